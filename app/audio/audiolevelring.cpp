@@ -0,0 +1,133 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audiolevelring.h"
+
+#include <QtMath>
+
+namespace olive {
+
+const int AudioLevelRing::kMaxChannels;
+const int AudioLevelRing::kCapacity;
+
+AudioLevelRing::AudioLevelRing() :
+  write_pos_(0)
+{
+  for (int i=0; i<kCapacity; i++) {
+    slots_[i].sequence = 0;
+    slots_[i].block.channels = 0;
+  }
+}
+
+void AudioLevelRing::WriteSamples(const float *samples, int nb_samples, int channels, qint64 audible_time)
+{
+  if (channels <= 0 || nb_samples <= 0) {
+    return;
+  }
+
+  Block b;
+  b.channels = qMin(channels, kMaxChannels);
+  b.audible_time = audible_time;
+
+  double sum_of_squares[kMaxChannels];
+
+  for (int i=0; i<b.channels; i++) {
+    b.peak[i] = 0;
+    sum_of_squares[i] = 0;
+  }
+
+  int frames = nb_samples / channels;
+
+  for (int i=0; i<frames; i++) {
+    const float* frame = samples + i * channels;
+
+    for (int j=0; j<b.channels; j++) {
+      float s = qAbs(frame[j]);
+
+      if (s > b.peak[j]) {
+        b.peak[j] = s;
+      }
+
+      sum_of_squares[j] += static_cast<double>(s) * s;
+    }
+  }
+
+  for (int i=0; i<b.channels; i++) {
+    b.rms[i] = frames ? static_cast<float>(qSqrt(sum_of_squares[i] / frames)) : 0.0f;
+  }
+
+  qint64 pos = write_pos_.loadAcquire();
+  Slot& slot = slots_[pos % kCapacity];
+
+  // Full barrier so the block isn't written before readers can see the slot is odd
+  slot.sequence.fetchAndAddOrdered(1);
+  slot.block = b;
+  slot.sequence.fetchAndAddRelease(1);
+
+  write_pos_.storeRelease(pos + 1);
+}
+
+bool AudioLevelRing::Read(qint64 *cursor, Block *block) const
+{
+  qint64 write_pos = write_pos_.loadAcquire();
+
+  // Anything older than this may have been overwritten already
+  *cursor = qMax(*cursor, write_pos - kCapacity + 1);
+
+  while (*cursor < write_pos) {
+    const Slot& slot = slots_[*cursor % kCapacity];
+
+    quint32 before = slot.sequence.loadAcquire();
+    *block = slot.block;
+    quint32 after = slot.sequence.fetchAndAddOrdered(0);
+
+    (*cursor)++;
+
+    if (!(before & 1) && before == after) {
+      return true;
+    }
+
+    // Overwritten while we were reading it, try the next one
+  }
+
+  return false;
+}
+
+bool AudioLevelRing::IsNextAudible(qint64 cursor, qint64 time) const
+{
+  qint64 write_pos = write_pos_.loadAcquire();
+
+  cursor = qMax(cursor, write_pos - kCapacity + 1);
+
+  if (cursor >= write_pos) {
+    return false;
+  }
+
+  const Slot& slot = slots_[cursor % kCapacity];
+
+  quint32 before = slot.sequence.loadAcquire();
+  qint64 audible_time = slot.block.audible_time;
+  quint32 after = slot.sequence.fetchAndAddOrdered(0);
+
+  // A block being overwritten is newer than we want, so it's as good as audible to let Read() skip it
+  return (before & 1) || before != after || audible_time <= time;
+}
+
+}
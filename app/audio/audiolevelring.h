@@ -0,0 +1,102 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIOLEVELRING_H
+#define AUDIOLEVELRING_H
+
+#include <QAtomicInteger>
+
+#include "common/define.h"
+
+namespace olive {
+
+/**
+ * @brief Lock-free ring of per-block audio levels, written by the output and read by meters
+ *
+ * The audio output thread measures every block it hands to the device and writes it here, so
+ * meters show exactly what's being played without reading any audio themselves. Write() must only
+ * be called from one thread. Any number of threads can Read(), each with its own cursor, since a
+ * slot overwritten mid-read is detected by its sequence number and skipped.
+ */
+class AudioLevelRing
+{
+public:
+  /**
+   * @brief Channels beyond this aren't measured
+   */
+  static const int kMaxChannels = 16;
+
+  struct Block {
+    int channels;
+    float peak[kMaxChannels];
+    float rms[kMaxChannels];
+
+    /// QDateTime::currentMSecsSinceEpoch() at which this block becomes audible
+    qint64 audible_time;
+  };
+
+  AudioLevelRing();
+
+  DISABLE_COPY_MOVE(AudioLevelRing)
+
+  /**
+   * @brief Measure interleaved float samples and write them as one block
+   */
+  void WriteSamples(const float* samples, int nb_samples, int channels, qint64 audible_time);
+
+  /**
+   * @brief Read the next block after `cursor`, returns FALSE if there isn't one
+   *
+   * `cursor` should start as GetWritePosition(). If the reader fell so far behind that blocks were
+   * overwritten, it skips to the oldest block still available.
+   */
+  bool Read(qint64* cursor, Block* block) const;
+
+  /**
+   * @brief Returns TRUE if the block after `cursor` exists and becomes audible by `time`
+   */
+  bool IsNextAudible(qint64 cursor, qint64 time) const;
+
+  qint64 GetWritePosition() const
+  {
+    return write_pos_.loadAcquire();
+  }
+
+private:
+  static const int kCapacity = 128;
+
+  struct Slot {
+    /// Odd while the slot is being written. Mutable so readers can use an ordered read-modify-write
+    /// to keep their copy of the block from being reordered past it.
+    mutable QAtomicInteger<quint32> sequence;
+
+    Block block;
+  };
+
+  Slot slots_[kCapacity];
+
+  /// Total blocks ever written, the slot index is this modulo the capacity
+  QAtomicInteger<qint64> write_pos_;
+
+};
+
+}
+
+#endif // AUDIOLEVELRING_H
@@ -84,9 +84,13 @@ void AudioManager::PushToOutput(const QByteArray &samples)
 
 void AudioManager::StartOutput(AudioPlaybackCache *cache, qint64 offset, int playback_speed)
 {
-  // Create device
-  QIODevice* device = cache->CreatePlaybackDevice();
+  StartOutput(cache->CreatePlaybackDevice(), offset, playback_speed);
 
+  emit OutputDeviceStarted(cache, offset, playback_speed);
+}
+
+void AudioManager::StartOutput(QIODevice *device, qint64 offset, int playback_speed)
+{
   // Move to output manager's thread
   device->moveToThread(&output_thread_);
 
@@ -97,8 +101,6 @@ void AudioManager::StartOutput(AudioPlaybackCache *cache, qint64 offset, int pla
                             Q_ARG(QIODevice*, device),
                             Q_ARG(qint64, offset),
                             Q_ARG(int, playback_speed));
-
-  emit OutputDeviceStarted(cache, offset, playback_speed);
 }
 
 void AudioManager::StopOutput()
@@ -132,7 +134,8 @@ void AudioManager::SetOutputDevice(const QAudioDeviceInfo &info)
                                 "SetOutputDevice",
                                 Qt::QueuedConnection,
                                 Q_ARG(const QAudioDeviceInfo&, info),
-                                Q_ARG(const QAudioFormat&, format));
+                                Q_ARG(const QAudioFormat&, format),
+                                Q_ARG(int, Config::Current()["AudioOutputBufferSize"].toInt()));
       output_is_set_ = true;
     } else {
       qWarning() << "Output format not supported by device";
@@ -140,6 +143,21 @@ void AudioManager::SetOutputDevice(const QAudioDeviceInfo &info)
   }
 }
 
+int AudioManager::GetOutputLatency() const
+{
+  return output_manager_->GetLatency();
+}
+
+bool AudioManager::GetOutputClock(qint64 *played_usecs, qint64 *sampled_at_msecs) const
+{
+  return output_manager_->GetClock(played_usecs, sampled_at_msecs);
+}
+
+const AudioLevelRing &AudioManager::GetOutputLevels() const
+{
+  return output_manager_->GetLevels();
+}
+
 void AudioManager::SetOutputParams(const AudioParams &params)
 {
   if (output_params_ != params) {
@@ -62,6 +62,13 @@ public:
    */
   void StartOutput(AudioPlaybackCache* cache, qint64 offset, int playback_speed);
 
+  /**
+   * @brief Start playing audio from any seekable device of PCM in the output params
+   *
+   * AudioManager takes ownership of the device.
+   */
+  void StartOutput(QIODevice* device, qint64 offset, int playback_speed);
+
   /**
    * @brief Stop audio output immediately
    */
@@ -69,6 +76,25 @@ public:
 
   void SetOutputDevice(const QAudioDeviceInfo& info);
 
+  /**
+   * @brief Measured output latency in milliseconds, i.e. how long until samples read now are heard
+   */
+  int GetOutputLatency() const;
+
+  /**
+   * @brief Position of the audio that's being heard right now, for video to follow
+   *
+   * \see AudioOutputManager::GetClock()
+   */
+  bool GetOutputClock(qint64* played_usecs, qint64* sampled_at_msecs) const;
+
+  /**
+   * @brief Levels of the audio being played, for meters to read at their own rate
+   *
+   * \see AudioLevelRing
+   */
+  const AudioLevelRing& GetOutputLevels() const;
+
   void SetOutputParams(const AudioParams& params);
 
   void SetInputDevice(const QAudioDeviceInfo& info);
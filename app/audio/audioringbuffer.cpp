@@ -0,0 +1,98 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audioringbuffer.h"
+
+namespace olive {
+
+AudioRingBuffer::AudioRingBuffer() :
+  read_pos_(0),
+  write_pos_(0)
+{
+}
+
+void AudioRingBuffer::Resize(int capacity)
+{
+  buffer_.resize(capacity);
+  Clear();
+}
+
+void AudioRingBuffer::Clear()
+{
+  read_pos_.store(0);
+  write_pos_.store(0);
+}
+
+int AudioRingBuffer::Write(const char *data, int length)
+{
+  qint64 read = read_pos_.loadAcquire();
+  qint64 write = write_pos_.load();
+
+  int count = qMin(length, capacity() - static_cast<int>(write - read));
+
+  if (count <= 0) {
+    return 0;
+  }
+
+  // The free space may wrap around the end of the buffer
+  int start = static_cast<int>(write % capacity());
+  int first = qMin(count, capacity() - start);
+
+  memcpy(buffer_.data() + start, data, static_cast<size_t>(first));
+  memcpy(buffer_.data(), data + first, static_cast<size_t>(count - first));
+
+  write_pos_.storeRelease(write + count);
+
+  return count;
+}
+
+int AudioRingBuffer::Read(char *data, int length)
+{
+  qint64 write = write_pos_.loadAcquire();
+  qint64 read = read_pos_.load();
+
+  int count = qMin(length, static_cast<int>(write - read));
+
+  if (count <= 0) {
+    return 0;
+  }
+
+  int start = static_cast<int>(read % capacity());
+  int first = qMin(count, capacity() - start);
+
+  memcpy(data, buffer_.constData() + start, static_cast<size_t>(first));
+  memcpy(data + first, buffer_.constData(), static_cast<size_t>(count - first));
+
+  read_pos_.storeRelease(read + count);
+
+  return count;
+}
+
+int AudioRingBuffer::BytesAvailable() const
+{
+  return static_cast<int>(write_pos_.loadAcquire() - read_pos_.loadAcquire());
+}
+
+int AudioRingBuffer::BytesFree() const
+{
+  return capacity() - BytesAvailable();
+}
+
+}
@@ -0,0 +1,82 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIORINGBUFFER_H
+#define AUDIORINGBUFFER_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+
+#include "common/define.h"
+
+namespace olive {
+
+/**
+ * @brief Lock-free single producer, single consumer byte ring buffer
+ *
+ * Used to hand audio from the thread that reads and processes it to the audio output, which must
+ * never block on a lock or file IO. Write() must only ever be called from one thread and Read()
+ * from one (other) thread. Resize() and Clear() must only be called while neither is running.
+ */
+class AudioRingBuffer
+{
+public:
+  AudioRingBuffer();
+
+  DISABLE_COPY_MOVE(AudioRingBuffer)
+
+  /**
+   * @brief Set the capacity in bytes, this also clears the buffer
+   */
+  void Resize(int capacity);
+
+  void Clear();
+
+  /**
+   * @brief Copy up to `length` bytes in, returns how many were written
+   */
+  int Write(const char* data, int length);
+
+  /**
+   * @brief Copy up to `length` bytes out, returns how many were read
+   */
+  int Read(char* data, int length);
+
+  int BytesAvailable() const;
+
+  int BytesFree() const;
+
+  int capacity() const
+  {
+    return buffer_.size();
+  }
+
+private:
+  QByteArray buffer_;
+
+  /// Total bytes ever read and written, the buffer index is these modulo the capacity
+  QAtomicInteger<qint64> read_pos_;
+  QAtomicInteger<qint64> write_pos_;
+
+};
+
+}
+
+#endif // AUDIORINGBUFFER_H
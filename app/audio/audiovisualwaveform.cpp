@@ -20,17 +20,33 @@
 
 #include "audiovisualwaveform.h"
 
+#include <QDataStream>
 #include <QDebug>
+#include <QFile>
+#include <QtMath>
+#include <QVarLengthArray>
 
+#include "codec/samplekernels.h"
 #include "config/config.h"
+#include "render/imageatlas.h"
 
 namespace olive {
 
 const int AudioVisualWaveform::kSumSampleRate = 200;
+const quint32 AudioVisualWaveform::kMagic = 0x4F574156; // "OWAV"
+const quint32 AudioVisualWaveform::kVersion = 2;
+const int AudioVisualWaveform::kTileWidth = 256;
+QAtomicInteger<quint64> AudioVisualWaveform::next_revision_(1);
 
 void AudioVisualWaveform::AddSum(const float *samples, int nb_samples, int nb_channels)
 {
+  Detach();
+
+  int old_size = data_.size();
+
   data_.append(SumSamples(samples, nb_samples, nb_channels));
+
+  UpdateMipmaps(old_size, data_.size());
 }
 
 void AudioVisualWaveform::OverwriteSamples(SampleBufferPtr samples, int sample_rate, const rational &start)
@@ -40,6 +56,8 @@ void AudioVisualWaveform::OverwriteSamples(SampleBufferPtr samples, int sample_r
     return;
   }
 
+  Detach();
+
   int start_index = time_to_samples(start);
   int samples_length = time_to_samples(static_cast<double>(samples->sample_count()) / static_cast<double>(sample_rate));
 
@@ -61,18 +79,24 @@ void AudioVisualWaveform::OverwriteSamples(SampleBufferPtr samples, int sample_r
         summary.constData(),
         summary.size() * sizeof(SamplePerChannel));
   }
+
+  UpdateMipmaps(start_index, end_index);
 }
 
 void AudioVisualWaveform::OverwriteSums(const AudioVisualWaveform &sums, const rational &dest, const rational& offset, const rational& length)
 {
-  if (sums.data_.isEmpty()) {
+  Level src = sums.GetLevel(0);
+
+  if (!src.count) {
     return;
   }
 
+  Detach();
+
   int start_index = time_to_samples(dest);
   int sample_start = time_to_samples(offset);
 
-  int copy_len = sums.data_.size() - sample_start;
+  int copy_len = src.count - sample_start;
   if (!length.isNull()) {
     copy_len = qMin(copy_len, time_to_samples(length));
   }
@@ -84,38 +108,62 @@ void AudioVisualWaveform::OverwriteSums(const AudioVisualWaveform &sums, const r
   }
 
   memcpy(reinterpret_cast<char*>(data_.data()) + start_index * sizeof(SamplePerChannel),
-         reinterpret_cast<const char*>(sums.data_.constData()) + time_to_samples(offset) * sizeof(SamplePerChannel),
+         reinterpret_cast<const char*>(src.data) + sample_start * sizeof(SamplePerChannel),
          copy_len * sizeof(SamplePerChannel));
+
+  UpdateMipmaps(start_index, end_index);
 }
 
 AudioVisualWaveform AudioVisualWaveform::Mid(const rational &time) const
 {
-  int sample_index = time_to_samples(time);
+  Level base = GetLevel(0);
+  int sample_index = qBound(0, time_to_samples(time), base.count);
 
   // Create a copy of this waveform chop the early section off
-  AudioVisualWaveform copy = *this;
-  copy.data_ = data_.mid(sample_index);
+  AudioVisualWaveform copy;
+  copy.channels_ = channels_;
+  copy.data_.resize(base.count - sample_index);
+  memcpy(copy.data_.data(), base.data + sample_index, copy.data_.size() * sizeof(SamplePerChannel));
+  copy.UpdateAllMipmaps();
 
   return copy;
 }
 
 void AudioVisualWaveform::Append(const AudioVisualWaveform &waveform)
 {
-  data_.append(waveform.data_);
+  Detach();
+
+  Level src = waveform.GetLevel(0);
+  int old_size = data_.size();
+
+  data_.resize(old_size + src.count);
+  memcpy(data_.data() + old_size, src.data, src.count * sizeof(SamplePerChannel));
+
+  UpdateMipmaps(old_size, data_.size());
 }
 
 void AudioVisualWaveform::TrimIn(const rational &time)
 {
+  Detach();
+
   data_ = data_.mid(time_to_samples(time));
+
+  UpdateAllMipmaps();
 }
 
 void AudioVisualWaveform::TrimOut(const rational &time)
 {
+  Detach();
+
   data_.resize(data_.size() - time_to_samples(time));
+
+  UpdateMipmaps(data_.size(), data_.size());
 }
 
 void AudioVisualWaveform::PrependSilence(const rational &time)
 {
+  Detach();
+
   int added_samples = time_to_samples(time);
 
   // Resize buffer for extra space
@@ -128,10 +176,14 @@ void AudioVisualWaveform::PrependSilence(const rational &time)
 
   // Fill remainder with silence
   memset(reinterpret_cast<char*>(data_.data()), 0, added_samples * sizeof(SamplePerChannel));
+
+  UpdateAllMipmaps();
 }
 
 void AudioVisualWaveform::AppendSilence(const rational &time)
 {
+  Detach();
+
   int added_samples = time_to_samples(time);
 
   // Resize buffer for extra space
@@ -140,6 +192,8 @@ void AudioVisualWaveform::AppendSilence(const rational &time)
 
   // Fill remainder with silence
   memset(reinterpret_cast<char*>(&data_[old_size]), 0, (data_.size() - old_size) * sizeof(SamplePerChannel));
+
+  UpdateMipmaps(old_size, data_.size());
 }
 
 void AudioVisualWaveform::Shift(const rational &from, const rational &to)
@@ -151,6 +205,8 @@ void AudioVisualWaveform::Shift(const rational &from, const rational &to)
     return;
   }
 
+  Detach();
+
   if (from_index > data_.size()) {
     return;
   }
@@ -180,11 +236,167 @@ void AudioVisualWaveform::Shift(const rational &from, const rational &to)
 
     memset(reinterpret_cast<char*>(&data_[from_index]), 0, distance * sizeof(SamplePerChannel));
   }
+
+  // Everything after the earlier of the two points has moved
+  UpdateMipmaps(qMin(from_index, to_index), data_.size());
+}
+
+bool AudioVisualWaveform::Load(const QString &filename)
+{
+  if (Map(filename)) {
+    Detach();
+    return true;
+  }
+
+  channels_ = 0;
+  data_.clear();
+  mipmaps_.clear();
+  UpdateMemoryUsage();
+
+  QFile f(filename);
+
+  if (!f.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  QDataStream ds(&f);
+
+  quint32 magic, version;
+  qint32 channels, count;
+
+  ds >> magic >> version >> channels >> count;
+
+  // Version 1 only stored the sums at kSumSampleRate, the levels are rebuilt from them
+  if (magic != kMagic || version != 1 || channels <= 0 || count < 0) {
+    return false;
+  }
+
+  data_.resize(count);
+
+  int bytes = count * static_cast<int>(sizeof(SamplePerChannel));
+
+  if (ds.readRawData(reinterpret_cast<char*>(data_.data()), bytes) != bytes) {
+    qWarning() << "Waveform" << filename << "is corrupt";
+    data_.clear();
+    UpdateMemoryUsage();
+    return false;
+  }
+
+  channels_ = channels;
+
+  UpdateAllMipmaps();
+
+  return true;
+}
+
+bool AudioVisualWaveform::Map(const QString &filename)
+{
+  std::shared_ptr<QFile> f = std::make_shared<QFile>(filename);
+
+  if (!f->open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  QDataStream ds(f.get());
+
+  quint32 magic, version;
+  qint32 channels, level_count;
+
+  ds >> magic >> version >> channels >> level_count;
+
+  if (magic != kMagic || version != kVersion || channels <= 0 || level_count <= 0) {
+    return false;
+  }
+
+  QVector<qint32> counts(level_count);
+  qint64 expected_size = f->pos() + level_count * static_cast<qint64>(sizeof(qint32));
+
+  for (int i=0; i<level_count; i++) {
+    ds >> counts[i];
+    expected_size += counts.at(i) * static_cast<qint64>(sizeof(SamplePerChannel));
+  }
+
+  if (ds.status() != QDataStream::Ok || f->size() < expected_size) {
+    qWarning() << "Waveform" << filename << "is corrupt";
+    return false;
+  }
+
+  qint64 data_offset = f->pos();
+  uchar* mapped = f->map(0, f->size());
+
+  if (!mapped) {
+    return false;
+  }
+
+  QVector<Level> levels(level_count);
+  const SamplePerChannel* level_data = reinterpret_cast<const SamplePerChannel*>(mapped + data_offset);
+
+  for (int i=0; i<level_count; i++) {
+    levels[i] = {level_data, counts.at(i)};
+    level_data += counts.at(i);
+  }
+
+  data_.clear();
+  mipmaps_.clear();
+  channels_ = channels;
+  mapped_file_ = f;
+  mapped_levels_ = levels;
+
+  // Mapped sums are paged in and out by the OS so they aren't counted
+  UpdateMemoryUsage();
+
+  return true;
+}
+
+bool AudioVisualWaveform::Save(const QString &filename) const
+{
+  QFile f(filename);
+
+  if (!f.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to write waveform" << filename;
+    return false;
+  }
+
+  QDataStream ds(&f);
+
+  int level_count = GetLevelCount();
+
+  ds << kMagic << kVersion << qint32(channels_) << qint32(level_count);
+
+  for (int i=0; i<level_count; i++) {
+    ds << qint32(GetLevel(i).count);
+  }
+
+  // Every level is stored so the file can be mapped and drawn at any zoom without computing them
+  for (int i=0; i<level_count; i++) {
+    Level level = GetLevel(i);
+    int bytes = level.count * static_cast<int>(sizeof(SamplePerChannel));
+
+    if (ds.writeRawData(reinterpret_cast<const char*>(level.data), bytes) != bytes) {
+      return false;
+    }
+  }
+
+  return ds.status() == QDataStream::Ok;
 }
 
 QVector<AudioVisualWaveform::SamplePerChannel> AudioVisualWaveform::SumSamples(const float *samples, int nb_samples, int nb_channels)
 {
-  return SumSamplesInternal<float>(samples, nb_samples, nb_channels);
+  QVarLengthArray<float, 8> min(nb_channels);
+  QVarLengthArray<float, 8> max(nb_channels);
+  std::fill(min.begin(), min.end(), 0.0f);
+  std::fill(max.begin(), max.end(), 0.0f);
+
+  SampleKernels::ExpandMinMax(samples, nb_samples, nb_channels, min.data(), max.data());
+
+  QVector<AudioVisualWaveform::SamplePerChannel> summed_samples(nb_channels);
+
+  for (int i=0; i<nb_channels; i++) {
+    summed_samples[i].min = min.at(i);
+    summed_samples[i].max = max.at(i);
+  }
+
+  return summed_samples;
 }
 
 QVector<AudioVisualWaveform::SamplePerChannel> AudioVisualWaveform::SumSamples(const qfloat16 *samples, int nb_samples, int nb_channels)
@@ -196,12 +408,15 @@ QVector<AudioVisualWaveform::SamplePerChannel> AudioVisualWaveform::SumSamples(S
 {
   QVector<AudioVisualWaveform::SamplePerChannel> summed_samples(samples->audio_params().channel_count());
 
-  int end_index = start_index + length;
+  // Planar, so each channel is summed on its own
+  for (int channel=0; channel<samples->audio_params().channel_count(); channel++) {
+    float min = 0.0f;
+    float max = 0.0f;
 
-  for (int i=start_index; i<end_index; i++) {
-    for (int channel=0; channel<samples->audio_params().channel_count(); channel++) {
-      ExpandMinMax<float>(summed_samples[channel], samples->data()[channel][i]);
-    }
+    SampleKernels::ExpandMinMax(samples->data()[channel] + start_index, length, 1, &min, &max);
+
+    summed_samples[channel].min = min;
+    summed_samples[channel].max = max;
   }
 
   return summed_samples;
@@ -261,43 +476,243 @@ void AudioVisualWaveform::DrawSample(QPainter *painter, const QVector<SamplePerC
 
 void AudioVisualWaveform::DrawWaveform(QPainter *painter, const QRect& rect, const double& scale, const AudioVisualWaveform &samples, const rational& start_time)
 {
-  int start_sample_index = samples.time_to_samples(start_time);
+  int channels = samples.channel_count();
 
-  if (start_sample_index >= samples.nb_samples()) {
+  if (!channels || !samples.nb_samples()) {
     return;
   }
 
-  int next_sample_index = start_sample_index;
-  int sample_index;
+  int start, end;
+  GetVisibleColumns(painter, rect, &start, &end);
+
+  DrawColumns(painter, samples, static_cast<double>(kSumSampleRate) / scale,
+              samples.time_to_samples(start_time) / channels,
+              start - rect.x(), end - rect.x(), rect.x(), rect.y(), rect.height());
+}
+
+void AudioVisualWaveform::DrawWaveformCached(QPainter *painter, const QRect &rect, const double &scale, const AudioVisualWaveform &samples, const rational &start_time)
+{
+  ImageAtlas* atlas = ImageAtlas::instance();
+
+  if (!atlas) {
+    DrawWaveform(painter, rect, scale, samples, start_time);
+    return;
+  }
+
+  int channels = samples.channel_count();
+
+  if (!channels || !samples.nb_samples() || rect.height() <= 0) {
+    return;
+  }
+
+  double frames_per_pixel = static_cast<double>(kSumSampleRate) / scale;
+  int total_columns = qCeil(static_cast<double>(samples.nb_samples() / channels) / frames_per_pixel);
+
+  // Columns are counted from the start of the waveform so tiles don't depend on where `rect` is
+  int origin = qFloor(start_time.toDouble() * scale);
+
+  int start, end;
+  GetVisibleColumns(painter, rect, &start, &end);
+
+  int first_column = qMax(0, start - rect.x() + origin);
+  int last_column = qMin(total_columns, end - rect.x() + origin);
+
+  QColor color = painter->pen().color();
+  bool rectified = Config::Current()[QStringLiteral("RectifiedWaveforms")].toBool();
+
+  for (int t=first_column/kTileWidth; t*kTileWidth<last_column; t++) {
+    QByteArray key;
+    {
+      QDataStream ds(&key, QIODevice::WriteOnly);
+      ds << QByteArrayLiteral("waveform") << samples.revision() << qint32(channels) << scale
+         << qint32(rect.height()) << color.rgba() << rectified << qint32(t);
+    }
+
+    int tile_start = t * kTileWidth;
+
+    ImageAtlas::Tile tile = atlas->Get(key);
+
+    if (tile.isNull()) {
+      // The last tile is allocated full width too so it shares pages with the others
+      tile = atlas->Insert(key, QSize(kTileWidth, rect.height()));
+
+      if (tile.isNull()) {
+        DrawWaveform(painter, rect, scale, samples, start_time);
+        return;
+      }
+
+      QPainter tile_painter(tile.page);
+      tile_painter.setClipRect(tile.rect);
+      tile_painter.setPen(painter->pen());
+      DrawColumns(&tile_painter, samples, frames_per_pixel, 0,
+                  tile_start, qMin(total_columns, tile_start + kTileWidth), tile.rect.x() - tile_start, tile.rect.y(), rect.height());
+    }
+
+    int from = qMax(first_column, tile_start);
+    int to = qMin(last_column, tile_start + kTileWidth);
+
+    painter->drawImage(QPoint(rect.x() + from - origin, rect.y()), *tile.page,
+                       QRect(tile.rect.x() + from - tile_start, tile.rect.y(), to - from, rect.height()));
+  }
+}
+
+void AudioVisualWaveform::DrawColumns(QPainter *painter, const AudioVisualWaveform &samples, double frames_per_pixel,
+                                      int start_frame, int first, int last, int x, int y, int height)
+{
+  int channels = samples.channel_count();
+  int total_frames = samples.nb_samples() / channels;
+
+  if (start_frame >= total_frames) {
+    return;
+  }
+
+  // Pick the coarsest level that still has at least one sum per pixel
+  int level = 0;
+  while (level < samples.GetLevelCount() - 1 && static_cast<double>(2 << level) <= frames_per_pixel) {
+    level++;
+  }
+
+  // If the waveform is mapped, only the sums read below are paged in
+  Level level_data = samples.GetLevel(level);
+  int level_frames = level_data.count / channels;
 
   QVector<SamplePerChannel> summary;
   int summary_index = -1;
 
+  for (int i=first;i<last;i++) {
+    int frame = start_frame + qFloor(frames_per_pixel * static_cast<double>(i));
+
+    if (frame >= total_frames) {
+      break;
+    }
+
+    int next_frame = qMin(total_frames, start_frame + qFloor(frames_per_pixel * static_cast<double>(i + 1)));
+
+    int level_start = frame >> level;
+    int level_end = qMin(level_frames, qMax(level_start + 1, next_frame >> level));
+
+    if (summary_index != level_start) {
+      summary = AudioVisualWaveform::ReSumSamples(level_data.data + level_start * channels,
+                                                  (level_end - level_start) * channels,
+                                                  channels);
+      summary_index = level_start;
+    }
+
+    DrawSample(painter, summary, x + i, y, height);
+  }
+}
+
+void AudioVisualWaveform::GetVisibleColumns(QPainter *painter, const QRect &rect, int *start, int *end)
+{
   const QRect& viewport = painter->viewport();
   QPoint top_left = painter->transform().map(viewport.topLeft());
 
-  int start = qMax(rect.x(), -top_left.x());
-  int end = qMin(rect.right(), -top_left.x() + viewport.width());
+  *start = qMax(rect.x(), -top_left.x());
+  *end = qMin(rect.right(), -top_left.x() + viewport.width());
+}
+
+void AudioVisualWaveform::UpdateMipmaps(int start, int end)
+{
+  if (!channels_) {
+    mipmaps_.clear();
+    UpdateMemoryUsage();
+    return;
+  }
+
+  // Work in frames (one sum for every channel) from here
+  start /= channels_;
+  end = (end + channels_ - 1) / channels_;
 
-  for (int i=start;i<end;i++) {
-    sample_index = next_sample_index;
+  int src_frames = data_.size() / channels_;
 
-    if (sample_index == samples.nb_samples()) {
-      break;
-    }
+  // Size the pyramid first so references into it stay valid below
+  int level_count = 0;
+  for (int f=src_frames; f>1; f=(f+1)/2) {
+    level_count++;
+  }
+  mipmaps_.resize(level_count);
 
-    next_sample_index = qMin(samples.nb_samples(),
-                             start_sample_index + qFloor(static_cast<double>(kSumSampleRate) * static_cast<double>(i - rect.x() + 1) / scale) * samples.channel_count());
+  const QVector<SamplePerChannel>* src = &data_;
 
-    if (summary_index != sample_index) {
-      summary = AudioVisualWaveform::ReSumSamples(&samples.data_.at(sample_index),
-                                                  qMax(samples.channel_count(), next_sample_index - sample_index),
-                                                  samples.channel_count());
-      summary_index = sample_index;
+  for (int level=0; level<level_count; level++) {
+    int dst_frames = (src_frames + 1) / 2;
+
+    QVector<SamplePerChannel>& dst = mipmaps_[level];
+    dst.resize(dst_frames * channels_);
+
+    start /= 2;
+    end = qMin(dst_frames, (end + 1) / 2);
+
+    for (int i=start; i<end; i++) {
+      int a = (i * 2) * channels_;
+      int b = (i * 2 + 1 < src_frames) ? a + channels_ : a;
+
+      for (int j=0; j<channels_; j++) {
+        const SamplePerChannel& first = src->at(a + j);
+        const SamplePerChannel& second = src->at(b + j);
+
+        dst[i * channels_ + j].min = qMin(first.min, second.min);
+        dst[i * channels_ + j].max = qMax(first.max, second.max);
+      }
     }
 
-    DrawSample(painter, summary, i, rect.y(), rect.height());
+    src = &dst;
+    src_frames = dst_frames;
   }
+
+  UpdateMemoryUsage();
+}
+
+void AudioVisualWaveform::UpdateMemoryUsage()
+{
+  qint64 sums = data_.size();
+
+  foreach (const QVector<SamplePerChannel>& level, mipmaps_) {
+    sums += level.size();
+  }
+
+  memory_.Set(sums * static_cast<qint64>(sizeof(SamplePerChannel)));
+
+  // Every modification ends here, so this is where the contents get a new identity
+  revision_ = next_revision_.fetchAndAddRelaxed(1);
+}
+
+AudioVisualWaveform::Level AudioVisualWaveform::GetLevel(int level) const
+{
+  if (mapped_file_) {
+    return mapped_levels_.at(level);
+  }
+
+  const QVector<SamplePerChannel>& v = (level == 0) ? data_ : mipmaps_.at(level - 1);
+  return {v.constData(), v.size()};
+}
+
+int AudioVisualWaveform::GetLevelCount() const
+{
+  return mapped_file_ ? mapped_levels_.size() : mipmaps_.size() + 1;
+}
+
+void AudioVisualWaveform::Detach()
+{
+  if (!mapped_file_) {
+    return;
+  }
+
+  QVector< QVector<SamplePerChannel> > levels(mapped_levels_.size());
+
+  for (int i=0; i<levels.size(); i++) {
+    const Level& l = mapped_levels_.at(i);
+    levels[i].resize(l.count);
+    memcpy(levels[i].data(), l.data, l.count * sizeof(SamplePerChannel));
+  }
+
+  data_ = levels.takeFirst();
+  mipmaps_ = levels;
+
+  mapped_file_ = nullptr;
+  mapped_levels_.clear();
+
+  UpdateMemoryUsage();
 }
 
 int AudioVisualWaveform::time_to_samples(const rational &time) const
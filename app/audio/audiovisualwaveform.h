@@ -21,11 +21,15 @@
 #ifndef SUMSAMPLES_H
 #define SUMSAMPLES_H
 
+#include <memory>
+#include <QAtomicInteger>
+#include <QFile>
 #include <QFloat16>
 #include <QPainter>
 #include <QVector>
 
 #include "codec/samplebuffer.h"
+#include "common/memoryaccounting.h"
 
 namespace olive {
 
@@ -34,6 +38,12 @@ namespace olive {
  *
  * This differs from a SampleBuffer as the data in an AudioVisualWaveform has been reduced
  * significantly and optimized for visual display.
+ *
+ * Alongside the sums at kSumSampleRate, a pyramid of coarser levels is kept up to date as the
+ * waveform is modified, so DrawWaveform() reads roughly one sum per pixel at any zoom level.
+ *
+ * Saved waveforms contain every level and can be mapped from disk with Map() rather than read
+ * into memory, in which case only the sums of the level and range being drawn are ever paged in.
  */
 class AudioVisualWaveform {
 public:
@@ -58,12 +68,12 @@ public:
 
   int nb_samples() const
   {
-    return data_.size();
+    return GetLevel(0).count;
   }
 
   const SamplePerChannel* const_data() const
   {
-    return data_.constData();
+    return GetLevel(0).data;
   }
 
   void AddSum(const float* samples, int nb_samples, int nb_channels);
@@ -79,6 +89,41 @@ public:
   void AppendSilence(const rational& time);
   void Shift(const rational& from, const rational& to);
 
+  /**
+   * @brief Load a waveform previously written with Save()
+   *
+   * Returns FALSE if the file doesn't exist or isn't a valid waveform, in which case this
+   * waveform is left empty.
+   */
+  bool Load(const QString& filename);
+
+  /**
+   * @brief Map a waveform previously written with Save() rather than reading it into memory
+   *
+   * The waveform is read-only while mapped, modifying it reads it into memory first. Returns
+   * FALSE if the file couldn't be mapped or was saved by an older version, which Load() can still
+   * read.
+   */
+  bool Map(const QString& filename);
+
+  bool IsMapped() const
+  {
+    return static_cast<bool>(mapped_file_);
+  }
+
+  bool Save(const QString& filename) const;
+
+  /**
+   * @brief Identifies the waveform's current contents and changes whenever they do
+   *
+   * Revisions are unique across all waveforms, so a copy shares its original's revision until
+   * either of them is modified.
+   */
+  quint64 revision() const
+  {
+    return revision_;
+  }
+
   // FIXME: Move to dynamic
   static const int kSumSampleRate;
 
@@ -92,20 +137,96 @@ public:
 
   static void DrawWaveform(QPainter* painter, const QRect &rect, const double &scale, const AudioVisualWaveform& samples, const rational &start_time);
 
+  /**
+   * @brief Same as DrawWaveform() but draws from tiles kept in ImageAtlas
+   *
+   * Tiles line up with the waveform's own time rather than `rect`, so every clip and scroll
+   * position showing the same part of a waveform at the same zoom shares the same tiles, and
+   * repaints just draw them. Falls back to DrawWaveform() if there's no ImageAtlas.
+   */
+  static void DrawWaveformCached(QPainter* painter, const QRect &rect, const double &scale, const AudioVisualWaveform& samples, const rational &start_time);
+
 private:
+  /**
+   * @brief Draw columns `first` to `last` (exclusive) at `x + column`
+   *
+   * Column `c` shows the frames from `start_frame + frames_per_pixel * c` onwards.
+   */
+  static void DrawColumns(QPainter* painter, const AudioVisualWaveform& samples, double frames_per_pixel,
+                          int start_frame, int first, int last, int x, int y, int height);
+
+  /**
+   * @brief Returns the range of columns of `rect` that are within the painter's viewport
+   */
+  static void GetVisibleColumns(QPainter* painter, const QRect& rect, int* start, int* end);
+
   template <typename T>
   static QVector<SamplePerChannel> SumSamplesInternal(const T* samples, int nb_samples, int nb_channels);
 
   template <typename T>
   static void ExpandMinMax(SamplePerChannel &sum, T value);
 
+  struct Level {
+    const SamplePerChannel* data;
+    int count;
+  };
+
+  /**
+   * @brief Sums of a level, 0 being `data_` and anything higher the mipmap at `level - 1`
+   */
+  Level GetLevel(int level) const;
+
+  int GetLevelCount() const;
+
+  /**
+   * @brief If mapped, read every level into memory and unmap so the waveform can be modified
+   */
+  void Detach();
+
   int time_to_samples(const rational& time) const;
   int time_to_samples(const double& time) const;
 
+  /**
+   * @brief Recompute every mipmap level covering `data_` from index `start` to `end`
+   */
+  void UpdateMipmaps(int start, int end);
+
+  void UpdateAllMipmaps()
+  {
+    UpdateMipmaps(0, data_.size());
+  }
+
+  void UpdateMemoryUsage();
+
+  static const quint32 kMagic;
+  static const quint32 kVersion;
+
+  static const int kTileWidth;
+
+  static QAtomicInteger<quint64> next_revision_;
+
   int channels_ = 0;
 
   QVector<SamplePerChannel> data_;
 
+  /**
+   * @brief Progressively reduced copies of `data_`
+   *
+   * Index `n` holds the min/max of every 2^(n+1) sums in `data_`.
+   */
+  QVector< QVector<SamplePerChannel> > mipmaps_;
+
+  /**
+   * @brief The mapped file if Map() was used, shared between copies since they never modify it
+   */
+  std::shared_ptr<QFile> mapped_file_;
+
+  QVector<Level> mapped_levels_;
+
+  MemoryAccounting::Counter memory_{MemoryAccounting::kWaveforms};
+
+  quint64 revision_ = 0;
+
 };
 
 }
@@ -20,14 +20,28 @@
 
 #include "outputdeviceproxy.h"
 
+#include <QDateTime>
+
 #include "audiomanager.h"
 
 namespace olive {
 
+const int AudioOutputDeviceProxy::kPrefetchChunkSamples = 1024;
+const int AudioOutputDeviceProxy::kPrefetchIntervalMs = 2;
+
 AudioOutputDeviceProxy::AudioOutputDeviceProxy(QObject *parent) :
   QIODevice(parent),
-  device_(nullptr)
+  device_(nullptr),
+  playback_speed_(1),
+  prefetch_thread_(this),
+  source_finished_(0),
+  latency_(nullptr)
+{
+}
+
+AudioOutputDeviceProxy::~AudioOutputDeviceProxy()
 {
+  StopPrefetching();
 }
 
 void AudioOutputDeviceProxy::SetParameters(const AudioParams &params)
@@ -35,8 +49,10 @@ void AudioOutputDeviceProxy::SetParameters(const AudioParams &params)
   params_ = params;
 }
 
-void AudioOutputDeviceProxy::SetDevice(QIODevice* device, qint64 offset, int playback_speed)
+void AudioOutputDeviceProxy::SetDevice(QIODevice* device, qint64 offset, int playback_speed, int prefetch_bytes)
 {
+  StopPrefetching();
+
   if (device_) {
     delete device_;
   }
@@ -56,12 +72,29 @@ void AudioOutputDeviceProxy::SetDevice(QIODevice* device, qint64 offset, int pla
   playback_speed_ = playback_speed;
 
   if (qAbs(playback_speed_) != 1) {
-    tempo_processor_.Open(params_, qAbs(playback_speed_));
+    if (tempo_processor_.IsOpen()) {
+      // Shuttling to another speed, the grains still overlapping from the last speed blend into
+      // the new one rather than starting over from silence
+      tempo_processor_.SetSpeed(qAbs(playback_speed_));
+    } else {
+      tempo_processor_.Open(params_, qAbs(playback_speed_));
+    }
+  } else if (tempo_processor_.IsOpen()) {
+    tempo_processor_.Close();
   }
+
+  // Keep whole samples in the buffer so a short read never splits one
+  int sample_size = params_.samples_to_bytes(1);
+  ring_.Resize(qMax(sample_size, prefetch_bytes - prefetch_bytes % qMax(1, sample_size)));
+
+  source_finished_ = 0;
+  prefetch_thread_.Start();
 }
 
 void AudioOutputDeviceProxy::close()
 {
+  StopPrefetching();
+
   QIODevice::close();
 
   delete device_;
@@ -78,6 +111,36 @@ qint64 AudioOutputDeviceProxy::readData(char *data, qint64 maxlen)
     return 0;
   }
 
+  int read_count = ring_.Read(data, static_cast<int>(maxlen));
+
+  if (read_count < maxlen && !source_finished_.load()) {
+    // The prefetch thread fell behind. Output silence rather than stalling the output so its clock,
+    // which playback is synced to, keeps going.
+    int sample_size = qMax(1, params_.samples_to_bytes(1));
+    int padded = static_cast<int>(maxlen - maxlen % sample_size);
+
+    if (padded > read_count) {
+      memset(data + read_count, 0, static_cast<size_t>(padded - read_count));
+      read_count = padded;
+    }
+  }
+
+  // Measure exactly what the output is about to play, it's heard once the output's buffer ahead of
+  // it has drained
+  if (read_count > 0 && params_.format() == AudioParams::kFormatFloat32) {
+    qint64 audible_time = QDateTime::currentMSecsSinceEpoch() + (latency_ ? latency_->load() : 0);
+
+    levels_.WriteSamples(reinterpret_cast<const float*>(data),
+                         static_cast<int>(read_count / sizeof(float)),
+                         params_.channel_count(),
+                         audible_time);
+  }
+
+  return read_count;
+}
+
+qint64 AudioOutputDeviceProxy::ReadFromSource(char *data, qint64 maxlen)
+{
   qint64 read_count;
 
   if (tempo_processor_.IsOpen()) {
@@ -100,6 +163,14 @@ qint64 AudioOutputDeviceProxy::readData(char *data, qint64 maxlen)
   return read_count;
 }
 
+void AudioOutputDeviceProxy::StopPrefetching()
+{
+  if (prefetch_thread_.isRunning()) {
+    prefetch_thread_.Cancel();
+    prefetch_thread_.wait();
+  }
+}
+
 qint64 AudioOutputDeviceProxy::writeData(const char *data, qint64 maxSize)
 {
   Q_UNUSED(data)
@@ -137,4 +208,45 @@ qint64 AudioOutputDeviceProxy::ReverseAwareRead(char *data, qint64 maxlen)
   return read_count;
 }
 
+AudioOutputDeviceProxy::PrefetchThread::PrefetchThread(AudioOutputDeviceProxy *proxy) :
+  proxy_(proxy),
+  cancelled_(0)
+{
+}
+
+void AudioOutputDeviceProxy::PrefetchThread::Start()
+{
+  cancelled_ = 0;
+  start(QThread::HighPriority);
+}
+
+void AudioOutputDeviceProxy::PrefetchThread::Cancel()
+{
+  cancelled_ = 1;
+}
+
+void AudioOutputDeviceProxy::PrefetchThread::run()
+{
+  QByteArray chunk(qMax(1, proxy_->params_.samples_to_bytes(kPrefetchChunkSamples)), 0);
+
+  while (!cancelled_.load()) {
+    int space = proxy_->ring_.BytesFree();
+
+    if (space < chunk.size() && space < proxy_->ring_.capacity()) {
+      // Still plenty buffered, check back shortly
+      msleep(kPrefetchIntervalMs);
+      continue;
+    }
+
+    qint64 read_count = proxy_->ReadFromSource(chunk.data(), qMin(chunk.size(), space));
+
+    if (read_count <= 0) {
+      proxy_->source_finished_ = 1;
+      break;
+    }
+
+    proxy_->ring_.Write(chunk.constData(), static_cast<int>(read_count));
+  }
+}
+
 }
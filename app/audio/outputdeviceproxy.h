@@ -22,7 +22,10 @@
 #define AUDIOOUTPUTDEVICEPROXY_H
 
 #include <QFile>
+#include <QThread>
 
+#include "audiolevelring.h"
+#include "audioringbuffer.h"
 #include "common/define.h"
 #include "tempoprocessor.h"
 
@@ -30,6 +33,11 @@ namespace olive {
 
 /**
  * @brief QIODevice wrapper that can adjust speed/reverse an audio file
+ *
+ * Reading the source (which for playback means opening and reading cache segment files) and tempo
+ * processing happen on a prefetch thread that stays ahead of the output in a lock-free ring
+ * buffer, so readData(), which is called by the audio output when it needs more samples, never
+ * waits on file IO.
  */
 class AudioOutputDeviceProxy : public QIODevice
 {
@@ -37,20 +45,79 @@ class AudioOutputDeviceProxy : public QIODevice
 public:
   AudioOutputDeviceProxy(QObject* parent = nullptr);
 
+  virtual ~AudioOutputDeviceProxy() override;
+
   void SetParameters(const AudioParams& params);
 
-  void SetDevice(QIODevice *device, qint64 offset, int playback_speed);
+  /**
+   * @brief Start reading from a device
+   *
+   * `prefetch_bytes` is how far ahead of the output the device is read.
+   */
+  void SetDevice(QIODevice *device, qint64 offset, int playback_speed, int prefetch_bytes);
 
   virtual void close() override;
 
+  /**
+   * @brief Set where the output's latency in milliseconds is read from when timing level blocks
+   */
+  void SetLatencySource(const QAtomicInt* latency)
+  {
+    latency_ = latency;
+  }
+
+  /**
+   * @brief Levels of every block handed to the output
+   */
+  const AudioLevelRing& levels() const
+  {
+    return levels_;
+  }
+
 protected:
   virtual qint64 readData(char *data, qint64 maxlen) override;
 
   virtual qint64 writeData(const char *data, qint64 maxSize) override;
 
 private:
+  class PrefetchThread : public QThread
+  {
+  public:
+    PrefetchThread(AudioOutputDeviceProxy* proxy);
+
+    void Start();
+
+    void Cancel();
+
+  protected:
+    virtual void run() override;
+
+  private:
+    AudioOutputDeviceProxy* proxy_;
+
+    QAtomicInt cancelled_;
+
+  };
+
+  /**
+   * @brief Read from the source device with tempo processing, only called from the prefetch thread
+   */
+  qint64 ReadFromSource(char* data, qint64 maxlen);
+
   qint64 ReverseAwareRead(char* data, qint64 maxlen);
 
+  void StopPrefetching();
+
+  /**
+   * @brief Size of each read the prefetch thread makes from the source
+   */
+  static const int kPrefetchChunkSamples;
+
+  /**
+   * @brief How long the prefetch thread sleeps when the ring buffer is full
+   */
+  static const int kPrefetchIntervalMs;
+
   QIODevice* device_;
 
   TempoProcessor tempo_processor_;
@@ -59,6 +126,17 @@ private:
 
   int playback_speed_;
 
+  AudioRingBuffer ring_;
+
+  PrefetchThread prefetch_thread_;
+
+  /// Set by the prefetch thread once the source has nothing more to read
+  QAtomicInt source_finished_;
+
+  AudioLevelRing levels_;
+
+  const QAtomicInt* latency_;
+
 };
 
 }
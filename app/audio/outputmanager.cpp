@@ -21,18 +21,26 @@
 #include "outputmanager.h"
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QtMath>
 
 #include <QFile>
 
 namespace olive {
 
+const int AudioOutputManager::kPrefetchBufferMultiple = 4;
+
 AudioOutputManager::AudioOutputManager(QObject *parent) :
   QObject(parent),
   output_(nullptr),
   push_device_(nullptr),
-  device_proxy_(this)
+  device_proxy_(this),
+  latency_(0),
+  clock_valid_(false),
+  clock_played_usecs_(0),
+  clock_sampled_at_(0)
 {
+  device_proxy_.SetLatencySource(&latency_);
 }
 
 AudioOutputManager::~AudioOutputManager()
@@ -56,6 +64,28 @@ void AudioOutputManager::Push(const QByteArray& samples)
   QMetaObject::invokeMethod(this, "PushMoreSamples", Qt::QueuedConnection);
 }
 
+int AudioOutputManager::GetLatency() const
+{
+  return latency_.load();
+}
+
+bool AudioOutputManager::GetClock(qint64 *played_usecs, qint64 *sampled_at_msecs) const
+{
+  QMutexLocker locker(&clock_lock_);
+
+  *played_usecs = clock_played_usecs_;
+  *sampled_at_msecs = clock_sampled_at_;
+
+  return clock_valid_;
+}
+
+void AudioOutputManager::InvalidateClock()
+{
+  QMutexLocker locker(&clock_lock_);
+
+  clock_valid_ = false;
+}
+
 void AudioOutputManager::ResetToPushMode()
 {
   // If we have a null push device, then we currently have the output in pull mode. We restore it to push mode here.
@@ -66,6 +96,8 @@ void AudioOutputManager::ResetToPushMode()
 
     // Put QAudioOutput back into push mode
     push_device_ = output_->start();
+
+    InvalidateClock();
   }
 }
 
@@ -76,6 +108,8 @@ void AudioOutputManager::SetParameters(AudioParams params)
 
 void AudioOutputManager::Close()
 {
+  InvalidateClock();
+
   if (output_) {
     output_->stop();
 
@@ -99,8 +133,11 @@ void AudioOutputManager::PullFromDevice(QIODevice *device, qint64 offset, int pl
   push_device_ = nullptr;
   push_samples_.clear();
 
+  // The output's processed time starts again from zero
+  InvalidateClock();
+
   // Pull from the device
-  device_proxy_.SetDevice(device, offset, playback_speed);
+  device_proxy_.SetDevice(device, offset, playback_speed, output_->bufferSize() * kPrefetchBufferMultiple);
   device_proxy_.open(QIODevice::ReadOnly);
   output_->start(&device_proxy_);
 }
@@ -129,23 +166,52 @@ void AudioOutputManager::PushMoreSamples()
   }
 }
 
-void AudioOutputManager::SetOutputDevice(QAudioDeviceInfo info, QAudioFormat format)
+void AudioOutputManager::SetOutputDevice(QAudioDeviceInfo info, QAudioFormat format, int buffer_ms)
 {
   // Whatever the output is doing right now, stop it
   Close();
 
   // Create a new output device and start it in push mode
   output_ = new QAudioOutput(info, format, this);
-  output_->setBufferSize(131072);
+  output_->setBufferSize(format.bytesForDuration(qMax(1, buffer_ms) * 1000));
   output_->setNotifyInterval(1);
   push_device_ = output_->start();
   connect(output_, &QAudioOutput::notify, this, &AudioOutputManager::PushMoreSamples);
+  connect(output_, &QAudioOutput::notify, this, &AudioOutputManager::UpdateLatency);
   connect(output_, &QAudioOutput::notify, this, &AudioOutputManager::OutputNotified);
 
   // Un-comment this to get debug information about what the audio output is doing
   //connect(output_, &QAudioOutput::stateChanged, this, &AudioOutputManager::OutputStateChanged);
 }
 
+void AudioOutputManager::UpdateLatency()
+{
+  if (!output_ || output_->state() != QAudio::ActiveState) {
+    return;
+  }
+
+  qint64 queued = output_->bufferSize() - output_->bytesFree();
+  int measured = static_cast<int>(output_->format().durationForBytes(queued) / 1000);
+
+  // Buffer fill jumps around with every write, so smooth it out
+  latency_ = (latency_.load() * 7 + measured) / 8;
+
+  if (!push_device_) {
+    // Everything the output has taken from us minus what's still in its buffer has been heard
+    qint64 played = output_->processedUSecs() - output_->format().durationForBytes(queued);
+
+    if (played > 0) {
+      QElapsedTimer now;
+      now.start();
+
+      QMutexLocker locker(&clock_lock_);
+      clock_played_usecs_ = played;
+      clock_sampled_at_ = now.msecsSinceReference();
+      clock_valid_ = true;
+    }
+  }
+}
+
 void AudioOutputManager::OutputStateChanged(QAudio::State state)
 {
   qDebug() << state << output_->error();
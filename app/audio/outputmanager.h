@@ -43,9 +43,38 @@ public:
   // Thread-safe
   void Push(const QByteArray &samples);
 
+  /**
+   * @brief Time in milliseconds between samples being read from the device and being heard
+   *
+   * Measured from how full the output's buffer is, smoothed over recent notifications. Thread-safe.
+   */
+  int GetLatency() const;
+
+  /**
+   * @brief Get how much of the pull device has actually been heard
+   *
+   * `played_usecs` is the duration played since the device started, measured at
+   * `sampled_at_msecs` on the monotonic clock (see QElapsedTimer::msecsSinceReference()). Returns
+   * FALSE if nothing is playing from a pull device. Thread-safe.
+   */
+  bool GetClock(qint64* played_usecs, qint64* sampled_at_msecs) const;
+
+  /**
+   * @brief Levels of everything played from a pull device, thread-safe
+   */
+  const AudioLevelRing& GetLevels() const
+  {
+    return device_proxy_.levels();
+  }
+
 public slots:
-  // Queued
-  void SetOutputDevice(QAudioDeviceInfo info, QAudioFormat format);
+  /**
+   * @brief Open an output device
+   *
+   * `buffer_ms` sets the size of the output's buffer. Smaller is lower latency but more prone to
+   * dropouts. Queued.
+   */
+  void SetOutputDevice(QAudioDeviceInfo info, QAudioFormat format, int buffer_ms);
 
   /**
    * @brief Connect a QIODevice (e.g. QFile) to start sending to the audio output
@@ -77,9 +106,25 @@ private:
 
   AudioOutputDeviceProxy device_proxy_;
 
+  QAtomicInt latency_;
+
+  void InvalidateClock();
+
+  mutable QMutex clock_lock_;
+  bool clock_valid_;
+  qint64 clock_played_usecs_;
+  qint64 clock_sampled_at_;
+
+  /**
+   * @brief How much further ahead than the output buffer the pull device is prefetched
+   */
+  static const int kPrefetchBufferMultiple;
+
 private slots:
   void PushMoreSamples();
 
+  void UpdateLatency();
+
   void OutputStateChanged(QAudio::State state);
 
 };
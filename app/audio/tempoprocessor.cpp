@@ -20,24 +20,31 @@
 
 #include "tempoprocessor.h"
 
-extern "C" {
-#include <libavfilter/buffersink.h>
-#include <libavfilter/buffersrc.h>
-#include <libavutil/opt.h>
-}
-
+#include <algorithm>
+#include <cstring>
 #include <QDebug>
+#include <QtMath>
 
-#include "common/ffmpegutils.h"
+#include "codec/samplekernels.h"
 
 namespace olive {
 
+const double TempoProcessor::kGrainLength = 0.04;
+const double TempoProcessor::kSearchRadius = 0.01;
+
 TempoProcessor::TempoProcessor() :
-  filter_graph_(nullptr),
-  buffersrc_ctx_(nullptr),
-  buffersink_ctx_(nullptr),
-  processed_frame_(nullptr),
-  open_(false)
+  channels_(0),
+  grain_size_(0),
+  hop_size_(0),
+  search_radius_(0),
+  input_start_(0),
+  input_end_(0),
+  analysis_position_(0),
+  last_grain_(-1),
+  output_index_(0),
+  speed_(1.0),
+  open_(false),
+  flushed_(false)
 {
 
 }
@@ -58,86 +65,36 @@ bool TempoProcessor::Open(const AudioParams &params, const double& speed)
     return true;
   }
 
-  params_ = params;
-  speed_ = speed;
-
-  // Create AVFilterGraph instance
-  filter_graph_ = avfilter_graph_alloc();
-  if (!filter_graph_) {
-    qCritical() << "Failed to create AVFilterGraph";
-    Close();
+  if (params.format() != AudioParams::kFormatFloat32 || params.channel_count() <= 0) {
+    qCritical() << "TempoProcessor only supports float audio";
     return false;
   }
 
-  // Set up audio buffer args
-  char filter_args[200];
-  snprintf(filter_args, 200, "time_base=%d/%d:sample_rate=%d:sample_fmt=%d:channel_layout=0x%" PRIx64,
-           1,
-           params_.sample_rate(),
-           params_.sample_rate(),
-           FFmpegUtils::GetFFmpegSampleFormat(params_.format()),
-           params.channel_layout());
-
-  // Create buffer and buffersink
-  if (avfilter_graph_create_filter(&buffersrc_ctx_, avfilter_get_by_name("abuffer"), "in", filter_args, nullptr, filter_graph_) < 0) {
-    qCritical() << "Failed to create audio buffer source";
-    Close();
-    return false;
-  }
-
-  if (avfilter_graph_create_filter(&buffersink_ctx_, avfilter_get_by_name("abuffersink"), "out", nullptr, nullptr, filter_graph_) < 0) {
-    qCritical() << "Failed to create audio buffer sink";
-    Close();
-    return false;
-  }
-
-  // Create audio tempo filters: FFmpeg's atempo can only be set between 0.5 and 2.0. If the requested speed is outside
-  // those boundaries, we need to daisychain more than one together.
-  double base = (speed_ > 1.0) ? 2.0 : 0.5;
-  double speed_log = log(speed_) / log(base);
-
-  // This is the number of how many 0.5 or 2.0 tempos we need to daisychain
-  int whole = qFloor(speed_log);
-
-  // Set speed_log to the remainder
-  speed_log -= whole;
-
-  AVFilterContext* previous_filter = buffersrc_ctx_;
-
-  for (int i=0;i<=whole;i++) {
-    double filter_tempo = (i == whole) ? qPow(base, speed_log) : base;
-
-    if (qFuzzyCompare(filter_tempo, 1.0)) {
-      // This filter would do nothing
-      continue;
-    }
+  params_ = params;
+  channels_ = params.channel_count();
+  speed_ = speed;
 
-    previous_filter = CreateTempoFilter(filter_graph_,
-                                        previous_filter,
-                                        filter_tempo);
+  hop_size_ = qMax(1, qRound(params.sample_rate() * kGrainLength * 0.5));
+  grain_size_ = hop_size_ * 2;
+  search_radius_ = qRound(params.sample_rate() * kSearchRadius);
 
-    if (!previous_filter) {
-      qCritical() << "Failed to create audio tempo filter";
-      Close();
-      return false;
-    }
+  // Periodic Hann window, which sums to exactly one at an overlap of half its length
+  window_.resize(grain_size_);
+  for (int i=0; i<grain_size_; i++) {
+    window_[i] = static_cast<float>(0.5 - 0.5 * qCos(2.0 * M_PI * i / grain_size_));
   }
 
-  // Link the last filter to the buffersink
-  if (avfilter_link(previous_filter, 0, buffersink_ctx_, 0) != 0) {
-    qCritical() << "Failed to link final filter and buffer sink";
-    Close();
-    return false;
-  }
+  input_ = QVector< QVector<float> >(channels_);
+  overlap_ = QVector< QVector<float> >(channels_, QVector<float>(grain_size_, 0.0f));
+  mix_.clear();
 
-  // Config graph
-  if (avfilter_graph_config(filter_graph_, nullptr) < 0) {
-    qCritical() << "Failed to configure filter graph";
-    Close();
-    return false;
-  }
+  input_start_ = 0;
+  input_end_ = 0;
+  analysis_position_ = 0;
+  last_grain_ = -1;
 
-  timestamp_ = 0;
+  output_.clear();
+  output_index_ = 0;
 
   open_ = true;
 
@@ -146,6 +103,11 @@ bool TempoProcessor::Open(const AudioParams &params, const double& speed)
   return true;
 }
 
+void TempoProcessor::SetSpeed(const double &speed)
+{
+  speed_ = speed;
+}
+
 void TempoProcessor::Push(const char *data, int length)
 {
   if (flushed_) {
@@ -155,87 +117,65 @@ void TempoProcessor::Push(const char *data, int length)
     return;
   }
 
-  AVFrame* src_frame;
+  QVector<float*> planes(channels_);
 
   if (length == 0) {
-    // No audio data, flush the last out of the filter graph
-    src_frame = nullptr;
-    flushed_ = true;
-  } else {
-    src_frame = av_frame_alloc();
+    // Pad with silence so the last grains have something to read, input_end_ still marks where
+    // the real samples stop
+    int padding = grain_size_ + search_radius_ * 2;
 
-    if (!src_frame) {
-      qCritical() << "Failed to allocate source frame";
-      return;
+    for (int c=0; c<channels_; c++) {
+      input_[c].resize(input_[c].size() + padding);
+      std::fill(input_[c].end() - padding, input_[c].end(), 0.0f);
     }
 
-    // Allocate a buffer for the number of samples we got
-    src_frame->sample_rate = params_.sample_rate();
-    src_frame->format = FFmpegUtils::GetFFmpegSampleFormat(params_.format());
-    src_frame->channel_layout = params_.channel_layout();
-    src_frame->nb_samples = params_.bytes_to_samples(length);
-    src_frame->pts = timestamp_;
-    timestamp_ += src_frame->nb_samples;
-
-    if (av_frame_get_buffer(src_frame, 0) < 0) {
-      qCritical() << "Failed to allocate buffer for source frame";
-      av_frame_free(&src_frame);
-      return;
-    }
+    mix_.resize(mix_.size() + padding);
+    std::fill(mix_.end() - padding, mix_.end(), 0.0f);
 
-    // Copy buffer from data array to frame
-    memcpy(src_frame->data[0], data, static_cast<size_t>(length));
+    flushed_ = true;
+    return;
   }
 
-  int ret = av_buffersrc_add_frame_flags(buffersrc_ctx_, src_frame, AV_BUFFERSRC_FLAG_KEEP_REF);
+  int count = params_.bytes_to_samples(length);
+  int old_size = mix_.size();
 
-  if (ret < 0) {
-    qCritical() << "Failed to feed buffer source" << ret;
+  for (int c=0; c<channels_; c++) {
+    input_[c].resize(old_size + count);
+    planes[c] = input_[c].data() + old_size;
   }
 
-  if (src_frame) {
-    av_frame_free(&src_frame);
+  SampleKernels::Deinterleave(reinterpret_cast<const float*>(data), channels_, count, planes.data());
+
+  mix_.resize(old_size + count);
+  float* mix = mix_.data() + old_size;
+
+  memcpy(mix, planes[0], static_cast<size_t>(count) * sizeof(float));
+  for (int c=1; c<channels_; c++) {
+    for (int i=0; i<count; i++) {
+      mix[i] += planes[c][i];
+    }
   }
+
+  input_end_ += count;
 }
 
 int TempoProcessor::Pull(char *data, int max_length)
 {
-  if (!processed_frame_) {
-    processed_frame_ = av_frame_alloc();
-
-    // Try to pull samples from the buffersink
-    int ret = av_buffersink_get_frame(buffersink_ctx_, processed_frame_);
-
-    if (ret < 0) {
-      // We couldn't pull for some reason, if the error was EAGAIN, we just need to send more samples. Otherwise the
-      // error might be fatal...
-      if (ret != AVERROR(EAGAIN)) {
-        qCritical() << "Failed to pull from buffersink" << ret;
-      }
-
-      av_frame_free(&processed_frame_);
+  while (output_index_ == output_.size()) {
+    output_.clear();
+    output_index_ = 0;
 
+    if (!ProcessGrain()) {
       return 0;
     }
-
-    processed_frame_byte_index_ = 0;
-    processed_frame_max_bytes_ = params_.samples_to_bytes(processed_frame_->nb_samples);
   }
 
   // Determine how many bytes we should copy into the data array
-  int copy_length = qMin(max_length, processed_frame_max_bytes_ - processed_frame_byte_index_);
+  int copy_length = qMin(max_length, output_.size() - output_index_);
 
-  // Copy the bytes
-  memcpy(data, processed_frame_->data[0] + processed_frame_byte_index_, static_cast<size_t>(copy_length));
+  memcpy(data, output_.constData() + output_index_, static_cast<size_t>(copy_length));
 
-  // Add the copied amount to the current index
-  processed_frame_byte_index_ += copy_length;
-
-  // If the index has reached the limit of this processed frame, we can dispose of the frame now
-  if (processed_frame_byte_index_ == processed_frame_max_bytes_) {
-    av_frame_free(&processed_frame_);
-    processed_frame_ = nullptr;
-  }
+  output_index_ += copy_length;
 
   return copy_length;
 }
@@ -244,34 +184,124 @@ void TempoProcessor::Close()
 {
   open_ = false;
 
-  if (filter_graph_) {
-    avfilter_graph_free(&filter_graph_);
-    filter_graph_ = nullptr;
+  input_.clear();
+  mix_.clear();
+  overlap_.clear();
+  output_.clear();
+  output_index_ = 0;
+}
+
+bool TempoProcessor::ProcessGrain()
+{
+  if (!open_) {
+    return false;
   }
 
-  if (processed_frame_) {
-    av_frame_free(&processed_frame_);
-    processed_frame_ = nullptr;
+  qint64 target = qRound64(analysis_position_);
+
+  if (flushed_ && target >= input_end_) {
+    if (last_grain_ >= 0) {
+      // Let the last grain fade out, and that's everything
+      EmitOverlap(hop_size_);
+      last_grain_ = -1;
+      return true;
+    }
+
+    return false;
   }
 
-  buffersrc_ctx_ = nullptr;
-  buffersink_ctx_ = nullptr;
+  // The search compares against the samples that naturally followed the last grain
+  qint64 natural = last_grain_ + hop_size_;
+  qint64 needed = qMax(target + search_radius_ + grain_size_, natural + hop_size_);
+
+  if (needed > input_start_ + mix_.size()) {
+    return false;
+  }
+
+  qint64 grain = (last_grain_ < 0) ? target : FindBestGrain(target, natural);
+  int offset = static_cast<int>(grain - input_start_);
+
+  for (int c=0; c<channels_; c++) {
+    const float* in = input_.at(c).constData() + offset;
+    float* out = overlap_[c].data();
+    const float* w = window_.constData();
+
+    for (int i=0; i<grain_size_; i++) {
+      out[i] += in[i] * w[i];
+    }
+  }
+
+  EmitOverlap(hop_size_);
+
+  last_grain_ = grain;
+  analysis_position_ += hop_size_ * speed_;
+
+  // Drop input that neither the next grain nor its search can reach
+  qint64 keep_from = qMin(qRound64(analysis_position_) - search_radius_, last_grain_ + hop_size_);
+  int discard = static_cast<int>(qBound(qint64(0), keep_from - input_start_, qint64(mix_.size())));
+
+  if (discard > 0) {
+    for (int c=0; c<channels_; c++) {
+      input_[c].remove(0, discard);
+    }
+    mix_.remove(0, discard);
+    input_start_ += discard;
+  }
+
+  return true;
 }
 
-AVFilterContext *TempoProcessor::CreateTempoFilter(AVFilterGraph* graph, AVFilterContext* link, const double &tempo)
+qint64 TempoProcessor::FindBestGrain(qint64 target, qint64 natural) const
 {
-  // Set up tempo param, which is taken as a C string
-  char speed_param[20];
-  snprintf(speed_param, 20, "%f", tempo);
+  qint64 first = qMax(input_start_, target - search_radius_);
+  qint64 last = target + search_radius_;
+
+  const float* reference = mix_.constData() + (natural - input_start_);
+  const float* candidates = mix_.constData() + (first - input_start_);
+  int overlap = hop_size_;
+
+  // Energy of each candidate is kept as a running sum rather than recomputed
+  float energy = SampleKernels::DotProduct(candidates, candidates, overlap);
+
+  qint64 best = target;
+  float best_score = -1.0f;
+
+  for (qint64 k=first; k<=last; k++) {
+    const float* c = candidates + (k - first);
+
+    if (k > first) {
+      energy += c[overlap - 1] * c[overlap - 1] - c[-1] * c[-1];
+    }
+
+    float correlation = SampleKernels::DotProduct(c, reference, overlap);
+    float score = correlation / static_cast<float>(qSqrt(qMax(energy, 1e-9f)));
+
+    if (score > best_score) {
+      best_score = score;
+      best = k;
+    }
+  }
 
-  AVFilterContext* tempo_ctx = nullptr;
+  return best;
+}
 
-  if (avfilter_graph_create_filter(&tempo_ctx, avfilter_get_by_name("atempo"), "atempo", speed_param, nullptr, graph) >= 0
-      && avfilter_link(link, 0, tempo_ctx, 0) == 0) {
-    return tempo_ctx;
+void TempoProcessor::EmitOverlap(int count)
+{
+  QVector<const float*> planes(channels_);
+  for (int c=0; c<channels_; c++) {
+    planes[c] = overlap_.at(c).constData();
   }
 
-  return nullptr;
+  int old_size = output_.size();
+  output_.resize(old_size + params_.samples_to_bytes(count));
+
+  SampleKernels::Interleave(planes.data(), channels_, count, reinterpret_cast<float*>(output_.data() + old_size));
+
+  for (int c=0; c<channels_; c++) {
+    float* o = overlap_[c].data();
+    memmove(o, o + count, static_cast<size_t>(grain_size_ - count) * sizeof(float));
+    std::fill(o + grain_size_ - count, o + grain_size_, 0.0f);
+  }
 }
 
 }
@@ -21,22 +21,26 @@
 #ifndef TEMPOPROCESSOR_H
 #define TEMPOPROCESSOR_H
 
-#ifdef __MINGW32__
-#ifndef __USE_MINGW_ANSI_STDIO
-#define __USE_MINGW_ANSI_STDIO
-#endif
-#endif
-
-#include <inttypes.h>
-
-extern "C" {
-#include <libavfilter/avfilter.h>
-}
+#include <QByteArray>
+#include <QVector>
 
 #include "render/audioparams.h"
 
 namespace olive {
 
+/**
+ * @brief Changes the speed of audio without changing its pitch
+ *
+ * This is WSOLA (waveform similarity overlap-add): the output is built from overlapping
+ * Hann-windowed grains read from the input at `speed` times the rate they're written. Each grain
+ * is moved by up to kSearchRadius seconds to where it best continues the previous grain, measured
+ * by normalized cross-correlation of a mono mix, so the overlaps line up in phase and don't
+ * smear or click. Samples are processed as planar floats with SampleKernels.
+ *
+ * Since grains always overlap, SetSpeed() can change speed at any time without a gap.
+ *
+ * Only kFormatFloat32 is supported, which is what playback uses.
+ */
 class TempoProcessor
 {
 public:
@@ -48,28 +52,81 @@ public:
 
   bool Open(const AudioParams& params, const double &speed);
 
+  /**
+   * @brief Change speed from the next grain on without reopening
+   */
+  void SetSpeed(const double& speed);
+
+  /**
+   * @brief Add interleaved samples to the input, a `length` of 0 flushes the rest out
+   */
   void Push(const char *data, int length);
 
+  /**
+   * @brief Read up to `max_length` bytes of processed samples, returns 0 if more need to be pushed
+   */
   int Pull(char* data, int max_length);
 
   void Close();
 
 private:
-  static AVFilterContext* CreateTempoFilter(AVFilterGraph *graph, AVFilterContext *link, const double& tempo);
+  /**
+   * @brief Add the next grain to the output, returns FALSE if there isn't enough input for it yet
+   */
+  bool ProcessGrain();
 
-  AVFilterGraph* filter_graph_;
+  /**
+   * @brief Find the grain start within kSearchRadius of `target` that best continues from `natural`
+   */
+  qint64 FindBestGrain(qint64 target, qint64 natural) const;
 
-  AVFilterContext* buffersrc_ctx_;
+  /**
+   * @brief Move the first `count` finished samples of the overlap buffer to the output
+   */
+  void EmitOverlap(int count);
 
-  AVFilterContext* buffersink_ctx_;
+  /// Length of each grain in seconds
+  static const double kGrainLength;
 
-  AVFrame* processed_frame_;
-  int processed_frame_byte_index_;
-  int processed_frame_max_bytes_;
+  /// How far a grain may move from where the speed puts it to line up with the previous one
+  static const double kSearchRadius;
 
   AudioParams params_;
 
-  int64_t timestamp_;
+  int channels_;
+
+  int grain_size_;
+
+  /// Distance between grains in the output, half a grain so the windows sum to one
+  int hop_size_;
+
+  int search_radius_;
+
+  QVector<float> window_;
+
+  /// Planar input starting at sample `input_start_`
+  QVector< QVector<float> > input_;
+
+  /// Mono mix of `input_` that grains are compared on
+  QVector<float> mix_;
+
+  qint64 input_start_;
+
+  /// Sample after the last one pushed, excluding the silence padded on when flushing
+  qint64 input_end_;
+
+  /// Where the next grain would start at the current speed
+  double analysis_position_;
+
+  /// Where the last grain actually started, or -1 if there hasn't been one
+  qint64 last_grain_;
+
+  /// Windowed grains being summed, the first `hop_size_` samples are finished after each grain
+  QVector< QVector<float> > overlap_;
+
+  /// Interleaved finished samples waiting to be pulled
+  QByteArray output_;
+  int output_index_;
 
   double speed_;
 
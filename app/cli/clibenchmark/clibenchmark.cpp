@@ -0,0 +1,498 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "clibenchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTemporaryDir>
+
+#include "codec/decoder.h"
+#include "common/timecodefunctions.h"
+#include "node/traverser.h"
+#include "project/item/footage/footage.h"
+#include "project/item/footage/videostream.h"
+#include "render/framepack.h"
+#include "render/rendermanager.h"
+#include "task/export/export.h"
+#include "task/project/load/load.h"
+
+namespace olive {
+
+const int CLIBenchmark::kDecodeFrameCount = 240;
+const int CLIBenchmark::kRenderFrameCount = 120;
+const int CLIBenchmark::kHashFrameCount = 100000;
+const int CLIBenchmark::kCacheIOFrameCount = 32;
+const int CLIBenchmark::kAudioLength = 60;
+
+/**
+ * @brief Summarize a list of durations in milliseconds
+ */
+static QJsonObject GetStatistics(QVector<double> ms)
+{
+  QJsonObject o;
+
+  if (ms.isEmpty()) {
+    return o;
+  }
+
+  std::sort(ms.begin(), ms.end());
+
+  double total = 0;
+  foreach (double d, ms) {
+    total += d;
+  }
+
+  o.insert(QStringLiteral("count"), ms.size());
+  o.insert(QStringLiteral("mean"), total / ms.size());
+  o.insert(QStringLiteral("median"), ms.at(ms.size() / 2));
+  o.insert(QStringLiteral("p95"), ms.at(qMin(ms.size() - 1, ms.size() * 95 / 100)));
+  o.insert(QStringLiteral("max"), ms.last());
+
+  return o;
+}
+
+CLIBenchmark::CLIBenchmark(const QString &project_filename) :
+  project_filename_(project_filename)
+{
+}
+
+int CLIBenchmark::Run(const QString &output_filename)
+{
+  if (project_filename_.isEmpty() || !QFileInfo::exists(project_filename_)) {
+    qCritical() << "Benchmark requires an existing project file";
+    return 1;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+
+  ProjectLoadTask load_task(project_filename_);
+
+  if (!load_task.Start()) {
+    qCritical() << "Failed to load project:" << load_task.GetError();
+    return 1;
+  }
+
+  Project* project = load_task.GetLoadedProject();
+
+  QJsonObject results;
+  results.insert(QStringLiteral("version"), QCoreApplication::applicationVersion());
+  results.insert(QStringLiteral("project"), project_filename_);
+  results.insert(QStringLiteral("load"), static_cast<double>(timer.nsecsElapsed()) / 1000000.0);
+
+  qInfo() << "Benchmarking decoders";
+  results.insert(QStringLiteral("decode"), BenchmarkDecoding(project));
+
+  QJsonArray sequences;
+
+  foreach (Item* item, project->get_items_of_type(Item::kSequence)) {
+    Sequence* sequence = static_cast<Sequence*>(item);
+
+    if (sequence->viewer_output()->GetLength().isNull()) {
+      continue;
+    }
+
+    qInfo() << "Benchmarking sequence" << sequence->name();
+
+    QJsonObject s;
+    FramePtr sample_frame;
+
+    s.insert(QStringLiteral("name"), sequence->name());
+    s.insert(QStringLiteral("render"), BenchmarkRendering(sequence, &sample_frame));
+    s.insert(QStringLiteral("precision"), BenchmarkPrecision(sequence));
+    s.insert(QStringLiteral("hash"), BenchmarkHashing(sequence));
+    s.insert(QStringLiteral("cache"), BenchmarkCacheIO(sample_frame));
+    s.insert(QStringLiteral("audio"), BenchmarkAudio(sequence));
+
+    sequences.append(s);
+  }
+
+  results.insert(QStringLiteral("sequences"), sequences);
+
+  delete project;
+
+  QByteArray json = QJsonDocument(results).toJson();
+
+  if (output_filename.isEmpty()) {
+    fwrite(json.constData(), 1, json.size(), stdout);
+    fflush(stdout);
+  } else {
+    QFile f(output_filename);
+
+    if (!f.open(QFile::WriteOnly) || f.write(json) != json.size()) {
+      qCritical() << "Failed to write benchmark results to" << output_filename;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+QJsonObject CLIBenchmark::BenchmarkDecoding(Project *project)
+{
+  QJsonArray streams;
+
+  struct Total {
+    qint64 frames;
+    qint64 nanoseconds;
+  };
+
+  QMap<QString, Total> totals;
+
+  foreach (Item* item, project->get_items_of_type(Item::kFootage)) {
+    Footage* footage = static_cast<Footage*>(item);
+
+    foreach (Stream* stream, footage->streams()) {
+      if (stream->type() != Stream::kVideo) {
+        continue;
+      }
+
+      VideoStream* video = static_cast<VideoStream*>(stream);
+
+      // Stills aren't decoded per frame so they'd only skew the totals
+      if (video->video_type() == VideoStream::kVideoTypeStill || video->frame_rate().isNull()) {
+        continue;
+      }
+
+      DecoderPtr decoder = Decoder::CreateFromID(footage->decoder());
+
+      if (!decoder || !decoder->Open(stream)) {
+        qWarning() << "Failed to open" << footage->filename() << "for benchmarking";
+        continue;
+      }
+
+      // Decode sequentially like playback would
+      rational frame_length = rational(1) / video->frame_rate();
+      rational stream_length = Timecode::timestamp_to_time(stream->duration(), stream->timebase());
+      int frames = 0;
+
+      QElapsedTimer timer;
+      timer.start();
+
+      for (rational t; frames < kDecodeFrameCount && t < stream_length; t += frame_length) {
+        if (!decoder->RetrieveVideo(t, 1)) {
+          break;
+        }
+
+        frames++;
+      }
+
+      qint64 elapsed = timer.nsecsElapsed();
+
+      decoder->Close();
+
+      if (!frames) {
+        continue;
+      }
+
+      QString format = QStringLiteral("%1/%2").arg(footage->decoder(), QFileInfo(footage->filename()).suffix().toLower());
+
+      QJsonObject s;
+      s.insert(QStringLiteral("filename"), footage->filename());
+      s.insert(QStringLiteral("index"), stream->index());
+      s.insert(QStringLiteral("format"), format);
+      s.insert(QStringLiteral("width"), video->width());
+      s.insert(QStringLiteral("height"), video->height());
+      s.insert(QStringLiteral("frames"), frames);
+      s.insert(QStringLiteral("fps"), frames / (static_cast<double>(elapsed) / 1e9));
+      streams.append(s);
+
+      Total& total = totals[format];
+      total.frames += frames;
+      total.nanoseconds += elapsed;
+    }
+  }
+
+  QJsonObject formats;
+
+  for (auto it=totals.cbegin(); it!=totals.cend(); it++) {
+    formats.insert(it.key(), it.value().frames / (static_cast<double>(it.value().nanoseconds) / 1e9));
+  }
+
+  QJsonObject o;
+  o.insert(QStringLiteral("streams"), streams);
+  o.insert(QStringLiteral("fps_per_format"), formats);
+  return o;
+}
+
+QJsonObject CLIBenchmark::BenchmarkRendering(Sequence *sequence, FramePtr *sample_frame)
+{
+  ViewerOutput* viewer = sequence->viewer_output();
+  const rational& timebase = viewer->video_params().time_base();
+
+  int64_t length_ts = Timecode::time_to_timestamp(viewer->GetLength(), timebase);
+  int frame_count = static_cast<int>(qMin(static_cast<int64_t>(kRenderFrameCount), length_ts));
+
+  QJsonObject o;
+
+  NodeTraverser::TakeTimings();
+  NodeTraverser::SetTimingEnabled(true);
+
+  // Latency, one frame at a time like scrubbing
+  QVector<double> latencies;
+
+  for (int i=0; i<frame_count; i++) {
+    QElapsedTimer timer;
+    timer.start();
+
+    RenderTicketPtr ticket = RenderManager::instance()->RenderFrame(viewer, sequence->project()->color_manager(),
+                                                                    Timecode::timestamp_to_time(i, timebase),
+                                                                    RenderMode::kOnline, nullptr,
+                                                                    RenderManager::kPriorityInteractive);
+    ticket->WaitForFinished();
+
+    latencies.append(static_cast<double>(timer.nsecsElapsed()) / 1000000.0);
+
+    if (i == 0) {
+      *sample_frame = ticket->Get().value<FramePtr>();
+    }
+  }
+
+  NodeTraverser::SetTimingEnabled(false);
+
+  QHash<QString, NodeTraverser::NodeTiming> timings = NodeTraverser::TakeTimings();
+
+  // Throughput, every frame at once like an export
+  QElapsedTimer timer;
+  timer.start();
+
+  QVector<RenderTicketPtr> tickets(frame_count);
+
+  for (int i=0; i<frame_count; i++) {
+    tickets[i] = RenderManager::instance()->RenderFrame(viewer, sequence->project()->color_manager(),
+                                                        Timecode::timestamp_to_time(i, timebase),
+                                                        RenderMode::kOnline);
+  }
+
+  foreach (RenderTicketPtr ticket, tickets) {
+    ticket->WaitForFinished();
+  }
+
+  double throughput_secs = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+
+  QJsonObject nodes;
+
+  for (auto it=timings.cbegin(); it!=timings.cend(); it++) {
+    QJsonObject n;
+    n.insert(QStringLiteral("count"), it.value().count);
+    n.insert(QStringLiteral("total"), static_cast<double>(it.value().nanoseconds) / 1000000.0);
+    n.insert(QStringLiteral("mean"), static_cast<double>(it.value().nanoseconds) / 1000000.0 / it.value().count);
+    nodes.insert(it.key(), n);
+  }
+
+  o.insert(QStringLiteral("width"), viewer->video_params().effective_width());
+  o.insert(QStringLiteral("height"), viewer->video_params().effective_height());
+  o.insert(QStringLiteral("latency"), GetStatistics(latencies));
+  o.insert(QStringLiteral("fps"), (throughput_secs > 0) ? frame_count / throughput_secs : 0.0);
+  o.insert(QStringLiteral("nodes"), nodes);
+
+  return o;
+}
+
+QJsonObject CLIBenchmark::BenchmarkPrecision(Sequence *sequence)
+{
+  ViewerOutput* viewer = sequence->viewer_output();
+  ColorManager* color_manager = sequence->project()->color_manager();
+  const rational& timebase = viewer->video_params().time_base();
+
+  int64_t length_ts = Timecode::time_to_timestamp(viewer->GetLength(), timebase);
+  int frame_count = static_cast<int>(qMin(static_cast<int64_t>(kRenderFrameCount), length_ts));
+
+  // Both are downloaded at 8 bits like a typical delivery, so differences are in output code values
+  static const VideoParams::Format kFormats[] = {VideoParams::kFormatFloat32, VideoParams::kFormatFloat16};
+
+  QVector<FramePtr> full_frames(frame_count);
+  double fps[2] = {0.0, 0.0};
+  int max_difference = 0;
+
+  for (int pass=0; pass<2; pass++) {
+    VideoParams params = viewer->video_params();
+    params.set_format(kFormats[pass]);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<RenderTicketPtr> tickets(frame_count);
+
+    for (int i=0; i<frame_count; i++) {
+      tickets[i] = RenderManager::instance()->RenderFrame(viewer, color_manager,
+                                                          Timecode::timestamp_to_time(i, timebase),
+                                                          RenderMode::kOnline, params,
+                                                          viewer->audio_params(), QSize(0, 0),
+                                                          QMatrix4x4(), VideoParams::kFormatUnsigned8,
+                                                          nullptr);
+    }
+
+    foreach (RenderTicketPtr ticket, tickets) {
+      ticket->WaitForFinished();
+    }
+
+    double secs = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+    fps[pass] = (secs > 0) ? frame_count / secs : 0.0;
+
+    for (int i=0; i<frame_count; i++) {
+      FramePtr frame = tickets.at(i)->Get().value<FramePtr>();
+
+      if (pass == 0) {
+        full_frames[i] = frame;
+        continue;
+      }
+
+      FramePtr full = full_frames.at(i);
+
+      if (!frame || !full
+          || frame->width() != full->width()
+          || frame->height() != full->height()
+          || frame->channel_count() != full->channel_count()) {
+        continue;
+      }
+
+      int row_bytes = frame->width() * frame->channel_count();
+
+      for (int y=0; y<frame->height(); y++) {
+        const uchar* a = reinterpret_cast<const uchar*>(full->const_data() + y * full->linesize_bytes());
+        const uchar* b = reinterpret_cast<const uchar*>(frame->const_data() + y * frame->linesize_bytes());
+
+        for (int x=0; x<row_bytes; x++) {
+          max_difference = qMax(max_difference, qAbs(int(a[x]) - int(b[x])));
+        }
+      }
+    }
+  }
+
+  QJsonObject o;
+
+  o.insert(QStringLiteral("full_fps"), fps[0]);
+  o.insert(QStringLiteral("half_fps"), fps[1]);
+  o.insert(QStringLiteral("speedup"), (fps[0] > 0) ? fps[1] / fps[0] : 0.0);
+  o.insert(QStringLiteral("max_difference"), max_difference);
+  o.insert(QStringLiteral("reducible"), ExportTask::CanReducePrecision(viewer, 8));
+
+  return o;
+}
+
+QJsonObject CLIBenchmark::BenchmarkHashing(Sequence *sequence)
+{
+  ViewerOutput* viewer = sequence->viewer_output();
+  const VideoParams& params = viewer->video_params();
+
+  int64_t length_ts = Timecode::time_to_timestamp(viewer->GetLength(), params.time_base());
+  int frame_count = static_cast<int>(qMin(static_cast<int64_t>(kHashFrameCount), length_ts));
+
+  QElapsedTimer timer;
+  timer.start();
+
+  for (int i=0; i<frame_count; i++) {
+    RenderManager::Hash(viewer, params, Timecode::timestamp_to_time(i, params.time_base()));
+  }
+
+  double secs = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+
+  QJsonObject o;
+  o.insert(QStringLiteral("frames"), frame_count);
+  o.insert(QStringLiteral("hashes_per_second"), (secs > 0) ? frame_count / secs : 0.0);
+  return o;
+}
+
+QJsonObject CLIBenchmark::BenchmarkCacheIO(FramePtr frame)
+{
+  QJsonObject o;
+
+  if (!frame) {
+    return o;
+  }
+
+  QTemporaryDir dir;
+
+  if (!dir.isValid()) {
+    qWarning() << "Failed to create temporary cache folder";
+    return o;
+  }
+
+  FramePack* pack = FramePack::Get(dir.path());
+
+  QVector<QByteArray> hashes(kCacheIOFrameCount);
+  for (int i=0; i<kCacheIOFrameCount; i++) {
+    hashes[i] = QCryptographicHash::hash(QByteArray::number(i), QCryptographicHash::Sha1);
+  }
+
+  double frame_mb = static_cast<double>(frame->allocated_size()) / 1048576.0;
+  qint64 written_bytes = 0;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  foreach (const QByteArray& hash, hashes) {
+    written_bytes += pack->Write(hash, frame->data(), frame->video_params(), frame->linesize_bytes());
+  }
+
+  double write_secs = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+
+  timer.restart();
+
+  foreach (const QByteArray& hash, hashes) {
+    pack->Read(hash);
+  }
+
+  double read_secs = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+
+  // Don't leave the temporary pack open once its folder is deleted
+  FramePack::CloseAll();
+
+  // Rates are of uncompressed frame data so they're comparable between compression settings
+  o.insert(QStringLiteral("frames"), kCacheIOFrameCount);
+  o.insert(QStringLiteral("compression_ratio"), (written_bytes > 0) ? frame_mb * 1048576.0 * kCacheIOFrameCount / written_bytes : 0.0);
+  o.insert(QStringLiteral("write_mb_per_second"), (write_secs > 0) ? frame_mb * kCacheIOFrameCount / write_secs : 0.0);
+  o.insert(QStringLiteral("read_mb_per_second"), (read_secs > 0) ? frame_mb * kCacheIOFrameCount / read_secs : 0.0);
+  return o;
+}
+
+QJsonObject CLIBenchmark::BenchmarkAudio(Sequence *sequence)
+{
+  ViewerOutput* viewer = sequence->viewer_output();
+
+  rational length = qMin(viewer->GetLength(), rational(kAudioLength));
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // Render in the same chunk size exports do
+  for (rational t; t<length; t+=rational(2)) {
+    RenderTicketPtr ticket = RenderManager::instance()->RenderAudio(viewer, TimeRange(t, qMin(t + rational(2), length)),
+                                                                    false, RenderManager::kPriorityBackground);
+    ticket->WaitForFinished();
+  }
+
+  double secs = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+
+  QJsonObject o;
+  o.insert(QStringLiteral("length"), length.toDouble() * 1000.0);
+  o.insert(QStringLiteral("realtime_factor"), (secs > 0) ? length.toDouble() / secs : 0.0);
+  return o;
+}
+
+}
@@ -0,0 +1,106 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef CLIBENCHMARK_H
+#define CLIBENCHMARK_H
+
+#include <QJsonObject>
+
+#include "codec/frame.h"
+#include "project/item/sequence/sequence.h"
+#include "project/project.h"
+
+namespace olive {
+
+/**
+ * @brief Measures the performance of a project's footage and sequences without a GUI
+ *
+ * Run with `--benchmark` and a project file. The project is loaded and each of the following is
+ * measured, with the results written as JSON to the file given with `--benchmark-output` (or
+ * stdout) so they can be compared between builds and machines:
+ *
+ * * Decode rate of each video stream, also totaled per decoder and file format
+ * * Latency and throughput of rendering each sequence, plus the time spent in each node type
+ * * Throughput of each sequence at full and half float intermediates and the largest 8-bit
+ *   difference between them, to check automatic export precision (see ExportParams)
+ * * Hashing throughput of each sequence
+ * * Disk cache write and read rates using frames rendered from each sequence
+ * * Real-time factor of rendering each sequence's audio
+ *
+ * All durations in the output are in milliseconds.
+ */
+class CLIBenchmark : public QObject
+{
+  Q_OBJECT
+public:
+  CLIBenchmark(const QString& project_filename);
+
+  /**
+   * @brief Run every benchmark and write the results to `output_filename`
+   *
+   * If `output_filename` is empty, results are written to stdout. Returns a process exit code.
+   */
+  int Run(const QString& output_filename);
+
+private:
+  QJsonObject BenchmarkDecoding(Project* project);
+
+  QJsonObject BenchmarkRendering(Sequence* sequence, FramePtr* sample_frame);
+
+  QJsonObject BenchmarkPrecision(Sequence* sequence);
+
+  QJsonObject BenchmarkHashing(Sequence* sequence);
+
+  QJsonObject BenchmarkCacheIO(FramePtr frame);
+
+  QJsonObject BenchmarkAudio(Sequence* sequence);
+
+  /**
+   * @brief Number of frames decoded from each video stream
+   */
+  static const int kDecodeFrameCount;
+
+  /**
+   * @brief Number of frames rendered from each sequence
+   */
+  static const int kRenderFrameCount;
+
+  /**
+   * @brief Maximum number of frames hashed from each sequence
+   */
+  static const int kHashFrameCount;
+
+  /**
+   * @brief Number of frames written to and read from the disk cache
+   */
+  static const int kCacheIOFrameCount;
+
+  /**
+   * @brief Maximum length of audio rendered from each sequence in seconds
+   */
+  static const int kAudioLength;
+
+  QString project_filename_;
+
+};
+
+}
+
+#endif // CLIBENCHMARK_H
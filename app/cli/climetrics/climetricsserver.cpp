@@ -0,0 +1,253 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "climetricsserver.h"
+
+#include <functional>
+#include <QDebug>
+#include <QHostAddress>
+
+#include "common/lockprofiler.h"
+#include "common/memoryaccounting.h"
+#include "common/memorygovernor.h"
+#include "common/metrics.h"
+#include "render/rendermanager.h"
+
+namespace olive {
+
+const qint64 CLIMetricsListener::kMaxRequestLength = 8192;
+
+namespace {
+
+QByteArray EscapeLabel(const QString& s)
+{
+  QByteArray b = s.toUtf8();
+  b.replace('\\', "\\\\");
+  b.replace('"', "\\\"");
+  b.replace('\n', "\\n");
+  return b;
+}
+
+void AppendHeader(QByteArray* out, const char* name, const char* help, const char* type)
+{
+  out->append("# HELP ").append(name).append(' ').append(help).append('\n');
+  out->append("# TYPE ").append(name).append(' ').append(type).append('\n');
+}
+
+void AppendSample(QByteArray* out, const char* name, const QByteArray& labels, double value)
+{
+  out->append(name);
+
+  if (!labels.isEmpty()) {
+    out->append('{').append(labels).append('}');
+  }
+
+  out->append(' ').append(QByteArray::number(value, 'g', 15)).append('\n');
+}
+
+}
+
+CLIMetricsServer::CLIMetricsServer() :
+  listener_(nullptr)
+{
+}
+
+CLIMetricsServer::~CLIMetricsServer()
+{
+  if (listener_) {
+    QMetaObject::invokeMethod(listener_, "deleteLater", Qt::BlockingQueuedConnection);
+    thread_.quit();
+    thread_.wait();
+  }
+}
+
+bool CLIMetricsServer::Start(int port)
+{
+  if (listener_) {
+    qWarning() << "Metrics server is already running";
+    return false;
+  }
+
+  thread_.setObjectName(QStringLiteral("Metrics"));
+  thread_.start(QThread::LowPriority);
+
+  listener_ = new CLIMetricsListener();
+  listener_->moveToThread(&thread_);
+
+  bool listening = false;
+
+  QMetaObject::invokeMethod(listener_, "Listen", Qt::BlockingQueuedConnection,
+                            Q_RETURN_ARG(bool, listening), Q_ARG(int, port));
+
+  return listening;
+}
+
+QByteArray CLIMetricsServer::GenerateReport()
+{
+  QByteArray out;
+
+  for (int i=0; i<Metrics::kCounterCount; i++) {
+    Metrics::Counter c = static_cast<Metrics::Counter>(i);
+    double scale = Metrics::IsTime(c) ? 0.000000001 : 1.0;
+
+    AppendHeader(&out, Metrics::GetName(c), Metrics::GetDescription(c), "counter");
+
+    if (Metrics::GetLabelName(c)) {
+      QMap<QString, qint64> labels = Metrics::GetLabels(c);
+
+      for (auto it=labels.cbegin(); it!=labels.cend(); it++) {
+        QByteArray label = QByteArray(Metrics::GetLabelName(c)) + "=\"" + EscapeLabel(it.key()) + '"';
+        AppendSample(&out, Metrics::GetName(c), label, it.value() * scale);
+      }
+    } else {
+      AppendSample(&out, Metrics::GetName(c), QByteArray(), Metrics::Get(c) * scale);
+    }
+  }
+
+  if (RenderManager::instance()) {
+    static const char* const priority_names[ThreadPool::kPriorityCount] = {
+      "interactive", "playback", "background", "disk_io"
+    };
+
+    AppendHeader(&out, "olive_render_queue_depth", "Render tickets waiting to be run", "gauge");
+
+    for (int i=0; i<ThreadPool::kPriorityCount; i++) {
+      int depth = RenderManager::instance()->GetQueuedTicketCount(static_cast<ThreadPool::TicketPriority>(i));
+      AppendSample(&out, "olive_render_queue_depth",
+                   QByteArray("priority=\"") + priority_names[i] + '"', depth);
+    }
+  }
+
+  AppendHeader(&out, "olive_memory_bytes", "Memory held by each subsystem", "gauge");
+
+  for (int i=0; i<MemoryAccounting::kCategoryCount; i++) {
+    MemoryAccounting::Category c = static_cast<MemoryAccounting::Category>(i);
+
+    QByteArray labels = QByteArray("category=\"") + EscapeLabel(QString::fromLatin1(MemoryAccounting::GetID(c)))
+        + "\",type=\"" + (MemoryAccounting::IsVideoMemory(c) ? "video" : "system") + '"';
+
+    AppendSample(&out, "olive_memory_bytes", labels, MemoryAccounting::Get(c));
+  }
+
+  AppendHeader(&out, "olive_memory_pool_bytes", "Memory allocated by memory pools", "gauge");
+  AppendSample(&out, "olive_memory_pool_bytes", QByteArray(), MemoryGovernor::GetUsage());
+
+  AppendHeader(&out, "olive_memory_budget_bytes", "Memory budget of the pools and caches, 0 if unlimited", "gauge");
+  AppendSample(&out, "olive_memory_budget_bytes", QByteArray(), MemoryGovernor::GetBudget());
+
+  if (LockProfiler::IsEnabled()) {
+    // One sample per lock for each of its stats
+    auto append_locks = [&out](const char* name, const char* help, const char* type,
+                               std::function<double(const LockProfiler::Stats&)> get) {
+      AppendHeader(&out, name, help, type);
+
+      for (int i=0; i<LockProfiler::kLockCount; i++) {
+        LockProfiler::Lock l = static_cast<LockProfiler::Lock>(i);
+        AppendSample(&out, name, QByteArray("lock=\"") + LockProfiler::GetName(l) + '"', get(LockProfiler::GetStats(l)));
+      }
+    };
+
+    append_locks("olive_lock_acquisitions_total", "Times each render path lock was acquired", "counter",
+                 [](const LockProfiler::Stats& s){ return double(s.acquisitions); });
+    append_locks("olive_lock_contentions_total", "Times each render path lock was already held when acquired", "counter",
+                 [](const LockProfiler::Stats& s){ return double(s.contentions); });
+    append_locks("olive_lock_wait_seconds_total", "Time spent waiting for each render path lock", "counter",
+                 [](const LockProfiler::Stats& s){ return s.wait_ns * 0.000000001; });
+    append_locks("olive_lock_hold_seconds_total", "Time each render path lock was held", "counter",
+                 [](const LockProfiler::Stats& s){ return s.hold_ns * 0.000000001; });
+    append_locks("olive_lock_max_wait_seconds", "Longest wait for each render path lock", "gauge",
+                 [](const LockProfiler::Stats& s){ return s.max_wait_ns * 0.000000001; });
+  }
+
+  AppendHeader(&out, "olive_task_progress", "Progress of running tasks between 0 and 1", "gauge");
+
+  foreach (const Metrics::Progress& p, Metrics::GetProgress()) {
+    QByteArray labels = QByteArray("id=\"") + QByteArray::number(p.id) + "\",task=\"" + EscapeLabel(p.name) + '"';
+    AppendSample(&out, "olive_task_progress", labels, p.progress);
+  }
+
+  return out;
+}
+
+CLIMetricsListener::CLIMetricsListener() :
+  server_(new QTcpServer(this))
+{
+  connect(server_, &QTcpServer::newConnection, this, &CLIMetricsListener::NewConnection);
+}
+
+bool CLIMetricsListener::Listen(int port)
+{
+  if (!server_->listen(QHostAddress::Any, static_cast<quint16>(port))) {
+    qCritical() << "Failed to start metrics server on port" << port << ":" << server_->errorString();
+    return false;
+  }
+
+  qInfo() << "Serving metrics on port" << server_->serverPort();
+  return true;
+}
+
+void CLIMetricsListener::WriteResponse(QTcpSocket *socket, const QByteArray &status, const QByteArray &body)
+{
+  QByteArray response = "HTTP/1.1 " + status + "\r\n"
+      "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+      "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+      "Connection: close\r\n"
+      "\r\n" + body;
+
+  socket->write(response);
+  socket->disconnectFromHost();
+}
+
+void CLIMetricsListener::NewConnection()
+{
+  while (QTcpSocket* socket = server_->nextPendingConnection()) {
+    connect(socket, &QTcpSocket::readyRead, this, &CLIMetricsListener::ReadRequest);
+    connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+  }
+}
+
+void CLIMetricsListener::ReadRequest()
+{
+  QTcpSocket* socket = static_cast<QTcpSocket*>(sender());
+
+  if (!socket->canReadLine()) {
+    if (socket->bytesAvailable() > kMaxRequestLength) {
+      socket->abort();
+      socket->deleteLater();
+    }
+    return;
+  }
+
+  // Only the request line matters, headers are ignored and the connection is closed after
+  // answering so there's never a second request to read
+  disconnect(socket, &QTcpSocket::readyRead, this, &CLIMetricsListener::ReadRequest);
+
+  QList<QByteArray> request = socket->readLine(kMaxRequestLength).trimmed().split(' ');
+
+  if (request.size() < 2 || request.at(0) != "GET") {
+    WriteResponse(socket, "405 Method Not Allowed", "Only GET is supported\n");
+  } else if (request.at(1) != "/metrics" && request.at(1) != "/") {
+    WriteResponse(socket, "404 Not Found", "Metrics are served at /metrics\n");
+  } else {
+    WriteResponse(socket, "200 OK", CLIMetricsServer::GenerateReport());
+  }
+}
+
+}
@@ -0,0 +1,100 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef CLIMETRICSSERVER_H
+#define CLIMETRICSSERVER_H
+
+#include <QThread>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include "common/define.h"
+
+namespace olive {
+
+class CLIMetricsListener;
+
+/**
+ * @brief Serves Metrics and MemoryAccounting over HTTP in the Prometheus text format
+ *
+ * Run headless with `--metrics-port` so render nodes can be scraped for throughput and health
+ * rather than having to read their console output. `GET /metrics` returns every counter along
+ * with render queue depths, memory usage and the progress of running tasks.
+ *
+ * Headless modes block the main thread while they render, so the server runs on its own thread.
+ */
+class CLIMetricsServer
+{
+public:
+  CLIMetricsServer();
+
+  ~CLIMetricsServer();
+
+  DISABLE_COPY_MOVE(CLIMetricsServer)
+
+  /**
+   * @brief Start listening on every interface, returns FALSE if the port couldn't be bound
+   */
+  bool Start(int port);
+
+  /**
+   * @brief Returns everything the endpoint reports in the Prometheus text exposition format
+   */
+  static QByteArray GenerateReport();
+
+private:
+  QThread thread_;
+
+  CLIMetricsListener* listener_;
+
+};
+
+/**
+ * @brief Accepts and answers connections for CLIMetricsServer on its thread
+ */
+class CLIMetricsListener : public QObject
+{
+  Q_OBJECT
+public:
+  CLIMetricsListener();
+
+public slots:
+  bool Listen(int port);
+
+private:
+  static void WriteResponse(QTcpSocket* socket, const QByteArray& status, const QByteArray& body);
+
+  /**
+   * @brief Longest request line we'll wait for before giving up on a client
+   */
+  static const qint64 kMaxRequestLength;
+
+  QTcpServer* server_;
+
+private slots:
+  void NewConnection();
+
+  void ReadRequest();
+
+};
+
+}
+
+#endif // CLIMETRICSSERVER_H
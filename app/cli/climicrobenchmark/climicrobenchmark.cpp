@@ -0,0 +1,481 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "climicrobenchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QMatrix4x4>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+
+#include "codec/samplebuffer.h"
+#include "common/memorypool.h"
+#include "common/rational.h"
+#include "common/timerange.h"
+#include "node/input.h"
+#include "node/math/math/math.h"
+#include "node/value.h"
+#include "render/rendermanager.h"
+
+namespace olive {
+
+const int CLIMicrobenchmark::kMinimumTime = 100;
+const int CLIMicrobenchmark::kRepetitions = 5;
+
+/**
+ * @brief Results are written here so the compiler can't optimize the measured work away
+ */
+static volatile double benchmark_sink = 0;
+
+int CLIMicrobenchmark::Run(const QString &output_filename)
+{
+  QJsonObject results;
+
+  qInfo() << "Benchmarking rational";
+  results.insert(QStringLiteral("rational"), BenchmarkRational());
+
+  qInfo() << "Benchmarking TimeRangeList";
+  results.insert(QStringLiteral("timerangelist"), BenchmarkTimeRangeList());
+
+  qInfo() << "Benchmarking MemoryPool";
+  results.insert(QStringLiteral("memorypool"), BenchmarkMemoryPool());
+
+  qInfo() << "Benchmarking NodeValueTable";
+  results.insert(QStringLiteral("nodevaluetable"), BenchmarkNodeValueTable());
+
+  qInfo() << "Benchmarking keyframes";
+  results.insert(QStringLiteral("keyframes"), BenchmarkKeyframes());
+
+  qInfo() << "Benchmarking hashing";
+  results.insert(QStringLiteral("hashing"), BenchmarkHashing());
+
+  qInfo() << "Benchmarking SampleBuffer";
+  results.insert(QStringLiteral("samplebuffer"), BenchmarkSampleBuffer());
+
+  QByteArray json = QJsonDocument(results).toJson();
+
+  if (output_filename.isEmpty()) {
+    fwrite(json.constData(), 1, json.size(), stdout);
+    fflush(stdout);
+  } else {
+    QFile f(output_filename);
+
+    if (!f.open(QFile::WriteOnly) || f.write(json) != json.size()) {
+      qCritical() << "Failed to write benchmark results to" << output_filename;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+QJsonObject CLIMicrobenchmark::Measure(const std::function<void (int)> &function)
+{
+  QElapsedTimer timer;
+
+  // Find an iteration count that takes long enough to time reliably, this also warms caches
+  int iterations = 1;
+
+  forever {
+    timer.start();
+    function(iterations);
+    qint64 elapsed = timer.elapsed();
+
+    if (elapsed >= kMinimumTime || iterations >= (1 << 30)) {
+      break;
+    }
+
+    // Aim a little past the minimum without growing by more than 10x at a time
+    int factor = elapsed > 0 ? qBound(2, int(kMinimumTime * 3 / 2 / elapsed), 10) : 10;
+    iterations *= factor;
+  }
+
+  QVector<double> ns_per_op(kRepetitions);
+
+  for (int i=0; i<kRepetitions; i++) {
+    timer.start();
+    function(iterations);
+    ns_per_op[i] = double(timer.nsecsElapsed()) / iterations;
+  }
+
+  std::sort(ns_per_op.begin(), ns_per_op.end());
+
+  QJsonObject o;
+  o.insert(QStringLiteral("iterations"), iterations);
+  o.insert(QStringLiteral("ns_per_op"), ns_per_op.at(kRepetitions / 2));
+  o.insert(QStringLiteral("min_ns_per_op"), ns_per_op.first());
+  o.insert(QStringLiteral("max_ns_per_op"), ns_per_op.last());
+  return o;
+}
+
+QJsonObject CLIMicrobenchmark::BenchmarkRational()
+{
+  // Times in the timebases footage actually comes in, so reductions do real work
+  static const int kTimebases[] = {24, 25, 30, 60, 1001, 24000, 30000, 48000, 44100};
+  static const int kCount = 1024;
+
+  std::mt19937 rng(kCount);
+  QVector<rational> values(kCount);
+
+  for (int i=0; i<kCount; i++) {
+    int tb = kTimebases[i % (sizeof(kTimebases) / sizeof(int))];
+    values[i] = rational(int(rng() % (tb * 3600)), tb);
+  }
+
+  QJsonObject o;
+
+  o.insert(QStringLiteral("add"), Measure([&](int iterations){
+    rational sum;
+    for (int i=0; i<iterations; i++) {
+      sum += values.at(i % kCount);
+    }
+    benchmark_sink = sum.toDouble();
+  }));
+
+  o.insert(QStringLiteral("multiply"), Measure([&](int iterations){
+    double sum = 0;
+    for (int i=0; i<iterations; i++) {
+      sum += (values.at(i % kCount) * values.at((i + 1) % kCount)).toDouble();
+    }
+    benchmark_sink = sum;
+  }));
+
+  o.insert(QStringLiteral("compare"), Measure([&](int iterations){
+    int less = 0;
+    for (int i=0; i<iterations; i++) {
+      if (values.at(i % kCount) < values.at((i + 1) % kCount)) {
+        less++;
+      }
+    }
+    benchmark_sink = less;
+  }));
+
+  o.insert(QStringLiteral("to_double"), Measure([&](int iterations){
+    double sum = 0;
+    for (int i=0; i<iterations; i++) {
+      sum += values.at(i % kCount).toDouble();
+    }
+    benchmark_sink = sum;
+  }));
+
+  return o;
+}
+
+QJsonObject CLIMicrobenchmark::BenchmarkTimeRangeList()
+{
+  // A list as fragmented as a cache that's been invalidated piecemeal
+  static const int kFragments = 1000;
+
+  TimeRangeList list;
+
+  for (int i=0; i<kFragments; i++) {
+    list.insert(TimeRange(rational(i * 2, 30), rational(i * 2 + 1, 30)));
+  }
+
+  std::mt19937 rng(kFragments);
+  QVector<TimeRange> queries(kFragments);
+
+  for (int i=0; i<kFragments; i++) {
+    int start = int(rng() % (kFragments * 4));
+    queries[i] = TimeRange(rational(start, 60), rational(start + 1, 60));
+  }
+
+  QJsonObject o;
+
+  o.insert(QStringLiteral("fragments"), kFragments);
+
+  o.insert(QStringLiteral("contains"), Measure([&](int iterations){
+    int found = 0;
+    for (int i=0; i<iterations; i++) {
+      if (list.contains(queries.at(i % kFragments))) {
+        found++;
+      }
+    }
+    benchmark_sink = found;
+  }));
+
+  // Removing a range filling a gap right after inserting it leaves the list as it was, so every
+  // iteration works on the same fragmentation
+  o.insert(QStringLiteral("insert_remove"), Measure([&](int iterations){
+    for (int i=0; i<iterations; i++) {
+      int gap = i % kFragments;
+      TimeRange r(rational(gap * 2 + 1, 30), rational(gap * 2 + 2, 30));
+      list.insert(r);
+      list.remove(r);
+    }
+    benchmark_sink = list.size();
+  }));
+
+  o.insert(QStringLiteral("intersects"), Measure([&](int iterations){
+    int count = 0;
+    for (int i=0; i<iterations; i++) {
+      count += list.Intersects(queries.at(i % kFragments)).size();
+    }
+    benchmark_sink = count;
+  }));
+
+  return o;
+}
+
+QJsonObject CLIMicrobenchmark::BenchmarkMemoryPool()
+{
+  static const int kElementsPerArena = 256;
+  static const int kHeldElements = 8;
+
+  MemoryPool<QMatrix4x4> pool(kElementsPerArena);
+
+  // Each worker holds on to a few elements like a decoder's frame cache would, each iteration
+  // releases the oldest and gets a new one
+  auto churn = [&pool](int iterations){
+    MemoryPool<QMatrix4x4>::ElementPtr held[kHeldElements];
+
+    for (int i=0; i<iterations; i++) {
+      held[i % kHeldElements] = pool.Get();
+    }
+  };
+
+  QJsonObject o;
+
+  o.insert(QStringLiteral("get_release"), Measure(churn));
+
+  int threads = QThread::idealThreadCount();
+  QJsonObject contended = Measure([&](int iterations){
+    QList< QFuture<void> > futures;
+    int per_thread = qMax(1, iterations / threads);
+
+    for (int i=0; i<threads; i++) {
+      futures.append(QtConcurrent::run([&churn, per_thread]{
+        churn(per_thread);
+      }));
+    }
+
+    foreach (QFuture<void> f, futures) {
+      f.waitForFinished();
+    }
+  });
+  contended.insert(QStringLiteral("threads"), threads);
+  o.insert(QStringLiteral("get_release_contended"), contended);
+
+  return o;
+}
+
+QJsonObject CLIMicrobenchmark::BenchmarkNodeValueTable()
+{
+  // A table shaped like one partway through a typical video node
+  NodeValueTable table;
+  table.Push(NodeParam::kFloat, 1.0, nullptr);
+  table.Push(NodeParam::kMatrix, QVariant::fromValue(QMatrix4x4()), nullptr);
+  table.Push(NodeParam::kColor, QVariant(), nullptr);
+  table.Push(NodeParam::kFloat, 2.0, nullptr, QStringLiteral("tag"));
+  table.Push(NodeParam::kInt, 3, nullptr);
+  table.Push(NodeParam::kBoolean, true, nullptr);
+  table.Push(NodeParam::kText, QStringLiteral("text"), nullptr);
+  table.Push(NodeParam::kRational, QVariant::fromValue(rational(1, 30)), nullptr);
+
+  QJsonObject o;
+
+  o.insert(QStringLiteral("get"), Measure([&](int iterations){
+    double sum = 0;
+    for (int i=0; i<iterations; i++) {
+      sum += table.Get(NodeParam::kFloat).toDouble();
+    }
+    benchmark_sink = sum;
+  }));
+
+  o.insert(QStringLiteral("get_tagged"), Measure([&](int iterations){
+    double sum = 0;
+    for (int i=0; i<iterations; i++) {
+      sum += table.Get(NodeParam::kFloat, QStringLiteral("tag")).toDouble();
+    }
+    benchmark_sink = sum;
+  }));
+
+  // Pushing the value back keeps the table the same size for every iteration
+  o.insert(QStringLiteral("push_take"), Measure([&](int iterations){
+    double sum = 0;
+    for (int i=0; i<iterations; i++) {
+      table.Push(NodeParam::kInt, i, nullptr);
+      sum += table.Take(NodeParam::kInt).toInt();
+    }
+    benchmark_sink = sum;
+  }));
+
+  return o;
+}
+
+QJsonObject CLIMicrobenchmark::BenchmarkKeyframes()
+{
+  static const int kKeyframes = 1000;
+  static const int kTimes = 1024;
+
+  NodeInput input(QStringLiteral("benchmark"), NodeParam::kFloat, 0.0);
+  input.set_is_keyframing(true);
+
+  for (int i=0; i<kKeyframes; i++) {
+    input.insert_keyframe(NodeKeyframe::Create(rational(i, 30), double(i % 7), (i % 3) ? NodeKeyframe::kLinear : NodeKeyframe::kBezier, 0));
+  }
+
+  std::mt19937 rng(kKeyframes);
+  QVector<rational> random_times(kTimes);
+  QVector<rational> sequential_times(kTimes);
+
+  for (int i=0; i<kTimes; i++) {
+    random_times[i] = rational(int(rng() % (kKeyframes * 10)), 300);
+    sequential_times[i] = rational(i * kKeyframes / kTimes, 30);
+  }
+
+  QJsonObject o;
+
+  o.insert(QStringLiteral("keyframes"), kKeyframes);
+
+  o.insert(QStringLiteral("get_value_at_time"), Measure([&](int iterations){
+    double sum = 0;
+    for (int i=0; i<iterations; i++) {
+      sum += input.get_value_at_time(random_times.at(i % kTimes)).toDouble();
+    }
+    benchmark_sink = sum;
+  }));
+
+  // Per value, for comparison with individual lookups
+  o.insert(QStringLiteral("get_values_at_times"), Measure([&](int iterations){
+    double sum = 0;
+    for (int i=0; i<iterations; i+=kTimes) {
+      QVector<QVariant> values = input.get_values_at_times(sequential_times);
+      sum += values.last().toDouble();
+    }
+    benchmark_sink = sum;
+  }));
+
+  return o;
+}
+
+QJsonObject CLIMicrobenchmark::BenchmarkHashing()
+{
+  static const int kNodeCount = 64;
+
+  // Each node takes the previous one and one further back, so shared subgraphs are reached
+  // through more than one path like they are in real compositions
+  QVector<MathNode*> nodes(kNodeCount);
+
+  for (int i=0; i<kNodeCount; i++) {
+    nodes[i] = new MathNode();
+
+    if (i > 0) {
+      NodeParam::ConnectEdge(nodes.at(i - 1)->output(), nodes.at(i)->param_a_in());
+    }
+
+    if (i > 1) {
+      NodeParam::ConnectEdge(nodes.at(i / 2)->output(), nodes.at(i)->param_b_in());
+    } else {
+      nodes.at(i)->param_b_in()->set_is_keyframing(true);
+      nodes.at(i)->param_b_in()->insert_keyframe(NodeKeyframe::Create(0, 0.0, NodeKeyframe::kLinear, 0));
+      nodes.at(i)->param_b_in()->insert_keyframe(NodeKeyframe::Create(rational(3600), 1.0, NodeKeyframe::kLinear, 0));
+    }
+  }
+
+  VideoParams params(1920, 1080, rational(1, 30), VideoParams::kFormatFloat16, VideoParams::kRGBAChannelCount);
+  Node* output = nodes.last();
+
+  QJsonObject o;
+
+  o.insert(QStringLiteral("nodes"), kNodeCount);
+
+  o.insert(QStringLiteral("cached"), Measure([&](int iterations){
+    int sum = 0;
+    for (int i=0; i<iterations; i++) {
+      sum += RenderManager::Hash(output, params, 0).size();
+    }
+    benchmark_sink = sum;
+  }));
+
+  // A new time every iteration so nothing comes from the nodes' hash caches
+  int next_frame = 0;
+  o.insert(QStringLiteral("uncached"), Measure([&](int iterations){
+    int sum = 0;
+    for (int i=0; i<iterations; i++) {
+      sum += RenderManager::Hash(output, params, rational(++next_frame, 30)).size();
+    }
+    benchmark_sink = sum;
+  }));
+
+  qDeleteAll(nodes);
+
+  return o;
+}
+
+QJsonObject CLIMicrobenchmark::BenchmarkSampleBuffer()
+{
+  AudioParams params(48000, AV_CH_LAYOUT_STEREO, AudioParams::kInternalFormat);
+  SampleBufferPtr buffer = SampleBuffer::CreateAllocated(params, rational(1));
+  buffer->fill(0.5f);
+
+  QJsonObject o;
+
+  o.insert(QStringLiteral("samples"), buffer->sample_count());
+
+  o.insert(QStringLiteral("fill"), Measure([&](int iterations){
+    for (int i=0; i<iterations; i++) {
+      buffer->fill(0.5f);
+    }
+    benchmark_sink = buffer->data()[0][0];
+  }));
+
+  // Alternating volumes so the values don't run off to zero or infinity
+  o.insert(QStringLiteral("transform_volume"), Measure([&](int iterations){
+    for (int i=0; i<iterations; i++) {
+      buffer->transform_volume((i % 2) ? 2.0f : 0.5f);
+    }
+    benchmark_sink = buffer->data()[0][0];
+  }));
+
+  o.insert(QStringLiteral("reverse"), Measure([&](int iterations){
+    for (int i=0; i<iterations; i++) {
+      buffer->reverse();
+    }
+    benchmark_sink = buffer->data()[0][0];
+  }));
+
+  o.insert(QStringLiteral("to_packed_data"), Measure([&](int iterations){
+    int sum = 0;
+    for (int i=0; i<iterations; i++) {
+      sum += buffer->toPackedData().size();
+    }
+    benchmark_sink = sum;
+  }));
+
+  // Speed changes resize the buffer, so start from a fresh one every time
+  o.insert(QStringLiteral("speed"), Measure([&](int iterations){
+    for (int i=0; i<iterations; i++) {
+      SampleBufferPtr copy = SampleBuffer::CreateAllocated(params, rational(1));
+      copy->speed(1.5);
+      benchmark_sink = copy->sample_count();
+    }
+  }));
+
+  return o;
+}
+
+}
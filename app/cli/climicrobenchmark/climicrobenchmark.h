@@ -0,0 +1,93 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef CLIMICROBENCHMARK_H
+#define CLIMICROBENCHMARK_H
+
+#include <functional>
+#include <QJsonObject>
+
+namespace olive {
+
+/**
+ * @brief Measures the primitives on the render and playback hot paths in isolation
+ *
+ * Run with `--microbenchmark`. Unlike CLIBenchmark this needs no project, each primitive is
+ * measured on synthetic data so changes to the files they live in can be compared on their own:
+ *
+ * * rational arithmetic, comparison and conversion
+ * * TimeRangeList insert/remove/contains on a heavily fragmented list
+ * * MemoryPool Get/Release from one thread and from every core at once
+ * * NodeValueTable Get/Take
+ * * NodeInput::get_value_at_time() on an input with many keyframes
+ * * RenderManager::Hash() on a synthetic node graph
+ * * SampleBuffer kernels on a second of stereo audio
+ *
+ * Each measurement runs enough iterations to take at least kMinimumTime, repeated kRepetitions
+ * times. Results are written as JSON to the file given with `--benchmark-output` (or stdout) in
+ * nanoseconds per operation.
+ */
+class CLIMicrobenchmark
+{
+public:
+  CLIMicrobenchmark() = default;
+
+  /**
+   * @brief Run every microbenchmark and write the results to `output_filename`
+   *
+   * If `output_filename` is empty, results are written to stdout. Returns a process exit code.
+   */
+  int Run(const QString& output_filename);
+
+private:
+  /**
+   * @brief Time `function`, which must perform the operation being measured `iterations` times
+   */
+  static QJsonObject Measure(const std::function<void(int iterations)>& function);
+
+  static QJsonObject BenchmarkRational();
+
+  static QJsonObject BenchmarkTimeRangeList();
+
+  static QJsonObject BenchmarkMemoryPool();
+
+  static QJsonObject BenchmarkNodeValueTable();
+
+  static QJsonObject BenchmarkKeyframes();
+
+  static QJsonObject BenchmarkHashing();
+
+  static QJsonObject BenchmarkSampleBuffer();
+
+  /**
+   * @brief Minimum duration of one repetition in milliseconds
+   */
+  static const int kMinimumTime;
+
+  /**
+   * @brief Number of times each measurement is repeated
+   */
+  static const int kRepetitions;
+
+};
+
+}
+
+#endif // CLIMICROBENCHMARK_H
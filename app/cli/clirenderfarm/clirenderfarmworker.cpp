@@ -0,0 +1,215 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "clirenderfarmworker.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QScopedPointer>
+#include <QThread>
+
+#include "common/filefunctions.h"
+#include "common/metrics.h"
+#include "common/timecodefunctions.h"
+#include "task/export/export.h"
+#include "task/project/load/load.h"
+
+namespace olive {
+
+const int CLIRenderFarmWorker::kIdleInterval = 2000;
+const int CLIRenderFarmWorker::kProgressInterval = 5000;
+
+CLIRenderFarmWorker::CLIRenderFarmWorker(const QString &farm_path) :
+  farm_path_(farm_path),
+  project_(nullptr)
+{
+}
+
+CLIRenderFarmWorker::~CLIRenderFarmWorker()
+{
+  delete project_;
+}
+
+int CLIRenderFarmWorker::Run()
+{
+  if (farm_path_.isEmpty() || !QFileInfo(farm_path_).isDir()) {
+    qCritical() << "Render farm worker requires an existing render farm folder";
+    return 1;
+  }
+
+  qInfo() << "Waiting for render farm jobs in" << farm_path_ << "as" << RenderFarmJob::GetHostName();
+
+  forever {
+    bool worked = false;
+
+    foreach (const QString& job_path, RenderFarmJob::GetJobs(farm_path_)) {
+      RenderFarmJob job(job_path);
+
+      if (job.IsCancelled() || !job.Load()) {
+        continue;
+      }
+
+      if (ProcessJob(job)) {
+        worked = true;
+      }
+    }
+
+    if (!worked) {
+      // Nothing left to do in jobs that are gone now
+      if (project_ && !QFileInfo::exists(project_job_)) {
+        delete project_;
+        project_ = nullptr;
+        project_job_.clear();
+      }
+
+      QThread::msleep(kIdleInterval);
+    }
+  }
+}
+
+bool CLIRenderFarmWorker::ProcessJob(const RenderFarmJob &job)
+{
+  bool worked = false;
+
+  for (int i=0; i<job.chunk_count() && !job.IsCancelled(); i++) {
+    if (job.IsChunkDone(i) || job.GetChunkFailures(i) >= RenderFarmJob::kMaximumAttempts) {
+      continue;
+    }
+
+    QScopedPointer<QLockFile> claim(job.TryClaimChunk(i));
+
+    // Check again now that it's ours in case it was finished while we were looking
+    if (!claim || job.IsChunkDone(i)) {
+      continue;
+    }
+
+    Project* project = GetProject(job);
+
+    if (!project) {
+      job.MarkChunkFailed(i, tr("Failed to load project"));
+      return worked;
+    }
+
+    Sequence* sequence = nullptr;
+
+    foreach (Item* item, project->get_items_of_type(Item::kSequence)) {
+      if (item->name() == job.sequence_name()) {
+        sequence = static_cast<Sequence*>(item);
+        break;
+      }
+    }
+
+    if (!sequence) {
+      job.MarkChunkFailed(i, tr("Sequence \"%1\" not found").arg(job.sequence_name()));
+      return worked;
+    }
+
+    RenderChunk(job, sequence, i);
+
+    worked = true;
+  }
+
+  return worked;
+}
+
+void CLIRenderFarmWorker::RenderChunk(const RenderFarmJob &job, Sequence *sequence, int chunk)
+{
+  TimeRange range = job.GetChunkRange(chunk);
+  QString chunk_filename = job.GetChunkFilename(chunk);
+
+  // Write somewhere else first, if our claim was released while we were unresponsive another
+  // worker may be writing this chunk too
+  ExportParams params = job.params();
+  params.set_custom_range(range);
+  params.SetExportLength(range.length());
+  params.SetFilename(FileFunctions::GetSafeTemporaryFilename(chunk_filename));
+
+  qInfo() << "Rendering chunk" << chunk << "of" << job.path();
+
+  ExportTask task(sequence->viewer_output(), project_->color_manager(), params);
+
+  int64_t frame_count = Timecode::time_to_timestamp(range.length(), params.video_params().time_base());
+  QElapsedTimer progress_timer;
+  progress_timer.start();
+
+  QString progress_name = tr("Chunk %1 of %2").arg(QString::number(chunk), QFileInfo(job.path()).fileName());
+
+  connect(&task, &Task::ProgressChanged, this, [&](double progress){
+    Metrics::SetProgress(&task, progress_name, progress);
+
+    if (progress_timer.elapsed() < kProgressInterval) {
+      return;
+    }
+
+    progress_timer.start();
+
+    if (job.IsCancelled()) {
+      task.Cancel();
+    } else {
+      job.UpdateChunkProgress(chunk, qRound64(progress * frame_count));
+    }
+  }, Qt::DirectConnection);
+
+  QElapsedTimer timer;
+  timer.start();
+
+  bool success = task.Start();
+
+  Metrics::RemoveProgress(&task);
+
+  if (task.IsCancelled()) {
+    QFile::remove(params.filename());
+  } else if (!success) {
+    qWarning() << "Failed to render chunk" << chunk << "of" << job.path() << ":" << task.GetError();
+    job.MarkChunkFailed(chunk, task.GetError());
+    QFile::remove(params.filename());
+  } else if (!FileFunctions::RenameFileAllowOverwrite(params.filename(), chunk_filename)) {
+    job.MarkChunkFailed(chunk, tr("Failed to write \"%1\"").arg(chunk_filename));
+    QFile::remove(params.filename());
+  } else {
+    job.MarkChunkDone(chunk, timer.elapsed());
+  }
+}
+
+Project *CLIRenderFarmWorker::GetProject(const RenderFarmJob &job)
+{
+  if (project_ && project_job_ == job.path()) {
+    return project_;
+  }
+
+  delete project_;
+  project_ = nullptr;
+  project_job_.clear();
+
+  ProjectLoadTask load_task(job.project_filename());
+
+  if (!load_task.Start()) {
+    qWarning() << "Failed to load project for" << job.path() << ":" << load_task.GetError();
+    return nullptr;
+  }
+
+  project_ = load_task.GetLoadedProject();
+  project_job_ = job.path();
+
+  return project_;
+}
+
+}
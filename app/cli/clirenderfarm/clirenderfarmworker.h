@@ -0,0 +1,84 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef CLIRENDERFARMWORKER_H
+#define CLIRENDERFARMWORKER_H
+
+#include "project/item/sequence/sequence.h"
+#include "project/project.h"
+#include "task/export/renderfarmjob.h"
+
+namespace olive {
+
+/**
+ * @brief Renders chunks of exports submitted to a render farm folder without a GUI
+ *
+ * Run with `--farm-worker` and the render farm folder. The worker polls the folder for jobs,
+ * claims any chunk nobody else is rendering, renders it with the job's copy of the project and
+ * reports back through the job directory (see RenderFarmJob). It runs until the process is
+ * terminated.
+ */
+class CLIRenderFarmWorker : public QObject
+{
+  Q_OBJECT
+public:
+  CLIRenderFarmWorker(const QString& farm_path);
+
+  virtual ~CLIRenderFarmWorker() override;
+
+  /**
+   * @brief Process jobs until the process is terminated, returns a process exit code on failure
+   */
+  int Run();
+
+private:
+  /**
+   * @brief Render every available chunk of a job, returns TRUE if any were rendered
+   */
+  bool ProcessJob(const RenderFarmJob& job);
+
+  void RenderChunk(const RenderFarmJob& job, Sequence* sequence, int chunk);
+
+  /**
+   * @brief Load the project of `job` unless it's already loaded
+   */
+  Project* GetProject(const RenderFarmJob& job);
+
+  /**
+   * @brief Milliseconds to wait before checking for jobs again when there's nothing to do
+   */
+  static const int kIdleInterval;
+
+  /**
+   * @brief Minimum milliseconds between progress updates written to the job directory
+   */
+  static const int kProgressInterval;
+
+  QString farm_path_;
+
+  Project* project_;
+
+  QString project_job_;
+
+};
+
+}
+
+#endif // CLIRENDERFARMWORKER_H
@@ -0,0 +1,423 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "clirenderreplay.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "project/item/sequence/sequence.h"
+#include "render/renderrecorder.h"
+#include "render/rendermanager.h"
+#include "task/project/load/load.h"
+
+namespace olive {
+
+/**
+ * @brief Summarize a list of latencies in milliseconds
+ */
+static QJsonObject GetStatistics(QVector<double> ms)
+{
+  QJsonObject o;
+
+  if (ms.isEmpty()) {
+    return o;
+  }
+
+  std::sort(ms.begin(), ms.end());
+
+  double total = 0;
+  foreach (double d, ms) {
+    total += d;
+  }
+
+  o.insert(QStringLiteral("count"), ms.size());
+  o.insert(QStringLiteral("mean"), total / ms.size());
+  o.insert(QStringLiteral("p50"), ms.at(ms.size() / 2));
+  o.insert(QStringLiteral("p90"), ms.at(qMin(ms.size() - 1, ms.size() * 90 / 100)));
+  o.insert(QStringLiteral("p99"), ms.at(qMin(ms.size() - 1, ms.size() * 99 / 100)));
+  o.insert(QStringLiteral("max"), ms.last());
+
+  return o;
+}
+
+static QString GetPriorityName(int priority)
+{
+  switch (priority) {
+  case ThreadPool::kPriorityInteractive:
+    return QStringLiteral("interactive");
+  case ThreadPool::kPriorityPlayback:
+    return QStringLiteral("playback");
+  case ThreadPool::kPriorityBackground:
+    return QStringLiteral("background");
+  case ThreadPool::kPriorityDiskIO:
+    return QStringLiteral("diskio");
+  }
+
+  return QString::number(priority);
+}
+
+CLIRenderReplay::CLIRenderReplay(const QString &project_filename, const QString &log_filename) :
+  project_filename_(project_filename),
+  log_filename_(log_filename)
+{
+}
+
+int CLIRenderReplay::Run(const QString &output_filename)
+{
+  if (!LoadLog()) {
+    return 1;
+  }
+
+  ProjectLoadTask load_task(project_filename_);
+
+  if (!load_task.Start()) {
+    qCritical() << "Failed to load project" << project_filename_ << ":" << load_task.GetError();
+    return 1;
+  }
+
+  Project* project = load_task.GetLoadedProject();
+
+  // Requests and cancels in the order they happened
+  struct Action {
+    qint64 time;
+    int index;
+    bool cancel;
+  };
+
+  QVector<Action> actions;
+
+  for (int i=0; i<requests_.size(); i++) {
+    actions.append({requests_.at(i).time, i, false});
+
+    if (requests_.at(i).cancelled) {
+      actions.append({requests_.at(i).finish_time, i, true});
+    }
+  }
+
+  std::stable_sort(actions.begin(), actions.end(), [](const Action& a, const Action& b){
+    return a.time < b.time;
+  });
+
+  qInfo() << "Replaying" << requests_.size() << "requests over"
+          << (actions.isEmpty() ? 0 : actions.last().time / 1000000) << "ms";
+
+  QVector<RenderTicketPtr> tickets(requests_.size());
+  QVector<qint64> issue_times(requests_.size(), -1);
+  QVector<qint64> finish_times(requests_.size(), -1);
+  QVector<bool> cancelled(requests_.size(), false);
+
+  // Finished is emitted after WaitForFinished() is released so we count them in ourselves
+  QMutex finish_lock;
+  QWaitCondition finish_cond;
+  int pending = 0;
+
+  QElapsedTimer timer;
+  timer.start();
+
+  foreach (const Action& action, actions) {
+    qint64 wait = action.time - timer.nsecsElapsed();
+
+    if (wait > 0) {
+      QThread::usleep(static_cast<unsigned long>(wait / 1000));
+    }
+
+    if (action.cancel) {
+      if (tickets.at(action.index)) {
+        tickets.at(action.index)->Cancel();
+      }
+      continue;
+    }
+
+    RenderTicketPtr ticket = Issue(project, requests_.at(action.index));
+
+    if (!ticket) {
+      continue;
+    }
+
+    int index = action.index;
+    issue_times[index] = timer.nsecsElapsed();
+    tickets[index] = ticket;
+
+    {
+      QMutexLocker locker(&finish_lock);
+      pending++;
+    }
+
+    RenderTicket* raw = ticket.get();
+    QObject::connect(raw, &RenderTicket::Finished, [&, index, raw]{
+      QMutexLocker locker(&finish_lock);
+      finish_times[index] = timer.nsecsElapsed();
+      cancelled[index] = raw->WasCancelled();
+      pending--;
+      finish_cond.wakeAll();
+    });
+  }
+
+  {
+    QMutexLocker locker(&finish_lock);
+
+    while (pending > 0) {
+      finish_cond.wait(&finish_lock);
+    }
+  }
+
+  // Disconnect before the locals the connections refer to go away
+  foreach (const RenderTicketPtr& t, tickets) {
+    if (t) {
+      QObject::disconnect(t.get(), nullptr, nullptr, nullptr);
+    }
+  }
+
+  tickets.clear();
+
+  QJsonObject results = GetResults(issue_times, finish_times, cancelled);
+
+  delete project;
+
+  QByteArray json = QJsonDocument(results).toJson();
+
+  if (output_filename.isEmpty()) {
+    fwrite(json.constData(), 1, json.size(), stdout);
+    fflush(stdout);
+  } else {
+    QFile f(output_filename);
+
+    if (!f.open(QFile::WriteOnly) || f.write(json) != json.size()) {
+      qCritical() << "Failed to write replay results to" << output_filename;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+bool CLIRenderReplay::LoadLog()
+{
+  QFile f(log_filename_);
+
+  if (!f.open(QFile::ReadOnly)) {
+    qCritical() << "Failed to open render log" << log_filename_;
+    return false;
+  }
+
+  QJsonObject header = QJsonDocument::fromJson(f.readLine()).object();
+
+  if (header.value(QStringLiteral("version")).toInt() != RenderRecorder::kVersion) {
+    qCritical() << "Render log" << log_filename_ << "is missing or has an unsupported version";
+    return false;
+  }
+
+  QHash<int, int> indices;
+
+  while (!f.atEnd()) {
+    QJsonObject entry = QJsonDocument::fromJson(f.readLine()).object();
+
+    if (entry.isEmpty()) {
+      // Probably a line cut off by the session ending
+      continue;
+    }
+
+    int id = entry.value(QStringLiteral("id")).toInt();
+    qint64 time = static_cast<qint64>(entry.value(QStringLiteral("t")).toDouble());
+
+    if (entry.value(QStringLiteral("finished")).toBool()) {
+      auto it = indices.find(id);
+
+      if (it != indices.end()) {
+        Request& r = requests_[it.value()];
+        r.finish_time = time;
+        r.cancelled = entry.value(QStringLiteral("cancelled")).toBool();
+      }
+    } else {
+      indices.insert(id, requests_.size());
+      requests_.append({entry, time, -1, false});
+    }
+  }
+
+  return true;
+}
+
+RenderTicketPtr CLIRenderReplay::Issue(Project *project, const CLIRenderReplay::Request &request)
+{
+  const QJsonObject& e = request.entry;
+  QString viewer_name = e.value(QStringLiteral("viewer")).toString();
+  ViewerOutput* viewer = nullptr;
+
+  foreach (Item* item, project->get_items_of_type(Item::kSequence)) {
+    if (item->name() == viewer_name) {
+      viewer = static_cast<Sequence*>(item)->viewer_output();
+      break;
+    }
+  }
+
+  if (!viewer) {
+    return nullptr;
+  }
+
+  QString type = e.value(QStringLiteral("type")).toString();
+  RenderManager::TicketPriority priority = static_cast<RenderManager::TicketPriority>(e.value(QStringLiteral("priority")).toInt());
+  RenderManager* manager = RenderManager::instance();
+
+  if (type == QStringLiteral("audio")) {
+    TimeRange range(rational::fromString(e.value(QStringLiteral("in")).toString()),
+                    rational::fromString(e.value(QStringLiteral("out")).toString()));
+
+    return manager->RenderAudio(viewer, range, e.value(QStringLiteral("waveforms")).toBool(), priority);
+  }
+
+  if (type == QStringLiteral("save")) {
+    VideoParams params = viewer->video_params();
+    params.set_width(e.value(QStringLiteral("width")).toInt(params.width()));
+    params.set_height(e.value(QStringLiteral("height")).toInt(params.height()));
+    params.set_format(static_cast<VideoParams::Format>(e.value(QStringLiteral("format")).toInt(params.format())));
+    params.set_channel_count(e.value(QStringLiteral("channels")).toInt(params.channel_count()));
+
+    FramePtr frame = Frame::Create();
+    frame->set_video_params(params);
+
+    if (!frame->allocate()) {
+      return nullptr;
+    }
+
+    // A hash nothing real will ever have so the cache isn't filled with blank frames
+    QByteArray hash = QCryptographicHash::hash(QStringLiteral("olive-replay-%1").arg(e.value(QStringLiteral("id")).toInt()).toUtf8(),
+                                               Node::kHashAlgorithm);
+
+    return manager->SaveFrameToCache(viewer->video_frame_cache(), frame, hash, priority);
+  }
+
+  if (type == QStringLiteral("load")) {
+    QByteArray hash = QByteArray::fromHex(e.value(QStringLiteral("hash")).toString().toLatin1());
+
+    return manager->LoadFrameFromCache(viewer->video_frame_cache(), hash, VideoParams::kFormatInvalid, nullptr, priority);
+  }
+
+  VideoParams params = viewer->video_params();
+  params.set_divider(e.value(QStringLiteral("divider")).toInt(params.divider()));
+
+  RenderMode::Mode mode = static_cast<RenderMode::Mode>(e.value(QStringLiteral("mode")).toInt());
+  rational time = rational::fromString(e.value(QStringLiteral("time")).toString());
+  FrameHashCache* cache = e.value(QStringLiteral("cached")).toBool() ? viewer->video_frame_cache() : nullptr;
+
+  QSize force_size;
+  QJsonArray force_size_array = e.value(QStringLiteral("force_size")).toArray();
+  if (force_size_array.size() == 2) {
+    force_size = QSize(force_size_array.at(0).toInt(), force_size_array.at(1).toInt());
+  }
+
+  VideoParams::Format force_format = static_cast<VideoParams::Format>(e.value(QStringLiteral("force_format")).toInt(VideoParams::kFormatInvalid));
+
+  if (type == QStringLiteral("batch")) {
+    QVector<rational> times;
+    foreach (const QJsonValue& t, e.value(QStringLiteral("times")).toArray()) {
+      times.append(rational::fromString(t.toString()));
+    }
+
+    return manager->RenderFrames(viewer, project->color_manager(), times, mode, params, viewer->audio_params(),
+                                 force_size, QMatrix4x4(), force_format, nullptr, cache, priority);
+  }
+
+  QRect region;
+  QJsonArray region_array = e.value(QStringLiteral("region")).toArray();
+  if (region_array.size() == 4) {
+    region = QRect(region_array.at(0).toInt(), region_array.at(1).toInt(),
+                   region_array.at(2).toInt(), region_array.at(3).toInt());
+  }
+
+  bool best_effort = e.value(QStringLiteral("best_effort")).toBool();
+
+  if (type == QStringLiteral("texture") && manager->CanShareTexturesWithDisplay()) {
+    return manager->RenderFrameForDisplay(viewer, project->color_manager(), time, mode, priority, region, best_effort);
+  }
+
+  // Display textures are downloaded instead if we can't share them, which costs about the same
+  return manager->RenderFrame(viewer, project->color_manager(), time, mode, params, viewer->audio_params(),
+                              force_size, QMatrix4x4(), force_format, nullptr, cache, priority, region, best_effort);
+}
+
+QJsonObject CLIRenderReplay::GetResults(const QVector<qint64> &issue_times, const QVector<qint64> &finish_times,
+                                        const QVector<bool> &cancelled) const
+{
+  QMap<QString, QVector<double> > recorded, replayed;
+  QMap<QString, int> cancel_counts, skipped_counts;
+
+  for (int i=0; i<requests_.size(); i++) {
+    const Request& r = requests_.at(i);
+
+    QStringList groups = {
+      QStringLiteral("type/%1").arg(r.entry.value(QStringLiteral("type")).toString()),
+      QStringLiteral("priority/%1").arg(GetPriorityName(r.entry.value(QStringLiteral("priority")).toInt()))
+    };
+
+    foreach (const QString& g, groups) {
+      if (r.finish_time >= 0 && !r.cancelled) {
+        recorded[g].append(double(r.finish_time - r.time) / 1000000.0);
+      }
+
+      if (issue_times.at(i) < 0) {
+        // The sequence it was for isn't in this project
+        skipped_counts[g]++;
+      } else if (cancelled.at(i)) {
+        cancel_counts[g]++;
+      } else if (finish_times.at(i) >= 0) {
+        replayed[g].append(double(finish_times.at(i) - issue_times.at(i)) / 1000000.0);
+      }
+    }
+  }
+
+  QJsonObject types, priorities;
+  QStringList keys = recorded.keys() + replayed.keys() + skipped_counts.keys();
+  keys.removeDuplicates();
+
+  foreach (const QString& g, keys) {
+    QJsonObject o;
+    o.insert(QStringLiteral("recorded"), GetStatistics(recorded.value(g)));
+    o.insert(QStringLiteral("replayed"), GetStatistics(replayed.value(g)));
+    o.insert(QStringLiteral("cancelled"), cancel_counts.value(g));
+    o.insert(QStringLiteral("skipped"), skipped_counts.value(g));
+
+    QString name = g.section('/', 1);
+
+    if (g.startsWith(QStringLiteral("type/"))) {
+      types.insert(name, o);
+    } else {
+      priorities.insert(name, o);
+    }
+  }
+
+  QJsonObject results;
+  results.insert(QStringLiteral("log"), log_filename_);
+  results.insert(QStringLiteral("requests"), requests_.size());
+  results.insert(QStringLiteral("types"), types);
+  results.insert(QStringLiteral("priorities"), priorities);
+  return results;
+}
+
+}
@@ -0,0 +1,91 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef CLIRENDERREPLAY_H
+#define CLIRENDERREPLAY_H
+
+#include <QJsonObject>
+#include <QVector>
+
+#include "project/project.h"
+#include "threading/threadticket.h"
+
+namespace olive {
+
+/**
+ * @brief Plays a RenderRecorder log back against a project without a GUI
+ *
+ * Run with `--replay-renders` and the log, plus the project the log was recorded with. Every
+ * request is made again at the same time relative to the start as it was originally, and tickets
+ * that were cancelled are cancelled at the same time too. Once everything has finished, latency
+ * percentiles of the replay and of the original session are written as JSON to the file given
+ * with `--benchmark-output` (or stdout), per request type and per priority.
+ *
+ * Frames saved to the disk cache are replaced with blank frames of the same size under hashes of
+ * their own, so the disk load is the same without overwriting anything real in the cache.
+ *
+ * All durations in the output are in milliseconds.
+ */
+class CLIRenderReplay
+{
+public:
+  CLIRenderReplay(const QString& project_filename, const QString& log_filename);
+
+  /**
+   * @brief Replay the log and write the results to `output_filename`
+   *
+   * If `output_filename` is empty, results are written to stdout. Returns a process exit code.
+   */
+  int Run(const QString& output_filename);
+
+private:
+  struct Request {
+    QJsonObject entry;
+    qint64 time;
+
+    /// When the original ticket finished, or -1 if it never did
+    qint64 finish_time;
+    bool cancelled;
+  };
+
+  bool LoadLog();
+
+  RenderTicketPtr Issue(Project* project, const Request& request);
+
+  /**
+   * @brief Latency statistics grouped by request type and by priority
+   *
+   * `issue_times` and `finish_times` are when each request was made and finished during the
+   * replay, the original times come from the log.
+   */
+  QJsonObject GetResults(const QVector<qint64>& issue_times, const QVector<qint64>& finish_times,
+                         const QVector<bool>& cancelled) const;
+
+  QString project_filename_;
+
+  QString log_filename_;
+
+  QVector<Request> requests_;
+
+};
+
+}
+
+#endif // CLIRENDERREPLAY_H
@@ -0,0 +1,423 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "clirenderserver.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QXmlStreamReader>
+
+#include "common/xmlutils.h"
+#include "project/item/sequence/sequence.h"
+#include "task/export/export.h"
+#include "task/project/load/load.h"
+#include "task/taskmanager.h"
+
+namespace olive {
+
+const int CLIRenderServer::kMaxIdleProjects = 4;
+const double CLIRenderServer::kProgressInterval = 0.01;
+
+CLIRenderServer::CLIRenderServer(const QString &name, QObject *parent) :
+  QObject(parent),
+  name_(name),
+  next_id_(1),
+  use_counter_(0)
+{
+  connect(&server_, &QLocalServer::newConnection, this, &CLIRenderServer::NewConnection);
+  connect(TaskManager::instance(), &TaskManager::TaskRemoved, this, &CLIRenderServer::TaskRemoved);
+  connect(TaskManager::instance(), &TaskManager::TaskFailed, this, &CLIRenderServer::TaskFailed);
+}
+
+CLIRenderServer::~CLIRenderServer()
+{
+  server_.close();
+
+  disconnect(TaskManager::instance(), nullptr, this, nullptr);
+
+  // Tasks reference their project so they have to go first
+  foreach (Task* t, task_jobs_.keys()) {
+    TaskManager::instance()->CancelTaskAndWait(t);
+  }
+
+  foreach (const LoadedProject& p, projects_) {
+    delete p.project;
+  }
+}
+
+bool CLIRenderServer::Start()
+{
+  // Clean up the socket of a server that didn't shut down cleanly
+  QLocalServer::removeServer(name_);
+
+  if (!server_.listen(name_)) {
+    qCritical() << "Failed to start render server on" << name_ << ":" << server_.errorString();
+    return false;
+  }
+
+  qInfo() << "Render server listening on" << server_.fullServerName();
+  return true;
+}
+
+void CLIRenderServer::NewConnection()
+{
+  while (QLocalSocket* client = server_.nextPendingConnection()) {
+    connect(client, &QLocalSocket::readyRead, this, &CLIRenderServer::ReadCommands);
+    connect(client, &QLocalSocket::disconnected, this, &CLIRenderServer::ClientDisconnected);
+  }
+}
+
+void CLIRenderServer::ReadCommands()
+{
+  QLocalSocket* client = static_cast<QLocalSocket*>(sender());
+
+  while (client->canReadLine()) {
+    QByteArray line = client->readLine().trimmed();
+
+    if (line.isEmpty()) {
+      continue;
+    }
+
+    QJsonParseError parse_error;
+    QJsonDocument doc = QJsonDocument::fromJson(line, &parse_error);
+
+    if (!doc.isObject()) {
+      SendError(client, tr("Invalid command: %1").arg(parse_error.errorString()));
+      continue;
+    }
+
+    HandleCommand(client, doc.object());
+  }
+}
+
+void CLIRenderServer::ClientDisconnected()
+{
+  QLocalSocket* client = static_cast<QLocalSocket*>(sender());
+
+  // Jobs keep running when their client goes away, there's just nobody to tell about them
+  for (auto it=jobs_.begin(); it!=jobs_.end(); it++) {
+    if (it->client == client) {
+      it->client = nullptr;
+    }
+  }
+
+  client->deleteLater();
+}
+
+void CLIRenderServer::HandleCommand(QLocalSocket *client, const QJsonObject &command)
+{
+  QString name = command.value(QStringLiteral("command")).toString();
+
+  if (name == QStringLiteral("export")) {
+    SubmitJob(client, command);
+  } else if (name == QStringLiteral("status")) {
+    QJsonArray list;
+
+    foreach (const Job& job, jobs_) {
+      list.append(JobToJson(job));
+    }
+
+    QJsonObject reply;
+    reply.insert(QStringLiteral("event"), QStringLiteral("status"));
+    reply.insert(QStringLiteral("jobs"), list);
+    Send(client, reply);
+  } else if (name == QStringLiteral("cancel")) {
+    int id = command.value(QStringLiteral("id")).toInt();
+    auto it = jobs_.find(id);
+
+    if (it == jobs_.end()) {
+      SendError(client, tr("No job with ID %1").arg(id));
+    } else if (it->task) {
+      // Finishes the job through TaskRemoved() or TaskFailed(), cancelling first so a job that
+      // hasn't started yet is still reported as cancelled
+      it->task->Cancel();
+      TaskManager::instance()->CancelTask(it->task);
+    }
+  } else if (name == QStringLiteral("quit")) {
+    qInfo() << "Render server shutting down";
+    QCoreApplication::exit(0);
+  } else {
+    SendError(client, tr("Unknown command \"%1\"").arg(name));
+  }
+}
+
+void CLIRenderServer::SubmitJob(QLocalSocket *client, const QJsonObject &command)
+{
+  Job job;
+  job.id = next_id_;
+  job.project_filename = command.value(QStringLiteral("project")).toString();
+  job.sequence_name = command.value(QStringLiteral("sequence")).toString();
+  job.progress = 0;
+  job.client = client;
+  job.task = nullptr;
+
+  ExportParams params;
+  QXmlStreamReader reader(command.value(QStringLiteral("params")).toString());
+
+  if (!XMLReadNextStartElement(&reader) || reader.name() != QStringLiteral("export") || !params.Load(&reader)) {
+    SendError(client, tr("Invalid export parameters"));
+    return;
+  }
+
+  if (command.contains(QStringLiteral("filename"))) {
+    params.SetFilename(command.value(QStringLiteral("filename")).toString());
+  }
+
+  QString error;
+  job.project = AcquireProject(job.project_filename, &error);
+
+  if (!job.project) {
+    SendError(client, error);
+    return;
+  }
+
+  Sequence* sequence = nullptr;
+
+  foreach (Item* item, job.project->get_items_of_type(Item::kSequence)) {
+    if (item->name() == job.sequence_name) {
+      sequence = static_cast<Sequence*>(item);
+      break;
+    }
+  }
+
+  if (!sequence) {
+    ReleaseProject(job.project);
+    SendError(client, tr("Sequence \"%1\" not found").arg(job.sequence_name));
+    return;
+  }
+
+  if (params.has_custom_range()) {
+    params.SetExportLength(params.custom_range().length());
+  } else {
+    params.SetExportLength(sequence->viewer_output()->GetLength());
+  }
+
+  job.output_filename = params.filename();
+  job.status = QStringLiteral("queued");
+  job.task = new ExportTask(sequence->viewer_output(), job.project->color_manager(), params);
+
+  Task* task = job.task;
+  connect(task, &Task::ProgressChanged, this, [this, task](double progress){
+    UpdateProgress(task, progress);
+  });
+
+  jobs_.insert(job.id, job);
+  task_jobs_.insert(task, job.id);
+  next_id_++;
+
+  qInfo() << "Queued job" << job.id << ":" << job.sequence_name << "of" << job.project_filename
+          << "to" << job.output_filename;
+
+  QJsonObject reply;
+  reply.insert(QStringLiteral("event"), QStringLiteral("queued"));
+  reply.insert(QStringLiteral("id"), job.id);
+  Send(client, reply);
+
+  TaskManager::instance()->AddTask(task);
+}
+
+Project *CLIRenderServer::AcquireProject(const QString &filename, QString *error)
+{
+  QFileInfo info(filename);
+
+  if (!info.exists()) {
+    *error = tr("Project \"%1\" doesn't exist").arg(filename);
+    return nullptr;
+  }
+
+  QString key = info.absoluteFilePath();
+  auto it = projects_.find(key);
+
+  if (it != projects_.end() && it->last_modified != info.lastModified() && it->users == 0) {
+    // Changed since we loaded it, nothing's using the old copy so load it again
+    delete it->project;
+    projects_.erase(it);
+    it = projects_.end();
+  }
+
+  if (it == projects_.end()) {
+    ProjectLoadTask load_task(key);
+
+    if (!load_task.Start()) {
+      *error = tr("Failed to load project \"%1\": %2").arg(filename, load_task.GetError());
+      return nullptr;
+    }
+
+    LoadedProject p;
+    p.project = load_task.GetLoadedProject();
+    p.last_modified = info.lastModified();
+    p.users = 0;
+    p.last_used = 0;
+    it = projects_.insert(key, p);
+  }
+
+  it->users++;
+  it->last_used = use_counter_++;
+
+  return it->project;
+}
+
+void CLIRenderServer::ReleaseProject(Project *project)
+{
+  for (auto it=projects_.begin(); it!=projects_.end(); it++) {
+    if (it->project == project) {
+      it->users--;
+      break;
+    }
+  }
+
+  PruneProjects();
+}
+
+void CLIRenderServer::PruneProjects()
+{
+  while (true) {
+    int idle = 0;
+    auto oldest = projects_.end();
+
+    for (auto it=projects_.begin(); it!=projects_.end(); it++) {
+      if (it->users == 0) {
+        idle++;
+
+        if (oldest == projects_.end() || it->last_used < oldest->last_used) {
+          oldest = it;
+        }
+      }
+    }
+
+    if (idle <= kMaxIdleProjects) {
+      break;
+    }
+
+    delete oldest->project;
+    projects_.erase(oldest);
+  }
+}
+
+void CLIRenderServer::UpdateProgress(Task *task, double progress)
+{
+  // Progress is queued from the task's thread, it may have finished in the meantime
+  auto it = task_jobs_.find(task);
+
+  if (it == task_jobs_.end()) {
+    return;
+  }
+
+  Job& job = jobs_[it.value()];
+  job.status = QStringLiteral("running");
+
+  if (progress - job.progress < kProgressInterval && progress < 1.0) {
+    return;
+  }
+
+  job.progress = progress;
+
+  if (job.client) {
+    QJsonObject message;
+    message.insert(QStringLiteral("event"), QStringLiteral("progress"));
+    message.insert(QStringLiteral("id"), job.id);
+    message.insert(QStringLiteral("progress"), progress);
+    Send(job.client, message);
+  }
+}
+
+void CLIRenderServer::FinishJob(Task *task, const QString &status)
+{
+  int id = task_jobs_.take(task);
+  Job& job = jobs_[id];
+
+  job.status = status;
+  job.task = nullptr;
+
+  if (status == QStringLiteral("done")) {
+    job.progress = 1.0;
+  } else if (status == QStringLiteral("failed")) {
+    job.error = task->GetError();
+  }
+
+  qInfo() << "Job" << id << status << job.error;
+
+  if (job.client) {
+    QJsonObject message = JobToJson(job);
+    message.insert(QStringLiteral("event"), status);
+    Send(job.client, message);
+  }
+
+  ReleaseProject(job.project);
+  job.project = nullptr;
+}
+
+void CLIRenderServer::TaskRemoved(Task *t)
+{
+  if (!task_jobs_.contains(t)) {
+    return;
+  }
+
+  // Also emitted for tasks cancelled before they started
+  FinishJob(t, t->IsCancelled() ? QStringLiteral("cancelled") : QStringLiteral("done"));
+}
+
+void CLIRenderServer::TaskFailed(Task *t)
+{
+  if (!task_jobs_.contains(t)) {
+    return;
+  }
+
+  FinishJob(t, t->IsCancelled() ? QStringLiteral("cancelled") : QStringLiteral("failed"));
+
+  // Nobody's going to look at it in a task panel, discard it now that it's no longer ours
+  TaskManager::instance()->CancelTask(t);
+}
+
+QJsonObject CLIRenderServer::JobToJson(const Job &job)
+{
+  QJsonObject o;
+  o.insert(QStringLiteral("id"), job.id);
+  o.insert(QStringLiteral("project"), job.project_filename);
+  o.insert(QStringLiteral("sequence"), job.sequence_name);
+  o.insert(QStringLiteral("filename"), job.output_filename);
+  o.insert(QStringLiteral("status"), job.status);
+  o.insert(QStringLiteral("progress"), job.progress);
+
+  if (!job.error.isEmpty()) {
+    o.insert(QStringLiteral("error"), job.error);
+  }
+
+  return o;
+}
+
+void CLIRenderServer::Send(QLocalSocket *client, const QJsonObject &message)
+{
+  client->write(QJsonDocument(message).toJson(QJsonDocument::Compact));
+  client->write("\n");
+}
+
+void CLIRenderServer::SendError(QLocalSocket *client, const QString &error)
+{
+  QJsonObject message;
+  message.insert(QStringLiteral("event"), QStringLiteral("error"));
+  message.insert(QStringLiteral("error"), error);
+  Send(client, message);
+}
+
+}
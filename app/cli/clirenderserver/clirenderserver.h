@@ -0,0 +1,156 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef CLIRENDERSERVER_H
+#define CLIRENDERSERVER_H
+
+#include <QDateTime>
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include "project/project.h"
+#include "task/export/exportparams.h"
+#include "task/task.h"
+
+namespace olive {
+
+/**
+ * @brief Persistent headless process that accepts export jobs over a local socket
+ *
+ * Run with `--render-server` and a socket name. Clients connect with QLocalSocket (a named pipe
+ * on Windows, a Unix domain socket elsewhere) and send one JSON object per line:
+ *
+ * - `{"command": "export", "project": <path>, "sequence": <name>, "params": <xml>}` queues an
+ *   export. `params` is an ExportParams `<export>` element as saved in render farm jobs, an
+ *   optional `"filename"` overrides its output file. Replies with `{"event": "queued", "id": <id>}`.
+ * - `{"command": "status"}` replies with the state and progress of every job.
+ * - `{"command": "cancel", "id": <id>}` cancels a job.
+ * - `{"command": "quit"}` cancels every job and exits.
+ *
+ * The client that submitted a job is sent `progress`, `done` and `failed` events for it. Errors
+ * are replied to with `{"event": "error", "error": <message>}`.
+ *
+ * Jobs run as ExportTasks through the TaskManager so they're scheduled like exports in the GUI.
+ * Since the process stays up, decoders, compiled shaders and color processors stay warm between
+ * jobs, as do the last few projects (reloaded if their file changes).
+ */
+class CLIRenderServer : public QObject
+{
+  Q_OBJECT
+public:
+  CLIRenderServer(const QString& name, QObject* parent = nullptr);
+
+  virtual ~CLIRenderServer() override;
+
+  /**
+   * @brief Start listening, returns FALSE if the socket couldn't be created
+   */
+  bool Start();
+
+private:
+  struct Job {
+    int id;
+    QString project_filename;
+    QString sequence_name;
+    QString output_filename;
+    QString status;
+    QString error;
+    double progress;
+    Project* project;
+    Task* task;
+    QLocalSocket* client;
+  };
+
+  struct LoadedProject {
+    Project* project;
+    QDateTime last_modified;
+    int users;
+    qint64 last_used;
+  };
+
+  void HandleCommand(QLocalSocket* client, const QJsonObject& command);
+
+  void SubmitJob(QLocalSocket* client, const QJsonObject& command);
+
+  /**
+   * @brief Get a loaded copy of the project at `filename`, loading it if necessary
+   *
+   * Every successful call must be balanced by ReleaseProject().
+   */
+  Project* AcquireProject(const QString& filename, QString* error);
+
+  void ReleaseProject(Project* project);
+
+  /**
+   * @brief Delete idle projects beyond kMaxIdleProjects, least recently used first
+   */
+  void PruneProjects();
+
+  void UpdateProgress(Task* task, double progress);
+
+  void FinishJob(Task* task, const QString& status);
+
+  static QJsonObject JobToJson(const Job& job);
+
+  static void Send(QLocalSocket* client, const QJsonObject& message);
+
+  static void SendError(QLocalSocket* client, const QString& error);
+
+  /**
+   * @brief Number of projects kept loaded while no job is using them
+   */
+  static const int kMaxIdleProjects;
+
+  /**
+   * @brief Minimum change in progress before another progress event is sent
+   */
+  static const double kProgressInterval;
+
+  QString name_;
+
+  QLocalServer server_;
+
+  QMap<int, Job> jobs_;
+
+  QHash<Task*, int> task_jobs_;
+
+  QHash<QString, LoadedProject> projects_;
+
+  int next_id_;
+
+  qint64 use_counter_;
+
+private slots:
+  void NewConnection();
+
+  void ReadCommands();
+
+  void ClientDisconnected();
+
+  void TaskRemoved(Task* t);
+
+  void TaskFailed(Task* t);
+
+};
+
+}
+
+#endif // CLIRENDERSERVER_H
@@ -0,0 +1,277 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "clistressproject.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include "node/block/clip/clip.h"
+#include "node/block/gap/gap.h"
+#include "node/factory.h"
+#include "node/generator/solid/solid.h"
+#include "node/math/merge/merge.h"
+#include "task/project/save/save.h"
+
+namespace olive {
+
+CLIStressProject::Params::Params() :
+  video_tracks(4),
+  audio_tracks(4),
+  blocks(100),
+  block_length(48),
+  gap_interval(10),
+  effects(3),
+  keyframes(16),
+  nesting(1)
+{
+}
+
+bool CLIStressProject::ParseParams(const QString &s, CLIStressProject::Params *params)
+{
+  QHash<QString, int*> keys;
+  keys.insert(QStringLiteral("video_tracks"), &params->video_tracks);
+  keys.insert(QStringLiteral("audio_tracks"), &params->audio_tracks);
+  keys.insert(QStringLiteral("blocks"), &params->blocks);
+  keys.insert(QStringLiteral("block_length"), &params->block_length);
+  keys.insert(QStringLiteral("gap_interval"), &params->gap_interval);
+  keys.insert(QStringLiteral("effects"), &params->effects);
+  keys.insert(QStringLiteral("keyframes"), &params->keyframes);
+  keys.insert(QStringLiteral("nesting"), &params->nesting);
+
+  foreach (const QString& pair, s.split(',')) {
+    if (pair.trimmed().isEmpty()) {
+      continue;
+    }
+
+    QStringList kv = pair.split('=');
+    bool ok = false;
+    int value = (kv.size() == 2) ? kv.at(1).trimmed().toInt(&ok) : 0;
+
+    if (!ok || value < 0) {
+      qCritical() << "Invalid stress project parameter" << pair;
+      return false;
+    }
+
+    int* target = keys.value(kv.at(0).trimmed());
+
+    if (!target) {
+      qCritical() << "Unknown stress project parameter" << kv.at(0) << "- expected one of" << keys.keys();
+      return false;
+    }
+
+    *target = value;
+  }
+
+  if (params->block_length < 1) {
+    qCritical() << "Stress project blocks must be at least one frame long";
+    return false;
+  }
+
+  return true;
+}
+
+int CLIStressProject::Run(const QString &filename, const CLIStressProject::Params &params)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  Project* project = Generate(params);
+  project->set_filename(filename);
+
+  Sequence* sequence = static_cast<Sequence*>(project->root()->item_child(0));
+  qInfo() << "Generated" << sequence->nodes().size() << "nodes in" << timer.elapsed() << "ms";
+
+  timer.start();
+
+  ProjectSaveTask save_task(project);
+  bool saved = save_task.Start();
+
+  if (saved) {
+    qInfo() << "Saved" << filename << "in" << timer.elapsed() << "ms";
+  } else {
+    qCritical() << "Failed to save stress project:" << save_task.GetError();
+  }
+
+  delete project;
+
+  return saved ? 0 : 1;
+}
+
+Project *CLIStressProject::Generate(const CLIStressProject::Params &params)
+{
+  Project* project = new Project();
+
+  Sequence* sequence = new Sequence();
+  sequence->set_name(QStringLiteral("Stress %1x%2x%3").arg(QString::number(params.video_tracks + params.audio_tracks),
+                                                           QString::number(params.blocks),
+                                                           QString::number(params.effects)));
+  sequence->set_default_parameters();
+  sequence->setParent(project->root());
+  sequence->add_default_nodes();
+
+  // add_default_nodes() made one track of each type already
+  for (int i=1; i<params.video_tracks; i++) {
+    sequence->viewer_output()->track_list(Timeline::kTrackTypeVideo)->AddTrack();
+  }
+
+  for (int i=1; i<params.audio_tracks; i++) {
+    sequence->viewer_output()->track_list(Timeline::kTrackTypeAudio)->AddTrack();
+  }
+
+  for (int i=0; i<params.video_tracks; i++) {
+    FillTrack(sequence, sequence->viewer_output()->track_list(Timeline::kTrackTypeVideo)->GetTrackAt(i), params, i);
+  }
+
+  for (int i=0; i<params.audio_tracks; i++) {
+    FillTrack(sequence, sequence->viewer_output()->track_list(Timeline::kTrackTypeAudio)->GetTrackAt(i), params, params.video_tracks + i);
+  }
+
+  return project;
+}
+
+void CLIStressProject::FillTrack(Sequence *sequence, TrackOutput *track, const CLIStressProject::Params &params, int track_index)
+{
+  rational length = sequence->video_params().time_base() * params.block_length;
+
+  for (int i=0; i<params.blocks; i++) {
+    // Offset each track's gaps so edits don't all line up
+    if (params.gap_interval > 0 && (i + track_index) % params.gap_interval == 0 && i > 0) {
+      GapBlock* gap = new GapBlock();
+      gap->set_length_and_media_out(length / 2);
+      sequence->AddNode(gap);
+      track->AppendBlock(gap);
+    }
+
+    ClipBlock* clip = new ClipBlock();
+    clip->set_length_and_media_out(length);
+    clip->SetLabel(QStringLiteral("Clip %1").arg(i));
+    sequence->AddNode(clip);
+    track->AppendBlock(clip);
+
+    Node* source = CreateClipSource(sequence, track->track_type(), params, length, track_index * params.blocks + i, params.nesting);
+    NodeParam::ConnectEdge(source->output(), clip->texture_input());
+  }
+}
+
+Node *CLIStressProject::CreateClipSource(Sequence *sequence, Timeline::TrackType type, const CLIStressProject::Params &params,
+                                         const rational &length, int seed, int nesting)
+{
+  if (type == Timeline::kTrackTypeAudio) {
+    static const QStringList kAudioEffects = {QStringLiteral("org.olivevideoeditor.Olive.volume"),
+                                              QStringLiteral("org.olivevideoeditor.Olive.pan")};
+
+    return CreateEffectChain(sequence, nullptr, kAudioEffects, params, length, seed);
+  }
+
+  static const QStringList kVideoEffects = {QStringLiteral("org.olivevideoeditor.Olive.transform"),
+                                            QStringLiteral("org.olivevideoeditor.Olive.blur"),
+                                            QStringLiteral("org.olivevideoeditor.Olive.mosaicfilter")};
+
+  SolidGenerator* solid = new SolidGenerator();
+  sequence->AddNode(solid);
+
+  Node* source = CreateEffectChain(sequence, solid, kVideoEffects, params, length, seed);
+
+  if (nesting > 0) {
+    MergeNode* merge = new MergeNode();
+    sequence->AddNode(merge);
+
+    NodeParam::ConnectEdge(source->output(), merge->base_in());
+
+    Node* blend = CreateClipSource(sequence, type, params, length, seed + 1, nesting - 1);
+    NodeParam::ConnectEdge(blend->output(), merge->blend_in());
+
+    source = merge;
+  }
+
+  return source;
+}
+
+Node *CLIStressProject::CreateEffectChain(Sequence *sequence, Node *source, const QStringList &effect_ids,
+                                          const CLIStressProject::Params &params, const rational &length, int seed)
+{
+  for (int i=0; i<params.effects; i++) {
+    Node* effect = NodeFactory::CreateFromID(effect_ids.at((seed + i) % effect_ids.size()));
+
+    if (!effect) {
+      continue;
+    }
+
+    sequence->AddNode(effect);
+
+    if (source) {
+      NodeInput* input = GetFirstInputOfType(effect, NodeParam::kTexture);
+
+      if (!input) {
+        input = GetFirstInputOfType(effect, NodeParam::kSamples);
+      }
+
+      if (input) {
+        NodeParam::ConnectEdge(source->output(), input);
+      }
+    }
+
+    NodeInput* animated = GetFirstInputOfType(effect, NodeParam::kFloat);
+
+    if (animated) {
+      AddKeyframes(animated, params.keyframes, length, seed + i);
+    }
+
+    source = effect;
+  }
+
+  return source;
+}
+
+void CLIStressProject::AddKeyframes(NodeInput *input, int count, const rational &length, int seed)
+{
+  if (count == 0) {
+    return;
+  }
+
+  input->set_is_keyframing(true);
+
+  for (int i=0; i<count; i++) {
+    rational time = (count > 1) ? length * i / (count - 1) : rational();
+
+    // Mix interpolation types so every branch of value lookup gets exercised
+    NodeKeyframe::Type type = static_cast<NodeKeyframe::Type>((seed + i) % 3);
+
+    input->insert_keyframe(NodeKeyframe::Create(time, double((seed + i) % 10), type, 0));
+  }
+}
+
+NodeInput *CLIStressProject::GetFirstInputOfType(Node *node, NodeParam::DataType type)
+{
+  foreach (NodeParam* param, node->parameters()) {
+    if (param->type() == NodeParam::kInput) {
+      NodeInput* input = static_cast<NodeInput*>(param);
+
+      if (input->data_type() == type) {
+        return input;
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+}
@@ -0,0 +1,109 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef CLISTRESSPROJECT_H
+#define CLISTRESSPROJECT_H
+
+#include "node/output/track/track.h"
+#include "project/item/sequence/sequence.h"
+#include "project/project.h"
+
+namespace olive {
+
+/**
+ * @brief Generates synthetic projects of a given size for scaling benchmarks
+ *
+ * Run with `--generate-stress-project` and an output file. The size of the project is set with
+ * `--stress-params`, a comma separated list of `key=value` pairs (see Params for the keys and
+ * their defaults). The project is built through the same Sequence, TrackOutput and NodeGraph
+ * calls the editor uses and saved as a normal project, so it can be opened, benchmarked with
+ * `--benchmark` or exported like any other.
+ *
+ * Every clip is a solid generator run through a chain of effects with keyframed parameters and
+ * nested merges of more of the same, audio clips get a chain of audio effects. Generation is
+ * deterministic so the same parameters always produce the same project.
+ */
+class CLIStressProject
+{
+public:
+  struct Params {
+    Params();
+
+    int video_tracks;
+    int audio_tracks;
+
+    /// Clips on each track
+    int blocks;
+
+    /// Length of each clip in frames
+    int block_length;
+
+    /// A gap is placed after every this many clips (0 for none)
+    int gap_interval;
+
+    /// Effect nodes chained onto each clip and each nested merge input
+    int effects;
+
+    /// Keyframes on one parameter of every effect
+    int keyframes;
+
+    /// Merges nested into each video clip
+    int nesting;
+  };
+
+  /**
+   * @brief Parse `key=value` pairs into `params`, returns FALSE on an unknown key or invalid value
+   */
+  static bool ParseParams(const QString& s, Params* params);
+
+  /**
+   * @brief Generate a project and save it to `filename`, returns a process exit code
+   */
+  static int Run(const QString& filename, const Params& params);
+
+  /**
+   * @brief Build a project in memory, caller takes ownership
+   */
+  static Project* Generate(const Params& params);
+
+private:
+  static void FillTrack(Sequence* sequence, TrackOutput* track, const Params& params, int track_index);
+
+  /**
+   * @brief Create the node graph feeding one clip, returns the node to connect to it
+   */
+  static Node* CreateClipSource(Sequence* sequence, Timeline::TrackType type, const Params& params,
+                                const rational& length, int seed, int nesting);
+
+  /**
+   * @brief Chain `count` effects onto `source`, returns the last one
+   */
+  static Node* CreateEffectChain(Sequence* sequence, Node* source, const QStringList& effect_ids,
+                                 const Params& params, const rational& length, int seed);
+
+  static void AddKeyframes(NodeInput* input, int count, const rational& length, int seed);
+
+  static NodeInput* GetFirstInputOfType(Node* node, NodeParam::DataType type);
+
+};
+
+}
+
+#endif // CLISTRESSPROJECT_H
@@ -0,0 +1,152 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#include "audioresampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <QtMath>
+
+#include "samplekernels.h"
+
+namespace olive {
+
+const int AudioResampler::kPhases = 256;
+const int AudioResampler::kBaseTaps = 32;
+const int AudioResampler::kMaxRatio = 8;
+
+AudioResampler::AudioResampler() :
+  position_(0)
+{
+}
+
+void AudioResampler::Process(const float * const *input, int input_count, int channels, float * const *output,
+                             int count, double ratio_start, double ratio_end)
+{
+  if (count <= 0) {
+    return;
+  }
+
+  const FilterBank& bank = GetFilterBank(qMax(ratio_start, ratio_end));
+  const int taps = bank.taps;
+  const int half = taps / 2;
+
+  edge_.resize(taps);
+
+  for (int k=0; k<count; k++) {
+    int i = qFloor(position_);
+    double phase = (position_ - i) * kPhases;
+    int p = qMin(static_cast<int>(phase), kPhases - 1);
+    float t = static_cast<float>(phase - p);
+
+    const float* c0 = bank.coefficients.constData() + p * taps;
+    const float* c1 = c0 + taps;
+
+    int start = i - (half - 1);
+    bool inside = (start >= 0 && start + taps <= input_count);
+
+    for (int ch=0; ch<channels; ch++) {
+      const float* src;
+
+      if (inside) {
+        src = input[ch] + start;
+      } else {
+        // Pad whatever part of the filter falls outside the input with silence
+        float* edge = edge_.data();
+        std::fill(edge, edge + taps, 0.0f);
+
+        int lo = qMax(start, 0);
+        int hi = qMin(start + taps, input_count);
+        if (hi > lo) {
+          memcpy(edge + (lo - start), input[ch] + lo, (hi - lo) * sizeof(float));
+        }
+
+        src = edge;
+      }
+
+      float d0 = SampleKernels::DotProduct(src, c0, taps);
+      float d1 = SampleKernels::DotProduct(src, c1, taps);
+
+      output[ch][k] = d0 + (d1 - d0) * t;
+    }
+
+    position_ += ratio_start + (ratio_end - ratio_start) * k / count;
+  }
+}
+
+const AudioResampler::FilterBank &AudioResampler::GetFilterBank(double ratio)
+{
+  // Banks are shared between ratios in steps of 1/8, rounding up so the cutoff is never too high
+  int key = qBound(8, qCeil(ratio * 8.0), kMaxRatio * 8);
+
+  QMap<int, FilterBank>::iterator it = banks_.find(key);
+
+  if (it == banks_.end()) {
+    it = banks_.insert(key, CreateFilterBank(key / 8.0));
+  }
+
+  return it.value();
+}
+
+AudioResampler::FilterBank AudioResampler::CreateFilterBank(double ratio)
+{
+  FilterBank bank;
+
+  // Slightly below Nyquist so the transition band doesn't fold back, and lowered further when
+  // reading faster than the input rate
+  double cutoff = 0.95 / ratio;
+
+  // Kept a multiple of 8 so the dot products don't end in a scalar tail
+  bank.taps = qCeil(kBaseTaps * ratio / 8.0) * 8;
+  int half = bank.taps / 2;
+
+  bank.coefficients.resize((kPhases + 1) * bank.taps);
+
+  for (int p=0; p<=kPhases; p++) {
+    double frac = static_cast<double>(p) / kPhases;
+    float* row = bank.coefficients.data() + p * bank.taps;
+    double sum = 0;
+
+    for (int j=0; j<bank.taps; j++) {
+      // Distance in input samples from the read position to this tap
+      double x = j - (half - 1) - frac;
+
+      double sinc_arg = M_PI * cutoff * x;
+      double sinc = qFuzzyIsNull(sinc_arg) ? 1.0 : std::sin(sinc_arg) / sinc_arg;
+
+      double w = x / half;
+      double window = 0.42 + 0.5 * std::cos(M_PI * w) + 0.08 * std::cos(2.0 * M_PI * w);
+
+      double c = cutoff * sinc * window;
+
+      row[j] = static_cast<float>(c);
+      sum += c;
+    }
+
+    // Normalize each phase to unity gain so there's no ripple in level between phases
+    for (int j=0; j<bank.taps; j++) {
+      row[j] = static_cast<float>(row[j] / sum);
+    }
+  }
+
+  return bank;
+}
+
+}
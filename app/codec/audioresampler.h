@@ -0,0 +1,113 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#ifndef AUDIORESAMPLER_H
+#define AUDIORESAMPLER_H
+
+#include <QMap>
+#include <QVector>
+
+#include "common/define.h"
+
+namespace olive {
+
+/**
+ * @brief Polyphase windowed-sinc resampler for changing the speed of planar float audio
+ *
+ * Each output sample is read from a fractional position in the input by convolving the input with
+ * a Blackman windowed sinc. The sinc is precomputed at kPhases offsets between two samples and
+ * the two nearest are interpolated, so the inner loop is two SampleKernels::DotProduct() calls
+ * per output sample.
+ *
+ * The ratio (input samples advanced per output sample) may ramp across a call, which is how
+ * keyframed speed is rendered. When the ratio is above 1, the filter's cutoff is lowered and its
+ * length widened to match so sped up audio doesn't alias. Filter banks are cached per ratio in
+ * steps of 1/8.
+ *
+ * The read position carries over between calls, so a buffer can be resampled in several calls with
+ * different ratios and the result is seamless. Input outside the buffer reads as silence.
+ */
+class AudioResampler
+{
+public:
+  AudioResampler();
+
+  DISABLE_COPY_MOVE(AudioResampler)
+
+  /**
+   * @brief The input position that the next output sample will be read from
+   */
+  double position() const
+  {
+    return position_;
+  }
+
+  void SetPosition(double p)
+  {
+    position_ = p;
+  }
+
+  /**
+   * @brief Resample `count` samples into each of `channels` planes of `output`
+   *
+   * `input` holds `input_count` samples per channel. The ratio starts at `ratio_start` and ramps
+   * linearly to `ratio_end` over the output.
+   */
+  void Process(const float* const* input, int input_count, int channels, float* const* output,
+               int count, double ratio_start, double ratio_end);
+
+  /**
+   * @brief Number of filter phases between two input samples
+   */
+  static const int kPhases;
+
+private:
+  struct FilterBank {
+    int taps;
+
+    /// kPhases + 1 rows of `taps` coefficients
+    QVector<float> coefficients;
+  };
+
+  const FilterBank& GetFilterBank(double ratio);
+
+  static FilterBank CreateFilterBank(double ratio);
+
+  /**
+   * @brief Number of taps used when the ratio is at or below 1
+   */
+  static const int kBaseTaps;
+
+  /**
+   * @brief Filters stop widening past this ratio to keep their length bounded
+   */
+  static const int kMaxRatio;
+
+  QMap<int, FilterBank> banks_;
+
+  double position_;
+
+  /// Scratch for reading around the edges of the input
+  QVector<float> edge_;
+
+};
+
+}
+
+#endif // AUDIORESAMPLER_H
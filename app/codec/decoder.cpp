@@ -21,16 +21,21 @@
 #include "decoder.h"
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDebug>
+#include <QDir>
+#include <QFile>
 #include <QFileInfo>
 
 #include "codec/ffmpeg/ffmpegdecoder.h"
 #include "codec/oiio/oiiodecoder.h"
-#include "codec/waveinput.h"
-#include "codec/waveoutput.h"
 #include "common/ffmpegutils.h"
 #include "common/filefunctions.h"
+#include "common/lockprofiler.h"
 #include "common/timecodefunctions.h"
+#include "common/xmlutils.h"
+#include "core.h"
 #ifdef USE_OTIO
 #include "task/project/loadotio/loadotio.h"
 #endif
@@ -42,19 +47,27 @@ namespace olive {
 QMutex Decoder::currently_conforming_mutex_;
 QWaitCondition Decoder::currently_conforming_wait_cond_;
 QVector<Decoder::CurrentlyConforming> Decoder::currently_conforming_;
+const int64_t Decoder::kRetrievalCostSeek = INT64_MAX;
+const int Decoder::kMaxAudioBlocks = 16;
+QMutex Decoder::probe_cache_mutex_;
+QHash<QString, Decoder::ProbeCacheEntry> Decoder::probe_cache_;
+const quint32 Decoder::kProbeCacheMagic = 0x4F505243; // "OPRC"
+const quint32 Decoder::kProbeCacheFormatVersion = 1;
 
 Decoder::Decoder() :
-  stream_(nullptr)
+  stream_(nullptr),
+  proxy_(false),
+  conform_(nullptr)
 {
 }
 
-bool Decoder::Open(Stream *fs)
+bool Decoder::Open(Stream *fs, bool proxy)
 {
   QMutexLocker locker(&mutex_);
 
   if (stream_) {
     // Decoder is already open. Return TRUE if the stream is the stream we have, or FALSE if not.
-    if (stream_ == fs) {
+    if (stream_ == fs && proxy_ == proxy) {
       return true;
     } else {
       qWarning() << "Tried to open a decoder that was already open with another stream";
@@ -68,13 +81,19 @@ bool Decoder::Open(Stream *fs)
       return false;
     }
 
-    if (fs->footage()->decoder() != id()) {
+    if (proxy) {
+      if (fs->type() != Stream::kVideo || !static_cast<VideoStream*>(fs)->has_proxy()) {
+        qCritical() << "Tried to open proxy of a stream that has none";
+        return false;
+      }
+    } else if (fs->footage()->decoder() != id()) {
       qCritical() << "Tried to open footage in incorrect decoder";
       return false;
     }
 
     // Set stream
     stream_ = fs;
+    proxy_ = proxy;
 
     // Try open internal
     if (OpenInternal()) {
@@ -88,9 +107,9 @@ bool Decoder::Open(Stream *fs)
   }
 }
 
-FramePtr Decoder::RetrieveVideo(const rational &timecode, const int &divider)
+FramePtr Decoder::RetrieveVideo(const rational &timecode, const int &divider, const QAtomicInt *cancelled, bool best_effort)
 {
-  QMutexLocker locker(&mutex_);
+  ProfiledMutexLocker locker(&mutex_, LockProfiler::kDecoder);
 
   if (!stream_) {
     qCritical() << "Can't retrieve video on a closed decoder";
@@ -107,12 +126,16 @@ FramePtr Decoder::RetrieveVideo(const rational &timecode, const int &divider)
     return nullptr;
   }
 
-  return RetrieveVideoInternal(timecode, divider);
+  if (best_effort) {
+    return RetrieveVideoBestEffortInternal(timecode, divider, cancelled);
+  }
+
+  return RetrieveVideoInternal(timecode, divider, cancelled);
 }
 
 SampleBufferPtr Decoder::RetrieveAudio(const TimeRange &range, const AudioParams &params, const QAtomicInt *cancelled)
 {
-  QMutexLocker locker(&mutex_);
+  ProfiledMutexLocker locker(&mutex_, LockProfiler::kDecoder);
 
   if (!stream_) {
     qCritical() << "Can't retrieve audio on a closed decoder";
@@ -133,6 +156,25 @@ SampleBufferPtr Decoder::RetrieveAudio(const TimeRange &range, const AudioParams
   QString conform_filename = GetConformedFilename(params);
   CurrentlyConforming want_conform = {stream_, params};
 
+  if (CanRetrieveAudioDirectlyInternal()) {
+    // A conform made earlier is still used since it's already resampled, but there's no reason to
+    // wait for or start one
+    currently_conforming_mutex_.lock();
+
+    SampleBufferPtr buffer;
+    if (!currently_conforming_.contains(want_conform)) {
+      buffer = RetrieveAudioFromConform(conform_filename, range);
+    }
+
+    currently_conforming_mutex_.unlock();
+
+    if (!buffer) {
+      buffer = RetrieveAudioDirect(range, params, cancelled);
+    }
+
+    return buffer;
+  }
+
   currently_conforming_mutex_.lock();
 
   // Wait for conform to complete
@@ -143,36 +185,127 @@ SampleBufferPtr Decoder::RetrieveAudio(const TimeRange &range, const AudioParams
   // See if we got the conform
   SampleBufferPtr buffer = RetrieveAudioFromConform(conform_filename, range);
 
+  currently_conforming_mutex_.unlock();
+
   if (!buffer) {
-    // We'll need to conform this ourselves
-    currently_conforming_.append(want_conform);
+    // We'll need to conform this ourselves. Every other audio stream in the file will need it
+    // too, and reading them all now saves demuxing the whole file again for each one.
+    QVector<Stream*> streams;
+    streams.append(stream_);
+
+    foreach (Stream* s, stream_->footage()->streams()) {
+      if (s != stream_ && s->type() == Stream::kAudio && s->enabled()) {
+        streams.append(s);
+      }
+    }
+
+    if (!ConformAudioLocked(streams, params, cancelled)) {
+      qCritical() << "Failed to conform audio";
+    }
+
+    // Our stream may have been taken by someone else in the meantime, in which case wait for them
+    currently_conforming_mutex_.lock();
+
+    while (currently_conforming_.contains(want_conform)) {
+      currently_conforming_wait_cond_.wait(&currently_conforming_mutex_);
+    }
+
+    buffer = RetrieveAudioFromConform(conform_filename, range);
+
     currently_conforming_mutex_.unlock();
+  }
+
+  return buffer;
+}
+
+bool Decoder::ConformAudio(const QVector<Stream *> &streams, const AudioParams &params, const QAtomicInt *cancelled)
+{
+  QMutexLocker locker(&mutex_);
+
+  if (!stream_) {
+    qCritical() << "Can't conform audio on a closed decoder";
+    return false;
+  }
+
+  return ConformAudioLocked(streams, params, cancelled);
+}
+
+bool Decoder::ConformAudioLocked(const QVector<Stream *> &streams, const AudioParams &params, const QAtomicInt *cancelled)
+{
+  QVector<Stream*> to_conform;
+  QStringList working_filenames;
+
+  currently_conforming_mutex_.lock();
+
+  foreach (Stream* s, streams) {
+    if (s->type() != Stream::kAudio || s->footage() != stream_->footage()) {
+      qWarning() << "Tried to conform a stream that isn't audio from this decoder's file";
+      continue;
+    }
+
+    CurrentlyConforming c = {s, params};
+
+    if (currently_conforming_.contains(c)) {
+      continue;
+    }
+
+    // Existing conforms are only skipped if they're still readable by this version
+    QString conform_filename = GetConformedFilename(s, params);
+    PlanarAudioInput existing(conform_filename);
+
+    if (existing.open()) {
+      existing.close();
+      continue;
+    }
+
+    currently_conforming_.append(c);
+    to_conform.append(s);
 
     // We conform to a different filename until it's done to make it clear even across sessions
     // whether this conform is ready or not
-    QString working_fn = conform_filename;
-    working_fn.append(QStringLiteral(".working"));
+    working_filenames.append(conform_filename + QStringLiteral(".working"));
+  }
+
+  currently_conforming_mutex_.unlock();
+
+  if (to_conform.isEmpty()) {
+    return true;
+  }
+
+  bool success = ConformAudioStreamsInternal(to_conform, working_filenames, params, cancelled);
+
+  currently_conforming_mutex_.lock();
 
-    if (ConformAudioInternal(working_fn, params, cancelled)) {
+  for (int i=0; i<to_conform.size(); i++) {
+    const QString& working_fn = working_filenames.at(i);
+
+    if (success) {
       // Move file to standard conform name, making it clear this conform is ready for use
+      QString conform_filename = GetConformedFilename(to_conform.at(i), params);
       QFile::remove(conform_filename);
       QFile::rename(working_fn, conform_filename);
-
-      // Return audio as planned
-      buffer = RetrieveAudioFromConform(conform_filename, range);
     } else {
-      // Failed
-      qCritical() << "Failed to conform audio";
+      QFile::remove(working_fn);
     }
 
-    currently_conforming_mutex_.lock();
-    currently_conforming_.removeOne(want_conform);
-    currently_conforming_wait_cond_.wakeAll();
+    currently_conforming_.removeOne({to_conform.at(i), params});
   }
 
+  currently_conforming_wait_cond_.wakeAll();
   currently_conforming_mutex_.unlock();
 
-  return buffer;
+  return success;
+}
+
+int64_t Decoder::GetRetrievalCost(const rational &timecode)
+{
+  ProfiledMutexLocker locker(&mutex_, LockProfiler::kDecoder);
+
+  if (!stream_) {
+    return kRetrievalCostSeek;
+  }
+
+  return GetRetrievalCostInternal(timecode);
 }
 
 void Decoder::Close()
@@ -180,6 +313,11 @@ void Decoder::Close()
   QMutexLocker locker(&mutex_);
 
   if (stream_) {
+    delete conform_;
+    conform_ = nullptr;
+
+    audio_blocks_.clear();
+
     CloseInternal();
     stream_ = nullptr;
   } else {
@@ -211,12 +349,23 @@ Footage* Decoder::Probe(Project* project, const QString &filename, const QAtomic
     return nullptr;
   }
 
+  QFileInfo file_info(filename);
+
   // Check file exists
-  if (!QFileInfo::exists(filename)) {
+  if (!file_info.exists()) {
     qWarning() << "Tried to probe file that doesn't exist:" << filename;
     return nullptr;
   }
 
+  // If this exact file was probed before, rebuild the result rather than probing again
+  Footage* cached = LoadFromProbeCache(file_info, cancelled);
+
+  if (cached) {
+    cached->set_project(project);
+    cached->SetValid();
+    return cached;
+  }
+
   // Create list to iterate through
   QVector<DecoderPtr> decoder_list = ReceiveListOfAllDecoders();
 
@@ -232,7 +381,6 @@ Footage* Decoder::Probe(Project* project, const QString &filename, const QAtomic
     Footage* footage = decoder->Probe(filename, cancelled);
 
     if (footage) {
-      QFileInfo file_info(filename);
       footage->set_name(file_info.fileName());
       footage->set_filename(filename);
 
@@ -242,7 +390,7 @@ Footage* Decoder::Probe(Project* project, const QString &filename, const QAtomic
 
       footage->SetValid();
 
-      // FIXME: Cache the results so we don't have to probe if this media is added a second time
+      AddToProbeCache(file_info, footage);
 
       return footage;
     }
@@ -252,6 +400,205 @@ Footage* Decoder::Probe(Project* project, const QString &filename, const QAtomic
   return nullptr;
 }
 
+Footage *Decoder::LoadFromProbeCache(const QFileInfo &file_info, const QAtomicInt *cancelled)
+{
+  QString path = file_info.absoluteFilePath();
+  ProbeCacheEntry entry;
+
+  {
+    QMutexLocker locker(&probe_cache_mutex_);
+
+    auto it = probe_cache_.constFind(path);
+
+    if (it == probe_cache_.constEnd()) {
+      // Not probed this session, see if it was in a previous one
+      QString cached_path;
+
+      if (!ReadProbeCacheFile(GetProbeCacheFilename(path), &cached_path, &entry) || cached_path != path) {
+        return nullptr;
+      }
+
+      probe_cache_.insert(path, entry);
+    } else {
+      entry = *it;
+    }
+  }
+
+  if (entry.timestamp != file_info.lastModified().toMSecsSinceEpoch()
+      || entry.size != file_info.size()) {
+    return nullptr;
+  }
+
+  const QByteArray& serialized = entry.footage;
+
+  QXmlStreamReader reader(serialized);
+
+  if (!XMLReadNextStartElement(&reader) || reader.name() != QStringLiteral("footage")) {
+    return nullptr;
+  }
+
+  Footage* footage = new Footage();
+  XMLNodeData xml_node_data;
+  footage->Load(&reader, xml_node_data, Core::kProjectVersion, cancelled);
+
+  if (reader.hasError() || footage->streams().isEmpty()) {
+    delete footage;
+    return nullptr;
+  }
+
+  return footage;
+}
+
+void Decoder::AddToProbeCache(const QFileInfo &file_info, Footage *footage)
+{
+  QByteArray serialized;
+
+  {
+    QXmlStreamWriter writer(&serialized);
+    writer.writeStartElement(QStringLiteral("footage"));
+    footage->Save(&writer);
+    writer.writeEndElement(); // footage
+  }
+
+  ProbeCacheEntry entry = {file_info.lastModified().toMSecsSinceEpoch(), file_info.size(), serialized};
+
+  QMutexLocker locker(&probe_cache_mutex_);
+
+  probe_cache_.insert(file_info.absoluteFilePath(), entry);
+
+  WriteProbeCacheFile(file_info.absoluteFilePath(), entry);
+}
+
+void Decoder::RevalidateProbeCache()
+{
+  QDir dir(GetProbeCacheDirectory());
+
+  QStringList entries = dir.entryList({QStringLiteral("*.probe")}, QDir::Files);
+
+  int removed = 0;
+
+  foreach (const QString& e, entries) {
+    QString cache_filename = dir.filePath(e);
+    QString path;
+    ProbeCacheEntry entry;
+
+    bool valid = ReadProbeCacheFile(cache_filename, &path, &entry);
+
+    if (valid) {
+      QFileInfo info(path);
+
+      valid = info.exists()
+          && info.lastModified().toMSecsSinceEpoch() == entry.timestamp
+          && info.size() == entry.size;
+    }
+
+    if (!valid) {
+      QMutexLocker locker(&probe_cache_mutex_);
+
+      QFile::remove(cache_filename);
+
+      if (!path.isEmpty()) {
+        probe_cache_.remove(path);
+      }
+
+      removed++;
+    }
+  }
+
+  if (removed) {
+    qInfo() << "Removed" << removed << "stale probe cache entries";
+  }
+}
+
+QString Decoder::GetProbeCacheDirectory()
+{
+  return QDir(FileFunctions::GetConfigurationLocation()).filePath(QStringLiteral("probecache"));
+}
+
+QString Decoder::GetProbeCacheFilename(const QString &absolute_path)
+{
+  QByteArray hash = QCryptographicHash::hash(absolute_path.toUtf8(), QCryptographicHash::Sha1);
+
+  return QDir(GetProbeCacheDirectory()).filePath(QString::fromLatin1(hash.toHex()).append(QStringLiteral(".probe")));
+}
+
+const QString &Decoder::GetProbeCacheVersion()
+{
+  static QString version;
+  static QMutex version_mutex;
+
+  QMutexLocker locker(&version_mutex);
+
+  if (version.isEmpty()) {
+    QStringList parts;
+
+    foreach (DecoderPtr d, ReceiveListOfAllDecoders()) {
+      parts.append(QStringLiteral("%1:%2").arg(d->id(), d->version()));
+    }
+
+    version = parts.join(';');
+  }
+
+  return version;
+}
+
+bool Decoder::ReadProbeCacheFile(const QString &cache_filename, QString *path, ProbeCacheEntry *entry)
+{
+  QFile f(cache_filename);
+
+  if (!f.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  QDataStream ds(&f);
+
+  quint32 magic, format_version;
+  QString decoder_version;
+
+  ds >> magic >> format_version;
+
+  if (magic != kProbeCacheMagic || format_version != kProbeCacheFormatVersion) {
+    return false;
+  }
+
+  ds >> decoder_version >> *path >> entry->timestamp >> entry->size >> entry->footage;
+
+  return ds.status() == QDataStream::Ok && decoder_version == GetProbeCacheVersion();
+}
+
+void Decoder::WriteProbeCacheFile(const QString &absolute_path, const ProbeCacheEntry &entry)
+{
+  if (!FileFunctions::DirectoryIsValid(GetProbeCacheDirectory(), true)) {
+    return;
+  }
+
+  QString cache_filename = GetProbeCacheFilename(absolute_path);
+  QString temp_filename = FileFunctions::GetSafeTemporaryFilename(cache_filename);
+
+  QFile f(temp_filename);
+
+  if (!f.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to write probe cache entry" << cache_filename;
+    return;
+  }
+
+  QDataStream ds(&f);
+
+  ds << kProbeCacheMagic << kProbeCacheFormatVersion << GetProbeCacheVersion()
+     << absolute_path << entry.timestamp << entry.size << entry.footage;
+
+  f.close();
+
+  if (ds.status() != QDataStream::Ok) {
+    QFile::remove(temp_filename);
+    return;
+  }
+
+  // Write to a temporary file first so a concurrent read never sees half an entry
+  QFile::remove(cache_filename);
+  QFile::rename(temp_filename, cache_filename);
+}
+
 DecoderPtr Decoder::CreateFromID(const QString &id)
 {
   if (id.isEmpty()) {
@@ -272,7 +619,12 @@ DecoderPtr Decoder::CreateFromID(const QString &id)
 
 QString Decoder::GetConformedFilename(const AudioParams &params)
 {
-  QString index_fn = GetIndexFilename();
+  return GetConformedFilename(stream_, params);
+}
+
+QString Decoder::GetConformedFilename(Stream *stream, const AudioParams &params) const
+{
+  QString index_fn = GetCacheFilename(stream, proxy_ ? QStringLiteral(".proxy") : QString());
 
   index_fn.append('.');
   index_fn.append(QString::number(params.sample_rate()));
@@ -286,7 +638,31 @@ QString Decoder::GetConformedFilename(const AudioParams &params)
 
 QString Decoder::GetIndexFilename()
 {
-  return QDir(stream_->footage()->project()->cache_path()).filePath(FileFunctions::GetUniqueFileIdentifier(stream()->footage()->filename()).append(QString::number(stream()->index())));
+  return GetCacheFilename(stream_, proxy_ ? QStringLiteral(".proxy") : QString());
+}
+
+QString Decoder::GetCacheFilename(Stream *stream, const QString &suffix)
+{
+  QString fn = QDir(stream->footage()->project()->cache_path()).filePath(FileFunctions::GetUniqueFileIdentifier(stream->footage()->filename()).append(QString::number(stream->index())));
+
+  fn.append(suffix);
+
+  return fn;
+}
+
+QString Decoder::filename() const
+{
+  if (proxy_) {
+    return static_cast<VideoStream*>(stream_)->proxy_filename();
+  }
+
+  return stream_->footage()->filename();
+}
+
+int Decoder::stream_index() const
+{
+  // Proxies only ever contain the one stream
+  return proxy_ ? 0 : stream_->index();
 }
 
 void Decoder::SignalProcessingProgress(const int64_t &ts)
@@ -341,13 +717,25 @@ int64_t Decoder::GetImageSequenceIndex(const QString &filename)
   return number_only.toLongLong();
 }
 
-FramePtr Decoder::RetrieveVideoInternal(const rational &timecode, const int &divider)
+FramePtr Decoder::RetrieveVideoInternal(const rational &timecode, const int &divider, const QAtomicInt *cancelled)
 {
   Q_UNUSED(timecode)
   Q_UNUSED(divider)
+  Q_UNUSED(cancelled)
   return nullptr;
 }
 
+FramePtr Decoder::RetrieveVideoBestEffortInternal(const rational &timecode, const int &divider, const QAtomicInt *cancelled)
+{
+  return RetrieveVideoInternal(timecode, divider, cancelled);
+}
+
+int64_t Decoder::GetRetrievalCostInternal(const rational &timecode)
+{
+  Q_UNUSED(timecode)
+  return kRetrievalCostSeek;
+}
+
 bool Decoder::ConformAudioInternal(const QString& filename, const AudioParams &params, const QAtomicInt* cancelled)
 {
   Q_UNUSED(filename)
@@ -356,25 +744,137 @@ bool Decoder::ConformAudioInternal(const QString& filename, const AudioParams &p
   return false;
 }
 
-SampleBufferPtr Decoder::RetrieveAudioFromConform(const QString &conform_filename, const TimeRange& range)
+bool Decoder::ConformAudioStreamsInternal(const QVector<Stream *> &streams, const QStringList &filenames,
+                                          const AudioParams &params, const QAtomicInt *cancelled)
 {
-  WaveInput input(conform_filename);
+  for (int i=0; i<streams.size(); i++) {
+    if (cancelled && *cancelled) {
+      return false;
+    }
+
+    if (streams.at(i) == stream_) {
+      if (!ConformAudioInternal(filenames.at(i), params, cancelled)) {
+        return false;
+      }
 
-  if (input.open()) {
-    const AudioParams& input_params = input.params();
+      continue;
+    }
+
+    // Other streams get a decoder of their own
+    DecoderPtr other = CreateFromID(id());
+
+    if (!other || !other->Open(streams.at(i), proxy_)) {
+      return false;
+    }
 
-    // Read bytes from wav
-    QByteArray packed_data = input.read(input_params.time_to_bytes(range.in()),
-                                        input_params.time_to_bytes(range.length()));
-    input.close();
+    bool success = other->ConformAudioInternal(filenames.at(i), params, cancelled);
 
-    // Create sample buffer
-    SampleBufferPtr sample_buffer = SampleBuffer::CreateFromPackedData(input_params, packed_data);
+    other->Close();
 
-    return sample_buffer;
+    if (!success) {
+      return false;
+    }
   }
 
+  return true;
+}
+
+bool Decoder::CanRetrieveAudioDirectlyInternal()
+{
+  return false;
+}
+
+SampleBufferPtr Decoder::RetrieveAudioDirectInternal(qint64 start, int count, const AudioParams &params, const QAtomicInt *cancelled)
+{
+  Q_UNUSED(start)
+  Q_UNUSED(count)
+  Q_UNUSED(params)
+  Q_UNUSED(cancelled)
+
   return nullptr;
 }
 
+SampleBufferPtr Decoder::RetrieveAudioDirect(const TimeRange &range, const AudioParams &params, const QAtomicInt *cancelled)
+{
+  if (audio_blocks_params_ != params) {
+    audio_blocks_.clear();
+    audio_blocks_params_ = params;
+  }
+
+  qint64 start = params.time_to_samples(range.in());
+  int count = static_cast<int>(params.time_to_samples(range.length()));
+
+  if (count <= 0) {
+    SampleBufferPtr empty = SampleBuffer::Create();
+    empty->set_audio_params(params);
+    return empty;
+  }
+
+  SampleBufferPtr output = SampleBuffer::CreateAllocated(params, count);
+
+  qint64 end = start + count;
+  qint64 block_size = params.sample_rate();
+  qint64 first_block = (start >= 0) ? start / block_size : (start - block_size + 1) / block_size;
+
+  QVector<const float*> planes(params.channel_count());
+
+  for (qint64 b=first_block; b*block_size<end; b++) {
+    SampleBufferPtr block;
+
+    for (int i=0; i<audio_blocks_.size(); i++) {
+      if (audio_blocks_.at(i).index == b) {
+        block = audio_blocks_.at(i).samples;
+        audio_blocks_.move(i, 0);
+        break;
+      }
+    }
+
+    if (!block) {
+      block = RetrieveAudioDirectInternal(b * block_size, static_cast<int>(block_size), params, cancelled);
+
+      if (!block) {
+        return nullptr;
+      }
+
+      audio_blocks_.prepend({b, block});
+
+      while (audio_blocks_.size() > kMaxAudioBlocks) {
+        audio_blocks_.removeLast();
+      }
+    }
+
+    qint64 block_start = b * block_size;
+    qint64 copy_start = qMax(start, block_start);
+    qint64 copy_end = qMin(end, block_start + block_size);
+
+    for (int i=0; i<planes.size(); i++) {
+      planes[i] = block->const_data()[i] + (copy_start - block_start);
+    }
+
+    output->set(planes.data(), static_cast<int>(copy_start - start), static_cast<int>(copy_end - copy_start));
+  }
+
+  return output;
+}
+
+SampleBufferPtr Decoder::RetrieveAudioFromConform(const QString &conform_filename, const TimeRange& range)
+{
+  if (!conform_ || conform_->filename() != conform_filename) {
+    delete conform_;
+    conform_ = new PlanarAudioInput(conform_filename);
+  }
+
+  if (!conform_->open()) {
+    // Doesn't exist yet or was written by an older version, either way it'll need conforming
+    delete conform_;
+    conform_ = nullptr;
+    return nullptr;
+  }
+
+  const AudioParams& input_params = conform_->params();
+
+  return conform_->read(input_params.time_to_samples(range.in()),
+                        input_params.time_to_samples(range.length()));
+}
+
 }
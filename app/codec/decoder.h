@@ -25,12 +25,15 @@ extern "C" {
 #include <libswresample/swresample.h>
 }
 
+#include <QFileInfo>
+#include <QHash>
 #include <QMutex>
 #include <QObject>
 #include <QWaitCondition>
 #include <stdint.h>
 
 #include "codec/frame.h"
+#include "codec/planaraudio.h"
 #include "codec/samplebuffer.h"
 #include "codec/waveoutput.h"
 #include "common/rational.h"
@@ -74,6 +77,14 @@ public:
    */
   virtual QString id() = 0;
 
+  /**
+   * @brief Version of the decoder and the library behind it
+   *
+   * Cached probe results are discarded when this changes since a newer version may probe the
+   * same file differently.
+   */
+  virtual QString version(){return QString();}
+
   virtual bool SupportsVideo(){return false;}
   virtual bool SupportsAudio(){return false;}
 
@@ -86,7 +97,7 @@ public:
    * already open and the stream == the stream provided. Returns FALSE if the stream couldn't
    * be opened OR if already open and the stream is NOT the same.
    */
-  bool Open(Stream* fs);
+  bool Open(Stream* fs, bool proxy = false);
 
   /**
    * @brief Retrieves a video frame from footage
@@ -96,9 +107,15 @@ public:
    * return the first frame. Likewise, if it is after the timecode, this function should return the
    * last frame.
    *
+   * If `cancelled` is set while retrieving, this returns nullptr as soon as possible.
+   *
+   * If `best_effort` is TRUE, the decoder may return a nearby frame it can provide much faster
+   * than the exact one (e.g. the keyframe before it), which is useful while scrubbing.
+   *
    * This function is thread safe and can only run while the decoder is open. \see Open()
    */
-  FramePtr RetrieveVideo(const rational& timecode, const int& divider);
+  FramePtr RetrieveVideo(const rational& timecode, const int& divider, const QAtomicInt* cancelled = nullptr,
+                         bool best_effort = false);
 
   /**
    * @brief Retrieve audio data from footage
@@ -106,10 +123,54 @@ public:
    * This function will always return a sample buffer unless a fatal error occurs (in such case,
    * nullptr will return). The SampleBuffer should always have enough audio for the range provided.
    *
+   * Audio is read from a conform of the stream to `params`, which is made first if it doesn't exist
+   * yet, unless the decoder can serve it directly from the source (see
+   * CanRetrieveAudioDirectlyInternal()).
+   *
    * This function is thread safe and can only run while the decoder is open. \see Open()
    */
   SampleBufferPtr RetrieveAudio(const TimeRange& range, const AudioParams& params, const QAtomicInt *cancelled);
 
+  /**
+   * @brief Conform several audio streams of the open file to `params` at once
+   *
+   * Every stream must belong to the same footage as the stream this decoder was opened on.
+   * Streams that are already conformed, or being conformed elsewhere, are skipped. The rest are
+   * read in a single pass over the file where the decoder supports it (see
+   * ConformAudioStreamsInternal()).
+   *
+   * RetrieveAudio() does this automatically for every audio stream in the file the first time any
+   * of them needs conforming.
+   *
+   * This function is thread safe and can only run while the decoder is open. \see Open()
+   */
+  bool ConformAudio(const QVector<Stream*>& streams, const AudioParams& params, const QAtomicInt* cancelled);
+
+  /**
+   * @brief Cost returned by GetRetrievalCost() when a retrieval will require a seek
+   */
+  static const int64_t kRetrievalCostSeek;
+
+  /**
+   * @brief Estimate how much work it would take to retrieve the video frame at `timecode`
+   *
+   * Used by DecoderPool to route a request to the instance that is already positioned closest to
+   * it. 0 means the frame is already cached, kRetrievalCostSeek means a seek is required, and
+   * values in between are roughly the number of frames that would have to be decoded. Costs are
+   * only comparable between decoders of the same stream.
+   *
+   * This function is thread safe and can only run while the decoder is open. \see Open()
+   */
+  int64_t GetRetrievalCost(const rational& timecode);
+
+  /**
+   * @brief Get a filename for data derived from this stream in its project's cache
+   *
+   * Used for the stream's indexes and conforms as well as anything else precomputed from it, such
+   * as waveforms and thumbnails. `suffix` is appended to distinguish each kind of file.
+   */
+  static QString GetCacheFilename(Stream* stream, const QString& suffix = QString());
+
   /**
    * @brief Try to probe a Footage file by passing it through all available Decoders
    *
@@ -131,6 +192,13 @@ public:
    */
   static Footage *Probe(Project *project, const QString& filename, const QAtomicInt *cancelled);
 
+  /**
+   * @brief Remove persistent probe cache entries for files that have changed or no longer exist
+   *
+   * This stats every cached file so it should be run in a background thread.
+   */
+  static void RevalidateProbeCache();
+
   /**
    * @brief Generate a Footage object from a file
    *
@@ -167,6 +235,17 @@ public:
   static int64_t GetImageSequenceIndex(const QString& filename);
 
 protected:
+  /**
+   * @brief The mutex held during every call to the public API
+   *
+   * Sub-classes doing work on their own threads can lock this to safely access the same state
+   * as the Internal functions.
+   */
+  QMutex* mutex()
+  {
+    return &mutex_;
+  }
+
   /**
    * @brief Internal open function
    *
@@ -193,18 +272,62 @@ protected:
    * @brief Internal frame retrieval function
    *
    * Sub-classes must override this function IF they support video. Function is already mutexed
-   * so sub-classes don't need to worry about thread safety.
+   * so sub-classes don't need to worry about thread safety. Long decodes should check `cancelled`
+   * (which may be nullptr) regularly and return nullptr if it's set.
    */
-  virtual FramePtr RetrieveVideoInternal(const rational& timecode, const int& divider);
+  virtual FramePtr RetrieveVideoInternal(const rational& timecode, const int& divider, const QAtomicInt* cancelled);
+
+  /**
+   * @brief Internal best-effort frame retrieval function
+   *
+   * Sub-classes may override this to return whichever frame near `timecode` is cheapest to
+   * provide. The default implementation retrieves the exact frame.
+   */
+  virtual FramePtr RetrieveVideoBestEffortInternal(const rational& timecode, const int& divider, const QAtomicInt* cancelled);
+
+  /**
+   * @brief Internal retrieval cost function
+   *
+   * Function is already mutexed. The default implementation always returns kRetrievalCostSeek.
+   */
+  virtual int64_t GetRetrievalCostInternal(const rational& timecode);
 
   virtual bool ConformAudioInternal(const QString& filename, const AudioParams &params, const QAtomicInt* cancelled);
 
+  /**
+   * @brief Conform each of `streams` to the file at the same index in `filenames`
+   *
+   * Function is already mutexed. The default implementation conforms the streams one after the
+   * other with ConformAudioInternal(). Override this to demux the file once for all of them.
+   */
+  virtual bool ConformAudioStreamsInternal(const QVector<Stream*>& streams, const QStringList& filenames,
+                                           const AudioParams& params, const QAtomicInt* cancelled);
+
+  /**
+   * @brief Returns TRUE if audio can be decoded straight from the source rather than conformed first
+   *
+   * Function is already mutexed. This is worth it for formats that seek exactly and cost little
+   * more to decode than to read, like PCM, where a conform only doubles disk usage and holds up
+   * playback for as long as it takes to write. The default implementation returns FALSE.
+   */
+  virtual bool CanRetrieveAudioDirectlyInternal();
+
+  /**
+   * @brief Decode `count` samples of the stream resampled to `params`, starting at sample `start`
+   *
+   * Function is already mutexed and only called if CanRetrieveAudioDirectlyInternal() returned
+   * TRUE. Samples outside the stream should be silent. The default implementation returns nullptr.
+   */
+  virtual SampleBufferPtr RetrieveAudioDirectInternal(qint64 start, int count, const AudioParams& params,
+                                                      const QAtomicInt* cancelled);
+
   void SignalProcessingProgress(const int64_t& ts);
 
   /**
    * @brief Get the destination filename of an audio stream conformed to a set of parameters
    */
   QString GetConformedFilename(const AudioParams &params);
+  QString GetConformedFilename(Stream* stream, const AudioParams &params) const;
 
   QString GetIndexFilename();
 
@@ -228,6 +351,24 @@ protected:
     return stream_;
   }
 
+  /**
+   * @brief Returns TRUE if this decoder was opened on the stream's proxy rather than its original media
+   */
+  bool is_proxy() const
+  {
+    return proxy_;
+  }
+
+  /**
+   * @brief The file this decoder reads from, which will be the proxy if is_proxy() is TRUE
+   */
+  QString filename() const;
+
+  /**
+   * @brief The index of the stream to read in filename()
+   */
+  int stream_index() const;
+
   static QMutex currently_conforming_mutex_;
   static QWaitCondition currently_conforming_wait_cond_;
   static QVector<CurrentlyConforming> currently_conforming_;
@@ -242,8 +383,95 @@ signals:
 private:
   SampleBufferPtr RetrieveAudioFromConform(const QString& conform_filename, const TimeRange &range);
 
+  /**
+   * @brief Assemble a range from blocks decoded with RetrieveAudioDirectInternal()
+   */
+  SampleBufferPtr RetrieveAudioDirect(const TimeRange &range, const AudioParams& params, const QAtomicInt* cancelled);
+
+  /**
+   * @brief One second of directly decoded audio, starting at sample `index * sample_rate`
+   */
+  struct AudioBlock {
+    qint64 index;
+    SampleBufferPtr samples;
+  };
+
+  /**
+   * @brief Maximum number of blocks kept in `audio_blocks_`
+   */
+  static const int kMaxAudioBlocks;
+
+  /**
+   * @brief ConformAudio() once the decoder's mutex is held
+   */
+  bool ConformAudioLocked(const QVector<Stream*>& streams, const AudioParams& params, const QAtomicInt* cancelled);
+
+  /**
+   * @brief A previous Probe() result, serialized the same way footage is saved in projects
+   */
+  struct ProbeCacheEntry {
+    qint64 timestamp;
+    qint64 size;
+    QByteArray footage;
+  };
+
+  /**
+   * @brief Directory persistent probe results are stored in
+   */
+  static QString GetProbeCacheDirectory();
+
+  /**
+   * @brief Persistent cache file for a given media file
+   */
+  static QString GetProbeCacheFilename(const QString& absolute_path);
+
+  /**
+   * @brief Combined ID and version of every decoder, entries saved with a different one are stale
+   */
+  static const QString& GetProbeCacheVersion();
+
+  /**
+   * @brief Read a persistent cache file, returns FALSE if it couldn't be read or is from another version
+   */
+  static bool ReadProbeCacheFile(const QString& cache_filename, QString* path, ProbeCacheEntry* entry);
+
+  static void WriteProbeCacheFile(const QString& absolute_path, const ProbeCacheEntry& entry);
+
+  static const quint32 kProbeCacheMagic;
+  static const quint32 kProbeCacheFormatVersion;
+
+  /**
+   * @brief Rebuild a previous Probe() result if the file hasn't changed since, otherwise nullptr
+   */
+  static Footage* LoadFromProbeCache(const QFileInfo& file_info, const QAtomicInt* cancelled);
+
+  static void AddToProbeCache(const QFileInfo& file_info, Footage* footage);
+
+  /**
+   * @brief Probe results keyed by absolute path, validated by modification time and size
+   *
+   * Entries are also written to GetProbeCacheDirectory() and read back on a miss, so
+   * re-importing media doesn't probe the same files again within a session or across them.
+   */
+  static QMutex probe_cache_mutex_;
+  static QHash<QString, ProbeCacheEntry> probe_cache_;
+
   Stream* stream_;
 
+  bool proxy_;
+
+  /**
+   * @brief The currently mapped conform file, kept open between audio retrievals
+   */
+  PlanarAudioInput* conform_;
+
+  /**
+   * @brief Recently decoded direct audio, most recently used first
+   */
+  QList<AudioBlock> audio_blocks_;
+
+  AudioParams audio_blocks_params_;
+
   QMutex mutex_;
 
 };
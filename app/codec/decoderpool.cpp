@@ -0,0 +1,214 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "decoderpool.h"
+
+#include <QThread>
+
+#include "codec/ffmpeg/ffmpegdecoder.h"
+#include "common/memorypool.h"
+#include "common/threadaffinity.h"
+
+namespace olive {
+
+DecoderPool::DecoderPool(Stream *stream, bool proxy, int max_instances) :
+  stream_(stream),
+  proxy_(proxy),
+  max_instances_(max_instances > 0 ? max_instances : QThread::idealThreadCount()),
+  pending_instances_(0)
+{
+}
+
+DecoderPool::~DecoderPool()
+{
+  QMutexLocker locker(&mutex_);
+
+  foreach (const Instance& i, instances_) {
+    i.decoder->Close();
+  }
+}
+
+bool DecoderPool::Open()
+{
+  DecoderPtr first = CreateInstance();
+
+  if (!first) {
+    return false;
+  }
+
+  QMutexLocker locker(&mutex_);
+  instances_.append({first, false, ThreadAffinity::GetCurrentNode()});
+  return true;
+}
+
+FramePtr DecoderPool::RetrieveVideo(const rational &timecode, const int &divider, const QAtomicInt *cancelled, bool best_effort)
+{
+  DecoderPtr decoder = Acquire(timecode, true);
+
+  if (!decoder) {
+    return nullptr;
+  }
+
+  FramePtr frame = decoder->RetrieveVideo(timecode, divider, cancelled, best_effort);
+
+  Release(decoder);
+
+  return frame;
+}
+
+SampleBufferPtr DecoderPool::RetrieveAudio(const TimeRange &range, const AudioParams &params, const QAtomicInt *cancelled)
+{
+  // Audio is read from a conform or cheap to decode directly so any instance will do, and sticking
+  // to one keeps hitting its cache of decoded blocks
+  DecoderPtr decoder = Acquire(range.in(), false);
+
+  if (!decoder) {
+    return nullptr;
+  }
+
+  SampleBufferPtr samples = decoder->RetrieveAudio(range, params, cancelled);
+
+  Release(decoder);
+
+  return samples;
+}
+
+void DecoderPool::Shrink(int keep)
+{
+  QMutexLocker locker(&mutex_);
+  ShrinkInternal(keep);
+}
+
+int DecoderPool::GetInstanceCount()
+{
+  QMutexLocker locker(&mutex_);
+  return instances_.size();
+}
+
+DecoderPtr DecoderPool::Acquire(const rational &time, bool allow_new_instance)
+{
+  QMutexLocker locker(&mutex_);
+
+  int node = ThreadAffinity::GetCurrentNode();
+
+  while (true) {
+    // Find the idle instance that can reach this time the cheapest
+    int best_index = -1;
+    int64_t best_cost = 0;
+
+    for (int i=0; i<instances_.size(); i++) {
+      const Instance& instance = instances_.at(i);
+
+      if (!instance.in_use) {
+        // An instance on another node would decode into memory on the other socket, so it's only
+        // as good as one that has to seek
+        int64_t cost = (instance.node == node) ? instance.decoder->GetRetrievalCost(time) : Decoder::kRetrievalCostSeek;
+
+        if (best_index == -1 || cost < best_cost) {
+          best_index = i;
+          best_cost = cost;
+        }
+      }
+    }
+
+    // If the best candidate would have to seek anyway, a fresh instance is just as good and leaves
+    // the existing one positioned for whatever sequence of frames it's serving
+    bool can_create = (instances_.size() + pending_instances_ < max_instances_)
+        && (allow_new_instance || instances_.isEmpty())
+        && !MemoryPoolLimitReached();
+
+    if (best_index >= 0 && (best_cost < Decoder::kRetrievalCostSeek || !can_create)) {
+      instances_[best_index].in_use = true;
+      return instances_.at(best_index).decoder;
+    }
+
+    if (can_create) {
+      pending_instances_++;
+      locker.unlock();
+
+      // Opening can be slow so we don't hold the lock for it
+      DecoderPtr decoder = CreateInstance();
+
+      locker.relock();
+      pending_instances_--;
+
+      if (decoder) {
+        instances_.append({decoder, true, node});
+        return decoder;
+      } else if (instances_.isEmpty()) {
+        // Nothing to fall back on
+        return nullptr;
+      }
+
+      // Couldn't open a new instance, stop trying and wait for an existing one
+      max_instances_ = instances_.size();
+      continue;
+    }
+
+    wait_cond_.wait(&mutex_);
+  }
+}
+
+void DecoderPool::Release(DecoderPtr decoder)
+{
+  QMutexLocker locker(&mutex_);
+
+  for (int i=0; i<instances_.size(); i++) {
+    if (instances_.at(i).decoder == decoder) {
+      instances_[i].in_use = false;
+      break;
+    }
+  }
+
+  // Give memory back if we're under pressure, frame pools of idle instances are the easiest win
+  if (MemoryPoolLimitReached()) {
+    ShrinkInternal(1);
+  }
+
+  wait_cond_.wakeOne();
+}
+
+DecoderPtr DecoderPool::CreateInstance()
+{
+  // Proxies are always written by FFmpeg so they're always read by it too
+  DecoderPtr decoder = proxy_ ? std::make_shared<FFmpegDecoder>() : Decoder::CreateFromID(stream_->footage()->decoder());
+
+  if (!decoder) {
+    return nullptr;
+  }
+
+  if (!decoder->Open(stream_, proxy_)) {
+    return nullptr;
+  }
+
+  return decoder;
+}
+
+void DecoderPool::ShrinkInternal(int keep)
+{
+  for (int i=instances_.size()-1; i>=0 && instances_.size()>keep; i--) {
+    if (!instances_.at(i).in_use) {
+      instances_.at(i).decoder->Close();
+      instances_.removeAt(i);
+    }
+  }
+}
+
+}
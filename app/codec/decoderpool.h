@@ -0,0 +1,140 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef DECODERPOOL_H
+#define DECODERPOOL_H
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "codec/decoder.h"
+#include "common/define.h"
+
+namespace olive {
+
+class DecoderPool;
+using DecoderPoolPtr = std::shared_ptr<DecoderPool>;
+
+/**
+ * @brief A set of Decoder instances that all decode the same Stream
+ *
+ * A single Decoder is mutexed for the duration of a retrieval, which means render threads pulling
+ * frames from the same clip would otherwise serialize on it. DecoderPool keeps up to
+ * `max_instances` decoders open for one stream and routes each request to the idle instance
+ * whose cached position is closest to the requested time (see Decoder::GetRetrievalCost()), so
+ * sequential requests keep hitting the same instance while parallel requests get their own.
+ *
+ * Idle instances beyond the first are closed when the global memory pool limit is reached.
+ *
+ * If render workers are pinned to NUMA nodes (see ThreadAffinity), an instance opened on another
+ * node costs as much as a seek, so each node ends up with its own instances where possible.
+ *
+ * If `proxy` is TRUE, the instances decode the stream's proxy rather than its original media.
+ *
+ * This class is thread safe.
+ */
+class DecoderPool
+{
+public:
+  DecoderPool(Stream* stream, bool proxy = false, int max_instances = 0);
+
+  ~DecoderPool();
+
+  DISABLE_COPY_MOVE(DecoderPool)
+
+  /**
+   * @brief Open the first decoder instance
+   *
+   * Returns FALSE if the stream couldn't be opened, in which case this pool should be discarded.
+   */
+  bool Open();
+
+  /**
+   * @brief Retrieve a video frame using the best available instance
+   *
+   * \see Decoder::RetrieveVideo()
+   */
+  FramePtr RetrieveVideo(const rational& timecode, const int& divider, const QAtomicInt* cancelled = nullptr,
+                         bool best_effort = false);
+
+  /**
+   * @brief Retrieve audio using any available instance
+   *
+   * \see Decoder::RetrieveAudio()
+   */
+  SampleBufferPtr RetrieveAudio(const TimeRange& range, const AudioParams& params, const QAtomicInt *cancelled);
+
+  /**
+   * @brief Close idle instances until only `keep` remain open
+   */
+  void Shrink(int keep = 1);
+
+  /**
+   * @brief Returns the number of currently open instances
+   */
+  int GetInstanceCount();
+
+  Stream* stream() const
+  {
+    return stream_;
+  }
+
+private:
+  struct Instance {
+    DecoderPtr decoder;
+    bool in_use;
+
+    /// NUMA node of the thread that opened it, where its codec threads and frame pool live
+    int node;
+  };
+
+  /**
+   * @brief Reserve an instance for a retrieval at `time`, blocking if none are available
+   *
+   * If `allow_new_instance` is TRUE, a new instance may be opened rather than using one that
+   * would have to seek.
+   */
+  DecoderPtr Acquire(const rational& time, bool allow_new_instance);
+
+  void Release(DecoderPtr decoder);
+
+  DecoderPtr CreateInstance();
+
+  void ShrinkInternal(int keep);
+
+  Stream* stream_;
+
+  bool proxy_;
+
+  int max_instances_;
+
+  int pending_instances_;
+
+  QVector<Instance> instances_;
+
+  QMutex mutex_;
+
+  QWaitCondition wait_cond_;
+
+};
+
+}
+
+#endif // DECODERPOOL_H
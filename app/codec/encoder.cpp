@@ -22,7 +22,9 @@
 
 #include <QFile>
 
+#include "common/xmlutils.h"
 #include "ffmpeg/ffmpegencoder.h"
+#include "oiio/oiioencoder.h"
 
 namespace olive {
 
@@ -48,6 +50,7 @@ EncodingParams::EncodingParams() :
   video_max_bit_rate_(0),
   video_buffer_size_(0),
   video_threads_(0),
+  video_two_pass_(false),
   audio_enabled_(false),
   audio_bit_rate_(0)
 {
@@ -72,6 +75,16 @@ void EncodingParams::EnableAudio(const AudioParams &audio_params, const ExportCo
   audio_codec_ = acodec;
 }
 
+void EncodingParams::DisableVideo()
+{
+  video_enabled_ = false;
+}
+
+void EncodingParams::DisableAudio()
+{
+  audio_enabled_ = false;
+}
+
 void EncodingParams::set_video_option(const QString &key, const QString &value)
 {
   video_opts_.insert(key, value);
@@ -180,6 +193,7 @@ void EncodingParams::SetExportLength(const rational &export_length)
 void EncodingParams::Save(QXmlStreamWriter *writer) const
 {
   writer->writeTextElement(QStringLiteral("filename"), filename_);
+  writer->writeTextElement(QStringLiteral("length"), export_length_.toString());
 
   writer->writeStartElement(QStringLiteral("video"));
 
@@ -192,10 +206,14 @@ void EncodingParams::Save(QXmlStreamWriter *writer) const
     writer->writeTextElement(QStringLiteral("format"), QString::number(video_params_.format()));
     writer->writeTextElement(QStringLiteral("timebase"), video_params_.time_base().toString());
     writer->writeTextElement(QStringLiteral("divider"), QString::number(video_params_.divider()));
+    writer->writeTextElement(QStringLiteral("pixelaspect"), video_params_.pixel_aspect_ratio().toString());
+    writer->writeTextElement(QStringLiteral("interlacing"), QString::number(video_params_.interlacing()));
+    writer->writeTextElement(QStringLiteral("pixfmt"), video_pix_fmt_);
     writer->writeTextElement(QStringLiteral("bitrate"), QString::number(video_bit_rate_));
     writer->writeTextElement(QStringLiteral("maxbitrate"), QString::number(video_max_bit_rate_));
     writer->writeTextElement(QStringLiteral("bufsize"), QString::number(video_buffer_size_));
     writer->writeTextElement(QStringLiteral("threads"), QString::number(video_threads_));
+    writer->writeTextElement(QStringLiteral("twopass"), QString::number(video_two_pass_));
 
     if (!video_opts_.isEmpty()) {
       writer->writeStartElement(QStringLiteral("opts"));
@@ -225,14 +243,134 @@ void EncodingParams::Save(QXmlStreamWriter *writer) const
     writer->writeTextElement(QStringLiteral("samplerate"), QString::number(audio_params_.sample_rate()));
     writer->writeTextElement(QStringLiteral("channellayout"), QString::number(audio_params_.channel_layout()));
     writer->writeTextElement(QStringLiteral("format"), QString::number(audio_params_.format()));
+    writer->writeTextElement(QStringLiteral("bitrate"), QString::number(audio_bit_rate_));
   }
 
   writer->writeEndElement(); // audio
 }
 
+bool EncodingParams::Load(QXmlStreamReader *reader)
+{
+  while (XMLReadNextStartElement(reader)) {
+    if (!LoadElement(reader)) {
+      reader->skipCurrentElement();
+    }
+  }
+
+  return !reader->hasError();
+}
+
+bool EncodingParams::LoadElement(QXmlStreamReader *reader)
+{
+  if (reader->name() == QStringLiteral("filename")) {
+    filename_ = reader->readElementText();
+  } else if (reader->name() == QStringLiteral("length")) {
+    export_length_ = rational::fromString(reader->readElementText());
+  } else if (reader->name() == QStringLiteral("video")) {
+    LoadVideo(reader);
+  } else if (reader->name() == QStringLiteral("audio")) {
+    LoadAudio(reader);
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+void EncodingParams::LoadVideo(QXmlStreamReader *reader)
+{
+  video_enabled_ = reader->attributes().value(QStringLiteral("enabled")).toString().toInt();
+
+  while (XMLReadNextStartElement(reader)) {
+    if (reader->name() == QStringLiteral("codec")) {
+      video_codec_ = static_cast<ExportCodec::Codec>(reader->readElementText().toInt());
+    } else if (reader->name() == QStringLiteral("width")) {
+      video_params_.set_width(reader->readElementText().toInt());
+    } else if (reader->name() == QStringLiteral("height")) {
+      video_params_.set_height(reader->readElementText().toInt());
+    } else if (reader->name() == QStringLiteral("format")) {
+      video_params_.set_format(static_cast<VideoParams::Format>(reader->readElementText().toInt()));
+    } else if (reader->name() == QStringLiteral("timebase")) {
+      video_params_.set_time_base(rational::fromString(reader->readElementText()));
+    } else if (reader->name() == QStringLiteral("divider")) {
+      video_params_.set_divider(reader->readElementText().toInt());
+    } else if (reader->name() == QStringLiteral("pixelaspect")) {
+      video_params_.set_pixel_aspect_ratio(rational::fromString(reader->readElementText()));
+    } else if (reader->name() == QStringLiteral("interlacing")) {
+      video_params_.set_interlacing(static_cast<VideoParams::Interlacing>(reader->readElementText().toInt()));
+    } else if (reader->name() == QStringLiteral("pixfmt")) {
+      video_pix_fmt_ = reader->readElementText();
+    } else if (reader->name() == QStringLiteral("bitrate")) {
+      video_bit_rate_ = reader->readElementText().toLongLong();
+    } else if (reader->name() == QStringLiteral("maxbitrate")) {
+      video_max_bit_rate_ = reader->readElementText().toLongLong();
+    } else if (reader->name() == QStringLiteral("bufsize")) {
+      video_buffer_size_ = reader->readElementText().toLongLong();
+    } else if (reader->name() == QStringLiteral("threads")) {
+      video_threads_ = reader->readElementText().toInt();
+    } else if (reader->name() == QStringLiteral("twopass")) {
+      video_two_pass_ = reader->readElementText().toInt();
+    } else if (reader->name() == QStringLiteral("opts")) {
+      while (XMLReadNextStartElement(reader)) {
+        if (reader->name() == QStringLiteral("entry")) {
+          QString key, value;
+
+          while (XMLReadNextStartElement(reader)) {
+            if (reader->name() == QStringLiteral("key")) {
+              key = reader->readElementText();
+            } else if (reader->name() == QStringLiteral("value")) {
+              value = reader->readElementText();
+            } else {
+              reader->skipCurrentElement();
+            }
+          }
+
+          video_opts_.insert(key, value);
+        } else {
+          reader->skipCurrentElement();
+        }
+      }
+    } else {
+      reader->skipCurrentElement();
+    }
+  }
+
+  // Frames are always rendered with the internal channel count, Save() doesn't store it
+  video_params_.set_channel_count(VideoParams::kInternalChannelCount);
+}
+
+void EncodingParams::LoadAudio(QXmlStreamReader *reader)
+{
+  audio_enabled_ = reader->attributes().value(QStringLiteral("enabled")).toString().toInt();
+
+  int sample_rate = 0;
+  uint64_t channel_layout = 0;
+  AudioParams::Format format = AudioParams::kInternalFormat;
+
+  while (XMLReadNextStartElement(reader)) {
+    if (reader->name() == QStringLiteral("codec")) {
+      audio_codec_ = static_cast<ExportCodec::Codec>(reader->readElementText().toInt());
+    } else if (reader->name() == QStringLiteral("samplerate")) {
+      sample_rate = reader->readElementText().toInt();
+    } else if (reader->name() == QStringLiteral("channellayout")) {
+      channel_layout = reader->readElementText().toULongLong();
+    } else if (reader->name() == QStringLiteral("format")) {
+      format = static_cast<AudioParams::Format>(reader->readElementText().toInt());
+    } else if (reader->name() == QStringLiteral("bitrate")) {
+      audio_bit_rate_ = reader->readElementText().toLongLong();
+    } else {
+      reader->skipCurrentElement();
+    }
+  }
+
+  audio_params_ = AudioParams(sample_rate, channel_layout, format);
+}
+
 Encoder* Encoder::CreateFromID(const QString &id, const EncodingParams& params)
 {
-  Q_UNUSED(id)
+  if (id == QStringLiteral("oiio")) {
+    return new OIIOEncoder(params);
+  }
 
   return new FFmpegEncoder(params);
 }
@@ -23,11 +23,13 @@
 
 #include <memory>
 #include <QString>
+#include <QXmlStreamReader>
 #include <QXmlStreamWriter>
 
 #include "codec/exportcodec.h"
 #include "codec/exportformat.h"
 #include "codec/frame.h"
+#include "codec/samplebuffer.h"
 #include "common/timerange.h"
 #include "render/audioparams.h"
 #include "render/videoparams.h"
@@ -46,6 +48,9 @@ public:
   void EnableVideo(const VideoParams& video_params, const ExportCodec::Codec& vcodec);
   void EnableAudio(const AudioParams& audio_params, const ExportCodec::Codec &acodec);
 
+  void DisableVideo();
+  void DisableAudio();
+
   void set_video_option(const QString& key, const QString& value);
   void set_video_bit_rate(const int64_t& rate);
   void set_video_max_bit_rate(const int64_t& rate);
@@ -65,6 +70,19 @@ public:
   const int& video_threads() const;
   const QString& video_pix_fmt() const;
 
+  /**
+   * @brief Whether the video should be encoded in two passes, see Encoder::SetPass()
+   */
+  bool video_two_pass() const
+  {
+    return video_two_pass_;
+  }
+
+  void set_video_two_pass(bool e)
+  {
+    video_two_pass_ = e;
+  }
+
   bool audio_enabled() const;
   const ExportCodec::Codec &audio_codec() const;
   const AudioParams& audio_params() const;
@@ -84,7 +102,28 @@ public:
 
   virtual void Save(QXmlStreamWriter* writer) const;
 
+  /**
+   * @brief Read back parameters written by Save()
+   *
+   * The reader should be positioned on the element Save() was called in. Returns FALSE if the
+   * parameters couldn't be read.
+   */
+  virtual bool Load(QXmlStreamReader* reader);
+
+protected:
+  /**
+   * @brief Read the current element if it's one written by EncodingParams::Save()
+   *
+   * Returns FALSE if the element isn't recognized so subclasses can handle their own elements
+   * alongside these ones.
+   */
+  bool LoadElement(QXmlStreamReader* reader);
+
 private:
+  void LoadVideo(QXmlStreamReader* reader);
+
+  void LoadAudio(QXmlStreamReader* reader);
+
   QString filename_;
 
   bool video_enabled_;
@@ -96,6 +135,7 @@ private:
   int64_t video_buffer_size_;
   int video_threads_;
   QString video_pix_fmt_;
+  bool video_two_pass_;
 
   bool audio_enabled_;
   ExportCodec::Codec audio_codec_;
@@ -131,6 +171,14 @@ public:
   void WriteAudio(olive::AudioParams pcm_info,
                   const QString& pcm_filename);
 
+  /**
+   * @brief Encode the next block of audio
+   *
+   * Blocks must be sent in order with no gaps. Audio sent this way is buffered internally until
+   * there's enough for the codec's frame size, any remainder is written on Close().
+   */
+  virtual bool WriteAudio(olive::SampleBufferPtr samples) = 0;
+
   virtual void Close() = 0;
 
   virtual VideoParams::Format GetDesiredPixelFormat() const
@@ -138,6 +186,40 @@ public:
     return VideoParams::kFormatInvalid;
   }
 
+  /**
+   * @brief Returns the number of bits per channel the video is stored with, or 0 if unknown
+   *
+   * Only depends on the parameters, so it can be called before Open().
+   */
+  virtual int GetTargetBitDepth() const
+  {
+    return 0;
+  }
+
+  /**
+   * @brief Returns TRUE if WriteFrame() can be called with frames in any order
+   *
+   * Encoders that return FALSE (the default) must receive every frame in chronological order.
+   */
+  virtual bool SupportsOutOfOrderFrames() const
+  {
+    return false;
+  }
+
+  /**
+   * @brief Make this encoder run one pass of a two-pass encode, must be called before Open()
+   *
+   * Pass 1 only analyzes the frames it's sent, writing rate control statistics to files starting
+   * with `stats_prefix` rather than writing the output file. Pass 2 reads them back and encodes
+   * the same frames for real. Returns FALSE if this encoder doesn't support two-pass encoding.
+   */
+  virtual bool SetPass(int pass, const QString& stats_prefix)
+  {
+    Q_UNUSED(pass)
+    Q_UNUSED(stats_prefix)
+    return false;
+  }
+
 private:
   EncodingParams params_;
 
@@ -52,6 +52,22 @@ QString ExportCodec::GetCodecName(ExportCodec::Codec c)
     return tr("AAC");
   case kCodecPCM:
     return tr("PCM (Uncompressed)");
+  case kCodecH264NVENC:
+    return tr("H.264 (NVIDIA NVENC)");
+  case kCodecH265NVENC:
+    return tr("H.265 (NVIDIA NVENC)");
+  case kCodecH264QSV:
+    return tr("H.264 (Intel Quick Sync)");
+  case kCodecH265QSV:
+    return tr("H.265 (Intel Quick Sync)");
+  case kCodecH264VAAPI:
+    return tr("H.264 (VA-API)");
+  case kCodecH265VAAPI:
+    return tr("H.265 (VA-API)");
+  case kCodecH264VideoToolbox:
+    return tr("H.264 (VideoToolbox)");
+  case kCodecH265VideoToolbox:
+    return tr("H.265 (VideoToolbox)");
   case kCodecCount:
     break;
   }
@@ -70,6 +86,14 @@ bool ExportCodec::IsCodecAStillImage(ExportCodec::Codec c)
   case kCodecMP3:
   case kCodecAAC:
   case kCodecPCM:
+  case kCodecH264NVENC:
+  case kCodecH265NVENC:
+  case kCodecH264QSV:
+  case kCodecH265QSV:
+  case kCodecH264VAAPI:
+  case kCodecH265VAAPI:
+  case kCodecH264VideoToolbox:
+  case kCodecH265VideoToolbox:
     return false;
   case kCodecOpenEXR:
   case kCodecPNG:
@@ -82,6 +106,56 @@ bool ExportCodec::IsCodecAStillImage(ExportCodec::Codec c)
   return false;
 }
 
+bool ExportCodec::IsCodecHardware(ExportCodec::Codec c)
+{
+  return GetHardwareEncoderName(c) != nullptr;
+}
+
+const char *ExportCodec::GetHardwareEncoderName(ExportCodec::Codec c)
+{
+  switch (c) {
+  case kCodecH264NVENC:
+    return "h264_nvenc";
+  case kCodecH265NVENC:
+    return "hevc_nvenc";
+  case kCodecH264QSV:
+    return "h264_qsv";
+  case kCodecH265QSV:
+    return "hevc_qsv";
+  case kCodecH264VAAPI:
+    return "h264_vaapi";
+  case kCodecH265VAAPI:
+    return "hevc_vaapi";
+  case kCodecH264VideoToolbox:
+    return "h264_videotoolbox";
+  case kCodecH265VideoToolbox:
+    return "hevc_videotoolbox";
+  default:
+    break;
+  }
+
+  return nullptr;
+}
+
+QList<ExportCodec::Codec> ExportCodec::GetAvailableHardwareCodecs(const QList<Codec> &software_equivalents)
+{
+  QList<Codec> codecs;
+
+  for (int i=kCodecH264NVENC; i<kCodecCount; i++) {
+    Codec c = static_cast<Codec>(i);
+
+    // Hardware codecs are listed H.264 first, then H.265 for each backend
+    Codec software = ((i - kCodecH264NVENC) % 2 == 0) ? kCodecH264 : kCodecH265;
+
+    if (software_equivalents.contains(software)
+        && avcodec_find_encoder_by_name(GetHardwareEncoderName(c))) {
+      codecs.append(c);
+    }
+  }
+
+  return codecs;
+}
+
 QStringList ExportCodec::GetPixelFormatsForCodec(ExportCodec::Codec c)
 {
   QStringList pix_fmts;
@@ -102,9 +176,24 @@ QStringList ExportCodec::GetPixelFormatsForCodec(ExportCodec::Codec c)
     codec_info = avcodec_find_encoder(AV_CODEC_ID_HEVC);
     break;
   case kCodecOpenEXR:
+    // Written by OIIOEncoder, see OIIOEncoder::GetDesiredPixelFormat()
+    pix_fmts.append(QStringLiteral("rgbaf16"));
+    pix_fmts.append(QStringLiteral("rgbaf32"));
+    break;
   case kCodecPNG:
   case kCodecTIFF:
-    // FIXME: Add these in (these will most likely use an OIIOEncoder which doesn't exist yet)
+    pix_fmts.append(QStringLiteral("rgba"));
+    pix_fmts.append(QStringLiteral("rgba64"));
+    break;
+  case kCodecH264NVENC:
+  case kCodecH265NVENC:
+  case kCodecH264QSV:
+  case kCodecH265QSV:
+  case kCodecH264VAAPI:
+  case kCodecH265VAAPI:
+  case kCodecH264VideoToolbox:
+  case kCodecH265VideoToolbox:
+    codec_info = avcodec_find_encoder_by_name(GetHardwareEncoderName(c));
     break;
   case kCodecMP2:
   case kCodecMP3:
@@ -117,8 +206,21 @@ QStringList ExportCodec::GetPixelFormatsForCodec(ExportCodec::Codec c)
 
   if (codec_info) {
     for (int i=0; codec_info->pix_fmts[i]!=-1; i++) {
-      const char* pix_fmt_name = av_get_pix_fmt_name(codec_info->pix_fmts[i]);
-      pix_fmts.append(pix_fmt_name);
+      const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(codec_info->pix_fmts[i]);
+
+      // Skip GPU surface formats, frames are uploaded to those automatically
+      if (desc->flags & AV_PIX_FMT_FLAG_HWACCEL) {
+        continue;
+      }
+
+      pix_fmts.append(desc->name);
+    }
+
+    // Encoders that only take GPU surfaces (e.g. VA-API) are fed through an upload from one of
+    // these instead
+    if (pix_fmts.isEmpty() && IsCodecHardware(c)) {
+      pix_fmts.append(QStringLiteral("nv12"));
+      pix_fmts.append(QStringLiteral("p010le"));
     }
   }
 
@@ -46,6 +46,16 @@ public:
     kCodecAAC,
     kCodecPCM,
 
+    // Hardware encoders, kept after the others so saved codec values don't change
+    kCodecH264NVENC,
+    kCodecH265NVENC,
+    kCodecH264QSV,
+    kCodecH265QSV,
+    kCodecH264VAAPI,
+    kCodecH265VAAPI,
+    kCodecH264VideoToolbox,
+    kCodecH265VideoToolbox,
+
     kCodecCount
   };
 
@@ -53,6 +63,23 @@ public:
 
   static bool IsCodecAStillImage(Codec c);
 
+  /**
+   * @brief Returns TRUE if this codec is encoded by a GPU or other dedicated hardware
+   */
+  static bool IsCodecHardware(Codec c);
+
+  /**
+   * @brief Returns the name of the FFmpeg encoder for a hardware codec, or nullptr for software codecs
+   */
+  static const char* GetHardwareEncoderName(Codec c);
+
+  /**
+   * @brief Returns the hardware codecs FFmpeg was built with that match `software_equivalents`
+   *
+   * Whether a device actually exists is only known once the encoder is opened.
+   */
+  static QList<Codec> GetAvailableHardwareCodecs(const QList<Codec>& software_equivalents);
+
   static QStringList GetPixelFormatsForCodec(Codec c);
 
 };
@@ -91,13 +91,15 @@ QString ExportFormat::GetEncoder(ExportFormat::Format f)
 
 QList<ExportCodec::Codec> ExportFormat::GetVideoCodecs(ExportFormat::Format f)
 {
+  QList<ExportCodec::Codec> software_codecs;
+
   switch (f) {
   case kFormatDNxHD:
     return {ExportCodec::kCodecDNxHD};
   case kFormatMatroska:
-    return {ExportCodec::kCodecH264, ExportCodec::kCodecH265};
   case kFormatMPEG4:
-    return {ExportCodec::kCodecH264, ExportCodec::kCodecH265};
+    software_codecs = {ExportCodec::kCodecH264, ExportCodec::kCodecH265};
+    return software_codecs + ExportCodec::GetAvailableHardwareCodecs(software_codecs);
   case kFormatOpenEXR:
     return {ExportCodec::kCodecOpenEXR};
   case kFormatPNG:
@@ -105,7 +107,8 @@ QList<ExportCodec::Codec> ExportFormat::GetVideoCodecs(ExportFormat::Format f)
   case kFormatTIFF:
     return {ExportCodec::kCodecTIFF};
   case kFormatQuickTime:
-    return {ExportCodec::kCodecH264, ExportCodec::kCodecH265, ExportCodec::kCodecProRes};
+    software_codecs = {ExportCodec::kCodecH264, ExportCodec::kCodecH265, ExportCodec::kCodecProRes};
+    return software_codecs + ExportCodec::GetAvailableHardwareCodecs(software_codecs);
   case kFormatCount:
     break;
   }
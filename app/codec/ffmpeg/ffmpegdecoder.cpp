@@ -23,6 +23,7 @@
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
+#include <libavutil/hwcontext.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/pixdesc.h>
 }
@@ -38,22 +39,42 @@ extern "C" {
 
 #include "codec/waveinput.h"
 #include "common/define.h"
+#include "config/config.h"
 #include "common/ffmpegutils.h"
+#include "common/memorypool.h"
+#include "common/metrics.h"
 #include "common/filefunctions.h"
 #include "common/functiontimer.h"
+#include "common/threadaffinity.h"
 #include "common/timecodefunctions.h"
 #include "render/framehashcache.h"
 #include "render/diskmanager.h"
 
 namespace olive {
 
+const int FFmpegDecoder::kReadAheadFrames = 8;
+const int FFmpegDecoder::kMaxReadAheadSpeed = 2;
+const int FFmpegDecoder::kMaxReverseSpanFrames = 32;
+const int FFmpegDecoder::kReverseSpanCount = 2;
+const int FFmpegDecoder::kKeyframeIndexCacheSize = 4194304;
+QCache<QString, FFmpegKeyframeIndex> FFmpegDecoder::keyframe_index_cache_(kKeyframeIndexCacheSize);
+QMutex FFmpegDecoder::keyframe_index_cache_lock_;
+
 FFmpegDecoder::FFmpegDecoder() :
   scale_ctx_(nullptr),
   scale_divider_(0),
-  pool_(QThread::idealThreadCount()*2),
   is_working_(false),
   cache_at_zero_(false),
-  cache_at_eof_(false)
+  cache_at_eof_(false),
+  yuv_output_(false),
+  cache_limit_(QThread::idealThreadCount()),
+  frame_duration_ts_(1),
+  last_requested_ts_(AV_NOPTS_VALUE),
+  read_ahead_(nullptr),
+  reverse_span_owns_instance_(false),
+  audio_resampler_(nullptr),
+  audio_position_(AV_NOPTS_VALUE),
+  audio_index_attempted_(false)
 {
 }
 
@@ -64,9 +85,34 @@ FFmpegDecoder::~FFmpegDecoder()
 
 bool FFmpegDecoder::OpenInternal()
 {
-  if (instance_.Open(stream()->footage()->filename().toUtf8(), stream()->index())) {
+  QByteArray filename = this->filename().toUtf8();
+
+  bool opened = false;
+
+  if (stream()->type() == Stream::kVideo
+      && static_cast<VideoStream*>(stream())->video_type() == VideoStream::kVideoTypeVideo
+      && Config::Current()["HardwareDecoding"].toBool()) {
+    opened = instance_.Open(filename, stream_index(), true);
+
+    if (!opened) {
+      // Fall back to software decoding
+      qWarning() << "Hardware decoding unavailable for" << this->filename() << "- using software";
+      instance_.Close();
+    }
+  }
+
+  if (!opened) {
+    opened = instance_.Open(filename, stream_index());
+  }
+
+  yuv_output_ = false;
+
+  if (opened) {
     AVStream* s = instance_.avstream();
 
+    pool_.set_name(QStringLiteral("%1 (%2)").arg(QFileInfo(this->filename()).fileName(),
+                                                 QString::number(stream_index())));
+
     // Store one second in the source's timebase
     second_ts_ = qRound64(av_q2d(av_inv_q(s->time_base)));
 
@@ -84,6 +130,35 @@ bool FFmpegDecoder::OpenInternal()
         qDebug() << "Failed to find valid native pixel format for" << ideal_pix_fmt_;
         return false;
       }
+
+      // Rather than converting to RGB here, we can hand the planes over as-is and convert on the
+      // GPU, which is much less data to move and a lot less work for the CPU
+      if (static_cast<VideoStream*>(stream())->video_type() == VideoStream::kVideoTypeVideo
+          && Config::Current()["GPUYUVConversion"].toBool()
+          && IsPlanarYUV(instance_.pix_fmt())) {
+        yuv_output_ = true;
+
+        native_pix_fmt_ = (av_pix_fmt_desc_get(instance_.pix_fmt())->comp[0].depth > 8) ? VideoParams::kFormatUnsigned16 : VideoParams::kFormatUnsigned8;
+        native_channel_count_ = VideoParams::kRGBChannelCount;
+      }
+
+      if (static_cast<VideoStream*>(stream())->video_type() == VideoStream::kVideoTypeVideo) {
+        AVRational frame_rate = s->avg_frame_rate.num ? s->avg_frame_rate : s->r_frame_rate;
+
+        if (frame_rate.num && frame_rate.den) {
+          frame_duration_ts_ = qMax(int64_t(1), av_rescale_q(1, av_inv_q(frame_rate), s->time_base));
+        } else {
+          frame_duration_ts_ = 1;
+        }
+
+        cache_limit_ = QThread::idealThreadCount();
+        last_requested_ts_ = AV_NOPTS_VALUE;
+
+        LoadKeyframeIndex();
+
+        read_ahead_ = new ReadAheadThread(this);
+        read_ahead_->start(QThread::LowPriority);
+      }
     }
 
     return true;
@@ -148,10 +223,23 @@ FramePtr FFmpegDecoder::RetrieveStillImage(const rational &timecode, const int &
   return output_frame;
 }
 
-FramePtr FFmpegDecoder::RetrieveVideoInternal(const rational &timecode, const int &divider)
+FramePtr FFmpegDecoder::RetrieveVideoInternal(const rational &timecode, const int &requested_divider, const QAtomicInt *cancelled)
+{
+  return RetrieveVideoFrame(timecode, requested_divider, cancelled, false);
+}
+
+FramePtr FFmpegDecoder::RetrieveVideoBestEffortInternal(const rational &timecode, const int &requested_divider, const QAtomicInt *cancelled)
+{
+  return RetrieveVideoFrame(timecode, requested_divider, cancelled, true);
+}
+
+FramePtr FFmpegDecoder::RetrieveVideoFrame(const rational &timecode, int requested_divider, const QAtomicInt *cancelled, bool best_effort)
 {
   VideoStream* vs = static_cast<VideoStream*>(stream());
 
+  // There's no point scaling a proxy up, so never go higher than the resolution it was made at
+  int divider = is_proxy() ? qMax(requested_divider, vs->proxy_divider()) : requested_divider;
+
   if (scale_divider_ != divider) {
     FreeScaler();
     InitScaler(divider);
@@ -172,31 +260,69 @@ FramePtr FFmpegDecoder::RetrieveVideoInternal(const rational &timecode, const in
     if (pool_.width() != divided_width || pool_.height() != divided_height) {
       // Clear all instance queues
       ClearFrameCache();
+      ClearReverseSpans();
 
       // Set new frame pool parameters
-      pool_.SetParameters(divided_width, divided_height, native_pix_fmt_, native_channel_count_);
+      pool_.SetParameters(divided_width, divided_height, native_pix_fmt_, native_channel_count_,
+                          yuv_output_ ? GetYUVLayout(divider) : YUVLayout());
+    }
+
+    int64_t step = target_ts - last_requested_ts_;
+    bool playback = read_ahead_ && !best_effort
+        && last_requested_ts_ != AV_NOPTS_VALUE && step != 0 && qAbs(step) <= second_ts_;
+
+    // Playing backwards, decoders can only go forwards so rather than decoding from the keyframe
+    // for every frame, whole spans are decoded once and served backwards
+    bool reverse = playback && step < 0 && keyframe_index_.IsValid();
+
+    if (!reverse && !best_effort && !reverse_spans_.isEmpty()) {
+      ClearReverseSpans();
     }
 
     // Retrieve frame
-    FFmpegFramePool::ElementPtr return_frame = RetrieveFrame(target_ts, divider);
+    FFmpegFramePool::ElementPtr return_frame;
+
+    if (reverse) {
+      return_frame = RetrieveReverseFrame(target_ts, divider, cancelled);
+    } else if (best_effort) {
+      return_frame = RetrieveBestEffortFrame(target_ts, divider, cancelled);
+    } else {
+      return_frame = RetrieveFrame(target_ts, divider, cancelled);
+    }
+
+    // If requests look like playback, start decoding ahead of them. Best-effort requests come
+    // from scrubbing so they never do.
+    if (read_ahead_ && !best_effort) {
+      if (playback) {
+        int speed = qBound(int64_t(1), qAbs(step) / frame_duration_ts_, int64_t(kMaxReadAheadSpeed));
+        cache_limit_ = QThread::idealThreadCount() + kReadAheadFrames * speed;
+
+        read_ahead_->Hint(target_ts, step, divider);
+      }
+
+      last_requested_ts_ = target_ts;
+    }
 
-    // We found the frame, we'll return a copy
+    // We found the frame, return it in the buffer it was decoded into rather than a copy. The
+    // frame cache keeps referencing it, so the frame copies it if anyone writes to it.
     if (return_frame) {
-      FramePtr copy = Frame::Create();
-      copy->set_video_params(VideoParams(vs->width(),
-                                         vs->height(),
-                                         native_pix_fmt_,
-                                         native_channel_count_,
-                                         vs->pixel_aspect_ratio(),
-                                         vs->interlacing(),
-                                         divider));
-      copy->set_timestamp(timecode);
-      copy->allocate();
+      FramePtr frame = Frame::Create();
+      frame->set_video_params(VideoParams(vs->width(),
+                                          vs->height(),
+                                          native_pix_fmt_,
+                                          native_channel_count_,
+                                          vs->pixel_aspect_ratio(),
+                                          vs->interlacing(),
+                                          divider));
+      frame->set_timestamp(timecode);
+
+      if (yuv_output_) {
+        frame->set_yuv_layout(GetYUVLayout(divider));
+      }
 
-      // This data will already match the frame
-      memcpy(copy->data(), return_frame->data(), copy->allocated_size());
+      frame->set_buffer(return_frame);
 
-      return copy;
+      return frame;
     }
 
   }
@@ -204,9 +330,70 @@ FramePtr FFmpegDecoder::RetrieveVideoInternal(const rational &timecode, const in
   return nullptr;
 }
 
+int64_t FFmpegDecoder::GetRetrievalCostInternal(const rational &timecode)
+{
+  if (stream()->type() != Stream::kVideo) {
+    return kRetrievalCostSeek;
+  }
+
+  VideoStream* vs = static_cast<VideoStream*>(stream());
+
+  if (vs->video_type() == VideoStream::kVideoTypeStill) {
+    // Stills hold no decoding state, any instance is as good as another
+    return 0;
+  }
+
+  if (vs->video_type() == VideoStream::kVideoTypeImageSequence) {
+    return kRetrievalCostSeek;
+  }
+
+  int64_t target_ts = vs->get_time_in_timebase_units(timecode);
+
+  // Keeps reverse playback on the instance that buffered it
+  foreach (const ReverseSpan& span, reverse_spans_) {
+    if (target_ts >= span.start && target_ts <= span.end) {
+      return 0;
+    }
+  }
+
+  if (cached_frames_.isEmpty()) {
+    return kRetrievalCostSeek;
+  }
+
+  // Mirrors the cache window test in RetrieveFrame()
+  if (target_ts < cached_frames_.first()->timestamp()) {
+    return cache_at_zero_ ? 0 : kRetrievalCostSeek;
+  }
+
+  if (target_ts <= cached_frames_.last()->timestamp()) {
+    return 0;
+  }
+
+  if (IsBeyondCacheWindow(target_ts)) {
+    return cache_at_eof_ ? 0 : kRetrievalCostSeek;
+  }
+
+  // We'll have to decode forward to this frame, cost is proportional to the distance
+  return target_ts - cached_frames_.last()->timestamp();
+}
+
 void FFmpegDecoder::CloseInternal()
 {
+  if (read_ahead_) {
+    read_ahead_->Cancel();
+    delete read_ahead_;
+    read_ahead_ = nullptr;
+  }
+
   ClearFrameCache();
+  ClearReverseSpans();
+
+  keyframe_index_.Clear();
+  audio_index_attempted_ = false;
+
+  swr_free(&audio_resampler_);
+  audio_carry_ = nullptr;
+  audio_position_ = AV_NOPTS_VALUE;
 
   instance_.Close();
 
@@ -218,6 +405,11 @@ QString FFmpegDecoder::id()
   return QStringLiteral("ffmpeg");
 }
 
+QString FFmpegDecoder::version()
+{
+  return QStringLiteral(LIBAVFORMAT_IDENT " " LIBAVCODEC_IDENT);
+}
+
 Footage *FFmpegDecoder::Probe(const QString& filename, const QAtomicInt* cancelled) const
 {
   // Variable for receiving errors from FFmpeg
@@ -464,6 +656,184 @@ QString FFmpegDecoder::FFmpegError(int error_code)
   return QStringLiteral("%1 %2").arg(QString::number(error_code), err);
 }
 
+bool FFmpegDecoder::CanRetrieveAudioDirectlyInternal()
+{
+  if (!instance_.fmt_ctx()->pb || !instance_.fmt_ctx()->pb->seekable) {
+    return false;
+  }
+
+  // Every packet of an intra-only codec (PCM, FLAC, ALAC, etc.) decodes on its own, so a
+  // timestamp seek is already exact
+  const AVCodecDescriptor* desc = avcodec_descriptor_get(instance_.avstream()->codecpar->codec_id);
+  if (desc && (desc->props & AV_CODEC_PROP_INTRA_ONLY)) {
+    return true;
+  }
+
+  // Anything else (AAC, Opus, MP3, etc.) needs a packet index to seek accurately, which only
+  // takes demuxing the file once rather than decoding and writing all of it
+  if (!audio_index_attempted_) {
+    audio_index_attempted_ = true;
+    LoadKeyframeIndex();
+  }
+
+  return keyframe_index_.IsValid();
+}
+
+SampleBufferPtr FFmpegDecoder::RetrieveAudioDirectInternal(qint64 start, int count, const AudioParams &params, const QAtomicInt *cancelled)
+{
+  SampleBufferPtr block = SampleBuffer::CreateAllocated(params, count);
+  block->fill(0);
+
+  if (start + count <= 0) {
+    // Entirely before the stream
+    return block;
+  }
+
+  AVStream* s = instance_.avstream();
+  AVRational out_timebase = {1, params.sample_rate()};
+
+  if (!audio_resampler_ || audio_resampler_params_ != params) {
+    uint64_t channel_layout = ValidateChannelLayout(s);
+    if (!channel_layout) {
+      qCritical() << "Failed to determine channel layout of audio file, could not decode";
+      return nullptr;
+    }
+
+    swr_free(&audio_resampler_);
+
+    audio_resampler_ = swr_alloc_set_opts(nullptr,
+                                          params.channel_layout(),
+                                          AV_SAMPLE_FMT_FLTP,
+                                          params.sample_rate(),
+                                          channel_layout,
+                                          static_cast<AVSampleFormat>(s->codecpar->format),
+                                          s->codecpar->sample_rate,
+                                          0,
+                                          nullptr);
+
+    audio_resampler_params_ = params;
+    audio_position_ = AV_NOPTS_VALUE;
+  }
+
+  qint64 carry_start = audio_carry_ ? audio_position_ - audio_carry_->sample_count() : audio_position_;
+
+  if (audio_position_ == AV_NOPTS_VALUE || start != carry_start) {
+    // Not carrying on from the last block, seek a little early so the decoder and resampler have
+    // settled by the time we reach this one
+    swr_init(audio_resampler_);
+    audio_carry_ = nullptr;
+    audio_position_ = AV_NOPTS_VALUE;
+
+    int64_t preroll = qMax(second_ts_ / 10, av_rescale_q(s->codecpar->seek_preroll, {1, s->codecpar->sample_rate}, s->time_base));
+    int64_t target_ts = av_rescale_q(qMax(qint64(0), start), out_timebase, s->time_base) - preroll;
+
+    if (keyframe_index_.IsValid()) {
+      instance_.SeekToKeyframe(keyframe_index_.GetKeyframeBefore(target_ts));
+    } else {
+      instance_.Seek(qMax(int64_t(0), target_ts));
+    }
+  } else if (audio_carry_) {
+    // Decoded past the end of the last block, that's the start of this one
+    int carried = qMin(count, audio_carry_->sample_count());
+    block->set(audio_carry_->const_data(), 0, carried);
+    audio_carry_ = nullptr;
+  }
+
+  AVPacket* pkt = av_packet_alloc();
+  AVFrame* frame = av_frame_alloc();
+  QVector<const float*> planes(params.channel_count());
+
+  qint64 end = start + count;
+
+  // audio_position_ is where the resampler's next output belongs, placed by the first frame's
+  // timestamp after a seek and simply counted on from there so the result is sample accurate
+  while (audio_position_ == AV_NOPTS_VALUE || audio_position_ < end) {
+    if (cancelled && *cancelled) {
+      block = nullptr;
+      break;
+    }
+
+    int ret = instance_.GetFrame(pkt, frame);
+
+    if (ret < 0) {
+      if (ret != AVERROR_EOF) {
+        qWarning() << "Failed to decode audio:" << FFmpegError(ret);
+        block = nullptr;
+      }
+
+      // Anything past the end of the stream stays silent
+      break;
+    }
+
+    if (audio_position_ == AV_NOPTS_VALUE) {
+      if (frame->pts == AV_NOPTS_VALUE) {
+        qWarning() << "Audio frame has no timestamp, can't decode directly";
+        block = nullptr;
+        break;
+      }
+
+      audio_position_ = av_rescale_q(frame->pts, s->time_base, out_timebase);
+    }
+
+    int nb_samples = swr_get_out_samples(audio_resampler_, frame->nb_samples);
+    if (nb_samples <= 0) {
+      continue;
+    }
+
+    SampleBufferPtr resampled = SampleBuffer::CreateAllocated(params, nb_samples);
+
+    nb_samples = swr_convert(audio_resampler_,
+                             reinterpret_cast<uint8_t**>(resampled->data()),
+                             nb_samples,
+                             const_cast<const uint8_t**>(frame->extended_data),
+                             frame->nb_samples);
+
+    if (nb_samples < 0) {
+      qWarning() << "libswresample failed with error:" << FFmpegError(nb_samples);
+      block = nullptr;
+      break;
+    }
+
+    qint64 copy_start = qMax(start, audio_position_);
+    qint64 copy_end = qMin(end, audio_position_ + nb_samples);
+
+    if (copy_end > copy_start) {
+      for (int i=0; i<planes.size(); i++) {
+        planes[i] = resampled->const_data()[i] + (copy_start - audio_position_);
+      }
+
+      block->set(planes.data(), static_cast<int>(copy_start - start), static_cast<int>(copy_end - copy_start));
+    }
+
+    if (audio_position_ + nb_samples > end) {
+      // Keep what's left over for the next block, which will most likely be requested next
+      int offset = static_cast<int>(qMax(qint64(0), end - audio_position_));
+      int leftover = nb_samples - offset;
+
+      audio_carry_ = SampleBuffer::CreateAllocated(params, leftover);
+
+      for (int i=0; i<planes.size(); i++) {
+        planes[i] = resampled->const_data()[i] + offset;
+      }
+
+      audio_carry_->set(planes.data(), leftover);
+    }
+
+    audio_position_ += nb_samples;
+  }
+
+  if (!block || audio_position_ < end) {
+    // Cancelled, failed, or reached the end of the stream, start over with a seek next time
+    audio_position_ = AV_NOPTS_VALUE;
+    audio_carry_ = nullptr;
+  }
+
+  av_frame_free(&frame);
+  av_packet_free(&pkt);
+
+  return block;
+}
+
 bool FFmpegDecoder::ConformAudioInternal(const QString &filename, const AudioParams &params, const QAtomicInt *cancelled)
 {
   // Iterate through each audio frame and extract the PCM data
@@ -491,7 +861,7 @@ bool FFmpegDecoder::ConformAudioInternal(const QString &filename, const AudioPar
 
   swr_init(resampler);
 
-  WaveOutput wave_out(filename, params);
+  PlanarAudioOutput conform_out(filename, params);
 
   AVPacket* pkt = av_packet_alloc();
   AVFrame* frame = av_frame_alloc();
@@ -499,7 +869,7 @@ bool FFmpegDecoder::ConformAudioInternal(const QString &filename, const AudioPar
 
   bool success = false;
 
-  if (wave_out.open()) {
+  if (conform_out.open()) {
     while (true) {
       // Check if we have a `cancelled` ptr and its value
       if (cancelled && *cancelled) {
@@ -539,8 +909,8 @@ bool FFmpegDecoder::ConformAudioInternal(const QString &filename, const AudioPar
         break;
       }
 
-      // Write packed WAV data to the disk cache
-      wave_out.write(data, params.samples_to_bytes(nb_samples));
+      // Write packed data to the disk cache, it's stored planar for fast retrieval
+      conform_out.write(data, params.samples_to_bytes(nb_samples));
 
       // If we allocated an output for the resampler, delete it here
       if (data != reinterpret_cast<char*>(frame->data[0])) {
@@ -550,9 +920,9 @@ bool FFmpegDecoder::ConformAudioInternal(const QString &filename, const AudioPar
       SignalProcessingProgress(frame->pts);
     }
 
-    wave_out.close();
+    conform_out.close();
   } else {
-    qWarning() << "Failed to open WAVE output for indexing";
+    qWarning() << "Failed to open conform output for indexing";
   }
 
   swr_free(&resampler);
@@ -563,6 +933,212 @@ bool FFmpegDecoder::ConformAudioInternal(const QString &filename, const AudioPar
   return success;
 }
 
+/**
+ * @brief Decode a packet (or flush if `pkt` is nullptr) and write it resampled to a conform
+ */
+static bool ConformPacket(AVCodecContext* codec_ctx, SwrContext* resampler, PlanarAudioOutput* output,
+                          AVPacket* pkt, AVFrame* frame)
+{
+  const AudioParams& params = output->params();
+
+  int ret = avcodec_send_packet(codec_ctx, pkt);
+
+  if (ret < 0 && ret != AVERROR_EOF) {
+    char err_str[50];
+    av_strerror(ret, err_str, 50);
+    qWarning() << "Failed to conform:" << ret << err_str;
+    return false;
+  }
+
+  while ((ret = avcodec_receive_frame(codec_ctx, frame)) >= 0) {
+    int nb_samples = swr_get_out_samples(resampler, frame->nb_samples);
+    QByteArray data(static_cast<int>(params.samples_to_bytes(nb_samples)), Qt::Uninitialized);
+    uint8_t* out = reinterpret_cast<uint8_t*>(data.data());
+
+    nb_samples = swr_convert(resampler,
+                             &out,
+                             nb_samples,
+                             const_cast<const uint8_t**>(frame->data),
+                             frame->nb_samples);
+
+    av_frame_unref(frame);
+
+    if (nb_samples < 0) {
+      char err_str[50];
+      av_strerror(nb_samples, err_str, 50);
+      qWarning() << "libswresample failed with error:" << nb_samples << err_str;
+      return false;
+    }
+
+    output->write(data.constData(), static_cast<int>(params.samples_to_bytes(nb_samples)));
+  }
+
+  return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF;
+}
+
+bool FFmpegDecoder::ConformAudioStreamsInternal(const QVector<Stream *> &streams, const QStringList &filenames,
+                                                const AudioParams &params, const QAtomicInt *cancelled)
+{
+  if (streams.size() == 1 && streams.first() == stream()) {
+    return ConformAudioInternal(filenames.first(), params, cancelled);
+  }
+
+  // Read the file once and hand each packet to the stream it belongs to, rather than demuxing the
+  // whole file again for every stream
+  struct Conform {
+    AVCodecContext* codec_ctx;
+    SwrContext* resampler;
+    PlanarAudioOutput* output;
+  };
+
+  AVFormatContext* fmt_ctx = nullptr;
+  QByteArray fn = filename().toUtf8();
+
+  int ret = avformat_open_input(&fmt_ctx, fn.constData(), nullptr, nullptr);
+
+  if (ret != 0) {
+    qCritical() << "Failed to open input:" << filename() << FFmpegError(ret);
+    return false;
+  }
+
+  ret = avformat_find_stream_info(fmt_ctx, nullptr);
+
+  if (ret < 0) {
+    qCritical() << "Failed to find stream info:" << FFmpegError(ret);
+    avformat_close_input(&fmt_ctx);
+    return false;
+  }
+
+  QVector<Conform> conforms(streams.size(), {nullptr, nullptr, nullptr});
+  QVector<int> stream_map(static_cast<int>(fmt_ctx->nb_streams), -1);
+  bool success = true;
+
+  for (int i=0; i<streams.size() && success; i++) {
+    int index = streams.at(i)->index();
+
+    if (index < 0 || index >= static_cast<int>(fmt_ctx->nb_streams)) {
+      qCritical() << "Stream" << index << "doesn't exist in" << filename();
+      success = false;
+      break;
+    }
+
+    AVStream* avstream = fmt_ctx->streams[index];
+    AVCodec* codec = avcodec_find_decoder(avstream->codecpar->codec_id);
+    uint64_t channel_layout = ValidateChannelLayout(avstream);
+
+    if (!codec || !channel_layout) {
+      qCritical() << "Failed to set up decoding of audio stream" << index << "for conforming";
+      success = false;
+      break;
+    }
+
+    Conform& c = conforms[i];
+
+    c.codec_ctx = avcodec_alloc_context3(codec);
+
+    if (!c.codec_ctx
+        || avcodec_parameters_to_context(c.codec_ctx, avstream->codecpar) < 0
+        || avcodec_open2(c.codec_ctx, codec, nullptr) < 0) {
+      qCritical() << "Failed to open decoder for audio stream" << index;
+      success = false;
+      break;
+    }
+
+    c.resampler = swr_alloc_set_opts(nullptr,
+                                     params.channel_layout(),
+                                     FFmpegUtils::GetFFmpegSampleFormat(params.format()),
+                                     params.sample_rate(),
+                                     channel_layout,
+                                     static_cast<AVSampleFormat>(avstream->codecpar->format),
+                                     avstream->codecpar->sample_rate,
+                                     0,
+                                     nullptr);
+
+    if (!c.resampler || swr_init(c.resampler) < 0) {
+      qCritical() << "Failed to create resampler for audio stream" << index;
+      success = false;
+      break;
+    }
+
+    c.output = new PlanarAudioOutput(filenames.at(i), params);
+
+    if (!c.output->open()) {
+      qWarning() << "Failed to open conform output for indexing";
+      success = false;
+      break;
+    }
+
+    stream_map[index] = i;
+  }
+
+  // Don't spend time demuxing streams nobody asked for
+  for (unsigned int i=0; i<fmt_ctx->nb_streams; i++) {
+    if (stream_map.at(static_cast<int>(i)) == -1) {
+      fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+    }
+  }
+
+  AVPacket* pkt = av_packet_alloc();
+  AVFrame* frame = av_frame_alloc();
+
+  while (success) {
+    if (cancelled && *cancelled) {
+      success = false;
+      break;
+    }
+
+    ret = av_read_frame(fmt_ctx, pkt);
+
+    if (ret == AVERROR_EOF) {
+      break;
+    } else if (ret < 0) {
+      char err_str[50];
+      av_strerror(ret, err_str, 50);
+      qWarning() << "Failed to conform:" << ret << err_str;
+      success = false;
+      break;
+    }
+
+    int conform_index = (pkt->stream_index < stream_map.size()) ? stream_map.at(pkt->stream_index) : -1;
+
+    if (conform_index >= 0) {
+      const Conform& c = conforms.at(conform_index);
+
+      success = ConformPacket(c.codec_ctx, c.resampler, c.output, pkt, frame);
+
+      if (streams.at(conform_index) == stream()) {
+        SignalProcessingProgress(pkt->pts);
+      }
+    }
+
+    av_packet_unref(pkt);
+  }
+
+  for (int i=0; i<conforms.size(); i++) {
+    Conform& c = conforms[i];
+
+    if (success && c.codec_ctx) {
+      // Drain whatever the decoder is still holding onto
+      success = ConformPacket(c.codec_ctx, c.resampler, c.output, nullptr, frame);
+    }
+
+    if (c.output) {
+      c.output->close();
+      delete c.output;
+    }
+
+    swr_free(&c.resampler);
+    avcodec_free_context(&c.codec_ctx);
+  }
+
+  av_frame_free(&frame);
+  av_packet_free(&pkt);
+
+  avformat_close_input(&fmt_ctx);
+
+  return success;
+}
+
 VideoParams::Format FFmpegDecoder::GetNativePixelFormat(AVPixelFormat pix_fmt)
 {
   switch (pix_fmt) {
@@ -600,23 +1176,98 @@ uint64_t FFmpegDecoder::ValidateChannelLayout(AVStream* stream)
   return av_get_default_channel_layout(stream->codecpar->channels);
 }
 
-void FFmpegDecoder::FFmpegBufferToNativeBuffer(uint8_t **input_data, int *input_linesize, uint8_t** output_buffer, int* output_linesize)
+bool FFmpegDecoder::IsPlanarYUV(AVPixelFormat pix_fmt)
 {
-  sws_scale(scale_ctx_,
-            input_data,
-            input_linesize,
-            0,
-            instance_.avstream()->codecpar->height,
-            output_buffer,
-            output_linesize);
-}
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pix_fmt);
 
-/* OLD UNUSED CODE: Keeping this around in case the code proves useful
+  if (!desc
+      || desc->nb_components != 3
+      || !(desc->flags & AV_PIX_FMT_FLAG_PLANAR)
+      || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BE
+                         | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM))) {
+    return false;
+  }
 
-void FFmpegDecoder::CacheFrameToDisk(AVFrame *f)
-{
-  QFile save_frame(GetIndexFilename().append(QString::number(f->pts)));
-  if (save_frame.open(QFile::WriteOnly)) {
+  // Each component must be in its own plane (rules out NV12 and the like) and stored in either
+  // 8 or 16-bit samples so the planes can be uploaded as single channel textures
+  int depth = desc->comp[0].depth;
+
+  if (depth > 16) {
+    return false;
+  }
+
+  for (int i=0; i<3; i++) {
+    if (desc->comp[i].plane != i
+        || desc->comp[i].depth != depth
+        || desc->comp[i].step != ((depth > 8) ? 2 : 1)
+        || desc->comp[i].shift != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+YUVLayout FFmpegDecoder::GetYUVLayout(int divider) const
+{
+  AVPixelFormat pix_fmt = instance_.pix_fmt();
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pix_fmt);
+  AVCodecParameters* codecpar = instance_.avstream()->codecpar;
+
+  VideoStream* vs = static_cast<VideoStream*>(stream());
+
+  int width = VideoParams::GetScaledDimension(vs->width(), divider);
+  int height = VideoParams::GetScaledDimension(vs->height(), divider);
+
+  YUVLayout::Matrix matrix;
+  switch (codecpar->color_space) {
+  case AVCOL_SPC_BT709:
+    matrix = YUVLayout::kMatrixBT709;
+    break;
+  case AVCOL_SPC_BT2020_NCL:
+  case AVCOL_SPC_BT2020_CL:
+    matrix = YUVLayout::kMatrixBT2020;
+    break;
+  case AVCOL_SPC_BT470BG:
+  case AVCOL_SPC_SMPTE170M:
+  case AVCOL_SPC_FCC:
+    matrix = YUVLayout::kMatrixBT601;
+    break;
+  default:
+    // Unspecified, make the same guess most players do
+    matrix = (codecpar->height >= 720) ? YUVLayout::kMatrixBT709 : YUVLayout::kMatrixBT601;
+  }
+
+  bool full_range = (codecpar->color_range == AVCOL_RANGE_JPEG
+                     || pix_fmt == AV_PIX_FMT_YUVJ420P
+                     || pix_fmt == AV_PIX_FMT_YUVJ422P
+                     || pix_fmt == AV_PIX_FMT_YUVJ440P
+                     || pix_fmt == AV_PIX_FMT_YUVJ444P);
+
+  return YUVLayout((width + (1 << desc->log2_chroma_w) - 1) >> desc->log2_chroma_w,
+                   (height + (1 << desc->log2_chroma_h) - 1) >> desc->log2_chroma_h,
+                   desc->comp[0].depth,
+                   matrix,
+                   full_range);
+}
+
+void FFmpegDecoder::FFmpegBufferToNativeBuffer(uint8_t **input_data, int *input_linesize, uint8_t** output_buffer, int* output_linesize)
+{
+  sws_scale(scale_ctx_,
+            input_data,
+            input_linesize,
+            0,
+            instance_.avstream()->codecpar->height,
+            output_buffer,
+            output_linesize);
+}
+
+/* OLD UNUSED CODE: Keeping this around in case the code proves useful
+
+void FFmpegDecoder::CacheFrameToDisk(AVFrame *f)
+{
+  QFile save_frame(GetIndexFilename().append(QString::number(f->pts)));
+  if (save_frame.open(QFile::WriteOnly)) {
 
     // Save frame to media index
     int cached_buffer_sz = av_image_get_buffer_size(static_cast<AVPixelFormat>(f->format),
@@ -675,22 +1326,30 @@ void FFmpegDecoder::ClearFrameCache()
   cache_at_zero_ = false;
 }
 
-FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveFrame(const int64_t& target_ts, int divider)
+FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveFrame(const int64_t& target_ts, int divider, const QAtomicInt *cancelled)
 {
   int64_t seek_ts = target_ts;
   bool still_seeking = false;
 
   // If the frame wasn't in the frame cache, see if this frame cache is too old to use
   if (cached_frames_.isEmpty()
-      || (target_ts < cached_frames_.first()->timestamp() || target_ts > cached_frames_.last()->timestamp() + 2*second_ts_)) {
+      || (target_ts < cached_frames_.first()->timestamp() || IsBeyondCacheWindow(target_ts))) {
     ClearFrameCache();
 
-    instance_.Seek(seek_ts);
-    if (seek_ts == 0) {
-      cache_at_zero_ = true;
-    }
+    if (keyframe_index_.IsValid()) {
+      // We know exactly which keyframe this frame needs, so one seek is always enough
+      const FFmpegKeyframeIndex::Keyframe& keyframe = keyframe_index_.GetKeyframeBefore(target_ts);
 
-    still_seeking = true;
+      instance_.SeekToKeyframe(keyframe);
+      cache_at_zero_ = (&keyframe == &keyframe_index_.keyframes().first());
+    } else {
+      instance_.Seek(seek_ts);
+      if (seek_ts == 0) {
+        cache_at_zero_ = true;
+      }
+
+      still_seeking = true;
+    }
   } else {
     // Search cache for frame
     FFmpegFramePool::ElementPtr cached_frame = GetFrameFromCache(target_ts);
@@ -699,6 +1358,9 @@ FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveFrame(const int64_t& target_t
     }
   }
 
+  // We're about to move the decoder, so any reverse span it was partway through has to start over
+  reverse_span_owns_instance_ = false;
+
   int ret;
   AVPacket* pkt = av_packet_alloc();
   FFmpegFramePool::ElementPtr return_frame = nullptr;
@@ -708,6 +1370,11 @@ FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveFrame(const int64_t& target_t
 
   while (true) {
 
+    if (cancelled && *cancelled) {
+      // Whatever we decoded so far is cached, so a later request for this frame resumes from here
+      break;
+    }
+
     // Pull from the decoder
     ret = instance_.GetFrame(pkt, working_frame);
 
@@ -753,25 +1420,16 @@ FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveFrame(const int64_t& target_t
     } else {
 
       // Cut down to thread count - 1 before we acquire a new frame
-      if (cached_frames_.size() == QThread::idealThreadCount()) {
+      while (cached_frames_.size() >= cache_limit_) {
         RemoveFirstFrame();
       }
 
-      FFmpegFramePool::ElementPtr cached = pool_.Get();
+      FFmpegFramePool::ElementPtr cached = StoreFrame(working_frame, divider);
 
       if (!cached) {
-        qCritical() << "Frame pool failed to return a valid frame - out of memory?";
         break;
       }
 
-      // Store in queue, converting to native format
-      uint8_t* destination_data = cached->data();
-      int destination_linesize = Frame::generate_linesize_bytes(VideoParams::GetScaledDimension(instance_.avstream()->codecpar->width, divider), native_pix_fmt_, native_channel_count_);
-      FFmpegBufferToNativeBuffer(working_frame->data, working_frame->linesize, &destination_data, &destination_linesize);
-
-      // Set timestamp so this frame can be identified later
-      cached->set_timestamp(working_frame->pts);
-
       // Store frame before just in case
       FFmpegFramePool::ElementPtr previous;
       if (cached_frames_.isEmpty()) {
@@ -805,6 +1463,249 @@ FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveFrame(const int64_t& target_t
   return return_frame;
 }
 
+FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveBestEffortFrame(const int64_t &target_ts, int divider, const QAtomicInt *cancelled)
+{
+  if (!keyframe_index_.IsValid()) {
+    // Without the index we don't know where the keyframe is, so there's nothing cheaper to do
+    return RetrieveFrame(target_ts, divider, cancelled);
+  }
+
+  const FFmpegKeyframeIndex::Keyframe& keyframe = keyframe_index_.GetKeyframeBefore(target_ts);
+
+  if (!cached_frames_.isEmpty()
+      && cached_frames_.first()->timestamp() <= target_ts
+      && cached_frames_.last()->timestamp() >= keyframe.pts) {
+    // We already decoded something between the keyframe and the target, the closest of those is
+    // nearer to what was asked for and costs nothing
+    FFmpegFramePool::ElementPtr cached = GetFrameFromCache(qMin(target_ts, cached_frames_.last()->timestamp()));
+
+    if (cached) {
+      return cached;
+    }
+  }
+
+  // Otherwise the keyframe itself is the only frame we can get without decoding others first
+  return RetrieveFrame(keyframe.pts, divider, cancelled);
+}
+
+FFmpegFramePool::ElementPtr FFmpegDecoder::StoreFrame(AVFrame *working_frame, int divider)
+{
+  FFmpegFramePool::ElementPtr cached = pool_.Get();
+
+  if (!cached) {
+    qCritical() << "Frame pool failed to return a valid frame - out of memory?";
+    return nullptr;
+  }
+
+  // Store in queue, converting to native format
+  // Sizes are relative to the original stream, which a proxy is smaller than
+  VideoStream* vs = static_cast<VideoStream*>(stream());
+  int scaled_width = VideoParams::GetScaledDimension(vs->width(), divider);
+
+  if (yuv_output_) {
+    int scaled_height = VideoParams::GetScaledDimension(vs->height(), divider);
+    int offsets[3];
+    int destination_linesize[3];
+    Frame::generate_yuv_planes(scaled_width, scaled_height, native_pix_fmt_, GetYUVLayout(divider),
+                               offsets, destination_linesize);
+
+    uint8_t* destination_data[3];
+    for (int i=0; i<3; i++) {
+      destination_data[i] = reinterpret_cast<uint8_t*>(cached->data()) + offsets[i];
+    }
+
+    FFmpegBufferToNativeBuffer(working_frame->data, working_frame->linesize, destination_data, destination_linesize);
+  } else {
+    uint8_t* destination_data = reinterpret_cast<uint8_t*>(cached->data());
+    int destination_linesize = Frame::generate_linesize_bytes(scaled_width, native_pix_fmt_, native_channel_count_);
+    FFmpegBufferToNativeBuffer(working_frame->data, working_frame->linesize, &destination_data, &destination_linesize);
+  }
+
+  // Set timestamp so this frame can be identified later
+  cached->set_timestamp(working_frame->pts);
+
+  return cached;
+}
+
+FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveReverseFrame(const int64_t &target_ts, int divider, const QAtomicInt *cancelled)
+{
+  FFmpegFramePool::ElementPtr frame = GetFrameFromReverseSpans(target_ts);
+
+  if (frame) {
+    return frame;
+  }
+
+  // Usually the read-ahead thread is already decoding the span we need, so we finish it off rather
+  // than starting again
+  if (reverse_prefetch_.end == AV_NOPTS_VALUE
+      || target_ts < reverse_prefetch_.start || target_ts > reverse_prefetch_.end) {
+    reverse_prefetch_ = CreateReverseSpan(target_ts);
+  }
+
+  while (!reverse_prefetch_.finished) {
+    if (cancelled && *cancelled) {
+      // What we decoded so far stays in the span for the next request to carry on from
+      return nullptr;
+    }
+
+    if (!StepReverseSpan(&reverse_prefetch_, divider)) {
+      break;
+    }
+  }
+
+  if (reverse_prefetch_.frames.isEmpty()) {
+    // Couldn't decode anything this way, try the usual way
+    reverse_prefetch_ = ReverseSpan();
+    return RetrieveFrame(target_ts, divider, cancelled);
+  }
+
+  AddReverseSpan(reverse_prefetch_);
+  reverse_prefetch_ = ReverseSpan();
+
+  return GetFrameFromReverseSpans(target_ts);
+}
+
+FFmpegDecoder::ReverseSpan FFmpegDecoder::CreateReverseSpan(int64_t end) const
+{
+  ReverseSpan span;
+
+  // Ideally the whole GOP, but long GOPs are capped so memory stays bounded. Those cost one decode
+  // of the frames before the span per kMaxReverseSpanFrames shown, still far fewer than a GOP each.
+  span.end = end;
+  span.start = qMax(keyframe_index_.GetKeyframeBefore(end).pts, end - (kMaxReverseSpanFrames - 1) * frame_duration_ts_);
+
+  return span;
+}
+
+bool FFmpegDecoder::StepReverseSpan(ReverseSpan *span, int divider)
+{
+  if (span->started && !reverse_span_owns_instance_) {
+    // Someone else moved the decoder in the meantime
+    span->frames.clear();
+    span->started = false;
+  }
+
+  if (!span->started) {
+    // The forward cache won't follow on from wherever this leaves the decoder
+    ClearFrameCache();
+
+    instance_.SeekToKeyframe(keyframe_index_.GetKeyframeBefore(span->start));
+    span->started = true;
+    reverse_span_owns_instance_ = true;
+  }
+
+  AVPacket* pkt = av_packet_alloc();
+  AVFrame* working_frame = av_frame_alloc();
+
+  int ret = instance_.GetFrame(pkt, working_frame);
+
+  bool ok = true;
+
+  if (ret == AVERROR_EOF) {
+    span->finished = true;
+  } else if (ret < 0) {
+    qCritical() << "Failed to retrieve frame:" << ret;
+    span->finished = true;
+    ok = false;
+  } else if (working_frame->pts > span->end) {
+    // Past the end, which happens when frames don't land exactly on the end timestamp
+    span->finished = true;
+  } else if (working_frame->pts >= span->start) {
+    FFmpegFramePool::ElementPtr cached = StoreFrame(working_frame, divider);
+
+    if (cached) {
+      span->frames.append(cached);
+      span->finished = (working_frame->pts == span->end);
+    } else {
+      span->finished = true;
+      ok = false;
+    }
+  }
+
+  av_frame_free(&working_frame);
+  av_packet_free(&pkt);
+
+  return ok;
+}
+
+void FFmpegDecoder::AddReverseSpan(const ReverseSpan &span)
+{
+  reverse_spans_.append(span);
+
+  // Reverse playback has already been through the latest spans
+  while (reverse_spans_.size() > kReverseSpanCount) {
+    int latest = 0;
+
+    for (int i=1; i<reverse_spans_.size(); i++) {
+      if (reverse_spans_.at(i).start > reverse_spans_.at(latest).start) {
+        latest = i;
+      }
+    }
+
+    reverse_spans_.removeAt(latest);
+  }
+}
+
+FFmpegFramePool::ElementPtr FFmpegDecoder::GetFrameFromReverseSpans(const int64_t &target_ts) const
+{
+  foreach (const ReverseSpan& span, reverse_spans_) {
+    if (target_ts < span.start || target_ts > span.end || span.frames.isEmpty()) {
+      continue;
+    }
+
+    // The last frame at or before the target, frames don't necessarily land on every timestamp
+    for (int i=span.frames.size()-1; i>=0; i--) {
+      if (span.frames.at(i)->timestamp() <= target_ts || i == 0) {
+        span.frames.at(i)->access();
+        return span.frames.at(i);
+      }
+    }
+  }
+
+  return nullptr;
+}
+
+void FFmpegDecoder::ClearReverseSpans()
+{
+  reverse_spans_.clear();
+  reverse_prefetch_ = ReverseSpan();
+}
+
+bool FFmpegDecoder::PrefetchReverseSpan(int64_t position, int divider)
+{
+  // Only prefetch once playback has reached the earliest span, one span ahead is enough
+  const ReverseSpan* earliest = nullptr;
+
+  foreach (const ReverseSpan& span, reverse_spans_) {
+    if (!earliest || span.start < earliest->start) {
+      earliest = &span;
+    }
+  }
+
+  if (!earliest || earliest->start <= 0 || position > earliest->end) {
+    return false;
+  }
+
+  int64_t end = earliest->start - frame_duration_ts_;
+
+  if (reverse_prefetch_.end != end) {
+    reverse_prefetch_ = CreateReverseSpan(end);
+  }
+
+  if (!StepReverseSpan(&reverse_prefetch_, divider)) {
+    reverse_prefetch_ = ReverseSpan();
+    return false;
+  }
+
+  if (reverse_prefetch_.finished) {
+    AddReverseSpan(reverse_prefetch_);
+    reverse_prefetch_ = ReverseSpan();
+    return false;
+  }
+
+  return true;
+}
+
 void FFmpegDecoder::InitScaler(int divider)
 {
   VideoStream* vs = static_cast<VideoStream*>(stream());
@@ -812,12 +1713,12 @@ void FFmpegDecoder::InitScaler(int divider)
   int scaled_width = VideoParams::GetScaledDimension(vs->width(), divider);
   int scaled_height = VideoParams::GetScaledDimension(vs->height(), divider);
 
-  scale_ctx_ = sws_getContext(vs->width(),
-                              vs->height(),
-                              static_cast<AVPixelFormat>(instance_.avstream()->codecpar->format),
+  scale_ctx_ = sws_getContext(instance_.avstream()->codecpar->width,
+                              instance_.avstream()->codecpar->height,
+                              instance_.pix_fmt(),
                               scaled_width,
                               scaled_height,
-                              ideal_pix_fmt_,
+                              yuv_output_ ? instance_.pix_fmt() : ideal_pix_fmt_,
                               SWS_FAST_BILINEAR,
                               nullptr,
                               nullptr,
@@ -953,14 +1854,225 @@ void FFmpegDecoder::RemoveFirstFrame()
   cache_at_zero_ = false;
 }
 
+bool FFmpegDecoder::IsBeyondCacheWindow(const int64_t &target_ts) const
+{
+  if (keyframe_index_.IsValid()) {
+    // Seeking would take us to the keyframe before the target anyway, only worth it if that
+    // keyframe comes after what we've already decoded
+    return keyframe_index_.GetKeyframeBefore(target_ts).pts > cached_frames_.last()->timestamp();
+  }
+
+  return target_ts > cached_frames_.last()->timestamp() + 2*second_ts_;
+}
+
+void FFmpegDecoder::LoadKeyframeIndex()
+{
+  QString index_fn = GetIndexFilename().append(QStringLiteral(".keyframes"));
+
+  {
+    QMutexLocker locker(&keyframe_index_cache_lock_);
+
+    if (FFmpegKeyframeIndex* cached = keyframe_index_cache_.object(index_fn)) {
+      // Keyframes are implicitly shared so this is cheap
+      keyframe_index_ = *cached;
+      return;
+    }
+  }
+
+  if (keyframe_index_.Load(index_fn)) {
+    QMutexLocker locker(&keyframe_index_cache_lock_);
+    keyframe_index_cache_.insert(index_fn, new FFmpegKeyframeIndex(keyframe_index_),
+                                 keyframe_index_.keyframes().size());
+    return;
+  }
+
+  // Like conforms, we write to a different filename until it's done so a half-written index is
+  // never picked up
+  QString working_fn = index_fn;
+  working_fn.append(QStringLiteral(".working"));
+
+  if (keyframe_index_.Build(filename().toUtf8(), stream_index(), nullptr,
+                            [this](int64_t ts){ SignalProcessingProgress(ts); })
+      && keyframe_index_.Save(working_fn)) {
+    QFile::remove(index_fn);
+    QFile::rename(working_fn, index_fn);
+
+    QMutexLocker locker(&keyframe_index_cache_lock_);
+    keyframe_index_cache_.insert(index_fn, new FFmpegKeyframeIndex(keyframe_index_),
+                                 keyframe_index_.keyframes().size());
+  } else {
+    // We'll fall back to searching for keyframes with repeated seeks
+    qWarning() << "Failed to build keyframe index for" << filename();
+    keyframe_index_.Clear();
+  }
+}
+
+void FFmpegDecoder::ReadAhead(int64_t position, int64_t step, int divider)
+{
+  if (step < 0 && keyframe_index_.IsValid()) {
+    // Reverse playback, decode the span before the ones being played a frame at a time
+    while (LockForReadAhead()) {
+      bool more = !read_ahead_->ShouldStop()
+          && scale_divider_ == divider
+          && !MemoryPoolLimitReached()
+          && PrefetchReverseSpan(position, divider);
+
+      mutex()->unlock();
+
+      if (!more) {
+        break;
+      }
+    }
+
+    return;
+  }
+
+  int span = (cache_limit_ - QThread::idealThreadCount());
+  QVector<int64_t> targets;
+
+  if (step > 0) {
+    // Forward, decode the frames immediately after the playhead
+    for (int i=1; i<=span; i++) {
+      targets.append(position + i * frame_duration_ts_);
+    }
+  } else {
+    // Backward, decoders can only go forward so seek back a window's length and decode up to
+    // the playhead. This clears the cache so we only do it once the window is running low.
+    int64_t start = qMax(int64_t(0), position - span * frame_duration_ts_);
+
+    for (int64_t t=start; t<position; t+=frame_duration_ts_) {
+      targets.append(t);
+    }
+  }
+
+  foreach (int64_t t, targets) {
+    if (!LockForReadAhead()) {
+      return;
+    }
+
+    bool stop = read_ahead_->ShouldStop()
+        || scale_divider_ != divider
+        || MemoryPoolLimitReached();
+
+    if (!stop && step < 0 && t == targets.first()
+        && !cached_frames_.isEmpty()
+        && cached_frames_.first()->timestamp() <= position - (span / 2) * frame_duration_ts_) {
+      // Still plenty of frames behind the playhead
+      stop = true;
+    }
+
+    if (!stop && step > 0 && cache_at_eof_
+        && !cached_frames_.isEmpty() && t > cached_frames_.last()->timestamp()) {
+      // Nothing left to decode
+      stop = true;
+    }
+
+    if (!stop) {
+      RetrieveFrame(t, divider);
+    }
+
+    mutex()->unlock();
+
+    if (stop) {
+      return;
+    }
+  }
+}
+
+bool FFmpegDecoder::LockForReadAhead()
+{
+  // Close() holds the mutex while it waits for this thread, so we can't block on it indefinitely
+  while (!mutex()->tryLock(10)) {
+    if (read_ahead_->IsCancelled()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+FFmpegDecoder::ReadAheadThread::ReadAheadThread(FFmpegDecoder *decoder) :
+  decoder_(decoder),
+  position_(0),
+  step_(0),
+  divider_(0),
+  has_hint_(false),
+  cancelled_(false)
+{
+}
+
+void FFmpegDecoder::ReadAheadThread::Hint(int64_t position, int64_t step, int divider)
+{
+  QMutexLocker locker(&hint_lock_);
+
+  position_ = position;
+  step_ = step;
+  divider_ = divider;
+  has_hint_ = true;
+
+  hint_cond_.wakeOne();
+}
+
+void FFmpegDecoder::ReadAheadThread::Cancel()
+{
+  hint_lock_.lock();
+  cancelled_ = true;
+  hint_cond_.wakeOne();
+  hint_lock_.unlock();
+
+  wait();
+}
+
+bool FFmpegDecoder::ReadAheadThread::ShouldStop()
+{
+  QMutexLocker locker(&hint_lock_);
+  return has_hint_ || cancelled_;
+}
+
+bool FFmpegDecoder::ReadAheadThread::IsCancelled()
+{
+  QMutexLocker locker(&hint_lock_);
+  return cancelled_;
+}
+
+void FFmpegDecoder::ReadAheadThread::run()
+{
+  hint_lock_.lock();
+
+  while (!cancelled_) {
+    if (!has_hint_) {
+      hint_cond_.wait(&hint_lock_);
+      continue;
+    }
+
+    int64_t position = position_;
+    int64_t step = step_;
+    int divider = divider_;
+    has_hint_ = false;
+
+    hint_lock_.unlock();
+
+    decoder_->ReadAhead(position, step, divider);
+
+    hint_lock_.lock();
+  }
+
+  hint_lock_.unlock();
+}
+
 FFmpegDecoder::Instance::Instance() :
   fmt_ctx_(nullptr),
   codec_ctx_(nullptr),
-  opts_(nullptr)
+  avstream_(nullptr),
+  opts_(nullptr),
+  hw_device_ctx_(nullptr),
+  hw_pix_fmt_(AV_PIX_FMT_NONE),
+  hw_transfer_frame_(nullptr),
+  pix_fmt_(AV_PIX_FMT_NONE)
 {
 }
 
-bool FFmpegDecoder::Instance::Open(const char *filename, int stream_index)
+bool FFmpegDecoder::Instance::Open(const char *filename, int stream_index, bool hw_accel)
 {
   // Open file in a format context
   int error_code = avformat_open_input(&fmt_ctx_, filename, nullptr, nullptr);
@@ -1011,8 +2123,14 @@ bool FFmpegDecoder::Instance::Open(const char *filename, int stream_index)
     return false;
   }
 
-  // Set multithreading setting
-  error_code = av_dict_set(&opts_, "threads", "auto", 0);
+  pix_fmt_ = static_cast<AVPixelFormat>(avstream_->codecpar->format);
+
+  if (hw_accel && !SetupHardwareDevice(codec)) {
+    return false;
+  }
+
+  // Set multithreading setting, budgeted since render workers are decoding in parallel too
+  error_code = av_dict_set(&opts_, "threads", QString::number(ThreadAffinity::GetDecoderThreadCount()).toUtf8().constData(), 0);
 
   // Handle failure to set multithreaded decoding
   if (error_code < 0) {
@@ -1028,11 +2146,111 @@ bool FFmpegDecoder::Instance::Open(const char *filename, int stream_index)
     return false;
   }
 
+  if (hw_device_ctx_) {
+    // Decode one frame to make sure the device actually works with this stream, drivers will
+    // happily create a device for profiles they can't decode. This also tells us what format
+    // frames will be transferred as.
+    AVPacket* pkt = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+
+    error_code = GetFrame(pkt, frame);
+
+    bool hw_works = (error_code >= 0 && frame->format != AV_PIX_FMT_NONE);
+
+    if (hw_works) {
+      pix_fmt_ = static_cast<AVPixelFormat>(frame->format);
+    }
+
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+
+    if (!hw_works) {
+      qWarning() << "Hardware decoder failed to decode" << filename << FFmpegError(error_code);
+      return false;
+    }
+
+    // No need to seek back, the decoder always seeks when its frame cache is empty
+  }
+
   return true;
 }
 
+bool FFmpegDecoder::Instance::SetupHardwareDevice(AVCodec *codec)
+{
+  if (avstream_->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+    return false;
+  }
+
+  // Try every device type the codec supports in the order FFmpeg lists them
+  for (int i=0; ; i++) {
+    const AVCodecHWConfig* config = avcodec_get_hw_config(codec, i);
+
+    if (!config) {
+      break;
+    }
+
+    if (!(config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX)) {
+      continue;
+    }
+
+    if (av_hwdevice_ctx_create(&hw_device_ctx_, config->device_type, nullptr, nullptr, 0) < 0) {
+      hw_device_ctx_ = nullptr;
+      continue;
+    }
+
+    hw_pix_fmt_ = config->pix_fmt;
+
+    codec_ctx_->hw_device_ctx = av_buffer_ref(hw_device_ctx_);
+    codec_ctx_->opaque = this;
+    codec_ctx_->get_format = GetHardwareFormat;
+
+    hw_transfer_frame_ = av_frame_alloc();
+
+    qInfo() << "Using hardware decoder" << av_hwdevice_get_type_name(config->device_type);
+
+    return true;
+  }
+
+  return false;
+}
+
+AVPixelFormat FFmpegDecoder::Instance::GetHardwareFormat(AVCodecContext *ctx, const AVPixelFormat *formats)
+{
+  Instance* instance = static_cast<Instance*>(ctx->opaque);
+
+  for (const AVPixelFormat* p = formats; *p != AV_PIX_FMT_NONE; p++) {
+    if (*p == instance->hw_pix_fmt_) {
+      return *p;
+    }
+  }
+
+  // The decoder won't give us a hardware surface, use the first software format it offers. This
+  // makes the probe frame in Open() come out without a transfer, so we still decode correctly.
+  for (const AVPixelFormat* p = formats; *p != AV_PIX_FMT_NONE; p++) {
+    if (!(av_pix_fmt_desc_get(*p)->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+      return *p;
+    }
+  }
+
+  return AV_PIX_FMT_NONE;
+}
+
 void FFmpegDecoder::Instance::Close()
 {
+  if (hw_transfer_frame_) {
+    av_frame_free(&hw_transfer_frame_);
+    hw_transfer_frame_ = nullptr;
+  }
+
+  if (hw_device_ctx_) {
+    av_buffer_unref(&hw_device_ctx_);
+    hw_device_ctx_ = nullptr;
+  }
+
+  hw_pix_fmt_ = AV_PIX_FMT_NONE;
+  pix_fmt_ = AV_PIX_FMT_NONE;
+  avstream_ = nullptr;
+
   if (opts_) {
     av_dict_free(&opts_);
     opts_ = nullptr;
@@ -1091,6 +2309,25 @@ int FFmpegDecoder::Instance::GetFrame(AVPacket *pkt, AVFrame *frame)
     }
   }
 
+  if (ret >= 0 && hw_device_ctx_ && frame->format == hw_pix_fmt_) {
+    // Download the surface into system memory so the rest of the decoder can treat it as usual
+    av_frame_unref(hw_transfer_frame_);
+
+    ret = av_hwframe_transfer_data(hw_transfer_frame_, frame, 0);
+
+    if (ret >= 0) {
+      av_frame_copy_props(hw_transfer_frame_, frame);
+      av_frame_unref(frame);
+      av_frame_move_ref(frame, hw_transfer_frame_);
+    } else {
+      qCritical() << "Failed to transfer frame from hardware decoder:" << FFmpegError(ret);
+    }
+  }
+
+  if (ret >= 0 && avstream_->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+    Metrics::AddLabeled(Metrics::kFramesDecoded, QString::fromLatin1(avcodec_get_name(codec_ctx_->codec_id)));
+  }
+
   return ret;
 }
 
@@ -1100,4 +2337,20 @@ void FFmpegDecoder::Instance::Seek(int64_t timestamp)
   av_seek_frame(fmt_ctx_, avstream_->index, timestamp, AVSEEK_FLAG_BACKWARD);
 }
 
+void FFmpegDecoder::Instance::SeekToKeyframe(const FFmpegKeyframeIndex::Keyframe &keyframe)
+{
+  avcodec_flush_buffers(codec_ctx_);
+
+  // Formats with discontinuous timestamps (e.g. MPEG-TS) are where timestamp seeking is least
+  // reliable, but they seek by byte well, so we go straight to the keyframe's packet there
+  if (keyframe.pos >= 0
+      && (fmt_ctx_->iformat->flags & AVFMT_TS_DISCONT)
+      && !(fmt_ctx_->iformat->flags & AVFMT_NO_BYTE_SEEK)
+      && av_seek_frame(fmt_ctx_, avstream_->index, keyframe.pos, AVSEEK_FLAG_BYTE) >= 0) {
+    return;
+  }
+
+  av_seek_frame(fmt_ctx_, avstream_->index, keyframe.pts, AVSEEK_FLAG_BACKWARD);
+}
+
 }
@@ -28,13 +28,16 @@ extern "C" {
 }
 
 #include <QAtomicInt>
+#include <QCache>
+#include <QThread>
 #include <QTimer>
 #include <QVector>
 #include <QWaitCondition>
 
 #include "codec/decoder.h"
-#include "codec/waveoutput.h"
+#include "codec/planaraudio.h"
 #include "ffmpegframepool.h"
+#include "ffmpegkeyframeindex.h"
 #include "project/item/footage/videostream.h"
 
 namespace olive {
@@ -53,6 +56,7 @@ public:
   virtual ~FFmpegDecoder() override;
 
   virtual QString id() override;
+  virtual QString version() override;
 
   virtual bool SupportsVideo() override{return true;}
   virtual bool SupportsAudio() override{return true;}
@@ -61,8 +65,15 @@ public:
 
 protected:
   virtual bool OpenInternal() override;
-  virtual FramePtr RetrieveVideoInternal(const rational &timecode, const int& divider) override;
+  virtual FramePtr RetrieveVideoInternal(const rational &timecode, const int& divider, const QAtomicInt* cancelled) override;
+  virtual FramePtr RetrieveVideoBestEffortInternal(const rational &timecode, const int& divider, const QAtomicInt* cancelled) override;
+  virtual int64_t GetRetrievalCostInternal(const rational &timecode) override;
+  virtual bool CanRetrieveAudioDirectlyInternal() override;
+  virtual SampleBufferPtr RetrieveAudioDirectInternal(qint64 start, int count, const AudioParams& params,
+                                                      const QAtomicInt* cancelled) override;
   virtual bool ConformAudioInternal(const QString& filename, const AudioParams &params, const QAtomicInt* cancelled) override;
+  virtual bool ConformAudioStreamsInternal(const QVector<Stream*>& streams, const QStringList& filenames,
+                                           const AudioParams& params, const QAtomicInt* cancelled) override;
   virtual void CloseInternal() override;
 
 private:
@@ -76,7 +87,16 @@ private:
       Close();
     }
 
-    bool Open(const char* filename, int stream_index);
+    /**
+     * @brief Open a stream for decoding
+     *
+     * If `hw_accel` is TRUE, the first hardware device the codec supports (VAAPI, NVDEC,
+     * VideoToolbox, D3D11VA, etc.) will be used to decode. Frames are transferred back to system
+     * memory in GetFrame() so callers see the same AVFrames either way. Returns FALSE if no
+     * device could be created or the device fails to decode, in which case the caller should
+     * Close() and reopen in software.
+     */
+    bool Open(const char* filename, int stream_index, bool hw_accel = false);
 
     void Close();
 
@@ -91,6 +111,11 @@ private:
 
     void Seek(int64_t timestamp);
 
+    /**
+     * @brief Seek exactly to a keyframe from an FFmpegKeyframeIndex
+     */
+    void SeekToKeyframe(const FFmpegKeyframeIndex::Keyframe& keyframe);
+
     AVFormatContext* fmt_ctx() const
     {
       return fmt_ctx_;
@@ -101,12 +126,87 @@ private:
       return avstream_;
     }
 
+    /**
+     * @brief The pixel format frames from GetFrame() will be in
+     *
+     * For hardware decoding this is the format frames are transferred as (e.g. NV12 or P010)
+     * which usually isn't the stream's own format.
+     */
+    AVPixelFormat pix_fmt() const
+    {
+      return pix_fmt_;
+    }
+
+    bool is_hardware_accelerated() const
+    {
+      return hw_device_ctx_;
+    }
+
   private:
+    bool SetupHardwareDevice(AVCodec* codec);
+
+    static AVPixelFormat GetHardwareFormat(AVCodecContext* ctx, const AVPixelFormat* formats);
+
     AVFormatContext* fmt_ctx_;
     AVCodecContext* codec_ctx_;
     AVStream* avstream_;
     AVDictionary* opts_;
 
+    AVBufferRef* hw_device_ctx_;
+    AVPixelFormat hw_pix_fmt_;
+    AVFrame* hw_transfer_frame_;
+
+    AVPixelFormat pix_fmt_;
+
+  };
+
+  /**
+   * @brief Thread that decodes ahead of sequential playback so frames are cached before they're requested
+   */
+  class ReadAheadThread : public QThread
+  {
+  public:
+    ReadAheadThread(FFmpegDecoder* decoder);
+
+    /**
+     * @brief Tell the thread where playback is and in which direction and speed it's moving
+     *
+     * `step` is the signed distance between the last two requests in the stream's timebase.
+     */
+    void Hint(int64_t position, int64_t step, int divider);
+
+    /**
+     * @brief Stop the thread and wait for it to finish
+     */
+    void Cancel();
+
+    /**
+     * @brief Returns TRUE if the current read-ahead should be abandoned
+     */
+    bool ShouldStop();
+
+    bool IsCancelled();
+
+  protected:
+    virtual void run() override;
+
+  private:
+    FFmpegDecoder* decoder_;
+
+    QMutex hint_lock_;
+
+    QWaitCondition hint_cond_;
+
+    int64_t position_;
+
+    int64_t step_;
+
+    int divider_;
+
+    bool has_hint_;
+
+    bool cancelled_;
+
   };
 
   /**
@@ -129,16 +229,163 @@ private:
 
   static uint64_t ValidateChannelLayout(AVStream *stream);
 
+  /**
+   * @brief Returns TRUE if this format stores Y, U, and V in separate planes we can upload as-is
+   */
+  static bool IsPlanarYUV(AVPixelFormat pix_fmt);
+
+  /**
+   * @brief Get the plane layout of frames at this divider when outputting YUV
+   */
+  YUVLayout GetYUVLayout(int divider) const;
+
   void FFmpegBufferToNativeBuffer(uint8_t** input_data, int* input_linesize, uint8_t **output_buffer, int *output_linesize);
 
   FFmpegFramePool::ElementPtr GetFrameFromCache(const int64_t& t) const;
 
   void ClearFrameCache();
 
-  FFmpegFramePool::ElementPtr RetrieveFrame(const int64_t &target_ts, int divider);
+  /**
+   * @brief Decode up to `target_ts`, returns nullptr early if `cancelled` (which may be nullptr) is set
+   *
+   * Frames decoded before cancelling stay in the frame cache for the next request.
+   */
+  FFmpegFramePool::ElementPtr RetrieveFrame(const int64_t &target_ts, int divider, const QAtomicInt* cancelled = nullptr);
+
+  /**
+   * @brief Return the frame nearest to `target_ts` that needs no more than one frame decoded
+   *
+   * That's either a cached frame between the target and its keyframe, or the keyframe itself.
+   * Falls back to RetrieveFrame() if there's no keyframe index.
+   */
+  FFmpegFramePool::ElementPtr RetrieveBestEffortFrame(const int64_t &target_ts, int divider, const QAtomicInt* cancelled);
+
+  FramePtr RetrieveVideoFrame(const rational& timecode, int requested_divider, const QAtomicInt* cancelled, bool best_effort);
+
+  /**
+   * @brief Convert a decoded frame into a frame from `pool_`, returns nullptr if the pool is out of memory
+   */
+  FFmpegFramePool::ElementPtr StoreFrame(AVFrame* working_frame, int divider);
+
+  /**
+   * @brief A run of consecutive frames decoded in one go for reverse playback
+   */
+  struct ReverseSpan {
+    ReverseSpan() :
+      start(0),
+      end(AV_NOPTS_VALUE),
+      started(false),
+      finished(false)
+    {
+    }
+
+    /// First and last timestamps (inclusive) of the frames it holds once finished
+    int64_t start;
+    int64_t end;
+
+    /// Frames decoded so far, in ascending order
+    QVector<FFmpegFramePool::ElementPtr> frames;
+
+    /// TRUE once the decoder was sought to its keyframe
+    bool started;
+
+    bool finished;
+  };
+
+  /**
+   * @brief Retrieve a frame while playing backwards
+   *
+   * Serves frames from spans decoded earlier (see PrefetchReverseSpan()), and if the frame isn't
+   * in any, decodes the span ending at it forward in one go. Each frame is then decoded roughly
+   * once rather than decoding from the keyframe for every frame. Requires the keyframe index.
+   */
+  FFmpegFramePool::ElementPtr RetrieveReverseFrame(const int64_t& target_ts, int divider, const QAtomicInt* cancelled);
+
+  /**
+   * @brief Create the span ending at `end`, which starts at its keyframe or kMaxReverseSpanFrames before
+   */
+  ReverseSpan CreateReverseSpan(int64_t end) const;
+
+  /**
+   * @brief Decode the next frame of `span`, returns FALSE on error
+   *
+   * Seeks to the span's keyframe first if it hasn't started, or if the decoder was used for
+   * something else since its last step.
+   */
+  bool StepReverseSpan(ReverseSpan* span, int divider);
+
+  /**
+   * @brief Keep a finished span, discarding the latest ones beyond kReverseSpanCount
+   */
+  void AddReverseSpan(const ReverseSpan& span);
+
+  FFmpegFramePool::ElementPtr GetFrameFromReverseSpans(const int64_t& target_ts) const;
+
+  void ClearReverseSpans();
+
+  /**
+   * @brief Called from the read-ahead thread to decode a step of the span before those buffered
+   *
+   * Returns TRUE if there's more to decode.
+   */
+  bool PrefetchReverseSpan(int64_t position, int divider);
 
   void RemoveFirstFrame();
 
+  /**
+   * @brief Returns TRUE if seeking is faster than decoding forward from the end of the frame cache to `target_ts`
+   *
+   * Must only be called if the frame cache isn't empty.
+   */
+  bool IsBeyondCacheWindow(const int64_t& target_ts) const;
+
+  /**
+   * @brief Load the keyframe index for this stream, building it if it doesn't exist yet
+   *
+   * For audio streams, where nearly every packet is a keyframe, this is an index of every packet.
+   */
+  void LoadKeyframeIndex();
+
+  /**
+   * @brief Called from the read-ahead thread to decode around `position` in the direction of `step`
+   */
+  void ReadAhead(int64_t position, int64_t step, int divider);
+
+  /**
+   * @brief Lock the decoder's mutex for the read-ahead thread, returns FALSE if it was cancelled while waiting
+   */
+  bool LockForReadAhead();
+
+  /**
+   * @brief Number of frames ahead of playback the read-ahead thread will decode at normal speed
+   */
+  static const int kReadAheadFrames;
+
+  /**
+   * @brief Maximum multiple of kReadAheadFrames decoded ahead for faster than realtime playback
+   */
+  static const int kMaxReadAheadSpeed;
+
+  /**
+   * @brief Maximum number of frames decoded into a single ReverseSpan
+   */
+  static const int kMaxReverseSpanFrames;
+
+  /**
+   * @brief Number of finished spans kept for reverse playback, the one playing and the one before it
+   */
+  static const int kReverseSpanCount;
+
+  /**
+   * @brief Keyframe indices of recently opened streams keyed by index filename, costed by keyframe count
+   *
+   * Decoders are closed and reopened as DecoderCache evicts them, this saves reading the index
+   * file from disk every time.
+   */
+  static QCache<QString, FFmpegKeyframeIndex> keyframe_index_cache_;
+  static QMutex keyframe_index_cache_lock_;
+  static const int kKeyframeIndexCacheSize;
+
   SwsContext* scale_ctx_;
   int scale_divider_;
   AVPixelFormat ideal_pix_fmt_;
@@ -157,6 +404,68 @@ private:
   bool cache_at_zero_;
   bool cache_at_eof_;
 
+  /**
+   * @brief If TRUE, frames are output as Y, U, and V planes for conversion on the GPU
+   */
+  bool yuv_output_;
+
+  /**
+   * @brief Maximum number of decoded frames kept in `cached_frames_`
+   */
+  int cache_limit_;
+
+  /**
+   * @brief Duration of one frame in the stream's timebase
+   */
+  int64_t frame_duration_ts_;
+
+  /**
+   * @brief The last timestamp requested through RetrieveVideo(), used to detect playback
+   */
+  int64_t last_requested_ts_;
+
+  ReadAheadThread* read_ahead_;
+
+  /**
+   * @brief Spans decoded for reverse playback, see RetrieveReverseFrame()
+   */
+  QList<ReverseSpan> reverse_spans_;
+
+  /**
+   * @brief The span currently being decoded, its end is AV_NOPTS_VALUE if there isn't one
+   */
+  ReverseSpan reverse_prefetch_;
+
+  /**
+   * @brief FALSE once the decoder was moved by something other than `reverse_prefetch_`
+   */
+  bool reverse_span_owns_instance_;
+
+  /**
+   * @brief Resampler kept between direct audio retrievals so consecutive blocks continue seamlessly
+   */
+  SwrContext* audio_resampler_;
+  AudioParams audio_resampler_params_;
+
+  /**
+   * @brief Sample position (in `audio_resampler_params_`) the resampler's next output belongs at
+   *
+   * AV_NOPTS_VALUE if the next retrieval has to seek.
+   */
+  qint64 audio_position_;
+
+  /**
+   * @brief Samples decoded past the end of the last block, ending at `audio_position_`
+   */
+  SampleBufferPtr audio_carry_;
+
+  /**
+   * @brief Set once we've tried to load (or build) a packet index for this audio stream
+   */
+  bool audio_index_attempted_;
+
+  FFmpegKeyframeIndex keyframe_index_;
+
   Instance instance_;
 
 };
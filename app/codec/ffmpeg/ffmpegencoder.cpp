@@ -21,12 +21,16 @@
 #include "ffmpegencoder.h"
 
 extern "C" {
+#include <libavutil/hwcontext.h>
 #include <libavutil/pixdesc.h>
 }
 
 #include <QFile>
+#include <QtConcurrent/QtConcurrent>
 
 #include "common/ffmpegutils.h"
+#include "common/metrics.h"
+#include "common/timecodefunctions.h"
 
 namespace olive {
 
@@ -35,13 +39,46 @@ FFmpegEncoder::FFmpegEncoder(const EncodingParams &params) :
   fmt_ctx_(nullptr),
   video_stream_(nullptr),
   video_codec_ctx_(nullptr),
-  video_alpha_scale_ctx_(nullptr),
-  video_noalpha_scale_ctx_(nullptr),
+  video_hw_device_ctx_(nullptr),
+  video_hw_frames_ctx_(nullptr),
+  video_sw_pix_fmt_(AV_PIX_FMT_NONE),
+  video_pass_(0),
   audio_stream_(nullptr),
   audio_codec_ctx_(nullptr),
   audio_resample_ctx_(nullptr),
-  open_(false)
+  audio_frame_(nullptr),
+  audio_frame_offset_(0),
+  audio_sample_counter_(0),
+  open_(false),
+  next_conversion_slot_(0)
 {
+  // At most one conversion per slot runs at a time, so this pool never needs more threads
+  conversion_pool_.setMaxThreadCount(kConversionSlots);
+}
+
+FFmpegEncoder::~FFmpegEncoder()
+{
+  Close();
+}
+
+const int FFmpegEncoder::kConversionSlots = qMax(2, QThread::idealThreadCount() / 2);
+
+int FFmpegEncoder::GetTargetBitDepth() const
+{
+  AVPixelFormat pix_fmt = av_get_pix_fmt(params().video_pix_fmt().toUtf8().constData());
+
+  if (pix_fmt == AV_PIX_FMT_NONE) {
+    return 0;
+  }
+
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pix_fmt);
+  int depth = 0;
+
+  for (int i=0; i<desc->nb_components; i++) {
+    depth = qMax(depth, desc->comp[i].depth);
+  }
+
+  return depth;
 }
 
 bool FFmpegEncoder::Open()
@@ -89,32 +126,39 @@ bool FFmpegEncoder::Open()
       return false;
     }
 
-    // This is the pixel format the encoder wants to encode to
-    AVPixelFormat encoder_pix_fmt = video_codec_ctx_->pix_fmt;
+    // This is the pixel format the encoder wants to encode to, or that frames are uploaded from
+    AVPixelFormat encoder_pix_fmt = video_sw_pix_fmt_;
 
     // Set up a scaling context - if the native pixel format is not equal to the encoder's, we'll need to convert it
     // before encoding. Even if we don't, this may be useful for converting between linesizes, etc.
-    video_alpha_scale_ctx_ = sws_getContext(params().video_params().width(),
-                                            params().video_params().height(),
-                                            src_alpha_pix_fmt,
-                                            params().video_params().width(),
-                                            params().video_params().height(),
-                                            encoder_pix_fmt,
-                                            0,
-                                            nullptr,
-                                            nullptr,
-                                            nullptr);
-
-    video_noalpha_scale_ctx_ = sws_getContext(params().video_params().width(),
-                                              params().video_params().height(),
-                                              src_noalpha_pix_fmt,
-                                              params().video_params().width(),
-                                              params().video_params().height(),
-                                              encoder_pix_fmt,
-                                              0,
-                                              nullptr,
-                                              nullptr,
-                                              nullptr);
+    //
+    // Swscale contexts can't be shared between threads, so every conversion slot gets its own.
+    video_alpha_scale_ctx_.resize(kConversionSlots);
+    video_noalpha_scale_ctx_.resize(kConversionSlots);
+
+    for (int i=0; i<kConversionSlots; i++) {
+      video_alpha_scale_ctx_[i] = sws_getContext(params().video_params().width(),
+                                                 params().video_params().height(),
+                                                 src_alpha_pix_fmt,
+                                                 params().video_params().width(),
+                                                 params().video_params().height(),
+                                                 encoder_pix_fmt,
+                                                 0,
+                                                 nullptr,
+                                                 nullptr,
+                                                 nullptr);
+
+      video_noalpha_scale_ctx_[i] = sws_getContext(params().video_params().width(),
+                                                   params().video_params().height(),
+                                                   src_noalpha_pix_fmt,
+                                                   params().video_params().width(),
+                                                   params().video_params().height(),
+                                                   encoder_pix_fmt,
+                                                   0,
+                                                   nullptr,
+                                                   nullptr,
+                                                   nullptr);
+    }
   }
 
   // Initialize an audio stream if it's enabled
@@ -125,6 +169,12 @@ bool FFmpegEncoder::Open()
 
   av_dump_format(fmt_ctx_, 0, filename_c_str, 1);
 
+  if (video_pass_ == 1) {
+    // The first pass only gathers statistics, nothing is written to the output file
+    open_ = true;
+    return true;
+  }
+
   // Open output file for writing
   error_code = avio_open(&fmt_ctx_->pb, filename_c_str, AVIO_FLAG_WRITE);
   if (error_code < 0) {
@@ -143,10 +193,79 @@ bool FFmpegEncoder::Open()
   return true;
 }
 
+bool FFmpegEncoder::SetPass(int pass, const QString &stats_prefix)
+{
+  if (open_ || pass < 0 || pass > 2) {
+    return false;
+  }
+
+  video_pass_ = pass;
+  video_stats_prefix_ = stats_prefix;
+
+  return true;
+}
+
 bool FFmpegEncoder::WriteFrame(FramePtr frame, rational time)
 {
-  bool success = false;
+  if (!open_) {
+    return false;
+  }
 
+  // Keep the pipeline bounded, encoding the oldest frame while the newer ones are still converting
+  while (pending_conversions_.size() >= kConversionSlots) {
+    if (!EncodeNextConvertedFrame()) {
+      return false;
+    }
+  }
+
+  // The previous user of this slot was the oldest conversion, which we've just waited for
+  int slot = next_conversion_slot_;
+  next_conversion_slot_ = (next_conversion_slot_ + 1) % kConversionSlots;
+
+  SwsContext*& scale_ctx = (frame->channel_count() == VideoParams::kRGBAChannelCount)
+      ? video_alpha_scale_ctx_[slot] : video_noalpha_scale_ctx_[slot];
+
+  int width = params().video_params().width();
+  int height = params().video_params().height();
+
+  if (frame->width() != width || frame->height() != height) {
+    // Frames rendered at another resolution (e.g. for another output of the same export) are
+    // stretched in the same pass as the pixel format conversion
+    scale_ctx = sws_getCachedContext(scale_ctx,
+                                     frame->width(),
+                                     frame->height(),
+                                     FFmpegUtils::GetFFmpegPixelFormat(video_conversion_fmt_, frame->channel_count()),
+                                     width,
+                                     height,
+                                     video_sw_pix_fmt_,
+                                     SWS_BICUBIC,
+                                     nullptr,
+                                     nullptr,
+                                     nullptr);
+
+    if (!scale_ctx) {
+      Error(QStringLiteral("Failed to create scaling context"));
+      return false;
+    }
+  }
+
+  int64_t pts = qRound64(time.toDouble() / av_q2d(video_codec_ctx_->time_base));
+
+  // QtConcurrent::run() only forwards up to five arguments, so they're bound in a lambda
+  SwsContext* slot_ctx = scale_ctx;
+  AVPixelFormat dest_fmt = video_sw_pix_fmt_;
+  VideoParams::Format conversion_fmt = video_conversion_fmt_;
+
+  pending_conversions_.enqueue(QtConcurrent::run(&conversion_pool_, [frame, slot_ctx, width, height, dest_fmt, conversion_fmt, pts](){
+    return ConvertFrame(frame, slot_ctx, width, height, dest_fmt, conversion_fmt, pts);
+  }));
+
+  return true;
+}
+
+AVFrame* FFmpegEncoder::ConvertFrame(FramePtr frame, SwsContext *scale_ctx, int width, int height,
+                                     AVPixelFormat dest_fmt, VideoParams::Format conversion_fmt, int64_t pts)
+{
   AVFrame* encoded_frame = av_frame_alloc();
 
   int error_code;
@@ -154,9 +273,9 @@ bool FFmpegEncoder::WriteFrame(FramePtr frame, rational time)
   int input_linesize;
 
   // Frame must be video
-  encoded_frame->width = frame->width();
-  encoded_frame->height = frame->height();
-  encoded_frame->format = video_codec_ctx_->pix_fmt;
+  encoded_frame->width = width;
+  encoded_frame->height = height;
+  encoded_frame->format = dest_fmt;
 
   // Set interlacing
   if (frame->video_params().interlacing() != VideoParams::kInterlaceNone) {
@@ -171,20 +290,20 @@ bool FFmpegEncoder::WriteFrame(FramePtr frame, rational time)
 
   error_code = av_frame_get_buffer(encoded_frame, 0);
   if (error_code < 0) {
-    FFmpegError("Failed to create AVFrame buffer", error_code);
+    qCritical() << "Failed to create AVFrame buffer" << error_code;
     goto fail;
   }
 
   // We may need to convert this frame to a frame that swscale will understand
-  if (frame->format() != video_conversion_fmt_) {
-    frame = frame->convert(video_conversion_fmt_);
+  if (frame->format() != conversion_fmt) {
+    frame = frame->convert(conversion_fmt);
   }
 
   // Use swscale context to convert formats/linesizes
   input_data = frame->const_data();
   input_linesize = frame->linesize_bytes();
 
-  error_code = sws_scale((frame->channel_count() == VideoParams::kRGBAChannelCount) ? video_alpha_scale_ctx_ : video_noalpha_scale_ctx_,
+  error_code = sws_scale(scale_ctx,
                          reinterpret_cast<const uint8_t**>(&input_data),
                          &input_linesize,
                          0,
@@ -192,39 +311,77 @@ bool FFmpegEncoder::WriteFrame(FramePtr frame, rational time)
                          encoded_frame->data,
                          encoded_frame->linesize);
 
-
   if (error_code < 0) {
-    FFmpegError("Failed to scale frame", error_code);
+    qCritical() << "Failed to scale frame" << error_code;
     goto fail;
   }
 
-  encoded_frame->pts = qRound64(time.toDouble() / av_q2d(video_codec_ctx_->time_base));
+  encoded_frame->pts = pts;
 
-  success = WriteAVFrame(encoded_frame, video_codec_ctx_, video_stream_);
+  return encoded_frame;
 
 fail:
   av_frame_free(&encoded_frame);
 
+  return nullptr;
+}
+
+bool FFmpegEncoder::EncodeNextConvertedFrame()
+{
+  AVFrame* encoded_frame = pending_conversions_.dequeue().result();
+
+  if (!encoded_frame) {
+    Error(QStringLiteral("Failed to convert frame for %1").arg(params().filename()));
+    return false;
+  }
+
+  if (video_hw_frames_ctx_) {
+    // Upload to a GPU surface for the encoder
+    AVFrame* hw_frame = av_frame_alloc();
+
+    int error_code = av_hwframe_get_buffer(video_hw_frames_ctx_, hw_frame, 0);
+
+    if (error_code >= 0) {
+      error_code = av_hwframe_transfer_data(hw_frame, encoded_frame, 0);
+    }
+
+    if (error_code < 0) {
+      av_frame_free(&hw_frame);
+      av_frame_free(&encoded_frame);
+      FFmpegError("Failed to upload frame to hardware encoder", error_code);
+      return false;
+    }
+
+    av_frame_copy_props(hw_frame, encoded_frame);
+    av_frame_free(&encoded_frame);
+    encoded_frame = hw_frame;
+  }
+
+  bool success = WriteAVFrame(encoded_frame, video_codec_ctx_, video_stream_);
+
+  av_frame_free(&encoded_frame);
+
+  if (success) {
+    Metrics::Add(Metrics::kFramesEncoded);
+  }
+
   return success;
 }
 
+void FFmpegEncoder::WaitForConversions()
+{
+  while (!pending_conversions_.isEmpty()) {
+    AVFrame* f = pending_conversions_.dequeue().result();
+    av_frame_free(&f);
+  }
+}
+
 void FFmpegEncoder::WriteAudio(AudioParams pcm_info, QIODevice* file)
 {
   if (file->open(QFile::ReadOnly)) {
     // Divide PCM stream into AVFrames
 
-    // See if the codec defines a number of samples per frame
-    int maximum_frame_samples = audio_codec_ctx_->frame_size;
-    if (!maximum_frame_samples) {
-      // If not, use another frame size
-      if (params().video_enabled()) {
-        // If we're encoding video, use enough samples to cover roughly one frame of video
-        maximum_frame_samples = params().audio_params().time_to_samples(params().video_params().time_base());
-      } else {
-        // If no video, just use an arbitrary number
-        maximum_frame_samples = 256;
-      }
-    }
+    int maximum_frame_samples = GetAudioFrameSize();
 
     SwrContext* swr_ctx = swr_alloc_set_opts(nullptr,
                                              static_cast<int64_t>(audio_codec_ctx_->channel_layout),
@@ -310,34 +467,174 @@ void FFmpegEncoder::WriteAudio(AudioParams pcm_info, QIODevice* file)
   }
 }
 
+bool FFmpegEncoder::WriteAudio(SampleBufferPtr samples)
+{
+  if (!audio_codec_ctx_) {
+    return false;
+  }
+
+  int frame_size = GetAudioFrameSize();
+
+  if (!audio_resample_ctx_) {
+    // Rendered samples are always planar float
+    const AudioParams& in_params = samples->audio_params();
+
+    audio_resample_ctx_ = swr_alloc_set_opts(nullptr,
+                                             static_cast<int64_t>(audio_codec_ctx_->channel_layout),
+                                             audio_codec_ctx_->sample_fmt,
+                                             audio_codec_ctx_->sample_rate,
+                                             static_cast<int64_t>(in_params.channel_layout()),
+                                             AV_SAMPLE_FMT_FLTP,
+                                             in_params.sample_rate(),
+                                             0,
+                                             nullptr);
+
+    if (!audio_resample_ctx_ || swr_init(audio_resample_ctx_) < 0) {
+      Error(QStringLiteral("Failed to create audio resampler"));
+      return false;
+    }
+
+    audio_frame_ = av_frame_alloc();
+    audio_frame_->channel_layout = audio_codec_ctx_->channel_layout;
+    audio_frame_->nb_samples = frame_size;
+    audio_frame_->format = audio_codec_ctx_->sample_fmt;
+
+    if (av_frame_get_buffer(audio_frame_, 0) < 0) {
+      Error(QStringLiteral("Failed to allocate audio frame"));
+      return false;
+    }
+  }
+
+  const uint8_t** input_data = reinterpret_cast<const uint8_t**>(samples->const_data());
+  int input_count = samples->sample_count();
+
+  int bytes_per_sample = av_get_bytes_per_sample(audio_codec_ctx_->sample_fmt);
+  bool planar = av_sample_fmt_is_planar(audio_codec_ctx_->sample_fmt);
+
+  forever {
+    // The encoder may still hold a reference to the last frame we sent it
+    if (av_frame_make_writable(audio_frame_) < 0) {
+      Error(QStringLiteral("Failed to make audio frame writable"));
+      return false;
+    }
+
+    // Point at the unfilled end of the frame
+    uint8_t* output_data[AV_NUM_DATA_POINTERS] = {nullptr};
+
+    if (planar) {
+      for (int i=0; i<audio_codec_ctx_->channels; i++) {
+        output_data[i] = audio_frame_->extended_data[i] + audio_frame_offset_ * bytes_per_sample;
+      }
+    } else {
+      output_data[0] = audio_frame_->data[0] + audio_frame_offset_ * bytes_per_sample * audio_codec_ctx_->channels;
+    }
+
+    int space = frame_size - audio_frame_offset_;
+    int converted = swr_convert(audio_resample_ctx_, output_data, space, input_data, input_count);
+
+    // Input is consumed in one go, further iterations only drain what the resampler buffered
+    input_data = nullptr;
+    input_count = 0;
+
+    if (converted < 0) {
+      FFmpegError("Failed to resample audio", converted);
+      return false;
+    }
+
+    audio_frame_offset_ += converted;
+
+    if (audio_frame_offset_ < frame_size) {
+      // Resampler is empty, wait for more samples
+      break;
+    }
+
+    audio_frame_->nb_samples = frame_size;
+    audio_frame_->pts = audio_sample_counter_;
+    audio_sample_counter_ += frame_size;
+    audio_frame_offset_ = 0;
+
+    if (!WriteAVFrame(audio_frame_, audio_codec_ctx_, audio_stream_)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 void FFmpegEncoder::Close()
 {
   if (open_) {
-    // Flush encoders
-    FlushEncoders();
+    // Cleared first since an error while flushing calls Close() again
+    open_ = false;
 
-    // We've written a header, so we'll write a trailer
-    av_write_trailer(fmt_ctx_);
-    avio_closep(&fmt_ctx_->pb);
+    // Encode any frames still in the pipeline
+    while (!pending_conversions_.isEmpty() && video_codec_ctx_) {
+      if (!EncodeNextConvertedFrame()) {
+        break;
+      }
+    }
 
-    open_ = false;
+    if (audio_resample_ctx_) {
+      FlushAudio();
+    }
+
+    if (fmt_ctx_) {
+      // Flush encoders
+      FlushEncoders();
+
+      if (fmt_ctx_->pb) {
+        // We've written a header, so we'll write a trailer
+        av_write_trailer(fmt_ctx_);
+        avio_closep(&fmt_ctx_->pb);
+      }
+    }
+  }
+
+  // Conversions use the scaling contexts so they must finish before we free them
+  WaitForConversions();
+
+  foreach (SwsContext* ctx, video_alpha_scale_ctx_) {
+    sws_freeContext(ctx);
+  }
+  video_alpha_scale_ctx_.clear();
+
+  foreach (SwsContext* ctx, video_noalpha_scale_ctx_) {
+    sws_freeContext(ctx);
+  }
+  video_noalpha_scale_ctx_.clear();
+
+  next_conversion_slot_ = 0;
+
+  if (audio_resample_ctx_) {
+    swr_free(&audio_resample_ctx_);
   }
 
-  if (video_alpha_scale_ctx_) {
-    sws_freeContext(video_alpha_scale_ctx_);
-    video_alpha_scale_ctx_ = nullptr;
+  if (audio_frame_) {
+    av_frame_free(&audio_frame_);
   }
 
-  if (video_noalpha_scale_ctx_) {
-    sws_freeContext(video_noalpha_scale_ctx_);
-    video_noalpha_scale_ctx_ = nullptr;
+  audio_frame_offset_ = 0;
+  audio_sample_counter_ = 0;
+
+  if (video_hw_frames_ctx_) {
+    av_buffer_unref(&video_hw_frames_ctx_);
+  }
+
+  if (video_hw_device_ctx_) {
+    av_buffer_unref(&video_hw_device_ctx_);
   }
 
   if (video_codec_ctx_) {
+    // Owned by us rather than FFmpeg
+    video_codec_ctx_->stats_in = nullptr;
+
     avcodec_free_context(&video_codec_ctx_);
     video_codec_ctx_ = nullptr;
   }
 
+  video_stats_file_.close();
+  video_stats_in_.clear();
+
   if (audio_codec_ctx_) {
     avcodec_free_context(&audio_codec_ctx_);
     audio_codec_ctx_ = nullptr;
@@ -350,6 +647,431 @@ void FFmpegEncoder::Close()
   }
 }
 
+bool FFmpegEncoder::ConcatenateSegments(const QStringList &segments,
+                                        const QVector<rational> &segment_starts,
+                                        const QString &audio_filename,
+                                        const QString &output_filename)
+{
+  if (segments.isEmpty() || segments.size() != segment_starts.size()) {
+    return false;
+  }
+
+  QVector<AVFormatContext*> inputs(segments.size(), nullptr);
+  AVFormatContext* audio_input = nullptr;
+  AVFormatContext* output = nullptr;
+  AVPacket* pkt = av_packet_alloc();
+  AVPacket* audio_pkt = av_packet_alloc();
+  bool audio_pkt_pending = false;
+  int audio_stream_offset = 0;
+  bool success = false;
+  int error_code;
+
+  QByteArray output_bytes = output_filename.toUtf8();
+
+  // Open every input now so we fail before writing anything
+  for (int i=0; i<segments.size(); i++) {
+    if (avformat_open_input(&inputs[i], segments.at(i).toUtf8(), nullptr, nullptr) < 0
+        || avformat_find_stream_info(inputs[i], nullptr) < 0) {
+      qCritical() << "Failed to open export segment" << segments.at(i);
+      goto fail;
+    }
+  }
+
+  if (!audio_filename.isEmpty()
+      && (avformat_open_input(&audio_input, audio_filename.toUtf8(), nullptr, nullptr) < 0
+          || avformat_find_stream_info(audio_input, nullptr) < 0)) {
+    qCritical() << "Failed to open export audio" << audio_filename;
+    goto fail;
+  }
+
+  error_code = avformat_alloc_output_context2(&output, nullptr, nullptr, output_bytes.constData());
+  if (error_code < 0) {
+    qCritical() << "Failed to allocate output context for" << output_filename;
+    goto fail;
+  }
+
+  // Streams are taken from the first segment, all the others are identical
+  for (unsigned int i=0; i<inputs.first()->nb_streams; i++) {
+    AVStream* in_stream = inputs.first()->streams[i];
+    AVStream* out_stream = avformat_new_stream(output, nullptr);
+
+    if (!out_stream || avcodec_parameters_copy(out_stream->codecpar, in_stream->codecpar) < 0) {
+      qCritical() << "Failed to create output stream";
+      goto fail;
+    }
+
+    out_stream->codecpar->codec_tag = 0;
+    out_stream->time_base = in_stream->time_base;
+    out_stream->sample_aspect_ratio = in_stream->sample_aspect_ratio;
+    out_stream->avg_frame_rate = in_stream->avg_frame_rate;
+  }
+
+  audio_stream_offset = static_cast<int>(output->nb_streams);
+
+  if (audio_input) {
+    for (unsigned int i=0; i<audio_input->nb_streams; i++) {
+      AVStream* in_stream = audio_input->streams[i];
+      AVStream* out_stream = avformat_new_stream(output, nullptr);
+
+      if (!out_stream || avcodec_parameters_copy(out_stream->codecpar, in_stream->codecpar) < 0) {
+        qCritical() << "Failed to create output stream";
+        goto fail;
+      }
+
+      out_stream->codecpar->codec_tag = 0;
+      out_stream->time_base = in_stream->time_base;
+    }
+  }
+
+  error_code = avio_open(&output->pb, output_bytes.constData(), AVIO_FLAG_WRITE);
+  if (error_code < 0) {
+    qCritical() << "Failed to open IO context for" << output_filename;
+    goto fail;
+  }
+
+  error_code = avformat_write_header(output, nullptr);
+  if (error_code < 0) {
+    qCritical() << "Failed to write format header for" << output_filename;
+    goto fail;
+  }
+
+  for (int i=0; i<inputs.size(); i++) {
+    AVFormatContext* input = inputs.at(i);
+
+    while (av_read_frame(input, pkt) >= 0) {
+      if (pkt->stream_index >= audio_stream_offset) {
+        // Stream doesn't exist in the first segment, this shouldn't happen
+        av_packet_unref(pkt);
+        continue;
+      }
+
+      AVStream* in_stream = input->streams[pkt->stream_index];
+      AVStream* out_stream = output->streams[pkt->stream_index];
+
+      // Segments all start at 0, offset them to where they belong in the output. DTS is offset by
+      // the same amount so B-frame delay works out the same in every segment.
+      av_packet_rescale_ts(pkt, in_stream->time_base, out_stream->time_base);
+
+      int64_t offset = Timecode::time_to_timestamp(segment_starts.at(i), out_stream->time_base);
+
+      if (pkt->pts != AV_NOPTS_VALUE) {
+        pkt->pts += offset;
+      }
+
+      if (pkt->dts != AV_NOPTS_VALUE) {
+        pkt->dts += offset;
+      }
+
+      pkt->pos = -1;
+
+      int64_t video_dts = pkt->dts;
+      AVRational video_tb = out_stream->time_base;
+
+      if (av_interleaved_write_frame(output, pkt) < 0) {
+        qCritical() << "Failed to write packet to" << output_filename;
+        goto fail;
+      }
+
+      // Write audio up to this point so the muxer doesn't have to buffer one stream entirely
+      while (audio_input && video_dts != AV_NOPTS_VALUE) {
+        if (!audio_pkt_pending) {
+          if (av_read_frame(audio_input, audio_pkt) < 0) {
+            break;
+          }
+
+          audio_pkt_pending = true;
+        }
+
+        AVStream* audio_in_stream = audio_input->streams[audio_pkt->stream_index];
+
+        if (audio_pkt->dts != AV_NOPTS_VALUE
+            && av_compare_ts(audio_pkt->dts, audio_in_stream->time_base, video_dts, video_tb) > 0) {
+          break;
+        }
+
+        AVStream* audio_out_stream = output->streams[audio_stream_offset + audio_pkt->stream_index];
+
+        av_packet_rescale_ts(audio_pkt, audio_in_stream->time_base, audio_out_stream->time_base);
+        audio_pkt->stream_index = audio_out_stream->index;
+        audio_pkt->pos = -1;
+
+        audio_pkt_pending = false;
+
+        if (av_interleaved_write_frame(output, audio_pkt) < 0) {
+          qCritical() << "Failed to write packet to" << output_filename;
+          goto fail;
+        }
+      }
+    }
+  }
+
+  // Write any remaining audio
+  while (audio_input) {
+    if (!audio_pkt_pending && av_read_frame(audio_input, audio_pkt) < 0) {
+      break;
+    }
+
+    audio_pkt_pending = false;
+
+    AVStream* audio_in_stream = audio_input->streams[audio_pkt->stream_index];
+    AVStream* audio_out_stream = output->streams[audio_stream_offset + audio_pkt->stream_index];
+
+    av_packet_rescale_ts(audio_pkt, audio_in_stream->time_base, audio_out_stream->time_base);
+    audio_pkt->stream_index = audio_out_stream->index;
+    audio_pkt->pos = -1;
+
+    if (av_interleaved_write_frame(output, audio_pkt) < 0) {
+      qCritical() << "Failed to write packet to" << output_filename;
+      goto fail;
+    }
+  }
+
+  av_write_trailer(output);
+
+  success = true;
+
+fail:
+  if (output) {
+    if (output->pb) {
+      avio_closep(&output->pb);
+    }
+
+    avformat_free_context(output);
+  }
+
+  for (int i=0; i<inputs.size(); i++) {
+    if (inputs.at(i)) {
+      avformat_close_input(&inputs[i]);
+    }
+  }
+
+  if (audio_input) {
+    avformat_close_input(&audio_input);
+  }
+
+  av_packet_free(&pkt);
+  av_packet_free(&audio_pkt);
+
+  return success;
+}
+
+bool FFmpegEncoder::CanCopyStream(const QString &filename, int stream_index, const EncodingParams &params)
+{
+  AVFormatContext* fmt_ctx = nullptr;
+
+  if (avformat_open_input(&fmt_ctx, filename.toUtf8(), nullptr, nullptr) < 0) {
+    return false;
+  }
+
+  bool can_copy = false;
+
+  if (avformat_find_stream_info(fmt_ctx, nullptr) >= 0
+      && stream_index >= 0
+      && stream_index < static_cast<int>(fmt_ctx->nb_streams)) {
+    AVStream* stream = fmt_ctx->streams[stream_index];
+    AVCodecParameters* par = stream->codecpar;
+    AVRational frame_rate = stream->avg_frame_rate.num ? stream->avg_frame_rate : stream->r_frame_rate;
+
+    can_copy = par->codec_type == AVMEDIA_TYPE_VIDEO
+        && par->codec_id == GetCodecID(params.video_codec())
+        && par->width == params.video_params().width()
+        && par->height == params.video_params().height()
+        && par->format == av_get_pix_fmt(params.video_pix_fmt().toUtf8())
+        && frame_rate.num
+        && rational(frame_rate) == params.video_params().time_base().flipped();
+  }
+
+  avformat_close_input(&fmt_ctx);
+
+  return can_copy;
+}
+
+bool FFmpegEncoder::CopyStreamRange(const QString &filename, int stream_index,
+                                    int64_t start_pts, int64_t end_pts, int64_t frame_count,
+                                    const QString &output_filename)
+{
+  AVFormatContext* input = nullptr;
+  AVFormatContext* output = nullptr;
+  AVStream* in_stream = nullptr;
+  AVStream* out_stream = nullptr;
+  AVPacket* pkt = av_packet_alloc();
+  bool started = false;
+  int64_t frames_written = 0;
+  bool success = false;
+  int error_code;
+
+  QByteArray output_bytes = output_filename.toUtf8();
+
+  if (avformat_open_input(&input, filename.toUtf8(), nullptr, nullptr) < 0
+      || avformat_find_stream_info(input, nullptr) < 0
+      || stream_index < 0
+      || stream_index >= static_cast<int>(input->nb_streams)) {
+    qCritical() << "Failed to open" << filename << "for copying";
+    goto fail;
+  }
+
+  in_stream = input->streams[stream_index];
+
+  error_code = avformat_alloc_output_context2(&output, nullptr, nullptr, output_bytes.constData());
+  if (error_code < 0) {
+    qCritical() << "Failed to allocate output context for" << output_filename;
+    goto fail;
+  }
+
+  out_stream = avformat_new_stream(output, nullptr);
+
+  if (!out_stream || avcodec_parameters_copy(out_stream->codecpar, in_stream->codecpar) < 0) {
+    qCritical() << "Failed to create output stream";
+    goto fail;
+  }
+
+  out_stream->codecpar->codec_tag = 0;
+  out_stream->time_base = in_stream->time_base;
+  out_stream->sample_aspect_ratio = in_stream->sample_aspect_ratio;
+  out_stream->avg_frame_rate = in_stream->avg_frame_rate;
+
+  error_code = avio_open(&output->pb, output_bytes.constData(), AVIO_FLAG_WRITE);
+  if (error_code < 0) {
+    qCritical() << "Failed to open IO context for" << output_filename;
+    goto fail;
+  }
+
+  error_code = avformat_write_header(output, nullptr);
+  if (error_code < 0) {
+    qCritical() << "Failed to write format header for" << output_filename;
+    goto fail;
+  }
+
+  if (av_seek_frame(input, stream_index, start_pts, AVSEEK_FLAG_BACKWARD) < 0) {
+    qCritical() << "Failed to seek" << filename << "for copying";
+    goto fail;
+  }
+
+  while (av_read_frame(input, pkt) >= 0) {
+    if (pkt->stream_index != stream_index) {
+      av_packet_unref(pkt);
+      continue;
+    }
+
+    if (pkt->pts == AV_NOPTS_VALUE) {
+      // We can't tell which frame this is, so we can't tell if it belongs in the range
+      av_packet_unref(pkt);
+      break;
+    }
+
+    bool keyframe = pkt->flags & AV_PKT_FLAG_KEY;
+
+    if (!started) {
+      // Skip what the seek landed on before our keyframe
+      started = (keyframe && pkt->pts == start_pts);
+    } else if (keyframe && pkt->pts >= end_pts) {
+      // That's the start of the next GOP, which isn't ours to copy
+      av_packet_unref(pkt);
+      break;
+    }
+
+    if (!started || pkt->pts < start_pts || pkt->pts >= end_pts) {
+      // Leading frames of an open GOP that are displayed outside of the range
+      av_packet_unref(pkt);
+      continue;
+    }
+
+    // Output starts at 0 like an encoded segment, DTS is offset by the same amount so any B-frame
+    // delay remains intact
+    pkt->pts -= start_pts;
+
+    if (pkt->dts != AV_NOPTS_VALUE) {
+      pkt->dts -= start_pts;
+    }
+
+    av_packet_rescale_ts(pkt, in_stream->time_base, out_stream->time_base);
+    pkt->stream_index = out_stream->index;
+    pkt->pos = -1;
+
+    if (av_interleaved_write_frame(output, pkt) < 0) {
+      qCritical() << "Failed to write packet to" << output_filename;
+      goto fail;
+    }
+
+    frames_written++;
+  }
+
+  av_write_trailer(output);
+
+  // Any frame displayed in the range that needed a frame outside of it to decode won't have been
+  // written, so this range can't be copied on its own
+  success = (frames_written == frame_count);
+
+  if (!success) {
+    qWarning() << "Expected" << frame_count << "frames copying" << filename << "but found" << frames_written;
+  }
+
+fail:
+  if (output) {
+    if (output->pb) {
+      avio_closep(&output->pb);
+    }
+
+    avformat_free_context(output);
+  }
+
+  if (input) {
+    avformat_close_input(&input);
+  }
+
+  av_packet_free(&pkt);
+
+  return success;
+}
+
+bool FFmpegEncoder::CanConcatenateSegments(const QStringList &segments)
+{
+  QVector<AVFormatContext*> inputs(segments.size(), nullptr);
+  bool compatible = true;
+
+  for (int i=0; i<segments.size() && compatible; i++) {
+    if (avformat_open_input(&inputs[i], segments.at(i).toUtf8(), nullptr, nullptr) < 0
+        || avformat_find_stream_info(inputs[i], nullptr) < 0
+        || inputs.at(i)->nb_streams == 0) {
+      qCritical() << "Failed to open export segment" << segments.at(i);
+      compatible = false;
+      break;
+    }
+
+    if (i == 0) {
+      continue;
+    }
+
+    const AVCodecParameters* first = inputs.first()->streams[0]->codecpar;
+    const AVCodecParameters* par = inputs.at(i)->streams[0]->codecpar;
+
+    if (par->codec_id != first->codec_id
+        || par->width != first->width
+        || par->height != first->height
+        || par->format != first->format) {
+      compatible = false;
+      break;
+    }
+
+    // Inter-frame codecs need the same parameter sets throughout, every muxer only stores one
+    const AVCodecDescriptor* desc = avcodec_descriptor_get(par->codec_id);
+
+    if (!desc || !(desc->props & AV_CODEC_PROP_INTRA_ONLY)) {
+      compatible = par->extradata_size == first->extradata_size
+          && (par->extradata_size == 0
+              || memcmp(par->extradata, first->extradata, par->extradata_size) == 0);
+    }
+  }
+
+  for (int i=0; i<inputs.size(); i++) {
+    if (inputs.at(i)) {
+      avformat_close_input(&inputs[i]);
+    }
+  }
+
+  return compatible;
+}
+
 void FFmpegEncoder::FFmpegError(const char* context, int error_code)
 {
   char err[128];
@@ -386,13 +1108,7 @@ bool FFmpegEncoder::WriteAVFrame(AVFrame *frame, AVCodecContext* codec_ctx, AVSt
       goto fail;
     }
 
-    // Set packet stream index
-    pkt->stream_index = stream->index;
-
-    av_packet_rescale_ts(pkt, codec_ctx->time_base, stream->time_base);
-
-    // Write packet to file
-    av_interleaved_write_frame(fmt_ctx_, pkt);
+    WritePacket(pkt, codec_ctx, stream);
 
     // Unref packet in case we're getting another
     av_packet_unref(pkt);
@@ -406,61 +1122,124 @@ fail:
   return succeeded;
 }
 
-bool FFmpegEncoder::InitializeStream(AVMediaType type, AVStream** stream_ptr, AVCodecContext** codec_ctx_ptr, const ExportCodec::Codec& codec)
+AVCodecID FFmpegEncoder::GetCodecID(ExportCodec::Codec codec)
 {
-  if (type != AVMEDIA_TYPE_VIDEO && type != AVMEDIA_TYPE_AUDIO) {
-    Error(QStringLiteral("Cannot initialize a stream that is not a video or audio type"));
-    return false;
-  }
-
-  // Retrieve codec
-  AVCodecID codec_id = AV_CODEC_ID_NONE;
-
   switch (codec) {
   case ExportCodec::kCodecDNxHD:
-    codec_id = AV_CODEC_ID_DNXHD;
-    break;
+    return AV_CODEC_ID_DNXHD;
   case ExportCodec::kCodecAAC:
-    codec_id = AV_CODEC_ID_AAC;
-    break;
+    return AV_CODEC_ID_AAC;
   case ExportCodec::kCodecMP2:
-    codec_id = AV_CODEC_ID_MP2;
-    break;
+    return AV_CODEC_ID_MP2;
   case ExportCodec::kCodecMP3:
-    codec_id = AV_CODEC_ID_MP3;
-    break;
+    return AV_CODEC_ID_MP3;
   case ExportCodec::kCodecH264:
-    codec_id = AV_CODEC_ID_H264;
-    break;
+    return AV_CODEC_ID_H264;
   case ExportCodec::kCodecH265:
-    codec_id = AV_CODEC_ID_HEVC;
-    break;
+    return AV_CODEC_ID_HEVC;
   case ExportCodec::kCodecOpenEXR:
-    codec_id = AV_CODEC_ID_EXR;
-    break;
+    return AV_CODEC_ID_EXR;
   case ExportCodec::kCodecPNG:
-    codec_id = AV_CODEC_ID_PNG;
-    break;
+    return AV_CODEC_ID_PNG;
   case ExportCodec::kCodecTIFF:
-    codec_id = AV_CODEC_ID_TIFF;
-    break;
+    return AV_CODEC_ID_TIFF;
   case ExportCodec::kCodecProRes:
-    codec_id = AV_CODEC_ID_PRORES;
-    break;
+    return AV_CODEC_ID_PRORES;
   case ExportCodec::kCodecPCM:
-    codec_id = AV_CODEC_ID_PCM_S16LE;
-    break;
+    return AV_CODEC_ID_PCM_S16LE;
+  case ExportCodec::kCodecH264NVENC:
+  case ExportCodec::kCodecH264QSV:
+  case ExportCodec::kCodecH264VAAPI:
+  case ExportCodec::kCodecH264VideoToolbox:
+    return AV_CODEC_ID_H264;
+  case ExportCodec::kCodecH265NVENC:
+  case ExportCodec::kCodecH265QSV:
+  case ExportCodec::kCodecH265VAAPI:
+  case ExportCodec::kCodecH265VideoToolbox:
+    return AV_CODEC_ID_HEVC;
   case ExportCodec::kCodecCount:
     break;
   }
 
+  return AV_CODEC_ID_NONE;
+}
+
+void FFmpegEncoder::WritePacket(AVPacket *pkt, AVCodecContext *codec_ctx, AVStream *stream)
+{
+  if (video_pass_ == 1) {
+    // Codecs that use FFmpeg's own rate control hand us their statistics with each packet
+    if (codec_ctx == video_codec_ctx_ && codec_ctx->stats_out && video_stats_file_.isOpen()) {
+      video_stats_file_.write(codec_ctx->stats_out);
+    }
+    return;
+  }
+
+  // Set packet stream index
+  pkt->stream_index = stream->index;
+
+  av_packet_rescale_ts(pkt, codec_ctx->time_base, stream->time_base);
+
+  // Write packet to file
+  av_interleaved_write_frame(fmt_ctx_, pkt);
+}
+
+void FFmpegEncoder::SetupPass(AVCodecContext *codec_ctx)
+{
+  if (video_pass_ == 0) {
+    return;
+  }
+
+  // libx264 (and libx265's wrapper) keep their statistics in a file of their own
+  QByteArray codec_stats = QString(video_stats_prefix_ + QStringLiteral(".codec")).toUtf8();
+  av_opt_set(codec_ctx, "stats", codec_stats.constData(), AV_OPT_SEARCH_CHILDREN);
+
+  video_stats_file_.setFileName(video_stats_prefix_ + QStringLiteral(".log"));
+
+  if (video_pass_ == 1) {
+    codec_ctx->flags |= AV_CODEC_FLAG_PASS1;
+
+    if (!video_stats_file_.open(QFile::WriteOnly)) {
+      qWarning() << "Failed to open two-pass statistics file" << video_stats_file_.fileName();
+    }
+  } else {
+    codec_ctx->flags |= AV_CODEC_FLAG_PASS2;
+
+    if (video_stats_file_.open(QFile::ReadOnly)) {
+      video_stats_in_ = video_stats_file_.readAll();
+      video_stats_file_.close();
+    }
+
+    // QByteArray is always null terminated, which is what FFmpeg expects
+    if (!video_stats_in_.isEmpty()) {
+      codec_ctx->stats_in = video_stats_in_.data();
+    }
+  }
+}
+
+bool FFmpegEncoder::InitializeStream(AVMediaType type, AVStream** stream_ptr, AVCodecContext** codec_ctx_ptr, const ExportCodec::Codec& codec)
+{
+  if (type != AVMEDIA_TYPE_VIDEO && type != AVMEDIA_TYPE_AUDIO) {
+    Error(QStringLiteral("Cannot initialize a stream that is not a video or audio type"));
+    return false;
+  }
+
+  // Retrieve codec
+  AVCodecID codec_id = GetCodecID(codec);
+
   if (codec_id == AV_CODEC_ID_NONE) {
     Error(QStringLiteral("Unknown internal codec"));
     return false;
   }
 
-  // Find encoder with this name
-  AVCodec* encoder = avcodec_find_encoder(codec_id);
+  // Find encoder with this name, hardware encoders are looked up by name since they share their
+  // codec ID with the software encoder
+  AVCodec* encoder;
+
+  if (ExportCodec::IsCodecHardware(codec)) {
+    encoder = avcodec_find_encoder_by_name(ExportCodec::GetHardwareEncoderName(codec));
+  } else {
+    encoder = avcodec_find_encoder(codec_id);
+  }
 
   if (!encoder) {
     Error(QStringLiteral("Failed to find codec for %1").arg(codec));
@@ -486,6 +1265,12 @@ bool FFmpegEncoder::InitializeStream(AVMediaType type, AVStream** stream_ptr, AV
     codec_ctx->sample_aspect_ratio = params().video_params().pixel_aspect_ratio().toAVRational();
     codec_ctx->time_base = params().video_params().time_base().toAVRational();
     codec_ctx->pix_fmt = av_get_pix_fmt(params().video_pix_fmt().toUtf8());
+    video_sw_pix_fmt_ = codec_ctx->pix_fmt;
+
+    // Encoders that only accept GPU surfaces get frames uploaded from the selected format
+    if (ExportCodec::IsCodecHardware(codec) && !SetupHardwareFrames(encoder, codec_ctx)) {
+      return false;
+    }
 
     if (params().video_params().interlacing() != VideoParams::kInterlaceNone) {
       // FIXME: I actually don't know what these flags do, the documentation helpfully doesn't
@@ -498,7 +1283,7 @@ bool FFmpegEncoder::InitializeStream(AVMediaType type, AVStream** stream_ptr, AV
       } else {
         codec_ctx->field_order = AV_FIELD_BB;
 
-        if (codec_id == AV_CODEC_ID_H264) {
+        if (codec_id == AV_CODEC_ID_H264 && !ExportCodec::IsCodecHardware(codec)) {
           // For some reason, FFmpeg doesn't set libx264's bff flag so we have to do it ourselves
           av_opt_set(codec_ctx->priv_data, "x264opts", "bff=1", AV_OPT_SEARCH_CHILDREN);
         }
@@ -510,7 +1295,9 @@ bool FFmpegEncoder::InitializeStream(AVMediaType type, AVStream** stream_ptr, AV
       QHash<QString, QString>::const_iterator i;
 
       for (i=params().video_opts().begin();i!=params().video_opts().end();i++) {
-        av_opt_set(codec_ctx->priv_data, i.key().toUtf8(), i.value().toUtf8(), AV_OPT_SEARCH_CHILDREN);
+        // Searching from the context itself finds generic options like "g" as well as the
+        // encoder's private ones
+        av_opt_set(codec_ctx, i.key().toUtf8(), i.value().toUtf8(), AV_OPT_SEARCH_CHILDREN);
       }
 
       if (params().video_bit_rate() > 0) {
@@ -526,6 +1313,8 @@ bool FFmpegEncoder::InitializeStream(AVMediaType type, AVStream** stream_ptr, AV
       }
     }
 
+    SetupPass(codec_ctx);
+
   } else {
 
     // Assume audio stream
@@ -548,6 +1337,60 @@ bool FFmpegEncoder::InitializeStream(AVMediaType type, AVStream** stream_ptr, AV
   return true;
 }
 
+bool FFmpegEncoder::SetupHardwareFrames(AVCodec *encoder, AVCodecContext *codec_ctx)
+{
+  // See if this encoder can take software frames at all
+  for (int i=0; encoder->pix_fmts && encoder->pix_fmts[i] != AV_PIX_FMT_NONE; i++) {
+    if (!(av_pix_fmt_desc_get(encoder->pix_fmts[i])->flags & AV_PIX_FMT_FLAG_HWACCEL)) {
+      // Encoders like NVENC and VideoToolbox upload frames themselves
+      return true;
+    }
+  }
+
+  const AVCodecHWConfig* config = nullptr;
+
+  for (int i=0; (config = avcodec_get_hw_config(encoder, i)); i++) {
+    if (config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_FRAMES_CTX) {
+      break;
+    }
+  }
+
+  if (!config) {
+    Error(QStringLiteral("%1 has no usable hardware configuration").arg(encoder->name));
+    return false;
+  }
+
+  int error_code = av_hwdevice_ctx_create(&video_hw_device_ctx_, config->device_type, nullptr, nullptr, 0);
+  if (error_code < 0) {
+    FFmpegError("Failed to create hardware device", error_code);
+    return false;
+  }
+
+  video_hw_frames_ctx_ = av_hwframe_ctx_alloc(video_hw_device_ctx_);
+  if (!video_hw_frames_ctx_) {
+    Error(QStringLiteral("Failed to allocate hardware frames context"));
+    return false;
+  }
+
+  AVHWFramesContext* frames_ctx = reinterpret_cast<AVHWFramesContext*>(video_hw_frames_ctx_->data);
+  frames_ctx->format = config->pix_fmt;
+  frames_ctx->sw_format = video_sw_pix_fmt_;
+  frames_ctx->width = codec_ctx->width;
+  frames_ctx->height = codec_ctx->height;
+  frames_ctx->initial_pool_size = 20;
+
+  error_code = av_hwframe_ctx_init(video_hw_frames_ctx_);
+  if (error_code < 0) {
+    FFmpegError("Failed to initialize hardware frames context", error_code);
+    return false;
+  }
+
+  codec_ctx->pix_fmt = config->pix_fmt;
+  codec_ctx->hw_frames_ctx = av_buffer_ref(video_hw_frames_ctx_);
+
+  return true;
+}
+
 bool FFmpegEncoder::InitializeCodecContext(AVStream **stream, AVCodecContext **codec_ctx, AVCodec* codec)
 {
   *stream = avformat_new_stream(fmt_ctx_, nullptr);
@@ -601,6 +1444,85 @@ bool FFmpegEncoder::SetupCodecContext(AVStream* stream, AVCodecContext* codec_ct
   return true;
 }
 
+int FFmpegEncoder::GetAudioFrameSize() const
+{
+  // See if the codec defines a number of samples per frame
+  int maximum_frame_samples = audio_codec_ctx_->frame_size;
+  if (!maximum_frame_samples) {
+    // If not, use another frame size
+    if (params().video_enabled()) {
+      // If we're encoding video, use enough samples to cover roughly one frame of video
+      maximum_frame_samples = params().audio_params().time_to_samples(params().video_params().time_base());
+    } else {
+      // If no video, just use an arbitrary number
+      maximum_frame_samples = 256;
+    }
+  }
+
+  return maximum_frame_samples;
+}
+
+void FFmpegEncoder::FlushAudio()
+{
+  int frame_size = GetAudioFrameSize();
+  int bytes_per_sample = av_get_bytes_per_sample(audio_codec_ctx_->sample_fmt);
+  bool planar = av_sample_fmt_is_planar(audio_codec_ctx_->sample_fmt);
+
+  // Drain the resampler into the frame, sending full frames as they fill up
+  forever {
+    if (av_frame_make_writable(audio_frame_) < 0) {
+      return;
+    }
+
+    uint8_t* output_data[AV_NUM_DATA_POINTERS] = {nullptr};
+
+    if (planar) {
+      for (int i=0; i<audio_codec_ctx_->channels; i++) {
+        output_data[i] = audio_frame_->extended_data[i] + audio_frame_offset_ * bytes_per_sample;
+      }
+    } else {
+      output_data[0] = audio_frame_->data[0] + audio_frame_offset_ * bytes_per_sample * audio_codec_ctx_->channels;
+    }
+
+    int converted = swr_convert(audio_resample_ctx_, output_data, frame_size - audio_frame_offset_, nullptr, 0);
+
+    if (converted <= 0) {
+      break;
+    }
+
+    audio_frame_offset_ += converted;
+
+    if (audio_frame_offset_ == frame_size) {
+      audio_frame_->nb_samples = frame_size;
+      audio_frame_->pts = audio_sample_counter_;
+      audio_sample_counter_ += frame_size;
+      audio_frame_offset_ = 0;
+
+      if (!WriteAVFrame(audio_frame_, audio_codec_ctx_, audio_stream_)) {
+        return;
+      }
+    }
+  }
+
+  if (audio_frame_offset_ > 0) {
+    int nb_samples = audio_frame_offset_;
+
+    // Codecs with a fixed frame size need the last frame padded out
+    if (!(audio_codec_ctx_->codec->capabilities & (AV_CODEC_CAP_SMALL_LAST_FRAME | AV_CODEC_CAP_VARIABLE_FRAME_SIZE))) {
+      av_samples_set_silence(audio_frame_->extended_data, audio_frame_offset_, frame_size - audio_frame_offset_,
+                             audio_codec_ctx_->channels, audio_codec_ctx_->sample_fmt);
+      nb_samples = frame_size;
+    }
+
+    audio_frame_->nb_samples = nb_samples;
+    audio_frame_->pts = audio_sample_counter_;
+    audio_sample_counter_ += nb_samples;
+    audio_frame_offset_ = 0;
+
+    WriteAVFrame(audio_frame_, audio_codec_ctx_, audio_stream_);
+  }
+}
+
 void FFmpegEncoder::FlushEncoders()
 {
   if (video_codec_ctx_) {
@@ -625,9 +1547,7 @@ void FFmpegEncoder::FlushCodecCtx(AVCodecContext *codec_ctx, AVStream* stream)
       break;
     }
 
-    pkt->stream_index = stream->index;
-    av_packet_rescale_ts(pkt, codec_ctx->time_base, stream->time_base);
-    av_interleaved_write_frame(fmt_ctx_, pkt);
+    WritePacket(pkt, codec_ctx, stream);
     av_packet_unref(pkt);
   } while (error_code >= 0);
 
@@ -28,16 +28,31 @@ extern "C" {
 #include <libavutil/opt.h>
 }
 
+#include <QFile>
+#include <QFuture>
+#include <QQueue>
+#include <QThreadPool>
+
 #include "codec/encoder.h"
 
 namespace olive {
 
+/**
+ * @brief An Encoder that wraps FFmpeg
+ *
+ * Video is encoded in two stages. WriteFrame() queues pixel format conversion on a worker pool
+ * and returns, while the oldest converted frame is sent to the codec and muxed. Up to
+ * kConversionSlots frames are converting at once, so codecs like x264 are kept busy while the
+ * next frames are converted.
+ */
 class FFmpegEncoder : public Encoder
 {
   Q_OBJECT
 public:
   FFmpegEncoder(const EncodingParams &params);
 
+  virtual ~FFmpegEncoder() override;
+
   virtual bool Open() override;
 
   virtual bool WriteFrame(olive::FramePtr frame, olive::rational time) override;
@@ -45,6 +60,8 @@ public:
   virtual void WriteAudio(olive::AudioParams pcm_info,
                           QIODevice *file) override;
 
+  virtual bool WriteAudio(olive::SampleBufferPtr samples) override;
+
   virtual void Close() override;
 
   virtual VideoParams::Format GetDesiredPixelFormat() const override
@@ -52,6 +69,51 @@ public:
     return video_conversion_fmt_;
   }
 
+  virtual int GetTargetBitDepth() const override;
+
+  virtual bool SetPass(int pass, const QString& stats_prefix) override;
+
+  /**
+   * @brief Losslessly join separately encoded video segments into one file
+   *
+   * Each segment must have been encoded with identical parameters and start on a keyframe, which
+   * is always the case for segments written by separate FFmpegEncoders. `segment_starts` is the
+   * time each segment begins at in the output. If `audio_filename` isn't empty, its streams are
+   * interleaved into the output too.
+   */
+  static bool ConcatenateSegments(const QStringList& segments,
+                                  const QVector<rational>& segment_starts,
+                                  const QString& audio_filename,
+                                  const QString& output_filename);
+
+  /**
+   * @brief Returns TRUE if a stream in `filename` could be copied into an export with `params`
+   *
+   * The stream must already be in the codec, resolution, frame rate and pixel format the export
+   * would encode to.
+   */
+  static bool CanCopyStream(const QString& filename, int stream_index, const EncodingParams& params);
+
+  /**
+   * @brief Copy the packets of a stream from `start_pts` up to `end_pts` into a file of their own
+   *
+   * `start_pts` must be a keyframe and `end_pts` either a keyframe or the end of the stream. The
+   * output starts at 0 so it can be joined with ConcatenateSegments() like an encoded segment.
+   * Returns FALSE if the range didn't contain exactly `frame_count` frames that can be decoded
+   * without the rest of the stream (e.g. open GOPs), in which case it should be encoded instead.
+   */
+  static bool CopyStreamRange(const QString& filename, int stream_index,
+                              int64_t start_pts, int64_t end_pts, int64_t frame_count,
+                              const QString& output_filename);
+
+  /**
+   * @brief Returns TRUE if the video in every segment can be decoded as one stream
+   *
+   * Segments from separate FFmpegEncoders always can. Copied source segments only can if every
+   * frame is a keyframe or they share the same codec extradata (i.e. SPS/PPS) as the others.
+   */
+  static bool CanConcatenateSegments(const QStringList& segments);
+
 private:
   /**
    * @brief Handle an error
@@ -74,10 +136,65 @@ private:
 
   bool WriteAVFrame(AVFrame* frame, AVCodecContext *codec_ctx, AVStream *stream);
 
+  /**
+   * @brief Mux a packet received from `codec_ctx`, or just collect its statistics during pass 1
+   */
+  void WritePacket(AVPacket* pkt, AVCodecContext *codec_ctx, AVStream *stream);
+
+  /**
+   * @brief Set up the video codec context for the current pass, see SetPass()
+   */
+  void SetupPass(AVCodecContext* codec_ctx);
+
+  /**
+   * @brief Convert a frame into the encoder's pixel format and `width`x`height`, run on the conversion pool
+   *
+   * Returns nullptr on failure.
+   */
+  static AVFrame* ConvertFrame(FramePtr frame, SwsContext* scale_ctx, int width, int height,
+                               AVPixelFormat dest_fmt, VideoParams::Format conversion_fmt, int64_t pts);
+
+  /**
+   * @brief Wait for the oldest conversion and send it to the encoder
+   */
+  bool EncodeNextConvertedFrame();
+
+  /**
+   * @brief Wait for and discard every pending conversion
+   */
+  void WaitForConversions();
+
+  /**
+   * @brief Number of frames that can be converting at once
+   */
+  static const int kConversionSlots;
+
+  /**
+   * @brief Returns the FFmpeg codec ID for an internal codec, or AV_CODEC_ID_NONE if there isn't one
+   */
+  static AVCodecID GetCodecID(ExportCodec::Codec codec);
+
   bool InitializeStream(enum AVMediaType type, AVStream** stream, AVCodecContext** codec_ctx, const ExportCodec::Codec &codec);
+  /**
+   * @brief Create a GPU frame pool for encoders that only accept GPU surfaces
+   *
+   * Does nothing for hardware encoders that accept frames in system memory.
+   */
+  bool SetupHardwareFrames(AVCodec* encoder, AVCodecContext* codec_ctx);
+
   bool InitializeCodecContext(AVStream** stream, AVCodecContext** codec_ctx, AVCodec* codec);
   bool SetupCodecContext(AVStream *stream, AVCodecContext *codec_ctx, AVCodec *codec);
 
+  /**
+   * @brief Number of samples per audio frame sent to the encoder
+   */
+  int GetAudioFrameSize() const;
+
+  /**
+   * @brief Write whatever audio is left in the resampler and the partially filled frame
+   */
+  void FlushAudio();
+
   void FlushEncoders();
   void FlushCodecCtx(AVCodecContext* codec_ctx, AVStream *stream);
 
@@ -85,16 +202,36 @@ private:
 
   AVStream* video_stream_;
   AVCodecContext* video_codec_ctx_;
-  SwsContext* video_alpha_scale_ctx_;
-  SwsContext* video_noalpha_scale_ctx_;
+  AVBufferRef* video_hw_device_ctx_;
+  AVBufferRef* video_hw_frames_ctx_;
+  AVPixelFormat video_sw_pix_fmt_;
+  QVector<SwsContext*> video_alpha_scale_ctx_;
+  QVector<SwsContext*> video_noalpha_scale_ctx_;
   VideoParams::Format video_conversion_fmt_;
 
+  /// 0 for a normal single-pass encode, otherwise which pass of a two-pass encode this is
+  int video_pass_;
+  QString video_stats_prefix_;
+
+  /// Statistics FFmpeg's own rate control writes during pass 1 and reads back during pass 2
+  QFile video_stats_file_;
+  QByteArray video_stats_in_;
+
   AVStream* audio_stream_;
   AVCodecContext* audio_codec_ctx_;
   SwrContext* audio_resample_ctx_;
+  AVFrame* audio_frame_;
+  int audio_frame_offset_;
+  int64_t audio_sample_counter_;
 
   bool open_;
 
+  QThreadPool conversion_pool_;
+
+  QQueue< QFuture<AVFrame*> > pending_conversions_;
+
+  int next_conversion_slot_;
+
 };
 
 }
@@ -21,11 +21,11 @@
 #include "ffmpegframepool.h"
 
 #include "codec/frame.h"
+#include "common/memoryaccounting.h"
 
 namespace olive {
 
-FFmpegFramePool::FFmpegFramePool(int element_count) :
-  MemoryPool(element_count),
+FFmpegFramePool::FFmpegFramePool() :
   width_(0),
   height_(0),
   format_(VideoParams::kFormatInvalid),
@@ -33,18 +33,30 @@ FFmpegFramePool::FFmpegFramePool(int element_count) :
 {
 }
 
-void FFmpegFramePool::SetParameters(int width, int height, VideoParams::Format format, int channel_count)
+void FFmpegFramePool::SetParameters(int width, int height, VideoParams::Format format, int channel_count, const YUVLayout &yuv)
 {
-  Clear();
-
   width_ = width;
   height_ = height;
   format_ = format;
   channel_count_ = channel_count;
+  yuv_ = yuv;
+}
+
+FFmpegFramePool::ElementPtr FFmpegFramePool::Get()
+{
+  size_t size = GetElementSize();
+
+  return MemoryAccounting::Track(BufferPool::Get(size), MemoryAccounting::kDecodedFrames,
+                                 static_cast<qint64>(size), name_);
 }
 
 size_t FFmpegFramePool::GetElementSize()
 {
+  if (yuv_.is_valid()) {
+    int offsets[3], linesizes[3];
+    return Frame::generate_yuv_planes(width_, height_, format_, yuv_, offsets, linesizes);
+  }
+
   return Frame::generate_linesize_bytes(width_, format_, channel_count_) * height_;
 }
 
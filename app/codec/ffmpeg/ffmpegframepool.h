@@ -21,17 +21,33 @@
 #ifndef FFMPEGFRAMEPOOL_H
 #define FFMPEGFRAMEPOOL_H
 
-#include "common/memorypool.h"
+#include "codec/frame.h"
+#include "common/bufferpool.h"
 #include "render/videoparams.h"
 
 namespace olive {
 
-class FFmpegFramePool : public MemoryPool<uint8_t>
+/**
+ * @brief Lends buffers sized for frames of the decoder's current output
+ *
+ * Buffers come from the global BufferPool rather than arenas owned by the decoder, so a Frame can
+ * hold the buffer FFmpeg's output was converted into (see Frame::set_buffer()) instead of a copy,
+ * and it stays valid after the decoder changes size or closes.
+ */
+class FFmpegFramePool
 {
 public:
-  FFmpegFramePool(int element_count);
+  using ElementPtr = BufferPool::BufferPtr;
 
-  void SetParameters(int width, int height, VideoParams::Format format, int channel_count);
+  FFmpegFramePool();
+
+  /**
+   * @brief Set the size and format of each frame in this pool
+   *
+   * If `yuv` is valid, elements are sized to hold separate Y, U, and V planes laid out as
+   * described by Frame::generate_yuv_planes().
+   */
+  void SetParameters(int width, int height, VideoParams::Format format, int channel_count, const YUVLayout& yuv = YUVLayout());
 
   const int& width() const
   {
@@ -43,10 +59,22 @@ public:
     return height_;
   }
 
-protected:
-  virtual size_t GetElementSize() override;
+  /**
+   * @brief Get a buffer for one frame, returns nullptr if it couldn't be allocated
+   */
+  ElementPtr Get();
+
+  /**
+   * @brief Set the name frames from this pool are counted under in MemoryAccounting, e.g. the stream they belong to
+   */
+  void set_name(const QString& name)
+  {
+    name_ = name;
+  }
 
 private:
+  size_t GetElementSize();
+
   int width_;
 
   int height_;
@@ -55,6 +83,10 @@ private:
 
   int channel_count_;
 
+  YUVLayout yuv_;
+
+  QString name_;
+
 };
 
 }
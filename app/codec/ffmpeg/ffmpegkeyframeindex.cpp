@@ -0,0 +1,170 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "ffmpegkeyframeindex.h"
+
+#include <algorithm>
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+
+namespace olive {
+
+const quint32 FFmpegKeyframeIndex::kMagic = 0x4F4B4649; // "OKFI"
+const quint32 FFmpegKeyframeIndex::kVersion = 1;
+
+bool FFmpegKeyframeIndex::Build(const char *filename, int stream_index, const QAtomicInt *cancelled, const std::function<void (int64_t)> &progress)
+{
+  keyframes_.clear();
+
+  AVFormatContext* fmt_ctx = nullptr;
+
+  if (avformat_open_input(&fmt_ctx, filename, nullptr, nullptr) != 0) {
+    qWarning() << "Failed to open" << filename << "for keyframe indexing";
+    return false;
+  }
+
+  if (avformat_find_stream_info(fmt_ctx, nullptr) < 0 || stream_index >= int(fmt_ctx->nb_streams)) {
+    avformat_close_input(&fmt_ctx);
+    return false;
+  }
+
+  // We only need packets from one stream, don't bother demuxing the others
+  for (unsigned int i=0; i<fmt_ctx->nb_streams; i++) {
+    if (int(i) != stream_index) {
+      fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+    }
+  }
+
+  AVPacket* pkt = av_packet_alloc();
+  bool was_cancelled = false;
+  int packet_count = 0;
+
+  while (av_read_frame(fmt_ctx, pkt) >= 0) {
+    if (pkt->stream_index == stream_index && (pkt->flags & AV_PKT_FLAG_KEY)) {
+      int64_t ts = (pkt->pts != AV_NOPTS_VALUE) ? pkt->pts : pkt->dts;
+
+      if (ts != AV_NOPTS_VALUE) {
+        keyframes_.append({ts, pkt->pos});
+      }
+    }
+
+    // Don't flood the progress signal
+    if (progress && ++packet_count % 256 == 0 && pkt->pts != AV_NOPTS_VALUE) {
+      progress(pkt->pts);
+    }
+
+    av_packet_unref(pkt);
+
+    if (cancelled && *cancelled) {
+      was_cancelled = true;
+      break;
+    }
+  }
+
+  av_packet_free(&pkt);
+  avformat_close_input(&fmt_ctx);
+
+  if (was_cancelled) {
+    keyframes_.clear();
+    return false;
+  }
+
+  // Keyframes are read in decode order, which may not quite match presentation order
+  std::sort(keyframes_.begin(), keyframes_.end(), [](const Keyframe& a, const Keyframe& b){
+    return a.pts < b.pts;
+  });
+
+  return IsValid();
+}
+
+bool FFmpegKeyframeIndex::Load(const QString &filename)
+{
+  keyframes_.clear();
+
+  QFile f(filename);
+
+  if (!f.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  QDataStream ds(&f);
+
+  quint32 magic, version;
+  qint32 count;
+
+  ds >> magic >> version >> count;
+
+  if (magic != kMagic || version != kVersion || count <= 0) {
+    return false;
+  }
+
+  keyframes_.resize(count);
+
+  for (int i=0; i<count; i++) {
+    qint64 pts, pos;
+    ds >> pts >> pos;
+    keyframes_[i] = {pts, pos};
+  }
+
+  if (ds.status() != QDataStream::Ok) {
+    qWarning() << "Keyframe index" << filename << "is corrupt";
+    keyframes_.clear();
+    return false;
+  }
+
+  return true;
+}
+
+bool FFmpegKeyframeIndex::Save(const QString &filename) const
+{
+  QFile f(filename);
+
+  if (!f.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to write keyframe index" << filename;
+    return false;
+  }
+
+  QDataStream ds(&f);
+
+  ds << kMagic << kVersion << qint32(keyframes_.size());
+
+  foreach (const Keyframe& k, keyframes_) {
+    ds << qint64(k.pts) << qint64(k.pos);
+  }
+
+  return ds.status() == QDataStream::Ok;
+}
+
+const FFmpegKeyframeIndex::Keyframe &FFmpegKeyframeIndex::GetKeyframeBefore(int64_t pts) const
+{
+  // Find the first keyframe after pts, the one before it is the one we want
+  auto it = std::upper_bound(keyframes_.cbegin(), keyframes_.cend(), pts, [](int64_t t, const Keyframe& k){
+    return t < k.pts;
+  });
+
+  if (it == keyframes_.cbegin()) {
+    return keyframes_.first();
+  }
+
+  return *(it - 1);
+}
+
+}
@@ -0,0 +1,102 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FFMPEGKEYFRAMEINDEX_H
+#define FFMPEGKEYFRAMEINDEX_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <functional>
+#include <QAtomicInt>
+#include <QString>
+#include <QVector>
+
+namespace olive {
+
+/**
+ * @brief A list of every keyframe in a stream, used for exact seeking
+ *
+ * Seeking with av_seek_frame() to an arbitrary timestamp can land on the wrong keyframe for
+ * badly muxed or long-GOP files, which FFmpegDecoder would otherwise correct by repeatedly
+ * seeking further back. With this index, the decoder can seek straight to the keyframe that
+ * precedes the frame it wants and decode the minimum number of frames from there.
+ *
+ * The index is built once by demuxing (not decoding) the whole stream and is saved alongside the
+ * stream's other cached data.
+ */
+class FFmpegKeyframeIndex
+{
+public:
+  struct Keyframe {
+    int64_t pts;
+    int64_t pos;
+  };
+
+  FFmpegKeyframeIndex() = default;
+
+  /**
+   * @brief Build the index by reading every packet of a stream
+   *
+   * `progress` is called periodically with the pts of the last packet read. Returns FALSE if the
+   * file couldn't be read, no keyframes were found, or `cancelled` was set.
+   */
+  bool Build(const char* filename, int stream_index, const QAtomicInt* cancelled,
+             const std::function<void(int64_t)>& progress);
+
+  bool Load(const QString& filename);
+
+  bool Save(const QString& filename) const;
+
+  bool IsValid() const
+  {
+    return !keyframes_.isEmpty();
+  }
+
+  void Clear()
+  {
+    keyframes_.clear();
+  }
+
+  /**
+   * @brief Get the last keyframe at or before `pts`
+   *
+   * If `pts` is before the first keyframe, the first keyframe is returned. Must only be called if
+   * the index is valid.
+   */
+  const Keyframe& GetKeyframeBefore(int64_t pts) const;
+
+  const QVector<Keyframe>& keyframes() const
+  {
+    return keyframes_;
+  }
+
+private:
+  static const quint32 kMagic;
+  static const quint32 kVersion;
+
+  QVector<Keyframe> keyframes_;
+
+};
+
+}
+
+#endif // FFMPEGKEYFRAMEINDEX_H
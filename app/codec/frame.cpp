@@ -20,17 +20,21 @@
 
 #include "frame.h"
 
-#include <OpenImageIO/imagebuf.h>
+#include <cstring>
 #include <QDebug>
 #include <QtGlobal>
 #include <QtMath>
 
-#include "common/oiioutils.h"
+#include "pixelkernels.h"
 
 namespace olive {
 
 Frame::Frame() :
-  timestamp_(0)
+  data_size_(0),
+  timestamp_(0),
+  plane_offset_{0, 0, 0},
+  plane_linesize_{0, 0, 0},
+  yuv_buffer_size_(0)
 {
 }
 
@@ -50,6 +54,10 @@ void Frame::set_video_params(const VideoParams &params)
 
   linesize_ = generate_linesize_bytes(width(), params_.format(), params_.channel_count());
   linesize_pixels_ = linesize_ / params_.GetBytesPerPixel();
+
+  if (is_yuv()) {
+    set_yuv_layout(yuv_layout_);
+  }
 }
 
 int Frame::generate_linesize_bytes(int width, VideoParams::Format format, int channel_count)
@@ -58,6 +66,33 @@ int Frame::generate_linesize_bytes(int width, VideoParams::Format format, int ch
   return VideoParams::GetBytesPerPixel(format, channel_count) * ((width + 31) & ~31);
 }
 
+int Frame::generate_yuv_planes(int width, int height, VideoParams::Format format, const YUVLayout &layout, int *offsets, int *linesizes)
+{
+  int size = 0;
+
+  for (int i=0; i<3; i++) {
+    int plane_width = (i == 0) ? width : layout.chroma_width();
+    int plane_height = (i == 0) ? height : layout.chroma_height();
+
+    linesizes[i] = generate_linesize_bytes(plane_width, format, 1);
+    offsets[i] = size;
+
+    size += linesizes[i] * plane_height;
+  }
+
+  return size;
+}
+
+void Frame::set_yuv_layout(const YUVLayout &layout)
+{
+  yuv_layout_ = layout;
+
+  if (is_yuv()) {
+    yuv_buffer_size_ = generate_yuv_planes(width(), height(), params_.format(), yuv_layout_,
+                                           plane_offset_, plane_linesize_);
+  }
+}
+
 Color Frame::get_pixel(int x, int y) const
 {
   if (!contains_pixel(x, y)) {
@@ -66,7 +101,7 @@ Color Frame::get_pixel(int x, int y) const
 
   int byte_offset = y * linesize_bytes() + x * video_params().GetBytesPerPixel();
 
-  return Color(data_.data() + byte_offset, video_params().format(), video_params().channel_count());
+  return Color(const_data() + byte_offset, video_params().format(), video_params().channel_count());
 }
 
 bool Frame::contains_pixel(int x, int y) const
@@ -82,7 +117,7 @@ void Frame::set_pixel(int x, int y, const Color &c)
 
   int byte_offset = y * linesize_bytes() + x * video_params().GetBytesPerPixel();
 
-  c.toData(data_.data() + byte_offset, video_params().format(), video_params().channel_count());
+  c.toData(data() + byte_offset, video_params().format(), video_params().channel_count());
 }
 
 bool Frame::allocate()
@@ -93,11 +128,74 @@ bool Frame::allocate()
     return false;
   }
 
-  data_.resize(VideoParams::GetBufferSize(linesize_, height(), params_.format(), params_.channel_count()));
+  int sz;
+
+  if (is_yuv()) {
+    sz = yuv_buffer_size_;
+  } else {
+    sz = VideoParams::GetBufferSize(linesize_, height(), params_.format(), params_.channel_count());
+  }
+
+  buffer_ = BufferPool::Get(static_cast<size_t>(sz));
+
+  if (!buffer_) {
+    qCritical() << "Failed to allocate frame buffer of" << sz << "bytes";
+    data_size_ = 0;
+    return false;
+  }
+
+  data_size_ = sz;
 
   return true;
 }
 
+void Frame::set_buffer(BufferPool::BufferPtr buffer)
+{
+  buffer_ = buffer;
+
+  if (!buffer_) {
+    data_size_ = 0;
+  } else if (is_yuv()) {
+    data_size_ = yuv_buffer_size_;
+  } else {
+    data_size_ = VideoParams::GetBufferSize(linesize_, height(), params_.format(), params_.channel_count());
+  }
+}
+
+void Frame::detach()
+{
+  if (!buffer_ || buffer_.use_count() == 1) {
+    return;
+  }
+
+  BufferPool::BufferPtr copy = BufferPool::Get(static_cast<size_t>(data_size_));
+
+  if (!copy) {
+    qCritical() << "Failed to allocate frame buffer of" << data_size_ << "bytes";
+    return;
+  }
+
+  memcpy(copy->data(), buffer_->data(), static_cast<size_t>(data_size_));
+  buffer_ = copy;
+}
+
+void Frame::DownloadTexture() const
+{
+  int sz = VideoParams::GetBufferSize(linesize_, height(), params_.format(), params_.channel_count());
+
+  buffer_ = BufferPool::Get(static_cast<size_t>(sz));
+
+  if (!buffer_) {
+    qCritical() << "Failed to allocate frame buffer of" << sz << "bytes";
+    data_size_ = 0;
+    return;
+  }
+
+  data_size_ = sz;
+
+  texture_->Download(buffer_->data(), linesize_pixels_);
+}
+
 FramePtr Frame::convert(VideoParams::Format format) const
 {
   // Create new params with destination format
@@ -108,25 +206,17 @@ FramePtr Frame::convert(VideoParams::Format format) const
   FramePtr converted = Frame::Create();
   converted->set_video_params(params);
   converted->set_timestamp(timestamp_);
-  converted->allocate();
 
-  // Do the conversion through OIIO for convenience
-  OIIO::ImageBuf src(OIIO::ImageSpec(width(), height(),
-                                     channel_count(),
-                                     OIIOUtils::GetOIIOBaseTypeFromFormat(this->format())));
-
-  OIIOUtils::FrameToBuffer(this, &src);
-
-  OIIO::ImageBuf dst(OIIO::ImageSpec(converted->width(), converted->height(),
-                                     channel_count(),
-                                     OIIOUtils::GetOIIOBaseTypeFromFormat(format)));
-
-  if (dst.copy_pixels(src)) {
-    OIIOUtils::BufferToFrame(&dst, converted.get());
-    return converted;
-  } else {
+  if (!converted->allocate()) {
     return nullptr;
   }
+
+  // Straight from our buffer into the new one, a row at a time
+  PixelKernels::ConvertImage(const_data(), this->format(), linesize_bytes(),
+                             converted->data(), format, converted->linesize_bytes(),
+                             width() * channel_count(), height());
+
+  return converted;
 }
 
 }
@@ -22,10 +22,13 @@
 #define FRAME_H
 
 #include <memory>
+#include <QRect>
 #include <QVector>
 
+#include "common/bufferpool.h"
 #include "common/rational.h"
 #include "render/color.h"
+#include "render/texture.h"
 #include "render/videoparams.h"
 
 namespace olive {
@@ -33,6 +36,85 @@ namespace olive {
 class Frame;
 using FramePtr = std::shared_ptr<Frame>;
 
+/**
+ * @brief Describes a frame stored as separate Y, U, and V planes rather than packed RGB(A)
+ *
+ * Decoders can output this so the conversion to RGB happens on the GPU during
+ * Renderer::BlitColorManaged() instead of on the CPU. Each plane is a single channel image in the
+ * frame's format, with the luma plane at the frame's size and both chroma planes at
+ * `chroma_width` x `chroma_height`. Samples with a `bit_depth` above 8 are stored in the low bits
+ * of 16-bit values.
+ */
+class YUVLayout
+{
+public:
+  enum Matrix {
+    kMatrixBT601,
+    kMatrixBT709,
+    kMatrixBT2020
+  };
+
+  YUVLayout() :
+    chroma_width_(0),
+    chroma_height_(0),
+    bit_depth_(0),
+    matrix_(kMatrixBT709),
+    full_range_(false)
+  {
+  }
+
+  YUVLayout(int chroma_width, int chroma_height, int bit_depth, Matrix matrix, bool full_range) :
+    chroma_width_(chroma_width),
+    chroma_height_(chroma_height),
+    bit_depth_(bit_depth),
+    matrix_(matrix),
+    full_range_(full_range)
+  {
+  }
+
+  bool is_valid() const
+  {
+    return chroma_width_ > 0 && chroma_height_ > 0 && bit_depth_ > 0;
+  }
+
+  int chroma_width() const
+  {
+    return chroma_width_;
+  }
+
+  int chroma_height() const
+  {
+    return chroma_height_;
+  }
+
+  int bit_depth() const
+  {
+    return bit_depth_;
+  }
+
+  Matrix matrix() const
+  {
+    return matrix_;
+  }
+
+  bool full_range() const
+  {
+    return full_range_;
+  }
+
+private:
+  int chroma_width_;
+
+  int chroma_height_;
+
+  int bit_depth_;
+
+  Matrix matrix_;
+
+  bool full_range_;
+
+};
+
 /**
  * @brief Video frame data or audio sample data from a Decoder
  */
@@ -48,6 +130,65 @@ public:
 
   static int generate_linesize_bytes(int width, VideoParams::Format format, int channel_count);
 
+  /**
+   * @brief Calculate where each plane of a YUV frame is stored in its buffer
+   *
+   * Fills the 3-element arrays `offsets` and `linesizes` (in bytes) and returns the total buffer
+   * size required.
+   */
+  static int generate_yuv_planes(int width, int height, VideoParams::Format format, const YUVLayout& layout,
+                                 int* offsets, int* linesizes);
+
+  /**
+   * @brief Store this frame as Y, U, and V planes rather than packed pixels
+   *
+   * Must be set before allocate(). Set an invalid YUVLayout to return to packed pixels.
+   */
+  void set_yuv_layout(const YUVLayout& layout);
+
+  const YUVLayout& yuv_layout() const
+  {
+    return yuv_layout_;
+  }
+
+  bool is_yuv() const
+  {
+    return yuv_layout_.is_valid();
+  }
+
+  /**
+   * @brief Get the data of a YUV plane (0 = Y, 1 = U, 2 = V)
+   */
+  char* plane_data(int plane)
+  {
+    return data() + plane_offset_[plane];
+  }
+
+  const char* const_plane_data(int plane) const
+  {
+    return const_data() + plane_offset_[plane];
+  }
+
+  int plane_linesize_bytes(int plane) const
+  {
+    return plane_linesize_[plane];
+  }
+
+  int plane_linesize_pixels(int plane) const
+  {
+    return plane_linesize_[plane] / VideoParams::GetBytesPerPixel(params_.format(), 1);
+  }
+
+  int plane_width(int plane) const
+  {
+    return (plane == 0) ? width() : yuv_layout_.chroma_width();
+  }
+
+  int plane_height(int plane) const
+  {
+    return (plane == 0) ? height() : yuv_layout_.chroma_height();
+  }
+
   int linesize_pixels() const
   {
     return linesize_pixels_;
@@ -102,7 +243,12 @@ public:
    */
   char* data()
   {
-    return data_.data();
+    if (!buffer_ && texture_) {
+      DownloadTexture();
+    }
+
+    detach();
+    return buffer_ ? buffer_->data() : nullptr;
   }
 
   /**
@@ -110,7 +256,51 @@ public:
    */
   const char* const_data() const
   {
-    return data_.constData();
+    if (!buffer_ && texture_) {
+      DownloadTexture();
+    }
+
+    return buffer_ ? buffer_->data() : nullptr;
+  }
+
+  /**
+   * @brief Keep this frame's pixels in a rendered texture rather than a memory buffer
+   *
+   * The texture must match this frame's video parameters and have finished rendering. Nothing is
+   * allocated until the frame's data is read, at which point the texture is downloaded into it.
+   */
+  void set_texture(TexturePtr texture)
+  {
+    texture_ = texture;
+  }
+
+  /**
+   * @brief The texture set with set_texture(), or nullptr if this frame only exists in memory
+   */
+  const TexturePtr& texture() const
+  {
+    return texture_;
+  }
+
+  /**
+   * @brief The part of this frame that was actually rendered, in pixels of its effective resolution
+   *
+   * A null rect (the default) means the whole frame is valid. Anything outside a non-null region
+   * is undefined, so partial frames must never be cached or used in place of a full one.
+   */
+  const QRect& region() const
+  {
+    return region_;
+  }
+
+  void set_region(const QRect& region)
+  {
+    region_ = region;
+  }
+
+  bool is_partial() const
+  {
+    return !region_.isNull();
   }
 
   /**
@@ -119,15 +309,26 @@ public:
    * For video frames, the width(), height(), and format() must be set for this function to work.
    *
    * If a memory buffer has been previously allocated without destroying, this function will destroy it.
+   *
+   * The buffer comes from BufferPool and is uninitialized, callers must write every byte they later read.
    */
   bool allocate();
 
+  /**
+   * @brief Use an existing buffer rather than allocating one
+   *
+   * The buffer must be laid out as allocate() would lay it out. It's shared rather than copied, so
+   * if anything else references it, the first non-const access to this frame's data copies it
+   * (see detach()) and the original is never modified. Read it with const_data() where possible.
+   */
+  void set_buffer(BufferPool::BufferPtr buffer);
+
   /**
    * @brief Return whether the frame is allocated or not
    */
   bool is_allocated() const
   {
-    return !data_.isEmpty();
+    return buffer_ || texture_;
   }
 
   /**
@@ -135,7 +336,9 @@ public:
    */
   void destroy()
   {
-    data_.clear();
+    buffer_ = nullptr;
+    data_size_ = 0;
+    texture_ = nullptr;
   }
 
   /**
@@ -145,15 +348,35 @@ public:
    */
   int allocated_size() const
   {
-    return data_.size();
+    return data_size_;
   }
 
   FramePtr convert(VideoParams::Format format) const;
 
 private:
+  /**
+   * @brief Give this frame its own copy of the buffer if it's shared with another frame
+   *
+   * Copies of a Frame share their buffer until one of them is written to, the same way the
+   * QByteArray this used to be stored in would.
+   */
+  void detach();
+
+  /**
+   * @brief Allocate the memory buffer and fill it from `texture_`
+   */
+  void DownloadTexture() const;
+
   VideoParams params_;
 
-  QByteArray data_;
+  // Mutable so frames that only exist as a texture can be downloaded on their first const read
+  mutable BufferPool::BufferPtr buffer_;
+
+  mutable int data_size_;
+
+  TexturePtr texture_;
+
+  QRect region_;
 
   rational timestamp_;
 
@@ -161,6 +384,14 @@ private:
 
   int linesize_pixels_;
 
+  YUVLayout yuv_layout_;
+
+  int plane_offset_[3];
+
+  int plane_linesize_[3];
+
+  int yuv_buffer_size_;
+
 };
 
 }
@@ -25,6 +25,7 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QMessageBox>
+#include <QtConcurrent/QtConcurrent>
 
 #include "common/define.h"
 #include "common/oiioutils.h"
@@ -34,11 +35,16 @@
 namespace olive {
 
 QStringList OIIODecoder::supported_formats_;
+const int OIIODecoder::kReadAheadFrames = 2;
+const int64_t OIIODecoder::kMaxReadAheadStep = 4;
 
 OIIODecoder::OIIODecoder() :
-  image_(nullptr),
-  buffer_(nullptr)
+  current_({nullptr, 0, 0, rational(1), false}),
+  current_index_(-1),
+  current_divider_(0),
+  last_requested_index_(-1)
 {
+  read_ahead_pool_.setMaxThreadCount(kReadAheadFrames);
 }
 
 OIIODecoder::~OIIODecoder()
@@ -51,6 +57,11 @@ QString OIIODecoder::id()
   return QStringLiteral("oiio");
 }
 
+QString OIIODecoder::version()
+{
+  return QStringLiteral(OIIO_VERSION_STRING);
+}
+
 Footage *OIIODecoder::Probe(const QString& filename, const QAtomicInt* cancelled) const
 {
   Q_UNUSED(cancelled)
@@ -106,64 +117,71 @@ Footage *OIIODecoder::Probe(const QString& filename, const QAtomicInt* cancelled
 bool OIIODecoder::OpenInternal()
 {
   // If we can open the filename provided, assume everything is working (even if this is an image
-  // sequence with potentially missing frame)
-  if (OpenImageHandler(stream()->footage()->filename())) {
-    VideoStream* video_stream = static_cast<VideoStream*>(stream());
-
-    if (video_stream->video_type() == VideoStream::kVideoTypeStill) {
-      last_sequence_index_ = 0;
-    } else {
-      last_sequence_index_ = GetImageSequenceIndex(stream()->footage()->filename());
-    }
+  // sequence with potentially missing frame). The image itself is read when it's first requested
+  // so we know what resolution it's needed at.
+  auto in = OIIO::ImageInput::open(stream()->footage()->filename().toStdString());
 
-    return true;
+  if (!in) {
+    return false;
   }
-  return false;
+
+  in->close();
+
+  current_index_ = -1;
+  last_requested_index_ = -1;
+
+  return true;
 }
 
-FramePtr OIIODecoder::RetrieveVideoInternal(const rational &timecode, const int& divider)
+FramePtr OIIODecoder::RetrieveVideoInternal(const rational &timecode, const int& divider, const QAtomicInt *cancelled)
 {
   VideoStream* video_stream = static_cast<VideoStream*>(stream());
 
-  int64_t sequence_index;
-
-  if (video_stream->video_type() == VideoStream::kVideoTypeStill) {
-    sequence_index = 0;
-  } else {
-    sequence_index = video_stream->get_time_in_timebase_units(timecode);
-  }
+  int64_t sequence_index = GetSequenceIndex(timecode);
 
-  if (last_sequence_index_ != sequence_index) {
-    CloseImageHandle();
+  if (!current_.buffer
+      || current_index_ != sequence_index
+      || (!current_.full_resolution && current_divider_ != divider)) {
+    current_ = TakeReadAheadImage(sequence_index, divider, cancelled);
 
-    if (!OpenImageHandler(TransformImageSequenceFileName(stream()->footage()->filename(), sequence_index))) {
+    if (!current_.buffer) {
+      current_index_ = -1;
       return nullptr;
     }
 
-    last_sequence_index_ = sequence_index;
+    current_index_ = sequence_index;
+    current_divider_ = divider;
+  }
+
+  if (video_stream->video_type() == VideoStream::kVideoTypeImageSequence && last_requested_index_ >= 0) {
+    QueueReadAhead(sequence_index, sequence_index - last_requested_index_, divider);
   }
 
+  last_requested_index_ = sequence_index;
+
+  OIIO::ImageBuf* buffer = current_.buffer.get();
+
   FramePtr frame = Frame::Create();
 
-  frame->set_video_params(VideoParams(buffer_->spec().width,
-                                      buffer_->spec().height,
-                                      pix_fmt_,
-                                      channel_count_,
-                                      OIIOUtils::GetPixelAspectRatioFromOIIO(buffer_->spec()),
+  frame->set_video_params(VideoParams(current_.width,
+                                      current_.height,
+                                      OIIOUtils::GetFormatFromOIIOBasetype(static_cast<OIIO::TypeDesc::BASETYPE>(buffer->spec().format.basetype)),
+                                      buffer->spec().nchannels,
+                                      current_.pixel_aspect_ratio,
                                       VideoParams::kInterlaceNone, // FIXME: Does OIIO deinterlace for us?
                                       divider));
   frame->allocate();
 
-  if (divider == 1) {
+  if (buffer->spec().width == frame->width() && buffer->spec().height == frame->height()) {
 
-    OIIOUtils::BufferToFrame(buffer_, frame.get());
+    OIIOUtils::BufferToFrame(buffer, frame.get());
 
   } else {
 
     // Will need to resize the image
-    OIIO::ImageBuf dst(OIIO::ImageSpec(frame->width(), frame->height(), buffer_->spec().nchannels, buffer_->spec().format));
+    OIIO::ImageBuf dst(OIIO::ImageSpec(frame->width(), frame->height(), buffer->spec().nchannels, buffer->spec().format));
 
-    if (!OIIO::ImageBufAlgo::resample(dst, *buffer_)) {
+    if (!OIIO::ImageBufAlgo::resample(dst, *buffer)) {
       qWarning() << "OIIO resize failed";
     }
 
@@ -174,9 +192,31 @@ FramePtr OIIODecoder::RetrieveVideoInternal(const rational &timecode, const int&
   return frame;
 }
 
+int64_t OIIODecoder::GetRetrievalCostInternal(const rational &timecode)
+{
+  int64_t sequence_index = GetSequenceIndex(timecode);
+
+  // If we already have this image loaded, there's nothing to do. Otherwise we'll have to open a
+  // new file, which is equivalent to a seek.
+  if (current_.buffer && current_index_ == sequence_index) {
+    return 0;
+  }
+
+  foreach (const ReadAheadImage& r, read_ahead_) {
+    if (r.index == sequence_index) {
+      return 0;
+    }
+  }
+
+  return kRetrievalCostSeek;
+}
+
 void OIIODecoder::CloseInternal()
 {
-  CloseImageHandle();
+  ClearReadAhead();
+
+  current_.buffer = nullptr;
+  current_index_ = -1;
 }
 
 bool OIIODecoder::FileTypeIsSupported(const QString& fn)
@@ -204,54 +244,257 @@ bool OIIODecoder::FileTypeIsSupported(const QString& fn)
   return true;
 }
 
-bool OIIODecoder::OpenImageHandler(const QString &fn)
+OIIODecoder::LoadedImage OIIODecoder::LoadImage(const QString &fn, int divider, const QAtomicInt *cancelled)
 {
-  image_ = OIIO::ImageInput::open(fn.toStdString());
+  LoadedImage loaded = {nullptr, 0, 0, rational(1), true};
 
-  if (!image_) {
-    return false;
+  std::string std_fn = fn.toStdString();
+
+  auto in = OIIO::ImageInput::open(std_fn);
+
+  if (!in) {
+    return loaded;
   }
 
   // Check if we can work with this pixel format
-  const OIIO::ImageSpec& spec = image_->spec();
-
-  // Store channel count
-  channel_count_ = spec.nchannels;
+  const OIIO::ImageSpec& spec = in->spec();
 
-  // We use RGBA frames because that tends to be the native format of GPUs
-  pix_fmt_ = OIIOUtils::GetFormatFromOIIOBasetype(static_cast<OIIO::TypeDesc::BASETYPE>(spec.format.basetype));
+  VideoParams::Format pix_fmt = OIIOUtils::GetFormatFromOIIOBasetype(static_cast<OIIO::TypeDesc::BASETYPE>(spec.format.basetype));
 
-  if (pix_fmt_ == VideoParams::kFormatInvalid) {
+  if (pix_fmt == VideoParams::kFormatInvalid) {
     qWarning() << "Failed to convert OIIO::ImageDesc to native pixel format";
-    return false;
+    return loaded;
   }
 
-  OIIO::TypeDesc::BASETYPE type = OIIOUtils::GetOIIOBaseTypeFromFormat(pix_fmt_);
+  OIIO::TypeDesc::BASETYPE type = OIIOUtils::GetOIIOBaseTypeFromFormat(pix_fmt);
 
   if (type == OIIO::TypeDesc::UNKNOWN) {
     qCritical() << "Failed to determine appropriate OIIO basetype from native format";
-    return false;
+    return loaded;
   }
 
-  buffer_ = new OIIO::ImageBuf(OIIO::ImageSpec(spec.width, spec.height, spec.nchannels, type),
-                               OIIO::InitializePixels::No);
+  loaded.width = spec.width;
+  loaded.height = spec.height;
+  loaded.pixel_aspect_ratio = OIIOUtils::GetPixelAspectRatioFromOIIO(spec);
 
-  image_->read_image(type, buffer_->localpixels());
+  if (spec.tile_width > 0) {
+    // Tiled files can be read a region at a time and often contain MIP levels, which the
+    // ImageCache handles for us
+    in->close();
 
-  return true;
+    OIIO::ImageCache* cache = GetImageCache();
+    OIIO::ustring cache_fn(std_fn);
+
+    int target_width = VideoParams::GetScaledDimension(loaded.width, divider);
+    int target_height = VideoParams::GetScaledDimension(loaded.height, divider);
+
+    // Use the smallest MIP level that's still at least as large as the output so we neither
+    // upscale nor read pixels we'd throw away
+    int miplevel = 0;
+    OIIO::ImageSpec level_spec;
+
+    if (!cache->get_imagespec(cache_fn, level_spec, 0, 0)) {
+      qWarning() << "Failed to read image through cache:" << QString::fromStdString(cache->geterror());
+      return loaded;
+    }
+
+    OIIO::ImageSpec next_spec;
+
+    while (cache->get_imagespec(cache_fn, next_spec, 0, miplevel + 1)
+           && next_spec.width >= target_width
+           && next_spec.height >= target_height) {
+      miplevel++;
+      level_spec = next_spec;
+    }
+
+    loaded.full_resolution = (miplevel == 0);
+    loaded.buffer = std::make_shared<OIIO::ImageBuf>(OIIO::ImageSpec(level_spec.width, level_spec.height, level_spec.nchannels, type),
+                                                     OIIO::InitializePixels::No);
+
+    // Fetch scanline bands in parallel, the ImageCache is thread safe and decodes each tile once
+    struct Band {
+      int ybegin;
+      int yend;
+    };
+
+    int band_count = qMin(QThread::idealThreadCount(), level_spec.height);
+    int band_height = (level_spec.height + band_count - 1) / band_count;
+    QVector<Band> bands;
+
+    for (int y=0; y<level_spec.height; y+=band_height) {
+      bands.append({y, qMin(y + band_height, level_spec.height)});
+    }
+
+    char* pixels = static_cast<char*>(loaded.buffer->localpixels());
+    size_t scanline_size = loaded.buffer->spec().scanline_bytes();
+    QAtomicInt failed;
+
+    QtConcurrent::blockingMap(bands, [&](const Band& b){
+      if (cancelled && *cancelled) {
+        failed.storeRelease(1);
+        return;
+      }
+
+      if (!cache->get_pixels(cache_fn, 0, miplevel,
+                             level_spec.x, level_spec.x + level_spec.width,
+                             level_spec.y + b.ybegin, level_spec.y + b.yend,
+                             level_spec.z, level_spec.z + 1,
+                             type,
+                             pixels + scanline_size * b.ybegin)) {
+        failed.storeRelease(1);
+      }
+    });
+
+    if (failed.loadAcquire()) {
+      if (!cancelled || !*cancelled) {
+        qWarning() << "Failed to read image through cache:" << QString::fromStdString(cache->geterror());
+      }
+      loaded.buffer = nullptr;
+    }
+
+  } else {
+
+    // Scanline files generally have to be decoded from the top, so these are read whole and let
+    // OIIO (and OpenEXR's own thread pool) parallelize decompression and conversion
+    in->threads(QThread::idealThreadCount());
+
+    loaded.buffer = std::make_shared<OIIO::ImageBuf>(OIIO::ImageSpec(spec.width, spec.height, spec.nchannels, type),
+                                                     OIIO::InitializePixels::No);
+
+    bool read = in->read_image(type, loaded.buffer->localpixels(),
+                               OIIO::AutoStride, OIIO::AutoStride, OIIO::AutoStride,
+                               cancelled ? &OIIODecoder::ReadProgressCallback : nullptr,
+                               const_cast<QAtomicInt*>(cancelled));
+
+    if (!read) {
+      if (!cancelled || !*cancelled) {
+        qWarning() << "Failed to read image:" << QString::fromStdString(in->geterror());
+      }
+      loaded.buffer = nullptr;
+    }
+
+    in->close();
+
+  }
+
+  return loaded;
+}
+
+bool OIIODecoder::ReadProgressCallback(void *cancelled, float portion_done)
+{
+  Q_UNUSED(portion_done)
+
+  // Returning TRUE tells OIIO to abort the read
+  return *static_cast<const QAtomicInt*>(cancelled);
+}
+
+OIIO::ImageCache *OIIODecoder::GetImageCache()
+{
+  // Deliberately never destroyed, decoders may still be reading from it on other threads at exit
+  static OIIO::ImageCache* cache = [](){
+    OIIO::ImageCache* c = OIIO::ImageCache::create(false);
+
+    c->attribute("max_memory_MB", Config::Current()[QStringLiteral("ImageDecoderCacheSize")].toFloat());
+
+    return c;
+  }();
+
+  return cache;
+}
+
+int64_t OIIODecoder::GetSequenceIndex(const rational &timecode) const
+{
+  VideoStream* video_stream = static_cast<VideoStream*>(stream());
+
+  if (video_stream->video_type() == VideoStream::kVideoTypeStill) {
+    return 0;
+  } else {
+    return video_stream->get_time_in_timebase_units(timecode);
+  }
+}
+
+QString OIIODecoder::GetFilenameForIndex(int64_t index) const
+{
+  if (static_cast<VideoStream*>(stream())->video_type() == VideoStream::kVideoTypeStill) {
+    return stream()->footage()->filename();
+  } else {
+    return TransformImageSequenceFileName(stream()->footage()->filename(), index);
+  }
+}
+
+OIIODecoder::LoadedImage OIIODecoder::TakeReadAheadImage(int64_t index, int divider, const QAtomicInt *cancelled)
+{
+  for (int i=0; i<read_ahead_.size(); i++) {
+    const ReadAheadImage& r = read_ahead_.at(i);
+
+    if (r.index == index && r.divider == divider) {
+      LoadedImage image = r.future.result();
+
+      read_ahead_.removeAt(i);
+
+      return image;
+    }
+  }
+
+  return LoadImage(GetFilenameForIndex(index), divider, cancelled);
 }
 
-void OIIODecoder::CloseImageHandle()
+void OIIODecoder::QueueReadAhead(int64_t index, int64_t step, int divider)
 {
-  if (image_) {
-    image_->close();
-    image_ = nullptr;
+  if (step == 0) {
+    // Same frame requested again, nothing has changed
+    return;
+  }
+
+  if (qAbs(step) > kMaxReadAheadStep) {
+    // Scrubbing, anything we've read ahead is probably useless now
+    ClearReadAhead();
+    return;
+  }
+
+  // Drop images that playback has already passed or that were read for another divider
+  for (int i=0; i<read_ahead_.size(); i++) {
+    const ReadAheadImage& r = read_ahead_.at(i);
+
+    if (r.divider != divider || (r.index - index) * step <= 0) {
+      read_ahead_.removeAt(i);
+      i--;
+    }
   }
 
-  if (buffer_) {
-    delete buffer_;
-    buffer_ = nullptr;
+  VideoStream* video_stream = static_cast<VideoStream*>(stream());
+  int64_t first_index = video_stream->start_time();
+  int64_t last_index = first_index + video_stream->duration() - 1;
+
+  for (int i=1; i<=kReadAheadFrames; i++) {
+    int64_t next = index + step * i;
+
+    if (next < first_index || next > last_index) {
+      break;
+    }
+
+    bool queued = false;
+
+    foreach (const ReadAheadImage& r, read_ahead_) {
+      if (r.index == next) {
+        queued = true;
+        break;
+      }
+    }
+
+    if (!queued) {
+      read_ahead_.append({next, divider, QtConcurrent::run(&read_ahead_pool_, &OIIODecoder::LoadImage,
+                                                           GetFilenameForIndex(next), divider,
+                                                           static_cast<const QAtomicInt*>(nullptr))});
+    }
   }
 }
 
+void OIIODecoder::ClearReadAhead()
+{
+  // Reads that haven't started yet can be dropped, ones that have are left to finish on their own
+  read_ahead_pool_.clear();
+  read_ahead_.clear();
+}
+
 }
@@ -21,8 +21,11 @@
 #ifndef OIIODECODER_H
 #define OIIODECODER_H
 
+#include <OpenImageIO/imagecache.h>
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/imagebuf.h>
+#include <QFuture>
+#include <QThreadPool>
 
 #include "codec/decoder.h"
 
@@ -37,6 +40,7 @@ public:
   virtual ~OIIODecoder() override;
 
   virtual QString id() override;
+  virtual QString version() override;
 
   virtual bool SupportsVideo() override{return true;}
 
@@ -44,25 +48,92 @@ public:
 
 protected:
   virtual bool OpenInternal() override;
-  virtual FramePtr RetrieveVideoInternal(const rational &timecode, const int& divider) override;
+  virtual FramePtr RetrieveVideoInternal(const rational &timecode, const int& divider, const QAtomicInt* cancelled) override;
+  virtual int64_t GetRetrievalCostInternal(const rational &timecode) override;
   virtual void CloseInternal() override;
 
 private:
-  std::unique_ptr<OIIO::ImageInput> image_;
+  /**
+   * @brief An image read from disk, possibly at a lower MIP level than its full resolution
+   */
+  struct LoadedImage {
+    std::shared_ptr<OIIO::ImageBuf> buffer;
+
+    int width;
+    int height;
+    rational pixel_aspect_ratio;
+
+    /**
+     * @brief If TRUE, `buffer` is the full resolution image and can be resampled for any divider
+     */
+    bool full_resolution;
+  };
+
+  /**
+   * @brief An image being read ahead of sequence playback
+   */
+  struct ReadAheadImage {
+    int64_t index;
+    int divider;
+    QFuture<LoadedImage> future;
+  };
 
   static bool FileTypeIsSupported(const QString& fn);
 
-  bool OpenImageHandler(const QString& fn);
+  /**
+   * @brief Read an image at the resolution needed for `divider`
+   *
+   * Tiled files are read through a shared ImageCache from the smallest MIP level that's still at
+   * least as large as the output, with scanline bands fetched in parallel. Everything else is
+   * read whole and downscaled afterwards. Thread safe, returns a null buffer on failure or if
+   * `cancelled` (which may be nullptr) is set part way through.
+   */
+  static LoadedImage LoadImage(const QString& fn, int divider, const QAtomicInt* cancelled);
 
-  void CloseImageHandle();
+  /**
+   * @brief OIIO progress callback that aborts a read once the QAtomicInt it's given is set
+   */
+  static bool ReadProgressCallback(void* cancelled, float portion_done);
 
-  int64_t last_sequence_index_;
+  static OIIO::ImageCache* GetImageCache();
 
-  VideoParams::Format pix_fmt_;
+  int64_t GetSequenceIndex(const rational& timecode) const;
 
-  int channel_count_;
+  QString GetFilenameForIndex(int64_t index) const;
 
-  OIIO::ImageBuf* buffer_;
+  /**
+   * @brief Return the image at `index`, waiting for a read-ahead of it if there is one
+   */
+  LoadedImage TakeReadAheadImage(int64_t index, int divider, const QAtomicInt* cancelled);
+
+  /**
+   * @brief Start reading the images following `index` in the direction of `step`
+   */
+  void QueueReadAhead(int64_t index, int64_t step, int divider);
+
+  void ClearReadAhead();
+
+  /**
+   * @brief Number of images opened and read ahead of sequence playback
+   */
+  static const int kReadAheadFrames;
+
+  /**
+   * @brief Largest distance between requests that's still considered playback rather than scrubbing
+   */
+  static const int64_t kMaxReadAheadStep;
+
+  LoadedImage current_;
+
+  int64_t current_index_;
+
+  int current_divider_;
+
+  int64_t last_requested_index_;
+
+  QList<ReadAheadImage> read_ahead_;
+
+  QThreadPool read_ahead_pool_;
 
   static QStringList supported_formats_;
 
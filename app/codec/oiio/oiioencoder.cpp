@@ -0,0 +1,254 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "oiioencoder.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+
+#include "codec/decoder.h"
+#include "common/filefunctions.h"
+#include "common/metrics.h"
+#include "common/oiioutils.h"
+#include "common/timecodefunctions.h"
+
+namespace olive {
+
+const int OIIOEncoder::kMaximumPendingWrites = QThread::idealThreadCount() * 2;
+
+OIIOEncoder::OIIOEncoder(const EncodingParams &params) :
+  Encoder(params),
+  open_(false),
+  image_sequence_(false),
+  digit_count_(0),
+  format_(VideoParams::kFormatInvalid),
+  pending_writes_(kMaximumPendingWrites)
+{
+  io_pool_.setMaxThreadCount(QThread::idealThreadCount());
+}
+
+OIIOEncoder::~OIIOEncoder()
+{
+  Close();
+}
+
+bool OIIOEncoder::Open()
+{
+  if (open_) {
+    return true;
+  }
+
+  if (!params().video_enabled()) {
+    qWarning() << "Image encoder opened without video";
+    return false;
+  }
+
+  format_ = GetDesiredPixelFormat();
+  failed_ = 0;
+
+  spec_ = OIIO::ImageSpec(params().video_params().width(),
+                          params().video_params().height(),
+                          VideoParams::kRGBAChannelCount,
+                          OIIOUtils::GetOIIOBaseTypeFromFormat(format_));
+
+  spec_.attribute("PixelAspectRatio", static_cast<float>(params().video_params().pixel_aspect_ratio().toDouble()));
+
+  const QHash<QString, QString>& opts = params().video_opts();
+
+  switch (params().video_codec()) {
+  case ExportCodec::kCodecOpenEXR:
+    // OpenEXR compresses blocks of scanlines on its own thread pool
+    OIIO::attribute("exr_threads", QThread::idealThreadCount());
+    spec_.attribute("compression", opts.value(QStringLiteral("compression"), QStringLiteral("zip")).toStdString());
+    break;
+  case ExportCodec::kCodecPNG:
+    // zlib is single threaded, writing several files at once is what keeps every core busy
+    spec_.attribute("png:compressionLevel", opts.value(QStringLiteral("compression_level"), QStringLiteral("6")).toInt());
+    break;
+  case ExportCodec::kCodecTIFF:
+    spec_.attribute("compression", opts.value(QStringLiteral("compression"), QStringLiteral("zip")).toStdString());
+    break;
+  default:
+    qWarning() << "Image encoder can't write codec" << params().video_codec();
+    return false;
+  }
+
+  int64_t frame_count = Timecode::time_to_timestamp(params().GetExportLength(), params().video_params().time_base());
+
+  image_sequence_ = (opts.value(QStringLiteral("image_sequence"), QStringLiteral("1")).toInt() && frame_count > 1);
+
+  if (image_sequence_) {
+    // Keep any number the user already put at the end of the filename, as long as every frame fits
+    digit_count_ = qMax(Decoder::GetImageSequenceDigitCount(params().filename()), 4);
+    digit_count_ = qMax(digit_count_, QString::number(frame_count - 1).size());
+  }
+
+  open_ = true;
+
+  return true;
+}
+
+bool OIIOEncoder::WriteFrame(FramePtr frame, rational time)
+{
+  if (!open_ || failed_) {
+    return false;
+  }
+
+  QString filename = GetFrameFilename(Timecode::time_to_timestamp(time, params().video_params().time_base()));
+
+  // Released by WriteImage() once the frame is on disk
+  pending_writes_.acquire();
+
+  QtConcurrent::run(&io_pool_, this, &OIIOEncoder::WriteImage, frame, filename);
+
+  return true;
+}
+
+void OIIOEncoder::WriteAudio(AudioParams pcm_info, QIODevice *file)
+{
+  Q_UNUSED(pcm_info)
+  Q_UNUSED(file)
+
+  qWarning() << "Image encoder can't write audio";
+}
+
+bool OIIOEncoder::WriteAudio(SampleBufferPtr samples)
+{
+  Q_UNUSED(samples)
+
+  qWarning() << "Image encoder can't write audio";
+  return false;
+}
+
+void OIIOEncoder::Close()
+{
+  // Frames already queued are still written, Close() only returns once they're on disk
+  io_pool_.waitForDone();
+
+  open_ = false;
+}
+
+VideoParams::Format OIIOEncoder::GetDesiredPixelFormat() const
+{
+  const QString& pix_fmt = params().video_pix_fmt();
+
+  switch (params().video_codec()) {
+  case ExportCodec::kCodecOpenEXR:
+    return (pix_fmt == QStringLiteral("rgbaf32")) ? VideoParams::kFormatFloat32 : VideoParams::kFormatFloat16;
+  case ExportCodec::kCodecPNG:
+  case ExportCodec::kCodecTIFF:
+    return (pix_fmt == QStringLiteral("rgba64")) ? VideoParams::kFormatUnsigned16 : VideoParams::kFormatUnsigned8;
+  default:
+    break;
+  }
+
+  return VideoParams::kFormatInvalid;
+}
+
+int OIIOEncoder::GetTargetBitDepth() const
+{
+  VideoParams::Format format = GetDesiredPixelFormat();
+
+  if (format == VideoParams::kFormatInvalid) {
+    return 0;
+  }
+
+  return VideoParams::GetBytesPerChannel(format) * 8;
+}
+
+QString OIIOEncoder::GetFrameFilename(int64_t index) const
+{
+  if (!image_sequence_) {
+    return params().filename();
+  }
+
+  QFileInfo info(params().filename());
+
+  QString basename = info.baseName();
+  basename.chop(Decoder::GetImageSequenceDigitCount(params().filename()));
+  basename.append(QStringLiteral("%1").arg(index, digit_count_, 10, QChar('0')));
+
+  if (!info.completeSuffix().isEmpty()) {
+    basename.append('.');
+    basename.append(info.completeSuffix());
+  }
+
+  return info.dir().filePath(basename);
+}
+
+void OIIOEncoder::WriteImage(FramePtr frame, const QString &filename)
+{
+  bool success = false;
+
+  if (frame->format() != format_) {
+    frame = frame->convert(format_);
+  }
+
+  if (frame) {
+    OIIO::ImageSpec spec = spec_;
+    spec.width = frame->width();
+    spec.height = frame->height();
+    spec.full_width = spec.width;
+    spec.full_height = spec.height;
+    spec.nchannels = frame->channel_count();
+    spec.alpha_channel = (spec.nchannels == VideoParams::kRGBAChannelCount) ? 3 : -1;
+    spec.default_channel_names();
+
+    // Write next to the destination so a failed or cancelled write never replaces a good file
+    QString temp_filename = FileFunctions::GetSafeTemporaryFilename(filename);
+    std::string std_temp_filename = temp_filename.toStdString();
+
+    auto out = OIIO::ImageOutput::create(std_temp_filename);
+
+    if (!out) {
+      qWarning() << "Failed to create image output for" << filename << QString::fromStdString(OIIO::geterror());
+    } else if (!out->open(std_temp_filename, spec)) {
+      qWarning() << "Failed to open" << filename << QString::fromStdString(out->geterror());
+    } else {
+      success = out->write_image(spec.format, frame->const_data(), OIIO::AutoStride, frame->linesize_bytes());
+
+      if (!success) {
+        qWarning() << "Failed to write" << filename << QString::fromStdString(out->geterror());
+      }
+
+      success = out->close() && success;
+    }
+
+    if (success) {
+      success = FileFunctions::RenameFileAllowOverwrite(temp_filename, filename);
+    } else {
+      QFile::remove(temp_filename);
+    }
+  }
+
+  if (success) {
+    Metrics::Add(Metrics::kFramesEncoded);
+  } else {
+    failed_ = 1;
+  }
+
+  pending_writes_.release();
+}
+
+}
@@ -0,0 +1,110 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef OIIOENCODER_H
+#define OIIOENCODER_H
+
+#include <OpenImageIO/imageio.h>
+#include <QAtomicInt>
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include "codec/encoder.h"
+
+namespace olive {
+
+/**
+ * @brief An Encoder that writes still images and image sequences through OpenImageIO
+ *
+ * Every frame of an image sequence is its own file, so unlike FFmpegEncoder, frames can be
+ * written in any order (see SupportsOutOfOrderFrames()). WriteFrame() hands each frame to a pool
+ * of IO threads and returns straight away, only blocking once kMaximumPendingWrites frames are
+ * waiting to be compressed and written.
+ *
+ * Setting the video option "image_sequence" to "0" writes a single image to the filename as-is.
+ */
+class OIIOEncoder : public Encoder
+{
+  Q_OBJECT
+public:
+  OIIOEncoder(const EncodingParams &params);
+
+  virtual ~OIIOEncoder() override;
+
+  virtual bool Open() override;
+
+  virtual bool WriteFrame(olive::FramePtr frame, olive::rational time) override;
+
+  virtual void WriteAudio(olive::AudioParams pcm_info,
+                          QIODevice *file) override;
+
+  virtual bool WriteAudio(olive::SampleBufferPtr samples) override;
+
+  virtual void Close() override;
+
+  virtual VideoParams::Format GetDesiredPixelFormat() const override;
+
+  virtual int GetTargetBitDepth() const override;
+
+  virtual bool SupportsOutOfOrderFrames() const override
+  {
+    return true;
+  }
+
+private:
+  /**
+   * @brief Returns the filename frame `index` of the export is written to
+   */
+  QString GetFrameFilename(int64_t index) const;
+
+  /**
+   * @brief Compress and write one frame, run on the IO pool
+   *
+   * The image is written to a temporary file first and only replaces `filename` once it's
+   * complete. Failures are stored in `failed_` so the next WriteFrame() returns FALSE.
+   */
+  void WriteImage(FramePtr frame, const QString& filename);
+
+  /**
+   * @brief Number of frames that can be queued or writing at once
+   */
+  static const int kMaximumPendingWrites;
+
+  bool open_;
+
+  bool image_sequence_;
+
+  int digit_count_;
+
+  OIIO::ImageSpec spec_;
+
+  VideoParams::Format format_;
+
+  QThreadPool io_pool_;
+
+  QSemaphore pending_writes_;
+
+  QAtomicInt failed_;
+
+};
+
+}
+
+#endif // OIIOENCODER_H
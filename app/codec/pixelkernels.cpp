@@ -0,0 +1,467 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "pixelkernels.h"
+
+#include <cstdint>
+#include <cstring>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+#include <QVector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OLIVE_KERNELS_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+// GCC and Clang can build F16C functions without -mf16c through the target attribute
+#define OLIVE_KERNELS_F16C
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OLIVE_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace olive {
+
+namespace {
+
+/// Values converted at a time between two non-float formats, small enough to stay in L1
+const int kScratchSize = 1024;
+
+/// Below this many values an image isn't worth splitting across threads
+const int kMinValuesPerThread = 1 << 18;
+
+float HalfToFloat(uint16_t h)
+{
+  uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+  uint32_t exponent = (h >> 10) & 0x1F;
+  uint32_t mantissa = h & 0x3FF;
+  uint32_t bits;
+
+  if (exponent == 0) {
+    if (mantissa == 0) {
+      bits = sign;
+    } else {
+      // Subnormal, normalize it
+      exponent = 127 - 15 + 1;
+
+      while (!(mantissa & 0x400)) {
+        mantissa <<= 1;
+        exponent--;
+      }
+
+      bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+  } else if (exponent == 31) {
+    // Infinity or NaN
+    bits = sign | 0x7F800000 | (mantissa << 13);
+  } else {
+    bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  }
+
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+uint16_t FloatToHalf(float f)
+{
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+
+  uint16_t sign = (bits >> 16) & 0x8000;
+  uint32_t abs = bits & 0x7FFFFFFF;
+
+  if (abs >= 0x7F800000) {
+    // Infinity or NaN, keep NaNs NaN
+    return sign | 0x7C00 | ((abs > 0x7F800000) ? 0x200 : 0);
+  }
+
+  if (abs >= 0x477FF000) {
+    // Rounds to something larger than the largest half
+    return sign | 0x7C00;
+  }
+
+  if (abs < 0x38800000) {
+    // Subnormal as a half, or too small for even that
+    if (abs < 0x33000000) {
+      return sign;
+    }
+
+    uint32_t shift = 126 - (abs >> 23);
+    uint32_t mantissa = (abs & 0x7FFFFF) | 0x800000;
+    uint32_t h = mantissa >> shift;
+    uint32_t remainder = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+
+    if (remainder > halfway || (remainder == halfway && (h & 1))) {
+      h++;
+    }
+
+    return sign | static_cast<uint16_t>(h);
+  }
+
+  // Rebias the exponent and round the mantissa to nearest even
+  uint32_t rebiased = abs - 0x38000000;
+  uint32_t h = rebiased >> 13;
+  uint32_t remainder = rebiased & 0x1FFF;
+
+  if (remainder > 0x1000 || (remainder == 0x1000 && (h & 1))) {
+    h++;
+  }
+
+  return sign | static_cast<uint16_t>(h);
+}
+
+template <typename T>
+inline T FloatToUnsigned(float f, float max)
+{
+  return static_cast<T>(qBound(0.0f, f * max + 0.5f, max));
+}
+
+void U8ToFloat(const uint8_t* src, float* dst, int count)
+{
+  int i = 0;
+  const float scale = 1.0f / 255.0f;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  __m128i zero = _mm_setzero_si128();
+  __m128 vscale = _mm_set1_ps(scale);
+
+  for (; i+16<=count; i+=16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), vscale));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), vscale));
+    _mm_storeu_ps(dst + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), vscale));
+    _mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), vscale));
+  }
+#elif defined(OLIVE_KERNELS_NEON)
+  for (; i+8<=count; i+=8) {
+    uint16x8_t v = vmovl_u8(vld1_u8(src + i));
+
+    vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(v))), scale));
+    vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(v))), scale));
+  }
+#endif
+
+  for (; i<count; i++) {
+    dst[i] = src[i] * scale;
+  }
+}
+
+void FloatToU8(const float* src, uint8_t* dst, int count)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  __m128 zero = _mm_setzero_ps();
+  __m128 max = _mm_set1_ps(255.0f);
+  __m128 half = _mm_set1_ps(0.5f);
+
+  for (; i+16<=count; i+=16) {
+    __m128i v[4];
+
+    for (int j=0; j<4; j++) {
+      // NaNs become 0 since _mm_max_ps returns its second operand for them
+      __m128 f = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + j*4), max), zero), max);
+      v[j] = _mm_cvttps_epi32(_mm_add_ps(f, half));
+    }
+
+    __m128i packed = _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3]));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+  }
+#elif defined(OLIVE_KERNELS_NEON)
+  float32x4_t zero = vdupq_n_f32(0.0f);
+  float32x4_t max = vdupq_n_f32(255.0f);
+  float32x4_t half = vdupq_n_f32(0.5f);
+
+  for (; i+8<=count; i+=8) {
+    float32x4_t a = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(src + i), max), zero), max);
+    float32x4_t b = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(src + i + 4), max), zero), max);
+
+    uint16x8_t v = vcombine_u16(vmovn_u32(vcvtq_u32_f32(vaddq_f32(a, half))),
+                                vmovn_u32(vcvtq_u32_f32(vaddq_f32(b, half))));
+    vst1_u8(dst + i, vmovn_u16(v));
+  }
+#endif
+
+  for (; i<count; i++) {
+    dst[i] = FloatToUnsigned<uint8_t>(src[i], 255.0f);
+  }
+}
+
+void U16ToFloat(const uint16_t* src, float* dst, int count)
+{
+  int i = 0;
+  const float scale = 1.0f / 65535.0f;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  __m128i zero = _mm_setzero_si128();
+  __m128 vscale = _mm_set1_ps(scale);
+
+  for (; i+8<=count; i+=8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)), vscale));
+    _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)), vscale));
+  }
+#elif defined(OLIVE_KERNELS_NEON)
+  for (; i+8<=count; i+=8) {
+    uint16x8_t v = vld1q_u16(src + i);
+
+    vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(v))), scale));
+    vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(v))), scale));
+  }
+#endif
+
+  for (; i<count; i++) {
+    dst[i] = src[i] * scale;
+  }
+}
+
+void FloatToU16(const float* src, uint16_t* dst, int count)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  __m128 zero = _mm_setzero_ps();
+  __m128 max = _mm_set1_ps(65535.0f);
+  __m128 half = _mm_set1_ps(0.5f);
+  __m128i bias = _mm_set1_epi32(32768);
+  __m128i sign = _mm_set1_epi16(static_cast<short>(0x8000));
+
+  for (; i+8<=count; i+=8) {
+    __m128i v[2];
+
+    for (int j=0; j<2; j++) {
+      __m128 f = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + j*4), max), zero), max);
+
+      // SSE2 can only pack to signed 16-bit, so shift into that range and flip the sign bit back
+      v[j] = _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(f, half)), bias);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(_mm_packs_epi32(v[0], v[1]), sign));
+  }
+#elif defined(OLIVE_KERNELS_NEON)
+  float32x4_t zero = vdupq_n_f32(0.0f);
+  float32x4_t max = vdupq_n_f32(65535.0f);
+  float32x4_t half = vdupq_n_f32(0.5f);
+
+  for (; i+8<=count; i+=8) {
+    float32x4_t a = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(src + i), max), zero), max);
+    float32x4_t b = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(src + i + 4), max), zero), max);
+
+    vst1q_u16(dst + i, vcombine_u16(vmovn_u32(vcvtq_u32_f32(vaddq_f32(a, half))),
+                                    vmovn_u32(vcvtq_u32_f32(vaddq_f32(b, half)))));
+  }
+#endif
+
+  for (; i<count; i++) {
+    dst[i] = FloatToUnsigned<uint16_t>(src[i], 65535.0f);
+  }
+}
+
+#if defined(OLIVE_KERNELS_F16C)
+__attribute__((target("f16c"))) int HalfToFloatF16C(const uint16_t* src, float* dst, int count)
+{
+  int i = 0;
+
+  for (; i+4<=count; i+=4) {
+    _mm_storeu_ps(dst + i, _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i))));
+  }
+
+  return i;
+}
+
+__attribute__((target("f16c"))) int FloatToHalfF16C(const float* src, uint16_t* dst, int count)
+{
+  int i = 0;
+
+  for (; i+4<=count; i+=4) {
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_cvtps_ph(_mm_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+  }
+
+  return i;
+}
+#endif
+
+void HalfToFloat(const uint16_t* src, float* dst, int count, bool f16c)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_F16C)
+  if (f16c) {
+    i = HalfToFloatF16C(src, dst, count);
+  }
+#elif defined(OLIVE_KERNELS_NEON) && defined(__aarch64__)
+  Q_UNUSED(f16c)
+
+  for (; i+4<=count; i+=4) {
+    vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+  }
+#else
+  Q_UNUSED(f16c)
+#endif
+
+  for (; i<count; i++) {
+    dst[i] = HalfToFloat(src[i]);
+  }
+}
+
+void FloatToHalf(const float* src, uint16_t* dst, int count, bool f16c)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_F16C)
+  if (f16c) {
+    i = FloatToHalfF16C(src, dst, count);
+  }
+#elif defined(OLIVE_KERNELS_NEON) && defined(__aarch64__)
+  Q_UNUSED(f16c)
+
+  for (; i+4<=count; i+=4) {
+    vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+  }
+#else
+  Q_UNUSED(f16c)
+#endif
+
+  for (; i<count; i++) {
+    dst[i] = FloatToHalf(src[i]);
+  }
+}
+
+void ToFloat(const void* src, VideoParams::Format format, float* dst, int count, bool f16c)
+{
+  switch (format) {
+  case VideoParams::kFormatUnsigned8:
+    U8ToFloat(static_cast<const uint8_t*>(src), dst, count);
+    break;
+  case VideoParams::kFormatUnsigned16:
+    U16ToFloat(static_cast<const uint16_t*>(src), dst, count);
+    break;
+  case VideoParams::kFormatFloat16:
+    HalfToFloat(static_cast<const uint16_t*>(src), dst, count, f16c);
+    break;
+  case VideoParams::kFormatFloat32:
+    memcpy(dst, src, count * sizeof(float));
+    break;
+  case VideoParams::kFormatInvalid:
+  case VideoParams::kFormatCount:
+    break;
+  }
+}
+
+void FromFloat(const float* src, void* dst, VideoParams::Format format, int count, bool f16c)
+{
+  switch (format) {
+  case VideoParams::kFormatUnsigned8:
+    FloatToU8(src, static_cast<uint8_t*>(dst), count);
+    break;
+  case VideoParams::kFormatUnsigned16:
+    FloatToU16(src, static_cast<uint16_t*>(dst), count);
+    break;
+  case VideoParams::kFormatFloat16:
+    FloatToHalf(src, static_cast<uint16_t*>(dst), count, f16c);
+    break;
+  case VideoParams::kFormatFloat32:
+    memcpy(dst, src, count * sizeof(float));
+    break;
+  case VideoParams::kFormatInvalid:
+  case VideoParams::kFormatCount:
+    break;
+  }
+}
+
+}
+
+void PixelKernels::Convert(const void *src, VideoParams::Format src_format, void *dst, VideoParams::Format dst_format, int count)
+{
+  if (src_format == dst_format) {
+    memcpy(dst, src, static_cast<size_t>(count) * VideoParams::GetBytesPerChannel(src_format));
+    return;
+  }
+
+  bool f16c = HasF16C();
+
+  if (dst_format == VideoParams::kFormatFloat32) {
+    ToFloat(src, src_format, static_cast<float*>(dst), count, f16c);
+  } else if (src_format == VideoParams::kFormatFloat32) {
+    FromFloat(static_cast<const float*>(src), dst, dst_format, count, f16c);
+  } else {
+    float scratch[kScratchSize];
+
+    int src_bytes = VideoParams::GetBytesPerChannel(src_format);
+    int dst_bytes = VideoParams::GetBytesPerChannel(dst_format);
+
+    for (int i=0; i<count; i+=kScratchSize) {
+      int n = qMin(kScratchSize, count - i);
+
+      ToFloat(static_cast<const char*>(src) + i * src_bytes, src_format, scratch, n, f16c);
+      FromFloat(scratch, static_cast<char*>(dst) + i * dst_bytes, dst_format, n, f16c);
+    }
+  }
+}
+
+void PixelKernels::ConvertImage(const char *src, VideoParams::Format src_format, int src_linesize,
+                                char *dst, VideoParams::Format dst_format, int dst_linesize,
+                                int values_per_row, int height)
+{
+  int band_count = qBound(1, static_cast<int>(static_cast<qint64>(values_per_row) * height / kMinValuesPerThread), QThread::idealThreadCount());
+  band_count = qMin(band_count, height);
+
+  auto convert_rows = [=](int ybegin, int yend) {
+    for (int y=ybegin; y<yend; y++) {
+      Convert(src + y * src_linesize, src_format, dst + y * dst_linesize, dst_format, values_per_row);
+    }
+  };
+
+  if (band_count <= 1) {
+    convert_rows(0, height);
+    return;
+  }
+
+  int band_height = (height + band_count - 1) / band_count;
+  QVector<int> bands;
+
+  for (int y=0; y<height; y+=band_height) {
+    bands.append(y);
+  }
+
+  QtConcurrent::blockingMap(bands, [=](int y) {
+    convert_rows(y, qMin(y + band_height, height));
+  });
+}
+
+bool PixelKernels::HasF16C()
+{
+#if defined(OLIVE_KERNELS_F16C)
+  static const bool has_f16c = __builtin_cpu_supports("f16c");
+  return has_f16c;
+#else
+  return false;
+#endif
+}
+
+}
@@ -0,0 +1,66 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PIXELKERNELS_H
+#define PIXELKERNELS_H
+
+#include "render/videoparams.h"
+
+namespace olive {
+
+/**
+ * @brief Vectorized conversions between the pixel formats in VideoParams::Format
+ *
+ * Every format converts to and from 32-bit float with a dedicated loop, using SSE2 on x86 or NEON
+ * on ARM like SampleKernels. Half floats additionally use F16C when the CPU running Olive supports
+ * it, checked once at runtime. Conversions between two non-float formats go through a small
+ * float buffer that stays in cache.
+ *
+ * Values are converted the same way OIIO does: unsigned integers map 0 to max onto 0.0 to 1.0,
+ * floats going to integers are clamped to that range and rounded to nearest. Channels are
+ * treated alike so any channel count works.
+ *
+ * None of these require aligned pointers.
+ */
+class PixelKernels
+{
+public:
+  /**
+   * @brief Convert `count` channel values from `src_format` to `dst_format`
+   */
+  static void Convert(const void* src, VideoParams::Format src_format, void* dst, VideoParams::Format dst_format, int count);
+
+  /**
+   * @brief Convert an image `values_per_row` channel values wide and `height` rows tall
+   *
+   * Linesizes are in bytes. Large images are split into bands of rows converted in parallel.
+   */
+  static void ConvertImage(const char* src, VideoParams::Format src_format, int src_linesize,
+                           char* dst, VideoParams::Format dst_format, int dst_linesize,
+                           int values_per_row, int height);
+
+private:
+  static bool HasF16C();
+
+};
+
+}
+
+#endif // PIXELKERNELS_H
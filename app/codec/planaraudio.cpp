@@ -0,0 +1,264 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "planaraudio.h"
+
+#include <QDebug>
+
+namespace olive {
+
+const char PlanarAudio::kMagic[4] = {'O', 'P', 'C', 'M'};
+const qint32 PlanarAudio::kVersion = 1;
+const qint64 PlanarAudio::kHeaderSize = 64;
+const int PlanarAudio::kDefaultChunkSize = 48000;
+
+PlanarAudioOutput::PlanarAudioOutput(const QString &f, const AudioParams &params, int chunk_size) :
+  file_(f),
+  params_(params),
+  chunk_size_(chunk_size),
+  chunk_fill_(0),
+  sample_count_(0)
+{
+  Q_ASSERT(params_.is_valid());
+}
+
+PlanarAudioOutput::~PlanarAudioOutput()
+{
+  close();
+}
+
+bool PlanarAudioOutput::open()
+{
+  chunk_fill_ = 0;
+  sample_count_ = 0;
+
+  if (!file_.open(QFile::WriteOnly)) {
+    return false;
+  }
+
+  chunk_.resize(params_.samples_to_bytes(chunk_size_));
+
+  // Write a placeholder header, the sample count is filled in on close
+  return WriteHeader();
+}
+
+void PlanarAudioOutput::write(const char *bytes, int length)
+{
+  if (!file_.isOpen()) {
+    return;
+  }
+
+  const int bytes_per_sample = params_.bytes_per_sample_per_channel();
+  const int channels = params_.channel_count();
+  const int frame_count = length / (bytes_per_sample * channels);
+  const int channel_stride = chunk_size_ * bytes_per_sample;
+
+  for (int i=0; i<frame_count; i++) {
+    for (int j=0; j<channels; j++) {
+      memcpy(chunk_.data() + j * channel_stride + chunk_fill_ * bytes_per_sample,
+             bytes + (i * channels + j) * bytes_per_sample,
+             bytes_per_sample);
+    }
+
+    chunk_fill_++;
+
+    if (chunk_fill_ == chunk_size_) {
+      FlushChunk();
+    }
+  }
+}
+
+void PlanarAudioOutput::close()
+{
+  if (!file_.isOpen()) {
+    return;
+  }
+
+  if (chunk_fill_ > 0) {
+    // Pad the final chunk with silence so every chunk has the same layout
+    const int bytes_per_sample = params_.bytes_per_sample_per_channel();
+    const int channel_stride = chunk_size_ * bytes_per_sample;
+    const int real_fill = chunk_fill_;
+
+    for (int j=0; j<params_.channel_count(); j++) {
+      memset(chunk_.data() + j * channel_stride + real_fill * bytes_per_sample,
+             0,
+             (chunk_size_ - real_fill) * bytes_per_sample);
+    }
+
+    // FlushChunk() always writes the whole chunk but only counts the samples that were filled
+    FlushChunk();
+  }
+
+  file_.seek(0);
+  WriteHeader();
+
+  file_.close();
+}
+
+bool PlanarAudioOutput::WriteHeader()
+{
+  PlanarAudio::Header header;
+  memset(&header, 0, sizeof(header));
+
+  memcpy(header.magic, PlanarAudio::kMagic, sizeof(header.magic));
+  header.version = PlanarAudio::kVersion;
+  header.sample_rate = params_.sample_rate();
+  header.format = params_.format();
+  header.channel_layout = params_.channel_layout();
+  header.chunk_size = chunk_size_;
+  header.sample_count = sample_count_;
+
+  QByteArray header_bytes(PlanarAudio::kHeaderSize, 0);
+  memcpy(header_bytes.data(), &header, sizeof(header));
+
+  return file_.write(header_bytes) == PlanarAudio::kHeaderSize;
+}
+
+void PlanarAudioOutput::FlushChunk()
+{
+  file_.write(chunk_);
+
+  sample_count_ += chunk_fill_;
+  chunk_fill_ = 0;
+}
+
+PlanarAudioInput::PlanarAudioInput(const QString &f) :
+  file_(f),
+  map_(nullptr),
+  chunk_size_(0),
+  sample_count_(0)
+{
+}
+
+PlanarAudioInput::~PlanarAudioInput()
+{
+  close();
+}
+
+bool PlanarAudioInput::open()
+{
+  if (map_) {
+    return true;
+  }
+
+  if (!file_.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  PlanarAudio::Header header;
+
+  if (file_.size() < PlanarAudio::kHeaderSize
+      || file_.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header)
+      || memcmp(header.magic, PlanarAudio::kMagic, sizeof(header.magic))
+      || header.version != PlanarAudio::kVersion
+      || header.chunk_size <= 0) {
+    // Not a planar audio file, possibly a conform from an older version
+    file_.close();
+    return false;
+  }
+
+  params_ = AudioParams(header.sample_rate, header.channel_layout, static_cast<AudioParams::Format>(header.format));
+  chunk_size_ = header.chunk_size;
+  sample_count_ = header.sample_count;
+
+  qint64 chunk_bytes = params_.samples_to_bytes(chunk_size_);
+  qint64 chunk_count = (sample_count_ + chunk_size_ - 1) / chunk_size_;
+
+  if (!params_.is_valid()
+      || file_.size() < PlanarAudio::kHeaderSize + chunk_count * chunk_bytes) {
+    qWarning() << "Planar audio file" << file_.fileName() << "is truncated or corrupt";
+    file_.close();
+    return false;
+  }
+
+  map_ = file_.map(0, file_.size());
+
+  if (!map_) {
+    qWarning() << "Failed to map planar audio file" << file_.fileName();
+    file_.close();
+    return false;
+  }
+
+  return true;
+}
+
+void PlanarAudioInput::close()
+{
+  if (map_) {
+    file_.unmap(map_);
+    map_ = nullptr;
+  }
+
+  if (file_.isOpen()) {
+    file_.close();
+  }
+}
+
+SampleBufferPtr PlanarAudioInput::read(qint64 start, qint64 count) const
+{
+  if (!map_) {
+    return nullptr;
+  }
+
+  if (params_.format() != AudioParams::kFormatFloat32) {
+    qWarning() << "Only 32-bit float planar audio can be read into a SampleBuffer";
+    return nullptr;
+  }
+
+  start = qMax(start, qint64(0));
+  count = qMin(count, sample_count_ - start);
+
+  SampleBufferPtr buffer = SampleBuffer::Create();
+  buffer->set_audio_params(params_);
+
+  if (count <= 0) {
+    return buffer;
+  }
+
+  buffer->set_sample_count(count);
+  buffer->allocate();
+
+  const qint64 chunk_bytes = params_.samples_to_bytes(chunk_size_);
+  const qint64 channel_stride = chunk_size_ * qint64(sizeof(float));
+
+  qint64 copied = 0;
+
+  while (copied < count) {
+    qint64 sample = start + copied;
+    qint64 chunk = sample / chunk_size_;
+    qint64 offset_in_chunk = sample % chunk_size_;
+    qint64 run = qMin(count - copied, chunk_size_ - offset_in_chunk);
+
+    const uchar* chunk_data = map_ + PlanarAudio::kHeaderSize + chunk * chunk_bytes;
+
+    for (int i=0; i<params_.channel_count(); i++) {
+      memcpy(buffer->data()[i] + copied,
+             chunk_data + i * channel_stride + offset_in_chunk * qint64(sizeof(float)),
+             run * sizeof(float));
+    }
+
+    copied += run;
+  }
+
+  return buffer;
+}
+
+}
@@ -0,0 +1,167 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PLANARAUDIO_H
+#define PLANARAUDIO_H
+
+#include <QFile>
+
+#include "codec/samplebuffer.h"
+#include "render/audioparams.h"
+
+namespace olive {
+
+/**
+ * @brief Layout of the planar audio files used for conformed audio
+ *
+ * Samples are stored in fixed size chunks, and within each chunk every channel is stored
+ * contiguously. This means reading any range of a channel is a handful of straight copies from
+ * the file, and the file can be memory mapped rather than read and deinterleaved on every request.
+ *
+ * The last chunk is padded with silence, the header's sample count is the real length.
+ */
+class PlanarAudio
+{
+public:
+  static const char kMagic[4];
+  static const qint32 kVersion;
+  static const qint64 kHeaderSize;
+  static const int kDefaultChunkSize;
+
+  struct Header {
+    char magic[4];
+    qint32 version;
+    qint32 sample_rate;
+    qint32 format;
+    quint64 channel_layout;
+    qint32 chunk_size;
+    qint32 reserved;
+    qint64 sample_count;
+  };
+
+};
+
+/**
+ * @brief Writes packed (interleaved) audio to a planar audio file
+ */
+class PlanarAudioOutput
+{
+public:
+  PlanarAudioOutput(const QString& f, const AudioParams& params, int chunk_size = PlanarAudio::kDefaultChunkSize);
+
+  ~PlanarAudioOutput();
+
+  DISABLE_COPY_MOVE(PlanarAudioOutput)
+
+  bool open();
+
+  void write(const char* bytes, int length);
+
+  void close();
+
+  const AudioParams& params() const
+  {
+    return params_;
+  }
+
+private:
+  bool WriteHeader();
+
+  void FlushChunk();
+
+  QFile file_;
+
+  AudioParams params_;
+
+  int chunk_size_;
+
+  QByteArray chunk_;
+
+  int chunk_fill_;
+
+  qint64 sample_count_;
+
+};
+
+/**
+ * @brief Reads a planar audio file through a memory map
+ *
+ * The file stays mapped until close() so repeated reads don't reopen it.
+ */
+class PlanarAudioInput
+{
+public:
+  PlanarAudioInput(const QString& f);
+
+  ~PlanarAudioInput();
+
+  DISABLE_COPY_MOVE(PlanarAudioInput)
+
+  /**
+   * @brief Map the file and validate its header, returns FALSE if it isn't a planar audio file
+   */
+  bool open();
+
+  bool is_open() const
+  {
+    return map_;
+  }
+
+  void close();
+
+  QString filename() const
+  {
+    return file_.fileName();
+  }
+
+  const AudioParams& params() const
+  {
+    return params_;
+  }
+
+  qint64 sample_count() const
+  {
+    return sample_count_;
+  }
+
+  /**
+   * @brief Read samples starting at `start` into a new SampleBuffer
+   *
+   * The range is clamped to the length of the file. Only 32-bit float files can be read into a
+   * SampleBuffer.
+   */
+  SampleBufferPtr read(qint64 start, qint64 count) const;
+
+private:
+  QFile file_;
+
+  uchar* map_;
+
+  AudioParams params_;
+
+  int chunk_size_;
+
+  qint64 sample_count_;
+
+};
+
+}
+
+#endif // PLANARAUDIO_H
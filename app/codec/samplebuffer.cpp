@@ -20,11 +20,20 @@
 
 #include "samplebuffer.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "audioresampler.h"
+#include "samplekernels.h"
+
 namespace olive {
 
+const size_t SampleBuffer::kPlaneAlignment = 64;
+
 SampleBuffer::SampleBuffer() :
   sample_count_per_channel_(0),
-  data_(nullptr)
+  data_(nullptr),
+  memory_(MemoryAccounting::kSampleBuffers)
 {
 }
 
@@ -64,15 +73,11 @@ SampleBufferPtr SampleBuffer::CreateFromPackedData(const AudioParams &audio_para
   int samples_per_channel = audio_params.bytes_to_samples(bytes.size());
   SampleBufferPtr buffer = CreateAllocated(audio_params, samples_per_channel);
 
-  int total_samples = samples_per_channel * audio_params.channel_count();
-
-  const float* packed_data = reinterpret_cast<const float*>(bytes.constData());
-
-  for (int i=0;i<total_samples;i++) {
-    int channel = i % audio_params.channel_count();
-    int index = i / audio_params.channel_count();
-
-    buffer->data_[channel][index] = packed_data[i];
+  if (buffer->is_allocated()) {
+    SampleKernels::Deinterleave(reinterpret_cast<const float*>(bytes.constData()),
+                                audio_params.channel_count(),
+                                samples_per_channel,
+                                buffer->data_);
   }
 
   return buffer;
@@ -145,12 +150,16 @@ void SampleBuffer::allocate()
     return;
   }
 
-  allocate_sample_buffer(&data_, audio_params_.channel_count(), sample_count_per_channel_);
+  allocate_sample_buffer(&buffer_, &data_, audio_params_.channel_count(), sample_count_per_channel_);
+
+  UpdateMemoryUsage();
 }
 
 void SampleBuffer::destroy()
 {
-  destroy_sample_buffer(&data_, audio_params_.channel_count());
+  destroy_sample_buffer(&buffer_, &data_);
+
+  UpdateMemoryUsage();
 }
 
 void SampleBuffer::reverse()
@@ -160,14 +169,8 @@ void SampleBuffer::reverse()
     return;
   }
 
-  int half_nb_sample = sample_count_per_channel_ / 2;
-
-  for (int i=0;i<half_nb_sample;i++) {
-    int opposite_ind = sample_count_per_channel_ - i - 1;
-
-    for (int j=0;j<audio_params_.channel_count();j++) {
-      std::swap(data_[j][i], data_[j][opposite_ind]);
-    }
+  for (int i=0;i<audio_params_.channel_count();i++) {
+    SampleKernels::Reverse(data_[i], sample_count_per_channel_);
   }
 }
 
@@ -178,40 +181,42 @@ void SampleBuffer::speed(double speed)
     return;
   }
 
-  sample_count_per_channel_ = qRound(static_cast<double>(sample_count_per_channel_) / speed);
+  int new_sample_count = qRound(static_cast<double>(sample_count_per_channel_) / speed);
 
   float** input_data = data_;
   float** output_data;
+  BufferPool::BufferPtr output_buffer;
 
-  allocate_sample_buffer(&output_data, audio_params_.channel_count(), sample_count_per_channel_);
+  allocate_sample_buffer(&output_buffer, &output_data, audio_params_.channel_count(), new_sample_count);
 
-  for (int i=0;i<sample_count_per_channel_;i++) {
-    int input_index = qFloor(static_cast<double>(i) * speed);
-
-    for (int j=0;j<audio_params_.channel_count();j++) {
-      output_data[j][i] = input_data[j][input_index];
-    }
+  if (!output_data) {
+    return;
   }
 
-  destroy_sample_buffer(&input_data, audio_params_.channel_count());
+  AudioResampler resampler;
+  resampler.Process(input_data, sample_count_per_channel_, audio_params_.channel_count(), output_data,
+                    new_sample_count, speed, speed);
 
+  sample_count_per_channel_ = new_sample_count;
+
+  destroy_sample_buffer(&buffer_, &input_data);
+
+  buffer_ = output_buffer;
   data_ = output_data;
+
+  UpdateMemoryUsage();
 }
 
 void SampleBuffer::transform_volume(float f)
 {
   for (int i=0;i<audio_params().channel_count();i++) {
-    for (int j=0;j<sample_count_per_channel_;j++) {
-      data_[i][j] *= f;
-    }
+    SampleKernels::Multiply(data_[i], sample_count_per_channel_, f);
   }
 }
 
 void SampleBuffer::transform_volume_for_channel(int channel, float volume)
 {
-  for (int i=0;i<sample_count_per_channel_;i++) {
-    data_[channel][i] *= volume;
-  }
+  SampleKernels::Multiply(data_[channel], sample_count_per_channel_, volume);
 }
 
 void SampleBuffer::transform_volume_for_sample(int sample_index, float volume)
@@ -239,9 +244,7 @@ void SampleBuffer::fill(const float &f, int start_sample, int end_sample)
   }
 
   for (int i=0;i<audio_params().channel_count();i++) {
-    for (int j=start_sample;j<end_sample;j++) {
-      data_[i][j] = f;
-    }
+    std::fill(data_[i] + start_sample, data_[i] + end_sample, f);
   }
 }
 
@@ -253,9 +256,7 @@ void SampleBuffer::set(const float **data, int sample_offset, int sample_length)
   }
 
   for (int i=0;i<audio_params().channel_count();i++) {
-    for (int j=0;j<sample_length;j++) {
-      data_[i][j + sample_offset] = data[i][j];
-    }
+    memcpy(data_[i] + sample_offset, data[i], static_cast<size_t>(sample_length) * sizeof(float));
   }
 }
 
@@ -271,43 +272,56 @@ QByteArray SampleBuffer::toPackedData() const
   if (is_allocated()) {
     packed_data.resize(audio_params_.samples_to_bytes(sample_count_per_channel_));
 
-    float* output_data = reinterpret_cast<float*>(packed_data.data());
-
-    int output_index = 0;
-
-    for (int j=0;j<sample_count_per_channel_;j++) {
-      for (int i=0;i<audio_params_.channel_count();i++) {
-        output_data[output_index] = data_[i][j];
-
-        output_index++;
-      }
-    }
+    SampleKernels::Interleave(data_,
+                              audio_params_.channel_count(),
+                              sample_count_per_channel_,
+                              reinterpret_cast<float*>(packed_data.data()));
   }
 
   return packed_data;
 }
 
-void SampleBuffer::allocate_sample_buffer(float ***data, int nb_channels, int nb_samples)
+void SampleBuffer::allocate_sample_buffer(BufferPool::BufferPtr *buffer, float ***data, int nb_channels, int nb_samples)
 {
   Q_ASSERT(nb_samples > 0);
 
-  *data = new float* [nb_channels];
+  size_t table_sz = sizeof(float*) * static_cast<size_t>(nb_channels);
+  size_t plane_sz = sizeof(float) * static_cast<size_t>(nb_samples);
+  plane_sz = (plane_sz + kPlaneAlignment - 1) & ~(kPlaneAlignment - 1);
+
+  // Extra alignment's worth so the first plane can be aligned regardless of where the buffer starts
+  *buffer = BufferPool::Get(table_sz + kPlaneAlignment + plane_sz * static_cast<size_t>(nb_channels));
+
+  if (!*buffer) {
+    qCritical() << "Failed to allocate sample buffer";
+    *data = nullptr;
+    return;
+  }
+
+  char* base = (*buffer)->data();
+  *data = reinterpret_cast<float**>(base);
+
+  quintptr planes = reinterpret_cast<quintptr>(base + table_sz);
+  planes = (planes + kPlaneAlignment - 1) & ~static_cast<quintptr>(kPlaneAlignment - 1);
 
   for (int i=0;i<nb_channels;i++) {
-    (*data)[i] = new float[nb_samples];
+    (*data)[i] = reinterpret_cast<float*>(planes + plane_sz * static_cast<size_t>(i));
   }
 }
 
-void SampleBuffer::destroy_sample_buffer(float ***data, int nb_channels)
+void SampleBuffer::UpdateMemoryUsage()
 {
-  if (*data) {
-    for (int i=0;i<nb_channels;i++) {
-      delete [] (*data)[i];
-    }
-
-    delete [] *data;
-    *data = nullptr;
+  if (data_) {
+    memory_.Set(static_cast<qint64>(sizeof(float)) * audio_params_.channel_count() * sample_count_per_channel_);
+  } else {
+    memory_.Set(0);
   }
 }
 
+void SampleBuffer::destroy_sample_buffer(BufferPool::BufferPtr *buffer, float ***data)
+{
+  *data = nullptr;
+  *buffer = nullptr;
+}
+
 }
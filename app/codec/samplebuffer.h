@@ -23,6 +23,8 @@
 
 #include <memory>
 
+#include "common/bufferpool.h"
+#include "common/memoryaccounting.h"
 #include "render/audioparams.h"
 
 namespace olive {
@@ -82,9 +84,25 @@ public:
   QByteArray toPackedData() const;
 
 private:
-  static void allocate_sample_buffer(float*** data, int nb_channels, int nb_samples);
-
-  static void destroy_sample_buffer(float*** data, int nb_channels);
+  /**
+   * @brief Allocate planar sample data as a single BufferPool buffer
+   *
+   * The channel pointer table and every channel plane are stored in `buffer`, with each plane
+   * padded to a cache line so SampleKernels can use aligned loads.
+   */
+  static void allocate_sample_buffer(BufferPool::BufferPtr* buffer, float*** data, int nb_channels, int nb_samples);
+
+  static void destroy_sample_buffer(BufferPool::BufferPtr* buffer, float*** data);
+
+  /**
+   * @brief Alignment in bytes of each channel plane
+   */
+  static const size_t kPlaneAlignment;
+
+  /**
+   * @brief Update `memory_` after `data_` has been allocated, reallocated or destroyed
+   */
+  void UpdateMemoryUsage();
 
   AudioParams audio_params_;
 
@@ -92,6 +110,10 @@ private:
 
   float** data_;
 
+  BufferPool::BufferPtr buffer_;
+
+  MemoryAccounting::Counter memory_;
+
 };
 
 }
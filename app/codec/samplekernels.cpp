@@ -0,0 +1,444 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "samplekernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OLIVE_KERNELS_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+// GCC and Clang can build AVX functions without -mavx through the target attribute
+#define OLIVE_KERNELS_AVX
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OLIVE_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace olive {
+
+namespace {
+
+/**
+ * @brief Spread per-channel min/max across vector lanes, lane `k` holds channel `k % channels`
+ */
+void InitLanes(int lanes, int channels, const float* min, const float* max, float* lane_min, float* lane_max)
+{
+  for (int k=0; k<lanes; k++) {
+    lane_min[k] = min[k % channels];
+    lane_max[k] = max[k % channels];
+  }
+}
+
+void ReduceLanes(int lanes, int channels, const float* lane_min, const float* lane_max, float* min, float* max)
+{
+  for (int k=0; k<lanes; k++) {
+    min[k % channels] = std::min(min[k % channels], lane_min[k]);
+    max[k % channels] = std::max(max[k % channels], lane_max[k]);
+  }
+}
+
+#if defined(OLIVE_KERNELS_SSE2) || defined(OLIVE_KERNELS_NEON)
+int Multiply4(float* data, int count, float f)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  __m128 factor = _mm_set1_ps(f);
+
+  for (; i+4<=count; i+=4) {
+    _mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), factor));
+  }
+#else
+  for (; i+4<=count; i+=4) {
+    vst1q_f32(data + i, vmulq_n_f32(vld1q_f32(data + i), f));
+  }
+#endif
+
+  return i;
+}
+
+int MultiplyAdd4(float* dst, const float* src, int count, float gain)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  __m128 factor = _mm_set1_ps(gain);
+
+  for (; i+4<=count; i+=4) {
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), factor)));
+  }
+#else
+  for (; i+4<=count; i+=4) {
+    vst1q_f32(dst + i, vmlaq_n_f32(vld1q_f32(dst + i), vld1q_f32(src + i), gain));
+  }
+#endif
+
+  return i;
+}
+
+int ExpandMinMax4(const float* data, int count, int channels, float* min, float* max)
+{
+  float lane_min[4];
+  float lane_max[4];
+  InitLanes(4, channels, min, max, lane_min, lane_max);
+
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  __m128 vmin = _mm_loadu_ps(lane_min);
+  __m128 vmax = _mm_loadu_ps(lane_max);
+
+  for (; i+4<=count; i+=4) {
+    __m128 v = _mm_loadu_ps(data + i);
+    vmin = _mm_min_ps(vmin, v);
+    vmax = _mm_max_ps(vmax, v);
+  }
+
+  _mm_storeu_ps(lane_min, vmin);
+  _mm_storeu_ps(lane_max, vmax);
+#else
+  float32x4_t vmin = vld1q_f32(lane_min);
+  float32x4_t vmax = vld1q_f32(lane_max);
+
+  for (; i+4<=count; i+=4) {
+    float32x4_t v = vld1q_f32(data + i);
+    vmin = vminq_f32(vmin, v);
+    vmax = vmaxq_f32(vmax, v);
+  }
+
+  vst1q_f32(lane_min, vmin);
+  vst1q_f32(lane_max, vmax);
+#endif
+
+  ReduceLanes(4, channels, lane_min, lane_max, min, max);
+
+  return i;
+}
+
+int DotProduct4(const float* a, const float* b, int count, float* sum)
+{
+  float lanes[4];
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  __m128 acc = _mm_setzero_ps();
+
+  for (; i+4<=count; i+=4) {
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+
+  _mm_storeu_ps(lanes, acc);
+#else
+  float32x4_t acc = vdupq_n_f32(0.0f);
+
+  for (; i+4<=count; i+=4) {
+    acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+  }
+
+  vst1q_f32(lanes, acc);
+#endif
+
+  *sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+  return i;
+}
+#endif
+
+#if defined(OLIVE_KERNELS_AVX)
+__attribute__((target("avx"))) int MultiplyAVX(float* data, int count, float f)
+{
+  __m256 factor = _mm256_set1_ps(f);
+
+  int i = 0;
+
+  for (; i+8<=count; i+=8) {
+    _mm256_storeu_ps(data + i, _mm256_mul_ps(_mm256_loadu_ps(data + i), factor));
+  }
+
+  return i;
+}
+
+__attribute__((target("avx"))) int MultiplyAddAVX(float* dst, const float* src, int count, float gain)
+{
+  __m256 factor = _mm256_set1_ps(gain);
+
+  int i = 0;
+
+  for (; i+8<=count; i+=8) {
+    _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i),
+                                            _mm256_mul_ps(_mm256_loadu_ps(src + i), factor)));
+  }
+
+  return i;
+}
+
+__attribute__((target("avx"))) int ExpandMinMaxAVX(const float* data, int count, int channels, float* min, float* max)
+{
+  float lane_min[8];
+  float lane_max[8];
+  InitLanes(8, channels, min, max, lane_min, lane_max);
+
+  __m256 vmin = _mm256_loadu_ps(lane_min);
+  __m256 vmax = _mm256_loadu_ps(lane_max);
+
+  int i = 0;
+
+  for (; i+8<=count; i+=8) {
+    __m256 v = _mm256_loadu_ps(data + i);
+    vmin = _mm256_min_ps(vmin, v);
+    vmax = _mm256_max_ps(vmax, v);
+  }
+
+  _mm256_storeu_ps(lane_min, vmin);
+  _mm256_storeu_ps(lane_max, vmax);
+
+  ReduceLanes(8, channels, lane_min, lane_max, min, max);
+
+  return i;
+}
+
+__attribute__((target("avx"))) int DotProductAVX(const float* a, const float* b, int count, float* sum)
+{
+  __m256 acc = _mm256_setzero_ps();
+
+  int i = 0;
+
+  for (; i+8<=count; i+=8) {
+    acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+  }
+
+  float lanes[8];
+  _mm256_storeu_ps(lanes, acc);
+
+  for (int k=0; k<8; k++) {
+    *sum += lanes[k];
+  }
+
+  return i;
+}
+#endif
+
+}
+
+void SampleKernels::Multiply(float *data, int count, float f)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_AVX)
+  if (HasAVX()) {
+    i = MultiplyAVX(data, count, f);
+  }
+#endif
+
+#if defined(OLIVE_KERNELS_SSE2) || defined(OLIVE_KERNELS_NEON)
+  i += Multiply4(data + i, count - i, f);
+#endif
+
+  for (; i<count; i++) {
+    data[i] *= f;
+  }
+}
+
+void SampleKernels::MultiplyAdd(float *dst, const float *src, int count, float gain)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_AVX)
+  if (HasAVX()) {
+    i = MultiplyAddAVX(dst, src, count, gain);
+  }
+#endif
+
+#if defined(OLIVE_KERNELS_SSE2) || defined(OLIVE_KERNELS_NEON)
+  i += MultiplyAdd4(dst + i, src + i, count - i, gain);
+#endif
+
+  for (; i<count; i++) {
+    dst[i] += src[i] * gain;
+  }
+}
+
+void SampleKernels::Reverse(float *data, int count)
+{
+  int start = 0;
+  int end = count;
+
+  // Swap blocks of 4 from either end, reversing each block as it moves
+  while (end - start >= 8) {
+#if defined(OLIVE_KERNELS_SSE2)
+    __m128 a = _mm_loadu_ps(data + start);
+    __m128 b = _mm_loadu_ps(data + end - 4);
+    _mm_storeu_ps(data + start, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 1, 2, 3)));
+    _mm_storeu_ps(data + end - 4, _mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 1, 2, 3)));
+#elif defined(OLIVE_KERNELS_NEON)
+    float32x4_t a = vrev64q_f32(vld1q_f32(data + start));
+    float32x4_t b = vrev64q_f32(vld1q_f32(data + end - 4));
+    vst1q_f32(data + start, vcombine_f32(vget_high_f32(b), vget_low_f32(b)));
+    vst1q_f32(data + end - 4, vcombine_f32(vget_high_f32(a), vget_low_f32(a)));
+#else
+    break;
+#endif
+
+    start += 4;
+    end -= 4;
+  }
+
+  std::reverse(data + start, data + end);
+}
+
+void SampleKernels::Interleave(const float * const *planar, int channels, int count, float *packed)
+{
+  if (channels == 1) {
+    memcpy(packed, planar[0], static_cast<size_t>(count) * sizeof(float));
+    return;
+  }
+
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2) || defined(OLIVE_KERNELS_NEON)
+  // Stereo is by far the most common layout so it gets its own path
+  if (channels == 2) {
+    const float* left = planar[0];
+    const float* right = planar[1];
+
+    for (; i+4<=count; i+=4) {
+#if defined(OLIVE_KERNELS_SSE2)
+      __m128 l = _mm_loadu_ps(left + i);
+      __m128 r = _mm_loadu_ps(right + i);
+      _mm_storeu_ps(packed + i*2, _mm_unpacklo_ps(l, r));
+      _mm_storeu_ps(packed + i*2 + 4, _mm_unpackhi_ps(l, r));
+#else
+      float32x4x2_t lr;
+      lr.val[0] = vld1q_f32(left + i);
+      lr.val[1] = vld1q_f32(right + i);
+      vst2q_f32(packed + i*2, lr);
+#endif
+    }
+  }
+#endif
+
+  for (; i<count; i++) {
+    for (int j=0; j<channels; j++) {
+      packed[i*channels + j] = planar[j][i];
+    }
+  }
+}
+
+void SampleKernels::Deinterleave(const float *packed, int channels, int count, float * const *planar)
+{
+  if (channels == 1) {
+    memcpy(planar[0], packed, static_cast<size_t>(count) * sizeof(float));
+    return;
+  }
+
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2) || defined(OLIVE_KERNELS_NEON)
+  if (channels == 2) {
+    float* left = planar[0];
+    float* right = planar[1];
+
+    for (; i+4<=count; i+=4) {
+#if defined(OLIVE_KERNELS_SSE2)
+      __m128 a = _mm_loadu_ps(packed + i*2);
+      __m128 b = _mm_loadu_ps(packed + i*2 + 4);
+      _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+      _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+#else
+      float32x4x2_t lr = vld2q_f32(packed + i*2);
+      vst1q_f32(left + i, lr.val[0]);
+      vst1q_f32(right + i, lr.val[1]);
+#endif
+    }
+  }
+#endif
+
+  for (; i<count; i++) {
+    for (int j=0; j<channels; j++) {
+      planar[j][i] = packed[i*channels + j];
+    }
+  }
+}
+
+void SampleKernels::ExpandMinMax(const float *data, int count, int channels, float *min, float *max)
+{
+  int i = 0;
+
+  // Vector lanes map onto channels as long as the channel count divides the vector width, which
+  // covers mono, stereo and quad
+#if defined(OLIVE_KERNELS_AVX)
+  if (HasAVX() && 8 % channels == 0) {
+    i = ExpandMinMaxAVX(data, count, channels, min, max);
+  }
+#endif
+
+#if defined(OLIVE_KERNELS_SSE2) || defined(OLIVE_KERNELS_NEON)
+  if (i == 0 && 4 % channels == 0) {
+    i = ExpandMinMax4(data, count, channels, min, max);
+  }
+#endif
+
+  // `i` is always a multiple of `channels` here so the remainder starts on the first channel
+  for (; i<count; i++) {
+    int c = i % channels;
+
+    min[c] = std::min(min[c], data[i]);
+    max[c] = std::max(max[c], data[i]);
+  }
+}
+
+float SampleKernels::DotProduct(const float *a, const float *b, int count)
+{
+  float sum = 0.0f;
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_AVX)
+  if (HasAVX()) {
+    i = DotProductAVX(a, b, count, &sum);
+  }
+#endif
+
+#if defined(OLIVE_KERNELS_SSE2) || defined(OLIVE_KERNELS_NEON)
+  i += DotProduct4(a + i, b + i, count - i, &sum);
+#endif
+
+  for (; i<count; i++) {
+    sum += a[i] * b[i];
+  }
+
+  return sum;
+}
+
+bool SampleKernels::HasAVX()
+{
+#if defined(OLIVE_KERNELS_AVX)
+  static const bool has_avx = __builtin_cpu_supports("avx");
+  return has_avx;
+#else
+  return false;
+#endif
+}
+
+}
@@ -0,0 +1,85 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SAMPLEKERNELS_H
+#define SAMPLEKERNELS_H
+
+namespace olive {
+
+/**
+ * @brief Vectorized loops over float audio used by SampleBuffer and AudioVisualWaveform
+ *
+ * Each function uses SSE2 on x86 or NEON on ARM (both are baseline on the 64-bit targets we
+ * build for) and falls back to plain loops elsewhere. Multiply(), MultiplyAdd(), ExpandMinMax() and DotProduct()
+ * additionally
+ * use AVX when the CPU running Olive supports it, which is checked once at runtime so no special
+ * compiler flags are required.
+ *
+ * None of these require aligned pointers.
+ */
+class SampleKernels
+{
+public:
+  /**
+   * @brief Multiply `count` samples by `f` in place
+   */
+  static void Multiply(float* data, int count, float f);
+
+  /**
+   * @brief Add `count` samples from `src` multiplied by `gain` to `dst` in place
+   */
+  static void MultiplyAdd(float* dst, const float* src, int count, float gain);
+
+  /**
+   * @brief Reverse the order of `count` samples in place
+   */
+  static void Reverse(float* data, int count);
+
+  /**
+   * @brief Pack `count` samples from each of `channels` planes into one interleaved array
+   */
+  static void Interleave(const float* const* planar, int channels, int count, float* packed);
+
+  /**
+   * @brief Split `count` interleaved samples per channel into `channels` planes
+   */
+  static void Deinterleave(const float* packed, int channels, int count, float* const* planar);
+
+  /**
+   * @brief Widen `min` and `max` (arrays of `channels` values) to cover `count` interleaved samples
+   *
+   * `count` is the total number of samples across all channels. Planar data can be passed one
+   * channel at a time with `channels` set to 1.
+   */
+  static void ExpandMinMax(const float* data, int count, int channels, float* min, float* max);
+
+  /**
+   * @brief Returns the sum of `a[i] * b[i]` over `count` samples
+   */
+  static float DotProduct(const float* a, const float* b, int count);
+
+private:
+  static bool HasAVX();
+
+};
+
+}
+
+#endif // SAMPLEKERNELS_H
@@ -0,0 +1,162 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "bufferpool.h"
+
+#include <QCoreApplication>
+
+#include "common/memorygovernor.h"
+
+namespace olive {
+
+namespace {
+
+/**
+ * @brief Reports arenas that are allocated but lending nothing, and frees them when over budget
+ */
+class BufferPoolConsumer : public MemoryGovernor::Consumer
+{
+public:
+  BufferPoolConsumer() :
+    Consumer(QCoreApplication::translate("BufferPool", "Idle Buffers"), MemoryGovernor::kPriorityIdle)
+  {
+    MemoryGovernor::Register(this);
+  }
+
+  virtual ~BufferPoolConsumer() override
+  {
+    MemoryGovernor::Unregister(this);
+  }
+
+  virtual qint64 GetMemoryUsage() const override
+  {
+    BufferPool::Statistics s = BufferPool::GetStatistics();
+    return s.reserved_bytes - s.lent_bytes;
+  }
+
+  virtual bool ReleaseMemory(qint64 bytes) override
+  {
+    Q_UNUSED(bytes)
+
+    return BufferPool::ReleaseIdleArenas();
+  }
+
+};
+
+}
+
+const size_t BufferPool::kPowerOfTwoLimit = 1048576;
+const size_t BufferPool::kLargeGranularity = 1048576;
+const size_t BufferPool::kMinimumSize = 4096;
+const size_t BufferPool::kTargetArenaSize = 16777216;
+const int BufferPool::kMaximumElementsPerArena = 32;
+
+QMutex BufferPool::lock_;
+QMap<size_t, BufferPool::SizeClass*> BufferPool::classes_;
+
+BufferPool::BufferPtr BufferPool::Get(size_t size)
+{
+  // Registered the first time anything is pooled
+  static BufferPoolConsumer consumer;
+  Q_UNUSED(consumer)
+
+  size_t class_size = GetSizeClass(size);
+
+  SizeClass* pool;
+
+  {
+    QMutexLocker locker(&lock_);
+
+    pool = classes_.value(class_size);
+
+    if (!pool) {
+      int element_count = static_cast<int>(qBound(size_t(1),
+                                                   kTargetArenaSize / class_size,
+                                                   size_t(kMaximumElementsPerArena)));
+
+      // Pools are never destroyed since buffers lent from them may be released as late as
+      // application shutdown
+      pool = new SizeClass(class_size, element_count);
+      pool->SetRetainedArenaCount(1);
+      classes_.insert(class_size, pool);
+    }
+  }
+
+  return pool->Get();
+}
+
+BufferPool::Statistics BufferPool::GetStatistics()
+{
+  QMutexLocker locker(&lock_);
+
+  Statistics s = {classes_.size(), 0, 0};
+
+  foreach (SizeClass* pool, classes_) {
+    qint64 sz = static_cast<qint64>(pool->element_size());
+
+    s.lent_bytes += pool->GetUsageCount() * sz;
+    s.reserved_bytes += pool->GetArenaCount() * pool->GetElementCountPerArena() * sz;
+  }
+
+  return s;
+}
+
+bool BufferPool::ReleaseIdleArenas()
+{
+  QMutexLocker locker(&lock_);
+
+  bool released = false;
+
+  foreach (SizeClass* pool, classes_) {
+    released |= pool->ReleaseEmptyArenas();
+  }
+
+  return released;
+}
+
+size_t BufferPool::GetSizeClass(size_t size)
+{
+  if (size <= kMinimumSize) {
+    return kMinimumSize;
+  }
+
+  if (size <= kPowerOfTwoLimit) {
+    size_t class_size = kMinimumSize;
+    while (class_size < size) {
+      class_size <<= 1;
+    }
+    return class_size;
+  }
+
+  return ((size + kLargeGranularity - 1) / kLargeGranularity) * kLargeGranularity;
+}
+
+BufferPool::SizeClass::SizeClass(size_t element_size, int element_count) :
+  MemoryPool<char>(element_count),
+  element_size_(element_size)
+{
+}
+
+size_t BufferPool::SizeClass::GetElementSize()
+{
+  return element_size_;
+}
+
+}
@@ -0,0 +1,124 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <QMap>
+
+#include "common/memorypool.h"
+
+namespace olive {
+
+/**
+ * @brief Shared pool of raw memory buffers for frames and sample buffers on the render path
+ *
+ * Rendering allocates buffers of the same few sizes over and over (one per frame of each resolution and format
+ * in use). Rather than going to the system allocator each time, BufferPool rounds requests up to a size class and
+ * lends them from a MemoryPool for that class, keeping one empty arena per class around so steady-state playback
+ * doesn't allocate at all.
+ *
+ * Buffers are uninitialized. Callers that don't immediately overwrite the whole buffer must clear it themselves.
+ *
+ * This class is thread safe.
+ */
+class BufferPool
+{
+public:
+  using BufferPtr = MemoryPool<char>::ElementPtr;
+
+  struct Statistics {
+    int size_classes;
+    qint64 lent_bytes;
+    qint64 reserved_bytes;
+  };
+
+  /**
+   * @brief Retrieve a buffer of at least `size` bytes
+   *
+   * Returns nullptr if the allocation failed.
+   */
+  static BufferPtr Get(size_t size);
+
+  /**
+   * @brief Returns current usage of all size classes, for debugging and profiling
+   */
+  static Statistics GetStatistics();
+
+  /**
+   * @brief Free every arena that isn't lending anything, returns TRUE if any were freed
+   */
+  static bool ReleaseIdleArenas();
+
+  /**
+   * @brief Returns the size class a request of `size` bytes will be served from
+   */
+  static size_t GetSizeClass(size_t size);
+
+private:
+  class SizeClass : public MemoryPool<char>
+  {
+  public:
+    SizeClass(size_t element_size, int element_count);
+
+    size_t element_size() const
+    {
+      return element_size_;
+    }
+
+  protected:
+    virtual size_t GetElementSize() override;
+
+  private:
+    size_t element_size_;
+
+  };
+
+  /**
+   * @brief Below this size, classes are powers of two
+   */
+  static const size_t kPowerOfTwoLimit;
+
+  /**
+   * @brief Above kPowerOfTwoLimit, classes are multiples of this size
+   */
+  static const size_t kLargeGranularity;
+
+  /**
+   * @brief Smallest size class, requests below this are rounded up to it
+   */
+  static const size_t kMinimumSize;
+
+  /**
+   * @brief Approximate size each arena should be, used to determine how many elements each one holds
+   */
+  static const size_t kTargetArenaSize;
+
+  static const int kMaximumElementsPerArena;
+
+  static QMutex lock_;
+
+  static QMap<size_t, SizeClass*> classes_;
+
+};
+
+}
+
+#endif // BUFFERPOOL_H
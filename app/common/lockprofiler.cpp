@@ -0,0 +1,135 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "lockprofiler.h"
+
+#include <algorithm>
+#include <QDebug>
+
+namespace olive {
+
+QAtomicInt LockProfiler::enabled_(0);
+QAtomicInteger<qint64> LockProfiler::acquisitions_[kLockCount];
+QAtomicInteger<qint64> LockProfiler::contentions_[kLockCount];
+QAtomicInteger<qint64> LockProfiler::wait_ns_[kLockCount];
+QAtomicInteger<qint64> LockProfiler::hold_ns_[kLockCount];
+QAtomicInteger<qint64> LockProfiler::max_wait_ns_[kLockCount];
+
+const char *LockProfiler::GetName(Lock lock)
+{
+  switch (lock) {
+  case kDecoderCache:
+    return "decoder_cache";
+  case kDecoder:
+    return "decoder";
+  case kStillImageCache:
+    return "still_image_cache";
+  case kColorProcessorCache:
+    return "color_processor_cache";
+  case kMemoryPool:
+    return "memory_pool";
+  case kMemoryPoolArena:
+    return "memory_pool_arena";
+  case kLockCount:
+    break;
+  }
+
+  return "unknown";
+}
+
+void LockProfiler::Record(Lock lock, bool contended, qint64 wait, qint64 hold)
+{
+  acquisitions_[lock].fetchAndAddRelaxed(1);
+  hold_ns_[lock].fetchAndAddRelaxed(hold);
+
+  if (contended) {
+    contentions_[lock].fetchAndAddRelaxed(1);
+    wait_ns_[lock].fetchAndAddRelaxed(wait);
+
+    qint64 max = max_wait_ns_[lock].loadAcquire();
+    while (wait > max && !max_wait_ns_[lock].testAndSetOrdered(max, wait, max)) {
+      // `max` was updated by testAndSetOrdered(), try again
+    }
+  }
+}
+
+LockProfiler::Stats LockProfiler::GetStats(Lock lock)
+{
+  return {acquisitions_[lock].loadAcquire(),
+          contentions_[lock].loadAcquire(),
+          wait_ns_[lock].loadAcquire(),
+          hold_ns_[lock].loadAcquire(),
+          max_wait_ns_[lock].loadAcquire()};
+}
+
+void LockProfiler::RecordTrace()
+{
+  if (!IsEnabled() || !Tracer::IsEnabled()) {
+    return;
+  }
+
+  // Counter names must outlive the tracer
+  static const char* const kCounterNames[kLockCount] = {
+    "Lock Wait: decoder_cache",
+    "Lock Wait: decoder",
+    "Lock Wait: still_image_cache",
+    "Lock Wait: color_processor_cache",
+    "Lock Wait: memory_pool",
+    "Lock Wait: memory_pool_arena"
+  };
+
+  qint64 now = Tracer::Now();
+
+  for (int i=0; i<kLockCount; i++) {
+    Tracer::RecordCounter(kCounterNames[i], now, wait_ns_[i].loadAcquire());
+  }
+}
+
+void LockProfiler::LogSummary()
+{
+  QVector<Lock> locks;
+
+  for (int i=0; i<kLockCount; i++) {
+    if (acquisitions_[i].loadAcquire() > 0) {
+      locks.append(static_cast<Lock>(i));
+    }
+  }
+
+  std::sort(locks.begin(), locks.end(), [](Lock a, Lock b){
+    return wait_ns_[a].loadAcquire() > wait_ns_[b].loadAcquire();
+  });
+
+  qInfo() << "Lock profile (lock, acquisitions, contended, total wait ms, max wait ms, total hold ms):";
+
+  foreach (Lock l, locks) {
+    Stats s = GetStats(l);
+
+    qInfo().noquote() << QStringLiteral("  %1: %2, %3 (%4%), %5, %6, %7").arg(
+                           QString::fromLatin1(GetName(l)),
+                           QString::number(s.acquisitions),
+                           QString::number(s.contentions),
+                           QString::number(100.0 * s.contentions / s.acquisitions, 'f', 1),
+                           QString::number(s.wait_ns * 0.000001, 'f', 2),
+                           QString::number(s.max_wait_ns * 0.000001, 'f', 2),
+                           QString::number(s.hold_ns * 0.000001, 'f', 2));
+  }
+}
+
+}
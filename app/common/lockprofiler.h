@@ -0,0 +1,214 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef LOCKPROFILER_H
+#define LOCKPROFILER_H
+
+#include <QAtomicInteger>
+#include <QMutex>
+
+#include "common/define.h"
+#include "common/tracer.h"
+
+namespace olive {
+
+/**
+ * @brief Wait time, hold time and contention counts of the mutexes on the render path
+ *
+ * Render threads share a handful of locks (the decoder cache, each decoder, the still image cache
+ * shards, the color processor cache and the memory pools) and any of them can be what stops
+ * rendering from scaling with more threads. Locking through ProfiledMutexLocker rather than
+ * QMutexLocker counts every acquisition against the lock's entry here, so the totals show which
+ * one threads are queueing on.
+ *
+ * Profiling is opt-in (see --profile-locks). When disabled, ProfiledMutexLocker costs one atomic
+ * load more than QMutexLocker. When enabled and the Tracer is too, every contended wait is recorded
+ * as a span named after the lock.
+ *
+ * This class is thread safe.
+ */
+class LockProfiler
+{
+public:
+  enum Lock {
+    /// DecoderCache's map of open decoder pools
+    kDecoderCache,
+
+    /// A single Decoder, held for the whole of a retrieval
+    kDecoder,
+
+    /// A shard of a StillImageCache
+    kStillImageCache,
+
+    /// ColorProcessorCache's map of built processors
+    kColorProcessorCache,
+
+    /// A MemoryPool's list of arenas
+    kMemoryPool,
+
+    /// A single arena of a MemoryPool
+    kMemoryPoolArena,
+
+    kLockCount
+  };
+
+  static void SetEnabled(bool e)
+  {
+    enabled_.store(e ? 1 : 0);
+  }
+
+  static bool IsEnabled()
+  {
+    return enabled_.load();
+  }
+
+  /**
+   * @brief Returns the lock's name, e.g. "decoder_cache"
+   */
+  static const char* GetName(Lock lock);
+
+  /**
+   * @brief Count an acquisition of `lock`, called by ProfiledMutexLocker
+   *
+   * `wait` and `hold` are in nanoseconds. `contended` is TRUE if another thread held the lock.
+   */
+  static void Record(Lock lock, bool contended, qint64 wait, qint64 hold);
+
+  struct Stats {
+    qint64 acquisitions;
+    qint64 contentions;
+    qint64 wait_ns;
+    qint64 hold_ns;
+    qint64 max_wait_ns;
+  };
+
+  static Stats GetStats(Lock lock);
+
+  /**
+   * @brief Record each lock's total wait time as a Tracer counter if tracing is enabled
+   */
+  static void RecordTrace();
+
+  /**
+   * @brief Log a table of every lock that was acquired, most waited on first
+   */
+  static void LogSummary();
+
+private:
+  static QAtomicInt enabled_;
+
+  static QAtomicInteger<qint64> acquisitions_[kLockCount];
+  static QAtomicInteger<qint64> contentions_[kLockCount];
+  static QAtomicInteger<qint64> wait_ns_[kLockCount];
+  static QAtomicInteger<qint64> hold_ns_[kLockCount];
+  static QAtomicInteger<qint64> max_wait_ns_[kLockCount];
+
+};
+
+/**
+ * @brief A QMutexLocker that reports to the LockProfiler
+ *
+ * Works on a plain QMutex, so the mutex can still be used with QWaitCondition or locked directly
+ * elsewhere, those uses just aren't counted.
+ */
+class ProfiledMutexLocker
+{
+public:
+  ProfiledMutexLocker(QMutex* mutex, LockProfiler::Lock lock) :
+    mutex_(mutex),
+    lock_(lock),
+    locked_(false),
+    acquired_(-1),
+    contended_(false),
+    wait_(0)
+  {
+    relock();
+  }
+
+  ~ProfiledMutexLocker()
+  {
+    unlock();
+  }
+
+  DISABLE_COPY_MOVE(ProfiledMutexLocker)
+
+  void unlock()
+  {
+    if (!locked_) {
+      return;
+    }
+
+    qint64 hold = (acquired_ >= 0) ? Tracer::Now() - acquired_ : 0;
+
+    mutex_->unlock();
+    locked_ = false;
+
+    if (acquired_ >= 0) {
+      LockProfiler::Record(lock_, contended_, wait_, hold);
+    }
+  }
+
+  void relock()
+  {
+    if (locked_) {
+      return;
+    }
+
+    if (!LockProfiler::IsEnabled()) {
+      mutex_->lock();
+      acquired_ = -1;
+    } else if (mutex_->tryLock()) {
+      acquired_ = Tracer::Now();
+      contended_ = false;
+      wait_ = 0;
+    } else {
+      qint64 start = Tracer::Now();
+      mutex_->lock();
+      acquired_ = Tracer::Now();
+      contended_ = true;
+      wait_ = acquired_ - start;
+
+      if (Tracer::IsEnabled()) {
+        Tracer::Record("Lock Wait", start, acquired_, QString::fromLatin1(LockProfiler::GetName(lock_)));
+      }
+    }
+
+    locked_ = true;
+  }
+
+private:
+  QMutex* mutex_;
+
+  LockProfiler::Lock lock_;
+
+  bool locked_;
+
+  /// When the lock was acquired on the Tracer's clock, -1 if profiling was disabled
+  qint64 acquired_;
+
+  bool contended_;
+
+  qint64 wait_;
+
+};
+
+}
+
+#endif // LOCKPROFILER_H
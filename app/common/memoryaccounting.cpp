@@ -0,0 +1,105 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "memoryaccounting.h"
+
+#include <QCoreApplication>
+#include <QMutex>
+
+#include "common/tracer.h"
+
+namespace olive {
+
+QAtomicInteger<qint64> MemoryAccounting::totals_[MemoryAccounting::kCategoryCount];
+
+// Untranslated so they can be used as Tracer counter names, which must be literals
+const char* const MemoryAccounting::kNames[MemoryAccounting::kCategoryCount] = {
+  QT_TRANSLATE_NOOP("MemoryAccounting", "Decoded Frames"),
+  QT_TRANSLATE_NOOP("MemoryAccounting", "Sample Buffers"),
+  QT_TRANSLATE_NOOP("MemoryAccounting", "Waveforms"),
+  QT_TRANSLATE_NOOP("MemoryAccounting", "Frame Hashes"),
+  QT_TRANSLATE_NOOP("MemoryAccounting", "Undo History"),
+  QT_TRANSLATE_NOOP("MemoryAccounting", "Interface Images"),
+  QT_TRANSLATE_NOOP("MemoryAccounting", "Footage Textures"),
+  QT_TRANSLATE_NOOP("MemoryAccounting", "Intermediate Textures"),
+  QT_TRANSLATE_NOOP("MemoryAccounting", "Display Textures"),
+  QT_TRANSLATE_NOOP("MemoryAccounting", "Scope Textures")
+};
+
+thread_local MemoryAccounting::Category MemoryAccounting::TextureOriginScope::current_ = MemoryAccounting::kCategoryCount;
+
+namespace {
+
+QMutex& details_lock()
+{
+  static QMutex lock;
+  return lock;
+}
+
+QMap<QString, qint64>& details(MemoryAccounting::Category category)
+{
+  static QMap<QString, qint64> maps[MemoryAccounting::kCategoryCount];
+  return maps[category];
+}
+
+}
+
+QString MemoryAccounting::GetName(Category category)
+{
+  return QCoreApplication::translate("MemoryAccounting", kNames[category]);
+}
+
+void MemoryAccounting::AddDetail(Category category, const QString &detail, qint64 bytes)
+{
+  Add(category, bytes);
+
+  QMutexLocker locker(&details_lock());
+
+  QMap<QString, qint64>& map = details(category);
+
+  qint64& total = map[detail];
+  total += bytes;
+
+  if (total == 0) {
+    map.remove(detail);
+  }
+}
+
+QMap<QString, qint64> MemoryAccounting::GetDetails(Category category)
+{
+  QMutexLocker locker(&details_lock());
+
+  return details(category);
+}
+
+void MemoryAccounting::RecordTrace()
+{
+  if (!Tracer::IsEnabled()) {
+    return;
+  }
+
+  qint64 now = Tracer::Now();
+
+  for (int i=0; i<kCategoryCount; i++) {
+    Tracer::RecordCounter(kNames[i], now, Get(static_cast<Category>(i)));
+  }
+}
+
+}
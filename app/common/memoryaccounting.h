@@ -0,0 +1,272 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef MEMORYACCOUNTING_H
+#define MEMORYACCOUNTING_H
+
+#include <memory>
+#include <QAtomicInteger>
+#include <QMap>
+#include <QString>
+
+#include "common/define.h"
+
+namespace olive {
+
+/**
+ * @brief Running totals of the memory held by each subsystem, for finding out where it all went
+ *
+ * The memory pools only know how much they've allocated and MemoryGovernor only knows about the
+ * caches that register with it, neither says whether it's decoded frames, audio or the undo
+ * history that's filling up memory, and GPU memory isn't counted anywhere. Subsystems add and
+ * subtract the bytes they hold here as they allocate and free so the totals can be shown in the
+ * viewer's performance overlay and recorded as counters in a trace (see RecordTrace()).
+ *
+ * Totals are plain atomics so accounting costs one atomic add per allocation. They're estimates of
+ * what the subsystem asked for, not what the allocator or driver actually reserved.
+ *
+ * This class is thread safe.
+ */
+class MemoryAccounting
+{
+public:
+  enum Category {
+    /// Frames decoded by FFmpeg, in decoder caches and in flight
+    kDecodedFrames,
+
+    /// Audio held in SampleBuffers
+    kSampleBuffers,
+
+    /// Sums kept by AudioVisualWaveform for drawing audio
+    kWaveforms,
+
+    /// Time to hash maps of every FrameHashCache
+    kFrameHashes,
+
+    /// Commands kept by UndoStack
+    kUndoHistory,
+
+    /// Pages of ImageAtlas, i.e. images cached for drawing the interface
+    kInterfaceImages,
+
+    /// Textures footage was uploaded and color managed into
+    kTextureFootage,
+
+    /// Textures created while rendering nodes
+    kTextureIntermediate,
+
+    /// Textures created by viewers and other display widgets
+    kTextureDisplay,
+
+    /// Textures created by scopes
+    kTextureScope,
+
+    kCategoryCount
+  };
+
+  static void Add(Category category, qint64 bytes)
+  {
+    totals_[category].fetchAndAddRelaxed(bytes);
+  }
+
+  static qint64 Get(Category category)
+  {
+    return totals_[category].loadAcquire();
+  }
+
+  /**
+   * @brief Returns the translated name of a category for showing in the UI
+   */
+  static QString GetName(Category category);
+
+  /**
+   * @brief Returns the untranslated name of a category, for machine readable output
+   */
+  static const char* GetID(Category category)
+  {
+    return kNames[category];
+  }
+
+  /**
+   * @brief Returns TRUE if this category is counting GPU memory rather than system memory
+   */
+  static bool IsVideoMemory(Category category)
+  {
+    return category >= kTextureFootage;
+  }
+
+  /**
+   * @brief Add bytes to a category and also to a named detail within it, e.g. a single stream
+   *
+   * Details are kept in a locked map, so this is more expensive than Add() and meant for
+   * allocations that are large and infrequent enough for it not to matter. Details are dropped
+   * once they return to zero.
+   */
+  static void AddDetail(Category category, const QString& detail, qint64 bytes);
+
+  /**
+   * @brief Returns every detail of a category that's currently holding memory
+   */
+  static QMap<QString, qint64> GetDetails(Category category);
+
+  /**
+   * @brief Returns a pointer to the same object that counts `bytes` until the last copy of it is released
+   *
+   * For buffers that are lent out and shared, where there's no owner to subtract them when they're
+   * freed. If `detail` isn't empty, the bytes are also counted with AddDetail().
+   */
+  template <typename T>
+  static std::shared_ptr<T> Track(std::shared_ptr<T> ptr, Category category, qint64 bytes,
+                                  const QString& detail = QString())
+  {
+    if (!ptr) {
+      return ptr;
+    }
+
+    if (detail.isEmpty()) {
+      Add(category, bytes);
+    } else {
+      AddDetail(category, detail, bytes);
+    }
+
+    T* raw = ptr.get();
+
+    return std::shared_ptr<T>(raw, [ptr, category, bytes, detail](T*) mutable {
+      if (detail.isEmpty()) {
+        Add(category, -bytes);
+      } else {
+        AddDetail(category, detail, -bytes);
+      }
+
+      ptr.reset();
+    });
+  }
+
+  /**
+   * @brief Record the current total of every category as a Tracer counter if tracing is enabled
+   */
+  static void RecordTrace();
+
+  /**
+   * @brief Counts the bytes held by the object it's a member of and subtracts them when destroyed
+   *
+   * Copies count the same bytes again, which matches what's held for anything that deep copies
+   * and overestimates implicitly shared containers until they detach.
+   */
+  class Counter
+  {
+  public:
+    Counter(Category category, qint64 bytes = 0) :
+      category_(category),
+      bytes_(0)
+    {
+      Set(bytes);
+    }
+
+    Counter(const Counter& other) :
+      category_(other.category_),
+      bytes_(0)
+    {
+      Set(other.bytes_);
+    }
+
+    Counter& operator=(const Counter& other)
+    {
+      if (this != &other) {
+        Set(0);
+        category_ = other.category_;
+        Set(other.bytes_);
+      }
+
+      return *this;
+    }
+
+    ~Counter()
+    {
+      Set(0);
+    }
+
+    void Set(qint64 bytes)
+    {
+      if (bytes != bytes_) {
+        MemoryAccounting::Add(category_, bytes - bytes_);
+        bytes_ = bytes;
+      }
+    }
+
+    qint64 bytes() const
+    {
+      return bytes_;
+    }
+
+  private:
+    Category category_;
+
+    qint64 bytes_;
+
+  };
+
+  /**
+   * @brief Counts textures created on this thread as `category` for as long as it exists
+   *
+   * Used where a renderer creates textures for something other than what it normally does, e.g.
+   * render workers uploading footage. Scopes nest, the innermost one applies.
+   */
+  class TextureOriginScope
+  {
+  public:
+    TextureOriginScope(Category category) :
+      previous_(current_)
+    {
+      current_ = category;
+    }
+
+    ~TextureOriginScope()
+    {
+      current_ = previous_;
+    }
+
+    DISABLE_COPY_MOVE(TextureOriginScope)
+
+    /**
+     * @brief Returns the category of the innermost scope on this thread, or `fallback` if there isn't one
+     */
+    static Category Current(Category fallback)
+    {
+      return (current_ == kCategoryCount) ? fallback : current_;
+    }
+
+  private:
+    Category previous_;
+
+    static thread_local Category current_;
+
+  };
+
+private:
+  static QAtomicInteger<qint64> totals_[kCategoryCount];
+
+  static const char* const kNames[kCategoryCount];
+
+};
+
+}
+
+#endif // MEMORYACCOUNTING_H
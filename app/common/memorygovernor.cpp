@@ -0,0 +1,155 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "memorygovernor.h"
+
+#include <QDebug>
+
+#include "common/memorypool.h"
+#include "config/config.h"
+
+namespace olive {
+
+QMutex MemoryGovernor::reclaim_lock_;
+QAtomicInteger<qint64> MemoryGovernor::budget_(-1);
+
+MemoryGovernor::Consumer::Consumer(const QString &name, Priority priority) :
+  name_(name),
+  priority_(priority)
+{
+}
+
+void MemoryGovernor::Register(Consumer *consumer)
+{
+  QMutexLocker locker(&registry_lock());
+
+  // Kept sorted by priority so Reclaim() can walk it in order
+  QVector<Consumer*>& list = consumers();
+
+  int index = 0;
+  while (index < list.size() && list.at(index)->memory_priority() <= consumer->memory_priority()) {
+    index++;
+  }
+
+  list.insert(index, consumer);
+}
+
+void MemoryGovernor::Unregister(Consumer *consumer)
+{
+  // Wait for any reclaim to finish since it may be using this consumer
+  QMutexLocker reclaim_locker(&reclaim_lock_);
+
+  QMutexLocker locker(&registry_lock());
+
+  consumers().removeOne(consumer);
+}
+
+qint64 MemoryGovernor::GetBudget()
+{
+  qint64 budget = budget_.loadAcquire();
+
+  if (budget < 0) {
+    budget = qMax(Q_INT64_C(0), Config::Current()[QStringLiteral("MemoryBudget")].toLongLong() * 1048576);
+    budget_.storeRelease(budget);
+  }
+
+  return budget;
+}
+
+qint64 MemoryGovernor::GetUsage()
+{
+  return memory_pool_consumption.loadAcquire();
+}
+
+bool MemoryGovernor::IsOverBudget()
+{
+  qint64 budget = GetBudget();
+
+  return budget > 0 && GetUsage() >= budget;
+}
+
+void MemoryGovernor::Reclaim()
+{
+  if (!reclaim_lock_.tryLock()) {
+    // Someone's already on it
+    return;
+  }
+
+  // Pick up any change to the budget made in preferences
+  budget_.storeRelease(-1);
+
+  // Consumers can't unregister while we hold the reclaim lock, so the registry lock isn't held
+  // while asking them for memory. That way consumers can register new ones while holding their
+  // own locks without risking a deadlock with us.
+  QVector<Consumer*> list;
+
+  {
+    QMutexLocker locker(&registry_lock());
+    list = consumers();
+  }
+
+  foreach (Consumer* c, list) {
+    if (c->memory_priority() == kPriorityWorking) {
+      break;
+    }
+
+    // Keep asking the same consumer while it's still giving memory back
+    while (IsOverBudget() && c->ReleaseMemory(GetUsage() - GetBudget())) {}
+
+    if (!IsOverBudget()) {
+      break;
+    }
+  }
+
+  if (IsOverBudget()) {
+    qDebug() << "Memory usage of" << GetUsage() / 1048576 << "MB is over the budget of"
+               << GetBudget() / 1048576 << "MB with nothing left to reclaim";
+  }
+
+  reclaim_lock_.unlock();
+}
+
+QVector<MemoryGovernor::Report> MemoryGovernor::GetReport()
+{
+  QMutexLocker locker(&registry_lock());
+
+  QVector<Report> report;
+
+  foreach (Consumer* c, consumers()) {
+    report.append({c->memory_consumer_name(), c->memory_priority(), c->GetMemoryUsage()});
+  }
+
+  return report;
+}
+
+QMutex &MemoryGovernor::registry_lock()
+{
+  // Function statics so consumers that are themselves statics can register safely
+  static QMutex lock;
+  return lock;
+}
+
+QVector<MemoryGovernor::Consumer *> &MemoryGovernor::consumers()
+{
+  static QVector<Consumer*> list;
+  return list;
+}
+
+}
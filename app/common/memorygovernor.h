@@ -0,0 +1,152 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef MEMORYGOVERNOR_H
+#define MEMORYGOVERNOR_H
+
+#include <QAtomicInteger>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+namespace olive {
+
+/**
+ * @brief One memory budget shared by every pool and cache that holds onto frames or buffers
+ *
+ * Each cache used to have its own limit and none of them knew about the others, so together they
+ * could easily add up to more than the machine has. Caches and pools now register themselves as a
+ * Consumer here and report how much they're holding. The budget, set in megabytes by the
+ * "MemoryBudget" config entry, is checked against the memory pools' actual allocations since
+ * nearly everything we hold is a buffer lent from them.
+ *
+ * When the budget is exceeded, Reclaim() asks consumers to give memory back in order of Priority,
+ * so memory that's holding nothing goes first and caches that are expensive to rebuild go last.
+ *
+ * This class is thread safe.
+ */
+class MemoryGovernor
+{
+public:
+  enum Priority {
+    /// Memory that's allocated but not being used for anything (e.g. empty pool arenas)
+    kPriorityIdle,
+
+    /// Caches that only save re-reading or re-decoding something
+    kPriorityCache,
+
+    /// Caches of converted textures, which take a full render to recreate
+    kPriorityTexture,
+
+    /// Memory needed to make progress, only reported and never reclaimed
+    kPriorityWorking
+  };
+
+  class Consumer
+  {
+  public:
+    Consumer(const QString& name, Priority priority);
+
+    virtual ~Consumer() = default;
+
+    const QString& memory_consumer_name() const
+    {
+      return name_;
+    }
+
+    Priority memory_priority() const
+    {
+      return priority_;
+    }
+
+    /**
+     * @brief Returns the bytes this consumer is currently holding
+     */
+    virtual qint64 GetMemoryUsage() const = 0;
+
+    /**
+     * @brief Give back up to `bytes`, returns TRUE if anything was released
+     *
+     * Called from whichever thread is reclaiming, never while the governor holds a consumer's own
+     * lock. Implementations must not call Reclaim().
+     */
+    virtual bool ReleaseMemory(qint64 bytes) = 0;
+
+  private:
+    QString name_;
+
+    Priority priority_;
+
+  };
+
+  struct Report {
+    QString name;
+    Priority priority;
+    qint64 usage;
+  };
+
+  /**
+   * @brief Start asking `consumer` for memory when over budget
+   *
+   * Consumers must unregister in their destructor before anything ReleaseMemory() uses is
+   * destroyed. Unregistering waits for a Reclaim() in progress to finish.
+   */
+  static void Register(Consumer* consumer);
+  static void Unregister(Consumer* consumer);
+
+  /**
+   * @brief Returns the budget in bytes, 0 means unlimited
+   */
+  static qint64 GetBudget();
+
+  /**
+   * @brief Returns the bytes currently allocated by memory pools
+   */
+  static qint64 GetUsage();
+
+  static bool IsOverBudget();
+
+  /**
+   * @brief Release memory from consumers, lowest priority first, until usage is under budget
+   *
+   * Must not be called while holding the lock of anything that's registered. If another thread
+   * is already reclaiming, this returns immediately.
+   */
+  static void Reclaim();
+
+  /**
+   * @brief Returns what every consumer is currently holding, for showing in the UI
+   */
+  static QVector<Report> GetReport();
+
+private:
+  static QMutex& registry_lock();
+
+  static QVector<Consumer*>& consumers();
+
+  static QMutex reclaim_lock_;
+
+  static QAtomicInteger<qint64> budget_;
+
+};
+
+}
+
+#endif // MEMORYGOVERNOR_H
@@ -1,14 +1,14 @@
 #include "memorypool.h"
 
+#include "common/memorygovernor.h"
+
 namespace olive {
 
-size_t memory_pool_consumption = 0;
-QMutex memory_pool_consumption_lock;
+QAtomicInteger<qint64> memory_pool_consumption(0);
 
 bool MemoryPoolLimitReached()
 {
-  QMutexLocker locker(&memory_pool_consumption_lock);
-  return (memory_pool_consumption >= 2147483648);
+  return MemoryGovernor::IsOverBudget();
 }
 
 }
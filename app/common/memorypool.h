@@ -22,18 +22,19 @@
 #define MEMORYPOOL_H
 
 #include <memory>
-#include <QDateTime>
+#include <QAtomicInteger>
 #include <QDebug>
-#include <QLinkedList>
+#include <QElapsedTimer>
 #include <QMutex>
+#include <QVector>
 #include <stdint.h>
 
 #include "common/define.h"
+#include "common/lockprofiler.h"
 
 namespace olive {
 
-extern size_t memory_pool_consumption;
-extern QMutex memory_pool_consumption_lock;
+extern QAtomicInteger<qint64> memory_pool_consumption;
 bool MemoryPoolLimitReached();
 
 template <typename T>
@@ -49,6 +50,9 @@ template <typename T>
  *
  * `Get()` will return an ElementPtr. The original desired data can be accessed through ElementPtr::data(). This data
  * will belong to the caller until ElementPtr goes out of scope and the memory is freed back into the pool.
+ *
+ * Each arena keeps a stack of free slot indices so that retrieving and releasing an element are both constant time
+ * regardless of how many elements the arena holds.
  */
 class MemoryPool
 {
@@ -61,6 +65,7 @@ public:
    */
   MemoryPool(int element_count) {
     element_count_ = element_count;
+    retained_arena_count_ = 0;
     ignore_arena_empty_signal_ = false;
   }
 
@@ -103,6 +108,59 @@ public:
     return arenas_.size();
   }
 
+  /**
+   * @brief Returns the number of elements each arena holds
+   */
+  inline int GetElementCountPerArena() const {
+    return element_count_;
+  }
+
+  /**
+   * @brief Returns the number of elements currently lent out across all arenas
+   */
+  int GetUsageCount() {
+    QMutexLocker locker(&lock_);
+
+    int count = 0;
+    foreach (Arena* a, arenas_) {
+      count += a->GetUsageCount();
+    }
+    return count;
+  }
+
+  /**
+   * @brief Free any empty arenas kept by SetRetainedArenaCount(), returns TRUE if any were freed
+   */
+  bool ReleaseEmptyArenas() {
+    QMutexLocker locker(&lock_);
+
+    bool released = false;
+
+    for (auto it=arenas_.begin(); it!=arenas_.end(); ) {
+      if ((*it)->GetUsageCount()) {
+        it++;
+      } else {
+        delete *it;
+        it = arenas_.erase(it);
+        released = true;
+      }
+    }
+
+    return released;
+  }
+
+  /**
+   * @brief Set how many empty arenas to keep allocated rather than freeing them
+   *
+   * By default an arena is freed as soon as its last element is released. Pools that lend few large elements at a
+   * time can keep some around to avoid reallocating them every time usage drops to zero. Empty arenas are always
+   * freed if the global memory limit has been reached.
+   */
+  void SetRetainedArenaCount(int count) {
+    QMutexLocker locker(&lock_);
+    retained_arena_count_ = count;
+  }
+
   class Arena;
 
   /**
@@ -119,10 +177,11 @@ public:
      *
      * There is no need to use this outside of the memory pool's internal functions.
      */
-    Element(Arena* parent, T* data) {
+    Element(Arena* parent, T* data, int index) {
       parent_ = parent;
       data_ = data;
-      accessed_ = QDateTime::currentMSecsSinceEpoch();
+      index_ = index;
+      accessed_ = QElapsedTimer::msecsSinceReference();
     }
 
     /**
@@ -157,13 +216,14 @@ public:
      * \see last_accessed()
      */
     inline void access() {
-      accessed_ = QDateTime::currentMSecsSinceEpoch();
+      accessed_ = QElapsedTimer::msecsSinceReference();
     }
 
     /**
      * @brief Returns the last time `access()` was called on this function
      *
-     * Useful for determining the relative age of an element (i.e. if it hasn't been accessed for a certain amount of
+     * This is a monotonic clock in milliseconds rather than wall time, so it's only meaningful relative to other
+     * elements' access times. Useful for determining the relative age of an element (i.e. if it hasn't been accessed for a certain amount of
      * time, it can probably be freed back into the pool). This requires all usages to call `access()`.
      */
     inline const int64_t& last_accessed() const {
@@ -177,11 +237,20 @@ public:
       }
     }
 
+    /**
+     * @brief Index of this element's slot in its arena
+     */
+    inline int index() const {
+      return index_;
+    }
+
   private:
     Arena* parent_;
 
     T* data_;
 
+    int index_;
+
     int64_t timestamp_;
 
     int64_t accessed_;
@@ -203,19 +272,20 @@ public:
       parent_ = parent;
       data_ = nullptr;
       allocated_sz_ = 0;
+      lent_count_ = 0;
     }
 
     ~Arena() {
-      std::list<Element*> copy = lent_elements_;
+      QVector<Element*> copy = lent_elements_;
       foreach (Element* e, copy) {
-        e->release();
+        if (e) {
+          e->release();
+        }
       }
 
       delete [] data_;
 
-      memory_pool_consumption_lock.lock();
-      memory_pool_consumption -= allocated_sz_;
-      memory_pool_consumption_lock.unlock();
+      memory_pool_consumption.fetchAndAddOrdered(-static_cast<qint64>(allocated_sz_));
     }
 
     DISABLE_COPY_MOVE(Arena)
@@ -224,38 +294,41 @@ public:
      * @brief Returns an element if there is free memory to do so
      */
     ElementPtr Get() {
-      QMutexLocker locker(&lock_);
+      ProfiledMutexLocker locker(&lock_, LockProfiler::kMemoryPoolArena);
 
-      for (int i=0;i<available_.size();i++) {
-        if (available_.at(i)) {
-          // This buffer is available
-          available_.replace(i, false);
+      if (free_indices_.isEmpty()) {
+        return nullptr;
+      }
 
-          ElementPtr e = std::make_shared<Element>(this,
-                                                   reinterpret_cast<T*>(data_ + i * element_sz_));
-          lent_elements_.push_back(e.get());
+      int i = free_indices_.last();
+      free_indices_.removeLast();
+      free_count_hint_.storeRelease(free_indices_.size());
 
-          return e;
-        }
-      }
+      ElementPtr e = std::make_shared<Element>(this,
+                                               reinterpret_cast<T*>(data_ + i * element_sz_),
+                                               i);
+      lent_elements_[i] = e.get();
+      lent_count_++;
 
-      return nullptr;
+      return e;
     }
 
     /**
      * @brief Releases an element back into the pool for use elsewhere
      */
     void Release(Element* e) {
-      QMutexLocker locker(&lock_);
-      quintptr diff = reinterpret_cast<quintptr>(e->data()) - reinterpret_cast<quintptr>(data_);
+      ProfiledMutexLocker locker(&lock_, LockProfiler::kMemoryPoolArena);
 
-      int index = diff / element_sz_;
+      int index = e->index();
 
-      available_.replace(index, true);
+      // Most recently released slots are handed out first since they're the likeliest to still be in cache
+      free_indices_.append(index);
+      free_count_hint_.storeRelease(free_indices_.size());
 
-      lent_elements_.remove(e);
+      lent_elements_[index] = nullptr;
+      lent_count_--;
 
-      if (lent_elements_.empty()) {
+      if (!lent_count_) {
         locker.unlock();
         parent_->ArenaIsEmpty(this);
       }
@@ -263,7 +336,16 @@ public:
 
     int GetUsageCount() {
       QMutexLocker locker(&lock_);
-      return lent_elements_.size();
+      return lent_count_;
+    }
+
+    /**
+     * @brief Returns TRUE if this arena has no free elements left
+     *
+     * This is only a hint taken without locking, Get() may still return nullptr.
+     */
+    inline bool IsFull() const {
+      return !free_count_hint_.loadAcquire();
     }
 
     bool Allocate(size_t ele_sz, size_t nb_elements) {
@@ -276,23 +358,30 @@ public:
       allocated_sz_ = element_sz_ * nb_elements;
 
       if ((data_ = new char[allocated_sz_])) {
-        available_.resize(nb_elements);
-        available_.fill(true);
+        int count = static_cast<int>(nb_elements);
+
+        // Fill in reverse so that Get() hands out slots from the start of the arena first
+        free_indices_.resize(count);
+        for (int i=0; i<count; i++) {
+          free_indices_[i] = count - 1 - i;
+        }
+        free_count_hint_.storeRelease(count);
+
+        lent_elements_.fill(nullptr, count);
+        lent_count_ = 0;
 
-        memory_pool_consumption_lock.lock();
-        memory_pool_consumption += allocated_sz_;
-        memory_pool_consumption_lock.unlock();
+        memory_pool_consumption.fetchAndAddOrdered(static_cast<qint64>(allocated_sz_));
 
         return true;
       } else {
-        available_.clear();
+        free_indices_.clear();
 
         return false;
       }
     }
 
     inline int GetElementCount() const {
-      return available_.size();
+      return lent_elements_.size();
     }
 
     inline bool IsAllocated() const {
@@ -306,13 +395,23 @@ public:
 
     size_t allocated_sz_;
 
-    QVector<bool> available_;
+    /**
+     * @brief Stack of slot indices that aren't currently lent out
+     */
+    QVector<int> free_indices_;
+
+    QAtomicInt free_count_hint_;
 
     QMutex lock_;
 
     size_t element_sz_;
 
-    std::list<Element*> lent_elements_;
+    /**
+     * @brief Element currently occupying each slot, or nullptr if the slot is free
+     */
+    QVector<Element*> lent_elements_;
+
+    int lent_count_;
 
   };
 
@@ -320,10 +419,14 @@ public:
    * @brief Retrieves an element from an available arena
    */
   ElementPtr Get() {
-    QMutexLocker locker(&lock_);
+    ProfiledMutexLocker locker(&lock_, LockProfiler::kMemoryPool);
 
     // Attempt to get an element from an arena
     foreach (Arena* a, arenas_) {
+      if (a->IsFull()) {
+        continue;
+      }
+
       ElementPtr e = a->Get();
 
       if (e) {
@@ -370,6 +473,19 @@ public:
     QMutexLocker locker(&lock_);
 
     if (!a->GetUsageCount()) {
+      if (retained_arena_count_ > 0 && !MemoryPoolLimitReached()) {
+        int empty_arenas = 0;
+        foreach (Arena* other, arenas_) {
+          if (!other->GetUsageCount()) {
+            empty_arenas++;
+          }
+        }
+
+        if (empty_arenas <= retained_arena_count_) {
+          return;
+        }
+      }
+
       qDebug() << "Removing an empty arena";
       arenas_.remove(a);
       delete a;
@@ -393,6 +509,8 @@ private:
 
   QMutex lock_;
 
+  int retained_arena_count_;
+
   bool ignore_arena_empty_signal_;
 
 };
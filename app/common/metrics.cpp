@@ -0,0 +1,152 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "metrics.h"
+
+#include <QHash>
+#include <QMutex>
+
+#include "common/tracer.h"
+
+namespace olive {
+
+const Metrics::Info Metrics::kInfo[Metrics::kCounterCount] = {
+  {"olive_frames_rendered_total", "Video frames rendered", nullptr, false},
+  {"olive_frames_encoded_total", "Video frames written to an encoder", nullptr, false},
+  {"olive_frames_decoded_total", "Video frames decoded", "codec", false},
+  {"olive_render_seconds_total", "Time spent rendering video frames", nullptr, true},
+  {"olive_gpu_busy_seconds_total", "Time spent rendering video frames not waiting on decodes", nullptr, true},
+  {"olive_texture_cache_hits_total", "Footage texture requests served from cache", nullptr, false},
+  {"olive_texture_cache_misses_total", "Footage texture requests that had to decode", nullptr, false},
+  {"olive_frame_cache_hits_total", "Rendered frame requests served from memory", nullptr, false},
+  {"olive_frame_cache_misses_total", "Rendered frame requests not in memory", nullptr, false}
+};
+
+QAtomicInteger<qint64> Metrics::totals_[Metrics::kCounterCount];
+
+namespace {
+
+QMutex& metrics_lock()
+{
+  static QMutex lock;
+  return lock;
+}
+
+QMap<QString, qint64>& labels(Metrics::Counter counter)
+{
+  static QMap<QString, qint64> maps[Metrics::kCounterCount];
+  return maps[counter];
+}
+
+QHash<const void*, Metrics::Progress>& progress_map()
+{
+  static QHash<const void*, Metrics::Progress> map;
+  return map;
+}
+
+}
+
+void Metrics::AddLabeled(Counter counter, const QString &label, qint64 value)
+{
+  Add(counter, value);
+
+  QMutexLocker locker(&metrics_lock());
+
+  labels(counter)[label] += value;
+}
+
+QMap<QString, qint64> Metrics::GetLabels(Counter counter)
+{
+  QMutexLocker locker(&metrics_lock());
+
+  return labels(counter);
+}
+
+const char *Metrics::GetName(Counter counter)
+{
+  return kInfo[counter].name;
+}
+
+const char *Metrics::GetDescription(Counter counter)
+{
+  return kInfo[counter].description;
+}
+
+const char *Metrics::GetLabelName(Counter counter)
+{
+  return kInfo[counter].label;
+}
+
+bool Metrics::IsTime(Counter counter)
+{
+  return kInfo[counter].time;
+}
+
+void Metrics::SetProgress(const void *key, const QString &name, double progress)
+{
+  static int next_id = 0;
+
+  QMutexLocker locker(&metrics_lock());
+
+  auto it = progress_map().find(key);
+
+  if (it == progress_map().end()) {
+    it = progress_map().insert(key, {next_id++, name, progress});
+  } else {
+    it.value().name = name;
+    it.value().progress = progress;
+  }
+}
+
+void Metrics::RemoveProgress(const void *key)
+{
+  QMutexLocker locker(&metrics_lock());
+
+  progress_map().remove(key);
+}
+
+QVector<Metrics::Progress> Metrics::GetProgress()
+{
+  QMutexLocker locker(&metrics_lock());
+
+  QVector<Progress> list;
+  list.reserve(progress_map().size());
+
+  foreach (const Progress& p, progress_map()) {
+    list.append(p);
+  }
+
+  return list;
+}
+
+void Metrics::RecordTrace()
+{
+  if (!Tracer::IsEnabled()) {
+    return;
+  }
+
+  qint64 now = Tracer::Now();
+
+  for (int i=0; i<kCounterCount; i++) {
+    Tracer::RecordCounter(kInfo[i].name, now, Get(static_cast<Counter>(i)));
+  }
+}
+
+}
@@ -0,0 +1,144 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QAtomicInteger>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+namespace olive {
+
+/**
+ * @brief Running totals of render throughput for monitoring a process from outside
+ *
+ * Unlike the Tracer, which records every span for looking at afterwards, these are monotonic
+ * totals that are always kept so they can be sampled at any time, e.g. by the metrics endpoint
+ * of a headless render node (see CLIMetricsServer) or as counters in a trace (see RecordTrace()).
+ * Rates such as frames per second are left to whoever samples them.
+ *
+ * This class is thread safe.
+ */
+class Metrics
+{
+public:
+  enum Counter {
+    /// Video frames rendered by the render workers
+    kFramesRendered,
+
+    /// Video frames written to an encoder
+    kFramesEncoded,
+
+    /// Video frames decoded, labelled by codec
+    kFramesDecoded,
+
+    /// Nanoseconds spent rendering video frames, including waiting on decodes
+    kRenderTime,
+
+    /// Nanoseconds of kRenderTime that weren't spent waiting on decodes, which is mostly GPU work
+    kGPUTime,
+
+    /// Footage textures requests served from a texture cache
+    kTextureCacheHits,
+    kTextureCacheMisses,
+
+    /// Rendered frame requests served from the FrameMemoryCache
+    kFrameCacheHits,
+    kFrameCacheMisses,
+
+    kCounterCount
+  };
+
+  static void Add(Counter counter, qint64 value = 1)
+  {
+    totals_[counter].fetchAndAddRelaxed(value);
+  }
+
+  /**
+   * @brief Add to a counter and to one of its labels, e.g. the codec of a decoded frame
+   *
+   * Labels are kept in a locked map so this is more expensive than Add().
+   */
+  static void AddLabeled(Counter counter, const QString& label, qint64 value = 1);
+
+  static qint64 Get(Counter counter)
+  {
+    return totals_[counter].loadAcquire();
+  }
+
+  static QMap<QString, qint64> GetLabels(Counter counter);
+
+  /**
+   * @brief Returns the counter's metric name, e.g. "olive_frames_rendered_total"
+   */
+  static const char* GetName(Counter counter);
+
+  static const char* GetDescription(Counter counter);
+
+  /**
+   * @brief Returns the name of the label AddLabeled() was used with, or nullptr if it isn't labelled
+   */
+  static const char* GetLabelName(Counter counter);
+
+  /**
+   * @brief Returns TRUE if the counter is in nanoseconds and should be reported in seconds
+   */
+  static bool IsTime(Counter counter);
+
+  /**
+   * @brief Set the progress of something long running, e.g. a Task, between 0.0 and 1.0
+   *
+   * `key` identifies it until RemoveProgress() is called with the same key.
+   */
+  static void SetProgress(const void* key, const QString& name, double progress);
+  static void RemoveProgress(const void* key);
+
+  struct Progress {
+    int id;
+    QString name;
+    double progress;
+  };
+
+  static QVector<Progress> GetProgress();
+
+  /**
+   * @brief Record every counter as a Tracer counter if tracing is enabled
+   */
+  static void RecordTrace();
+
+private:
+  struct Info {
+    const char* name;
+    const char* description;
+    const char* label;
+    bool time;
+  };
+
+  static const Info kInfo[kCounterCount];
+
+  static QAtomicInteger<qint64> totals_[kCounterCount];
+
+};
+
+}
+
+#endif // METRICS_H
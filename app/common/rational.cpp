@@ -3,6 +3,9 @@
 
 #include "rational.h"
 
+#include <algorithm>
+#include <QtAlgorithms>
+
 namespace olive {
 
 rational rational::fromDouble(const double &flt)
@@ -51,34 +54,148 @@ void rational::fix_signs()
 
 void rational::reduce()
 {
-  if (!isNull()) {
-    // Euclidean often fails if numbers are negative, we abs it and re-neg it later if necessary
-    bool neg = numer_ < 0;
-
-    numer_ = qAbs(numer_);
-
-    intType d = gcd(numer_, denom_);
+  if (!isNull() && denom_ != 1) {
+    // The denominator is always positive here and the gcd is never more than it, so it fits in intType
+    intType d = static_cast<intType>(gcd(abs_unsigned(numer_), static_cast<uint64_t>(denom_)));
 
     if (d > 1) {
       numer_ /= d;
       denom_ /= d;
     }
-
-    if (neg) {
-      numer_ = -numer_;
-    }
   }
 }
 
-//Function: finds greatest common denominator
+//Function: finds greatest common denominator using the binary (Stein's) algorithm
 
-intType rational::gcd(const intType &x, const intType &y)
+uint64_t rational::gcd(uint64_t x, uint64_t y)
 {
+  if (x == 0) {
+    return y;
+  }
+
   if (y == 0) {
     return x;
+  }
+
+  // Factor out common powers of two, then only subtract and shift
+  uint shift = qCountTrailingZeroBits(quint64(x | y));
+
+  x >>= qCountTrailingZeroBits(quint64(x));
+
+  do {
+    y >>= qCountTrailingZeroBits(quint64(y));
+
+    if (x > y) {
+      std::swap(x, y);
+    }
+
+    y -= x;
+  } while (y != 0);
+
+  return x << shift;
+}
+
+uint64_t rational::abs_unsigned(const intType &x)
+{
+  return (x < 0) ? (uint64_t(0) - static_cast<uint64_t>(x)) : static_cast<uint64_t>(x);
+}
+
+void rational::multiply_wide(uint64_t a, uint64_t b, uint64_t *hi, uint64_t *lo)
+{
+  // Schoolbook multiplication on 32-bit halves, __int128 isn't available everywhere we build
+  uint64_t a_lo = a & 0xFFFFFFFFULL;
+  uint64_t a_hi = a >> 32;
+  uint64_t b_lo = b & 0xFFFFFFFFULL;
+  uint64_t b_hi = b >> 32;
+
+  uint64_t p0 = a_lo * b_lo;
+  uint64_t p1 = a_lo * b_hi;
+  uint64_t p2 = a_hi * b_lo;
+  uint64_t p3 = a_hi * b_hi;
+
+  uint64_t mid = (p0 >> 32) + (p1 & 0xFFFFFFFFULL) + (p2 & 0xFFFFFFFFULL);
+
+  *lo = (mid << 32) | (p0 & 0xFFFFFFFFULL);
+  *hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+}
+
+int rational::compare(const rational &a, const rational &b)
+{
+  // Null rationals have a numerator of 0 so they compare as zero
+  if (a.denom_ == b.denom_) {
+    return (a.numer_ < b.numer_) ? -1 : (a.numer_ > b.numer_);
+  }
+
+  int a_sign = (a.numer_ > 0) - (a.numer_ < 0);
+  int b_sign = (b.numer_ > 0) - (b.numer_ < 0);
+
+  if (a_sign != b_sign) {
+    return (a_sign < b_sign) ? -1 : 1;
+  }
+
+  if (a_sign == 0) {
+    return 0;
+  }
+
+  // Same sign and both non-null, compare magnitudes by exact cross-multiplication
+  uint64_t left_hi, left_lo, right_hi, right_lo;
+  multiply_wide(abs_unsigned(a.numer_), static_cast<uint64_t>(b.denom_), &left_hi, &left_lo);
+  multiply_wide(abs_unsigned(b.numer_), static_cast<uint64_t>(a.denom_), &right_hi, &right_lo);
+
+  int magnitude;
+  if (left_hi != right_hi) {
+    magnitude = (left_hi < right_hi) ? -1 : 1;
+  } else {
+    magnitude = (left_lo < right_lo) ? -1 : (left_lo > right_lo);
+  }
+
+  return (a_sign > 0) ? magnitude : -magnitude;
+}
+
+void rational::add(const intType &numerator, const intType &denominator)
+{
+  if (denominator == 0) {
+    return;
+  }
+
+  if (isNull()) {
+    numer_ = numerator;
+    denom_ = denominator;
+    return;
+  }
+
+  if (denom_ == denominator) {
+    // Common case of two times in the same timebase, no multiplication needed
+    numer_ += numerator;
   } else {
-    return gcd(y, x % y);
+    // Scale by the least common multiple rather than the product to keep intermediates small
+    intType g = static_cast<intType>(gcd(static_cast<uint64_t>(denom_), static_cast<uint64_t>(denominator)));
+    intType rhs_scale = denominator / g;
+
+    numer_ = numer_ * rhs_scale + numerator * (denom_ / g);
+    denom_ *= rhs_scale;
+  }
+
+  fix_signs();
+  reduce();
+}
+
+void rational::multiply(const intType &numerator, const intType &denominator)
+{
+  if (isNull() || numerator == 0 || denominator == 0) {
+    numer_ = 0;
+    denom_ = 0;
+    return;
   }
+
+  // Both operands are already in lowest terms, so cross-reducing leaves the result in lowest terms too
+  intType g1 = static_cast<intType>(gcd(abs_unsigned(numer_), abs_unsigned(denominator)));
+  intType g2 = static_cast<intType>(gcd(abs_unsigned(numerator), static_cast<uint64_t>(denom_)));
+
+  numer_ = (numer_ / g1) * (numerator / g2);
+  denom_ = (denom_ / g2) * (denominator / g1);
+
+  fix_signs();
 }
 
 //Function: convert to double
@@ -149,53 +266,25 @@ const rational& rational::operator=(const rational &rhs)
 
 const rational& rational::operator+=(const rational &rhs)
 {
-  if (!rhs.isNull()) {
-    if (isNull()) {
-      numer_ = rhs.numer_;
-      denom_ = rhs.denom_;
-    } else {
-      numer_ = (numer_ * rhs.denom_) + (rhs.numer_ * denom_);
-      denom_ = denom_ * rhs.denom_;
-      fix_signs();
-      reduce();
-    }
-  }
-
+  add(rhs.numer_, rhs.denom_);
   return *this;
 }
 
 const rational& rational::operator-=(const rational &rhs)
 {
-  if (!rhs.isNull()) {
-    if (isNull()) {
-      numer_ = -rhs.numer_;
-      denom_ = rhs.denom_;
-    } else {
-      numer_ = (numer_ * rhs.denom_) - (rhs.numer_ * denom_);
-      denom_ = denom_ * rhs.denom_;
-      fix_signs();
-      reduce();
-    }
-  }
-
+  add(-rhs.numer_, rhs.denom_);
   return *this;
 }
 
 const rational& rational::operator/=(const rational &rhs)
 {
-  numer_ = numer_ * rhs.denom_;
-  denom_ = denom_ * rhs.numer_;
-  fix_signs();
-  reduce();
+  multiply(rhs.denom_, rhs.numer_);
   return *this;
 }
 
 const rational& rational::operator*=(const rational &rhs)
 {
-  numer_ = numer_ * rhs.numer_;
-  denom_ = denom_ * rhs.denom_;
-  fix_signs();
-  reduce();
+  multiply(rhs.numer_, rhs.denom_);
   return *this;
 }
 
@@ -233,70 +322,22 @@ rational rational::operator*(const rational &rhs) const
 
 bool rational::operator<(const rational &rhs) const
 {
-  if (isNull() && rhs.isNull()) {
-    return false;
-  }
-
-  if (rhs == RATIONAL_MAX
-      || *this == RATIONAL_MIN) {
-    // We will always wither be LESS THAN (true) or EQUAL (false)
-    return (*this != rhs);
-  }
-
-  if (*this == RATIONAL_MAX
-      || rhs == RATIONAL_MIN) {
-    // We will always be GREATER THAN (false) or EQUAL (false)
-    return false;
-  }
-
-  if (!isNull() && rhs.isNull()) {
-    return (numer_ * denom_ < intType(0));
-  }
-
-  if (isNull() && !rhs.isNull()) {
-    return !(rhs.numer_ * rhs.denom_ < intType(0));
-  }
-
-  return ((numer_ * rhs.denom_) < (denom_ * rhs.numer_));
+  return compare(*this, rhs) < 0;
 }
 
 bool rational::operator<=(const rational &rhs) const
 {
-  if (isNull() && rhs.isNull()) {
-    return true;
-  }
-
-  if (rhs == RATIONAL_MAX
-      || *this == RATIONAL_MIN) {
-    // We will always wither be LESS THAN (true) or EQUAL (true)
-    return true;
-  }
-
-  if (*this == RATIONAL_MAX
-      || rhs == RATIONAL_MIN) {
-    // We will always be GREATER THAN (false) or EQUAL (true)
-    return rhs == *this;
-  }
-
-  if (!isNull() && rhs.isNull()) {
-    return (numer_ * denom_ < intType(0));
-  }
-
-  if (isNull() && !rhs.isNull()) {
-    return !(rhs.numer_ * rhs.denom_ < intType(0));
-  }
-
-  return ((numer_ * rhs.denom_) <= (denom_ * rhs.numer_));
+  return compare(*this, rhs) <= 0;
 }
 
 bool rational::operator>(const rational &rhs) const
 {
-  return rhs < *this;
+  return compare(*this, rhs) > 0;
 }
 
 bool rational::operator>=(const rational &rhs) const
 {
-  return rhs <= *this;
+  return compare(*this, rhs) >= 0;
 }
 
 bool rational::operator==(const rational &rhs) const
@@ -332,7 +373,7 @@ const rational& rational::operator--()
 
 rational rational::operator--(int)
 {
-  rational tmp;
+  rational tmp = *this;
   numer_ -= denom_;
   return tmp;
 }
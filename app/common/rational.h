@@ -131,8 +131,18 @@ private:
   void fix_signs();
   //Function: ensures lowest form
   void reduce();
-  //Function: finds greatest common denominator
-  static intType gcd(const intType &x, const intType &y);
+  //Function: finds greatest common denominator using the binary (Stein's) algorithm
+  static uint64_t gcd(uint64_t x, uint64_t y);
+  //Function: absolute value that doesn't overflow for INT64_MIN
+  static uint64_t abs_unsigned(const intType &x);
+  //Function: full 128-bit product of two 64-bit values
+  static void multiply_wide(uint64_t a, uint64_t b, uint64_t *hi, uint64_t *lo);
+  //Function: returns -1, 0, or 1 if a is less than, equal to, or greater than b
+  static int compare(const rational &a, const rational &b);
+  //Function: adds numerator/denominator, with denominator > 0
+  void add(const intType &numerator, const intType &denominator);
+  //Function: multiplies by numerator/denominator, reducing before multiplying to avoid overflow
+  void multiply(const intType &numerator, const intType &denominator);
 };
 
 #define RATIONAL_MIN rational(INT64_MIN, 1)
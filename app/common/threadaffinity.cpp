@@ -0,0 +1,178 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "threadaffinity.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QThread>
+
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "config/config.h"
+
+namespace olive {
+
+const int ThreadAffinity::kConcurrentDecodersPerNode = 4;
+const int ThreadAffinity::kMaxDecoderThreads = 16;
+
+namespace {
+
+thread_local int current_node = 0;
+
+}
+
+int ThreadAffinity::GetNodeCount()
+{
+  return qMax(1, GetTopology().size());
+}
+
+bool ThreadAffinity::IsEnabled()
+{
+  return Config::Current()[QStringLiteral("ThreadAffinity")].toBool() && GetNodeCount() > 1;
+}
+
+bool ThreadAffinity::PinCurrentThreadToNode(int node)
+{
+  const QVector< QVector<int> >& topology = GetTopology();
+
+  if (node < 0 || node >= topology.size()) {
+    return false;
+  }
+
+#ifdef Q_OS_LINUX
+  cpu_set_t set;
+  CPU_ZERO(&set);
+
+  foreach (int cpu, topology.at(node)) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+    qWarning() << "Failed to pin thread to NUMA node" << node;
+    return false;
+  }
+
+  current_node = node;
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+int ThreadAffinity::GetCurrentNode()
+{
+  return current_node;
+}
+
+int ThreadAffinity::GetDecoderThreadCount()
+{
+  int configured = Config::Current()[QStringLiteral("DecoderThreads")].toInt();
+
+  if (configured > 0) {
+    return configured;
+  }
+
+  int cores_per_node = QThread::idealThreadCount() / GetNodeCount();
+
+  return qBound(1, cores_per_node / kConcurrentDecodersPerNode, kMaxDecoderThreads);
+}
+
+const QVector<QVector<int> > &ThreadAffinity::GetTopology()
+{
+  // Function-local statics are initialized thread-safely
+  static const QVector< QVector<int> > topology = [](){
+    QVector< QVector<int> > nodes;
+
+#ifdef Q_OS_LINUX
+    QDir node_dir(QStringLiteral("/sys/devices/system/node"));
+
+    QStringList node_names = node_dir.entryList({QStringLiteral("node*")}, QDir::Dirs);
+
+    foreach (const QString& name, node_names) {
+      bool ok;
+      int index = name.mid(4).toInt(&ok);
+
+      if (!ok) {
+        continue;
+      }
+
+      QFile cpu_list(node_dir.filePath(QStringLiteral("%1/cpulist").arg(name)));
+
+      if (cpu_list.open(QFile::ReadOnly | QFile::Text)) {
+        QVector<int> cpus = ParseCPUList(QString::fromUtf8(cpu_list.readAll()).trimmed());
+
+        cpu_list.close();
+
+        // Memory-only nodes have no CPUs to run on
+        if (!cpus.isEmpty()) {
+          if (nodes.size() <= index) {
+            nodes.resize(index + 1);
+          }
+
+          nodes[index] = cpus;
+        }
+      }
+    }
+
+    // Node numbers can have gaps, keep only the ones with CPUs
+    nodes.removeAll(QVector<int>());
+#endif
+
+    return nodes;
+  }();
+
+  return topology;
+}
+
+QVector<int> ThreadAffinity::ParseCPUList(const QString &list)
+{
+  QVector<int> cpus;
+
+  foreach (const QString& range, list.split(',')) {
+    QStringList bounds = range.split('-');
+
+    bool start_ok;
+    bool end_ok = true;
+    int start = bounds.first().toInt(&start_ok);
+    int end = start;
+
+    if (bounds.size() > 1) {
+      end = bounds.at(1).toInt(&end_ok);
+    }
+
+    if (start_ok && end_ok) {
+      for (int i=start; i<=end; i++) {
+        cpus.append(i);
+      }
+    }
+  }
+
+  return cpus;
+}
+
+}
@@ -0,0 +1,98 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef THREADAFFINITY_H
+#define THREADAFFINITY_H
+
+#include <QVector>
+
+namespace olive {
+
+/**
+ * @brief Places threads on the machine's NUMA nodes
+ *
+ * On multi-socket machines, memory is fastest to access from the socket it was allocated on. If
+ * the "ThreadAffinity" config entry is set, ThreadPool workers are pinned to nodes round-robin.
+ * Memory they allocate (decoded frames, frame pools) is then placed locally by the kernel's
+ * first-touch policy, and threads they start (e.g. FFmpeg codec threads) inherit the pinning.
+ *
+ * Topology is currently only read on Linux. Everywhere else the machine is treated as a single
+ * node and pinning does nothing.
+ */
+class ThreadAffinity
+{
+public:
+  /**
+   * @brief Returns the number of NUMA nodes with CPUs, at least 1
+   */
+  static int GetNodeCount();
+
+  /**
+   * @brief Returns TRUE if threads should be pinned, i.e. it's enabled and there's more than one node
+   */
+  static bool IsEnabled();
+
+  /**
+   * @brief Pin the calling thread to the CPUs of `node`
+   *
+   * Returns FALSE if the thread couldn't be pinned, in which case it may run anywhere.
+   */
+  static bool PinCurrentThreadToNode(int node);
+
+  /**
+   * @brief Returns the node the calling thread was pinned to, or 0 if it hasn't been
+   */
+  static int GetCurrentNode();
+
+  /**
+   * @brief Number of threads each FFmpeg decoder may use
+   *
+   * Render workers already decode in parallel, so giving every decoder instance as many threads as
+   * there are cores oversubscribes the machine. Uses the "DecoderThreads" config entry, or if
+   * that's 0, a share of the cores of one node.
+   */
+  static int GetDecoderThreadCount();
+
+private:
+  /**
+   * @brief CPU indices of each node, read once
+   */
+  static const QVector< QVector<int> >& GetTopology();
+
+  /**
+   * @brief Parse a Linux CPU list such as "0-7,16-23"
+   */
+  static QVector<int> ParseCPUList(const QString& list);
+
+  /**
+   * @brief Decoder instances expected to be decoding at once on one node when set to auto
+   */
+  static const int kConcurrentDecodersPerNode;
+
+  /**
+   * @brief Most threads FFmpeg's frame threading benefits from
+   */
+  static const int kMaxDecoderThreads;
+
+};
+
+}
+
+#endif // THREADAFFINITY_H
@@ -20,6 +20,7 @@
 
 #include "timerange.h"
 
+#include <algorithm>
 #include <QtMath>
 #include <utility>
 
@@ -178,42 +179,50 @@ void TimeRange::normalize()
 
 void TimeRangeList::insert(TimeRange range_to_add)
 {
-  // See if list contains this range
-  if (contains(range_to_add)) {
+  // Every range from here until one starting after our out point overlaps or touches us
+  int start = FirstRangeEndingAtOrAfter(range_to_add.in());
+
+  if (start < size() && array_.at(start).Contains(range_to_add)) {
+    // Already in the list
     return;
   }
 
-  // Does not contain range, so we'll almost certainly be adding it in some way
-  for (int i=0;i<size();i++) {
-    const TimeRange& compare = array_.at(i);
+  int end = start;
 
-    if (compare.OverlapsWith(range_to_add)) {
-      range_to_add = TimeRange::Combine(range_to_add, compare);
-      array_.removeAt(i);
-      i--;
-    }
+  while (end < size() && array_.at(end).in() <= range_to_add.out()) {
+    range_to_add = TimeRange::Combine(range_to_add, array_.at(end));
+    end++;
   }
 
-  array_.append(range_to_add);
+  if (end == start) {
+    array_.insert(start, range_to_add);
+  } else {
+    array_[start] = range_to_add;
+    array_.remove(start + 1, end - start - 1);
+  }
 }
 
 void TimeRangeList::remove(const TimeRange &remove)
 {
-  int sz = this->size();
+  int i = FirstRangeEndingAtOrAfter(remove.in());
 
-  for (int i=0;i<sz;i++) {
+  while (i < size() && array_.at(i).in() <= remove.out()) {
     TimeRange& compare = array_[i];
 
     if (remove.Contains(compare)) {
       // This element is entirely encompassed in this range, remove it
       array_.removeAt(i);
-      i--;
-      sz--;
+      continue;
     } else if (compare.Contains(remove, false, false)) {
+      if (remove.length().isNull()) {
+        // Splitting around an empty range would leave two touching ranges, so there's nothing to do
+        break;
+      }
+
       // The remove range is within this element, only choice is to split the element into two
       TimeRange new_range(remove.out(), compare.out());
       compare.set_out(remove.in());
-      insert(new_range);
+      array_.insert(i + 1, new_range);
       break;
     } else if (compare.in() < remove.in() && compare.out() > remove.in()) {
       // This element's out point overlaps the range's in, we'll trim it
@@ -222,18 +231,17 @@ void TimeRangeList::remove(const TimeRange &remove)
       // This element's in point overlaps the range's out, we'll trim it
       compare.set_in(remove.out());
     }
+
+    i++;
   }
 }
 
 bool TimeRangeList::contains(const TimeRange &range, bool in_inclusive, bool out_inclusive) const
 {
-  for (int i=0;i<size();i++) {
-    if (array_.at(i).Contains(range, in_inclusive, out_inclusive)) {
-      return true;
-    }
-  }
+  // Ranges never touch, so only the first range reaching the out point can contain this range
+  int i = FirstRangeEndingAtOrAfter(range.out());
 
-  return false;
+  return i < size() && array_.at(i).Contains(range, in_inclusive, out_inclusive);
 }
 
 void TimeRangeList::shift(const rational &diff)
@@ -273,24 +281,38 @@ TimeRangeList TimeRangeList::Intersects(const TimeRange &range) const
 {
   TimeRangeList intersect_list;
 
-  for (int i=0;i<size();i++) {
+  for (int i=FirstRangeEndingAtOrAfter(range.in());i<size();i++) {
     const TimeRange& compare = array_.at(i);
 
-    if (compare.out() <= range.in() || compare.in() >= range.out()) {
+    if (compare.in() >= range.out()) {
+      // This and every range after it start after the range
+      break;
+    }
+
+    if (compare.out() <= range.in()) {
       // No intersect
       continue;
-    } else {
-      // Crop the time range to the range and add it to the list
-      TimeRange cropped(qMax(range.in(), compare.in()),
-                        qMin(range.out(), compare.out()));
-
-      intersect_list.insert(cropped);
     }
+
+    // Crop the time range to the range, this keeps the list sorted and non-touching so it can be
+    // appended directly
+    intersect_list.array_.append(TimeRange(qMax(range.in(), compare.in()),
+                                           qMin(range.out(), compare.out())));
   }
 
   return intersect_list;
 }
 
+int TimeRangeList::FirstRangeEndingAtOrAfter(const rational &time) const
+{
+  auto it = std::lower_bound(array_.constBegin(), array_.constEnd(), time,
+                             [](const TimeRange& r, const rational& t) {
+    return r.out() < t;
+  });
+
+  return static_cast<int>(it - array_.constBegin());
+}
+
 uint qHash(const TimeRange &r, uint seed)
 {
   return qHash(r.in(), seed) ^ qHash(r.out(), seed);
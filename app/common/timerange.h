@@ -67,13 +67,22 @@ private:
 
 };
 
+/**
+ * @brief A set of time ranges
+ *
+ * Ranges are kept sorted, non-overlapping and non-adjacent (ranges that touch are merged on
+ * insert), so lookups can binary search rather than scanning the whole list. Iteration always
+ * goes from earliest to latest.
+ */
 class TimeRangeList {
 public:
   TimeRangeList() = default;
 
-  TimeRangeList(std::initializer_list<TimeRange> r) :
-    array_(r)
+  TimeRangeList(std::initializer_list<TimeRange> r)
   {
+    foreach (const TimeRange& range, r) {
+      insert(range);
+    }
   }
 
   void insert(TimeRange range_to_add);
@@ -133,6 +142,13 @@ public:
   }
 
 private:
+  /**
+   * @brief Returns the index of the first range whose out point is at or after `time`
+   *
+   * Returns size() if there is none.
+   */
+  int FirstRangeEndingAtOrAfter(const rational& time) const;
+
   QVector<TimeRange> array_;
 
 };
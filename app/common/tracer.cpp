@@ -0,0 +1,226 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "tracer.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+
+namespace olive {
+
+const int Tracer::kEventsPerThread = 65536;
+
+QAtomicInt Tracer::enabled_(0);
+QMutex Tracer::buffers_lock_;
+QVector<Tracer::ThreadBuffer*> Tracer::buffers_;
+
+void Tracer::SetEnabled(bool e)
+{
+  // Make sure the clock has started before anything is recorded against it
+  Now();
+
+  enabled_.store(e ? 1 : 0);
+}
+
+qint64 Tracer::Now()
+{
+  static QElapsedTimer clock;
+  static QMutex clock_lock;
+  static bool clock_started = false;
+
+  if (!clock_started) {
+    QMutexLocker locker(&clock_lock);
+    if (!clock_started) {
+      clock.start();
+      clock_started = true;
+    }
+  }
+
+  return clock.nsecsElapsed();
+}
+
+void Tracer::Record(const char *name, qint64 start, qint64 end, const QString &arg)
+{
+  Append(GetThreadBuffer(), name, arg, start, end - start, false);
+}
+
+void Tracer::RecordCounter(const char *name, qint64 time, qint64 value)
+{
+  Append(GetThreadBuffer(), name, QString(), time, value, true);
+}
+
+void Tracer::RecordGPU(const char *name, qint64 start, qint64 duration, const QString &arg)
+{
+  Append(GetGPUBuffer(), name, arg, start, duration, false);
+}
+
+void Tracer::Append(ThreadBuffer* buffer, const char *name, const QString &arg, qint64 start, qint64 duration, bool counter)
+{
+  QMutexLocker locker(&buffer->lock);
+
+  if (buffer->events.isEmpty()) {
+    buffer->events.resize(kEventsPerThread);
+  }
+
+  Event& e = buffer->events[buffer->next];
+  e.name = name;
+  e.arg = arg;
+  e.start = start;
+  e.duration = duration;
+  e.counter = counter;
+
+  buffer->next++;
+
+  if (buffer->next == kEventsPerThread) {
+    buffer->next = 0;
+    buffer->wrapped = true;
+  }
+}
+
+void Tracer::Clear()
+{
+  QMutexLocker locker(&buffers_lock_);
+
+  foreach (ThreadBuffer* buffer, buffers_) {
+    QMutexLocker buffer_locker(&buffer->lock);
+
+    buffer->events.clear();
+    buffer->next = 0;
+    buffer->wrapped = false;
+  }
+}
+
+bool Tracer::SaveChromeTrace(const QString &filename)
+{
+  QJsonArray events;
+
+  {
+    QMutexLocker locker(&buffers_lock_);
+
+    foreach (ThreadBuffer* buffer, buffers_) {
+      QMutexLocker buffer_locker(&buffer->lock);
+
+      QJsonObject thread_name;
+      thread_name.insert(QStringLiteral("name"), QStringLiteral("thread_name"));
+      thread_name.insert(QStringLiteral("ph"), QStringLiteral("M"));
+      thread_name.insert(QStringLiteral("pid"), 1);
+      thread_name.insert(QStringLiteral("tid"), buffer->tid);
+      thread_name.insert(QStringLiteral("args"), QJsonObject({{QStringLiteral("name"), buffer->thread_name}}));
+      events.append(thread_name);
+
+      // Oldest first
+      int count = buffer->wrapped ? kEventsPerThread : buffer->next;
+      int first = buffer->wrapped ? buffer->next : 0;
+
+      for (int i=0; i<count; i++) {
+        const Event& e = buffer->events.at((first + i) % kEventsPerThread);
+
+        // Trace Event Format times are in microseconds
+        QJsonObject o;
+        o.insert(QStringLiteral("name"), QString::fromLatin1(e.name));
+        o.insert(QStringLiteral("pid"), 1);
+        o.insert(QStringLiteral("tid"), buffer->tid);
+        o.insert(QStringLiteral("ts"), static_cast<double>(e.start) / 1000.0);
+
+        if (e.counter) {
+          o.insert(QStringLiteral("ph"), QStringLiteral("C"));
+          o.insert(QStringLiteral("args"), QJsonObject({{QStringLiteral("value"), static_cast<double>(e.duration)}}));
+        } else {
+          o.insert(QStringLiteral("ph"), QStringLiteral("X"));
+          o.insert(QStringLiteral("dur"), static_cast<double>(e.duration) / 1000.0);
+        }
+
+        if (!e.arg.isEmpty()) {
+          o.insert(QStringLiteral("args"), QJsonObject({{QStringLiteral("detail"), e.arg}}));
+        }
+
+        events.append(o);
+      }
+    }
+  }
+
+  QJsonObject root;
+  root.insert(QStringLiteral("traceEvents"), events);
+  root.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ns"));
+
+  QFile f(filename);
+
+  if (!f.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to write trace" << filename;
+    return false;
+  }
+
+  QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Compact);
+
+  return f.write(json) == json.size();
+}
+
+Tracer::ThreadBuffer *Tracer::GetThreadBuffer()
+{
+  static thread_local ThreadBuffer* thread_buffer = nullptr;
+
+  if (!thread_buffer) {
+    QThread* thread = QThread::currentThread();
+
+    if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+      thread_buffer = CreateBuffer(QStringLiteral("Main"));
+    } else {
+      thread_buffer = CreateBuffer(thread->objectName());
+    }
+  }
+
+  return thread_buffer;
+}
+
+Tracer::ThreadBuffer *Tracer::GetGPUBuffer()
+{
+  // Function statics are initialized thread-safely so every renderer records onto the same track
+  static ThreadBuffer* gpu_buffer = CreateBuffer(QStringLiteral("GPU"));
+
+  return gpu_buffer;
+}
+
+Tracer::ThreadBuffer *Tracer::CreateBuffer(const QString &name)
+{
+  ThreadBuffer* buffer = new ThreadBuffer();
+  buffer->next = 0;
+  buffer->wrapped = false;
+  buffer->thread_name = name;
+
+  QMutexLocker locker(&buffers_lock_);
+
+  buffer->tid = buffers_.size() + 1;
+
+  if (buffer->thread_name.isEmpty()) {
+    buffer->thread_name = QStringLiteral("Thread %1").arg(buffer->tid);
+  }
+
+  buffers_.append(buffer);
+
+  return buffer;
+}
+
+}
@@ -0,0 +1,176 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include "common/define.h"
+
+namespace olive {
+
+/**
+ * @brief Opt-in recorder of timed spans and counters across every thread for performance analysis
+ *
+ * Each thread records into its own fixed-size ring buffer so recording never contends with other
+ * threads and memory stays bounded however long it runs, only the most recent kEventsPerThread
+ * spans of each thread are kept. Timestamps are in nanoseconds from a monotonic clock.
+ *
+ * Recorded spans can be saved as a Chrome trace (JSON Trace Event Format) that can be opened in
+ * chrome://tracing or https://ui.perfetto.dev.
+ *
+ * When disabled (the default), TraceSpan costs a single atomic load.
+ */
+class Tracer
+{
+public:
+  static void SetEnabled(bool e);
+
+  static bool IsEnabled()
+  {
+    return enabled_.load();
+  }
+
+  /**
+   * @brief Current time in nanoseconds on the clock spans are recorded with
+   */
+  static qint64 Now();
+
+  /**
+   * @brief Record a span on the calling thread
+   *
+   * `name` must be a string that outlives the tracer, i.e. a literal. `arg` is shown alongside the
+   * span, e.g. the ID of the node a shader belongs to.
+   */
+  static void Record(const char* name, qint64 start, qint64 end, const QString& arg = QString());
+
+  /**
+   * @brief Record the value of a counter at `time` on the calling thread
+   *
+   * Counters are drawn as a graph over the timeline rather than as spans, e.g. for memory usage.
+   * `name` must be a literal, the same as for Record().
+   */
+  static void RecordCounter(const char* name, qint64 time, qint64 value);
+
+  /**
+   * @brief Record a span of GPU work on a track of its own rather than the calling thread's
+   *
+   * GPU timings arrive some time after the work was submitted, so they'd overlap whatever the
+   * renderer's thread is recording by then. `start` is when the work was submitted.
+   */
+  static void RecordGPU(const char* name, qint64 start, qint64 duration, const QString& arg = QString());
+
+  /**
+   * @brief Discard everything recorded so far
+   */
+  static void Clear();
+
+  /**
+   * @brief Write everything recorded so far as a Chrome trace JSON file
+   */
+  static bool SaveChromeTrace(const QString& filename);
+
+  /**
+   * @brief Number of spans kept per thread before the oldest are overwritten
+   */
+  static const int kEventsPerThread;
+
+private:
+  struct Event {
+    const char* name;
+    QString arg;
+    qint64 start;
+
+    /// The counter's value if `counter` is TRUE
+    qint64 duration;
+
+    bool counter;
+  };
+
+  struct ThreadBuffer;
+
+  static void Append(ThreadBuffer* buffer, const char* name, const QString& arg, qint64 start, qint64 duration, bool counter);
+
+  struct ThreadBuffer {
+    QVector<Event> events;
+    int next;
+    bool wrapped;
+    int tid;
+    QString thread_name;
+    QMutex lock;
+  };
+
+  static ThreadBuffer* GetThreadBuffer();
+
+  static ThreadBuffer* GetGPUBuffer();
+
+  static ThreadBuffer* CreateBuffer(const QString& name);
+
+  static QAtomicInt enabled_;
+
+  static QMutex buffers_lock_;
+
+  /**
+   * @brief Every thread's buffer, kept after a thread exits so its spans can still be saved
+   */
+  static QVector<ThreadBuffer*> buffers_;
+
+};
+
+/**
+ * @brief Records a span from its construction to its destruction if the Tracer is enabled
+ */
+class TraceSpan
+{
+public:
+  TraceSpan(const char* name, const QString& arg = QString()) :
+    name_(name),
+    start_(Tracer::IsEnabled() ? Tracer::Now() : -1)
+  {
+    if (start_ >= 0) {
+      arg_ = arg;
+    }
+  }
+
+  ~TraceSpan()
+  {
+    if (start_ >= 0) {
+      Tracer::Record(name_, start_, Tracer::Now(), arg_);
+    }
+  }
+
+  DISABLE_COPY_MOVE(TraceSpan)
+
+private:
+  const char* name_;
+
+  qint64 start_;
+
+  QString arg_;
+
+};
+
+}
+
+#endif // TRACER_H
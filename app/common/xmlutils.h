@@ -34,6 +34,7 @@ class NodeParam;
 class NodeInput;
 class NodeOutput;
 class Item;
+class NestedSequence;
 
 #define XMLAttributeLoop(reader, item) \
   QXmlStreamAttributes __attributes = reader->attributes(); \
@@ -55,14 +56,23 @@ struct XMLNodeData {
     quintptr link;
   };
 
+  struct SequenceConnection {
+    NestedSequence* node;
+    quintptr sequence;
+  };
+
   QHash<quintptr, Node*> node_ptrs;
   QHash<quintptr, NodeOutput*> output_ptrs;
   QList<SerializedConnection> desired_connections;
   QHash<quintptr, Stream*> footage_ptrs;
   QList<FootageConnection> footage_connections;
   QList<BlockLink> block_links;
+  QList<SequenceConnection> sequence_connections;
   QHash<quintptr, Item*> item_ptrs;
 
+  // Compressed sequence XML from binary projects, referenced by "chunk" attributes
+  QHash<quint32, QByteArray> sequence_chunks;
+
 };
 
 void XMLConnectNodes(const XMLNodeData& xml_node_data, QUndoCommand* command = nullptr);
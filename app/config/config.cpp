@@ -31,6 +31,7 @@
 #include "common/filefunctions.h"
 #include "common/xmlutils.h"
 #include "core.h"
+#include "render/rendermodes.h"
 #include "ui/style/style.h"
 #include "window/mainwindow/mainwindow.h"
 
@@ -67,7 +68,20 @@ void Config::SetDefaults()
   SetEntryInternal(QStringLiteral("HoverFocus"), NodeParam::kBoolean, false);
   SetEntryInternal(QStringLiteral("AudioScrubbing"), NodeParam::kBoolean, true);
   SetEntryInternal(QStringLiteral("AutorecoveryInterval"), NodeParam::kInt, 1);
+  SetEntryInternal(QStringLiteral("UndoMemoryLimit"), NodeParam::kInt, 512);
+  SetEntryInternal(QStringLiteral("ProbeConcurrency"), NodeParam::kInt, 8);
+  SetEntryInternal(QStringLiteral("ImageDecoderCacheSize"), NodeParam::kInt, 256);
   SetEntryInternal(QStringLiteral("DiskCacheSaveInterval"), NodeParam::kInt, 10000);
+  SetEntryInternal(QStringLiteral("DiskCacheCompression"), NodeParam::kBoolean, false);
+  SetEntryInternal(QStringLiteral("PlaybackMemoryCache"), NodeParam::kInt, 1024);
+  SetEntryInternal(QStringLiteral("PlaybackQueueMemory"), NodeParam::kInt, 512);
+  SetEntryInternal(QStringLiteral("RemoteCachePath"), NodeParam::kString, QString());
+  SetEntryInternal(QStringLiteral("StillImageCacheSize"), NodeParam::kInt, 512);
+  SetEntryInternal(QStringLiteral("VideoTextureCacheSize"), NodeParam::kInt, 512);
+  SetEntryInternal(QStringLiteral("ImageAtlasSize"), NodeParam::kInt, 64);
+  SetEntryInternal(QStringLiteral("OpenDecoderLimit"), NodeParam::kInt, 128);
+  SetEntryInternal(QStringLiteral("MemoryBudget"), NodeParam::kInt, 2048);
+  SetEntryInternal(QStringLiteral("PrecomputeFootagePreviews"), NodeParam::kBoolean, true);
   SetEntryInternal(QStringLiteral("Language"), NodeParam::kString, QString());
   SetEntryInternal(QStringLiteral("ScrollZooms"), NodeParam::kBoolean, false);
   SetEntryInternal(QStringLiteral("EnableSeekToImport"), NodeParam::kBoolean, false);
@@ -92,6 +106,19 @@ void Config::SetDefaults()
   SetEntryInternal(QStringLiteral("SplitClipsCopyNodes"), NodeParam::kBoolean, true);
 
   SetEntryInternal(QStringLiteral("AutoCacheDelay"), NodeParam::kInt, 1000);
+  SetEntryInternal(QStringLiteral("RenderThreads"), NodeParam::kInt, 2);
+  SetEntryInternal(QStringLiteral("TexturePoolBudget"), NodeParam::kInt, 512);
+  SetEntryInternal(QStringLiteral("HardwareDecoding"), NodeParam::kBoolean, false);
+  SetEntryInternal(QStringLiteral("ThreadAffinity"), NodeParam::kBoolean, false);
+  SetEntryInternal(QStringLiteral("DecoderThreads"), NodeParam::kInt, 0);
+  SetEntryInternal(QStringLiteral("GPUYUVConversion"), NodeParam::kBoolean, false);
+  SetEntryInternal(QStringLiteral("ExportSegments"), NodeParam::kInt, 1);
+  SetEntryInternal(QStringLiteral("RenderFarmPath"), NodeParam::kString, QString());
+  SetEntryInternal(QStringLiteral("RenderMaxFramesInFlight"), NodeParam::kInt, 0);
+  SetEntryInternal(QStringLiteral("RenderMaxMemoryInFlight"), NodeParam::kInt, 2048);
+  SetEntryInternal(QStringLiteral("ScopeRefreshRate"), NodeParam::kInt, 15);
+  SetEntryInternal(QStringLiteral("AdaptivePlaybackResolution"), NodeParam::kBoolean, false);
+  SetEntryInternal(QStringLiteral("PreviewPrecision"), NodeParam::kInt, RenderMode::kPrecisionAccurate);
 
   SetEntryInternal(QStringLiteral("NodeCatColor0"), NodeParam::kColor, QVariant::fromValue(Color(0.75, 0.75, 0.75)));
   SetEntryInternal(QStringLiteral("NodeCatColor1"), NodeParam::kColor, QVariant::fromValue(Color(0.25, 0.25, 0.25)));
@@ -107,6 +134,8 @@ void Config::SetDefaults()
 
   SetEntryInternal(QStringLiteral("AudioOutput"), NodeParam::kString, QString());
   SetEntryInternal(QStringLiteral("AudioInput"), NodeParam::kString, QString());
+  SetEntryInternal(QStringLiteral("AudioOutputBufferSize"), NodeParam::kInt, 100);
+  SetEntryInternal(QStringLiteral("AudioRealtimeMix"), NodeParam::kBoolean, false);
 
   SetEntryInternal(QStringLiteral("DiskCacheBehind"), NodeParam::kRational, QVariant::fromValue(rational(1)));
   SetEntryInternal(QStringLiteral("DiskCacheAhead"), NodeParam::kRational, QVariant::fromValue(rational(5)));
@@ -23,19 +23,31 @@
 #include <QApplication>
 #include <QClipboard>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QHBoxLayout>
 #include <QInputDialog>
 #include <QMessageBox>
 #include <QStyleFactory>
+#include <QtConcurrent/QtConcurrent>
 #ifdef Q_OS_WINDOWS
 #include <QtPlatformHeaders/QWindowsWindowFunctions>
 #endif
 
 #include "audio/audiomanager.h"
+#include "cli/clibenchmark/clibenchmark.h"
+#include "cli/climetrics/climetricsserver.h"
+#include "cli/climicrobenchmark/climicrobenchmark.h"
+#include "cli/clirenderfarm/clirenderfarmworker.h"
+#include "cli/clirenderreplay/clirenderreplay.h"
+#include "cli/clirenderserver/clirenderserver.h"
+#include "cli/clistressproject/clistressproject.h"
 #include "cli/clitask/clitaskdialog.h"
+#include "codec/decoder.h"
 #include "common/filefunctions.h"
+#include "common/lockprofiler.h"
+#include "common/tracer.h"
 #include "common/xmlutils.h"
 #include "config/config.h"
 #include "dialog/about/about.h"
@@ -49,17 +61,27 @@
 #include "panel/panelmanager.h"
 #include "panel/project/project.h"
 #include "panel/viewer/viewer.h"
+#include "project/item/footage/videostream.h"
 #include "render/colormanager.h"
 #include "render/diskmanager.h"
+#include "render/framememorycache.h"
+#include "render/imageatlas.h"
+#include "render/remoteframecache.h"
 #include "render/rendermanager.h"
+#include "render/renderrecorder.h"
 #ifdef USE_OTIO
 #include "task/project/loadotio/loadotio.h"
 #include "task/project/saveotio/saveotio.h"
 #endif
+#include "task/precompute/thumbnailcache.h"
+#include "task/precompute/waveformtask.h"
+#include "task/project/autorecovery/autorecoverysaver.h"
 #include "task/project/import/import.h"
 #include "task/project/import/importerrordialog.h"
 #include "task/project/load/load.h"
+#include "task/project/loadbinary/loadbinary.h"
 #include "task/project/save/save.h"
+#include "task/project/savebinary/savebinary.h"
 #include "task/taskmanager.h"
 #include "ui/style/style.h"
 #include "undo/undostack.h"
@@ -78,7 +100,9 @@ Core::Core(const CoreParams& params) :
   tool_(Tool::kPointer),
   addable_object_(Tool::kAddableEmpty),
   snapping_(true),
-  core_params_(params)
+  core_params_(params),
+  metrics_server_(nullptr),
+  render_server_(nullptr)
 {
   // Store reference to this object, making the assumption that Core will only ever be made in
   // main(). This will obviously break if not.
@@ -117,6 +141,9 @@ void Core::DeclareTypesForQt()
 
 void Core::Start()
 {
+  QElapsedTimer startup_timer;
+  startup_timer.start();
+
   // Load application config
   Config::Load();
 
@@ -126,17 +153,67 @@ void Core::Start()
   // Declare custom types for Qt signal/slot system
   DeclareTypesForQt();
 
-  // Set up node factory/library
-  NodeFactory::Initialize();
+  if (!core_params_.trace_output().isEmpty()) {
+    Tracer::SetEnabled(true);
+  }
 
-  // Set up color manager's default config
+  if (core_params_.profile_locks()) {
+    LockProfiler::SetEnabled(true);
+  }
+
+  // The node library is built the first time it's used and the default color config loads in the
+  // background, neither has to hold up the main window
   ColorManager::SetUpDefaultConfig();
 
   // Initialize task manager
   TaskManager::CreateInstance();
 
-  // Initialize RenderManager
-  RenderManager::CreateInstance();
+  // Initialize RenderManager, its renderer threads finish setting up their contexts while the UI
+  // is being built
+  {
+    TraceSpan span("Startup: Render Manager");
+    RenderManager::Backend backend = RenderManager::kOpenGL;
+
+    if (core_params_.software_render()) {
+      backend = RenderManager::kSoftware;
+    } else if (core_params_.headless_gpu()) {
+      backend = RenderManager::kOpenGLHeadless;
+    }
+
+    RenderManager::CreateInstance(backend);
+  }
+
+  // Initialize in-memory frame cache
+  FrameMemoryCache::CreateInstance();
+
+  // Initialize shared storage for images widgets draw repeatedly
+  ImageAtlas::CreateInstance();
+
+  // Initialize thumbnail cache for the project views
+  ThumbnailCache::CreateInstance();
+
+  // Initialize shared frame cache
+  {
+    TraceSpan span("Startup: Remote Frame Cache");
+    RemoteFrameCache::CreateInstance();
+  }
+
+  // Drop persistent probe results for media that has changed since, in the background since it
+  // stats every cached file
+  QtConcurrent::run(&Decoder::RevalidateProbeCache);
+
+  if (!core_params_.render_log_output().isEmpty()) {
+    RenderRecorder::Start(core_params_.render_log_output());
+  }
+
+  if (core_params_.metrics_port() > 0) {
+    metrics_server_ = new CLIMetricsServer();
+
+    if (!metrics_server_->Start(core_params_.metrics_port())) {
+      delete metrics_server_;
+      metrics_server_ = nullptr;
+    }
+  }
 
   //
   // Start application
@@ -149,6 +226,8 @@ void Core::Start()
     // Start GUI
     StartGUI(core_params_.fullscreen());
 
+    qInfo() << "Main window ready after" << startup_timer.elapsed() << "ms";
+
     // If we have a startup
     QMetaObject::invokeMethod(this, "OpenStartupProject", Qt::QueuedConnection);
     break;
@@ -158,6 +237,25 @@ void Core::Start()
   case CoreParams::kHeadlessPreCache:
     qInfo() << "Headless pre-cache is not fully implemented yet";
     break;
+  case CoreParams::kHeadlessBenchmark:
+    // Run once the event loop has started so the application can quit when it's done
+    QMetaObject::invokeMethod(this, "RunBenchmark", Qt::QueuedConnection);
+    break;
+  case CoreParams::kHeadlessRenderFarm:
+    QMetaObject::invokeMethod(this, "RunRenderFarmWorker", Qt::QueuedConnection);
+    break;
+  case CoreParams::kHeadlessRenderServer:
+    QMetaObject::invokeMethod(this, "RunRenderServer", Qt::QueuedConnection);
+    break;
+  case CoreParams::kHeadlessMicrobenchmark:
+    QMetaObject::invokeMethod(this, "RunMicrobenchmark", Qt::QueuedConnection);
+    break;
+  case CoreParams::kHeadlessStressProject:
+    QMetaObject::invokeMethod(this, "RunStressProjectGenerator", Qt::QueuedConnection);
+    break;
+  case CoreParams::kHeadlessRenderReplay:
+    QMetaObject::invokeMethod(this, "RunRenderReplay", Qt::QueuedConnection);
+    break;
   }
 }
 
@@ -178,8 +276,40 @@ void Core::Stop()
     }
   }
 
+  // Jobs need the task manager and render threads to finish
+  delete render_server_;
+  render_server_ = nullptr;
+
+  RenderRecorder::Stop();
+
+  // Stop serving metrics before what they're read from goes away
+  delete metrics_server_;
+  metrics_server_ = nullptr;
+
   RenderManager::DestroyInstance();
 
+  if (core_params_.profile_locks()) {
+    LockProfiler::LogSummary();
+    LockProfiler::SetEnabled(false);
+  }
+
+  // Save trace after render threads have finished so every span is complete
+  if (!core_params_.trace_output().isEmpty()) {
+    Tracer::SetEnabled(false);
+
+    if (!Tracer::SaveChromeTrace(core_params_.trace_output())) {
+      qWarning() << "Failed to save trace to" << core_params_.trace_output();
+    }
+  }
+
+  FrameMemoryCache::DestroyInstance();
+
+  ImageAtlas::DestroyInstance();
+
+  ThumbnailCache::DestroyInstance();
+
+  RemoteFrameCache::DestroyInstance();
+
   MenuShared::DestroyInstance();
 
   TaskManager::DestroyInstance();
@@ -457,9 +587,64 @@ void Core::AddOpenProject(Project* p)
 
   PushRecentlyOpenedProject(p->filename());
 
+  WarmProjectColorProcessors(p);
+
   emit ProjectOpened(p);
 }
 
+void Core::WarmProjectColorProcessors(Project *p)
+{
+  if (!RenderManager::instance()) {
+    return;
+  }
+
+  QStringList colorspaces;
+
+  foreach (Item* item, p->get_items_of_type(Item::kFootage)) {
+    foreach (Stream* stream, static_cast<Footage*>(item)->streams()) {
+      if (stream->type() == Stream::kVideo) {
+        const QString& cs = static_cast<VideoStream*>(stream)->colorspace();
+
+        if (!colorspaces.contains(cs)) {
+          colorspaces.append(cs);
+        }
+      }
+    }
+  }
+
+  if (!colorspaces.isEmpty()) {
+    RenderManager::instance()->WarmColorProcessors(p->color_manager(), colorspaces);
+  }
+}
+
+void Core::PrecomputeFootagePreviews(const QVector<Footage *> &footage)
+{
+  if (!Config::Current()[QStringLiteral("PrecomputeFootagePreviews")].toBool()) {
+    return;
+  }
+
+  foreach (Footage* f, footage) {
+    bool has_audio = false;
+
+    foreach (Stream* stream, f->streams()) {
+      if (!stream->enabled()) {
+        continue;
+      }
+
+      if (stream->type() == Stream::kVideo) {
+        ThumbnailCache::instance()->Generate(static_cast<VideoStream*>(stream));
+      } else if (stream->type() == Stream::kAudio) {
+        has_audio = true;
+      }
+    }
+
+    if (has_audio) {
+      // One task per file so all of its audio streams are conformed in a single read
+      TaskManager::instance()->AddTask(new WaveformTask(f));
+    }
+  }
+}
+
 void Core::AddOpenProjectFromTask(Task *task)
 {
   ProjectLoadBaseTask* load_task = static_cast<ProjectLoadBaseTask*>(task);
@@ -467,10 +652,21 @@ void Core::AddOpenProjectFromTask(Task *task)
   Project* project = load_task->GetLoadedProject();
   MainWindowLayoutInfo layout = load_task->GetLoadedLayout();
 
-  if (ValidateFootageInLoadedProject(project, load_task->GetFilenameProjectWasSavedAs())) {
+  QUndoCommand* relink_command = new QUndoCommand();
+
+  if (RelinkInvalidFootage(load_task->GetInvalidFootage(), relink_command)) {
+    // Pick up where the disk cache left off rather than rehashing every sequence
+    foreach (Item* item, project->get_items_of_type(Item::kSequence)) {
+      ViewerOutput* viewer = static_cast<Sequence*>(item)->viewer_output();
+      viewer->video_frame_cache()->LoadHashMap(viewer->uuid());
+    }
+
     AddOpenProject(project);
     main_window_->LoadLayout(layout);
+
+    undo_stack_.pushIfHasChildren(relink_command);
   } else {
+    delete relink_command;
     delete project;
   }
 }
@@ -487,6 +683,8 @@ void Core::ImportTaskComplete(Task* task)
   }
 
   undo_stack_.pushIfHasChildren(command);
+
+  PrecomputeFootagePreviews(import_task->GetImportedFootage());
 }
 
 bool Core::ConfirmImageSequence(const QString& filename)
@@ -607,6 +805,61 @@ bool Core::StartHeadlessExport()
   }
 }
 
+void Core::RunBenchmark()
+{
+  CLIBenchmark benchmark(core_params_.startup_project());
+
+  QCoreApplication::exit(benchmark.Run(core_params_.benchmark_output()));
+}
+
+void Core::RunMicrobenchmark()
+{
+  CLIMicrobenchmark benchmark;
+
+  QCoreApplication::exit(benchmark.Run(core_params_.benchmark_output()));
+}
+
+void Core::RunStressProjectGenerator()
+{
+  CLIStressProject::Params params;
+
+  if (!CLIStressProject::ParseParams(core_params_.stress_project_params(), &params)) {
+    QCoreApplication::exit(1);
+    return;
+  }
+
+  QCoreApplication::exit(CLIStressProject::Run(core_params_.stress_project_output(), params));
+}
+
+void Core::RunRenderReplay()
+{
+  CLIRenderReplay replay(core_params_.startup_project(), core_params_.render_replay_log());
+
+  QCoreApplication::exit(replay.Run(core_params_.benchmark_output()));
+}
+
+void Core::RunRenderFarmWorker()
+{
+  QString farm_path = core_params_.render_farm_path();
+
+  if (farm_path.isEmpty()) {
+    farm_path = Config::Current()["RenderFarmPath"].toString();
+  }
+
+  CLIRenderFarmWorker worker(farm_path);
+
+  QCoreApplication::exit(worker.Run());
+}
+
+void Core::RunRenderServer()
+{
+  render_server_ = new CLIRenderServer(core_params_.render_server_name());
+
+  if (!render_server_->Start()) {
+    QCoreApplication::exit(1);
+  }
+}
+
 void Core::OpenStartupProject()
 {
   const QString& startup_project = core_params_.startup_project();
@@ -641,11 +894,14 @@ void Core::StartGUI(bool full_screen)
   // Since we're starting GUI mode, create a PanelFocusManager (auto-deletes with QObject)
   PanelManager::CreateInstance();
 
-  // Initialize audio service
+  // Initialize audio service, devices are enumerated in the background
   AudioManager::CreateInstance();
 
-  // Initialize disk service
-  DiskManager::CreateInstance();
+  // Initialize disk service, folder indexes are loaded on each folder's IO thread
+  {
+    TraceSpan span("Startup: Disk Manager");
+    DiskManager::CreateInstance();
+  }
 
   // Connect the PanelFocusManager to the application's focus change signal
   connect(qApp,
@@ -654,6 +910,7 @@ void Core::StartGUI(bool full_screen)
           &PanelManager::FocusChanged);
 
   // Create main window and open it
+  TraceSpan window_span("Startup: Main Window");
   main_window_ = new MainWindow();
 
   if (full_screen) {
@@ -709,6 +966,8 @@ void Core::SaveProjectInternal(Project* project)
                              "cannot open OpenTimelineIO files."));
     return;
 #endif
+  } else if (project->filename().endsWith(QStringLiteral(".ovb"), Qt::CaseInsensitive)) {
+    psm = new ProjectSaveBinaryTask(project);
   } else {
     psm = new ProjectSaveTask(project);
   }
@@ -753,9 +1012,12 @@ ViewerOutput *Core::GetSequenceToExport()
 void Core::SaveAutorecovery()
 {
   foreach (Project* p, open_projects_) {
-    if (!p->has_autorecovery_been_saved()) {
-      // FIXME: SAVE AN AUTORECOVERY PROJECT
-      p->set_autorecovery_saved(true);
+    // Skip projects that are already being saved from the last interval
+    if (!p->has_autorecovery_been_saved()
+        && !p->findChild<AutorecoverySaver*>(QString(), Qt::FindDirectChildrenOnly)) {
+      AutorecoverySaver* saver = new AutorecoverySaver(p);
+      connect(saver, &AutorecoverySaver::Finished, p, &Project::set_autorecovery_saved);
+      saver->Start();
     }
   }
 }
@@ -767,6 +1029,15 @@ void Core::ProjectSaveSucceeded(Task* task)
   PushRecentlyOpenedProject(p->filename());
 
   p->set_modified(false);
+
+  // Keep the cache's view of each sequence in step with what's now on disk
+  foreach (Item* item, p->get_items_of_type(Item::kSequence)) {
+    ViewerOutput* viewer = static_cast<Sequence*>(item)->viewer_output();
+    viewer->video_frame_cache()->SaveHashMap(viewer->uuid());
+  }
+
+  // Project is safely on disk so its autorecovery copy is no longer needed
+  QFile::remove(AutorecoverySaver::GetAutorecoveryFilename(p));
 }
 
 Project* Core::GetActiveProject() const
@@ -888,15 +1159,19 @@ QString Core::GetProjectFilter(bool include_any_filter)
 {
   QString filters;
 
-#ifdef USE_OTIO
   if (include_any_filter) {
-    filters.append(QStringLiteral("All Supported Projects (*.ove *.otio);;"));
-  }
+#ifdef USE_OTIO
+    filters.append(QStringLiteral("All Supported Projects (*.ove *.ovb *.otio);;"));
+#else
+    filters.append(QStringLiteral("All Supported Projects (*.ove *.ovb);;"));
 #endif
+  }
 
   // Append standard filter
   filters.append(QStringLiteral("%1 (*.ove)").arg(tr("Olive Project")));
 
+  filters.append(QStringLiteral(";;%1 (*.ovb)").arg(tr("Olive Binary Project")));
+
 #ifdef USE_OTIO
   filters.append(QStringLiteral(";;%2 (*.otio)").arg(tr("OpenTimelineIO")));
 #endif
@@ -1011,6 +1286,8 @@ void Core::OpenProjectInternal(const QString &filename)
                              "cannot open OpenTimelineIO files."));
     return;
 #endif
+  } else if (filename.endsWith(QStringLiteral(".ovb"), Qt::CaseInsensitive)) {
+    load_task = new ProjectLoadBinaryTask(filename);
   } else {
     // Fallback to regular OVE project
     load_task = new ProjectLoadTask(filename);
@@ -1287,45 +1564,10 @@ void Core::CacheActiveSequence(bool in_out_only)
   }
 }
 
-bool Core::ValidateFootageInLoadedProject(Project* project, const QString& project_saved_url)
+bool Core::RelinkInvalidFootage(const QVector<Footage *> &footage, QUndoCommand *command)
 {
-  QVector<Footage*> footage_we_couldnt_validate;
-
-  QVector<Item*> project_footage = project->get_items_of_type(Item::kFootage);
-
-  foreach (Item* item, project_footage) {
-    Footage* footage = static_cast<Footage*>(item);
-
-    if (!QFileInfo::exists(footage->filename()) && !project_saved_url.isEmpty()) {
-      // If the footage doesn't exist, it might have moved with the project
-      const QString& project_current_url = project->filename();
-
-      if (project_current_url != project_saved_url) {
-        // Project has definitely moved, try to resolve relative paths
-        QDir saved_dir(QFileInfo(project_saved_url).dir());
-        QDir true_dir(QFileInfo(project_current_url).dir());
-
-        QString relative_filename = saved_dir.relativeFilePath(footage->filename());
-        QString transformed_abs_filename = true_dir.filePath(relative_filename);
-
-        if (QFileInfo::exists(transformed_abs_filename)) {
-          // Use this file instead
-          qInfo() << "Resolved" << footage->filename() << "relatively to" << transformed_abs_filename;
-          footage->set_filename(transformed_abs_filename);
-        }
-      }
-    }
-
-    // Heuristically compare footage to file
-    if (Footage::CompareFootageToItsFilename(footage)) {
-      footage->SetValid();
-    } else {
-      footage_we_couldnt_validate.append(footage);
-    }
-  }
-
-  if (!footage_we_couldnt_validate.isEmpty()) {
-    FootageRelinkDialog frd(footage_we_couldnt_validate, main_window_);
+  if (!footage.isEmpty()) {
+    FootageRelinkDialog frd(footage, command, main_window_);
     if (frd.exec() == QDialog::Rejected) {
       return false;
     }
@@ -1365,7 +1607,11 @@ void Core::OpenProject()
 
 Core::CoreParams::CoreParams() :
   mode_(kRunNormal),
-  run_fullscreen_(false)
+  run_fullscreen_(false),
+  headless_gpu_(false),
+  software_render_(false),
+  profile_locks_(false),
+  metrics_port_(0)
 {
 }
 
@@ -38,6 +38,8 @@
 
 namespace olive {
 
+class CLIMetricsServer;
+class CLIRenderServer;
 class MainWindow;
 
 /**
@@ -61,7 +63,13 @@ public:
     enum RunMode {
       kRunNormal,
       kHeadlessExport,
-      kHeadlessPreCache
+      kHeadlessPreCache,
+      kHeadlessBenchmark,
+      kHeadlessRenderFarm,
+      kHeadlessRenderServer,
+      kHeadlessMicrobenchmark,
+      kHeadlessStressProject,
+      kHeadlessRenderReplay
     };
 
     bool fullscreen() const
@@ -104,6 +112,168 @@ public:
       startup_language_ = s;
     }
 
+    /**
+     * @brief File benchmark results are written to in kHeadlessBenchmark, stdout if empty
+     */
+    const QString& benchmark_output() const
+    {
+      return benchmark_output_;
+    }
+
+    void set_benchmark_output(const QString& s)
+    {
+      benchmark_output_ = s;
+    }
+
+    /**
+     * @brief Render farm folder a kHeadlessRenderFarm worker takes jobs from
+     *
+     * If empty, the folder set in the configuration is used.
+     */
+    const QString& render_farm_path() const
+    {
+      return render_farm_path_;
+    }
+
+    void set_render_farm_path(const QString& s)
+    {
+      render_farm_path_ = s;
+    }
+
+    /**
+     * @brief Local socket name a kHeadlessRenderServer listens for jobs on
+     */
+    const QString& render_server_name() const
+    {
+      return render_server_name_;
+    }
+
+    void set_render_server_name(const QString& s)
+    {
+      render_server_name_ = s;
+    }
+
+    /**
+     * @brief File a kHeadlessStressProject run writes its project to
+     */
+    const QString& stress_project_output() const
+    {
+      return stress_project_output_;
+    }
+
+    void set_stress_project_output(const QString& s)
+    {
+      stress_project_output_ = s;
+    }
+
+    /**
+     * @brief Size of the project a kHeadlessStressProject run generates
+     *
+     * \see CLIStressProject::ParseParams()
+     */
+    const QString& stress_project_params() const
+    {
+      return stress_project_params_;
+    }
+
+    void set_stress_project_params(const QString& s)
+    {
+      stress_project_params_ = s;
+    }
+
+    /**
+     * @brief If set, every render request is logged here with RenderRecorder
+     */
+    const QString& render_log_output() const
+    {
+      return render_log_output_;
+    }
+
+    void set_render_log_output(const QString& s)
+    {
+      render_log_output_ = s;
+    }
+
+    /**
+     * @brief RenderRecorder log a kHeadlessRenderReplay run plays back against the startup project
+     */
+    const QString& render_replay_log() const
+    {
+      return render_replay_log_;
+    }
+
+    void set_render_replay_log(const QString& s)
+    {
+      render_replay_log_ = s;
+    }
+
+    /**
+     * @brief If set, render tracing is enabled for the whole session and saved here on exit
+     */
+    const QString& trace_output() const
+    {
+      return trace_output_;
+    }
+
+    void set_trace_output(const QString& s)
+    {
+      trace_output_ = s;
+    }
+
+    /**
+     * @brief If TRUE, render with OpenGL through EGL rather than a windowing system
+     */
+    bool headless_gpu() const
+    {
+      return headless_gpu_;
+    }
+
+    void set_headless_gpu(bool e)
+    {
+      headless_gpu_ = e;
+    }
+
+    /**
+     * @brief If TRUE, render on the CPU rather than with OpenGL
+     */
+    bool software_render() const
+    {
+      return software_render_;
+    }
+
+    void set_software_render(bool e)
+    {
+      software_render_ = e;
+    }
+
+    /**
+     * @brief If TRUE, profile the render path's locks and log a summary on exit
+     *
+     * \see LockProfiler
+     */
+    bool profile_locks() const
+    {
+      return profile_locks_;
+    }
+
+    void set_profile_locks(bool e)
+    {
+      profile_locks_ = e;
+    }
+
+    /**
+     * @brief If > 0, serve metrics over HTTP on this port while running headless
+     */
+    int metrics_port() const
+    {
+      return metrics_port_;
+    }
+
+    void set_metrics_port(int port)
+    {
+      metrics_port_ = port;
+    }
+
   private:
     RunMode mode_;
 
@@ -111,8 +281,32 @@ public:
 
     QString startup_language_;
 
+    QString benchmark_output_;
+
+    QString render_farm_path_;
+
+    QString render_server_name_;
+
+    QString stress_project_output_;
+
+    QString stress_project_params_;
+
+    QString render_log_output_;
+
+    QString render_replay_log_;
+
+    QString trace_output_;
+
     bool run_fullscreen_;
 
+    bool headless_gpu_;
+
+    bool software_render_;
+
+    bool profile_locks_;
+
+    int metrics_port_;
+
   };
 
   /**
@@ -277,9 +471,22 @@ public:
   void CacheActiveSequence(bool in_out_only);
 
   /**
-   * @brief Check each footage object for whether it still exists or has changed
+   * @brief Ask the user to relink footage that was found to be missing or changed while loading
+   *
+   * Returns FALSE if the user cancelled, in which case the project shouldn't be opened. Relinks
+   * are added to `command` so they can be undone together once the project is open.
    */
-  bool ValidateFootageInLoadedProject(Project* project, const QString &project_saved_url);
+  bool RelinkInvalidFootage(const QVector<Footage*>& footage, QUndoCommand* command);
+
+  /**
+   * @brief Prepare the color processors for every footage color space in a project in the background
+   */
+  void WarmProjectColorProcessors(Project* p);
+
+  /**
+   * @brief Queue background tasks that precompute waveforms and thumbnails for newly imported footage
+   */
+  void PrecomputeFootagePreviews(const QVector<Footage*>& footage);
 
   /**
    * @brief Changes the current language
@@ -540,6 +747,16 @@ private:
    */
   CoreParams core_params_;
 
+  /**
+   * @brief Metrics endpoint if one was requested with CoreParams::metrics_port()
+   */
+  CLIMetricsServer* metrics_server_;
+
+  /**
+   * @brief Job server when running as kHeadlessRenderServer
+   */
+  CLIRenderServer* render_server_;
+
   /**
    * @brief Static singleton core instance
    */
@@ -572,6 +789,36 @@ private slots:
 
   void OpenStartupProject();
 
+  /**
+   * @brief Run CLIBenchmark on the startup project and quit with its result
+   */
+  void RunBenchmark();
+
+  /**
+   * @brief Run CLIMicrobenchmark and quit with its result
+   */
+  void RunMicrobenchmark();
+
+  /**
+   * @brief Generate a project with CLIStressProject and quit with its result
+   */
+  void RunStressProjectGenerator();
+
+  /**
+   * @brief Replay a render log with CLIRenderReplay and quit with its result
+   */
+  void RunRenderReplay();
+
+  /**
+   * @brief Run CLIRenderFarmWorker until the process is terminated
+   */
+  void RunRenderFarmWorker();
+
+  /**
+   * @brief Start a CLIRenderServer that takes jobs until it's told to quit
+   */
+  void RunRenderServer();
+
   /**
    * @brief Internal project open
    */
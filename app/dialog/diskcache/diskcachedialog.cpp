@@ -21,11 +21,15 @@
 #include "diskcachedialog.h"
 
 #include <QDialogButtonBox>
+#include <QFileDialog>
 #include <QGridLayout>
+#include <QHBoxLayout>
 #include <QLabel>
 #include <QMessageBox>
 
+#include "common/filefunctions.h"
 #include "config/config.h"
+#include "render/remoteframecache.h"
 
 namespace olive {
 
@@ -52,6 +56,51 @@ DiskCacheDialog::DiskCacheDialog(DiskCacheFolder *folder, QWidget* parent) :
 
   row++;
 
+  layout->addWidget(new QLabel(tr("Frame Encoding:")), row, 0);
+
+  encoding_combo_ = new QComboBox();
+  encoding_combo_->setToolTip(tr("How newly cached frames are stored. The lossy encodings make the cache "
+                                 "several times smaller and faster to read at a small cost in quality. "
+                                 "Frames already in the cache are unaffected."));
+  encoding_combo_->addItem(tr("Uncompressed"), FramePack::kEncodingUncompressed);
+  encoding_combo_->addItem(tr("Lossless (zlib)"), FramePack::kEncodingZlib);
+  encoding_combo_->addItem(tr("Lossy, Smallest (DWAA)"), FramePack::kEncodingDWAA);
+  encoding_combo_->addItem(tr("Lossy, Fastest (B44)"), FramePack::kEncodingB44);
+  encoding_combo_->setCurrentIndex(encoding_combo_->findData(folder->GetEncoding()));
+  layout->addWidget(encoding_combo_, row, 1);
+
+  row++;
+
+  layout->addWidget(new QLabel(tr("Stripe Across:")), row, 0);
+
+  stripe_list_ = new QListWidget();
+  stripe_list_->setToolTip(tr("Extra folders, ideally on other drives, to spread cached frames over "
+                              "so playback can read from several drives at once. Each folder keeps "
+                              "its own maximum size, set in its own disk cache settings."));
+  stripe_list_->addItems(DiskManager::instance()->GetStripePaths(folder->GetPath()).mid(1));
+  layout->addWidget(stripe_list_, row, 1);
+
+  row++;
+
+  {
+    QHBoxLayout* stripe_btn_layout = new QHBoxLayout();
+    stripe_btn_layout->setMargin(0);
+
+    QPushButton* add_stripe_btn = new QPushButton(tr("Add Folder"));
+    connect(add_stripe_btn, &QPushButton::clicked, this, &DiskCacheDialog::AddStripe);
+    stripe_btn_layout->addWidget(add_stripe_btn);
+
+    QPushButton* remove_stripe_btn = new QPushButton(tr("Remove Folder"));
+    connect(remove_stripe_btn, &QPushButton::clicked, this, &DiskCacheDialog::RemoveStripe);
+    stripe_btn_layout->addWidget(remove_stripe_btn);
+
+    stripe_btn_layout->addStretch();
+
+    layout->addLayout(stripe_btn_layout, row, 1);
+  }
+
+  row++;
+
   clear_cache_btn_ = new QPushButton(tr("Clear Disk Cache"));
   connect(clear_cache_btn_, &QPushButton::clicked, this, &DiskCacheDialog::ClearDiskCache);
   layout->addWidget(clear_cache_btn_, row, 1);
@@ -64,6 +113,26 @@ DiskCacheDialog::DiskCacheDialog(DiskCacheFolder *folder, QWidget* parent) :
 
   row++;
 
+  layout->addWidget(new QLabel(tr("Shared Cache:")), row, 0);
+
+  remote_cache_path_ = new PathWidget(Config::Current()[QStringLiteral("RemoteCachePath")].toString());
+  remote_cache_path_->setToolTip(tr("A folder shared with other workstations (e.g. on a NAS). Frames "
+                                    "rendered by any of them can be used by all of them. This applies "
+                                    "to all disk caches."));
+  layout->addWidget(remote_cache_path_, row, 1);
+
+  row++;
+
+  remote_cache_stats_lbl_ = new QLabel();
+  layout->addWidget(remote_cache_stats_lbl_, row, 1);
+
+  UpdateRemoteCacheStatistics();
+  remote_cache_stats_timer_.setInterval(1000);
+  connect(&remote_cache_stats_timer_, &QTimer::timeout, this, &DiskCacheDialog::UpdateRemoteCacheStatistics);
+  remote_cache_stats_timer_.start();
+
+  row++;
+
   QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
   connect(buttons, &QDialogButtonBox::accepted, this, &DiskCacheDialog::accept);
   connect(buttons, &QDialogButtonBox::rejected, this, &DiskCacheDialog::reject);
@@ -81,6 +150,31 @@ void DiskCacheDialog::accept()
     folder_->SetClearOnClose(clear_disk_cache_->isChecked());
   }
 
+  FramePack::Encoding encoding = static_cast<FramePack::Encoding>(encoding_combo_->currentData().toInt());
+  if (folder_->GetEncoding() != encoding) {
+    folder_->SetEncoding(encoding);
+  }
+
+  QStringList stripes;
+  for (int i=0; i<stripe_list_->count(); i++) {
+    stripes.append(stripe_list_->item(i)->text());
+  }
+
+  if (stripes != DiskManager::instance()->GetStripePaths(folder_->GetPath()).mid(1)) {
+    DiskManager::instance()->SetStripePaths(folder_->GetPath(), stripes);
+  }
+
+  // Frames are encoded by whichever stripe they land on, so keep them consistent
+  foreach (const QString& stripe, stripes) {
+    DiskCacheFolder* stripe_folder = DiskManager::instance()->GetOpenFolder(stripe);
+
+    if (stripe_folder->GetEncoding() != encoding) {
+      stripe_folder->SetEncoding(encoding);
+    }
+  }
+
+  Config::Current()[QStringLiteral("RemoteCachePath")] = remote_cache_path_->text();
+
   QDialog::accept();
 }
 
@@ -104,4 +198,47 @@ void DiskCacheDialog::ClearDiskCache()
   }
 }
 
+void DiskCacheDialog::AddStripe()
+{
+  QString dir = QFileDialog::getExistingDirectory(this, tr("Stripe Disk Cache Across"));
+
+  if (dir.isEmpty()) {
+    return;
+  }
+
+  if (!FileFunctions::DirectoryIsValid(dir, true)) {
+    QMessageBox::critical(this, tr("Disk Cache Error"),
+                          tr("Failed to open disk cache at \"%1\". Try a different folder.").arg(dir));
+    return;
+  }
+
+  if (dir != folder_->GetPath() && stripe_list_->findItems(dir, Qt::MatchExactly).isEmpty()) {
+    stripe_list_->addItem(dir);
+  }
+}
+
+void DiskCacheDialog::RemoveStripe()
+{
+  qDeleteAll(stripe_list_->selectedItems());
+}
+
+void DiskCacheDialog::UpdateRemoteCacheStatistics()
+{
+  RemoteFrameCache::Statistics stats = RemoteFrameCache::instance()->GetStatistics();
+
+  // Kilobytes per millisecond is close enough to megabytes per second
+  double throughput = (stats.transfer_time > 0)
+      ? static_cast<double>(stats.bytes_read + stats.bytes_written) / static_cast<double>(stats.transfer_time) / 1024.0
+      : 0.0;
+
+  qint64 latency = (stats.fetches > 0) ? stats.fetch_time / stats.fetches : 0;
+
+  remote_cache_stats_lbl_->setText(tr("%1 of %2 frames found, %3 uploaded, %4 ms average lookup, %5 MB/s")
+                                   .arg(QString::number(stats.hits),
+                                        QString::number(stats.fetches),
+                                        QString::number(stats.uploads),
+                                        QString::number(latency),
+                                        QString::number(throughput, 'f', 1)));
+}
+
 }
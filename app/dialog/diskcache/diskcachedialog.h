@@ -22,10 +22,15 @@
 #define DISKCACHEDIALOG_H
 
 #include <QCheckBox>
+#include <QComboBox>
 #include <QDialog>
+#include <QLabel>
+#include <QListWidget>
 #include <QPushButton>
+#include <QTimer>
 
 #include "render/diskmanager.h"
+#include "widget/path/pathwidget.h"
 #include "widget/slider/floatslider.h"
 
 namespace olive {
@@ -44,13 +49,29 @@ private:
 
   FloatSlider* maximum_cache_slider_;
 
+  QComboBox* encoding_combo_;
+
+  QListWidget* stripe_list_;
+
   QCheckBox* clear_disk_cache_;
 
   QPushButton* clear_cache_btn_;
 
+  PathWidget* remote_cache_path_;
+
+  QLabel* remote_cache_stats_lbl_;
+
+  QTimer remote_cache_stats_timer_;
+
 private slots:
   void ClearDiskCache();
 
+  void AddStripe();
+
+  void RemoveStripe();
+
+  void UpdateRemoteCacheStatistics();
+
 };
 
 }
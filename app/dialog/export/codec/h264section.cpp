@@ -71,8 +71,6 @@ H264Section::H264Section(QWidget *parent) :
 
 void H264Section::AddOpts(EncodingParams *params)
 {
-  // FIXME: Implement two-pass
-
   CompressionMethod method = static_cast<CompressionMethod>(compression_method_stack_->currentIndex());
 
   if (method == kConstantRateFactor) {
@@ -101,6 +99,9 @@ void H264Section::AddOpts(EncodingParams *params)
     params->set_video_max_bit_rate(max_rate);
     params->set_video_buffer_size(2000000);
 
+    // Only bit rate targets benefit from a first pass, CRF already distributes quality evenly
+    params->set_video_two_pass((method == kTargetBitRate) ? bitrate_section_->IsTwoPass() : filesize_section_->IsTwoPass());
+
   }
 }
 
@@ -159,8 +160,8 @@ H264BitRateSection::H264BitRateSection(QWidget *parent) :
 
   layout->addWidget(new QLabel(tr("Two-Pass")), row, 0);
 
-  QCheckBox* two_pass_box = new QCheckBox();
-  layout->addWidget(two_pass_box, row, 1);
+  two_pass_box_ = new QCheckBox();
+  layout->addWidget(two_pass_box_, row, 1);
 
   // Bit rate defaults
   target_rate_->SetValue(16.0);
@@ -177,6 +178,11 @@ int64_t H264BitRateSection::GetMaximumBitRate() const
   return qRound64(max_rate_->GetValue() * 1000000.0);
 }
 
+bool H264BitRateSection::IsTwoPass() const
+{
+  return two_pass_box_->isChecked();
+}
+
 H264FileSizeSection::H264FileSizeSection(QWidget *parent) :
   QWidget(parent)
 {
@@ -195,8 +201,8 @@ H264FileSizeSection::H264FileSizeSection(QWidget *parent) :
 
   layout->addWidget(new QLabel(tr("Two-Pass")), row, 0);
 
-  QCheckBox* two_pass_box = new QCheckBox();
-  layout->addWidget(two_pass_box, row, 1);
+  two_pass_box_ = new QCheckBox();
+  layout->addWidget(two_pass_box_, row, 1);
 
   // File size defaults
   file_size_->SetValue(700.0);
@@ -208,4 +214,9 @@ int64_t H264FileSizeSection::GetFileSize() const
   return qRound64(file_size_->GetValue() * 1024.0 * 1024.0 * 8.0);
 }
 
+bool H264FileSizeSection::IsTwoPass() const
+{
+  return two_pass_box_->isChecked();
+}
+
 }
@@ -21,6 +21,7 @@
 #ifndef H264SECTION_H
 #define H264SECTION_H
 
+#include <QCheckBox>
 #include <QSlider>
 #include <QStackedWidget>
 
@@ -64,11 +65,15 @@ public:
    */
   int64_t GetMaximumBitRate() const;
 
+  bool IsTwoPass() const;
+
 private:
   FloatSlider* target_rate_;
 
   FloatSlider* max_rate_;
 
+  QCheckBox* two_pass_box_;
+
 };
 
 class H264FileSizeSection : public QWidget
@@ -82,9 +87,13 @@ public:
    */
   int64_t GetFileSize() const;
 
+  bool IsTwoPass() const;
+
 private:
   FloatSlider* file_size_;
 
+  QCheckBox* two_pass_box_;
+
 };
 
 class H264Section : public CodecSection
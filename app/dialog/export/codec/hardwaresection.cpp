@@ -0,0 +1,128 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "hardwaresection.h"
+
+#include <QGridLayout>
+#include <QLabel>
+#include <QStandardItemModel>
+
+namespace olive {
+
+HardwareSection::HardwareSection(QWidget *parent) :
+  CodecSection(parent),
+  codec_(ExportCodec::kCodecH264NVENC)
+{
+  QGridLayout* layout = new QGridLayout(this);
+  layout->setMargin(0);
+
+  int row = 0;
+
+  layout->addWidget(new QLabel(tr("Compression Method:")), row, 0);
+
+  compression_box_ = new QComboBox();
+
+  // These items must correspond to the CompressionMethod enum
+  compression_box_->addItem(tr("Constant Quality"));
+  compression_box_->addItem(tr("Target Bit Rate"));
+
+  layout->addWidget(compression_box_, row, 1);
+
+  row++;
+
+  compression_method_stack_ = new QStackedWidget();
+  layout->addWidget(compression_method_stack_, row, 0, 1, 2);
+
+  quality_section_ = new H264CRFSection();
+  compression_method_stack_->addWidget(quality_section_);
+
+  bitrate_section_ = new H264BitRateSection();
+  compression_method_stack_->addWidget(bitrate_section_);
+
+  connect(compression_box_,
+          static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+          compression_method_stack_,
+          &QStackedWidget::setCurrentIndex);
+}
+
+void HardwareSection::SetCodec(ExportCodec::Codec c)
+{
+  codec_ = c;
+
+  bool cq = SupportsConstantQuality(c);
+
+  // Disable constant quality for backends that only do bit rate control
+  QStandardItemModel* model = static_cast<QStandardItemModel*>(compression_box_->model());
+  model->item(kConstantQuality)->setEnabled(cq);
+
+  if (!cq) {
+    compression_box_->setCurrentIndex(kTargetBitRate);
+  }
+}
+
+void HardwareSection::AddOpts(EncodingParams *params)
+{
+  CompressionMethod method = static_cast<CompressionMethod>(compression_method_stack_->currentIndex());
+
+  if (method == kConstantQuality && SupportsConstantQuality(codec_)) {
+    QString quality = QString::number(quality_section_->GetValue());
+
+    switch (codec_) {
+    case ExportCodec::kCodecH264NVENC:
+    case ExportCodec::kCodecH265NVENC:
+      params->set_video_option(QStringLiteral("rc"), QStringLiteral("vbr"));
+      params->set_video_option(QStringLiteral("cq"), quality);
+      break;
+    case ExportCodec::kCodecH264QSV:
+    case ExportCodec::kCodecH265QSV:
+      // Intelligent constant quality
+      params->set_video_option(QStringLiteral("global_quality"), quality);
+      break;
+    case ExportCodec::kCodecH264VAAPI:
+    case ExportCodec::kCodecH265VAAPI:
+      params->set_video_option(QStringLiteral("rc_mode"), QStringLiteral("CQP"));
+      params->set_video_option(QStringLiteral("qp"), quality);
+      break;
+    default:
+      break;
+    }
+
+  } else {
+
+    if (codec_ == ExportCodec::kCodecH264NVENC || codec_ == ExportCodec::kCodecH265NVENC) {
+      params->set_video_option(QStringLiteral("rc"), QStringLiteral("vbr"));
+    } else if (codec_ == ExportCodec::kCodecH264VAAPI || codec_ == ExportCodec::kCodecH265VAAPI) {
+      params->set_video_option(QStringLiteral("rc_mode"), QStringLiteral("VBR"));
+    }
+
+    params->set_video_bit_rate(bitrate_section_->GetTargetBitRate());
+    params->set_video_max_bit_rate(bitrate_section_->GetMaximumBitRate());
+    params->set_video_buffer_size(2000000);
+
+  }
+}
+
+bool HardwareSection::SupportsConstantQuality(ExportCodec::Codec c)
+{
+  // VideoToolbox only exposes bit rate control
+  return c != ExportCodec::kCodecH264VideoToolbox && c != ExportCodec::kCodecH265VideoToolbox;
+}
+
+}
@@ -0,0 +1,70 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef HARDWARESECTION_H
+#define HARDWARESECTION_H
+
+#include <QComboBox>
+#include <QStackedWidget>
+
+#include "codec/exportcodec.h"
+#include "h264section.h"
+
+namespace olive {
+
+/**
+ * @brief Rate control settings for hardware H.264/H.265 encoders
+ *
+ * Each hardware backend names its rate control options differently, AddOpts() translates the
+ * user's choice into whichever options the current codec's encoder understands.
+ */
+class HardwareSection : public CodecSection
+{
+  Q_OBJECT
+public:
+  enum CompressionMethod {
+    kConstantQuality,
+    kTargetBitRate
+  };
+
+  HardwareSection(QWidget* parent = nullptr);
+
+  void SetCodec(ExportCodec::Codec c);
+
+  virtual void AddOpts(EncodingParams* params) override;
+
+private:
+  static bool SupportsConstantQuality(ExportCodec::Codec c);
+
+  QComboBox* compression_box_;
+
+  QStackedWidget* compression_method_stack_;
+
+  H264CRFSection* quality_section_;
+
+  H264BitRateSection* bitrate_section_;
+
+  ExportCodec::Codec codec_;
+
+};
+
+}
+
+#endif // HARDWARESECTION_H
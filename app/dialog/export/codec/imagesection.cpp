@@ -36,7 +36,14 @@ ImageSection::ImageSection(QWidget* parent) :
   layout->addWidget(new QLabel(tr("Image Sequence:")), row, 0);
 
   image_sequence_checkbox_ = new QCheckBox();
-  layout->addWidget(new QCheckBox(), row, 1);
+  image_sequence_checkbox_->setChecked(true);
+  layout->addWidget(image_sequence_checkbox_, row, 1);
+}
+
+void ImageSection::AddOpts(EncodingParams *params)
+{
+  params->set_video_option(QStringLiteral("image_sequence"),
+                           QString::number(image_sequence_checkbox_->isChecked()));
 }
 
 QCheckBox *ImageSection::image_sequence_checkbox() const
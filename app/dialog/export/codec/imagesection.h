@@ -33,6 +33,8 @@ class ImageSection : public CodecSection
 public:
   ImageSection(QWidget* parent = nullptr);
 
+  virtual void AddOpts(EncodingParams* params) override;
+
   QCheckBox* image_sequence_checkbox() const;
 
 private:
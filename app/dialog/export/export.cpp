@@ -31,6 +31,7 @@
 #include <QStandardPaths>
 
 #include "common/qtutils.h"
+#include "config/config.h"
 #include "core.h"
 #include "dialog/task/task.h"
 #include "project/item/sequence/sequence.h"
@@ -136,6 +137,17 @@ ExportDialog::ExportDialog(ViewerOutput *viewer_node, TimelinePoints *points, QW
 
   row++;
 
+  // Video can be rendered by workers sharing a folder with this machine
+  render_farm_enabled_ = new QCheckBox(tr("Render Farm:"));
+  preferences_layout->addWidget(render_farm_enabled_, row, 0);
+
+  render_farm_path_ = new PathWidget(Config::Current()["RenderFarmPath"].toString());
+  render_farm_path_->setEnabled(false);
+  connect(render_farm_enabled_, &QCheckBox::toggled, render_farm_path_, &QWidget::setEnabled);
+  preferences_layout->addWidget(render_farm_path_, row, 1, 1, 3);
+
+  row++;
+
   QTabWidget* preferences_tabs = new QTabWidget();
   QScrollArea* video_area = new QScrollArea();
   color_manager_ = static_cast<Sequence*>(viewer_node_->parent())->project()->color_manager();
@@ -306,7 +318,8 @@ void ExportDialog::StartExport()
 
   // Validate video resolution
   if (video_enabled_->isChecked()
-      && video_tab_->GetSelectedCodec() == ExportCodec::kCodecH264
+      && (video_tab_->GetSelectedCodec() == ExportCodec::kCodecH264
+          || ExportCodec::IsCodecHardware(video_tab_->GetSelectedCodec()))
       && (video_tab_->width_slider()->GetValue()%2 != 0 || video_tab_->height_slider()->GetValue()%2 != 0)) {
     QMessageBox b(this);
     b.setIcon(QMessageBox::Critical);
@@ -317,7 +330,36 @@ void ExportDialog::StartExport()
     return;
   }
 
+  Project* project = static_cast<Sequence*>(viewer_node_->parent())->project();
+
+  if (render_farm_enabled_->isChecked() && !QFileInfo(render_farm_path_->text()).isDir()) {
+    QMessageBox b(this);
+    b.setIcon(QMessageBox::Critical);
+    b.setWindowModality(Qt::WindowModal);
+    b.setWindowTitle(tr("Invalid Render Farm"));
+    b.setText(tr("The render farm folder doesn't exist."));
+    b.exec();
+    return;
+  }
+
+  // Workers load the project from disk so it must match what's being exported
+  if (render_farm_enabled_->isChecked()
+      && (project->filename().isEmpty() || project->is_modified())) {
+    QMessageBox b(this);
+    b.setIcon(QMessageBox::Critical);
+    b.setWindowModality(Qt::WindowModal);
+    b.setWindowTitle(tr("Project Not Saved"));
+    b.setText(tr("The project must be saved before it can be exported on a render farm."));
+    b.exec();
+    return;
+  }
+
   ExportTask* task = new ExportTask(viewer_node_, color_manager_, GenerateParams());
+
+  if (render_farm_enabled_->isChecked()) {
+    Config::Current()["RenderFarmPath"] = render_farm_path_->text();
+    task->SetRenderFarm(render_farm_path_->text(), project->filename());
+  }
   TaskDialog* td = new TaskDialog(task, tr("Export"), this);
   connect(td, &TaskDialog::TaskSucceeded, this, &ExportDialog::ExportFinished);
   td->open();
@@ -461,6 +503,7 @@ ExportParams ExportDialog::GenerateParams() const
                                   AudioParams::kInternalFormat);
 
   ExportParams params;
+  params.set_encoder(ExportFormat::GetEncoder(static_cast<ExportFormat::Format>(format_combobox_->currentIndex())));
   params.SetFilename(filename_edit_->text().trimmed());
   params.SetExportLength(viewer_node_->GetLength());
 
@@ -485,6 +528,10 @@ ExportParams ExportDialog::GenerateParams() const
     params.set_color_transform(video_tab_->CurrentOCIOColorSpace());
 
     params.set_video_pix_fmt(video_tab_->pix_fmt());
+
+    params.set_smart_render(video_tab_->smart_render_checkbox()->isChecked());
+
+    params.set_auto_precision(video_tab_->auto_precision_checkbox()->isChecked());
   }
 
   if (audio_enabled_->isChecked()) {
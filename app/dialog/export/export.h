@@ -32,6 +32,7 @@
 #include "exportaudiotab.h"
 #include "exportvideotab.h"
 #include "task/export/export.h"
+#include "widget/path/pathwidget.h"
 #include "widget/viewer/viewer.h"
 
 namespace olive {
@@ -66,6 +67,9 @@ private:
   QCheckBox* video_enabled_;
   QCheckBox* audio_enabled_;
 
+  QCheckBox* render_farm_enabled_;
+  PathWidget* render_farm_path_;
+
   ViewerWidget* preview_viewer_;
   QLineEdit* filename_edit_;
   QComboBox* format_combobox_;
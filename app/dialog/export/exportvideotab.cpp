@@ -122,6 +122,14 @@ QWidget* ExportVideoTab::SetupResolutionSection()
   pixel_format_field_ = new PixelFormatComboBox(true);
   layout->addWidget(pixel_format_field_, row, 1);
 
+  row++;
+
+  layout->addWidget(new QLabel(tr("Automatic Precision:")), row, 0);
+
+  auto_precision_checkbox_ = new QCheckBox();
+  auto_precision_checkbox_->setToolTip(tr("Render at half float when the output has 10 bits per channel or fewer and nothing in the sequence needs full float"));
+  layout->addWidget(auto_precision_checkbox_, row, 1);
+
   return resolution_group;
 }
 
@@ -161,6 +169,18 @@ QWidget *ExportVideoTab::SetupCodecSection()
   h264_section_ = new H264Section();
   codec_stack_->addWidget(h264_section_);
 
+  hardware_section_ = new HardwareSection();
+  codec_stack_->addWidget(hardware_section_);
+
+  row++;
+
+  codec_layout->addWidget(new QLabel(tr("Smart Render:")), row, 0);
+
+  // Clips already in the export's format can skip the renderer and be copied as-is
+  smart_render_checkbox_ = new QCheckBox();
+  smart_render_checkbox_->setToolTip(tr("Copy unmodified clips that match these settings instead of re-encoding them"));
+  codec_layout->addWidget(smart_render_checkbox_, row, 1);
+
   row++;
 
   QPushButton* advanced_btn = new QPushButton(tr("Advanced"));
@@ -197,6 +217,9 @@ void ExportVideoTab::VideoCodecChanged()
 
   if (codec == ExportCodec::kCodecH264) {
     SetCodecSection(h264_section());
+  } else if (ExportCodec::IsCodecHardware(codec)) {
+    hardware_section()->SetCodec(codec);
+    SetCodecSection(hardware_section());
   } else if (ExportCodec::IsCodecAStillImage(codec)) {
     SetCodecSection(image_section());
   }
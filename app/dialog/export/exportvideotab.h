@@ -27,6 +27,7 @@
 
 #include "common/rational.h"
 #include "dialog/export/codec/h264section.h"
+#include "dialog/export/codec/hardwaresection.h"
 #include "dialog/export/codec/imagesection.h"
 #include "render/colormanager.h"
 #include "widget/colorwheel/colorspacechooser.h"
@@ -101,6 +102,11 @@ public:
     return h264_section_;
   }
 
+  HardwareSection* hardware_section() const
+  {
+    return hardware_section_;
+  }
+
   InterlacedComboBox* interlaced_combobox() const
   {
     return interlaced_combobox_;
@@ -116,6 +122,16 @@ public:
     return pixel_format_field_;
   }
 
+  QCheckBox* smart_render_checkbox() const
+  {
+    return smart_render_checkbox_;
+  }
+
+  QCheckBox* auto_precision_checkbox() const
+  {
+    return auto_precision_checkbox_;
+  }
+
   const int& threads() const
   {
     return threads_;
@@ -144,6 +160,9 @@ private:
   QStackedWidget* codec_stack_;
   ImageSection* image_section_;
   H264Section* h264_section_;
+  HardwareSection* hardware_section_;
+
+  QCheckBox* smart_render_checkbox_;
 
   ColorSpaceChooser* color_space_chooser_;
 
@@ -156,6 +175,8 @@ private:
   PixelAspectRatioComboBox* pixel_aspect_combobox_;
   PixelFormatComboBox* pixel_format_field_;
 
+  QCheckBox* auto_precision_checkbox_;
+
   int threads_;
 
   QString pix_fmt_;
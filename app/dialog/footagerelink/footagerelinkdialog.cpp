@@ -29,11 +29,15 @@
 #include <QScrollBar>
 #include <QVBoxLayout>
 
+#include "dialog/task/task.h"
+#include "task/project/relink/relinktask.h"
+
 namespace olive {
 
-FootageRelinkDialog::FootageRelinkDialog(const QVector<Footage *> &footage, QWidget* parent) :
+FootageRelinkDialog::FootageRelinkDialog(const QVector<Footage *> &footage, QUndoCommand *command, QWidget* parent) :
   QDialog(parent),
-  footage_(footage)
+  footage_(footage),
+  command_(command)
 {
   QVBoxLayout* layout = new QVBoxLayout(this);
 
@@ -76,6 +80,8 @@ FootageRelinkDialog::FootageRelinkDialog(const QVector<Footage *> &footage, QWid
   layout->addWidget(table_);
 
   QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+  QPushButton* search_btn = buttons->addButton(tr("Search Folder..."), QDialogButtonBox::ActionRole);
+  connect(search_btn, &QPushButton::clicked, this, &FootageRelinkDialog::SearchForFootage);
   connect(buttons, &QDialogButtonBox::accepted, this, &FootageRelinkDialog::accept);
   connect(buttons, &QDialogButtonBox::rejected, this, &FootageRelinkDialog::reject);
   layout->addWidget(buttons);
@@ -85,6 +91,14 @@ FootageRelinkDialog::FootageRelinkDialog(const QVector<Footage *> &footage, QWid
 
 }
 
+void FootageRelinkDialog::Relink(int index, const QString &filename, bool valid)
+{
+  RelinkCommand* c = new RelinkCommand(footage_.at(index), filename, valid, command_);
+  c->redo();
+
+  UpdateFootageItem(index);
+}
+
 void FootageRelinkDialog::UpdateFootageItem(int index)
 {
   Footage* f = footage_.at(index);
@@ -112,15 +126,7 @@ void FootageRelinkDialog::BrowseForFootage()
     QDir new_dir = QFileInfo(new_fn).dir();
 
     // Set new filename since this was set manually by the user
-    f->set_filename(new_fn);
-
-    if (Footage::CompareFootageToItsFilename(f)) {
-      // Set footage to valid and update icon
-      f->SetValid();
-
-      // Update item visually
-      UpdateFootageItem(index);
-    }
+    Relink(index, new_fn, Footage::CompareFootageToFile(f, new_fn));
 
     // Check all other footage files for matches
     for (int it=0; it<footage_.size(); it++) {
@@ -135,14 +141,58 @@ void FootageRelinkDialog::BrowseForFootage()
         // Check if file exists
         if (QFileInfo::exists(absolute_to_new)
             && Footage::CompareFootageToFile(other_footage, absolute_to_new)) {
-          other_footage->set_filename(absolute_to_new);
-          other_footage->SetValid();
-          UpdateFootageItem(it);
+          Relink(it, absolute_to_new, true);
         }
       }
     }
   }
 
+  JumpToNextInvalid();
+}
+
+void FootageRelinkDialog::SearchForFootage()
+{
+  QVector<Footage*> offline;
+  QString start_dir;
+
+  foreach (Footage* f, footage_) {
+    if (!f->IsValid()) {
+      offline.append(f);
+
+      if (start_dir.isEmpty()) {
+        start_dir = QFileInfo(f->filename()).absolutePath();
+      }
+    }
+  }
+
+  if (offline.isEmpty()) {
+    return;
+  }
+
+  QString dir = QFileDialog::getExistingDirectory(this, tr("Search Folder for Footage"), start_dir);
+
+  if (dir.isEmpty()) {
+    return;
+  }
+
+  TaskDialog* td = new TaskDialog(new FootageRelinkTask(offline, {dir}), tr("Searching..."), this);
+  connect(td, &TaskDialog::TaskSucceeded, this, &FootageRelinkDialog::SearchFinished);
+  td->open();
+}
+
+void FootageRelinkDialog::SearchFinished(Task *task)
+{
+  FootageRelinkTask* relink_task = static_cast<FootageRelinkTask*>(task);
+
+  foreach (const FootageRelinkTask::Result& r, relink_task->GetResults()) {
+    Relink(footage_.indexOf(r.footage), r.filename, true);
+  }
+
+  JumpToNextInvalid();
+}
+
+void FootageRelinkDialog::JumpToNextInvalid()
+{
   // Check where the next invalid footage is. If there is none, accept automatically. Otherwise,
   // jump to that footage so the user knows where it is.
   int next_invalid = -1;
@@ -166,4 +216,31 @@ void FootageRelinkDialog::BrowseForFootage()
   }
 }
 
+FootageRelinkDialog::RelinkCommand::RelinkCommand(Footage *footage, const QString &filename, bool valid, QUndoCommand *parent) :
+  UndoCommand(parent),
+  footage_(footage),
+  new_filename_(filename),
+  old_filename_(footage->filename()),
+  new_valid_(valid),
+  old_valid_(footage->IsValid())
+{
+}
+
+Project *FootageRelinkDialog::RelinkCommand::GetRelevantProject() const
+{
+  return footage_->project();
+}
+
+void FootageRelinkDialog::RelinkCommand::redo_internal()
+{
+  footage_->set_filename(new_filename_);
+  footage_->SetValid(new_valid_);
+}
+
+void FootageRelinkDialog::RelinkCommand::undo_internal()
+{
+  footage_->set_filename(old_filename_);
+  footage_->SetValid(old_valid_);
+}
+
 }
@@ -25,6 +25,8 @@
 #include <QTreeWidget>
 
 #include "project/item/footage/footage.h"
+#include "task/task.h"
+#include "undo/undocommand.h"
 
 namespace olive {
 
@@ -32,18 +34,58 @@ class FootageRelinkDialog : public QDialog
 {
   Q_OBJECT
 public:
-  FootageRelinkDialog(const QVector<Footage*>& footage, QWidget* parent = nullptr);
+  /**
+   * @brief FootageRelinkDialog Constructor
+   *
+   * Relinks are added to `command` as children and applied straight away, the caller should push
+   * it once the dialog is accepted so they can be undone together.
+   */
+  FootageRelinkDialog(const QVector<Footage*>& footage, QUndoCommand* command, QWidget* parent = nullptr);
 
 private:
+  class RelinkCommand : public UndoCommand {
+  public:
+    RelinkCommand(Footage* footage, const QString& filename, bool valid, QUndoCommand* parent = nullptr);
+
+    virtual Project* GetRelevantProject() const override;
+
+  protected:
+    virtual void redo_internal() override;
+    virtual void undo_internal() override;
+
+  private:
+    Footage* footage_;
+
+    QString new_filename_;
+    QString old_filename_;
+
+    bool new_valid_;
+    bool old_valid_;
+
+  };
+
+  void Relink(int index, const QString& filename, bool valid);
+
   void UpdateFootageItem(int index);
 
+  /**
+   * @brief Accept if all footage is valid, otherwise select the next invalid footage
+   */
+  void JumpToNextInvalid();
+
   QTreeWidget* table_;
 
   QVector<Footage*> footage_;
 
+  QUndoCommand* command_;
+
 private slots:
   void BrowseForFootage();
 
+  void SearchForFootage();
+
+  void SearchFinished(Task* task);
+
 };
 
 }
@@ -23,8 +23,10 @@
 #include <QGridLayout>
 #include <QLabel>
 #include <QPushButton>
+#include <QThread>
 
 #include "common/autoscroll.h"
+#include "common/threadaffinity.h"
 #include "core.h"
 #include "dialog/sequence/sequence.h"
 #include "project/item/sequence/sequence.h"
@@ -97,6 +99,31 @@ PreferencesGeneralTab::PreferencesGeneralTab()
   default_still_length_->SetValue(Config::Current()["DefaultStillLength"].value<rational>().toDouble());
   general_layout->addWidget(default_still_length_);
 
+  row++;
+
+  general_layout->addWidget(new QLabel(tr("Pin Threads to NUMA Nodes:")), row, 0);
+
+  thread_affinity_ = new QCheckBox();
+  thread_affinity_->setToolTip(tr("Keeps render threads and the frames they decode on the same "
+                                  "processor socket. Only affects multi-socket machines and takes "
+                                  "effect after restarting."));
+  thread_affinity_->setChecked(Config::Current()[QStringLiteral("ThreadAffinity")].toBool());
+  if (ThreadAffinity::GetNodeCount() < 2) {
+    thread_affinity_->setEnabled(false);
+  }
+  general_layout->addWidget(thread_affinity_, row, 1);
+
+  row++;
+
+  general_layout->addWidget(new QLabel(tr("Threads Per Decoder:")), row, 0);
+
+  decoder_threads_ = new QSpinBox();
+  decoder_threads_->setMinimum(0);
+  decoder_threads_->setMaximum(QThread::idealThreadCount());
+  decoder_threads_->setSpecialValueText(tr("Auto"));
+  decoder_threads_->setValue(Config::Current()[QStringLiteral("DecoderThreads")].toInt());
+  general_layout->addWidget(decoder_threads_, row, 1);
+
   layout->addStretch();
 }
 
@@ -104,6 +131,10 @@ void PreferencesGeneralTab::Accept()
 {
   Config::Current()[QStringLiteral("RectifiedWaveforms")] = rectified_waveforms_->isChecked();
 
+  Config::Current()[QStringLiteral("ThreadAffinity")] = thread_affinity_->isChecked();
+
+  Config::Current()[QStringLiteral("DecoderThreads")] = decoder_threads_->value();
+
   Config::Current()[QStringLiteral("Autoscroll")] = autoscroll_method_->currentData();
 
   Config::Current()[QStringLiteral("DefaultStillLength")] = QVariant::fromValue(rational::fromDouble(default_still_length_->GetValue()));
@@ -50,6 +50,10 @@ private:
 
   FloatSlider* default_still_length_;
 
+  QCheckBox* thread_affinity_;
+
+  QSpinBox* decoder_threads_;
+
 };
 
 }
@@ -20,7 +20,6 @@
 
 #include "progress.h"
 
-#include <QLabel>
 #include <QMessageBox>
 #include <QPushButton>
 #include <QVBoxLayout>
@@ -50,6 +49,11 @@ ProgressDialog::ProgressDialog(const QString& message, const QString& title, QWi
   elapsed_timer_lbl_ = new ElapsedCounterWidget();
   layout->addWidget(elapsed_timer_lbl_);
 
+  status_lbl_ = new QLabel();
+  status_lbl_->setWordWrap(true);
+  status_lbl_->setVisible(false);
+  layout->addWidget(status_lbl_);
+
   QHBoxLayout* cancel_layout = new QHBoxLayout();
   layout->addLayout(cancel_layout);
   cancel_layout->setMargin(0);
@@ -105,6 +109,12 @@ void ProgressDialog::SetProgress(double value)
   Core::instance()->main_window()->SetApplicationProgressValue(percent);
 }
 
+void ProgressDialog::SetStatus(const QString &status)
+{
+  status_lbl_->setText(status);
+  status_lbl_->setVisible(true);
+}
+
 void ProgressDialog::ShowErrorMessage(const QString &title, const QString &message)
 {
   Core::instance()->main_window()->SetApplicationProgressStatus(MainWindow::kProgressError);
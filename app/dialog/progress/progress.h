@@ -22,6 +22,7 @@
 #define PROGRESSDIALOG_H
 
 #include <QDialog>
+#include <QLabel>
 #include <QProgressBar>
 
 #include "common/debug.h"
@@ -43,6 +44,11 @@ protected:
 public slots:
   void SetProgress(double value);
 
+  /**
+   * @brief Show extra information below the progress bar, hidden until this is first called
+   */
+  void SetStatus(const QString& status);
+
 signals:
   void Cancelled();
 
@@ -54,6 +60,8 @@ private:
 
   ElapsedCounterWidget* elapsed_timer_lbl_;
 
+  QLabel* status_lbl_;
+
   bool show_progress_;
 
 private slots:
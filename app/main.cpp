@@ -40,6 +40,7 @@ extern "C" {
 #include "core.h"
 #include "common/commandlineparser.h"
 #include "common/debug.h"
+#include "render/rendermanager.h"
 
 #ifdef USE_CRASHPAD
 #include "common/crashpadinterface.h"
@@ -92,6 +93,86 @@ int main(int argc, char *argv[])
       parser.AddOption({QStringLiteral("x"), QStringLiteral("-export")},
                        QCoreApplication::translate("main", "Export only (No GUI)"));
 
+  const CommandLineParser::Option* benchmark_option =
+      parser.AddOption({QStringLiteral("b"), QStringLiteral("-benchmark")},
+                       QCoreApplication::translate("main", "Benchmark project and quit (No GUI)"));
+
+  const CommandLineParser::Option* microbenchmark_option =
+      parser.AddOption({QStringLiteral("-microbenchmark")},
+                       QCoreApplication::translate("main", "Benchmark core primitives on synthetic data and quit (No GUI)"));
+
+  const CommandLineParser::Option* stress_project_option =
+      parser.AddOption({QStringLiteral("-generate-stress-project")},
+                       QCoreApplication::translate("main", "Generate a synthetic project for scaling benchmarks and quit (No GUI)"),
+                       true,
+                       QCoreApplication::translate("main", "project-file"));
+
+  const CommandLineParser::Option* stress_params_option =
+      parser.AddOption({QStringLiteral("-stress-params")},
+                       QCoreApplication::translate("main", "Size of the generated project, e.g. video_tracks=8,blocks=500,effects=4,keyframes=32,nesting=2"),
+                       true,
+                       QCoreApplication::translate("main", "params"));
+
+  const CommandLineParser::Option* record_renders_option =
+      parser.AddOption({QStringLiteral("-record-renders")},
+                       QCoreApplication::translate("main", "Log every render request of this session for replaying with --replay-renders"),
+                       true,
+                       QCoreApplication::translate("main", "log-file"));
+
+  const CommandLineParser::Option* replay_renders_option =
+      parser.AddOption({QStringLiteral("-replay-renders")},
+                       QCoreApplication::translate("main", "Replay a render log against the project and report latencies (No GUI)"),
+                       true,
+                       QCoreApplication::translate("main", "log-file"));
+
+  const CommandLineParser::Option* benchmark_output_option =
+      parser.AddOption({QStringLiteral("-benchmark-output")},
+                       QCoreApplication::translate("main", "Write benchmark results to file instead of stdout"),
+                       true,
+                       QCoreApplication::translate("main", "json-file"));
+
+  const CommandLineParser::Option* farm_worker_option =
+      parser.AddOption({QStringLiteral("-farm-worker")},
+                       QCoreApplication::translate("main", "Render chunks of exports submitted to a render farm folder (No GUI)"),
+                       true,
+                       QCoreApplication::translate("main", "folder"));
+
+  const CommandLineParser::Option* render_server_option =
+      parser.AddOption({QStringLiteral("-render-server")},
+                       QCoreApplication::translate("main", "Accept export jobs on a local socket until told to quit (No GUI)"),
+                       true,
+                       QCoreApplication::translate("main", "socket-name"));
+
+  const CommandLineParser::Option* headless_gpu_option =
+      parser.AddOption({QStringLiteral("-headless-gpu")},
+                       QCoreApplication::translate("main", "Render on the GPU through EGL without a display server (with --export, --benchmark, --farm-worker or --render-server)"));
+
+  const CommandLineParser::Option* render_device_option =
+      parser.AddOption({QStringLiteral("-render-device")},
+                       QCoreApplication::translate("main", "Render on this GPU, an index or PCI tag (Mesa drivers only, run one --farm-worker per GPU to use several)"),
+                       true,
+                       QCoreApplication::translate("main", "device"));
+
+  const CommandLineParser::Option* software_render_option =
+      parser.AddOption({QStringLiteral("-software-render")},
+                       QCoreApplication::translate("main", "Render on the CPU without a GPU (with --export, --benchmark, --farm-worker or --render-server)"));
+
+  const CommandLineParser::Option* trace_option =
+      parser.AddOption({QStringLiteral("-trace")},
+                       QCoreApplication::translate("main", "Record render trace and save it to file on exit"),
+                       true,
+                       QCoreApplication::translate("main", "json-file"));
+
+  const CommandLineParser::Option* profile_locks_option =
+      parser.AddOption({QStringLiteral("-profile-locks")},
+                       QCoreApplication::translate("main", "Record wait and hold times of render locks, logged on exit and served with --metrics-port"));
+
+  const CommandLineParser::Option* metrics_port_option =
+      parser.AddOption({QStringLiteral("-metrics-port")},
+                       QCoreApplication::translate("main", "Serve Prometheus metrics over HTTP on this port (with --export, --benchmark, --farm-worker or --render-server)"),
+                       true,
+                       QCoreApplication::translate("main", "port"));
+
   const CommandLineParser::Option* ts_option =
       parser.AddOption({QStringLiteral("-ts")},
                        QCoreApplication::translate("main", "Override language with file"),
@@ -120,6 +201,108 @@ int main(int argc, char *argv[])
     startup_params.set_run_mode(olive::Core::CoreParams::kHeadlessExport);
   }
 
+  if (benchmark_option->IsSet()) {
+    startup_params.set_run_mode(olive::Core::CoreParams::kHeadlessBenchmark);
+    startup_params.set_benchmark_output(benchmark_output_option->GetSetting());
+  }
+
+  if (stress_project_option->IsSet()) {
+    if (stress_project_option->GetSetting().isEmpty()) {
+      qWarning() << "--generate-stress-project was set but no output file was provided";
+    } else {
+      startup_params.set_run_mode(olive::Core::CoreParams::kHeadlessStressProject);
+      startup_params.set_stress_project_output(stress_project_option->GetSetting());
+      startup_params.set_stress_project_params(stress_params_option->GetSetting());
+    }
+  }
+
+  if (replay_renders_option->IsSet()) {
+    if (replay_renders_option->GetSetting().isEmpty()) {
+      qWarning() << "--replay-renders was set but no log file was provided";
+    } else {
+      startup_params.set_run_mode(olive::Core::CoreParams::kHeadlessRenderReplay);
+      startup_params.set_render_replay_log(replay_renders_option->GetSetting());
+      startup_params.set_benchmark_output(benchmark_output_option->GetSetting());
+    }
+  }
+
+  if (record_renders_option->IsSet()) {
+    if (record_renders_option->GetSetting().isEmpty()) {
+      qWarning() << "--record-renders was set but no log file was provided";
+    } else {
+      startup_params.set_render_log_output(record_renders_option->GetSetting());
+    }
+  }
+
+  if (microbenchmark_option->IsSet()) {
+    startup_params.set_run_mode(olive::Core::CoreParams::kHeadlessMicrobenchmark);
+    startup_params.set_benchmark_output(benchmark_output_option->GetSetting());
+  }
+
+  if (farm_worker_option->IsSet()) {
+    startup_params.set_run_mode(olive::Core::CoreParams::kHeadlessRenderFarm);
+    startup_params.set_render_farm_path(farm_worker_option->GetSetting());
+  }
+
+  if (render_server_option->IsSet()) {
+    if (render_server_option->GetSetting().isEmpty()) {
+      qWarning() << "--render-server was set but no socket name was provided";
+    } else {
+      startup_params.set_run_mode(olive::Core::CoreParams::kHeadlessRenderServer);
+      startup_params.set_render_server_name(render_server_option->GetSetting());
+    }
+  }
+
+  if (headless_gpu_option->IsSet()) {
+    if (startup_params.run_mode() == olive::Core::CoreParams::kRunNormal) {
+      qWarning() << "--headless-gpu only applies to exports, benchmarks, render farm workers and render servers, ignoring";
+    } else {
+      startup_params.set_headless_gpu(true);
+      olive::RenderManager::PrepareHeadlessPlatform();
+    }
+  }
+
+  if (render_device_option->IsSet()) {
+    if (render_device_option->GetSetting().isEmpty()) {
+      qWarning() << "--render-device was set but no device was provided";
+    } else {
+      olive::RenderManager::SelectRenderDevice(render_device_option->GetSetting());
+    }
+  }
+
+  if (software_render_option->IsSet()) {
+    if (startup_params.run_mode() == olive::Core::CoreParams::kRunNormal) {
+      qWarning() << "--software-render only applies to exports, benchmarks, render farm workers and render servers, ignoring";
+    } else {
+      startup_params.set_software_render(true);
+    }
+  }
+
+  if (trace_option->IsSet()) {
+    if (trace_option->GetSetting().isEmpty()) {
+      qWarning() << "--trace was set but no output file was provided";
+    } else {
+      startup_params.set_trace_output(trace_option->GetSetting());
+    }
+  }
+
+  if (profile_locks_option->IsSet()) {
+    startup_params.set_profile_locks(true);
+  }
+
+  if (metrics_port_option->IsSet()) {
+    bool ok;
+    int port = metrics_port_option->GetSetting().toInt(&ok);
+
+    if (startup_params.run_mode() == olive::Core::CoreParams::kRunNormal) {
+      qWarning() << "--metrics-port only applies to exports, benchmarks, render farm workers and render servers, ignoring";
+    } else if (!ok || port <= 0 || port > 65535) {
+      qWarning() << "--metrics-port was set but" << metrics_port_option->GetSetting() << "isn't a valid port";
+    } else {
+      startup_params.set_metrics_port(port);
+    }
+  }
+
   if (ts_option->IsSet()) {
     if (ts_option->GetSetting().isEmpty()) {
       qWarning() << "--ts was set but no translation file was provided";
@@ -147,8 +330,17 @@ int main(int argc, char *argv[])
   format.setOption(QSurfaceFormat::DeprecatedFunctions);
 
   format.setDepthBufferSize(24);
+
+  // Swap on vsync so the viewer's frameSwapped signal ticks once per display refresh, playback
+  // paces itself on it
+  format.setSwapInterval(1);
+
   QSurfaceFormat::setDefaultFormat(format);
 
+  // Let display widgets share textures with the renderers so previews can be drawn straight from
+  // the GPU
+  QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
+
   // Enable application automatically using higher resolution images from icons
   QCoreApplication::setAttribute(Qt::AA_UseHighDpiPixmaps);
 
@@ -157,6 +349,14 @@ int main(int argc, char *argv[])
 
   if (startup_params.run_mode() == olive::Core::CoreParams::kRunNormal) {
     a.reset(new QApplication(argc, argv));
+  } else if (startup_params.run_mode() == olive::Core::CoreParams::kHeadlessBenchmark
+             || startup_params.run_mode() == olive::Core::CoreParams::kHeadlessRenderFarm
+             || startup_params.run_mode() == olive::Core::CoreParams::kHeadlessRenderServer
+             || startup_params.run_mode() == olive::Core::CoreParams::kHeadlessRenderReplay
+             || startup_params.headless_gpu()) {
+    // Rendering still needs a GUI application for OpenGL. If there's no display, --headless-gpu
+    // has set up a platform plugin that doesn't need one.
+    a.reset(new QGuiApplication(argc, argv));
   } else {
     a.reset(new QCoreApplication(argc, argv));
   }
@@ -108,6 +108,35 @@ void PanNode::ProcessSamples(NodeValueDatabase &values, const SampleBufferPtr in
   }
 }
 
+bool PanNode::ProcessSampleBlock(const SampleParamCurveMap &params, const SampleBufferPtr input, SampleBufferPtr output) const
+{
+  if (input->audio_params().channel_count() != 2) {
+    // This node currently only works for stereo audio, the per-sample path handles this case
+    return false;
+  }
+
+  SampleParamCurve pan = params.value(panning_input_->id());
+
+  if (!pan.IsValid()) {
+    return false;
+  }
+
+  const float* in_left = input->data()[0];
+  const float* in_right = input->data()[1];
+  float* out_left = output->data()[0];
+  float* out_right = output->data()[1];
+
+  // Branchless form of ProcessSamples() so the loop can be vectorized
+  for (int i=0;i<output->sample_count();i++) {
+    float pan_val = pan.IsConstant() ? pan.at(0) : pan.data()[i];
+
+    out_left[i] = in_left[i] * (1.0F - qMax(pan_val, 0.0F));
+    out_right[i] = in_right[i] * (1.0F + qMin(pan_val, 0.0F));
+  }
+
+  return true;
+}
+
 void PanNode::Retranslate()
 {
   samples_input_->set_name(tr("Samples"));
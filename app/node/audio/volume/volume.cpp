@@ -75,6 +75,11 @@ void VolumeNode::ProcessSamples(NodeValueDatabase &values, const SampleBufferPtr
   return ProcessSamplesInternal(values, kOpMultiply, samples_input_, volume_input_, input, output, index);
 }
 
+bool VolumeNode::ProcessSampleBlock(const SampleParamCurveMap &params, const SampleBufferPtr input, SampleBufferPtr output) const
+{
+  return ProcessSampleBlockInternal(params, kOpMultiply, samples_input_, volume_input_, input, output);
+}
+
 void VolumeNode::Retranslate()
 {
   samples_input_->set_name(tr("Samples"));
@@ -42,6 +42,8 @@ public:
 
   virtual void ProcessSamples(NodeValueDatabase &values, const SampleBufferPtr input, SampleBufferPtr output, int index) const override;
 
+  virtual bool ProcessSampleBlock(const SampleParamCurveMap &params, const SampleBufferPtr input, SampleBufferPtr output) const override;
+
   virtual void Retranslate() override;
 
   NodeInput* samples_input() const
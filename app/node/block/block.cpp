@@ -21,12 +21,15 @@
 #include "block.h"
 
 #include <QDebug>
+#include <QtMath>
 
 #include "node/output/track/track.h"
 #include "transition/transition.h"
 
 namespace olive {
 
+const double Block::kSpeedIntegrationStep = 0.01;
+
 Block::Block() :
   previous_(nullptr),
   next_(nullptr)
@@ -179,8 +182,10 @@ rational Block::SequenceToMediaTime(const rational &sequence_time) const
   rational local_time = sequence_time - in();
 
   // FIXME: Doesn't handle reversing
-  if (speed_input_->is_keyframing() || speed_input_->is_connected()) {
+  if (speed_input_->is_connected()) {
     // FIXME: We'll need to calculate the speed hoo boy
+  } else if (speed_input_->is_keyframing()) {
+    local_time = rational::fromDouble(IntegrateSpeed(in(), sequence_time));
   } else {
     double speed_value = speed_input_->get_standard_value().toDouble();
 
@@ -206,8 +211,10 @@ rational Block::MediaToSequenceTime(const rational &media_time) const
   rational sequence_time = media_time - media_in();
 
   // FIXME: Doesn't handle reversing
-  if (speed_input_->is_keyframing() || speed_input_->is_connected()) {
+  if (speed_input_->is_connected()) {
     // FIXME: We'll need to calculate the speed hoo boy
+  } else if (speed_input_->is_keyframing()) {
+    sequence_time = MediaOffsetToSequenceTime(sequence_time.toDouble()) - in();
   } else {
     double speed_value = speed_input_->get_standard_value().toDouble();
 
@@ -223,6 +230,75 @@ rational Block::MediaToSequenceTime(const rational &media_time) const
   return sequence_time + in();
 }
 
+double Block::IntegrateSpeed(const rational &from, const rational &to) const
+{
+  double a = from.toDouble();
+  double b = to.toDouble();
+
+  if (b < a) {
+    return -IntegrateSpeed(to, from);
+  } else if (b == a) {
+    return 0;
+  }
+
+  int steps = qMax(1, qCeil((b - a) / kSpeedIntegrationStep));
+  double h = (b - a) / steps;
+
+  QVector<rational> times(steps + 1);
+  for (int i=0; i<=steps; i++) {
+    times[i] = rational::fromDouble(a + h * i);
+  }
+
+  QVector<QVariant> speeds = speed_input_->get_values_at_times(times);
+
+  // Trapezoid rule, negative speeds would mean reversing which we don't handle yet so they hold
+  double played = 0;
+  for (int i=0; i<steps; i++) {
+    played += (qMax(0.0, speeds.at(i).toDouble()) + qMax(0.0, speeds.at(i + 1).toDouble())) * 0.5 * h;
+  }
+
+  return played;
+}
+
+rational Block::MediaOffsetToSequenceTime(double offset) const
+{
+  double a = in().toDouble();
+
+  if (offset < 0) {
+    // Before the in point, continue back at the first speed
+    double first = speed_input_->get_value_at_time(in()).toDouble();
+    return (qFuzzyIsNull(first) || first < 0) ? in() : rational::fromDouble(a + offset / first);
+  }
+
+  double b = qMax(out().toDouble(), a + kSpeedIntegrationStep);
+  int steps = qCeil((b - a) / kSpeedIntegrationStep);
+  double h = (b - a) / steps;
+
+  QVector<rational> times(steps + 1);
+  for (int i=0; i<=steps; i++) {
+    times[i] = rational::fromDouble(a + h * i);
+  }
+
+  QVector<QVariant> speeds = speed_input_->get_values_at_times(times);
+
+  // Walk forward from the in point until enough media has played
+  double played = 0;
+  for (int i=0; i<steps; i++) {
+    double step_played = (qMax(0.0, speeds.at(i).toDouble()) + qMax(0.0, speeds.at(i + 1).toDouble())) * 0.5 * h;
+
+    if (played + step_played >= offset) {
+      double f = qFuzzyIsNull(step_played) ? 0 : (offset - played) / step_played;
+      return rational::fromDouble(a + h * (i + f));
+    }
+
+    played += step_played;
+  }
+
+  // Past the out point, continue at the last speed
+  double last = speeds.last().toDouble();
+  return (qFuzzyIsNull(last) || last < 0) ? rational::fromDouble(b) : rational::fromDouble(b + (offset - played) / last);
+}
+
 void Block::LoadInternal(QXmlStreamReader *reader, XMLNodeData &xml_node_data)
 {
   while (XMLReadNextStartElement(reader)) {
@@ -122,6 +122,21 @@ protected:
 private:
   void set_length_internal(const rational &length);
 
+  /**
+   * @brief Returns how many seconds of media play between two sequence times with keyframed speed
+   *
+   * Speed is sampled every kSpeedIntegrationStep seconds and integrated with the trapezoid rule.
+   */
+  double IntegrateSpeed(const rational& from, const rational& to) const;
+
+  /**
+   * @brief Inverse of IntegrateSpeed() from the in point, returns the sequence time at which
+   * `offset` seconds of media have played
+   */
+  rational MediaOffsetToSequenceTime(double offset) const;
+
+  static const double kSpeedIntegrationStep;
+
   NodeInput* length_input_;
   NodeInput* media_in_input_;
   NodeInput* speed_input_;
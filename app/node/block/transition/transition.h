@@ -59,6 +59,17 @@ public:
 protected:
   virtual void ShaderJobEvent(NodeValueDatabase &value, ShaderJob& job) const;
 
+  virtual bool HashIsTimeInvariant() const override
+  {
+    // Transition progress is part of the hash
+    return false;
+  }
+
+  virtual bool HashIsConstantOver(const TimeRange&) const override
+  {
+    return false;
+  }
+
   virtual void SampleJobEvent(SampleBufferPtr from_samples, SampleBufferPtr to_samples, SampleBufferPtr out_samples, double time_in) const;
 
   double TransformCurve(double linear) const;
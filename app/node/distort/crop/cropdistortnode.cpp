@@ -88,6 +88,19 @@ NodeValueTable CropDistortNode::Value(NodeValueDatabase &value) const
         || !qIsNull(job.GetValue(right_input_).data.toDouble())
         || !qIsNull(job.GetValue(top_input_).data.toDouble())
         || !qIsNull(job.GetValue(bottom_input_).data.toDouble())) {
+      // Everything outside the crop (and its feathering) is transparent, so it doesn't need to run
+      QVector2D resolution = job.GetValue(QStringLiteral("resolution_in")).data.value<QVector2D>();
+      double feather = job.GetValue(feather_input_).data.toDouble();
+      double feather_x = qIsNull(resolution.x()) ? 0.0 : feather / resolution.x();
+      double feather_y = qIsNull(resolution.y()) ? 0.0 : feather / resolution.y();
+
+      QRectF bounds(QPointF(job.GetValue(left_input_).data.toDouble() - feather_x,
+                            job.GetValue(top_input_).data.toDouble() - feather_y),
+                    QPointF(1.0 - job.GetValue(right_input_).data.toDouble() + feather_x,
+                            1.0 - job.GetValue(bottom_input_).data.toDouble() + feather_y));
+
+      job.SetBounds(bounds & QRectF(0, 0, 1, 1));
+
       table.Push(NodeParam::kShaderJob, QVariant::fromValue(job), this);
     } else {
       table.Push(NodeParam::kTexture, job.GetValue(texture_input_).data, this);
@@ -265,4 +278,18 @@ void CropDistortNode::GizmoRelease()
   gizmo_start_.clear();
 }
 
+bool CropDistortNode::GetGizmoImageGeometry(NodeValueDatabase &db, QTransform *transform, QRectF *clip)
+{
+  QVector2D resolution = db[QStringLiteral("global")].Get(NodeParam::kVec2, QStringLiteral("resolution")).value<QVector2D>();
+
+  // The image doesn't move, only how much of it shows. Feathering isn't approximated.
+  *transform = QTransform();
+  *clip = QRectF(QPointF(resolution.x() * db[left_input_].Get(NodeParam::kFloat).toDouble(),
+                         resolution.y() * db[top_input_].Get(NodeParam::kFloat).toDouble()),
+                 QPointF(resolution.x() * (1.0 - db[right_input_].Get(NodeParam::kFloat).toDouble()),
+                         resolution.y() * (1.0 - db[bottom_input_].Get(NodeParam::kFloat).toDouble())));
+
+  return true;
+}
+
 }
@@ -74,6 +74,7 @@ public:
   virtual bool GizmoPress(NodeValueDatabase& db, const QPointF &p) override;
   virtual void GizmoMove(const QPointF &p, const rational &time) override;
   virtual void GizmoRelease() override;
+  virtual bool GetGizmoImageGeometry(NodeValueDatabase& db, QTransform* transform, QRectF* clip) override;
 
 private:
   NodeInput* texture_input_;
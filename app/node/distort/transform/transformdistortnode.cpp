@@ -308,6 +308,34 @@ void TransformDistortNode::GizmoRelease()
   gizmo_drag_ = nullptr;
 }
 
+bool TransformDistortNode::GetGizmoImageGeometry(NodeValueDatabase &db, QTransform *transform, QRectF *clip)
+{
+  Q_UNUSED(clip)
+
+  QVector2D sequence_res = db[QStringLiteral("global")].Get(NodeParam::kVec2, QStringLiteral("resolution")).value<QVector2D>();
+  QVector2D tex_sz = db[texture_input_].Get(NodeParam::kTexture).value<QVector2D>();
+
+  if (tex_sz.isNull() || sequence_res.isNull()) {
+    return false;
+  }
+
+  AutoScaleType autoscale = static_cast<AutoScaleType>(db[autoscale_input_].Get(NodeParam::kCombo).toInt());
+
+  // Same as the rectangle in DrawGizmos(), the image is approximated as moving with it
+  QVector2D sequence_half_res = sequence_res/2;
+  QMatrix4x4 image_matrix;
+  image_matrix.translate(sequence_half_res.x(), sequence_half_res.y());
+  image_matrix.scale(sequence_half_res);
+  image_matrix *= AdjustMatrixByResolutions(GenerateMatrix(db, false, false, false, false),
+                                            sequence_res,
+                                            tex_sz,
+                                            autoscale);
+
+  *transform = image_matrix.toTransform();
+
+  return transform->isInvertible();
+}
+
 QMatrix4x4 TransformDistortNode::AdjustMatrixByResolutions(const QMatrix4x4 &mat, const QVector2D &sequence_res, const QVector2D &texture_res, AutoScaleType autoscale_type)
 {
   // First, create an identity matrix
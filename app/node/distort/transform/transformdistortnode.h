@@ -67,6 +67,12 @@ public:
 
   virtual ShaderCode GetShaderCode(const QString& shader_id) const override;
 
+  virtual int GetRegionOfInterestMargin() const override
+  {
+    // The matrix can bring any part of the input into view
+    return -1;
+  }
+
   virtual bool HasGizmos() const override
   {
     return true;
@@ -77,6 +83,7 @@ public:
   virtual bool GizmoPress(NodeValueDatabase& db, const QPointF &p) override;
   virtual void GizmoMove(const QPointF &p, const rational &time) override;
   virtual void GizmoRelease() override;
+  virtual bool GetGizmoImageGeometry(NodeValueDatabase& db, QTransform* transform, QRectF* clip) override;
 
   NodeInput* texture_input() const
   {
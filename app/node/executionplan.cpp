@@ -0,0 +1,76 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "executionplan.h"
+
+#include "node.h"
+#include "output/track/track.h"
+
+namespace olive {
+
+QAtomicInt NodeExecutionPlan::structure_version_(0);
+
+NodeExecutionPlanPtr NodeExecutionPlan::Compile(const Node *root)
+{
+  NodeExecutionPlan* plan = new NodeExecutionPlan();
+
+  // Read version first so any change made while we're compiling makes this plan stale
+  plan->version_ = structure_version_.load();
+
+  QHash<const Node*, int> added;
+  plan->AddStep(root, added);
+
+  return NodeExecutionPlanPtr(plan);
+}
+
+int NodeExecutionPlan::AddStep(const Node *node, QHash<const Node*, int> &added)
+{
+  QHash<const Node*, int>::const_iterator existing = added.constFind(node);
+  if (existing != added.constEnd()) {
+    return existing.value();
+  }
+
+  Step step;
+  step.node = node;
+
+  if (node->IsTrack()) {
+    step.track = static_cast<const TrackOutput*>(node);
+  } else {
+    step.track = nullptr;
+
+    QVector<NodeInput*> inputs = node->GetInputsIncludingArrays();
+    step.inputs.reserve(inputs.size());
+
+    foreach (NodeInput* input, inputs) {
+      Slot slot;
+      slot.input = input;
+      slot.source = input->is_connected() ? AddStep(input->get_connected_node(), added) : -1;
+      step.inputs.append(slot);
+    }
+  }
+
+  steps_.append(step);
+
+  int index = steps_.size() - 1;
+  added.insert(node, index);
+  return index;
+}
+
+}
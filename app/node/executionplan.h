@@ -0,0 +1,125 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NODEEXECUTIONPLAN_H
+#define NODEEXECUTIONPLAN_H
+
+#include <memory>
+#include <QAtomicInt>
+#include <QHash>
+#include <QVector>
+
+namespace olive {
+
+class Node;
+class NodeInput;
+class TrackOutput;
+
+class NodeExecutionPlan;
+using NodeExecutionPlanPtr = std::shared_ptr<const NodeExecutionPlan>;
+
+/**
+ * @brief A node's upstream graph flattened into the order its nodes need processing
+ *
+ * Rather than NodeTraverser recursively walking a node's inputs, looking up their connections
+ * and collecting them for every frame, the walk happens once here. Each step is one node in
+ * post-order (every step's inputs appear before it, the root is last) and refers to the steps
+ * feeding its inputs by index, so executing the plan is two linear passes over an array: one from
+ * the root down to propagate each input's time, and one back up to process the nodes.
+ *
+ * A node reached through more than one path (e.g. a clip feeding several effects that are merged
+ * back together) only gets one step, with every consumer referring to it. NodeTraverser
+ * processes it once for each distinct time its consumers ask for, which is usually just once.
+ * Tracks end the plan at that branch, which block they process depends on the time so they're
+ * handled by NodeTraverser::GenerateBlockTable() when executed.
+ *
+ * Plans only hold pointers into the graph so they're only valid until its structure changes.
+ * Every change to connections or inputs calls StructureChanged(), which makes all existing plans
+ * stale. See Node::GetExecutionPlan() for the cached plan of a node.
+ */
+class NodeExecutionPlan
+{
+public:
+  struct Slot {
+    NodeInput* input;
+
+    /// Index of the step connected to this input, or -1 if it isn't connected
+    int source;
+  };
+
+  struct Step {
+    const Node* node;
+
+    /// If set, this step is a track and has no inputs
+    const TrackOutput* track;
+
+    /// Every input of the node including array sub-inputs, see Node::GetInputsIncludingArrays()
+    QVector<Slot> inputs;
+  };
+
+  /**
+   * @brief Flatten the graph upstream of `root`
+   */
+  static NodeExecutionPlanPtr Compile(const Node* root);
+
+  const QVector<Step>& steps() const
+  {
+    return steps_;
+  }
+
+  /**
+   * @brief Returns TRUE if the graph's structure has changed since this plan was compiled
+   */
+  bool IsStale() const
+  {
+    return version_ != structure_version_.load();
+  }
+
+  /**
+   * @brief Make every existing plan stale
+   *
+   * Must be called whenever an edge is added or removed or a node's inputs change.
+   */
+  static void StructureChanged()
+  {
+    structure_version_.ref();
+  }
+
+private:
+  NodeExecutionPlan() = default;
+
+  /**
+   * @brief Append steps for `node` and everything upstream of it, returning the index of its step
+   *
+   * Nodes that already have a step aren't added again.
+   */
+  int AddStep(const Node* node, QHash<const Node*, int>& added);
+
+  QVector<Step> steps_;
+
+  int version_;
+
+  static QAtomicInt structure_version_;
+
+};
+
+}
+
+#endif // NODEEXECUTIONPLAN_H
@@ -36,6 +36,7 @@
 #include "filter/mosaic/mosaicfilternode.h"
 #include "filter/stroke/stroke.h"
 #include "input/media/media.h"
+#include "input/nested/nestedsequence.h"
 #include "input/time/timeinput.h"
 #include "math/math/math.h"
 #include "math/merge/merge.h"
@@ -45,24 +46,48 @@
 
 namespace olive {
 QList<Node*> NodeFactory::library_;
+QMutex NodeFactory::library_lock_;
 
 void NodeFactory::Initialize()
 {
   Destroy();
 
+  GetLibrary();
+}
+
+const QList<Node *> &NodeFactory::GetLibrary()
+{
+  QMutexLocker locker(&library_lock_);
+
+  if (!library_.isEmpty()) {
+    return library_;
+  }
+
   // Add internal types
   for (int i=0;i<kInternalNodeCount;i++) {
-    library_.append(CreateFromFactoryIndex(static_cast<InternalID>(i)));
+    Node* n = CreateFromFactoryIndex(static_cast<InternalID>(i));
+
+    // The first caller may be a render thread, prototypes belong to the main thread like the nodes
+    // copied from them
+    if (QCoreApplication::instance()) {
+      n->moveToThread(QCoreApplication::instance()->thread());
+    }
+
+    library_.append(n);
   }
 
   /*
   library_.append(new ExternalTransition(":/shaders/crossdissolve.xml"));
   library_.append(new ExternalTransition(":/shaders/diptoblack.xml"));
   */
+
+  return library_;
 }
 
 void NodeFactory::Destroy()
 {
+  QMutexLocker locker(&library_lock_);
+
   qDeleteAll(library_);
   library_.clear();
 }
@@ -72,8 +97,10 @@ Menu *NodeFactory::CreateMenu(QWidget* parent, bool create_none_item, Node::Cate
   Menu* menu = new Menu(parent);
   menu->setToolTipsVisible(true);
 
-  for (int i=0;i<library_.size();i++) {
-    Node* n = library_.at(i);
+  const QList<Node*>& library = GetLibrary();
+
+  for (int i=0;i<library.size();i++) {
+    Node* n = library.at(i);
 
     if (restrict_to != Node::kCategoryUnknown && !n->Category().contains(restrict_to)) {
       // Skip this node
@@ -136,7 +163,7 @@ Node* NodeFactory::CreateFromMenuAction(QAction *action)
     return nullptr;
   }
 
-  return library_.at(index)->copy();
+  return GetLibrary().at(index)->copy();
 }
 
 QString NodeFactory::GetIDFromMenuAction(QAction *action)
@@ -147,13 +174,13 @@ QString NodeFactory::GetIDFromMenuAction(QAction *action)
     return QString();
   }
 
-  return library_.at(action->data().toInt())->id();
+  return GetLibrary().at(action->data().toInt())->id();
 }
 
 QString NodeFactory::GetNameFromID(const QString &id)
 {
   if (!id.isEmpty()) {
-    foreach (Node* n, library_) {
+    foreach (Node* n, GetLibrary()) {
       if (n->id() == id) {
         return n->Name();
       }
@@ -165,7 +192,7 @@ QString NodeFactory::GetNameFromID(const QString &id)
 
 Node *NodeFactory::CreateFromID(const QString &id)
 {
-  foreach (Node* n, library_) {
+  foreach (Node* n, GetLibrary()) {
     if (n->id() == id) {
       return n->copy();
     }
@@ -221,6 +248,8 @@ Node *NodeFactory::CreateFromFactoryIndex(const NodeFactory::InternalID &id)
     return new MosaicFilterNode();
   case kCropDistort:
     return new CropDistortNode();
+  case kNestedSequence:
+    return new NestedSequence();
 
   case kInternalNodeCount:
     break;
@@ -22,6 +22,7 @@
 #define NODEFACTORY_H
 
 #include <QList>
+#include <QMutex>
 
 #include "node.h"
 #include "widget/menu/menu.h"
@@ -54,6 +55,7 @@ public:
     kDipToColorTransition,
     kMosaicFilter,
     kCropDistort,
+    kNestedSequence,
 
     // Count value
     kInternalNodeCount
@@ -61,6 +63,12 @@ public:
 
   NodeFactory() = default;
 
+  /**
+   * @brief Build the prototype of every node type now
+   *
+   * This is optional, the library is built on first use otherwise. That saves startup from
+   * constructing every node type before the main window can appear.
+   */
   static void Initialize();
 
   static void Destroy();
@@ -78,8 +86,17 @@ public:
   static Node* CreateFromFactoryIndex(const InternalID& id);
 
 private:
+  /**
+   * @brief Returns the prototype of every node type, creating them if they haven't been yet
+   *
+   * This function is thread-safe.
+   */
+  static const QList<Node*>& GetLibrary();
+
   static QList<Node*> library_;
 
+  static QMutex library_lock_;
+
 };
 
 }
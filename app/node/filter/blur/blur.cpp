@@ -20,8 +20,13 @@
 
 #include "blur.h"
 
+#include <QtMath>
+
 namespace olive {
 
+const int BlurFilterNode::kSampleBudget[] = {0, 32, 8};
+const int BlurFilterNode::kMaxDownsampleLevel = 6;
+
 BlurFilterNode::BlurFilterNode()
 {
   texture_input_ = new NodeInput("tex_in", NodeParam::kTexture);
@@ -42,6 +47,9 @@ BlurFilterNode::BlurFilterNode()
 
   repeat_edge_pixels_input_ = new NodeInput("repeat_edge_pixels_in", NodeParam::kBoolean, false);
   AddInput(repeat_edge_pixels_input_);
+
+  quality_input_ = new NodeInput("quality_in", NodeParam::kCombo, kQualityBalanced);
+  AddInput(quality_input_);
 }
 
 Node *BlurFilterNode::copy() const
@@ -78,6 +86,8 @@ void BlurFilterNode::Retranslate()
   horiz_input_->set_name(tr("Horizontal"));
   vert_input_->set_name(tr("Vertical"));
   repeat_edge_pixels_input_->set_name(tr("Repeat Edge Pixels"));
+  quality_input_->set_name(tr("Quality"));
+  quality_input_->set_combobox_strings({ tr("Best"), tr("Balanced"), tr("Fast") });
 }
 
 ShaderCode BlurFilterNode::GetShaderCode(const QString &shader_id) const
@@ -96,6 +106,11 @@ NodeValueTable BlurFilterNode::Value(NodeValueDatabase &value) const
   job.InsertValue(horiz_input_, value);
   job.InsertValue(vert_input_, value);
   job.InsertValue(repeat_edge_pixels_input_, value);
+  job.InsertValue(QStringLiteral("lod_in"),
+                  ShaderValue(GetDownsampleLevel(job.GetValue(radius_input_).data.toDouble(),
+                                                 job.GetValue(method_input_).data.toInt(),
+                                                 value[quality_input_].Get(NodeParam::kCombo).toInt()),
+                              NodeParam::kInt));
   job.InsertValue(QStringLiteral("resolution_in"),
                   ShaderValue(value[QStringLiteral("global")].Get(NodeParam::kVec2, QStringLiteral("resolution")), NodeParam::kVec2));
 
@@ -104,13 +119,15 @@ NodeValueTable BlurFilterNode::Value(NodeValueDatabase &value) const
   // If there's no texture, no need to run an operation
   if (!job.GetValue(texture_input_).data.isNull()) {
 
-    // Check if radius > 0, and both "horiz" and/or "vert" are enabled
-    if ((job.GetValue(horiz_input_).data.toBool() || job.GetValue(vert_input_).data.toBool())
-        && job.GetValue(radius_input_).data.toDouble() > 0.0) {
+    int passes = GetPassCount(job.GetValue(horiz_input_).data.toBool(),
+                              job.GetValue(vert_input_).data.toBool(),
+                              job.GetValue(radius_input_).data.toDouble());
 
-      // Set iteration count to 2 if we're blurring both horizontally and vertically
-      if (job.GetValue(horiz_input_).data.toBool() && job.GetValue(vert_input_).data.toBool()) {
-        job.SetIterations(2, texture_input_);
+    if (passes > 0) {
+
+      // The blur is separable, so blurring both ways is a horizontal pass followed by a vertical one
+      if (passes > 1) {
+        job.SetIterations(passes, texture_input_);
       }
 
       // If we're not repeating pixels, expect an alpha channel to appear
@@ -130,4 +147,82 @@ NodeValueTable BlurFilterNode::Value(NodeValueDatabase &value) const
   return table;
 }
 
+void BlurFilterNode::Hash(QCryptographicHash &hash, const rational &time) const
+{
+  Node::Hash(hash, time);
+
+  // The sample budgets aren't inputs, so include what they resolve to in case they ever change
+  if (!radius_input_->is_connected() && !method_input_->is_connected() && !quality_input_->is_connected()) {
+    double radius = radius_input_->get_value_at_time(time).toDouble();
+
+    hash.addData(QByteArray::number(GetDownsampleLevel(radius,
+                                                       method_input_->get_value_at_time(time).toInt(),
+                                                       quality_input_->get_value_at_time(time).toInt())));
+
+    if (!horiz_input_->is_connected() && !vert_input_->is_connected()) {
+      hash.addData(QByteArray::number(GetPassCount(horiz_input_->get_value_at_time(time).toBool(),
+                                                   vert_input_->get_value_at_time(time).toBool(),
+                                                   radius)));
+    }
+  }
+}
+
+int BlurFilterNode::GetRegionOfInterestMargin() const
+{
+  if (!radius_input_->is_static() || !method_input_->is_static() || !quality_input_->is_static()
+      || !horiz_input_->is_static() || !vert_input_->is_static()) {
+    // Could be anything at the time being rendered
+    return -1;
+  }
+
+  double radius = radius_input_->get_standard_value().toDouble();
+  int method = method_input_->get_standard_value().toInt();
+
+  int kernel_radius = qCeil(radius);
+
+  if (method == 1) {
+    kernel_radius *= 3;
+  }
+
+  // Each pass reads the last one's output, and downsampled levels average blocks of pixels
+  int lod = GetDownsampleLevel(radius, method, quality_input_->get_standard_value().toInt());
+  int passes = GetPassCount(horiz_input_->get_standard_value().toBool(),
+                            vert_input_->get_standard_value().toBool(),
+                            radius);
+
+  return (kernel_radius + (1 << lod)) * passes;
+}
+
+int BlurFilterNode::GetDownsampleLevel(double radius, int method, int quality)
+{
+  if (quality < kQualityBest || quality > kQualityFast || kSampleBudget[quality] == 0) {
+    return 0;
+  }
+
+  // The shader takes one (linearly interpolated) sample for every two pixels of its kernel
+  double kernel_radius = qCeil(radius);
+
+  if (method == 1) {
+    // Gaussian kernels extend to three standard deviations (see blur.frag)
+    kernel_radius *= 3.0;
+  }
+
+  if (kernel_radius <= kSampleBudget[quality]) {
+    return 0;
+  }
+
+  int level = qCeil(std::log2(kernel_radius / kSampleBudget[quality]));
+
+  return qMin(level, kMaxDownsampleLevel);
+}
+
+int BlurFilterNode::GetPassCount(bool horiz, bool vert, double radius)
+{
+  if (radius <= 0.0) {
+    return 0;
+  }
+
+  return (horiz ? 1 : 0) + (vert ? 1 : 0);
+}
+
 }
@@ -43,7 +43,38 @@ public:
   virtual ShaderCode GetShaderCode(const QString &shader_id) const override;
   virtual NodeValueTable Value(NodeValueDatabase &value) const override;
 
+  virtual void Hash(QCryptographicHash &hash, const rational &time) const override;
+
+  virtual int GetRegionOfInterestMargin() const override;
+
+  enum Quality {
+    kQualityBest,
+    kQualityBalanced,
+    kQualityFast
+  };
+
+  /**
+   * @brief Determine which mipmap level the blur samples from
+   *
+   * Large radii would need hundreds of samples per pixel at full resolution, so instead they're
+   * blurred from a downsampled copy of the input, halving the sample count for each level. The
+   * level is chosen to keep each pass under the sample budget for this quality.
+   */
+  static int GetDownsampleLevel(double radius, int method, int quality);
+
 private:
+  /**
+   * @brief Returns how many passes the blur renders in, 0 if it's a no-op
+   */
+  static int GetPassCount(bool horiz, bool vert, double radius);
+
+  /**
+   * @brief Maximum samples per pass for each Quality, 0 means unlimited
+   */
+  static const int kSampleBudget[];
+
+  static const int kMaxDownsampleLevel;
+
   NodeInput* texture_input_;
 
   NodeInput* method_input_;
@@ -56,6 +87,8 @@ private:
 
   NodeInput* repeat_edge_pixels_input_;
 
+  NodeInput* quality_input_;
+
 };
 
 }
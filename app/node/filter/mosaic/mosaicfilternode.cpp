@@ -59,9 +59,7 @@ NodeValueTable MosaicFilterNode::Value(NodeValueDatabase &value) const
   if (!job.GetValue(tex_input_).data.isNull()) {
     TexturePtr texture = job.GetValue(tex_input_).data.value<TexturePtr>();
 
-    if (texture
-        && job.GetValue(horiz_input_).data.toInt() != texture->width()
-        && job.GetValue(vert_input_).data.toInt() != texture->height()) {
+    if (texture && !IsPassthrough(job.GetValue(horiz_input_).data.toInt(), job.GetValue(vert_input_).data.toInt(), texture.get())) {
       table.Push(NodeParam::kShaderJob, QVariant::fromValue(job), this);
     } else {
       table.Push(job.GetValue(tex_input_), this);
@@ -71,6 +69,13 @@ NodeValueTable MosaicFilterNode::Value(NodeValueDatabase &value) const
   return table;
 }
 
+bool MosaicFilterNode::IsPassthrough(int horiz, int vert, const Texture *texture)
+{
+  // Each axis is left alone if it's disabled or has at least one tile for every pixel
+  return (horiz <= 0 || horiz >= texture->width())
+      && (vert <= 0 || vert >= texture->height());
+}
+
 ShaderCode MosaicFilterNode::GetShaderCode(const QString &shader_id) const
 {
   Q_UNUSED(shader_id)
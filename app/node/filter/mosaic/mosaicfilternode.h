@@ -61,7 +61,18 @@ public:
   virtual NodeValueTable Value(NodeValueDatabase &value) const override;
   virtual ShaderCode GetShaderCode(const QString &shader_id) const override;
 
+  virtual int GetRegionOfInterestMargin() const override
+  {
+    // Tiles are sized relative to the whole frame and sampled at their centers
+    return -1;
+  }
+
 private:
+  /**
+   * @brief Returns TRUE if this many tiles would leave `texture` unchanged
+   */
+  static bool IsPassthrough(int horiz, int vert, const Texture* texture);
+
   NodeInput* tex_input_;
 
   NodeInput* horiz_input_;
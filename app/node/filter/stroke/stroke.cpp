@@ -20,6 +20,8 @@
 
 #include "stroke.h"
 
+#include <QtMath>
+
 #include "render/color.h"
 
 namespace olive {
@@ -97,8 +99,30 @@ NodeValueTable StrokeFilterNode::Value(NodeValueDatabase &value) const
   NodeValueTable table = value.Merge();
 
   if (!job.GetValue(tex_input_).data.isNull()) {
-    if (job.GetValue(radius_input_).data.toDouble() > 0.0
+    double radius = job.GetValue(radius_input_).data.toDouble();
+
+    if (radius > 0.0
         && job.GetValue(opacity_input_).data.toDouble() > 0.0) {
+      // Rather than sampling every pixel within the radius, the stroke is drawn from a distance
+      // field built with a jump flood, which costs a pass per doubling of the radius
+      int steps;
+      int first_step = GetJumpFloodFirstStep(radius, &steps);
+
+      job.InsertValue(QStringLiteral("field_in"), job.GetValue(tex_input_));
+      job.InsertValue(QStringLiteral("jfa_steps_in"), ShaderValue(steps, NodeParam::kInt));
+      job.InsertValue(QStringLiteral("jfa_first_step_in"), ShaderValue(first_step, NodeParam::kFloat));
+      job.InsertValue(QStringLiteral("field_scale_in"),
+                      ShaderValue(qCeil(radius) + 1 + first_step * 2, NodeParam::kFloat));
+
+      // The field stores offsets, blending neighboring ones would point nowhere
+      job.SetInterpolation(QStringLiteral("field_in"), Texture::kNearest);
+
+      // Seeding and one pass per step, then the composite
+      job.SetIterations(steps + 2, QStringLiteral("field_in"));
+
+      // The field needs an alpha channel even if the input doesn't have one
+      job.SetAlphaChannelRequired(true);
+
       table.Push(NodeParam::kShaderJob, QVariant::fromValue(job), this);
     } else {
       table.Push(job.GetValue(tex_input_), this);
@@ -115,4 +139,33 @@ ShaderCode StrokeFilterNode::GetShaderCode(const QString &shader_id) const
   return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/stroke.frag"));
 }
 
+int StrokeFilterNode::GetRegionOfInterestMargin() const
+{
+  if (!radius_input_->is_static()) {
+    return -1;
+  }
+
+  // Pixels outside the region of interest are never written, so the flood needs room to reach
+  // in from beyond it as well as the stroke itself
+  double radius = radius_input_->get_standard_value().toDouble();
+  int steps;
+
+  return qCeil(radius) + 1 + GetJumpFloodFirstStep(radius, &steps) * 2;
+}
+
+int StrokeFilterNode::GetJumpFloodFirstStep(double radius, int *steps)
+{
+  int reach = qCeil(radius) + 1;
+
+  int first = 1;
+  *steps = 1;
+
+  while (first * 2 - 1 < reach) {
+    first *= 2;
+    (*steps)++;
+  }
+
+  return first;
+}
+
 }
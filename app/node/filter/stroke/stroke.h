@@ -43,7 +43,17 @@ public:
   virtual NodeValueTable Value(NodeValueDatabase &value) const override;
   virtual ShaderCode GetShaderCode(const QString &shader_id) const override;
 
+  virtual int GetRegionOfInterestMargin() const override;
+
 private:
+  /**
+   * @brief Size the jump flood that finds every seed within `radius` pixels
+   *
+   * Returns the step size of the first pass and sets `steps` to the number of passes. Every pass
+   * halves the step so the flood can reach `2 * first - 1` pixels.
+   */
+  static int GetJumpFloodFirstStep(double radius, int* steps);
+
   NodeInput* tex_input_;
 
   NodeInput* color_input_;
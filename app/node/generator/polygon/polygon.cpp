@@ -21,11 +21,13 @@
 #include "polygon.h"
 
 #include <QGuiApplication>
+#include <QtMath>
 #include <QVector2D>
 
 namespace olive {
 
-PolygonGenerator::PolygonGenerator()
+PolygonGenerator::PolygonGenerator() :
+  tessellation_valid_(false)
 {
   points_input_ = new NodeInputArray("points_in", NodeParam::kVec2);
   AddInput(points_input_);
@@ -92,6 +94,14 @@ ShaderCode PolygonGenerator::GetShaderCode(const QString &shader_id) const
   return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/polygon.frag"));
 }
 
+bool PolygonGenerator::SupportsLowPrecisionOutput(const QString &shader_id) const
+{
+  Q_UNUSED(shader_id)
+
+  // A single color with antialiased edges, 8 bits is plenty
+  return true;
+}
+
 NodeValueTable PolygonGenerator::Value(NodeValueDatabase &value) const
 {
   ShaderJob job;
@@ -101,6 +111,42 @@ NodeValueTable PolygonGenerator::Value(NodeValueDatabase &value) const
   job.InsertValue(QStringLiteral("resolution_in"), ShaderValue(value[QStringLiteral("global")].Get(NodeParam::kVec2, QStringLiteral("resolution")), NodeParam::kVec2));
   job.SetAlphaChannelRequired(true);
 
+  QVector2D resolution = job.GetValue(QStringLiteral("resolution_in")).data.value<QVector2D>();
+  QVector<QVariant> point_values = job.GetValue(points_input_).data.value< QVector<QVariant> >();
+
+  QVector<QPointF> points(point_values.size());
+  QRectF bounding_box;
+
+  for (int i=0; i<point_values.size(); i++) {
+    points[i] = point_values.at(i).value<QVector2D>().toPointF();
+
+    bounding_box = (i == 0) ? QRectF(points.at(i), QSizeF()) : bounding_box.united(QRectF(points.at(i), QSizeF()));
+  }
+
+  // Only pixels around the polygon can be anything but transparent
+  if (points.size() >= 3 && resolution.x() > 0 && resolution.y() > 0) {
+    bounding_box.adjust(-1, -1, 1, 1);
+
+    job.SetBounds(QRectF(bounding_box.x() / resolution.x(),
+                         bounding_box.y() / resolution.y(),
+                         bounding_box.width() / resolution.x(),
+                         bounding_box.height() / resolution.y()) & QRectF(0, 0, 1, 1));
+
+    QMutexLocker locker(&tessellation_lock_);
+
+    if (points != tessellation_points_ || resolution != tessellation_resolution_) {
+      tessellation_points_ = points;
+      tessellation_resolution_ = resolution;
+      tessellation_valid_ = Tessellate(points, resolution, &tessellation_positions_, &tessellation_coverage_);
+    }
+
+    if (tessellation_valid_) {
+      // Draw the triangles rather than testing every pixel against every edge
+      job.SetVertices(tessellation_positions_, tessellation_coverage_);
+      job.InsertValue(QStringLiteral("triangulated_in"), ShaderValue(true, NodeParam::kBoolean));
+    }
+  }
+
   NodeValueTable table = value.Merge();
   table.Push(NodeParam::kShaderJob, QVariant::fromValue(job), this);
   return table;
@@ -173,6 +219,171 @@ void PolygonGenerator::GizmoRelease()
   gizmo_y_dragger_.End();
 }*/
 
+namespace {
+
+double Cross(const QPointF& o, const QPointF& a, const QPointF& b)
+{
+  return (a.x() - o.x()) * (b.y() - o.y()) - (a.y() - o.y()) * (b.x() - o.x());
+}
+
+void AppendVertex(QVector<float>* positions, QVector<float>* coverage, const QPointF& p,
+                  const QVector2D& resolution, float c)
+{
+  positions->append(p.x() / resolution.x());
+  positions->append(p.y() / resolution.y());
+  coverage->append(c);
+  coverage->append(0.0f);
+}
+
+QPointF OutwardNormal(const QPointF& a, const QPointF& b, double orientation)
+{
+  QPointF d = b - a;
+  double length = qSqrt(d.x() * d.x() + d.y() * d.y());
+
+  if (qIsNull(length)) {
+    return QPointF();
+  }
+
+  return QPointF(d.y(), -d.x()) * (orientation / length);
+}
+
+}
+
+bool PolygonGenerator::Triangulate(const QVector<QPointF> &points, QVector<int> *triangles)
+{
+  double area = 0;
+
+  for (int i=0, j=points.size()-1; i<points.size(); j=i++) {
+    area += Cross(QPointF(), points.at(j), points.at(i));
+  }
+
+  double orientation = (area < 0) ? -1.0 : 1.0;
+
+  QVector<int> remaining(points.size());
+  for (int i=0; i<remaining.size(); i++) {
+    remaining[i] = i;
+  }
+
+  int since_last_ear = 0;
+  int i = 0;
+
+  while (remaining.size() > 3) {
+    if (since_last_ear > remaining.size()) {
+      // Went all the way around without finding an ear, the polygon must intersect itself
+      return false;
+    }
+
+    int prev = remaining.at((i + remaining.size() - 1) % remaining.size());
+    int cur = remaining.at(i);
+    int next = remaining.at((i + 1) % remaining.size());
+
+    const QPointF& a = points.at(prev);
+    const QPointF& b = points.at(cur);
+    const QPointF& c = points.at(next);
+
+    double corner = Cross(a, b, c) * orientation;
+
+    bool is_ear = false;
+
+    if (qIsNull(corner)) {
+      // Collinear or duplicate point, it can be dropped without a triangle
+      remaining.removeAt(i);
+      since_last_ear = 0;
+      i %= remaining.size();
+      continue;
+    } else if (corner > 0) {
+      is_ear = true;
+
+      // An ear can't contain any other point
+      foreach (int k, remaining) {
+        if (k == prev || k == cur || k == next) {
+          continue;
+        }
+
+        const QPointF& p = points.at(k);
+
+        if (Cross(a, b, p) * orientation >= 0
+            && Cross(b, c, p) * orientation >= 0
+            && Cross(c, a, p) * orientation >= 0) {
+          is_ear = false;
+          break;
+        }
+      }
+    }
+
+    if (is_ear) {
+      triangles->append(prev);
+      triangles->append(cur);
+      triangles->append(next);
+
+      remaining.removeAt(i);
+      since_last_ear = 0;
+      i %= remaining.size();
+    } else {
+      since_last_ear++;
+      i = (i + 1) % remaining.size();
+    }
+  }
+
+  if (remaining.size() == 3) {
+    triangles->append(remaining.at(0));
+    triangles->append(remaining.at(1));
+    triangles->append(remaining.at(2));
+  }
+
+  return true;
+}
+
+bool PolygonGenerator::Tessellate(const QVector<QPointF> &points, const QVector2D &resolution,
+                                  QVector<float> *positions, QVector<float> *coverage)
+{
+  positions->clear();
+  coverage->clear();
+
+  QVector<int> triangles;
+
+  if (!Triangulate(points, &triangles)) {
+    return false;
+  }
+
+  foreach (int index, triangles) {
+    AppendVertex(positions, coverage, points.at(index), resolution, 1.0f);
+  }
+
+  double area = 0;
+
+  for (int i=0, j=points.size()-1; i<points.size(); j=i++) {
+    area += Cross(QPointF(), points.at(j), points.at(i));
+  }
+
+  double orientation = (area < 0) ? -1.0 : 1.0;
+
+  // Antialias the outline with a pixel wide strip along each edge fading out to nothing, plus a
+  // wedge at each corner to close the gap between neighboring strips
+  for (int i=0; i<points.size(); i++) {
+    const QPointF& a = points.at(i);
+    const QPointF& b = points.at((i + 1) % points.size());
+    const QPointF& c = points.at((i + 2) % points.size());
+
+    QPointF edge_normal = OutwardNormal(a, b, orientation);
+    QPointF next_normal = OutwardNormal(b, c, orientation);
+
+    AppendVertex(positions, coverage, a, resolution, 1.0f);
+    AppendVertex(positions, coverage, b, resolution, 1.0f);
+    AppendVertex(positions, coverage, b + edge_normal, resolution, 0.0f);
+
+    AppendVertex(positions, coverage, a, resolution, 1.0f);
+    AppendVertex(positions, coverage, b + edge_normal, resolution, 0.0f);
+    AppendVertex(positions, coverage, a + edge_normal, resolution, 0.0f);
+
+    AppendVertex(positions, coverage, b, resolution, 1.0f);
+    AppendVertex(positions, coverage, b + edge_normal, resolution, 0.0f);
+    AppendVertex(positions, coverage, b + next_normal, resolution, 0.0f);
+  }
+
+  return true;
+}
+
 QVector<QPointF> PolygonGenerator::GetGizmoCoordinates(NodeValueDatabase &db, const QVector2D& scale) const
 {
   QVector<QPointF> points(points_input_->GetSize());
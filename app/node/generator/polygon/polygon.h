@@ -21,6 +21,8 @@
 #ifndef POLYGONGENERATOR_H
 #define POLYGONGENERATOR_H
 
+#include <QMutex>
+
 #include "node/node.h"
 #include "node/inputdragger.h"
 
@@ -42,6 +44,7 @@ public:
   virtual void Retranslate() override;
 
   virtual ShaderCode GetShaderCode(const QString& shader_id) const override;
+  virtual bool SupportsLowPrecisionOutput(const QString& shader_id) const override;
   virtual NodeValueTable Value(NodeValueDatabase &value) const override;
 
   virtual bool HasGizmos() const override;
@@ -52,6 +55,24 @@ public:
   //virtual void GizmoRelease() override;
 
 private:
+  /**
+   * @brief Split a simple polygon into triangles by ear clipping
+   *
+   * Appends three indices into `points` per triangle to `triangles`. Returns FALSE if the polygon
+   * intersects itself, in which case `triangles` is incomplete.
+   */
+  static bool Triangulate(const QVector<QPointF>& points, QVector<int>* triangles);
+
+  /**
+   * @brief Build the triangles the shader draws for these points (in pixels)
+   *
+   * Besides the polygon itself, a 1 pixel fringe is drawn around its outline with a coverage
+   * falling off to zero, which the shader receives as the X texture coordinate. Returns FALSE if
+   * the polygon couldn't be triangulated.
+   */
+  static bool Tessellate(const QVector<QPointF>& points, const QVector2D& resolution,
+                         QVector<float>* positions, QVector<float>* coverage);
+
   QVector<QPointF> GetGizmoCoordinates(NodeValueDatabase &db, const QVector2D &scale) const;
 
   QVector<QRectF> GetGizmoRects(const QVector<QPointF>& points) const;
@@ -66,6 +87,16 @@ private:
   NodeInputDragger gizmo_x_dragger_;
   NodeInputDragger gizmo_y_dragger_;
 
+  /**
+   * @brief Triangles for the last set of points, they're only rebuilt when the points change
+   */
+  mutable QMutex tessellation_lock_;
+  mutable QVector<QPointF> tessellation_points_;
+  mutable QVector2D tessellation_resolution_;
+  mutable QVector<float> tessellation_positions_;
+  mutable QVector<float> tessellation_coverage_;
+  mutable bool tessellation_valid_;
+
 };
 
 }
@@ -80,4 +80,19 @@ ShaderCode SolidGenerator::GetShaderCode(const QString &shader_id) const
   return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/solid.frag"));
 }
 
+bool SolidGenerator::SupportsLowPrecisionOutput(const QString &shader_id) const
+{
+  Q_UNUSED(shader_id)
+
+  // A flat color has nothing to band
+  return true;
+}
+
+bool SolidGenerator::IsShaderOutputUniform(const QString &shader_id) const
+{
+  Q_UNUSED(shader_id)
+
+  return true;
+}
+
 }
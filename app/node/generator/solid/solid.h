@@ -42,6 +42,9 @@ public:
 
   virtual NodeValueTable Value(NodeValueDatabase &value) const override;
   virtual ShaderCode GetShaderCode(const QString &shader_id) const override;
+  virtual bool SupportsLowPrecisionOutput(const QString &shader_id) const override;
+
+  virtual bool IsShaderOutputUniform(const QString &shader_id) const override;
 
 private:
   NodeInput* color_input_;
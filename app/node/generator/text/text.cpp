@@ -101,6 +101,7 @@ NodeValueTable TextGenerator::Value(NodeValueDatabase &value) const
   job.InsertValue(font_input_, value);
   job.InsertValue(font_size_input_, value);
   job.SetAlphaChannelRequired(true);
+  job.SetCoverageMask(job.GetValue(color_input_).data.value<Color>());
 
   NodeValueTable table = value.Merge();
 
@@ -113,11 +114,40 @@ NodeValueTable TextGenerator::Value(NodeValueDatabase &value) const
 
 void TextGenerator::GenerateFrame(FramePtr frame, const GenerateJob& job) const
 {
-  // This could probably be more optimized, but for now we use Qt to draw to a QImage.
-  // QImages only support integer pixels and we use float pixels, so what we do here is draw onto
-  // a single-channel QImage (alpha only) and then transplant that alpha channel to our float buffer
-  // with correct float RGB.
-  QImage img(frame->width(), frame->height(), QImage::Format_Grayscale8);
+  QByteArray key = GetRasterKey(frame->video_params(), job);
+
+  QMutexLocker locker(&raster_lock_);
+
+  if (key != raster_key_) {
+    raster_ = Rasterize(frame->video_params(), job);
+    raster_key_ = key;
+  }
+
+  if (frame->video_params().channel_count() == 1) {
+    // Coverage mask requested, the renderer does the coloring so we can copy our raster as-is
+    for (int y=0; y<frame->height(); y++) {
+      memcpy(frame->data() + frame->linesize_bytes() * y, raster_.constScanLine(y), frame->width());
+    }
+  } else {
+    // QImages only support integer pixels and we use float pixels, so we transplant the alpha
+    // channel to our float buffer with correct float RGB.
+    Color rgb = job.GetValue(color_input_).data.value<Color>();
+    for (int x=0; x<frame->width(); x++) {
+      for (int y=0; y<frame->height(); y++) {
+        uchar src_alpha = raster_.constScanLine(y)[x];
+        float alpha = float(src_alpha) / 255.0f;
+
+        frame->set_pixel(x, y, Color(rgb.red() * alpha, rgb.green() * alpha, rgb.blue() * alpha, alpha));
+      }
+    }
+  }
+}
+
+QImage TextGenerator::Rasterize(const VideoParams &params, const GenerateJob &job) const
+{
+  // This could probably be more optimized, but for now we use Qt to draw to a single-channel
+  // QImage (alpha only)
+  QImage img(params.effective_width(), params.effective_height(), QImage::Format_Grayscale8);
   img.fill(0);
 
   QTextDocument text_doc;
@@ -134,12 +164,12 @@ void TextGenerator::GenerateFrame(FramePtr frame, const GenerateJob& job) const
   text_doc.setHtml(job.GetValue(text_input_).data.toString());
 
   // Align to 80% width because that's considered the "title safe" area
-  int tenth_of_width = frame->video_params().width() / 10;
+  int tenth_of_width = params.width() / 10;
   text_doc.setTextWidth(tenth_of_width * 8);
 
   // Draw rich text onto image
   QPainter p(&img);
-  p.scale(1.0 / frame->video_params().divider(), 1.0 / frame->video_params().divider());
+  p.scale(1.0 / params.divider(), 1.0 / params.divider());
 
   // Push 10% inwards to compensate for title safe area
   p.translate(tenth_of_width, 0);
@@ -150,30 +180,37 @@ void TextGenerator::GenerateFrame(FramePtr frame, const GenerateJob& job) const
   switch (valign) {
   case kVerticalAlignTop:
     // Push 10% inwards for title safe area
-    p.translate(0, frame->video_params().height() / 10);
+    p.translate(0, params.height() / 10);
     break;
   case kVerticalAlignCenter:
     // Center align
-    p.translate(0, frame->video_params().height() / 2 - doc_height / 2);
+    p.translate(0, params.height() / 2 - doc_height / 2);
     break;
   case kVerticalAlignBottom:
     // Push 10% inwards for title safe area
-    p.translate(0, frame->video_params().height() - doc_height - frame->video_params().height() / 10);
+    p.translate(0, params.height() - doc_height - params.height() / 10);
     break;
   }
 
   text_doc.drawContents(&p);
 
-  // Transplant alpha channel to frame
-  Color rgb = job.GetValue(color_input_).data.value<Color>();
-  for (int x=0; x<frame->width(); x++) {
-    for (int y=0; y<frame->height(); y++) {
-      uchar src_alpha = img.bits()[img.bytesPerLine() * y + x];
-      float alpha = float(src_alpha) / 255.0f;
+  return img;
+}
 
-      frame->set_pixel(x, y, Color(rgb.red() * alpha, rgb.green() * alpha, rgb.blue() * alpha, alpha));
-    }
-  }
+QByteArray TextGenerator::GetRasterKey(const VideoParams &params, const GenerateJob &job) const
+{
+  // Color isn't included since it's applied after rasterizing
+  QStringList parts = {
+    job.GetValue(text_input_).data.toString(),
+    job.GetValue(font_input_).data.toString(),
+    QString::number(job.GetValue(font_size_input_).data.toDouble()),
+    QString::number(job.GetValue(valign_input_).data.toInt()),
+    QString::number(params.width()),
+    QString::number(params.height()),
+    QString::number(params.divider())
+  };
+
+  return parts.join(QChar('\0')).toUtf8();
 }
 
 }
@@ -21,6 +21,9 @@
 #ifndef TEXTGENERATOR_H
 #define TEXTGENERATOR_H
 
+#include <QImage>
+#include <QMutex>
+
 #include "node/node.h"
 
 namespace olive {
@@ -45,6 +48,16 @@ public:
   virtual void GenerateFrame(FramePtr frame, const GenerateJob &job) const override;
 
 private:
+  /**
+   * @brief Draw the text's coverage (alpha only) at the size of a frame with these parameters
+   */
+  QImage Rasterize(const VideoParams& params, const GenerateJob& job) const;
+
+  /**
+   * @brief Uniquely identifies what Rasterize() would draw for these parameters and job
+   */
+  QByteArray GetRasterKey(const VideoParams& params, const GenerateJob& job) const;
+
   NodeInput* text_input_;
 
   NodeInput* color_input_;
@@ -55,6 +68,15 @@ private:
 
   NodeInput* font_size_input_;
 
+  /**
+   * @brief The last rasterized text and the key it was rasterized for
+   *
+   * Text is rarely animated, so this saves laying out and drawing the same text for every frame.
+   */
+  mutable QMutex raster_lock_;
+  mutable QByteArray raster_key_;
+  mutable QImage raster_;
+
 };
 
 }
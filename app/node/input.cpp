@@ -20,6 +20,7 @@
 
 #include "input.h"
 
+#include <algorithm>
 #include <QMatrix4x4>
 #include <QVector2D>
 #include <QVector3D>
@@ -109,11 +110,15 @@ void NodeInput::Load(QXmlStreamReader *reader, XMLNodeData &xml_node_data, const
 
         if (reader->name() == QStringLiteral("value")) {
           QString value_text = reader->readElementText();
+          QVariant loaded_value;
 
-          if (value_text.isEmpty()) {
-            standard_value_.replace(val_index, QVariant());
-          } else {
-            standard_value_.replace(val_index, StringToValue(value_text, xml_node_data.footage_connections));
+          if (!value_text.isEmpty()) {
+            loaded_value = StringToValue(value_text, xml_node_data.footage_connections);
+          }
+
+          // Values saved at their default would otherwise detach from `default_value_` for nothing
+          if (val_index < standard_value_.size() && standard_value_.at(val_index) != loaded_value) {
+            standard_value_.replace(val_index, loaded_value);
           }
 
           val_index++;
@@ -169,6 +174,7 @@ void NodeInput::Load(QXmlStreamReader *reader, XMLNodeData &xml_node_data, const
               key->set_bezier_control_out(key_out_handle);
               key->set_parent(this);
               keyframe_tracks_[track].append(key);
+              InvalidateKeyframeCurves();
             } else {
               reader->skipCurrentElement();
             }
@@ -304,6 +310,7 @@ void NodeInput::Init(DataType type)
 {
   keyframable_ = true;
   keyframing_ = false;
+  keyframe_curves_valid_ = false;
   data_type_ = type;
 
   int track_size;
@@ -331,8 +338,13 @@ void NodeInput::SetDefaultValue(const QVector<QVariant> &default_value)
 {
   default_value_ = default_value;
 
-  for (int i=0;i<standard_value_.size();i++) {
-    standard_value_.replace(i, default_value.at(i));
+  if (default_value_.size() == standard_value_.size()) {
+    // Implicitly shared, so inputs left at their defaults don't keep a copy
+    standard_value_ = default_value_;
+  } else {
+    for (int i=0;i<standard_value_.size();i++) {
+      standard_value_.replace(i, default_value.at(i));
+    }
   }
 }
 
@@ -552,91 +564,288 @@ QVector<QVariant> NodeInput::get_split_values_at_time(const rational &time) cons
 QVariant NodeInput::get_value_at_time_for_track(const rational& time, int track) const
 {
   if (!is_using_standard_value(track)) {
-    const KeyframeTrack& key_track = keyframe_tracks_.at(track);
+    int hint = -1;
+    return EvaluateKeyframeCurve(GetKeyframeCurve(track), time, &hint);
+  }
+
+  return standard_value_.at(track);
+}
+
+QVector<QVariant> NodeInput::get_values_at_times_for_track(const QVector<rational> &times, int track) const
+{
+  QVector<QVariant> values(times.size());
+
+  if (is_using_standard_value(track)) {
+    values.fill(standard_value_.at(track));
+  } else {
+    KeyframeCurve curve = GetKeyframeCurve(track);
+    int hint = -1;
 
-    if (key_track.first()->time() >= time) {
-      // This time precedes any keyframe, so we just return the first value
-      return key_track.first()->value();
+    for (int i=0;i<times.size();i++) {
+      values[i] = EvaluateKeyframeCurve(curve, times.at(i), &hint);
     }
+  }
+
+  return values;
+}
+
+QVector<QVariant> NodeInput::get_values_at_times(const QVector<rational> &times) const
+{
+  QVector< QVector<QVariant> > track_values(get_number_of_keyframe_tracks());
+
+  for (int i=0;i<track_values.size();i++) {
+    track_values[i] = get_values_at_times_for_track(times, i);
+  }
+
+  QVector<QVariant> values(times.size());
+  QVector<QVariant> split(track_values.size());
 
-    if (key_track.last()->time() <= time) {
-      // This time is after any keyframes so we return the last value
-      return key_track.last()->value();
+  for (int i=0;i<times.size();i++) {
+    for (int j=0;j<track_values.size();j++) {
+      split[j] = track_values.at(j).at(i);
     }
 
-    // If we're here, the time must be somewhere in between the keyframes
-    for (int i=0;i<key_track.size()-1;i++) {
-      NodeKeyframePtr before = key_track.at(i);
-      NodeKeyframePtr after = key_track.at(i+1);
+    values[i] = combine_track_values_into_normal_value(split);
+  }
+
+  return values;
+}
+
+NodeInput::KeyframeCurve NodeInput::GetKeyframeCurve(int track) const
+{
+  QMutexLocker locker(&keyframe_curve_lock_);
 
-      if (before->time() == time
-          || !type_can_be_interpolated(data_type())
-          || (before->time() < time && before->type() == NodeKeyframe::kHold)) {
+  if (!keyframe_curves_valid_) {
+    keyframe_curves_.resize(keyframe_tracks_.size());
 
-        // Time == keyframe time, so value is precise
-        return before->value();
+    for (int i=0;i<keyframe_tracks_.size();i++) {
+      const KeyframeTrack& key_track = keyframe_tracks_.at(i);
+      KeyframeCurve& curve = keyframe_curves_[i];
 
-      } else if (after->time() == time) {
+      curve.segments.clear();
 
-        // Time == keyframe time, so value is precise
-        return after->value();
+      if (key_track.isEmpty()) {
+        continue;
+      }
 
-      } else if (before->time() < time && after->time() > time) {
-        // We must interpolate between these keyframes
+      curve.first_time = key_track.first()->time();
+      curve.first_value = key_track.first()->value();
+      curve.last_time = key_track.last()->time();
+      curve.last_value = key_track.last()->value();
 
-        if (before->type() == NodeKeyframe::kBezier && after->type() == NodeKeyframe::kBezier) {
-          // Perform a cubic bezier with two control points
+      curve.segments.resize(key_track.size() - 1);
 
-          double t = Bezier::CubicXtoT(time.toDouble(),
-                                       before->time().toDouble(),
-                                       before->time().toDouble() + before->bezier_control_out().x(),
-                                       after->time().toDouble() + after->bezier_control_in().x(),
-                                       after->time().toDouble());
+      for (int j=0;j<curve.segments.size();j++) {
+        curve.segments[j] = CreateKeyframeSegment(key_track.at(j).get(), key_track.at(j+1).get());
+      }
+    }
 
-          double y = Bezier::CubicTtoY(before->value().toDouble(),
-                                       before->value().toDouble() + before->bezier_control_out().y(),
-                                       after->value().toDouble() + after->bezier_control_in().y(),
-                                       after->value().toDouble(),
-                                       t);
+    keyframe_curves_valid_ = true;
+  }
 
-          return y;
+  return keyframe_curves_.at(track);
+}
 
-        } else if (before->type() == NodeKeyframe::kBezier || after->type() == NodeKeyframe::kBezier) {
-          // Perform a quadratic bezier with only one control point
+NodeInput::KeyframeSegment NodeInput::CreateKeyframeSegment(NodeKeyframe *before, NodeKeyframe *after) const
+{
+  KeyframeSegment segment;
 
-          QPointF control_point;
-          double control_point_time;
-          double control_point_value;
+  segment.in = before->time();
+  segment.out = after->time();
+  segment.in_value = before->value();
 
-          if (before->type() == NodeKeyframe::kBezier) {
-            control_point = before->bezier_control_out();
-            control_point_time = before->time().toDouble() + control_point.x();
-            control_point_value = before->value().toDouble() + control_point.y();
-          } else {
-            control_point = after->bezier_control_in();
-            control_point_time = after->time().toDouble() + control_point.x();
-            control_point_value = after->value().toDouble() + control_point.y();
-          }
+  for (int i=0;i<4;i++) {
+    segment.x[i] = 0;
+    segment.y[i] = 0;
+  }
 
-          // Generate T from time values - used to determine bezier progress
-          double t = Bezier::QuadraticXtoT(time.toDouble(), before->time().toDouble(), control_point_time, after->time().toDouble());
+  if (!type_can_be_interpolated(data_type()) || before->type() == NodeKeyframe::kHold) {
+    segment.interpolation = KeyframeSegment::kHold;
+    return segment;
+  }
 
-          // Generate value using T
-          double y = Bezier::QuadraticTtoY(before->value().toDouble(), control_point_value, after->value().toDouble(), t);
+  double before_time = before->time().toDouble();
+  double before_value = before->value().toDouble();
+  double after_time = after->time().toDouble();
+  double after_value = after->value().toDouble();
+
+  if (before->type() == NodeKeyframe::kBezier && after->type() == NodeKeyframe::kBezier) {
+    // Perform a cubic bezier with two control points, stored as polynomial coefficients
+    double xa = before_time;
+    double xb = before_time + before->bezier_control_out().x();
+    double xc = after_time + after->bezier_control_in().x();
+    double xd = after_time;
+
+    double ya = before_value;
+    double yb = before_value + before->bezier_control_out().y();
+    double yc = after_value + after->bezier_control_in().y();
+    double yd = after_value;
+
+    segment.interpolation = KeyframeSegment::kCubic;
+
+    segment.x[0] = -xa + 3*xb - 3*xc + xd;
+    segment.x[1] = 3*xa - 6*xb + 3*xc;
+    segment.x[2] = -3*xa + 3*xb;
+    segment.x[3] = xa;
+
+    segment.y[0] = -ya + 3*yb - 3*yc + yd;
+    segment.y[1] = 3*ya - 6*yb + 3*yc;
+    segment.y[2] = -3*ya + 3*yb;
+    segment.y[3] = ya;
+
+  } else if (before->type() == NodeKeyframe::kBezier || after->type() == NodeKeyframe::kBezier) {
+    // Perform a quadratic bezier with only one control point
+    QPointF control_point;
+
+    if (before->type() == NodeKeyframe::kBezier) {
+      control_point = QPointF(before_time, before_value) + before->bezier_control_out();
+    } else {
+      control_point = QPointF(after_time, after_value) + after->bezier_control_in();
+    }
 
-          return y;
+    segment.interpolation = KeyframeSegment::kQuadratic;
 
-        } else {
-          // To have arrived here, the keyframes must both be linear
-          qreal period_progress = (time.toDouble() - before->time().toDouble()) / (after->time().toDouble() - before->time().toDouble());
+    segment.x[0] = before_time;
+    segment.x[1] = control_point.x();
+    segment.x[2] = after_time;
+
+    segment.y[0] = before_value;
+    segment.y[1] = control_point.y();
+    segment.y[2] = after_value;
+
+  } else {
+    // To have arrived here, the keyframes must both be linear
+    segment.interpolation = KeyframeSegment::kLinear;
+
+    segment.x[0] = before_time;
+    segment.x[1] = after_time;
+
+    segment.y[0] = before_value;
+    segment.y[1] = after_value;
+  }
+
+  return segment;
+}
+
+QVariant NodeInput::EvaluateKeyframeCurve(const KeyframeCurve &curve, const rational &time, int *segment_hint)
+{
+  if (curve.first_time >= time) {
+    // This time precedes any keyframe, so we just return the first value
+    return curve.first_value;
+  }
+
+  if (curve.last_time <= time) {
+    // This time is after any keyframes so we return the last value
+    return curve.last_value;
+  }
+
+  // If we're here, the time must be somewhere in between the keyframes. Try the segment the last
+  // lookup landed on and the one after it before falling back to a binary search.
+  const QVector<KeyframeSegment>& segments = curve.segments;
+  int index = *segment_hint;
+
+  if (index >= 0 && index < segments.size() - 1 && segments.at(index).out <= time) {
+    index++;
+  }
+
+  if (index < 0 || index >= segments.size()
+      || segments.at(index).in > time || segments.at(index).out <= time) {
+    QVector<KeyframeSegment>::const_iterator it = std::upper_bound(segments.cbegin(), segments.cend(), time,
+                                                                   [](const rational& t, const KeyframeSegment& s) {
+      return t < s.in;
+    });
+
+    index = (it - segments.cbegin()) - 1;
+  }
+
+  *segment_hint = index;
+
+  const KeyframeSegment& segment = segments.at(index);
+
+  if (segment.in == time || segment.interpolation == KeyframeSegment::kHold) {
+    // Time == keyframe time, so value is precise
+    return segment.in_value;
+  }
+
+  double x = time.toDouble();
+
+  switch (segment.interpolation) {
+  case KeyframeSegment::kHold:
+  case KeyframeSegment::kLinear:
+    break;
+  case KeyframeSegment::kQuadratic:
+  {
+    // Generate T from time values - used to determine bezier progress
+    double t = Bezier::QuadraticXtoT(x, segment.x[0], segment.x[1], segment.x[2]);
+
+    // Generate value using T
+    return Bezier::QuadraticTtoY(segment.y[0], segment.y[1], segment.y[2], t);
+  }
+  case KeyframeSegment::kCubic:
+  {
+    const double* cx = segment.x;
+    const double* cy = segment.y;
+
+    // Solve x(t) = x with Newton's method, starting from a linear guess, which converges in a
+    // couple of steps for any sensible curve. Fall back to bisection if it doesn't.
+    const double tolerance = 1e-7;
+
+    double t = (x - cx[3]) / (segment.out.toDouble() - cx[3]);
+    bool solved = false;
+
+    for (int i=0;i<8;i++) {
+      double error = ((cx[0]*t + cx[1])*t + cx[2])*t + cx[3] - x;
+
+      if (qAbs(error) < tolerance) {
+        solved = true;
+        break;
+      }
+
+      double derivative = (3*cx[0]*t + 2*cx[1])*t + cx[2];
 
-          return lerp(before->value().toDouble(), after->value().toDouble(), period_progress);
+      if (qFuzzyIsNull(derivative)) {
+        break;
+      }
+
+      t -= error / derivative;
+
+      if (t < 0.0 || t > 1.0) {
+        break;
+      }
+    }
+
+    if (!solved) {
+      double lower = 0.0;
+      double upper = 1.0;
+
+      for (int i=0;i<64;i++) {
+        t = (upper + lower) * 0.5;
+
+        double error = ((cx[0]*t + cx[1])*t + cx[2])*t + cx[3] - x;
+
+        if (qAbs(error) < tolerance) {
+          break;
+        } else if (error < 0) {
+          lower = t;
+        } else {
+          upper = t;
         }
       }
     }
+
+    return ((cy[0]*t + cy[1])*t + cy[2])*t + cy[3];
+  }
   }
 
-  return standard_value_.at(track);
+  qreal period_progress = (x - segment.x[0]) / (segment.x[1] - segment.x[0]);
+
+  return lerp(segment.y[0], segment.y[1], period_progress);
+}
+
+void NodeInput::InvalidateKeyframeCurves()
+{
+  QMutexLocker locker(&keyframe_curve_lock_);
+  keyframe_curves_valid_ = false;
 }
 
 QList<NodeKeyframePtr> NodeInput::get_keyframe_at_time(const rational &time) const
@@ -822,6 +1031,7 @@ void NodeInput::remove_keyframe(NodeKeyframePtr key)
 
   keyframe_tracks_[key->track()].removeOne(key);
   key->set_parent(nullptr);
+  InvalidateKeyframeCurves();
 
   emit KeyframeRemoved(key);
   emit_time_range(time_affected);
@@ -842,6 +1052,8 @@ NodeKeyframePtr NodeInput::get_keyframe_shared_ptr_from_raw(NodeKeyframe* raw) c
 
 void NodeInput::KeyframeTimeChanged()
 {
+  InvalidateKeyframeCurves();
+
   NodeKeyframe* key = static_cast<NodeKeyframe*>(sender());
   int keyframe_index = FindIndexOfKeyframeFromRawPtr(key);
 
@@ -869,11 +1081,15 @@ void NodeInput::KeyframeTimeChanged()
 
 void NodeInput::KeyframeValueChanged()
 {
+  InvalidateKeyframeCurves();
+
   emit_range_affected_by_keyframe(static_cast<NodeKeyframe*>(sender()));
 }
 
 void NodeInput::KeyframeTypeChanged()
 {
+  InvalidateKeyframeCurves();
+
   NodeKeyframe* key = static_cast<NodeKeyframe*>(sender());
   int keyframe_index = FindIndexOfKeyframeFromRawPtr(key);
 
@@ -888,6 +1104,8 @@ void NodeInput::KeyframeTypeChanged()
 
 void NodeInput::KeyframeBezierInChanged()
 {
+  InvalidateKeyframeCurves();
+
   NodeKeyframe* key = static_cast<NodeKeyframe*>(sender());
   int keyframe_index = FindIndexOfKeyframeFromRawPtr(key);
 
@@ -903,6 +1121,8 @@ void NodeInput::KeyframeBezierInChanged()
 
 void NodeInput::KeyframeBezierOutChanged()
 {
+  InvalidateKeyframeCurves();
+
   NodeKeyframe* key = static_cast<NodeKeyframe*>(sender());
   int keyframe_index = FindIndexOfKeyframeFromRawPtr(key);
 
@@ -934,6 +1154,7 @@ void NodeInput::insert_keyframe_internal(NodeKeyframePtr key)
   KeyframeTrack& key_track = keyframe_tracks_[key->track()];
 
   key->set_parent(this);
+  InvalidateKeyframeCurves();
 
   for (int i=0;i<key_track.size();i++) {
     NodeKeyframePtr compare = key_track.at(i);
@@ -1092,6 +1313,8 @@ void NodeInput::CopyValues(NodeInput *source, NodeInput *dest, bool include_conn
     }
   }
 
+  dest->InvalidateKeyframeCurves();
+
   // Copy keyframing state
   dest->set_is_keyframing(source->is_keyframing());
 
@@ -21,6 +21,8 @@
 #ifndef NODEINPUT_H
 #define NODEINPUT_H
 
+#include <QMutex>
+
 #include "common/timerange.h"
 #include "keyframe.h"
 #include "param.h"
@@ -34,7 +36,13 @@ class NodeInput : public NodeParam
 {
   Q_OBJECT
 public:
-  using KeyframeTrack = QList<NodeKeyframePtr>;
+  /**
+   * @brief Keyframes of one track sorted by time
+   *
+   * A QVector rather than a QList so the keyframes sit next to each other, QList would allocate
+   * every shared pointer on its own since they're larger than a pointer.
+   */
+  using KeyframeTrack = QVector<NodeKeyframePtr>;
 
   /**
    * @brief NodeInput Constructor
@@ -105,6 +113,22 @@ public:
    */
   QVariant get_value_at_time_for_track(const rational& time, int track) const;
 
+  /**
+   * @brief Calculate the stored value for a specific track at several times at once
+   *
+   * Equivalent to calling get_value_at_time_for_track() for every time, but considerably faster
+   * for dense sampling (e.g. per audio sample or for drawing a curve). Times don't have to be
+   * sorted, but sorted times let each lookup continue from where the last one left off.
+   */
+  QVector<QVariant> get_values_at_times_for_track(const QVector<rational>& times, int track) const;
+
+  /**
+   * @brief Calculate what the stored value should be at several times at once
+   *
+   * \see get_value_at_time() and get_values_at_times_for_track()
+   */
+  QVector<QVariant> get_values_at_times(const QVector<rational>& times) const;
+
   /**
    * @brief Retrieve a list of keyframe objects for all tracks at a given time
    *
@@ -297,6 +321,74 @@ private:
    */
   static bool type_can_be_interpolated(DataType type);
 
+  /**
+   * @brief Precomputed interpolation between two adjacent keyframes
+   */
+  struct KeyframeSegment {
+    enum Interpolation {
+      kHold,
+      kLinear,
+      kQuadratic,
+      kCubic
+    };
+
+    /// Range of times this segment covers, `in` inclusive and `out` exclusive
+    rational in;
+    rational out;
+
+    /// Value of the keyframe at `in`, returned as-is for holds and exact matches
+    QVariant in_value;
+
+    Interpolation interpolation;
+
+    /**
+     * @brief Curve coefficients
+     *
+     * For linear segments these are the start and end points. For quadratic segments they're the
+     * start, control and end points, and for cubic segments they're the polynomial coefficients
+     * in terms of t (highest order first) so each evaluation is a few multiplications.
+     */
+    double x[4];
+    double y[4];
+  };
+
+  /**
+   * @brief Everything needed to evaluate a keyframe track without walking its keyframes
+   */
+  struct KeyframeCurve {
+    rational first_time;
+    QVariant first_value;
+    rational last_time;
+    QVariant last_value;
+
+    QVector<KeyframeSegment> segments;
+  };
+
+  /**
+   * @brief Get the precomputed curve for a track, building it if keyframes have changed since
+   *
+   * Thread-safe.
+   */
+  KeyframeCurve GetKeyframeCurve(int track) const;
+
+  /**
+   * @brief Build the segment between two adjacent keyframes
+   */
+  KeyframeSegment CreateKeyframeSegment(NodeKeyframe* before, NodeKeyframe* after) const;
+
+  /**
+   * @brief Evaluate a keyframe curve at a time
+   *
+   * `segment_hint` is the segment the last evaluation landed on (or -1) and is updated with the
+   * one this evaluation landed on, which makes sorted lookups O(1) rather than O(log n).
+   */
+  static QVariant EvaluateKeyframeCurve(const KeyframeCurve& curve, const rational& time, int* segment_hint);
+
+  /**
+   * @brief Discard precomputed keyframe curves, must be called whenever any keyframe changes
+   */
+  void InvalidateKeyframeCurves();
+
   /**
    * @brief We use Qt signals/slots for keyframe communication but store them as shared ptrs. This function converts
    * a raw ptr to a list index
@@ -347,6 +439,8 @@ private:
 
   /**
    * @brief Non-keyframed value
+   *
+   * Shares `default_value_`'s data until it's changed, most inputs never are.
    */
   QVector<QVariant> standard_value_;
 
@@ -360,13 +454,22 @@ private:
    *
    * If keyframing is enabled, this data is used instead of standard_value.
    */
-  QVector< QList<NodeKeyframePtr> > keyframe_tracks_;
+  QVector<KeyframeTrack> keyframe_tracks_;
 
   /**
    * @brief Internal keyframing enabled setting
    */
   bool keyframing_;
 
+  /**
+   * @brief Precomputed curves for `keyframe_tracks_`, only up to date if `keyframe_curves_valid_` is TRUE
+   */
+  mutable QVector<KeyframeCurve> keyframe_curves_;
+
+  mutable bool keyframe_curves_valid_;
+
+  mutable QMutex keyframe_curve_lock_;
+
 private slots:
   /**
    * @brief Slot when a keyframe's time changes to keep the keyframes correctly sorted by time
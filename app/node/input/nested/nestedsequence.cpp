@@ -0,0 +1,236 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#include "nestedsequence.h"
+
+#include "common/xmlutils.h"
+#include "project/item/sequence/sequence.h"
+
+namespace olive {
+
+NestedSequence::NestedSequence() :
+  sequence_(nullptr),
+  inner_node_copy_(nullptr),
+  pending_source_(nullptr)
+{
+}
+
+Node *NestedSequence::copy() const
+{
+  NestedSequence* n = new NestedSequence();
+  n->SetSequence(sequence_);
+  return n;
+}
+
+QVector<Node::CategoryID> NestedSequence::Category() const
+{
+  return {kCategoryInput};
+}
+
+void NestedSequence::SetSequence(Sequence *s)
+{
+  if (sequence_ == s) {
+    return;
+  }
+
+  if (sequence_) {
+    disconnect(sequence_->viewer_output(), &ViewerOutput::GraphChangedFrom, this, &NestedSequence::InnerGraphChanged);
+    disconnect(sequence_->viewer_output()->video_frame_cache(), &FrameHashCache::Invalidated, this, &NestedSequence::InnerFramesInvalidated);
+    disconnect(sequence_, &Sequence::destroyed, this, &NestedSequence::SequenceDestroyed);
+  }
+
+  sequence_ = s;
+  pending_source_ = nullptr;
+
+  if (sequence_) {
+    connect(sequence_->viewer_output(), &ViewerOutput::GraphChangedFrom, this, &NestedSequence::InnerGraphChanged);
+    connect(sequence_->viewer_output()->video_frame_cache(), &FrameHashCache::Invalidated, this, &NestedSequence::InnerFramesInvalidated);
+    connect(sequence_, &Sequence::destroyed, this, &NestedSequence::SequenceDestroyed);
+  }
+
+  if (parent()) {
+    InvalidateCache(TimeRange(0, RATIONAL_MAX), nullptr, nullptr);
+    emit InnerNodeChanged();
+  }
+}
+
+ViewerOutput *NestedSequence::GetViewer() const
+{
+  return sequence_ ? sequence_->viewer_output() : nullptr;
+}
+
+Node *NestedSequence::GetInnerNode() const
+{
+  if (inner_node_copy_) {
+    return inner_node_copy_;
+  }
+
+  ViewerOutput* viewer = GetViewer();
+
+  if (viewer && viewer->texture_input()->is_connected()) {
+    return viewer->texture_input()->get_connected_node();
+  }
+
+  return nullptr;
+}
+
+void NestedSequence::SetInnerNodeCopy(Node *n)
+{
+  if (inner_node_copy_) {
+    disconnect(inner_node_copy_, &Node::CacheInvalidated, this, &NestedSequence::InnerCopyInvalidated);
+  }
+
+  inner_node_copy_ = n;
+
+  if (inner_node_copy_) {
+    // The copy isn't connected to us, so changes to it have to be passed on by hand
+    connect(inner_node_copy_, &Node::CacheInvalidated, this, &NestedSequence::InnerCopyInvalidated);
+  }
+}
+
+bool NestedSequence::CanNest(Sequence *s, NodeGraph *graph)
+{
+  if (!s || s == graph) {
+    return false;
+  }
+
+  // Make sure `graph` isn't nested anywhere inside `s` either
+  foreach (Node* n, s->nodes()) {
+    NestedSequence* nest = dynamic_cast<NestedSequence*>(n);
+
+    if (nest && nest->sequence() && !CanNest(nest->sequence(), graph)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+NodeValueTable NestedSequence::Value(NodeValueDatabase &value) const
+{
+  NodeValueTable table = value.Merge();
+
+  ViewerOutput* viewer = GetViewer();
+
+  if (viewer) {
+    table.Push(NodeInput::kRational, QVariant::fromValue(viewer->GetLength()), this, "length");
+  }
+
+  return table;
+}
+
+void NestedSequence::Hash(QCryptographicHash &hash, const rational &time) const
+{
+  Node::Hash(hash, time);
+
+  Node* inner = GetInnerNode();
+
+  if (inner && GetViewer()) {
+    // The inner hash changes with anything edited inside the nested sequence, and the size is
+    // embedded for the same reason RenderManager::Hash() embeds it
+    const VideoParams& params = GetViewer()->video_params();
+    int width = params.width();
+    int height = params.height();
+
+    hash.addData(inner->GetCachedHash(time));
+    hash.addData(reinterpret_cast<const char*>(&width), sizeof(int));
+    hash.addData(reinterpret_cast<const char*>(&height), sizeof(int));
+  }
+}
+
+int NestedSequence::GetRegionOfInterestMargin() const
+{
+  // The inner graph is rendered whole so it can be cached
+  return -1;
+}
+
+void NestedSequence::LoadInternal(QXmlStreamReader *reader, XMLNodeData &xml_node_data)
+{
+  while (XMLReadNextStartElement(reader)) {
+    if (reader->name() == QStringLiteral("sequence")) {
+      xml_node_data.sequence_connections.append({this, reader->readElementText().toULongLong()});
+    } else {
+      reader->skipCurrentElement();
+    }
+  }
+}
+
+void NestedSequence::SaveInternal(QXmlStreamWriter *writer) const
+{
+  if (sequence_) {
+    writer->writeTextElement(QStringLiteral("sequence"), QString::number(reinterpret_cast<quintptr>(sequence_)));
+  }
+}
+
+bool NestedSequence::HashIsTimeInvariant() const
+{
+  Node* inner = GetInnerNode();
+
+  return !inner || inner->IsHashConstantOver(TimeRange(0, RATIONAL_MAX));
+}
+
+bool NestedSequence::HashIsConstantOver(const TimeRange &range) const
+{
+  Node* inner = GetInnerNode();
+
+  return !inner || inner->IsHashConstantOver(range);
+}
+
+void NestedSequence::InnerGraphChanged(NodeInput *source)
+{
+  pending_source_ = source;
+}
+
+void NestedSequence::InnerFramesInvalidated(const TimeRange &range)
+{
+  NodeInput* source = pending_source_;
+  pending_source_ = nullptr;
+
+  // Only edits inside the nested sequence change what it looks like, and copies outside a graph
+  // (e.g. PreviewAutoCacher's) are kept up to date by whoever made them
+  if (!source || !parent()) {
+    return;
+  }
+
+  if (source->parentNode() == GetViewer()) {
+    // The nested sequence's viewer was reconnected, which nothing downstream of us has a copy of
+    source = nullptr;
+    emit InnerNodeChanged();
+  }
+
+  InvalidateCache(range, nullptr, source);
+}
+
+void NestedSequence::SequenceDestroyed()
+{
+  sequence_ = nullptr;
+  pending_source_ = nullptr;
+
+  if (parent()) {
+    InvalidateCache(TimeRange(0, RATIONAL_MAX), nullptr, nullptr);
+    emit InnerNodeChanged();
+  }
+}
+
+void NestedSequence::InnerCopyInvalidated(const TimeRange &range)
+{
+  InvalidateCache(range, nullptr, nullptr);
+}
+
+}
@@ -0,0 +1,144 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#ifndef NESTEDSEQUENCE_H
+#define NESTEDSEQUENCE_H
+
+#include "node/node.h"
+
+namespace olive {
+
+class Sequence;
+class ViewerOutput;
+
+/**
+ * @brief A node that uses another sequence as footage
+ *
+ * Rather than re-evaluating the inner graph as part of every outer render, frames are looked up in
+ * the nested sequence's own FrameHashCache first (see NodeTraverser::ProcessNestedSequence()). The
+ * inner graph is only rendered on a miss, and if it was rendered at the nested sequence's own
+ * parameters the result goes into its cache too.
+ *
+ * The hash of this node embeds the hash the inner frame is cached under, so an edit inside the
+ * nested sequence only invalidates the outer frames that show it. This node is evaluated at the
+ * nested sequence's time, mapping from the outer sequence is left to the ClipBlock it's in.
+ */
+class NestedSequence : public Node
+{
+  Q_OBJECT
+public:
+  NestedSequence();
+
+  virtual QString Name() const override
+  {
+    return tr("Nested Sequence");
+  }
+
+  virtual QString id() const override
+  {
+    return QStringLiteral("org.olivevideoeditor.Olive.nestedsequence");
+  }
+
+  virtual QString Description() const override
+  {
+    return tr("Use another sequence as footage.");
+  }
+
+  virtual Node* copy() const override;
+
+  virtual QVector<CategoryID> Category() const override;
+
+  Sequence* sequence() const
+  {
+    return sequence_;
+  }
+
+  void SetSequence(Sequence* s);
+
+  /**
+   * @brief Returns the viewer of the nested sequence, or nullptr if none is set
+   */
+  ViewerOutput* GetViewer() const;
+
+  /**
+   * @brief Returns the node whose output is the nested sequence's picture
+   *
+   * This is whatever the nested sequence's viewer is connected to, unless a copy of that node was
+   * set with SetInnerNodeCopy().
+   */
+  Node* GetInnerNode() const;
+
+  /**
+   * @brief Render from a copy of the inner graph rather than the graph itself
+   *
+   * Used by PreviewAutoCacher, which renders from copies of every graph involved so that edits
+   * can't happen under a running render. The copy isn't owned by this node.
+   */
+  void SetInnerNodeCopy(Node* n);
+
+  /**
+   * @brief Returns TRUE if `s` can be nested in `graph` without a sequence ending up inside itself
+   */
+  static bool CanNest(Sequence* s, NodeGraph* graph);
+
+  virtual NodeValueTable Value(NodeValueDatabase& value) const override;
+
+  virtual void Hash(QCryptographicHash& hash, const rational &time) const override;
+
+  virtual int GetRegionOfInterestMargin() const override;
+
+signals:
+  /**
+   * @brief The nested sequence's viewer was connected to a different node
+   */
+  void InnerNodeChanged();
+
+protected:
+  virtual void LoadInternal(QXmlStreamReader* reader, XMLNodeData& xml_node_data) override;
+
+  virtual void SaveInternal(QXmlStreamWriter* writer) const override;
+
+  virtual bool HashIsTimeInvariant() const override;
+
+  virtual bool HashIsConstantOver(const TimeRange& range) const override;
+
+private:
+  Sequence* sequence_;
+
+  Node* inner_node_copy_;
+
+  /**
+   * @brief Input the nested sequence last reported a change from, until its frames are invalidated
+   */
+  NodeInput* pending_source_;
+
+private slots:
+  void InnerGraphChanged(NodeInput* source);
+
+  void InnerFramesInvalidated(const olive::TimeRange& range);
+
+  void SequenceDestroyed();
+
+  void InnerCopyInvalidated(const olive::TimeRange& range);
+
+};
+
+}
+
+#endif // NESTEDSEQUENCE_H
@@ -42,6 +42,17 @@ public:
 
   virtual void Hash(QCryptographicHash& hash, const rational& time) const override;
 
+protected:
+  virtual bool HashIsConstantOver(const TimeRange&) const override
+  {
+    return false;
+  }
+
+  virtual bool HashIsTimeInvariant() const override
+  {
+    return false;
+  }
+
 };
 
 }
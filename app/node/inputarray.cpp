@@ -93,6 +93,8 @@ void NodeInputArray::SetSize(int size)
     }
   }
 
+  NodeExecutionPlan::StructureChanged();
+
   emit SizeChanged(size);
 }
 
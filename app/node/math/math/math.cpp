@@ -88,6 +88,12 @@ ShaderCode MathNode::GetShaderCode(const QString &shader_id) const
   return GetShaderCodeInternal(shader_id, param_a_in_, param_b_in_);
 }
 
+bool MathNode::IsPrecisionSensitive() const
+{
+  // Arbitrary math on images can easily leave half float's range or amplify its rounding
+  return true;
+}
+
 NodeValueTable MathNode::Value(NodeValueDatabase &value) const
 {
   // Auto-detect what values to operate with
@@ -119,4 +125,9 @@ void MathNode::ProcessSamples(NodeValueDatabase &values, const SampleBufferPtr i
   return ProcessSamplesInternal(values, GetOperation(), param_a_in_, param_b_in_, input, output, index);
 }
 
+bool MathNode::ProcessSampleBlock(const SampleParamCurveMap &params, const SampleBufferPtr input, SampleBufferPtr output) const
+{
+  return ProcessSampleBlockInternal(params, GetOperation(), param_a_in_, param_b_in_, input, output);
+}
+
 }
@@ -42,6 +42,8 @@ public:
 
   virtual ShaderCode GetShaderCode(const QString &shader_id) const override;
 
+  virtual bool IsPrecisionSensitive() const override;
+
   Operation GetOperation() const
   {
     return static_cast<Operation>(method_in_->get_standard_value().toInt());
@@ -66,6 +68,8 @@ public:
 
   virtual void ProcessSamples(NodeValueDatabase &values, const SampleBufferPtr input, SampleBufferPtr output, int index) const override;
 
+  virtual bool ProcessSampleBlock(const SampleParamCurveMap &params, const SampleBufferPtr input, SampleBufferPtr output) const override;
+
 private:
   NodeInput* method_in_;
 
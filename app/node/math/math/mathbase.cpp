@@ -23,6 +23,7 @@
 #include <QMatrix4x4>
 #include <QVector2D>
 
+#include "codec/samplekernels.h"
 #include "common/tohex.h"
 #include "node/distort/transform/transformdistortnode.h"
 #include "render/color.h"
@@ -257,23 +258,30 @@ NodeValueTable MathNodeBase::ValueInternal(NodeValueDatabase &value, Operation o
 
     SampleBufferPtr mixed_samples = SampleBuffer::CreateAllocated(samples_a->audio_params(), max_samples);
 
-    for (int i=0;i<mixed_samples->audio_params().channel_count();i++) {
-      // Mix samples that are in both buffers
-      for (int j=0;j<min_samples;j++) {
-        mixed_samples->data()[i][j] = PerformAll<float, float>(operation, samples_a->data()[i][j], samples_b->data()[i][j]);
-      }
-    }
+    bool a_is_larger = (max_samples == samples_a->sample_count());
+    SampleBufferPtr larger_buffer = a_is_larger ? samples_a : samples_b;
+    SampleBufferPtr smaller_buffer = a_is_larger ? samples_b : samples_a;
 
-    if (max_samples > min_samples) {
-      // Fill in remainder space with 0s
-      int remainder = max_samples - min_samples;
+    for (int i=0;i<mixed_samples->audio_params().channel_count();i++) {
+      float* dst = mixed_samples->data()[i];
 
-      SampleBufferPtr larger_buffer = (max_samples == samples_a->sample_count()) ? samples_a : samples_b;
+      // Start from the larger buffer, which also fills the remainder the smaller one doesn't cover
+      memcpy(dst, larger_buffer->const_data()[i], max_samples * sizeof(float));
 
-      for (int i=0;i<mixed_samples->audio_params().channel_count();i++) {
-        memcpy(&mixed_samples->data()[i][min_samples],
-               &larger_buffer->data()[i][min_samples],
-               remainder * sizeof(float));
+      if (operation == kOpAdd) {
+        // Mixing, the common case, accumulates the other buffer in place
+        SampleKernels::MultiplyAdd(dst, smaller_buffer->const_data()[i], min_samples, 1.0f);
+      } else if (operation == kOpSubtract) {
+        if (a_is_larger) {
+          SampleKernels::MultiplyAdd(dst, samples_b->const_data()[i], min_samples, -1.0f);
+        } else {
+          SampleKernels::Multiply(dst, min_samples, -1.0f);
+          SampleKernels::MultiplyAdd(dst, samples_a->const_data()[i], min_samples, 1.0f);
+        }
+      } else {
+        for (int j=0;j<min_samples;j++) {
+          dst[j] = PerformAll<float, float>(operation, samples_a->const_data()[i][j], samples_b->const_data()[i][j]);
+        }
       }
     }
 
@@ -395,6 +403,45 @@ void MathNodeBase::ProcessSamplesInternal(NodeValueDatabase &values, MathNodeBas
   }
 }
 
+bool MathNodeBase::ProcessSampleBlockInternal(const SampleParamCurveMap &params, MathNodeBase::Operation operation, NodeInput *param_a_in, NodeInput *param_b_in, const SampleBufferPtr input, SampleBufferPtr output) const
+{
+  // This function is only used for sample+number pairing
+  SampleParamCurve number = params.value(param_a_in->id());
+
+  if (!number.IsValid()) {
+    number = params.value(param_b_in->id());
+
+    if (!number.IsValid()) {
+      return false;
+    }
+  }
+
+  for (int i=0;i<output->audio_params().channel_count();i++) {
+    const float* in = input->data()[i];
+    float* out = output->data()[i];
+
+    switch (operation) {
+    case kOpAdd:
+      PerformBlock(in, number, out, output->sample_count(), [](float x, float y){return x + y;});
+      break;
+    case kOpSubtract:
+      PerformBlock(in, number, out, output->sample_count(), [](float x, float y){return x - y;});
+      break;
+    case kOpMultiply:
+      PerformBlock(in, number, out, output->sample_count(), [](float x, float y){return x * y;});
+      break;
+    case kOpDivide:
+      PerformBlock(in, number, out, output->sample_count(), [](float x, float y){return x / y;});
+      break;
+    case kOpPower:
+      PerformBlock(in, number, out, output->sample_count(), [](float x, float y){return qPow(x, y);});
+      break;
+    }
+  }
+
+  return true;
+}
+
 float MathNodeBase::RetrieveNumber(const NodeValue &val)
 {
   if (val.type() == NodeParam::kRational) {
@@ -523,6 +570,25 @@ const NodeValue &MathNodeBase::PairingCalculator::GetMostLikelyValueB() const
   return most_likely_value_b_;
 }
 
+template<typename Func>
+void MathNodeBase::PerformBlock(const float *in, const SampleParamCurve &number, float *out, int count, Func func)
+{
+  // Kept as plain loops over contiguous memory so the compiler can vectorize them
+  if (number.IsConstant()) {
+    const float n = number.at(0);
+
+    for (int i=0;i<count;i++) {
+      out[i] = func(in[i], n);
+    }
+  } else {
+    const float* n = number.data();
+
+    for (int i=0;i<count;i++) {
+      out[i] = func(in[i], n[i]);
+    }
+  }
+}
+
 template<typename T, typename U>
 T MathNodeBase::PerformAll(Operation operation, T a, U b)
 {
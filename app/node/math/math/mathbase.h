@@ -99,6 +99,9 @@ protected:
   template<typename T, typename U>
   static T PerformAddSubMultDiv(Operation operation, T a, U b);
 
+  template<typename Func>
+  static void PerformBlock(const float* in, const SampleParamCurve& number, float* out, int count, Func func);
+
   static QString GetShaderUniformType(const NodeParam::DataType& type);
 
   static QString GetShaderVariableCall(const QString& input_id, const NodeParam::DataType& type, const QString &coord_op = QString());
@@ -117,6 +120,8 @@ protected:
 
   void ProcessSamplesInternal(NodeValueDatabase &values, Operation operation, NodeInput* param_a_in, NodeInput* param_b_in, const SampleBufferPtr input, SampleBufferPtr output, int index) const;
 
+  bool ProcessSampleBlockInternal(const SampleParamCurveMap &params, Operation operation, NodeInput* param_a_in, NodeInput* param_b_in, const SampleBufferPtr input, SampleBufferPtr output) const;
+
 };
 
 }
@@ -109,11 +109,11 @@ NodeInput *MergeNode::blend_in() const
 void MergeNode::Hash(QCryptographicHash &hash, const rational &time) const
 {
   if (base_in_->is_connected()) {
-    base_in_->get_connected_node()->Hash(hash, time);
+    hash.addData(base_in_->get_connected_node()->GetCachedHash(time));
   }
 
   if (blend_in_->is_connected()) {
-    blend_in_->get_connected_node()->Hash(hash, time);
+    hash.addData(blend_in_->get_connected_node()->GetCachedHash(time));
   }
 }
 
@@ -34,8 +34,17 @@
 
 namespace olive {
 
+const QCryptographicHash::Algorithm Node::kHashAlgorithm = QCryptographicHash::Md5;
+const int Node::kMaxCachedHashes = 4096;
+
+thread_local Node::InvalidationPass* Node::current_invalidation_pass_ = nullptr;
+QAtomicInteger<quint64> Node::next_invalidation_epoch_(1);
+
 Node::Node() :
-  can_be_deleted_(true)
+  invalidation_epoch_(0),
+  invalidation_position_(-1),
+  can_be_deleted_(true),
+  hash_time_invariant_(-1)
 {
   output_ = new NodeOutput("node_out");
   AddParameter(output_);
@@ -193,6 +202,8 @@ void Node::AddParameter(NodeParam *param)
 
   if (param->type() == NodeParam::kInput) {
     ConnectInput(static_cast<NodeInput*>(param));
+
+    NodeExecutionPlan::StructureChanged();
   }
 }
 
@@ -205,6 +216,10 @@ void Node::InvalidateCache(const TimeRange &range, NodeInput *from, NodeInput *s
 {
   Q_UNUSED(from)
 
+  ClearHashCache();
+
+  emit CacheInvalidated(range);
+
   SendInvalidateCache(range, source);
 }
 
@@ -304,6 +319,21 @@ void Node::CopyDependencyGraph(const QVector<Node *> &src, const QVector<Node *>
 
 void Node::SendInvalidateCache(const TimeRange &range, NodeInput *source)
 {
+  // Rather than calling every connected node straight away, which visits nodes once per path
+  // through the graph, ranges are queued on the inputs they arrive on and each node is called
+  // once its upstream nodes have all been called
+  InvalidationPass* pass = current_invalidation_pass_;
+  InvalidationPass local_pass;
+  bool starts_pass = !pass;
+
+  if (starts_pass) {
+    pass = &local_pass;
+    pass->epoch = next_invalidation_epoch_.fetchAndAddRelaxed(1);
+    pass->position = 0;
+    AppendDownstream(pass, this);
+    current_invalidation_pass_ = pass;
+  }
+
   // Loop through all parameters (there should be no children that are not NodeParams)
   foreach (NodeParam* param, params_) {
     // If the Node is an output, relay the signal to any Nodes that are connected to it
@@ -312,10 +342,96 @@ void Node::SendInvalidateCache(const TimeRange &range, NodeInput *source)
         NodeInput* connected_input = edge->input();
         Node* connected_node = connected_input->parentNode();
 
-        // Send clear cache signal to the Node
-        connected_node->InvalidateCache(range, connected_input, source);
+        if (connected_node->invalidation_epoch_ != pass->epoch
+            || connected_node->invalidation_position_ < pass->position) {
+          // Not in this pass or already called (e.g. an override invalidated an unrelated range
+          // mid-pass), run it and everything after it again
+          pass->order.append(connected_node);
+          connected_node->invalidation_position_ = pass->order.size() - 1;
+          connected_node->invalidation_epoch_ = pass->epoch;
+          AppendDownstream(pass, connected_node);
+        }
+
+        QMap<NodeInput*, PendingInvalidation>& inputs = pass->pending[connected_node];
+        auto existing = inputs.find(connected_input);
+
+        if (existing == inputs.end()) {
+          existing = inputs.insert(connected_input, {TimeRangeList(), source});
+        }
+
+        existing->ranges.insert(range);
+      }
+    }
+  }
+
+  if (starts_pass) {
+    for (; pass->position<pass->order.size(); pass->position++) {
+      Node* n = pass->order.at(pass->position);
+
+      if (n->invalidation_position_ != pass->position) {
+        // Appended again later on, it'll be called there
+        continue;
+      }
+
+      QMap<NodeInput*, PendingInvalidation> inputs = pass->pending.take(n);
+
+      for (auto it=inputs.cbegin(); it!=inputs.cend(); it++) {
+        foreach (const TimeRange& r, it->ranges) {
+          n->InvalidateCache(r, it.key(), it->source);
+        }
       }
     }
+
+    current_invalidation_pass_ = nullptr;
+  }
+}
+
+void Node::AppendDownstream(InvalidationPass *pass, Node *from)
+{
+  // Reverse post-order of a depth-first walk along output edges. Nodes already in the pass are
+  // skipped, if they're reached again they're appended as they're sent ranges.
+  QVector<Node*> post_order;
+  QVector<QPair<Node*, bool> > stack;
+
+  stack.append({from, false});
+
+  while (!stack.isEmpty()) {
+    QPair<Node*, bool> top = stack.takeLast();
+    Node* n = top.first;
+
+    if (top.second) {
+      post_order.append(n);
+      continue;
+    }
+
+    if (n != from) {
+      if (n->invalidation_epoch_ == pass->epoch) {
+        continue;
+      }
+
+      n->invalidation_epoch_ = pass->epoch;
+    }
+
+    stack.append({n, true});
+
+    foreach (NodeParam* param, n->params_) {
+      if (param->type() == NodeParam::kOutput) {
+        foreach (NodeEdgePtr edge, param->edges()) {
+          Node* connected = edge->input()->parentNode();
+
+          if (connected->invalidation_epoch_ != pass->epoch) {
+            stack.append({connected, false});
+          }
+        }
+      }
+    }
+  }
+
+  // `from` is last in the post order and is either the origin or has been appended already
+  for (int i=post_order.size()-2; i>=0; i--) {
+    Node* n = post_order.at(i);
+    pass->order.append(n);
+    n->invalidation_position_ = pass->order.size() - 1;
   }
 }
 
@@ -391,6 +507,11 @@ void Node::GizmoRelease()
 {
 }
 
+bool Node::GetGizmoImageGeometry(NodeValueDatabase &, QTransform *, QRectF *)
+{
+  return false;
+}
+
 const QString &Node::GetLabel() const
 {
   return label_;
@@ -421,7 +542,7 @@ void Node::Hash(QCryptographicHash &hash, const rational& time) const
 
     if (input->is_connected()) {
       // Traverse down this edge
-      input->get_connected_node()->Hash(hash, input_time);
+      hash.addData(input->get_connected_node()->GetCachedHash(input_time));
     } else {
       // Grab the value at this time
       QVariant value = input->get_value_at_time(input_time);
@@ -458,8 +579,9 @@ void Node::Hash(QCryptographicHash &hash, const rational& time) const
           hash.addData(reinterpret_cast<const char*>(&image_stream->pixel_aspect_ratio()), sizeof(rational));
         }
 
-        // Footage timestamp
-        if (stream->type() == Stream::kVideo) {
+        // Footage timestamp, stills look the same at every time so they don't get one
+        if (stream->type() == Stream::kVideo
+            && static_cast<VideoStream*>(stream)->video_type() != VideoStream::kVideoTypeStill) {
           VideoStream* video_stream = static_cast<VideoStream*>(stream);
 
           int64_t video_ts = Timecode::time_to_timestamp(input_time, video_stream->timebase());
@@ -475,6 +597,130 @@ void Node::Hash(QCryptographicHash &hash, const rational& time) const
   }
 }
 
+QByteArray Node::GetCachedHash(const rational &time) const
+{
+  if (IsHashTimeInvariant()) {
+    QMutexLocker locker(&hash_cache_lock_);
+
+    if (time_invariant_hash_.isEmpty()) {
+      time_invariant_hash_ = GenerateHash(time);
+    }
+
+    return time_invariant_hash_;
+  }
+
+  QMutexLocker locker(&hash_cache_lock_);
+
+  QMap<rational, QByteArray>::const_iterator existing = hash_cache_.constFind(time);
+  if (existing != hash_cache_.constEnd()) {
+    return existing.value();
+  }
+
+  if (hash_cache_.size() >= kMaxCachedHashes) {
+    hash_cache_.clear();
+  }
+
+  QByteArray h = GenerateHash(time);
+  hash_cache_.insert(time, h);
+  return h;
+}
+
+NodeExecutionPlanPtr Node::GetExecutionPlan() const
+{
+  QMutexLocker locker(&plan_lock_);
+
+  if (!plan_ || plan_->IsStale()) {
+    plan_ = NodeExecutionPlan::Compile(this);
+  }
+
+  return plan_;
+}
+
+bool FootageIsTimeInvariant(NodeInput* input)
+{
+  Stream* stream = Node::ValueToPtr<Stream>(input->get_standard_value());
+
+  return stream
+      && stream->type() == Stream::kVideo
+      && static_cast<VideoStream*>(stream)->video_type() == VideoStream::kVideoTypeStill;
+}
+
+bool Node::HashIsTimeInvariant() const
+{
+  foreach (NodeInput* input, GetInputsToHash()) {
+    if (input->is_keyframing()
+        || (input->data_type() == NodeParam::kFootage && !FootageIsTimeInvariant(input))) {
+      return false;
+    }
+
+    if (input->is_connected() && !input->get_connected_node()->IsHashTimeInvariant()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool Node::HashIsConstantOver(const TimeRange &range) const
+{
+  foreach (NodeInput* input, GetInputsToHash()) {
+    if (input->data_type() == NodeParam::kFootage && !FootageIsTimeInvariant(input)) {
+      return false;
+    }
+
+    TimeRange input_range = InputTimeAdjustment(input, range);
+
+    if (input->is_connected()) {
+      if (!input->get_connected_node()->IsHashConstantOver(input_range)) {
+        return false;
+      }
+    } else if (input->is_keyframing()) {
+      // Values only change between the first and last keyframe of each track
+      foreach (const NodeInput::KeyframeTrack& track, input->keyframe_tracks()) {
+        if (!track.isEmpty()
+            && track.first()->time() < input_range.out()
+            && track.last()->time() > input_range.in()) {
+          return false;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+bool Node::IsHashConstantOver(const TimeRange &range) const
+{
+  return IsHashTimeInvariant() || HashIsConstantOver(range);
+}
+
+bool Node::IsHashTimeInvariant() const
+{
+  QMutexLocker locker(&hash_cache_lock_);
+
+  if (hash_time_invariant_ == -1) {
+    hash_time_invariant_ = HashIsTimeInvariant() ? 1 : 0;
+  }
+
+  return hash_time_invariant_;
+}
+
+QByteArray Node::GenerateHash(const rational &time) const
+{
+  QCryptographicHash hasher(kHashAlgorithm);
+  Hash(hasher, time);
+  return hasher.result();
+}
+
+void Node::ClearHashCache()
+{
+  QMutexLocker locker(&hash_cache_lock_);
+
+  hash_cache_.clear();
+  time_invariant_hash_.clear();
+  hash_time_invariant_ = -1;
+}
+
 void Node::CopyInputs(Node *source, Node *destination, bool include_connections)
 {
   Q_ASSERT(source->id() == destination->id());
@@ -574,10 +820,39 @@ ShaderCode Node::GetShaderCode(const QString &shader_id) const
   return ShaderCode(QString(), QString());
 }
 
+bool Node::SupportsLowPrecisionOutput(const QString &shader_id) const
+{
+  Q_UNUSED(shader_id)
+
+  return false;
+}
+
+bool Node::IsPrecisionSensitive() const
+{
+  return false;
+}
+
+bool Node::IsShaderOutputUniform(const QString &shader_id) const
+{
+  Q_UNUSED(shader_id)
+
+  return false;
+}
+
+int Node::GetRegionOfInterestMargin() const
+{
+  return 0;
+}
+
 void Node::ProcessSamples(NodeValueDatabase &, const SampleBufferPtr, SampleBufferPtr, int) const
 {
 }
 
+bool Node::ProcessSampleBlock(const SampleParamCurveMap &, const SampleBufferPtr, SampleBufferPtr) const
+{
+  return false;
+}
+
 void Node::GenerateFrame(FramePtr frame, const GenerateJob &job) const
 {
   Q_UNUSED(frame)
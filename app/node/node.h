@@ -21,7 +21,11 @@
 #ifndef NODE_H
 #define NODE_H
 
+#include <QAtomicInteger>
 #include <QCryptographicHash>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
 #include <QObject>
 #include <QPainter>
 #include <QPointF>
@@ -31,6 +35,7 @@
 #include "codec/samplebuffer.h"
 #include "common/rational.h"
 #include "common/xmlutils.h"
+#include "node/executionplan.h"
 #include "node/input.h"
 #include "node/inputarray.h"
 #include "node/output.h"
@@ -182,11 +187,58 @@ public:
    */
   virtual ShaderCode GetShaderCode(const QString& shader_id) const;
 
+  /**
+   * @brief Returns TRUE if this shader's output can be stored at 8 bits per channel in preview
+   *
+   * Only used for RenderMode::kPrecisionPerformance. Nodes that output flat colors or masks can
+   * return TRUE, anything that passes through or filters an image should leave this FALSE since
+   * 8-bit linear intermediates band visibly. The default returns FALSE.
+   */
+  virtual bool SupportsLowPrecisionOutput(const QString& shader_id) const;
+
+  /**
+   * @brief Returns TRUE if this node's output suffers when intermediates are stored at half float
+   *
+   * Exports with automatic precision (see ExportParams::auto_precision()) only drop to half float
+   * intermediates if no node in the graph returns TRUE. Nodes whose output can leave half float's
+   * range or that amplify small differences should return TRUE. The default returns FALSE.
+   */
+  virtual bool IsPrecisionSensitive() const;
+
+  /**
+   * @brief Returns TRUE if this shader outputs the same color for every pixel
+   *
+   * Only considered when the shader has no texture inputs. Its output is then realized as a
+   * single pixel, which samples the same as a full frame of that color. The default returns FALSE.
+   */
+  virtual bool IsShaderOutputUniform(const QString& shader_id) const;
+
+  /**
+   * @brief How far from an output pixel this node reads its texture inputs, in sequence pixels
+   *
+   * Used for region of interest rendering, where only the part of the frame visible in the viewer
+   * (expanded by the margins of every node that contributes to it) is rendered. Return -1 if this
+   * node can read anywhere in its inputs (e.g. a transform), in which case the whole frame is
+   * always rendered. The default returns 0, i.e. the node only reads its inputs at the pixel it's
+   * writing.
+   */
+  virtual int GetRegionOfInterestMargin() const;
+
   /**
    * @brief If Value() pushes a ShaderJob, this is the function that will process them.
    */
   virtual void ProcessSamples(NodeValueDatabase &values, const SampleBufferPtr input, SampleBufferPtr output, int index) const;
 
+  /**
+   * @brief Block version of ProcessSamples() that processes the whole buffer at once
+   *
+   * `params` contains a curve for each numeric value in the SampleJob, keyed by input ID, already
+   * evaluated across every sample of the buffer. Nodes that can work on a whole buffer should
+   * override this and return TRUE. The default returns FALSE, in which case ProcessSamples() is
+   * called for each sample instead.
+   */
+  virtual bool ProcessSampleBlock(const SampleParamCurveMap &params, const SampleBufferPtr input, SampleBufferPtr output) const;
+
   /**
    * @brief If Value() pushes a GenerateJob, override this function for the image to create
    *
@@ -311,6 +363,10 @@ public:
    * Default behavior is to relay this signal to all connected outputs, which will need to be done as to not break
    * the DAG. Even if the time needs to be transformed somehow (e.g. converting media time to sequence time), you can
    * call this function with transformed time and relay the signal that way.
+   *
+   * Relaying is done as a single pass over the downstream graph in topological order (see
+   * SendInvalidateCache()), so with fan-in a node is called once per input with the ranges that
+   * arrived on it merged, rather than once for every path from the edit.
    */
   virtual void InvalidateCache(const TimeRange& range, NodeInput* from, NodeInput* source);
 
@@ -426,11 +482,63 @@ public:
   virtual void GizmoMove(const QPointF& p, const rational &time);
   virtual void GizmoRelease();
 
+  /**
+   * @brief Where this node's image ends up with the values in `db`, for previewing gizmo drags
+   *
+   * `transform` maps the image to sequence pixels and `clip` is set to the part of the sequence
+   * it's visible in, or left null if it isn't clipped. While a gizmo is dragged, the viewer moves
+   * the last rendered image from where this was when it rendered to where it is now rather than
+   * rendering for every movement.
+   *
+   * Returns FALSE if this node's changes can't be approximated this way, which is the default.
+   */
+  virtual bool GetGizmoImageGeometry(NodeValueDatabase& db, QTransform* transform, QRectF* clip);
+
   const QString& GetLabel() const;
   void SetLabel(const QString& s);
 
   virtual void Hash(QCryptographicHash& hash, const rational &time) const;
 
+  /**
+   * @brief Returns the hash of this node and everything connected to it at a given time
+   *
+   * Results are kept until InvalidateCache() is called, and if nothing in this node's subtree can
+   * change over time, the hash is only generated once for all times. Connected nodes should be
+   * added to a hash with this rather than by calling their Hash() directly so their results can be
+   * reused.
+   *
+   * This function is thread-safe.
+   */
+  QByteArray GetCachedHash(const rational& time) const;
+
+  /**
+   * @brief Returns the flattened graph upstream of this node for NodeTraverser
+   *
+   * The plan is kept until the structure of the graph changes, at which point it's compiled again
+   * the next time it's requested.
+   *
+   * This function is thread-safe.
+   */
+  NodeExecutionPlanPtr GetExecutionPlan() const;
+
+  /**
+   * @brief Returns TRUE if GetCachedHash() is guaranteed to return the same hash for every time in `range`
+   *
+   * Used to hash long stretches of a sequence (e.g. clips without keyframes or gaps) once rather
+   * than once per frame. A FALSE result only means the hash may change.
+   *
+   * This function is thread-safe.
+   */
+  bool IsHashConstantOver(const TimeRange& range) const;
+
+  /**
+   * @brief Algorithm used for all node hashes
+   *
+   * Hashes are only compared against each other to find identical frames, so this favors speed
+   * over cryptographic strength.
+   */
+  static const QCryptographicHash::Algorithm kHashAlgorithm;
+
 protected:
   void AddInput(NodeInput* input);
 
@@ -444,6 +552,24 @@ protected:
 
   virtual QVector<NodeInput*> GetInputsToHash() const;
 
+  /**
+   * @brief Returns TRUE if Hash() gives the same result regardless of the time
+   *
+   * The default returns TRUE if none of the inputs in GetInputsToHash() are keyframed or
+   * reference footage other than still images, and all connected nodes are time invariant too. Derived classes that add
+   * time-dependent data to the hash should override this.
+   */
+  virtual bool HashIsTimeInvariant() const;
+
+  /**
+   * @brief Returns TRUE if Hash() gives the same result for every time in `range`
+   *
+   * Only called if HashIsTimeInvariant() is FALSE. The default checks that no keyframes fall
+   * within the range and that every connected node is constant over its adjusted range. Derived
+   * classes that add time-dependent data to the hash should override this too.
+   */
+  virtual bool HashIsConstantOver(const TimeRange& range) const;
+
   enum GizmoScaleHandles {
     kGizmoScaleTopLeft,
     kGizmoScaleTopCenter,
@@ -496,6 +622,13 @@ signals:
    */
   void LabelChanged(const QString& s);
 
+  /**
+   * @brief Signal emitted whenever InvalidateCache() reaches this node
+   *
+   * Lets anything caching values produced by this node (e.g. gizmo databases) drop them.
+   */
+  void CacheInvalidated(const olive::TimeRange& range);
+
 private:
   /**
    * @brief Add a parameter to this node
@@ -520,6 +653,58 @@ private:
 
   QVector<Node *> GetDependenciesInternal(bool traverse, bool exclusive_only) const;
 
+  bool IsHashTimeInvariant() const;
+
+  QByteArray GenerateHash(const rational& time) const;
+
+  void ClearHashCache();
+
+  /**
+   * @brief Ranges waiting to be sent into one input during an invalidation pass
+   */
+  struct PendingInvalidation {
+    TimeRangeList ranges;
+    NodeInput* source;
+  };
+
+  /**
+   * @brief State of the invalidation pass running on this thread, see SendInvalidateCache()
+   */
+  struct InvalidationPass {
+    quint64 epoch;
+
+    /// Downstream nodes in topological order, a node may be appended again if it's reached late
+    QVector<Node*> order;
+
+    int position;
+
+    QHash<Node*, QMap<NodeInput*, PendingInvalidation> > pending;
+  };
+
+  /**
+   * @brief Append every node downstream of `from` (not including it) to the pass in topological order
+   */
+  static void AppendDownstream(InvalidationPass* pass, Node* from);
+
+  static thread_local InvalidationPass* current_invalidation_pass_;
+
+  static QAtomicInteger<quint64> next_invalidation_epoch_;
+
+  /**
+   * @brief Mark for AppendDownstream(), the last pass this node was visited by
+   */
+  quint64 invalidation_epoch_;
+
+  /**
+   * @brief Where this node last appeared in the pass's order
+   */
+  int invalidation_position_;
+
+  /**
+   * @brief Maximum number of per-time hashes kept before they're cleared
+   */
+  static const int kMaxCachedHashes;
+
   QVector<NodeParam *> params_;
 
   /**
@@ -542,6 +727,20 @@ private:
    */
   QString label_;
 
+  /**
+   * @brief Hash memoization, see GetCachedHash()
+   */
+  mutable QMutex hash_cache_lock_;
+  mutable QMap<rational, QByteArray> hash_cache_;
+  mutable QByteArray time_invariant_hash_;
+  mutable int hash_time_invariant_;
+
+  /**
+   * @brief Cached plan, see GetExecutionPlan()
+   */
+  mutable QMutex plan_lock_;
+  mutable NodeExecutionPlanPtr plan_;
+
 };
 
 template<class T>
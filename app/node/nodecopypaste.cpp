@@ -20,103 +20,209 @@
 
 #include "nodecopypaste.h"
 
+#include <QClipboard>
+#include <QGuiApplication>
 #include <QMessageBox>
+#include <QMimeData>
 
 #include "core.h"
+#include "node/block/block.h"
 #include "node/factory.h"
+#include "node/input/nested/nestedsequence.h"
 #include "widget/nodeview/nodeviewundo.h"
 #include "window/mainwindow/mainwindow.h"
 
 namespace olive {
 
-void NodeCopyPasteService::CopyNodesToClipboard(const QVector<Node *> &nodes, void *userdata)
+/**
+ * @brief Clipboard data holding copied nodes as in-memory clones
+ *
+ * Pasting inside Olive clones these again rather than round tripping the whole selection through
+ * XML. The XML is only written if another application asks for the clipboard's text.
+ */
+class NodeClipboardData : public QMimeData
 {
-  QString copy_str;
+public:
+  NodeClipboardData(const QVector<Node*>& nodes, const QString& custom) :
+    nodes_(nodes),
+    custom_(custom)
+  {
+  }
+
+  virtual ~NodeClipboardData() override
+  {
+    qDeleteAll(nodes_);
+  }
+
+  DISABLE_COPY_MOVE(NodeClipboardData)
+
+  const QVector<Node*>& nodes() const
+  {
+    return nodes_;
+  }
+
+  const QString& custom() const
+  {
+    return custom_;
+  }
+
+  virtual QStringList formats() const override
+  {
+    return {QStringLiteral("text/plain")};
+  }
+
+protected:
+  virtual QVariant retrieveData(const QString &mimetype, QVariant::Type preferredType) const override
+  {
+    Q_UNUSED(preferredType)
+
+    if (mimetype != QStringLiteral("text/plain")) {
+      return QVariant();
+    }
+
+    if (text_.isEmpty()) {
+      text_ = ToXml();
+    }
+
+    return text_;
+  }
+
+private:
+  QString ToXml() const
+  {
+    QString copy_str;
 
-  QXmlStreamWriter writer(&copy_str);
-  writer.setAutoFormatting(true);
+    QXmlStreamWriter writer(&copy_str);
+    writer.setAutoFormatting(true);
 
-  writer.writeStartDocument();
-  writer.writeStartElement(QStringLiteral("olive"));
+    writer.writeStartDocument();
+    writer.writeStartElement(QStringLiteral("olive"));
 
-  foreach (Node* n, nodes) {
-    writer.writeStartElement(QStringLiteral("node"));
-    writer.writeAttribute(QStringLiteral("id"), n->id());
-    n->Save(&writer);
-    writer.writeEndElement(); // node
+    foreach (Node* n, nodes_) {
+      writer.writeStartElement(QStringLiteral("node"));
+      writer.writeAttribute(QStringLiteral("id"), n->id());
+      n->Save(&writer);
+      writer.writeEndElement(); // node
+    }
+
+    // The custom section was already written at copy time, copy it through token by token
+    QXmlStreamReader reader(custom_);
+    while (!reader.atEnd()) {
+      reader.readNext();
+
+      if (!reader.isStartDocument() && !reader.isEndDocument()) {
+        writer.writeCurrentToken(reader);
+      }
+    }
+
+    writer.writeEndElement(); // olive
+    writer.writeEndDocument();
+
+    return copy_str;
+  }
+
+  QVector<Node*> nodes_;
+
+  QString custom_;
+
+  mutable QString text_;
+
+};
+
+void NodeCopyPasteService::CopyNodesToClipboard(const QVector<Node *> &nodes, void *userdata)
+{
+  // Clone the nodes as they are now, the clipboard owns the clones from here
+  QVector<Node*> clones(nodes.size());
+
+  for (int i=0; i<nodes.size(); i++) {
+    Node* c = nodes.at(i)->copy();
+    Node::CopyInputs(nodes.at(i), c, false);
+    clones[i] = c;
+    copy_clones_.insert(nodes.at(i), c);
+  }
+
+  Node::CopyDependencyGraph(nodes, clones, nullptr);
+
+  for (int i=0; i<nodes.size(); i++) {
+    if (nodes.at(i)->IsBlock()) {
+      for (int j=i+1; j<nodes.size(); j++) {
+        if (nodes.at(j)->IsBlock()
+            && Block::AreLinked(static_cast<Block*>(nodes.at(i)), static_cast<Block*>(nodes.at(j)))) {
+          Block::Link(static_cast<Block*>(clones.at(i)), static_cast<Block*>(clones.at(j)));
+        }
+      }
+    }
   }
 
+  QString custom_str;
+
+  QXmlStreamWriter writer(&custom_str);
   writer.writeStartElement(QStringLiteral("custom"));
   CopyNodesToClipboardInternal(&writer, userdata);
   writer.writeEndElement(); // custom
 
-  writer.writeEndElement(); // olive
-  writer.writeEndDocument();
+  copy_clones_.clear();
 
-  Core::CopyStringToClipboard(copy_str);
+  QGuiApplication::clipboard()->setMimeData(new NodeClipboardData(clones, custom_str));
 }
 
 QVector<Node *> NodeCopyPasteService::PasteNodesFromClipboard(Sequence *graph, QUndoCommand* command, void *userdata)
 {
-  QString clipboard = Core::PasteStringFromClipboard();
-
-  if (clipboard.isEmpty()) {
-    return QVector<Node*>();
-  }
-
-  QXmlStreamReader reader(clipboard);
-
   QVector<Node*> pasted_nodes;
   XMLNodeData xml_node_data;
 
-  while (XMLReadNextStartElement(&reader)) {
-    if (reader.name() == QStringLiteral("olive")) {
-      while (XMLReadNextStartElement(&reader)) {
-        if (reader.name() == QStringLiteral("node")) {
-          Node* node = nullptr;
+  const NodeClipboardData* clipboard_data = dynamic_cast<const NodeClipboardData*>(QGuiApplication::clipboard()->mimeData());
 
-          XMLAttributeLoop((&reader), attr) {
-            if (attr.name() == QStringLiteral("id")) {
-              node = NodeFactory::CreateFromID(attr.value().toString());
-              break;
-            }
-          }
+  if (clipboard_data) {
+    // Copied from this instance, clone the clones and skip XML entirely
+    const QVector<Node*>& clones = clipboard_data->nodes();
 
-          if (node) {
-            node->Load(&reader, xml_node_data, nullptr);
+    if (clones.isEmpty()) {
+      return QVector<Node*>();
+    }
 
-            pasted_nodes.append(node);
-          }
-        } else if (reader.name() == QStringLiteral("custom")) {
-          PasteNodesFromClipboardInternal(&reader, xml_node_data, userdata);
-        } else {
-          reader.skipCurrentElement();
+    foreach (Node* src, clones) {
+      Node* c = src->copy();
+      Node::CopyInputs(src, c, false);
+      pasted_nodes.append(c);
+      xml_node_data.node_ptrs.insert(reinterpret_cast<quintptr>(src), c);
+
+      // Footage and sequences may have been deleted since the copy, route them through the same
+      // checks as XML data
+      foreach (NodeInput* input, c->GetInputsIncludingArrays()) {
+        if (input->data_type() == NodeParam::kFootage) {
+          xml_node_data.footage_connections.append({input, reinterpret_cast<quintptr>(Node::ValueToPtr<Stream>(input->get_standard_value()))});
+          input->set_standard_value(QVariant());
         }
       }
-    } else {
-      reader.skipCurrentElement();
-    }
-  }
 
-  if (pasted_nodes.isEmpty()) {
-    // If we passed through the whole string and there were no nodes, it must not be data for us after all
-    return QVector<Node*>();
-  }
+      if (src->IsBlock()) {
+        foreach (Block* link, static_cast<Block*>(src)->linked_clips()) {
+          xml_node_data.block_links.append({static_cast<Block*>(c), reinterpret_cast<quintptr>(link)});
+        }
+      }
 
-  // If we have some nodes AND the XML data was malformed, the user should probably know
-  if (reader.hasError()) {
-    // Delete all nodes so this is a no-op
-    foreach (Node* n, pasted_nodes) {
-      delete n;
+      NestedSequence* nested = dynamic_cast<NestedSequence*>(c);
+      if (nested) {
+        xml_node_data.sequence_connections.append({nested, reinterpret_cast<quintptr>(nested->sequence())});
+        nested->SetSequence(nullptr);
+      }
     }
 
-    // If this was NOT an internal error, we assume it's an XML error that the user needs to know about
-    QMessageBox::critical(Core::instance()->main_window(),
-                          QCoreApplication::translate("NodeCopyPasteWidget", "Error pasting nodes"),
-                          QCoreApplication::translate("NodeCopyPasteWidget", "Failed to paste nodes: %1").arg(reader.errorString()),
-                          QMessageBox::Ok);
+    QXmlStreamReader reader(clipboard_data->custom());
+    if (XMLReadNextStartElement(&reader) && reader.name() == QStringLiteral("custom")) {
+      PasteNodesFromClipboardInternal(&reader, xml_node_data, userdata);
+    }
+  } else {
+    QString clipboard = Core::PasteStringFromClipboard();
 
-    return QVector<Node*>();
+    if (clipboard.isEmpty()) {
+      return QVector<Node*>();
+    }
+
+    if (!PasteNodesFromXml(clipboard, pasted_nodes, xml_node_data, userdata)) {
+      return QVector<Node*>();
+    }
   }
 
   // Add all nodes to graph
@@ -125,7 +231,9 @@ QVector<Node *> NodeCopyPasteService::PasteNodesFromClipboard(Sequence *graph, Q
   }
 
   // Make connections
-  if (!xml_node_data.desired_connections.isEmpty()) {
+  if (clipboard_data) {
+    Node::CopyDependencyGraph(clipboard_data->nodes(), pasted_nodes, command);
+  } else if (!xml_node_data.desired_connections.isEmpty()) {
     XMLConnectNodes(xml_node_data, command);
   }
 
@@ -163,9 +271,90 @@ QVector<Node *> NodeCopyPasteService::PasteNodesFromClipboard(Sequence *graph, Q
     }
   }
 
+  // Connect nested sequences to existing sequences, unless that would nest one inside itself
+  if (!xml_node_data.sequence_connections.isEmpty()) {
+    QVector<Item*> sequences = graph->project()->get_items_of_type(Item::kSequence);
+
+    foreach (const XMLNodeData::SequenceConnection& con, xml_node_data.sequence_connections) {
+      foreach (Item* item, sequences) {
+        if (reinterpret_cast<quintptr>(item) == con.sequence) {
+          Sequence* s = static_cast<Sequence*>(item);
+
+          if (NestedSequence::CanNest(s, graph)) {
+            con.node->SetSequence(s);
+          }
+          break;
+        }
+      }
+    }
+  }
+
   return pasted_nodes;
 }
 
+quintptr NodeCopyPasteService::GetClipboardPtr(Node *n) const
+{
+  return reinterpret_cast<quintptr>(copy_clones_.value(n, n));
+}
+
+bool NodeCopyPasteService::PasteNodesFromXml(const QString &xml, QVector<Node*>& pasted_nodes, XMLNodeData &xml_node_data, void *userdata)
+{
+  QXmlStreamReader reader(xml);
+
+  while (XMLReadNextStartElement(&reader)) {
+    if (reader.name() == QStringLiteral("olive")) {
+      while (XMLReadNextStartElement(&reader)) {
+        if (reader.name() == QStringLiteral("node")) {
+          Node* node = nullptr;
+
+          XMLAttributeLoop((&reader), attr) {
+            if (attr.name() == QStringLiteral("id")) {
+              node = NodeFactory::CreateFromID(attr.value().toString());
+              break;
+            }
+          }
+
+          if (node) {
+            node->Load(&reader, xml_node_data, nullptr);
+
+            pasted_nodes.append(node);
+          }
+        } else if (reader.name() == QStringLiteral("custom")) {
+          PasteNodesFromClipboardInternal(&reader, xml_node_data, userdata);
+        } else {
+          reader.skipCurrentElement();
+        }
+      }
+    } else {
+      reader.skipCurrentElement();
+    }
+  }
+
+  if (pasted_nodes.isEmpty()) {
+    // If we passed through the whole string and there were no nodes, it must not be data for us after all
+    return false;
+  }
+
+  // If we have some nodes AND the XML data was malformed, the user should probably know
+  if (reader.hasError()) {
+    // Delete all nodes so this is a no-op
+    foreach (Node* n, pasted_nodes) {
+      delete n;
+    }
+
+    // If this was NOT an internal error, we assume it's an XML error that the user needs to know about
+    QMessageBox::critical(Core::instance()->main_window(),
+                          QCoreApplication::translate("NodeCopyPasteWidget", "Error pasting nodes"),
+                          QCoreApplication::translate("NodeCopyPasteWidget", "Failed to paste nodes: %1").arg(reader.errorString()),
+                          QMessageBox::Ok);
+
+    pasted_nodes.clear();
+    return false;
+  }
+
+  return true;
+}
+
 void NodeCopyPasteService::CopyNodesToClipboardInternal(QXmlStreamWriter*, void*)
 {
 }
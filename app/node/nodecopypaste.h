@@ -43,6 +43,20 @@ protected:
 
   virtual void PasteNodesFromClipboardInternal(QXmlStreamReader *reader, XMLNodeData &xml_node_data, void* userdata);
 
+  /**
+   * @brief Returns the pointer a node will have in the copied data
+   *
+   * Copied nodes are held on the clipboard as clones, so any pointers written by
+   * CopyNodesToClipboardInternal() should go through this to match them up on paste. Only valid
+   * during CopyNodesToClipboardInternal().
+   */
+  quintptr GetClipboardPtr(Node* n) const;
+
+private:
+  bool PasteNodesFromXml(const QString& xml, QVector<Node*>& pasted_nodes, XMLNodeData& xml_node_data, void* userdata);
+
+  QHash<Node*, Node*> copy_clones_;
+
 };
 
 }
@@ -20,9 +20,11 @@
 
 #include "track.h"
 
+#include <algorithm>
 #include <QApplication>
 #include <QDebug>
 #include <QFontMetrics>
+#include <QSet>
 
 #include "node/block/gap/gap.h"
 #include "node/graph.h"
@@ -36,7 +38,10 @@ const double TrackOutput::kTrackHeightInterval = 0.5;
 TrackOutput::TrackOutput() :
   track_type_(Timeline::kTrackTypeNone),
   index_(-1),
-  locked_(false)
+  locked_(false),
+  lookup_hint_(0),
+  operation_depth_(0),
+  pending_refresh_from_(-1)
 {
   block_input_ = new NodeInputArray("block_in", NodeParam::kAny);
   block_input_->set_is_keyframable(false);
@@ -145,12 +150,10 @@ void TrackOutput::SetIndex(const int &index)
 
 Block *TrackOutput::BlockContainingTime(const rational &time) const
 {
-  foreach (Block* block, block_cache_) {
-    if (block->in() < time && block->out() > time) {
-      return block;
-    } else if (block->out() == time) {
-      break;
-    }
+  Block* block = BlockAtIndex(FirstBlockEndingAfter(time, true));
+
+  if (block && block->in() < time && block->out() > time) {
+    return block;
   }
 
   return nullptr;
@@ -158,50 +161,26 @@ Block *TrackOutput::BlockContainingTime(const rational &time) const
 
 Block *TrackOutput::NearestBlockBefore(const rational &time) const
 {
-  foreach (Block* block, block_cache_) {
-    // Blocks are sorted by time, so the first Block who's out point is at/after this time is the correct Block
-    if (block->out() >= time) {
-      return block;
-    }
-  }
-
-  return nullptr;
+  // The first Block who's out point is at/after this time is the correct Block
+  return BlockAtIndex(FirstBlockEndingAfter(time, true));
 }
 
 Block *TrackOutput::NearestBlockBeforeOrAt(const rational &time) const
 {
-  foreach (Block* block, block_cache_) {
-    // Blocks are sorted by time, so the first Block who's out point is at/after this time is the correct Block
-    if (block->out() > time) {
-      return block;
-    }
-  }
-
-  return nullptr;
+  // The first Block who's out point is after this time is the correct Block
+  return BlockAtIndex(FirstBlockEndingAfter(time, false));
 }
 
 Block *TrackOutput::NearestBlockAfterOrAt(const rational &time) const
 {
-  foreach (Block* block, block_cache_) {
-    // Blocks are sorted by time, so the first Block after this time is the correct Block
-    if (block->in() >= time) {
-      return block;
-    }
-  }
-
-  return nullptr;
+  // The first Block starting at/after this time is the correct Block
+  return BlockAtIndex(FirstBlockStartingAfter(time, true));
 }
 
 Block *TrackOutput::NearestBlockAfter(const rational &time) const
 {
-  foreach (Block* block, block_cache_) {
-    // Blocks are sorted by time, so the first Block after this time is the correct Block
-    if (block->in() > time) {
-      return block;
-    }
-  }
-
-  return nullptr;
+  // The first Block starting after this time is the correct Block
+  return BlockAtIndex(FirstBlockStartingAfter(time, false));
 }
 
 Block *TrackOutput::BlockAtTime(const rational &time) const
@@ -210,16 +189,12 @@ Block *TrackOutput::BlockAtTime(const rational &time) const
     return nullptr;
   }
 
-  foreach (Block* block, block_cache_) {
-    if (block
-        && block->in() <= time
-        && block->out() > time) {
-      if (block->is_enabled()) {
-        return block;
-      } else {
-        break;
-      }
-    }
+  Block* block = BlockAtIndex(FirstBlockEndingAfter(time, false));
+
+  if (block
+      && block->in() <= time
+      && block->is_enabled()) {
+    return block;
   }
 
   return nullptr;
@@ -233,11 +208,14 @@ QList<Block *> TrackOutput::BlocksAtTimeRange(const TimeRange &range) const
     return list;
   }
 
-  foreach (Block* block, block_cache_) {
-    if (block
-        && block->is_enabled()
-        && block->out() > range.in()
-        && block->in() < range.out()) {
+  for (int i=FirstBlockEndingAfter(range.in(), false); i<block_cache_.size(); i++) {
+    Block* block = block_cache_.at(i);
+
+    if (block->in() >= range.out()) {
+      break;
+    }
+
+    if (block->is_enabled()) {
       list.append(block);
     }
   }
@@ -272,6 +250,46 @@ void TrackOutput::InvalidateCache(const TimeRange &range, NodeInput *from, NodeI
   Node::InvalidateCache(limited, from, source);
 }
 
+void TrackOutput::BeginOperation()
+{
+  if (!operation_depth_) {
+    operation_start_length_ = track_length_;
+  }
+
+  operation_depth_++;
+
+  Node::BeginOperation();
+}
+
+void TrackOutput::EndOperation()
+{
+  operation_depth_--;
+
+  if (!operation_depth_) {
+    // Commit before ending the operation downstream so it sees this track's edit as one change
+    if (pending_refresh_from_ >= 0) {
+      for (int i=pending_refresh_from_; i<block_cache_.size(); i++) {
+        emit block_cache_.at(i)->Refreshed();
+      }
+
+      pending_refresh_from_ = -1;
+    }
+
+    if (track_length_ != operation_start_length_) {
+      emit TrackLengthChanged();
+    }
+
+    TimeRangeList invalidated = pending_invalidation_;
+    pending_invalidation_.clear();
+
+    foreach (const TimeRange& range, invalidated) {
+      Node::InvalidateCache(range, block_input_, block_input_);
+    }
+  }
+
+  Node::EndOperation();
+}
+
 void TrackOutput::InsertBlockBefore(Block* block, Block* after)
 {
   InsertBlockAtIndex(block, block_cache_.indexOf(after));
@@ -300,7 +318,7 @@ void TrackOutput::PrependBlock(Block *block)
   EndOperation();
 
   // Everything has shifted at this point
-  Node::InvalidateCache(TimeRange(0, track_length()), block_input_, block_input_);
+  InvalidateEditedRange(TimeRange(0, track_length()));
 }
 
 void TrackOutput::InsertBlockAtIndex(Block *block, int index)
@@ -314,7 +332,7 @@ void TrackOutput::InsertBlockAtIndex(Block *block, int index)
 
   EndOperation();
 
-  Node::InvalidateCache(TimeRange(block->in(), track_length()), block_input_, block_input_);
+  InvalidateEditedRange(TimeRange(block->in(), track_length()));
 }
 
 void TrackOutput::AppendBlock(Block *block)
@@ -327,7 +345,7 @@ void TrackOutput::AppendBlock(Block *block)
   EndOperation();
 
   // Invalidate area that block was added to
-  Node::InvalidateCache(TimeRange(block->in(), track_length()), block_input_, block_input_);
+  InvalidateEditedRange(TimeRange(block->in(), track_length()));
 }
 
 void TrackOutput::RippleRemoveBlock(Block *block)
@@ -341,7 +359,7 @@ void TrackOutput::RippleRemoveBlock(Block *block)
 
   EndOperation();
 
-  Node::InvalidateCache(TimeRange(remove_in, qMax(track_length(), remove_out)), block_input_, block_input_);
+  InvalidateEditedRange(TimeRange(remove_in, qMax(track_length(), remove_out)));
 }
 
 void TrackOutput::ReplaceBlock(Block *old, Block *replace)
@@ -359,9 +377,9 @@ void TrackOutput::ReplaceBlock(Block *old, Block *replace)
   EndOperation();
 
   if (old->length() == replace->length()) {
-    Node::InvalidateCache(TimeRange(replace->in(), replace->out()), block_input_, block_input_);
+    InvalidateEditedRange(TimeRange(replace->in(), replace->out()));
   } else {
-    Node::InvalidateCache(TimeRange(replace->in(), RATIONAL_MAX), block_input_, block_input_);
+    InvalidateEditedRange(TimeRange(replace->in(), RATIONAL_MAX));
   }
 }
 
@@ -428,14 +446,33 @@ void TrackOutput::Hash(QCryptographicHash &hash, const rational &time) const
 
   // Defer to block at this time, don't add any of our own information to the hash
   if (b) {
-    b->Hash(hash, time);
+    hash.addData(b->GetCachedHash(time));
   }
 }
 
+bool TrackOutput::HashIsConstantOver(const TimeRange &range) const
+{
+  if (IsMuted()) {
+    // Nothing is hashed at any time
+    return true;
+  }
+
+  Block* block = BlockAtIndex(FirstBlockEndingAfter(range.in(), false));
+
+  if (block && block->in() <= range.in()) {
+    // The range has to stay within this one block, which we defer to just like Hash()
+    return range.out() <= block->out()
+        && (!block->is_enabled() || block->IsHashConstantOver(range));
+  }
+
+  // No block here, constant if there aren't any later on either
+  return range.in() >= track_length();
+}
+
 void TrackOutput::SetMuted(bool e)
 {
   muted_input_->set_standard_value(e);
-  Node::InvalidateCache(TimeRange(0, track_length()), block_input_, block_input_);
+  InvalidateEditedRange(TimeRange(0, track_length()));
 }
 
 void TrackOutput::SetLocked(bool e)
@@ -458,13 +495,97 @@ void TrackOutput::UpdateInOutFrom(int index)
 
     b->set_out(last_out);
 
-    emit b->Refreshed();
+    if (!operation_depth_) {
+      emit b->Refreshed();
+    }
+  }
+
+  if (operation_depth_ && index < block_cache_.size()
+      && (pending_refresh_from_ < 0 || index < pending_refresh_from_)) {
+    pending_refresh_from_ = index;
   }
 
   // Update track length
   SetLengthInternal(last_out);
 }
 
+int TrackOutput::FirstBlockEndingAfter(const rational &time, bool inclusive) const
+{
+  // Sequential lookups usually land on the same block as last time or the one after it
+  int hint = lookup_hint_.loadAcquire();
+
+  if (IsFirstBlockEndingAfter(hint, time, inclusive)) {
+    return hint;
+  }
+
+  if (IsFirstBlockEndingAfter(hint + 1, time, inclusive)) {
+    lookup_hint_.storeRelease(hint + 1);
+    return hint + 1;
+  }
+
+  // Blocks are contiguous and sorted by time so their out points can be binary searched
+  QList<Block*>::const_iterator it;
+
+  if (inclusive) {
+    it = std::lower_bound(block_cache_.cbegin(), block_cache_.cend(), time,
+                          [](Block* b, const rational& t){ return b->out() < t; });
+  } else {
+    it = std::upper_bound(block_cache_.cbegin(), block_cache_.cend(), time,
+                          [](const rational& t, Block* b){ return t < b->out(); });
+  }
+
+  int index = it - block_cache_.cbegin();
+
+  lookup_hint_.storeRelease(index);
+
+  return index;
+}
+
+bool TrackOutput::IsFirstBlockEndingAfter(int index, const rational &time, bool inclusive) const
+{
+  // Only valid if this block qualifies and the one before it doesn't, the end of the list is
+  // never taken from the hint since it'd have to be checked against every block anyway
+  if (index < 0 || index >= block_cache_.size()) {
+    return false;
+  }
+
+  const rational& out = block_cache_.at(index)->out();
+
+  if (inclusive ? (out < time) : (out <= time)) {
+    return false;
+  }
+
+  if (index > 0) {
+    const rational& prev_out = block_cache_.at(index - 1)->out();
+
+    if (inclusive ? !(prev_out < time) : (prev_out > time)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int TrackOutput::FirstBlockStartingAfter(const rational &time, bool inclusive) const
+{
+  QList<Block*>::const_iterator it;
+
+  if (inclusive) {
+    it = std::lower_bound(block_cache_.cbegin(), block_cache_.cend(), time,
+                          [](Block* b, const rational& t){ return b->in() < t; });
+  } else {
+    it = std::upper_bound(block_cache_.cbegin(), block_cache_.cend(), time,
+                          [](const rational& t, Block* b){ return t < b->in(); });
+  }
+
+  return it - block_cache_.cbegin();
+}
+
+Block *TrackOutput::BlockAtIndex(int index) const
+{
+  return (index < block_cache_.size()) ? block_cache_.at(index) : nullptr;
+}
+
 int TrackOutput::GetInputIndexFromCacheIndex(int cache_index)
 {
   return GetInputIndexFromCacheIndex(block_cache_.at(cache_index));
@@ -487,26 +608,45 @@ void TrackOutput::SetLengthInternal(const rational &r, bool invalidate)
     TimeRange invalidate_range(track_length_, r);
 
     track_length_ = r;
-    emit TrackLengthChanged();
+
+    if (!operation_depth_) {
+      emit TrackLengthChanged();
+    }
 
     if (invalidate) {
-      Node::InvalidateCache(invalidate_range,
-                            block_input_,
-                            block_input_);
+      InvalidateEditedRange(invalidate_range);
     }
   }
 }
 
+void TrackOutput::InvalidateEditedRange(const TimeRange &range)
+{
+  if (operation_depth_) {
+    pending_invalidation_.insert(range);
+  } else {
+    Node::InvalidateCache(range, block_input_, block_input_);
+  }
+}
+
 void TrackOutput::BlockConnected(NodeEdgePtr edge)
 {
   QList<Block*> new_block_list;
 
+  // Sets for membership tests so rebuilding long tracks isn't quadratic
+  QSet<Block*> new_block_set;
+  QSet<Block*> old_block_set;
+
+  old_block_set.reserve(block_cache_.size());
+  foreach (Block* b, block_cache_) {
+    old_block_set.insert(b);
+  }
+
   foreach (NodeInput* i, block_input_->sub_params()) {
     Node* connected = i->get_connected_node();
 
     if (connected
         && connected->IsBlock()
-        && !new_block_list.contains(static_cast<Block*>(connected))) {
+        && !new_block_set.contains(static_cast<Block*>(connected))) {
       Block* b = static_cast<Block*>(connected);
 
       if (!new_block_list.isEmpty()) {
@@ -515,8 +655,9 @@ void TrackOutput::BlockConnected(NodeEdgePtr edge)
       }
 
       new_block_list.append(b);
+      new_block_set.insert(b);
 
-      if (!block_cache_.contains(b)) {
+      if (!old_block_set.contains(b)) {
         // Make connections to this block
         connect(b, &Block::LengthChanged, this, &TrackOutput::BlockLengthChanged);
 
@@ -595,7 +736,7 @@ void TrackOutput::BlockLengthChanged()
 
   TimeRange invalidate_region(qMin(old_out, new_out), track_length());
 
-  Node::InvalidateCache(invalidate_region, block_input_, block_input_);
+  InvalidateEditedRange(invalidate_region);
 }
 
 void TrackOutput::MutedInputValueChanged()
@@ -21,6 +21,8 @@
 #ifndef TRACKOUTPUT_H
 #define TRACKOUTPUT_H
 
+#include <QAtomicInt>
+
 #include "audio/audiovisualwaveform.h"
 #include "node/block/block.h"
 #include "timeline/timelinecommon.h"
@@ -154,6 +156,19 @@ public:
 
   virtual void InvalidateCache(const TimeRange& range, NodeInput* from, NodeInput *source) override;
 
+  /**
+   * @brief Starts an edit transaction on this track's blocks
+   *
+   * Until the matching EndOperation(), the block list and in/out points stay up to date after
+   * every edit, but the ranges the edits invalidate are merged, and Block::Refreshed() and
+   * TrackLengthChanged() are held back. When the outermost operation ends, each block whose
+   * position changed is refreshed once, the length is signalled once if it changed, and the
+   * merged ranges are invalidated in a single pass.
+   */
+  virtual void BeginOperation() override;
+
+  virtual void EndOperation() override;
+
   /**
    * @brief Adds Block `block` at the very beginning of the Sequence before all other clips
    */
@@ -267,14 +282,52 @@ protected:
 
   virtual void SaveInternal(QXmlStreamWriter* writer) const override;
 
+  virtual bool HashIsTimeInvariant() const override
+  {
+    // Which block we defer to depends on the time
+    return false;
+  }
+
+  virtual bool HashIsConstantOver(const TimeRange& range) const override;
+
 private:
   void UpdateInOutFrom(int index);
 
+  /**
+   * @brief Index of the first block whose out point is after `time` (or at it if `inclusive`)
+   *
+   * Returns the block count if there's no such block.
+   *
+   * The result is remembered so that lookups advancing through the track (e.g. playback
+   * rendering one frame after another) are answered by checking the same or next block rather
+   * than searching.
+   */
+  int FirstBlockEndingAfter(const rational& time, bool inclusive) const;
+
+  /**
+   * @brief Returns TRUE if `index` is the correct result of FirstBlockEndingAfter()
+   */
+  bool IsFirstBlockEndingAfter(int index, const rational& time, bool inclusive) const;
+
+  /**
+   * @brief Index of the first block whose in point is after `time` (or at it if `inclusive`)
+   *
+   * Returns the block count if there's no such block.
+   */
+  int FirstBlockStartingAfter(const rational& time, bool inclusive) const;
+
+  Block* BlockAtIndex(int index) const;
+
   int GetInputIndexFromCacheIndex(int cache_index);
   int GetInputIndexFromCacheIndex(Block* block);
 
   void SetLengthInternal(const rational& r, bool invalidate = true);
 
+  /**
+   * @brief Invalidate a range changed by editing the block list, deferred while in an operation
+   */
+  void InvalidateEditedRange(const TimeRange& range);
+
   QList<Block*> block_cache_;
 
   NodeInputArray* block_input_;
@@ -291,8 +344,30 @@ private:
 
   bool locked_;
 
+  /**
+   * @brief Last result of FirstBlockEndingAfter(), only ever a hint and validated before use
+   */
+  mutable QAtomicInt lookup_hint_;
+
   AudioVisualWaveform waveform_;
 
+  int operation_depth_;
+
+  /**
+   * @brief Ranges invalidated by edits during the current operation
+   */
+  TimeRangeList pending_invalidation_;
+
+  /**
+   * @brief Index of the earliest block whose in/out changed during the current operation, -1 if none
+   */
+  int pending_refresh_from_;
+
+  /**
+   * @brief The track's length when the current operation started
+   */
+  rational operation_start_length_;
+
 private slots:
   void BlockConnected(NodeEdgePtr edge);
 
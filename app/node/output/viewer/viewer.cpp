@@ -27,7 +27,8 @@ namespace olive {
 ViewerOutput::ViewerOutput() :
   video_frame_cache_(this),
   audio_playback_cache_(this),
-  operation_stack_(0)
+  operation_stack_(0),
+  pending_verify_length_(false)
 {
   texture_input_ = new NodeInput("tex_in", NodeInput::kTexture);
   AddInput(texture_input_);
@@ -210,9 +211,12 @@ void ViewerOutput::UpdateTrackCache()
 void ViewerOutput::VerifyLength()
 {
   if (operation_stack_ != 0) {
+    pending_verify_length_ = true;
     return;
   }
 
+  pending_verify_length_ = false;
+
   NodeTraverser traverser;
 
   rational video_length;
@@ -323,6 +327,10 @@ void ViewerOutput::EndOperation()
 
     emit BlockRemoved(cached_block_removed_);
     cached_block_removed_.clear();
+
+    if (pending_verify_length_) {
+      VerifyLength();
+    }
   }
 
   Node::EndOperation();
@@ -87,6 +87,13 @@ public:
     return uuid_;
   }
 
+  /**
+   * @brief Replace the UUID, used to restore it when a sequence is loaded so its disk cache state can be found again
+   */
+  void set_uuid(const QUuid& uuid) {
+    uuid_ = uuid;
+  }
+
   const QVector<TrackOutput *> &GetTracks() const {
     return track_cache_;
   }
@@ -180,6 +187,11 @@ private:
 
   int operation_stack_;
 
+  /**
+   * @brief Set if the length may have changed during an operation and needs checking once it ends
+   */
+  bool pending_verify_length_;
+
 private slots:
   void UpdateTrackCache();
 
@@ -141,6 +141,8 @@ NodeEdgePtr NodeParam::ConnectEdge(NodeOutput *output, NodeInput *input)
   output->edges_.append(edge);
   input->edges_.append(edge);
 
+  NodeExecutionPlan::StructureChanged();
+
   // Emit a signal than an edge was added (only one signal needs emitting)
   emit input->EdgeAdded(edge);
 
@@ -155,6 +157,8 @@ void NodeParam::DisconnectEdge(NodeEdgePtr edge)
   output->edges_.removeOne(edge);
   input->edges_.removeOne(edge);
 
+  NodeExecutionPlan::StructureChanged();
+
   emit input->EdgeRemoved(edge);
 }
 
@@ -20,10 +20,37 @@
 
 #include "traverser.h"
 
+#include <QElapsedTimer>
+
 #include "node.h"
+#include "node/input/nested/nestedsequence.h"
 
 namespace olive {
 
+QAtomicInt NodeTraverser::timing_enabled_(0);
+QMutex NodeTraverser::timing_lock_;
+QHash<QString, NodeTraverser::NodeTiming> NodeTraverser::timings_;
+
+NodeTraverser::NodeTraverser() :
+  profiling_(false),
+  slowest_node_ns_(0)
+{
+}
+
+void NodeTraverser::SetTimingEnabled(bool e)
+{
+  timing_enabled_.store(e ? 1 : 0);
+}
+
+QHash<QString, NodeTraverser::NodeTiming> NodeTraverser::TakeTimings()
+{
+  QMutexLocker locker(&timing_lock_);
+
+  QHash<QString, NodeTiming> t = timings_;
+  timings_.clear();
+  return t;
+}
+
 NodeValueDatabase NodeTraverser::GenerateDatabase(const Node* node, const TimeRange &range)
 {
   NodeValueDatabase database;
@@ -70,19 +97,241 @@ NodeValueTable NodeTraverser::GenerateTable(const Node *n, const TimeRange& rang
     return GenerateBlockTable(static_cast<const TrackOutput*>(n), range);
   }
 
-  // FIXME: Cache certain values here if we've already processed them before
+  return ExecutePlan(*n->GetExecutionPlan(), range);
+}
+
+NodeValueTable NodeTraverser::ExecutePlan(const NodeExecutionPlan &plan, const TimeRange &range)
+{
+  const QVector<NodeExecutionPlan::Step>& steps = plan.steps();
+
+  // Every distinct time each step is needed at, and the result once it's been processed
+  struct Instance {
+    TimeRange range;
+
+    // Index of the source step's instance for each of the step's inputs, -1 if not connected
+    QVector<int> sources;
+
+    // Number of consumers that haven't received this result yet
+    int uses;
+
+    NodeValueTable table;
+
+    // TRUE if `table` came from GetCachedTable() so there's nothing to process
+    bool cached;
+
+    // TRUE if `table` should be given to CacheTable() once it's processed
+    bool store;
+  };
+
+  QVector< QVector<Instance> > instances(steps.size());
 
-  // Generate database of input values of node
-  NodeValueDatabase database = GenerateDatabase(n, range);
+  instances.last().append({range, QVector<int>(), 1, NodeValueTable(), false, false});
+
+  // Steps always come after their inputs, so walking backwards from the root collects every time
+  // a step is needed at from all of its consumers before it's reached. Consumers asking for the
+  // same time share one instance, this is what makes a shared upstream node only run once.
+  for (int i=steps.size()-1; i>=0; i--) {
+    const NodeExecutionPlan::Step& step = steps.at(i);
+    QVector<Instance>& step_instances = instances[i];
+
+    for (int j=0; j<step_instances.size(); j++) {
+      if (!step.track
+          && GetCachedTable(step.node, step_instances.at(j).range, &step_instances[j].table, &step_instances[j].store)) {
+        // None of this instance's inputs are needed
+        step_instances[j].cached = true;
+        continue;
+      }
+
+      step_instances[j].sources.resize(step.inputs.size());
+
+      for (int k=0; k<step.inputs.size(); k++) {
+        const NodeExecutionPlan::Slot& slot = step.inputs.at(k);
+
+        if (slot.source < 0) {
+          step_instances[j].sources[k] = -1;
+          continue;
+        }
+
+        TimeRange input_time = step.node->InputTimeAdjustment(slot.input, step_instances.at(j).range);
+        QVector<Instance>& source_instances = instances[slot.source];
+
+        int found = -1;
+        for (int l=0; l<source_instances.size(); l++) {
+          if (source_instances.at(l).range == input_time) {
+            found = l;
+            break;
+          }
+        }
+
+        if (found == -1) {
+          source_instances.append({input_time, QVector<int>(), 0, NodeValueTable(), false, false});
+          found = source_instances.size() - 1;
+        }
+
+        source_instances[found].uses++;
+        step_instances[j].sources[k] = found;
+      }
+    }
+  }
+
+  // Then walking forwards processes every step after its inputs
+  for (int i=0; i<steps.size(); i++) {
+    const NodeExecutionPlan::Step& step = steps.at(i);
+    QVector<Instance>& step_instances = instances[i];
+
+    for (int j=0; j<step_instances.size(); j++) {
+      if (IsCancelled()) {
+        return NodeValueTable();
+      }
+
+      Instance& instance = step_instances[j];
+
+      if (instance.cached) {
+        continue;
+      }
+
+      if (step.track) {
+        instance.table = GenerateBlockTable(step.track, instance.range);
+        continue;
+      }
+
+      NodeValueDatabase database;
+
+      for (int k=0; k<step.inputs.size(); k++) {
+        const NodeExecutionPlan::Slot& slot = step.inputs.at(k);
+
+        if (slot.source >= 0) {
+          Instance& source = instances[slot.source][instance.sources.at(k)];
+
+          database.Insert(slot.input, source.table);
+
+          // Release the result as soon as every consumer has it
+          source.uses--;
+          if (!source.uses) {
+            source.table = NodeValueTable();
+          }
+        } else if (!slot.input->IsArray()) {
+          // Push onto the table the value at this time from the input
+          TimeRange input_time = step.node->InputTimeAdjustment(slot.input, instance.range);
+
+          NodeValueTable table;
+          table.Push(slot.input->data_type(), slot.input->get_value_at_time(input_time.in()), slot.input->parentNode());
+          database.Insert(slot.input, table);
+        } else {
+          database.Insert(slot.input, NodeValueTable());
+        }
+      }
+
+      AddGlobalsToDatabase(database, instance.range);
+
+      instance.table = ProcessNode(step.node, instance.range, database);
+
+      if (instance.store) {
+        CacheTable(step.node, instance.range, instance.table);
+      }
+    }
+  }
+
+  return instances.last().first().table;
+}
+
+NodeValueTable NodeTraverser::ProcessNode(const Node *n, const TimeRange &range, NodeValueDatabase &database)
+{
+  QElapsedTimer timer;
+  bool timing = profiling_ || timing_enabled_.load();
+  if (timing) {
+    timer.start();
+  }
 
   // By this point, the node should have all the inputs it needs to render correctly
   NodeValueTable table = n->Value(database);
 
   PostProcessTable(n, range, table);
 
+  if (timing) {
+    qint64 elapsed = timer.nsecsElapsed();
+
+    if (profiling_ && elapsed > slowest_node_ns_) {
+      slowest_node_ = n->id();
+      slowest_node_ns_ = elapsed;
+    }
+
+    if (timing_enabled_.load()) {
+      QMutexLocker locker(&timing_lock_);
+      NodeTiming& t = timings_[n->id()];
+      t.count++;
+      t.nanoseconds += elapsed;
+    }
+  }
+
   return table;
 }
 
+void NodeTraverser::CollectVideoFootage(const Node *n, const TimeRange &range, QVector<FootageRequest> *requests)
+{
+  if (n->IsTrack()) {
+    Block* active_block = static_cast<const TrackOutput*>(n)->BlockAtTime(range.in());
+
+    if (active_block) {
+      CollectVideoFootage(active_block, range, requests);
+    }
+
+    return;
+  }
+
+  const QVector<NodeExecutionPlan::Step>& steps = n->GetExecutionPlan()->steps();
+
+  // Same backwards walk as ExecutePlan(), only collecting the times each step is needed at
+  QVector< QVector<TimeRange> > times(steps.size());
+  times.last().append(range);
+
+  for (int i=steps.size()-1; i>=0; i--) {
+    const NodeExecutionPlan::Step& step = steps.at(i);
+
+    foreach (const TimeRange& step_time, times.at(i)) {
+      if (step.track) {
+        CollectVideoFootage(step.track, step_time, requests);
+        continue;
+      }
+
+      NodeValueTable cached_table;
+      bool store;
+      if (GetCachedTable(step.node, step_time, &cached_table, &store)) {
+        continue;
+      }
+
+      foreach (const NodeExecutionPlan::Slot& slot, step.inputs) {
+        TimeRange input_time = step.node->InputTimeAdjustment(slot.input, step_time);
+
+        if (slot.source >= 0) {
+          if (!times.at(slot.source).contains(input_time)) {
+            times[slot.source].append(input_time);
+          }
+        } else if (slot.input->data_type() == NodeParam::kFootage) {
+          // Footage is retrieved by the node it's passed through, at that node's time
+          Stream* stream = Node::ValueToPtr<Stream>(slot.input->get_value_at_time(input_time.in()));
+
+          if (stream && stream->type() == Stream::kVideo && stream->footage()->IsValid()) {
+            FootageRequest request = {static_cast<VideoStream*>(stream), step_time.in()};
+
+            bool exists = false;
+            foreach (const FootageRequest& r, *requests) {
+              if (r.stream == request.stream && r.time == request.time) {
+                exists = true;
+                break;
+              }
+            }
+
+            if (!exists) {
+              requests->append(request);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
 NodeValueTable NodeTraverser::GenerateTable(const Node *n, const rational &in, const rational &out)
 {
   return GenerateTable(n, TimeRange(in, out));
@@ -144,6 +393,17 @@ QVariant NodeTraverser::ProcessFrameGeneration(const Node *node, const GenerateJ
   return QVariant();
 }
 
+QVariant NodeTraverser::ProcessNestedSequence(const NestedSequence *node, const TimeRange &range)
+{
+  Node* inner = node->GetInnerNode();
+
+  if (!inner) {
+    return QVariant();
+  }
+
+  return GenerateTable(inner, range).Get(NodeParam::kTexture);
+}
+
 QVariant NodeTraverser::GetCachedFrame(const Node *node, const rational &time)
 {
   Q_UNUSED(node)
@@ -152,6 +412,23 @@ QVariant NodeTraverser::GetCachedFrame(const Node *node, const rational &time)
   return QVariant();
 }
 
+bool NodeTraverser::GetCachedTable(const Node *node, const TimeRange &range, NodeValueTable *table, bool *store)
+{
+  Q_UNUSED(node)
+  Q_UNUSED(range)
+  Q_UNUSED(table)
+  Q_UNUSED(store)
+
+  return false;
+}
+
+void NodeTraverser::CacheTable(const Node *node, const TimeRange &range, const NodeValueTable &table)
+{
+  Q_UNUSED(node)
+  Q_UNUSED(range)
+  Q_UNUSED(table)
+}
+
 void NodeTraverser::AddGlobalsToDatabase(NodeValueDatabase &db, const TimeRange& range) const
 {
   // Insert global variables
@@ -211,6 +488,11 @@ void NodeTraverser::PostProcessTable(const Node *node, const TimeRange &range, N
     }
   }
 
+  if (IsCancelled()) {
+    // Nobody wants the result anymore, don't start any decodes or jobs
+    return;
+  }
+
   if (!got_cached_frame) {
     // Retrieve video frames
     foreach (const NodeValue& v, video_footage_to_retrieve) {
@@ -243,6 +525,16 @@ void NodeTraverser::PostProcessTable(const Node *node, const TimeRange &range, N
         output_params.Push(NodeParam::kTexture, value, node);
       }
     }
+
+    // Retrieve nested sequence frames
+    const NestedSequence* nest = dynamic_cast<const NestedSequence*>(node);
+    if (nest) {
+      QVariant value = ProcessNestedSequence(nest, range);
+
+      if (!value.isNull()) {
+        output_params.Push(NodeParam::kTexture, value, node);
+      }
+    }
   }
 
   // Retrieve audio samples
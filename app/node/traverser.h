@@ -21,26 +21,74 @@
 #ifndef NODETRAVERSER_H
 #define NODETRAVERSER_H
 
+#include <QHash>
+#include <QMutex>
 #include <QVector2D>
 
 #include "codec/decoder.h"
 #include "common/cancelableobject.h"
+#include "node/executionplan.h"
 #include "node/output/track/track.h"
 #include "project/item/footage/stream.h"
 #include "value.h"
 
 namespace olive {
 
+class NestedSequence;
+
 class NodeTraverser : public CancelableObject
 {
 public:
-  NodeTraverser() = default;
+  NodeTraverser();
 
   NodeValueTable GenerateTable(const Node *n, const TimeRange &range);
   NodeValueTable GenerateTable(const Node *n, const rational &in, const rational& out);
 
   NodeValueDatabase GenerateDatabase(const Node *node, const TimeRange &range);
 
+  struct NodeTiming {
+    qint64 count;
+    qint64 nanoseconds;
+  };
+
+  /**
+   * @brief Start or stop recording how long each node type takes to process
+   *
+   * Only the node's own work (Value() and any jobs it returns) is counted, not its inputs.
+   * Recording adds a lock per node so it's only intended for benchmarking.
+   */
+  static void SetTimingEnabled(bool e);
+
+  /**
+   * @brief Returns timings recorded since the last call keyed by node ID and clears them
+   */
+  static QHash<QString, NodeTiming> TakeTimings();
+
+  /**
+   * @brief Track which node took the longest in this traverser's subsequent GenerateTable() calls
+   *
+   * Unlike SetTimingEnabled(), this only affects this instance and takes no locks.
+   */
+  void SetProfilingEnabled(bool e)
+  {
+    profiling_ = e;
+    slowest_node_.clear();
+    slowest_node_ns_ = 0;
+  }
+
+  /**
+   * @brief ID of the slowest node processed since profiling was enabled
+   */
+  const QString& slowest_node() const
+  {
+    return slowest_node_;
+  }
+
+  qint64 slowest_node_ns() const
+  {
+    return slowest_node_ns_;
+  }
+
 protected:
   NodeValueTable ProcessInput(NodeInput *input, const TimeRange &range);
 
@@ -56,8 +104,30 @@ protected:
 
   virtual QVariant ProcessFrameGeneration(const Node *node, const GenerateJob& job);
 
+  /**
+   * @brief Produce the picture of a nested sequence
+   *
+   * Only called if GetCachedFrame() had nothing for it. The default renders the nested sequence's
+   * graph as part of this traversal.
+   */
+  virtual QVariant ProcessNestedSequence(const NestedSequence *node, const TimeRange &range);
+
   virtual QVariant GetCachedFrame(const Node *node, const rational &time);
 
+  /**
+   * @brief Retrieve a node's result from a cache rather than processing it and its inputs
+   *
+   * Called before any of the node's inputs are processed. Returns TRUE with `table` filled if a
+   * cached result was found. Otherwise `store` can be set to TRUE to have the result given to
+   * CacheTable() once it's been processed.
+   */
+  virtual bool GetCachedTable(const Node* node, const TimeRange& range, NodeValueTable* table, bool* store);
+
+  /**
+   * @brief Cache a result that GetCachedTable() asked to store
+   */
+  virtual void CacheTable(const Node* node, const TimeRange& range, const NodeValueTable& table);
+
   void AddGlobalsToDatabase(NodeValueDatabase& db, const TimeRange &range) const;
 
   virtual QVector2D GenerateResolution() const
@@ -65,9 +135,46 @@ protected:
     return QVector2D(0, 0);
   }
 
+  struct FootageRequest {
+    VideoStream* stream;
+    rational time;
+  };
+
+  /**
+   * @brief Find every video frame that generating `n` at `range` will retrieve
+   *
+   * Follows the same plans GenerateTable() executes, taking the block active at each track's in
+   * point like the default GenerateBlockTable() and skipping anything GetCachedTable() has. This
+   * lets a derivative start decoding independent branches in parallel before they're processed
+   * one after the other. Requests are appended to `requests` without duplicates.
+   */
+  void CollectVideoFootage(const Node* n, const TimeRange& range, QVector<FootageRequest>* requests);
+
 private:
+  /**
+   * @brief Process every step of a plan, returning the table of its root
+   */
+  NodeValueTable ExecutePlan(const NodeExecutionPlan& plan, const TimeRange& range);
+
+  /**
+   * @brief Run a node on a database that already holds all of its inputs
+   */
+  NodeValueTable ProcessNode(const Node* n, const TimeRange& range, NodeValueDatabase& database);
+
   void PostProcessTable(const Node *node, const TimeRange &range, NodeValueTable &output_params);
 
+  static QAtomicInt timing_enabled_;
+
+  static QMutex timing_lock_;
+
+  static QHash<QString, NodeTiming> timings_;
+
+  bool profiling_;
+
+  QString slowest_node_;
+
+  qint64 slowest_node_ns_;
+
 };
 
 }
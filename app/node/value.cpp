@@ -108,10 +108,8 @@ void NodeValueTable::Remove(const NodeValue &v)
   }
 }
 
-NodeValueTable NodeValueTable::Merge(QList<NodeValueTable> tables)
+NodeValueTable NodeValueTable::Merge(const QList<NodeValueTable>& tables)
 {
-
-
   if (tables.size() == 1) {
     return tables.first();
   }
@@ -119,6 +117,7 @@ NodeValueTable NodeValueTable::Merge(QList<NodeValueTable> tables)
   int row = 0;
 
   NodeValueTable merged_table;
+  merged_table.values_.reserve(tables.size());
 
   // Slipstreams all tables together
   foreach (const NodeValueTable& t, tables) {
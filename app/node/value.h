@@ -64,6 +64,13 @@ private:
 
 };
 
+}
+
+// Every member is trivially relocatable, so containers can move NodeValues with memmove
+Q_DECLARE_TYPEINFO(olive::NodeValue, Q_MOVABLE_TYPE);
+
+namespace olive {
+
 class NodeValueTable
 {
 public:
@@ -79,6 +86,11 @@ public:
     values_.append(value);
   }
 
+  void Push(NodeValue&& value)
+  {
+    values_.append(std::move(value));
+  }
+
   void Push(const NodeParam::DataType& type, const QVariant& data, const Node *from, const QString& tag = QString())
   {
     Push(NodeValue(type, data, from, tag));
@@ -126,12 +138,18 @@ public:
     return values_.isEmpty();
   }
 
-  static NodeValueTable Merge(QList<NodeValueTable> tables);
+  static NodeValueTable Merge(const QList<NodeValueTable>& tables);
 
 private:
   int GetInternal(const NodeParam::DataType& type, const QString& tag) const;
 
-  QList<NodeValue> values_;
+  /**
+   * @brief Values in push order
+   *
+   * A QVector rather than a QList since NodeValue is larger than a pointer, which would make a
+   * QList heap allocate every value individually.
+   */
+  QVector<NodeValue> values_;
 
 };
 
@@ -26,6 +26,8 @@
 
 #include "widget/panel/panel.h"
 #include "widget/scope/histogram/histogram.h"
+#include "widget/scope/parade/parade.h"
+#include "widget/scope/vectorscope/vectorscope.h"
 #include "widget/scope/waveform/waveform.h"
 
 namespace olive {
@@ -39,6 +41,8 @@ public:
   enum Type {
     kTypeWaveform,
     kTypeHistogram,
+    kTypeParade,
+    kTypeVectorscope,
 
     kTypeCount
   };
@@ -68,6 +72,10 @@ private:
 
   HistogramScope* histogram_;
 
+  ParadeScope* parade_;
+
+  VectorscopeScope* vectorscope_;
+
 };
 
 }
@@ -165,6 +165,11 @@ void TimelinePanel::ToggleSelectedEnabled()
   static_cast<TimelineWidget*>(GetTimeBasedWidget())->ToggleSelectedEnabled();
 }
 
+void TimelinePanel::Nest()
+{
+  static_cast<TimelineWidget*>(GetTimeBasedWidget())->NestSelected();
+}
+
 void TimelinePanel::InsertFootageAtPlayhead(const QList<Footage *> &footage)
 {
   static_cast<TimelineWidget*>(GetTimeBasedWidget())->InsertFootageAtPlayhead(footage);
@@ -83,6 +83,8 @@ public:
 
   virtual void ToggleSelectedEnabled() override;
 
+  virtual void Nest() override;
+
   void InsertFootageAtPlayhead(const QList<Footage *> &footage);
 
   void OverwriteFootageAtPlayhead(const QList<Footage *> &footage);
@@ -20,6 +20,8 @@
 
 #include "folder.h"
 
+#include <QDebug>
+
 #include "common/xmlutils.h"
 #include "project/item/footage/footage.h"
 #include "project/item/sequence/sequence.h"
@@ -75,11 +77,30 @@ void Folder::Load(QXmlStreamReader *reader, XMLNodeData& xml_node_data, uint ver
     }
 
     child->setParent(this);
-    child->Load(reader, xml_node_data, version, cancelled);
+
+    QString chunk = reader->attributes().value(QStringLiteral("chunk")).toString();
+
+    if (child->type() == Item::kSequence && !chunk.isEmpty()) {
+      // Sequence is stored separately in a binary project
+      reader->skipCurrentElement();
+      LoadSequenceChunk(static_cast<Sequence*>(child), chunk.toUInt(), xml_node_data, version, cancelled);
+    } else {
+      child->Load(reader, xml_node_data, version, cancelled);
+    }
   }
 }
 
 void Folder::Save(QXmlStreamWriter *writer) const
+{
+  SaveInternal(writer, nullptr);
+}
+
+void Folder::SaveWithoutSequences(QXmlStreamWriter *writer, QVector<Sequence *> *sequences) const
+{
+  SaveInternal(writer, sequences);
+}
+
+void Folder::SaveInternal(QXmlStreamWriter *writer, QVector<Sequence *> *sequences) const
 {
   writer->writeAttribute(QStringLiteral("name"), name());
 
@@ -98,10 +119,37 @@ void Folder::Save(QXmlStreamWriter *writer) const
       break;
     }
 
-    child->Save(writer);
+    if (sequences && child->type() == Item::kSequence) {
+      writer->writeAttribute(QStringLiteral("chunk"), QString::number(sequences->size()));
+      sequences->append(static_cast<Sequence*>(child));
+    } else if (sequences && child->type() == Item::kFolder) {
+      static_cast<Folder*>(child)->SaveInternal(writer, sequences);
+    } else {
+      child->Save(writer);
+    }
 
     writer->writeEndElement(); // footage/folder/sequence
   }
 }
 
+void Folder::LoadSequenceChunk(Sequence *sequence, quint32 chunk, XMLNodeData &xml_node_data, uint version, const QAtomicInt *cancelled)
+{
+  QByteArray xml = qUncompress(xml_node_data.sequence_chunks.value(chunk));
+
+  if (xml.isEmpty()) {
+    qWarning() << "Failed to decode sequence chunk" << chunk;
+    return;
+  }
+
+  QXmlStreamReader chunk_reader(xml);
+
+  if (XMLReadNextStartElement(&chunk_reader) && chunk_reader.name() == QStringLiteral("sequence")) {
+    sequence->Load(&chunk_reader, xml_node_data, version, cancelled);
+  }
+
+  if (chunk_reader.hasError()) {
+    qWarning() << "Failed to read sequence chunk" << chunk << chunk_reader.errorString();
+  }
+}
+
 }
@@ -27,6 +27,8 @@
 
 namespace olive {
 
+class Sequence;
+
 /**
  * @brief The Folder class representing a directory in a project structure
  *
@@ -48,7 +50,20 @@ public:
 
   virtual void Save(QXmlStreamWriter* writer) const override;
 
+  /**
+   * @brief Save this folder with sequences written as references to separately stored chunks
+   *
+   * Each sequence (including those in subfolders) is written as an empty element with a "chunk"
+   * attribute holding its index in `sequences`, and appended to `sequences` so the caller can
+   * store it elsewhere. Load() resolves these references through XMLNodeData::sequence_chunks.
+   */
+  void SaveWithoutSequences(QXmlStreamWriter* writer, QVector<Sequence*>* sequences) const;
+
 private:
+  void SaveInternal(QXmlStreamWriter* writer, QVector<Sequence*>* sequences) const;
+
+  static void LoadSequenceChunk(Sequence* sequence, quint32 chunk, XMLNodeData &xml_node_data, uint version, const QAtomicInt *cancelled);
+
 
 };
 
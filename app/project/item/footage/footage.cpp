@@ -94,9 +94,9 @@ void Footage::Clear()
   valid_ = false;
 }
 
-void Footage::SetValid()
+void Footage::SetValid(bool e)
 {
-  valid_ = true;
+  valid_ = e;
 }
 
 const QString &Footage::filename() const
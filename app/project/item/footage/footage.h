@@ -84,8 +84,10 @@ public:
 
   /**
    * @brief Sets this footage to valid and ready to use
+   *
+   * Setting FALSE marks it offline again, e.g. when undoing a relink.
    */
-  void SetValid();
+  void SetValid(bool e = true);
 
   /**
    * @brief Return the current filename of this Footage object
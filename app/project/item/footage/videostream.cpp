@@ -20,8 +20,10 @@
 
 #include "videostream.h"
 
+#include <QDir>
 #include <QFile>
 
+#include "common/filefunctions.h"
 #include "common/timecodefunctions.h"
 #include "common/xmlutils.h"
 #include "footage.h"
@@ -35,7 +37,8 @@ VideoStream::VideoStream() :
   interlacing_(VideoParams::kInterlaceNone),
   video_type_(VideoStream::kVideoTypeVideo),
   pixel_aspect_ratio_(1),
-  start_time_(0)
+  start_time_(0),
+  proxy_divider_(0)
 {
   set_type(Stream::kVideo);
 }
@@ -113,6 +116,8 @@ void VideoStream::LoadCustomParameters(QXmlStreamReader *reader)
       set_frame_rate(rational::fromString(reader->readElementText()));
     } else if (reader->name() == QStringLiteral("starttime")) {
       set_start_time(reader->readElementText().toLongLong());
+    } else if (reader->name() == QStringLiteral("proxydivider")) {
+      proxy_divider_ = reader->readElementText().toInt();
     } else {
       reader->skipCurrentElement();
     }
@@ -132,6 +137,28 @@ void VideoStream::SaveCustomParameters(QXmlStreamWriter *writer) const
   writer->writeTextElement(QStringLiteral("pixelaspect"), pixel_aspect_ratio_.toString());
   writer->writeTextElement(QStringLiteral("framerate"), frame_rate_.toString());
   writer->writeTextElement(QStringLiteral("starttime"), QString::number(start_time_));
+  writer->writeTextElement(QStringLiteral("proxydivider"), QString::number(proxy_divider_));
+}
+
+void VideoStream::set_proxy_divider(int divider)
+{
+  proxy_divider_ = divider;
+
+  emit ParametersChanged();
+}
+
+QString VideoStream::proxy_filename() const
+{
+  QString fn = FileFunctions::GetUniqueFileIdentifier(footage()->filename());
+  fn.append(QString::number(index()));
+  fn.append(QStringLiteral(".proxy.mov"));
+
+  return QDir(footage()->project()->cache_path()).filePath(fn);
+}
+
+bool VideoStream::has_proxy() const
+{
+  return proxy_divider_ > 0 && QFileInfo::exists(proxy_filename());
 }
 
 bool VideoStream::premultiplied_alpha()
@@ -141,9 +141,29 @@ public:
 
   int64_t get_time_in_timebase_units(const rational& time) const;
 
+  /**
+   * @brief The divider the proxy of this stream was generated at, or 0 if it has no proxy
+   */
+  int proxy_divider() const
+  {
+    return proxy_divider_;
+  }
+
+  /**
+   * @brief Where the proxy for this stream is stored in the project's cache directory
+   */
+  QString proxy_filename() const;
+
+  /**
+   * @brief Returns TRUE if a proxy has been generated for this stream and still exists
+   */
+  bool has_proxy() const;
+
   virtual QIcon icon() const override;
 
 public slots:
+  void set_proxy_divider(int divider);
+
   void ColorConfigChanged();
 
   void DefaultColorSpaceChanged();
@@ -172,6 +192,8 @@ private:
 
   int64_t start_time_;
 
+  int proxy_divider_;
+
 };
 
 }
@@ -23,6 +23,8 @@
 namespace olive {
 
 Item::Item() :
+  item_row_(-1),
+  first_stale_row_(0),
   item_parent_(nullptr),
   project_(nullptr)
 {
@@ -104,6 +106,17 @@ QVector<Item *> Item::get_children_of_type(Type type, bool recursive) const
   return list;
 }
 
+int Item::item_row() const
+{
+  if (!item_parent_) {
+    return -1;
+  }
+
+  item_parent_->UpdateChildRows();
+
+  return item_row_;
+}
+
 bool Item::CanHaveChildren() const
 {
   return false;
@@ -127,18 +140,37 @@ void Item::childEvent(QChildEvent *event)
   if (cast_test) {
     if (event->type() == QEvent::ChildAdded) {
 
+      cast_test->item_row_ = item_children_.size();
       item_children_.append(cast_test);
       cast_test->item_parent_ = this;
 
-    } else if (event->type() == QEvent::ChildRemoved) {
+      if (first_stale_row_ == cast_test->item_row_) {
+        first_stale_row_++;
+      }
+
+    } else if (event->type() == QEvent::ChildRemoved && cast_test->item_parent_ == this) {
+
+      // Everything after this child moves up a row, they're renumbered when next asked for
+      int row = cast_test->item_row();
+      item_children_.remove(row);
+      first_stale_row_ = qMin(first_stale_row_, row);
 
-      item_children_.removeOne(cast_test);
+      cast_test->item_row_ = -1;
       cast_test->item_parent_ = nullptr;
 
     }
   }
 }
 
+void Item::UpdateChildRows() const
+{
+  for (int i=first_stale_row_; i<item_children_.size(); i++) {
+    item_children_.at(i)->item_row_ = i;
+  }
+
+  first_stale_row_ = item_children_.size();
+}
+
 bool Item::ChildExistsWithNameInternal(const QString &name, Item *folder)
 {
   // Loop through all children
@@ -84,6 +84,14 @@ public:
     return item_children_;
   }
 
+  /**
+   * @brief Returns the index of this item in its parent's children, or -1 if it has no parent
+   *
+   * Rows are stored on each child rather than searched for, so this is constant time apart from
+   * the first call after a child was removed from the middle of the parent.
+   */
+  int item_row() const;
+
   const QString& name() const;
   void set_name(const QString& n);
 
@@ -120,8 +128,20 @@ protected:
 private:
   static bool ChildExistsWithNameInternal(const QString& name, Item* folder);
 
+  /**
+   * @brief Renumber children whose row may have changed since a removal
+   */
+  void UpdateChildRows() const;
+
   QVector<Item*> item_children_;
 
+  /**
+   * @brief Row of this item in its parent, valid if it's before the parent's `first_stale_row_`
+   */
+  mutable int item_row_;
+
+  mutable int first_stale_row_;
+
   Item* item_parent_;
 
   Project* project_;
@@ -57,6 +57,12 @@ void Sequence::Load(QXmlStreamReader *reader, XMLNodeData& xml_node_data, uint v
         set_name(attr.value().toString());
       } else if (attr.name() == QStringLiteral("ptr")) {
         xml_node_data.item_ptrs.insert(attr.value().toULongLong(), this);
+      } else if (attr.name() == QStringLiteral("uuid")) {
+        QUuid uuid(attr.value().toString());
+
+        if (!uuid.isNull()) {
+          viewer_output_->set_uuid(uuid);
+        }
       }
     }
   }
@@ -179,6 +185,8 @@ void Sequence::Save(QXmlStreamWriter *writer) const
 
   writer->writeAttribute(QStringLiteral("ptr"), QString::number(reinterpret_cast<quintptr>(this)));
 
+  writer->writeAttribute(QStringLiteral("uuid"), viewer_output_->uuid().toString());
+
   writer->writeStartElement(QStringLiteral("video"));
 
   writer->writeTextElement(QStringLiteral("width"), QString::number(video_params().width()));
@@ -74,12 +74,30 @@ public:
 
   ViewerOutput* viewer_output() const;
 
+  /**
+   * @brief Encoded form of this sequence from the last time it was saved to a binary project
+   *
+   * ProjectSaveBinaryTask compares `hash` to a hash of the sequence's current XML and reuses
+   * `chunk` if they match so sequences that haven't changed aren't compressed again.
+   */
+  struct BinaryChunkCache {
+    QByteArray hash;
+    QByteArray chunk;
+  };
+
+  BinaryChunkCache& binary_chunk_cache()
+  {
+    return binary_chunk_cache_;
+  }
+
 protected:
   virtual void NameChangedEvent(const QString& name) override;
 
 private:
   ViewerOutput* viewer_output_;
 
+  BinaryChunkCache binary_chunk_cache_;
+
 };
 
 }
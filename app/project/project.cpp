@@ -26,6 +26,7 @@
 #include "common/xmlutils.h"
 #include "core.h"
 #include "dialog/progress/progress.h"
+#include "node/input/nested/nestedsequence.h"
 #include "render/diskmanager.h"
 #include "window/mainwindow/mainwindow.h"
 
@@ -43,9 +44,10 @@ Project::Project() :
           this, &Project::DefaultColorSpaceChanged);
 }
 
-void Project::Load(QXmlStreamReader *reader, MainWindowLayoutInfo* layout, uint version, const QAtomicInt* cancelled)
+void Project::Load(QXmlStreamReader *reader, MainWindowLayoutInfo* layout, uint version, const QAtomicInt* cancelled, const QHash<quint32, QByteArray> &sequence_chunks)
 {
   XMLNodeData xml_node_data;
+  xml_node_data.sequence_chunks = sequence_chunks;
 
   while (XMLReadNextStartElement(reader)) {
     if (reader->name() == QStringLiteral("root")) {
@@ -91,14 +93,23 @@ void Project::Load(QXmlStreamReader *reader, MainWindowLayoutInfo* layout, uint
       con.input->set_standard_value(QVariant::fromValue(xml_node_data.footage_ptrs.value(con.footage)));
     }
   }
+
+  // Sequences can be nested in sequences saved before them, so these are resolved once all are loaded
+  foreach (const XMLNodeData::SequenceConnection& con, xml_node_data.sequence_connections) {
+    con.node->SetSequence(dynamic_cast<Sequence*>(xml_node_data.item_ptrs.value(con.sequence)));
+  }
 }
 
-void Project::Save(QXmlStreamWriter *writer) const
+void Project::Save(QXmlStreamWriter *writer, QVector<Sequence*>* external_sequences) const
 {
   writer->writeTextElement(QStringLiteral("cachepath"), cache_path(false));
 
   writer->writeStartElement(QStringLiteral("root"));
-  root_.Save(writer);
+  if (external_sequences) {
+    root_.SaveWithoutSequences(writer, external_sequences);
+  } else {
+    root_.Save(writer);
+  }
   writer->writeEndElement();
 
   writer->writeStartElement(QStringLiteral("colormanagement"));
@@ -47,9 +47,22 @@ class Project : public QObject
 public:
   Project();
 
-  void Load(QXmlStreamReader* reader, MainWindowLayoutInfo *layout, uint version, const QAtomicInt* cancelled);
-
-  void Save(QXmlStreamWriter* writer) const;
+  /**
+   * @brief Load function
+   *
+   * `sequence_chunks` holds separately stored sequences for projects saved with
+   * Folder::SaveWithoutSequences(), it can be left empty for regular projects.
+   */
+  void Load(QXmlStreamReader* reader, MainWindowLayoutInfo *layout, uint version, const QAtomicInt* cancelled,
+            const QHash<quint32, QByteArray>& sequence_chunks = QHash<quint32, QByteArray>());
+
+  /**
+   * @brief Save function
+   *
+   * If `external_sequences` is not nullptr, sequences are collected into it rather than saved
+   * inline (see Folder::SaveWithoutSequences()).
+   */
+  void Save(QXmlStreamWriter* writer, QVector<Sequence*>* external_sequences = nullptr) const;
 
   Folder* root();
 
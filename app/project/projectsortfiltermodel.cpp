@@ -0,0 +1,126 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#include "projectsortfiltermodel.h"
+
+namespace olive {
+
+ProjectSortFilterModel::ProjectSortFilterModel(QObject *parent) :
+  QSortFilterProxyModel(parent)
+{
+  collator_.setNumericMode(true);
+  collator_.setCaseSensitivity(Qt::CaseInsensitive);
+
+  setDynamicSortFilter(true);
+}
+
+void ProjectSortFilterModel::setSourceModel(QAbstractItemModel *source_model)
+{
+  if (sourceModel()) {
+    disconnect(sourceModel(), &QAbstractItemModel::dataChanged, this, &ProjectSortFilterModel::SourceDataChanged);
+    disconnect(sourceModel(), &QAbstractItemModel::rowsAboutToBeRemoved, this, &ProjectSortFilterModel::ClearSortKeys);
+    disconnect(sourceModel(), &QAbstractItemModel::modelAboutToBeReset, this, &ProjectSortFilterModel::ClearSortKeys);
+  }
+
+  ClearSortKeys();
+
+  // Connected before the base class connects its own so keys are up to date when it re-sorts
+  if (source_model) {
+    connect(source_model, &QAbstractItemModel::dataChanged, this, &ProjectSortFilterModel::SourceDataChanged);
+    connect(source_model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &ProjectSortFilterModel::ClearSortKeys);
+    connect(source_model, &QAbstractItemModel::modelAboutToBeReset, this, &ProjectSortFilterModel::ClearSortKeys);
+  }
+
+  QSortFilterProxyModel::setSourceModel(source_model);
+}
+
+void ProjectSortFilterModel::SetFilterText(const QString &text)
+{
+  if (filter_text_ == text) {
+    return;
+  }
+
+  filter_text_ = text;
+
+  invalidateFilter();
+}
+
+bool ProjectSortFilterModel::lessThan(const QModelIndex &source_left, const QModelIndex &source_right) const
+{
+  Item* left = static_cast<Item*>(source_left.internalPointer());
+  Item* right = static_cast<Item*>(source_right.internalPointer());
+
+  // Folders come first regardless of the sort order
+  if (left->CanHaveChildren() != right->CanHaveChildren()) {
+    return (left->CanHaveChildren() == (sortOrder() == Qt::AscendingOrder));
+  }
+
+  ProjectViewModel::ColumnType column = static_cast<ProjectViewModel::ColumnType>(source_left.column());
+
+  int result = 0;
+
+  if (column == ProjectViewModel::kDuration) {
+    result = collator_.compare(GetSortKey(left).duration, GetSortKey(right).duration);
+  } else if (column == ProjectViewModel::kRate) {
+    result = collator_.compare(GetSortKey(left).rate, GetSortKey(right).rate);
+  }
+
+  if (result == 0) {
+    result = collator_.compare(left->name(), right->name());
+  }
+
+  return result < 0;
+}
+
+bool ProjectSortFilterModel::filterAcceptsRow(int source_row, const QModelIndex &source_parent) const
+{
+  if (filter_text_.isEmpty()) {
+    return true;
+  }
+
+  QModelIndex index = sourceModel()->index(source_row, 0, source_parent);
+  Item* item = static_cast<Item*>(index.internalPointer());
+
+  return item->CanHaveChildren() || item->name().contains(filter_text_, Qt::CaseInsensitive);
+}
+
+const ProjectSortFilterModel::SortKey &ProjectSortFilterModel::GetSortKey(Item *item) const
+{
+  QHash<Item*, SortKey>::iterator it = sort_keys_.find(item);
+
+  if (it == sort_keys_.end()) {
+    it = sort_keys_.insert(item, {item->duration(), item->rate()});
+  }
+
+  return it.value();
+}
+
+void ProjectSortFilterModel::SourceDataChanged(const QModelIndex &top_left, const QModelIndex &bottom_right)
+{
+  for (int i=top_left.row(); i<=bottom_right.row(); i++) {
+    sort_keys_.remove(static_cast<Item*>(sourceModel()->index(i, 0, top_left.parent()).internalPointer()));
+  }
+}
+
+void ProjectSortFilterModel::ClearSortKeys()
+{
+  sort_keys_.clear();
+}
+
+}
@@ -0,0 +1,82 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#ifndef PROJECTSORTFILTERMODEL_H
+#define PROJECTSORTFILTERMODEL_H
+
+#include <QCollator>
+#include <QSortFilterProxyModel>
+
+#include "projectviewmodel.h"
+
+namespace olive {
+
+/**
+ * @brief Sorts and filters a ProjectViewModel for display
+ *
+ * Folders are always listed before anything else. Names are compared naturally (so "frame9"
+ * comes before "frame10") straight from the Items, and the duration and rate strings, which are
+ * built on every call, are cached per Item until the source model reports them changing. This
+ * keeps sorting a bin of hundreds of thousands of items from spending its time in data().
+ *
+ * Sorting and filtering are dynamic, so items added to the source model are inserted into place
+ * rather than the whole folder being sorted again.
+ */
+class ProjectSortFilterModel : public QSortFilterProxyModel
+{
+  Q_OBJECT
+public:
+  ProjectSortFilterModel(QObject* parent = nullptr);
+
+  virtual void setSourceModel(QAbstractItemModel *source_model) override;
+
+  /**
+   * @brief Only show items whose names contain `text`, folders are always shown
+   */
+  void SetFilterText(const QString& text);
+
+protected:
+  virtual bool lessThan(const QModelIndex &source_left, const QModelIndex &source_right) const override;
+
+  virtual bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
+
+private:
+  struct SortKey {
+    QString duration;
+    QString rate;
+  };
+
+  const SortKey& GetSortKey(Item* item) const;
+
+  QString filter_text_;
+
+  QCollator collator_;
+
+  mutable QHash<Item*, SortKey> sort_keys_;
+
+private slots:
+  void SourceDataChanged(const QModelIndex& top_left, const QModelIndex& bottom_right);
+
+  void ClearSortKeys();
+
+};
+
+}
+
+#endif // PROJECTSORTFILTERMODEL_H
@@ -20,6 +20,7 @@
 
 #include "projectviewmodel.h"
 
+#include <QAbstractProxyModel>
 #include <QDebug>
 #include <QMimeData>
 #include <QUrl>
@@ -400,6 +401,69 @@ void ProjectViewModel::AddChild(Item *parent, Item *child)
   endInsertRows();
 }
 
+void ProjectViewModel::AddChildren(Item *parent, const QVector<Item *> &children)
+{
+  if (children.isEmpty()) {
+    return;
+  }
+
+  QModelIndex parent_index;
+
+  if (parent != project_->root()) {
+    parent_index = CreateIndexFromItem(parent);
+  }
+
+  int first = parent->item_child_count();
+
+  beginInsertRows(parent_index, first, first + children.size() - 1);
+
+  foreach (Item* child, children) {
+    child->setParent(parent);
+  }
+
+  endInsertRows();
+}
+
+void ProjectViewModel::RemoveChildren(Item *parent, const QVector<Item *> &children, QObject *new_parent)
+{
+  if (children.isEmpty()) {
+    return;
+  }
+
+  // Children added with AddChildren() are normally still together when they're removed again
+  int first = children.first()->item_row();
+  bool adjacent = true;
+
+  for (int i=1; i<children.size(); i++) {
+    if (children.at(i)->item_row() != first + i) {
+      adjacent = false;
+      break;
+    }
+  }
+
+  if (!adjacent) {
+    foreach (Item* child, children) {
+      RemoveChild(parent, child, new_parent);
+    }
+    return;
+  }
+
+  QModelIndex parent_index;
+
+  if (parent != project_->root()) {
+    parent_index = CreateIndexFromItem(parent);
+  }
+
+  beginRemoveRows(parent_index, first, first + children.size() - 1);
+
+  // Remove from the back so no rows have to be renumbered
+  for (int i=children.size()-1; i>=0; i--) {
+    children.at(i)->setParent(new_parent);
+  }
+
+  endRemoveRows();
+}
+
 void ProjectViewModel::RemoveChild(Item *parent, Item *child, QObject *new_parent)
 {
   QModelIndex parent_index;
@@ -428,24 +492,12 @@ void ProjectViewModel::RenameChild(Item *item, const QString &name)
 
 int ProjectViewModel::IndexOfChild(Item *item) const
 {
-  // Find parent's index within its own parent
-  // (FIXME: this model should handle sorting, which means it'll have to "know" the indices)
-
+  // Sorting is done by ProjectSortFilterModel, so this is just the item's position in its parent
   if (item == project_->root()) {
     return -1;
   }
 
-  Item* parent = item->item_parent();
-
-  if (parent != nullptr) {
-    for (int i=0;i<parent->item_child_count();i++) {
-      if (parent->item_child(i) == item) {
-        return i;
-      }
-    }
-  }
-
-  return -1;
+  return item->item_row();
 }
 
 int ProjectViewModel::ChildCount(const QModelIndex &index)
@@ -497,6 +549,18 @@ QModelIndex ProjectViewModel::CreateIndexFromItem(Item *item, int column)
   return createIndex(IndexOfChild(item), column, item);
 }
 
+Item *ProjectViewModel::ItemFromIndex(const QModelIndex &index)
+{
+  QModelIndex source = index;
+
+  const QAbstractProxyModel* proxy;
+  while ((proxy = qobject_cast<const QAbstractProxyModel*>(source.model()))) {
+    source = proxy->mapToSource(source);
+  }
+
+  return static_cast<Item*>(source.internalPointer());
+}
+
 ProjectViewModel::MoveItemCommand::MoveItemCommand(ProjectViewModel *model,
                                                    Item *item,
                                                    Folder *destination,
@@ -581,6 +645,37 @@ void ProjectViewModel::AddItemCommand::undo_internal()
   model_->RemoveChild(parent_, child_, &memory_manager_);
 }
 
+ProjectViewModel::AddItemsCommand::AddItemsCommand(ProjectViewModel *model, Item *folder, const QVector<Item *> &children, QUndoCommand *parent) :
+  UndoCommand(parent),
+  model_(model),
+  parent_(folder),
+  children_(children)
+{
+  // Ensure all operations are done in folder's thread
+  if (memory_manager_.thread() != parent_->thread()) {
+    memory_manager_.moveToThread(parent_->thread());
+  }
+
+  foreach (Item* child, children_) {
+    child->setParent(&memory_manager_);
+  }
+}
+
+Project *ProjectViewModel::AddItemsCommand::GetRelevantProject() const
+{
+  return model_->project();
+}
+
+void ProjectViewModel::AddItemsCommand::redo_internal()
+{
+  model_->AddChildren(parent_, children_);
+}
+
+void ProjectViewModel::AddItemsCommand::undo_internal()
+{
+  model_->RemoveChildren(parent_, children_, &memory_manager_);
+}
+
 ProjectViewModel::RemoveItemCommand::RemoveItemCommand(ProjectViewModel *model, Item *item, QUndoCommand *parent) :
   UndoCommand(parent),
   model_(model),
@@ -104,11 +104,28 @@ public:
   void RemoveChild(Item* parent, Item* child, QObject* new_parent);
   void RenameChild(Item* item, const QString& name);
 
+  /**
+   * @brief Add several children to the same parent, signalling views once rather than per child
+   */
+  void AddChildren(Item* parent, const QVector<Item*>& children);
+
+  /**
+   * @brief Remove several children of the same parent, signalling views once if they're adjacent
+   */
+  void RemoveChildren(Item* parent, const QVector<Item*>& children, QObject* new_parent);
+
   /**
    * @brief Convenience function for creating QModelIndexes from an Item object
    */
   QModelIndex CreateIndexFromItem(Item* item, int column = 0);
 
+  /**
+   * @brief Retrieve the Item an index of this model, or of a proxy in front of it, refers to
+   *
+   * Returns nullptr if the index is invalid.
+   */
+  static Item* ItemFromIndex(const QModelIndex& index);
+
   /**
    * @brief A QUndoCommand for moving an item from one folder to another folder
    */
@@ -174,6 +191,28 @@ public:
 
   };
 
+  /**
+   * @brief A QUndoCommand for adding many items to the same folder, e.g. a bulk import
+   */
+  class AddItemsCommand : public UndoCommand {
+  public:
+    AddItemsCommand(ProjectViewModel* model, Item* folder, const QVector<Item*>& children, QUndoCommand* parent = nullptr);
+
+    virtual Project* GetRelevantProject() const override;
+
+  protected:
+    virtual void redo_internal() override;
+
+    virtual void undo_internal() override;
+
+  private:
+    ProjectViewModel* model_;
+    Item* parent_;
+    QVector<Item*> children_;
+    QObject memory_manager_;
+
+  };
+
   /**
    * @brief An undo command for removing an item
    */
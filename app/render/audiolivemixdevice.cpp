@@ -0,0 +1,173 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audiolivemixdevice.h"
+
+#include "codec/samplebuffer.h"
+#include "node/output/viewer/viewer.h"
+#include "render/rendermanager.h"
+
+namespace olive {
+
+const qint64 AudioLiveMixDevice::kBlockSamples = 4096;
+const int AudioLiveMixDevice::kBlocksAhead = 4;
+
+AudioLiveMixDevice::AudioLiveMixDevice(ViewerOutput *viewer, const AudioParams &params, const rational &length, QObject *parent) :
+  QIODevice(parent),
+  viewer_(viewer),
+  params_(params),
+  length_(params.time_to_bytes(length)),
+  block_size_(params.samples_to_bytes(kBlockSamples)),
+  current_offset_(-1),
+  read_pos_(0)
+{
+}
+
+AudioLiveMixDevice::~AudioLiveMixDevice()
+{
+  QMutexLocker locker(&lock_);
+
+  CancelBlocks();
+}
+
+bool AudioLiveMixDevice::seek(qint64 pos)
+{
+  // Default behavior
+  QIODevice::seek(pos);
+
+  QMutexLocker locker(&lock_);
+
+  read_pos_ = pos;
+
+  return pos >= 0 && pos <= length_;
+}
+
+qint64 AudioLiveMixDevice::readData(char *data, qint64 maxSize)
+{
+  QMutexLocker locker(&lock_);
+
+  if (block_size_ <= 0) {
+    return -1;
+  }
+
+  qint64 position = read_pos_;
+  qint64 read_count = 0;
+
+  // Reading backwards is done by seeking back before each read
+  int direction = (current_offset_ >= 0 && position < current_offset_) ? -1 : 1;
+
+  while (read_count < maxSize && position < length_) {
+    qint64 block_offset = position - position % block_size_;
+
+    if (block_offset != current_offset_) {
+      RetrieveBlock(block_offset, direction);
+    }
+
+    qint64 offset_in_block = position - current_offset_;
+    qint64 copy_count = qMin(maxSize - read_count, current_.size() - offset_in_block);
+
+    memcpy(data + read_count, current_.constData() + offset_in_block, static_cast<size_t>(copy_count));
+
+    read_count += copy_count;
+    position += copy_count;
+  }
+
+  read_pos_ = position;
+
+  return read_count;
+}
+
+qint64 AudioLiveMixDevice::writeData(const char *data, qint64 maxSize)
+{
+  Q_UNUSED(data)
+  Q_UNUSED(maxSize)
+
+  return -1;
+}
+
+void AudioLiveMixDevice::RetrieveBlock(qint64 offset, int direction)
+{
+  // Discard anything requested before this block, the reader has moved past it
+  while (!queued_.isEmpty() && queued_.first().offset != offset) {
+    queued_.takeFirst().ticket->Cancel();
+  }
+
+  if (queued_.isEmpty()) {
+    // Either the reader seeked or it was faster than we were, start again from here
+    QueueBlock(offset);
+  }
+
+  // Keep the next few blocks rendering while this one is read
+  qint64 last_queued = queued_.last().offset;
+  while (queued_.size() <= kBlocksAhead) {
+    last_queued += direction * block_size_;
+
+    if (last_queued < 0 || last_queued >= length_) {
+      break;
+    }
+
+    QueueBlock(last_queued);
+  }
+
+  Block block = queued_.takeFirst();
+  qint64 expected_size = qMin(block_size_, length_ - offset);
+
+  SampleBufferPtr samples = block.ticket->Get().value<SampleBufferPtr>();
+
+  if (samples) {
+    current_ = samples->toPackedData();
+  } else {
+    current_.clear();
+  }
+
+  // Rounding can leave the render a sample short or long, and nothing rendered at all is silence
+  int rendered_size = current_.size();
+  current_.resize(static_cast<int>(expected_size));
+  if (rendered_size < current_.size()) {
+    memset(current_.data() + rendered_size, 0, static_cast<size_t>(current_.size() - rendered_size));
+  }
+
+  current_offset_ = offset;
+}
+
+void AudioLiveMixDevice::QueueBlock(qint64 offset)
+{
+  TimeRange range(params_.bytes_to_time(offset),
+                  params_.bytes_to_time(qMin(offset + block_size_, length_)));
+
+  queued_.append({offset, RenderManager::instance()->RenderAudio(viewer_, range, params_, false)});
+}
+
+void AudioLiveMixDevice::CancelBlocks()
+{
+  foreach (const Block& b, queued_) {
+    b.ticket->Cancel();
+  }
+
+  // Blocks that already started will still read from the viewer, so they must finish before it
+  // can be deleted
+  foreach (const Block& b, queued_) {
+    b.ticket->WaitForFinished();
+  }
+
+  queued_.clear();
+}
+
+}
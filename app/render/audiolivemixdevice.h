@@ -0,0 +1,129 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIOLIVEMIXDEVICE_H
+#define AUDIOLIVEMIXDEVICE_H
+
+#include <QIODevice>
+#include <QMutex>
+
+#include "common/define.h"
+#include "render/audioparams.h"
+#include "threading/threadticket.h"
+
+namespace olive {
+
+class ViewerOutput;
+
+/**
+ * @brief A QIODevice that mixes a viewer's audio as it's read rather than reading a cache
+ *
+ * The audio graph is rendered in blocks through RenderManager. Whenever a block is read, the next
+ * few in the direction of reading are requested so they're mixed ahead of time, which means a
+ * prefetching reader (see AudioOutputDeviceProxy) rarely has to wait for one.
+ *
+ * It can be read from and seeked like a file of packed PCM in `params`, the same as
+ * AudioPlaybackCache::PlaybackDevice, so it's a drop-in replacement for playback when the cache is
+ * out of date.
+ *
+ * `viewer` must remain valid for the life of this device, so it should be a render copy rather
+ * than a node being edited (see PreviewAutoCacher::CreateLiveAudioDevice()).
+ */
+class AudioLiveMixDevice : public QIODevice
+{
+public:
+  AudioLiveMixDevice(ViewerOutput* viewer, const AudioParams& params, const rational& length, QObject* parent = nullptr);
+
+  virtual ~AudioLiveMixDevice() override;
+
+  virtual bool isSequential() const override
+  {
+    return false;
+  }
+
+  virtual bool seek(qint64 pos) override;
+
+  virtual qint64 size() const override
+  {
+    return length_;
+  }
+
+protected:
+  virtual qint64 readData(char *data, qint64 maxSize) override;
+
+  virtual qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+  struct Block {
+    qint64 offset;
+    RenderTicketPtr ticket;
+  };
+
+  /**
+   * @brief Make the block at `offset` current, rendering it if it wasn't requested in advance
+   *
+   * `direction` is 1 or -1 depending on which way the device is being read and determines which
+   * blocks are requested ahead.
+   */
+  void RetrieveBlock(qint64 offset, int direction);
+
+  /**
+   * @brief Request rendering of the block starting at `offset`, if it's within the device
+   */
+  void QueueBlock(qint64 offset);
+
+  /**
+   * @brief Cancel every block that has been requested and wait for any already rendering
+   */
+  void CancelBlocks();
+
+  /**
+   * @brief Size of each block in samples
+   */
+  static const qint64 kBlockSamples;
+
+  /**
+   * @brief Number of blocks requested ahead of the one being read
+   */
+  static const int kBlocksAhead;
+
+  ViewerOutput* viewer_;
+
+  AudioParams params_;
+
+  qint64 length_;
+
+  qint64 block_size_;
+
+  QList<Block> queued_;
+
+  QByteArray current_;
+
+  qint64 current_offset_;
+
+  qint64 read_pos_;
+
+  QMutex lock_;
+
+};
+
+}
+
+#endif // AUDIOLIVEMIXDEVICE_H
@@ -23,22 +23,32 @@
 #include <QDir>
 #include <QFile>
 #include <QUuid>
+#include <QtConcurrent/QtConcurrent>
 
 #include "common/filefunctions.h"
+#include "render/cacheiopool.h"
 
 namespace olive {
 
 const qint64 AudioPlaybackCache::kDefaultSegmentSize = 5242880;
+QThreadPool AudioPlaybackCache::write_pool_;
 
 AudioPlaybackCache::AudioPlaybackCache(QObject* parent) :
-  PlaybackCache(parent)
+  PlaybackCache(parent),
+  queue_running_(false)
 {
+  // Shares the frame cache's budget of disk threads
+  write_pool_.setMaxThreadCount(CacheIOPool::kThreadCount);
+
+  connect(this, &AudioPlaybackCache::RangeWritten, this, &AudioPlaybackCache::WriteFinished, Qt::QueuedConnection);
 }
 
 AudioPlaybackCache::~AudioPlaybackCache()
 {
   // Segments are volatile, so delete them here
   ClearPlaylist();
+
+  WaitForWrites();
 }
 
 void AudioPlaybackCache::SetParameters(const AudioParams &params)
@@ -79,58 +89,57 @@ void AudioPlaybackCache::WritePCM(const TimeRange &range, SampleBufferPtr sample
     a = samples->toPackedData();
   }
 
-  // Keep track of validated ranges so we can signal them all at once at the end
-  TimeRangeList ranges_we_validated;
+  // Keep track of written ranges so they can be validated once they're on disk
+  TimeRangeList ranges_we_wrote;
 
   // Write each valid range to the segments
   foreach (const TimeRange& r, valid_ranges) {
     rational this_segment_in = 0;
 
     for (auto it=playlist_.begin(); it!=playlist_.end(); it++) {
-      rational this_segment_out = this_segment_in + params_.bytes_to_time((*it).size());
+      Segment& seg = *it;
+      rational this_segment_out = this_segment_in + params_.bytes_to_time(seg.size());
 
       if (r.in() < this_segment_out) {
-        // We'll write at least something to this segment
-        QFile seg_file((*it).filename());
-
-        if (seg_file.open(QFile::ReadWrite)) {
-          // Calculate how much to write
-          rational this_write_in_point = qMax(r.in(), this_segment_in);
-          rational this_write_out_point = qMin(r.out(), this_segment_out);
+        // Calculate how much to write
+        rational this_write_in_point = qMax(r.in(), this_segment_in);
+        rational this_write_out_point = qMin(r.out(), this_segment_out);
 
-          // Calculate what the byte offsets are going to be in this segment file
-          rational in_point_relative = this_write_in_point - this_segment_in;
-          qint64 dst_offset = params_.time_to_bytes(in_point_relative);
+        // Calculate what the byte offsets are going to be in this segment file
+        rational in_point_relative = this_write_in_point - this_segment_in;
+        qint64 dst_offset = params_.time_to_bytes(in_point_relative);
 
-          // Calculate where to retrieve data from in the source buffer
-          qint64 src_offset = params_.time_to_bytes(this_write_in_point - range.in());
+        // Calculate where to retrieve data from in the source buffer
+        qint64 src_offset = params_.time_to_bytes(this_write_in_point - range.in());
 
-          // Determine how many bytes need to be written
-          qint64 total_write_length = params_.time_to_bytes(this_write_out_point - this_write_in_point);
+        // Determine how many bytes need to be written
+        qint64 total_write_length = params_.time_to_bytes(this_write_out_point - this_write_in_point);
 
-          // Determine how many bytes we actually have in the source buffer
-          qint64 possible_write_length = qMin(qMax(qint64(0), a.size() - src_offset), total_write_length);
+        // Determine how many bytes we actually have in the source buffer
+        qint64 possible_write_length = qMin(qMax(qint64(0), a.size() - src_offset), total_write_length);
 
-          // Seek to our start offset
-          seg_file.seek(dst_offset);
-
-          // If we have source bytes to write, write them here
-          if (possible_write_length > 0) {
-            seg_file.write(a.data() + src_offset, possible_write_length);
+        if (possible_write_length > 0) {
+          if (seg.IsSilent()) {
+            MaterializeSegment(&seg);
           }
 
-          if (possible_write_length < total_write_length) {
-            // Fill remaining space with silence
-            QByteArray s(total_write_length - possible_write_length, 0x00);
-            seg_file.write(s);
-          }
+          QueueWrite(seg.filename(), dst_offset, a, src_offset, possible_write_length);
+        }
 
-          seg_file.close();
+        if (possible_write_length < total_write_length && !seg.IsSilent()) {
+          qint64 silence_offset = dst_offset + possible_write_length;
+          qint64 silence_length = total_write_length - possible_write_length;
 
-          ranges_we_validated.insert(TimeRange(this_write_in_point, this_write_out_point));
-        } else {
-          qWarning() << "Failed to write PCM data to" << seg_file.fileName();
+          if (silence_offset == 0 && silence_length >= seg.size()) {
+            // The whole segment is silent now, drop its file rather than filling it with zeroes
+            QueueFileOperation(FileOperation::kRemove, seg.filename());
+            seg.set_filename(QString());
+          } else {
+            QueueWrite(seg.filename(), silence_offset, QByteArray(silence_length, 0x00), 0, silence_length);
+          }
         }
+
+        ranges_we_wrote.insert(TimeRange(this_write_in_point, this_write_out_point));
       }
 
       if (r.out() <= this_segment_out) {
@@ -143,18 +152,34 @@ void AudioPlaybackCache::WritePCM(const TimeRange &range, SampleBufferPtr sample
     }
   }
 
-  foreach (const TimeRange& v, ranges_we_validated) {
-    Validate(v);
+  foreach (const TimeRange& v, ranges_we_wrote) {
+    FileOperation op;
+    op.type = FileOperation::kValidate;
+    op.offset = 0;
+    op.size = 0;
+    op.data_offset = 0;
+    op.range = v;
+    op.job_time = job_time;
+    QueueOperation(op);
   }
 }
 
 void AudioPlaybackCache::WriteSilence(const TimeRange &range, qint64 job_time)
 {
-  // WritePCM will automatically fill non-existent bytes with silence, so we just have to send
-  // it an empty sample buffer
+  // WritePCM will automatically treat non-existent bytes as silence, so we just have to send it an
+  // empty sample buffer
   WritePCM(range, nullptr, job_time);
 }
 
+void AudioPlaybackCache::WaitForWrites()
+{
+  QMutexLocker locker(&queue_lock_);
+
+  while (queue_running_) {
+    queue_cond_.wait(&queue_lock_);
+  }
+}
+
 void AudioPlaybackCache::ShiftEvent(const rational &from_in_time, const rational &to_in_time)
 {
   if (from_in_time == to_in_time || from_in_time >= GetLength()) {
@@ -279,64 +304,41 @@ void AudioPlaybackCache::LengthChangedEvent(const rational& old, const rational&
   }
 }
 
-AudioPlaybackCache::Segment AudioPlaybackCache::CloneSegment(const AudioPlaybackCache::Segment &s) const
+AudioPlaybackCache::Segment AudioPlaybackCache::CloneSegment(const AudioPlaybackCache::Segment &s)
 {
   Segment new_seg = s;
 
-  // Copy data to a new file
-  QString new_filename = GenerateSegmentFilename();
-  QFile::copy(s.filename(), new_filename);
-
-  new_seg.set_filename(new_filename);
+  if (!s.IsSilent()) {
+    // Copy data to a new file
+    new_seg.set_filename(GenerateSegmentFilename());
+    QueueFileOperation(FileOperation::kCopy, s.filename(), 0, new_seg.filename());
+  }
 
   return new_seg;
 }
 
-AudioPlaybackCache::Segment AudioPlaybackCache::CreateSegment(const qint64 &size, const qint64& offset) const
+AudioPlaybackCache::Segment AudioPlaybackCache::CreateSegment(const qint64 &size, const qint64& offset)
 {
-  Segment s(size, GenerateSegmentFilename());
+  // Segments start silent, a file is only created once something is written to them
+  Segment s(size, QString());
 
   s.set_offset(offset);
 
-  // Create empty file
-  QFile f(s.filename());
-  if (f.open(QFile::WriteOnly)) {
-    f.close();
-  }
-
   return s;
 }
 
 QString AudioPlaybackCache::GenerateSegmentFilename() const
 {
-  QString new_seg_filename;
-
-  do {
-    uint32_t r = std::rand();
-    new_seg_filename = QDir(GetCacheDirectory()).filePath(QStringLiteral("%1.pcm").arg(r));
-  } while (QFileInfo::exists(new_seg_filename));
-
-  return new_seg_filename;
+  // The file may not be created until much later, so rather than checking what exists, use a name
+  // that won't collide
+  QString uuid = QUuid::createUuid().toString();
+  return QDir(GetCacheDirectory()).filePath(QStringLiteral("%1.pcm").arg(uuid.mid(1, uuid.size() - 2)));
 }
 
 void AudioPlaybackCache::TrimSegmentIn(AudioPlaybackCache::Segment *s, qint64 new_length)
 {
-  // Read filename
-  QFile f(s->filename());
-  if (f.open(QFile::ReadWrite)) {
-    // Read whole segment into memory
-    QByteArray data = f.readAll();
-
-    // Trim to new length
-    data = data.right(new_length);
-
-    // Seek to start and write
-    f.seek(0);
-
-    // Write trimmed data
-    f.write(data);
-
-    f.close();
+  if (!s->IsSilent()) {
+    QueueFileOperation(FileOperation::kTrimIn, s->filename(), new_length);
   }
 
   s->set_size(new_length);
@@ -349,18 +351,144 @@ void AudioPlaybackCache::TrimSegmentOut(AudioPlaybackCache::Segment *s, qint64 n
 
 void AudioPlaybackCache::RemoveSegmentFromArray(int index)
 {
-  QFile::remove(playlist_.at(index).filename());
+  if (!playlist_.at(index).IsSilent()) {
+    QueueFileOperation(FileOperation::kRemove, playlist_.at(index).filename());
+  }
   playlist_.removeAt(index);
 }
 
 void AudioPlaybackCache::ClearPlaylist()
 {
   foreach (const Segment& s, playlist_) {
-    QFile::remove(s.filename());
+    if (!s.IsSilent()) {
+      QueueFileOperation(FileOperation::kRemove, s.filename());
+    }
   }
   playlist_.clear();
 }
 
+void AudioPlaybackCache::MaterializeSegment(AudioPlaybackCache::Segment *s)
+{
+  s->set_filename(GenerateSegmentFilename());
+  QueueFileOperation(FileOperation::kCreate, s->filename(), s->size());
+}
+
+void AudioPlaybackCache::QueueOperation(const FileOperation &op)
+{
+  QMutexLocker locker(&queue_lock_);
+
+  queue_.enqueue(op);
+
+  if (!queue_running_) {
+    // Operations on this cache run one at a time and in order, other caches can use the rest of
+    // the pool
+    queue_running_ = true;
+    QtConcurrent::run(&write_pool_, this, &AudioPlaybackCache::DrainQueue);
+  }
+}
+
+void AudioPlaybackCache::QueueFileOperation(FileOperation::Type type, const QString &filename, qint64 size, const QString &destination)
+{
+  FileOperation op;
+  op.type = type;
+  op.filename = filename;
+  op.destination = destination;
+  op.offset = 0;
+  op.size = size;
+  op.data_offset = 0;
+  op.job_time = 0;
+  QueueOperation(op);
+}
+
+void AudioPlaybackCache::QueueWrite(const QString &filename, qint64 offset, const QByteArray &data, qint64 data_offset, qint64 size)
+{
+  FileOperation op;
+  op.type = FileOperation::kWrite;
+  op.filename = filename;
+  op.offset = offset;
+  op.size = size;
+  op.data = data;
+  op.data_offset = data_offset;
+  op.job_time = 0;
+  QueueOperation(op);
+}
+
+void AudioPlaybackCache::DrainQueue()
+{
+  QMutexLocker locker(&queue_lock_);
+
+  while (!queue_.isEmpty()) {
+    FileOperation op = queue_.dequeue();
+
+    locker.unlock();
+    RunOperation(op);
+    locker.relock();
+  }
+
+  queue_running_ = false;
+  queue_cond_.wakeAll();
+}
+
+void AudioPlaybackCache::RunOperation(const FileOperation &op)
+{
+  switch (op.type) {
+  case FileOperation::kCreate:
+  {
+    // Resizing an empty file leaves it sparse on most filesystems, so no space is used until the
+    // audio is written, but the file already has its full length for reading
+    QFile f(op.filename);
+    if (!f.open(QFile::WriteOnly) || !f.resize(op.size)) {
+      qWarning() << "Failed to create audio segment" << op.filename;
+    }
+    break;
+  }
+  case FileOperation::kWrite:
+  {
+    QFile f(op.filename);
+    if (f.open(QFile::ReadWrite)) {
+      f.seek(op.offset);
+      f.write(op.data.constData() + op.data_offset, op.size);
+    } else {
+      qWarning() << "Failed to write PCM data to" << op.filename;
+    }
+    break;
+  }
+  case FileOperation::kCopy:
+    if (!QFile::copy(op.filename, op.destination)) {
+      qWarning() << "Failed to copy audio segment" << op.filename;
+    }
+    break;
+  case FileOperation::kTrimIn:
+  {
+    QFile f(op.filename);
+    if (f.open(QFile::ReadWrite)) {
+      // Read whole segment into memory and keep only its end
+      QByteArray data = f.readAll().right(op.size);
+
+      f.seek(0);
+      f.write(data);
+      f.resize(op.size);
+    }
+    break;
+  }
+  case FileOperation::kRemove:
+    QFile::remove(op.filename);
+    break;
+  case FileOperation::kValidate:
+    emit RangeWritten(op.range, op.job_time);
+    break;
+  }
+}
+
+void AudioPlaybackCache::WriteFinished(const TimeRange &range, qint64 job_time)
+{
+  // Only validate what hasn't been invalidated (or shifted, which invalidates) again while it was
+  // being written
+  foreach (const TimeRange& r, GetValidRanges(range, job_time)) {
+    Validate(r);
+  }
+}
+
 void AudioPlaybackCache::UpdateOffsetsFrom(int index)
 {
   qint64 current_offset;
@@ -449,36 +577,45 @@ qint64 AudioPlaybackCache::PlaybackDevice::readData(char *data, qint64 maxSize)
          && current_segment_ < playlist_.size()) {
     const Segment& cs = playlist_.at(current_segment_);
     qint64 current_segment_sz = cs.size();
-    QFile segment_file(cs.filename());
 
-    if (segment_file.open(QFile::ReadOnly)) {
-      // Seek to our stored index of this segment
-      segment_file.seek(segment_read_index_);
+    // Determine how many bytes to read
+    qint64 this_read_length = qMin(current_segment_sz - segment_read_index_,
+                                   maxSize - read_size);
 
-      // Determine how many bytes to read
-      qint64 this_read_length = qMin(current_segment_sz - segment_read_index_,
-                                     maxSize - read_size);
+    qint64 bytes_read = 0;
 
-      // Read those bytes
-      segment_file.read(data + read_size, this_read_length);
+    if (!cs.IsSilent()) {
+      QFile segment_file(cs.filename());
 
-      // Close the file
-      segment_file.close();
+      if (segment_file.open(QFile::ReadOnly)) {
+        // Seek to our stored index of this segment
+        segment_file.seek(segment_read_index_);
 
-      // Add to the read index
-      segment_read_index_ += this_read_length;
+        // Read those bytes
+        bytes_read = qMax(qint64(0), segment_file.read(data + read_size, this_read_length));
 
-      // Add to the read size
-      read_size += this_read_length;
-
-      // If we've reached the end of this segment, tick the counter over to the next segment
-      if (segment_read_index_ == current_segment_sz) {
-        // Jump to the next file
-        segment_read_index_ = 0;
-        current_segment_++;
+        // Close the file
+        segment_file.close();
       }
-    } else {
-      qWarning() << "Failed to read data from segment";
+    }
+
+    // Silent segments and anything the writer hasn't got to yet (including the file itself) play
+    // as silence
+    if (bytes_read < this_read_length) {
+      memset(data + read_size + bytes_read, 0, this_read_length - bytes_read);
+    }
+
+    // Add to the read index
+    segment_read_index_ += this_read_length;
+
+    // Add to the read size
+    read_size += this_read_length;
+
+    // If we've reached the end of this segment, tick the counter over to the next segment
+    if (segment_read_index_ == current_segment_sz) {
+      // Jump to the next file
+      segment_read_index_ = 0;
+      current_segment_++;
     }
   }
 
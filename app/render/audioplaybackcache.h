@@ -21,6 +21,11 @@
 #ifndef AUDIOPLAYBACKCACHE_H
 #define AUDIOPLAYBACKCACHE_H
 
+#include <QMutex>
+#include <QQueue>
+#include <QThreadPool>
+#include <QWaitCondition>
+
 #include "common/timerange.h"
 #include "codec/samplebuffer.h"
 #include "render/playbackcache.h"
@@ -49,6 +54,11 @@ namespace olive {
  * AudioPlaybackCache also provides a playback device (accessible from CreatePlaybackDevice()) that
  * acts identically to a file-based IO device, transparently joining segments together and acting
  * like one contiguous file.
+ *
+ * Silence is never written to disk. A segment without a file is silent, and segments only get a
+ * file (created sparse at its full size) once audio is written to them. All file operations are
+ * queued in order and run on a shared pool of writer threads so the main thread never waits on the
+ * disk. Written ranges are validated once their data has actually reached their files.
  */
 class AudioPlaybackCache : public PlaybackCache
 {
@@ -71,6 +81,11 @@ public:
 
   QList<TimeRange> GetValidRanges(const TimeRange &range, const qint64 &job_time);
 
+  /**
+   * @brief Block until every queued file operation has finished
+   */
+  void WaitForWrites();
+
   class Segment
   {
   public:
@@ -112,6 +127,14 @@ public:
       return offset_ + size_;
     }
 
+    /**
+     * @brief Returns TRUE if this segment has no file and plays as silence
+     */
+    bool IsSilent() const
+    {
+      return filename_.isEmpty();
+    }
+
   private:
     QString filename_;
 
@@ -184,17 +207,69 @@ public:
 signals:
   void ParametersChanged();
 
+  /**
+   * @brief Emitted from a writer thread once a range's data is in its segment files
+   */
+  void RangeWritten(const olive::TimeRange& range, qint64 job_time);
+
 protected:
   virtual void ShiftEvent(const rational& from, const rational& to) override;
 
   virtual void LengthChangedEvent(const rational& old, const rational& newlen) override;
 
 private:
+  struct FileOperation {
+    enum Type {
+      /// Create `filename` at `size` bytes, sparse where the filesystem supports it
+      kCreate,
+
+      /// Write `size` bytes of `data` from `data_offset` at `offset`
+      kWrite,
+
+      /// Copy `filename` to `destination`
+      kCopy,
+
+      /// Keep only the last `size` bytes of `filename`
+      kTrimIn,
+
+      kRemove,
+
+      /// Signal RangeWritten() for `range`, everything queued before it has been written
+      kValidate
+    };
+
+    Type type;
+    QString filename;
+    QString destination;
+    qint64 offset;
+    qint64 size;
+    QByteArray data;
+    qint64 data_offset;
+    TimeRange range;
+    qint64 job_time;
+  };
+
   static const qint64 kDefaultSegmentSize;
 
-  Segment CloneSegment(const Segment& s) const;
+  void QueueOperation(const FileOperation& op);
+
+  void QueueFileOperation(FileOperation::Type type, const QString& filename, qint64 size = 0,
+                          const QString& destination = QString());
 
-  Segment CreateSegment(const qint64 &size, const qint64 &offset) const;
+  void QueueWrite(const QString& filename, qint64 offset, const QByteArray& data, qint64 data_offset, qint64 size);
+
+  void DrainQueue();
+
+  void RunOperation(const FileOperation& op);
+
+  /**
+   * @brief Give a silent segment a file so audio can be written to it
+   */
+  void MaterializeSegment(Segment* s);
+
+  Segment CloneSegment(const Segment& s);
+
+  static Segment CreateSegment(const qint64 &size, const qint64 &offset);
 
   QString GenerateSegmentFilename() const;
 
@@ -212,6 +287,19 @@ private:
 
   AudioParams params_;
 
+  QMutex queue_lock_;
+
+  QWaitCondition queue_cond_;
+
+  QQueue<FileOperation> queue_;
+
+  bool queue_running_;
+
+  static QThreadPool write_pool_;
+
+private slots:
+  void WriteFinished(const olive::TimeRange& range, qint64 job_time);
+
 };
 
 }
@@ -0,0 +1,120 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#include "cacheiopool.h"
+
+#include <QCoreApplication>
+
+#include "common/tracer.h"
+#include "render/framehashcache.h"
+#include "render/renderrequest.h"
+
+namespace olive {
+
+const int CacheIOPool::kThreadCount = 2;
+const int CacheIOPool::kMaximumQueuedWrites = 32;
+
+CacheIOPool::CacheIOPool(QObject *parent) :
+  ThreadPool(QThread::LowPriority, kThreadCount, parent),
+  pending_writes_(0)
+{
+}
+
+void CacheIOPool::RunTicket(RenderTicketPtr ticket) const
+{
+  const RenderRequest* request = ticket->request();
+
+  ticket->Start();
+
+  if (request && request->type == RenderRequest::kTypeVideoLoad) {
+    // Reads aren't counted against the write queue
+    ticket->Finish(QVariant::fromValue(LoadFrame(static_cast<const FrameLoadRequest*>(request))),
+                   ticket->WasCancelled());
+    return;
+  }
+
+  if (!request || request->type != RenderRequest::kTypeVideoDownload) {
+    qWarning() << "Tried to run a non-save ticket on the cache IO pool";
+    ticket->Finish(QVariant(), true);
+  } else if (ticket->WasCancelled()) {
+    ticket->Finish(QVariant(), true);
+  } else {
+    const FrameSaveRequest* save = static_cast<const FrameSaveRequest*>(request);
+
+    TraceSpan save_span("Disk Save");
+
+    ticket->Finish(save->cache->SaveCacheFrame(save->hash, save->frame), false);
+  }
+
+  QMutexLocker locker(&space_lock_);
+  pending_writes_.fetchAndSubOrdered(1);
+  space_cond_.wakeAll();
+}
+
+FramePtr CacheIOPool::LoadFrame(const FrameLoadRequest *load)
+{
+  TraceSpan load_span("Disk Load");
+
+  FramePtr frame = load->cache->LoadCacheFrame(load->hash);
+
+  if (!frame) {
+    return nullptr;
+  }
+
+  if (load->force_color_output) {
+    // Convert in float so the transform isn't clamped or quantized by the cache's format
+    if (frame->format() != VideoParams::kFormatFloat32) {
+      frame = frame->convert(VideoParams::kFormatFloat32);
+
+      if (!frame) {
+        return nullptr;
+      }
+    }
+
+    load->force_color_output->ConvertFrame(frame);
+  }
+
+  if (load->force_format != VideoParams::kFormatInvalid && frame->format() != load->force_format) {
+    frame = frame->convert(load->force_format);
+  }
+
+  return frame;
+}
+
+void CacheIOPool::AddSaveTicket(RenderTicketPtr ticket, TicketPriority priority)
+{
+  QCoreApplication* app = QCoreApplication::instance();
+  bool can_wait = app && QThread::currentThread() != app->thread();
+
+  {
+    QMutexLocker locker(&space_lock_);
+
+    if (can_wait) {
+      while (IsSaturated()) {
+        space_cond_.wait(&space_lock_);
+      }
+    }
+
+    pending_writes_.fetchAndAddOrdered(1);
+  }
+
+  AddTicket(ticket, priority);
+}
+
+}
@@ -0,0 +1,102 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#ifndef CACHEIOPOOL_H
+#define CACHEIOPOOL_H
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "codec/frame.h"
+#include "threading/threadpool.h"
+
+namespace olive {
+
+struct FrameLoadRequest;
+
+/**
+ * @brief A small pool of threads dedicated to writing rendered frames to the disk cache
+ *
+ * Writes used to share the render workers, so a slow disk held up a render thread (and its
+ * renderer) for every frame saved. Here they run on their own low priority threads, leaving the
+ * render workers free to keep rendering while the disk catches up.
+ *
+ * The number of writes in flight is bounded by kMaximumQueuedWrites. Callers off the main thread
+ * (e.g. an export's watcher thread) block in AddSaveTicket() until there's room, so a producer
+ * can't outrun the disk and fill memory with frames waiting to be written. The main thread is
+ * never blocked, it's expected to check IsSaturated() and hold off on rendering more instead.
+ *
+ * Frames being read back from the cache (kTypeVideoLoad tickets) run here too, but don't count
+ * towards the write queue.
+ */
+class CacheIOPool : public ThreadPool
+{
+  Q_OBJECT
+public:
+  CacheIOPool(QObject* parent = nullptr);
+
+  virtual void RunTicket(RenderTicketPtr ticket) const override;
+
+  /**
+   * @brief Queue a FrameSaveRequest ticket, waiting for room first if necessary
+   *
+   * This function is thread-safe.
+   */
+  void AddSaveTicket(RenderTicketPtr ticket, TicketPriority priority);
+
+  /**
+   * @brief Returns how many writes are queued or running
+   */
+  int GetPendingWriteCount() const
+  {
+    return pending_writes_.load();
+  }
+
+  /**
+   * @brief Returns TRUE if no more writes should be queued until some have finished
+   */
+  bool IsSaturated() const
+  {
+    return GetPendingWriteCount() >= kMaximumQueuedWrites;
+  }
+
+  /**
+   * @brief Number of threads writing to disk at once
+   */
+  static const int kThreadCount;
+
+  /**
+   * @brief Queued and running writes at which producers are held back
+   */
+  static const int kMaximumQueuedWrites;
+
+private:
+  static FramePtr LoadFrame(const FrameLoadRequest* load);
+
+  mutable QAtomicInt pending_writes_;
+
+  mutable QMutex space_lock_;
+
+  mutable QWaitCondition space_cond_;
+
+};
+
+}
+
+#endif // CACHEIOPOOL_H
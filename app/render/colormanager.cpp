@@ -23,15 +23,18 @@
 #include <QDir>
 #include <QFloat16>
 #include <QStandardPaths>
+#include <QtConcurrent/QtConcurrent>
 
 #include "common/define.h"
 #include "common/filefunctions.h"
 #include "config/config.h"
 #include "core.h"
+#include "render/colorprocessorcache.h"
 
 namespace olive {
 
 OCIO::ConstConfigRcPtr ColorManager::default_config_;
+QFuture<void> ColorManager::default_config_load_;
 
 ColorManager::ColorManager()
 {
@@ -64,10 +67,17 @@ const QString &ColorManager::GetConfigFilename() const
 
 OCIO::ConstConfigRcPtr ColorManager::GetDefaultConfig()
 {
+  default_config_load_.waitForFinished();
+
   return default_config_;
 }
 
 void ColorManager::SetUpDefaultConfig()
+{
+  default_config_load_ = QtConcurrent::run(&ColorManager::LoadDefaultConfig);
+}
+
+void ColorManager::LoadDefaultConfig()
 {
   if (!qgetenv("OCIO").isEmpty()) {
     // Attempt to set config from "OCIO" environment variable
@@ -109,6 +119,9 @@ void ColorManager::SetConfigInternal(const QString &filename)
 {
   config_filename_ = filename;
 
+  // The file may have changed since processors were last built from it
+  ColorProcessorCache::Clear(filename);
+
   OCIO::ConstConfigRcPtr cfg;
 
   if (config_filename_.isEmpty()) {
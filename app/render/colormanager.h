@@ -22,6 +22,7 @@
 #define COLORSERVICE_H
 
 #include <memory>
+#include <QFuture>
 #include <QMutex>
 
 #include "codec/frame.h"
@@ -43,8 +44,17 @@ public:
 
   const QString& GetConfigFilename() const;
 
+  /**
+   * @brief Returns the built-in config, waiting for SetUpDefaultConfig() to finish loading it
+   */
   static OCIO::ConstConfigRcPtr GetDefaultConfig();
 
+  /**
+   * @brief Start loading the built-in config in the background
+   *
+   * Extracting and parsing it is slow enough to hold up startup, nothing needs it until the first
+   * project is created.
+   */
   static void SetUpDefaultConfig();
 
   void SetConfig(const QString& filename);
@@ -117,8 +127,12 @@ private:
 
   QMutex mutex_;
 
+  static void LoadDefaultConfig();
+
   static OCIO::ConstConfigRcPtr default_config_;
 
+  static QFuture<void> default_config_load_;
+
 };
 
 }
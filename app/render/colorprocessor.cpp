@@ -23,6 +23,7 @@
 #include "common/define.h"
 #include "common/ocioutils.h"
 #include "colormanager.h"
+#include "colorprocessorcache.h"
 
 namespace olive {
 
@@ -78,6 +79,21 @@ ColorProcessor::ColorProcessor(ColorManager *config, const QString &input, const
   id_ = GenerateID(config, input, transform);
 }
 
+ColorProcessor::ColorProcessor(ColorManager *config, ColorProcessorPtr first, ColorProcessorPtr second)
+{
+  QMutexLocker locker(config->mutex());
+
+  auto group = OCIO::GroupTransform::Create();
+  group->appendTransform(first->GetProcessor()->createGroupTransform());
+  group->appendTransform(second->GetProcessor()->createGroupTransform());
+
+  OCIO_SET_C_LOCALE_FOR_SCOPE;
+  processor_ = config->GetConfig()->getProcessor(group);
+
+  cpu_processor_ = processor_->getDefaultCPUProcessor();
+  id_ = GenerateComposedID(first, second);
+}
+
 void ColorProcessor::ConvertFrame(Frame *f)
 {
   OCIO::BitDepth ocio_bit_depth = OCIOUtils::GetOCIOBitDepthFromPixelFormat(f->format());
@@ -111,16 +127,28 @@ Color ColorProcessor::ConvertColor(const Color& in)
 
 QString ColorProcessor::GenerateID(ColorManager *config, const QString &input, const ColorTransform &transform)
 {
-  return QStringLiteral("%1:%2:%3:%4:%5").arg(config->GetConfigFilename(),
-                                              input,
-                                              transform.display(),
-                                              transform.view(),
-                                              transform.look());
+  return QStringLiteral("%1:%2:%3:%4:%5:%6").arg(config->GetConfigFilename(),
+                                                 input,
+                                                 transform.is_display() ? QStringLiteral("d") : QStringLiteral("o"),
+                                                 transform.display(),
+                                                 transform.view(),
+                                                 transform.look());
+}
+
+QString ColorProcessor::GenerateComposedID(ColorProcessorPtr first, ColorProcessorPtr second)
+{
+  // Both IDs start with the config filename, so the composition's does too
+  return QStringLiteral("%1>%2").arg(first->id(), second->id());
 }
 
 ColorProcessorPtr ColorProcessor::Create(ColorManager *config, const QString& input, const ColorTransform &transform)
 {
-  return std::make_shared<ColorProcessor>(config, input, transform);
+  return ColorProcessorCache::Get(config, input, transform);
+}
+
+ColorProcessorPtr ColorProcessor::Compose(ColorManager *config, ColorProcessorPtr first, ColorProcessorPtr second)
+{
+  return ColorProcessorCache::GetComposed(config, first, second);
 }
 
 OCIO::ConstProcessorRcPtr ColorProcessor::GetProcessor()
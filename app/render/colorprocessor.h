@@ -43,10 +43,24 @@ public:
 
   ColorProcessor(ColorManager* config, const QString& input, const ColorTransform& dest_space);
 
+  /**
+   * @brief Create a processor that applies `first` and then `second` in a single transform
+   */
+  ColorProcessor(ColorManager* config, ColorProcessorPtr first, ColorProcessorPtr second);
+
   DISABLE_COPY_MOVE(ColorProcessor)
 
   static ColorProcessorPtr Create(ColorManager* config, const QString& input, const ColorTransform& dest_space);
 
+  /**
+   * @brief Returns a processor equivalent to running `first` and then `second`
+   *
+   * OCIO optimizes the combined transform, so a conversion into the reference space followed by
+   * one out of it usually costs no more than either on its own, and running it on the GPU only
+   * takes one pass rather than two.
+   */
+  static ColorProcessorPtr Compose(ColorManager* config, ColorProcessorPtr first, ColorProcessorPtr second);
+
   OCIO::ConstProcessorRcPtr GetProcessor();
 
   void ConvertFrame(FramePtr f);
@@ -61,6 +75,8 @@ public:
 
   static QString GenerateID(ColorManager* config, const QString& input, const ColorTransform& dest_space);
 
+  static QString GenerateComposedID(ColorProcessorPtr first, ColorProcessorPtr second);
+
 private:
   OCIO::ConstProcessorRcPtr processor_;
 
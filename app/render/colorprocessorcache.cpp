@@ -0,0 +1,124 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "colorprocessorcache.h"
+
+#include "colormanager.h"
+#include "common/lockprofiler.h"
+
+namespace olive {
+
+QMutex ColorProcessorCache::lock_;
+QHash<QString, ColorProcessorPtr> ColorProcessorCache::processors_;
+
+ColorProcessorPtr ColorProcessorCache::Get(ColorManager *config, const QString &input, const ColorTransform &dest_space)
+{
+  QString id = ColorProcessor::GenerateID(config, input, dest_space);
+
+  {
+    ProfiledMutexLocker locker(&lock_, LockProfiler::kColorProcessorCache);
+
+    ColorProcessorPtr existing = processors_.value(id);
+    if (existing) {
+      return existing;
+    }
+  }
+
+  // Build outside the lock so threads creating different transforms don't wait on each other. If
+  // another thread built the same one in the meantime, we use theirs and discard ours.
+  ColorProcessorPtr processor = std::make_shared<ColorProcessor>(config, input, dest_space);
+
+  ProfiledMutexLocker locker(&lock_, LockProfiler::kColorProcessorCache);
+
+  ColorProcessorPtr existing = processors_.value(id);
+  if (existing) {
+    return existing;
+  }
+
+  processors_.insert(id, processor);
+
+  return processor;
+}
+
+ColorProcessorPtr ColorProcessorCache::GetComposed(ColorManager *config, ColorProcessorPtr first, ColorProcessorPtr second)
+{
+  QString id = ColorProcessor::GenerateComposedID(first, second);
+
+  {
+    ProfiledMutexLocker locker(&lock_, LockProfiler::kColorProcessorCache);
+
+    ColorProcessorPtr existing = processors_.value(id);
+    if (existing) {
+      return existing;
+    }
+  }
+
+  ColorProcessorPtr processor = std::make_shared<ColorProcessor>(config, first, second);
+
+  ProfiledMutexLocker locker(&lock_, LockProfiler::kColorProcessorCache);
+
+  ColorProcessorPtr existing = processors_.value(id);
+  if (existing) {
+    return existing;
+  }
+
+  processors_.insert(id, processor);
+
+  return processor;
+}
+
+QVector<ColorProcessorPtr> ColorProcessorCache::Warm(ColorManager *config, const QStringList &input_spaces)
+{
+  QVector<ColorProcessorPtr> processors;
+  ColorTransform reference(config->GetReferenceColorSpace());
+
+  foreach (const QString& input, input_spaces) {
+    if (!input.isEmpty() && input != reference.output()) {
+      processors.append(Get(config, input, reference));
+    }
+  }
+
+  return processors;
+}
+
+void ColorProcessorCache::Clear(const QString &config_filename)
+{
+  QMutexLocker locker(&lock_);
+
+  // IDs start with the config filename followed by a colon
+  QString prefix = config_filename;
+  prefix.append(QLatin1Char(':'));
+
+  for (auto it=processors_.begin(); it!=processors_.end(); ) {
+    if (it.key().startsWith(prefix)) {
+      it = processors_.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+void ColorProcessorCache::Clear()
+{
+  QMutexLocker locker(&lock_);
+  processors_.clear();
+}
+
+}
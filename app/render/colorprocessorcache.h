@@ -21,12 +21,63 @@
 #ifndef COLORPROCESSORCACHE_H
 #define COLORPROCESSORCACHE_H
 
-#include "project/item/footage/stream.h"
+#include <QHash>
+#include <QMutex>
+
 #include "render/colorprocessor.h"
 
 namespace olive {
 
-using ColorProcessorCache = QHash<QString, ColorProcessorPtr>;
+/**
+ * @brief Global cache of ColorProcessors so each transform is only built once
+ *
+ * Building an OCIO processor means resolving the config's transforms and optimizing them, which
+ * is slow enough to show up when many render threads start on a new clip at once. Processors
+ * hold no per-use state, so one instance can be shared by every thread that needs the same
+ * transform. ColorProcessor::Create() goes through this cache automatically.
+ *
+ * Entries are keyed on ColorProcessor::GenerateID(), i.e. the config file, the input space and
+ * the output display/view/look. They're dropped whenever a ColorManager's config changes.
+ *
+ * This class is thread safe.
+ */
+class ColorProcessorCache
+{
+public:
+  /**
+   * @brief Return the processor for this transform, creating it if it isn't cached yet
+   */
+  static ColorProcessorPtr Get(ColorManager* config, const QString& input, const ColorTransform& dest_space);
+
+  /**
+   * @brief Return the composition of two processors, creating it if it isn't cached yet
+   *
+   * \see ColorProcessor::Compose()
+   */
+  static ColorProcessorPtr GetComposed(ColorManager* config, ColorProcessorPtr first, ColorProcessorPtr second);
+
+  /**
+   * @brief Create the processors converting each of `input_spaces` to the reference space
+   *
+   * These are the processors footage is converted with, so creating them up front (for example
+   * when a project is opened) keeps the first frame of each clip from stalling on them. Returns
+   * the processors so they can also be compiled for the GPU.
+   */
+  static QVector<ColorProcessorPtr> Warm(ColorManager* config, const QStringList& input_spaces);
+
+  /**
+   * @brief Remove every processor created from this config file
+   */
+  static void Clear(const QString& config_filename);
+
+  static void Clear();
+
+private:
+  static QMutex lock_;
+
+  static QHash<QString, ColorProcessorPtr> processors_;
+
+};
 
 }
 
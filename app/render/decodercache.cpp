@@ -0,0 +1,160 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "decodercache.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+
+#include "common/lockprofiler.h"
+#include "config/config.h"
+
+namespace olive {
+
+const qint64 DecoderCache::kIdleTimeout = 60000;
+
+DecoderCache::DecoderCache() :
+  Consumer(QCoreApplication::translate("DecoderCache", "Open Decoders"), MemoryGovernor::kPriorityCache)
+{
+  clock_.start();
+
+  MemoryGovernor::Register(this);
+}
+
+DecoderCache::~DecoderCache()
+{
+  MemoryGovernor::Unregister(this);
+}
+
+DecoderPoolPtr DecoderCache::Get(Stream *stream, bool proxy)
+{
+  DecoderPoolPtr pool;
+
+  {
+    // Declared before the locker so evicted pools are closed after the lock is released
+    QVector<DecoderPoolPtr> closing;
+
+    ProfiledMutexLocker locker(&lock_, LockProfiler::kDecoderCache);
+
+    Key key(stream, proxy);
+
+    auto it = entries_.find(key);
+
+    if (it == entries_.end()) {
+      pool = std::make_shared<DecoderPool>(stream, proxy);
+
+      if (!pool->Open()) {
+        qWarning() << "Failed to open decoder for" << stream->footage()->filename()
+                   << "::" << stream->index();
+        return nullptr;
+      }
+
+      Entry e;
+      e.pool = pool;
+      access_order_.push_back(key);
+      e.access = std::prev(access_order_.end());
+      e.last_used = clock_.elapsed();
+      entries_.insert(key, e);
+    } else {
+      // Bump to most recently used
+      access_order_.splice(access_order_.end(), access_order_, it->access);
+      it->last_used = clock_.elapsed();
+      pool = it->pool;
+    }
+
+    EvictInternal(key, &closing);
+  }
+
+  if (MemoryGovernor::IsOverBudget()) {
+    MemoryGovernor::Reclaim();
+  }
+
+  return pool;
+}
+
+qint64 DecoderCache::GetMemoryUsage() const
+{
+  return 0;
+}
+
+bool DecoderCache::ReleaseMemory(qint64 bytes)
+{
+  Q_UNUSED(bytes)
+
+  // Closed after the lock is released
+  DecoderPoolPtr closing;
+
+  QMutexLocker locker(&lock_);
+
+  for (auto a=access_order_.begin(); a!=access_order_.end(); a++) {
+    auto e = entries_.find(*a);
+
+    // The cache holding the only reference means nobody is decoding from it
+    if (e->pool.use_count() == 1) {
+      closing = e->pool;
+      entries_.erase(e);
+      access_order_.erase(a);
+      break;
+    }
+  }
+
+  locker.unlock();
+
+  return closing != nullptr;
+}
+
+void DecoderCache::EvictInternal(const Key &keep, QVector<DecoderPoolPtr> *closing)
+{
+  int limit = Config::Current()[QStringLiteral("OpenDecoderLimit")].toInt();
+
+  int open_count = 0;
+  foreach (const Entry& e, entries_) {
+    open_count += e.pool->GetInstanceCount();
+  }
+
+  qint64 now = clock_.elapsed();
+
+  auto a = access_order_.begin();
+
+  while (a != access_order_.end()) {
+    auto e = entries_.find(*a);
+
+    bool over_limit = (open_count > limit);
+    bool expired = (now - e->last_used > kIdleTimeout);
+
+    if (!over_limit && !expired) {
+      // Everything after this was used more recently so it can't have expired either
+      break;
+    }
+
+    // The cache holding the only reference means nobody is decoding from it
+    if (*a != keep && e->pool.use_count() == 1) {
+      open_count -= e->pool->GetInstanceCount();
+
+      closing->append(e->pool);
+      entries_.erase(e);
+      a = access_order_.erase(a);
+    } else {
+      a++;
+    }
+  }
+}
+
+}
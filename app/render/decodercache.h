@@ -0,0 +1,111 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef DECODERCACHE_H
+#define DECODERCACHE_H
+
+#include <list>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+
+#include "codec/decoderpool.h"
+#include "common/define.h"
+#include "common/memorygovernor.h"
+
+namespace olive {
+
+/**
+ * @brief Open DecoderPools shared between renderers, keyed by stream and whether they decode its proxy
+ *
+ * Every open decoder holds its format and codec contexts, scaler and frame pool, so long timelines
+ * can't keep a decoder open for every clip they've ever rendered. The cache keeps the total number
+ * of open decoder instances under the "OpenDecoderLimit" config entry and closes pools that haven't
+ * been used for a while. When MemoryGovernor is over budget, it closes the least recently used
+ * pools to give their frames back. Pools currently being decoded from are never closed.
+ *
+ * Reopening a closed stream is cheap since FFmpegDecoder keeps the keyframe indices of recently
+ * opened streams in memory.
+ *
+ * This class is thread safe.
+ */
+class DecoderCache : public MemoryGovernor::Consumer
+{
+public:
+  DecoderCache();
+
+  virtual ~DecoderCache() override;
+
+  DISABLE_COPY_MOVE(DecoderCache)
+
+  /**
+   * @brief Get the pool for a stream, opening it if it isn't open yet
+   *
+   * Returns nullptr if the stream couldn't be opened.
+   */
+  DecoderPoolPtr Get(Stream* stream, bool proxy);
+
+  /**
+   * @brief Decoded frames are lent from BufferPool so they're counted there, this always returns 0
+   */
+  virtual qint64 GetMemoryUsage() const override;
+
+  /**
+   * @brief Close the least recently used idle pool
+   */
+  virtual bool ReleaseMemory(qint64 bytes) override;
+
+private:
+  using Key = QPair<Stream*, bool>;
+
+  struct Entry {
+    DecoderPoolPtr pool;
+    std::list<Key>::iterator access;
+    qint64 last_used;
+  };
+
+  /**
+   * @brief Remove pools that are idle and over the limits, least recently used first
+   *
+   * Removed pools are appended to `closing` so they can be destroyed after the lock is released.
+   * The pool for `keep` is never removed.
+   */
+  void EvictInternal(const Key& keep, QVector<DecoderPoolPtr>* closing);
+
+  /**
+   * @brief Milliseconds after which an unused pool is closed
+   */
+  static const qint64 kIdleTimeout;
+
+  QMutex lock_;
+
+  QHash<Key, Entry> entries_;
+
+  /// Keys ordered from least to most recently used
+  std::list<Key> access_order_;
+
+  QElapsedTimer clock_;
+
+};
+
+}
+
+#endif // DECODERCACHE_H
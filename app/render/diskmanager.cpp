@@ -20,18 +20,24 @@
 
 #include "diskmanager.h"
 
+#include <cmath>
 #include <QDataStream>
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QMessageBox>
+#include <QSaveFile>
 #include <QStandardPaths>
+#include <QStorageInfo>
+#include <QtConcurrent/QtConcurrent>
 
 #include "common/filefunctions.h"
 #include "config/config.h"
 #include "core.h"
 #include "dialog/diskcache/diskcachedialog.h"
+#include "render/framememorycache.h"
+#include "render/framepack.h"
 
 namespace olive {
 
@@ -74,6 +80,10 @@ DiskManager::DiskManager()
 
     disk_cache_index.close();
   }
+
+  stripe_health_timer_.setInterval(kStripeHealthInterval);
+  connect(&stripe_health_timer_, &QTimer::timeout, this, &DiskManager::UpdateStripeHealth);
+  stripe_health_timer_.start();
 }
 
 DiskManager::~DiskManager()
@@ -86,6 +96,12 @@ DiskManager::~DiskManager()
 
     default_disk_cache_file.close();
   }
+
+  // Folders save their packs' indexes as they close so they must go first
+  qDeleteAll(open_folders_);
+  open_folders_.clear();
+
+  FramePack::CloseAll();
 }
 
 void DiskManager::CreateInstance()
@@ -118,11 +134,24 @@ void DiskManager::CreatedFile(const QString &cache_folder, const QString &file_n
   f->CreatedFile(file_name, hash);
 }
 
-bool DiskManager::ClearDiskCache(const QString &cache_folder)
+void DiskManager::CreatedPackedFrame(const QString &cache_folder, const QByteArray &hash, qint64 size)
 {
   DiskCacheFolder* f = GetOpenFolder(cache_folder);
 
-  return f->ClearCache();
+  f->CreatedPackedFrame(hash, size);
+}
+
+bool DiskManager::ClearDiskCache(const QString &cache_folder)
+{
+  bool success = true;
+
+  foreach (const QString& stripe, GetStripePaths(cache_folder.isEmpty() ? GetDefaultCachePath() : cache_folder)) {
+    if (!GetOpenFolder(stripe)->ClearCache()) {
+      success = false;
+    }
+  }
+
+  return success;
 }
 
 DiskCacheFolder *DiskManager::GetOpenFolder(const QString &path)
@@ -141,7 +170,7 @@ DiskCacheFolder *DiskManager::GetOpenFolder(const QString &path)
 
   // We must have to open this folder
   DiskCacheFolder* f = new DiskCacheFolder(path, this);
-  connect(f, &DiskCacheFolder::DeletedFrame, this, &DiskManager::DeletedFrame);
+  connect(f, &DiskCacheFolder::DeletedFrames, this, &DiskManager::DeletedFrames);
   open_folders_.append(f);
 
   return f;
@@ -185,9 +214,284 @@ void DiskManager::ShowDiskCacheSettingsDialog(const QString &path, QWidget *pare
   ShowDiskCacheSettingsDialog(folder, parent);
 }
 
+QStringList DiskManager::GetStripePaths(const QString &cache_path)
+{
+  QMutexLocker locker(&stripe_lock_);
+
+  QStringList paths;
+
+  foreach (const Stripe& s, GetStripeSet(cache_path)) {
+    paths.append(s.path);
+  }
+
+  return paths;
+}
+
+void DiskManager::SetStripePaths(const QString &cache_path, const QStringList &extra_folders)
+{
+  QStringList lines;
+
+  {
+    QMutexLocker locker(&stripe_lock_);
+
+    QVector<Stripe>& set = GetStripeSet(cache_path);
+
+    QVector<Stripe> new_set;
+    new_set.append(set.first());
+
+    foreach (const QString& folder, extra_folders) {
+      if (folder.isEmpty() || folder == cache_path) {
+        continue;
+      }
+
+      // Keep what we've learned about stripes that were already in the set
+      Stripe stripe = {folder, 0, 0.0, false};
+      foreach (const Stripe& existing, set) {
+        if (existing.path == folder) {
+          stripe = existing;
+          break;
+        }
+      }
+
+      new_set.append(stripe);
+      lines.append(folder);
+    }
+
+    set = new_set;
+  }
+
+  QFile stripe_file(GetStripeListFilename(cache_path));
+  if (lines.isEmpty()) {
+    stripe_file.remove();
+  } else if (stripe_file.open(QFile::WriteOnly | QFile::Text)) {
+    stripe_file.write(lines.join('\n').toUtf8());
+    stripe_file.close();
+  } else {
+    qWarning() << "Failed to save disk cache stripes to" << stripe_file.fileName();
+  }
+
+  UpdateStripeHealth();
+}
+
+QString DiskManager::GetStripeForWrite(const QString &cache_path, const QByteArray &hash)
+{
+  QMutexLocker locker(&stripe_lock_);
+
+  const QVector<Stripe>& set = GetStripeSet(cache_path);
+
+  if (set.size() == 1) {
+    return cache_path;
+  }
+
+  QVector<const Stripe*> ranked = RankStripes(set, hash);
+
+  foreach (const Stripe* s, ranked) {
+    if (!s->degraded) {
+      return s->path;
+    }
+  }
+
+  // Everything is degraded, we may as well write where the frame belongs
+  return ranked.first()->path;
+}
+
+QStringList DiskManager::GetStripesForRead(const QString &cache_path, const QByteArray &hash)
+{
+  QMutexLocker locker(&stripe_lock_);
+
+  const QVector<Stripe>& set = GetStripeSet(cache_path);
+
+  if (set.size() == 1) {
+    return QStringList(cache_path);
+  }
+
+  // Degraded stripes rank where they normally would, frames already on them are still best
+  // read from them, and frames moved off them were moved to the next in line
+  QStringList paths;
+  foreach (const Stripe* s, RankStripes(set, hash)) {
+    paths.append(s->path);
+  }
+
+  return paths;
+}
+
+void DiskManager::RecordStripeWrite(const QString &stripe, qint64 bytes, qint64 nsecs)
+{
+  if (nsecs <= 0) {
+    return;
+  }
+
+  double rate = static_cast<double>(bytes) * 1000000.0 / static_cast<double>(nsecs);
+
+  QMutexLocker locker(&stripe_lock_);
+
+  for (auto it=stripe_sets_.begin(); it!=stripe_sets_.end(); it++) {
+    // Only striped caches need to compare drives
+    if (it.value().size() == 1) {
+      continue;
+    }
+
+    for (int i=0; i<it.value().size(); i++) {
+      Stripe& s = it.value()[i];
+
+      if (s.path == stripe) {
+        s.write_rate = (s.write_rate > 0.0) ? (s.write_rate * 0.9 + rate * 0.1) : rate;
+      }
+    }
+  }
+}
+
+QVector<DiskManager::Stripe> &DiskManager::GetStripeSet(const QString &cache_path)
+{
+  auto it = stripe_sets_.find(cache_path);
+
+  if (it == stripe_sets_.end()) {
+    QVector<Stripe> set;
+    set.append({cache_path, 0, 0.0, false});
+
+    QFile stripe_file(GetStripeListFilename(cache_path));
+    if (stripe_file.open(QFile::ReadOnly | QFile::Text)) {
+      QStringList lines = QString::fromUtf8(stripe_file.readAll()).split('\n');
+      stripe_file.close();
+
+      foreach (const QString& line, lines) {
+        if (!line.isEmpty() && line != cache_path) {
+          set.append({line, 0, 0.0, false});
+        }
+      }
+    }
+
+    it = stripe_sets_.insert(cache_path, set);
+  }
+
+  return it.value();
+}
+
+QVector<const DiskManager::Stripe *> DiskManager::RankStripes(const QVector<Stripe> &set, const QByteArray &hash)
+{
+  // Weighted rendezvous hashing, each stripe scores -weight/ln(x) for a uniform x drawn from the
+  // frame hash and the stripe's path, and the highest score wins
+  QVector<QPair<double, const Stripe*> > scores;
+  scores.reserve(set.size());
+
+  foreach (const Stripe& s, set) {
+    double x = (static_cast<double>(qHash(hash + s.path.toUtf8())) + 1.0) / 4294967297.0;
+    double weight = (s.weight > 0) ? static_cast<double>(s.weight) : 1.0;
+
+    scores.append({-weight / std::log(x), &s});
+  }
+
+  std::sort(scores.begin(), scores.end(), [](const QPair<double, const Stripe*>& a, const QPair<double, const Stripe*>& b){
+    return a.first > b.first;
+  });
+
+  QVector<const Stripe*> ranked;
+  ranked.reserve(scores.size());
+
+  for (int i=0; i<scores.size(); i++) {
+    ranked.append(scores.at(i).second);
+  }
+
+  return ranked;
+}
+
+QString DiskManager::GetStripeListFilename(const QString &cache_path)
+{
+  return QDir(cache_path).filePath(QStringLiteral("stripes"));
+}
+
+void DiskManager::UpdateStripeHealth()
+{
+  // Limits and free space are read without the lock held, they can take a moment to get
+  QHash<QString, QPair<qint64, qint64> > drive_info;
+
+  {
+    QStringList striped_paths;
+
+    {
+      QMutexLocker locker(&stripe_lock_);
+
+      for (auto it=stripe_sets_.cbegin(); it!=stripe_sets_.cend(); it++) {
+        if (it.value().size() > 1) {
+          foreach (const Stripe& s, it.value()) {
+            striped_paths.append(s.path);
+          }
+        }
+      }
+    }
+
+    foreach (const QString& path, striped_paths) {
+      if (!drive_info.contains(path)) {
+        QStorageInfo storage(path);
+        drive_info.insert(path, {GetOpenFolder(path)->GetLimit(), storage.isValid() ? storage.bytesAvailable() : -1});
+      }
+    }
+  }
+
+  if (drive_info.isEmpty()) {
+    return;
+  }
+
+  QMutexLocker locker(&stripe_lock_);
+
+  for (auto it=stripe_sets_.begin(); it!=stripe_sets_.end(); it++) {
+    QVector<Stripe>& set = it.value();
+
+    if (set.size() == 1) {
+      continue;
+    }
+
+    double fastest = 0.0;
+    foreach (const Stripe& s, set) {
+      fastest = qMax(fastest, s.write_rate);
+    }
+
+    for (int i=0; i<set.size(); i++) {
+      Stripe& s = set[i];
+
+      if (!drive_info.contains(s.path)) {
+        // Added while we were checking, it'll be picked up next time
+        continue;
+      }
+
+      const QPair<qint64, qint64>& info = drive_info.value(s.path);
+
+      bool was_degraded = s.degraded;
+
+      // A stripe that's been skipped hasn't been written to since, so give it another chance to
+      // show whether it's still slow
+      if (was_degraded) {
+        s.write_rate = 0.0;
+      }
+
+      s.weight = info.first;
+      s.degraded = (info.second >= 0 && info.second < kStripeMinimumFreeSpace)
+          || (s.write_rate > 0.0 && s.write_rate * kStripeSlowRatio < fastest);
+
+      if (s.degraded != was_degraded) {
+        if (s.degraded) {
+          qWarning() << "Moving disk cache writes off" << s.path << "until it's less full or slow";
+        } else {
+          qInfo() << "Resuming disk cache writes to" << s.path;
+        }
+      }
+    }
+  }
+}
+
+const int DiskManager::kStripeHealthInterval = 5000;
+const qint64 DiskManager::kStripeMinimumFreeSpace = 2147483648LL;
+const int DiskManager::kStripeSlowRatio = 3;
+
+const int DiskCacheFolder::kJournalCompactRatio = 2;
+const int DiskCacheFolder::kEvictionHeadroomDivider = 20;
+
 DiskCacheFolder::DiskCacheFolder(const QString &path, QObject *parent) :
-  QObject(parent)
+  QObject(parent),
+  journal_records_(0)
 {
+  io_pool_.setMaxThreadCount(1);
+
   SetPath(path);
 
   save_timer_.setInterval(Config::Current()[QStringLiteral("DiskCacheSaveInterval")].toInt());
@@ -202,14 +506,25 @@ DiskCacheFolder::~DiskCacheFolder()
 
 bool DiskCacheFolder::ClearCache()
 {
+  WaitForIndex();
+
   bool deleted_files = true;
 
-  std::list<HashTime>::iterator i = disk_data_.begin();
+  // Clearing is usually done to force frames to be rendered again, so don't leave them in memory either
+  if (FrameMemoryCache::instance()) {
+    FrameMemoryCache::instance()->Clear();
+  }
+
+  HashList::iterator i = disk_data_.begin();
+  QVector<QByteArray> deleted_hashes;
 
   while (i != disk_data_.end()) {
     // We return a false result if any of the files fail to delete, but still try to delete as many as we can
-    if (QFile::remove(i->file_name) || !QFileInfo::exists(i->file_name)) {
-      emit DeletedFrame(path_, i->hash);
+    if (DeleteEntry(*i)) {
+      deleted_hashes.append(i->hash);
+      WriteJournal(kJournalDeleted, *i);
+      consumption_ -= i->file_size;
+      disk_map_.remove(i->hash);
       i = disk_data_.erase(i);
     } else {
       qWarning() << "Failed to delete" << i->file_name;
@@ -218,66 +533,82 @@ bool DiskCacheFolder::ClearCache()
     }
   }
 
+  if (!deleted_hashes.isEmpty()) {
+    emit DeletedFrames(path_, deleted_hashes);
+  }
+
   return deleted_files;
 }
 
 void DiskCacheFolder::Accessed(const QByteArray &hash)
 {
-  std::list<HashTime>::iterator i = disk_data_.begin();
+  WaitForIndex();
 
-  while (i != disk_data_.end()) {
-    if (i->hash == hash) {
-      // Copy access data and erase from list
-      HashTime accessed_hash = *i;
-      disk_data_.erase(i);
+  auto it = disk_map_.constFind(hash);
 
-      // Add it to the end
-      disk_data_.push_back(accessed_hash);
+  if (it != disk_map_.constEnd()) {
+    // Move to the end of the list
+    disk_data_.splice(disk_data_.end(), disk_data_, it.value());
 
-      // End loop
-      break;
-    } else {
-      i++;
-    }
+    WriteJournal(kJournalAccessed, *it.value());
   }
 }
 
 void DiskCacheFolder::CreatedFile(const QString &file_name, const QByteArray &hash)
 {
-  qint64 file_size = QFile(file_name).size();
-
-  disk_data_.push_back({file_name, hash, file_size});
+  WaitForIndex();
 
-  consumption_ += file_size;
+  HashTime h = {file_name, hash, QFile(file_name).size()};
 
-  QList<QByteArray> deleted_hashes;
+  InsertEntry(h);
+  WriteJournal(kJournalCreated, h);
 
-  while (consumption_ > limit_) {
-    deleted_hashes.append(DeleteLeastRecent());
+  if (consumption_ > limit_) {
+    DeleteLeastRecent();
   }
+}
 
-  foreach (const QByteArray& h, deleted_hashes) {
-    emit DeletedFrame(path_, h);
+void DiskCacheFolder::CreatedPackedFrame(const QByteArray &hash, qint64 file_size)
+{
+  WaitForIndex();
+
+  HashTime h = {QString(), hash, file_size};
+
+  InsertEntry(h);
+  WriteJournal(kJournalCreated, h);
+
+  if (consumption_ > limit_) {
+    DeleteLeastRecent();
   }
 }
 
 void DiskCacheFolder::SetPath(const QString &path)
 {
+  WaitForIndex();
+
   // If this is currently set to a folder, close it out now
   CloseCacheFolder();
 
   // Signal that disk cache is gone
   if (!disk_data_.empty()) {
+    QVector<QByteArray> deleted_hashes;
+    deleted_hashes.reserve(static_cast<int>(disk_data_.size()));
+
     foreach (const HashTime& h, disk_data_) {
-      emit DeletedFrame(path_, h.hash);
+      deleted_hashes.append(h.hash);
     }
+
+    emit DeletedFrames(path_, deleted_hashes);
     disk_data_.clear();
+    disk_map_.clear();
   }
 
   // Set defaults
   clear_on_close_ = false;
   consumption_ = 0;
   limit_ = 21474836480; // Default to 20 GB
+  journal_buffer_.clear();
+  journal_records_ = 0;
 
   // Set path
   path_ = path;
@@ -287,8 +618,195 @@ void DiskCacheFolder::SetPath(const QString &path)
   path_dir.mkpath(".");
 
   index_path_ = path_dir.filePath(QStringLiteral("index"));
+  journal_path_ = path_dir.filePath(QStringLiteral("index.journal"));
+  old_journal_path_ = path_dir.filePath(QStringLiteral("index.journal.old"));
+
+  index_load_ = QtConcurrent::run(&io_pool_, [this](){
+    LoadIndex();
+  });
+}
+
+void DiskCacheFolder::LoadIndex()
+{
+  // Load the last full index and then everything that happened since. An old journal only exists
+  // if we didn't get to finish compacting it.
+  LoadSnapshot();
+  ReplayJournal(old_journal_path_);
+  ReplayJournal(journal_path_);
+
+  // Drop anything that's no longer on disk
+  FramePack* pack = FramePack::Get(path_);
+  HashList::iterator i = disk_data_.begin();
+
+  while (i != disk_data_.end()) {
+    bool exists = i->file_name.isEmpty()
+        ? pack->Contains(i->hash)
+        : QFileInfo::exists(i->file_name);
+
+    if (exists) {
+      i++;
+    } else {
+      consumption_ -= i->file_size;
+      disk_map_.remove(i->hash);
+      i = disk_data_.erase(i);
+    }
+  }
+}
+
+void DiskCacheFolder::SetLimit(qint64 l)
+{
+  WaitForIndex();
+
+  limit_ = l;
+
+  WriteJournal(kJournalSettings, HashTime());
+}
+
+void DiskCacheFolder::SetClearOnClose(bool e)
+{
+  WaitForIndex();
+
+  clear_on_close_ = e;
+
+  WriteJournal(kJournalSettings, HashTime());
+}
+
+void DiskCacheFolder::DeleteLeastRecent()
+{
+  qint64 target = limit_ - limit_ / kEvictionHeadroomDivider;
+
+  FramePack* pack = FramePack::Get(path_);
+  QStringList files_to_delete;
+  QVector<QByteArray> deleted_hashes;
+
+  while (consumption_ > target && !disk_data_.empty()) {
+    HashTime h = disk_data_.front();
+
+    RemoveEntry(h.hash);
+    WriteJournal(kJournalDeleted, h);
+
+    if (h.file_name.isEmpty()) {
+      // Only drops the frame from the index so it's fast enough to do here
+      pack->Remove(h.hash);
+    } else {
+      files_to_delete.append(h.file_name);
+    }
+
+    deleted_hashes.append(h.hash);
+  }
+
+  if (!files_to_delete.isEmpty()) {
+    QtConcurrent::run(&io_pool_, [files_to_delete](){
+      foreach (const QString& f, files_to_delete) {
+        QFile::remove(f);
+      }
+    });
+  }
+
+  if (!deleted_hashes.isEmpty()) {
+    emit DeletedFrames(path_, deleted_hashes);
+  }
+}
+
+bool DiskCacheFolder::DeleteEntry(const HashTime &h)
+{
+  if (h.file_name.isEmpty()) {
+    // Succeeds even if the pack no longer has it, either way it's gone
+    FramePack::Get(path_)->Remove(h.hash);
+    return true;
+  } else {
+    return QFile::remove(h.file_name) || !QFileInfo::exists(h.file_name);
+  }
+}
+
+void DiskCacheFolder::InsertEntry(const HashTime &h)
+{
+  RemoveEntry(h.hash);
+
+  disk_data_.push_back(h);
+  disk_map_.insert(h.hash, std::prev(disk_data_.end()));
+
+  consumption_ += h.file_size;
+}
+
+void DiskCacheFolder::RemoveEntry(const QByteArray &hash)
+{
+  auto it = disk_map_.find(hash);
+
+  if (it != disk_map_.end()) {
+    consumption_ -= it.value()->file_size;
+    disk_data_.erase(it.value());
+    disk_map_.erase(it);
+  }
+}
+
+FramePack::Encoding DiskCacheFolder::GetEncoding() const
+{
+  return FramePack::Get(path_)->GetEncoding();
+}
+
+void DiskCacheFolder::SetEncoding(FramePack::Encoding e)
+{
+  FramePack* pack = FramePack::Get(path_);
+
+  pack->SetEncoding(e);
+  pack->SaveIndex();
+}
+
+void DiskCacheFolder::WriteJournal(JournalOp op, const HashTime &h)
+{
+  QDataStream ds(&journal_buffer_, QIODevice::WriteOnly | QIODevice::Append);
+
+  ds << static_cast<quint8>(op);
+
+  switch (op) {
+  case kJournalCreated:
+    ds << h.hash;
+    ds << h.file_name;
+    ds << h.file_size;
+    break;
+  case kJournalAccessed:
+  case kJournalDeleted:
+    ds << h.hash;
+    break;
+  case kJournalSettings:
+    ds << limit_;
+    ds << clear_on_close_;
+    break;
+  }
+
+  journal_records_++;
+}
+
+void DiskCacheFolder::CloseCacheFolder()
+{
+  if (path_.isEmpty()) {
+    return;
+  }
+
+  WaitForIndex();
+
+  if (clear_on_close_) {
+    // If we're not moving to new and we're set to clear on close, clear now or else it'll never
+    // get cleared later
+    ClearCache();
+  }
+
+  // Save current cache index
+  CompactIndex(false);
+
+  io_pool_.waitForDone();
+
+  FramePack::Get(path_)->SaveIndex();
+}
+
+void DiskCacheFolder::WaitForIndex() const
+{
+  index_load_.waitForFinished();
+}
 
-  // Try to load any current cache index from file
+void DiskCacheFolder::LoadSnapshot()
+{
   QFile cache_index_file(index_path_);
 
   if (cache_index_file.open(QFile::ReadOnly)) {
@@ -304,64 +822,181 @@ void DiskCacheFolder::SetPath(const QString &path)
       ds >> h.hash;
       ds >> h.file_size;
 
-      if (QFileInfo::exists(h.file_name)) {
-        consumption_ += h.file_size;
-        disk_data_.push_back(h);
+      if (ds.status() != QDataStream::Ok) {
+        break;
       }
+
+      InsertEntry(h);
     }
 
     cache_index_file.close();
   }
 }
 
-QByteArray DiskCacheFolder::DeleteLeastRecent()
+void DiskCacheFolder::ReplayJournal(const QString &filename)
 {
-  HashTime h = disk_data_.front();
-  disk_data_.pop_front();
+  QFile journal(filename);
+
+  if (!journal.open(QFile::ReadOnly)) {
+    return;
+  }
 
-  QFile::remove(h.file_name);
+  QDataStream ds(&journal);
 
-  consumption_ -= h.file_size;
+  while (!journal.atEnd()) {
+    quint8 op;
+    HashTime h = HashTime();
+    qint64 limit = 0;
+    bool clear_on_close = false;
 
-  return h.hash;
+    ds >> op;
+
+    switch (op) {
+    case kJournalCreated:
+      ds >> h.hash;
+      ds >> h.file_name;
+      ds >> h.file_size;
+      break;
+    case kJournalAccessed:
+    case kJournalDeleted:
+      ds >> h.hash;
+      break;
+    case kJournalSettings:
+      ds >> limit;
+      ds >> clear_on_close;
+      break;
+    default:
+      ds.setStatus(QDataStream::ReadCorruptData);
+    }
+
+    if (ds.status() != QDataStream::Ok) {
+      // A partial record at the end just means we didn't get to finish writing it
+      break;
+    }
+
+    switch (op) {
+    case kJournalCreated:
+      InsertEntry(h);
+      break;
+    case kJournalAccessed:
+    {
+      auto it = disk_map_.constFind(h.hash);
+      if (it != disk_map_.constEnd()) {
+        disk_data_.splice(disk_data_.end(), disk_data_, it.value());
+      }
+      break;
+    }
+    case kJournalDeleted:
+      RemoveEntry(h.hash);
+      break;
+    case kJournalSettings:
+      limit_ = limit;
+      clear_on_close_ = clear_on_close;
+      break;
+    }
+
+    journal_records_++;
+  }
+
+  journal.close();
 }
 
-void DiskCacheFolder::CloseCacheFolder()
+void DiskCacheFolder::CompactIndex(bool async)
 {
-  if (path_.isEmpty()) {
-    return;
+  if (compaction_.isRunning()) {
+    if (async) {
+      return;
+    }
+
+    compaction_.waitForFinished();
   }
 
-  if (clear_on_close_) {
-    // If we're not moving to new and we're set to clear on close, clear now or else it'll never
-    // get cleared later
-    ClearCache();
+  // Everything in the journal is about to be in the snapshot. It's moved aside rather than removed
+  // so it's still there if the snapshot fails to write.
+  if (QFileInfo::exists(old_journal_path_)) {
+    // Last compaction didn't finish, keep its records along with ours
+    QFile old_journal(old_journal_path_);
+    QFile journal(journal_path_);
+
+    if (old_journal.open(QFile::WriteOnly | QFile::Append) && journal.open(QFile::ReadOnly)) {
+      old_journal.write(journal.readAll());
+      journal.close();
+      QFile::remove(journal_path_);
+    }
+  } else {
+    QFile::rename(journal_path_, old_journal_path_);
   }
 
-  // Save current cache index
-  SaveDiskCacheIndex();
+  journal_buffer_.clear();
+  journal_records_ = 0;
+
+  HashList data = disk_data_;
+  QString index_path = index_path_;
+  QString old_journal_path = old_journal_path_;
+  qint64 limit = limit_;
+  bool clear_on_close = clear_on_close_;
+
+  auto write_snapshot = [data, index_path, old_journal_path, limit, clear_on_close](){
+    if (WriteSnapshot(index_path, limit, clear_on_close, data)) {
+      QFile::remove(old_journal_path);
+    }
+  };
+
+  if (async) {
+    compaction_ = QtConcurrent::run(&io_pool_, write_snapshot);
+  } else {
+    write_snapshot();
+  }
 }
 
-void DiskCacheFolder::SaveDiskCacheIndex()
+bool DiskCacheFolder::WriteSnapshot(const QString &filename, qint64 limit, bool clear_on_close, const HashList &data)
 {
-  QFile cache_index_file(index_path_);
+  QSaveFile cache_index_file(filename);
 
   if (cache_index_file.open(QFile::WriteOnly)) {
     QDataStream ds(&cache_index_file);
 
-    ds << limit_;
-    ds << clear_on_close_;
+    ds << limit;
+    ds << clear_on_close;
 
-    foreach (const HashTime& h, disk_data_) {
+    foreach (const HashTime& h, data) {
       ds << h.file_name;
       ds << h.hash;
       ds << h.file_size;
     }
 
-    cache_index_file.close();
-  } else {
-    qWarning() << "Failed to write cache index:" << index_path_;
+    if (cache_index_file.commit()) {
+      return true;
+    }
   }
+
+  qWarning() << "Failed to write cache index:" << filename;
+  return false;
+}
+
+void DiskCacheFolder::SaveDiskCacheIndex()
+{
+  WaitForIndex();
+
+  // Only what's changed since the last save is written, the full index is rewritten on the IO
+  // thread once the journal gets long
+  if (!journal_buffer_.isEmpty()) {
+    QFile journal(journal_path_);
+
+    if (journal.open(QFile::WriteOnly | QFile::Append)) {
+      journal.write(journal_buffer_);
+      journal.close();
+      journal_buffer_.clear();
+    } else {
+      qWarning() << "Failed to write cache journal:" << journal_path_;
+    }
+  }
+
+  if (journal_records_ > qMax(1024, static_cast<int>(disk_data_.size()) * kJournalCompactRatio)) {
+    CompactIndex(true);
+  }
+
+  QtConcurrent::run(&io_pool_, FramePack::Get(path_), &FramePack::SaveIndex);
 }
 
 }
@@ -21,13 +21,18 @@
 #ifndef DISKMANAGER_H
 #define DISKMANAGER_H
 
+#include <list>
+#include <QFuture>
+#include <QHash>
 #include <QMap>
 #include <QMutex>
 #include <QObject>
+#include <QThreadPool>
 #include <QTimer>
 
 #include "common/define.h"
 #include "project/project.h"
+#include "render/framepack.h"
 
 namespace olive {
 
@@ -45,52 +50,153 @@ public:
 
   void CreatedFile(const QString& file_name, const QByteArray& hash);
 
+  /**
+   * @brief Register a frame written to this folder's FramePack rather than to its own file
+   */
+  void CreatedPackedFrame(const QByteArray& hash, qint64 size);
+
   const QString& GetPath() const
   {
     return path_;
   }
 
+  /**
+   * @brief Set the folder to cache in
+   *
+   * Its index is loaded on the IO thread, anything that needs it waits for the load to finish.
+   */
   void SetPath(const QString& path);
 
   qint64 GetLimit() const
   {
+    WaitForIndex();
     return limit_;
   }
 
   bool GetClearOnClose() const
   {
+    WaitForIndex();
     return clear_on_close_;
   }
 
-  void SetLimit(qint64 l)
-  {
-    limit_ = l;
-  }
+  void SetLimit(qint64 l);
 
-  void SetClearOnClose(bool e)
-  {
-    clear_on_close_ = e;
-  }
+  void SetClearOnClose(bool e);
+
+  /**
+   * @brief How frames cached in this folder from now on are encoded, stored with its FramePack
+   */
+  FramePack::Encoding GetEncoding() const;
+
+  void SetEncoding(FramePack::Encoding e);
 
 signals:
-  void DeletedFrame(const QString& path, const QByteArray& hash);
+  /**
+   * @brief Frames were deleted from the cache, sent once per batch rather than once per frame
+   */
+  void DeletedFrames(const QString& path, const QVector<QByteArray>& hashes);
 
 private:
-  QByteArray DeleteLeastRecent();
+  struct HashTime {
+    /// Empty if this frame is stored in the folder's FramePack
+    QString file_name;
+    QByteArray hash;
+    qint64 file_size;
+  };
+
+  using HashList = std::list<HashTime>;
+
+  enum JournalOp {
+    kJournalCreated,
+    kJournalAccessed,
+    kJournalDeleted,
+    kJournalSettings
+  };
+
+  /**
+   * @brief Delete least recently used frames until we're comfortably under the limit
+   *
+   * Frames are removed in batches rather than one per new frame so eviction isn't constantly
+   * running once the cache fills up. Files are deleted on the IO thread.
+   */
+  void DeleteLeastRecent();
+
+  /**
+   * @brief Delete a cached frame from disk, whether it's packed or in its own file
+   */
+  bool DeleteEntry(const HashTime& h);
+
+  /**
+   * @brief Insert or replace an entry as the most recently used
+   */
+  void InsertEntry(const HashTime& h);
+
+  void RemoveEntry(const QByteArray& hash);
+
+  /**
+   * @brief Record a change to the index, written to the journal on the next save
+   */
+  void WriteJournal(JournalOp op, const HashTime& h);
 
   void CloseCacheFolder();
 
+  /**
+   * @brief Load the index of the current path and drop entries that are no longer on disk
+   *
+   * Runs on the IO thread, large caches can take seconds to check.
+   */
+  void LoadIndex();
+
+  /**
+   * @brief Block until the index started loading by SetPath() is ready
+   */
+  void WaitForIndex() const;
+
+  void LoadSnapshot();
+
+  void ReplayJournal(const QString& filename);
+
+  /**
+   * @brief Rewrite the whole index and discard the journal
+   *
+   * If `async` is TRUE, the index is written on the IO thread.
+   */
+  void CompactIndex(bool async);
+
+  static bool WriteSnapshot(const QString& filename, qint64 limit, bool clear_on_close, const HashList& data);
+
+  /**
+   * @brief Number of journal records after which the index is compacted, as a multiple of the
+   * number of entries
+   */
+  static const int kJournalCompactRatio;
+
+  /**
+   * @brief Fraction of the limit to free when eviction runs
+   */
+  static const int kEvictionHeadroomDivider;
+
   QString path_;
 
   QString index_path_;
 
-  struct HashTime {
-    QString file_name;
-    QByteArray hash;
-    qint64 file_size;
-  };
+  QString journal_path_;
+
+  QString old_journal_path_;
+
+  /**
+   * @brief Cached frames ordered from least to most recently used
+   */
+  HashList disk_data_;
+
+  QHash<QByteArray, HashList::iterator> disk_map_;
+
+  /**
+   * @brief Journal records not yet appended to the journal file
+   */
+  QByteArray journal_buffer_;
 
-  std::list<HashTime> disk_data_;
+  int journal_records_;
 
   qint64 consumption_;
 
@@ -100,6 +206,15 @@ private:
 
   QTimer save_timer_;
 
+  /**
+   * @brief Single thread for file deletion and index compaction so they don't stall the UI
+   */
+  QThreadPool io_pool_;
+
+  QFuture<void> compaction_;
+
+  mutable QFuture<void> index_load_;
+
 private slots:
   void SaveDiskCacheIndex();
 
@@ -144,13 +259,62 @@ public:
   void ShowDiskCacheSettingsDialog(DiskCacheFolder* folder, QWidget* parent);
   void ShowDiskCacheSettingsDialog(const QString& path, QWidget* parent);
 
+  /**
+   * @brief Returns the folders frames cached in `cache_path` are striped across
+   *
+   * The first is always `cache_path` itself, which also holds the hash maps and anything that
+   * isn't a frame. A cache that isn't striped returns just `cache_path`. Each folder is a
+   * DiskCacheFolder in its own right with its own limit and LRU.
+   *
+   * This function is thread-safe.
+   */
+  QStringList GetStripePaths(const QString& cache_path);
+
+  /**
+   * @brief Stripe frames cached in `cache_path` across these extra folders too
+   *
+   * Frames already cached stay where they are and are still found. The list is stored in
+   * `cache_path` so it applies whenever that cache is used.
+   */
+  void SetStripePaths(const QString& cache_path, const QStringList& extra_folders);
+
+  /**
+   * @brief Returns the folder a new frame with this hash should be written to
+   *
+   * Frames are spread by weighted rendezvous hashing, each folder taking a share proportional to
+   * its limit, so adding or removing a drive only moves the frames that belong to it. Folders
+   * that are nearly out of space or much slower than the others are skipped until they recover.
+   *
+   * This function is thread-safe.
+   */
+  QString GetStripeForWrite(const QString& cache_path, const QByteArray& hash);
+
+  /**
+   * @brief Returns the folders this frame may be cached in, the one it most likely is in first
+   *
+   * This function is thread-safe.
+   */
+  QStringList GetStripesForRead(const QString& cache_path, const QByteArray& hash);
+
+  /**
+   * @brief Report a finished write so drives that fall behind can have writes moved off them
+   *
+   * This function is thread-safe.
+   */
+  void RecordStripeWrite(const QString& stripe, qint64 bytes, qint64 nsecs);
+
 public slots:
   void Accessed(const QString& cache_folder, const QByteArray& hash);
 
   void CreatedFile(const QString& cache_folder, const QString& file_name, const QByteArray& hash);
 
+  void CreatedPackedFrame(const QString& cache_folder, const QByteArray& hash, qint64 size);
+
 signals:
-  void DeletedFrame(const QString& path, const QByteArray& hash);
+  /**
+   * @brief Frames were deleted from the cache, sent once per batch rather than once per frame
+   */
+  void DeletedFrames(const QString& path, const QVector<QByteArray>& hashes);
 
   void InvalidateProject(Project* p);
 
@@ -159,10 +323,64 @@ private:
 
   virtual ~DiskManager() override;
 
+  struct Stripe {
+    QString path;
+
+    /// The folder's limit in bytes, its share of frames is proportional to it
+    qint64 weight;
+
+    /// Moving average of bytes written per millisecond, 0 if nothing has been written yet
+    double write_rate;
+
+    /// Too full or too slow to take new frames
+    bool degraded;
+  };
+
+  /**
+   * @brief Returns the stripe set of `cache_path`, loading it from disk the first time
+   *
+   * `stripe_lock_` must be held.
+   */
+  QVector<Stripe>& GetStripeSet(const QString& cache_path);
+
+  /**
+   * @brief Returns the stripes of `set` ordered by how strongly this hash belongs to them
+   */
+  static QVector<const Stripe*> RankStripes(const QVector<Stripe>& set, const QByteArray& hash);
+
+  static QString GetStripeListFilename(const QString& cache_path);
+
+  /**
+   * @brief Milliseconds between checks of each stripe's free space and write rate
+   */
+  static const int kStripeHealthInterval;
+
+  /**
+   * @brief Free space a drive must keep to be written to
+   */
+  static const qint64 kStripeMinimumFreeSpace;
+
+  /**
+   * @brief How many times slower than the fastest stripe a stripe can be before it's skipped
+   */
+  static const int kStripeSlowRatio;
+
   static DiskManager* instance_;
 
   QVector<DiskCacheFolder*> open_folders_;
 
+  QHash<QString, QVector<Stripe> > stripe_sets_;
+
+  QMutex stripe_lock_;
+
+  QTimer stripe_health_timer_;
+
+private slots:
+  /**
+   * @brief Update each stripe's weight and take drives that are full or slow out of rotation
+   */
+  void UpdateStripeHealth();
+
 };
 
 }
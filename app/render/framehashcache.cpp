@@ -20,32 +20,103 @@
 
 #include "framehashcache.h"
 
+#include <algorithm>
 #include <OpenEXR/ImfFloatAttribute.h>
 #include <OpenEXR/ImfInputFile.h>
 #include <OpenEXR/ImfOutputFile.h>
 #include <OpenEXR/ImfChannelList.h>
+#include <QDataStream>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFileInfo>
+#include <QSaveFile>
 
 #include "codec/frame.h"
 #include "common/filefunctions.h"
 #include "common/timecodefunctions.h"
 #include "render/diskmanager.h"
+#include "render/framememorycache.h"
+#include "render/framepack.h"
+#include "render/rendermanager.h"
 
 namespace olive {
 
+const quint32 FrameHashCache::kHashMapMagic = 0x4F484D50; // "OHMP"
+const quint32 FrameHashCache::kHashMapVersion = 1;
+
 FrameHashCache::FrameHashCache(QObject *parent) :
-  PlaybackCache(parent)
+  PlaybackCache(parent),
+  memory_(MemoryAccounting::kFrameHashes)
 {
   if (DiskManager::instance()) {
-    connect(DiskManager::instance(), &DiskManager::DeletedFrame, this, &FrameHashCache::HashDeleted);
+    connect(DiskManager::instance(), &DiskManager::DeletedFrames, this, &FrameHashCache::HashesDeleted);
     connect(DiskManager::instance(), &DiskManager::InvalidateProject, this, &FrameHashCache::ProjectInvalidated);
   }
 }
 
+void FrameHashCache::SetRenderCost(const QByteArray &hash, qint64 total, qint64 decode)
+{
+  render_costs_.insert(hash, {total, decode, -1});
+
+  UpdateMemoryUsage();
+}
+
+void FrameHashCache::SetMeasuredGPUTime(const QByteArray &hash, qint64 ns)
+{
+  auto it = render_costs_.find(hash);
+
+  if (it != render_costs_.end()) {
+    it->gpu_measured = ns;
+  }
+}
+
+QVector<QPair<TimeRange, FrameHashCache::RenderCost> > FrameHashCache::GetRenderCosts(const TimeRange &range) const
+{
+  QVector<QPair<TimeRange, RenderCost> > costs;
+
+  if (render_costs_.isEmpty()) {
+    return costs;
+  }
+
+  // Start from the run containing the start of the range
+  auto it = hash_runs_.upperBound(range.in());
+
+  if (it != hash_runs_.begin()) {
+    it--;
+  }
+
+  for (; it!=hash_runs_.constEnd() && it.key() < range.out(); it++) {
+    auto cost = render_costs_.constFind(it.value().hash);
+
+    if (cost != render_costs_.constEnd() && it.value().out > range.in()) {
+      costs.append({TimeRange(it.key(), it.value().out), cost.value()});
+    }
+  }
+
+  return costs;
+}
+
 QByteArray FrameHashCache::GetHash(const rational &time)
 {
-  return time_hash_map_.value(time);
+  auto it = hash_runs_.upperBound(time);
+
+  if (it == hash_runs_.begin()) {
+    return QByteArray();
+  }
+
+  it--;
+
+  if (time < it.value().out) {
+    if (!unverified_.isEmpty()
+        && unverified_.contains(TimeRange(time, time), true, false)
+        && !VerifyRestoredHash(time, it.value().hash)) {
+      return QByteArray();
+    }
+
+    return it.value().hash;
+  }
+
+  return QByteArray();
 }
 
 void FrameHashCache::SetHash(const rational &time, const QByteArray &hash, const qint64& job_time, bool frame_exists)
@@ -60,7 +131,7 @@ void FrameHashCache::SetHash(const rational &time, const QByteArray &hash, const
     }
   }
 
-  time_hash_map_.insert(time, hash);
+  InsertRun(TimeRange(time, time + timebase_), hash);
 
   TimeRange validated_range;
   if (frame_exists) {
@@ -69,6 +140,27 @@ void FrameHashCache::SetHash(const rational &time, const QByteArray &hash, const
   }
 }
 
+void FrameHashCache::SetHashRange(const TimeRange &range, const QByteArray &hash, const qint64 &job_time, bool frame_exists)
+{
+  // Leave out any part of the range that has changed since this hash was generated
+  TimeRangeList accepted;
+  accepted.insert(range);
+
+  foreach (const JobIdentifier& job, jobs_) {
+    if (job_time < job.job_time) {
+      accepted.remove(job.range);
+    }
+  }
+
+  foreach (const TimeRange& r, accepted) {
+    InsertRun(SnapRangeToFrames(r), hash);
+
+    if (frame_exists) {
+      Validate(r);
+    }
+  }
+}
+
 void FrameHashCache::SetTimebase(const rational &tb)
 {
   timebase_ = tb;
@@ -76,26 +168,34 @@ void FrameHashCache::SetTimebase(const rational &tb)
 
 void FrameHashCache::ValidateFramesWithHash(const QByteArray &hash)
 {
-  const TimeRangeList& invalidated_ranges = GetInvalidatedRanges();
+  ValidateFramesWithHashes({hash});
+}
 
-  for (auto iterator=time_hash_map_.begin();iterator!=time_hash_map_.end();iterator++) {
-    if (iterator.value() == hash) {
-      TimeRange frame_range(iterator.key(), iterator.key() + timebase_);
+void FrameHashCache::ValidateFramesWithHashes(const QVector<QByteArray> &hashes)
+{
+  TimeRangeList to_validate;
 
-      if (invalidated_ranges.contains(frame_range)) {
-        Validate(frame_range);
+  foreach (const QByteArray& hash, hashes) {
+    foreach (const TimeRange& run_range, GetRunsWithHash(hash)) {
+      foreach (const TimeRange& r, GetInvalidatedRanges().Intersects(run_range)) {
+        to_validate.insert(r);
       }
     }
   }
+
+  // Validating modifies the invalidated ranges so we do it after iterating them
+  foreach (const TimeRange& r, to_validate) {
+    Validate(r);
+  }
 }
 
 QList<rational> FrameHashCache::GetFramesWithHash(const QByteArray &hash)
 {
   QList<rational> times;
 
-  for (auto iterator=time_hash_map_.begin();iterator!=time_hash_map_.end();iterator++) {
-    if (iterator.value() == hash) {
-      times.append(iterator.key());
+  foreach (const TimeRange& run_range, GetRunsWithHash(hash)) {
+    foreach (const rational& r, GetFrameListFromTimeRange({run_range})) {
+      times.append(r);
     }
   }
 
@@ -105,34 +205,234 @@ QList<rational> FrameHashCache::GetFramesWithHash(const QByteArray &hash)
 QList<rational> FrameHashCache::TakeFramesWithHash(const QByteArray &hash)
 {
   QList<rational> times;
+  TimeRangeList ranges;
 
-  auto iterator = time_hash_map_.begin();
+  foreach (const TimeRange& run_range, GetRunsWithHash(hash)) {
+    foreach (const rational& r, GetFrameListFromTimeRange({run_range})) {
+      times.append(r);
+    }
 
-  while (iterator != time_hash_map_.end()) {
-    if (iterator.value() == hash) {
-      times.append(iterator.key());
+    ranges.insert(run_range);
 
-      iterator = time_hash_map_.erase(iterator);
-    } else {
-      iterator++;
-    }
+    EraseRun(hash_runs_.find(run_range.in()));
   }
 
-  foreach (const rational& r, times) {
-    Invalidate(TimeRange(r, r + timebase_));
+  foreach (const TimeRange& r, ranges) {
+    Invalidate(r);
   }
 
   return times;
 }
 
-QMap<rational, QByteArray> FrameHashCache::time_hash_map()
+QString FrameHashCache::GetFormatExtension()
 {
-  return time_hash_map_;
+  return QStringLiteral(".exr");
 }
 
-QString FrameHashCache::GetFormatExtension()
+QString FrameHashCache::GetHashMapFilename(const QString &cache_path, const QUuid &uuid)
 {
-  return QStringLiteral(".exr");
+  return QDir(QDir(cache_path).filePath(QStringLiteral("hashmaps"))).filePath(uuid.toString() + QStringLiteral(".map"));
+}
+
+bool FrameHashCache::SaveHashMap(const QUuid &uuid) const
+{
+  QString cache_dir = GetCacheDirectory();
+
+  if (cache_dir.isEmpty() || timebase_.isNull()) {
+    return false;
+  }
+
+  QString filename = GetHashMapFilename(cache_dir, uuid);
+
+  if (hash_runs_.isEmpty()) {
+    // Nothing worth restoring, don't leave an old map behind either
+    QFile::remove(filename);
+    return true;
+  }
+
+  if (!FileFunctions::DirectoryIsValid(QFileInfo(filename).path(), true)) {
+    return false;
+  }
+
+  QSaveFile file(filename);
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to open" << filename << "for writing";
+    return false;
+  }
+
+  QDataStream stream(&file);
+
+  // Each distinct hash is only written once, runs refer to them by index
+  QVector<QByteArray> hash_table;
+  QHash<QByteArray, quint32> hash_index;
+
+  for (auto it=hash_runs_.cbegin(); it!=hash_runs_.cend(); it++) {
+    if (!hash_index.contains(it.value().hash)) {
+      hash_index.insert(it.value().hash, hash_table.size());
+      hash_table.append(it.value().hash);
+    }
+  }
+
+  stream << kHashMapMagic << kHashMapVersion;
+  stream << static_cast<qint64>(timebase_.numerator()) << static_cast<qint64>(timebase_.denominator());
+
+  stream << static_cast<quint32>(hash_table.size());
+  foreach (const QByteArray& hash, hash_table) {
+    stream << hash;
+  }
+
+  stream << static_cast<quint32>(hash_runs_.size());
+  for (auto it=hash_runs_.cbegin(); it!=hash_runs_.cend(); it++) {
+    qint64 in = Timecode::time_to_timestamp(it.key(), timebase_);
+    qint64 out = Timecode::time_to_timestamp(it.value().out, timebase_);
+
+    stream << in << static_cast<qint64>(out - in) << hash_index.value(it.value().hash);
+  }
+
+  if (stream.status() != QDataStream::Ok || !file.commit()) {
+    qWarning() << "Failed to write hash map" << filename;
+    return false;
+  }
+
+  return true;
+}
+
+bool FrameHashCache::LoadHashMap(const QUuid &uuid)
+{
+  QString cache_dir = GetCacheDirectory();
+
+  if (cache_dir.isEmpty() || timebase_.isNull()) {
+    return false;
+  }
+
+  QFile file(GetHashMapFilename(cache_dir, uuid));
+
+  if (!file.open(QFile::ReadOnly)) {
+    // Not an error, it just hasn't been saved yet
+    return false;
+  }
+
+  QDataStream stream(&file);
+
+  quint32 magic, version;
+  stream >> magic >> version;
+
+  if (magic != kHashMapMagic || version != kHashMapVersion) {
+    return false;
+  }
+
+  qint64 tb_num, tb_den;
+  stream >> tb_num >> tb_den;
+
+  if (rational(tb_num, tb_den) != timebase_) {
+    // Every run would land on the wrong frames
+    return false;
+  }
+
+  quint32 hash_count;
+  stream >> hash_count;
+
+  QVector<QByteArray> hash_table(hash_count);
+  QVector<bool> hash_on_disk(hash_count);
+
+  for (quint32 i=0; i<hash_count && stream.status() == QDataStream::Ok; i++) {
+    stream >> hash_table[i];
+
+    // One lookup per distinct hash rather than per frame
+    hash_on_disk[i] = HasCacheFrame(hash_table.at(i));
+  }
+
+  quint32 run_count;
+  stream >> run_count;
+
+  if (stream.status() != QDataStream::Ok) {
+    return false;
+  }
+
+  TimeRange limit(rational(), GetLength());
+  TimeRangeList restored;
+
+  for (quint32 i=0; i<run_count; i++) {
+    qint64 in, length;
+    quint32 index;
+
+    stream >> in >> length >> index;
+
+    if (stream.status() != QDataStream::Ok) {
+      break;
+    }
+
+    if (index >= hash_count || length <= 0 || !hash_on_disk.at(index)) {
+      continue;
+    }
+
+    TimeRange range(Timecode::timestamp_to_time(in, timebase_),
+                    Timecode::timestamp_to_time(in + length, timebase_));
+
+    // Only fill in what's still invalidated and within the sequence
+    foreach (const TimeRange& r, GetInvalidatedRanges().Intersects(range)) {
+      if (r.in() >= limit.out()) {
+        continue;
+      }
+
+      TimeRange clamped(r.in(), qMin(r.out(), limit.out()));
+
+      InsertRun(SnapRangeToFrames(clamped), hash_table.at(index));
+      restored.insert(clamped);
+    }
+  }
+
+  foreach (const TimeRange& r, restored) {
+    unverified_.insert(r);
+    Validate(r);
+  }
+
+  return !restored.isEmpty();
+}
+
+bool FrameHashCache::VerifyRestoredHash(const rational &time, const QByteArray &hash)
+{
+  rational frame_time = Timecode::snap_time_to_timebase(time, timebase_);
+  if (frame_time > time) {
+    frame_time -= timebase_;
+  }
+
+  unverified_.remove(TimeRange(frame_time, frame_time + timebase_));
+
+  ViewerOutput* viewer = static_cast<ViewerOutput*>(parent());
+  if (!viewer) {
+    return true;
+  }
+
+  QByteArray current = RenderManager::Hash(viewer->texture_input()->get_connected_node(),
+                                           viewer->video_params(), frame_time);
+
+  if (current == hash) {
+    return true;
+  }
+
+  // The graph changed since the map was saved so the rest of this run can't be trusted either.
+  // The run is removed now so we stop handing out its hash, but invalidation is queued so whoever
+  // is asking isn't re-entered from its own GetHash() call.
+  auto it = hash_runs_.upperBound(frame_time);
+  if (it == hash_runs_.begin()) {
+    return false;
+  }
+  it--;
+
+  TimeRange stale(it.key(), it.value().out);
+
+  foreach (const TimeRange& r, unverified_.Intersects(stale)) {
+    stale = TimeRange(qMin(stale.in(), r.in()), qMax(stale.out(), r.out()));
+  }
+
+  unverified_.remove(stale);
+  RemoveRange(stale);
+
+  QMetaObject::invokeMethod(this, "Invalidate", Qt::QueuedConnection, OLIVE_NS_ARG(TimeRange, stale));
+
+  return false;
 }
 
 QVector<rational> FrameHashCache::GetFrameListFromTimeRange(TimeRangeList range_list, const rational &timebase)
@@ -183,16 +483,28 @@ bool FrameHashCache::SaveCacheFrame(const QByteArray& hash,
                                     const VideoParams& vparam,
                                     int linesize_bytes) const
 {
-  QString fn = CachePathName(hash);
+  if (!VideoParams::FormatIsFloat(vparam.format())) {
+    qCritical() << "Tried to cache frame with non-float pixel format";
+    return false;
+  }
+
+  QString stripe = DiskManager::instance()->GetStripeForWrite(GetCacheDirectory(), hash);
+
+  QElapsedTimer write_timer;
+  write_timer.start();
+
+  qint64 size = FramePack::Get(stripe)->Write(hash, data, vparam, linesize_bytes);
+
+  if (size > 0) {
+    DiskManager::instance()->RecordStripeWrite(stripe, size, write_timer.nsecsElapsed());
 
-  if (SaveCacheFrame(fn, data, vparam, linesize_bytes)) {
     // Register frame with the disk manager
     QMetaObject::invokeMethod(DiskManager::instance(),
-                              "CreatedFile",
+                              "CreatedPackedFrame",
                               Qt::QueuedConnection,
-                              Q_ARG(QString, GetCacheDirectory()),
-                              Q_ARG(QString, fn),
-                              Q_ARG(QByteArray, hash));
+                              Q_ARG(QString, stripe),
+                              Q_ARG(QByteArray, hash),
+                              Q_ARG(qint64, size));
 
     return true;
   } else {
@@ -202,7 +514,10 @@ bool FrameHashCache::SaveCacheFrame(const QByteArray& hash,
 
 bool FrameHashCache::SaveCacheFrame(const QByteArray &hash, FramePtr frame) const
 {
-  if (frame) {
+  if (frame && frame->is_partial()) {
+    qWarning() << "Refusing to cache a partially rendered frame";
+    return false;
+  } else if (frame) {
     return SaveCacheFrame(hash, frame->data(), frame->video_params(), frame->linesize_bytes());
   } else {
     qWarning() << "Attempted to save a NULL frame to the cache. This may or may not be desirable.";
@@ -212,12 +527,61 @@ bool FrameHashCache::SaveCacheFrame(const QByteArray &hash, FramePtr frame) cons
 
 FramePtr FrameHashCache::LoadCacheFrame(const QString &cache_path, const QByteArray &hash)
 {
-  return LoadCacheFrame(CachePathName(cache_path, hash));
+  FramePtr frame = FrameMemoryCache::instance()->Get(hash);
+
+  if (frame) {
+    return frame;
+  }
+
+  // Each stripe has its own pack, so frames on different drives are read in parallel by
+  // whichever workers ask for them
+  foreach (const QString& stripe, DiskManager::instance()->GetStripesForRead(cache_path, hash)) {
+    frame = FramePack::Get(stripe)->Read(hash);
+
+    if (frame) {
+      QMetaObject::invokeMethod(DiskManager::instance(),
+                                "Accessed",
+                                Qt::QueuedConnection,
+                                Q_ARG(QString, stripe),
+                                Q_ARG(QByteArray, hash));
+      break;
+    }
+  }
+
+  if (!frame) {
+    // Fall back to frames cached as individual files
+    frame = LoadCacheFrame(CachePathName(cache_path, hash));
+  }
+
+  // Keep it in memory in case it's needed again soon (e.g. looping playback)
+  FrameMemoryCache::instance()->Insert(hash, frame);
+
+  return frame;
 }
 
 FramePtr FrameHashCache::LoadCacheFrame(const QByteArray &hash) const
 {
-  return LoadCacheFrame(CachePathName(hash));
+  return LoadCacheFrame(GetCacheDirectory(), hash);
+}
+
+bool FrameHashCache::HasCacheFrame(const QByteArray &hash) const
+{
+  return HasCacheFrame(GetCacheDirectory(), hash);
+}
+
+bool FrameHashCache::HasCacheFrame(const QString &cache_path, const QByteArray &hash)
+{
+  if (FrameMemoryCache::instance()->Contains(hash)) {
+    return true;
+  }
+
+  foreach (const QString& stripe, DiskManager::instance()->GetStripesForRead(cache_path, hash)) {
+    if (FramePack::Get(stripe)->Contains(hash)) {
+      return true;
+    }
+  }
+
+  return QFileInfo::exists(CachePathName(cache_path, hash));
 }
 
 FramePtr FrameHashCache::LoadCacheFrame(const QString &fn)
@@ -273,80 +637,226 @@ FramePtr FrameHashCache::LoadCacheFrame(const QString &fn)
 
 void FrameHashCache::LengthChangedEvent(const rational &old, const rational &newlen)
 {
-  if (newlen < old) {
-    auto i = time_hash_map_.begin();
-
-    while (i != time_hash_map_.end()) {
-      if (i.key() >= newlen) {
-        i = time_hash_map_.erase(i);
-      } else {
-        i++;
-      }
-    }
+  if (newlen < old && !hash_runs_.isEmpty()) {
+    RemoveRange(TimeRange(newlen, qMax(old, hash_runs_.last().out)));
   }
 }
 
-struct HashTimePair {
-  rational time;
-  QByteArray hash;
-};
-
 void FrameHashCache::ShiftEvent(const rational &from, const rational &to)
 {
-  auto i = time_hash_map_.begin();
-
   // POSITIVE if moving forward ->
   // NEGATIVE if moving backward <-
   rational diff = to - from;
-  bool diff_is_negative = (diff < rational());
 
-  QList<HashTimePair> shifted_times;
+  if (diff < rational()) {
+    // These times will be removed in the shift so we just discard them
+    RemoveRange(TimeRange(to, from));
+    unverified_.remove(TimeRange(to, from));
+  }
 
-  while (i != time_hash_map_.end()) {
-    if (diff_is_negative && i.key() >= to && i.key() < from) {
+  if (!unverified_.isEmpty()) {
+    TimeRangeList moved = unverified_.Intersects(TimeRange(from, RATIONAL_MAX));
+    unverified_.remove(TimeRange(from, RATIONAL_MAX));
+    moved.shift(diff);
 
-      // This time will be removed in the shift so we just discard it
-      i = time_hash_map_.erase(i);
+    foreach (const TimeRange& r, moved) {
+      unverified_.insert(r);
+    }
+  }
 
-    } else if (i.key() >= from) {
+  // Make sure no run straddles the shift point so everything after it moves as a unit
+  SplitAt(from);
 
-      // This time is after the from time and must be shifted
-      shifted_times.append({i.key() + diff, i.value()});
-      i = time_hash_map_.erase(i);
+  // Only runs are moved, not frames, so this scales with the number of edits after `from`
+  QList< QPair<rational, HashRun> > shifted_runs;
 
-    } else {
+  auto i = hash_runs_.lowerBound(from);
 
-      // Do nothing
-      i++;
+  while (i != hash_runs_.end()) {
+    HashRun run = i.value();
+    run.out += diff;
+    shifted_runs.append({i.key() + diff, run});
+    i = EraseRun(i);
+  }
 
-    }
+  for (int j=0; j<shifted_runs.size(); j++) {
+    AddRun(shifted_runs.at(j).first, shifted_runs.at(j).second);
   }
 
-  foreach (const HashTimePair& p, shifted_times) {
-    time_hash_map_.insert(p.time, p.hash);
+  if (!shifted_runs.isEmpty()) {
+    MergeAt(shifted_runs.first().first);
   }
 }
 
 void FrameHashCache::InvalidateEvent(const TimeRange &range)
 {
-  QVector<rational> invalid_frames = GetFrameListFromTimeRange({range});
+  unverified_.remove(range);
+
+  RemoveRange(SnapRangeToFrames(range));
+}
+
+TimeRange FrameHashCache::SnapRangeToFrames(const TimeRange &range) const
+{
+  rational in = Timecode::snap_time_to_timebase(range.in(), timebase_);
+  if (in > range.in()) {
+    in -= timebase_;
+  }
+
+  rational out = Timecode::snap_time_to_timebase(range.out(), timebase_);
+  if (out < range.out()) {
+    out += timebase_;
+  }
+
+  return TimeRange(in, out);
+}
+
+void FrameHashCache::InsertRun(const TimeRange &range, const QByteArray &hash)
+{
+  if (range.in() >= range.out()) {
+    return;
+  }
+
+  RemoveRange(range);
+
+  AddRun(range.in(), {range.out(), hash});
+
+  // Merge with the run that follows first since merging backwards may remove this key
+  MergeAt(range.out());
+  MergeAt(range.in());
+}
+
+void FrameHashCache::RemoveRange(const TimeRange &range)
+{
+  if (range.in() >= range.out()) {
+    return;
+  }
+
+  SplitAt(range.in());
+  SplitAt(range.out());
+
+  auto i = hash_runs_.lowerBound(range.in());
+
+  while (i != hash_runs_.end() && i.key() < range.out()) {
+    i = EraseRun(i);
+  }
+}
+
+void FrameHashCache::SplitAt(const rational &time)
+{
+  auto i = hash_runs_.upperBound(time);
+
+  if (i == hash_runs_.begin()) {
+    return;
+  }
+
+  i--;
+
+  if (i.key() < time && time < i.value().out) {
+    HashRun tail = i.value();
+    i.value().out = time;
+    AddRun(time, tail);
+  }
+}
+
+void FrameHashCache::AddRun(const rational &in, const HashRun &run)
+{
+  auto existing = hash_runs_.find(in);
+
+  if (existing != hash_runs_.end()) {
+    UnindexRun(in, existing.value().hash);
+  }
+
+  hash_runs_.insert(in, run);
+  runs_by_hash_[run.hash].insert(in);
+
+  UpdateMemoryUsage();
+}
+
+QMap<rational, FrameHashCache::HashRun>::iterator FrameHashCache::EraseRun(QMap<rational, HashRun>::iterator it)
+{
+  UnindexRun(it.key(), it.value().hash);
+
+  it = hash_runs_.erase(it);
+
+  UpdateMemoryUsage();
+
+  return it;
+}
+
+void FrameHashCache::UnindexRun(const rational &in, const QByteArray &hash)
+{
+  auto runs = runs_by_hash_.find(hash);
+
+  if (runs != runs_by_hash_.end()) {
+    runs.value().remove(in);
+
+    if (runs.value().isEmpty()) {
+      runs_by_hash_.erase(runs);
+    }
+  }
+}
+
+void FrameHashCache::UpdateMemoryUsage()
+{
+  // Hashes are implicitly shared between the maps, so each distinct one is only counted once
+  static const qint64 kHashBytes = 16; // Node::kHashAlgorithm is MD5
+  static const qint64 kNodeBytes = 2 * sizeof(void*);
+
+  qint64 runs = hash_runs_.size() * (sizeof(rational) + sizeof(HashRun) + kNodeBytes   // hash_runs_
+                                     + sizeof(rational) + kNodeBytes);                   // runs_by_hash_ sets
+
+  qint64 hashes = runs_by_hash_.size() * (sizeof(QByteArray) + sizeof(QSet<rational>) + kNodeBytes + kHashBytes)
+      + render_costs_.size() * (sizeof(QByteArray) + sizeof(RenderCost) + kNodeBytes);
+
+  memory_.Set(runs + hashes);
+}
+
+QVector<TimeRange> FrameHashCache::GetRunsWithHash(const QByteArray &hash) const
+{
+  QVector<TimeRange> ranges;
+
+  QList<rational> starts = runs_by_hash_.value(hash).values();
+  std::sort(starts.begin(), starts.end());
 
-  foreach (const rational& r, invalid_frames) {
-    time_hash_map_.remove(r);
+  foreach (const rational& in, starts) {
+    ranges.append(TimeRange(in, hash_runs_.value(in).out));
   }
+
+  return ranges;
 }
 
-void FrameHashCache::HashDeleted(const QString& s, const QByteArray &hash)
+void FrameHashCache::MergeAt(const rational &time)
+{
+  auto i = hash_runs_.find(time);
+
+  if (i == hash_runs_.end() || i == hash_runs_.begin()) {
+    return;
+  }
+
+  auto prev = i;
+  prev--;
+
+  if (prev.value().out == time && prev.value().hash == i.value().hash) {
+    prev.value().out = i.value().out;
+    EraseRun(i);
+  }
+}
+
+void FrameHashCache::HashesDeleted(const QString& s, const QVector<QByteArray> &hashes)
 {
   QString cache_dir = GetCacheDirectory();
-  if (cache_dir.isEmpty() || s != cache_dir) {
+  if (cache_dir.isEmpty() || !DiskManager::instance()->GetStripePaths(cache_dir).contains(s)) {
     return;
   }
 
   TimeRangeList ranges_to_invalidate;
-  for (auto i=time_hash_map_.constBegin(); i!=time_hash_map_.constEnd(); i++) {
-    if (i.value() == hash) {
-      ranges_to_invalidate.insert(TimeRange(i.key(), i.key() + timebase_));
+
+  foreach (const QByteArray& hash, hashes) {
+    render_costs_.remove(hash);
+    UpdateMemoryUsage();
+
+    foreach (const TimeRange& range, GetRunsWithHash(hash)) {
+      ranges_to_invalidate.insert(range);
     }
   }
 
@@ -358,7 +868,11 @@ void FrameHashCache::HashDeleted(const QString& s, const QByteArray &hash)
 void FrameHashCache::ProjectInvalidated(Project *p)
 {
   if (GetProject() == p) {
-    time_hash_map_.clear();
+    hash_runs_.clear();
+    runs_by_hash_.clear();
+    render_costs_.clear();
+    unverified_.clear();
+    UpdateMemoryUsage();
 
     InvalidateAll();
   }
@@ -388,7 +902,7 @@ QString FrameHashCache::CachePathName(const QString &cache_path, const QByteArra
   return cache_dir.filePath(filename);
 }
 
-bool FrameHashCache::SaveCacheFrame(const QString &filename, char *data, const VideoParams &vparam, int linesize_bytes) const
+bool FrameHashCache::SaveCacheFrame(const QString &filename, char *data, const VideoParams &vparam, int linesize_bytes)
 {
   if (!VideoParams::FormatIsFloat(vparam.format())) {
     qCritical() << "Tried to cache frame with non-float pixel format";
@@ -21,8 +21,13 @@
 #ifndef VIDEORENDERFRAMECACHE_H
 #define VIDEORENDERFRAMECACHE_H
 
+#include <QHash>
 #include <QMutex>
+#include <QPair>
+#include <QSet>
+#include <QUuid>
 
+#include "common/memoryaccounting.h"
 #include "common/rational.h"
 #include "common/timerange.h"
 #include "codec/frame.h"
@@ -41,8 +46,57 @@ public:
 
   void SetTimebase(const rational& tb);
 
+  const rational& GetTimebase() const
+  {
+    return timebase_;
+  }
+
   void ValidateFramesWithHash(const QByteArray& hash);
 
+  /**
+   * @brief Validate every frame with any of these hashes
+   *
+   * The ranges are merged before validating so neighbouring frames only emit Validated() once.
+   */
+  void ValidateFramesWithHashes(const QVector<QByteArray>& hashes);
+
+  /**
+   * @brief How long it took to render a frame, in nanoseconds
+   */
+  struct RenderCost {
+    qint64 total;
+    qint64 decode;
+
+    /// Time the GPU spent on the frame's shader passes, -1 if they weren't timed
+    qint64 gpu_measured;
+
+    /// The measured GPU time if there is one, otherwise everything that wasn't waiting on footage
+    qint64 gpu() const
+    {
+      return (gpu_measured >= 0) ? gpu_measured : total - decode;
+    }
+  };
+
+  /**
+   * @brief Record how long the frame with this hash took to render
+   */
+  void SetRenderCost(const QByteArray& hash, qint64 total, qint64 decode);
+
+  /**
+   * @brief Record how long the GPU spent on the frame with this hash
+   *
+   * GPU timings arrive after the frame finished, so this updates a cost SetRenderCost() already
+   * recorded and does nothing if there isn't one.
+   */
+  void SetMeasuredGPUTime(const QByteArray& hash, qint64 ns);
+
+  /**
+   * @brief Returns the recorded cost of every run of frames intersecting `range` that has one
+   *
+   * Frames that haven't been rendered since they last changed have no cost.
+   */
+  QVector<QPair<TimeRange, RenderCost> > GetRenderCosts(const TimeRange& range) const;
+
   /**
    * @brief Returns a list of frames that use a particular hash
    */
@@ -53,23 +107,58 @@ public:
    */
   QList<rational> TakeFramesWithHash(const QByteArray& hash);
 
-  QMap<rational, QByteArray> time_hash_map();
+  /**
+   * @brief Returns the number of runs of identical hashes currently stored
+   */
+  int GetRunCount() const
+  {
+    return hash_runs_.size();
+  }
 
   /**
    * @brief Return the path of the cached image at this time
+   *
+   * New frames are written to the cache folder's FramePack, this path is only used for reading
+   * frames cached as individual EXR files by older versions.
    */
   QString CachePathName(const QByteArray &hash) const;
   static QString CachePathName(const QString& cache_path, const QByteArray &hash);
 
-  bool SaveCacheFrame(const QString& filename, char *data, const VideoParams &vparam, int linesize_bytes) const;
+  static bool SaveCacheFrame(const QString& filename, char *data, const VideoParams &vparam, int linesize_bytes);
   bool SaveCacheFrame(const QByteArray& hash, char *data, const VideoParams &vparam, int linesize_bytes) const;
   bool SaveCacheFrame(const QByteArray& hash, FramePtr frame) const;
   static FramePtr LoadCacheFrame(const QString& cache_path, const QByteArray& hash);
   FramePtr LoadCacheFrame(const QByteArray& hash) const;
   static FramePtr LoadCacheFrame(const QString& fn);
 
+  /**
+   * @brief Returns TRUE if a frame with this hash is in the disk cache, either packed or as a file
+   */
+  bool HasCacheFrame(const QByteArray& hash) const;
+  static bool HasCacheFrame(const QString& cache_path, const QByteArray& hash);
+
   static QString GetFormatExtension();
 
+  /**
+   * @brief Write the time to hash map into the cache folder so it's warm when the project is reopened
+   *
+   * The map is stored as its runs in frames, each pointing into a table of distinct hashes, and
+   * keyed by `uuid` (the sequence's viewer UUID, which is saved with the project).
+   */
+  bool SaveHashMap(const QUuid& uuid) const;
+
+  /**
+   * @brief Restore a map written by SaveHashMap()
+   *
+   * Runs are only restored if the timebase still matches, and only those whose frame is still in
+   * the disk cache, which are validated straight away. Restored frames stay unverified until
+   * they're first retrieved with GetHash(), which compares them against the graph's current hash
+   * and invalidates the run if it has changed since the map was saved.
+   */
+  bool LoadHashMap(const QUuid& uuid);
+
+  static QString GetHashMapFilename(const QString& cache_path, const QUuid& uuid);
+
   static QVector<rational> GetFrameListFromTimeRange(TimeRangeList range_list, const rational& timebase);
   QVector<rational> GetFrameListFromTimeRange(const TimeRangeList &range);
   QVector<rational> GetInvalidatedFrames();
@@ -78,6 +167,14 @@ public:
 public slots:
   void SetHash(const olive::rational& time, const QByteArray& hash, const qint64 &job_time, bool frame_exists);
 
+  /**
+   * @brief Set the same hash for every frame in `range`
+   *
+   * Equivalent to calling SetHash() for each frame, used when a node reports its hash is constant
+   * over the range so it only had to be generated once.
+   */
+  void SetHashRange(const olive::TimeRange& range, const QByteArray& hash, const qint64 &job_time, bool frame_exists);
+
 protected:
   virtual void LengthChangedEvent(const rational& old, const rational& newlen) override;
 
@@ -86,12 +183,101 @@ protected:
   virtual void InvalidateEvent(const TimeRange& range) override;
 
 private:
-  QMap<rational, QByteArray> time_hash_map_;
+  /**
+   * @brief A stretch of consecutive frames that share one hash
+   */
+  struct HashRun {
+    rational out;
+    QByteArray hash;
+  };
+
+  /**
+   * @brief Snap a range outwards so it covers every frame it touches
+   */
+  TimeRange SnapRangeToFrames(const TimeRange& range) const;
+
+  /**
+   * @brief Set `hash` for every frame in `range`, merging with neighboring runs of the same hash
+   */
+  void InsertRun(const TimeRange& range, const QByteArray& hash);
+
+  /**
+   * @brief Remove all hashes in `range`, splitting any runs that cross its edges
+   */
+  void RemoveRange(const TimeRange& range);
+
+  /**
+   * @brief Split the run containing `time` (if any) so a run starts exactly at `time`
+   */
+  void SplitAt(const rational& time);
+
+  /**
+   * @brief Merge the run starting at `time` into the preceding run if they're adjacent and share a hash
+   */
+  void MergeAt(const rational& time);
+
+  /**
+   * @brief Insert a run, every insertion into `hash_runs_` goes through here to keep `runs_by_hash_` in sync
+   */
+  void AddRun(const rational& in, const HashRun& run);
+
+  /**
+   * @brief Erase a run and remove it from `runs_by_hash_`, returns the iterator after it
+   */
+  QMap<rational, HashRun>::iterator EraseRun(QMap<rational, HashRun>::iterator it);
+
+  void UnindexRun(const rational& in, const QByteArray& hash);
+
+  /**
+   * @brief Estimate what the maps are holding from their sizes and update `memory_`
+   */
+  void UpdateMemoryUsage();
+
+  /**
+   * @brief Every run using `hash` in time order
+   */
+  QVector<TimeRange> GetRunsWithHash(const QByteArray& hash) const;
+
+  /**
+   * @brief Runs of identical hashes keyed by the time they start
+   *
+   * Runs never overlap. Still images, held frames and gaps all collapse into one entry, so the
+   * size of this map scales with the number of edits rather than the number of frames.
+   */
+  QMap<rational, HashRun> hash_runs_;
+
+  /**
+   * @brief The start of every run in `hash_runs_` using each hash
+   *
+   * Lets frames be looked up by hash (most importantly when the disk cache deletes them) without
+   * scanning every run.
+   */
+  QHash<QByteArray, QSet<rational> > runs_by_hash_;
+
+  /**
+   * @brief Frames restored by LoadHashMap() that haven't been compared against the graph yet
+   */
+  TimeRangeList unverified_;
+
+  /**
+   * @brief Returns FALSE if the restored hash at `time` no longer matches, see LoadHashMap()
+   */
+  bool VerifyRestoredHash(const rational& time, const QByteArray& hash);
+
+  static const quint32 kHashMapMagic;
+  static const quint32 kHashMapVersion;
+
+  /**
+   * @brief Render cost of each hash, shared by every frame that uses it
+   */
+  QHash<QByteArray, RenderCost> render_costs_;
 
   rational timebase_;
 
+  MemoryAccounting::Counter memory_;
+
 private slots:
-  void HashDeleted(const QString &s, const QByteArray& hash);
+  void HashesDeleted(const QString &s, const QVector<QByteArray>& hashes);
 
   void ProjectInvalidated(Project* p);
 
@@ -0,0 +1,171 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framememorycache.h"
+
+#include <QCoreApplication>
+
+#include "common/metrics.h"
+#include "config/config.h"
+
+namespace olive {
+
+FrameMemoryCache* FrameMemoryCache::instance_ = nullptr;
+
+FrameMemoryCache::FrameMemoryCache() :
+  Consumer(QCoreApplication::translate("FrameMemoryCache", "RAM Frame Cache"), MemoryGovernor::kPriorityCache),
+  size_(0)
+{
+  MemoryGovernor::Register(this);
+}
+
+FrameMemoryCache::~FrameMemoryCache()
+{
+  MemoryGovernor::Unregister(this);
+}
+
+void FrameMemoryCache::CreateInstance()
+{
+  instance_ = new FrameMemoryCache();
+}
+
+void FrameMemoryCache::DestroyInstance()
+{
+  delete instance_;
+  instance_ = nullptr;
+}
+
+FrameMemoryCache *FrameMemoryCache::instance()
+{
+  return instance_;
+}
+
+void FrameMemoryCache::Insert(const QByteArray &hash, FramePtr frame)
+{
+  if (!frame || frame->is_partial()) {
+    return;
+  }
+
+  qint64 budget = Config::Current()[QStringLiteral("PlaybackMemoryCache")].toLongLong() * 1048576;
+
+  if (frame->allocated_size() > budget) {
+    return;
+  }
+
+  {
+    QMutexLocker locker(&lock_);
+
+    auto existing = entries_.find(hash);
+    if (existing != entries_.end()) {
+      size_ -= existing->frame->allocated_size();
+      access_order_.erase(existing->access);
+      entries_.erase(existing);
+    }
+
+    // Keep our own copy so the caller's timestamp changes don't affect us
+    FramePtr copy = std::make_shared<Frame>(*frame);
+
+    access_order_.push_back(hash);
+    entries_.insert(hash, {copy, std::prev(access_order_.end())});
+    size_ += copy->allocated_size();
+
+    while (size_ > budget) {
+      RemoveLeastRecent();
+    }
+  }
+
+  if (MemoryGovernor::IsOverBudget()) {
+    MemoryGovernor::Reclaim();
+  }
+}
+
+FramePtr FrameMemoryCache::Get(const QByteArray &hash)
+{
+  QMutexLocker locker(&lock_);
+
+  auto it = entries_.find(hash);
+  if (it == entries_.end()) {
+    Metrics::Add(Metrics::kFrameCacheMisses);
+    return nullptr;
+  }
+
+  Metrics::Add(Metrics::kFrameCacheHits);
+
+  // Move to the back of the access order
+  access_order_.splice(access_order_.end(), access_order_, it->access);
+
+  return std::make_shared<Frame>(*it->frame);
+}
+
+bool FrameMemoryCache::Contains(const QByteArray &hash)
+{
+  QMutexLocker locker(&lock_);
+
+  return entries_.contains(hash);
+}
+
+void FrameMemoryCache::Clear()
+{
+  QMutexLocker locker(&lock_);
+
+  entries_.clear();
+  access_order_.clear();
+  size_ = 0;
+}
+
+qint64 FrameMemoryCache::GetSize()
+{
+  QMutexLocker locker(&lock_);
+
+  return size_;
+}
+
+qint64 FrameMemoryCache::GetMemoryUsage() const
+{
+  QMutexLocker locker(&lock_);
+
+  return size_;
+}
+
+bool FrameMemoryCache::ReleaseMemory(qint64 bytes)
+{
+  QMutexLocker locker(&lock_);
+
+  qint64 target = size_ - bytes;
+  bool released = false;
+
+  while (!entries_.isEmpty() && size_ > target) {
+    RemoveLeastRecent();
+    released = true;
+  }
+
+  return released;
+}
+
+void FrameMemoryCache::RemoveLeastRecent()
+{
+  auto it = entries_.find(access_order_.front());
+
+  size_ -= it->frame->allocated_size();
+  entries_.erase(it);
+  access_order_.pop_front();
+}
+
+}
@@ -0,0 +1,113 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMEMEMORYCACHE_H
+#define FRAMEMEMORYCACHE_H
+
+#include <list>
+#include <QHash>
+#include <QMutex>
+
+#include "codec/frame.h"
+#include "common/define.h"
+#include "common/memorygovernor.h"
+
+namespace olive {
+
+/**
+ * @brief In-memory tier in front of the disk cache
+ *
+ * Holds the most recently rendered or loaded cached frames, keyed by the same hash FrameHashCache
+ * uses, so frames that were just rendered or are being looped don't have to be read back from disk.
+ * Frames are still written to disk as normal, this only saves the read.
+ *
+ * The cache is bounded by the "PlaybackMemoryCache" config entry (in megabytes), the least
+ * recently used frames are dropped first when it's exceeded. It's registered with MemoryGovernor so
+ * frames are also dropped when the global memory budget is exceeded.
+ *
+ * This class is thread safe.
+ */
+class FrameMemoryCache : public MemoryGovernor::Consumer
+{
+public:
+  static void CreateInstance();
+
+  static void DestroyInstance();
+
+  static FrameMemoryCache* instance();
+
+  DISABLE_COPY_MOVE(FrameMemoryCache)
+
+  /**
+   * @brief Store a frame, replacing any frame already stored with this hash
+   */
+  void Insert(const QByteArray& hash, FramePtr frame);
+
+  /**
+   * @brief Retrieve a frame, returns nullptr if it isn't in memory
+   *
+   * The returned frame shares its buffer with the cached one but is otherwise a separate object,
+   * so callers are free to change its timestamp. Writing to its data will detach it.
+   */
+  FramePtr Get(const QByteArray& hash);
+
+  bool Contains(const QByteArray& hash);
+
+  void Clear();
+
+  /**
+   * @brief Returns the total size in bytes of all frames currently in memory
+   */
+  qint64 GetSize();
+
+  virtual qint64 GetMemoryUsage() const override;
+
+  virtual bool ReleaseMemory(qint64 bytes) override;
+
+private:
+  FrameMemoryCache();
+
+  virtual ~FrameMemoryCache() override;
+
+  void RemoveLeastRecent();
+
+  struct Entry {
+    FramePtr frame;
+    std::list<QByteArray>::iterator access;
+  };
+
+  static FrameMemoryCache* instance_;
+
+  QHash<QByteArray, Entry> entries_;
+
+  /**
+   * @brief Hashes ordered from least to most recently used
+   */
+  std::list<QByteArray> access_order_;
+
+  qint64 size_;
+
+  mutable QMutex lock_;
+
+};
+
+}
+
+#endif // FRAMEMEMORYCACHE_H
@@ -0,0 +1,657 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framepack.h"
+
+#include <stdexcept>
+#include <OpenEXR/ImfChannelList.h>
+#include <OpenEXR/ImfFloatAttribute.h>
+#include <OpenEXR/ImfInputFile.h>
+#include <OpenEXR/ImfIO.h>
+#include <OpenEXR/ImfOutputFile.h>
+#include <OpenEXR/OpenEXRConfig.h>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+
+#include "config/config.h"
+
+namespace olive {
+
+namespace {
+
+#if OPENEXR_VERSION_MAJOR >= 3
+using ExrOffset = uint64_t;
+#else
+using ExrOffset = Imf::Int64;
+#endif
+
+/**
+ * @brief Lets OpenEXR write a file into a QByteArray
+ */
+class ExrMemoryOStream : public Imf::OStream
+{
+public:
+  ExrMemoryOStream() :
+    Imf::OStream("memory"),
+    pos_(0)
+  {
+  }
+
+  virtual void write(const char c[], int n) override
+  {
+    if (pos_ + n > data_.size()) {
+      data_.resize(pos_ + n);
+    }
+
+    memcpy(data_.data() + pos_, c, n);
+    pos_ += n;
+  }
+
+  virtual ExrOffset tellp() override
+  {
+    return pos_;
+  }
+
+  virtual void seekp(ExrOffset pos) override
+  {
+    pos_ = static_cast<int>(pos);
+  }
+
+  const QByteArray& data() const
+  {
+    return data_;
+  }
+
+private:
+  QByteArray data_;
+
+  int pos_;
+
+};
+
+/**
+ * @brief Lets OpenEXR read a file straight from a mapped cache segment
+ */
+class ExrMemoryIStream : public Imf::IStream
+{
+public:
+  ExrMemoryIStream(const char* data, qint64 size) :
+    Imf::IStream("memory"),
+    data_(data),
+    size_(size),
+    pos_(0)
+  {
+  }
+
+  virtual bool isMemoryMapped() const override
+  {
+    return true;
+  }
+
+  virtual char* readMemoryMapped(int n) override
+  {
+    if (pos_ + n > size_) {
+      throw std::out_of_range("Read past end of cached frame");
+    }
+
+    char* c = const_cast<char*>(data_ + pos_);
+    pos_ += n;
+    return c;
+  }
+
+  virtual bool read(char c[], int n) override
+  {
+    memcpy(c, readMemoryMapped(n), n);
+    return pos_ < size_;
+  }
+
+  virtual ExrOffset tellg() override
+  {
+    return pos_;
+  }
+
+  virtual void seekg(ExrOffset pos) override
+  {
+    pos_ = static_cast<qint64>(pos);
+  }
+
+private:
+  const char* data_;
+
+  qint64 size_;
+
+  qint64 pos_;
+
+};
+
+}
+
+const qint64 FramePack::kSegmentSize = 268435456; // 256 MB
+const quint32 FramePack::kIndexVersion = 2;
+QMutex FramePack::instance_lock_;
+QHash<QString, FramePack*> FramePack::instances_;
+
+FramePack::FramePack(const QString &cache_path) :
+  active_segment_(-1),
+  next_segment_(0),
+  encoding_(Config::Current()[QStringLiteral("DiskCacheCompression")].toBool() ? kEncodingZlib : kEncodingUncompressed)
+{
+  QDir pack_dir(QDir(cache_path).filePath(QStringLiteral("pack")));
+  pack_dir.mkpath(".");
+
+  pack_path_ = pack_dir.absolutePath();
+  index_path_ = pack_dir.filePath(QStringLiteral("index"));
+
+  LoadIndex();
+}
+
+FramePack::~FramePack()
+{
+  SaveIndex();
+
+  active_file_.close();
+
+  foreach (const Segment& s, segments_) {
+    delete s.file;
+  }
+}
+
+FramePack *FramePack::Get(const QString &cache_path)
+{
+  QMutexLocker locker(&instance_lock_);
+
+  FramePack* pack = instances_.value(cache_path);
+
+  if (!pack) {
+    pack = new FramePack(cache_path);
+    instances_.insert(cache_path, pack);
+  }
+
+  return pack;
+}
+
+void FramePack::CloseAll()
+{
+  QMutexLocker locker(&instance_lock_);
+
+  qDeleteAll(instances_);
+  instances_.clear();
+}
+
+void FramePack::Close(const QString &cache_path)
+{
+  QMutexLocker locker(&instance_lock_);
+
+  delete instances_.take(cache_path);
+}
+
+qint64 FramePack::Write(const QByteArray &hash, const char *data, const VideoParams &vparam, int linesize_bytes)
+{
+  int width = vparam.effective_width();
+  int height = vparam.effective_height();
+  int row_bytes = VideoParams::GetBytesPerPixel(vparam.format(), vparam.channel_count()) * width;
+
+  Encoding encoding = GetEncoding();
+  QByteArray buffer;
+
+  if (encoding == kEncodingDWAA || encoding == kEncodingB44) {
+    buffer = EncodeEXR(data, vparam, linesize_bytes, encoding);
+  }
+
+  if (buffer.isEmpty()) {
+    // Strip any row padding, there's no reason to store it
+    buffer = QByteArray(row_bytes * height, Qt::Uninitialized);
+    for (int i=0; i<height; i++) {
+      memcpy(buffer.data() + i * row_bytes, data + i * linesize_bytes, row_bytes);
+    }
+
+    if (encoding == kEncodingZlib) {
+      QByteArray c = qCompress(buffer, 1);
+
+      if (c.size() < buffer.size()) {
+        buffer = c;
+      } else {
+        encoding = kEncodingUncompressed;
+      }
+    } else {
+      encoding = kEncodingUncompressed;
+    }
+  }
+
+  QMutexLocker append_locker(&append_lock_);
+
+  if (!active_file_.isOpen()
+      || (active_file_.size() > 0 && active_file_.size() + buffer.size() > kSegmentSize)) {
+    if (!OpenSegmentForWriting(next_segment_)) {
+      return 0;
+    }
+  }
+
+  qint64 offset = active_file_.size();
+
+  if (active_file_.write(buffer) != buffer.size() || !active_file_.flush()) {
+    qWarning() << "Failed to write frame to cache pack" << active_file_.fileName();
+    return 0;
+  }
+
+  Entry e;
+  e.segment = active_segment_;
+  e.offset = offset;
+  e.size = buffer.size();
+  e.width = width;
+  e.height = height;
+  e.format = vparam.format();
+  e.channel_count = vparam.channel_count();
+  e.pixel_aspect = vparam.pixel_aspect_ratio();
+  e.encoding = encoding;
+
+  QWriteLocker locker(&lock_);
+
+  // If this hash was already written (e.g. two threads rendered the same frame), drop the old copy
+  auto existing = entries_.constFind(hash);
+  if (existing != entries_.constEnd()) {
+    int old_segment = existing->segment;
+    entries_.erase(existing);
+    segments_[old_segment].references--;
+    RemoveSegmentIfUnused(old_segment);
+  }
+
+  entries_.insert(hash, e);
+  segments_[e.segment].references++;
+
+  return e.size;
+}
+
+FramePtr FramePack::Read(const QByteArray &hash)
+{
+  QReadLocker locker(&lock_);
+
+  auto it = entries_.constFind(hash);
+  if (it == entries_.constEnd()) {
+    return nullptr;
+  }
+
+  Entry e = *it;
+  QFile* file;
+  uchar* mapped;
+
+  {
+    QMutexLocker map_locker(&map_lock_);
+
+    Segment& s = segments_[e.segment];
+
+    if (!s.file) {
+      s.file = new QFile(SegmentFilename(e.segment));
+
+      if (!s.file->open(QFile::ReadOnly)) {
+        qWarning() << "Failed to open cache pack" << s.file->fileName();
+        delete s.file;
+        s.file = nullptr;
+        return nullptr;
+      }
+    }
+
+    file = s.file;
+    mapped = file->map(e.offset, e.size);
+  }
+
+  if (!mapped) {
+    qWarning() << "Failed to map frame from cache pack" << file->fileName();
+    return nullptr;
+  }
+
+  VideoParams::Format format = static_cast<VideoParams::Format>(e.format);
+  int row_bytes = VideoParams::GetBytesPerPixel(format, e.channel_count) * e.width;
+
+  FramePtr frame = Frame::Create();
+  frame->set_video_params(VideoParams(e.width, e.height, format, e.channel_count, e.pixel_aspect));
+  frame->allocate();
+
+  if (e.encoding == kEncodingDWAA || e.encoding == kEncodingB44) {
+    if (!DecodeEXR(reinterpret_cast<const char*>(mapped), e.size, frame.get())) {
+      frame = nullptr;
+    }
+  } else {
+    QByteArray decompressed;
+    const char* src;
+
+    if (e.encoding == kEncodingZlib) {
+      decompressed = qUncompress(mapped, e.size);
+      src = decompressed.constData();
+    } else {
+      src = reinterpret_cast<const char*>(mapped);
+    }
+
+    if (e.encoding == kEncodingZlib && decompressed.size() != row_bytes * e.height) {
+      qWarning() << "Cached frame failed to decompress";
+      frame = nullptr;
+    } else {
+      for (int i=0; i<e.height; i++) {
+        memcpy(frame->data() + i * frame->linesize_bytes(), src + i * row_bytes, row_bytes);
+      }
+    }
+  }
+
+  {
+    QMutexLocker map_locker(&map_lock_);
+    file->unmap(mapped);
+  }
+
+  return frame;
+}
+
+bool FramePack::Contains(const QByteArray &hash)
+{
+  QReadLocker locker(&lock_);
+
+  return entries_.contains(hash);
+}
+
+bool FramePack::Remove(const QByteArray &hash)
+{
+  QWriteLocker locker(&lock_);
+
+  auto it = entries_.find(hash);
+  if (it == entries_.end()) {
+    return false;
+  }
+
+  int segment = it->segment;
+  entries_.erase(it);
+
+  segments_[segment].references--;
+  RemoveSegmentIfUnused(segment);
+
+  return true;
+}
+
+void FramePack::Clear()
+{
+  QMutexLocker append_locker(&append_lock_);
+  QWriteLocker locker(&lock_);
+
+  active_file_.close();
+  active_segment_ = -1;
+
+  for (auto it=segments_.cbegin(); it!=segments_.cend(); it++) {
+    delete it->file;
+    QFile::remove(SegmentFilename(it.key()));
+  }
+
+  segments_.clear();
+  entries_.clear();
+  next_segment_ = 0;
+
+  QFile::remove(index_path_);
+}
+
+void FramePack::SaveIndex()
+{
+  QReadLocker locker(&lock_);
+
+  QFile index_file(index_path_);
+
+  if (!index_file.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to write cache pack index:" << index_path_;
+    return;
+  }
+
+  QDataStream ds(&index_file);
+
+  ds << kIndexVersion;
+  ds << static_cast<qint32>(GetEncoding());
+
+  for (auto it=entries_.cbegin(); it!=entries_.cend(); it++) {
+    const Entry& e = it.value();
+
+    ds << it.key();
+    ds << e.segment;
+    ds << e.offset;
+    ds << e.size;
+    ds << e.width;
+    ds << e.height;
+    ds << e.format;
+    ds << e.channel_count;
+    ds << static_cast<qint64>(e.pixel_aspect.numerator());
+    ds << static_cast<qint64>(e.pixel_aspect.denominator());
+    ds << e.encoding;
+  }
+
+  index_file.close();
+}
+
+void FramePack::SetEncoding(Encoding e)
+{
+  encoding_ = e;
+}
+
+QString FramePack::SegmentFilename(int index) const
+{
+  return QDir(pack_path_).filePath(QStringLiteral("segment%1").arg(index));
+}
+
+bool FramePack::OpenSegmentForWriting(int index)
+{
+  active_file_.close();
+  active_file_.setFileName(SegmentFilename(index));
+
+  if (!active_file_.open(QFile::WriteOnly | QFile::Truncate)) {
+    qWarning() << "Failed to create cache pack" << active_file_.fileName();
+    return false;
+  }
+
+  next_segment_ = index + 1;
+
+  QWriteLocker locker(&lock_);
+
+  int old_segment = active_segment_;
+
+  segments_.insert(index, {nullptr, 0});
+  active_segment_ = index;
+
+  // The previous segment may have been emptied while it was still being written to
+  if (old_segment >= 0) {
+    RemoveSegmentIfUnused(old_segment);
+  }
+
+  return true;
+}
+
+void FramePack::RemoveSegmentIfUnused(int index)
+{
+  auto it = segments_.find(index);
+
+  if (index == active_segment_ || it == segments_.end() || it->references > 0) {
+    return;
+  }
+
+  delete it->file;
+  QFile::remove(SegmentFilename(index));
+  segments_.erase(it);
+}
+
+void FramePack::LoadIndex()
+{
+  QFile index_file(index_path_);
+
+  if (index_file.open(QFile::ReadOnly)) {
+    QDataStream ds(&index_file);
+
+    quint32 version;
+    ds >> version;
+
+    if (version == kIndexVersion) {
+      qint32 encoding;
+      ds >> encoding;
+      encoding_ = encoding;
+    }
+
+    // Version 1 stored whether each frame was compressed rather than how
+    if (version == 1 || version == kIndexVersion) {
+      while (!index_file.atEnd()) {
+        QByteArray hash;
+        Entry e;
+        qint64 par_num, par_den;
+
+        ds >> hash;
+        ds >> e.segment;
+        ds >> e.offset;
+        ds >> e.size;
+        ds >> e.width;
+        ds >> e.height;
+        ds >> e.format;
+        ds >> e.channel_count;
+        ds >> par_num;
+        ds >> par_den;
+
+        if (version == 1) {
+          bool compressed;
+          ds >> compressed;
+          e.encoding = compressed ? kEncodingZlib : kEncodingUncompressed;
+        } else {
+          ds >> e.encoding;
+        }
+
+        if (ds.status() != QDataStream::Ok) {
+          break;
+        }
+
+        e.pixel_aspect = rational(par_num, par_den);
+
+        if (!segments_.contains(e.segment)) {
+          if (!QFileInfo::exists(SegmentFilename(e.segment))) {
+            continue;
+          }
+
+          segments_.insert(e.segment, {nullptr, 0});
+        }
+
+        entries_.insert(hash, e);
+        segments_[e.segment].references++;
+        next_segment_ = qMax(next_segment_, e.segment + 1);
+      }
+    }
+
+    index_file.close();
+  }
+
+  // Anything not referenced by the index was written after the last save and can't be recovered
+  QDir pack_dir(pack_path_);
+  QStringList segment_files = pack_dir.entryList({QStringLiteral("segment*")}, QDir::Files);
+  foreach (const QString& f, segment_files) {
+    bool ok;
+    int index = f.mid(7).toInt(&ok);
+
+    if (!ok || !segments_.contains(index)) {
+      pack_dir.remove(f);
+    }
+  }
+}
+
+QByteArray FramePack::EncodeEXR(const char *data, const VideoParams &vparam, int linesize_bytes, Encoding encoding)
+{
+  Imf::PixelType pix_type;
+
+  if (vparam.format() == VideoParams::kFormatFloat16) {
+    pix_type = Imf::HALF;
+  } else if (vparam.format() == VideoParams::kFormatFloat32) {
+    pix_type = Imf::FLOAT;
+  } else {
+    return QByteArray();
+  }
+
+  bool has_alpha = (vparam.channel_count() == VideoParams::kRGBAChannelCount);
+
+  Imf::Header header(vparam.effective_width(), vparam.effective_height());
+  header.channels().insert("R", Imf::Channel(pix_type));
+  header.channels().insert("G", Imf::Channel(pix_type));
+  header.channels().insert("B", Imf::Channel(pix_type));
+  if (has_alpha) {
+    header.channels().insert("A", Imf::Channel(pix_type));
+  }
+
+  if (encoding == kEncodingB44) {
+    header.compression() = Imf::B44_COMPRESSION;
+  } else {
+    header.compression() = Imf::DWAA_COMPRESSION;
+    header.insert("dwaCompressionLevel", Imf::FloatAttribute(45.0f));
+  }
+
+  int bpc = VideoParams::GetBytesPerChannel(vparam.format());
+  size_t xs = vparam.channel_count() * bpc;
+  size_t ys = linesize_bytes;
+  char* pixels = const_cast<char*>(data);
+
+  Imf::FrameBuffer framebuffer;
+  framebuffer.insert("R", Imf::Slice(pix_type, pixels, xs, ys));
+  framebuffer.insert("G", Imf::Slice(pix_type, pixels + bpc, xs, ys));
+  framebuffer.insert("B", Imf::Slice(pix_type, pixels + 2*bpc, xs, ys));
+  if (has_alpha) {
+    framebuffer.insert("A", Imf::Slice(pix_type, pixels + 3*bpc, xs, ys));
+  }
+
+  ExrMemoryOStream stream;
+
+  try {
+    Imf::OutputFile out(stream, header, 0);
+    out.setFrameBuffer(framebuffer);
+    out.writePixels(vparam.effective_height());
+  } catch (const std::exception& e) {
+    qWarning() << "Failed to encode cache frame:" << e.what();
+    return QByteArray();
+  }
+
+  return stream.data();
+}
+
+bool FramePack::DecodeEXR(const char *data, qint64 size, Frame *frame)
+{
+  Imf::PixelType pix_type = (frame->format() == VideoParams::kFormatFloat16) ? Imf::HALF : Imf::FLOAT;
+
+  int bpc = VideoParams::GetBytesPerChannel(frame->format());
+  size_t xs = frame->channel_count() * bpc;
+  size_t ys = frame->linesize_bytes();
+  char* pixels = frame->data();
+
+  Imf::FrameBuffer framebuffer;
+  framebuffer.insert("R", Imf::Slice(pix_type, pixels, xs, ys));
+  framebuffer.insert("G", Imf::Slice(pix_type, pixels + bpc, xs, ys));
+  framebuffer.insert("B", Imf::Slice(pix_type, pixels + 2*bpc, xs, ys));
+  if (frame->channel_count() == VideoParams::kRGBAChannelCount) {
+    framebuffer.insert("A", Imf::Slice(pix_type, pixels + 3*bpc, xs, ys));
+  }
+
+  ExrMemoryIStream stream(data, size);
+
+  try {
+    Imf::InputFile file(stream, 0);
+    file.setFrameBuffer(framebuffer);
+    file.readPixels(0, frame->height() - 1);
+  } catch (const std::exception& e) {
+    qWarning() << "Failed to decode cache frame:" << e.what();
+    return false;
+  }
+
+  return true;
+}
+
+}
@@ -0,0 +1,223 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMEPACK_H
+#define FRAMEPACK_H
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QReadWriteLock>
+
+#include "codec/frame.h"
+#include "common/define.h"
+
+namespace olive {
+
+/**
+ * @brief Append-only store of cached frames for one disk cache folder
+ *
+ * Writing one EXR per frame means every frame shown during playback costs a file open and a
+ * header parse, and the disk cache folder ends up with thousands of small files. FramePack instead
+ * appends frames to a handful of large segment files and keeps an index of where each hash lives.
+ * Reads map just the frame's region of its segment, so loading a cached frame is a single copy
+ * (or decompression) into a Frame.
+ *
+ * Each pack has an Encoding that new frames are stored with, chosen per cache folder. Frames keep
+ * the encoding they were written with, so changing it doesn't invalidate what's already cached.
+ * Uncompressed and zlib frames are stored with tightly packed rows, zlib is skipped for frames it
+ * doesn't shrink. The lossy encodings store each frame as an in-memory EXR, which reads several
+ * times less from disk for a small loss in quality.
+ *
+ * Removing a frame only drops it from the index. A segment's file is deleted once nothing in it
+ * is referenced any more, which happens in order under DiskCacheFolder's least-recently-used
+ * eviction, so little space is held by removed frames at any one time.
+ *
+ * The index is only written by SaveIndex() (called alongside DiskCacheFolder's own index), frames
+ * written after the last save are forgotten if the application doesn't close cleanly.
+ *
+ * This class is thread safe.
+ */
+class FramePack
+{
+public:
+  enum Encoding {
+    kEncodingUncompressed,
+
+    /// Lossless, typically saves little on noisy footage
+    kEncodingZlib,
+
+    /// Lossy EXR DWAA, the smallest frames at a small quality cost
+    kEncodingDWAA,
+
+    /// Lossy EXR B44, fixed size and very fast to decode, but only compresses half float frames
+    kEncodingB44
+  };
+
+  ~FramePack();
+
+  DISABLE_COPY_MOVE(FramePack)
+
+  /**
+   * @brief Get the pack for a cache folder, opening it if it isn't already open
+   */
+  static FramePack* Get(const QString& cache_path);
+
+  /**
+   * @brief Save and close every open pack
+   */
+  static void CloseAll();
+
+  /**
+   * @brief Save and close the pack for a cache folder if it's open
+   *
+   * Nothing else may be using the pack, any pointer to it from Get() is invalid afterwards.
+   */
+  static void Close(const QString& cache_path);
+
+  /**
+   * @brief Append a frame to the pack
+   *
+   * Returns the number of bytes the frame occupies on disk, or 0 if it couldn't be written.
+   */
+  qint64 Write(const QByteArray& hash, const char *data, const VideoParams &vparam, int linesize_bytes);
+
+  /**
+   * @brief Read a frame from the pack, returns nullptr if this hash isn't in it
+   */
+  FramePtr Read(const QByteArray& hash);
+
+  bool Contains(const QByteArray& hash);
+
+  /**
+   * @brief Remove a frame from the index, returns FALSE if it wasn't there
+   */
+  bool Remove(const QByteArray& hash);
+
+  /**
+   * @brief Remove every frame and delete all segment files
+   */
+  void Clear();
+
+  /**
+   * @brief Write the index to disk
+   */
+  void SaveIndex();
+
+  Encoding GetEncoding() const
+  {
+    return static_cast<Encoding>(encoding_.load());
+  }
+
+  /**
+   * @brief Set the encoding frames written from now on are stored with
+   */
+  void SetEncoding(Encoding e);
+
+private:
+  FramePack(const QString& cache_path);
+
+  struct Entry {
+    int segment;
+    qint64 offset;
+    qint64 size;
+
+    int width;
+    int height;
+    int format;
+    int channel_count;
+    rational pixel_aspect;
+
+    int encoding;
+  };
+
+  struct Segment {
+    QFile* file;
+    int references;
+  };
+
+  QString SegmentFilename(int index) const;
+
+  bool OpenSegmentForWriting(int index);
+
+  void RemoveSegmentIfUnused(int index);
+
+  void LoadIndex();
+
+  /**
+   * @brief Encode a frame as an EXR in memory, returns an empty array on failure
+   */
+  static QByteArray EncodeEXR(const char* data, const VideoParams& vparam, int linesize_bytes, Encoding encoding);
+
+  /**
+   * @brief Decode an EXR written by EncodeEXR() into `frame`, which must already be allocated
+   */
+  static bool DecodeEXR(const char* data, qint64 size, Frame* frame);
+
+  /**
+   * @brief Segment size after which a new segment is started
+   */
+  static const qint64 kSegmentSize;
+
+  static const quint32 kIndexVersion;
+
+  static QMutex instance_lock_;
+
+  static QHash<QString, FramePack*> instances_;
+
+  QString pack_path_;
+
+  QString index_path_;
+
+  QHash<QByteArray, Entry> entries_;
+
+  QHash<int, Segment> segments_;
+
+  int active_segment_;
+
+  /**
+   * @brief Index the next segment will be created with, guarded by `append_lock_`
+   */
+  int next_segment_;
+
+  QFile active_file_;
+
+  QAtomicInt encoding_;
+
+  /**
+   * @brief Guards `entries_`, `segments_`, and `active_segment_`
+   */
+  QReadWriteLock lock_;
+
+  /**
+   * @brief Guards `active_file_`, always locked before `lock_` if both are needed
+   */
+  QMutex append_lock_;
+
+  /**
+   * @brief Guards opening, mapping, and unmapping segment files while `lock_` is held for reading
+   */
+  QMutex map_lock_;
+
+};
+
+}
+
+#endif // FRAMEPACK_H
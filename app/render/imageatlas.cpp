@@ -0,0 +1,247 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "imageatlas.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QPainter>
+
+#include "config/config.h"
+
+namespace olive {
+
+const int ImageAtlas::kPageSize = 1024;
+
+ImageAtlas* ImageAtlas::instance_ = nullptr;
+
+ImageAtlas::ImageAtlas() :
+  Consumer(QCoreApplication::translate("ImageAtlas", "Interface Images"), MemoryGovernor::kPriorityCache),
+  size_(0),
+  trim_request_(0),
+  memory_(MemoryAccounting::kInterfaceImages)
+{
+  MemoryGovernor::Register(this);
+}
+
+ImageAtlas::~ImageAtlas()
+{
+  MemoryGovernor::Unregister(this);
+
+  foreach (const Group& g, groups_) {
+    qDeleteAll(g.pages);
+  }
+}
+
+void ImageAtlas::CreateInstance()
+{
+  instance_ = new ImageAtlas();
+}
+
+void ImageAtlas::DestroyInstance()
+{
+  delete instance_;
+  instance_ = nullptr;
+}
+
+ImageAtlas *ImageAtlas::instance()
+{
+  return instance_;
+}
+
+ImageAtlas::Tile ImageAtlas::Get(const QByteArray &key)
+{
+  auto it = entries_.find(key);
+
+  if (it == entries_.end()) {
+    return Tile();
+  }
+
+  access_order_.splice(access_order_.end(), access_order_, it->access);
+
+  return GetTile(*it);
+}
+
+ImageAtlas::Tile ImageAtlas::Insert(const QByteArray &key, const QSize &size)
+{
+  if (size.isEmpty()) {
+    return Tile();
+  }
+
+  auto existing = entries_.find(key);
+  if (existing != entries_.end()) {
+    RemoveEntry(existing);
+  }
+
+  // Make room before allocating rather than after so we never go over by more than one page
+  qint64 budget = Config::Current()[QStringLiteral("ImageAtlasSize")].toLongLong() * 1048576;
+  qint64 trim = trim_request_.fetchAndStoreOrdered(0);
+  qint64 current = size_.load();
+
+  if (current > budget || trim > 0) {
+    EvictTo(qMax(qint64(0), qMin(budget, current - trim)));
+  }
+
+  quint64 group_key = GetGroupKey(size);
+  auto group_it = groups_.find(group_key);
+
+  if (group_it == groups_.end()) {
+    Group g;
+    g.slot_size = size;
+    g.columns = qMax(1, kPageSize / size.width());
+    g.rows = qMax(1, kPageSize / size.height());
+    group_it = groups_.insert(group_key, g);
+  }
+
+  Group& group = *group_it;
+
+  int page_index = -1;
+  int free_index = -1;
+
+  for (int i=0; i<group.pages.size(); i++) {
+    Page* p = group.pages.at(i);
+
+    if (p && !p->free_slots.isEmpty()) {
+      page_index = i;
+      break;
+    } else if (!p && free_index == -1) {
+      free_index = i;
+    }
+  }
+
+  if (page_index == -1) {
+    Page* p = new Page();
+    p->image = QImage(group.columns * size.width(), group.rows * size.height(), QImage::Format_ARGB32_Premultiplied);
+
+    if (p->image.isNull()) {
+      qWarning() << "Failed to allocate image atlas page of" << p->image.size();
+      delete p;
+      return Tile();
+    }
+
+    int slot_count = group.columns * group.rows;
+
+    // Hand out slots from the top left
+    p->free_slots.resize(slot_count);
+    for (int i=0; i<slot_count; i++) {
+      p->free_slots[i] = slot_count - 1 - i;
+    }
+    p->used_slots = 0;
+
+    if (free_index == -1) {
+      page_index = group.pages.size();
+      group.pages.append(p);
+    } else {
+      page_index = free_index;
+      group.pages[page_index] = p;
+    }
+
+    size_.fetchAndAddOrdered(GetPageSize(p));
+    memory_.Set(size_.load());
+  }
+
+  Page* page = group.pages.at(page_index);
+
+  Entry entry;
+  entry.group = group_key;
+  entry.page = page_index;
+  entry.slot = page->free_slots.takeLast();
+  page->used_slots++;
+
+  access_order_.push_back(key);
+  entry.access = std::prev(access_order_.end());
+
+  entries_.insert(key, entry);
+
+  Tile tile = GetTile(entry);
+
+  // Slots are reused, clear whatever was drawn here before
+  QPainter p(tile.page);
+  p.setCompositionMode(QPainter::CompositionMode_Source);
+  p.fillRect(tile.rect, Qt::transparent);
+
+  return tile;
+}
+
+qint64 ImageAtlas::GetMemoryUsage() const
+{
+  return size_.load();
+}
+
+bool ImageAtlas::ReleaseMemory(qint64 bytes)
+{
+  // Only the latest request matters, each one is how far over budget we are right now
+  trim_request_.storeRelease(bytes);
+
+  return false;
+}
+
+qint64 ImageAtlas::GetPageSize(const Page *page)
+{
+  return static_cast<qint64>(page->image.bytesPerLine()) * page->image.height();
+}
+
+quint64 ImageAtlas::GetGroupKey(const QSize &size)
+{
+  return (static_cast<quint64>(size.width()) << 32) | static_cast<quint32>(size.height());
+}
+
+ImageAtlas::Tile ImageAtlas::GetTile(const Entry &entry)
+{
+  const Group& group = groups_[entry.group];
+
+  Tile t;
+  t.page = &group.pages.at(entry.page)->image;
+  t.rect = QRect((entry.slot % group.columns) * group.slot_size.width(),
+                 (entry.slot / group.columns) * group.slot_size.height(),
+                 group.slot_size.width(),
+                 group.slot_size.height());
+  return t;
+}
+
+void ImageAtlas::EvictTo(qint64 target)
+{
+  while (size_.load() > target && !access_order_.empty()) {
+    RemoveEntry(entries_.find(access_order_.front()));
+  }
+}
+
+void ImageAtlas::RemoveEntry(QHash<QByteArray, Entry>::iterator it)
+{
+  Group& group = groups_[it->group];
+  Page* page = group.pages.at(it->page);
+
+  page->free_slots.append(it->slot);
+  page->used_slots--;
+
+  if (page->used_slots == 0) {
+    // Pages are only given back once they're empty
+    size_.fetchAndAddOrdered(-GetPageSize(page));
+    memory_.Set(size_.load());
+
+    delete page;
+    group.pages[it->page] = nullptr;
+  }
+
+  access_order_.erase(it->access);
+  entries_.erase(it);
+}
+
+}
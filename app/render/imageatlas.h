@@ -0,0 +1,167 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef IMAGEATLAS_H
+#define IMAGEATLAS_H
+
+#include <list>
+#include <QHash>
+#include <QImage>
+#include <QVector>
+
+#include "common/define.h"
+#include "common/memoryaccounting.h"
+#include "common/memorygovernor.h"
+
+namespace olive {
+
+/**
+ * @brief Shared storage for small images that widgets draw over and over again
+ *
+ * Widgets that draw the same small image every repaint (such as a tile of a clip's waveform)
+ * would otherwise each keep a QPixmap of their own, or redraw the image on every paint. Images of
+ * the same size are instead packed into large pages here and drawn straight out of them. Scrolling
+ * a dense timeline then draws parts of a few pages rather than filling an image for every item.
+ *
+ * Images are looked up by a key that the caller builds from everything that decides what's in
+ * them, so changing the contents means changing the key. Nothing is removed explicitly, images
+ * that are no longer asked for are evicted once the pages use more than the "ImageAtlasSize"
+ * config entry (in megabytes), least recently used first. The atlas is registered with
+ * MemoryGovernor too, but since pages may be in use for drawing, memory it asks for back is only
+ * released by the next Insert().
+ *
+ * This class must only be used from the main thread, with the exception of the MemoryGovernor
+ * functions.
+ */
+class ImageAtlas : public MemoryGovernor::Consumer
+{
+public:
+  static void CreateInstance();
+
+  static void DestroyInstance();
+
+  static ImageAtlas* instance();
+
+  DISABLE_COPY_MOVE(ImageAtlas)
+
+  /**
+   * @brief Where an image is stored, valid until the next Insert()
+   */
+  struct Tile {
+    QImage* page = nullptr;
+    QRect rect;
+
+    bool isNull() const
+    {
+      return !page;
+    }
+  };
+
+  /**
+   * @brief Returns where the image for `key` is, or a null Tile if it isn't stored
+   */
+  Tile Get(const QByteArray& key);
+
+  /**
+   * @brief Make space for an image of `size` under `key`, returns where to draw it
+   *
+   * The space starts out transparent. Returns a null Tile if `size` is empty.
+   */
+  Tile Insert(const QByteArray& key, const QSize& size);
+
+  virtual qint64 GetMemoryUsage() const override;
+
+  /**
+   * @brief Request the next Insert() evicts `bytes` more, always returns FALSE since nothing is freed yet
+   */
+  virtual bool ReleaseMemory(qint64 bytes) override;
+
+private:
+  ImageAtlas();
+
+  virtual ~ImageAtlas() override;
+
+  /**
+   * @brief A page holding a grid of images that are all the same size
+   */
+  struct Page {
+    QImage image;
+    QVector<int> free_slots;
+    int used_slots;
+  };
+
+  /**
+   * @brief Every page for one image size
+   *
+   * Pages are never moved so tiles can point at their images, freed pages leave a nullptr behind
+   * to be reused.
+   */
+  struct Group {
+    QSize slot_size;
+    int columns;
+    int rows;
+    QVector<Page*> pages;
+  };
+
+  struct Entry {
+    quint64 group;
+    int page;
+    int slot;
+    std::list<QByteArray>::iterator access;
+  };
+
+  static qint64 GetPageSize(const Page* page);
+
+  static quint64 GetGroupKey(const QSize& size);
+
+  Tile GetTile(const Entry& entry);
+
+  /**
+   * @brief Evict least recently used images until the pages are using at most `target` bytes
+   */
+  void EvictTo(qint64 target);
+
+  void RemoveEntry(QHash<QByteArray, Entry>::iterator it);
+
+  static const int kPageSize;
+
+  static ImageAtlas* instance_;
+
+  QHash<quint64, Group> groups_;
+
+  QHash<QByteArray, Entry> entries_;
+
+  /**
+   * @brief Keys ordered from least to most recently used
+   */
+  std::list<QByteArray> access_order_;
+
+  QAtomicInteger<qint64> size_;
+
+  /// Bytes the governor asked for that haven't been evicted yet
+  QAtomicInteger<qint64> trim_request_;
+
+  MemoryAccounting::Counter memory_;
+
+};
+
+}
+
+#endif // IMAGEATLAS_H
@@ -22,6 +22,7 @@
 #define GENERATEJOB_H
 
 #include "acceleratedjob.h"
+#include "render/color.h"
 
 namespace olive {
 
@@ -30,6 +31,7 @@ public:
   GenerateJob()
   {
     alpha_channel_required_ = false;
+    coverage_mask_ = false;
   }
 
   bool GetAlphaChannelRequired() const
@@ -42,9 +44,39 @@ public:
     alpha_channel_required_ = e;
   }
 
+  /**
+   * @brief Returns TRUE if the node generates a coverage mask rather than a color frame
+   */
+  bool IsCoverageMask() const
+  {
+    return coverage_mask_;
+  }
+
+  /**
+   * @brief Have the node generate a single channel 8-bit coverage mask instead of a color frame
+   *
+   * Text and shapes only really produce coverage in a single color. Rasterizing and uploading an
+   * 8-bit mask is a fraction of the work of a float RGBA frame, and the renderer tints it with
+   * `color` on the GPU. The frame given to Node::GenerateFrame() will have one channel.
+   */
+  void SetCoverageMask(const Color& color)
+  {
+    coverage_mask_ = true;
+    coverage_color_ = color;
+  }
+
+  const Color& GetCoverageColor() const
+  {
+    return coverage_color_;
+  }
+
 private:
   bool alpha_channel_required_;
 
+  bool coverage_mask_;
+
+  Color coverage_color_;
+
 };
 
 }
@@ -21,11 +21,70 @@
 #ifndef SAMPLEJOB_H
 #define SAMPLEJOB_H
 
+#include <algorithm>
+#include <QHash>
+#include <QVector>
+
 #include "acceleratedjob.h"
 #include "codec/samplebuffer.h"
 
 namespace olive {
 
+/**
+ * @brief The value of a numeric parameter across every sample of a SampleJob
+ *
+ * Parameters that don't change across the buffer (e.g. non-keyframed inputs) are stored as a
+ * single value so nodes can take a faster path for them.
+ */
+class SampleParamCurve {
+public:
+  SampleParamCurve() = default;
+
+  explicit SampleParamCurve(float constant)
+  {
+    values_.append(constant);
+  }
+
+  explicit SampleParamCurve(const QVector<float>& values) :
+    values_(values)
+  {
+    // Collapse curves that end up not changing at all
+    if (values_.size() > 1 && std::all_of(values_.cbegin(), values_.cend(),
+                                          [this](float v){return qFuzzyCompare(v, values_.first());})) {
+      values_.resize(1);
+    }
+  }
+
+  bool IsValid() const
+  {
+    return !values_.isEmpty();
+  }
+
+  bool IsConstant() const
+  {
+    return values_.size() == 1;
+  }
+
+  float at(int index) const
+  {
+    return IsConstant() ? values_.first() : values_.at(index);
+  }
+
+  /**
+   * @brief Direct access to the per-sample values, only valid if IsConstant() is FALSE
+   */
+  const float* data() const
+  {
+    return values_.constData();
+  }
+
+private:
+  QVector<float> values_;
+
+};
+
+using SampleParamCurveMap = QHash<QString, SampleParamCurve>;
+
 class SampleJob : public AcceleratedJob {
 public:
   SampleJob()
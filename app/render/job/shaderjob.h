@@ -22,6 +22,8 @@
 #define SHADERJOB_H
 
 #include <QMatrix4x4>
+#include <QRectF>
+#include <QVector>
 
 #include "generatejob.h"
 #include "render/texture.h"
@@ -34,6 +36,7 @@ public:
   {
     iterations_ = 1;
     iterative_input_ = nullptr;
+    gpu_timing_tag_ = 0;
   }
 
   const QString& GetShaderID() const
@@ -82,6 +85,67 @@ public:
     interpolation_.insert(id, interp);
   }
 
+  /**
+   * @brief Area of the output the shader can write anything other than transparency to
+   *
+   * In normalized texture coordinates. The renderer is free to skip running the shader outside
+   * of it. A null rect (the default) means the shader can affect the whole output.
+   */
+  const QRectF& GetBounds() const
+  {
+    return bounds_;
+  }
+
+  void SetBounds(const QRectF& bounds)
+  {
+    bounds_ = bounds;
+  }
+
+  /**
+   * @brief Triangles to draw instead of a quad covering the whole output
+   *
+   * `positions` are pairs of normalized texture coordinates, three vertices per triangle.
+   * `texcoords` has a pair for each vertex too and is what the shader receives as ove_texcoord.
+   * Anything no triangle covers is left transparent. Empty (the default) draws the whole output.
+   */
+  const QVector<float>& GetVertexPositions() const
+  {
+    return vertex_positions_;
+  }
+
+  const QVector<float>& GetVertexTexCoords() const
+  {
+    return vertex_texcoords_;
+  }
+
+  void SetVertices(const QVector<float>& positions, const QVector<float>& texcoords)
+  {
+    vertex_positions_ = positions;
+    vertex_texcoords_ = texcoords;
+  }
+
+  /**
+   * @brief Ask the renderer to time this job on the GPU and report it against this node and frame
+   *
+   * `tag` comes from RenderManager::CreateGPUTimingTag(), 0 (the default) doesn't time the job.
+   * \see RenderManager::ReportGPUPass()
+   */
+  void SetGPUTiming(const QString& node_id, quint64 tag)
+  {
+    gpu_timing_node_ = node_id;
+    gpu_timing_tag_ = tag;
+  }
+
+  const QString& GetGPUTimingNode() const
+  {
+    return gpu_timing_node_;
+  }
+
+  quint64 GetGPUTimingTag() const
+  {
+    return gpu_timing_tag_;
+  }
+
 private:
   QString shader_id_;
 
@@ -91,6 +155,16 @@ private:
 
   QHash<QString, Texture::Interpolation> interpolation_;
 
+  QRectF bounds_;
+
+  QVector<float> vertex_positions_;
+
+  QVector<float> vertex_texcoords_;
+
+  QString gpu_timing_node_;
+
+  quint64 gpu_timing_tag_;
+
 };
 
 }
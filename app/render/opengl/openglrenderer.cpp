@@ -23,6 +23,9 @@
 #include <QDebug>
 #include <QOpenGLExtraFunctions>
 
+#include "common/tracer.h"
+#include "render/rendermanager.h"
+
 namespace olive {
 
 const QVector<GLfloat> blit_vertices = {
@@ -75,8 +78,14 @@ private:
 
 OpenGLRenderer::OpenGLRenderer(QObject* parent) :
   Renderer(parent),
-  context_(nullptr)
+  context_(nullptr),
+  share_(nullptr),
+  upload_buffer_index_(0),
+  gpu_timers_supported_(true)
 {
+  for (int i=0; i<kUploadBufferCount; i++) {
+    upload_buffers_[i] = {0, 0};
+  }
 }
 
 OpenGLRenderer::~OpenGLRenderer()
@@ -105,16 +114,39 @@ bool OpenGLRenderer::Init()
   surface_.create();
 
   context_ = new QOpenGLContext(this);
+
+  if (share_) {
+    context_->setShareContext(share_->context_);
+  } else if (QOpenGLContext::globalShareContext()) {
+    // Share with display widgets too so they can draw our textures without a round trip through
+    // system memory
+    context_->setShareContext(QOpenGLContext::globalShareContext());
+  }
+
   if (!context_->create()) {
     qCritical() << "Failed to create OpenGL context";
     return false;
   }
 
+  if (share_ && !context_->shareContext()) {
+    qCritical() << "Failed to share OpenGL context";
+    delete context_;
+    context_ = nullptr;
+    return false;
+  }
+
   context_->moveToThread(this->thread());
 
   return true;
 }
 
+bool OpenGLRenderer::SharesWithDisplay() const
+{
+  QOpenGLContext* global = QOpenGLContext::globalShareContext();
+
+  return context_ && global && QOpenGLContext::areSharing(context_, global);
+}
+
 void OpenGLRenderer::PostDestroy()
 {
   // Destroy surface if we created it
@@ -138,6 +170,11 @@ void OpenGLRenderer::PostInit()
 
   // Set up framebuffer used for various things
   functions_->glGenFramebuffers(1, &framebuffer_);
+
+  // Set up pixel buffers used for uploading, these are sized on first use
+  for (int i=0; i<kUploadBufferCount; i++) {
+    functions_->glGenBuffers(1, &upload_buffers_[i].id);
+  }
 }
 
 void OpenGLRenderer::DestroyInternal()
@@ -146,6 +183,19 @@ void OpenGLRenderer::DestroyInternal()
     // Delete framebuffer
     functions_->glDeleteFramebuffers(1, &framebuffer_);
 
+    // Delete pixel buffers
+    for (int i=0; i<kUploadBufferCount; i++) {
+      functions_->glDeleteBuffers(1, &upload_buffers_[i].id);
+      upload_buffers_[i] = {0, 0};
+    }
+
+    foreach (const PixelBuffer& b, free_download_buffers_) {
+      functions_->glDeleteBuffers(1, &b.id);
+    }
+    free_download_buffers_.clear();
+
+    DestroyGPUTimers();
+
     // Delete context if it belongs to us
     if (context_->parent() == this) {
       delete context_;
@@ -260,12 +310,24 @@ QVariant OpenGLRenderer::CreateNativeShader(ShaderCode code)
   vert_code.prepend(shader_preamble);
   frag_code.prepend(shader_preamble);
 
+#if QT_VERSION >= QT_VERSION_CHECK(5, 9, 0)
+  // Cacheable shaders are only compiled if Qt's on-disk program binary cache (keyed by the source
+  // and the driver's vendor, renderer and version) has no match, so effects used in previous
+  // sessions link straight from the stored binary
+  if (!program->addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, vert_code)) {
+    qCritical() << "Failed to add vertex code to shader";
+    goto error;
+  }
+
+  if (!program->addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, frag_code)) {
+#else
   if (!program->addShaderFromSourceCode(QOpenGLShader::Vertex, vert_code)) {
     qCritical() << "Failed to add vertex code to shader";
     goto error;
   }
 
   if (!program->addShaderFromSourceCode(QOpenGLShader::Fragment, frag_code)) {
+#endif
     qCritical() << "Failed to add fragment code to shader";
     goto error;
   }
@@ -302,10 +364,39 @@ void OpenGLRenderer::UploadToTexture(Texture *texture, const void *data, int lin
 
   functions_->glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize);
 
-  functions_->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
-                              p.effective_width(), p.effective_height(),
-                              GetPixelFormat(p.channel_count()), GetPixelType(p.format()),
-                              data);
+  // Copy into a pixel buffer so the transfer to the texture can happen asynchronously. Orphaning the
+  // buffer's storage means we never wait on a transfer that's still using it.
+  PixelBuffer& buffer = upload_buffers_[upload_buffer_index_];
+  upload_buffer_index_ = (upload_buffer_index_ + 1) % kUploadBufferCount;
+
+  int size = linesize * p.effective_height() * p.GetBytesPerPixel();
+
+  functions_->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+  functions_->glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  buffer.size = size;
+
+  void* mapped = context_->extraFunctions()->glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                                              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+  if (mapped) {
+    memcpy(mapped, data, size);
+    context_->extraFunctions()->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    functions_->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                                p.effective_width(), p.effective_height(),
+                                GetPixelFormat(p.channel_count()), GetPixelType(p.format()),
+                                nullptr);
+
+    functions_->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  } else {
+    // Fall back to uploading directly from client memory
+    functions_->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    functions_->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+                                p.effective_width(), p.effective_height(),
+                                GetPixelFormat(p.channel_count()), GetPixelType(p.format()),
+                                data);
+  }
 
   functions_->glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 
@@ -341,6 +432,145 @@ void OpenGLRenderer::DownloadFromTexture(Texture* texture, void *data, int lines
   functions_->glBindTexture(GL_TEXTURE_2D, current_tex);
 }
 
+QVariant OpenGLRenderer::BeginDownloadFromTexture(Texture *texture, int linesize)
+{
+  const VideoParams& p = texture->params();
+
+  GLenum read_format = (QOpenGLContext::openGLModuleType() == QOpenGLContext::LibGLES) ? GL_RGBA : GetPixelFormat(p.channel_count());
+
+  return BeginDownloadInternal(texture, QRect(0, 0, p.width(), p.height()), linesize, read_format);
+}
+
+QVariant OpenGLRenderer::BeginDownloadRegionFromTexture(Texture *texture, const QRect &region)
+{
+  return BeginDownloadInternal(texture, region, region.width(), GL_RGBA);
+}
+
+QVariant OpenGLRenderer::BeginDownloadInternal(Texture *texture, const QRect &region, int linesize, GLenum read_format)
+{
+  const VideoParams& p = texture->params();
+
+  int read_channels = (read_format == GL_RGBA) ? VideoParams::kRGBAChannelCount : p.channel_count();
+  int size = linesize * region.height() * VideoParams::GetBytesPerPixel(p.format(), read_channels);
+
+  PendingDownload* download = new PendingDownload();
+  download->buffer = TakeDownloadBuffer(size);
+
+  GLint current_tex;
+  functions_->glGetIntegerv(GL_TEXTURE_BINDING_2D, &current_tex);
+
+  AttachTextureAsDestination(texture);
+
+  functions_->glPixelStorei(GL_PACK_ROW_LENGTH, linesize);
+
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, download->buffer.id);
+
+  {
+    PRINT_GL_ERRORS;
+
+    // With a pack buffer bound this returns immediately, the data is copied into the buffer later
+    functions_->glReadPixels(region.x(),
+                             region.y(),
+                             region.width(),
+                             region.height(),
+                             read_format,
+                             GetPixelType(p.format()),
+                             nullptr);
+  }
+
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  functions_->glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+
+  DetachTextureAsDestination();
+
+  functions_->glBindTexture(GL_TEXTURE_2D, current_tex);
+
+  download->fence = context_->extraFunctions()->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  // Make sure the commands actually get submitted so the fence can signal while we do other things
+  functions_->glFlush();
+
+  return Node::PtrToValue(download);
+}
+
+void OpenGLRenderer::FinishDownloadFromTexture(QVariant download_handle, void *data)
+{
+  PendingDownload* download = Node::ValueToPtr<PendingDownload>(download_handle);
+  QOpenGLExtraFunctions* xf = context_->extraFunctions();
+
+  if (download->fence) {
+    // Wait in 1ms increments, in practice the transfer is usually done by the time we get here
+    while (xf->glClientWaitSync(download->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+
+    xf->glDeleteSync(download->fence);
+  }
+
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, download->buffer.id);
+
+  void* mapped = xf->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, download->buffer.size, GL_MAP_READ_BIT);
+
+  if (mapped) {
+    memcpy(data, mapped, download->buffer.size);
+    xf->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  } else {
+    qWarning() << "Failed to map pixel buffer for texture download";
+  }
+
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  // Keep the buffer around for the next download
+  if (free_download_buffers_.size() < kMaxFreeDownloadBuffers) {
+    free_download_buffers_.append(download->buffer);
+  } else {
+    functions_->glDeleteBuffers(1, &download->buffer.id);
+  }
+
+  delete download;
+}
+
+void OpenGLRenderer::Flush()
+{
+  functions_->glFinish();
+
+  // Everything has finished so nothing here waits
+  CollectGPUTimers(true);
+}
+
+OpenGLRenderer::PixelBuffer OpenGLRenderer::TakeDownloadBuffer(int size)
+{
+  PixelBuffer buffer;
+
+  // Reuse a free buffer if there is one, preferring one that's already the right size
+  int index = -1;
+  for (int i=0; i<free_download_buffers_.size(); i++) {
+    if (free_download_buffers_.at(i).size == size) {
+      index = i;
+      break;
+    }
+  }
+
+  if (index == -1 && !free_download_buffers_.isEmpty()) {
+    index = 0;
+  }
+
+  if (index >= 0) {
+    buffer = free_download_buffers_.takeAt(index);
+  } else {
+    functions_->glGenBuffers(1, &buffer.id);
+    buffer.size = 0;
+  }
+
+  if (buffer.size != size) {
+    functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.id);
+    functions_->glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    buffer.size = size;
+  }
+
+  return buffer;
+}
+
 struct TextureToBind {
   TexturePtr texture;
   Texture::Interpolation interpolation;
@@ -481,17 +711,38 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
   vao_.create();
   vao_.bind();
 
+  // Draw the job's own triangles if it has any, otherwise a quad covering the destination
+  QVector<GLfloat> job_vertices;
+  const QVector<GLfloat>* vertices = &blit_vertices;
+  const QVector<GLfloat>* texcoords = &blit_texcoords;
+
+  if (!job.GetVertexPositions().isEmpty()) {
+    const QVector<float>& positions = job.GetVertexPositions();
+
+    job_vertices.resize(positions.size() / 2 * 3);
+
+    for (int i=0, j=0; i+1<positions.size(); i+=2, j+=3) {
+      // Texture coordinates to clip space
+      job_vertices[j] = positions.at(i) * 2.0f - 1.0f;
+      job_vertices[j+1] = positions.at(i+1) * 2.0f - 1.0f;
+      job_vertices[j+2] = 0.0f;
+    }
+
+    vertices = &job_vertices;
+    texcoords = &job.GetVertexTexCoords();
+  }
+
   // Set buffers
   QOpenGLBuffer vert_vbo_;
   vert_vbo_.create();
   vert_vbo_.bind();
-  vert_vbo_.allocate(blit_vertices.constData(), blit_vertices.size() * sizeof(GLfloat));
+  vert_vbo_.allocate(vertices->constData(), vertices->size() * sizeof(GLfloat));
   vert_vbo_.release();
 
   QOpenGLBuffer frag_vbo_;
   frag_vbo_.create();
   frag_vbo_.bind();
-  frag_vbo_.allocate(blit_texcoords.constData(), blit_texcoords.size() * sizeof(GLfloat));
+  frag_vbo_.allocate(texcoords->constData(), texcoords->size() * sizeof(GLfloat));
   frag_vbo_.release();
 
   int vertex_location = shader->attributeLocation("a_position");
@@ -530,6 +781,8 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
     }
   }
 
+  QOpenGLTimerQuery* gpu_timer = BeginGPUTimer(job);
+
   for (int iteration=0; iteration<real_iteration_count; iteration++) {
     // Set iteration number
     shader->setUniformValue("ove_iteration", iteration);
@@ -570,10 +823,26 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
     // Blit this texture through this shader
     {
       PRINT_GL_ERRORS;
-      functions_->glDrawArrays(GL_TRIANGLES, 0, blit_vertices.size() / 3);
+
+      // Enabled after clearing since glClear() is restricted by the scissor too
+      const QRect& roi = region_of_interest();
+      if (!roi.isNull()) {
+        functions_->glEnable(GL_SCISSOR_TEST);
+        functions_->glScissor(roi.x(), roi.y(), roi.width(), roi.height());
+      }
+
+      functions_->glDrawArrays(GL_TRIANGLES, 0, vertices->size() / 3);
+
+      if (!roi.isNull()) {
+        functions_->glDisable(GL_SCISSOR_TEST);
+      }
     }
   }
 
+  if (gpu_timer) {
+    gpu_timer->end();
+  }
+
   if (destination) {
     // Reset framebuffer to default if we were drawing to a texture
     DetachTextureAsDestination();
@@ -712,4 +981,73 @@ void OpenGLRenderer::PrepareInputTexture(GLenum target, Texture::Interpolation i
   functions_->glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 }
 
+QOpenGLTimerQuery *OpenGLRenderer::BeginGPUTimer(const ShaderJob &job)
+{
+  // Results from earlier passes are usually ready by now
+  CollectGPUTimers();
+
+  if (!job.GetGPUTimingTag() || !gpu_timers_supported_) {
+    return nullptr;
+  }
+
+  if (pending_gpu_timers_.size() >= kMaxPendingGPUTimers) {
+    // The GPU is far enough behind that we'd rather lose timings than wait for it
+    return nullptr;
+  }
+
+  QOpenGLTimerQuery* query;
+
+  if (free_gpu_timers_.isEmpty()) {
+    query = new QOpenGLTimerQuery(this);
+
+    if (!query->create()) {
+      qWarning() << "GPU timer queries aren't supported, shader passes won't be timed";
+      delete query;
+      gpu_timers_supported_ = false;
+      return nullptr;
+    }
+  } else {
+    query = free_gpu_timers_.takeLast();
+  }
+
+  query->begin();
+
+  pending_gpu_timers_.append({query, job.GetGPUTimingNode(), job.GetShaderID(), job.GetGPUTimingTag(), Tracer::Now()});
+
+  return query;
+}
+
+void OpenGLRenderer::CollectGPUTimers(bool wait)
+{
+  // Queries complete in the order they were submitted
+  while (!pending_gpu_timers_.isEmpty()) {
+    const PendingGPUTimer& t = pending_gpu_timers_.first();
+
+    if (!wait && !t.query->isResultAvailable()) {
+      break;
+    }
+
+    qint64 ns = static_cast<qint64>(t.query->waitForResult());
+
+    if (RenderManager::instance()) {
+      RenderManager::instance()->ReportGPUPass(t.tag, t.node_id, t.shader_id, t.submitted, ns);
+    }
+
+    free_gpu_timers_.append(t.query);
+    pending_gpu_timers_.removeFirst();
+  }
+}
+
+void OpenGLRenderer::DestroyGPUTimers()
+{
+  // Anything still pending is lost with the context
+  foreach (const PendingGPUTimer& t, pending_gpu_timers_) {
+    free_gpu_timers_.append(t.query);
+  }
+  pending_gpu_timers_.clear();
+
+  qDeleteAll(free_gpu_timers_);
+  free_gpu_timers_.clear();
+}
+
 }
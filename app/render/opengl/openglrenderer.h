@@ -25,6 +25,7 @@
 #include <QOpenGLBuffer>
 #include <QOpenGLFunctions>
 #include <QOpenGLShader>
+#include <QOpenGLTimerQuery>
 #include <QOpenGLVertexArrayObject>
 #include <QThread>
 
@@ -42,8 +43,23 @@ public:
 
   void Init(QOpenGLContext* existing_ctx);
 
+  /**
+   * @brief Share textures, buffers and shaders with another renderer
+   *
+   * Must be called before Init(). Init() fails if the contexts can't be shared.
+   */
+  void SetShareRenderer(OpenGLRenderer* share)
+  {
+    share_ = share;
+  }
+
   virtual bool Init() override;
 
+  /**
+   * @brief Returns TRUE if this renderer shares resources with display widgets' contexts
+   */
+  bool SharesWithDisplay() const;
+
   virtual void PostDestroy() override;
 
 public slots:
@@ -66,6 +82,14 @@ public slots:
 
   virtual void DownloadFromTexture(olive::Texture* texture, void* data, int linesize) override;
 
+  virtual QVariant BeginDownloadFromTexture(olive::Texture* texture, int linesize) override;
+
+  virtual QVariant BeginDownloadRegionFromTexture(olive::Texture* texture, const QRect& region) override;
+
+  virtual void FinishDownloadFromTexture(QVariant download, void* data) override;
+
+  virtual void Flush() override;
+
 protected slots:
   virtual void Blit(QVariant shader,
                     olive::ShaderJob job,
@@ -86,14 +110,74 @@ private:
 
   void PrepareInputTexture(GLenum target, Texture::Interpolation interp);
 
+  struct PixelBuffer {
+    GLuint id;
+    int size;
+  };
+
+  struct PendingDownload {
+    PixelBuffer buffer;
+    GLsync fence;
+  };
+
+  PixelBuffer TakeDownloadBuffer(int size);
+
+  QVariant BeginDownloadInternal(Texture* texture, const QRect& region, int linesize, GLenum read_format);
+
+  /**
+   * @brief Start timing a Blit() on the GPU if the job asked for it, returns nullptr if it's not timed
+   */
+  QOpenGLTimerQuery* BeginGPUTimer(const ShaderJob& job);
+
+  /**
+   * @brief Report every GPU timer whose result is ready, stopping at the first that isn't
+   *
+   * Never waits on the GPU unless `wait` is TRUE.
+   */
+  void CollectGPUTimers(bool wait = false);
+
+  void DestroyGPUTimers();
+
   QOpenGLContext* context_;
 
+  OpenGLRenderer* share_;
+
   QOpenGLFunctions* functions_;
 
   QOffscreenSurface surface_;
 
   GLuint framebuffer_;
 
+  /// Uploads alternate between two buffers so one can be filled while the other is transferring
+  static const int kUploadBufferCount = 2;
+  PixelBuffer upload_buffers_[kUploadBufferCount];
+  int upload_buffer_index_;
+
+  /// Download buffers that finished transferring and can be reused
+  QVector<PixelBuffer> free_download_buffers_;
+
+  /// Number of idle download buffers that are kept rather than deleted
+  static const int kMaxFreeDownloadBuffers = 4;
+
+  struct PendingGPUTimer {
+    QOpenGLTimerQuery* query;
+    QString node_id;
+    QString shader_id;
+    quint64 tag;
+    qint64 submitted;
+  };
+
+  /// Timers that were submitted and haven't been reported yet, oldest first
+  QList<PendingGPUTimer> pending_gpu_timers_;
+
+  QVector<QOpenGLTimerQuery*> free_gpu_timers_;
+
+  /// Set to FALSE if the context turns out not to support timer queries
+  bool gpu_timers_supported_;
+
+  /// Passes stop being timed if this many are waiting on the GPU rather than stalling for them
+  static const int kMaxPendingGPUTimers = 64;
+
 };
 
 }
@@ -1,75 +1,227 @@
 #include "previewautocacher.h"
 
 #include <QApplication>
+#include <QMatrix4x4>
 #include <QtConcurrent/QtConcurrent>
 
+#include "common/timecodefunctions.h"
+#include "node/input/nested/nestedsequence.h"
 #include "project/item/sequence/sequence.h"
 #include "project/project.h"
+#include "render/framememorycache.h"
+#include "render/remoteframecache.h"
 #include "render/rendermanager.h"
 #include "render/renderprocessor.h"
 
 namespace olive {
 
+const int PreviewAutoCacher::kMaxRetiredSnapshots = 2;
+const int64_t PreviewAutoCacher::kHashChunkFrames = 240;
+QHash<ViewerOutput*, PreviewAutoCacher*> PreviewAutoCacher::instances_;
+
 PreviewAutoCacher::PreviewAutoCacher() :
+  snapshot_(nullptr),
   viewer_node_(nullptr),
-  paused_(false),
+  direct_preview_(false),
   has_changed_(false),
   use_custom_range_(false),
-  single_frame_render_(nullptr),
   last_update_time_(0),
   ignore_next_mouse_button_(false),
   video_params_changed_(false),
   audio_params_changed_(false),
-  color_manager_(nullptr)
+  nested_sequence_changed_(false)
 {
-  // Set default autocache range
-  SetPlayhead(rational());
-
   delayed_requeue_timer_.setInterval(Config::Current()[QStringLiteral("AutoCacheDelay")].toInt());
   delayed_requeue_timer_.setSingleShot(true);
   connect(&delayed_requeue_timer_, &QTimer::timeout, this, &PreviewAutoCacher::RequeueFrames);
+
+  // Runs once the downloads that finished in the current event have all been handled
+  validate_timer_.setInterval(0);
+  validate_timer_.setSingleShot(true);
+  connect(&validate_timer_, &QTimer::timeout, this, &PreviewAutoCacher::ValidateDownloadedFrames);
+
+  connect(RenderManager::instance(), &RenderManager::GPUFrameTimed, this, &PreviewAutoCacher::GPUFrameTimed);
 }
 
-RenderTicketPtr PreviewAutoCacher::GetSingleFrame(const rational &t)
+PreviewAutoCacher *PreviewAutoCacher::Acquire(ViewerOutput *viewer, QObject *client)
 {
-  if (single_frame_render_) {
-    single_frame_render_->Cancel();
+  PreviewAutoCacher* cacher = instances_.value(viewer);
+
+  if (!cacher) {
+    cacher = new PreviewAutoCacher();
+    cacher->SetViewerNode(viewer);
+    instances_.insert(viewer, cacher);
   }
 
-  single_frame_render_ = std::make_shared<RenderTicket>();
+  cacher->clients_.insert(client, Client());
+
+  // Set default autocache range
+  cacher->SetPlayhead(client, rational());
+
+  return cacher;
+}
+
+void PreviewAutoCacher::Release(PreviewAutoCacher *cacher, QObject *client)
+{
+  if (!cacher->clients_.contains(client)) {
+    return;
+  }
+
+  cacher->CancelSingleFrame(cacher->clients_[client]);
+  cacher->ClearPlaybackQueue(client);
+  cacher->clients_.remove(client);
+
+  if (cacher->clients_.isEmpty()) {
+    instances_.remove(cacher->viewer_node_);
+    cacher->SetViewerNode(nullptr);
+    delete cacher;
+  } else {
+    // The range around this client's playhead may no longer be wanted
+    cacher->has_changed_ = true;
+    cacher->RequeueFrames();
+  }
+}
+
+RenderTicketPtr PreviewAutoCacher::GetSingleFrame(QObject *client, const rational &t, const QRect &region, bool best_effort)
+{
+  Client& c = clients_[client];
+
+  CancelSingleFrame(c);
+
+  c.single_frame_render = std::make_shared<RenderTicket>();
 
-  single_frame_render_->setProperty("time", QVariant::fromValue(t));
+  c.single_frame_render->setProperty("time", QVariant::fromValue(t));
+  c.single_frame_render->setProperty("region", region);
+  c.single_frame_render->setProperty("besteffort", best_effort);
 
   // Copy because TryRender() might set this to null and we still want to return a handle to this
-  RenderTicketPtr copy = single_frame_render_;
+  RenderTicketPtr copy = c.single_frame_render;
 
   TryRender();
 
   return copy;
 }
 
-void PreviewAutoCacher::SetPaused(bool paused)
+RenderTicketPtr PreviewAutoCacher::GetPlaybackFrame(QObject *client, const rational &t, int divider)
 {
-  paused_ = paused;
+  RenderTicketPtr ticket = std::make_shared<RenderTicket>();
 
-  if (paused_) {
+  ticket->setProperty("time", QVariant::fromValue(t));
+  ticket->setProperty("divider", divider);
+
+  clients_[client].pending_playback_frames.append(ticket);
+
+  TryRender();
+
+  return ticket;
+}
+
+AudioLiveMixDevice *PreviewAutoCacher::CreateLiveAudioDevice()
+{
+  if (!viewer_node_) {
+    return nullptr;
+  }
+
+  // Apply any queued graph changes so the device hears the latest edit
+  TryRender();
+
+  AudioPlaybackCache* cache = viewer_node_->audio_playback_cache();
+
+  AudioLiveMixDevice* device = new AudioLiveMixDevice(snapshot_->viewer, cache->GetParameters(), cache->GetLength());
+
+  PinSnapshot(device);
+  live_audio_devices_.insert(device);
+
+  // Devices are usually destroyed on the audio output's thread, so this is queued back to ours
+  connect(device, &QObject::destroyed, this, [this, device]{
+    live_audio_devices_.remove(device);
+    ReleaseSnapshot(device);
+  });
+
+  return device;
+}
+
+void PreviewAutoCacher::SetPaused(QObject *client, bool paused)
+{
+  clients_[client].paused = paused;
+
+  if (!HasActiveClients()) {
     // Pause the autocache
     ClearVideoQueue();
   } else {
-    // Unpause the cache
+    // Unpause the cache, or drop this client's range from it
+    has_changed_ = true;
     RequeueFrames();
   }
 }
 
+void PreviewAutoCacher::SetColorManager(QObject *client, ColorManager *manager)
+{
+  clients_[client].color_manager = manager;
+}
+
+bool PreviewAutoCacher::HasActiveClients() const
+{
+  foreach (const Client& c, clients_) {
+    if (!c.paused) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+ColorManager *PreviewAutoCacher::GetCacheColorManager() const
+{
+  foreach (const Client& c, clients_) {
+    if (c.color_manager) {
+      return c.color_manager;
+    }
+  }
+
+  return nullptr;
+}
+
+void PreviewAutoCacher::CancelSingleFrame(Client &client)
+{
+  if (client.single_frame_render) {
+    client.single_frame_render->Cancel();
+    client.single_frame_render = nullptr;
+  }
+
+  if (client.single_frame_watcher) {
+    // Stop the one already rendering too, it'll finish as cancelled
+    client.single_frame_watcher->Cancel();
+    client.single_frame_watcher = nullptr;
+  }
+}
+
+bool PreviewAutoCacher::IsAheadOfPlayhead(const rational &time) const
+{
+  foreach (const Client& c, clients_) {
+    if (!c.paused && time >= c.playhead) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 void PreviewAutoCacher::NodeGraphChanged(NodeInput *source)
 {
+  // Changes with no source (e.g. a nested sequence's viewer being reconnected) are picked up by
+  // copying the whole graph again, see NestedSequenceChanged()
+  if (!source) {
+    return;
+  }
+
   // We need to determine:
   // - If we don't have this input, assume that it's coming soon and ignore it
   // - If we do, is this input a child of another input we're already copying?
   // - Or are any of the queued inputs children of this one?
 
   // First we need to find our copy of the input being queued
-  Node* our_copy_node = copy_map_.value(source->parentNode());
+  Node* our_copy_node = snapshot_->copy_map.value(source->parentNode());
 
   // If we don't have this node yet, assume it's coming in a later copy in which case it'll be
   // copied then
@@ -114,31 +266,101 @@ void PreviewAutoCacher::NodeGraphChanged(NodeInput *source)
   connect(source, &NodeInput::destroyed, this, &PreviewAutoCacher::QueuedInputRemoved);
 }
 
-void PreviewAutoCacher::GenerateHashes(ViewerOutput *viewer, FrameHashCache* cache, const QVector<rational> &times, qint64 job_time)
+void PreviewAutoCacher::GenerateHashes(ViewerOutput *viewer, FrameHashCache* cache, const TimeRangeList &ranges, const rational &timebase, qint64 job_time)
 {
   std::vector<QByteArray> existing_hashes;
 
-  foreach (const rational& time, times) {
-    // See if hash already exists in disk cache
-    QByteArray hash = RenderManager::Hash(viewer->texture_input()->get_connected_node(), viewer->video_params(), time);
+  Node* node = viewer->texture_input()->get_connected_node();
 
-    // Check memory list since disk checking is slow
-    bool hash_exists = (std::find(existing_hashes.begin(), existing_hashes.end(), hash) != existing_hashes.end());
+  // Returns TRUE if every frame in [a, b) will have the same hash
+  auto is_constant = [node, &timebase](int64_t a, int64_t b) {
+    return !node || node->IsHashConstantOver(TimeRange(Timecode::timestamp_to_time(a, timebase),
+                                                       Timecode::timestamp_to_time(b, timebase)));
+  };
 
-    if (!hash_exists) {
-      hash_exists = QFileInfo::exists(cache->CachePathName(hash));
+  foreach (const TimeRange& range, ranges) {
+    // Snap range outwards to whole frames
+    int64_t start_ts = Timecode::time_to_timestamp(range.in(), timebase);
+    if (Timecode::timestamp_to_time(start_ts, timebase) > range.in()) {
+      start_ts--;
+    }
 
-      if (hash_exists) {
-        existing_hashes.push_back(hash);
-      }
+    int64_t end_ts = Timecode::time_to_timestamp(range.out(), timebase);
+    if (Timecode::timestamp_to_time(end_ts, timebase) < range.out()) {
+      end_ts++;
     }
 
-    // Set hash in FrameHashCache's thread rather than in ours to prevent race conditions
-    QMetaObject::invokeMethod(cache, "SetHash", Qt::QueuedConnection,
-                              OLIVE_NS_ARG(rational, time),
-                              Q_ARG(QByteArray, hash),
-                              Q_ARG(qint64, job_time),
-                              Q_ARG(bool, hash_exists));
+    int64_t ts = start_ts;
+
+    while (ts < end_ts) {
+      // Find how many frames from here share a hash. The run is grown exponentially to find an
+      // upper bound and then narrowed down, so long constant stretches only take a few checks.
+      int64_t run = 1;
+      int64_t remaining = end_ts - ts;
+
+      if (remaining > 1 && is_constant(ts, ts + 2)) {
+        int64_t good = 2;
+        int64_t bad = 0;
+
+        while (good < remaining) {
+          int64_t attempt = qMin(good * 2, remaining);
+
+          if (is_constant(ts, ts + attempt)) {
+            good = attempt;
+          } else {
+            bad = attempt;
+            break;
+          }
+        }
+
+        if (bad) {
+          while (bad - good > 1) {
+            int64_t mid = good + (bad - good) / 2;
+
+            if (is_constant(ts, ts + mid)) {
+              good = mid;
+            } else {
+              bad = mid;
+            }
+          }
+        }
+
+        run = good;
+      }
+
+      rational time = Timecode::timestamp_to_time(ts, timebase);
+
+      // See if hash already exists in disk cache
+      QByteArray hash = RenderManager::Hash(node, viewer->video_params(), time);
+
+      // Check memory list since disk checking is slow
+      bool hash_exists = (std::find(existing_hashes.begin(), existing_hashes.end(), hash) != existing_hashes.end());
+
+      if (!hash_exists) {
+        hash_exists = cache->HasCacheFrame(hash);
+
+        if (hash_exists) {
+          existing_hashes.push_back(hash);
+        }
+      }
+
+      // Set hash in FrameHashCache's thread rather than in ours to prevent race conditions
+      if (run == 1) {
+        QMetaObject::invokeMethod(cache, "SetHash", Qt::QueuedConnection,
+                                  OLIVE_NS_ARG(rational, time),
+                                  Q_ARG(QByteArray, hash),
+                                  Q_ARG(qint64, job_time),
+                                  Q_ARG(bool, hash_exists));
+      } else {
+        QMetaObject::invokeMethod(cache, "SetHashRange", Qt::QueuedConnection,
+                                  OLIVE_NS_ARG(TimeRange, TimeRange(time, Timecode::timestamp_to_time(ts + run, timebase))),
+                                  Q_ARG(QByteArray, hash),
+                                  Q_ARG(qint64, job_time),
+                                  Q_ARG(bool, hash_exists));
+      }
+
+      ts += run;
+    }
   }
 }
 
@@ -146,6 +368,11 @@ void PreviewAutoCacher::VideoInvalidated(const TimeRange &range)
 {
   ClearQueue(false);
 
+  if (direct_preview_) {
+    // Frames are rendered on request, there's nothing to hash ahead of time
+    return;
+  }
+
   // Hash these frames since that should be relatively quick.
   if (ignore_next_mouse_button_ || !(qApp->mouseButtons() & Qt::LeftButton)) {
     ignore_next_mouse_button_ = false;
@@ -160,6 +387,11 @@ void PreviewAutoCacher::AudioInvalidated(const TimeRange &range)
 {
   ClearQueue(false);
 
+  if (direct_preview_) {
+    // Audio is mixed live as it plays
+    return;
+  }
+
   // Start jobs to re-render the audio at this range, split into 2 second chunks
   invalidated_audio_.insert(range);
 
@@ -170,12 +402,19 @@ void PreviewAutoCacher::HashesProcessed()
 {
   QFutureWatcher<void>* watcher = static_cast<QFutureWatcher<void>*>(sender());
 
+  ReleaseSnapshot(watcher);
+
   if (hash_tasks_.contains(watcher)) {
-    hash_tasks_.removeOne(watcher);
+    hash_tasks_.remove(watcher);
+
+    // This chunk's hashes have all been set by now (they were queued before this signal), so its
+    // frames can be queued without waiting for the rest. The timer isn't restarted if it's already
+    // running, otherwise a steady stream of chunks would keep pushing it back.
+    has_changed_ = true;
 
-    // Restart delayed requeue timer
-    delayed_requeue_timer_.stop();
-    delayed_requeue_timer_.start();
+    if (!delayed_requeue_timer_.isActive()) {
+      delayed_requeue_timer_.start();
+    }
   }
 
   // The cacher might be waiting for this job to finish
@@ -190,19 +429,20 @@ void PreviewAutoCacher::AudioRendered()
 {
   RenderTicketWatcher* watcher = static_cast<RenderTicketWatcher*>(sender());
 
-  if (audio_tasks_.contains(watcher)) {
+  GraphSnapshot* snapshot = GetJobSnapshot(watcher);
+
+  if (audio_tasks_.contains(watcher) && snapshot) {
     if (!watcher->WasCancelled()) {
       viewer_node_->audio_playback_cache()->WritePCM(audio_tasks_.value(watcher),
                                                      watcher->Get().value<SampleBufferPtr>(),
                                                      watcher->GetTicket()->GetJobTime());
 
       // Retrieve visual waveforms
-      QVector<RenderProcessor::RenderedWaveform> waveform_list = watcher->GetTicket()->property("waveforms").value< QVector<RenderProcessor::RenderedWaveform> >();
-      foreach (const RenderProcessor::RenderedWaveform& waveform_info, waveform_list) {
+      foreach (const RenderedWaveform& waveform_info, watcher->GetTicket()->stats().waveforms) {
         // Find original track
         TrackOutput* track = nullptr;
 
-        for (auto it=copy_map_.cbegin(); it!=copy_map_.cend(); it++) {
+        for (auto it=snapshot->copy_map.cbegin(); it!=snapshot->copy_map.cend(); it++) {
           if (it.value() == waveform_info.track) {
             track = static_cast<TrackOutput*>(it.key());
             break;
@@ -226,9 +466,11 @@ void PreviewAutoCacher::AudioRendered()
       }
     }
 
-    audio_tasks_.remove(watcher);
   }
 
+  audio_tasks_.remove(watcher);
+  ReleaseSnapshot(watcher);
+
   // The cacher might be waiting for this job to finish
   if (!graph_update_queue_.isEmpty()) {
     TryRender();
@@ -244,23 +486,50 @@ void PreviewAutoCacher::VideoRendered()
   if (video_tasks_.contains(watcher)) {
     if (watcher->WasCancelled()) {
       // We didn't get this hash
-      currently_caching_hashes_.removeOne(watcher->property("hash").toByteArray());
+      currently_caching_hashes_.remove(watcher->property("hash").toByteArray());
     } else {
       const QByteArray& hash = video_tasks_.value(watcher);
+      FramePtr frame = watcher->Get().value<FramePtr>();
+
+      // Recorded before the frames are validated so the ruler repaints with it
+      const RenderStats& stats = watcher->GetTicket()->stats();
+      viewer_node_->video_frame_cache()->SetRenderCost(hash,
+                                                       qMax(stats.render_time, qint64(0)),
+                                                       stats.decode_time);
+
+      if (stats.gpu_timing_tag) {
+        // Some of the frame's GPU time may already be in, the rest arrives in GPUFrameTimed()
+        qint64 gpu_time = RenderManager::instance()->GetGPUFrameTime(stats.gpu_timing_tag);
+        if (gpu_time > 0) {
+          viewer_node_->video_frame_cache()->SetMeasuredGPUTime(hash, gpu_time);
+        }
+
+        gpu_timed_hashes_.insert(stats.gpu_timing_tag, hash);
 
-      // Download frame in another thread
-      RenderTicketWatcher* w = new RenderTicketWatcher();
-      video_download_tasks_.insert(w, hash);
-      connect(w, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::VideoDownloaded);
-      w->SetTicket(RenderManager::instance()->SaveFrameToCache(viewer_node_->video_frame_cache(),
-                                                               watcher->Get().value<FramePtr>(),
-                                                               hash,
-                                                               true));
+        // Tags only go up, forget the ones RenderManager has stopped keeping
+        if (gpu_timed_hashes_.size() > int(RenderManager::kGPUTimingHistory)) {
+          for (auto it=gpu_timed_hashes_.begin(); it!=gpu_timed_hashes_.end(); ) {
+            if (it.key() + RenderManager::kGPUTimingHistory < stats.gpu_timing_tag) {
+              it = gpu_timed_hashes_.erase(it);
+            } else {
+              it++;
+            }
+          }
+        }
+      }
+
+      CacheFrame(hash, frame);
+
+      if (RemoteFrameCache::instance()->IsEnabled()) {
+        RemoteFrameCache::instance()->Upload(hash, frame);
+      }
     }
 
     video_tasks_.remove(watcher);
   }
 
+  ReleaseSnapshot(watcher);
+
   // The cacher might be waiting for this job to finish
   if (!graph_update_queue_.isEmpty()) {
     TryRender();
@@ -269,6 +538,58 @@ void PreviewAutoCacher::VideoRendered()
   delete watcher;
 }
 
+void PreviewAutoCacher::GPUFrameTimed(quint64 tag, qint64 ns)
+{
+  auto it = gpu_timed_hashes_.constFind(tag);
+
+  if (viewer_node_ && it != gpu_timed_hashes_.constEnd()) {
+    viewer_node_->video_frame_cache()->SetMeasuredGPUTime(it.value(), ns);
+  }
+}
+
+void PreviewAutoCacher::RemoteFrameFetched()
+{
+  RenderTicketWatcher* watcher = static_cast<RenderTicketWatcher*>(sender());
+
+  if (video_tasks_.contains(watcher)) {
+    QByteArray hash = video_tasks_.take(watcher);
+
+    if (watcher->WasCancelled()) {
+      currently_caching_hashes_.remove(hash);
+    } else {
+      FramePtr frame = watcher->Get().value<FramePtr>();
+
+      if (frame) {
+        CacheFrame(hash, frame);
+      } else {
+        // Nobody has rendered this yet, render it ourselves
+        QueueFrameRender(watcher->property("time").value<rational>(), hash);
+      }
+    }
+  }
+
+  // The cacher might be waiting for this job to finish
+  if (!graph_update_queue_.isEmpty()) {
+    TryRender();
+  }
+
+  delete watcher;
+}
+
+void PreviewAutoCacher::CacheFrame(const QByteArray &hash, FramePtr frame)
+{
+  // Keep the frame in memory so it can be shown without waiting for it to be read back from disk
+  FrameMemoryCache::instance()->Insert(hash, frame);
+
+  // Download frame in another thread
+  RenderTicketWatcher* w = new RenderTicketWatcher();
+  video_download_tasks_.insert(w, hash);
+  connect(w, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::VideoDownloaded);
+  w->SetTicket(RenderManager::instance()->SaveFrameToCache(viewer_node_->video_frame_cache(),
+                                                           frame,
+                                                           hash));
+}
+
 void PreviewAutoCacher::VideoDownloaded()
 {
   RenderTicketWatcher* watcher = static_cast<RenderTicketWatcher*>(sender());
@@ -276,11 +597,12 @@ void PreviewAutoCacher::VideoDownloaded()
   if (video_download_tasks_.contains(watcher)) {
     if (!watcher->WasCancelled()) {
       if (watcher->Get().toBool()) {
-        const QByteArray& hash = video_download_tasks_.value(watcher);
-
-        currently_caching_hashes_.removeOne(hash);
+        // Stays in `currently_caching_hashes_` until it's validated so it isn't queued again
+        downloaded_hashes_.append(video_download_tasks_.value(watcher));
 
-        viewer_node_->video_frame_cache()->ValidateFramesWithHash(hash);
+        if (!validate_timer_.isActive()) {
+          validate_timer_.start();
+        }
       } else {
         qCritical() << "Failed to download video frame";
       }
@@ -292,6 +614,25 @@ void PreviewAutoCacher::VideoDownloaded()
   delete watcher;
 }
 
+void PreviewAutoCacher::ValidateDownloadedFrames()
+{
+  validate_timer_.stop();
+
+  if (downloaded_hashes_.isEmpty()) {
+    return;
+  }
+
+  if (viewer_node_) {
+    viewer_node_->video_frame_cache()->ValidateFramesWithHashes(downloaded_hashes_);
+  }
+
+  foreach (const QByteArray& hash, downloaded_hashes_) {
+    currently_caching_hashes_.remove(hash);
+  }
+
+  downloaded_hashes_.clear();
+}
+
 void PreviewAutoCacher::QueuedInputRemoved()
 {
   NodeInput* i = static_cast<NodeInput*>(sender());
@@ -321,6 +662,43 @@ void PreviewAutoCacher::SingleFrameFinished()
   RenderTicketWatcher* watcher = static_cast<RenderTicketWatcher*>(sender());
   RenderTicketPtr passthrough = watcher->property("passthrough").value<RenderTicketPtr>();
   passthrough->Finish(watcher->GetTicket()->Get(), watcher->GetTicket()->WasCancelled());
+
+  for (auto it=clients_.begin(); it!=clients_.end(); it++) {
+    if (it->single_frame_watcher == watcher) {
+      it->single_frame_watcher = nullptr;
+      break;
+    }
+  }
+
+  ReleaseSnapshot(watcher);
+
+  // The cacher might be waiting for this job to finish
+  if (!graph_update_queue_.isEmpty()) {
+    TryRender();
+  }
+
+  delete watcher;
+}
+
+void PreviewAutoCacher::PlaybackFrameFinished()
+{
+  RenderTicketWatcher* watcher = static_cast<RenderTicketWatcher*>(sender());
+  RenderTicketPtr passthrough = watcher->property("passthrough").value<RenderTicketPtr>();
+  passthrough->SetStats(watcher->GetTicket()->stats());
+  passthrough->Finish(watcher->GetTicket()->Get(), watcher->GetTicket()->WasCancelled());
+
+  for (auto it=clients_.begin(); it!=clients_.end(); it++) {
+    if (it->playback_tasks.removeOne(watcher)) {
+      break;
+    }
+  }
+  ReleaseSnapshot(watcher);
+
+  // The cacher might be waiting for this job to finish
+  if (!graph_update_queue_.isEmpty()) {
+    TryRender();
+  }
+
   delete watcher;
 }
 
@@ -349,16 +727,94 @@ void PreviewAutoCacher::ProcessUpdateQueue()
   last_update_time_ = QDateTime::currentMSecsSinceEpoch();
 }
 
-bool PreviewAutoCacher::HasActiveJobs() const
+void PreviewAutoCacher::PublishSnapshot()
+{
+  if (snapshot_) {
+    if (snapshot_->pins > 0) {
+      retired_snapshots_.append(snapshot_);
+    } else {
+      DeleteSnapshot(snapshot_);
+    }
+  }
+
+  // A full copy includes every queued change
+  foreach (NodeInput* i, graph_update_queue_) {
+    disconnect(i, &NodeInput::destroyed, this, &PreviewAutoCacher::QueuedInputRemoved);
+  }
+  graph_update_queue_.clear();
+
+  snapshot_ = new GraphSnapshot();
+  snapshot_->pins = 0;
+  snapshot_->viewer = static_cast<ViewerOutput*>(viewer_node_->copy());
+  snapshot_->copy_map.insert(viewer_node_, snapshot_->viewer);
+
+  // Copy parameters
+  snapshot_->viewer->set_video_params(viewer_node_->video_params());
+  snapshot_->viewer->set_audio_params(viewer_node_->audio_params());
+  video_params_changed_ = false;
+  audio_params_changed_ = false;
+  nested_sequence_changed_ = false;
+
+  // We begin an operation and never end it which prevents the copy from unnecessarily
+  // invalidating its own cache
+  snapshot_->viewer->BeginOperation();
+
+  NodeGraphChanged(viewer_node_->texture_input());
+  NodeGraphChanged(viewer_node_->samples_input());
+  ProcessUpdateQueue();
+}
+
+void PreviewAutoCacher::PinSnapshot(QObject *job)
+{
+  snapshot_->pins++;
+  job_snapshots_.insert(job, snapshot_);
+}
+
+PreviewAutoCacher::GraphSnapshot *PreviewAutoCacher::GetJobSnapshot(QObject *job) const
 {
-  return !hash_tasks_.isEmpty()
-      || !audio_tasks_.isEmpty()
-      || !video_tasks_.isEmpty();
+  return job_snapshots_.value(job);
 }
 
-void PreviewAutoCacher::SetPlayhead(const rational &playhead)
+void PreviewAutoCacher::ReleaseSnapshot(QObject *job)
 {
-  cache_range_ = TimeRange(playhead - Config::Current()["DiskCacheBehind"].value<rational>(),
+  GraphSnapshot* snapshot = job_snapshots_.take(job);
+
+  if (!snapshot) {
+    return;
+  }
+
+  snapshot->pins--;
+
+  if (snapshot->pins == 0 && snapshot != snapshot_) {
+    retired_snapshots_.removeOne(snapshot);
+    DeleteSnapshot(snapshot);
+  }
+}
+
+void PreviewAutoCacher::DeleteSnapshot(GraphSnapshot *snapshot)
+{
+  foreach (Node* c, snapshot->copy_map) {
+    delete c;
+  }
+
+  delete snapshot;
+}
+
+void PreviewAutoCacher::SetPlayhead(QObject *client, const rational &playhead)
+{
+  Client& c = clients_[client];
+
+  // Playback in either direction moves the playhead steadily, so the last move is the best guess
+  // at which way frames will be needed next
+  if (playhead > c.playhead) {
+    c.playhead_direction = 1;
+  } else if (playhead < c.playhead) {
+    c.playhead_direction = -1;
+  }
+
+  c.playhead = playhead;
+
+  c.cache_range = TimeRange(playhead - Config::Current()["DiskCacheBehind"].value<rational>(),
       playhead + Config::Current()["DiskCacheAhead"].value<rational>());
 
   has_changed_ = true;
@@ -379,12 +835,18 @@ void PreviewAutoCacher::ClearHashQueue(bool wait)
   auto copy = hash_tasks_;
 
   for (auto it=copy.cbegin(); it!=copy.cend(); it++) {
-    (*it)->cancel();
+    it.key()->cancel();
   }
   if (wait) {
     copy = hash_tasks_;
     for (auto it=copy.cbegin(); it!=copy.cend(); it++) {
-      (*it)->waitForFinished();
+      it.key()->waitForFinished();
+    }
+  } else {
+    // Chunks that hadn't started yet won't run at all now, so hash their ranges again with the
+    // next batch. Chunks that were already running finish anyway and just get hashed twice.
+    for (auto it=copy.cbegin(); it!=copy.cend(); it++) {
+      invalidated_video_.insert(it.value());
     }
   }
 }
@@ -408,6 +870,33 @@ void PreviewAutoCacher::ClearVideoQueue(bool wait)
   use_custom_range_ = false;
 }
 
+void PreviewAutoCacher::ClearPlaybackQueue(QObject *client, bool wait)
+{
+  auto it = clients_.find(client);
+  if (it == clients_.end()) {
+    return;
+  }
+
+  // Requests that haven't been sent to the renderer yet finish immediately
+  foreach (RenderTicketPtr ticket, it->pending_playback_frames) {
+    ticket->Cancel();
+  }
+  it->pending_playback_frames.clear();
+
+  // Copy because tasks that cancel immediately will be automatically removed from the list
+  auto copy = it->playback_tasks;
+
+  foreach (RenderTicketWatcher* watcher, copy) {
+    watcher->Cancel();
+  }
+  if (wait) {
+    copy = clients_.value(client).playback_tasks;
+    foreach (RenderTicketWatcher* watcher, copy) {
+      watcher->WaitForFinished();
+    }
+  }
+}
+
 void PreviewAutoCacher::ClearAudioQueue(bool wait)
 {
   // Create a copy because otherwise
@@ -443,7 +932,7 @@ void PreviewAutoCacher::ClearVideoDownloadQueue(bool wait)
 void PreviewAutoCacher::CopyNodeInputValue(NodeInput *input)
 {
   // Find our copy of this parameter
-  Node* our_copy_node = copy_map_.value(input->parentNode());
+  Node* our_copy_node = snapshot_->copy_map.value(input->parentNode());
   Q_ASSERT(our_copy_node);
   NodeInput* our_copy = our_copy_node->GetInputWithID(input->id());
 
@@ -461,7 +950,7 @@ void PreviewAutoCacher::CopyNodeInputValue(NodeInput *input)
     // We start by removing all old dependencies from the map
     QVector<Node*> old_deps = our_copy->GetExclusiveDependencies();
     foreach (Node* i, old_deps) {
-      copy_map_.take(copy_map_.key(i))->deleteLater();
+      snapshot_->copy_map.take(snapshot_->copy_map.key(i))->deleteLater();
     }
 
     // And clear any other edges
@@ -484,7 +973,7 @@ void PreviewAutoCacher::CopyNodeInputValue(NodeInput *input)
 Node* PreviewAutoCacher::CopyNodeConnections(Node* src_node)
 {
   // Check if this node is already in the map
-  Node* dst_node = copy_map_.value(src_node);
+  Node* dst_node = snapshot_->copy_map.value(src_node);
 
   // If not, create it now
   if (!dst_node) {
@@ -495,12 +984,17 @@ Node* PreviewAutoCacher::CopyNodeConnections(Node* src_node)
       static_cast<TrackOutput*>(dst_node)->set_track_type(static_cast<TrackOutput*>(src_node)->track_type());
     }
 
-    copy_map_.insert(src_node, dst_node);
+    snapshot_->copy_map.insert(src_node, dst_node);
   }
 
   // Make sure its values are copied
   Node::CopyInputs(src_node, dst_node, false);
 
+  NestedSequence* src_nest = dynamic_cast<NestedSequence*>(src_node);
+  if (src_nest) {
+    CopyNestedSequence(src_nest, static_cast<NestedSequence*>(dst_node));
+  }
+
   // Copy all connections
   QVector<NodeInput*> src_node_inputs = src_node->GetInputsIncludingArrays();
   QVector<NodeInput*> dst_node_inputs = dst_node->GetInputsIncludingArrays();
@@ -526,40 +1020,91 @@ void PreviewAutoCacher::CopyNodeMakeConnection(NodeInput* src_input, NodeInput*
   }
 }
 
-void PreviewAutoCacher::TryRender()
+void PreviewAutoCacher::CopyNestedSequence(NestedSequence *src, NestedSequence *dst)
 {
-  if (!graph_update_queue_.isEmpty()) {
-    if (HasActiveJobs()) {
-      // Still waiting for jobs to finish
-      return;
-    }
+  Node* inner = src->GetInnerNode();
 
-    // No jobs are active, we can process the update queue
-    ProcessUpdateQueue();
+  dst->SetInnerNodeCopy(inner ? CopyNodeConnections(inner) : nullptr);
 
-    if (video_params_changed_) {
-      copied_viewer_node_->set_video_params(viewer_node_->video_params());
-      video_params_changed_ = false;
-    }
+  connect(src, &NestedSequence::InnerNodeChanged, this, &PreviewAutoCacher::NestedSequenceChanged, Qt::UniqueConnection);
+}
+
+void PreviewAutoCacher::NestedSequenceChanged()
+{
+  nested_sequence_changed_ = true;
+}
+
+void PreviewAutoCacher::TryRender()
+{
+  if (!graph_update_queue_.isEmpty() || video_params_changed_ || audio_params_changed_ || nested_sequence_changed_) {
+    if (snapshot_->pins == 0 && !nested_sequence_changed_) {
+      // Nothing is reading the current snapshot, we can update it in place
+      ProcessUpdateQueue();
+
+      if (video_params_changed_) {
+        snapshot_->viewer->set_video_params(viewer_node_->video_params());
+        video_params_changed_ = false;
+      }
 
-    if (audio_params_changed_) {
-      copied_viewer_node_->set_audio_params(viewer_node_->audio_params());
-      audio_params_changed_ = false;
+      if (audio_params_changed_) {
+        snapshot_->viewer->set_audio_params(viewer_node_->audio_params());
+        audio_params_changed_ = false;
+      }
+    } else if (snapshot_->pins == 0 || retired_snapshots_.size() < kMaxRetiredSnapshots) {
+      // Jobs are still reading the current snapshot, or it needs copying from scratch anyway,
+      // publish a new one
+      PublishSnapshot();
+    } else {
+      // Too many old snapshots are still alive, wait for jobs to finish before copying again
+      return;
     }
   }
 
   // If we're here, we must be able to render
   if (!invalidated_video_.isEmpty()) {
-    QVector<rational> frames = viewer_node_->video_frame_cache()->GetFrameListFromTimeRange(invalidated_video_);
+    // Split hashing into chunks so it runs across cores and rendering can start on each chunk as
+    // soon as it's done rather than when the whole batch is
+    const rational& timebase = viewer_node_->video_frame_cache()->GetTimebase();
+    QVector<TimeRange> chunks;
+
+    foreach (const TimeRange& range, invalidated_video_) {
+      int64_t start_ts = Timecode::time_to_timestamp(range.in(), timebase);
+      if (Timecode::timestamp_to_time(start_ts, timebase) > range.in()) {
+        start_ts--;
+      }
+
+      int64_t end_ts = Timecode::time_to_timestamp(range.out(), timebase);
+      if (Timecode::timestamp_to_time(end_ts, timebase) < range.out()) {
+        end_ts++;
+      }
 
-    QFutureWatcher<void>* watcher = new QFutureWatcher<void>();
-    hash_tasks_.append(watcher);
-    connect(watcher, &QFutureWatcher<void>::finished, this, &PreviewAutoCacher::HashesProcessed);
-    watcher->setFuture(QtConcurrent::run(&PreviewAutoCacher::GenerateHashes,
-                                         copied_viewer_node_,
-                                         viewer_node_->video_frame_cache(),
-                                         frames,
-                                         last_update_time_));
+      for (int64_t ts=start_ts; ts<end_ts; ts+=kHashChunkFrames) {
+        chunks.append(TimeRange(Timecode::timestamp_to_time(ts, timebase),
+                                Timecode::timestamp_to_time(qMin(ts + kHashChunkFrames, end_ts), timebase)));
+      }
+    }
+
+    // The thread pool starts tasks in the order they're queued, so starting with the chunk
+    // containing the playhead and working outwards gets frames near it rendered first
+    std::stable_sort(chunks.begin(), chunks.end(), [this](const TimeRange& a, const TimeRange& b){
+      return DistanceFromPlayhead(a) < DistanceFromPlayhead(b);
+    });
+
+    foreach (const TimeRange& chunk, chunks) {
+      TimeRangeList chunk_list;
+      chunk_list.insert(chunk);
+
+      QFutureWatcher<void>* watcher = new QFutureWatcher<void>();
+      hash_tasks_.insert(watcher, chunk);
+      PinSnapshot(watcher);
+      connect(watcher, &QFutureWatcher<void>::finished, this, &PreviewAutoCacher::HashesProcessed);
+      watcher->setFuture(QtConcurrent::run(&PreviewAutoCacher::GenerateHashes,
+                                           snapshot_->viewer,
+                                           viewer_node_->video_frame_cache(),
+                                           chunk_list,
+                                           timebase,
+                                           last_update_time_));
+    }
 
     invalidated_video_.clear();
   }
@@ -572,31 +1117,102 @@ void PreviewAutoCacher::TryRender()
         RenderTicketWatcher* watcher = new RenderTicketWatcher();
         connect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::AudioRendered);
         audio_tasks_.insert(watcher, r);
-        watcher->SetTicket(RenderManager::instance()->RenderAudio(copied_viewer_node_, r, true));
+        PinSnapshot(watcher);
+        watcher->SetTicket(RenderManager::instance()->RenderAudio(snapshot_->viewer, r, true));
       }
     }
 
     invalidated_audio_.clear();
   }
 
-  if (single_frame_render_) {
-    RenderTicketWatcher* watcher = new RenderTicketWatcher();
+  for (auto it=clients_.begin(); it!=clients_.end(); it++) {
+    if (it->single_frame_render) {
+      StartSingleFrame(*it);
+    }
+
+    while (!it->pending_playback_frames.isEmpty()) {
+      StartPlaybackFrame(*it, it->pending_playback_frames.takeFirst());
+    }
+  }
+}
+
+void PreviewAutoCacher::StartSingleFrame(Client &client)
+{
+  RenderTicketWatcher* watcher = new RenderTicketWatcher();
+
+  watcher->setProperty("passthrough", QVariant::fromValue(client.single_frame_render));
+
+  connect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::SingleFrameFinished);
 
-    watcher->setProperty("passthrough", QVariant::fromValue(single_frame_render_));
+  PinSnapshot(watcher);
 
-    connect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::SingleFrameFinished);
+  client.single_frame_render->Start();
 
-    single_frame_render_->Start();
+  rational single_frame_time = client.single_frame_render->property("time").value<rational>();
+  QRect single_frame_region = client.single_frame_render->property("region").toRect();
+  bool single_frame_best_effort = client.single_frame_render->property("besteffort").toBool();
 
-    watcher->SetTicket(RenderManager::instance()->RenderFrame(copied_viewer_node_,
-                                                              color_manager_,
-                                                              single_frame_render_->property("time").value<rational>(),
+  if (RenderManager::instance()->CanShareTexturesWithDisplay()) {
+    // This frame is only going to be shown in the viewer, so it can stay on the GPU
+    watcher->SetTicket(RenderManager::instance()->RenderFrameForDisplay(snapshot_->viewer,
+                                                                        client.color_manager,
+                                                                        single_frame_time,
+                                                                        RenderMode::kOffline,
+                                                                        RenderManager::kPriorityInteractive,
+                                                                        single_frame_region,
+                                                                        single_frame_best_effort));
+  } else {
+    watcher->SetTicket(RenderManager::instance()->RenderFrame(snapshot_->viewer,
+                                                              client.color_manager,
+                                                              single_frame_time,
                                                               RenderMode::kOffline,
-                                                              viewer_node_->video_frame_cache(),
-                                                              true));
+                                                              snapshot_->viewer->video_params(),
+                                                              snapshot_->viewer->audio_params(),
+                                                              QSize(0, 0),
+                                                              QMatrix4x4(),
+                                                              VideoParams::kFormatInvalid,
+                                                              nullptr,
+                                                              direct_preview_ ? nullptr : viewer_node_->video_frame_cache(),
+                                                              RenderManager::kPriorityInteractive,
+                                                              single_frame_region,
+                                                              single_frame_best_effort));
+  }
+
+  client.single_frame_watcher = watcher;
+  client.single_frame_render = nullptr;
+}
+
+void PreviewAutoCacher::StartPlaybackFrame(Client &client, RenderTicketPtr passthrough)
+{
+  RenderTicketWatcher* watcher = new RenderTicketWatcher();
+
+  watcher->setProperty("passthrough", QVariant::fromValue(passthrough));
+
+  connect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::PlaybackFrameFinished);
+
+  client.playback_tasks.append(watcher);
+  PinSnapshot(watcher);
+
+  passthrough->Start();
 
-    single_frame_render_ = nullptr;
+  VideoParams video_params = snapshot_->viewer->video_params();
+  int divider = passthrough->property("divider").toInt();
+  if (divider > 0) {
+    video_params.set_divider(divider);
   }
+
+  watcher->SetTicket(RenderManager::instance()->RenderFrame(snapshot_->viewer,
+                                                            client.color_manager,
+                                                            passthrough->property("time").value<rational>(),
+                                                            RenderMode::kOffline,
+                                                            video_params,
+                                                            snapshot_->viewer->audio_params(),
+                                                            QSize(0, 0),
+                                                            QMatrix4x4(),
+                                                            VideoParams::kFormatInvalid,
+                                                            nullptr,
+                                                            direct_preview_ ? nullptr : viewer_node_->video_frame_cache(),
+                                                            RenderManager::kPriorityPlayback));
 }
 
 void PreviewAutoCacher::RequeueFrames()
@@ -604,55 +1220,201 @@ void PreviewAutoCacher::RequeueFrames()
   delayed_requeue_timer_.stop();
 
   if (viewer_node_
+      && !direct_preview_
       && viewer_node_->video_frame_cache()->HasInvalidatedRanges()
-      && hash_tasks_.isEmpty()
       && has_changed_
-      && (!paused_ || use_custom_range_)) {
-    TimeRange using_range;
+      && (HasActiveClients() || use_custom_range_)) {
+    TimeRangeList using_ranges;
 
     if (use_custom_range_) {
-      using_range = custom_autocache_range_;
+      using_ranges.insert(custom_autocache_range_);
       use_custom_range_ = false;
     } else {
-      using_range = cache_range_;
+      // Every viewer showing this sequence wants the frames around its own playhead
+      foreach (const Client& c, clients_) {
+        if (!c.paused) {
+          using_ranges.insert(c.cache_range);
+        }
+      }
     }
 
-    QVector<rational> invalidated_ranges = viewer_node_->video_frame_cache()->GetInvalidatedFrames(using_range);
+    QVector<rational> invalidated_frames;
+    foreach (const TimeRange& using_range, using_ranges) {
+      foreach (const rational& t, viewer_node_->video_frame_cache()->GetInvalidatedFrames(using_range)) {
+        if (t >= using_range.in() && t < using_range.out()) {
+          invalidated_frames.append(t);
+        }
+      }
+    }
 
-    ClearVideoQueue();
+    // Frames a playhead is heading towards are needed first, then the ones it's leaving behind,
+    // each nearest first. With several viewers a frame ranks by whichever playhead it's best for.
+    bool any_active = HasActiveClients();
+    QHash<rational, QPair<bool, double> > ranks;
+    foreach (const rational& t, invalidated_frames) {
+      QPair<bool, double> best(true, 0);
+      bool found = false;
+
+      foreach (const Client& c, clients_) {
+        if (c.paused && any_active) {
+          continue;
+        }
 
-    foreach (const rational& t, invalidated_ranges) {
-      const QByteArray& hash = viewer_node_->video_frame_cache()->GetHash(t);
+        bool ahead = (c.playhead_direction > 0) ? (t >= c.playhead) : (t <= c.playhead);
+        QPair<bool, double> rank(!ahead, qAbs((t - c.playhead).toDouble()));
 
-      if (t >= using_range.in()
-          && t < using_range.out()
-          && !currently_caching_hashes_.contains(hash)) {
-        // Don't render any hash more than once
-        currently_caching_hashes_.append(hash);
+        if (!found || rank < best) {
+          best = rank;
+          found = true;
+        }
+      }
 
-        RenderTicketWatcher* watcher = new RenderTicketWatcher();
-        watcher->setProperty("hash", hash);
-        connect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::VideoRendered);
-        video_tasks_.insert(watcher, hash);
-        watcher->SetTicket(RenderManager::instance()->RenderFrame(copied_viewer_node_,
-                                                                  color_manager_,
-                                                                  t, RenderMode::kOffline,
-                                                                  viewer_node_->video_frame_cache(),
-                                                                  false));
+      ranks.insert(t, best);
+    }
+
+    std::stable_sort(invalidated_frames.begin(), invalidated_frames.end(),
+                     [&ranks](const rational& a, const rational& b){
+      return ranks.value(a) < ranks.value(b);
+    });
+
+    // Frames that are still being hashed don't have their new hash yet, they'll be queued when
+    // their chunk finishes
+    TimeRangeList unhashed = invalidated_video_;
+    foreach (const TimeRange& chunk, hash_tasks_) {
+      unhashed.insert(chunk);
+    }
+
+    QVector<QPair<rational, QByteArray> > wanted;
+    QSet<QByteArray> wanted_hashes;
+
+    foreach (const rational& t, invalidated_frames) {
+      if (!unhashed.contains(TimeRange(t, t), true, false)) {
+        QByteArray hash = viewer_node_->video_frame_cache()->GetHash(t);
+
+        if (!wanted_hashes.contains(hash)) {
+          wanted_hashes.insert(hash);
+          wanted.append({t, hash});
+        }
+      }
+    }
+
+    // Only cancel work that's no longer wanted, anything in flight for a hash we still need is
+    // still rendering the right frame. Copied because tasks that cancel immediately are removed.
+    auto in_flight = video_tasks_;
+    for (auto it=in_flight.cbegin(); it!=in_flight.cend(); it++) {
+      if (!wanted_hashes.contains(it.value())) {
+        it.key()->Cancel();
       }
     }
 
-    has_changed_ = false;
+    bool deferred = false;
+
+    for (int i=0; i<wanted.size(); i++) {
+      const rational& t = wanted.at(i).first;
+      const QByteArray& hash = wanted.at(i).second;
+
+      // If the disk can't keep up, frames rendered now would only sit in memory waiting to be
+      // written, so try the rest again once the queued writes have drained a little
+      if (RenderManager::instance()->IsCacheWriteQueueFull()) {
+        deferred = true;
+        break;
+      }
+
+      // Don't render any hash more than once
+      if (!currently_caching_hashes_.contains(hash)) {
+        currently_caching_hashes_.insert(hash);
+
+        if (RemoteFrameCache::instance()->IsEnabled()) {
+          // See if another workstation has already rendered this frame
+          RenderTicketWatcher* watcher = new RenderTicketWatcher();
+          watcher->setProperty("hash", hash);
+          watcher->setProperty("time", QVariant::fromValue(t));
+          connect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::RemoteFrameFetched);
+          video_tasks_.insert(watcher, hash);
+          watcher->SetTicket(RemoteFrameCache::instance()->Fetch(hash));
+        } else {
+          QueueFrameRender(t, hash);
+        }
+      }
+    }
+
+    has_changed_ = deferred;
+
+    if (deferred) {
+      delayed_requeue_timer_.start();
+    }
   }
 }
 
+rational PreviewAutoCacher::DistanceFromPlayhead(const TimeRange &range) const
+{
+  rational nearest;
+  bool found = false;
+
+  foreach (const Client& c, clients_) {
+    rational distance;
+
+    if (c.playhead < range.in()) {
+      distance = range.in() - c.playhead;
+    } else if (c.playhead >= range.out()) {
+      distance = c.playhead - range.out();
+    }
+
+    if (!found || distance < nearest) {
+      nearest = distance;
+      found = true;
+    }
+  }
+
+  return nearest;
+}
+
+void PreviewAutoCacher::QueueFrameRender(const rational &time, const QByteArray &hash)
+{
+  RenderTicketWatcher* watcher = new RenderTicketWatcher();
+  watcher->setProperty("hash", hash);
+  connect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::VideoRendered);
+  video_tasks_.insert(watcher, hash);
+  PinSnapshot(watcher);
+  watcher->SetTicket(RenderManager::instance()->RenderFrame(snapshot_->viewer,
+                                                            GetCacheColorManager(),
+                                                            time, RenderMode::kOffline,
+                                                            viewer_node_->video_frame_cache(),
+                                                            IsAheadOfPlayhead(time) ? RenderManager::kPriorityPlayback : RenderManager::kPriorityBackground));
+}
+
 void PreviewAutoCacher::IgnoreNextMouseButton()
 {
   ignore_next_mouse_button_ = true;
 }
 
+void PreviewAutoCacher::SetDirectPreview(bool e)
+{
+  if (direct_preview_ == e) {
+    return;
+  }
+
+  direct_preview_ = e;
+
+  ClearQueue(false);
+
+  if (direct_preview_) {
+    invalidated_video_.clear();
+    invalidated_audio_.clear();
+  } else if (viewer_node_) {
+    // Pick up everything that was skipped while we weren't caching
+    invalidated_video_ = viewer_node_->video_frame_cache()->GetInvalidatedRanges();
+    invalidated_audio_ = viewer_node_->audio_playback_cache()->GetInvalidatedRanges();
+    TryRender();
+  }
+}
+
 void PreviewAutoCacher::ForceCacheRange(const TimeRange &range)
 {
+  if (direct_preview_) {
+    return;
+  }
+
   has_changed_ = true;
   use_custom_range_ = true;
   custom_autocache_range_ = range;
@@ -682,20 +1444,44 @@ void PreviewAutoCacher::SetViewerNode(ViewerOutput *viewer_node)
       // This can be cleared normally (PCM data will be discarded and need to be rendered again)
       ClearAudioQueue(false);
 
+      // These read from the copied graph that's about to be deleted
+      foreach (QObject* client, clients_.keys()) {
+        ClearPlaybackQueue(client, true);
+      }
+
       // We'll need to wait for these since they work directly on the FrameHashCache. Frames will
       // be in the cache for later use.
       ClearVideoDownloadQueue(true);
 
+      // Those that already finished still belong to this viewer's cache
+      ValidateDownloadedFrames();
+
       // No longer caching any hashes
       currently_caching_hashes_.clear();
     }
 
-    // Delete all of our copied nodes
-    foreach (Node* c, copy_map_) {
-      delete c;
+    // Delete all of our copied nodes, old snapshots included since their jobs have been cancelled.
+    // Live audio devices may still be reading from theirs though, those are deleted when the
+    // devices are.
+    QList<GraphSnapshot*> snapshots = retired_snapshots_;
+    snapshots.append(snapshot_);
+    snapshot_ = nullptr;
+    retired_snapshots_.clear();
+
+    QHash<QObject*, GraphSnapshot*> live_snapshots;
+    foreach (QObject* device, live_audio_devices_) {
+      live_snapshots.insert(device, job_snapshots_.value(device));
     }
-    copy_map_.clear();
-    copied_viewer_node_ = nullptr;
+    job_snapshots_ = live_snapshots;
+
+    foreach (GraphSnapshot* s, snapshots) {
+      s->pins = live_snapshots.keys(s).size();
+
+      if (s->pins == 0) {
+        DeleteSnapshot(s);
+      }
+    }
+
     graph_update_queue_.clear();
 
     video_params_changed_ = false;
@@ -732,23 +1518,12 @@ void PreviewAutoCacher::SetViewerNode(ViewerOutput *viewer_node)
 
   if (viewer_node_) {
     // Copy graph
-    copied_viewer_node_ = static_cast<ViewerOutput*>(viewer_node_->copy());
-    copy_map_.insert(viewer_node_, copied_viewer_node_);
-
-    // Copy parameters
-    copied_viewer_node_->set_video_params(viewer_node_->video_params());
-    copied_viewer_node_->set_audio_params(viewer_node_->audio_params());
+    PublishSnapshot();
 
-    // We begin an operation and never end it which prevents the copy from unnecessarily
-    // invalidating its own cache
-    copied_viewer_node_->BeginOperation();
-
-    NodeGraphChanged(viewer_node_->texture_input());
-    NodeGraphChanged(viewer_node_->samples_input());
-    ProcessUpdateQueue();
-
-    invalidated_video_ = viewer_node_->video_frame_cache()->GetInvalidatedRanges();
-    invalidated_audio_ = viewer_node_->audio_playback_cache()->GetInvalidatedRanges();
+    if (!direct_preview_) {
+      invalidated_video_ = viewer_node_->video_frame_cache()->GetInvalidatedRanges();
+      invalidated_audio_ = viewer_node_->audio_playback_cache()->GetInvalidatedRanges();
+    }
 
     connect(viewer_node_,
             &ViewerOutput::GraphChangedFrom,
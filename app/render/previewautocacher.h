@@ -6,28 +6,71 @@
 #include "config/config.h"
 #include "node/node.h"
 #include "node/output/viewer/viewer.h"
+#include "render/audiolivemixdevice.h"
 #include "render/colormanager.h"
 #include "threading/threadticketwatcher.h"
 
 namespace olive {
 
+class NestedSequence;
+
 /**
  * @brief Manager for dynamically caching a sequence in the background
  *
  * Intended to be used with a Viewer to dynamically cache parts of a sequence based on the playhead.
+ *
+ * There's one PreviewAutoCacher per ViewerOutput, shared by every widget showing it (see
+ * Acquire()), so the graph is only copied and each frame only hashed and queued once however
+ * many viewers are open on a sequence. Each widget registers as a client and contributes its own
+ * playhead, pause state and interactive requests; the cache range is the union of the playhead
+ * ranges of every client that isn't paused.
  */
 class PreviewAutoCacher : public QObject
 {
   Q_OBJECT
 public:
-  PreviewAutoCacher();
+  /**
+   * @brief Get the cacher for `viewer`, creating it if necessary, and register `client` with it
+   *
+   * Every call must be balanced with a call to Release() with the same client. Must be called
+   * from the main thread.
+   */
+  static PreviewAutoCacher* Acquire(ViewerOutput* viewer, QObject* client);
 
-  RenderTicketPtr GetSingleFrame(const rational& t);
+  /**
+   * @brief Unregister `client`, destroying the cacher once it has no clients left
+   *
+   * Any frames the client requested that haven't finished are cancelled.
+   */
+  static void Release(PreviewAutoCacher* cacher, QObject* client);
 
   /**
-   * @brief Set the viewer node to auto-cache
+   * @brief Render a frame for the viewer to show, cancelling any previous one from this client
+   *
+   * If `region` is set, only that part of the frame is rendered (see RenderManager::RenderFrame()).
+   * If `best_effort` is TRUE, footage may be substituted with a nearby frame that decodes faster.
    */
-  void SetViewerNode(ViewerOutput *viewer_node);
+  RenderTicketPtr GetSingleFrame(QObject* client, const rational& t, const QRect& region = QRect(), bool best_effort = false);
+
+  /**
+   * @brief Render a frame ahead of the playhead for playback
+   *
+   * Unlike GetSingleFrame(), this doesn't cancel earlier requests so several frames can be in
+   * flight at once. Requests are made at playback priority and run until they finish or
+   * ClearPlaybackQueue() is called for this client.
+   *
+   * If `divider` is set, the frame is rendered at that divider rather than the viewer's own.
+   */
+  RenderTicketPtr GetPlaybackFrame(QObject* client, const rational& t, int divider = 0);
+
+  /**
+   * @brief Create a device that mixes the viewer's audio as it's read
+   *
+   * Used to play audio without waiting for the cache to catch up with an edit. The device renders
+   * from the current graph snapshot, which stays alive until the device is destroyed. The caller
+   * takes ownership of the device.
+   */
+  AudioLiveMixDevice* CreateLiveAudioDevice();
 
   /**
    * @brief If the mouse is held during the next cache invalidation, cache anyway
@@ -40,21 +83,38 @@ public:
   void IgnoreNextMouseButton();
 
   /**
-   * @brief Returns whether the auto-cache is currently paused or not
+   * @brief Sets whether frames are rendered straight to the viewer without any caching
+   *
+   * In direct mode nothing is hashed, queued for the disk cache or mixed into the audio cache.
+   * Single and playback frames are still rendered from the graph snapshot, but are neither looked
+   * up in nor saved to the viewer's FrameHashCache, and audio is expected to be played through
+   * CreateLiveAudioDevice(). Used for previews of raw footage where the sequence only exists to
+   * feed the decoder and caching would just be wasted work.
+   */
+  void SetDirectPreview(bool e);
+
+  bool IsDirectPreview() const
+  {
+    return direct_preview_;
+  }
+
+  /**
+   * @brief Returns whether the auto-cache is currently paused for this client or not
    */
-  bool IsPaused() const
+  bool IsPaused(QObject* client) const
   {
-    return paused_;
+    return clients_.value(client).paused;
   }
 
   /**
-   * @brief Sets whether the auto-cache is currently paused or not
+   * @brief Sets whether the auto-cache is currently paused for this client or not
    * @param paused
    *
-   * If TRUE, the cache queue is cleared (any frames currently being rendered will be processed as
+   * A paused client's playhead no longer contributes to the cache range. Once every client is
+   * paused, the cache queue is cleared (any frames currently being rendered will be processed as
    * normal however). If FALSE, any uncached frames in the range will automatically be queued.
    */
-  void SetPaused(bool paused);
+  void SetPaused(QObject* client, bool paused);
 
   /**
    * @brief Force a certain range to be cached
@@ -66,9 +126,9 @@ public:
   void ForceCacheRange(const TimeRange& range);
 
   /**
-   * @brief Updates the range of frames to auto-cache
+   * @brief Updates this client's playhead and so the range of frames to auto-cache around it
    */
-  void SetPlayhead(const rational& playhead);
+  void SetPlayhead(QObject* client, const rational& playhead);
 
   /**
    * @brief Clears queue of running jobs
@@ -84,10 +144,18 @@ public:
   void ClearAudioQueue(bool wait = false);
   void ClearVideoDownloadQueue(bool wait = false);
 
-  void SetColorManager(ColorManager* manager)
-  {
-    color_manager_ = manager;
-  }
+  /**
+   * @brief Cancel every frame this client requested with GetPlaybackFrame() that hasn't finished yet
+   */
+  void ClearPlaybackQueue(QObject* client, bool wait = false);
+
+  /**
+   * @brief Set the color manager used for this client's frames
+   *
+   * Background caching uses the first client's that's set, it's the project's in all but rare
+   * cases.
+   */
+  void SetColorManager(QObject* client, ColorManager* manager);
 
 public slots:
   /**
@@ -96,14 +164,90 @@ public slots:
   void NodeGraphChanged(NodeInput *source);
 
 private:
-  static void GenerateHashes(ViewerOutput* viewer, FrameHashCache *cache, const QVector<rational>& times, qint64 job_time);
+  PreviewAutoCacher();
+
+  /**
+   * @brief Set the viewer node to auto-cache
+   */
+  void SetViewerNode(ViewerOutput *viewer_node);
+
+  /**
+   * @brief State kept for each widget using this cacher
+   */
+  struct Client {
+    Client() :
+      playhead_direction(1),
+      paused(false),
+      color_manager(nullptr),
+      single_frame_watcher(nullptr)
+    {
+    }
+
+    rational playhead;
+
+    /**
+     * @brief 1 if the playhead last moved forward, -1 if it last moved backward
+     */
+    int playhead_direction;
+
+    TimeRange cache_range;
+
+    bool paused;
+
+    ColorManager* color_manager;
+
+    RenderTicketPtr single_frame_render;
+
+    /**
+     * @brief The single frame currently being rendered, cancelled when the next one is requested
+     */
+    RenderTicketWatcher* single_frame_watcher;
+
+    QList<RenderTicketPtr> pending_playback_frames;
+    QList<RenderTicketWatcher*> playback_tasks;
+  };
+
+  /**
+   * @brief Returns TRUE if at least one client isn't paused
+   */
+  bool HasActiveClients() const;
+
+  ColorManager* GetCacheColorManager() const;
+
+  /**
+   * @brief Cancel this client's pending single frame and the one being rendered
+   */
+  void CancelSingleFrame(Client& client);
+
+  /**
+   * @brief Returns TRUE if `time` is at or after the playhead of any client that isn't paused
+   */
+  bool IsAheadOfPlayhead(const rational& time) const;
+
+  static QHash<ViewerOutput*, PreviewAutoCacher*> instances_;
+
+  static void GenerateHashes(ViewerOutput* viewer, FrameHashCache *cache, const TimeRangeList& ranges, const rational& timebase, qint64 job_time);
 
   void CopyNodeInputValue(NodeInput* input);
   Node *CopyNodeConnections(Node *src_node);
   void CopyNodeMakeConnection(NodeInput *src_input, NodeInput *dst_input);
 
+  /**
+   * @brief Copy the graph a nested sequence renders from along with it
+   *
+   * Edits inside the nested sequence arrive through NodeGraphChanged() like any other, but if its
+   * viewer is reconnected the whole snapshot is copied again since we don't copy that viewer.
+   */
+  void CopyNestedSequence(NestedSequence* src, NestedSequence* dst);
+
   void TryRender();
 
+  /**
+   * @brief Send a client's requested single frame or playback frame to the renderer
+   */
+  void StartSingleFrame(Client& client);
+  void StartPlaybackFrame(Client& client, RenderTicketPtr passthrough);
+
   /**
    * @brief Process all changes to internal NodeGraph copy
    *
@@ -112,17 +256,87 @@ private:
    */
   void ProcessUpdateQueue();
 
-  bool HasActiveJobs() const;
+  /**
+   * @brief An immutable version of the node graph that render jobs read from
+   *
+   * Jobs pin the snapshot that was current when they started. Edits are applied to the current
+   * snapshot in place if nothing is pinning it, otherwise a new snapshot is published straight
+   * away and the old one is deleted once its last job finishes, so edits never have to wait for
+   * rendering to drain.
+   */
+  struct GraphSnapshot {
+    ViewerOutput* viewer;
+    QHash<Node*, Node*> copy_map;
+    int pins;
+  };
+
+  /**
+   * @brief Copy the whole graph into a new snapshot and make it current
+   */
+  void PublishSnapshot();
+
+  /**
+   * @brief Mark `job` as reading from the current snapshot until ReleaseSnapshot() is called
+   */
+  void PinSnapshot(QObject* job);
+
+  /**
+   * @brief Returns the snapshot `job` was pinned to
+   */
+  GraphSnapshot* GetJobSnapshot(QObject* job) const;
+
+  /**
+   * @brief Unpin the snapshot `job` used, deleting it if it has been superseded
+   */
+  void ReleaseSnapshot(QObject* job);
+
+  static void DeleteSnapshot(GraphSnapshot* snapshot);
+
+  /**
+   * @brief Maximum number of superseded snapshots kept alive for running jobs
+   *
+   * If this many are still pinned, further edits wait for jobs to finish like they used to rather
+   * than making yet another copy of the graph.
+   */
+  static const int kMaxRetiredSnapshots;
+
+  /**
+   * @brief Number of frames hashed by each GenerateHashes() task
+   */
+  static const int64_t kHashChunkFrames;
+
+  /**
+   * @brief Returns how far `range` is from the nearest playhead, zero if it contains one
+   */
+  rational DistanceFromPlayhead(const TimeRange& range) const;
+
+  /**
+   * @brief Start rendering a frame for the cache
+   */
+  void QueueFrameRender(const rational& time, const QByteArray& hash);
+
+  /**
+   * @brief Keep a frame in memory and start writing it to the disk cache
+   */
+  void CacheFrame(const QByteArray& hash, FramePtr frame);
 
   QList<NodeInput*> graph_update_queue_;
-  QHash<Node*, Node*> copy_map_;
-  ViewerOutput* copied_viewer_node_;
+
+  GraphSnapshot* snapshot_;
+  QList<GraphSnapshot*> retired_snapshots_;
+  QHash<QObject*, GraphSnapshot*> job_snapshots_;
+  QSet<QObject*> live_audio_devices_;
 
   ViewerOutput* viewer_node_;
 
-  bool paused_;
+  bool direct_preview_;
+
+  QHash<QObject*, Client> clients_;
 
-  TimeRange cache_range_;
+  /**
+   * @brief Hashes of recently rendered frames by the tag their GPU timings are reported under
+   */
+  QHash<quint64, QByteArray> gpu_timed_hashes_;
 
   bool has_changed_;
 
@@ -132,14 +346,12 @@ private:
   TimeRangeList invalidated_video_;
   TimeRangeList invalidated_audio_;
 
-  RenderTicketPtr single_frame_render_;
-
-  QList<QFutureWatcher<void>*> hash_tasks_;
+  QMap<QFutureWatcher<void>*, TimeRange> hash_tasks_;
   QMap<RenderTicketWatcher*, TimeRange> audio_tasks_;
   QMap<RenderTicketWatcher*, QByteArray> video_tasks_;
   QMap<RenderTicketWatcher*, QByteArray> video_download_tasks_;
 
-  QVector<QByteArray> currently_caching_hashes_;
+  QSet<QByteArray> currently_caching_hashes_;
 
   qint64 last_update_time_;
 
@@ -149,11 +361,23 @@ private:
 
   bool audio_params_changed_;
 
-  ColorManager* color_manager_;
+  bool nested_sequence_changed_;
 
   QTimer delayed_requeue_timer_;
 
+  /**
+   * @brief Hashes saved to the disk cache since the last ValidateDownloadedFrames()
+   */
+  QVector<QByteArray> downloaded_hashes_;
+
+  QTimer validate_timer_;
+
 private slots:
+  /**
+   * @brief Handler for when a nested sequence's viewer is connected to a different node
+   */
+  void NestedSequenceChanged();
+
   /**
    * @brief Handler for when the NodeGraph reports a video change over a certain time range
    */
@@ -179,11 +403,31 @@ private slots:
    */
   void VideoRendered();
 
+  /**
+   * @brief Handler for when a frame has been looked for in the shared cache
+   *
+   * If it wasn't found, the frame is rendered locally.
+   */
+  void RemoteFrameFetched();
+
   /**
    * @brief Handler for when we've saved a video frame to the cache
    */
   void VideoDownloaded();
 
+  /**
+   * @brief Validate every frame saved since the last call in one go
+   *
+   * Frames finish in bursts, validating them together means the cache and everything drawing it
+   * only update once per burst rather than once per frame.
+   */
+  void ValidateDownloadedFrames();
+
+  /**
+   * @brief Handler for GPU time arriving for a frame, which is usually after it finished rendering
+   */
+  void GPUFrameTimed(quint64 tag, qint64 ns);
+
   /**
    * @brief Handler for when a NodeInput has been deleted so we clear it from the queue
    *
@@ -199,6 +443,8 @@ private slots:
 
   void SingleFrameFinished();
 
+  void PlaybackFrameFinished();
+
   /**
    * @brief Generic function called whenever the frames to render need to be (re)queued
    */
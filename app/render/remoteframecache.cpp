@@ -0,0 +1,201 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "remoteframecache.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QtConcurrent/QtConcurrent>
+#include <QUuid>
+
+#include "config/config.h"
+#include "render/framehashcache.h"
+
+namespace olive {
+
+const int RemoteFrameCache::kMaximumTransfers = 4;
+RemoteFrameCache* RemoteFrameCache::instance_ = nullptr;
+
+RemoteFrameCache::RemoteFrameCache()
+{
+  pool_.setMaxThreadCount(kMaximumTransfers);
+
+  memset(&statistics_, 0, sizeof(statistics_));
+}
+
+void RemoteFrameCache::CreateInstance()
+{
+  instance_ = new RemoteFrameCache();
+}
+
+void RemoteFrameCache::DestroyInstance()
+{
+  if (instance_) {
+    instance_->pool_.waitForDone();
+  }
+
+  delete instance_;
+  instance_ = nullptr;
+}
+
+RemoteFrameCache *RemoteFrameCache::instance()
+{
+  return instance_;
+}
+
+bool RemoteFrameCache::IsEnabled() const
+{
+  return !GetPath().isEmpty();
+}
+
+RenderTicketPtr RemoteFrameCache::Fetch(const QByteArray &hash)
+{
+  RenderTicketPtr ticket = std::make_shared<RenderTicket>();
+
+  QtConcurrent::run(&pool_, this, &RemoteFrameCache::FetchInternal, ticket, GetPath(), hash);
+
+  return ticket;
+}
+
+void RemoteFrameCache::Upload(const QByteArray &hash, FramePtr frame)
+{
+  if (!frame || !VideoParams::FormatIsFloat(frame->format())) {
+    return;
+  }
+
+  QtConcurrent::run(&pool_, this, &RemoteFrameCache::UploadInternal, GetPath(), hash, frame);
+}
+
+RemoteFrameCache::Statistics RemoteFrameCache::GetStatistics()
+{
+  QMutexLocker locker(&statistics_lock_);
+
+  return statistics_;
+}
+
+QString RemoteFrameCache::GetPath()
+{
+  return Config::Current()[QStringLiteral("RemoteCachePath")].toString();
+}
+
+QString RemoteFrameCache::GetFilename(const QString &path, const QByteArray &hash)
+{
+  // Same layout as the local cache so neither directory gets too large
+  return QDir(QDir(path).filePath(QString(hash.left(1).toHex())))
+      .filePath(QStringLiteral("%1%2").arg(QString(hash.mid(1).toHex()), FrameHashCache::GetFormatExtension()));
+}
+
+void RemoteFrameCache::FetchInternal(RenderTicketPtr ticket, QString path, QByteArray hash)
+{
+  // Ticket may have been cancelled before we got to it
+  if (ticket->IsFinished()) {
+    return;
+  }
+
+  ticket->Start();
+
+  QElapsedTimer timer;
+  timer.start();
+
+  QString filename = GetFilename(path, hash);
+  FramePtr frame = nullptr;
+
+  if (!path.isEmpty() && QFileInfo::exists(filename)) {
+    try {
+      frame = FrameHashCache::LoadCacheFrame(filename);
+    } catch (const std::exception& e) {
+      // Files on network storage can disappear or be truncated under us, treat it as a miss
+      qWarning() << "Failed to read frame from shared cache:" << filename << e.what();
+      frame = nullptr;
+    }
+  }
+
+  qint64 elapsed = timer.elapsed();
+
+  {
+    QMutexLocker locker(&statistics_lock_);
+
+    statistics_.fetches++;
+    statistics_.fetch_time += elapsed;
+
+    if (frame) {
+      statistics_.hits++;
+      statistics_.bytes_read += QFileInfo(filename).size();
+      statistics_.transfer_time += elapsed;
+    }
+  }
+
+  ticket->Finish(QVariant::fromValue(frame), ticket->WasCancelled());
+}
+
+void RemoteFrameCache::UploadInternal(QString path, QByteArray hash, FramePtr frame)
+{
+  if (path.isEmpty()) {
+    return;
+  }
+
+  QString filename = GetFilename(path, hash);
+
+  if (QFileInfo::exists(filename)) {
+    // Someone else already uploaded it
+    return;
+  }
+
+  QFileInfo info(filename);
+  if (!info.dir().mkpath(QStringLiteral("."))) {
+    qWarning() << "Failed to create shared cache folder" << info.dir().path();
+    return;
+  }
+
+  // Write somewhere no one else will look and then move it into place
+  QString temp_filename = QStringLiteral("%1.%2.tmp").arg(filename, QString(QUuid::createUuid().toRfc4122().toHex()));
+
+  QElapsedTimer timer;
+  timer.start();
+
+  bool saved;
+
+  try {
+    // The frame's buffer may be shared with the memory cache, avoid detaching it since we only read
+    saved = FrameHashCache::SaveCacheFrame(temp_filename,
+                                           const_cast<char*>(frame->const_data()),
+                                           frame->video_params(),
+                                           frame->linesize_bytes());
+  } catch (const std::exception& e) {
+    qWarning() << "Failed to write frame to shared cache:" << temp_filename << e.what();
+    saved = false;
+  }
+
+  if (!saved || !QFile::rename(temp_filename, filename)) {
+    QFile::remove(temp_filename);
+    return;
+  }
+
+  qint64 elapsed = timer.elapsed();
+
+  QMutexLocker locker(&statistics_lock_);
+
+  statistics_.uploads++;
+  statistics_.bytes_written += QFileInfo(filename).size();
+  statistics_.transfer_time += elapsed;
+}
+
+}
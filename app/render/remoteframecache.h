@@ -0,0 +1,121 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef REMOTEFRAMECACHE_H
+#define REMOTEFRAMECACHE_H
+
+#include <QMutex>
+#include <QThreadPool>
+
+#include "codec/frame.h"
+#include "common/define.h"
+#include "threading/threadticket.h"
+
+namespace olive {
+
+/**
+ * @brief Optional cache tier shared between workstations
+ *
+ * Frame hashes are content-addressed, there's nothing machine-specific in them, so a frame
+ * rendered on one workstation can be used by any other working on the same project. If the
+ * "RemoteCachePath" config entry points to a shared folder (e.g. on a NAS), frames that aren't in
+ * the local cache are looked for there before being rendered, and frames rendered locally are
+ * uploaded there in the background.
+ *
+ * Frames are stored as one DWAA-compressed EXR per hash to keep network transfers small. Uploads
+ * are written to a temporary file and renamed into place so other machines never see a partial
+ * frame, if two machines upload the same hash at once the second rename simply fails.
+ *
+ * All transfers happen on this class's own thread pool so slow storage never blocks rendering.
+ *
+ * This class is thread safe.
+ */
+class RemoteFrameCache
+{
+public:
+  static void CreateInstance();
+
+  static void DestroyInstance();
+
+  static RemoteFrameCache* instance();
+
+  DISABLE_COPY_MOVE(RemoteFrameCache)
+
+  struct Statistics {
+    int fetches;
+    int hits;
+    int uploads;
+    qint64 bytes_read;
+    qint64 bytes_written;
+
+    /// Total time spent fetching in milliseconds
+    qint64 fetch_time;
+
+    /// Total time spent transferring data in milliseconds, fetch misses are excluded
+    qint64 transfer_time;
+  };
+
+  /**
+   * @brief Returns TRUE if a shared cache folder has been set
+   */
+  bool IsEnabled() const;
+
+  /**
+   * @brief Look for a frame in the shared cache
+   *
+   * The ticket finishes with a FramePtr, which is null if the frame isn't in the shared cache.
+   */
+  RenderTicketPtr Fetch(const QByteArray& hash);
+
+  /**
+   * @brief Upload a frame to the shared cache in the background
+   *
+   * Nothing is uploaded if the frame is already there.
+   */
+  void Upload(const QByteArray& hash, FramePtr frame);
+
+  Statistics GetStatistics();
+
+private:
+  RemoteFrameCache();
+
+  static QString GetPath();
+
+  static QString GetFilename(const QString& path, const QByteArray& hash);
+
+  void FetchInternal(RenderTicketPtr ticket, QString path, QByteArray hash);
+
+  void UploadInternal(QString path, QByteArray hash, FramePtr frame);
+
+  static const int kMaximumTransfers;
+
+  static RemoteFrameCache* instance_;
+
+  QThreadPool pool_;
+
+  QMutex statistics_lock_;
+
+  Statistics statistics_;
+
+};
+
+}
+
+#endif // REMOTEFRAMECACHE_H
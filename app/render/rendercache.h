@@ -21,8 +21,8 @@
 #ifndef RENDERCACHE_H
 #define RENDERCACHE_H
 
-#include "codec/decoder.h"
-#include "project/item/footage/stream.h"
+#include <QHash>
+#include <QMutex>
 
 namespace olive {
 
@@ -40,7 +40,6 @@ private:
 
 };
 
-using DecoderCache = RenderCache<Stream*, DecoderPtr>;
 using ShaderCache = RenderCache<QString, QVariant>;
 
 }
@@ -23,23 +23,41 @@
 #include <QFloat16>
 
 #include "common/ocioutils.h"
+#include "config/config.h"
 
 namespace olive {
 
 Renderer::Renderer(QObject *parent) :
-  QObject(parent)
+  QObject(parent),
+  color_cache_(std::make_shared<ColorCache>()),
+  texture_origin_(MemoryAccounting::kTextureIntermediate)
 {
-
+  texture_pool_.SetBudget(Config::Current()["TexturePoolBudget"].toLongLong() * 1024 * 1024);
 }
 
 TexturePtr Renderer::CreateTexture(const VideoParams &params, Texture::Type type, const void *data, int linesize)
 {
   QVariant v;
 
+  MemoryAccounting::Category origin = MemoryAccounting::TextureOriginScope::Current(texture_origin_);
+
   if (type == Texture::k3D) {
     v = CreateNativeTexture3D(params.effective_width(), params.effective_height(),
                               params.effective_depth(), params.format(), params.channel_count(), data, linesize);
   } else {
+    v = texture_pool_.Take(params);
+
+    if (!v.isNull()) {
+      // Recycled texture, upload the data into it if we were given any
+      TexturePtr t = std::make_shared<Texture>(this, v, params, type, origin);
+
+      if (data) {
+        t->Upload(data, linesize);
+      }
+
+      return t;
+    }
+
     v = CreateNativeTexture2D(params.effective_width(), params.effective_height(), params.format(),
                               params.channel_count(), data, linesize);
   }
@@ -48,7 +66,7 @@ TexturePtr Renderer::CreateTexture(const VideoParams &params, Texture::Type type
     return nullptr;
   }
 
-  return std::make_shared<Texture>(this, v, params, type);
+  return std::make_shared<Texture>(this, v, params, type, origin);
 }
 
 TexturePtr Renderer::CreateTexture(const VideoParams &params, const void *data, int linesize)
@@ -66,21 +84,66 @@ void Renderer::BlitColorManaged(ColorProcessorPtr color_processor, TexturePtr so
   BlitColorManagedInternal(color_processor, source, source_is_premultiplied, nullptr, params, clear_destination, matrix);
 }
 
+void Renderer::BlitColorManagedYUV(ColorProcessorPtr color_processor, TexturePtr y, TexturePtr u, TexturePtr v, const YUVLayout &layout, Texture *destination)
+{
+  YUVPlanes planes = {u, v, layout};
+
+  BlitColorManagedInternal(color_processor, y, false, destination, destination->params(), true, QMatrix4x4(), &planes);
+}
+
+bool Renderer::PrepareColorProcessor(ColorProcessorPtr color_processor)
+{
+  ColorContext ctx;
+  return GetColorContext(color_processor, &ctx);
+}
+
+void Renderer::ShareColorCache(Renderer *other)
+{
+  color_cache_ = other->color_cache_;
+}
+
 void Renderer::Destroy()
 {
-  color_cache_.clear();
+  // The first renderer destroyed clears a shared cache while every texture's owner is still alive
+  {
+    QMutexLocker locker(&color_cache_->mutex);
+    color_cache_->contexts.clear();
+  }
+
+  DestroyNativeTextures(texture_pool_.Clear());
 
   DestroyInternal();
 }
 
+void Renderer::ReleaseTexture(const QVariant &native, const VideoParams &params, Texture::Type type)
+{
+  if (native.isNull()) {
+    // Placeholder that was never backed by a real texture
+    return;
+  }
+
+  if (type == Texture::k2D) {
+    DestroyNativeTextures(texture_pool_.Give(native, params));
+  } else {
+    DestroyNativeTexture(native);
+  }
+}
+
+void Renderer::DestroyNativeTextures(const QVector<QVariant> &textures)
+{
+  foreach (const QVariant& t, textures) {
+    DestroyNativeTexture(t);
+  }
+}
+
 bool Renderer::GetColorContext(ColorProcessorPtr color_processor, Renderer::ColorContext *ctx)
 {
-  QMutexLocker locker(&color_cache_mutex_);
+  QMutexLocker locker(&color_cache_->mutex);
 
   ColorContext& color_ctx = *ctx;
 
-  if (color_cache_.contains(color_processor->id())) {
-    color_ctx = color_cache_.value(color_processor->id());
+  if (color_cache_->contexts.contains(color_processor->id())) {
+    color_ctx = color_cache_->contexts.value(color_processor->id());
     return true;
   } else {
     // Create shader description
@@ -98,6 +161,12 @@ bool Renderer::GetColorContext(ColorProcessorPtr color_processor, Renderer::Colo
                                       "uniform sampler2D ove_maintex;\n"
                                       "uniform int ove_maintex_alpha;\n"
                                       "\n"
+                                      "// Chroma planes and conversion matrix if the main texture is luma\n"
+                                      "uniform bool ove_maintex_yuv;\n"
+                                      "uniform sampler2D ove_maintex_u;\n"
+                                      "uniform sampler2D ove_maintex_v;\n"
+                                      "uniform mat4 ove_yuv_matrix;\n"
+                                      "\n"
                                       "// Macros defining `ove_maintex_alpha` state\n"
                                       "// Matches `AlphaAssociated` C++ enum\n"
                                       "#define ALPHA_NONE     0\n"
@@ -129,7 +198,17 @@ bool Renderer::GetColorContext(ColorProcessorPtr color_processor, Renderer::Colo
                                       "}\n"
                                       "\n"
                                       "void main() {\n"
-                                      "  vec4 col = texture(ove_maintex, ove_texcoord);\n"
+                                      "  vec4 col;\n"
+                                      "\n"
+                                      "  if (ove_maintex_yuv) {\n"
+                                      "    col = ove_yuv_matrix * vec4(texture(ove_maintex, ove_texcoord).r,\n"
+                                      "                                texture(ove_maintex_u, ove_texcoord).r,\n"
+                                      "                                texture(ove_maintex_v, ove_texcoord).r,\n"
+                                      "                                1.0);\n"
+                                      "    col.a = 1.0;\n"
+                                      "  } else {\n"
+                                      "    col = texture(ove_maintex, ove_texcoord);\n"
+                                      "  }\n"
                                       "\n"
                                       "  // If alpha is associated, de-associate now\n"
                                       "  if (ove_maintex_alpha == ALPHA_ASSOC) {\n"
@@ -150,8 +229,9 @@ bool Renderer::GetColorContext(ColorProcessorPtr color_processor, Renderer::Colo
                                       "}\n").arg(ocio_func_name));
 
     // Try to compile shader
-    color_ctx.compiled_shader = CreateNativeShader(ShaderCode(shader_frag,
-                                                              FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/default.vert"))));
+    color_ctx.compiled_shader = CreateNativeColorShader(color_processor,
+                                                        ShaderCode(shader_frag,
+                                                                   FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/default.vert"))));
 
     if (color_ctx.compiled_shader.isNull()) {
       return false;
@@ -219,7 +299,7 @@ bool Renderer::GetColorContext(ColorProcessorPtr color_processor, Renderer::Colo
       color_ctx.lut1d_textures[i].interpolation = (interpolation == OCIO::INTERP_NEAREST) ? Texture::kNearest : Texture::kLinear;
     }
 
-    color_cache_.insert(color_processor->id(), color_ctx);
+    color_cache_->contexts.insert(color_processor->id(), color_ctx);
 
     return true;
   }
@@ -227,7 +307,8 @@ bool Renderer::GetColorContext(ColorProcessorPtr color_processor, Renderer::Colo
 
 void Renderer::BlitColorManagedInternal(ColorProcessorPtr color_processor, TexturePtr source,
                                         bool source_is_premultiplied, Texture *destination,
-                                        VideoParams params, bool clear_destination, const QMatrix4x4& matrix)
+                                        VideoParams params, bool clear_destination, const QMatrix4x4& matrix,
+                                        const YUVPlanes* yuv)
 {
   ColorContext color_ctx;
   if (!GetColorContext(color_processor, &color_ctx)) {
@@ -254,6 +335,13 @@ void Renderer::BlitColorManagedInternal(ColorProcessorPtr color_processor, Textu
   }
   job.InsertValue(QStringLiteral("ove_maintex_alpha"), ShaderValue(associated, NodeParam::kInt));
 
+  job.InsertValue(QStringLiteral("ove_maintex_yuv"), ShaderValue(yuv != nullptr, NodeParam::kBoolean));
+  if (yuv) {
+    job.InsertValue(QStringLiteral("ove_maintex_u"), ShaderValue(QVariant::fromValue(yuv->u), NodeParam::kTexture));
+    job.InsertValue(QStringLiteral("ove_maintex_v"), ShaderValue(QVariant::fromValue(yuv->v), NodeParam::kTexture));
+    job.InsertValue(QStringLiteral("ove_yuv_matrix"), ShaderValue(GenerateYUVToRGBMatrix(yuv->layout), NodeParam::kMatrix));
+  }
+
   foreach (const ColorContext::LUT& l, color_ctx.lut3d_textures) {
     job.InsertValue(l.name, ShaderValue(QVariant::fromValue(l.texture), NodeParam::kTexture));
     job.SetInterpolation(l.name, l.interpolation);
@@ -270,4 +358,60 @@ void Renderer::BlitColorManagedInternal(ColorProcessorPtr color_processor, Textu
   }
 }
 
+QMatrix4x4 Renderer::GenerateYUVToRGBMatrix(const YUVLayout &layout)
+{
+  double kr, kb;
+  switch (layout.matrix()) {
+  case YUVLayout::kMatrixBT601:
+    kr = 0.299;
+    kb = 0.114;
+    break;
+  case YUVLayout::kMatrixBT2020:
+    kr = 0.2627;
+    kb = 0.0593;
+    break;
+  case YUVLayout::kMatrixBT709:
+  default:
+    kr = 0.2126;
+    kb = 0.0722;
+  }
+
+  double kg = 1.0 - kr - kb;
+
+  // Samples above 8-bit sit in the low bits of 16-bit textures, so the texture value is scaled by
+  // the container's maximum rather than the source's
+  int depth = layout.bit_depth();
+  int depth_shift = qMax(0, depth - 8);
+  double container_max = (depth > 8) ? 65535.0 : 255.0;
+
+  double y_offset, y_range, c_offset, c_range;
+  if (layout.full_range()) {
+    y_offset = 0;
+    y_range = (1 << depth) - 1;
+    c_offset = 1 << (depth - 1);
+    c_range = (1 << depth) - 1;
+  } else {
+    y_offset = 16 << depth_shift;
+    y_range = 219 << depth_shift;
+    c_offset = 128 << depth_shift;
+    c_range = 224 << depth_shift;
+  }
+
+  // Y' = sample * y_scale + y_bias, likewise for Cb/Cr
+  double y_scale = container_max / y_range;
+  double y_bias = -y_offset / y_range;
+  double c_scale = container_max / c_range;
+  double c_bias = -c_offset / c_range;
+
+  double r_cr = 2.0 * (1.0 - kr);
+  double g_cb = -2.0 * kb * (1.0 - kb) / kg;
+  double g_cr = -2.0 * kr * (1.0 - kr) / kg;
+  double b_cb = 2.0 * (1.0 - kb);
+
+  return QMatrix4x4(y_scale, 0,              r_cr * c_scale, y_bias + r_cr * c_bias,
+                    y_scale, g_cb * c_scale, g_cr * c_scale, y_bias + (g_cb + g_cr) * c_bias,
+                    y_scale, b_cb * c_scale, 0,              y_bias + b_cb * c_bias,
+                    0,       0,              0,              1);
+}
+
 }
@@ -21,15 +21,18 @@
 #ifndef RENDERCONTEXT_H
 #define RENDERCONTEXT_H
 
+#include <QMutex>
 #include <QObject>
 #include <QVariant>
 
 #include "common/define.h"
 #include "common/timerange.h"
 #include "node/node.h"
+#include "codec/frame.h"
 #include "render/colorprocessor.h"
 #include "render/videoparams.h"
 #include "texture.h"
+#include "texturepool.h"
 
 namespace olive {
 
@@ -65,10 +68,73 @@ public:
   void BlitColorManaged(ColorProcessorPtr color_processor, TexturePtr source, bool source_is_premultiplied, Texture* destination, bool clear_destination = true, const QMatrix4x4& matrix = QMatrix4x4());
   void BlitColorManaged(ColorProcessorPtr color_processor, TexturePtr source, bool source_is_premultiplied, VideoParams params, bool clear_destination = true, const QMatrix4x4& matrix = QMatrix4x4());
 
+  /**
+   * @brief Color manage a frame from separate Y, U, and V plane textures
+   *
+   * The planes are converted to RGB using the matrix and range in `layout` in the same pass as
+   * the color transform.
+   */
+  void BlitColorManagedYUV(ColorProcessorPtr color_processor, TexturePtr y, TexturePtr u, TexturePtr v, const YUVLayout& layout, Texture* destination);
+
+  /**
+   * @brief Compile the shader and LUTs this color processor needs ahead of time
+   *
+   * Normally they're created the first time the processor is blitted with, which stalls that
+   * frame. Returns FALSE if the processor couldn't be compiled.
+   */
+  bool PrepareColorProcessor(ColorProcessorPtr color_processor);
+
+  /**
+   * @brief Only draw the pixels of blits inside `region` until this is set back to a null rect
+   *
+   * Destinations are still cleared in full, so everything outside the region ends up empty.
+   * Applies to every blit while it's set, so callers should only set it around the blits that
+   * are meant to be restricted.
+   */
+  void SetRegionOfInterest(const QRect& region)
+  {
+    region_of_interest_ = region;
+  }
+
+  const QRect& region_of_interest() const
+  {
+    return region_of_interest_;
+  }
+
+  /**
+   * @brief Use the same compiled color contexts as `other`
+   *
+   * Only valid if both renderers share resources. Must be called before either is used.
+   */
+  void ShareColorCache(Renderer* other);
+
+  /**
+   * @brief Set which MemoryAccounting category textures created by this renderer count towards
+   *
+   * Defaults to MemoryAccounting::kTextureIntermediate, a MemoryAccounting::TextureOriginScope
+   * on the creating thread takes precedence.
+   */
+  void SetTextureOrigin(MemoryAccounting::Category origin)
+  {
+    texture_origin_ = origin;
+  }
+
   void Destroy();
 
   virtual void PostDestroy() = 0;
 
+  /**
+   * @brief Called by Texture when it's no longer referenced
+   *
+   * 2D textures are kept in the texture pool for reuse, everything else is destroyed.
+   */
+  virtual void ReleaseTexture(const QVariant& native, const VideoParams& params, Texture::Type type);
+
+  const TexturePool& texture_pool() const
+  {
+    return texture_pool_;
+  }
+
 public slots:
   virtual void PostInit() = 0;
 
@@ -89,6 +155,51 @@ public slots:
 
   virtual void DownloadFromTexture(olive::Texture* texture, void* data, int linesize) = 0;
 
+  /**
+   * @brief Start an asynchronous download of a texture's contents
+   *
+   * Returns a handle that must be passed to FinishDownloadFromTexture() to retrieve the data. The
+   * renderer is free to do other work while the transfer is in progress. Returns a null QVariant
+   * if asynchronous downloads aren't supported, in which case DownloadFromTexture() should be
+   * used instead.
+   */
+  virtual QVariant BeginDownloadFromTexture(olive::Texture* texture, int linesize) = 0;
+
+  /**
+   * @brief Start an asynchronous download of a small region of a texture
+   *
+   * Like BeginDownloadFromTexture() except only `region` is read, tightly packed and always as
+   * four channels regardless of the texture's channel count, so the data passed to
+   * FinishDownloadFromTexture() must fit `region.width() * region.height()` RGBA pixels.
+   */
+  virtual QVariant BeginDownloadRegionFromTexture(olive::Texture* texture, const QRect& region) = 0;
+
+  /**
+   * @brief Wait for a download started by BeginDownloadFromTexture() to complete and copy it to `data`
+   */
+  virtual void FinishDownloadFromTexture(QVariant download, void* data) = 0;
+
+  /**
+   * @brief Block until all commands submitted to this renderer have completed
+   *
+   * Required before a texture written by this renderer can be read by another renderer that
+   * shares its resources.
+   */
+  virtual void Flush() = 0;
+
+protected:
+  /**
+   * @brief Compile the shader color managed blits with `color_processor` are drawn with
+   *
+   * `code` is the GLSL generated from the processor, which is all the default implementation
+   * needs. Renderers that can't run GLSL can override this to apply the processor directly.
+   */
+  virtual QVariant CreateNativeColorShader(ColorProcessorPtr color_processor, const ShaderCode& code)
+  {
+    Q_UNUSED(color_processor)
+    return CreateNativeShader(code);
+  }
+
 protected slots:
   virtual void Blit(QVariant shader,
                     olive::ShaderJob job,
@@ -110,6 +221,11 @@ private:
 
   };
 
+  struct ColorCache {
+    QHash<QString, ColorContext> contexts;
+    QMutex mutex;
+  };
+
   enum AlphaAssociated {
     kAlphaNone,
     kAlphaUnassociated,
@@ -118,14 +234,31 @@ private:
 
   bool GetColorContext(ColorProcessorPtr color_processor, ColorContext* ctx);
 
+  struct YUVPlanes {
+    TexturePtr u;
+    TexturePtr v;
+    YUVLayout layout;
+  };
+
   void BlitColorManagedInternal(ColorProcessorPtr color_processor, TexturePtr source,
                                 bool source_is_premultiplied,
                                 Texture* destination, VideoParams params, bool clear_destination,
-                                const QMatrix4x4 &matrix);
+                                const QMatrix4x4 &matrix, const YUVPlanes* yuv = nullptr);
+
+  /**
+   * @brief Create a matrix converting normalized Y'CbCr texture samples to R'G'B'
+   */
+  static QMatrix4x4 GenerateYUVToRGBMatrix(const YUVLayout& layout);
+
+  void DestroyNativeTextures(const QVector<QVariant>& textures);
+
+  std::shared_ptr<ColorCache> color_cache_;
+
+  TexturePool texture_pool_;
 
-  QHash<QString, ColorContext> color_cache_;
+  QRect region_of_interest_;
 
-  QMutex color_cache_mutex_;
+  MemoryAccounting::Category texture_origin_;
 
 };
 
@@ -20,12 +20,55 @@
 
 #include "rendererthreadwrapper.h"
 
+#include <QCoreApplication>
+#include <QEvent>
+
 namespace olive {
 
+const int RendererThreadWrapper::kMaximumRecordedCommands = 64;
+
+class RendererThreadWrapper::Executor : public QObject
+{
+public:
+  class SubmitEvent : public QEvent
+  {
+  public:
+    SubmitEvent(CommandListPtr l) :
+      QEvent(QEvent::User),
+      list(l)
+    {
+    }
+
+    CommandListPtr list;
+  };
+
+  virtual bool event(QEvent* e) override
+  {
+    if (e->type() != QEvent::User) {
+      return QObject::event(e);
+    }
+
+    CommandListPtr list = static_cast<SubmitEvent*>(e)->list;
+
+    for (int i=0; i<list->commands.size(); i++) {
+      list->commands.at(i)();
+    }
+
+    // Whatever the commands hold (e.g. textures in shader jobs) is released on this thread, so
+    // textures no longer in use go back to the pool without another round trip
+    list->commands.clear();
+
+    list->done.release();
+
+    return true;
+  }
+};
+
 RendererThreadWrapper::RendererThreadWrapper(Renderer *inner, QObject *parent) :
   Renderer(parent),
   inner_(inner),
-  thread_(nullptr)
+  thread_(nullptr),
+  executor_(nullptr)
 {
 }
 
@@ -43,8 +86,12 @@ bool RendererThreadWrapper::Init()
   // Move context to thread
   inner_->moveToThread(thread_);
 
-  // Queue post-init in new thread
-  QMetaObject::invokeMethod(inner_, "PostInit", Qt::BlockingQueuedConnection);
+  executor_ = new Executor();
+  executor_->moveToThread(thread_);
+
+  // Queue post-init in new thread. Every later call is queued behind it, so there's no need to wait
+  // for the context to be made current and the UI can be built in the meantime.
+  QMetaObject::invokeMethod(inner_, "PostInit", Qt::QueuedConnection);
 
   return true;
 }
@@ -57,39 +104,60 @@ void RendererThreadWrapper::PostInit()
 void RendererThreadWrapper::DestroyInternal()
 {
   if (thread_) {
-    QMetaObject::invokeMethod(inner_, "DestroyInternal", Qt::BlockingQueuedConnection);
+    // Anything still recorded goes first, it may hold resources that are about to be destroyed
+    {
+      QMutexLocker locker(&recorded_lock_);
+
+      foreach (CommandListPtr list, recorded_) {
+        Submit(list, false);
+      }
+
+      recorded_.clear();
+    }
+
+    Run([this]{ inner_->DestroyInternal(); });
 
     thread_->quit();
     thread_->wait();
     delete thread_;
     thread_ = nullptr;
 
+    delete executor_;
+    executor_ = nullptr;
+
     // Destroy in main thread
     inner_->PostDestroy();
   }
 }
 
+void RendererThreadWrapper::ReleaseTexture(const QVariant &native, const VideoParams &params, Texture::Type type)
+{
+  bool recorded;
+
+  {
+    QMutexLocker locker(&recorded_lock_);
+    recorded = recorded_.contains(QThread::currentThread());
+  }
+
+  // This thread may have recorded commands that draw to this texture, they have to run before it's
+  // gone and before the pool can give it to another thread
+  if (recorded) {
+    Run([]{});
+  }
+
+  Renderer::ReleaseTexture(native, params, type);
+}
+
 void RendererThreadWrapper::ClearDestination(double r, double g, double b, double a)
 {
-  QMetaObject::invokeMethod(inner_, "ClearDestination", Qt::BlockingQueuedConnection,
-                            Q_ARG(double, r),
-                            Q_ARG(double, g),
-                            Q_ARG(double, b),
-                            Q_ARG(double, a));
+  Record([this, r, g, b, a]{ inner_->ClearDestination(r, g, b, a); });
 }
 
 QVariant RendererThreadWrapper::CreateNativeTexture2D(int width, int height, VideoParams::Format format, int channel_count, const void *data, int linesize)
 {
   QVariant v;
 
-  QMetaObject::invokeMethod(inner_, "CreateNativeTexture2D", Qt::BlockingQueuedConnection,
-                            Q_RETURN_ARG(QVariant, v),
-                            Q_ARG(int, width),
-                            Q_ARG(int, height),
-                            OLIVE_NS_ARG(VideoParams::Format, format),
-                            Q_ARG(int, channel_count),
-                            Q_ARG(const void*, data),
-                            Q_ARG(int, linesize));
+  Run([&]{ v = inner_->CreateNativeTexture2D(width, height, format, channel_count, data, linesize); });
 
   return v;
 }
@@ -98,66 +166,135 @@ QVariant RendererThreadWrapper::CreateNativeTexture3D(int width, int height, int
 {
   QVariant v;
 
-  QMetaObject::invokeMethod(inner_, "CreateNativeTexture3D", Qt::BlockingQueuedConnection,
-                            Q_RETURN_ARG(QVariant, v),
-                            Q_ARG(int, width),
-                            Q_ARG(int, height),
-                            Q_ARG(int, depth),
-                            OLIVE_NS_ARG(VideoParams::Format, format),
-                            Q_ARG(int, channel_count),
-                            Q_ARG(const void*, data),
-                            Q_ARG(int, linesize));
+  Run([&]{ v = inner_->CreateNativeTexture3D(width, height, depth, format, channel_count, data, linesize); });
 
   return v;
 }
 
 void RendererThreadWrapper::DestroyNativeTexture(QVariant texture)
 {
-  QMetaObject::invokeMethod(inner_, "DestroyNativeTexture", Qt::BlockingQueuedConnection,
-                            Q_ARG(QVariant, texture));
+  Record([this, texture]{ inner_->DestroyNativeTexture(texture); });
 }
 
 QVariant RendererThreadWrapper::CreateNativeShader(ShaderCode code)
 {
   QVariant v;
 
-  QMetaObject::invokeMethod(inner_, "CreateNativeShader", Qt::BlockingQueuedConnection,
-                            Q_RETURN_ARG(QVariant, v),
-                            OLIVE_NS_ARG(ShaderCode, code));
+  Run([&]{ v = inner_->CreateNativeShader(code); });
 
   return v;
 }
 
 void RendererThreadWrapper::DestroyNativeShader(QVariant shader)
 {
-  QMetaObject::invokeMethod(inner_, "DestroyNativeShader", Qt::BlockingQueuedConnection,
-                            Q_ARG(QVariant, shader));
+  Record([this, shader]{ inner_->DestroyNativeShader(shader); });
 }
 
 void RendererThreadWrapper::UploadToTexture(Texture *texture, const void *data, int linesize)
 {
-  QMetaObject::invokeMethod(inner_, "UploadToTexture", Qt::BlockingQueuedConnection,
-                            OLIVE_NS_ARG(Texture*, texture),
-                            Q_ARG(const void*, data),
-                            Q_ARG(int, linesize));
+  // The caller is free to release the data as soon as we return, so this can't be recorded
+  Run([&]{ inner_->UploadToTexture(texture, data, linesize); });
 }
 
 void RendererThreadWrapper::DownloadFromTexture(Texture *texture, void *data, int linesize)
 {
-  QMetaObject::invokeMethod(inner_, "DownloadFromTexture", Qt::BlockingQueuedConnection,
-                            OLIVE_NS_ARG(Texture*, texture),
-                            Q_ARG(void*, data),
-                            Q_ARG(int, linesize));
+  Run([&]{ inner_->DownloadFromTexture(texture, data, linesize); });
+}
+
+QVariant RendererThreadWrapper::BeginDownloadFromTexture(Texture *texture, int linesize)
+{
+  QVariant v;
+
+  Run([&]{ v = inner_->BeginDownloadFromTexture(texture, linesize); });
+
+  return v;
+}
+
+QVariant RendererThreadWrapper::BeginDownloadRegionFromTexture(Texture *texture, const QRect &region)
+{
+  QVariant v;
+
+  Run([&]{ v = inner_->BeginDownloadRegionFromTexture(texture, region); });
+
+  return v;
+}
+
+void RendererThreadWrapper::FinishDownloadFromTexture(QVariant download, void *data)
+{
+  Run([&]{ inner_->FinishDownloadFromTexture(download, data); });
+}
+
+void RendererThreadWrapper::Flush()
+{
+  Run([this]{ inner_->Flush(); });
 }
 
 void RendererThreadWrapper::Blit(QVariant shader, ShaderJob job, Texture *destination, VideoParams destination_params, bool clear_destination)
 {
-  QMetaObject::invokeMethod(inner_, "Blit", Qt::BlockingQueuedConnection,
-                            Q_ARG(QVariant, shader),
-                            OLIVE_NS_ARG(ShaderJob, job),
-                            OLIVE_NS_ARG(Texture*, destination),
-                            OLIVE_NS_ARG(VideoParams, destination_params),
-                            Q_ARG(bool, clear_destination));
+  // The inner Blit() is protected, but the public overloads lead to it with the same arguments
+  // since a destination's params are always its own
+  Record([this, shader, job, destination, destination_params, clear_destination]{
+    if (destination) {
+      inner_->BlitToTexture(shader, job, destination, clear_destination);
+    } else {
+      inner_->Blit(shader, job, destination_params, clear_destination);
+    }
+  });
+}
+
+void RendererThreadWrapper::Record(const std::function<void ()> &command)
+{
+  if (QThread::currentThread() == thread_) {
+    command();
+    return;
+  }
+
+  QMutexLocker locker(&recorded_lock_);
+
+  CommandListPtr& list = recorded_[QThread::currentThread()];
+
+  if (!list) {
+    list = std::make_shared<CommandList>();
+  }
+
+  list->commands.append(command);
+
+  if (list->commands.size() >= kMaximumRecordedCommands) {
+    Submit(recorded_.take(QThread::currentThread()), false);
+  }
+}
+
+void RendererThreadWrapper::Run(const std::function<void ()> &command)
+{
+  if (QThread::currentThread() == thread_) {
+    command();
+    return;
+  }
+
+  CommandListPtr list;
+
+  {
+    QMutexLocker locker(&recorded_lock_);
+    list = recorded_.take(QThread::currentThread());
+  }
+
+  if (!list) {
+    list = std::make_shared<CommandList>();
+  }
+
+  list->commands.append(command);
+
+  Submit(list, true);
+}
+
+void RendererThreadWrapper::Submit(CommandListPtr list, bool wait)
+{
+  // Posted events are handled in order, so lists run in the order they were submitted
+  QCoreApplication::postEvent(executor_, new Executor::SubmitEvent(list));
+
+  if (wait) {
+    list->done.acquire();
+  }
 }
 
 }
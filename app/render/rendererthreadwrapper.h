@@ -21,12 +21,25 @@
 #ifndef RENDERCONTEXTTHREADWRAPPER_H
 #define RENDERCONTEXTTHREADWRAPPER_H
 
+#include <functional>
+#include <QHash>
+#include <QMutex>
+#include <QSemaphore>
 #include <QThread>
 
 #include "renderer.h"
 
 namespace olive {
 
+/**
+ * @brief Runs another Renderer on a thread of its own
+ *
+ * Calls that don't return anything (blits, clears and destroying resources) aren't sent to the
+ * renderer's thread straight away. Each calling thread records them into its own command list,
+ * which is submitted in one go at the next call that needs an answer, e.g. a download or Flush().
+ * A frame through a large graph is then a couple of round trips rather than one per call, and
+ * lists from different threads are simply run one after the other on the renderer's thread.
+ */
 class RendererThreadWrapper : public Renderer
 {
 public:
@@ -43,6 +56,8 @@ public:
 
   virtual void PostDestroy() override {}
 
+  virtual void ReleaseTexture(const QVariant& native, const VideoParams& params, Texture::Type type) override;
+
 public slots:
   virtual void PostInit() override;
 
@@ -63,6 +78,14 @@ public slots:
 
   virtual void DownloadFromTexture(olive::Texture* texture, void* data, int linesize) override;
 
+  virtual QVariant BeginDownloadFromTexture(olive::Texture* texture, int linesize) override;
+
+  virtual QVariant BeginDownloadRegionFromTexture(olive::Texture* texture, const QRect& region) override;
+
+  virtual void FinishDownloadFromTexture(QVariant download, void* data) override;
+
+  virtual void Flush() override;
+
 protected slots:
   virtual void Blit(QVariant shader,
                     olive::ShaderJob job,
@@ -71,10 +94,49 @@ protected slots:
                     bool clear_destination) override;
 
 private:
+  struct CommandList {
+    QVector< std::function<void()> > commands;
+
+    /// Released once the commands have run
+    QSemaphore done;
+  };
+
+  using CommandListPtr = std::shared_ptr<CommandList>;
+
+  /**
+   * @brief Object on the renderer's thread that command lists are posted to
+   */
+  class Executor;
+
+  /**
+   * @brief Add a command to this thread's list to be run at the next submission
+   */
+  void Record(const std::function<void()>& command);
+
+  /**
+   * @brief Run a command after everything this thread has recorded, and wait for it
+   */
+  void Run(const std::function<void()>& command);
+
+  void Submit(CommandListPtr list, bool wait);
+
+  /**
+   * @brief Commands a thread can record before they're submitted without waiting
+   *
+   * Keeps the renderer busy while a long graph is being recorded.
+   */
+  static const int kMaximumRecordedCommands;
+
   Renderer* inner_;
 
   QThread* thread_;
 
+  Executor* executor_;
+
+  QHash<QThread*, CommandListPtr> recorded_;
+
+  QMutex recorded_lock_;
+
 };
 
 }
@@ -22,14 +22,19 @@
 
 #include <QApplication>
 #include <QDateTime>
+#include <QDir>
+#include <QFile>
 #include <QMatrix4x4>
 #include <QThread>
 
+#include "common/filefunctions.h"
 #include "config/config.h"
 #include "core.h"
 #include "render/opengl/openglrenderer.h"
 #include "render/rendererthreadwrapper.h"
+#include "render/software/softwarerenderer.h"
 #include "renderprocessor.h"
+#include "renderrecorder.h"
 #include "task/conform/conform.h"
 #include "task/taskmanager.h"
 #include "window/mainwindow/mainwindow.h"
@@ -38,51 +43,161 @@ namespace olive {
 
 RenderManager* RenderManager::instance_ = nullptr;
 
-RenderManager::RenderManager(QObject *parent) :
+const quint64 RenderManager::kGPUTimingHistory = 256;
+
+RenderManager::RenderManager(Backend backend, QObject *parent) :
   ThreadPool(QThread::IdlePriority, 0, parent),
-  backend_(kOpenGL)
+  backend_(backend),
+  display_sharing_(false),
+  profiling_listeners_(0),
+  gpu_timing_tags_(0),
+  slowest_gpu_pass_({QString(), QString(), 0}),
+  slowest_gpu_pass_time_(0)
 {
-  Renderer* graphics_renderer = nullptr;
-
-  if (backend_ == kOpenGL) {
-    graphics_renderer = new OpenGLRenderer();
+  io_pool_ = new CacheIOPool(this);
+
+  if (backend_ == kOpenGL || backend_ == kOpenGLHeadless) {
+    // Each renderer gets its own thread and context, all sharing resources with the first so
+    // textures and shaders can be used by any of them
+    int renderer_count = qMax(1, Config::Current()["RenderThreads"].toInt());
+    OpenGLRenderer* share = nullptr;
+
+    for (int i=0; i<renderer_count; i++) {
+      OpenGLRenderer* graphics_renderer = new OpenGLRenderer();
+      graphics_renderer->SetShareRenderer(share);
+
+      RendererThreadWrapper* wrapper = new RendererThreadWrapper(graphics_renderer, this);
+
+      if (!wrapper->Init()) {
+        qWarning() << "Failed to create renderer" << i << "- continuing with" << contexts_.size();
+        delete wrapper;
+        break;
+      }
+
+      wrapper->PostInit();
+
+      if (share) {
+        // Compiled color contexts are shared resources too, so only one renderer has to build each
+        wrapper->ShareColorCache(contexts_.first());
+      } else {
+        share = graphics_renderer;
+
+        // Everything else shares with the first renderer, so if it shares with the display
+        // widgets, they can all draw what any renderer produces
+        display_sharing_ = graphics_renderer->SharesWithDisplay();
+      }
+
+      contexts_.append(wrapper);
+    }
+  } else if (backend_ == kSoftware) {
+    // Software rendering has no context to be bound to, so every worker can use the same renderer
+    // and its blits spread across the global thread pool themselves
+    SoftwareRenderer* software_renderer = new SoftwareRenderer(this);
+
+    software_renderer->Init();
+    software_renderer->PostInit();
+
+    contexts_.append(software_renderer);
   }
 
-  if (graphics_renderer) {
-    context_ = new RendererThreadWrapper(graphics_renderer, this);
-    context_->Init();
-    context_->PostInit();
-
-    still_cache_ = new StillImageCache();
+  if (!contexts_.isEmpty()) {
+    still_cache_ = new StillImageCache(tr("Still Image Textures"), QStringLiteral("StillImageCacheSize"));
+    video_cache_ = new StillImageCache(tr("Video Frame Textures"), QStringLiteral("VideoTextureCacheSize"));
     decoder_cache_ = new DecoderCache();
     shader_cache_ = new ShaderCache();
-    default_shader_ = context_->CreateNativeShader(ShaderCode(QString(), QString()));
+
+    // Shaders used last session are likely to be used again, compiling them in the background
+    // now saves a hitch the first time each effect appears in playback
+    QFile shader_list_file(GetShaderListFilePath());
+    if (shader_list_file.open(QFile::ReadOnly | QFile::Text)) {
+      QStringList shader_ids = QString::fromUtf8(shader_list_file.readAll()).split('\n');
+      shader_ids.removeAll(QString());
+
+      shader_list_file.close();
+
+      if (!shader_ids.isEmpty()) {
+        WarmShaders(shader_ids);
+      }
+    }
   } else {
     qCritical() << "Tried to initialize unknown graphics backend";
-    context_ = nullptr;
     still_cache_ = nullptr;
+    video_cache_ = nullptr;
     decoder_cache_ = nullptr;
   }
 }
 
 RenderManager::~RenderManager()
 {
-  if (context_) {
-    context_->DestroyNativeShader(default_shader_);
+  // Let any in-flight writes finish before the caches and renderers go away
+  delete io_pool_;
+
+  if (!contexts_.isEmpty()) {
+    if (!default_shader_.isNull()) {
+      contexts_.first()->DestroyNativeShader(default_shader_);
+    }
+
+    // Remember which node shaders were compiled for the next launch, generated shaders can't be
+    // rebuilt from their key alone so only "nodeid:shaderid" keys are kept
+    {
+      QStringList shader_ids;
+
+      QMutexLocker locker(shader_cache_->mutex());
+      for (auto it=shader_cache_->cbegin(); it!=shader_cache_->cend(); it++) {
+        if (it.key().contains(':') && !it.key().startsWith(QStringLiteral("fused:"))) {
+          shader_ids.append(it.key());
+        }
+      }
+      locker.unlock();
+
+      QFile shader_list_file(GetShaderListFilePath());
+      if (shader_list_file.open(QFile::WriteOnly | QFile::Text)) {
+        shader_list_file.write(shader_ids.join('\n').toUtf8());
+        shader_list_file.close();
+      }
+    }
 
     delete shader_cache_;
     delete decoder_cache_;
+    delete video_cache_;
     delete still_cache_;
 
-    context_->Destroy();
-    context_->PostDestroy();
-    delete context_;
+    // Destroy in reverse so the renderer everything shares with goes last
+    for (int i=contexts_.size()-1; i>=0; i--) {
+      Renderer* context = contexts_.at(i);
+
+      context->Destroy();
+      context->PostDestroy();
+      delete context;
+    }
+  }
+}
+
+void RenderManager::PrepareHeadlessPlatform()
+{
+  // eglfs is the only EGL plugin with offscreen surfaces, which are all we render to. Without an
+  // integration it uses the default EGL display, which Mesa makes surfaceless with EGL_PLATFORM.
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "eglfs");
   }
+
+  if (qEnvironmentVariableIsEmpty("QT_QPA_EGLFS_INTEGRATION")) {
+    qputenv("QT_QPA_EGLFS_INTEGRATION", "none");
+  }
+
+  if (qEnvironmentVariableIsEmpty("EGL_PLATFORM")) {
+    qputenv("EGL_PLATFORM", "surfaceless");
+  }
+}
+
+void RenderManager::SelectRenderDevice(const QString &device)
+{
+  qputenv("DRI_PRIME", device.toUtf8());
 }
 
 QByteArray RenderManager::Hash(const Node *n, const VideoParams &params, const rational &time)
 {
-  QCryptographicHash hasher(QCryptographicHash::Sha1);
+  QCryptographicHash hasher(Node::kHashAlgorithm);
 
   // Embed video parameters into this hash
   int width = params.effective_width();
@@ -94,7 +209,7 @@ QByteArray RenderManager::Hash(const Node *n, const VideoParams &params, const r
   hasher.addData(reinterpret_cast<const char*>(&format), sizeof(VideoParams::Format));
 
   if (n) {
-    n->Hash(hasher, time);
+    hasher.addData(n->GetCachedHash(time));
   }
 
   return hasher.result();
@@ -102,7 +217,7 @@ QByteArray RenderManager::Hash(const Node *n, const VideoParams &params, const r
 
 RenderTicketPtr RenderManager::RenderFrame(ViewerOutput* viewer, ColorManager* color_manager,
                                            const rational& time, RenderMode::Mode mode,
-                                           FrameHashCache* cache, bool prioritize)
+                                           FrameHashCache* cache, TicketPriority priority)
 {
   return RenderFrame(viewer,
                      color_manager,
@@ -115,7 +230,7 @@ RenderTicketPtr RenderManager::RenderFrame(ViewerOutput* viewer, ColorManager* c
                      VideoParams::kFormatInvalid,
                      nullptr,
                      cache,
-                     prioritize);
+                     priority);
 }
 
 RenderTicketPtr RenderManager::RenderFrame(ViewerOutput* viewer, ColorManager* color_manager,
@@ -124,92 +239,379 @@ RenderTicketPtr RenderManager::RenderFrame(ViewerOutput* viewer, ColorManager* c
                                            const QSize& force_size,
                                            const QMatrix4x4& force_matrix, VideoParams::Format force_format,
                                            ColorProcessorPtr force_color_output,
-                                           FrameHashCache* cache, bool prioritize)
+                                           FrameHashCache* cache, TicketPriority priority,
+                                           const QRect& region, bool best_effort)
 {
-  // Create ticket
-  RenderTicketPtr ticket = std::make_shared<RenderTicket>();
+  // Partial and best effort frames aren't "the" frame at this time so they're never shared
+  bool shareable = region.isNull() && !best_effort;
+  QByteArray key;
 
-  ticket->setProperty("viewer", Node::PtrToValue(viewer));
-  ticket->setProperty("time", QVariant::fromValue(time));
-  ticket->setProperty("size", force_size);
-  ticket->setProperty("matrix", force_matrix);
-  ticket->setProperty("format", force_format);
-  ticket->setProperty("mode", mode);
-  ticket->setProperty("type", kTypeVideo);
-  ticket->setProperty("colormanager", Node::PtrToValue(color_manager));
-  ticket->setProperty("coloroutput", QVariant::fromValue(force_color_output));
-  ticket->setProperty("vparam", QVariant::fromValue(video_params));
-  ticket->setProperty("aparam", QVariant::fromValue(audio_params));
+  if (shareable) {
+    key = GetInFlightKey(viewer, color_manager, time, mode, video_params, force_size, force_matrix,
+                         force_format, force_color_output);
 
-  if (cache) {
-    ticket->setProperty("cache", cache->GetCacheDirectory());
+    QMutexLocker locker(&in_flight_lock_);
+
+    RenderTicketPtr existing = in_flight_.value(key);
+
+    if (existing && existing->AddRequester()) {
+      locker.unlock();
+
+      RenderRecorder::Record(existing, priority, true);
+
+      // Somebody more impatient is waiting on it now
+      EscalateTicket(existing, priority);
+
+      return existing;
+    }
   }
 
-  if (ticket->thread() != this->thread()) {
-    ticket->moveToThread(this->thread());
+  RenderTicketPtr ticket = CreateFrameTicket(viewer, color_manager, time, mode, video_params,
+                                             audio_params, force_size, force_matrix, force_format,
+                                             force_color_output, cache, RenderRequest::kTypeVideo, region,
+                                             best_effort);
+
+  if (shareable) {
+    RenderTicket* raw = ticket.get();
+
+    connect(raw, &RenderTicket::Finished, this, [this, key, raw]{
+      QMutexLocker locker(&in_flight_lock_);
+
+      // Only remove it if it hasn't already been replaced by a newer request
+      auto it = in_flight_.find(key);
+      if (it != in_flight_.end() && it.value().get() == raw) {
+        in_flight_.erase(it);
+      }
+    }, Qt::DirectConnection);
+
+    QMutexLocker locker(&in_flight_lock_);
+    in_flight_.insert(key, ticket);
   }
 
-  // Queue appending the ticket and running the next job on our thread to make this function thread-safe
-  QMetaObject::invokeMethod(this, "AddTicket", Qt::AutoConnection,
-                            OLIVE_NS_ARG(RenderTicketPtr, ticket),
-                            Q_ARG(bool, prioritize));
+  RenderRecorder::Record(ticket, priority);
+
+  AddTicket(ticket, priority);
+
+  return ticket;
+}
+
+RenderTicketPtr RenderManager::RenderFrames(ViewerOutput *viewer, ColorManager *color_manager,
+                                            const QVector<rational> &times, RenderMode::Mode mode,
+                                            const VideoParams &video_params, const AudioParams &audio_params,
+                                            const QSize &force_size,
+                                            const QMatrix4x4 &force_matrix, VideoParams::Format force_format,
+                                            ColorProcessorPtr force_color_output,
+                                            FrameHashCache *cache, TicketPriority priority)
+{
+  RenderTicketPtr ticket = CreateFrameTicket(viewer, color_manager, times.isEmpty() ? rational() : times.first(),
+                                             mode, video_params, audio_params, force_size, force_matrix,
+                                             force_format, force_color_output, cache,
+                                             RenderRequest::kTypeVideoBatch, QRect(), false, times);
+
+  RenderRecorder::Record(ticket, priority);
+
+  AddTicket(ticket, priority);
 
   return ticket;
 }
 
-RenderTicketPtr RenderManager::RenderAudio(ViewerOutput* viewer, const TimeRange& r, bool generate_waveforms, bool prioritize)
+RenderTicketPtr RenderManager::RenderFrameForDisplay(ViewerOutput *viewer, ColorManager *color_manager,
+                                                     const rational &time, RenderMode::Mode mode,
+                                                     TicketPriority priority, const QRect& region,
+                                                     bool best_effort)
 {
-  return RenderAudio(viewer, r, viewer->audio_params(), generate_waveforms, prioritize);
+  RenderTicketPtr ticket = CreateFrameTicket(viewer, color_manager, time, mode,
+                                             viewer->video_params(), viewer->audio_params(),
+                                             QSize(0, 0), QMatrix4x4(), VideoParams::kFormatInvalid,
+                                             nullptr, nullptr, RenderRequest::kTypeVideoTexture, region,
+                                             best_effort);
+
+  RenderRecorder::Record(ticket, priority);
+
+  AddTicket(ticket, priority);
+
+  return ticket;
 }
 
-RenderTicketPtr RenderManager::RenderAudio(ViewerOutput* viewer, const TimeRange &r, const AudioParams &params, bool generate_waveforms, bool prioritize)
+RenderTicketPtr RenderManager::CreateFrameTicket(ViewerOutput *viewer, ColorManager *color_manager,
+                                                 const rational &time, RenderMode::Mode mode,
+                                                 const VideoParams &video_params, const AudioParams &audio_params,
+                                                 const QSize &force_size,
+                                                 const QMatrix4x4 &force_matrix, VideoParams::Format force_format,
+                                                 ColorProcessorPtr force_color_output,
+                                                 FrameHashCache *cache, RenderRequest::Type type,
+                                                 const QRect &region, bool best_effort,
+                                                 const QVector<rational> &batch_times)
 {
+  std::shared_ptr<FrameRenderRequest> request = std::make_shared<FrameRenderRequest>(type);
+
+  request->viewer = viewer;
+  request->color_manager = color_manager;
+  request->time = time;
+  request->video_params = video_params;
+  request->audio_params = audio_params;
+  request->force_size = force_size;
+  request->force_matrix = force_matrix;
+  request->force_format = force_format;
+  request->force_color_output = force_color_output;
+  request->mode = mode;
+
+  // Reduced precision is a preview-only tradeoff, exports always render at the sequence's format
+  if (mode == RenderMode::kOffline) {
+    request->precision = static_cast<RenderMode::Precision>(Config::Current()[QStringLiteral("PreviewPrecision")].toInt());
+  } else {
+    request->precision = RenderMode::kPrecisionAccurate;
+  }
+
+  request->region = region;
+
+  if (cache) {
+    request->cache_directory = cache->GetCacheDirectory();
+  }
+
+  request->best_effort = best_effort;
+  request->batch_times = batch_times;
+
   // Create ticket
   RenderTicketPtr ticket = std::make_shared<RenderTicket>();
+  ticket->SetRequest(request);
 
-  ticket->setProperty("viewer", Node::PtrToValue(viewer));
-  ticket->setProperty("time", QVariant::fromValue(r));
-  ticket->setProperty("type", kTypeAudio);
-  ticket->setProperty("enablewaveforms", generate_waveforms);
-  ticket->setProperty("aparam", QVariant::fromValue(params));
+  return ticket;
+}
 
-  if (ticket->thread() != this->thread()) {
-    ticket->moveToThread(this->thread());
-  }
+QByteArray RenderManager::GetInFlightKey(ViewerOutput *viewer, ColorManager *color_manager,
+                                        const rational &time, RenderMode::Mode mode,
+                                        const VideoParams &video_params, const QSize &force_size,
+                                        const QMatrix4x4 &force_matrix, VideoParams::Format force_format,
+                                        ColorProcessorPtr force_color_output)
+{
+  QCryptographicHash hasher(Node::kHashAlgorithm);
 
-  // Queue appending the ticket and running the next job on our thread to make this function thread-safe
-  QMetaObject::invokeMethod(this, "AddTicket", Qt::AutoConnection,
-                            OLIVE_NS_ARG(RenderTicketPtr, ticket),
-                            Q_ARG(bool, prioritize));
+  hasher.addData(Hash(viewer, video_params, time));
+
+  // Everything else that changes the returned frame, color managers and processors are compared
+  // by identity since they're shared between requests for the same output anyway
+  quintptr color_manager_ptr = reinterpret_cast<quintptr>(color_manager);
+  quintptr color_output_ptr = reinterpret_cast<quintptr>(force_color_output.get());
+  int force_width = force_size.width();
+  int force_height = force_size.height();
+
+  hasher.addData(reinterpret_cast<const char*>(&color_manager_ptr), sizeof(quintptr));
+  hasher.addData(reinterpret_cast<const char*>(&color_output_ptr), sizeof(quintptr));
+  hasher.addData(reinterpret_cast<const char*>(&mode), sizeof(RenderMode::Mode));
+  hasher.addData(reinterpret_cast<const char*>(&force_width), sizeof(int));
+  hasher.addData(reinterpret_cast<const char*>(&force_height), sizeof(int));
+  hasher.addData(reinterpret_cast<const char*>(force_matrix.constData()), 16 * sizeof(float));
+  hasher.addData(reinterpret_cast<const char*>(&force_format), sizeof(VideoParams::Format));
+
+  return hasher.result();
+}
+
+RenderTicketPtr RenderManager::RenderAudio(ViewerOutput* viewer, const TimeRange& r, bool generate_waveforms, TicketPriority priority)
+{
+  return RenderAudio(viewer, r, viewer->audio_params(), generate_waveforms, priority);
+}
+
+RenderTicketPtr RenderManager::RenderAudio(ViewerOutput* viewer, const TimeRange &r, const AudioParams &params, bool generate_waveforms, TicketPriority priority)
+{
+  std::shared_ptr<AudioRenderRequest> request = std::make_shared<AudioRenderRequest>();
+
+  request->viewer = viewer;
+  request->range = r;
+  request->audio_params = params;
+  request->generate_waveforms = generate_waveforms;
+
+  // Create ticket
+  RenderTicketPtr ticket = std::make_shared<RenderTicket>();
+  ticket->SetRequest(request);
+
+  RenderRecorder::Record(ticket, priority);
+
+  AddTicket(ticket, priority);
 
   return ticket;
 }
 
-RenderTicketPtr RenderManager::SaveFrameToCache(FrameHashCache *cache, FramePtr frame, const QByteArray &hash, bool prioritize)
+RenderTicketPtr RenderManager::SaveFrameToCache(FrameHashCache *cache, FramePtr frame, const QByteArray &hash, TicketPriority priority)
 {
+  std::shared_ptr<FrameSaveRequest> request = std::make_shared<FrameSaveRequest>();
+
+  request->cache = cache;
+  request->frame = frame;
+  request->hash = hash;
+
   // Create ticket
   RenderTicketPtr ticket = std::make_shared<RenderTicket>();
+  ticket->SetRequest(request);
 
-  ticket->setProperty("cache", Node::PtrToValue(cache));
-  ticket->setProperty("frame", QVariant::fromValue(frame));
-  ticket->setProperty("hash", hash);
-  ticket->setProperty("type", kTypeVideoDownload);
+  RenderRecorder::Record(ticket, priority);
 
-  if (ticket->thread() != this->thread()) {
-    ticket->moveToThread(this->thread());
-  }
+  io_pool_->AddSaveTicket(ticket, priority);
+
+  return ticket;
+}
+
+RenderTicketPtr RenderManager::LoadFrameFromCache(FrameHashCache *cache, const QByteArray &hash, VideoParams::Format force_format, ColorProcessorPtr force_color_output, TicketPriority priority)
+{
+  std::shared_ptr<FrameLoadRequest> request = std::make_shared<FrameLoadRequest>();
+
+  request->cache = cache;
+  request->hash = hash;
+  request->force_format = force_format;
+  request->force_color_output = force_color_output;
+
+  // Create ticket
+  RenderTicketPtr ticket = std::make_shared<RenderTicket>();
+  ticket->SetRequest(request);
+
+  RenderRecorder::Record(ticket, priority);
+
+  io_pool_->AddTicket(ticket, priority);
+
+  return ticket;
+}
+
+RenderTicketPtr RenderManager::WarmColorProcessors(ColorManager *color_manager, const QStringList &colorspaces, TicketPriority priority)
+{
+  std::shared_ptr<ColorWarmupRequest> request = std::make_shared<ColorWarmupRequest>();
+
+  request->color_manager = color_manager;
+  request->colorspaces = colorspaces;
 
-  // Queue appending the ticket and running the next job on our thread to make this function thread-safe
-  QMetaObject::invokeMethod(this, "AddTicket", Qt::AutoConnection,
-                            OLIVE_NS_ARG(RenderTicketPtr, ticket),
-                            Q_ARG(bool, prioritize));
+  RenderTicketPtr ticket = std::make_shared<RenderTicket>();
+  ticket->SetRequest(request);
+
+  AddTicket(ticket, priority);
+
+  return ticket;
+}
+
+RenderTicketPtr RenderManager::WarmShaders(const QStringList &shader_ids, TicketPriority priority)
+{
+  std::shared_ptr<ShaderWarmupRequest> request = std::make_shared<ShaderWarmupRequest>();
+
+  request->shader_ids = shader_ids;
+
+  RenderTicketPtr ticket = std::make_shared<RenderTicket>();
+  ticket->SetRequest(request);
+
+  AddTicket(ticket, priority);
 
   return ticket;
 }
 
+QString RenderManager::GetShaderListFilePath()
+{
+  return QDir(FileFunctions::GetConfigurationLocation()).filePath(QStringLiteral("shaders"));
+}
+
 void RenderManager::RunTicket(RenderTicketPtr ticket) const
 {
-  RenderProcessor::Process(ticket, context_, still_cache_, decoder_cache_, shader_cache_, default_shader_);
+  // Tickets stay on the same renderer for their whole run so their textures stay local to it, each
+  // worker is assigned one renderer
+  int thread_index = qMax(0, GetCurrentThreadIndex());
+  Renderer* context = contexts_.at(thread_index % contexts_.size());
+
+  RenderProcessor::Process(ticket, context, still_cache_, video_cache_, decoder_cache_, shader_cache_, GetDefaultShader(context));
+}
+
+QVariant RenderManager::GetDefaultShader(Renderer *context) const
+{
+  QMutexLocker locker(&default_shader_lock_);
+
+  // Compiled on first use rather than in the constructor, which would wait on the renderer thread
+  // to finish setting up its context
+  if (default_shader_.isNull()) {
+    default_shader_ = context->CreateNativeShader(ShaderCode(QString(), QString()));
+  }
+
+  return default_shader_;
+}
+
+void RenderManager::SetFrameProfilingEnabled(bool e)
+{
+  if (e) {
+    profiling_listeners_.ref();
+  } else if (!profiling_listeners_.deref()) {
+    // Nobody is listening anymore, don't hold onto viewers that may be deleted
+    QMutexLocker locker(&profile_lock_);
+    last_frame_profiles_.clear();
+  }
+}
+
+RenderManager::FrameProfile RenderManager::GetLastFrameProfile(ViewerOutput *viewer) const
+{
+  QMutexLocker locker(&profile_lock_);
+
+  return last_frame_profiles_.value(viewer, {QString(), 0});
+}
+
+void RenderManager::SetLastFrameProfile(ViewerOutput *viewer, const FrameProfile &profile)
+{
+  QMutexLocker locker(&profile_lock_);
+
+  last_frame_profiles_.insert(viewer, profile);
+}
+
+void RenderManager::ReportGPUPass(quint64 tag, const QString &node_id, const QString &shader_id, qint64 submitted, qint64 ns)
+{
+  if (Tracer::IsEnabled()) {
+    Tracer::RecordGPU("GPU Shader", submitted, ns,
+                      shader_id.isEmpty() ? node_id : QStringLiteral("%1 (%2)").arg(node_id, shader_id));
+  }
+
+  qint64 frame_total;
+
+  {
+    QMutexLocker locker(&gpu_timing_lock_);
+
+    frame_total = (gpu_frame_times_[tag] += ns);
+
+    // Tags only go up, so anything this far behind belongs to a frame nobody is waiting on
+    if (tag > kGPUTimingHistory && gpu_frame_times_.size() > int(kGPUTimingHistory) * 2) {
+      for (auto it=gpu_frame_times_.begin(); it!=gpu_frame_times_.end(); ) {
+        if (it.key() < tag - kGPUTimingHistory) {
+          it = gpu_frame_times_.erase(it);
+        } else {
+          it++;
+        }
+      }
+    }
+
+    // Replace the slowest pass if this one's slower or the slowest is stale
+    qint64 now = Tracer::Now();
+    if (ns > slowest_gpu_pass_.ns || now - slowest_gpu_pass_time_ > 1000000000) {
+      slowest_gpu_pass_ = {node_id, shader_id, ns};
+      slowest_gpu_pass_time_ = now;
+    }
+  }
+
+  emit GPUFrameTimed(tag, frame_total);
+}
+
+qint64 RenderManager::GetGPUFrameTime(quint64 tag) const
+{
+  QMutexLocker locker(&gpu_timing_lock_);
+
+  return gpu_frame_times_.value(tag, 0);
+}
+
+RenderManager::GPUPassProfile RenderManager::GetSlowestGPUPass() const
+{
+  QMutexLocker locker(&gpu_timing_lock_);
+
+  return slowest_gpu_pass_;
+}
+
+void RenderManager::GetTexturePoolUsage(qint64 *usage, qint64 *budget) const
+{
+  *usage = 0;
+  *budget = 0;
+
+  foreach (Renderer* context, contexts_) {
+    *usage += context->texture_pool().memory_usage();
+    *budget += context->texture_pool().budget();
+  }
 }
 
 }
@@ -23,13 +23,16 @@
 
 #include <QtConcurrent/QtConcurrent>
 
+#include "common/tracer.h"
 #include "config/config.h"
+#include "cacheiopool.h"
 #include "colorprocessorcache.h"
 #include "dialog/rendercancel/rendercancel.h"
 #include "node/graph.h"
 #include "node/output/viewer/viewer.h"
 #include "node/traverser.h"
 #include "render/renderer.h"
+#include "decodercache.h"
 #include "rendercache.h"
 #include "stillimagecache.h"
 #include "threading/threadpool.h"
@@ -44,13 +47,19 @@ public:
     /// Graphics acceleration provided by OpenGL
     kOpenGL,
 
+    /// OpenGL through EGL, for rendering on machines without a display server
+    kOpenGLHeadless,
+
+    /// Rendering on the CPU for machines without a GPU, see SoftwareRenderer
+    kSoftware,
+
     /// No graphics rendering - used to test core threading logic
     kDummy
   };
 
-  static void CreateInstance()
+  static void CreateInstance(Backend backend = kOpenGL)
   {
-    instance_ = new RenderManager();
+    instance_ = new RenderManager(backend);
   }
 
   static void DestroyInstance()
@@ -64,6 +73,26 @@ public:
     return instance_;
   }
 
+  /**
+   * @brief Set up Qt to create OpenGL contexts without a display server for kOpenGLHeadless
+   *
+   * Selects the EGL platform plugin with Mesa's surfaceless platform. Anything already set in the
+   * environment is left alone so other drivers' EGL integrations can be used instead. Must be
+   * called before the application is created.
+   */
+  static void PrepareHeadlessPlatform();
+
+  /**
+   * @brief Ask the OpenGL driver to create this process's contexts on a specific GPU
+   *
+   * Qt has no way to choose the device a context is created on, so this goes through Mesa's
+   * DRI_PRIME, which takes an index ("1" for the second GPU) or a PCI tag like
+   * "pci-0000_02_00_0". Drivers that don't read it use their default GPU. Contexts of one
+   * process share resources and so always live on one GPU, to use several GPUs run one render
+   * farm worker per GPU. Must be called before the application is created.
+   */
+  static void SelectRenderDevice(const QString& device);
+
   /**
    * @brief Generate a unique identifier for a certain node at a certain time
    */
@@ -75,75 +104,316 @@ public:
    * The ticket from this function will return a FramePtr - the rendered frame in reference color
    * space.
    *
-   * Setting `prioritize` to TRUE puts this ticket at the top of the queue. Leaving it as FALSE
-   * appends it to the bottom.
+   * `priority` sets which class of work the ticket is queued with, see ThreadPool::TicketPriority.
+   *
+   * If `region` is set, only that part of the frame (in sequence pixels, plus whatever the nodes
+   * need around it) is rendered and the returned Frame is partial, see Frame::region().
+   *
+   * If `best_effort` is TRUE, footage may be substituted with a nearby frame that decodes much
+   * faster (see Decoder::RetrieveVideo()), for showing something immediately while scrubbing.
+   * The result must not be cached as the frame at `time`.
+   *
+   * Full frame requests that match one still in flight (same Hash() and output parameters) share
+   * its ticket rather than rendering the frame again, with the ticket moved up to `priority` if
+   * that's more urgent. The FramePtr from a shared ticket is given to every requester so it must
+   * be treated as read-only, and cancelling only cancels the render once every requester has.
    *
    * This function is thread-safe.
    */
   RenderTicketPtr RenderFrame(ViewerOutput* viewer, ColorManager* color_manager,
                               const rational& time, RenderMode::Mode mode,
-                              FrameHashCache* cache = nullptr, bool prioritize = false);
+                              FrameHashCache* cache = nullptr, TicketPriority priority = kPriorityBackground);
   RenderTicketPtr RenderFrame(ViewerOutput* viewer, ColorManager* color_manager,
                               const rational& time, RenderMode::Mode mode,
                               const VideoParams& video_params, const AudioParams& audio_params,
                               const QSize& force_size,
                               const QMatrix4x4& force_matrix, VideoParams::Format force_format,
                               ColorProcessorPtr force_color_output,
-                              FrameHashCache* cache = nullptr, bool prioritize = false);
+                              FrameHashCache* cache = nullptr, TicketPriority priority = kPriorityBackground,
+                              const QRect& region = QRect(), bool best_effort = false);
+
+  /**
+   * @brief Asynchronously generate several frames with one ticket
+   *
+   * The ticket returns a QVector<FramePtr> with a frame for each of `times` in the same order, or
+   * fewer if it was cancelled. A batch goes through the render queue once and reuses everything
+   * the frames have in common (region of interest, execution plan, static textures and shaders),
+   * so it suits consecutive frames of an export or precache.
+   *
+   * This function is thread-safe.
+   */
+  RenderTicketPtr RenderFrames(ViewerOutput* viewer, ColorManager* color_manager,
+                               const QVector<rational>& times, RenderMode::Mode mode,
+                               const VideoParams& video_params, const AudioParams& audio_params,
+                               const QSize& force_size,
+                               const QMatrix4x4& force_matrix, VideoParams::Format force_format,
+                               ColorProcessorPtr force_color_output,
+                               FrameHashCache* cache = nullptr, TicketPriority priority = kPriorityBackground);
+
+  /**
+   * @brief Asynchronously render a frame that's only going to be displayed
+   *
+   * Like RenderFrame(), but the pixels are left on the GPU. The returned Frame only holds the
+   * rendered texture, which a display sharing resources with the renderers can draw directly, and
+   * is downloaded the first time anything reads the frame's data.
+   *
+   * Only valid if CanShareTexturesWithDisplay() returns TRUE. This function is thread-safe.
+   */
+  RenderTicketPtr RenderFrameForDisplay(ViewerOutput* viewer, ColorManager* color_manager,
+                                        const rational& time, RenderMode::Mode mode,
+                                        TicketPriority priority = kPriorityInteractive,
+                                        const QRect& region = QRect(), bool best_effort = false);
+
+  /**
+   * @brief Returns TRUE if textures rendered by the renderers can be drawn by display widgets
+   */
+  bool CanShareTexturesWithDisplay() const
+  {
+    return display_sharing_;
+  }
 
   /**
    * @brief Asynchronously generate a chunk of audio
    *
    * The ticket from this function will return a SampleBufferPtr - the rendered audio.
    *
-   * Setting `prioritize` to TRUE puts this ticket at the top of the queue. Leaving it as FALSE
-   * appends it to the bottom.
+   * `priority` sets which class of work the ticket is queued with, see ThreadPool::TicketPriority.
    *
    * This function is thread-safe.
    */
-  RenderTicketPtr RenderAudio(ViewerOutput* viewer, const TimeRange& r, const AudioParams& params, bool generate_waveforms, bool prioritize = false);
-  RenderTicketPtr RenderAudio(ViewerOutput* viewer, const TimeRange& r, bool generate_waveforms, bool prioritize = false);
+  RenderTicketPtr RenderAudio(ViewerOutput* viewer, const TimeRange& r, const AudioParams& params, bool generate_waveforms, TicketPriority priority = kPriorityPlayback);
+  RenderTicketPtr RenderAudio(ViewerOutput* viewer, const TimeRange& r, bool generate_waveforms, TicketPriority priority = kPriorityPlayback);
 
-  RenderTicketPtr SaveFrameToCache(FrameHashCache* cache, FramePtr frame, const QByteArray& hash, bool prioritize = false);
+  /**
+   * @brief Write a frame to the disk cache on the dedicated IO threads
+   *
+   * Blocks until there's room in the write queue if called off the main thread, see CacheIOPool.
+   */
+  RenderTicketPtr SaveFrameToCache(FrameHashCache* cache, FramePtr frame, const QByteArray& hash, TicketPriority priority = kPriorityDiskIO);
 
-  virtual void RunTicket(RenderTicketPtr ticket) const override;
+  /**
+   * @brief Read a frame back from the disk cache on the dedicated IO threads
+   *
+   * The ticket's result is the frame, or a null FramePtr if it couldn't be loaded. If
+   * `force_color_output` is set, the frame is converted out of reference space with it, and if
+   * `force_format` is valid it's converted to that format, the same as a rendered frame would be.
+   */
+  RenderTicketPtr LoadFrameFromCache(FrameHashCache* cache, const QByteArray& hash,
+                                     VideoParams::Format force_format = VideoParams::kFormatInvalid,
+                                     ColorProcessorPtr force_color_output = nullptr,
+                                     TicketPriority priority = kPriorityDiskIO);
 
-  enum TicketType {
-    kTypeVideo,
-    kTypeAudio,
-    kTypeVideoDownload
-  };
+  /**
+   * @brief Returns TRUE if enough cache writes are pending that rendering more frames to save would only pile up in memory
+   */
+  bool IsCacheWriteQueueFull() const
+  {
+    return io_pool_->IsSaturated();
+  }
+
+  /**
+   * @brief Returns how many cache writes are queued or running
+   */
+  int GetPendingCacheWriteCount() const
+  {
+    return io_pool_->GetPendingWriteCount();
+  }
+
+  /**
+   * @brief Build and compile the processors converting `colorspaces` to the reference space
+   *
+   * Run in the background so the first frames decoded from footage in these color spaces don't
+   * wait on OCIO or shader compilation. The ticket returns nothing.
+   */
+  RenderTicketPtr WarmColorProcessors(ColorManager* color_manager, const QStringList& colorspaces, TicketPriority priority = kPriorityBackground);
+
+  /**
+   * @brief Compile node shaders ahead of their first use
+   *
+   * `shader_ids` are ShaderCache keys in the form "nodeid:shaderid", IDs of nodes that no longer
+   * exist are skipped. The ticket returns nothing.
+   */
+  RenderTicketPtr WarmShaders(const QStringList& shader_ids, TicketPriority priority = kPriorityBackground);
+
+  virtual void RunTicket(RenderTicketPtr ticket) const override;
 
   Backend backend() const
   {
     return backend_;
   }
 
+  struct FrameProfile {
+    QString slowest_node;
+    qint64 slowest_node_ns;
+  };
+
+  /**
+   * @brief Register or unregister interest in per-frame profiles
+   *
+   * While at least one listener is registered, video tickets record which node took the longest
+   * so it can be retrieved with GetLastFrameProfile(). This function is thread-safe.
+   */
+  void SetFrameProfilingEnabled(bool e);
+
+  bool IsFrameProfilingEnabled() const
+  {
+    return profiling_listeners_.load() > 0;
+  }
+
+  /**
+   * @brief Get the profile of the last frame rendered for this viewer
+   *
+   * Only available while frame profiling is enabled. This function is thread-safe.
+   */
+  FrameProfile GetLastFrameProfile(ViewerOutput* viewer) const;
+
+  void SetLastFrameProfile(ViewerOutput* viewer, const FrameProfile& profile);
+
+  /**
+   * @brief Returns TRUE if video tickets should have their shader passes timed on the GPU
+   *
+   * Timer queries are cheap but not free, so they only run while something will show them, i.e.
+   * the Tracer or frame profiling.
+   */
+  bool IsGPUTimingEnabled() const
+  {
+    return Tracer::IsEnabled() || IsFrameProfilingEnabled();
+  }
+
+  /**
+   * @brief Create a new tag that GPU timings of a frame are reported against
+   *
+   * \see ShaderJob::SetGPUTiming()
+   */
+  quint64 CreateGPUTimingTag()
+  {
+    return gpu_timing_tags_.fetchAndAddRelaxed(1) + 1;
+  }
+
+  /**
+   * @brief Called by renderers once the GPU time of a shader pass is known
+   *
+   * Timer query results are collected a few passes after they're submitted so the renderer never
+   * waits on the GPU for them, which means this usually arrives after the frame's ticket finished.
+   * `submitted` is when the pass was submitted on the Tracer's clock. This function is
+   * thread-safe.
+   */
+  void ReportGPUPass(quint64 tag, const QString& node_id, const QString& shader_id, qint64 submitted, qint64 ns);
+
+  /**
+   * @brief Returns the GPU time reported so far for the frame with this tag, 0 if there's none
+   *
+   * Only the most recent kGPUTimingHistory tags are kept. This function is thread-safe.
+   */
+  qint64 GetGPUFrameTime(quint64 tag) const;
+
+  struct GPUPassProfile {
+    QString node;
+    QString shader;
+    qint64 ns;
+  };
+
+  /**
+   * @brief The slowest shader pass on the GPU within roughly the last second
+   *
+   * This function is thread-safe.
+   */
+  GPUPassProfile GetSlowestGPUPass() const;
+
+  static const quint64 kGPUTimingHistory;
+
+  /**
+   * @brief Total size of idle textures kept by every renderer's TexturePool and their combined budget
+   */
+  void GetTexturePoolUsage(qint64* usage, qint64* budget) const;
+
 signals:
+  /**
+   * @brief Emitted whenever GPU time is reported for a frame, `ns` is the frame's total so far
+   *
+   * This may be emitted from any thread.
+   */
+  void GPUFrameTimed(quint64 tag, qint64 ns);
 
 private:
-  RenderManager(QObject* parent = nullptr);
+  RenderManager(Backend backend, QObject* parent = nullptr);
 
   virtual ~RenderManager() override;
 
+  RenderTicketPtr CreateFrameTicket(ViewerOutput* viewer, ColorManager* color_manager,
+                                    const rational& time, RenderMode::Mode mode,
+                                    const VideoParams& video_params, const AudioParams& audio_params,
+                                    const QSize& force_size,
+                                    const QMatrix4x4& force_matrix, VideoParams::Format force_format,
+                                    ColorProcessorPtr force_color_output,
+                                    FrameHashCache* cache, RenderRequest::Type type,
+                                    const QRect& region, bool best_effort,
+                                    const QVector<rational>& batch_times = QVector<rational>());
+
+  /**
+   * @brief Key identifying frame renders that would produce the same result, see RenderFrame()
+   */
+  static QByteArray GetInFlightKey(ViewerOutput* viewer, ColorManager* color_manager,
+                                   const rational& time, RenderMode::Mode mode,
+                                   const VideoParams& video_params, const QSize& force_size,
+                                   const QMatrix4x4& force_matrix, VideoParams::Format force_format,
+                                   ColorProcessorPtr force_color_output);
+
+  /**
+   * @brief File listing the node shaders compiled last session, warmed again on startup
+   */
+  static QString GetShaderListFilePath();
+
   static RenderManager* instance_;
 
-  Renderer* context_;
+  QVector<Renderer*> contexts_;
 
   Backend backend_;
 
+  bool display_sharing_;
+
   StillImageCache* still_cache_;
 
+  StillImageCache* video_cache_;
+
   DecoderCache* decoder_cache_;
 
   ShaderCache* shader_cache_;
 
-  QVariant default_shader_;
+  CacheIOPool* io_pool_;
+
+  QVariant GetDefaultShader(Renderer* context) const;
+
+  mutable QVariant default_shader_;
+
+  mutable QMutex default_shader_lock_;
+
+  QAtomicInt profiling_listeners_;
+
+  mutable QMutex profile_lock_;
+
+  QHash<ViewerOutput*, FrameProfile> last_frame_profiles_;
+
+  QAtomicInteger<quint64> gpu_timing_tags_;
+
+  mutable QMutex gpu_timing_lock_;
+
+  QHash<quint64, qint64> gpu_frame_times_;
+
+  GPUPassProfile slowest_gpu_pass_;
+
+  /// When `slowest_gpu_pass_` was reported on the Tracer's clock
+  qint64 slowest_gpu_pass_time_;
+
+  /**
+   * @brief Frame tickets that haven't finished yet by GetInFlightKey(), for sharing with duplicate requests
+   */
+  QHash<QByteArray, RenderTicketPtr> in_flight_;
+
+  QMutex in_flight_lock_;
 
 };
 
 }
 
-Q_DECLARE_METATYPE(olive::RenderManager::TicketType)
-
 #endif // RENDERBACKEND_H
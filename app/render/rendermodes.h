@@ -43,6 +43,30 @@ public:
      */
     kOnline
   };
+
+  /**
+   * @brief How much accuracy kOffline renders trade for speed, set by the "PreviewPrecision" preference
+   *
+   * kOnline renders always use the sequence's own format regardless of this setting.
+   */
+  enum Precision {
+    /**
+     * Intermediates use the sequence's format.
+     */
+    kPrecisionAccurate,
+
+    /**
+     * Intermediates use half-float, which is visually identical for preview at half the bandwidth
+     * of 32-bit float.
+     */
+    kPrecisionBalanced,
+
+    /**
+     * Like kPrecisionBalanced, but nodes that declare their output safe at 8 bits per channel
+     * (see Node::SupportsLowPrecisionOutput()) render into 8-bit intermediates.
+     */
+    kPrecisionPerformance
+  };
 };
 
 }
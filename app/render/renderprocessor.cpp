@@ -20,184 +20,458 @@
 
 #include "renderprocessor.h"
 
+#include <QElapsedTimer>
 #include <QOpenGLContext>
 #include <QVector2D>
 #include <QVector3D>
 #include <QVector4D>
-
+#include <QtConcurrent/QtConcurrent>
+#include <QtMath>
+
+#include "codec/audioresampler.h"
+#include "common/filefunctions.h"
+#include "common/lockprofiler.h"
+#include "common/memoryaccounting.h"
+#include "common/metrics.h"
+#include "common/tracer.h"
+#include "node/block/transition/transition.h"
+#include "node/factory.h"
+#include "node/input/nested/nestedsequence.h"
 #include "project/project.h"
+#include "render/colorprocessorcache.h"
 #include "rendermanager.h"
 
 namespace olive {
 
-RenderProcessor::RenderProcessor(RenderTicketPtr ticket, Renderer *render_ctx, StillImageCache* still_image_cache, DecoderCache* decoder_cache, ShaderCache *shader_cache, QVariant default_shader) :
+const int RenderProcessor::kMaxFusedStages = 16;
+const int RenderProcessor::kMaxFusedSamplers = 16;
+const int RenderProcessor::kMaxTransformClips = 4;
+const int RenderProcessor::kSamplesPerCancelCheck = 1024;
+const int RenderProcessor::kSamplesPerControlPoint = 64;
+const FrameRenderRequest RenderProcessor::kNoFrameRequest;
+
+RenderProcessor::RenderProcessor(RenderTicketPtr ticket, Renderer *render_ctx, StillImageCache* still_image_cache, StillImageCache *video_texture_cache, DecoderCache* decoder_cache, ShaderCache *shader_cache, QVariant default_shader) :
   ticket_(ticket),
   render_ctx_(render_ctx),
   still_image_cache_(still_image_cache),
+  video_texture_cache_(video_texture_cache),
   decoder_cache_(decoder_cache),
   shader_cache_(shader_cache),
-  default_shader_(default_shader)
+  default_shader_(default_shader),
+  decode_ns_(0),
+  gpu_timing_tag_(0),
+  frame_request_(&kNoFrameRequest),
+  audio_request_(nullptr)
 {
+  const RenderRequest* request = ticket_->request();
+
+  if (request) {
+    if (request->type == RenderRequest::kTypeVideo
+        || request->type == RenderRequest::kTypeVideoTexture
+        || request->type == RenderRequest::kTypeVideoBatch) {
+      frame_request_ = static_cast<const FrameRenderRequest*>(request);
+    } else if (request->type == RenderRequest::kTypeAudio) {
+      audio_request_ = static_cast<const AudioRenderRequest*>(request);
+    }
+  }
 }
 
 void RenderProcessor::Run()
 {
   // Depending on the render ticket type, start a job
-  RenderManager::TicketType type = ticket_->property("type").value<RenderManager::TicketType>();
+  const RenderRequest* request = ticket_->request();
 
-  ticket_->Start();
+  TraceSpan span("Render Ticket", (Tracer::IsEnabled() && request) ? QString::number(request->type) : QString());
+
+  // Sampled once per ticket, which is often enough to see memory build up over a render
+  MemoryAccounting::RecordTrace();
+  Metrics::RecordTrace();
+  LockProfiler::RecordTrace();
+
+  // Cancelling the ticket from now on cancels us too, so decodes and sample loops stop early
+  ticket_->Start(this);
+
+  if (!request) {
+    qWarning() << "Tried to run a render ticket without a request";
+    ticket_->Finish(QVariant(), true);
+    return;
+  }
 
   if (ticket_->WasCancelled()) {
+    ticket_->Finish(QVariant(), true);
     return;
   }
 
-  switch (type) {
-  case RenderManager::kTypeVideo:
+  switch (request->type) {
+  case RenderRequest::kTypeVideo:
+  case RenderRequest::kTypeVideoTexture:
   {
-    ViewerOutput* viewer = Node::ValueToPtr<ViewerOutput>(ticket_->property("viewer"));
-    const VideoParams& video_params = ticket_->property("vparam").value<VideoParams>();
-    rational time = ticket_->property("time").value<rational>();
-
-    NodeValueTable table = ProcessInput(viewer->texture_input(),
-                                        TimeRange(time, time + video_params.time_base()));
+    region_of_interest_ = GetRegionOfInterest(frame_request_->viewer, frame_request_->video_params);
 
-    TexturePtr texture = table.Get(NodeParam::kTexture).value<TexturePtr>();
+    RenderStats stats;
+    stats.render_time = 0;
 
-    // Set up output frame parameters
-    VideoParams frame_params = ticket_->property("vparam").value<VideoParams>();
-
-    QSize frame_size = ticket_->property("size").value<QSize>();
-    if (!frame_size.isNull()) {
-      frame_params.set_width(frame_size.width());
-      frame_params.set_height(frame_size.height());
-    }
+    FramePtr frame = RenderVideoFrame(frame_request_->time, request->type == RenderRequest::kTypeVideoTexture, &stats);
 
-    VideoParams::Format frame_format = static_cast<VideoParams::Format>(ticket_->property("format").toInt());
-    if (frame_format != VideoParams::kFormatInvalid) {
-      frame_params.set_format(frame_format);
-    }
+    AddFrameMetrics(stats, 1);
 
-    if (RenderManager::instance()->backend() == RenderManager::kOpenGL
-        && QOpenGLContext::openGLModuleType() == QOpenGLContext::LibGLES) {
-      // HACK: From what I can tell, ANGLE only supports texture reading to RGBA
-      frame_params.set_channel_count(VideoParams::kRGBAChannelCount);
-    } else if (texture) {
-      frame_params.set_channel_count(texture->channel_count());
-    }
+    ticket_->SetStats(stats);
+    ticket_->Finish(QVariant::fromValue(frame), IsCancelled());
+    break;
+  }
+  case RenderRequest::kTypeVideoBatch:
+  {
+    // The region, execution plan and static textures are resolved for the first frame and reused
+    // by the rest, and the whole batch only goes through the render queue once
+    region_of_interest_ = GetRegionOfInterest(frame_request_->viewer, frame_request_->video_params);
 
-    FramePtr frame = Frame::Create();
-    frame->set_timestamp(time);
-    frame->set_video_params(frame_params);
-    frame->allocate();
+    RenderStats stats;
+    stats.render_time = 0;
 
-    if (!texture) {
-      // Blank frame out
-      memset(frame->data(), 0, frame->allocated_size());
-    } else {
-      // Dump texture contents to frame
-      ColorProcessorPtr output_color_transform = ticket_->property("coloroutput").value<ColorProcessorPtr>();
-      const VideoParams& tex_params = texture->params();
-
-      if (tex_params.effective_width() != frame_params.effective_width()
-          || tex_params.effective_height() != frame_params.effective_height()
-          || tex_params.format() != frame_params.format()
-          || output_color_transform) {
-        TexturePtr blit_tex = render_ctx_->CreateTexture(frame_params);
-
-        QMatrix4x4 matrix = ticket_->property("matrix").value<QMatrix4x4>();
-
-        if (output_color_transform) {
-          // Yes color transform, blit color managed
-          render_ctx_->BlitColorManaged(output_color_transform, texture, true, blit_tex.get(), true, matrix);
-        } else {
-          // No color transform, just blit
-          ShaderJob job;
-          job.InsertValue(QStringLiteral("ove_maintex"), {QVariant::fromValue(texture), NodeParam::kTexture});
-          job.InsertValue(QStringLiteral("ove_mvpmat"), {matrix, NodeParam::kMatrix});
-
-          render_ctx_->BlitToTexture(default_shader_, job, blit_tex.get());
-        }
+    QVector<FramePtr> frames;
+    frames.reserve(frame_request_->batch_times.size());
 
-        // Replace texture that we're going to download in the next step
-        texture = blit_tex;
+    foreach (const rational& time, frame_request_->batch_times) {
+      if (IsCancelled()) {
+        break;
       }
 
-      render_ctx_->DownloadFromTexture(texture.get(), frame->data(), frame->linesize_pixels());
+      frames.append(RenderVideoFrame(time, false, &stats));
+
+      // Nothing deferred for this frame can be used by the next one
+      deferred_shaders_.clear();
     }
 
-    ticket_->Finish(QVariant::fromValue(frame), IsCancelled());
+    AddFrameMetrics(stats, frames.size());
+
+    ticket_->SetStats(stats);
+    ticket_->Finish(QVariant::fromValue(frames), IsCancelled());
     break;
   }
-  case RenderManager::kTypeAudio:
+  case RenderRequest::kTypeAudio:
   {
-    ViewerOutput* viewer = Node::ValueToPtr<ViewerOutput>(ticket_->property("viewer"));
-    TimeRange time = ticket_->property("time").value<TimeRange>();
+    NodeValueTable table = ProcessInput(audio_request_->viewer->samples_input(), audio_request_->range);
 
-    NodeValueTable table = ProcessInput(viewer->samples_input(), time);
+    if (!waveforms_.isEmpty()) {
+      RenderStats stats;
+      stats.waveforms = waveforms_;
+      ticket_->SetStats(stats);
+    }
 
     ticket_->Finish(table.Get(NodeParam::kSamples), IsCancelled());
     break;
   }
-  case RenderManager::kTypeVideoDownload:
+  case RenderRequest::kTypeColorWarmup:
+  {
+    const ColorWarmupRequest* warmup = static_cast<const ColorWarmupRequest*>(request);
+
+    foreach (ColorProcessorPtr processor, ColorProcessorCache::Warm(warmup->color_manager, warmup->colorspaces)) {
+      if (IsCancelled()) {
+        break;
+      }
+
+      render_ctx_->PrepareColorProcessor(processor);
+    }
+
+    ticket_->Finish(QVariant(), IsCancelled());
+    break;
+  }
+  case RenderRequest::kTypeShaderWarmup:
   {
-    FrameHashCache* cache = Node::ValueToPtr<FrameHashCache>(ticket_->property("cache"));
-    FramePtr frame = ticket_->property("frame").value<FramePtr>();
-    QByteArray hash = ticket_->property("hash").toByteArray();
+    const QStringList& shader_ids = static_cast<const ShaderWarmupRequest*>(request)->shader_ids;
+
+    TraceSpan warmup_span("Shader Warmup");
+
+    foreach (const QString& full_shader_id, shader_ids) {
+      if (IsCancelled()) {
+        break;
+      }
+
+      int separator = full_shader_id.indexOf(':');
+      if (separator < 0) {
+        continue;
+      }
+
+      // GetShaderCode() only depends on the shader ID, so a throwaway node gives the same code
+      // the real one will
+      Node* node = NodeFactory::CreateFromID(full_shader_id.left(separator));
+      if (!node) {
+        continue;
+      }
+
+      GetNodeShader(node, full_shader_id.mid(separator + 1));
+
+      delete node;
+    }
 
-    ticket_->Finish(cache->SaveCacheFrame(hash, frame), false);
+    ticket_->Finish(QVariant(), IsCancelled());
     break;
   }
   default:
     // Fail
-    ticket_->Cancel();
+    ticket_->Finish(QVariant(), true);
+  }
+}
+
+void RenderProcessor::AddFrameMetrics(const RenderStats &stats, int frame_count)
+{
+  Metrics::Add(Metrics::kFramesRendered, frame_count);
+  Metrics::Add(Metrics::kRenderTime, stats.render_time);
+  Metrics::Add(Metrics::kGPUTime, stats.render_time - stats.decode_time);
+}
+
+SampleBufferPtr RenderProcessor::ResampleSpeedRamp(SampleBufferPtr samples, Block *block, const TimeRange &range)
+{
+  const AudioParams& params = audio_params();
+  int count = params.time_to_samples(range.length());
+
+  if (count <= 0) {
+    return samples;
+  }
+
+  QVector<rational> times;
+  for (int i=0; i<count; i+=kSamplesPerControlPoint) {
+    times.append(range.in() + params.samples_to_time(i));
+  }
+  times.append(range.out());
+
+  QVector<QVariant> speeds = block->speed_input()->get_values_at_times(times);
+
+  SampleBufferPtr output = SampleBuffer::CreateAllocated(params, count);
+  int channels = params.channel_count();
+  QVector<float*> output_data(channels);
+
+  // One resampler across the whole range so its read position carries between control points
+  AudioResampler resampler;
+
+  for (int i=0; i+1<times.size(); i++) {
+    int start = i * kSamplesPerControlPoint;
+
+    for (int j=0; j<channels; j++) {
+      output_data[j] = output->data()[j] + start;
+    }
+
+    // Negative speed would be reversing which isn't handled yet, hold instead
+    resampler.Process(samples->const_data(), samples->sample_count(), channels, output_data.constData(),
+                      qMin(kSamplesPerControlPoint, count - start),
+                      qMax(0.0, speeds.at(i).toDouble()), qMax(0.0, speeds.at(i + 1).toDouble()));
+  }
+
+  return output;
+}
+
+float RenderProcessor::ValueToFloat(NodeParam::DataType type, const QVariant &data)
+{
+  if (type == NodeParam::kRational) {
+    return data.value<rational>().toDouble();
+  } else {
+    return data.toFloat();
   }
 }
 
-DecoderPtr RenderProcessor::ResolveDecoderFromInput(Stream *stream)
+DecoderPoolPtr RenderProcessor::ResolveDecoderFromInput(Stream *stream, bool proxy)
 {
   if (!stream) {
     qWarning() << "Attempted to resolve the decoder of a null stream";
     return nullptr;
   }
 
-  QMutexLocker locker(decoder_cache_->mutex());
+  return decoder_cache_->Get(stream, proxy);
+}
+
+void RenderProcessor::Process(RenderTicketPtr ticket, Renderer *render_ctx, StillImageCache *still_image_cache, StillImageCache *video_texture_cache, DecoderCache *decoder_cache, ShaderCache *shader_cache, QVariant default_shader)
+{
+  RenderProcessor p(ticket, render_ctx, still_image_cache, video_texture_cache, decoder_cache, shader_cache, default_shader);
+  p.Run();
+}
+
+FramePtr RenderProcessor::RenderVideoFrame(const rational &time, bool texture_output, RenderStats *stats)
+{
+  ViewerOutput* viewer = frame_request_->viewer;
+  const VideoParams& video_params = frame_request_->video_params;
+
+  decode_ns_ = 0;
+
+  QElapsedTimer render_timer;
+  render_timer.start();
+
+  bool profiling = RenderManager::instance()->IsFrameProfilingEnabled();
+  SetProfilingEnabled(profiling);
+
+  if (RenderManager::instance()->IsGPUTimingEnabled()) {
+    gpu_timing_tag_ = RenderManager::instance()->CreateGPUTimingTag();
+    stats->gpu_timing_tag = gpu_timing_tag_;
+  } else {
+    gpu_timing_tag_ = 0;
+  }
+
+  TimeRange range(time, time + video_params.time_base());
+
+  // Independent branches (e.g. each track, or both sides of a merge) are still processed one
+  // after another, but their decodes start now on the thread pool so they run in parallel.
+  // Everything touching the renderer stays on this thread in order.
+  if (viewer->texture_input()->is_connected()) {
+    QVector<FootageRequest> requests;
+    CollectVideoFootage(viewer->texture_input()->get_connected_node(), range, &requests);
+    PrefetchVideoFootage(requests);
+  }
+
+  NodeValueTable table = ProcessInput(viewer->texture_input(), range);
+
+  ClearPrefetches();
+
+  if (profiling && !slowest_node().isEmpty()) {
+    RenderManager::instance()->SetLastFrameProfile(viewer, {slowest_node(), slowest_node_ns()});
+  }
+
+  TexturePtr texture = table.Get(NodeParam::kTexture).value<TexturePtr>();
+
+  // Set up output frame parameters
+  VideoParams frame_params = video_params;
+
+  const QSize& frame_size = frame_request_->force_size;
+  if (!frame_size.isNull()) {
+    frame_params.set_width(frame_size.width());
+    frame_params.set_height(frame_size.height());
+  }
+
+  if (frame_request_->force_format != VideoParams::kFormatInvalid) {
+    frame_params.set_format(frame_request_->force_format);
+  }
+
+  RenderManager::Backend backend = RenderManager::instance()->backend();
+
+  if ((backend == RenderManager::kOpenGL || backend == RenderManager::kOpenGLHeadless)
+      && QOpenGLContext::openGLModuleType() == QOpenGLContext::LibGLES) {
+    // HACK: From what I can tell, ANGLE only supports texture reading to RGBA
+    frame_params.set_channel_count(VideoParams::kRGBAChannelCount);
+  } else if (texture) {
+    frame_params.set_channel_count(texture->channel_count());
+  }
+
+  const ColorProcessorPtr& output_color_transform = frame_request_->force_color_output;
+  const QMatrix4x4& matrix = frame_request_->force_matrix;
+
+  bool needs_blit = texture
+      && (texture->params().effective_width() != frame_params.effective_width()
+          || texture->params().effective_height() != frame_params.effective_height()
+          || texture->format() != frame_params.format()
+          || output_color_transform);
+
+  DeferredShader* deferred_footage = GetDeferredShader(texture);
+
+  if (needs_blit && output_color_transform
+      && deferred_footage && deferred_footage->color && !deferred_footage->realized
+      && (matrix.isIdentity() || deferred_footage->color_planes.size() == 1)) {
+    // The output is the only thing reading this footage, so go straight from its color space to
+    // the output's rather than through the reference space in between
+    ColorProcessorPtr combined = ColorProcessor::Compose(frame_request_->color_manager,
+                                                         deferred_footage->color,
+                                                         output_color_transform);
+
+    TexturePtr blit_tex = render_ctx_->CreateTexture(frame_params);
+
+    BlitFootageColor(*deferred_footage, combined, blit_tex.get(), matrix);
+
+    texture = blit_tex;
+    needs_blit = false;
+  } else if (needs_blit && !output_color_transform && CanConcatenateTransform(texture, 1)) {
+    // Fold the output matrix into the transforms before it so the footage is only resampled once
+    TexturePtr blit_tex = render_ctx_->CreateTexture(frame_params);
+
+    bool blitted = BlitTransform(*GetDeferredShader(texture), matrix, blit_tex.get());
+
+    texture = blitted ? blit_tex : nullptr;
+    needs_blit = false;
+  } else {
+    texture = Realize(texture);
+
+    // Uniform colors are realized smaller than they were deferred at
+    needs_blit = needs_blit
+        || (texture && (texture->params().effective_width() != frame_params.effective_width()
+                        || texture->params().effective_height() != frame_params.effective_height()));
+  }
+
+  FramePtr frame = Frame::Create();
+  frame->set_timestamp(time);
+  frame->set_video_params(frame_params);
+  frame->set_region(region_of_interest_);
+
+  if (!texture) {
+    // Blank frame out
+    frame->allocate();
+    memset(frame->data(), 0, frame->allocated_size());
+  } else {
+    // Dump texture contents to frame
+    if (needs_blit) {
+      TexturePtr blit_tex = render_ctx_->CreateTexture(frame_params);
+
+      if (output_color_transform) {
+        // Yes color transform, blit color managed
+        TraceSpan color_span("Color Management");
+        render_ctx_->BlitColorManaged(output_color_transform, texture, true, blit_tex.get(), true, matrix);
+      } else {
+        // No color transform, just blit
+        ShaderJob job;
+        job.InsertValue(QStringLiteral("ove_maintex"), {QVariant::fromValue(texture), NodeParam::kTexture});
+        job.InsertValue(QStringLiteral("ove_mvpmat"), {matrix, NodeParam::kMatrix});
+
+        render_ctx_->BlitToTexture(default_shader_, job, blit_tex.get());
+      }
+
+      // Replace texture that we're going to download in the next step
+      texture = blit_tex;
+    }
+
+    if (texture_output) {
+      // Hand the texture over as-is. The display draws it from another context, so everything
+      // writing to it needs to have finished first.
+      render_ctx_->Flush();
+
+      frame->set_texture(texture);
 
-  DecoderPtr decoder = decoder_cache_->value(stream);
+      stats->render_time += render_timer.nsecsElapsed();
+      stats->decode_time += decode_ns_;
+      return frame;
+    }
+
+    // Start the download before allocating so the transfer overlaps with it, the renderer is
+    // free to service other tickets until we ask for the result
+    TraceSpan download_span("Download");
 
-  if (!decoder) {
-    // No decoder
-    decoder = Decoder::CreateFromID(stream->footage()->decoder());
+    QVariant download = render_ctx_->BeginDownloadFromTexture(texture.get(), frame->linesize_pixels());
+
+    frame->allocate();
 
-    if (decoder->Open(stream)) {
-      decoder_cache_->insert(stream, decoder);
+    if (download.isNull()) {
+      render_ctx_->DownloadFromTexture(texture.get(), frame->data(), frame->linesize_pixels());
     } else {
-      qWarning() << "Failed to open decoder for" << stream->footage()->filename()
-                 << "::" << stream->index();
-      return nullptr;
+      render_ctx_->FinishDownloadFromTexture(download, frame->data());
     }
   }
 
-  return decoder;
-}
+  stats->render_time += render_timer.nsecsElapsed();
+  stats->decode_time += decode_ns_;
 
-void RenderProcessor::Process(RenderTicketPtr ticket, Renderer *render_ctx, StillImageCache *still_image_cache, DecoderCache *decoder_cache, ShaderCache *shader_cache, QVariant default_shader)
-{
-  RenderProcessor p(ticket, render_ctx, still_image_cache, decoder_cache, shader_cache, default_shader);
-  p.Run();
+  return frame;
 }
 
 NodeValueTable RenderProcessor::GenerateBlockTable(const TrackOutput *track, const TimeRange &range)
 {
   if (track->track_type() == Timeline::kTrackTypeAudio) {
 
-    const AudioParams& audio_params = ticket_->property("aparam").value<AudioParams>();
+    const AudioParams& audio_params = this->audio_params();
 
     QList<Block*> active_blocks = track->BlocksAtTimeRange(range);
 
-    // All these blocks will need to output to a buffer so we create one here
-    SampleBufferPtr block_range_buffer = SampleBuffer::CreateAllocated(audio_params,
-                                                                       audio_params.time_to_samples(range.length()));
-    block_range_buffer->fill(0);
+    int range_sample_count = audio_params.time_to_samples(range.length());
+
+    // Created once we know we can't pass a single block's samples straight through
+    SampleBufferPtr block_range_buffer;
+
+    // Everything before this sample has been written, anything after it has to be zeroed. Blocks
+    // are in order so only the gaps between them are ever cleared rather than the whole buffer.
+    int written_samples = 0;
 
     NodeValueTable merged_table;
 
@@ -218,39 +492,78 @@ NodeValueTable RenderProcessor::GenerateBlockTable(const TrackOutput *track, con
         continue;
       }
 
+      bool silent = false;
+      bool unit_speed = true;
+
       // FIXME: Doesn't handle reversing
-      if (b->speed_input()->is_keyframing() || b->speed_input()->is_connected()) {
+      if (b->speed_input()->is_connected()) {
         // FIXME: We'll need to calculate the speed hoo boy
+      } else if (b->speed_input()->is_keyframing()) {
+        samples_from_this_block = ResampleSpeedRamp(samples_from_this_block, b, range_for_block);
+        unit_speed = false;
       } else {
         double speed_value = b->speed_input()->get_standard_value().toDouble();
 
         if (qIsNull(speed_value)) {
           // Just silence, don't think there's any other practical application of 0 speed audio
-          samples_from_this_block->fill(0);
+          silent = true;
         } else if (!qFuzzyCompare(speed_value, 1.0)) {
           // Multiply time
           samples_from_this_block->speed(speed_value);
+          unit_speed = false;
         }
       }
 
+      NodeValueTable::Merge({merged_table, table});
+
+      if (silent) {
+        // Left for the gap fill below
+        continue;
+      }
+
+      if (active_blocks.size() == 1
+          && destination_offset == 0
+          && unit_speed
+          && samples_from_this_block->sample_count() == range_sample_count) {
+        // This block fills the whole range by itself, its buffer can be used as-is
+        block_range_buffer = samples_from_this_block;
+        written_samples = range_sample_count;
+        continue;
+      }
+
+      if (!block_range_buffer) {
+        block_range_buffer = SampleBuffer::CreateAllocated(audio_params, range_sample_count);
+      }
+
       int copy_length = qMin(max_dest_sz, samples_from_this_block->sample_count());
 
+      if (destination_offset > written_samples) {
+        block_range_buffer->fill(0, written_samples, destination_offset);
+      }
+
       // Copy samples into destination buffer
       block_range_buffer->set(samples_from_this_block->const_data(), destination_offset, copy_length);
 
-      NodeValueTable::Merge({merged_table, table});
+      written_samples = destination_offset + copy_length;
+    }
+
+    if (!block_range_buffer) {
+      // Nothing on this track produced samples
+      block_range_buffer = SampleBuffer::CreateAllocated(audio_params, range_sample_count);
+    }
+
+    if (written_samples < range_sample_count) {
+      block_range_buffer->fill(0, written_samples, range_sample_count);
     }
 
-    if (ticket_->property("enablewaveforms").toBool()) {
+    if (audio_request_ && audio_request_->generate_waveforms) {
       // Generate a visual waveform and send it back to the main thread
       AudioVisualWaveform visual_waveform;
       visual_waveform.set_channel_count(audio_params.channel_count());
       visual_waveform.OverwriteSamples(block_range_buffer, audio_params.sample_rate());
 
       RenderedWaveform waveform_info = {track, visual_waveform, range};
-      QVector<RenderedWaveform> waveform_list = ticket_->property("waveforms").value< QVector<RenderedWaveform> >();
-      waveform_list.append(waveform_info);
-      ticket_->setProperty("waveforms", QVariant::fromValue(waveform_list));
+      waveforms_.append(waveform_info);
     }
 
     merged_table.Push(NodeParam::kSamples, QVariant::fromValue(block_range_buffer), track);
@@ -262,17 +575,8 @@ NodeValueTable RenderProcessor::GenerateBlockTable(const TrackOutput *track, con
   }
 }
 
-QVariant RenderProcessor::ProcessVideoFootage(VideoStream *video_stream, const rational &input_time)
+void RenderProcessor::GetFootageDivider(VideoStream *video_stream, const VideoParams &video_params, int *divider, bool *use_proxy) const
 {
-  TexturePtr value = nullptr;
-
-  // Check the still frame cache. On large frames such as high resolution still images, uploading
-  // and color managing them for every frame is a waste of time, so we implement a small cache here
-  // to optimize such a situation
-  const VideoParams& video_params = ticket_->property("vparam").value<VideoParams>();
-
-  ColorManager* color_manager = Node::ValueToPtr<ColorManager>(ticket_->property("colormanager"));
-
   // See if we can make this divider larger (i.e. if the fooage is smaller)
   int footage_divider = video_params.divider();
   while (footage_divider > 1
@@ -281,205 +585,1030 @@ QVariant RenderProcessor::ProcessVideoFootage(VideoStream *video_stream, const r
     footage_divider--;
   }
 
-  StillImageCache::EntryPtr want_entry = std::make_shared<StillImageCache::Entry>(
-        nullptr,
-        video_stream,
-        ColorProcessor::GenerateID(color_manager, video_stream->colorspace(), color_manager->GetReferenceColorSpace()),
-        video_stream->premultiplied_alpha(),
-        footage_divider,
-        (video_stream->video_type() == VideoStream::kVideoTypeStill) ? 0 : input_time,
-        true);
+  bool offline = (frame_request_->mode == RenderMode::kOffline);
 
-  bool found_existing = false;
+  // Offline renders use the proxy if there is one, online renders always use the original
+  *use_proxy = (offline
+                && video_stream->video_type() == VideoStream::kVideoTypeVideo
+                && video_stream->has_proxy());
 
-  still_image_cache_->mutex()->lock();
+  if (*use_proxy) {
+    footage_divider = qMax(footage_divider, video_stream->proxy_divider());
+  }
 
-  foreach (StillImageCache::EntryPtr e, still_image_cache_->entries()) {
-    if (StillImageCache::CompareEntryMetadata(want_entry, e)) {
-      // Found an exact match of the texture we want in the cache. See if it's working or if it's
-      // ready.
-      want_entry = e;
-      found_existing = true;
+  *divider = footage_divider;
+}
 
-      while (want_entry->working) {
-        still_image_cache_->wait_cond()->wait(still_image_cache_->mutex());
-      }
+StillImageCache::Key RenderProcessor::GetFootageKey(VideoStream *video_stream, const rational &input_time, int divider, bool use_proxy, ColorManager *color_manager, const VideoParams &video_params) const
+{
+  bool is_still = (video_stream->video_type() == VideoStream::kVideoTypeStill);
+
+  return {video_stream,
+          ColorProcessor::GenerateID(color_manager, video_stream->colorspace(), color_manager->GetReferenceColorSpace()),
+          video_stream->premultiplied_alpha(),
+          divider,
+          is_still ? rational(0) : input_time,
+          use_proxy,
+          ShouldDeinterlace(video_stream, video_params, divider),
+          QByteArray()};
+}
 
-      value = want_entry->texture;
-      break;
-    }
+void RenderProcessor::PrefetchVideoFootage(const QVector<FootageRequest> &requests)
+{
+  // Only worth it if there's more than one decode to overlap, and frames loaded from the disk
+  // cache by GetCachedFrame() don't need decoding at all
+  if (requests.size() < 2 || !frame_request_->cache_directory.isEmpty()) {
+    return;
   }
 
-  if (value) {
-    // Found the texture, we can release the cache now
-    still_image_cache_->mutex()->unlock();
-  } else {
-    // Wasn't in still image cache, so we'll have to retrieve it from the decoder
-
-    // Let other processors know we're getting this texture (want_entry's `working` field is
-    // already set to true in the initializer above)
-    if (!found_existing) {
-      still_image_cache_->PushEntry(want_entry);
-    }
+  const VideoParams& video_params = frame_request_->video_params;
 
-    still_image_cache_->mutex()->unlock();
+  ColorManager* color_manager = frame_request_->color_manager;
 
-    DecoderPtr decoder = ResolveDecoderFromInput(video_stream);
+  bool offline = (frame_request_->mode == RenderMode::kOffline);
 
-    if (decoder) {
-      FramePtr frame = decoder->RetrieveVideo(input_time,
-                                              footage_divider);
+  bool best_effort = frame_request_->best_effort;
 
-      if (frame) {
-        // Return a texture from the derived class
-        TexturePtr unmanaged_texture = render_ctx_->CreateTexture(frame->video_params(),
-                                                                  frame->data(),
-                                                                  frame->linesize_pixels());
+  foreach (const FootageRequest& r, requests) {
+    // Stills are decoded once into the still cache, there's nothing to gain from them
+    if (r.stream->video_type() == VideoStream::kVideoTypeStill) {
+      continue;
+    }
 
-        // We convert to our rendering pixel format, since that will always be float-based which
-        // is necessary for correct color conversion
-        VideoParams managed_params = frame->video_params();
-        managed_params.set_format(video_params.format());
-        value = render_ctx_->CreateTexture(managed_params);
+    int divider;
+    bool use_proxy;
+    GetFootageDivider(r.stream, video_params, &divider, &use_proxy);
 
-        ColorProcessorPtr processor = ColorProcessor::Create(color_manager,
-                                                             video_stream->colorspace(),
-                                                             color_manager->GetReferenceColorSpace());
+    if (offline && video_texture_cache_->Get(GetFootageKey(r.stream, r.time, divider, use_proxy, color_manager, video_params))) {
+      continue;
+    }
 
-        render_ctx_->BlitColorManaged(processor, unmanaged_texture,
-                                      video_stream->premultiplied_alpha(),
-                                      value.get());
+    DecoderPoolPtr decoder = ResolveDecoderFromInput(r.stream, use_proxy);
 
-        still_image_cache_->mutex()->lock();
+    if (!decoder) {
+      continue;
+    }
 
-        // Put this into the image cache instead
-        want_entry->texture = value;
-        want_entry->working = false;
+    VideoStream* stream = r.stream;
+    rational time = r.time;
+    const QAtomicInt* cancelled = &IsCancelled();
 
-        still_image_cache_->wait_cond()->wakeAll();
+    QFuture<FramePtr> future = QtConcurrent::run([decoder, stream, time, divider, cancelled, best_effort](){
+      TraceSpan decode_span("Decode", stream->footage()->filename());
+      return decoder->RetrieveVideo(time, divider, cancelled, best_effort);
+    });
 
-        still_image_cache_->mutex()->unlock();
-      }
-    }
+    prefetches_.append({stream, time, divider, use_proxy, future});
   }
-
-  return QVariant::fromValue(value);
 }
 
-QVariant RenderProcessor::ProcessAudioFootage(AudioStream *stream, const TimeRange &input_time)
+FramePtr RenderProcessor::TakePrefetchedFrame(VideoStream *video_stream, const rational &input_time, int divider, bool use_proxy, bool *found)
 {
-  QVariant value;
+  for (int i=0; i<prefetches_.size(); i++) {
+    const Prefetch& p = prefetches_.at(i);
 
-  DecoderPtr decoder = ResolveDecoderFromInput(stream);
+    if (p.stream == video_stream && p.time == input_time && p.divider == divider && p.use_proxy == use_proxy) {
+      // Runs the decode here instead if no thread has picked it up yet
+      QFuture<FramePtr> future = p.frame;
+      prefetches_.removeAt(i);
 
-  if (decoder) {
-    const AudioParams& audio_params = ticket_->property("aparam").value<AudioParams>();
+      *found = true;
+      return future.result();
+    }
+  }
 
-    SampleBufferPtr frame = decoder->RetrieveAudio(input_time, audio_params, &IsCancelled());
+  *found = false;
+  return nullptr;
+}
 
-    if (frame) {
-      value = QVariant::fromValue(frame);
-    }
+void RenderProcessor::ClearPrefetches()
+{
+  // They hold a pointer to our cancel flag so they must finish before we're gone
+  foreach (const Prefetch& p, prefetches_) {
+    QFuture<FramePtr> future = p.frame;
+    future.waitForFinished();
   }
 
-  return value;
+  prefetches_.clear();
 }
 
-QVariant RenderProcessor::ProcessShader(const Node *node, const TimeRange &range, const ShaderJob &job)
+QVariant RenderProcessor::ProcessVideoFootage(VideoStream *video_stream, const rational &input_time)
 {
-  Q_UNUSED(range)
+  TexturePtr value = nullptr;
 
-  QString full_shader_id = QStringLiteral("%1:%2").arg(node->id(), job.GetShaderID());
+  const VideoParams& video_params = frame_request_->video_params;
 
-  QMutexLocker locker(shader_cache_->mutex());
+  ColorManager* color_manager = frame_request_->color_manager;
 
-  QVariant shader = shader_cache_->value(full_shader_id);
+  int footage_divider;
+  bool use_proxy;
+  GetFootageDivider(video_stream, video_params, &footage_divider, &use_proxy);
 
-  if (shader.isNull()) {
-    // Since we have shader code, compile it now
-    shader = render_ctx_->CreateNativeShader(node->GetShaderCode(job.GetShaderID()));
+  bool offline = (frame_request_->mode == RenderMode::kOffline);
 
-    if (shader.isNull()) {
-      // Couldn't find or build the shader required
-      return QVariant();
-    }
-  }
+  bool is_still = (video_stream->video_type() == VideoStream::kVideoTypeStill);
 
-  VideoParams tex_params = ticket_->property("vparam").value<VideoParams>();
+  bool best_effort = !is_still && frame_request_->best_effort;
 
-  bool input_textures_have_alpha = false;
-  for (auto it=job.GetValues().cbegin(); it!=job.GetValues().cend(); it++) {
-    if (it.value().type == NodeParam::kTexture) {
-      TexturePtr tex = it.value().data.value<TexturePtr>();
-      if (tex && tex->channel_count() == VideoParams::kRGBAChannelCount) {
-        input_textures_have_alpha = true;
-        break;
+  if (!is_still && !offline) {
+    // Online renders (e.g. exports) use each frame once, caching them would only push out frames
+    // the viewer might want again
+    value = DecodeVideoFootage(video_stream, input_time, footage_divider, use_proxy, color_manager, video_params,
+                               best_effort, true);
+  } else {
+    // Check the texture caches. On large frames such as high resolution still images, uploading
+    // and color managing them for every frame is a waste of time, and while scrubbing the same
+    // video frames are often requested again moments later
+    StillImageCache* cache = is_still ? still_image_cache_ : video_texture_cache_;
+
+    StillImageCache::Key key = GetFootageKey(video_stream, input_time, footage_divider, use_proxy, color_manager, video_params);
+
+    bool reserved = false;
+
+    if (best_effort) {
+      // Use the exact frame if it's already there, but whatever we decode instead may not be the
+      // frame at this time so it's never cached. Nor do we wait for another renderer's decode.
+      value = cache->Get(key);
+
+      Metrics::Add(value ? Metrics::kTextureCacheHits : Metrics::kTextureCacheMisses);
+
+      if (!value) {
+        value = DecodeVideoFootage(video_stream, input_time, footage_divider, use_proxy, color_manager, video_params, true);
       }
+    } else {
+      value = cache->Acquire(key, &reserved);
+
+      Metrics::Add((value && !reserved) ? Metrics::kTextureCacheHits : Metrics::kTextureCacheMisses);
     }
-  }
 
-  if (input_textures_have_alpha || job.GetAlphaChannelRequired()) {
-    tex_params.set_channel_count(VideoParams::kRGBAChannelCount);
-  } else {
-    tex_params.set_channel_count(VideoParams::kRGBChannelCount);
-  }
+    if (reserved) {
+      value = DecodeVideoFootage(video_stream, input_time, footage_divider, use_proxy, color_manager, video_params);
 
-  TexturePtr destination = render_ctx_->CreateTexture(tex_params);
+      if (value) {
+        // Other renderers may pick this texture up from the cache, so it must be complete first
+        render_ctx_->Flush();
+      }
 
-  // Run shader
-  render_ctx_->BlitToTexture(shader, job, destination.get());
+      // Must be called even if we failed so any renderer waiting for this texture is released
+      cache->Fill(key, value);
+    }
+  }
 
-  return QVariant::fromValue(destination);
+  return QVariant::fromValue(value);
 }
 
-QVariant RenderProcessor::ProcessSamples(const Node *node, const TimeRange &range, const SampleJob &job)
+TexturePtr RenderProcessor::DecodeVideoFootage(VideoStream *video_stream, const rational &input_time, int divider, bool use_proxy, ColorManager *color_manager, const VideoParams &video_params, bool best_effort, bool defer_color)
 {
-  if (!job.samples() || !job.samples()->is_allocated()) {
-    return QVariant();
-  }
+  QElapsedTimer decode_timer;
+  decode_timer.start();
 
-  SampleBufferPtr output_buffer = SampleBuffer::CreateAllocated(job.samples()->audio_params(), job.samples()->sample_count());
-  NodeValueDatabase value_db;
+  bool prefetched;
+  FramePtr frame = TakePrefetchedFrame(video_stream, input_time, divider, use_proxy, &prefetched);
 
-  const AudioParams& audio_params = ticket_->property("aparam").value<AudioParams>();
+  if (!prefetched) {
+    DecoderPoolPtr decoder = ResolveDecoderFromInput(video_stream, use_proxy);
+
+    if (!decoder) {
+      return nullptr;
+    }
 
-  for (int i=0;i<job.samples()->sample_count();i++) {
-    // Calculate the exact rational time at this sample
-    double sample_to_second = static_cast<double>(i) / static_cast<double>(audio_params.sample_rate());
+    TraceSpan decode_span("Decode", video_stream->footage()->filename());
+    frame = decoder->RetrieveVideo(input_time, divider, &IsCancelled(), best_effort);
+  }
 
-    rational this_sample_time = rational::fromDouble(range.in().toDouble() + sample_to_second);
+  // Prefetched frames decode in parallel, so only the time we actually waited for them counts
+  decode_ns_ += decode_timer.nsecsElapsed();
 
-    // Update all non-sample and non-footage inputs
-    NodeValueMap::const_iterator j;
-    for (j=job.GetValues().constBegin(); j!=job.GetValues().constEnd(); j++) {
-      NodeValueTable value;
-      NodeInput* corresponding_input = node->GetInputWithID(j.key());
+  if (!frame) {
+    return nullptr;
+  }
 
-      if (corresponding_input) {
-        value = ProcessInput(corresponding_input, TimeRange(this_sample_time, this_sample_time));
-      } else {
-        value.Push(j.value(), node);
+  MemoryAccounting::TextureOriginScope origin(MemoryAccounting::kTextureFootage);
+
+  // We convert to our rendering pixel format, since that will always be float-based which
+  // is necessary for correct color conversion
+  VideoParams managed_params = frame->video_params();
+  managed_params.set_format(video_params.format());
+
+  ColorProcessorPtr processor = ColorProcessor::Create(color_manager,
+                                                       video_stream->colorspace(),
+                                                       color_manager->GetReferenceColorSpace());
+
+  // Deinterlacing reads the converted texture directly so it can't be deferred
+  if (defer_color && !ShouldDeinterlace(video_stream, video_params, divider)) {
+    TexturePtr placeholder = std::make_shared<Texture>(render_ctx_, QVariant(), managed_params, Texture::k2D);
+
+    DeferredShader deferred;
+    deferred.placeholder = placeholder;
+    deferred.node = nullptr;
+    deferred.analysis.pointwise = false;
+    deferred.analysis.passthrough = false;
+    deferred.transform = false;
+    deferred.uniform = false;
+    deferred.color = processor;
+    deferred.color_premultiplied = video_stream->premultiplied_alpha();
+
+    TraceSpan upload_span("Upload");
+
+    if (frame->is_yuv()) {
+      for (int i=0; i<3; i++) {
+        deferred.color_planes.append(render_ctx_->CreateTexture(VideoParams(frame->plane_width(i),
+                                                                            frame->plane_height(i),
+                                                                            frame->format(),
+                                                                            1),
+                                                                frame->const_plane_data(i),
+                                                                frame->plane_linesize_pixels(i)));
       }
 
-      value_db.Insert(j.key(), value);
+      deferred.color_yuv_layout = frame->yuv_layout();
+    } else {
+      deferred.color_planes.append(render_ctx_->CreateTexture(frame->video_params(),
+                                                              frame->const_data(),
+                                                              frame->linesize_pixels()));
     }
 
-    AddGlobalsToDatabase(value_db, TimeRange(this_sample_time, this_sample_time));
+    deferred_shaders_.insert(placeholder.get(), deferred);
 
-    node->ProcessSamples(value_db,
-                         job.samples(),
-                         output_buffer,
-                         i);
+    return placeholder;
   }
 
-  return QVariant::fromValue(output_buffer);
-}
+  TexturePtr value = render_ctx_->CreateTexture(managed_params);
+
+  if (frame->is_yuv()) {
+    // Upload each plane separately and let the color management pass convert to RGB
+    TexturePtr planes[3];
+
+    {
+      TraceSpan upload_span("Upload");
+
+      for (int i=0; i<3; i++) {
+        planes[i] = render_ctx_->CreateTexture(VideoParams(frame->plane_width(i),
+                                                           frame->plane_height(i),
+                                                           frame->format(),
+                                                           1),
+                                               frame->const_plane_data(i),
+                                               frame->plane_linesize_pixels(i));
+      }
+    }
+
+    TraceSpan color_span("Color Management");
+    render_ctx_->BlitColorManagedYUV(processor, planes[0], planes[1], planes[2],
+                                     frame->yuv_layout(), value.get());
+  } else {
+    // Return a texture from the derived class
+    TexturePtr unmanaged_texture;
+
+    {
+      TraceSpan upload_span("Upload");
+      unmanaged_texture = render_ctx_->CreateTexture(frame->video_params(),
+                                                     frame->const_data(),
+                                                     frame->linesize_pixels());
+    }
+
+    TraceSpan color_span("Color Management");
+    render_ctx_->BlitColorManaged(processor, unmanaged_texture,
+                                  video_stream->premultiplied_alpha(),
+                                  value.get());
+  }
+
+  if (ShouldDeinterlace(video_stream, video_params, divider)) {
+    TraceSpan deinterlace_span("Deinterlace");
+    value = Deinterlace(value, video_stream->interlacing());
+  }
+
+  return value;
+}
+
+bool RenderProcessor::ShouldDeinterlace(VideoStream *video_stream, const VideoParams &video_params, int divider)
+{
+  // If the sequence has the same field order the fields can stay as they are. Downscaled frames
+  // have already had their fields blended together by the scaler so there's nothing to separate.
+  return video_stream->video_type() == VideoStream::kVideoTypeVideo
+      && video_stream->interlacing() != VideoParams::kInterlaceNone
+      && video_stream->interlacing() != video_params.interlacing()
+      && divider == 1;
+}
+
+TexturePtr RenderProcessor::Deinterlace(TexturePtr texture, VideoParams::Interlacing interlacing)
+{
+  static const QString code = FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/deinterlace.frag"));
+
+  QVariant shader = GetShader(QStringLiteral("deinterlace"), ShaderCode(code));
+
+  if (shader.isNull()) {
+    // Better to show the fields than nothing at all
+    return texture;
+  }
+
+  int field = (interlacing == VideoParams::kInterlacedBottomFirst) ? 1 : 0;
+
+  ShaderJob job;
+  job.InsertValue(QStringLiteral("ove_maintex"), ShaderValue(QVariant::fromValue(texture), NodeParam::kTexture));
+  job.InsertValue(QStringLiteral("resolution_in"), ShaderValue(QVector2D(texture->width(), texture->height()), NodeParam::kVec2));
+  job.InsertValue(QStringLiteral("field_in"), ShaderValue(field, NodeParam::kInt));
+
+  TexturePtr destination = render_ctx_->CreateTexture(texture->params());
+  render_ctx_->BlitToTexture(shader, job, destination.get());
+
+  return destination;
+}
+
+QVariant RenderProcessor::ProcessAudioFootage(AudioStream *stream, const TimeRange &input_time)
+{
+  QVariant value;
+
+  DecoderPoolPtr decoder = ResolveDecoderFromInput(stream);
+
+  if (decoder) {
+    TraceSpan span("Decode Audio", stream->footage()->filename());
+
+    SampleBufferPtr frame = decoder->RetrieveAudio(input_time, audio_params(), &IsCancelled());
+
+    if (frame) {
+      value = QVariant::fromValue(frame);
+    }
+  }
+
+  return value;
+}
+
+QVariant RenderProcessor::ProcessShader(const Node *node, const TimeRange &range, const ShaderJob &job)
+{
+  Q_UNUSED(range)
+
+  VideoParams tex_params = frame_request_->video_params;
+
+  bool input_textures_have_alpha = false;
+  for (auto it=job.GetValues().cbegin(); it!=job.GetValues().cend(); it++) {
+    if (it.value().type == NodeParam::kTexture) {
+      TexturePtr tex = it.value().data.value<TexturePtr>();
+      if (tex && tex->channel_count() == VideoParams::kRGBAChannelCount) {
+        input_textures_have_alpha = true;
+        break;
+      }
+    }
+  }
+
+  if (input_textures_have_alpha || job.GetAlphaChannelRequired()) {
+    tex_params.set_channel_count(VideoParams::kRGBAChannelCount);
+  } else {
+    tex_params.set_channel_count(VideoParams::kRGBChannelCount);
+  }
+
+  tex_params.set_format(GetIntermediateFormat(node, job.GetShaderID(), tex_params.format()));
+
+  ShaderFusion::Analysis analysis = ShaderFusion::GetAnalysis(node, job.GetShaderID());
+
+  if (ShaderFusion::CanFuse(analysis, job)) {
+    // Don't render yet, if whatever reads this is pointwise too it can run this shader inline
+    TexturePtr placeholder = std::make_shared<Texture>(render_ctx_, QVariant(), tex_params, Texture::k2D);
+
+    DeferredShader deferred;
+    deferred.placeholder = placeholder;
+    deferred.node = node;
+    deferred.shader_id = job.GetShaderID();
+    deferred.analysis = analysis;
+    deferred.job = job;
+    deferred.transform = false;
+    deferred.uniform = IsUniformShader(node, job);
+    deferred.color_premultiplied = false;
+    deferred_shaders_.insert(placeholder.get(), deferred);
+
+    return QVariant::fromValue(placeholder);
+  }
+
+  if (ShaderFusion::IsTransform(analysis, job)) {
+    // Don't render yet either, another transform or the output blit can concatenate with this one
+    return QVariant::fromValue(DeferTransform(node, job, tex_params));
+  }
+
+  TraceSpan span("Shader", Tracer::IsEnabled() ? node->id() : QString());
+
+  QVariant shader = GetNodeShader(node, job.GetShaderID());
+
+  if (shader.isNull()) {
+    // Couldn't find or build the shader required
+    return QVariant();
+  }
+
+  ShaderJob realized_job = job;
+  RealizeInputs(&realized_job);
+
+  TexturePtr destination = render_ctx_->CreateTexture(tex_params);
+
+  // Run shader
+  BlitShader(shader, realized_job, destination.get(), node);
+
+  return QVariant::fromValue(destination);
+}
+
+QRect RenderProcessor::GetRegionOfInterest(ViewerOutput *viewer, const VideoParams &params) const
+{
+  const QRect& requested = frame_request_->region;
+
+  if (requested.isNull() || !frame_request_->force_size.isNull()) {
+    // Either nothing was requested or the output gets scaled, which the region doesn't account for
+    return QRect();
+  }
+
+  // Every node could read further out than the last, so the margins add up
+  int margin = 0;
+
+  foreach (Node* node, viewer->GetDependencies()) {
+    int node_margin = node->GetRegionOfInterestMargin();
+
+    if (node_margin < 0) {
+      return QRect();
+    }
+
+    margin += node_margin;
+  }
+
+  QRect region = requested.adjusted(-margin, -margin, margin, margin);
+  region &= QRect(0, 0, params.width(), params.height());
+
+  // Scale to the physical resolution, rounding outwards
+  int divider = params.divider();
+  QRect effective(region.left() / divider,
+                  region.top() / divider,
+                  region.width() / divider + 2,
+                  region.height() / divider + 2);
+
+  QRect frame(0, 0, params.effective_width(), params.effective_height());
+  effective &= frame;
+
+  if (effective == frame) {
+    return QRect();
+  }
+
+  return effective;
+}
+
+void RenderProcessor::BlitShader(QVariant shader, const ShaderJob &job, Texture *destination, const Node *node)
+{
+  QRect scissor = region_of_interest_;
+
+  const QRectF& bounds = job.GetBounds();
+
+  if (!bounds.isNull()) {
+    // Round outwards so partially covered pixels still run
+    int left = qFloor(bounds.left() * destination->width());
+    int top = qFloor(bounds.top() * destination->height());
+    int right = qCeil(bounds.right() * destination->width());
+    int bottom = qCeil(bounds.bottom() * destination->height());
+
+    QRect bounds_rect(left, top, right - left, bottom - top);
+
+    scissor = scissor.isNull() ? bounds_rect : (scissor & bounds_rect);
+
+    if (scissor.isEmpty()) {
+      // A null scissor would run everything. Anything drawn out of bounds is transparent anyway,
+      // so a single pixel is as good as nothing.
+      scissor = QRect(0, 0, 1, 1);
+    }
+  }
+
+  render_ctx_->SetRegionOfInterest(scissor);
+
+  if (gpu_timing_tag_) {
+    ShaderJob timed_job = job;
+    timed_job.SetGPUTiming(node->id(), gpu_timing_tag_);
+    render_ctx_->BlitToTexture(shader, timed_job, destination);
+  } else {
+    render_ctx_->BlitToTexture(shader, job, destination);
+  }
+
+  render_ctx_->SetRegionOfInterest(QRect());
+}
+
+VideoParams::Format RenderProcessor::GetIntermediateFormat(const Node *node, const QString &shader_id, VideoParams::Format format) const
+{
+  RenderMode::Precision precision = frame_request_->precision;
+
+  if (precision == RenderMode::kPrecisionPerformance
+      && node->SupportsLowPrecisionOutput(shader_id)) {
+    return VideoParams::kFormatUnsigned8;
+  }
+
+  if (precision != RenderMode::kPrecisionAccurate
+      && format == VideoParams::kFormatFloat32) {
+    return VideoParams::kFormatFloat16;
+  }
+
+  return format;
+}
+
+QVariant RenderProcessor::GetNodeShader(const Node *node, const QString &shader_id)
+{
+  QString full_shader_id = QStringLiteral("%1:%2").arg(node->id(), shader_id);
+
+  QMutexLocker locker(shader_cache_->mutex());
+
+  QVariant shader = shader_cache_->value(full_shader_id);
+
+  if (shader.isNull()) {
+    // Since we have shader code, compile it now
+    shader = render_ctx_->CreateNativeShader(node->GetShaderCode(shader_id));
+
+    if (!shader.isNull()) {
+      shader_cache_->insert(full_shader_id, shader);
+    }
+  }
+
+  return shader;
+}
+
+QVariant RenderProcessor::GetShader(const QString &id, const ShaderCode &code)
+{
+  QMutexLocker locker(shader_cache_->mutex());
+
+  QVariant shader = shader_cache_->value(id);
+
+  if (shader.isNull()) {
+    shader = render_ctx_->CreateNativeShader(code);
+
+    if (shader.isNull()) {
+      qWarning() << "Failed to compile generated shader" << id;
+    } else {
+      shader_cache_->insert(id, shader);
+    }
+  }
+
+  return shader;
+}
+
+RenderProcessor::DeferredShader *RenderProcessor::GetDeferredShader(const TexturePtr &texture)
+{
+  if (!texture) {
+    return nullptr;
+  }
+
+  QHash<const Texture*, DeferredShader>::iterator it = deferred_shaders_.find(texture.get());
+
+  if (it == deferred_shaders_.end()) {
+    return nullptr;
+  }
+
+  return &it.value();
+}
+
+TexturePtr RenderProcessor::Realize(const TexturePtr &texture)
+{
+  DeferredShader* deferred = GetDeferredShader(texture);
+
+  if (!deferred) {
+    return texture;
+  }
+
+  if (deferred->realized) {
+    // Already rendered for another consumer
+    return deferred->realized;
+  }
+
+  if (deferred->color) {
+    // Something other than the output reads this footage, so it needs the reference space after all
+    MemoryAccounting::TextureOriginScope origin(MemoryAccounting::kTextureFootage);
+
+    TexturePtr destination = render_ctx_->CreateTexture(texture->params());
+
+    BlitFootageColor(*deferred, deferred->color, destination.get());
+
+    deferred->realized = destination;
+    return destination;
+  }
+
+  if (deferred->transform) {
+    TexturePtr destination = render_ctx_->CreateTexture(texture->params());
+
+    if (!BlitTransform(*deferred, QMatrix4x4(), destination.get())) {
+      return nullptr;
+    }
+
+    deferred->realized = destination;
+    return destination;
+  }
+
+  TraceSpan span("Shader", Tracer::IsEnabled() ? deferred->node->id() : QString());
+
+  if (deferred->uniform) {
+    // Every consumer samples with normalized coordinates and clamps to the edge, so a single pixel
+    // reads the same as a full frame of it without allocating or filling one
+    VideoParams pixel_params = texture->params();
+    pixel_params.set_width(1);
+    pixel_params.set_height(1);
+    pixel_params.set_divider(1);
+
+    QVariant shader = GetNodeShader(deferred->node, deferred->shader_id);
+
+    if (shader.isNull()) {
+      return nullptr;
+    }
+
+    TexturePtr destination = render_ctx_->CreateTexture(pixel_params);
+
+    // The region of interest is in frame pixels, it doesn't apply here
+    render_ctx_->BlitToTexture(shader, deferred->job, destination.get());
+
+    deferred->realized = destination;
+    return destination;
+  }
+
+  // Realizing inputs never adds deferred shaders so this pointer stays valid
+  QVector<ShaderFusion::Stage> stages;
+  int samplers = ShaderFusion::CountSamplers(deferred->analysis);
+  BuildFusionStages(*deferred, &stages, &samplers);
+
+  TexturePtr destination = render_ctx_->CreateTexture(texture->params());
+
+  if (stages.size() > 1) {
+    ShaderCode code;
+    ShaderJob job;
+    QString key;
+
+    ShaderFusion::Generate(stages, &code, &job, &key);
+
+    // Only the bounds of the last stage limit what the fused shader writes
+    job.SetBounds(stages.last().job.GetBounds());
+
+    QVariant shader = GetShader(QStringLiteral("fused:%1").arg(key), code);
+
+    if (!shader.isNull()) {
+      BlitShader(shader, job, destination.get(), deferred->node);
+      deferred->realized = destination;
+      return destination;
+    }
+  }
+
+  // Nothing to fuse (or the fused shader failed), render this shader on its own
+  QVariant shader = GetNodeShader(deferred->node, deferred->shader_id);
+
+  if (shader.isNull()) {
+    return nullptr;
+  }
+
+  ShaderJob job = deferred->job;
+  RealizeInputs(&job);
+
+  BlitShader(shader, job, destination.get(), deferred->node);
+  deferred->realized = destination;
+
+  return destination;
+}
+
+TexturePtr RenderProcessor::DeferTransform(const Node *node, const ShaderJob &job, const VideoParams &params)
+{
+  TexturePtr placeholder = std::make_shared<Texture>(render_ctx_, QVariant(), params, Texture::k2D);
+
+  DeferredShader deferred;
+  deferred.placeholder = placeholder;
+  deferred.node = node;
+  deferred.shader_id = job.GetShaderID();
+  deferred.analysis.pointwise = false;
+  deferred.analysis.passthrough = true;
+  deferred.job = job;
+  deferred.transform = true;
+  deferred.uniform = false;
+  deferred.color_premultiplied = false;
+
+  TexturePtr input = job.GetValue(QStringLiteral("ove_maintex")).data.value<TexturePtr>();
+
+  if (CanConcatenateTransform(input, 1)) {
+    // Sample what the upstream transform would've sampled with both matrices at once. The
+    // upstream's texture would've cut off anything outside its frame so that becomes a clip.
+    const DeferredShader* upstream = GetDeferredShader(input);
+
+    QMatrix4x4 inner = upstream->job.GetValue(QStringLiteral("ove_mvpmat")).data.value<QMatrix4x4>();
+    QMatrix4x4 outer = job.GetValue(QStringLiteral("ove_mvpmat")).data.value<QMatrix4x4>();
+
+    deferred.job = upstream->job;
+    deferred.job.InsertValue(QStringLiteral("ove_mvpmat"), ShaderValue(outer * inner, NodeParam::kMatrix));
+
+    // Use the better of the two filters, the single sample has to cover for both
+    deferred.job.SetInterpolation(QStringLiteral("ove_maintex"),
+                                  qMax(upstream->job.GetInterpolation(QStringLiteral("ove_maintex")),
+                                       job.GetInterpolation(QStringLiteral("ove_maintex"))));
+
+    deferred.clips = upstream->clips;
+    deferred.clips.append(inner);
+  }
+
+  deferred_shaders_.insert(placeholder.get(), deferred);
+
+  return placeholder;
+}
+
+bool RenderProcessor::IsUniformShader(const Node *node, const ShaderJob &job) const
+{
+  if (!job.GetBounds().isNull()) {
+    // Anything outside the bounds is transparent
+    return false;
+  }
+
+  for (auto it=job.GetValues().cbegin(); it!=job.GetValues().cend(); it++) {
+    if (it.value().type == NodeParam::kTexture) {
+      return false;
+    }
+  }
+
+  return node->IsShaderOutputUniform(job.GetShaderID());
+}
+
+bool RenderProcessor::CanConcatenateTransform(const TexturePtr &texture, int clips)
+{
+  DeferredShader* deferred = GetDeferredShader(texture);
+
+  return deferred
+      && deferred->transform
+      && !deferred->realized
+      && deferred->clips.size() + clips <= kMaxTransformClips;
+}
+
+bool RenderProcessor::BlitTransform(const DeferredShader &deferred, const QMatrix4x4 &post, Texture *destination)
+{
+  TraceSpan span("Shader", Tracer::IsEnabled() ? deferred.node->id() : QString());
+
+  ShaderJob job = deferred.job;
+  RealizeInputs(&job);
+
+  QVector<QMatrix4x4> clips = deferred.clips;
+
+  if (!post.isIdentity()) {
+    QMatrix4x4 matrix = job.GetValue(QStringLiteral("ove_mvpmat")).data.value<QMatrix4x4>();
+
+    clips.append(matrix);
+    job.InsertValue(QStringLiteral("ove_mvpmat"), ShaderValue(post * matrix, NodeParam::kMatrix));
+  }
+
+  if (clips.isEmpty()) {
+    // A lone transform, nothing to clip against
+    BlitShader(default_shader_, job, destination, deferred.node);
+    return true;
+  }
+
+  static const ShaderCode code(FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/transform.frag")),
+                               FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/transform.vert")));
+
+  QVariant shader = GetShader(QStringLiteral("transform"), code);
+
+  if (shader.isNull()) {
+    return false;
+  }
+
+  job.InsertValue(QStringLiteral("clip_count"), ShaderValue(clips.size(), NodeParam::kInt));
+
+  for (int i=0; i<kMaxTransformClips; i++) {
+    job.InsertValue(QStringLiteral("clip_mat%1").arg(i),
+                    ShaderValue(i < clips.size() ? clips.at(i) : QMatrix4x4(), NodeParam::kMatrix));
+  }
+
+  BlitShader(shader, job, destination, deferred.node);
+
+  return true;
+}
+
+void RenderProcessor::BlitFootageColor(const DeferredShader &deferred, ColorProcessorPtr processor, Texture *destination, const QMatrix4x4 &matrix)
+{
+  TraceSpan color_span("Color Management");
+
+  if (deferred.color_planes.size() == 3) {
+    render_ctx_->BlitColorManagedYUV(processor,
+                                     deferred.color_planes.at(0),
+                                     deferred.color_planes.at(1),
+                                     deferred.color_planes.at(2),
+                                     deferred.color_yuv_layout, destination);
+  } else {
+    render_ctx_->BlitColorManaged(processor, deferred.color_planes.first(),
+                                  deferred.color_premultiplied,
+                                  destination, true, matrix);
+  }
+}
+
+void RenderProcessor::RealizeInputs(ShaderJob *job)
+{
+  NodeValueMap values = job->GetValues();
+
+  for (auto it=values.begin(); it!=values.end(); it++) {
+    if (it.value().type == NodeParam::kTexture) {
+      TexturePtr texture = it.value().data.value<TexturePtr>();
+
+      if (GetDeferredShader(texture)) {
+        it.value().data = QVariant::fromValue(Realize(texture));
+        job->InsertValue(it.key(), it.value());
+      }
+    }
+  }
+}
+
+int RenderProcessor::BuildFusionStages(const DeferredShader &shader, QVector<ShaderFusion::Stage> *stages, int *samplers, int ancestors)
+{
+  ShaderFusion::Stage stage;
+  stage.analysis = shader.analysis;
+  stage.id = QStringLiteral("%1:%2").arg(shader.node->id(), shader.shader_id);
+  stage.job = shader.job;
+  stage.opaque = false;
+  stage.clamped = false;
+
+  for (auto it=shader.job.GetValues().cbegin(); it!=shader.job.GetValues().cend(); it++) {
+    if (it.value().type != NodeParam::kTexture) {
+      continue;
+    }
+
+    TexturePtr input = it.value().data.value<TexturePtr>();
+    DeferredShader* upstream = GetDeferredShader(input);
+
+    if (!upstream) {
+      continue;
+    }
+
+    // Inlining swaps the sampler for this input with the upstream shader's own samplers. A chain of
+    // merges (e.g. a TrackList's video tracks) only adds one sampler per layer, so up to these
+    // limits every layer is composited in a single pass.
+    int inlined_samplers = *samplers - 1 + ShaderFusion::CountSamplers(upstream->analysis);
+
+    if (!upstream->realized && !upstream->transform && !upstream->color
+        && stages->size() + ancestors + 2 <= kMaxFusedStages
+        && inlined_samplers <= kMaxFusedSamplers) {
+      *samplers = inlined_samplers;
+
+      int index = BuildFusionStages(*upstream, stages, samplers, ancestors + 1);
+
+      // Inlining skips storing the upstream result so emulate what storing it would've done
+      (*stages)[index].opaque = (input->channel_count() != VideoParams::kRGBAChannelCount);
+      (*stages)[index].clamped = !VideoParams::FormatIsFloat(input->format());
+
+      stage.inlined.insert(it.key(), index);
+    } else {
+      ShaderValue realized = it.value();
+      realized.data = QVariant::fromValue(Realize(input));
+      stage.job.InsertValue(it.key(), realized);
+    }
+  }
+
+  stages->append(stage);
+
+  return stages->size() - 1;
+}
+
+QVariant RenderProcessor::ProcessSamples(const Node *node, const TimeRange &range, const SampleJob &job)
+{
+  if (!job.samples() || !job.samples()->is_allocated()) {
+    return QVariant();
+  }
+
+  SampleBufferPtr output_buffer = SampleBuffer::CreateAllocated(job.samples()->audio_params(), job.samples()->sample_count());
+
+  const AudioParams& audio_params = this->audio_params();
+  const int sample_count = job.samples()->sample_count();
+  const double sample_rate = audio_params.sample_rate();
+
+  // Only inputs that are connected or keyframed can change over the buffer, everything else is
+  // taken from the job as-is. Those are evaluated every kSamplesPerControlPoint samples and ramped
+  // linearly in between, which is smooth enough to never click and a tiny fraction of the work of
+  // traversing them at every sample.
+  QVector<int> control_indexes;
+  for (int i=0;i<sample_count;i+=kSamplesPerControlPoint) {
+    control_indexes.append(i);
+  }
+  if (control_indexes.last() != sample_count - 1) {
+    control_indexes.append(sample_count - 1);
+  }
+
+  QVector<rational> control_times(control_indexes.size());
+  for (int i=0;i<control_indexes.size();i++) {
+    control_times[i] = rational::fromDouble(range.in().toDouble() + control_indexes.at(i) / sample_rate);
+  }
+
+  SampleParamCurveMap curves;
+  bool all_numeric = true;
+
+  NodeValueMap::const_iterator j;
+  for (j=job.GetValues().constBegin(); j!=job.GetValues().constEnd() && all_numeric; j++) {
+    NodeInput* corresponding_input = node->GetInputWithID(j.key());
+
+    if (corresponding_input
+        && (corresponding_input->is_connected() || corresponding_input->is_keyframing())) {
+      QVector<NodeValueTable> tables = EvaluateSampleInput(corresponding_input, control_times);
+      QVector<float> control_values(tables.size());
+
+      for (int i=0;i<tables.size();i++) {
+        NodeValue number = tables.at(i).GetWithMeta(NodeParam::kNumber);
+
+        if (number.type() == NodeParam::kNone) {
+          all_numeric = false;
+          break;
+        }
+
+        control_values[i] = ValueToFloat(number.type(), number.data());
+      }
+
+      if (!all_numeric) {
+        break;
+      }
+
+      QVector<float> numbers(sample_count);
+      for (int i=0;i<control_indexes.size()-1;i++) {
+        int from = control_indexes.at(i);
+        int to = control_indexes.at(i+1);
+        float a = control_values.at(i);
+        float step = (control_values.at(i+1) - a) / static_cast<float>(to - from);
+
+        for (int k=from;k<to;k++) {
+          numbers[k] = a + step * static_cast<float>(k - from);
+        }
+      }
+      numbers[sample_count - 1] = control_values.last();
+
+      curves.insert(j.key(), SampleParamCurve(numbers));
+    } else if (j.value().type & NodeParam::kNumber) {
+      curves.insert(j.key(), SampleParamCurve(ValueToFloat(j.value().type, j.value().data)));
+    } else {
+      all_numeric = false;
+    }
+  }
+
+  // Let the node process the whole buffer at once if it can
+  if (all_numeric && node->ProcessSampleBlock(curves, job.samples(), output_buffer)) {
+    return QVariant::fromValue(output_buffer);
+  }
+
+  // Calculate the exact rational time at each sample
+  QVector<rational> sample_times(sample_count);
+  for (int i=0;i<sample_count;i++) {
+    sample_times[i] = rational::fromDouble(range.in().toDouble() + i / sample_rate);
+  }
+
+  QHash<QString, QVector<NodeValueTable> > varying_values;
+
+  for (j=job.GetValues().constBegin(); j!=job.GetValues().constEnd(); j++) {
+    NodeInput* corresponding_input = node->GetInputWithID(j.key());
+
+    if (corresponding_input
+        && (corresponding_input->is_connected() || corresponding_input->is_keyframing())) {
+      varying_values.insert(j.key(), EvaluateSampleInput(corresponding_input, sample_times));
+    }
+  }
+
+  // Otherwise fall back to processing each sample individually
+  NodeValueDatabase value_db;
+
+  for (int i=0;i<sample_count;i++) {
+    if ((i % kSamplesPerCancelCheck) == 0 && IsCancelled()) {
+      return QVariant();
+    }
+
+    for (j=job.GetValues().constBegin(); j!=job.GetValues().constEnd(); j++) {
+      NodeValueTable value;
+
+      if (varying_values.contains(j.key())) {
+        value = varying_values.value(j.key()).at(i);
+      } else {
+        value.Push(j.value(), node);
+      }
+
+      value_db.Insert(j.key(), value);
+    }
+
+    AddGlobalsToDatabase(value_db, TimeRange(sample_times.at(i), sample_times.at(i)));
+
+    node->ProcessSamples(value_db,
+                         job.samples(),
+                         output_buffer,
+                         i);
+  }
+
+  return QVariant::fromValue(output_buffer);
+}
+
+QVector<NodeValueTable> RenderProcessor::EvaluateSampleInput(NodeInput *input, const QVector<rational> &times)
+{
+  QVector<NodeValueTable> tables(times.size());
+
+  if (!input->is_connected() && !input->IsArray()) {
+    // Keyframed values can be evaluated for every time in one go
+    QVector<QVariant> values = input->get_values_at_times(times);
+
+    for (int i=0;i<times.size();i++) {
+      tables[i].Push(input->data_type(), values.at(i), input->parentNode());
+    }
+  } else {
+    for (int i=0;i<times.size();i++) {
+      tables[i] = ProcessInput(input, TimeRange(times.at(i), times.at(i)));
+    }
+  }
+
+  return tables;
+}
 
 QVariant RenderProcessor::ProcessFrameGeneration(const Node *node, const GenerateJob &job)
 {
   FramePtr frame = Frame::Create();
 
-  VideoParams frame_params = ticket_->property("vparam").value<VideoParams>();
+  VideoParams frame_params = frame_request_->video_params;
+
+  if (job.IsCoverageMask()) {
+    return GenerateCoverageMask(node, job, frame_params);
+  }
+
   if (job.GetAlphaChannelRequired()) {
     frame_params.set_channel_count(VideoParams::kRGBAChannelCount);
   } else {
@@ -498,15 +1627,143 @@ QVariant RenderProcessor::ProcessFrameGeneration(const Node *node, const Generat
   return QVariant::fromValue(texture);
 }
 
+QVariant RenderProcessor::GenerateCoverageMask(const Node *node, const GenerateJob &job, VideoParams params)
+{
+  VideoParams mask_params = params;
+  mask_params.set_format(VideoParams::kFormatUnsigned8);
+  mask_params.set_channel_count(1);
+
+  FramePtr mask = Frame::Create();
+  mask->set_video_params(mask_params);
+  mask->allocate();
+
+  node->GenerateFrame(mask, job);
+
+  TexturePtr mask_texture;
+
+  {
+    TraceSpan upload_span("Upload", Tracer::IsEnabled() ? node->id() : QString());
+    mask_texture = render_ctx_->CreateTexture(mask_params, mask->data(), mask->linesize_pixels());
+  }
+
+  const QString shader_id = QStringLiteral("ove:coverage");
+
+  QVariant shader;
+
+  {
+    // Only read the shader source if it isn't compiled yet
+    QMutexLocker locker(shader_cache_->mutex());
+    shader = shader_cache_->value(shader_id);
+  }
+
+  if (shader.isNull()) {
+    shader = GetShader(shader_id, ShaderCode(FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/coverage.frag"))));
+  }
+
+  if (shader.isNull()) {
+    return QVariant();
+  }
+
+  const Color& tint = job.GetCoverageColor();
+
+  ShaderJob tint_job;
+  tint_job.InsertValue(QStringLiteral("ove_maintex"), ShaderValue(QVariant::fromValue(mask_texture), NodeParam::kTexture));
+  tint_job.InsertValue(QStringLiteral("color_in"),
+                       ShaderValue(QVariant::fromValue(Color(tint.red(), tint.green(), tint.blue(), 1.0)), NodeParam::kColor));
+
+  // The mask is the same size as the destination so there's nothing to filter
+  tint_job.SetInterpolation(QStringLiteral("ove_maintex"), Texture::kNearest);
+
+  params.set_channel_count(VideoParams::kRGBAChannelCount);
+  TexturePtr destination = render_ctx_->CreateTexture(params);
+
+  render_ctx_->BlitToTexture(shader, tint_job, destination.get());
+
+  return QVariant::fromValue(destination);
+}
+
+QVariant RenderProcessor::ProcessNestedSequence(const NestedSequence *node, const TimeRange &range)
+{
+  ViewerOutput* inner_viewer = node->GetViewer();
+  Node* inner = node->GetInnerNode();
+
+  if (!inner_viewer || !inner || frame_request_ == &kNoFrameRequest) {
+    return NodeTraverser::ProcessNestedSequence(node, range);
+  }
+
+  // Look the frame up the same way the nested sequence's own cacher stores it
+  const VideoParams& outer_params = frame_request_->video_params;
+
+  VideoParams inner_params = inner_viewer->video_params();
+  inner_params.set_divider(outer_params.divider());
+  inner_params.set_format(outer_params.format());
+
+  QString inner_cache_dir = inner_viewer->video_frame_cache()->GetCacheDirectory();
+
+  QByteArray hash = RenderManager::Hash(inner, inner_params, range.in());
+
+  FramePtr f = FrameHashCache::LoadCacheFrame(inner_cache_dir, hash);
+
+  if (f) {
+    VideoParams p = f->video_params();
+
+    p.set_width(f->width() * inner_params.divider());
+    p.set_height(f->height() * inner_params.divider());
+    p.set_divider(inner_params.divider());
+
+    f->set_video_params(p);
+
+    TexturePtr texture = render_ctx_->CreateTexture(f->video_params(), f->data(), f->linesize_pixels());
+    return QVariant::fromValue(texture);
+  }
+
+  QVariant value = NodeTraverser::ProcessNestedSequence(node, range);
+
+  // The inner graph was rendered at our resolution, so it can only go in the nested sequence's
+  // cache if that's the resolution it caches at too
+  if (!region_of_interest_.isNull()
+      || frame_request_->best_effort
+      || inner_params.width() != outer_params.width()
+      || inner_params.height() != outer_params.height()
+      || !VideoParams::FormatIsFloat(inner_params.format())
+      || RenderManager::instance()->IsCacheWriteQueueFull()
+      || IsCancelled()) {
+    return value;
+  }
+
+  TexturePtr texture = Realize(value.value<TexturePtr>());
+
+  if (!texture
+      || texture->params().effective_width() != inner_params.effective_width()
+      || texture->params().effective_height() != inner_params.effective_height()
+      || texture->format() != inner_params.format()) {
+    return QVariant::fromValue(texture);
+  }
+
+  FramePtr frame = Frame::Create();
+  frame->set_timestamp(range.in());
+  frame->set_video_params(texture->params());
+  frame->allocate();
+
+  {
+    TraceSpan download_span("Download");
+    render_ctx_->DownloadFromTexture(texture.get(), frame->data(), frame->linesize_pixels());
+  }
+
+  RenderManager::instance()->SaveFrameToCache(inner_viewer->video_frame_cache(), frame, hash);
+
+  return QVariant::fromValue(texture);
+}
+
 QVariant RenderProcessor::GetCachedFrame(const Node *node, const rational &time)
 {
-  if (!ticket_->property("cache").toString().isEmpty()
+  if (!frame_request_->cache_directory.isEmpty()
       && node->id() == QStringLiteral("org.olivevideoeditor.Olive.videoinput")) {
-    const VideoParams& video_params = ticket_->property("vparam").value<VideoParams>();
+    const VideoParams& video_params = frame_request_->video_params;
 
     QByteArray hash = RenderManager::Hash(node, video_params, time);
 
-    FramePtr f = FrameHashCache::LoadCacheFrame(ticket_->property("cache").toString(), hash);
+    FramePtr f = FrameHashCache::LoadCacheFrame(frame_request_->cache_directory, hash);
 
     if (f) {
       // The cached frame won't load with the correct divider by default, so we enforce it here
@@ -526,10 +1783,111 @@ QVariant RenderProcessor::GetCachedFrame(const Node *node, const rational &time)
   return QVariant();
 }
 
+bool RenderProcessor::GetCachedTable(const Node *node, const TimeRange &range, NodeValueTable *table, bool *store)
+{
+  if (!IsStaticInput(node)) {
+    return false;
+  }
+
+  TexturePtr texture = video_texture_cache_->Get(GetStaticInputKey(node, range));
+
+  if (texture) {
+    table->Push(NodeParam::kTexture, QVariant::fromValue(texture), node);
+    return true;
+  }
+
+  *store = true;
+  return false;
+}
+
+void RenderProcessor::CacheTable(const Node *node, const TimeRange &range, const NodeValueTable &table)
+{
+  // Whatever's deferred has to be rendered now so it can be used by later frames
+  TexturePtr texture = Realize(table.Get(NodeParam::kTexture).value<TexturePtr>());
+
+  if (texture) {
+    // Other renderers and threads may pick this texture up from the cache, so it must be complete first
+    render_ctx_->Flush();
+
+    video_texture_cache_->Insert(GetStaticInputKey(node, range), texture);
+  }
+}
+
+bool RenderProcessor::IsStaticInput(const Node *node) const
+{
+  // A partially rendered texture is no use to other frames
+  if (frame_request_ == &kNoFrameRequest
+      || !region_of_interest_.isNull()
+      || frame_request_->best_effort
+      || node->output()->edges().isEmpty()) {
+    return false;
+  }
+
+  // Only the texture is cached, so everything reading this node has to want just that
+  bool has_varying_consumer = false;
+
+  foreach (NodeEdgePtr edge, node->output()->edges()) {
+    if (edge->input()->data_type() != NodeParam::kTexture) {
+      return false;
+    }
+
+    if (!edge->input()->parentNode()->IsHashTimeInvariant()) {
+      has_varying_consumer = true;
+    }
+  }
+
+  if (node->IsHashTimeInvariant()) {
+    // Nothing about this subgraph ever changes (e.g. a still with a static transform, or a title
+    // without keyframes). If whatever reads it doesn't change either, that's the one to cache so
+    // we don't keep a texture for every step of the chain.
+    return has_varying_consumer;
+  }
+
+  if (!node->IsBlock()) {
+    return false;
+  }
+
+  const Block* block = static_cast<const Block*>(node);
+
+  // A clip that looks the same for its whole length is only rendered once
+  if (block->type() != Block::kTransition && node->IsHashConstantOver(TimeRange(block->in(), block->out()))) {
+    return true;
+  }
+
+  // Both sides of a transition are rendered for every frame of it, if one of them doesn't change
+  // over the transition it only needs to be rendered once
+  foreach (NodeEdgePtr edge, node->output()->edges()) {
+    Node* consumer = edge->input()->parentNode();
+
+    if (consumer->IsBlock() && static_cast<Block*>(consumer)->type() == Block::kTransition) {
+      TransitionBlock* transition = static_cast<TransitionBlock*>(consumer);
+
+      if ((edge->input() == transition->in_block_input() || edge->input() == transition->out_block_input())
+          && node->IsHashConstantOver(TimeRange(transition->in(), transition->out()))) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+StillImageCache::Key RenderProcessor::GetStaticInputKey(const Node *node, const TimeRange &range) const
+{
+  const VideoParams& video_params = frame_request_->video_params;
+
+  // Reduced precision intermediates and proxies give a different texture for the same hash
+  QByteArray hash = RenderManager::Hash(node, video_params, range.in());
+  hash.append(static_cast<char>(frame_request_->precision));
+  hash.append(static_cast<char>(frame_request_->mode));
+
+  return {nullptr, QString(), false, video_params.divider(), rational(0), false, false, hash};
+}
+
 QVector2D RenderProcessor::GenerateResolution() const
 {
   // Set resolution to the destination to the "logical" resolution of the destination
-  const VideoParams& video_params = ticket_->property("vparam").value<VideoParams>();
+  const VideoParams& video_params = frame_request_->video_params;
   return QVector2D(video_params.width() * video_params.pixel_aspect_ratio().toDouble(),
                    video_params.height());
 }
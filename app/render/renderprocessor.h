@@ -21,9 +21,15 @@
 #ifndef RENDERPROCESSOR_H
 #define RENDERPROCESSOR_H
 
+#include <QFuture>
+#include <QMatrix4x4>
+
+#include "node/output/viewer/viewer.h"
 #include "node/traverser.h"
 #include "render/renderer.h"
+#include "decodercache.h"
 #include "rendercache.h"
+#include "shaderfusion.h"
 #include "stillimagecache.h"
 #include "threading/threadticket.h"
 
@@ -32,13 +38,7 @@ namespace olive {
 class RenderProcessor : public NodeTraverser
 {
 public:
-  static void Process(RenderTicketPtr ticket, Renderer* render_ctx, StillImageCache* still_image_cache, DecoderCache* decoder_cache, ShaderCache* shader_cache, QVariant default_shader);
-
-  struct RenderedWaveform {
-    const TrackOutput* track;
-    AudioVisualWaveform waveform;
-    TimeRange range;
-  };
+  static void Process(RenderTicketPtr ticket, Renderer* render_ctx, StillImageCache* still_image_cache, StillImageCache* video_texture_cache, DecoderCache* decoder_cache, ShaderCache* shader_cache, QVariant default_shader);
 
 protected:
   virtual NodeValueTable GenerateBlockTable(const TrackOutput *track, const TimeRange &range) override;
@@ -53,16 +53,265 @@ protected:
 
   virtual QVariant ProcessFrameGeneration(const Node *node, const GenerateJob& job) override;
 
+  virtual QVariant ProcessNestedSequence(const NestedSequence *node, const TimeRange &range) override;
+
   virtual QVariant GetCachedFrame(const Node *node, const rational &time) override;
 
+  virtual bool GetCachedTable(const Node* node, const TimeRange& range, NodeValueTable* table, bool* store) override;
+
+  virtual void CacheTable(const Node* node, const TimeRange& range, const NodeValueTable& table) override;
+
   virtual QVector2D GenerateResolution() const override;
 
 private:
-  RenderProcessor(RenderTicketPtr ticket, Renderer* render_ctx, StillImageCache* still_image_cache, DecoderCache* decoder_cache, ShaderCache* shader_cache, QVariant default_shader);
+  RenderProcessor(RenderTicketPtr ticket, Renderer* render_ctx, StillImageCache* still_image_cache, StillImageCache* video_texture_cache, DecoderCache* decoder_cache, ShaderCache* shader_cache, QVariant default_shader);
 
   void Run();
 
-  DecoderPtr ResolveDecoderFromInput(Stream* stream);
+  /**
+   * @brief Render one frame of the frame request at `time`
+   *
+   * If `texture_output` is TRUE, the frame holds the rendered texture rather than being
+   * downloaded. Render and decode times are added to `stats`.
+   */
+  FramePtr RenderVideoFrame(const rational& time, bool texture_output, RenderStats* stats);
+
+  /**
+   * @brief Add a finished video ticket's frames and times to Metrics
+   */
+  static void AddFrameMetrics(const RenderStats& stats, int frame_count);
+
+  /**
+   * @brief Audio parameters of the request, whether it's for a frame or for audio
+   */
+  const AudioParams& audio_params() const
+  {
+    return audio_request_ ? audio_request_->audio_params : frame_request_->audio_params;
+  }
+
+  DecoderPoolPtr ResolveDecoderFromInput(Stream* stream, bool proxy = false);
+
+  /**
+   * @brief Get the divider footage is decoded at for this ticket and whether its proxy is used
+   */
+  void GetFootageDivider(VideoStream* video_stream, const VideoParams& video_params, int* divider, bool* use_proxy) const;
+
+  StillImageCache::Key GetFootageKey(VideoStream* video_stream, const rational& input_time, int divider, bool use_proxy, ColorManager* color_manager, const VideoParams& video_params) const;
+
+  /**
+   * @brief Start decoding these frames on the global thread pool
+   *
+   * DecodeVideoFootage() picks the results up with TakePrefetchedFrame() when it gets to them.
+   */
+  void PrefetchVideoFootage(const QVector<FootageRequest>& requests);
+
+  /**
+   * @brief Wait for a prefetched frame, `found` is set to FALSE if it wasn't prefetched
+   */
+  FramePtr TakePrefetchedFrame(VideoStream* video_stream, const rational& input_time, int divider, bool use_proxy, bool* found);
+
+  /**
+   * @brief Wait for every prefetch that hasn't been taken and discard them
+   */
+  void ClearPrefetches();
+
+  /**
+   * @brief Retrieve a frame from a video stream and upload it as a texture in the reference color space
+   *
+   * If `defer_color` is TRUE, the conversion is deferred and a placeholder is returned, so that if
+   * the output is the only thing that reads it, both conversions can be done in one pass.
+   */
+  TexturePtr DecodeVideoFootage(VideoStream* video_stream, const rational& input_time, int divider, bool use_proxy, ColorManager* color_manager, const VideoParams& video_params, bool best_effort = false, bool defer_color = false);
+
+  /**
+   * @brief Returns TRUE if frames from this stream need deinterlacing before use in this render
+   */
+  static bool ShouldDeinterlace(VideoStream* video_stream, const VideoParams& video_params, int divider);
+
+  /**
+   * @brief Rebuild the other field of an interlaced frame, returning a progressive copy
+   */
+  TexturePtr Deinterlace(TexturePtr texture, VideoParams::Interlacing interlacing);
+
+  static float ValueToFloat(NodeParam::DataType type, const QVariant& data);
+
+  /**
+   * @brief Resample the audio a block returned for a keyframed speed ramp
+   *
+   * `samples` covers the media that plays over `range`. The speed is evaluated every
+   * kSamplesPerControlPoint samples and ramped in between.
+   */
+  SampleBufferPtr ResampleSpeedRamp(SampleBufferPtr samples, Block* block, const TimeRange& range);
+
+  /**
+   * @brief Get the format a shader's output should be rendered into for this ticket's precision
+   *
+   * \see RenderMode::Precision
+   */
+  VideoParams::Format GetIntermediateFormat(const Node* node, const QString& shader_id, VideoParams::Format format) const;
+
+  /**
+   * @brief Get the part of the frame that needs rendering for this ticket, in physical pixels
+   *
+   * This is the ticket's requested region expanded by every contributing node's margin (see
+   * Node::GetRegionOfInterestMargin()). Returns a null rect if the whole frame must be rendered.
+   */
+  QRect GetRegionOfInterest(ViewerOutput* viewer, const VideoParams& params) const;
+
+  /**
+   * @brief Blit a node's shader restricted to the region of interest
+   *
+   * Footage is never restricted since its textures may be cached for other tickets. If GPU timing
+   * is enabled, the pass is timed and reported against `node`.
+   */
+  void BlitShader(QVariant shader, const ShaderJob& job, Texture* destination, const Node* node);
+
+  /**
+   * @brief Run a GenerateJob that produces a coverage mask and tint it into a color texture
+   *
+   * \see GenerateJob::SetCoverageMask()
+   */
+  QVariant GenerateCoverageMask(const Node* node, const GenerateJob& job, VideoParams params);
+
+  /**
+   * @brief Evaluate a connected or keyframed input of a SampleJob at each of `times`
+   */
+  QVector<NodeValueTable> EvaluateSampleInput(NodeInput* input, const QVector<rational>& times);
+
+  /**
+   * @brief A pointwise shader whose output texture hasn't been rendered yet
+   *
+   * ProcessShader() returns a placeholder texture for these so that a pointwise consumer can
+   * inline them with ShaderFusion instead of rendering each one to its own texture.
+   */
+  struct DeferredShader {
+    std::weak_ptr<Texture> placeholder;
+    const Node* node;
+    QString shader_id;
+    ShaderFusion::Analysis analysis;
+    ShaderJob job;
+    TexturePtr realized;
+
+    /// TRUE if this is a transform that later transforms can concatenate with
+    bool transform;
+
+    /// TRUE if every pixel is the same color, so it's realized as a single pixel
+    bool uniform;
+
+    /// Frames the transform's quad has to stay within, one for each transform concatenated into it
+    QVector<QMatrix4x4> clips;
+
+    /// If set, this is footage waiting to be converted to the reference space by this processor
+    ColorProcessorPtr color;
+
+    /// The footage's uploaded texture, or its Y, U and V planes if `color_planes` has three
+    QVector<TexturePtr> color_planes;
+    YUVLayout color_yuv_layout;
+    bool color_premultiplied;
+  };
+
+  /**
+   * @brief Get one of a node's shaders from the cache, compiling it if it isn't there yet
+   */
+  QVariant GetNodeShader(const Node* node, const QString& shader_id);
+
+  /**
+   * @brief Get a shader from the cache, compiling `code` if it isn't there yet
+   */
+  QVariant GetShader(const QString& id, const ShaderCode& code);
+
+  /**
+   * @brief Returns the deferred shader this texture is a placeholder for, or nullptr if it isn't one
+   */
+  DeferredShader* GetDeferredShader(const TexturePtr& texture);
+
+  /**
+   * @brief Render a deferred texture along with everything inlinable into it
+   *
+   * Textures that aren't placeholders are returned as-is.
+   */
+  TexturePtr Realize(const TexturePtr& texture);
+
+  /**
+   * @brief Replace any placeholder textures in this job with their realized textures
+   */
+  void RealizeInputs(ShaderJob* job);
+
+  /**
+   * @brief Add a deferred shader and the deferred shaders it reads from to `stages`
+   *
+   * `ancestors` is the number of stages waiting to be added after this one. `samplers` is the
+   * number of samplers the fused program needs so far, counting this shader's. Returns the index
+   * of the shader's stage.
+   */
+  int BuildFusionStages(const DeferredShader& shader, QVector<ShaderFusion::Stage>* stages, int* samplers, int ancestors = 0);
+
+  /**
+   * @brief Defer a transform so it can be concatenated with the transforms that read from it
+   *
+   * If `job` reads from another deferred transform, the two are combined into one job that
+   * samples the upstream transform's input directly.
+   */
+  TexturePtr DeferTransform(const Node* node, const ShaderJob& job, const VideoParams& params);
+
+  /**
+   * @brief Returns TRUE if this job outputs the same color everywhere (see Node::IsShaderOutputUniform())
+   */
+  bool IsUniformShader(const Node* node, const ShaderJob& job) const;
+
+  /**
+   * @brief Returns TRUE if this texture is an unrendered transform with room for `clips` more clips
+   */
+  bool CanConcatenateTransform(const TexturePtr& texture, int clips);
+
+  /**
+   * @brief Render a deferred transform with `post` applied after it
+   */
+  bool BlitTransform(const DeferredShader& deferred, const QMatrix4x4& post, Texture* destination);
+
+  /**
+   * @brief Convert deferred footage with `processor` rather than the one it was deferred with
+   *
+   * `matrix` is ignored for YUV footage, callers that need it must check color_planes first.
+   */
+  void BlitFootageColor(const DeferredShader& deferred, ColorProcessorPtr processor, Texture* destination, const QMatrix4x4& matrix = QMatrix4x4());
+
+  /**
+   * @brief Returns TRUE if this node's texture is worth keeping for later frames
+   *
+   * That's any subgraph whose hash never changes (no keyframes, footage or time-dependent nodes
+   * like TimeInput), a clip that looks the same for its whole length, or a side of a transition
+   * that looks the same for all of it. The cache is keyed by the node's hash, so a texture is
+   * only ever reused for frames that would render identically.
+   */
+  bool IsStaticInput(const Node* node) const;
+
+  StillImageCache::Key GetStaticInputKey(const Node* node, const TimeRange& range) const;
+
+  /**
+   * @brief Maximum number of shaders fused into one program
+   */
+  static const int kMaxFusedStages;
+
+  /**
+   * @brief Maximum number of textures a fused program samples, the fragment texture units GL guarantees
+   */
+  static const int kMaxFusedSamplers;
+
+  /**
+   * @brief Maximum number of transforms concatenated into one, limited by transform.vert
+   */
+  static const int kMaxTransformClips;
+
+  /**
+   * @brief How often the per-sample fallback in ProcessSamples() checks whether it was cancelled
+   */
+  static const int kSamplesPerCancelCheck;
+
+  /**
+   * @brief Distance between the samples ProcessSamples() evaluates varying parameters at for ramps
+   */
+  static const int kSamplesPerControlPoint;
 
   RenderTicketPtr ticket_;
 
@@ -70,16 +319,66 @@ private:
 
   StillImageCache* still_image_cache_;
 
+  StillImageCache* video_texture_cache_;
+
   DecoderCache* decoder_cache_;
 
   ShaderCache* shader_cache_;
 
   QVariant default_shader_;
 
+  /**
+   * @brief Deferred shaders keyed by their placeholder texture
+   *
+   * Each entry holds a weak pointer to its placeholder, which keeps the address from being reused
+   * while the entry exists.
+   */
+  QHash<const Texture*, DeferredShader> deferred_shaders_;
+
+  struct Prefetch {
+    VideoStream* stream;
+    rational time;
+    int divider;
+    bool use_proxy;
+    QFuture<FramePtr> frame;
+  };
+
+  QVector<Prefetch> prefetches_;
+
+  QRect region_of_interest_;
+
+  /**
+   * @brief Time this ticket has spent waiting for footage to decode, in nanoseconds
+   */
+  qint64 decode_ns_;
+
+  /**
+   * @brief Tag shader passes of the current frame are timed under on the GPU, 0 if they aren't
+   */
+  quint64 gpu_timing_tag_;
+
+  /**
+   * @brief Placeholder for tickets that don't render a frame so video parameters read as defaults
+   */
+  static const FrameRenderRequest kNoFrameRequest;
+
+  /**
+   * @brief The ticket's request if it renders a frame, otherwise kNoFrameRequest
+   */
+  const FrameRenderRequest* frame_request_;
+
+  /**
+   * @brief The ticket's request if it renders audio, otherwise nullptr
+   */
+  const AudioRenderRequest* audio_request_;
+
+  /**
+   * @brief Waveforms generated for an audio ticket, handed back in its RenderStats
+   */
+  QVector<RenderedWaveform> waveforms_;
+
 };
 
 }
 
-Q_DECLARE_METATYPE(olive::RenderProcessor::RenderedWaveform)
-
 #endif // RENDERPROCESSOR_H
@@ -0,0 +1,233 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "renderrecorder.h"
+
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include "render/framehashcache.h"
+
+namespace olive {
+
+const int RenderRecorder::kVersion = 1;
+
+QAtomicInt RenderRecorder::recording_(0);
+QAtomicInt RenderRecorder::next_id_(0);
+QMutex RenderRecorder::lock_;
+QFile* RenderRecorder::file_ = nullptr;
+QElapsedTimer RenderRecorder::timer_;
+
+static QString GetViewerName(ViewerOutput* viewer)
+{
+  return viewer ? viewer->media_name() : QString();
+}
+
+static QJsonArray RectToJson(const QRect& r)
+{
+  return QJsonArray({r.x(), r.y(), r.width(), r.height()});
+}
+
+bool RenderRecorder::Start(const QString &filename)
+{
+  Stop();
+
+  QMutexLocker locker(&lock_);
+
+  file_ = new QFile(filename);
+
+  if (!file_->open(QFile::WriteOnly | QFile::Truncate)) {
+    qWarning() << "Failed to open render log" << filename;
+    delete file_;
+    file_ = nullptr;
+    return false;
+  }
+
+  timer_.start();
+  next_id_.store(0);
+
+  QJsonObject header;
+  header.insert(QStringLiteral("version"), kVersion);
+  file_->write(QJsonDocument(header).toJson(QJsonDocument::Compact));
+  file_->write("\n");
+
+  recording_.store(1);
+
+  return true;
+}
+
+void RenderRecorder::Stop()
+{
+  recording_.store(0);
+
+  QMutexLocker locker(&lock_);
+
+  // Tickets still in flight won't log their finish, the replay treats them as never finishing
+  delete file_;
+  file_ = nullptr;
+}
+
+void RenderRecorder::Record(const RenderTicketPtr &ticket, ThreadPool::TicketPriority priority, bool shared)
+{
+  if (!IsRecording() || !ticket->request()) {
+    return;
+  }
+
+  int id = next_id_.fetchAndAddRelaxed(1);
+
+  QJsonObject entry;
+  entry.insert(QStringLiteral("id"), id);
+  entry.insert(QStringLiteral("t"), double(timer_.nsecsElapsed()));
+  entry.insert(QStringLiteral("priority"), int(priority));
+
+  if (shared) {
+    entry.insert(QStringLiteral("shared"), true);
+  }
+
+  const RenderRequest* request = ticket->request();
+
+  switch (request->type) {
+  case RenderRequest::kTypeVideo:
+  case RenderRequest::kTypeVideoTexture:
+  case RenderRequest::kTypeVideoBatch:
+  {
+    const FrameRenderRequest* frame = static_cast<const FrameRenderRequest*>(request);
+
+    if (request->type == RenderRequest::kTypeVideo) {
+      entry.insert(QStringLiteral("type"), QStringLiteral("video"));
+    } else if (request->type == RenderRequest::kTypeVideoTexture) {
+      entry.insert(QStringLiteral("type"), QStringLiteral("texture"));
+    } else {
+      entry.insert(QStringLiteral("type"), QStringLiteral("batch"));
+
+      QJsonArray times;
+      foreach (const rational& t, frame->batch_times) {
+        times.append(t.toString());
+      }
+      entry.insert(QStringLiteral("times"), times);
+    }
+
+    entry.insert(QStringLiteral("viewer"), GetViewerName(frame->viewer));
+    entry.insert(QStringLiteral("time"), frame->time.toString());
+    entry.insert(QStringLiteral("mode"), int(frame->mode));
+    entry.insert(QStringLiteral("width"), frame->video_params.width());
+    entry.insert(QStringLiteral("height"), frame->video_params.height());
+    entry.insert(QStringLiteral("divider"), frame->video_params.divider());
+    entry.insert(QStringLiteral("cached"), !frame->cache_directory.isEmpty());
+
+    if (!frame->force_size.isNull()) {
+      entry.insert(QStringLiteral("force_size"), QJsonArray({frame->force_size.width(), frame->force_size.height()}));
+    }
+
+    if (frame->force_format != VideoParams::kFormatInvalid) {
+      entry.insert(QStringLiteral("force_format"), int(frame->force_format));
+    }
+
+    if (!frame->region.isNull()) {
+      entry.insert(QStringLiteral("region"), RectToJson(frame->region));
+    }
+
+    if (frame->best_effort) {
+      entry.insert(QStringLiteral("best_effort"), true);
+    }
+    break;
+  }
+  case RenderRequest::kTypeAudio:
+  {
+    const AudioRenderRequest* audio = static_cast<const AudioRenderRequest*>(request);
+
+    entry.insert(QStringLiteral("type"), QStringLiteral("audio"));
+    entry.insert(QStringLiteral("viewer"), GetViewerName(audio->viewer));
+    entry.insert(QStringLiteral("in"), audio->range.in().toString());
+    entry.insert(QStringLiteral("out"), audio->range.out().toString());
+    entry.insert(QStringLiteral("sample_rate"), audio->audio_params.sample_rate());
+    entry.insert(QStringLiteral("waveforms"), audio->generate_waveforms);
+    break;
+  }
+  case RenderRequest::kTypeVideoDownload:
+  {
+    const FrameSaveRequest* save = static_cast<const FrameSaveRequest*>(request);
+
+    entry.insert(QStringLiteral("type"), QStringLiteral("save"));
+    entry.insert(QStringLiteral("viewer"), GetViewerName(save->cache ? qobject_cast<ViewerOutput*>(save->cache->parent()) : nullptr));
+
+    if (save->frame) {
+      const VideoParams& p = save->frame->video_params();
+      entry.insert(QStringLiteral("width"), p.width());
+      entry.insert(QStringLiteral("height"), p.height());
+      entry.insert(QStringLiteral("format"), int(p.format()));
+      entry.insert(QStringLiteral("channels"), p.channel_count());
+    }
+    break;
+  }
+  case RenderRequest::kTypeVideoLoad:
+  {
+    const FrameLoadRequest* load = static_cast<const FrameLoadRequest*>(request);
+
+    entry.insert(QStringLiteral("type"), QStringLiteral("load"));
+    entry.insert(QStringLiteral("viewer"), GetViewerName(load->cache ? qobject_cast<ViewerOutput*>(load->cache->parent()) : nullptr));
+    entry.insert(QStringLiteral("hash"), QString::fromLatin1(load->hash.toHex()));
+    break;
+  }
+  case RenderRequest::kTypeColorWarmup:
+  case RenderRequest::kTypeShaderWarmup:
+    // Startup work rather than anything the user did
+    return;
+  }
+
+  Write(entry);
+
+  // Without a context object this is called directly on the thread that finished the ticket, so
+  // what's logged is when it finished rather than when an event loop got around to it
+  RenderTicket* raw = ticket.get();
+  QObject::connect(raw, &RenderTicket::Finished, [id, raw]{
+    if (!IsRecording()) {
+      return;
+    }
+
+    QJsonObject finish;
+    finish.insert(QStringLiteral("id"), id);
+    finish.insert(QStringLiteral("t"), double(timer_.nsecsElapsed()));
+    finish.insert(QStringLiteral("finished"), true);
+
+    if (raw->WasCancelled()) {
+      finish.insert(QStringLiteral("cancelled"), true);
+    } else if (raw->stats().render_time >= 0) {
+      finish.insert(QStringLiteral("render_time"), double(raw->stats().render_time));
+    }
+
+    Write(finish);
+  });
+}
+
+void RenderRecorder::Write(const QJsonObject &entry)
+{
+  QByteArray line = QJsonDocument(entry).toJson(QJsonDocument::Compact);
+  line.append('\n');
+
+  QMutexLocker locker(&lock_);
+
+  if (file_) {
+    file_->write(line);
+  }
+}
+
+}
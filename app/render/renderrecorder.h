@@ -0,0 +1,95 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERRECORDER_H
+#define RENDERRECORDER_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QMutex>
+
+#include "threading/threadpool.h"
+
+namespace olive {
+
+/**
+ * @brief Opt-in log of every render request RenderManager receives, for replaying them later
+ *
+ * While recording, each RenderFrame(), RenderFrames(), RenderFrameForDisplay(), RenderAudio() and
+ * SaveFrameToCache() request is written to a file with its priority and the time it was made,
+ * followed by a second entry when its ticket finishes or is cancelled. CLIRenderReplay plays the
+ * log back against the same project headlessly, so the scheduling and caching behavior of a real
+ * interactive session (scrubbing, dragging parameters, starting playback) can be reproduced and
+ * compared between builds.
+ *
+ * The log has one JSON object per line. Times are nanoseconds since recording started, rational
+ * times are in rational::toString() form and viewers are identified by their media name (i.e.
+ * the sequence name).
+ *
+ * When not recording (the default), Record() costs a single atomic load.
+ */
+class RenderRecorder
+{
+public:
+  /**
+   * @brief Start recording to `filename`, replacing anything already in it
+   */
+  static bool Start(const QString& filename);
+
+  static void Stop();
+
+  static bool IsRecording()
+  {
+    return recording_.load();
+  }
+
+  /**
+   * @brief Log a ticket that's about to be queued with `priority`
+   *
+   * `shared` is TRUE if the caller is joining an identical ticket already in flight rather than
+   * queueing a new one. This function is thread-safe.
+   */
+  static void Record(const RenderTicketPtr& ticket, ThreadPool::TicketPriority priority, bool shared = false);
+
+  /**
+   * @brief Version written in the first line of the log
+   */
+  static const int kVersion;
+
+private:
+  static void Write(const QJsonObject& entry);
+
+  static QAtomicInt recording_;
+
+  static QAtomicInt next_id_;
+
+  static QMutex lock_;
+
+  static QFile* file_;
+
+  static QElapsedTimer timer_;
+
+};
+
+}
+
+#endif // RENDERRECORDER_H
@@ -0,0 +1,232 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERREQUEST_H
+#define RENDERREQUEST_H
+
+#include <QMatrix4x4>
+#include <QRect>
+#include <QSize>
+#include <QStringList>
+
+#include "audio/audiovisualwaveform.h"
+#include "codec/frame.h"
+#include "common/timerange.h"
+#include "render/audioparams.h"
+#include "render/colorprocessor.h"
+#include "render/rendermodes.h"
+#include "render/videoparams.h"
+
+namespace olive {
+
+class ColorManager;
+class FrameHashCache;
+class TrackOutput;
+class ViewerOutput;
+
+/**
+ * @brief Everything a render ticket needs to do its job
+ *
+ * Each ticket type has its own request struct deriving from this one. Requests are created by
+ * RenderManager when the ticket is, and never modified afterwards so the render thread can read
+ * them without locking.
+ */
+struct RenderRequest {
+  enum Type {
+    kTypeVideo,
+    kTypeVideoTexture,
+    kTypeVideoBatch,
+    kTypeAudio,
+    kTypeVideoDownload,
+    kTypeVideoLoad,
+    kTypeColorWarmup,
+    kTypeShaderWarmup
+  };
+
+  RenderRequest(Type t) :
+    type(t)
+  {
+  }
+
+  virtual ~RenderRequest(){}
+
+  Type type;
+};
+
+using RenderRequestPtr = std::shared_ptr<const RenderRequest>;
+
+/**
+ * @brief Request for kTypeVideo, kTypeVideoTexture and kTypeVideoBatch tickets
+ */
+struct FrameRenderRequest : public RenderRequest {
+  FrameRenderRequest(Type t = kTypeVideo) :
+    RenderRequest(t),
+    viewer(nullptr),
+    color_manager(nullptr),
+    force_format(VideoParams::kFormatInvalid),
+    mode(RenderMode::kOffline),
+    precision(RenderMode::kPrecisionAccurate),
+    best_effort(false)
+  {
+  }
+
+  ViewerOutput* viewer;
+  ColorManager* color_manager;
+  rational time;
+
+  VideoParams video_params;
+  AudioParams audio_params;
+
+  /// If not null, the output frame is scaled to this size
+  QSize force_size;
+  QMatrix4x4 force_matrix;
+
+  /// If not kFormatInvalid, the output frame is converted to this format
+  VideoParams::Format force_format;
+  ColorProcessorPtr force_color_output;
+
+  RenderMode::Mode mode;
+  RenderMode::Precision precision;
+
+  /// Region of the frame that's needed, null for the whole frame
+  QRect region;
+
+  /// Disk cache directory to load already rendered footage from, empty to not use the cache
+  QString cache_directory;
+
+  bool best_effort;
+
+  /// For kTypeVideoBatch, every frame to render in order. `time` is the first of them.
+  QVector<rational> batch_times;
+};
+
+/**
+ * @brief Request for kTypeAudio tickets
+ */
+struct AudioRenderRequest : public RenderRequest {
+  AudioRenderRequest() :
+    RenderRequest(kTypeAudio),
+    viewer(nullptr),
+    generate_waveforms(false)
+  {
+  }
+
+  ViewerOutput* viewer;
+  TimeRange range;
+  AudioParams audio_params;
+  bool generate_waveforms;
+};
+
+/**
+ * @brief Request for kTypeVideoDownload tickets
+ */
+struct FrameSaveRequest : public RenderRequest {
+  FrameSaveRequest() :
+    RenderRequest(kTypeVideoDownload),
+    cache(nullptr)
+  {
+  }
+
+  FrameHashCache* cache;
+  FramePtr frame;
+  QByteArray hash;
+};
+
+/**
+ * @brief Request for kTypeVideoLoad tickets
+ */
+struct FrameLoadRequest : public RenderRequest {
+  FrameLoadRequest() :
+    RenderRequest(kTypeVideoLoad),
+    cache(nullptr),
+    force_format(VideoParams::kFormatInvalid)
+  {
+  }
+
+  FrameHashCache* cache;
+  QByteArray hash;
+
+  /// If not kFormatInvalid, the loaded frame is converted to this format
+  VideoParams::Format force_format;
+
+  /// If set, the loaded frame is converted from reference space with this processor
+  ColorProcessorPtr force_color_output;
+};
+
+/**
+ * @brief Request for kTypeColorWarmup tickets
+ */
+struct ColorWarmupRequest : public RenderRequest {
+  ColorWarmupRequest() :
+    RenderRequest(kTypeColorWarmup),
+    color_manager(nullptr)
+  {
+  }
+
+  ColorManager* color_manager;
+  QStringList colorspaces;
+};
+
+/**
+ * @brief Request for kTypeShaderWarmup tickets
+ */
+struct ShaderWarmupRequest : public RenderRequest {
+  ShaderWarmupRequest() :
+    RenderRequest(kTypeShaderWarmup)
+  {
+  }
+
+  QStringList shader_ids;
+};
+
+struct RenderedWaveform {
+  const TrackOutput* track;
+  AudioVisualWaveform waveform;
+  TimeRange range;
+};
+
+/**
+ * @brief Details a render ticket reports alongside its result
+ */
+struct RenderStats {
+  RenderStats() :
+    render_time(-1),
+    decode_time(0),
+    gpu_timing_tag(0)
+  {
+  }
+
+  /// Nanoseconds spent rendering, -1 if nothing was rendered (e.g. the frame came from a cache)
+  qint64 render_time;
+
+  /// Nanoseconds of `render_time` spent waiting for footage to decode
+  qint64 decode_time;
+
+  /// Tag the frame's GPU timings are reported against, 0 if they weren't timed
+  /// \see RenderManager::GetGPUFrameTime()
+  quint64 gpu_timing_tag;
+
+  /// Waveforms of the audio tracks rendered, if the request asked for them
+  QVector<RenderedWaveform> waveforms;
+};
+
+}
+
+#endif // RENDERREQUEST_H
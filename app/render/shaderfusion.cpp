@@ -0,0 +1,358 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "shaderfusion.h"
+
+#include <QRegularExpression>
+
+namespace olive {
+
+QMutex ShaderFusion::analysis_lock_;
+QHash<QString, ShaderFusion::Analysis> ShaderFusion::analysis_cache_;
+
+ShaderFusion::Analysis ShaderFusion::GetAnalysis(const Node *node, const QString &shader_id)
+{
+  QString id = QStringLiteral("%1:%2").arg(node->id(), shader_id);
+
+  QMutexLocker locker(&analysis_lock_);
+
+  QHash<QString, Analysis>::const_iterator existing = analysis_cache_.constFind(id);
+
+  if (existing != analysis_cache_.constEnd()) {
+    return existing.value();
+  }
+
+  ShaderCode code = node->GetShaderCode(shader_id);
+  Analysis a = Analyze(code.frag_code(), code.vert_code());
+  analysis_cache_.insert(id, a);
+  return a;
+}
+
+bool ShaderFusion::CanFuse(const Analysis &analysis, const ShaderJob &job)
+{
+  if (!analysis.pointwise) {
+    return false;
+  }
+
+  // Iterative shaders read their own output from the last iteration
+  if (job.GetIterationCount() > 1 && !job.GetIterativeInput().isEmpty()) {
+    return false;
+  }
+
+  // A transformed quad no longer maps each pixel to the same pixel of its inputs
+  if (!job.GetValue(QStringLiteral("ove_mvpmat")).data.value<QMatrix4x4>().isIdentity()) {
+    return false;
+  }
+
+  // Only the pixels its triangles cover would have run the shader
+  if (!job.GetVertexPositions().isEmpty()) {
+    return false;
+  }
+
+  for (auto it=job.GetValues().cbegin(); it!=job.GetValues().cend(); it++) {
+    if (it.value().array) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int ShaderFusion::CountSamplers(const Analysis &analysis)
+{
+  int count = 0;
+
+  foreach (const QString& type, analysis.uniform_types) {
+    if (type.startsWith(QStringLiteral("sampler"))) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+bool ShaderFusion::IsTransform(const Analysis &analysis, const ShaderJob &job)
+{
+  if (!analysis.passthrough || job.GetValues().size() != 2) {
+    return false;
+  }
+
+  ShaderValue texture = job.GetValue(QStringLiteral("ove_maintex"));
+  ShaderValue matrix = job.GetValue(QStringLiteral("ove_mvpmat"));
+
+  return texture.type == NodeParam::kTexture
+      && !texture.array
+      && matrix.type == NodeParam::kMatrix
+      && job.GetIterationCount() <= 1;
+}
+
+void ShaderFusion::Generate(const QVector<Stage> &stages, ShaderCode *code, ShaderJob *job, QString *key)
+{
+  QString uniforms;
+  QString functions;
+  QStringList key_parts;
+
+  for (int i=0; i<stages.size(); i++) {
+    const Stage& stage = stages.at(i);
+    QString body = stage.analysis.body;
+
+    // Replace reads of textures we're inlining with the stage that would have rendered them
+    QStringList inlined_keys;
+
+    for (auto it=stage.inlined.cbegin(); it!=stage.inlined.cend(); it++) {
+      QRegularExpression read(QStringLiteral("\\btexture\\s*\\(\\s*%1\\s*,\\s*ove_texcoord\\s*\\)").arg(QRegularExpression::escape(it.key())));
+
+      body.replace(read, QStringLiteral("%1()").arg(StageFunctionName(it.value(), QStringLiteral("sample"))));
+
+      // Like any other texture, the shader sees an inlined texture as enabled
+      job->InsertValue(StageFunctionName(i, QStringLiteral("%1_enabled").arg(it.key())),
+                       ShaderValue(true, NodeParam::kBoolean));
+
+      inlined_keys.append(QStringLiteral("%1=%2").arg(it.key(), QString::number(it.value())));
+    }
+
+    // Give every stage its own namespace so uniforms from different shaders never collide
+    for (int j=0; j<stage.analysis.uniforms.size(); j++) {
+      const QString& u = stage.analysis.uniforms.at(j);
+
+      body.replace(QRegularExpression(QStringLiteral("\\b%1\\b").arg(QRegularExpression::escape(u))),
+                   StageFunctionName(i, u));
+
+      if (!stage.inlined.contains(u)) {
+        uniforms.append(QStringLiteral("uniform %1 %2;\n").arg(stage.analysis.uniform_types.at(j),
+                                                               StageFunctionName(i, u)));
+      }
+    }
+
+    QString color = StageFunctionName(i, QStringLiteral("color"));
+    body.replace(QRegularExpression(QStringLiteral("\\bfragColor\\b")), color);
+    body.replace(QRegularExpression(QStringLiteral("\\breturn\\s*;")), QStringLiteral("return %1;").arg(color));
+
+    functions.append(QStringLiteral("vec4 %1() {\n"
+                                    "vec4 %2 = vec4(0.0);\n"
+                                    "%3\n"
+                                    "return %2;\n"
+                                    "}\n\n").arg(StageFunctionName(i, QStringLiteral("main")), color, body));
+
+    if (i < stages.size() - 1) {
+      // Reproduce what storing this stage in a texture would have done to its output
+      QString adjust;
+
+      if (stage.opaque) {
+        adjust.append(QStringLiteral("c.a = 1.0;\n"));
+      }
+
+      if (stage.clamped) {
+        adjust.append(QStringLiteral("c = clamp(c, 0.0, 1.0);\n"));
+      }
+
+      functions.append(QStringLiteral("vec4 %1() {\n"
+                                      "vec4 c = %2();\n"
+                                      "%3"
+                                      "return c;\n"
+                                      "}\n\n").arg(StageFunctionName(i, QStringLiteral("sample")),
+                                                   StageFunctionName(i, QStringLiteral("main")),
+                                                   adjust));
+    }
+
+    for (auto it=stage.job.GetValues().cbegin(); it!=stage.job.GetValues().cend(); it++) {
+      if (!stage.inlined.contains(it.key())) {
+        QString renamed = StageFunctionName(i, it.key());
+
+        job->InsertValue(renamed, it.value());
+        job->SetInterpolation(renamed, stage.job.GetInterpolation(it.key()));
+      }
+    }
+
+    inlined_keys.sort();
+    key_parts.append(QStringLiteral("%1(%2)%3%4").arg(stage.id,
+                                                      inlined_keys.join(','),
+                                                      stage.opaque ? QStringLiteral("o") : QString(),
+                                                      stage.clamped ? QStringLiteral("c") : QString()));
+  }
+
+  job->SetAlphaChannelRequired(stages.last().job.GetAlphaChannelRequired());
+
+  *code = ShaderCode(QStringLiteral("%1\n"
+                                    "in vec2 ove_texcoord;\n\n"
+                                    "out vec4 fragColor;\n\n"
+                                    "%2"
+                                    "void main(void) {\n"
+                                    "fragColor = %3();\n"
+                                    "}\n").arg(uniforms,
+                                               functions,
+                                               StageFunctionName(stages.size() - 1, QStringLiteral("main"))));
+
+  *key = key_parts.join('|');
+}
+
+ShaderFusion::Analysis ShaderFusion::Analyze(const QString &frag_code, const QString &vert_code)
+{
+  Analysis a;
+  a.pointwise = false;
+
+  ShaderCode default_code;
+  a.passthrough = (frag_code == default_code.frag_code() && vert_code == default_code.vert_code());
+
+  // Inlined stages are run by the fragment shader alone
+  if (vert_code != ShaderCode().vert_code()) {
+    return a;
+  }
+
+  QString code = StripComments(frag_code);
+
+  // Macros could hide anything
+  if (code.contains('#')) {
+    return a;
+  }
+
+  // Only accept uniforms, the standard inputs and outputs, and main()
+  static const QRegularExpression uniform_regex(QStringLiteral("^uniform (\\w+) (\\w+)$"));
+  static const QRegularExpression precision_regex(QStringLiteral("^precision \\w+ \\w+$"));
+  static const QRegularExpression main_regex(QStringLiteral("^void main ?\\( ?(void)? ?\\)$"));
+
+  QString statement;
+  bool has_main = false;
+
+  for (int i=0; i<code.size(); i++) {
+    QChar c = code.at(i);
+
+    if (c == '{') {
+      if (has_main || !main_regex.match(statement.simplified()).hasMatch()) {
+        return a;
+      }
+
+      int end = i + 1;
+      int depth = 1;
+
+      while (end < code.size() && depth > 0) {
+        if (code.at(end) == '{') {
+          depth++;
+        } else if (code.at(end) == '}') {
+          depth--;
+        }
+
+        end++;
+      }
+
+      if (depth > 0) {
+        return a;
+      }
+
+      a.body = code.mid(i + 1, end - 1 - (i + 1));
+      has_main = true;
+      statement.clear();
+      i = end - 1;
+    } else if (c == ';') {
+      QString declaration = statement.simplified();
+      QRegularExpressionMatch match = uniform_regex.match(declaration);
+
+      if (match.hasMatch()) {
+        a.uniform_types.append(match.captured(1));
+        a.uniforms.append(match.captured(2));
+      } else if (declaration != QStringLiteral("in vec2 ove_texcoord")
+                 && declaration != QStringLiteral("out vec4 fragColor")
+                 && !precision_regex.match(declaration).hasMatch()) {
+        return a;
+      }
+
+      statement.clear();
+    } else if (c == '}') {
+      return a;
+    } else {
+      statement.append(c);
+    }
+  }
+
+  if (!has_main || !statement.simplified().isEmpty()) {
+    return a;
+  }
+
+  // Discarding in an inlined stage would discard the whole pixel rather than leave it empty
+  if (a.body.contains(QRegularExpression(QStringLiteral("\\b(discard|ove_iteration|ove_mvpmat)\\b")))) {
+    return a;
+  }
+
+  // Every texture must only be read at this pixel
+  for (int i=0; i<a.uniforms.size(); i++) {
+    const QString& type = a.uniform_types.at(i);
+
+    if (!type.startsWith(QStringLiteral("sampler"))) {
+      continue;
+    }
+
+    if (type != QStringLiteral("sampler2D")) {
+      return a;
+    }
+
+    QString name = QRegularExpression::escape(a.uniforms.at(i));
+    QRegularExpression any_use(QStringLiteral("\\b%1\\b").arg(name));
+    QRegularExpression pointwise_read(QStringLiteral("\\btexture\\s*\\(\\s*%1\\s*,\\s*ove_texcoord\\s*\\)").arg(name));
+
+    if (a.body.count(any_use) != a.body.count(pointwise_read)) {
+      return a;
+    }
+  }
+
+  a.pointwise = true;
+
+  return a;
+}
+
+QString ShaderFusion::StripComments(const QString &code)
+{
+  QString stripped;
+  stripped.reserve(code.size());
+
+  for (int i=0; i<code.size(); i++) {
+    if (code.at(i) == '/' && i + 1 < code.size()) {
+      if (code.at(i + 1) == '/') {
+        // Skip to end of line
+        while (i < code.size() && code.at(i) != '\n') {
+          i++;
+        }
+
+        stripped.append('\n');
+        continue;
+      } else if (code.at(i + 1) == '*') {
+        int end = code.indexOf(QStringLiteral("*/"), i + 2);
+
+        if (end == -1) {
+          break;
+        }
+
+        stripped.append(' ');
+        i = end + 1;
+        continue;
+      }
+    }
+
+    stripped.append(code.at(i));
+  }
+
+  return stripped;
+}
+
+QString ShaderFusion::StageFunctionName(int stage, const QString &name)
+{
+  return QStringLiteral("ove_f%1_%2").arg(QString::number(stage), name);
+}
+
+}
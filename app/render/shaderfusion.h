@@ -0,0 +1,131 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SHADERFUSION_H
+#define SHADERFUSION_H
+
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+
+#include "node/node.h"
+#include "render/job/shaderjob.h"
+#include "render/shadercode.h"
+
+namespace olive {
+
+/**
+ * @brief Combines chains of per-pixel shaders into a single program
+ *
+ * A shader is per-pixel ("pointwise") if the only thing its output at a pixel depends on is its
+ * uniforms and its input textures sampled at that same pixel, i.e. every sampler is only read as
+ * `texture(name, ove_texcoord)`. When such a shader's input is the output of another pointwise
+ * shader, the producer can be inlined as a function call in place of the texture read, so the
+ * whole chain renders in one pass without writing and reading back intermediate textures.
+ *
+ * Shaders are analyzed from their source. Anything the analysis doesn't fully understand (helper
+ * functions, globals, preprocessor directives, arrays, discard, iterations, etc.) is treated as
+ * not pointwise and rendered as usual.
+ */
+class ShaderFusion
+{
+public:
+  struct Analysis {
+    /// TRUE if this shader can be inlined into or have inputs inlined into it
+    bool pointwise;
+
+    /// TRUE if this is the default shader, which does nothing but draw its quad
+    bool passthrough;
+
+    /// Declared uniforms, `uniform_types` at the same index is each one's type
+    QStringList uniforms;
+    QStringList uniform_types;
+
+    /// Contents of main() without the braces
+    QString body;
+  };
+
+  /**
+   * @brief Get the analysis for one of a node's shaders, analyzing it the first time it's seen
+   *
+   * This function is thread-safe.
+   */
+  static Analysis GetAnalysis(const Node* node, const QString& shader_id);
+
+  /**
+   * @brief Returns TRUE if a job for this shader can be inlined into another one
+   */
+  static bool CanFuse(const Analysis& analysis, const ShaderJob& job);
+
+  /**
+   * @brief Returns TRUE if a job does nothing but draw a texture with a matrix
+   *
+   * Consecutive jobs like this can be concatenated into one by multiplying their matrices.
+   */
+  static bool IsTransform(const Analysis& analysis, const ShaderJob& job);
+
+  /**
+   * @brief Returns the number of texture samplers a shader declares
+   */
+  static int CountSamplers(const Analysis& analysis);
+
+  struct Stage {
+    Analysis analysis;
+
+    /// Unique ID of this stage's shader, e.g. the node ID and shader ID
+    QString id;
+
+    ShaderJob job;
+
+    /// Sampler uniforms whose textures are the result of an earlier stage
+    QHash<QString, int> inlined;
+
+    /// The texture this stage replaces had no alpha channel so alpha must read as 1.0
+    bool opaque;
+
+    /// The texture this stage replaces stored integers so values must be clamped to 0.0-1.0
+    bool clamped;
+  };
+
+  /**
+   * @brief Generate a program running every stage in one pass
+   *
+   * `stages` must be ordered so every stage comes after the stages inlined into it, the last is
+   * the one whose output is rendered. `key` uniquely identifies the generated code and can be used
+   * to cache it.
+   */
+  static void Generate(const QVector<Stage>& stages, ShaderCode* code, ShaderJob* job, QString* key);
+
+private:
+  static Analysis Analyze(const QString& frag_code, const QString& vert_code);
+
+  static QString StripComments(const QString& code);
+
+  static QString StageFunctionName(int stage, const QString& name);
+
+  static QMutex analysis_lock_;
+
+  static QHash<QString, Analysis> analysis_cache_;
+
+};
+
+}
+
+#endif // SHADERFUSION_H
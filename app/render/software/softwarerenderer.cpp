@@ -0,0 +1,429 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "softwarerenderer.h"
+
+#include <QDebug>
+#include <QtConcurrent/QtConcurrent>
+#include <QtMath>
+#include <QVector4D>
+
+#include "codec/pixelkernels.h"
+#include "common/ocioutils.h"
+#include "render/job/shaderjob.h"
+
+namespace olive {
+
+const int SoftwareRenderer::kBandHeight = 32;
+
+SoftwareRenderer::SoftwareRenderer(QObject *parent) :
+  Renderer(parent)
+{
+}
+
+SoftwareRenderer::~SoftwareRenderer()
+{
+  Destroy();
+  PostDestroy();
+}
+
+bool SoftwareRenderer::Init()
+{
+  return true;
+}
+
+void SoftwareRenderer::PostDestroy()
+{
+}
+
+void SoftwareRenderer::PostInit()
+{
+}
+
+void SoftwareRenderer::DestroyInternal()
+{
+}
+
+void SoftwareRenderer::ClearDestination(double r, double g, double b, double a)
+{
+  // There's no bound destination here, Blit() clears textures itself
+  Q_UNUSED(r)
+  Q_UNUSED(g)
+  Q_UNUSED(b)
+  Q_UNUSED(a)
+}
+
+QVariant SoftwareRenderer::CreateNativeTexture2D(int width, int height, VideoParams::Format format, int channel_count, const void *data, int linesize)
+{
+  return CreateNativeTexture3D(width, height, 1, format, channel_count, data, linesize);
+}
+
+QVariant SoftwareRenderer::CreateNativeTexture3D(int width, int height, int depth, VideoParams::Format format, int channel_count, const void *data, int linesize)
+{
+  NativeTexture* t = new NativeTexture();
+
+  t->width = width;
+  t->height = height;
+  t->depth = depth;
+  t->channel_count = channel_count;
+  t->pixels.resize(static_cast<size_t>(width) * height * depth * channel_count, 0.0f);
+
+  if (data) {
+    UploadInternal(t, format, data, linesize ? linesize : width);
+  }
+
+  return Node::PtrToValue(t);
+}
+
+void SoftwareRenderer::DestroyNativeTexture(QVariant texture)
+{
+  delete Node::ValueToPtr<NativeTexture>(texture);
+}
+
+QVariant SoftwareRenderer::CreateNativeShader(ShaderCode code)
+{
+  static const ShaderCode default_code;
+
+  NativeShader* shader = new NativeShader();
+
+  if (code.frag_code() == default_code.frag_code() && code.vert_code() == default_code.vert_code()) {
+    shader->type = NativeShader::kPassthrough;
+  } else {
+    shader->type = NativeShader::kUnsupported;
+  }
+
+  return Node::PtrToValue(shader);
+}
+
+QVariant SoftwareRenderer::CreateNativeColorShader(ColorProcessorPtr color_processor, const ShaderCode &code)
+{
+  Q_UNUSED(code)
+
+  NativeShader* shader = new NativeShader();
+
+  shader->type = NativeShader::kColorManaged;
+  shader->color_processor = color_processor;
+
+  return Node::PtrToValue(shader);
+}
+
+void SoftwareRenderer::DestroyNativeShader(QVariant shader)
+{
+  delete Node::ValueToPtr<NativeShader>(shader);
+}
+
+void SoftwareRenderer::UploadToTexture(Texture *texture, const void *data, int linesize)
+{
+  UploadInternal(Node::ValueToPtr<NativeTexture>(texture->id()), texture->format(), data, linesize);
+}
+
+void SoftwareRenderer::DownloadFromTexture(Texture *texture, void *data, int linesize)
+{
+  const NativeTexture* t = Node::ValueToPtr<NativeTexture>(texture->id());
+  int values_per_row = t->width * t->channel_count;
+
+  PixelKernels::ConvertImage(reinterpret_cast<const char*>(t->pixels.data()),
+                             VideoParams::kFormatFloat32,
+                             values_per_row * static_cast<int>(sizeof(float)),
+                             static_cast<char*>(data),
+                             texture->format(),
+                             linesize * VideoParams::GetBytesPerPixel(texture->format(), t->channel_count),
+                             values_per_row,
+                             t->height * t->depth);
+}
+
+QVariant SoftwareRenderer::BeginDownloadFromTexture(Texture *texture, int linesize)
+{
+  // Downloads are just a conversion, there's nothing to overlap them with
+  Q_UNUSED(texture)
+  Q_UNUSED(linesize)
+
+  return QVariant();
+}
+
+QVariant SoftwareRenderer::BeginDownloadRegionFromTexture(Texture *texture, const QRect &region)
+{
+  const NativeTexture* t = Node::ValueToPtr<NativeTexture>(texture->id());
+  QRect clamped = region.intersected(QRect(0, 0, t->width, t->height));
+
+  // Regions are always read as RGBA, so expand the channels into a float buffer first
+  std::vector<float> rgba(static_cast<size_t>(region.width()) * region.height() * VideoParams::kRGBAChannelCount, 0.0f);
+
+  for (int y=clamped.top(); y<=clamped.bottom(); y++) {
+    for (int x=clamped.left(); x<=clamped.right(); x++) {
+      float* out = &rgba[((y - region.y()) * region.width() + (x - region.x())) * VideoParams::kRGBAChannelCount];
+      Sample(t, (x + 0.5f) / t->width, (y + 0.5f) / t->height, false, out);
+    }
+  }
+
+  QByteArray* download = new QByteArray(region.width() * region.height() * VideoParams::GetBytesPerPixel(texture->format(), VideoParams::kRGBAChannelCount), Qt::Uninitialized);
+
+  PixelKernels::Convert(rgba.data(), VideoParams::kFormatFloat32, download->data(), texture->format(), static_cast<int>(rgba.size()));
+
+  return Node::PtrToValue(download);
+}
+
+void SoftwareRenderer::FinishDownloadFromTexture(QVariant download, void *data)
+{
+  QByteArray* bytes = Node::ValueToPtr<QByteArray>(download);
+
+  memcpy(data, bytes->constData(), bytes->size());
+
+  delete bytes;
+}
+
+void SoftwareRenderer::Flush()
+{
+  // Everything is finished by the time each call returns
+}
+
+void SoftwareRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, VideoParams destination_params, bool clear_destination)
+{
+  Q_UNUSED(destination_params)
+
+  NativeShader* shader = Node::ValueToPtr<NativeShader>(s);
+
+  if (!destination) {
+    qWarning() << "Software renderer can only draw to textures";
+    return;
+  }
+
+  NativeTexture* dst = Node::ValueToPtr<NativeTexture>(destination->id());
+
+  if (clear_destination) {
+    std::fill(dst->pixels.begin(), dst->pixels.end(), 0.0f);
+  }
+
+  if (shader->type == NativeShader::kUnsupported) {
+    if (shader->warned.testAndSetRelaxed(0, 1)) {
+      qWarning() << "Software renderer can't run GLSL shaders, their output will be empty";
+    }
+    return;
+  }
+
+  TexturePtr source = job.GetValue(QStringLiteral("ove_maintex")).data.value<TexturePtr>();
+
+  if (!source || source->type() != Texture::k2D) {
+    return;
+  }
+
+  // The quad covers [-1, 1] in both directions before the matrix is applied, so to find what each
+  // destination pixel shows we map its NDC position back through the inverse
+  bool invertible;
+  QTransform inverse = job.GetValue(QStringLiteral("ove_mvpmat")).data.value<QMatrix4x4>().toTransform().inverted(&invertible);
+
+  if (!invertible) {
+    // Degenerate transform, nothing to draw
+    return;
+  }
+
+  BlitParams params;
+  params.shader = shader;
+  params.destination = dst;
+  params.source = Node::ValueToPtr<NativeTexture>(source->id());
+  params.source_linear = (job.GetInterpolation(QStringLiteral("ove_maintex")) != Texture::kNearest);
+  params.inverse = inverse;
+  params.alpha_mode = 0;
+  params.u = nullptr;
+  params.v = nullptr;
+
+  if (shader->type == NativeShader::kColorManaged) {
+    params.alpha_mode = job.GetValue(QStringLiteral("ove_maintex_alpha")).data.toInt();
+
+    if (job.GetValue(QStringLiteral("ove_maintex_yuv")).data.toBool()) {
+      TexturePtr u = job.GetValue(QStringLiteral("ove_maintex_u")).data.value<TexturePtr>();
+      TexturePtr v = job.GetValue(QStringLiteral("ove_maintex_v")).data.value<TexturePtr>();
+
+      if (!u || !v) {
+        return;
+      }
+
+      params.u = Node::ValueToPtr<NativeTexture>(u->id());
+      params.v = Node::ValueToPtr<NativeTexture>(v->id());
+      params.yuv_matrix = job.GetValue(QStringLiteral("ove_yuv_matrix")).data.value<QMatrix4x4>();
+    }
+  }
+
+  QRect area(0, 0, dst->width, dst->height);
+  if (!region_of_interest().isNull()) {
+    area &= region_of_interest();
+  }
+
+  if (area.isEmpty()) {
+    return;
+  }
+
+  params.left = area.left();
+  params.right = area.right() + 1;
+
+  QVector<int> bands;
+  for (int y=area.top(); y<=area.bottom(); y+=kBandHeight) {
+    bands.append(y);
+  }
+
+  int bottom = area.bottom() + 1;
+
+  QtConcurrent::blockingMap(bands, [&params, bottom](int top){
+    DrawRows(params, top, qMin(top + kBandHeight, bottom));
+  });
+}
+
+void SoftwareRenderer::UploadInternal(NativeTexture *t, VideoParams::Format format, const void *data, int linesize)
+{
+  int values_per_row = t->width * t->channel_count;
+
+  PixelKernels::ConvertImage(static_cast<const char*>(data),
+                             format,
+                             linesize * VideoParams::GetBytesPerPixel(format, t->channel_count),
+                             reinterpret_cast<char*>(t->pixels.data()),
+                             VideoParams::kFormatFloat32,
+                             values_per_row * static_cast<int>(sizeof(float)),
+                             values_per_row,
+                             t->height * t->depth);
+}
+
+void SoftwareRenderer::DrawRows(const BlitParams &params, int top, int bottom)
+{
+  NativeTexture* dst = params.destination;
+  int row_width = params.right - params.left;
+
+  // Colors for one row are gathered here so OCIO can convert them in one call
+  std::vector<float> row(static_cast<size_t>(row_width) * VideoParams::kRGBAChannelCount);
+  std::vector<char> covered(row_width);
+
+  OCIO::ConstCPUProcessorRcPtr cpu_processor;
+  if (params.shader->type == NativeShader::kColorManaged) {
+    cpu_processor = params.shader->color_processor->GetProcessor()->getDefaultCPUProcessor();
+  }
+
+  for (int y=top; y<bottom; y++) {
+    double ndc_y = (y + 0.5) / dst->height * 2.0 - 1.0;
+
+    for (int i=0; i<row_width; i++) {
+      double ndc_x = (params.left + i + 0.5) / dst->width * 2.0 - 1.0;
+
+      QPointF quad = params.inverse.map(QPointF(ndc_x, ndc_y));
+
+      // Outside the quad, the destination is left as it is
+      covered[i] = (quad.x() >= -1.0 && quad.x() <= 1.0 && quad.y() >= -1.0 && quad.y() <= 1.0);
+
+      if (!covered[i]) {
+        continue;
+      }
+
+      float s = static_cast<float>((quad.x() + 1.0) * 0.5);
+      float t = static_cast<float>((quad.y() + 1.0) * 0.5);
+      float* col = &row[i * VideoParams::kRGBAChannelCount];
+
+      Sample(params.source, s, t, params.source_linear, col);
+
+      if (params.u) {
+        float u[4], v[4];
+        Sample(params.u, s, t, params.source_linear, u);
+        Sample(params.v, s, t, params.source_linear, v);
+
+        QVector4D rgb = params.yuv_matrix * QVector4D(col[0], u[0], v[0], 1.0f);
+        col[0] = rgb.x();
+        col[1] = rgb.y();
+        col[2] = rgb.z();
+        col[3] = 1.0f;
+      }
+
+      // Matches the ALPHA_ASSOC define in the color shader Renderer generates
+      if (params.alpha_mode == 2 && col[3] != 0.0f) {
+        col[0] /= col[3];
+        col[1] /= col[3];
+        col[2] /= col[3];
+      }
+    }
+
+    if (cpu_processor) {
+      OCIO::PackedImageDesc img(row.data(), row_width, 1, VideoParams::kRGBAChannelCount);
+      cpu_processor->apply(img);
+    }
+
+    float* out = &dst->pixels[(static_cast<size_t>(y) * dst->width + params.left) * dst->channel_count];
+
+    for (int i=0; i<row_width; i++, out+=dst->channel_count) {
+      if (!covered[i]) {
+        continue;
+      }
+
+      float* col = &row[i * VideoParams::kRGBAChannelCount];
+
+      // Associated alpha is restored, unassociated alpha is associated, like the color shader
+      if (params.alpha_mode == 1 || (params.alpha_mode == 2 && col[3] != 0.0f)) {
+        col[0] *= col[3];
+        col[1] *= col[3];
+        col[2] *= col[3];
+      }
+
+      for (int c=0; c<dst->channel_count; c++) {
+        out[c] = col[c];
+      }
+    }
+  }
+}
+
+void SoftwareRenderer::Sample(const NativeTexture *texture, float s, float t, bool linear, float *out)
+{
+  static const float kMissingChannels[] = {0.0f, 0.0f, 0.0f, 1.0f};
+
+  int channels = texture->channel_count;
+  float x = s * texture->width - 0.5f;
+  float y = t * texture->height - 0.5f;
+
+  auto texel = [texture, channels](int tx, int ty) {
+    tx = qBound(0, tx, texture->width - 1);
+    ty = qBound(0, ty, texture->height - 1);
+    return &texture->pixels[(static_cast<size_t>(ty) * texture->width + tx) * channels];
+  };
+
+  if (!linear) {
+    const float* p = texel(qFloor(x + 0.5f), qFloor(y + 0.5f));
+
+    for (int c=0; c<VideoParams::kRGBAChannelCount; c++) {
+      out[c] = (c < channels) ? p[c] : kMissingChannels[c];
+    }
+    return;
+  }
+
+  int x0 = qFloor(x);
+  int y0 = qFloor(y);
+  float fx = x - x0;
+  float fy = y - y0;
+
+  const float* p00 = texel(x0, y0);
+  const float* p10 = texel(x0 + 1, y0);
+  const float* p01 = texel(x0, y0 + 1);
+  const float* p11 = texel(x0 + 1, y0 + 1);
+
+  for (int c=0; c<VideoParams::kRGBAChannelCount; c++) {
+    if (c < channels) {
+      float top = p00[c] + (p10[c] - p00[c]) * fx;
+      float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+      out[c] = top + (bottom - top) * fy;
+    } else {
+      out[c] = kMissingChannels[c];
+    }
+  }
+}
+
+}
@@ -0,0 +1,164 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SOFTWARERENDERER_H
+#define SOFTWARERENDERER_H
+
+#include <QAtomicInt>
+#include <QMatrix4x4>
+#include <QTransform>
+
+#include "render/renderer.h"
+
+namespace olive {
+
+/**
+ * @brief A Renderer that draws on the CPU, for machines without a usable GPU
+ *
+ * Textures are kept in memory as 32-bit float and converted to and from their own formats on
+ * upload and download. Blits are split into bands of rows that are drawn in parallel.
+ *
+ * GLSL can't run here, so only the default shader (a transformed copy of `ove_maintex`) and
+ * color managed blits are drawn, the latter through OCIO's CPU processor rather than its
+ * generated shader. Blits with any other shader leave the destination empty. Output only depends
+ * on the input, which makes this backend suitable for comparing renders across machines.
+ *
+ * Every function is safe to call from any thread, so the RenderManager shares one instance
+ * between all of its workers.
+ */
+class SoftwareRenderer : public Renderer
+{
+  Q_OBJECT
+public:
+  SoftwareRenderer(QObject* parent = nullptr);
+
+  virtual ~SoftwareRenderer() override;
+
+  virtual bool Init() override;
+
+  virtual void PostDestroy() override;
+
+public slots:
+  virtual void PostInit() override;
+
+  virtual void DestroyInternal() override;
+
+  virtual void ClearDestination(double r = 0.0, double g = 0.0, double b = 0.0, double a = 0.0) override;
+
+  virtual QVariant CreateNativeTexture2D(int width, int height, olive::VideoParams::Format format, int channel_count, const void* data = nullptr, int linesize = 0) override;
+  virtual QVariant CreateNativeTexture3D(int width, int height, int depth, olive::VideoParams::Format format, int channel_count, const void* data = nullptr, int linesize = 0) override;
+
+  virtual void DestroyNativeTexture(QVariant texture) override;
+
+  virtual QVariant CreateNativeShader(olive::ShaderCode code) override;
+
+  virtual void DestroyNativeShader(QVariant shader) override;
+
+  virtual void UploadToTexture(olive::Texture* texture, const void* data, int linesize) override;
+
+  virtual void DownloadFromTexture(olive::Texture* texture, void* data, int linesize) override;
+
+  virtual QVariant BeginDownloadFromTexture(olive::Texture* texture, int linesize) override;
+
+  virtual QVariant BeginDownloadRegionFromTexture(olive::Texture* texture, const QRect& region) override;
+
+  virtual void FinishDownloadFromTexture(QVariant download, void* data) override;
+
+  virtual void Flush() override;
+
+protected:
+  virtual QVariant CreateNativeColorShader(ColorProcessorPtr color_processor, const ShaderCode& code) override;
+
+protected slots:
+  virtual void Blit(QVariant shader,
+                    olive::ShaderJob job,
+                    olive::Texture* destination,
+                    olive::VideoParams destination_params,
+                    bool clear_destination) override;
+
+private:
+  struct NativeTexture {
+    int width;
+    int height;
+    int depth;
+    int channel_count;
+
+    /// Every channel of every pixel as a normalized float, rows top to bottom with no padding
+    std::vector<float> pixels;
+  };
+
+  struct NativeShader {
+    enum Type {
+      kPassthrough,
+      kColorManaged,
+      kUnsupported
+    };
+
+    Type type;
+
+    ColorProcessorPtr color_processor;
+
+    QAtomicInt warned;
+  };
+
+  /**
+   * @brief Everything a band of rows needs to draw a blit
+   */
+  struct BlitParams {
+    const NativeShader* shader;
+    NativeTexture* destination;
+    const NativeTexture* source;
+    bool source_linear;
+
+    /// Maps destination NDC back to the blit quad's [-1, 1] coordinates
+    QTransform inverse;
+
+    /// For color managed blits, see Renderer::BlitColorManagedInternal()
+    int alpha_mode;
+    const NativeTexture* u;
+    const NativeTexture* v;
+    QMatrix4x4 yuv_matrix;
+
+    int left;
+    int right;
+  };
+
+  static void UploadInternal(NativeTexture* t, VideoParams::Format format, const void* data, int linesize);
+
+  static void DrawRows(const BlitParams& params, int top, int bottom);
+
+  /**
+   * @brief Sample a 2D texture at normalized coordinates with clamp-to-edge addressing
+   *
+   * Always outputs four channels, missing ones are filled the way OpenGL does (0 for green and
+   * blue, 1 for alpha).
+   */
+  static void Sample(const NativeTexture* texture, float s, float t, bool linear, float* out);
+
+  /**
+   * @brief Number of rows drawn by one thread at a time
+   */
+  static const int kBandHeight;
+
+};
+
+}
+
+#endif // SOFTWARERENDERER_H
@@ -0,0 +1,214 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "stillimagecache.h"
+
+#include "common/lockprofiler.h"
+#include "config/config.h"
+
+namespace olive {
+
+StillImageCache::StillImageCache(const QString &name, const QString &budget_entry) :
+  Consumer(name, MemoryGovernor::kPriorityTexture),
+  budget_entry_(budget_entry),
+  trim_request_(0)
+{
+  MemoryGovernor::Register(this);
+}
+
+StillImageCache::~StillImageCache()
+{
+  MemoryGovernor::Unregister(this);
+}
+
+bool StillImageCache::Key::operator==(const Key &rhs) const
+{
+  return stream == rhs.stream
+      && colorspace == rhs.colorspace
+      && alpha_is_associated == rhs.alpha_is_associated
+      && divider == rhs.divider
+      && time == rhs.time
+      && proxy == rhs.proxy
+      && deinterlace == rhs.deinterlace
+      && hash == rhs.hash;
+}
+
+TexturePtr StillImageCache::Acquire(const Key &key, bool *reserved)
+{
+  Shard& shard = GetShard(key);
+
+  ProfiledMutexLocker locker(&shard.lock, LockProfiler::kStillImageCache);
+
+  while (true) {
+    auto it = shard.entries.find(key);
+
+    if (it == shard.entries.end()) {
+      // Nobody has this yet, reserve it for the caller
+      Entry e;
+      e.promise = std::make_shared< std::promise<TexturePtr> >();
+      e.future = e.promise->get_future().share();
+      e.size = 0;
+      e.access = shard.access_order.end();
+      shard.entries.insert(key, e);
+
+      *reserved = true;
+      return nullptr;
+    }
+
+    *reserved = false;
+
+    if (it->access != shard.access_order.end()) {
+      // Already filled, bump it to most recently used
+      shard.access_order.splice(shard.access_order.end(), shard.access_order, it->access);
+    }
+
+    // Copy the future so we can wait without holding the shard
+    std::shared_future<TexturePtr> future = it->future;
+
+    locker.unlock();
+
+    TexturePtr texture = future.get();
+
+    if (texture) {
+      return texture;
+    }
+
+    // Whoever reserved this failed or was cancelled part way through, so rather than handing a
+    // render that still wants it a blank frame, try again and most likely reserve it ourselves
+    locker.relock();
+  }
+}
+
+void StillImageCache::Fill(const Key &key, TexturePtr texture)
+{
+  Shard& shard = GetShard(key);
+
+  ProfiledMutexLocker locker(&shard.lock, LockProfiler::kStillImageCache);
+
+  auto it = shard.entries.find(key);
+
+  if (it == shard.entries.end() || !it->promise) {
+    qWarning() << "Tried to fill a still image cache entry that wasn't reserved";
+    return;
+  }
+
+  it->promise->set_value(texture);
+  it->promise = nullptr;
+
+  if (!texture) {
+    // Waiters get the null result this time, the next request will try again
+    shard.entries.erase(it);
+    return;
+  }
+
+  const VideoParams& p = texture->params();
+  it->size = VideoParams::GetBufferSize(p.effective_width(), p.effective_height(), p.format(), p.channel_count());
+
+  shard.access_order.push_back(key);
+  it->access = std::prev(shard.access_order.end());
+  shard.size += it->size;
+
+  // Every shard gets an equal share of the budget
+  qint64 budget = Config::Current()[budget_entry_].toLongLong() * 1048576 / kShardCount;
+
+  // Include anything the governor asked for since we're on a thread that can destroy textures
+  qint64 trim = trim_request_.fetchAndStoreOrdered(0);
+
+  // Always keep the most recent entry, even if it's larger than the budget on its own
+  while ((shard.size > budget || trim > 0) && shard.access_order.size() > 1) {
+    auto lru = shard.entries.find(shard.access_order.front());
+
+    if (shard.size <= budget) {
+      trim -= lru->size;
+    }
+
+    shard.size -= lru->size;
+    shard.entries.erase(lru);
+    shard.access_order.pop_front();
+  }
+}
+
+TexturePtr StillImageCache::Get(const Key &key)
+{
+  Shard& shard = GetShard(key);
+
+  ProfiledMutexLocker locker(&shard.lock, LockProfiler::kStillImageCache);
+
+  auto it = shard.entries.find(key);
+
+  if (it == shard.entries.end() || it->access == shard.access_order.end()) {
+    // Not cached or still being created
+    return nullptr;
+  }
+
+  shard.access_order.splice(shard.access_order.end(), shard.access_order, it->access);
+
+  return it->future.get();
+}
+
+void StillImageCache::Insert(const Key &key, TexturePtr texture)
+{
+  bool reserved;
+
+  Acquire(key, &reserved);
+
+  if (reserved) {
+    Fill(key, texture);
+  }
+}
+
+qint64 StillImageCache::GetMemoryUsage() const
+{
+  qint64 size = 0;
+
+  for (int i=0; i<kShardCount; i++) {
+    QMutexLocker locker(&shards_[i].lock);
+    size += shards_[i].size;
+  }
+
+  return size;
+}
+
+bool StillImageCache::ReleaseMemory(qint64 bytes)
+{
+  // Only the latest request matters, each one is how far over budget we are right now
+  trim_request_.storeRelease(bytes);
+
+  return false;
+}
+
+StillImageCache::Shard &StillImageCache::GetShard(const Key &key)
+{
+  return shards_[qHash(key, 0) % kShardCount];
+}
+
+uint qHash(const StillImageCache::Key &k, uint seed)
+{
+  return ::qHash(k.stream, seed)
+      ^ ::qHash(k.colorspace, seed)
+      ^ qHash(k.time, seed)
+      ^ (static_cast<uint>(k.divider) << 2)
+      ^ (k.alpha_is_associated ? 1u : 0u)
+      ^ (k.proxy ? 2u : 0u)
+      ^ (k.deinterlace ? 0x80000000u : 0u)
+      ^ ::qHash(k.hash, seed);
+}
+
+}
@@ -1,83 +1,150 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
 #ifndef STILLIMAGECACHE_H
 #define STILLIMAGECACHE_H
 
+#include <future>
+#include <list>
 #include <QHash>
-#include <QWaitCondition>
+#include <QMutex>
 
-#include "common/rational.h"
+#include "common/define.h"
+#include "common/memorygovernor.h"
 #include "project/item/footage/videostream.h"
 #include "render/texture.h"
 
 namespace olive {
 
-class StillImageCache
+/**
+ * @brief Cache of color managed footage textures shared between renderers
+ *
+ * Uploading and color managing a large still image for every frame it's used on is a waste of
+ * time, so the resulting texture is kept here for any renderer to reuse. A second instance holds
+ * recently decoded video frames so scrubbing back and forth over a short region, or re-rendering
+ * after a parameter change, doesn't decode, upload, and convert the same source frames again.
+ *
+ * Entries are spread across several independently locked shards by hash so render threads only
+ * contend when they want the same image, and lookups are a hash rather than a linear scan. When a
+ * renderer starts creating a texture it reserves the key with a future, other renderers wanting the
+ * same texture wait on that future rather than on the whole cache.
+ *
+ * The cache is bounded by the texture memory its entries use, set in megabytes by the config entry
+ * named by `budget_entry`. Least recently used textures are dropped first. It's also registered
+ * with MemoryGovernor under `name`. Textures can only be destroyed on a render thread, so when the
+ * governor asks for memory back, the next Fill() drops that much more from its shard.
+ *
+ * This class is thread safe.
+ */
+class StillImageCache : public MemoryGovernor::Consumer
 {
 public:
-  struct Entry {
-    Entry(TexturePtr t, VideoStream* s, const QString& cs, bool a, int d, const rational& i, bool w)
-    {
-      texture = t;
-      stream = s;
-      colorspace = cs;
-      alpha_is_associated = a;
-      divider = d;
-      time = i;
-      working = w;
-    }
-
-    TexturePtr texture;
+  StillImageCache(const QString& name, const QString& budget_entry);
+
+  virtual ~StillImageCache() override;
+
+  DISABLE_COPY_MOVE(StillImageCache)
+
+  struct Key {
     VideoStream* stream;
     QString colorspace;
     bool alpha_is_associated;
     int divider;
     rational time;
-    bool working;
+    bool proxy;
+    bool deinterlace;
+
+    /// For a node's rendered output rather than footage, `stream` is nullptr and this is its hash
+    QByteArray hash;
+
+    bool operator==(const Key& rhs) const;
   };
 
-  using EntryPtr = std::shared_ptr<Entry>;
-
-  QMutex* mutex()
-  {
-    return &mutex_;
-  }
-
-  QWaitCondition* wait_cond()
-  {
-    return &wait_cond_;
-  }
-
-  const QVector<EntryPtr>& entries() const
-  {
-    return entries_;
-  }
-
-  static bool CompareEntryMetadata(EntryPtr a, EntryPtr b)
-  {
-    return (a->stream == b->stream
-            && a->colorspace == b->colorspace
-            && a->alpha_is_associated == b->alpha_is_associated
-            && a->divider == b->divider
-            && a->time == b->time);
-  }
-
-  void PushEntry(EntryPtr e)
-  {
-    entries_.prepend(e);
-
-    if (entries_.size() > 8) {
-      entries_.removeLast();
-    }
-  }
+  /**
+   * @brief Look up a texture or reserve the right to create it
+   *
+   * If the texture is cached, it's returned. If another renderer is currently creating it, this
+   * waits for it to finish and returns its result, or tries again if it produced nothing (e.g.
+   * because its render was cancelled). Otherwise nullptr is returned with `reserved`
+   * set to TRUE, in which case the caller must create the texture and call Fill() with it (even if
+   * creating it failed) so anyone waiting is released.
+   */
+  TexturePtr Acquire(const Key& key, bool* reserved);
+
+  /**
+   * @brief Provide the texture for a key reserved with Acquire()
+   *
+   * If `texture` is nullptr, the reservation is dropped and the next Acquire() will try again.
+   */
+  void Fill(const Key& key, TexturePtr texture);
+
+  /**
+   * @brief Returns a texture if it's cached and finished, never waits for one being created
+   */
+  TexturePtr Get(const Key& key);
+
+  /**
+   * @brief Cache a texture unless it's already cached or being created
+   */
+  void Insert(const Key& key, TexturePtr texture);
+
+  virtual qint64 GetMemoryUsage() const override;
+
+  /**
+   * @brief Request the next Fill() trims `bytes` more, always returns FALSE since nothing is freed yet
+   */
+  virtual bool ReleaseMemory(qint64 bytes) override;
 
 private:
-  QMutex mutex_;
+  struct Entry {
+    std::shared_future<TexturePtr> future;
+    std::shared_ptr< std::promise<TexturePtr> > promise;
+    qint64 size;
+    std::list<Key>::iterator access;
+  };
 
-  QWaitCondition wait_cond_;
+  struct Shard {
+    QMutex lock;
+    QHash<Key, Entry> entries;
+
+    /// Filled entries ordered from least to most recently used, reserved entries aren't in here
+    std::list<Key> access_order;
+
+    qint64 size = 0;
+  };
 
-  QVector<EntryPtr> entries_;
+  Shard& GetShard(const Key& key);
+
+  static const int kShardCount = 16;
+
+  QString budget_entry_;
+
+  mutable Shard shards_[kShardCount];
+
+  /// Bytes the governor asked for that haven't been trimmed yet
+  QAtomicInteger<qint64> trim_request_;
 
 };
 
+uint qHash(const StillImageCache::Key& k, uint seed);
+
 }
 
 #endif // STILLIMAGECACHE_H
@@ -28,12 +28,17 @@ const Texture::Interpolation Texture::kDefaultInterpolation = Texture::kMipmappe
 
 Texture::~Texture()
 {
-  renderer_->DestroyNativeTexture(id_);
+  renderer_->ReleaseTexture(id_, params_, type_);
 }
 
-void Texture::Upload(void *data, int linesize)
+void Texture::Upload(const void *data, int linesize)
 {
   renderer_->UploadToTexture(this, data, linesize);
 }
 
+void Texture::Download(void *data, int linesize)
+{
+  renderer_->DownloadFromTexture(this, data, linesize);
+}
+
 }
@@ -23,6 +23,7 @@
 
 #include <memory>
 
+#include "common/memoryaccounting.h"
 #include "render/videoparams.h"
 
 namespace olive {
@@ -45,11 +46,13 @@ public:
 
   static const Interpolation kDefaultInterpolation;
 
-  Texture(Renderer* renderer, const QVariant& native, const VideoParams& param, Type type) :
+  Texture(Renderer* renderer, const QVariant& native, const VideoParams& param, Type type,
+          MemoryAccounting::Category origin = MemoryAccounting::kTextureIntermediate) :
     renderer_(renderer),
     params_(param),
     id_(native),
-    type_(type)
+    type_(type),
+    memory_(origin, native.isNull() ? 0 : GetMemoryUsage(param, type))
   {
   }
 
@@ -65,7 +68,9 @@ public:
     return params_;
   }
 
-  void Upload(void* data, int linesize);
+  void Upload(const void* data, int linesize);
+
+  void Download(void* data, int linesize);
 
   int width() const
   {
@@ -102,6 +107,21 @@ public:
     return type_;
   }
 
+  /**
+   * @brief Returns the approximate video memory used by a texture with these parameters
+   */
+  static qint64 GetMemoryUsage(const VideoParams& params, Type type)
+  {
+    qint64 bytes = VideoParams::GetBufferSize(params.effective_width(), params.effective_height(),
+                                              params.format(), params.channel_count());
+
+    if (type == k3D) {
+      bytes *= params.effective_depth();
+    }
+
+    return bytes;
+  }
+
 private:
   Renderer* renderer_;
 
@@ -111,6 +131,8 @@ private:
 
   Type type_;
 
+  MemoryAccounting::Counter memory_;
+
 };
 
 using TexturePtr = std::shared_ptr<Texture>;
@@ -0,0 +1,110 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "texturepool.h"
+
+namespace olive {
+
+TexturePool::TexturePool() :
+  budget_(0),
+  memory_usage_(0),
+  hits_(0),
+  misses_(0)
+{
+}
+
+QVariant TexturePool::Take(const VideoParams &params)
+{
+  QMutexLocker locker(&mutex_);
+
+  for (auto it=entries_.begin(); it!=entries_.end(); it++) {
+    if (it->Matches(params)) {
+      QVariant texture = it->texture;
+
+      memory_usage_ -= it->size;
+      entries_.erase(it);
+      hits_++;
+
+      return texture;
+    }
+  }
+
+  misses_++;
+
+  return QVariant();
+}
+
+QVector<QVariant> TexturePool::Give(const QVariant &texture, const VideoParams &params)
+{
+  QMutexLocker locker(&mutex_);
+
+  Entry e;
+  e.width = params.effective_width();
+  e.height = params.effective_height();
+  e.format = params.format();
+  e.channel_count = params.channel_count();
+  e.texture = texture;
+  e.size = static_cast<qint64>(VideoParams::GetBufferSize(e.width, e.height, e.format, e.channel_count));
+
+  entries_.push_front(e);
+  memory_usage_ += e.size;
+
+  return TrimInternal();
+}
+
+QVector<QVariant> TexturePool::Clear()
+{
+  QMutexLocker locker(&mutex_);
+
+  QVector<QVariant> removed;
+
+  foreach (const Entry& e, entries_) {
+    removed.append(e.texture);
+  }
+
+  entries_.clear();
+  memory_usage_ = 0;
+
+  return removed;
+}
+
+QVector<QVariant> TexturePool::SetBudget(qint64 bytes)
+{
+  QMutexLocker locker(&mutex_);
+
+  budget_ = bytes;
+
+  return TrimInternal();
+}
+
+QVector<QVariant> TexturePool::TrimInternal()
+{
+  QVector<QVariant> removed;
+
+  while (!entries_.empty() && memory_usage_ > budget_) {
+    removed.append(entries_.back().texture);
+    memory_usage_ -= entries_.back().size;
+    entries_.pop_back();
+  }
+
+  return removed;
+}
+
+}
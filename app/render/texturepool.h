@@ -0,0 +1,133 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TEXTUREPOOL_H
+#define TEXTUREPOOL_H
+
+#include <list>
+#include <QMutex>
+#include <QVariant>
+
+#include "render/videoparams.h"
+
+namespace olive {
+
+/**
+ * @brief Recycles native 2D textures so intermediates don't need a new allocation every frame
+ *
+ * Textures that are no longer referenced are given back to the pool instead of being destroyed,
+ * and handed out again the next time a texture with the same dimensions, format and channel count
+ * is requested. Once the idle textures exceed the memory budget, the least recently returned ones
+ * are evicted.
+ *
+ * The pool only stores native handles, it's up to the Renderer to create and destroy them. This
+ * class is thread-safe.
+ */
+class TexturePool
+{
+public:
+  TexturePool();
+
+  /**
+   * @brief Take an idle texture matching these parameters, or a null QVariant if there isn't one
+   */
+  QVariant Take(const VideoParams& params);
+
+  /**
+   * @brief Give a texture back to the pool
+   *
+   * Returns any textures that were evicted to stay within the budget, which the caller must
+   * destroy.
+   */
+  QVector<QVariant> Give(const QVariant& texture, const VideoParams& params);
+
+  /**
+   * @brief Remove every idle texture from the pool, returning them so the caller can destroy them
+   */
+  QVector<QVariant> Clear();
+
+  /**
+   * @brief Set the maximum number of bytes idle textures can take up
+   */
+  QVector<QVariant> SetBudget(qint64 bytes);
+
+  quint64 hits() const
+  {
+    QMutexLocker locker(&mutex_);
+    return hits_;
+  }
+
+  quint64 misses() const
+  {
+    QMutexLocker locker(&mutex_);
+    return misses_;
+  }
+
+  qint64 memory_usage() const
+  {
+    QMutexLocker locker(&mutex_);
+    return memory_usage_;
+  }
+
+  qint64 budget() const
+  {
+    QMutexLocker locker(&mutex_);
+    return budget_;
+  }
+
+private:
+  struct Entry {
+    int width;
+    int height;
+    VideoParams::Format format;
+    int channel_count;
+
+    QVariant texture;
+    qint64 size;
+
+    bool Matches(const VideoParams& params) const
+    {
+      return width == params.effective_width()
+          && height == params.effective_height()
+          && format == params.format()
+          && channel_count == params.channel_count();
+    }
+  };
+
+  QVector<QVariant> TrimInternal();
+
+  // Most recently returned at the front
+  std::list<Entry> entries_;
+
+  qint64 budget_;
+
+  qint64 memory_usage_;
+
+  quint64 hits_;
+
+  quint64 misses_;
+
+  mutable QMutex mutex_;
+
+};
+
+}
+
+#endif // TEXTUREPOOL_H
@@ -8,24 +8,27 @@ in vec2 ove_texcoord;
 out vec4 fragColor;
 
 void main(void) {
-    vec4 base_col = texture(base_in, ove_texcoord);
-    vec4 blend_col = texture(blend_in, ove_texcoord);
-
     if (!base_in_enabled && !blend_in_enabled) {
         fragColor = vec4(0.0);
         return;
     }
 
-    if (!base_in_enabled) {
-        fragColor = blend_col;
+    if (!blend_in_enabled) {
+        fragColor = texture(base_in, ove_texcoord);
         return;
     }
 
-    if (!blend_in_enabled) {
-        fragColor = base_col;
-        return; 
+    vec4 blend_col = texture(blend_in, ove_texcoord);
+
+    // Where the blend is opaque the base can't be seen, so it's never sampled. When the base is a
+    // chain of merges fused into this shader, that skips every layer beneath.
+    if (!base_in_enabled || blend_col.a >= 1.0) {
+        fragColor = blend_col;
+        return;
     }
 
+    vec4 base_col = texture(base_in, ove_texcoord);
+
     base_col *= 1.0 - blend_col.a;
     base_col += blend_col;
 
@@ -4,6 +4,7 @@ uniform float radius_in;
 uniform bool horiz_in;
 uniform bool vert_in;
 uniform bool repeat_edge_pixels_in;
+uniform int lod_in;
 uniform vec2 resolution_in;
 
 uniform int ove_iteration;
@@ -74,12 +75,19 @@ void main(void) {
 
     vec4 composite = vec4(0.0);
 
+    // For large radii we sample from a downsampled mipmap, each texel there covers `scale` pixels
+    // so we step over the kernel `scale` times faster
+    float lod = float(lod_in);
+    float scale = exp2(lod);
+    float step_size = 2.0 * scale;
+    float start = -real_radius + 0.5 * scale;
+
     float divider, sigma;
 
     if (method_in == METHOD_BOX_BLUR) {
 
         // Calculate the weight of each pixel based on the radius
-        divider = 1.0 / real_radius;
+        divider = scale / real_radius;
 
     } else if (method_in == METHOD_GAUSSIAN_BLUR) {
 
@@ -90,13 +98,14 @@ void main(void) {
 
         // Use gaussian formula to calculate the weight of all pixels
         divider = 0.0;
-        for (float i = -real_radius + 0.5; i <= real_radius; i += 2.0) {
+        start = -real_radius + 0.5 * scale;
+        for (float i = start; i <= real_radius; i += step_size) {
             divider += gaussian2(i, 0.0, sigma);
         }
 
     }
 
-    for (float i = -real_radius + 0.5; i <= real_radius; i += 2.0) {
+    for (float i = start; i <= real_radius; i += step_size) {
         float weight;
 
         if (method_in == METHOD_BOX_BLUR) {
@@ -117,7 +126,7 @@ void main(void) {
                 && pixel_coord.x < 1.0
                 && pixel_coord.y >= 0.0
                 && pixel_coord.y < 1.0)) {
-            composite += texture(tex_in, pixel_coord) * weight;
+            composite += textureLod(tex_in, pixel_coord, lod) * weight;
         }
     }
 
@@ -0,0 +1,53 @@
+// Wheel diameter in pixels
+uniform float ove_diameter;
+
+// HSV value of every color on the wheel
+uniform float ove_value;
+
+// Input texture coordinate
+in vec2 ove_texcoord;
+
+// Output color
+out vec4 fragColor;
+
+// Matches Color::fromHsv()
+vec3 hsv_to_rgb(float h, float s, float v) {
+    float c = s * v;
+    float x = c * (1.0 - abs(mod(h / 60.0, 2.0) - 1.0));
+    float m = v - c;
+
+    vec3 rgb;
+
+    if (h < 60.0) {
+        rgb = vec3(c, x, 0.0);
+    } else if (h < 120.0) {
+        rgb = vec3(x, c, 0.0);
+    } else if (h < 180.0) {
+        rgb = vec3(0.0, c, x);
+    } else if (h < 240.0) {
+        rgb = vec3(0.0, x, c);
+    } else if (h < 300.0) {
+        rgb = vec3(x, 0.0, c);
+    } else {
+        rgb = vec3(c, 0.0, x);
+    }
+
+    return rgb + m;
+}
+
+void main(void) {
+    float radius = ove_diameter * 0.5;
+
+    // Position from the center with Y pointing down, the same as ColorWheelWidget's screen coords
+    vec2 pos = vec2(ove_texcoord.x - 0.5, 0.5 - ove_texcoord.y) * ove_diameter;
+    float hypotenuse = length(pos);
+
+    float hue = degrees(atan(pos.y, pos.x)) + 180.0;
+    float sat = min(1.0, hypotenuse / radius);
+
+    // Very basic antialiasing around the edges of the wheel
+    float alpha = clamp(radius - hypotenuse, 0.0, 1.0);
+
+    // Output is premultiplied
+    fragColor = vec4(hsv_to_rgb(hue, sat, ove_value) * alpha, alpha);
+}
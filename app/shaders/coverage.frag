@@ -0,0 +1,14 @@
+// Single channel coverage mask, e.g. rasterized text
+uniform sampler2D ove_maintex;
+
+// Color to tint covered pixels with
+uniform vec4 color_in;
+
+in vec2 ove_texcoord;
+
+out vec4 fragColor;
+
+void main() {
+    // Output is premultiplied so the coverage scales every channel
+    fragColor = color_in * texture(ove_maintex, ove_texcoord).r;
+}
@@ -2,19 +2,70 @@ uniform sampler2D ove_maintex;
 
 uniform vec2 resolution_in;
 
+// 0 keeps the top (even) field, 1 keeps the bottom (odd) field
+uniform int field_in;
+
 in vec2 ove_texcoord;
 
 out vec4 fragColor;
 
+vec4 texel(ivec2 pos) {
+    return texelFetch(ove_maintex, clamp(pos, ivec2(0), ivec2(resolution_in) - 1), 0);
+}
+
+// How different the lines above and below are along direction `dir`
+float edge_score(ivec2 pos, int dir) {
+    float score = 0.0;
+
+    for (int i = -1; i <= 1; i++) {
+        vec4 diff = abs(texel(pos + ivec2(dir + i, -1)) - texel(pos + ivec2(-dir + i, 1)));
+        score += diff.r + diff.g + diff.b;
+    }
+
+    return score;
+}
+
+vec4 edge_pred(ivec2 pos, int dir) {
+    return (texel(pos + ivec2(dir, -1)) + texel(pos + ivec2(-dir, 1))) * 0.5;
+}
+
 void main() {
-    vec2 using_texcoord = ove_texcoord;
+    ivec2 pos = ivec2(ove_texcoord * resolution_in);
+
+    if (pos.y % 2 == field_in) {
+        // This line belongs to the field we're keeping
+        fragColor = texel(pos);
+        return;
+    }
+
+    // Rebuild the missing line with yadif's spatial prediction: interpolate along whichever
+    // direction across the line the neighboring field matches best, so diagonal edges don't
+    // staircase. Steeper directions are only tried if the shallower one was an improvement.
+    vec4 color = edge_pred(pos, 0);
+    float best = edge_score(pos, 0);
+
+    float score = edge_score(pos, -1);
+    if (score < best) {
+        best = score;
+        color = edge_pred(pos, -1);
+
+        score = edge_score(pos, -2);
+        if (score < best) {
+            best = score;
+            color = edge_pred(pos, -2);
+        }
+    }
+
+    score = edge_score(pos, 1);
+    if (score < best) {
+        best = score;
+        color = edge_pred(pos, 1);
 
-    // A very basic deinterlace that halves the vertical
-    // resolution and linearly interpolates the two fields
-    // by reading the texture coord between them.
-    float half_vert = round(resolution_in.y / 2.0);
-    using_texcoord.y = (round(using_texcoord.y * half_vert) + 0.25) / half_vert;
+        score = edge_score(pos, 2);
+        if (score < best) {
+            color = edge_pred(pos, 2);
+        }
+    }
 
-    vec4 color = texture(ove_maintex, using_texcoord);
     fragColor = color;
 }
@@ -4,6 +4,9 @@ uniform vec4 color_in;
 
 uniform vec2 resolution_in;
 
+// If TRUE, this is drawn over the polygon's triangles and ove_texcoord.x is edge coverage
+uniform bool triangulated_in;
+
 in vec2 ove_texcoord;
 
 out vec4 fragColor;
@@ -34,7 +37,10 @@ bool pnpoly(vec2 p) {
 }
 
 void main(void) {
-    if (points_in_count > 0 && pnpoly(ove_texcoord * resolution_in)) {
+    if (triangulated_in) {
+        fragColor = color_in * ove_texcoord.x;
+    } else if (points_in_count > 0 && pnpoly(ove_texcoord * resolution_in)) {
+        // Self-intersecting polygons can't be triangulated, test every pixel instead
         fragColor = color_in;
     } else {
         fragColor = vec4(0.0, 0.0, 0.0, 0.0);
@@ -0,0 +1,41 @@
+uniform sampler2D ove_maintex;
+
+uniform vec2 viewport;
+
+uniform float waveform_scale;
+
+in vec2 ove_texcoord;
+
+out vec4 fragColor;
+
+void main(void) {
+    float waveform_height = ceil(waveform_scale * viewport.y);
+    float quantisation = 1.0 / (waveform_height - 1.0);
+    float intensity = 0.10;
+    float sum = 0.0;
+    float value = 0.0;
+    float ratio = 0.0;
+
+    // The scope is split into one column each for red, green, and blue, each column is a waveform
+    // of the whole image for that channel
+    float column = floor(ove_texcoord.x * 3.0);
+    float source_x = fract(ove_texcoord.x * 3.0);
+    vec3 channel_mask = vec3(equal(vec3(column), vec3(0.0, 1.0, 2.0)));
+
+    for (int i = 0; i < waveform_height; i++) {
+        ratio = float(i) / float(waveform_height - 1.0);
+        value = dot(texture(
+            ove_maintex,
+            vec2(source_x, ratio)
+        ).rgb, channel_mask);
+
+        sum += (
+            step(ove_texcoord.y - quantisation, value) *
+            step(value, ove_texcoord.y + quantisation) *
+            intensity) +
+            (step(1.0 - quantisation, ove_texcoord.y) *
+            step(1.0 - quantisation, value) * intensity);
+    }
+
+    fragColor = vec4(channel_mask * sum, 1.0);
+}
@@ -0,0 +1,16 @@
+// Premultiplied input texture
+uniform sampler2D ove_maintex;
+
+// Opaque color to composite over
+uniform vec4 ove_background;
+
+// Input texture coordinate
+in vec2 ove_texcoord;
+
+// Output color
+out vec4 fragColor;
+
+void main(void) {
+    vec4 color = texture(ove_maintex, ove_texcoord);
+    fragColor = color + ove_background * (1.0 - color.a);
+}
@@ -6,6 +6,16 @@ uniform float opacity_in;
 uniform bool inner_in;
 uniform vec2 resolution_in;
 
+// Distance field, starts off as tex_in and is replaced with the previous iteration's output
+uniform sampler2D field_in;
+
+// Number of jump flood passes and the step size of the first one in sequence pixels
+uniform int jfa_steps_in;
+uniform float jfa_first_step_in;
+
+// Largest offset the field can store in sequence pixels
+uniform float field_scale_in;
+
 // Standard inputs
 uniform int ove_iteration;
 
@@ -13,7 +23,91 @@ in vec2 ove_texcoord;
 
 out vec4 fragColor;
 
+// Iterations run in this order:
+//  - 0: Mark every pixel the stroke grows from (any alpha for outer, any transparency for inner)
+//  - 1 to jfa_steps_in: Jump flood, each pixel takes the nearest seed any of its 8 neighbors at
+//    the current step size knows of, halving the step each pass
+//  - jfa_steps_in + 1: Composite the stroke from the distance to the nearest seed
+//
+// The field stores the offset from each pixel to its nearest seed in RG and whether it has one
+// in A. Offsets are normalized so they survive integer intermediates.
+
+vec2 texel_count;
+float texel_ratio;
+
+float SeedWeight(vec2 pixel) {
+    vec2 coord = pixel / texel_count;
+
+    if (coord.x < 0.0 || coord.y < 0.0 || coord.x > 1.0 || coord.y > 1.0) {
+        return 0.0;
+    }
+
+    float alpha = texture(tex_in, coord).a;
+
+    return inner_in ? 1.0 - alpha : alpha;
+}
+
+vec4 EncodeOffset(vec2 offset) {
+    return vec4(offset / (2.0 * field_scale_in * texel_ratio) + 0.5, 0.0, 1.0);
+}
+
+vec2 DecodeOffset(vec4 field) {
+    return (field.rg - 0.5) * 2.0 * field_scale_in * texel_ratio;
+}
+
 void main(void) {
+    // Work in physical texels so offsets land exactly on the field's pixels at any divider
+    texel_count = vec2(textureSize(tex_in, 0));
+    texel_ratio = texel_count.x / resolution_in.x;
+
+    vec2 pixel = ove_texcoord * texel_count;
+
+    if (ove_iteration == 0) {
+        fragColor = (SeedWeight(pixel) > 0.0) ? EncodeOffset(vec2(0.0)) : vec4(0.5, 0.5, 0.0, 0.0);
+        return;
+    }
+
+    if (ove_iteration <= jfa_steps_in) {
+        float step = max(1.0, floor(jfa_first_step_in * texel_ratio / exp2(float(ove_iteration - 1))));
+        float max_dist = field_scale_in * texel_ratio;
+
+        vec2 best_offset = vec2(0.0);
+        float best_dist = -1.0;
+
+        for (int y=-1; y<=1; y++) {
+            for (int x=-1; x<=1; x++) {
+                vec2 neighbor = pixel + vec2(float(x), float(y)) * step;
+                vec2 neighbor_coord = neighbor / texel_count;
+
+                if (neighbor_coord.x < 0.0 || neighbor_coord.y < 0.0
+                    || neighbor_coord.x > 1.0 || neighbor_coord.y > 1.0) {
+                    continue;
+                }
+
+                vec4 field = texture(field_in, neighbor_coord);
+
+                if (field.a < 0.5) {
+                    continue;
+                }
+
+                vec2 offset = vec2(float(x), float(y)) * step + DecodeOffset(field);
+                float dist = length(offset);
+
+                // Confirm the seed against the input since pixels outside the region of interest
+                // were never written
+                if (dist <= max_dist
+                    && (best_dist < 0.0 || dist < best_dist)
+                    && SeedWeight(pixel + offset) > 0.0) {
+                    best_offset = offset;
+                    best_dist = dist;
+                }
+            }
+        }
+
+        fragColor = (best_dist < 0.0) ? vec4(0.5, 0.5, 0.0, 0.0) : EncodeOffset(best_offset);
+        return;
+    }
+
     vec4 pixel_here = texture(tex_in, ove_texcoord);
 
     // Detect no-op situations
@@ -26,37 +120,18 @@ void main(void) {
         return;
     }
 
-    float radius = ceil(radius_in);
-
     float stroke_weight = 0.0;
 
-    // Loop over box
-    for (float i=-radius + 0.5; i<=radius; i += 2.0) {
-        float x_coord = i / resolution_in.x;
+    vec4 field = texture(field_in, ove_texcoord);
 
-        for (float j=-radius + 0.5; j<=radius; j += 2.0) {
-            float y_coord = j / resolution_in.y;
-
-            if (abs(length(vec2(i, j))) < radius) {
-                // Get pixel here
-                float alpha = texture(tex_in, ove_texcoord + vec2(x_coord, y_coord)).a;
-
-                if (inner_in) {
-                    alpha = 1.0 - alpha;
-                }
+    if (field.a >= 0.5) {
+        vec2 offset = DecodeOffset(field);
 
-                stroke_weight += alpha;
+        // Partially transparent seeds sit further in, which keeps the stroke's edge antialiased
+        float dist = length(offset) / texel_ratio;
+        float seed_weight = SeedWeight(pixel + offset);
 
-                if (stroke_weight >= 1.0) {
-                    break;
-                }
-            }
-        }
-
-        if (stroke_weight >= 1.0) {
-            stroke_weight = 1.0;
-            break;
-        }
+        stroke_weight = clamp(radius_in + seed_weight - 0.5 - dist, 0.0, 1.0);
     }
 
     stroke_weight *= opacity_in;
@@ -0,0 +1,34 @@
+// Input texture
+uniform sampler2D ove_maintex;
+
+// Number of clip_pos values in use
+uniform int clip_count;
+
+// Input texture coordinate
+in vec2 ove_texcoord;
+
+// Position in the frame of each concatenated transform, anything outside [-1, 1] would've been
+// cut off by that transform's texture
+in vec2 clip_pos0;
+in vec2 clip_pos1;
+in vec2 clip_pos2;
+in vec2 clip_pos3;
+
+// Output color
+out vec4 fragColor;
+
+bool outside(vec2 pos) {
+    return any(greaterThan(abs(pos), vec2(1.0)));
+}
+
+void main() {
+    if ((clip_count > 0 && outside(clip_pos0))
+        || (clip_count > 1 && outside(clip_pos1))
+        || (clip_count > 2 && outside(clip_pos2))
+        || (clip_count > 3 && outside(clip_pos3))) {
+        fragColor = vec4(0.0);
+        return;
+    }
+
+    fragColor = texture(ove_maintex, ove_texcoord);
+}
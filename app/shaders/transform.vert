@@ -0,0 +1,26 @@
+uniform mat4 ove_mvpmat;
+
+// Maps the quad into the frame of each transform that was concatenated into this one
+uniform mat4 clip_mat0;
+uniform mat4 clip_mat1;
+uniform mat4 clip_mat2;
+uniform mat4 clip_mat3;
+
+in vec4 a_position;
+in vec2 a_texcoord;
+
+out vec2 ove_texcoord;
+out vec2 clip_pos0;
+out vec2 clip_pos1;
+out vec2 clip_pos2;
+out vec2 clip_pos3;
+
+void main() {
+    gl_Position = ove_mvpmat * a_position;
+    ove_texcoord = a_texcoord;
+
+    clip_pos0 = (clip_mat0 * a_position).xy;
+    clip_pos1 = (clip_mat1 * a_position).xy;
+    clip_pos2 = (clip_mat2 * a_position).xy;
+    clip_pos3 = (clip_mat3 * a_position).xy;
+}
@@ -0,0 +1,44 @@
+uniform sampler2D ove_maintex;
+
+uniform vec2 viewport;
+uniform vec3 luma_coeffs;
+
+uniform float vectorscope_scale;
+
+// Number of source samples to take horizontally and vertically
+uniform vec2 sample_count;
+
+in vec2 ove_texcoord;
+
+out vec4 fragColor;
+
+void main(void) {
+    // Chroma from -0.5 to 0.5 maps to a square in the center of the viewport
+    float diameter = ceil(vectorscope_scale * min(viewport.x, viewport.y));
+    vec2 chroma = (ove_texcoord - 0.5) * viewport / diameter;
+    float quantisation = 1.0 / diameter;
+    float intensity = 0.25;
+    float sum = 0.0;
+    vec3 cur_col = vec3(0.0);
+    float luma = 0.0;
+    vec2 cbcr = vec2(0.0);
+
+    for (int x = 0; x < sample_count.x; x++) {
+        for (int y = 0; y < sample_count.y; y++) {
+            cur_col = texture(
+                ove_maintex,
+                (vec2(x, y) + 0.5) / sample_count
+            ).rgb;
+
+            luma = dot(cur_col, luma_coeffs);
+            cbcr = vec2((cur_col.b - luma) / (2.0 * (1.0 - luma_coeffs.b)),
+                        (cur_col.r - luma) / (2.0 * (1.0 - luma_coeffs.r)));
+
+            sum += step(abs(cbcr.x - chroma.x), quantisation) *
+                step(abs(cbcr.y - chroma.y), quantisation) *
+                intensity;
+        }
+    }
+
+    fragColor = vec4(vec3(0.4, 1.0, 0.4) * min(sum, 1.0), 1.0);
+}
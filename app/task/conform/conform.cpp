@@ -33,26 +33,28 @@ ConformTask::ConformTask(AudioStream *stream, const AudioParams& params) :
 
 bool ConformTask::Run()
 {
-  // Conforming is done by the renderer now, but I would like to use something like this just to
-  // show progress
-
-  /*if (stream_->footage()->decoder().isEmpty()) {
+  if (stream_->footage()->decoder().isEmpty()) {
     SetError(tr("Failed to find decoder to conform audio stream"));
     return false;
-  } else {
-    DecoderPtr decoder = Decoder::CreateFromID(stream_->footage()->decoder());
+  }
+
+  DecoderPtr decoder = Decoder::CreateFromID(stream_->footage()->decoder());
+
+  if (!decoder || !decoder->Open(stream_)) {
+    SetError(tr("Failed to open decoder"));
+    return false;
+  }
+
+  connect(decoder.get(), &Decoder::IndexProgress, this, &ConformTask::ProgressChanged, Qt::DirectConnection);
 
-    decoder->set_stream(stream_);
+  bool success = decoder->ConformAudio({stream_}, params_, &IsCancelled());
 
-    connect(decoder.get(), &Decoder::IndexProgress, this, &ConformTask::ProgressChanged);
+  decoder->Close();
 
-    if (!decoder->ConformAudio(&IsCancelled(), params_)) {
-      SetError(tr("Failed to conform audio"));
-      return false;
-    } else {
-      return true;
-    }
-  }*/
+  if (!success && !IsCancelled()) {
+    SetError(tr("Failed to conform audio"));
+    return false;
+  }
 
   return true;
 }
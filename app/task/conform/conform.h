@@ -33,6 +33,11 @@ class ConformTask : public Task
 public:
   ConformTask(AudioStream* stream, const AudioParams& params);
 
+  virtual Resource GetResource() const override
+  {
+    return kResourceIO;
+  }
+
 protected:
   virtual bool Run() override;
 
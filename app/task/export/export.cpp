@@ -20,45 +20,94 @@
 
 #include "export.h"
 
+#include <algorithm>
+#include <QDebug>
+#include <QDir>
+#include <QTemporaryDir>
+
+#include "codec/decoder.h"
+#include "codec/ffmpeg/ffmpegencoder.h"
+#include "codec/ffmpeg/ffmpegkeyframeindex.h"
 #include "common/timecodefunctions.h"
+#include "config/config.h"
+#include "node/block/clip/clip.h"
+#include "node/input/media/media.h"
+#include "node/output/track/track.h"
 #include "render/colormanager.h"
+#include "render/diskmanager.h"
+#include "render/framepack.h"
+#include "renderfarmjob.h"
 
 namespace olive {
 
+namespace {
+
+qint64 GetSampleBufferSize(const SampleBufferPtr& samples)
+{
+  if (!samples) {
+    return 0;
+  }
+
+  return static_cast<qint64>(samples->sample_count()) * samples->audio_params().channel_count() * static_cast<qint64>(sizeof(float));
+}
+
+}
+
 ExportTask::ExportTask(ViewerOutput* viewer_node,
                        ColorManager* color_manager,
                        const ExportParams& params) :
   RenderTask(viewer_node, params.video_params(), params.audio_params()),
+  Consumer(tr("Export Reorder Buffer"), MemoryGovernor::kPriorityWorking),
+  reorder_video_bytes_(0),
+  reorder_audio_bytes_(0),
   color_manager_(color_manager),
-  params_(params)
+  params_(params),
+  encoder_(nullptr),
+  two_pass_pack_(nullptr),
+  frame_time_(0),
+  write_failed_(false),
+  audio_encoder_(nullptr)
 {
   SetTitle(tr("Exporting \"%1\"").arg(viewer_node->media_name()));
+
+  MemoryGovernor::Register(this);
 }
 
-bool ExportTask::Run()
+ExportTask::~ExportTask()
 {
-  TimeRange range;
+  MemoryGovernor::Unregister(this);
+}
 
-  // For safety, if we're overwriting, we save to a temporary filename and then only overwrite it
-  // at the end
-  QString real_filename = params_.filename();
-  if (QFileInfo::exists(params_.filename())) {
-    // Generate a filename that definitely doesn't exist
-    params_.SetFilename(FileFunctions::GetSafeTemporaryFilename(real_filename));
-  }
+qint64 ExportTask::GetMemoryUsage() const
+{
+  return reorder_video_bytes_.loadAcquire() + reorder_audio_bytes_.loadAcquire();
+}
 
-  encoder_ = Encoder::CreateFromID(params_.encoder(), params_);
+bool ExportTask::ReleaseMemory(qint64 bytes)
+{
+  Q_UNUSED(bytes)
 
-  if (!encoder_) {
-    SetError(tr("Failed to create encoder"));
-    return false;
-  }
+  return false;
+}
 
-  if (!encoder_->Open()) {
-    SetError(tr("Failed to open file"));
-    encoder_->deleteLater();
-    return false;
-  }
+const int ExportTask::kMinimumSegmentFrames = 120;
+const int ExportTask::kRenderFarmChunkFrames = 240;
+const int ExportTask::kRenderFarmPollInterval = 1000;
+
+void ExportTask::SetRenderFarm(const QString &farm_path, const QString &project_filename)
+{
+  farm_path_ = farm_path;
+  farm_project_ = project_filename;
+}
+
+void ExportTask::AddOutput(const ExportParams &params)
+{
+  extra_outputs_.append(params);
+}
+
+bool ExportTask::Run()
+{
+  TimeRange range;
 
   if (params_.has_custom_range()) {
     // Render custom range only
@@ -68,8 +117,6 @@ bool ExportTask::Run()
     range = TimeRange(0, viewer()->GetLength());
   }
 
-  frame_time_ = 0;
-
   QSize video_force_size;
   QMatrix4x4 video_force_matrix;
 
@@ -96,12 +143,68 @@ bool ExportTask::Run()
     color_processor_ = ColorProcessor::Create(color_manager_,
                                               color_manager_->GetReferenceColorSpace(),
                                               params_.color_transform());
+
+    ChooseRenderPrecision();
+
+    // Frames the preview has already cached at exactly these parameters don't need rendering again
+    if (video_force_size.isNull() && CanReusePreviewCache(viewer())) {
+      SetReuseCache(viewer()->video_frame_cache());
+    }
   }
 
-  if (params_.audio_enabled()) {
-    audio_data_.SetParameters(audio_params());
+  if (!extra_outputs_.isEmpty()) {
+    return RunMultiple(range, video_force_size, video_force_matrix);
+  }
+
+  // For safety, if we're overwriting, we save to a temporary filename and then only overwrite it
+  // at the end
+  QString real_filename = params_.filename();
+
+  if (!farm_path_.isEmpty() && params_.video_enabled()) {
+    return RunDistributed(range, real_filename);
+  }
+
+  if (params_.video_enabled() && params_.video_two_pass() && params_.encoder() == QStringLiteral("ffmpeg")) {
+    return RunTwoPass(range, real_filename, video_force_size, video_force_matrix);
+  }
+
+  QVector<CopyRange> copies = GetCopyableRanges(range);
+
+  if (!copies.isEmpty()) {
+    return RunSmart(range, real_filename, copies, video_force_size, video_force_matrix);
+  }
+
+  int segment_count = GetSegmentCount(Timecode::time_to_timestamp(range.length(), video_params().time_base()));
+
+  if (segment_count > 1) {
+    return RunSegmented(range, real_filename, segment_count, video_force_size, video_force_matrix);
+  }
+
+  // Image encoders write each file to a temporary name themselves, and a sequence never writes to
+  // this exact filename anyway
+  if (params_.encoder() != QStringLiteral("oiio") && QFileInfo::exists(params_.filename())) {
+    // Generate a filename that definitely doesn't exist
+    params_.SetFilename(FileFunctions::GetSafeTemporaryFilename(real_filename));
+  }
+
+  encoder_ = Encoder::CreateFromID(params_.encoder(), params_);
+
+  if (!encoder_) {
+    SetError(tr("Failed to create encoder"));
+    return false;
+  }
+
+  if (!encoder_->Open()) {
+    SetError(tr("Failed to open file"));
+    encoder_->deleteLater();
+    return false;
   }
 
+  frame_time_ = 0;
+  write_failed_ = false;
+  audio_encoder_ = encoder_;
+  audio_time_ = 0;
+
   // Start render process
   TimeRangeList video_range, audio_range;
 
@@ -111,7 +214,6 @@ bool ExportTask::Run()
 
   if (params_.audio_enabled()) {
     audio_range = {range};
-    audio_data_.SetLength(range.length());
   }
 
   Render(color_manager_, video_range, audio_range, RenderMode::kOnline, nullptr,
@@ -120,15 +222,21 @@ bool ExportTask::Run()
 
   bool success = true;
 
-  if (params_.audio_enabled()) {
-    // Write audio data now
-    encoder_->WriteAudio(audio_params(), audio_data_.CreatePlaybackDevice(encoder_));
-  }
+  // Audio is held back so it doesn't get ahead of video in the file, write whatever's left now
+  WritePendingAudio(false);
+  audio_map_.clear();
+  reorder_audio_bytes_.storeRelease(0);
+  audio_encoder_ = nullptr;
 
   encoder_->Close();
 
   delete encoder_;
 
+  if (write_failed_) {
+    SetError(tr("Failed to write \"%1\"").arg(real_filename));
+    success = false;
+  }
+
   // If cancelled, delete the file we made, which is always a file we created since we write to a
   // temp file during the actual encoding process
   if (IsCancelled()) {
@@ -145,48 +253,1402 @@ bool ExportTask::Run()
   return success;
 }
 
-void ExportTask::FrameDownloaded(FramePtr f, const QByteArray &hash, const QVector<rational> &times, qint64 job_time)
+bool ExportTask::RunMultiple(const TimeRange &range, const QSize &force_size, const QMatrix4x4 &force_matrix)
 {
-  Q_UNUSED(job_time)
-  Q_UNUSED(hash)
+  QVector<ExportParams> outputs = extra_outputs_;
+  outputs.prepend(params_);
 
-  foreach (const rational& t, times) {
-    rational actual_time = t;
+  const rational& timebase = video_params().time_base();
+  bool any_video = false;
+  bool any_audio = false;
 
-    if (params_.has_custom_range()) {
-      actual_time -= params_.custom_range().in();
+  foreach (const ExportParams& p, outputs) {
+    if (p.video_enabled()) {
+      // Frames are rendered at the first output's resolution and frame rate
+      if (!params_.video_enabled() || p.video_params().time_base() != timebase) {
+        SetError(tr("Every output of an export must have the same frame rate"));
+        return false;
+      }
+
+      if (p.encoder() != QStringLiteral("ffmpeg")
+          && (p.video_params().width() != params_.video_params().width()
+              || p.video_params().height() != params_.video_params().height())) {
+        SetError(tr("\"%1\" can't be exported at a different resolution to the first output").arg(p.filename()));
+        return false;
+      }
+
+      any_video = true;
     }
 
-    time_map_.insert(actual_time, f);
+    if (p.audio_enabled()) {
+      any_audio = true;
+    }
   }
 
-  forever {
-    rational real_time = Timecode::timestamp_to_time(frame_time_,
-                                                     viewer()->video_params().time_base());
+  int64_t frame_count = Timecode::time_to_timestamp(range.length(), timebase);
 
-    if (!time_map_.contains(real_time)) {
+  QStringList real_filenames;
+  QStringList filenames;
+  bool success = true;
+
+  foreach (const ExportParams& p, outputs) {
+    ExportParams output_params = p;
+
+    // Like a single export, overwrite existing files only once this one is done
+    if (output_params.encoder() != QStringLiteral("oiio") && QFileInfo::exists(output_params.filename())) {
+      output_params.SetFilename(FileFunctions::GetSafeTemporaryFilename(p.filename()));
+    }
+
+    Encoder* encoder = Encoder::CreateFromID(output_params.encoder(), output_params);
+
+    if (!encoder || !encoder->Open()) {
+      SetError(tr("Failed to open \"%1\"").arg(p.filename()));
+      delete encoder;
+      success = false;
       break;
     }
 
-    // Unfortunately this can't be done in another thread since the frames need to be sent
-    // one after the other chronologically.
-    encoder_->WriteFrame(time_map_.take(real_time), real_time);
+    // Frames arrive in the reference space so each output converts to its own
+    ColorProcessorPtr color_processor;
 
-    frame_time_++;
+    if (output_params.video_enabled()) {
+      color_processor = ColorProcessor::Create(color_manager_,
+                                               color_manager_->GetReferenceColorSpace(),
+                                               output_params.color_transform());
+    }
+
+    outputs_.append(new OutputWriter(encoder, color_processor,
+                                     output_params.video_enabled() ? frame_count : 0, timebase));
+    real_filenames.append(p.filename());
+    filenames.append(output_params.filename());
+  }
+
+  if (success) {
+    foreach (OutputWriter* writer, outputs_) {
+      writer->start();
+    }
+
+    TimeRangeList video_range, audio_range;
+
+    if (any_video) {
+      video_range = {range};
+    }
+
+    if (any_audio) {
+      audio_range = {range};
+    }
+
+    audio_time_ = 0;
+
+    // Full float keeps the precision every output's color conversion needs
+    Render(color_manager_, video_range, audio_range, RenderMode::kOnline, nullptr,
+           force_size, force_matrix, VideoParams::kFormatFloat32, nullptr);
+
+    WritePendingAudio(false);
+    audio_map_.clear();
+    reorder_audio_bytes_.storeRelease(0);
+
+    success = !IsCancelled();
+  }
+
+  foreach (OutputWriter* writer, outputs_) {
+    if (success) {
+      writer->Finish();
+    } else {
+      writer->Cancel();
+    }
+
+    writer->wait();
+
+    if (writer->HasFailed()) {
+      SetError(tr("Failed to write \"%1\"").arg(real_filenames.at(outputs_.indexOf(writer))));
+      success = false;
+    }
+  }
+
+  qDeleteAll(outputs_);
+  outputs_.clear();
+
+  if (!success) {
+    // Cancelling isn't a failure, but either way nothing half-written is kept
+    foreach (const QString& fn, filenames) {
+      QFile::remove(fn);
+    }
+
+    return IsCancelled();
+  }
+
+  for (int i=0; i<filenames.size(); i++) {
+    if (filenames.at(i) != real_filenames.at(i)
+        && !FileFunctions::RenameFileAllowOverwrite(filenames.at(i), real_filenames.at(i))) {
+      SetError(tr("Failed to overwrite \"%1\". Export has been saved as \"%2\" instead.")
+               .arg(real_filenames.at(i), filenames.at(i)));
+      success = false;
+    }
   }
+
+  return success;
 }
 
-void ExportTask::AudioDownloaded(const TimeRange &range, SampleBufferPtr samples, qint64 job_time)
+bool ExportTask::RunSegmented(const TimeRange &range, const QString &real_filename, int segment_count,
+                              const QSize &force_size, const QMatrix4x4 &force_matrix)
 {
-  Q_UNUSED(job_time)
+  const rational& timebase = video_params().time_base();
+  int64_t frame_count = Timecode::time_to_timestamp(range.length(), timebase);
 
-  TimeRange adjusted_range = range;
+  int64_t segment_length = (frame_count + segment_count - 1) / segment_count;
 
-  if (params_.has_custom_range()) {
-    adjusted_range -= params_.custom_range().in();
+  // Segments must start on a keyframe, so if the user asked for a fixed GOP, keep to it
+  int gop_size = params_.video_opts().value(QStringLiteral("g")).toInt();
+  if (gop_size > 0) {
+    segment_length = ((segment_length + gop_size - 1) / gop_size) * gop_size;
+  }
+
+  QVector<TimeRange> segment_ranges;
+
+  for (int64_t start=0; start<frame_count; start+=segment_length) {
+    int64_t end = qMin(start + segment_length, frame_count);
+
+    segment_ranges.append(TimeRange(range.in() + Timecode::timestamp_to_time(start, timebase),
+                                    range.in() + Timecode::timestamp_to_time(end, timebase)));
+  }
+
+  TimeRangeList audio_range;
+  QString audio_filename;
+
+  if (params_.audio_enabled()) {
+    if (!OpenAudioEncoder(real_filename, &audio_filename)) {
+      SetError(tr("Failed to open file"));
+      return false;
+    }
+
+    audio_range = {range};
+  }
+
+  QMap<rational, QString> segment_files;
+
+  bool success = EncodeSegments(segment_ranges, range, audio_range, real_filename,
+                                force_size, force_matrix, &segment_files);
+
+  CloseAudioEncoder();
+
+  if (!success) {
+    if (!audio_filename.isEmpty()) {
+      QFile::remove(audio_filename);
+    }
+    return false;
+  }
+
+  return JoinSegments(segment_files.values(), segment_files.keys().toVector(),
+                      audio_filename, real_filename, !IsCancelled());
+}
+
+bool ExportTask::RunTwoPass(const TimeRange &range, const QString &real_filename,
+                            const QSize &force_size, const QMatrix4x4 &force_matrix)
+{
+  // Frames are only rendered once. The first pass analyzes them as they arrive, and they're kept
+  // in a temporary pack in the disk cache for the second pass to stream back from.
+  QTemporaryDir temp_dir(QDir(DiskManager::instance()->GetDefaultCachePath()).filePath(QStringLiteral("twopass-XXXXXX")));
+
+  if (!temp_dir.isValid()) {
+    SetError(tr("Failed to create temporary files in the disk cache"));
+    return false;
+  }
+
+  QString stats_prefix = QDir(temp_dir.path()).filePath(QStringLiteral("stats"));
+
+  EncodingParams first_pass_params = params_;
+  first_pass_params.DisableAudio();
+
+  encoder_ = Encoder::CreateFromID(params_.encoder(), first_pass_params);
+
+  if (!encoder_ || !encoder_->SetPass(1, stats_prefix) || !encoder_->Open()) {
+    SetError(tr("Failed to open encoder"));
+    delete encoder_;
+    encoder_ = nullptr;
+    return false;
+  }
+
+  TimeRangeList audio_range;
+  QString audio_filename;
+
+  // Audio is encoded once alongside the first pass and interleaved with the second pass's video
+  if (params_.audio_enabled()) {
+    if (!OpenAudioEncoder(real_filename, &audio_filename)) {
+      SetError(tr("Failed to open file"));
+      delete encoder_;
+      encoder_ = nullptr;
+      return false;
+    }
+
+    audio_range = {range};
+  }
+
+  two_pass_pack_ = FramePack::Get(temp_dir.path());
+  two_pass_pack_->SetEncoding(FramePack::kEncodingZlib);
+
+  frame_time_ = 0;
+  write_failed_ = false;
+
+  Render(color_manager_, {range}, audio_range, RenderMode::kOnline, nullptr,
+         force_size, force_matrix, encoder_->GetDesiredPixelFormat(),
+         color_processor_);
+
+  CloseAudioEncoder();
+
+  encoder_->Close();
+  delete encoder_;
+  encoder_ = nullptr;
+
+  QStringList video_filenames;
+  bool success = !write_failed_;
+
+  if (success && !IsCancelled()) {
+    emit StatusChanged(tr("Encoding second pass"));
+
+    QString video_filename = FileFunctions::GetSafeTemporaryFilename(real_filename);
+    video_filenames.append(video_filename);
+
+    EncodingParams second_pass_params = params_;
+    second_pass_params.SetFilename(video_filename);
+    second_pass_params.DisableAudio();
+
+    Encoder* encoder = Encoder::CreateFromID(params_.encoder(), second_pass_params);
+
+    success = encoder && encoder->SetPass(2, stats_prefix) && encoder->Open();
+
+    const rational& timebase = viewer()->video_params().time_base();
+    int64_t frame_count = frame_time_;
+
+    for (int64_t i=0; success && i<frame_count && !IsCancelled(); i++) {
+      WaitIfPaused();
+
+      QByteArray key = QByteArray::number(qlonglong(i));
+      FramePtr frame = two_pass_pack_->Read(key);
+
+      // Give the disk space back as we go
+      two_pass_pack_->Remove(key);
+
+      if (frame && !encoder->WriteFrame(frame, Timecode::timestamp_to_time(i, timebase))) {
+        success = false;
+      }
+
+      emit ProgressChanged(double(i + 1) / double(frame_count));
+    }
+
+    if (encoder) {
+      encoder->Close();
+      delete encoder;
+    }
+  }
+
+  // The temporary folder takes the pack's files with it
+  FramePack::Close(temp_dir.path());
+  two_pass_pack_ = nullptr;
+
+  return JoinSegments(video_filenames, QVector<rational>(video_filenames.size(), rational(0)),
+                      audio_filename, real_filename, success && !IsCancelled());
+}
+
+bool ExportTask::RunSmart(const TimeRange &range, const QString &real_filename, const QVector<CopyRange> &copies,
+                          const QSize &force_size, const QMatrix4x4 &force_matrix)
+{
+  const rational& timebase = video_params().time_base();
+
+  QMap<rational, QString> segment_files;
+  QVector<TimeRange> copied_ranges;
+  TimeRangeList render_range = {range};
+
+  // Copying is only demuxing and muxing so it's quick to get out of the way first, we'll know
+  // exactly what's left to encode afterwards
+  foreach (const CopyRange& copy, copies) {
+    if (IsCancelled()) {
+      break;
+    }
+
+    QString copy_filename = FileFunctions::GetSafeTemporaryFilename(real_filename);
+
+    if (FFmpegEncoder::CopyStreamRange(copy.stream->footage()->filename(), copy.stream->index(),
+                                       copy.start_pts, copy.end_pts,
+                                       Timecode::time_to_timestamp(copy.range.length(), timebase),
+                                       copy_filename)) {
+      segment_files.insert(copy.range.in() - range.in(), copy_filename);
+      copied_ranges.append(copy.range);
+      render_range.remove(copy.range);
+    } else {
+      QFile::remove(copy_filename);
+    }
+  }
+
+  TimeRangeList audio_range;
+  QString audio_filename;
+
+  if (params_.audio_enabled()) {
+    if (!OpenAudioEncoder(real_filename, &audio_filename)) {
+      SetError(tr("Failed to open file"));
+
+      foreach (const QString& fn, segment_files) {
+        QFile::remove(fn);
+      }
+      return false;
+    }
+
+    audio_range = {range};
+  }
+
+  bool success = EncodeSegments(render_range.internal_array(), range, audio_range, real_filename,
+                                force_size, force_matrix, &segment_files);
+
+  CloseAudioEncoder();
+
+  if (success && !IsCancelled() && !copied_ranges.isEmpty()
+      && !FFmpegEncoder::CanConcatenateSegments(segment_files.values())) {
+    // The encoder didn't produce a stream the copies can be spliced into, so encode them too
+    qWarning() << "Copied clips aren't compatible with the encoded video, rendering them instead";
+
+    foreach (const TimeRange& r, copied_ranges) {
+      QFile::remove(segment_files.take(r.in() - range.in()));
+    }
+
+    success = EncodeSegments(copied_ranges, range, TimeRangeList(), real_filename,
+                             force_size, force_matrix, &segment_files);
+  }
+
+  if (!success) {
+    foreach (const QString& fn, segment_files) {
+      QFile::remove(fn);
+    }
+
+    if (!audio_filename.isEmpty()) {
+      QFile::remove(audio_filename);
+    }
+
+    return false;
+  }
+
+  return JoinSegments(segment_files.values(), segment_files.keys().toVector(),
+                      audio_filename, real_filename, !IsCancelled());
+}
+
+bool ExportTask::CanReducePrecision(ViewerOutput *viewer, int target_bit_depth)
+{
+  if (target_bit_depth <= 0 || target_bit_depth > 10) {
+    return false;
+  }
+
+  foreach (Node* n, viewer->GetDependencies()) {
+    if (n->IsPrecisionSensitive()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool ExportTask::CanReusePreviewCache(ViewerOutput *viewer)
+{
+  // The preview renders offline at this precision, anything less than accurate differs from online
+  if (Config::Current()[QStringLiteral("PreviewPrecision")].toInt() != RenderMode::kPrecisionAccurate) {
+    return false;
+  }
+
+  // Offline renders use proxies where they exist, which the hash doesn't tell apart
+  foreach (Node* n, viewer->GetDependencies()) {
+    if (n->IsMedia()) {
+      Stream* stream = static_cast<MediaInput*>(n)->stream();
+
+      if (stream && stream->type() == Stream::kVideo && static_cast<VideoStream*>(stream)->has_proxy()) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+void ExportTask::ChooseRenderPrecision()
+{
+  if (!params_.auto_precision() || video_params().format() != VideoParams::kFormatFloat32) {
+    return;
+  }
+
+  // Every output is encoded from the same frames, so the deepest one decides
+  int depth = GetTargetBitDepth(params_);
+
+  foreach (const ExportParams& p, extra_outputs_) {
+    if (p.video_enabled()) {
+      int output_depth = GetTargetBitDepth(p);
+
+      if (output_depth == 0) {
+        return;
+      }
+
+      depth = qMax(depth, output_depth);
+    }
+  }
+
+  if (CanReducePrecision(viewer(), depth)) {
+    qInfo() << "Rendering export at half float for a" << depth << "bit output";
+    SetVideoFormat(VideoParams::kFormatFloat16);
+  }
+}
+
+int ExportTask::GetTargetBitDepth(const ExportParams &params)
+{
+  // Encoders work the depth out from their parameters alone, so this one never has to be opened
+  Encoder* encoder = Encoder::CreateFromID(params.encoder(), params);
+
+  if (!encoder) {
+    return 0;
+  }
+
+  int depth = encoder->GetTargetBitDepth();
+
+  delete encoder;
+
+  return depth;
+}
+
+QVector<ExportTask::CopyRange> ExportTask::GetCopyableRanges(const TimeRange &range) const
+{
+  QVector<CopyRange> copies;
+
+  // Copies are joined with encoded segments by remuxing with FFmpeg
+  if (!params_.smart_render()
+      || !params_.video_enabled()
+      || params_.encoder() != QStringLiteral("ffmpeg")
+      || params_.color_transform().is_display()) {
+    return copies;
+  }
+
+  // Copied frames never pass through the renderer, so the sequence itself can't alter them either
+  const VideoParams& sequence_params = viewer()->video_params();
+
+  if (sequence_params.width() != params_.video_params().width()
+      || sequence_params.height() != params_.video_params().height()
+      || sequence_params.time_base() != params_.video_params().time_base()) {
+    return copies;
+  }
+
+  // Anything composited over the track would be lost
+  Node* connected = viewer()->texture_input()->get_connected_node();
+
+  if (!connected || !connected->IsTrack()) {
+    return copies;
+  }
+
+  TrackOutput* track = static_cast<TrackOutput*>(connected);
+
+  if (track->IsMuted()) {
+    return copies;
+  }
+
+  const rational& timebase = params_.video_params().time_base();
+
+  foreach (Block* block, track->Blocks()) {
+    if (block->type() != Block::kClip
+        || !block->is_enabled()
+        || block->speed_input()->is_connected()
+        || block->speed_input()->is_keyframing()
+        || !qFuzzyCompare(block->speed_input()->get_standard_value().toDouble(), 1.0)
+        || block->media_in_input()->is_connected()
+        || block->media_in_input()->is_keyframing()) {
+      continue;
+    }
+
+    TimeRange clip_range = range.Intersected(TimeRange(block->in(), block->out()));
+
+    if (Timecode::time_to_timestamp(clip_range.length(), timebase) < kMinimumSegmentFrames) {
+      continue;
+    }
+
+    // The clip has to be the footage with nothing (e.g. effects) in between
+    Node* source = static_cast<ClipBlock*>(block)->texture_input()->get_connected_node();
+
+    if (!source || !source->IsMedia()) {
+      continue;
+    }
+
+    Stream* stream = static_cast<MediaInput*>(source)->stream();
+
+    if (!stream
+        || stream->type() != Stream::kVideo
+        || stream->footage()->decoder() != QStringLiteral("ffmpeg")) {
+      continue;
+    }
+
+    VideoStream* video_stream = static_cast<VideoStream*>(stream);
+
+    if (video_stream->video_type() != VideoStream::kVideoTypeVideo
+        || video_stream->pixel_aspect_ratio() != params_.video_params().pixel_aspect_ratio()
+        || video_stream->interlacing() != params_.video_params().interlacing()
+        || video_stream->colorspace() != params_.color_transform().output()
+        || !FFmpegEncoder::CanCopyStream(stream->footage()->filename(), stream->index(), params_)) {
+      continue;
+    }
+
+    FFmpegKeyframeIndex index;
+    QString index_fn = Decoder::GetCacheFilename(stream).append(QStringLiteral(".keyframes"));
+
+    if (!index.Load(index_fn)
+        && !index.Build(stream->footage()->filename().toUtf8(), stream->index(), nullptr, [](int64_t){})) {
+      continue;
+    }
+
+    // Sequence time plus this is media time
+    rational media_offset = block->media_in() - block->in();
+
+    int64_t media_start = video_stream->get_time_in_timebase_units(clip_range.in() + media_offset);
+    int64_t media_end = video_stream->get_time_in_timebase_units(clip_range.out() + media_offset);
+
+    // Only whole GOPs are copied, from the first keyframe in the clip to the last one
+    const QVector<FFmpegKeyframeIndex::Keyframe>& keyframes = index.keyframes();
+    int64_t start_pts = AV_NOPTS_VALUE;
+    int64_t end_pts = AV_NOPTS_VALUE;
+
+    foreach (const FFmpegKeyframeIndex::Keyframe& k, keyframes) {
+      if (k.pts < media_start) {
+        continue;
+      }
+
+      if (k.pts > media_end) {
+        break;
+      }
+
+      if (start_pts == AV_NOPTS_VALUE) {
+        start_pts = k.pts;
+      } else {
+        end_pts = k.pts;
+      }
+    }
+
+    if (start_pts == AV_NOPTS_VALUE || end_pts == AV_NOPTS_VALUE) {
+      continue;
+    }
+
+    TimeRange copy_range(Timecode::timestamp_to_time(start_pts - video_stream->start_time(), video_stream->timebase()) - media_offset,
+                         Timecode::timestamp_to_time(end_pts - video_stream->start_time(), video_stream->timebase()) - media_offset);
+
+    // Keyframes between frames of the sequence can't be cut at
+    if (Timecode::timestamp_to_time(Timecode::time_to_timestamp(copy_range.in(), timebase), timebase) != copy_range.in()
+        || Timecode::timestamp_to_time(Timecode::time_to_timestamp(copy_range.out(), timebase), timebase) != copy_range.out()
+        || Timecode::time_to_timestamp(copy_range.length(), timebase) < kMinimumSegmentFrames) {
+      continue;
+    }
+
+    copies.append({copy_range, video_stream, start_pts, end_pts});
+  }
+
+  return copies;
+}
+
+bool ExportTask::EncodeSegments(const QVector<TimeRange> &ranges, const TimeRange &range, const TimeRangeList &audio_range,
+                                const QString &real_filename, const QSize &force_size, const QMatrix4x4 &force_matrix,
+                                QMap<rational, QString> *filenames)
+{
+  const rational& timebase = video_params().time_base();
+
+  QStringList segment_filenames;
+  TimeRangeList video_range;
+
+  foreach (const TimeRange& r, ranges) {
+    int64_t length = Timecode::time_to_timestamp(r.length(), timebase);
+
+    // Each encoder creates its file on Open(), so consecutive calls return unique names
+    QString segment_filename = FileFunctions::GetSafeTemporaryFilename(real_filename);
+
+    EncodingParams segment_params = params_;
+    segment_params.SetFilename(segment_filename);
+    segment_params.DisableAudio();
+    segment_params.SetExportLength(r.length());
+
+    Encoder* encoder = Encoder::CreateFromID(params_.encoder(), segment_params);
+
+    if (!encoder || !encoder->Open()) {
+      SetError(tr("Failed to open file"));
+      delete encoder;
+      ClearSegments();
+
+      foreach (const QString& fn, segment_filenames) {
+        QFile::remove(fn);
+      }
+      return false;
+    }
+
+    segments_.append(new SegmentWriter(encoder, length, timebase));
+    segment_starts_.append(Timecode::time_to_timestamp(r.in() - range.in(), timebase));
+    segment_filenames.append(segment_filename);
+    video_range.insert(r);
+  }
+
+  foreach (SegmentWriter* writer, segments_) {
+    writer->start();
+  }
+
+  Render(color_manager_, video_range, audio_range, RenderMode::kOnline, nullptr,
+         force_size, force_matrix,
+         segments_.isEmpty() ? VideoParams::kFormatInvalid : segments_.first()->encoder()->GetDesiredPixelFormat(),
+         color_processor_);
+
+  bool success = !IsCancelled();
+
+  foreach (SegmentWriter* writer, segments_) {
+    if (success) {
+      writer->Finish();
+    } else {
+      writer->Cancel();
+    }
+
+    writer->wait();
+
+    if (writer->HasFailed()) {
+      success = false;
+    }
+  }
+
+  ClearSegments();
+
+  if (!success && !IsCancelled()) {
+    SetError(tr("Failed to write \"%1\"").arg(real_filename));
+
+    foreach (const QString& fn, segment_filenames) {
+      QFile::remove(fn);
+    }
+    return false;
+  }
+
+  for (int i=0; i<ranges.size(); i++) {
+    filenames->insert(ranges.at(i).in() - range.in(), segment_filenames.at(i));
+  }
+
+  return true;
+}
+
+bool ExportTask::RunDistributed(const TimeRange &range, const QString &real_filename)
+{
+  const rational& timebase = video_params().time_base();
+
+  // Chunks must start on a keyframe, so if the user asked for a fixed GOP, keep to it
+  int64_t chunk_length = kRenderFarmChunkFrames;
+  int gop_size = params_.video_opts().value(QStringLiteral("g")).toInt();
+  if (gop_size > 0) {
+    chunk_length = ((chunk_length + gop_size - 1) / gop_size) * gop_size;
+  }
+
+  ExportParams job_params = params_;
+  job_params.set_custom_range(range);
+  job_params.DisableAudio();
+
+  RenderFarmJob job(RenderFarmJob::GenerateJobPath(farm_path_));
+
+  if (!job.Publish(farm_project_, viewer()->media_name(), job_params, chunk_length)) {
+    SetError(tr("Failed to create a render farm job in \"%1\"").arg(farm_path_));
+    job.Remove();
+    return false;
+  }
+
+  // Workers start on the video straight away, audio is cheap enough to render here in the meantime
+  QString audio_filename;
+
+  if (params_.audio_enabled()) {
+    if (!OpenAudioEncoder(real_filename, &audio_filename)) {
+      SetError(tr("Failed to open file"));
+      job.Cancel();
+      job.Remove();
+      return false;
+    }
+
+    Render(color_manager_, TimeRangeList(), {range}, RenderMode::kOnline, nullptr);
+
+    CloseAudioEncoder();
+  }
+
+  int64_t total_frames = qMax(Timecode::time_to_timestamp(range.length(), timebase), int64_t(1));
+  bool success = true;
+
+  while (!IsCancelled()) {
+    struct HostStats {
+      int64_t frames;
+      qint64 elapsed;
+      bool rendering;
+    };
+
+    QMap<QString, HostStats> hosts;
+    int64_t frames_done = 0;
+    int chunks_done = 0;
+
+    for (int i=0; i<job.chunk_count(); i++) {
+      int64_t chunk_frames = Timecode::time_to_timestamp(job.GetChunkRange(i).length(), timebase);
+      QString host;
+
+      if (job.IsChunkDone(i)) {
+        qint64 elapsed;
+
+        if (job.ReadChunkResult(i, &host, &elapsed)) {
+          HostStats& stats = hosts[host];
+          stats.frames += chunk_frames;
+          stats.elapsed += elapsed;
+        }
+
+        frames_done += chunk_frames;
+        chunks_done++;
+        continue;
+      }
+
+      QString error;
+      if (job.GetChunkFailures(i, &error) >= RenderFarmJob::kMaximumAttempts) {
+        SetError(tr("Frames %1 to %2 failed to render on the render farm: %3")
+                 .arg(QString::number(Timecode::time_to_timestamp(job.GetChunkRange(i).in(), timebase)),
+                      QString::number(Timecode::time_to_timestamp(job.GetChunkRange(i).out(), timebase)),
+                      error));
+        success = false;
+        break;
+      }
+
+      int64_t progress;
+      qint64 age;
+
+      if (job.ReadChunkProgress(i, &host, &progress, &age)) {
+        if (age > RenderFarmJob::kProgressTimeout) {
+          // The worker has gone quiet, let another one have it
+          qWarning() << "Render farm worker" << host << "stopped responding, retrying chunk" << i;
+          job.MarkChunkFailed(i, tr("Worker stopped responding"));
+          job.ReleaseClaim(i);
+        } else {
+          hosts[host].rendering = true;
+          frames_done += qMin(progress, chunk_frames);
+        }
+      }
+    }
+
+    if (!success) {
+      break;
+    }
+
+    QStringList status;
+    for (auto it=hosts.constBegin(); it!=hosts.constEnd(); it++) {
+      QString host_status = it.key();
+
+      if (it.value().elapsed > 0) {
+        host_status.append(tr(": %1 fps").arg(QString::number(it.value().frames * 1000.0 / it.value().elapsed, 'f', 1)));
+      }
+
+      if (it.value().rendering) {
+        host_status.append(tr(" (rendering)"));
+      }
+
+      status.append(host_status);
+    }
+
+    emit StatusChanged(tr("Render farm: %1").arg(status.isEmpty() ? tr("waiting for workers") : status.join(QStringLiteral(", "))));
+    emit ProgressChanged(static_cast<double>(frames_done) / static_cast<double>(total_frames));
+
+    if (chunks_done == job.chunk_count()) {
+      break;
+    }
+
+    QThread::msleep(kRenderFarmPollInterval);
+  }
+
+  if (IsCancelled() || !success) {
+    job.Cancel();
+    job.Remove();
+
+    if (!audio_filename.isEmpty()) {
+      QFile::remove(audio_filename);
+    }
+
+    // Cancelling isn't a failure
+    return success;
+  }
+
+  QStringList segment_filenames;
+  QVector<rational> segment_starts;
+
+  for (int i=0; i<job.chunk_count(); i++) {
+    segment_filenames.append(job.GetChunkFilename(i));
+    segment_starts.append(job.GetChunkRange(i).in() - range.in());
+  }
+
+  success = JoinSegments(segment_filenames, segment_starts, audio_filename, real_filename, true);
+
+  job.Remove();
+
+  return success;
+}
+
+bool ExportTask::OpenAudioEncoder(const QString &real_filename, QString *audio_filename)
+{
+  // Audio is encoded into its own file as it arrives and interleaved when the segments are joined
+  *audio_filename = FileFunctions::GetSafeTemporaryFilename(real_filename);
+
+  EncodingParams audio_encoding_params = params_;
+  audio_encoding_params.SetFilename(*audio_filename);
+  audio_encoding_params.DisableVideo();
+
+  audio_encoder_ = Encoder::CreateFromID(params_.encoder(), audio_encoding_params);
+  audio_time_ = 0;
+
+  if (!audio_encoder_ || !audio_encoder_->Open()) {
+    delete audio_encoder_;
+    audio_encoder_ = nullptr;
+    QFile::remove(*audio_filename);
+    return false;
+  }
+
+  return true;
+}
+
+void ExportTask::CloseAudioEncoder()
+{
+  if (!audio_encoder_) {
+    return;
+  }
+
+  WritePendingAudio(false);
+  audio_map_.clear();
+  reorder_audio_bytes_.storeRelease(0);
+
+  audio_encoder_->Close();
+  delete audio_encoder_;
+  audio_encoder_ = nullptr;
+}
+
+bool ExportTask::JoinSegments(const QStringList &segment_filenames, const QVector<rational> &segment_starts,
+                              const QString &audio_filename, const QString &real_filename, bool success)
+{
+  QString output_filename = real_filename;
+  if (QFileInfo::exists(real_filename)) {
+    output_filename = FileFunctions::GetSafeTemporaryFilename(real_filename);
+  }
+
+  if (success) {
+    success = FFmpegEncoder::ConcatenateSegments(segment_filenames, segment_starts,
+                                                 audio_filename, output_filename);
+  }
+
+  foreach (const QString& fn, segment_filenames) {
+    QFile::remove(fn);
+  }
+
+  if (!audio_filename.isEmpty()) {
+    QFile::remove(audio_filename);
+  }
+
+  if (IsCancelled()) {
+    QFile::remove(output_filename);
+    return true;
+  }
+
+  if (!success) {
+    SetError(tr("Failed to write \"%1\"").arg(real_filename));
+    QFile::remove(output_filename);
+    return false;
+  }
+
+  if (output_filename != real_filename
+      && !FileFunctions::RenameFileAllowOverwrite(output_filename, real_filename)) {
+    SetError(tr("Failed to overwrite \"%1\". Export has been saved as \"%2\" instead.")
+             .arg(real_filename, output_filename));
+    return false;
+  }
+
+  return true;
+}
+
+int ExportTask::GetSegmentCount(int64_t frame_count) const
+{
+  // Segments are joined by remuxing with FFmpeg
+  if (!params_.video_enabled() || params_.encoder() != QStringLiteral("ffmpeg")) {
+    return 1;
+  }
+
+  int segments = Config::Current()["ExportSegments"].toInt();
+
+  return qMax(1, qMin(segments, static_cast<int>(frame_count / kMinimumSegmentFrames)));
+}
+
+int ExportTask::GetSegmentIndex(int64_t timestamp) const
+{
+  // Segments are in order, so the last one starting at or before the timestamp is the only candidate
+  auto it = std::upper_bound(segment_starts_.constBegin(), segment_starts_.constEnd(), timestamp);
+
+  if (it == segment_starts_.constBegin()) {
+    return -1;
+  }
+
+  int index = static_cast<int>(it - segment_starts_.constBegin()) - 1;
+
+  if (timestamp >= segment_starts_.at(index) + segments_.at(index)->length()) {
+    return -1;
+  }
+
+  return index;
+}
+
+void ExportTask::ClearSegments()
+{
+  qDeleteAll(segments_);
+  segments_.clear();
+  segment_starts_.clear();
+}
+
+int ExportTask::GetMaximumFramesInFlight() const
+{
+  int limit = RenderTask::GetMaximumFramesInFlight();
+
+  if (segments_.isEmpty()) {
+    return limit;
+  }
+
+  // Every segment needs at least one frame in flight to keep its encoder busy
+  int segment_limit = segments_.size() * SegmentWriter::kMaximumBufferedFrames;
+
+  if (limit > 0) {
+    segment_limit = qMin(segment_limit, qMax(limit, segments_.size()));
+  }
+
+  return segment_limit;
+}
+
+void ExportTask::SortFramesForRendering(QVector<rational> &times) const
+{
+  if (segments_.isEmpty()) {
+    return;
+  }
+
+  // Interleave segments so every writer has frames to encode from the start
+  rational offset = params_.has_custom_range() ? params_.custom_range().in() : rational();
+  const rational& timebase = video_params().time_base();
+
+  auto position_in_segment = [this, offset, timebase](const rational& t){
+    int64_t ts = Timecode::time_to_timestamp(t - offset, timebase);
+    int segment = GetSegmentIndex(ts);
+    return (segment >= 0) ? ts - segment_starts_.at(segment) : ts;
+  };
+
+  std::stable_sort(times.begin(), times.end(), [&position_in_segment](const rational& a, const rational& b){
+    return position_in_segment(a) < position_in_segment(b);
+  });
+}
+
+void ExportTask::CancelEvent()
+{
+  RenderTask::CancelEvent();
+
+  foreach (SegmentWriter* writer, segments_) {
+    writer->Cancel();
+  }
+
+  foreach (OutputWriter* writer, outputs_) {
+    writer->Cancel();
+  }
+}
+
+void ExportTask::FrameDownloaded(FramePtr f, const QByteArray &hash, const QVector<rational> &times, qint64 job_time)
+{
+  Q_UNUSED(job_time)
+  Q_UNUSED(hash)
+
+  if (!outputs_.isEmpty()) {
+    // Every output gets the same frame, they each convert their own copy
+    foreach (const rational& t, times) {
+      rational actual_time = t;
+
+      if (params_.has_custom_range()) {
+        actual_time -= params_.custom_range().in();
+      }
+
+      int64_t ts = Timecode::time_to_timestamp(actual_time, video_params().time_base());
+
+      foreach (OutputWriter* writer, outputs_) {
+        writer->Push(ts, f);
+      }
+    }
+
+    return;
+  }
+
+  if (!segments_.isEmpty()) {
+    // Each segment has its own reorder buffer so frames can be written as soon as they arrive
+    foreach (const rational& t, times) {
+      rational actual_time = t;
+
+      if (params_.has_custom_range()) {
+        actual_time -= params_.custom_range().in();
+      }
+
+      int64_t ts = Timecode::time_to_timestamp(actual_time, video_params().time_base());
+      int segment = GetSegmentIndex(ts);
+
+      if (segment >= 0) {
+        segments_.at(segment)->Push(ts - segment_starts_.at(segment), f);
+      }
+    }
+
+    return;
+  }
+
+  if (encoder_->SupportsOutOfOrderFrames()) {
+    // Every frame is independent (e.g. an image sequence) so there's nothing to wait for
+    foreach (const rational& t, times) {
+      rational actual_time = t;
+
+      if (params_.has_custom_range()) {
+        actual_time -= params_.custom_range().in();
+      }
+
+      if (!encoder_->WriteFrame(f, actual_time)) {
+        // Stop rendering, Run() reports the failure
+        write_failed_ = true;
+        Cancel();
+        return;
+      }
+    }
+
+    return;
+  }
+
+  foreach (const rational& t, times) {
+    rational actual_time = t;
+
+    if (params_.has_custom_range()) {
+      actual_time -= params_.custom_range().in();
+    }
+
+    time_map_.insert(actual_time, f);
+    reorder_video_bytes_.fetchAndAddOrdered(f ? f->allocated_size() : 0);
+  }
+
+  forever {
+    rational real_time = Timecode::timestamp_to_time(frame_time_,
+                                                     viewer()->video_params().time_base());
+
+    if (!time_map_.contains(real_time)) {
+      break;
+    }
+
+    // Frames need to be sent one after the other chronologically, see SegmentWriter for exporting
+    // in parallel
+    FramePtr next = time_map_.take(real_time);
+    reorder_video_bytes_.fetchAndAddOrdered(next ? -next->allocated_size() : 0);
+
+    encoder_->WriteFrame(next, real_time);
+
+    // A two-pass export keeps every frame for the second pass
+    if (two_pass_pack_ && next
+        && !two_pass_pack_->Write(QByteArray::number(qlonglong(frame_time_)), next->const_data(),
+                                  next->video_params(), next->linesize_bytes())) {
+      write_failed_ = true;
+      Cancel();
+      break;
+    }
+
+    frame_time_++;
+  }
+
+  // Video has moved on, audio up to this point can be written now
+  WritePendingAudio(true);
+}
+
+void ExportTask::AudioDownloaded(const TimeRange &range, SampleBufferPtr samples, qint64 job_time)
+{
+  Q_UNUSED(job_time)
+
+  TimeRange adjusted_range = range;
+
+  if (params_.has_custom_range()) {
+    adjusted_range -= params_.custom_range().in();
+  }
+
+  audio_map_.insert(adjusted_range.in(), qMakePair(adjusted_range.out(), samples));
+  reorder_audio_bytes_.fetchAndAddOrdered(GetSampleBufferSize(samples));
+
+  // Segmented and distributed exports write audio to its own file so it never has to wait for video,
+  // and outputs of a multi-output export hold it back themselves
+  WritePendingAudio(outputs_.isEmpty() && audio_encoder_ == encoder_ && params_.video_enabled());
+}
+
+void ExportTask::WritePendingAudio(bool limit_to_video)
+{
+  if (!audio_encoder_ && outputs_.isEmpty()) {
+    return;
+  }
+
+  rational video_time = Timecode::timestamp_to_time(frame_time_, video_params().time_base());
+
+  // Chunks can arrive out of order, only write once every chunk before them has been written
+  while (audio_map_.contains(audio_time_)) {
+    if (limit_to_video && audio_time_ > video_time) {
+      break;
+    }
+
+    QPair<rational, SampleBufferPtr> chunk = audio_map_.take(audio_time_);
+    reorder_audio_bytes_.fetchAndAddOrdered(-GetSampleBufferSize(chunk.second));
+
+    if (outputs_.isEmpty()) {
+      audio_encoder_->WriteAudio(chunk.second);
+    } else {
+      foreach (OutputWriter* writer, outputs_) {
+        writer->PushAudio(audio_time_, chunk.second);
+      }
+    }
+
+    audio_time_ = chunk.first;
+  }
+}
+
+const int ExportTask::SegmentWriter::kMaximumBufferedFrames = 8;
+
+ExportTask::SegmentWriter::SegmentWriter(Encoder *encoder, int64_t length, const rational &timebase) :
+  encoder_(encoder),
+  length_(length),
+  timebase_(timebase),
+  next_(0),
+  finishing_(false),
+  cancelled_(false),
+  failed_(false)
+{
+}
+
+ExportTask::SegmentWriter::~SegmentWriter()
+{
+  Cancel();
+  wait();
+
+  encoder_->Close();
+  delete encoder_;
+}
+
+void ExportTask::SegmentWriter::Push(int64_t timestamp, FramePtr frame)
+{
+  QMutexLocker locker(&lock_);
+
+  buffer_.insert(timestamp, frame);
+  cond_.wakeAll();
+
+  // Only block while the writer can make progress without us, otherwise the frame it's waiting for
+  // might be queued behind this one
+  while (!cancelled_
+         && buffer_.size() >= kMaximumBufferedFrames
+         && buffer_.contains(next_)) {
+    cond_.wait(&lock_);
+  }
+}
+
+void ExportTask::SegmentWriter::Finish()
+{
+  QMutexLocker locker(&lock_);
+  finishing_ = true;
+  cond_.wakeAll();
+}
+
+void ExportTask::SegmentWriter::Cancel()
+{
+  QMutexLocker locker(&lock_);
+  cancelled_ = true;
+  cond_.wakeAll();
+}
+
+bool ExportTask::SegmentWriter::HasFailed()
+{
+  QMutexLocker locker(&lock_);
+  return failed_;
+}
+
+void ExportTask::SegmentWriter::run()
+{
+  for (int64_t i=0; i<length_; i++) {
+    lock_.lock();
+
+    while (!cancelled_ && !finishing_ && !buffer_.contains(i)) {
+      cond_.wait(&lock_);
+    }
+
+    if (cancelled_ || !buffer_.contains(i)) {
+      if (!cancelled_) {
+        qWarning() << "Export segment finished without frame" << i;
+        failed_ = true;
+      }
+
+      lock_.unlock();
+      break;
+    }
+
+    FramePtr frame = buffer_.take(i);
+    next_ = i + 1;
+    cond_.wakeAll();
+
+    lock_.unlock();
+
+    if (!encoder_->WriteFrame(frame, Timecode::timestamp_to_time(i, timebase_))) {
+      lock_.lock();
+      failed_ = true;
+      cancelled_ = true;
+      cond_.wakeAll();
+      lock_.unlock();
+      break;
+    }
+  }
+
+  encoder_->Close();
+}
+
+const int ExportTask::OutputWriter::kMaximumBufferedFrames = 8;
+
+ExportTask::OutputWriter::OutputWriter(Encoder *encoder, ColorProcessorPtr color_processor, int64_t length, const rational &timebase) :
+  encoder_(encoder),
+  color_processor_(color_processor),
+  length_(length),
+  timebase_(timebase),
+  next_(0),
+  finishing_(false),
+  cancelled_(false),
+  failed_(false)
+{
+}
+
+ExportTask::OutputWriter::~OutputWriter()
+{
+  Cancel();
+  wait();
+
+  encoder_->Close();
+  delete encoder_;
+}
+
+void ExportTask::OutputWriter::Push(int64_t timestamp, FramePtr frame)
+{
+  QMutexLocker locker(&lock_);
+
+  // Audio-only outputs have no use for frames
+  if (length_ == 0) {
+    return;
+  }
+
+  buffer_.insert(timestamp, frame);
+  cond_.wakeAll();
+
+  // Same as SegmentWriter, only block while the writer can make progress without us
+  while (!cancelled_
+         && buffer_.size() >= kMaximumBufferedFrames
+         && buffer_.contains(next_)) {
+    cond_.wait(&lock_);
+  }
+}
+
+void ExportTask::OutputWriter::PushAudio(const rational &time, SampleBufferPtr samples)
+{
+  if (!encoder_->params().audio_enabled()) {
+    return;
+  }
+
+  QMutexLocker locker(&lock_);
+  audio_.enqueue(qMakePair(time, samples));
+  cond_.wakeAll();
+}
+
+void ExportTask::OutputWriter::Finish()
+{
+  QMutexLocker locker(&lock_);
+  finishing_ = true;
+  cond_.wakeAll();
+}
+
+void ExportTask::OutputWriter::Cancel()
+{
+  QMutexLocker locker(&lock_);
+  cancelled_ = true;
+  cond_.wakeAll();
+}
+
+bool ExportTask::OutputWriter::HasFailed()
+{
+  QMutexLocker locker(&lock_);
+  return failed_;
+}
+
+void ExportTask::OutputWriter::run()
+{
+  forever {
+    FramePtr frame;
+    int64_t timestamp = 0;
+    SampleBufferPtr samples;
+    bool done = false;
+
+    lock_.lock();
+
+    forever {
+      if (cancelled_) {
+        done = true;
+        break;
+      }
+
+      bool video_done = (next_ >= length_);
+
+      // Audio is written once the video has caught up with it
+      if (!audio_.isEmpty()
+          && (video_done || audio_.head().first <= Timecode::timestamp_to_time(next_, timebase_))) {
+        samples = audio_.dequeue().second;
+        break;
+      }
+
+      if (!video_done && buffer_.contains(next_)) {
+        timestamp = next_;
+        frame = buffer_.take(next_);
+        next_++;
+        cond_.wakeAll();
+        break;
+      }
+
+      if (finishing_) {
+        if (!video_done) {
+          qWarning() << "Export output finished without frame" << next_;
+          failed_ = true;
+        }
+
+        done = true;
+        break;
+      }
+
+      cond_.wait(&lock_);
+    }
+
+    lock_.unlock();
+
+    if (done) {
+      break;
+    }
+
+    bool written = samples ? encoder_->WriteAudio(samples) : WriteVideo(frame, timestamp);
+
+    if (!written) {
+      lock_.lock();
+      failed_ = true;
+      cancelled_ = true;
+      cond_.wakeAll();
+      lock_.unlock();
+      break;
+    }
+  }
+
+  encoder_->Close();
+}
+
+bool ExportTask::OutputWriter::WriteVideo(FramePtr frame, int64_t timestamp)
+{
+  if (color_processor_) {
+    // The frame is shared with the other outputs, so convert a copy
+    frame = frame->convert(VideoParams::kFormatFloat32);
+
+    if (!frame) {
+      return false;
+    }
+
+    color_processor_->ConvertFrame(frame);
   }
 
-  audio_data_.WritePCM(adjusted_range, samples, QDateTime::currentMSecsSinceEpoch());
+  return encoder_->WriteFrame(frame, Timecode::timestamp_to_time(timestamp, timebase_));
 }
 
 }
@@ -21,20 +21,78 @@
 #ifndef EXPORTTASK_H
 #define EXPORTTASK_H
 
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "common/memorygovernor.h"
 #include "exportparams.h"
 #include "node/output/viewer/viewer.h"
+#include "project/item/footage/videostream.h"
 #include "render/colorprocessor.h"
 #include "task/render/render.h"
 #include "task/task.h"
 
 namespace olive {
 
-class ExportTask : public RenderTask
+class FramePack;
+
+class ExportTask : public RenderTask, public MemoryGovernor::Consumer
 {
   Q_OBJECT
 public:
   ExportTask(ViewerOutput *viewer_node, ColorManager *color_manager, const ExportParams &params);
 
+  virtual ~ExportTask() override;
+
+  /**
+   * @brief Returns the size of frames and audio waiting to be written in order
+   */
+  virtual qint64 GetMemoryUsage() const override;
+
+  /**
+   * @brief Buffered frames have to be written eventually, this always returns FALSE
+   */
+  virtual bool ReleaseMemory(qint64 bytes) override;
+
+  /**
+   * @brief Render video on a render farm rather than locally
+   *
+   * The project saved at `project_filename` is shared with workers through `farm_path` and each
+   * worker renders chunks of the export while this task renders audio, waits for the chunks and
+   * joins them. See RenderFarmJob for how the folder is used.
+   */
+  void SetRenderFarm(const QString& farm_path, const QString& project_filename);
+
+  /**
+   * @brief Encode another file from the same rendered frames and audio
+   *
+   * Each output gets its own color transform, encoder and reorder buffer, but frames are only
+   * rendered once, at the resolution of the ExportParams this task was created with. FFmpeg
+   * outputs at other resolutions are stretched to fit. Every output must have the same frame rate
+   * and range as the first, though any of them may be audio or video only.
+   */
+  void AddOutput(const ExportParams& params);
+
+  /**
+   * @brief Returns TRUE if this graph can be rendered at half float for an output of this depth
+   *
+   * Half float keeps 11 significant bits, so outputs of up to 10 bits per channel can't tell the
+   * difference unless a node in the graph is precision sensitive (see
+   * Node::IsPrecisionSensitive()). A `target_bit_depth` of 0 (unknown) always returns FALSE.
+   */
+  static bool CanReducePrecision(ViewerOutput* viewer, int target_bit_depth);
+
+  /**
+   * @brief Returns TRUE if frames in this viewer's disk cache match what an online render produces
+   *
+   * Preview frames are rendered offline, which is only identical to online when the preview
+   * precision is accurate and none of the graph's video footage has a proxy. Hashes match
+   * otherwise, so this has to be checked before an export uses them.
+   */
+  static bool CanReusePreviewCache(ViewerOutput* viewer);
+
 protected:
   virtual bool Run() override;
 
@@ -47,20 +105,318 @@ protected:
     return false;
   }
 
+  virtual int GetMaximumFramesInFlight() const override;
+
+  virtual void SortFramesForRendering(QVector<rational>& times) const override;
+
+  virtual void CancelEvent() override;
+
 private:
+  /**
+   * @brief Thread that encodes one segment of a parallel export
+   *
+   * Frames can be pushed in any order, they're held in a reorder buffer until every frame before
+   * them has been written. Push() blocks while the buffer is full and the writer is still making
+   * progress, which holds back the render loop rather than letting frames pile up in memory.
+   */
+  class SegmentWriter : public QThread
+  {
+  public:
+    SegmentWriter(Encoder* encoder, int64_t length, const rational& timebase);
+
+    virtual ~SegmentWriter() override;
+
+    /**
+     * @brief Queue a frame for writing at `timestamp` frames from the start of this segment
+     */
+    void Push(int64_t timestamp, FramePtr frame);
+
+    /**
+     * @brief Signal that no more frames are coming, the writer will finish once the buffer is empty
+     */
+    void Finish();
+
+    void Cancel();
+
+    bool HasFailed();
+
+    const int64_t& length() const
+    {
+      return length_;
+    }
+
+    Encoder* encoder() const
+    {
+      return encoder_;
+    }
+
+    static const int kMaximumBufferedFrames;
+
+  protected:
+    virtual void run() override;
+
+  private:
+    Encoder* encoder_;
+
+    int64_t length_;
+
+    rational timebase_;
+
+    QMap<int64_t, FramePtr> buffer_;
+
+    int64_t next_;
+
+    QMutex lock_;
+
+    QWaitCondition cond_;
+
+    bool finishing_;
+
+    bool cancelled_;
+
+    bool failed_;
+
+  };
+
+  /**
+   * @brief A range of an untouched clip that can be copied from its source file
+   */
+  struct CopyRange {
+    /// Range in the sequence
+    TimeRange range;
+
+    VideoStream* stream;
+
+    /// Keyframe the range starts on and the keyframe (or end of stream) it finishes before
+    int64_t start_pts;
+    int64_t end_pts;
+  };
+
+  /**
+   * @brief Thread that converts and encodes frames for one output of a multi-output export
+   *
+   * Frames are held in a reorder buffer like SegmentWriter, and Push() blocks the same way, so the
+   * slowest output decides how fast the render goes. Audio is written in between frames so it
+   * never gets ahead of the video.
+   */
+  class OutputWriter : public QThread
+  {
+  public:
+    OutputWriter(Encoder* encoder, ColorProcessorPtr color_processor, int64_t length, const rational& timebase);
+
+    virtual ~OutputWriter() override;
+
+    void Push(int64_t timestamp, FramePtr frame);
+
+    /**
+     * @brief Queue audio starting at `time`, chunks must be pushed in order
+     */
+    void PushAudio(const rational& time, SampleBufferPtr samples);
+
+    void Finish();
+
+    void Cancel();
+
+    bool HasFailed();
+
+    static const int kMaximumBufferedFrames;
+
+  protected:
+    virtual void run() override;
+
+  private:
+    bool WriteVideo(FramePtr frame, int64_t timestamp);
+
+    Encoder* encoder_;
+
+    ColorProcessorPtr color_processor_;
+
+    int64_t length_;
+
+    rational timebase_;
+
+    QMap<int64_t, FramePtr> buffer_;
+
+    QQueue< QPair<rational, SampleBufferPtr> > audio_;
+
+    int64_t next_;
+
+    QMutex lock_;
+
+    QWaitCondition cond_;
+
+    bool finishing_;
+
+    bool cancelled_;
+
+    bool failed_;
+
+  };
+
+  bool RunMultiple(const TimeRange& range, const QSize& force_size, const QMatrix4x4& force_matrix);
+
+  bool RunSegmented(const TimeRange& range, const QString& real_filename, int segment_count,
+                    const QSize& force_size, const QMatrix4x4& force_matrix);
+
+  /**
+   * @brief Export with a two-pass encode while only rendering the sequence once
+   *
+   * Rendered frames go to the first pass as usual and are also appended to a temporary FramePack
+   * in the disk cache. The second pass then encodes them from there. Audio is encoded into its
+   * own file during the first pass and joined with the second pass's video at the end.
+   */
+  bool RunTwoPass(const TimeRange& range, const QString& real_filename,
+                  const QSize& force_size, const QMatrix4x4& force_matrix);
+
+  /**
+   * @brief Export by copying `copies` from their source files and encoding everything in between
+   */
+  bool RunSmart(const TimeRange& range, const QString& real_filename, const QVector<CopyRange>& copies,
+                const QSize& force_size, const QMatrix4x4& force_matrix);
+
+  /**
+   * @brief Find the parts of `range` that smart rendering can copy as-is
+   *
+   * A clip qualifies if it's on the only video track and is its source footage with nothing in
+   * between: no effects, transitions or speed changes, and in the same resolution, frame rate, pixel
+   * format, codec and color space as the export. Only whole GOPs of it are copied, the frames
+   * around them are encoded as usual.
+   */
+  QVector<CopyRange> GetCopyableRanges(const TimeRange& range) const;
+
+  /**
+   * @brief Switch rendering to half float if automatic precision is on and every output allows it
+   */
+  void ChooseRenderPrecision();
+
+  /**
+   * @brief Returns the bits per channel the encoder for these parameters writes, or 0 if unknown
+   */
+  static int GetTargetBitDepth(const ExportParams& params);
+
+  /**
+   * @brief Encode each of `ranges` into its own segment next to `real_filename` in parallel
+   *
+   * Audio in `audio_range` is rendered at the same time and written to `audio_encoder_`. The
+   * segment filenames are inserted into `filenames` by their start relative to `range`. Returns
+   * FALSE if a segment couldn't be opened or written, its files have been removed in that case.
+   */
+  bool EncodeSegments(const QVector<TimeRange>& ranges, const TimeRange& range, const TimeRangeList& audio_range,
+                      const QString& real_filename, const QSize& force_size, const QMatrix4x4& force_matrix,
+                      QMap<rational, QString>* filenames);
+
+  bool RunDistributed(const TimeRange& range, const QString& real_filename);
+
+  /**
+   * @brief Open an encoder that writes audio alone to a temporary file next to `real_filename`
+   */
+  bool OpenAudioEncoder(const QString& real_filename, QString* audio_filename);
+
+  void CloseAudioEncoder();
+
+  /**
+   * @brief Join separately encoded video segments and audio into `real_filename`
+   *
+   * The segments and audio file are deleted afterwards. If `success` is FALSE, nothing is joined
+   * and only the cleanup is done.
+   */
+  bool JoinSegments(const QStringList& segment_filenames, const QVector<rational>& segment_starts,
+                    const QString& audio_filename, const QString& real_filename, bool success);
+
+  /**
+   * @brief Number of segments this export should be split into, 1 meaning a regular serial export
+   */
+  int GetSegmentCount(int64_t frame_count) const;
+
+  /**
+   * @brief Index of the segment containing the frame `timestamp` frames from the start of the export
+   *
+   * Returns -1 if no segment does.
+   */
+  int GetSegmentIndex(int64_t timestamp) const;
+
+  void ClearSegments();
+
+  /**
+   * @brief Send buffered audio to the encoder in order
+   *
+   * If `limit_to_video` is TRUE, audio past the last video frame written is held back so the
+   * muxer doesn't have to buffer it.
+   */
+  void WritePendingAudio(bool limit_to_video);
+
+  /**
+   * @brief Minimum length of a segment in frames, shorter exports aren't worth splitting
+   */
+  static const int kMinimumSegmentFrames;
+
+  /**
+   * @brief Length in frames of each chunk handed to render farm workers
+   */
+  static const int kRenderFarmChunkFrames;
+
+  /**
+   * @brief Milliseconds between checks on the progress of a render farm job
+   */
+  static const int kRenderFarmPollInterval;
+
   QHash<rational, FramePtr> time_map_;
 
+  /**
+   * @brief Bytes held by `time_map_` and `audio_map_`, for reporting to MemoryGovernor
+   */
+  QAtomicInteger<qint64> reorder_video_bytes_;
+  QAtomicInteger<qint64> reorder_audio_bytes_;
+
+  QVector<SegmentWriter*> segments_;
+
+  QVector<ExportParams> extra_outputs_;
+
+  QVector<OutputWriter*> outputs_;
+
+  /**
+   * @brief Frame each of `segments_` starts on relative to the start of the export
+   */
+  QVector<int64_t> segment_starts_;
+
   ColorManager* color_manager_;
 
   ExportParams params_;
 
   Encoder* encoder_;
 
+  /**
+   * @brief Where a two-pass export keeps frames for its second pass, nullptr otherwise
+   */
+  FramePack* two_pass_pack_;
+
   ColorProcessorPtr color_processor_;
 
   int64_t frame_time_;
 
-  AudioPlaybackCache audio_data_;
+  /**
+   * @brief Set if an encoder that accepts frames out of order failed to write one
+   */
+  bool write_failed_;
+
+  /**
+   * @brief Encoder audio is written to, which is separate from `encoder_` for segmented exports
+   */
+  Encoder* audio_encoder_;
+
+  /**
+   * @brief Rendered audio chunks waiting to be written, keyed by start time
+   */
+  QMap<rational, QPair<rational, SampleBufferPtr> > audio_map_;
+
+  /**
+   * @brief Start time of the next audio chunk to write
+   */
+  rational audio_time_;
+
+  QString farm_path_;
+
+  QString farm_project_;
 
 };
 
@@ -20,11 +20,15 @@
 
 #include "exportparams.h"
 
+#include "common/xmlutils.h"
+
 namespace olive {
 
 ExportParams::ExportParams() :
   video_scaling_method_(kStretch),
-  has_custom_range_(false)
+  has_custom_range_(false),
+  smart_render_(false),
+  auto_precision_(false)
 {
 }
 
@@ -74,6 +78,26 @@ void ExportParams::set_color_transform(const ColorTransform &color_transform)
   color_transform_ = color_transform;
 }
 
+bool ExportParams::smart_render() const
+{
+  return smart_render_;
+}
+
+void ExportParams::set_smart_render(bool e)
+{
+  smart_render_ = e;
+}
+
+bool ExportParams::auto_precision() const
+{
+  return auto_precision_;
+}
+
+void ExportParams::set_auto_precision(bool e)
+{
+  auto_precision_ = e;
+}
+
 QMatrix4x4 ExportParams::GenerateMatrix(ExportParams::VideoScalingMethod method,
                                         int source_width, int source_height,
                                         int dest_width, int dest_height)
@@ -114,12 +138,64 @@ void ExportParams::Save(QXmlStreamWriter *writer) const
 
   writer->writeTextElement(QStringLiteral("customrangeout"), custom_range_.out().toString());
 
+  writer->writeTextElement(QStringLiteral("smartrender"), QString::number(smart_render_));
+
+  writer->writeTextElement(QStringLiteral("autoprecision"), QString::number(auto_precision_));
+
   // FIXME: Change this when color chains are implemented
-  writer->writeTextElement(QStringLiteral("color"), color_transform_.output());
+  if (color_transform_.is_display()) {
+    writer->writeStartElement(QStringLiteral("color"));
+    writer->writeAttribute(QStringLiteral("display"), color_transform_.display());
+    writer->writeAttribute(QStringLiteral("view"), color_transform_.view());
+    writer->writeAttribute(QStringLiteral("look"), color_transform_.look());
+    writer->writeEndElement(); // color
+  } else {
+    writer->writeTextElement(QStringLiteral("color"), color_transform_.output());
+  }
 
   EncodingParams::Save(writer);
 
   writer->writeEndElement(); // export
 }
 
+bool ExportParams::Load(QXmlStreamReader *reader)
+{
+  rational custom_in, custom_out;
+
+  while (XMLReadNextStartElement(reader)) {
+    if (reader->name() == QStringLiteral("encoder")) {
+      encoder_id_ = reader->readElementText();
+    } else if (reader->name() == QStringLiteral("vscale")) {
+      video_scaling_method_ = static_cast<VideoScalingMethod>(reader->readElementText().toInt());
+    } else if (reader->name() == QStringLiteral("range")) {
+      has_custom_range_ = reader->readElementText().toInt();
+    } else if (reader->name() == QStringLiteral("customrangein")) {
+      custom_in = rational::fromString(reader->readElementText());
+    } else if (reader->name() == QStringLiteral("customrangeout")) {
+      custom_out = rational::fromString(reader->readElementText());
+    } else if (reader->name() == QStringLiteral("smartrender")) {
+      smart_render_ = reader->readElementText().toInt();
+    } else if (reader->name() == QStringLiteral("autoprecision")) {
+      auto_precision_ = reader->readElementText().toInt();
+    } else if (reader->name() == QStringLiteral("color")) {
+      QXmlStreamAttributes attributes = reader->attributes();
+
+      if (attributes.hasAttribute(QStringLiteral("display"))) {
+        color_transform_ = ColorTransform(attributes.value(QStringLiteral("display")).toString(),
+                                          attributes.value(QStringLiteral("view")).toString(),
+                                          attributes.value(QStringLiteral("look")).toString());
+        reader->skipCurrentElement();
+      } else {
+        color_transform_ = ColorTransform(reader->readElementText());
+      }
+    } else if (!LoadElement(reader)) {
+      reader->skipCurrentElement();
+    }
+  }
+
+  custom_range_ = TimeRange(custom_in, custom_out);
+
+  return !reader->hasError();
+}
+
 }
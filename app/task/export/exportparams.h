@@ -52,12 +52,31 @@ public:
   const ColorTransform& color_transform() const;
   void set_color_transform(const ColorTransform& color_transform);
 
+  /**
+   * @brief If TRUE, untouched clips that already match the export are copied rather than re-encoded
+   *
+   * See ExportTask for when a clip qualifies.
+   */
+  bool smart_render() const;
+  void set_smart_render(bool e);
+
+  /**
+   * @brief If TRUE, intermediates may be stored at half float when the output can't tell
+   *
+   * See ExportTask::CanReducePrecision() for when this applies. Only has an effect if the video
+   * is rendered in full float.
+   */
+  bool auto_precision() const;
+  void set_auto_precision(bool e);
+
   static QMatrix4x4 GenerateMatrix(ExportParams::VideoScalingMethod method,
                                    int source_width, int source_height,
                                    int dest_width, int dest_height);
 
   virtual void Save(QXmlStreamWriter* writer) const override;
 
+  virtual bool Load(QXmlStreamReader* reader) override;
+
 private:
   QString encoder_id_;
 
@@ -68,6 +87,10 @@ private:
 
   ColorTransform color_transform_;
 
+  bool smart_render_;
+
+  bool auto_precision_;
+
 };
 
 }
@@ -0,0 +1,351 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "renderfarmjob.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QUuid>
+
+#include "common/timecodefunctions.h"
+#include "common/xmlutils.h"
+
+namespace olive {
+
+const int RenderFarmJob::kMaximumAttempts = 3;
+const qint64 RenderFarmJob::kProgressTimeout = 120000;
+
+/**
+ * @brief Write a small text file so readers never see it half written
+ */
+static bool WriteStatusFile(const QString& filename, const QString& contents)
+{
+  QSaveFile f(filename);
+
+  if (!f.open(QFile::WriteOnly)) {
+    return false;
+  }
+
+  f.write(contents.toUtf8());
+
+  return f.commit();
+}
+
+RenderFarmJob::RenderFarmJob(const QString &path) :
+  path_(path),
+  chunk_length_(0),
+  frame_count_(0)
+{
+}
+
+QString RenderFarmJob::GenerateJobPath(const QString &farm_path)
+{
+  QString id = QUuid::createUuid().toString();
+  id.remove('{');
+  id.remove('}');
+
+  return QDir(farm_path).filePath(id);
+}
+
+QStringList RenderFarmJob::GetJobs(const QString &farm_path)
+{
+  QDir farm_dir(farm_path);
+  QStringList jobs;
+
+  // Oldest first so jobs are worked through in the order they were submitted
+  foreach (const QString& entry, farm_dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot,
+                                                   QDir::Time | QDir::Reversed)) {
+    jobs.append(farm_dir.filePath(entry));
+  }
+
+  return jobs;
+}
+
+bool RenderFarmJob::Publish(const QString &project_filename, const QString &sequence_name,
+                            const ExportParams &params, int64_t chunk_length)
+{
+  if (!QDir().mkpath(path_)) {
+    qWarning() << "Failed to create render farm job" << path_;
+    return false;
+  }
+
+  if (!QFile::copy(project_filename, this->project_filename())) {
+    qWarning() << "Failed to copy project to render farm job" << path_;
+    return false;
+  }
+
+  sequence_name_ = sequence_name;
+  params_ = params;
+  chunk_length_ = chunk_length;
+  frame_count_ = Timecode::time_to_timestamp(params.custom_range().length(),
+                                             params.video_params().time_base());
+
+  chunk_starts_.clear();
+  for (int64_t start=0; start<frame_count_; start+=chunk_length_) {
+    chunk_starts_.append(start);
+  }
+
+  // Written last, workers ignore the job until this exists
+  QSaveFile f(QDir(path_).filePath(QStringLiteral("job.xml")));
+
+  if (!f.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to write render farm job" << path_;
+    return false;
+  }
+
+  QXmlStreamWriter writer(&f);
+  writer.setAutoFormatting(true);
+
+  writer.writeStartDocument();
+
+  writer.writeStartElement(QStringLiteral("renderfarmjob"));
+  writer.writeAttribute(QStringLiteral("version"), QString::number(1));
+
+  writer.writeTextElement(QStringLiteral("sequence"), sequence_name_);
+  writer.writeTextElement(QStringLiteral("chunklength"), QString::number(chunk_length_));
+  writer.writeTextElement(QStringLiteral("frames"), QString::number(frame_count_));
+
+  params_.Save(&writer);
+
+  writer.writeEndElement(); // renderfarmjob
+
+  writer.writeEndDocument();
+
+  return f.commit();
+}
+
+bool RenderFarmJob::Load()
+{
+  QFile f(QDir(path_).filePath(QStringLiteral("job.xml")));
+
+  if (!f.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  QXmlStreamReader reader(&f);
+
+  if (!XMLReadNextStartElement(&reader) || reader.name() != QStringLiteral("renderfarmjob")) {
+    qWarning() << "Invalid render farm job" << path_;
+    return false;
+  }
+
+  while (XMLReadNextStartElement(&reader)) {
+    if (reader.name() == QStringLiteral("sequence")) {
+      sequence_name_ = reader.readElementText();
+    } else if (reader.name() == QStringLiteral("chunklength")) {
+      chunk_length_ = reader.readElementText().toLongLong();
+    } else if (reader.name() == QStringLiteral("frames")) {
+      frame_count_ = reader.readElementText().toLongLong();
+    } else if (reader.name() == QStringLiteral("export")) {
+      params_.Load(&reader);
+    } else {
+      reader.skipCurrentElement();
+    }
+  }
+
+  if (reader.hasError() || chunk_length_ <= 0 || !params_.has_custom_range()) {
+    qWarning() << "Failed to read render farm job" << path_;
+    return false;
+  }
+
+  chunk_starts_.clear();
+  for (int64_t start=0; start<frame_count_; start+=chunk_length_) {
+    chunk_starts_.append(start);
+  }
+
+  return true;
+}
+
+void RenderFarmJob::Remove() const
+{
+  QDir(path_).removeRecursively();
+}
+
+QString RenderFarmJob::project_filename() const
+{
+  return QDir(path_).filePath(QStringLiteral("project.ove"));
+}
+
+TimeRange RenderFarmJob::GetChunkRange(int i) const
+{
+  const rational& timebase = params_.video_params().time_base();
+  int64_t start = chunk_starts_.at(i);
+  int64_t end = qMin(start + chunk_length_, frame_count_);
+
+  return TimeRange(params_.custom_range().in() + Timecode::timestamp_to_time(start, timebase),
+                   params_.custom_range().in() + Timecode::timestamp_to_time(end, timebase));
+}
+
+QString RenderFarmJob::GetChunkFilename(int i) const
+{
+  return GetChunkPath(i, QFileInfo(params_.filename()).suffix());
+}
+
+QLockFile *RenderFarmJob::TryClaimChunk(int i) const
+{
+  QLockFile* lock = new QLockFile(GetChunkPath(i, QStringLiteral("lock")));
+
+  // Chunks take as long as they take, abandoned claims are released by the coordinator instead
+  lock->setStaleLockTime(0);
+
+  if (!lock->tryLock()) {
+    delete lock;
+    return nullptr;
+  }
+
+  UpdateChunkProgress(i, 0);
+
+  return lock;
+}
+
+void RenderFarmJob::ReleaseClaim(int i) const
+{
+  QFile::remove(GetChunkPath(i, QStringLiteral("progress")));
+  QFile::remove(GetChunkPath(i, QStringLiteral("lock")));
+}
+
+void RenderFarmJob::UpdateChunkProgress(int i, int64_t frames) const
+{
+  WriteStatusFile(GetChunkPath(i, QStringLiteral("progress")),
+                  QStringLiteral("%1\n%2\n").arg(GetHostName(), QString::number(frames)));
+}
+
+bool RenderFarmJob::ReadChunkProgress(int i, QString *host, int64_t *frames, qint64 *age) const
+{
+  QFileInfo lock_info(GetChunkPath(i, QStringLiteral("lock")));
+
+  if (!lock_info.exists()) {
+    return false;
+  }
+
+  QFile f(GetChunkPath(i, QStringLiteral("progress")));
+  QDateTime last_update = lock_info.lastModified();
+
+  *host = QString();
+  *frames = 0;
+
+  if (f.open(QFile::ReadOnly)) {
+    QTextStream stream(&f);
+
+    *host = stream.readLine();
+    *frames = stream.readLine().toLongLong();
+
+    last_update = QFileInfo(f).lastModified();
+  }
+
+  *age = last_update.msecsTo(QDateTime::currentDateTime());
+
+  return true;
+}
+
+void RenderFarmJob::MarkChunkDone(int i, qint64 elapsed) const
+{
+  WriteStatusFile(GetChunkPath(i, QStringLiteral("done")),
+                  QStringLiteral("%1\n%2\n").arg(GetHostName(), QString::number(elapsed)));
+
+  QFile::remove(GetChunkPath(i, QStringLiteral("progress")));
+}
+
+bool RenderFarmJob::IsChunkDone(int i) const
+{
+  return QFileInfo::exists(GetChunkPath(i, QStringLiteral("done")));
+}
+
+bool RenderFarmJob::ReadChunkResult(int i, QString *host, qint64 *elapsed) const
+{
+  QFile f(GetChunkPath(i, QStringLiteral("done")));
+
+  if (!f.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  QTextStream stream(&f);
+
+  *host = stream.readLine();
+  *elapsed = stream.readLine().toLongLong();
+
+  return true;
+}
+
+void RenderFarmJob::MarkChunkFailed(int i, const QString &error) const
+{
+  QFile f(GetChunkPath(i, QStringLiteral("failed")));
+
+  if (f.open(QFile::WriteOnly | QFile::Append)) {
+    QString line = QStringLiteral("%1: %2\n").arg(GetHostName(), QString(error).replace('\n', ' '));
+    f.write(line.toUtf8());
+  }
+}
+
+int RenderFarmJob::GetChunkFailures(int i, QString *last_error) const
+{
+  QFile f(GetChunkPath(i, QStringLiteral("failed")));
+
+  if (!f.open(QFile::ReadOnly)) {
+    return 0;
+  }
+
+  QTextStream stream(&f);
+  int failures = 0;
+
+  while (!stream.atEnd()) {
+    QString line = stream.readLine();
+
+    if (!line.isEmpty()) {
+      failures++;
+
+      if (last_error) {
+        *last_error = line;
+      }
+    }
+  }
+
+  return failures;
+}
+
+bool RenderFarmJob::IsCancelled() const
+{
+  QDir dir(path_);
+
+  // A job that's been removed is as good as cancelled
+  return QFileInfo::exists(dir.filePath(QStringLiteral("cancel")))
+      || !QFileInfo::exists(dir.filePath(QStringLiteral("job.xml")));
+}
+
+void RenderFarmJob::Cancel() const
+{
+  WriteStatusFile(QDir(path_).filePath(QStringLiteral("cancel")), QString());
+}
+
+QString RenderFarmJob::GetHostName()
+{
+  return QSysInfo::machineHostName();
+}
+
+QString RenderFarmJob::GetChunkPath(int i, const QString &ext) const
+{
+  return QDir(path_).filePath(QStringLiteral("chunk%1.%2").arg(QString::number(i), ext));
+}
+
+}
@@ -0,0 +1,195 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERFARMJOB_H
+#define RENDERFARMJOB_H
+
+#include <QLockFile>
+
+#include "exportparams.h"
+
+namespace olive {
+
+/**
+ * @brief An export split into chunks for a render farm, shared through a folder every node can see
+ *
+ * The coordinator creates a directory for each job in the render farm folder containing a copy of
+ * the project and a description of the export, then waits for workers (`--farm-worker`) to render
+ * its chunks. Everything is communicated through files in the job directory so the only
+ * requirement is a shared folder:
+ *
+ * * `project.ove` and `job.xml` are written by the coordinator, a job without `job.xml` hasn't
+ *   been published yet.
+ * * `chunkN.lock` is held by the worker rendering chunk N. `chunkN.progress` is rewritten
+ *   periodically while it renders so the coordinator can tell a worker has died.
+ * * `chunkN.<ext>` is the encoded chunk, and `chunkN.done` records which host rendered it and how
+ *   long it took once it's complete.
+ * * `chunkN.failed` has a line appended each time a chunk fails so it's only retried a limited
+ *   number of times.
+ * * `cancel` tells workers to abandon the job.
+ *
+ * Footage must be reachable at the same path from every node for workers to load the project.
+ */
+class RenderFarmJob
+{
+public:
+  RenderFarmJob(const QString& path);
+
+  /**
+   * @brief Generate a path for a new job in `farm_path`
+   */
+  static QString GenerateJobPath(const QString& farm_path);
+
+  /**
+   * @brief Return the paths of every job in `farm_path`
+   */
+  static QStringList GetJobs(const QString& farm_path);
+
+  /**
+   * @brief Create the job directory and make it available to workers
+   *
+   * `params` must have a custom range set to the range being rendered. It's split into chunks of
+   * `chunk_length` frames.
+   */
+  bool Publish(const QString& project_filename, const QString& sequence_name,
+               const ExportParams& params, int64_t chunk_length);
+
+  /**
+   * @brief Read a job published by another node
+   */
+  bool Load();
+
+  /**
+   * @brief Delete the job directory and everything in it
+   */
+  void Remove() const;
+
+  const QString& path() const
+  {
+    return path_;
+  }
+
+  QString project_filename() const;
+
+  const QString& sequence_name() const
+  {
+    return sequence_name_;
+  }
+
+  const ExportParams& params() const
+  {
+    return params_;
+  }
+
+  int chunk_count() const
+  {
+    return chunk_starts_.size();
+  }
+
+  /**
+   * @brief Range of chunk `i` in sequence time
+   */
+  TimeRange GetChunkRange(int i) const;
+
+  /**
+   * @brief File chunk `i` is encoded to
+   */
+  QString GetChunkFilename(int i) const;
+
+  /**
+   * @brief Try to take chunk `i` for rendering, returns nullptr if another worker has it
+   *
+   * Delete the returned lock to release the chunk.
+   */
+  QLockFile* TryClaimChunk(int i) const;
+
+  /**
+   * @brief Remove another worker's claim on chunk `i`, used when it's stopped responding
+   */
+  void ReleaseClaim(int i) const;
+
+  /**
+   * @brief Record that `frames` frames of chunk `i` have been rendered by this host
+   */
+  void UpdateChunkProgress(int i, int64_t frames) const;
+
+  /**
+   * @brief Read the progress of a chunk that's being rendered
+   *
+   * Returns FALSE if the chunk isn't claimed. `age` is set to the milliseconds since the progress
+   * was last updated.
+   */
+  bool ReadChunkProgress(int i, QString* host, int64_t* frames, qint64* age) const;
+
+  void MarkChunkDone(int i, qint64 elapsed) const;
+
+  bool IsChunkDone(int i) const;
+
+  /**
+   * @brief Read which host rendered chunk `i` and how long it took in milliseconds
+   */
+  bool ReadChunkResult(int i, QString* host, qint64* elapsed) const;
+
+  void MarkChunkFailed(int i, const QString& error) const;
+
+  /**
+   * @brief Number of times chunk `i` has failed, along with the last error
+   */
+  int GetChunkFailures(int i, QString* last_error = nullptr) const;
+
+  bool IsCancelled() const;
+
+  void Cancel() const;
+
+  /**
+   * @brief Name this node identifies itself with in progress and done files
+   */
+  static QString GetHostName();
+
+  /**
+   * @brief Number of times a chunk is attempted before the job is abandoned
+   */
+  static const int kMaximumAttempts;
+
+  /**
+   * @brief Milliseconds without progress before a worker is assumed to have died
+   */
+  static const qint64 kProgressTimeout;
+
+private:
+  QString GetChunkPath(int i, const QString& ext) const;
+
+  QString path_;
+
+  QString sequence_name_;
+
+  ExportParams params_;
+
+  QVector<int64_t> chunk_starts_;
+
+  int64_t chunk_length_;
+
+  int64_t frame_count_;
+
+};
+
+}
+
+#endif // RENDERFARMJOB_H
@@ -36,6 +36,12 @@ public:
 
   virtual ~PreCacheTask() override;
 
+  virtual Priority GetPriority() const override
+  {
+    // Pre-caching only saves time later
+    return kPriorityLow;
+  }
+
 protected:
   virtual bool Run() override;
 
@@ -0,0 +1,163 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "thumbnailcache.h"
+
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrent>
+
+#include "task/precompute/thumbnailtask.h"
+#include "task/taskmanager.h"
+
+namespace olive {
+
+ThumbnailCache* ThumbnailCache::instance_ = nullptr;
+const int ThumbnailCache::kMemoryBudget = 64 * 1024 * 1024;
+
+struct LoadedThumbnails {
+  bool valid;
+  QImage strip;
+  rational interval;
+  int count;
+};
+
+ThumbnailCache::ThumbnailCache() :
+  strips_(kMemoryBudget)
+{
+  connect(TaskManager::instance(), &TaskManager::TaskRemoved, this, &ThumbnailCache::TaskRemoved);
+  connect(TaskManager::instance(), &TaskManager::TaskFailed, this, &ThumbnailCache::TaskRemoved);
+}
+
+void ThumbnailCache::CreateInstance()
+{
+  instance_ = new ThumbnailCache();
+}
+
+void ThumbnailCache::DestroyInstance()
+{
+  delete instance_;
+  instance_ = nullptr;
+}
+
+ThumbnailCache *ThumbnailCache::instance()
+{
+  return instance_;
+}
+
+const ThumbnailCache::Strip *ThumbnailCache::Get(VideoStream *stream)
+{
+  Strip* s = strips_.object(stream);
+
+  if (!s && !loading_.contains(stream) && !generating_.key(stream) && !unavailable_.contains(stream)) {
+    Load(stream);
+  }
+
+  return s;
+}
+
+void ThumbnailCache::Generate(VideoStream *stream)
+{
+  if (generated_.contains(stream)) {
+    return;
+  }
+
+  generated_.insert(stream);
+  connect(stream, &QObject::destroyed, this, &ThumbnailCache::StreamDestroyed, Qt::UniqueConnection);
+
+  ThumbnailTask* task = new ThumbnailTask(stream);
+  generating_.insert(task, stream);
+  TaskManager::instance()->AddTask(task);
+}
+
+void ThumbnailCache::Load(VideoStream *stream)
+{
+  loading_.insert(stream);
+  connect(stream, &QObject::destroyed, this, &ThumbnailCache::StreamDestroyed, Qt::UniqueConnection);
+
+  // Work out the filename here, the stream must not be touched from the worker thread
+  QString filename = ThumbnailTask::GetThumbnailFilename(stream);
+
+  QFutureWatcher<LoadedThumbnails>* watcher = new QFutureWatcher<LoadedThumbnails>(this);
+
+  connect(watcher, &QFutureWatcher<LoadedThumbnails>::finished, this, [this, watcher, stream]{
+    LoadedThumbnails loaded = watcher->result();
+    watcher->deleteLater();
+
+    if (!loading_.remove(stream)) {
+      // Stream was deleted while we were loading
+      return;
+    }
+
+    if (loaded.valid) {
+      // QPixmaps can only be created on the main thread, they're what views paint fastest though
+      Strip* s = new Strip();
+      s->pixmap = QPixmap::fromImage(loaded.strip);
+      s->interval = loaded.interval;
+      s->count = loaded.count;
+
+      strips_.insert(stream, s, qMax(1, s->pixmap.width() * s->pixmap.height() * 4));
+
+      emit ThumbnailsReady(stream);
+    } else if (generated_.contains(stream)) {
+      // Generating didn't produce anything (e.g. it was cancelled or the stream can't be decoded)
+      unavailable_.insert(stream);
+    } else {
+      Generate(stream);
+    }
+  });
+
+  watcher->setFuture(QtConcurrent::run([filename]{
+    LoadedThumbnails loaded;
+    loaded.valid = ThumbnailTask::LoadThumbnails(filename, &loaded.strip, &loaded.interval, &loaded.count);
+    return loaded;
+  }));
+}
+
+void ThumbnailCache::StreamDestroyed(QObject *o)
+{
+  // Only used as a key, never dereferenced
+  VideoStream* stream = static_cast<VideoStream*>(o);
+
+  strips_.remove(stream);
+  loading_.remove(stream);
+  generated_.remove(stream);
+  unavailable_.remove(stream);
+
+  for (QHash<Task*, VideoStream*>::iterator i=generating_.begin(); i!=generating_.end(); ) {
+    if (i.value() == stream) {
+      TaskManager::instance()->CancelTask(i.key());
+      i = generating_.erase(i);
+    } else {
+      i++;
+    }
+  }
+}
+
+void ThumbnailCache::TaskRemoved(Task *t)
+{
+  VideoStream* stream = generating_.take(t);
+
+  if (stream) {
+    // Views will ask again and pick the strip up from disk
+    emit ThumbnailsReady(stream);
+  }
+}
+
+}
@@ -0,0 +1,112 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QCache>
+#include <QHash>
+#include <QPixmap>
+#include <QSet>
+
+#include "project/item/footage/videostream.h"
+#include "task/task.h"
+
+namespace olive {
+
+/**
+ * @brief Provides the thumbnail strips generated by ThumbnailTask to the UI
+ *
+ * Strips are loaded from disk on a worker thread the first time they're asked for and kept in
+ * memory (up to kMemoryBudget bytes, least recently used first) so views can repaint from them
+ * freely. If a stream has no strip on disk yet, a ThumbnailTask is queued for it, which renders
+ * in the background render class and yields to playback and interactive work.
+ *
+ * Since views only ask for what they're painting, visible items are always fetched first.
+ * ThumbnailsReady() is emitted whenever asking again may give a different result.
+ *
+ * This class must only be used from the main thread.
+ */
+class ThumbnailCache : public QObject
+{
+  Q_OBJECT
+public:
+  static void CreateInstance();
+
+  static void DestroyInstance();
+
+  static ThumbnailCache* instance();
+
+  struct Strip {
+    QPixmap pixmap;
+    rational interval;
+    int count;
+  };
+
+  /**
+   * @brief Retrieve a stream's thumbnail strip
+   *
+   * Returns nullptr if it isn't in memory, in which case it's loaded or generated in the
+   * background. The returned pointer is only valid until the next call.
+   */
+  const Strip* Get(VideoStream* stream);
+
+  /**
+   * @brief Queue thumbnail generation for a stream unless it's already queued or generated
+   */
+  void Generate(VideoStream* stream);
+
+  /**
+   * @brief Maximum size in bytes of all strips held in memory
+   */
+  static const int kMemoryBudget;
+
+signals:
+  void ThumbnailsReady(VideoStream* stream);
+
+private:
+  ThumbnailCache();
+
+  void Load(VideoStream* stream);
+
+  static ThumbnailCache* instance_;
+
+  QCache<VideoStream*, Strip> strips_;
+
+  QSet<VideoStream*> loading_;
+
+  QHash<Task*, VideoStream*> generating_;
+
+  /// Streams generation was already attempted for this session, so a failure isn't retried forever
+  QSet<VideoStream*> generated_;
+
+  /// Streams that still had nothing on disk after generating, not asked for again this session
+  QSet<VideoStream*> unavailable_;
+
+private slots:
+  void StreamDestroyed(QObject* o);
+
+  void TaskRemoved(Task* t);
+
+};
+
+}
+
+#endif // THUMBNAILCACHE_H
@@ -0,0 +1,211 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "thumbnailtask.h"
+
+#include <cmath>
+#include <QFileInfo>
+
+#include "codec/decoder.h"
+#include "common/filefunctions.h"
+#include "common/timecodefunctions.h"
+#include "project/item/footage/footage.h"
+#include "project/project.h"
+#include "render/colormanager.h"
+#include "render/rendermanager.h"
+
+namespace olive {
+
+const int ThumbnailTask::kThumbnailHeight = 72;
+const int ThumbnailTask::kMaxThumbnailCount = 600;
+
+ThumbnailTask::ThumbnailTask(VideoStream *stream) :
+  RenderTask(new ViewerOutput(), GenerateThumbnailParams(stream), AudioParams()),
+  stream_(stream)
+{
+  viewer()->set_video_params(video_params());
+
+  video_node_ = new MediaInput();
+  video_node_->SetStream(stream);
+
+  NodeParam::ConnectEdge(video_node_->output(), viewer()->texture_input());
+
+  SetTitle(tr("Generating thumbnails for %1:%2").arg(stream->footage()->filename(),
+                                                     QString::number(stream->index())));
+}
+
+ThumbnailTask::~ThumbnailTask()
+{
+  // We created these nodes ourselves, so now we should delete them
+  delete viewer();
+  delete video_node_;
+}
+
+QString ThumbnailTask::GetThumbnailFilename(VideoStream *stream)
+{
+  return Decoder::GetCacheFilename(stream, QStringLiteral(".thumbs.png"));
+}
+
+bool ThumbnailTask::LoadThumbnails(VideoStream *stream, QImage *strip, rational *interval, int *count)
+{
+  return LoadThumbnails(GetThumbnailFilename(stream), strip, interval, count);
+}
+
+bool ThumbnailTask::LoadThumbnails(const QString &filename, QImage *strip, rational *interval, int *count)
+{
+  QImage img;
+
+  if (!img.load(filename)) {
+    return false;
+  }
+
+  rational i = rational::fromString(img.text(QStringLiteral("interval")));
+  int c = img.text(QStringLiteral("count")).toInt();
+
+  if (i.isNull() || c <= 0) {
+    return false;
+  }
+
+  *strip = img;
+  *interval = i;
+  *count = c;
+
+  return true;
+}
+
+bool ThumbnailTask::Run()
+{
+  QString thumbnail_fn = GetThumbnailFilename(stream_);
+
+  if (QFileInfo::exists(thumbnail_fn)) {
+    // Already generated in an earlier session
+    return true;
+  }
+
+  ColorManager* color_manager = stream_->footage()->project()->color_manager();
+
+  // Thumbnails are only ever displayed so they're stored display-referred
+  QString display = color_manager->GetDefaultDisplay();
+  ColorProcessorPtr color_processor = ColorProcessor::Create(color_manager,
+                                                             color_manager->GetReferenceColorSpace(),
+                                                             ColorTransform(display, color_manager->GetDefaultView(display), QString()));
+
+  thumbnails_.clear();
+
+  // Still images only need the one
+  rational length = (stream_->video_type() == VideoStream::kVideoTypeStill) ? video_params().time_base() : viewer()->GetLength();
+
+  // Thumbnails are tiny so proxies are more than good enough if they exist
+  Render(color_manager,
+         {TimeRange(0, length)},
+         TimeRangeList(),
+         RenderMode::kOffline,
+         nullptr,
+         QSize(0, 0),
+         QMatrix4x4(),
+         VideoParams::kFormatUnsigned8,
+         color_processor);
+
+  if (IsCancelled() || thumbnails_.isEmpty()) {
+    thumbnails_.clear();
+    return true;
+  }
+
+  int thumb_width = thumbnails_.first()->width();
+  int thumb_height = thumbnails_.first()->height();
+
+  QImage strip(thumb_width * thumbnails_.size(), thumb_height, QImage::Format_RGBA8888);
+  strip.fill(Qt::transparent);
+  strip.setText(QStringLiteral("interval"), video_params().time_base().toString());
+  strip.setText(QStringLiteral("count"), QString::number(thumbnails_.size()));
+
+  int x = 0;
+
+  foreach (FramePtr frame, thumbnails_) {
+    if (frame->channel_count() == VideoParams::kRGBAChannelCount
+        && frame->width() == thumb_width && frame->height() == thumb_height) {
+      for (int y=0; y<thumb_height; y++) {
+        memcpy(strip.scanLine(y) + x * VideoParams::kRGBAChannelCount,
+               frame->const_data() + y * frame->linesize_bytes(),
+               thumb_width * VideoParams::kRGBAChannelCount);
+      }
+    }
+
+    x += thumb_width;
+  }
+
+  thumbnails_.clear();
+
+  // Write to a temporary file first so a partially written strip is never loaded
+  QString working_fn = FileFunctions::GetSafeTemporaryFilename(thumbnail_fn);
+
+  if (!strip.save(working_fn, "PNG")
+      || !FileFunctions::RenameFileAllowOverwrite(working_fn, thumbnail_fn)) {
+    SetError(tr("Failed to save thumbnails to \"%1\"").arg(thumbnail_fn));
+    QFile::remove(working_fn);
+    return false;
+  }
+
+  return true;
+}
+
+void ThumbnailTask::FrameDownloaded(FramePtr frame, const QByteArray &hash, const QVector<rational> &times, qint64 job_time)
+{
+  Q_UNUSED(hash)
+  Q_UNUSED(job_time)
+
+  foreach (const rational& t, times) {
+    thumbnails_.insert(t, frame);
+  }
+
+  // Only one frame is in flight at a time, so holding off here holds off the next render
+  RenderManager::instance()->WaitForMoreUrgentTickets(RenderManager::kPriorityBackground, &IsCancelled());
+}
+
+void ThumbnailTask::AudioDownloaded(const TimeRange &range, SampleBufferPtr samples, qint64 job_time)
+{
+  // Thumbnails are video only
+
+  Q_UNUSED(range)
+  Q_UNUSED(samples)
+  Q_UNUSED(job_time)
+}
+
+VideoParams ThumbnailTask::GenerateThumbnailParams(VideoStream *stream)
+{
+  // Space thumbnails at least a second apart, further for long streams
+  int64_t interval = 1;
+
+  if (stream->video_type() != VideoStream::kVideoTypeStill) {
+    rational length = Timecode::timestamp_to_time(stream->duration(), stream->timebase());
+    interval = qMax(interval, static_cast<int64_t>(std::ceil(length.toDouble() / kMaxThumbnailCount)));
+  }
+
+  return VideoParams(stream->width(),
+                     stream->height(),
+                     rational(interval),
+                     VideoParams::kFormatUnsigned8,
+                     VideoParams::kRGBAChannelCount,
+                     stream->pixel_aspect_ratio(),
+                     stream->interlacing(),
+                     qMax(1, stream->height() / kThumbnailHeight));
+}
+
+}
@@ -0,0 +1,117 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef THUMBNAILTASK_H
+#define THUMBNAILTASK_H
+
+#include <QImage>
+
+#include "node/input/media/media.h"
+#include "project/item/footage/videostream.h"
+#include "task/render/render.h"
+
+namespace olive {
+
+/**
+ * @brief Precomputes a strip of small thumbnails of a video stream in the background
+ *
+ * Frames are rendered at evenly spaced intervals (at least one second apart, and no more than
+ * kMaxThumbnailCount total) in the default display color space and stitched left to right into a
+ * single image saved in the project's cache. Use LoadThumbnails() to retrieve it.
+ *
+ * Only one frame is rendered at a time and rendering is paused whenever interactive or playback
+ * tickets are waiting in the RenderManager so this never holds up the user.
+ */
+class ThumbnailTask : public RenderTask
+{
+  Q_OBJECT
+public:
+  ThumbnailTask(VideoStream* stream);
+
+  virtual ~ThumbnailTask() override;
+
+  /**
+   * @brief Returns the filename this stream's thumbnails are saved to
+   */
+  static QString GetThumbnailFilename(VideoStream* stream);
+
+  /**
+   * @brief Load thumbnails generated by this task
+   *
+   * `strip` is set to the thumbnails laid out left to right, `interval` to the time between each
+   * and `count` to how many there are. Thumbnail `i` shows the frame at `i * interval` and is
+   * `strip->width() / count` pixels wide. Returns FALSE if no thumbnails have been generated yet.
+   */
+  static bool LoadThumbnails(VideoStream* stream, QImage* strip, rational* interval, int* count);
+
+  /**
+   * @brief Load thumbnails from a file returned by GetThumbnailFilename()
+   *
+   * Doesn't touch the stream so it's safe to call from any thread.
+   */
+  static bool LoadThumbnails(const QString& filename, QImage* strip, rational* interval, int* count);
+
+  /**
+   * @brief Approximate height of each thumbnail in pixels
+   */
+  static const int kThumbnailHeight;
+
+  /**
+   * @brief Maximum number of thumbnails generated for one stream
+   */
+  static const int kMaxThumbnailCount;
+
+  virtual Priority GetPriority() const override
+  {
+    // Thumbnails are shown as soon as they're ready
+    return kPriorityHigh;
+  }
+
+protected:
+  virtual bool Run() override;
+
+  virtual void FrameDownloaded(FramePtr frame, const QByteArray& hash, const QVector<rational>& times, qint64 job_time) override;
+
+  virtual void AudioDownloaded(const TimeRange& range, SampleBufferPtr samples, qint64 job_time) override;
+
+  virtual bool TwoStepFrameRendering() const override
+  {
+    return false;
+  }
+
+  virtual int GetMaximumFramesInFlight() const override
+  {
+    return 1;
+  }
+
+private:
+  static VideoParams GenerateThumbnailParams(VideoStream* stream);
+
+  VideoStream* stream_;
+
+  MediaInput* video_node_;
+
+  QMap<rational, FramePtr> thumbnails_;
+
+};
+
+}
+
+#endif // THUMBNAILTASK_H
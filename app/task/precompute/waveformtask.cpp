@@ -0,0 +1,201 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "waveformtask.h"
+
+#include <QFileInfo>
+
+#include "codec/decoder.h"
+#include "common/filefunctions.h"
+#include "common/timecodefunctions.h"
+#include "config/config.h"
+#include "project/item/footage/footage.h"
+#include "render/rendermanager.h"
+
+namespace olive {
+
+const rational WaveformTask::kChunkLength = rational(10);
+
+WaveformTask::WaveformTask(Footage *footage) :
+  footage_(footage)
+{
+  SetTitle(tr("Generating waveforms for %1").arg(footage->filename()));
+}
+
+QString WaveformTask::GetWaveformFilename(AudioStream *stream)
+{
+  AudioParams params = GetWaveformParams();
+
+  return Decoder::GetCacheFilename(stream, QStringLiteral(".%1.%2.waveform").arg(QString::number(params.sample_rate()),
+                                                                                  QString::number(params.channel_layout())));
+}
+
+bool WaveformTask::LoadWaveform(AudioStream *stream, AudioVisualWaveform *waveform)
+{
+  // Footage waveforms are only ever drawn so there's no reason to read them into memory
+  QString fn = GetWaveformFilename(stream);
+  return waveform->Map(fn) || waveform->Load(fn);
+}
+
+bool WaveformTask::Run()
+{
+  QVector<Stream*> streams;
+
+  foreach (Stream* s, footage_->streams()) {
+    if (s->type() == Stream::kAudio
+        && s->enabled()
+        && !QFileInfo::exists(GetWaveformFilename(static_cast<AudioStream*>(s)))) {
+      streams.append(s);
+    }
+  }
+
+  if (streams.isEmpty()) {
+    // Already generated in an earlier session
+    return true;
+  }
+
+  DecoderPtr decoder = Decoder::CreateFromID(footage_->decoder());
+
+  if (!decoder || !decoder->Open(streams.first())) {
+    SetError(tr("Failed to open decoder"));
+    return false;
+  }
+
+  AudioParams params = GetWaveformParams();
+
+  // Don't compete with anything the user is waiting on
+  WaitIfPaused();
+  RenderManager::instance()->WaitForMoreUrgentTickets(RenderManager::kPriorityBackground, &IsCancelled());
+
+  if (IsCancelled()) {
+    decoder->Close();
+    return true;
+  }
+
+  // Conforming takes up the first half of the progress, summarizing the conforms the second
+  connect(decoder.get(), &Decoder::IndexProgress, this, [this](double progress){
+    emit ProgressChanged(progress * 0.5);
+  }, Qt::DirectConnection);
+
+  // Conform every stream in a single read of the file rather than one read per stream
+  bool conformed = decoder->ConformAudio(streams, params, &IsCancelled());
+
+  if (!conformed) {
+    decoder->Close();
+
+    if (IsCancelled()) {
+      return true;
+    }
+
+    SetError(tr("Failed to conform audio"));
+    return false;
+  }
+
+  for (int i=0; i<streams.size(); i++) {
+    AudioStream* stream = static_cast<AudioStream*>(streams.at(i));
+
+    if (i > 0) {
+      // Decoders are opened per stream, reopen on the one we're summarizing
+      decoder->Close();
+
+      if (!decoder->Open(stream)) {
+        SetError(tr("Failed to open decoder"));
+        return false;
+      }
+    }
+
+    double progress_start = 0.5 + 0.5 * i / streams.size();
+    double progress_end = 0.5 + 0.5 * (i + 1) / streams.size();
+
+    if (!GenerateWaveform(decoder.get(), stream, params, progress_start, progress_end)) {
+      decoder->Close();
+      return false;
+    }
+
+    if (IsCancelled()) {
+      break;
+    }
+  }
+
+  decoder->Close();
+
+  return true;
+}
+
+bool WaveformTask::GenerateWaveform(Decoder* decoder, AudioStream *stream, const AudioParams &params,
+                                    double progress_start, double progress_end)
+{
+  rational length = Timecode::timestamp_to_time(stream->duration(), stream->timebase());
+
+  AudioVisualWaveform waveform;
+  waveform.set_channel_count(params.channel_count());
+
+  for (rational t; t<length; t+=kChunkLength) {
+    WaitIfPaused();
+
+    // Don't compete with anything the user is waiting on
+    RenderManager::instance()->WaitForMoreUrgentTickets(RenderManager::kPriorityBackground, &IsCancelled());
+
+    if (IsCancelled()) {
+      return true;
+    }
+
+    // The stream has already been conformed so this just reads from the conform
+    SampleBufferPtr samples = decoder->RetrieveAudio(TimeRange(t, qMin(t + kChunkLength, length)),
+                                                     params, &IsCancelled());
+
+    if (!samples) {
+      if (IsCancelled()) {
+        return true;
+      }
+
+      SetError(tr("Failed to retrieve audio"));
+      return false;
+    }
+
+    waveform.OverwriteSamples(samples, params.sample_rate(), t);
+
+    double chunk_progress = qMin(1.0, (t + kChunkLength).toDouble() / length.toDouble());
+    emit ProgressChanged(progress_start + (progress_end - progress_start) * chunk_progress);
+  }
+
+  // Write to a temporary file first so a partially written waveform is never loaded
+  QString waveform_fn = GetWaveformFilename(stream);
+  QString working_fn = FileFunctions::GetSafeTemporaryFilename(waveform_fn);
+
+  if (!waveform.Save(working_fn)
+      || !FileFunctions::RenameFileAllowOverwrite(working_fn, waveform_fn)) {
+    SetError(tr("Failed to save waveform to \"%1\"").arg(waveform_fn));
+    QFile::remove(working_fn);
+    return false;
+  }
+
+  return true;
+}
+
+AudioParams WaveformTask::GetWaveformParams()
+{
+  // Use the same parameters new sequences do so the conform doubles as the one used for editing
+  return AudioParams(Config::Current()["DefaultSequenceAudioFrequency"].toInt(),
+                     Config::Current()["DefaultSequenceAudioLayout"].toULongLong(),
+                     AudioParams::kInternalFormat);
+}
+
+}
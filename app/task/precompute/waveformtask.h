@@ -0,0 +1,95 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef WAVEFORMTASK_H
+#define WAVEFORMTASK_H
+
+#include "audio/audiovisualwaveform.h"
+#include "codec/decoder.h"
+#include "project/item/footage/audiostream.h"
+#include "render/audioparams.h"
+#include "task/task.h"
+
+namespace olive {
+
+/**
+ * @brief Precomputes the visual waveforms of a footage file's audio streams in the background
+ *
+ * Every audio stream is conformed to the default sequence audio parameters in a single pass over
+ * the file (so the conforms are ready by the time the footage is first edited) and summarized
+ * into an AudioVisualWaveform saved next to its conform. Use LoadWaveform() to retrieve them.
+ *
+ * Decoding is paused whenever interactive or playback tickets are waiting in the RenderManager so
+ * this doesn't compete with the user scrubbing or playing back.
+ */
+class WaveformTask : public Task
+{
+  Q_OBJECT
+public:
+  WaveformTask(Footage* footage);
+
+  /**
+   * @brief Returns the filename this stream's waveform is saved to
+   */
+  static QString GetWaveformFilename(AudioStream* stream);
+
+  /**
+   * @brief Load a waveform generated by this task, returns FALSE if none has been generated yet
+   */
+  static bool LoadWaveform(AudioStream* stream, AudioVisualWaveform* waveform);
+
+  virtual Priority GetPriority() const override
+  {
+    // Waveforms are shown as soon as they're ready
+    return kPriorityHigh;
+  }
+
+  virtual Resource GetResource() const override
+  {
+    // Reading the whole file to conform it takes far longer than summarizing it
+    return kResourceIO;
+  }
+
+protected:
+  virtual bool Run() override;
+
+private:
+  static AudioParams GetWaveformParams();
+
+  /**
+   * @brief Summarize a conformed stream and save its waveform
+   *
+   * Progress is reported from `progress_start` to `progress_end`.
+   */
+  bool GenerateWaveform(Decoder* decoder, AudioStream* stream, const AudioParams& params,
+                        double progress_start, double progress_end);
+
+  /**
+   * @brief Length of audio decoded and summarized at a time
+   */
+  static const rational kChunkLength;
+
+  Footage* footage_;
+
+};
+
+}
+
+#endif // WAVEFORMTASK_H
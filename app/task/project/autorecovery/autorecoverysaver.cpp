@@ -0,0 +1,147 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "autorecoverysaver.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrent>
+
+#include "common/filefunctions.h"
+#include "core.h"
+#include "task/project/savebinary/savebinary.h"
+
+namespace olive {
+
+const int AutorecoverySaver::kMaxRestarts = 5;
+
+AutorecoverySaver::AutorecoverySaver(Project *project) :
+  QObject(project),
+  project_(project),
+  restarts_(0),
+  project_changed_(false)
+{
+  connect(Core::instance()->undo_stack(), &UndoStack::indexChanged, this, &AutorecoverySaver::UndoStackChanged);
+  connect(&watcher_, &QFutureWatcher<bool>::finished, this, &AutorecoverySaver::SnapshotWritten);
+}
+
+void AutorecoverySaver::Start()
+{
+  sequences_.clear();
+  sequence_xml_.clear();
+  project_xml_.clear();
+  project_changed_ = false;
+
+  // Serialize the project itself with sequences split out, they're serialized one at a time after
+  QXmlStreamWriter writer(&project_xml_);
+  ProjectSaveTask::WriteProjectDocument(&writer, project_, &sequences_);
+
+  sequence_xml_.reserve(sequences_.size());
+
+  QTimer::singleShot(0, this, &AutorecoverySaver::SerializeNext);
+}
+
+QString AutorecoverySaver::GetAutorecoveryFilename(Project *project)
+{
+  QDir dir(QDir(FileFunctions::GetConfigurationLocation()).filePath(QStringLiteral("autorecovery")));
+  dir.mkpath(QStringLiteral("."));
+
+  // Name after the project's file if it has one, otherwise this instance
+  QString id = project->filename().isEmpty()
+      ? QString::number(reinterpret_cast<quintptr>(project), 16)
+      : QString(QCryptographicHash::hash(project->filename().toUtf8(), QCryptographicHash::Sha1).toHex().left(16));
+
+  return dir.filePath(QStringLiteral("%1-%2.ovb").arg(project->name(), id));
+}
+
+bool AutorecoverySaver::WriteSnapshot(const QString &filename, QByteArray project_xml, QVector<QByteArray> sequence_xml)
+{
+  QVector<ProjectSaveBinaryTask::Chunk> chunks(sequence_xml.size() + 1);
+
+  chunks[0] = {ProjectSaveBinaryTask::kChunkProject, 0, ProjectSaveBinaryTask::CompressChunk(project_xml)};
+
+  for (int i=0; i<sequence_xml.size(); i++) {
+    chunks[i + 1] = {ProjectSaveBinaryTask::kChunkSequence, static_cast<quint32>(i), ProjectSaveBinaryTask::CompressChunk(sequence_xml.at(i))};
+  }
+
+  QString error;
+
+  if (!ProjectSaveBinaryTask::WriteChunks(filename, chunks, &error)) {
+    qWarning() << "Failed to save autorecovery:" << error;
+    return false;
+  }
+
+  return true;
+}
+
+void AutorecoverySaver::SerializeNext()
+{
+  if (project_changed_) {
+    // Part of the snapshot is out of date, start over
+    if (restarts_ < kMaxRestarts) {
+      restarts_++;
+      Start();
+    } else {
+      emit Finished(false);
+      deleteLater();
+    }
+    return;
+  }
+
+  if (sequence_xml_.size() < sequences_.size()) {
+    Sequence* sequence = sequences_.at(sequence_xml_.size());
+
+    QByteArray xml;
+
+    {
+      QXmlStreamWriter writer(&xml);
+      writer.writeStartElement(QStringLiteral("sequence"));
+      sequence->Save(&writer);
+      writer.writeEndElement(); // sequence
+    }
+
+    sequence_xml_.append(xml);
+
+    QTimer::singleShot(0, this, &AutorecoverySaver::SerializeNext);
+    return;
+  }
+
+  // Snapshot is complete, hand it off to be written. These are all copy-on-write so the worker
+  // takes them without copying any data.
+  watcher_.setFuture(QtConcurrent::run(&AutorecoverySaver::WriteSnapshot,
+                                       GetAutorecoveryFilename(project_),
+                                       project_xml_,
+                                       sequence_xml_));
+}
+
+void AutorecoverySaver::UndoStackChanged()
+{
+  project_changed_ = true;
+}
+
+void AutorecoverySaver::SnapshotWritten()
+{
+  emit Finished(watcher_.result() && !project_changed_);
+  deleteLater();
+}
+
+}
@@ -0,0 +1,105 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUTORECOVERYSAVER_H
+#define AUTORECOVERYSAVER_H
+
+#include <QFutureWatcher>
+#include <QObject>
+
+#include "project/project.h"
+
+namespace olive {
+
+/**
+ * @brief Saves an autorecovery copy of a project without stalling the UI thread
+ *
+ * Serializing has to happen in the main thread since it reads the live project, but it's split up
+ * so that each event loop iteration only serializes one sequence, keeping interactive stalls short
+ * even in large projects. Compressing and writing the snapshot (the slow part) happens in a
+ * worker thread. The file is written in the binary project format (see ProjectSaveBinaryTask).
+ *
+ * If the undo stack changes partway through serializing, the snapshot would be inconsistent so it
+ * starts again from the beginning.
+ *
+ * The saver is parented to its project and deletes itself once it's done.
+ */
+class AutorecoverySaver : public QObject
+{
+  Q_OBJECT
+public:
+  AutorecoverySaver(Project* project);
+
+  /**
+   * @brief Begin serializing the project
+   */
+  void Start();
+
+  /**
+   * @brief Returns the file autorecovery data for `project` is written to
+   */
+  static QString GetAutorecoveryFilename(Project* project);
+
+signals:
+  /**
+   * @brief Emitted once the snapshot has been written or failed
+   *
+   * `up_to_date` is TRUE if the project was saved successfully and didn't change since its snapshot
+   * was taken.
+   */
+  void Finished(bool up_to_date);
+
+private:
+  /**
+   * @brief Write a serialized snapshot to disk, runs in a worker thread
+   */
+  static bool WriteSnapshot(const QString& filename, QByteArray project_xml, QVector<QByteArray> sequence_xml);
+
+  /**
+   * @brief Number of times serializing may restart before waiting for the next autorecovery
+   */
+  static const int kMaxRestarts;
+
+  Project* project_;
+
+  QVector<Sequence*> sequences_;
+
+  QByteArray project_xml_;
+
+  QVector<QByteArray> sequence_xml_;
+
+  int restarts_;
+
+  bool project_changed_;
+
+  QFutureWatcher<bool> watcher_;
+
+private slots:
+  void SerializeNext();
+
+  void UndoStackChanged();
+
+  void SnapshotWritten();
+
+};
+
+}
+
+#endif // AUTORECOVERYSAVER_H
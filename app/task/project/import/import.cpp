@@ -22,6 +22,8 @@
 
 #include <QDir>
 #include <QFileInfo>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
 
 #include "config/config.h"
 #include "core.h"
@@ -52,227 +54,383 @@ bool ProjectImportTask::Run()
 {
   command_ = new QUndoCommand();
 
-  int imported = 0;
+  processed_count_ = 0;
 
-  Import(folder_, filenames_, imported, command_);
+  QVector<ImportDirectory> directories = EnumerateDirectories();
+
+  QVector<ImportItem> items;
+
+  foreach (const ImportDirectory& dir, directories) {
+    if (dir.folder) {
+      items.append(GroupImageSequences(dir.folder, dir.files));
+    }
+  }
+
+  // Only the first file of each possible image sequence is probed, the rest of the sequence is
+  // only probed if it turns out not to be one
+  QStringList first_files;
+
+  foreach (const ImportItem& item, items) {
+    first_files.append(item.filenames.first());
+  }
+
+  QVector<Footage*> footage = ProbeFiles(first_files);
+
+  QVector<ImportItem> rejected_sequences;
+
+  for (int i=0; i<items.size(); i++) {
+    const ImportItem& item = items.at(i);
+    Footage* f = footage.at(i);
+
+    if (IsCancelled()) {
+      delete f;
+      continue;
+    }
+
+    if (item.filenames.size() > 1) {
+      bool is_sequence = false;
+
+      if (f && ItemIsStillImageFootageOnly(f)) {
+        // This file is a still image with a number at the end of the filename followed by
+        // adjacent numbers. It could be an image sequence! But let's ask the user just in case...
+        QMetaObject::invokeMethod(Core::instance(),
+                                  "ConfirmImageSequence",
+                                  Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(bool, is_sequence),
+                                  Q_ARG(QString, f->filename()));
+      }
+
+      if (is_sequence) {
+        SetImageSequence(f, item.start_index, item.filenames.size());
+
+        FilesProcessed(item.filenames.size() - 1);
+      } else {
+        // Import the rest of the files individually
+        rejected_sequences.append({item.folder, item.filenames.mid(1), 0});
+      }
+    }
+
+    AddFootage(item.folder, item.filenames.first(), f);
+  }
+
+  if (!rejected_sequences.isEmpty() && !IsCancelled()) {
+    QStringList remaining_files;
+
+    foreach (const ImportItem& item, rejected_sequences) {
+      remaining_files.append(item.filenames);
+    }
+
+    footage = ProbeFiles(remaining_files);
+
+    int footage_index = 0;
+
+    foreach (const ImportItem& item, rejected_sequences) {
+      foreach (const QString& fn, item.filenames) {
+        Footage* f = footage.at(footage_index);
+
+        if (IsCancelled()) {
+          delete f;
+        } else {
+          AddFootage(item.folder, fn, f);
+        }
+
+        footage_index++;
+      }
+    }
+  }
 
   if (IsCancelled()) {
     delete command_;
     command_ = nullptr;
+
+    // Footage isn't owned by any command yet
+    foreach (const QVector<Item*>& list, folder_footage_) {
+      qDeleteAll(list);
+    }
+    imported_footage_.clear();
+
     return false;
   } else {
+    // Add each folder's footage in one go so views insert the rows once rather than per file
+    foreach (Folder* folder, footage_folders_) {
+      new ProjectViewModel::AddItemsCommand(model_,
+                                            folder,
+                                            folder_footage_.value(folder),
+                                            command_);
+    }
+
     return true;
   }
 }
 
-void ProjectImportTask::Import(Folder *folder, QFileInfoList import, int &counter, QUndoCommand* parent_command)
+QVector<ProjectImportTask::ImportDirectory> ProjectImportTask::EnumerateDirectories()
 {
-  for (int i=0; i<import.size(); i++) {
-    if (IsCancelled()) {
-      break;
-    }
+  QVector<ImportDirectory> directories;
 
-    const QFileInfo& file_info = import.at(i);
+  // The files passed to this task act as a directory of their own that imports into `folder_`
+  directories.append({QString(), QString(), -1, folder_, QFileInfoList()});
 
-    // Check if this file is a directory
-    if (file_info.isDir()) {
+  QVector<int> level;
 
-      // QDir::entryList only returns filenames, we can use entryInfoList() to get full paths
-      QFileInfoList entry_list = QDir(file_info.absoluteFilePath()).entryInfoList();
+  SortDirectoryEntries(directories, 0, filenames_, level);
 
-      // Strip out "." and ".." (for some reason QDir::NoDotAndDotDot	doesn't work with entryInfoList, so we have to
-      // check manually)
-      for (int j=0;j<entry_list.size();j++) {
-        if (entry_list.at(j).fileName() == QStringLiteral(".")
-            || entry_list.at(j).fileName() == QStringLiteral("..")) {
-          entry_list.removeAt(j);
-          j--;
-        }
-      }
+  while (!level.isEmpty() && !IsCancelled()) {
+    QStringList paths;
 
-      // Only proceed if the empty actually has files in it
-      if (!entry_list.isEmpty()) {
-        // Create a folder corresponding to the directory
-        Folder* f = new Folder();
+    foreach (int index, level) {
+      paths.append(directories.at(index).path);
+    }
 
-        f->moveToThread(folder->thread());
+    // Listing a directory is mostly waiting on the filesystem, so list a whole level of the tree
+    // at once rather than one directory at a time
+    QList<QFileInfoList> listings = QtConcurrent::blockingMapped< QList<QFileInfoList> >(paths, &ListDirectory);
 
-        f->set_name(file_info.fileName());
+    QVector<int> next_level;
 
-        // Create undoable command that adds the items to the model
-        new ProjectViewModel::AddItemCommand(model_,
-                                             folder,
-                                             f,
-                                             parent_command);
+    for (int i=0; i<level.size(); i++) {
+      const QFileInfoList& entry_list = listings.at(i);
 
-        // Recursively follow this path
-        Import(f, entry_list, counter, parent_command);
+      // Only proceed if the directory actually has files in it
+      if (entry_list.isEmpty()) {
+        continue;
       }
 
-    } else {
+      int index = level.at(i);
 
-      Footage* footage = Decoder::Probe(model_->project(), file_info.absoluteFilePath(),
-                                        &IsCancelled());
+      // Create a folder corresponding to the directory
+      Folder* f = new Folder();
 
-      if (footage) {
-        // Move footage to main thread
-        footage->moveToThread(folder->thread());
+      f->moveToThread(folder_->thread());
 
-        // See if this footage is an image sequence
-        ValidateImageSequence(footage, import, i);
+      f->set_name(directories.at(index).name);
 
-        // Create undoable command that adds the items to the model
-        new ProjectViewModel::AddItemCommand(model_,
-                                             folder,
-                                             footage,
-                                             parent_command);
-      } else {
-        // Add to list so we can tell the user about it later
-        invalid_files_.append(file_info.absoluteFilePath());
-      }
+      // Create undoable command that adds the items to the model
+      new ProjectViewModel::AddItemCommand(model_,
+                                           directories.at(directories.at(index).parent).folder,
+                                           f,
+                                           command_);
 
-      counter++;
+      directories[index].folder = f;
 
-      emit ProgressChanged(static_cast<double>(counter) / static_cast<double>(file_count_));
+      SortDirectoryEntries(directories, index, entry_list, next_level);
+    }
+
+    level = next_level;
+  }
+
+  return directories;
+}
 
+void ProjectImportTask::SortDirectoryEntries(QVector<ImportDirectory> &directories, int index,
+                                             const QFileInfoList &entries, QVector<int> &subdirectories)
+{
+  foreach (const QFileInfo& info, entries) {
+    if (info.isDir()) {
+      subdirectories.append(directories.size());
+      directories.append({info.absoluteFilePath(), info.fileName(), index, nullptr, QFileInfoList()});
+    } else {
+      directories[index].files.append(info);
     }
   }
 }
 
-void ProjectImportTask::ValidateImageSequence(Footage *footage, QFileInfoList& info_list, int index)
+QFileInfoList ProjectImportTask::ListDirectory(const QString &path)
 {
-  // Heuristically determine whether this file is part of an image sequence or not
-  VideoStream* video_stream = static_cast<VideoStream*>(footage->streams().first());
+  QFileInfoList entry_list = QDir(path).entryInfoList();
+
+  // Strip out "." and ".." (for some reason QDir::NoDotAndDotDot	doesn't work with entryInfoList, so we have to
+  // check manually)
+  for (int j=0;j<entry_list.size();j++) {
+    if (entry_list.at(j).fileName() == QStringLiteral(".")
+        || entry_list.at(j).fileName() == QStringLiteral("..")) {
+      entry_list.removeAt(j);
+      j--;
+    }
+  }
 
-  // By this point we've established that video contains a single still image stream. Now we'll
-  // see if it ends with numbers.
-  if (Decoder::GetImageSequenceDigitCount(footage->filename()) > 0
-      && !image_sequence_ignore_files_.contains(footage->filename())) {
-    QSize dim(video_stream->width(), video_stream->height());
-
-    int64_t ind = Decoder::GetImageSequenceIndex(footage->filename());
-
-    // Check if files around exist around it with that follow a sequence
-    QString previous_img_fn = Decoder::TransformImageSequenceFileName(footage->filename(), ind - 1);
-    QString next_img_fn = Decoder::TransformImageSequenceFileName(footage->filename(), ind + 1);
-
-    // See if the same decoder can retrieve surrounding files
-    DecoderPtr decoder = Decoder::CreateFromID(footage->decoder());
-    Footage* previous_file = decoder->Probe(previous_img_fn, nullptr);
-    Footage* next_file = decoder->Probe(next_img_fn, nullptr);
-
-    // Finally see if these files have the same dimensions
-    if ((previous_file && CompareStillImageSize(previous_file, dim))
-        || (next_file && CompareStillImageSize(next_file, dim))) {
-      // By this point, we've established this file is a still image with a number at the end of
-      // the filename surrounded by adjacent numbers. It could be a still image! But let's ask the
-      // user just in case...
-      bool is_sequence;
-
-      QMetaObject::invokeMethod(Core::instance(),
-                                "ConfirmImageSequence",
-                                Qt::BlockingQueuedConnection,
-                                Q_RETURN_ARG(bool, is_sequence),
-                                Q_ARG(QString, footage->filename()));
-
-      int64_t seq_index = Decoder::GetImageSequenceIndex(footage->filename());
-
-      // Heuristic to find the first and last images (users can always override this later in
-      // FootagePropertiesDialog)
-      int64_t start_index = GetImageSequenceLimit(footage->filename(), seq_index, false);
-      int64_t end_index = GetImageSequenceLimit(footage->filename(), seq_index, true);
-
-      // Depending on the user's choice, either remove them from the list or don't ask for the
-      // remainders
-      for (int64_t j=start_index; j<=end_index; j++) {
-        QString entry_fn = Decoder::TransformImageSequenceFileName(footage->filename(), j);
-
-        if (is_sequence) {
-          // If this is part of the sequence we're importing here, remove it
-          for (int i=index+1; i<info_list.size(); i++) {
-            if (info_list.at(i).absoluteFilePath() == entry_fn) {
-              if (is_sequence) {
-                info_list.removeAt(i);
-              }
-              break;
-            }
-          }
-        } else {
-          image_sequence_ignore_files_.append(entry_fn);
-        }
-      }
+  return entry_list;
+}
 
-      if (is_sequence) {
-        // User has confirmed it is a still image, let's set it accordingly.
-        video_stream->set_video_type(VideoStream::kVideoTypeImageSequence);
+QVector<ProjectImportTask::ImportItem> ProjectImportTask::GroupImageSequences(Folder *folder, const QFileInfoList &files)
+{
+  struct NumberedFile {
+    QString key;
+    int64_t index;
+    int file;
+  };
 
-        rational default_timebase = Config::Current()["DefaultSequenceFrameRate"].value<rational>();
-        video_stream->set_timebase(default_timebase);
-        video_stream->set_frame_rate(default_timebase.flipped());
+  QVector<ImportItem> items;
+  QVector<NumberedFile> numbered;
 
-        video_stream->set_start_time(start_index);
-        video_stream->set_duration(end_index - start_index + 1);
-      }
+  for (int i=0; i<files.size(); i++) {
+    QString key;
+    int64_t index;
+
+    if (GetImageSequenceKey(files.at(i).fileName(), &key, &index)) {
+      numbered.append({key, index, i});
+    } else {
+      items.append({folder, {files.at(i).absoluteFilePath()}, 0});
     }
   }
+
+  // Sorting by key and then number puts every run of consecutive files next to each other
+  std::sort(numbered.begin(), numbered.end(), [](const NumberedFile& a, const NumberedFile& b){
+    if (a.key != b.key) {
+      return a.key < b.key;
+    }
+
+    return a.index < b.index;
+  });
+
+  for (int i=0; i<numbered.size(); i++) {
+    const NumberedFile& n = numbered.at(i);
+
+    if (i > 0
+        && numbered.at(i-1).key == n.key
+        && numbered.at(i-1).index + 1 == n.index) {
+      items.last().filenames.append(files.at(n.file).absoluteFilePath());
+    } else {
+      items.append({folder, {files.at(n.file).absoluteFilePath()}, n.index});
+    }
+  }
+
+  return items;
 }
 
-bool ProjectImportTask::ItemIsStillImageFootageOnly(Footage* footage)
+bool ProjectImportTask::GetImageSequenceKey(const QString &filename, QString *key, int64_t *index)
 {
-  if (footage->stream_count() != 1) {
-    // Footage with more than one stream (usually video+audio) most likely isn't an image sequence
-    return false;
+  // Matches QFileInfo::baseName(), which is what Decoder uses to find the sequence number
+  int base_length = filename.indexOf('.');
+
+  if (base_length == -1) {
+    base_length = filename.size();
   }
 
-  if (footage->streams().first()->type() != Stream::kVideo) {
-    // Footage with no video stream definitely isn't an image sequence
+  int digit_count = 0;
+
+  while (digit_count < base_length && filename.at(base_length - digit_count - 1).isDigit()) {
+    digit_count++;
+  }
+
+  if (!digit_count) {
     return false;
   }
 
-  VideoStream* video_stream = static_cast<VideoStream*>(footage->streams().first());
+  bool ok;
 
-  if (video_stream->video_type() != VideoStream::kVideoTypeStill) {
-    // If video type is not a still, this definitely isn't a video stream
+  *index = filename.mid(base_length - digit_count, digit_count).toLongLong(&ok);
+
+  if (!ok) {
     return false;
   }
 
+  // The digit count is part of the key since Decoder pads every number in a sequence to it
+  *key = QStringLiteral("%1/%2/%3").arg(filename.left(base_length - digit_count),
+                                        QString::number(digit_count),
+                                        filename.mid(base_length));
+
   return true;
 }
 
-bool ProjectImportTask::CompareStillImageSize(Footage* footage, const QSize &sz)
+QVector<Footage *> ProjectImportTask::ProbeFiles(const QStringList &filenames)
 {
-  if (!ItemIsStillImageFootageOnly(footage)) {
-    return false;
+  // Probing is mostly waiting on IO, so this is bounded by how much the storage can take rather
+  // than the number of cores
+  QThreadPool pool;
+  pool.setMaxThreadCount(qMax(1, Config::Current()[QStringLiteral("ProbeConcurrency")].toInt()));
+
+  QThread* main_thread = folder_->thread();
+
+  QVector< QFuture<Footage*> > futures(filenames.size());
+
+  for (int i=0; i<filenames.size(); i++) {
+    const QString& fn = filenames.at(i);
+
+    futures[i] = QtConcurrent::run(&pool, [this, fn, main_thread]() -> Footage* {
+      Footage* f = nullptr;
+
+      if (!IsCancelled()) {
+        f = Decoder::Probe(model_->project(), fn, &IsCancelled());
+
+        if (f) {
+          // Move footage to main thread
+          f->moveToThread(main_thread);
+        }
+      }
+
+      FilesProcessed(1);
+
+      return f;
+    });
   }
 
-  VideoStream* video_stream = static_cast<VideoStream*>(footage->streams().first());
+  QVector<Footage*> footage(filenames.size());
+
+  for (int i=0; i<filenames.size(); i++) {
+    footage[i] = futures.at(i).result();
+  }
 
-  return video_stream->width() == sz.width() && video_stream->height() == sz.height();
+  return footage;
 }
 
-int64_t ProjectImportTask::GetImageSequenceLimit(const QString& start_fn, int64_t start, bool up)
+void ProjectImportTask::AddFootage(Folder *folder, const QString &filename, Footage *footage)
 {
-  QString test_filename;
-  int test_index;
-
-  forever {
-    if (up) {
-      test_index = start + 1;
-    } else {
-      test_index = start - 1;
+  if (footage) {
+    // The undoable command is created once everything is probed, see Run()
+    if (!folder_footage_.contains(folder)) {
+      footage_folders_.append(folder);
     }
 
-    test_filename = Decoder::TransformImageSequenceFileName(start_fn, test_index);
+    folder_footage_[folder].append(footage);
 
-    if (!QFileInfo::exists(test_filename)) {
-      // Reached end of index
-      break;
-    }
+    imported_footage_.append(footage);
+  } else {
+    // Add to list so we can tell the user about it later
+    invalid_files_.append(filename);
+  }
+}
+
+void ProjectImportTask::FilesProcessed(int count)
+{
+  int processed = processed_count_.fetchAndAddOrdered(count) + count;
+
+  emit ProgressChanged(static_cast<double>(processed) / static_cast<double>(file_count_));
+}
+
+void ProjectImportTask::SetImageSequence(Footage *footage, int64_t start_index, int64_t count)
+{
+  VideoStream* video_stream = static_cast<VideoStream*>(footage->streams().first());
+
+  video_stream->set_video_type(VideoStream::kVideoTypeImageSequence);
 
-    start = test_index;
+  rational default_timebase = Config::Current()["DefaultSequenceFrameRate"].value<rational>();
+  video_stream->set_timebase(default_timebase);
+  video_stream->set_frame_rate(default_timebase.flipped());
+
+  video_stream->set_start_time(start_index);
+  video_stream->set_duration(count);
+}
+
+bool ProjectImportTask::ItemIsStillImageFootageOnly(Footage* footage)
+{
+  if (footage->stream_count() != 1) {
+    // Footage with more than one stream (usually video+audio) most likely isn't an image sequence
+    return false;
+  }
+
+  if (footage->streams().first()->type() != Stream::kVideo) {
+    // Footage with no video stream definitely isn't an image sequence
+    return false;
   }
 
-  return start;
+  VideoStream* video_stream = static_cast<VideoStream*>(footage->streams().first());
+
+  if (video_stream->video_type() != VideoStream::kVideoTypeStill) {
+    // If video type is not a still, this definitely isn't a video stream
+    return false;
+  }
+
+  return true;
 }
 
 }
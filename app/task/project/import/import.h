@@ -21,6 +21,7 @@
 #ifndef PROJECTIMPORTMANAGER_H
 #define PROJECTIMPORTMANAGER_H
 
+#include <QAtomicInt>
 #include <QFileInfoList>
 #include <QUndoCommand>
 
@@ -53,20 +54,85 @@ public:
     return !invalid_files_.isEmpty();
   }
 
+  /**
+   * @brief Returns every Footage item created by this import
+   */
+  const QVector<Footage*>& GetImportedFootage() const
+  {
+    return imported_footage_;
+  }
+
+  virtual Resource GetResource() const override
+  {
+    return kResourceIO;
+  }
+
 protected:
   virtual bool Run() override;
 
 private:
-  void Import(Folder* folder, QFileInfoList import, int& counter, QUndoCommand *parent_command);
-
-  void ValidateImageSequence(Footage *footage, QFileInfoList &info_list, int index);
+  /**
+   * @brief A directory being imported, directories are all enumerated before anything is probed
+   */
+  struct ImportDirectory {
+    QString path;
+    QString name;
+    int parent;
+    Folder* folder;
+    QFileInfoList files;
+  };
+
+  /**
+   * @brief A single file, or a run of consecutively numbered files that may be an image sequence
+   */
+  struct ImportItem {
+    Folder* folder;
+    QStringList filenames;
+    int64_t start_index;
+  };
+
+  /**
+   * @brief Walk every directory being imported, listing each level of the tree concurrently
+   *
+   * Creates a Folder (and the command adding it) for every directory that isn't empty.
+   */
+  QVector<ImportDirectory> EnumerateDirectories();
+
+  static void SortDirectoryEntries(QVector<ImportDirectory>& directories, int index,
+                                   const QFileInfoList& entries, QVector<int>& subdirectories);
+
+  static QFileInfoList ListDirectory(const QString& path);
+
+  /**
+   * @brief Group a directory's files into runs of consecutively numbered files in a single pass
+   *
+   * Files that aren't part of a run become items of their own.
+   */
+  static QVector<ImportItem> GroupImageSequences(Folder* folder, const QFileInfoList& files);
+
+  /**
+   * @brief Split a filename into the part that identifies its sequence and its frame number
+   *
+   * Returns FALSE if the filename doesn't end with a number. Follows the same rules as
+   * Decoder::GetImageSequenceIndex().
+   */
+  static bool GetImageSequenceKey(const QString& filename, QString* key, int64_t* index);
+
+  /**
+   * @brief Probe every file concurrently, at most "ProbeConcurrency" at a time
+   *
+   * Files that couldn't be probed map to nullptr.
+   */
+  QVector<Footage*> ProbeFiles(const QStringList& filenames);
+
+  void AddFootage(Folder* folder, const QString& filename, Footage* footage);
+
+  void FilesProcessed(int count);
+
+  static void SetImageSequence(Footage* footage, int64_t start_index, int64_t count);
 
   static bool ItemIsStillImageFootageOnly(Footage *footage);
 
-  static bool CompareStillImageSize(Footage *footage, const QSize& sz);
-
-  static int64_t GetImageSequenceLimit(const QString &start_fn, int64_t start, bool up);
-
   QUndoCommand* command_;
 
   ProjectViewModel* model_;
@@ -79,7 +145,15 @@ private:
 
   QStringList invalid_files_;
 
-  QList<QString> image_sequence_ignore_files_;
+  QVector<Footage*> imported_footage_;
+
+  /**
+   * @brief Footage waiting to be added to each folder, so each folder gets one AddItemsCommand
+   */
+  QVector<Folder*> footage_folders_;
+  QHash<Folder*, QVector<Item*> > folder_footage_;
+
+  QAtomicInt processed_count_;
 
 };
 
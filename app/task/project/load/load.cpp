@@ -20,15 +20,13 @@
 
 #include "load.h"
 
-#include <QApplication>
 #include <QFile>
 #include <QXmlStreamReader>
 
-#include "common/xmlutils.h"
-#include "core.h"
-
 namespace olive {
 
+const double ProjectLoadTask::kParseProgress = 0.5;
+
 ProjectLoadTask::ProjectLoadTask(const QString &filename) :
   ProjectLoadBaseTask(filename)
 {
@@ -37,67 +35,56 @@ ProjectLoadTask::ProjectLoadTask(const QString &filename) :
 bool ProjectLoadTask::Run()
 {
   QFile project_file(GetFilename());
-  uint project_version = Core::kProjectVersion;
 
   if (project_file.open(QFile::ReadOnly | QFile::Text)) {
-    QXmlStreamReader reader(&project_file);
-
-    while (XMLReadNextStartElement(&reader)) {
-      if (reader.name() == QStringLiteral("olive")) {
-        while(XMLReadNextStartElement(&reader)) {
-          if (reader.name() == QStringLiteral("version")) {
-            project_version = reader.readElementText().toUInt();
-
-            if (project_version > Core::kProjectVersion) {
-              // Project is newer than we support
-              SetError(tr("This project is newer than this version of Olive and cannot be opened."));
-              return false;
-            } else if (project_version < 201003) { // Change this if we drop support for a project version
-              // Project is older than we support
-              SetError(tr("This project is from a version of Olive that is no longer supported in this version."));
-              return false;
-            }
-          } else if (reader.name() == QStringLiteral("url")) {
-            project_saved_url_ = reader.readElementText();
-          } else if (reader.name() == QStringLiteral("project")) {
-            project_ = new Project();
-
-            project_->set_filename(GetFilename());
-
-            project_->Load(&reader, &layout_info_, project_version, &IsCancelled());
-
-            // Ensure project is in main thread
-            project_->moveToThread(qApp->thread());
-            break;
-          } else {
-            reader.skipCurrentElement();
-          }
-        }
-      } else if (reader.name() == QStringLiteral("project")) {
-        // 0.1 projects use "project" as the root instead of Olive. We don't currently support
-        // these projects
-        SetError(tr("This project is from a version of Olive that is no longer supported in this version."));
-        return false;
-      } else {
-        reader.skipCurrentElement();
-      }
-    }
+    ProgressDevice progress_device(&project_file, this);
+    progress_device.open(QIODevice::ReadOnly);
 
-    project_file.close();
+    QXmlStreamReader reader(&progress_device);
+
+    bool read_success = ReadProjectDocument(&reader);
 
-    emit ProgressChanged(1);
+    project_file.close();
 
-    if (reader.hasError()) {
-      SetError(reader.errorString());
+    if (!read_success) {
       return false;
-    } else {
-      return true;
     }
 
+    emit ProgressChanged(kParseProgress);
+
+    ValidateFootage(kParseProgress);
+
+    return !IsCancelled();
+
   } else {
     SetError(tr("Failed to read file \"%1\" for reading.").arg(GetFilename()));
     return false;
   }
 }
 
+ProjectLoadTask::ProgressDevice::ProgressDevice(QIODevice *source, ProjectLoadTask *task) :
+  source_(source),
+  task_(task)
+{
+}
+
+qint64 ProjectLoadTask::ProgressDevice::readData(char *data, qint64 maxSize)
+{
+  qint64 read_count = source_->read(data, maxSize);
+
+  if (read_count > 0 && source_->size() > 0) {
+    emit task_->ProgressChanged(kParseProgress * static_cast<double>(source_->pos()) / static_cast<double>(source_->size()));
+  }
+
+  return read_count;
+}
+
+qint64 ProjectLoadTask::ProgressDevice::writeData(const char *data, qint64 maxSize)
+{
+  Q_UNUSED(data)
+  Q_UNUSED(maxSize)
+
+  return -1;
+}
+
 }
@@ -35,6 +35,42 @@ public:
 protected:
   virtual bool Run() override;
 
+private:
+  /**
+   * @brief Passes reads through to the project file, reporting how far through it the parser is
+   */
+  class ProgressDevice : public QIODevice
+  {
+  public:
+    ProgressDevice(QIODevice* source, ProjectLoadTask* task);
+
+    virtual bool isSequential() const override
+    {
+      return true;
+    }
+
+    virtual qint64 bytesAvailable() const override
+    {
+      return QIODevice::bytesAvailable() + source_->bytesAvailable();
+    }
+
+  protected:
+    virtual qint64 readData(char *data, qint64 maxSize) override;
+
+    virtual qint64 writeData(const char *data, qint64 maxSize) override;
+
+  private:
+    QIODevice* source_;
+
+    ProjectLoadTask* task_;
+
+  };
+
+  /**
+   * @brief Portion of the overall progress taken by parsing, the rest is footage validation
+   */
+  static const double kParseProgress;
+
 };
 
 }
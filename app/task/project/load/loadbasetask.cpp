@@ -20,6 +20,12 @@
 
 #include "loadbasetask.h"
 
+#include <QApplication>
+#include <QtConcurrent/QtConcurrent>
+
+#include "common/xmlutils.h"
+#include "core.h"
+
 namespace olive {
 
 ProjectLoadBaseTask::ProjectLoadBaseTask(const QString &filename) :
@@ -29,4 +35,127 @@ ProjectLoadBaseTask::ProjectLoadBaseTask(const QString &filename) :
   SetTitle(tr("Loading '%1'").arg(filename));
 }
 
+bool ProjectLoadBaseTask::ReadProjectDocument(QXmlStreamReader *reader, const QHash<quint32, QByteArray> &sequence_chunks)
+{
+  uint project_version = Core::kProjectVersion;
+
+  while (XMLReadNextStartElement(reader)) {
+    if (reader->name() == QStringLiteral("olive")) {
+      while(XMLReadNextStartElement(reader)) {
+        if (reader->name() == QStringLiteral("version")) {
+          project_version = reader->readElementText().toUInt();
+
+          if (project_version > Core::kProjectVersion) {
+            // Project is newer than we support
+            SetError(tr("This project is newer than this version of Olive and cannot be opened."));
+            return false;
+          } else if (project_version < 201003) { // Change this if we drop support for a project version
+            // Project is older than we support
+            SetError(tr("This project is from a version of Olive that is no longer supported in this version."));
+            return false;
+          }
+        } else if (reader->name() == QStringLiteral("url")) {
+          project_saved_url_ = reader->readElementText();
+        } else if (reader->name() == QStringLiteral("project")) {
+          project_ = new Project();
+
+          project_->set_filename(GetFilename());
+
+          project_->Load(reader, &layout_info_, project_version, &IsCancelled(), sequence_chunks);
+
+          // Ensure project is in main thread
+          project_->moveToThread(qApp->thread());
+          break;
+        } else {
+          reader->skipCurrentElement();
+        }
+      }
+    } else if (reader->name() == QStringLiteral("project")) {
+      // 0.1 projects use "project" as the root instead of Olive. We don't currently support
+      // these projects
+      SetError(tr("This project is from a version of Olive that is no longer supported in this version."));
+      return false;
+    } else {
+      reader->skipCurrentElement();
+    }
+  }
+
+  if (reader->hasError()) {
+    SetError(reader->errorString());
+    return false;
+  }
+
+  if (IsCancelled()) {
+    return false;
+  }
+
+  if (!project_) {
+    SetError(tr("Failed to find a project in file \"%1\".").arg(GetFilename()));
+    return false;
+  }
+
+  return true;
+}
+
+void ProjectLoadBaseTask::ValidateFootage(double progress_start)
+{
+  struct Validation {
+    Footage* footage;
+    bool valid;
+  };
+
+  QVector<Item*> project_footage = project_->get_items_of_type(Item::kFootage);
+
+  QVector<Validation> validations(project_footage.size());
+  for (int i=0; i<project_footage.size(); i++) {
+    validations[i] = {static_cast<Footage*>(project_footage.at(i)), false};
+  }
+
+  QAtomicInt checked_count;
+  double count = validations.size();
+  QString current_url = project_->filename();
+
+  QtConcurrent::blockingMap(validations, [&](Validation& v) {
+    if (IsCancelled()) {
+      return;
+    }
+
+    v.valid = ValidateFootageItem(v.footage, project_saved_url_, current_url);
+
+    emit ProgressChanged(progress_start + (1.0 - progress_start) * (checked_count.fetchAndAddOrdered(1) + 1) / count);
+  });
+
+  invalid_footage_.clear();
+
+  foreach (const Validation& v, validations) {
+    if (v.valid) {
+      v.footage->SetValid();
+    } else {
+      invalid_footage_.append(v.footage);
+    }
+  }
+}
+
+bool ProjectLoadBaseTask::ValidateFootageItem(Footage *footage, const QString &project_saved_url, const QString &project_current_url)
+{
+  if (!QFileInfo::exists(footage->filename()) && !project_saved_url.isEmpty()
+      && project_current_url != project_saved_url) {
+    // The footage doesn't exist but the project has moved, the footage might have moved with it
+    QDir saved_dir(QFileInfo(project_saved_url).dir());
+    QDir true_dir(QFileInfo(project_current_url).dir());
+
+    QString relative_filename = saved_dir.relativeFilePath(footage->filename());
+    QString transformed_abs_filename = true_dir.filePath(relative_filename);
+
+    if (QFileInfo::exists(transformed_abs_filename)) {
+      // Use this file instead
+      qInfo() << "Resolved" << footage->filename() << "relatively to" << transformed_abs_filename;
+      footage->set_filename(transformed_abs_filename);
+    }
+  }
+
+  // Heuristically compare footage to file
+  return Footage::CompareFootageToItsFilename(footage);
+}
+
 }
@@ -21,6 +21,9 @@
 #ifndef PROJECTLOADBASETASK_H
 #define PROJECTLOADBASETASK_H
 
+#include <QXmlStreamReader>
+
+#include "project/item/footage/footage.h"
 #include "project/project.h"
 #include "task/task.h"
 
@@ -57,7 +60,42 @@ public:
     return filename_;
   }
 
+  /**
+   * @brief Footage in the loaded project that couldn't be matched to its file
+   *
+   * Filled by ValidateFootage(), the user should be asked to relink these.
+   */
+  const QVector<Footage*>& GetInvalidFootage() const
+  {
+    return invalid_footage_;
+  }
+
+  virtual Resource GetResource() const override
+  {
+    return kResourceIO;
+  }
+
 protected:
+  /**
+   * @brief Read an Olive XML document into `project_`
+   *
+   * Checks the document's project version and fills `project_saved_url_` and `layout_info_`.
+   * `sequence_chunks` is passed through to Project::Load(). Sets an error and returns FALSE if the
+   * document couldn't be read or didn't contain a project.
+   */
+  bool ReadProjectDocument(QXmlStreamReader* reader, const QHash<quint32, QByteArray>& sequence_chunks = QHash<quint32, QByteArray>());
+
+  /**
+   * @brief Check every footage item in the loaded project against its file
+   *
+   * Footage is checked in parallel on the global thread pool since it may involve probing. Footage
+   * that moved along with the project is pointed at its new location, footage that is fine is set
+   * valid, and anything else is added to GetInvalidFootage().
+   *
+   * Progress is reported from `progress_start` to 1.0.
+   */
+  void ValidateFootage(double progress_start);
+
   Project* project_;
 
   MainWindowLayoutInfo layout_info_;
@@ -65,8 +103,15 @@ protected:
   QString project_saved_url_;
 
 private:
+  /**
+   * @brief Check one footage item, returns TRUE if it's valid
+   */
+  static bool ValidateFootageItem(Footage* footage, const QString& project_saved_url, const QString& project_current_url);
+
   QString filename_;
 
+  QVector<Footage*> invalid_footage_;
+
 };
 
 }
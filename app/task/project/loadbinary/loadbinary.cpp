@@ -0,0 +1,126 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "loadbinary.h"
+
+#include <cstring>
+#include <QFile>
+#include <QtEndian>
+
+#include "task/project/savebinary/savebinary.h"
+
+namespace olive {
+
+const double ProjectLoadBinaryTask::kParseProgress = 0.5;
+
+ProjectLoadBinaryTask::ProjectLoadBinaryTask(const QString &filename) :
+  ProjectLoadBaseTask(filename)
+{
+}
+
+bool ProjectLoadBinaryTask::Run()
+{
+  QFile project_file(GetFilename());
+
+  if (!project_file.open(QFile::ReadOnly)) {
+    SetError(tr("Failed to read file \"%1\" for reading.").arg(GetFilename()));
+    return false;
+  }
+
+  quint64 file_size = project_file.size();
+
+  // Prefer mapping the file, fall back to reading it if the platform or file system can't
+  QByteArray file_contents;
+  const uchar* data = project_file.map(0, file_size);
+
+  if (!data) {
+    file_contents = project_file.readAll();
+    data = reinterpret_cast<const uchar*>(file_contents.constData());
+    file_size = file_contents.size();
+  }
+
+  if (file_size < static_cast<quint64>(ProjectSaveBinaryTask::kHeaderSize)
+      || memcmp(data, ProjectSaveBinaryTask::kMagic, 4) != 0) {
+    SetError(tr("\"%1\" is not a valid Olive project.").arg(GetFilename()));
+    return false;
+  }
+
+  if (qFromLittleEndian<quint32>(data + 4) > ProjectSaveBinaryTask::kFormatVersion) {
+    SetError(tr("This project is newer than this version of Olive and cannot be opened."));
+    return false;
+  }
+
+  quint32 chunk_count = qFromLittleEndian<quint32>(data + 8);
+
+  if (file_size < ProjectSaveBinaryTask::kHeaderSize + static_cast<quint64>(chunk_count) * ProjectSaveBinaryTask::kTocEntrySize) {
+    SetError(tr("Project file \"%1\" is corrupt.").arg(GetFilename()));
+    return false;
+  }
+
+  // Read table of contents, chunks reference the file data rather than copying it
+  QByteArray project_chunk;
+  QHash<quint32, QByteArray> sequence_chunks;
+
+  for (quint32 i=0; i<chunk_count; i++) {
+    const uchar* entry = data + ProjectSaveBinaryTask::kHeaderSize + ProjectSaveBinaryTask::kTocEntrySize * i;
+
+    quint32 type = qFromLittleEndian<quint32>(entry);
+    quint32 id = qFromLittleEndian<quint32>(entry + 4);
+    quint64 offset = qFromLittleEndian<quint64>(entry + 8);
+    quint64 size = qFromLittleEndian<quint64>(entry + 16);
+
+    if (offset > file_size || size > file_size - offset) {
+      SetError(tr("Project file \"%1\" is corrupt.").arg(GetFilename()));
+      return false;
+    }
+
+    QByteArray chunk = QByteArray::fromRawData(reinterpret_cast<const char*>(data + offset), static_cast<int>(size));
+
+    if (type == ProjectSaveBinaryTask::kChunkProject) {
+      project_chunk = chunk;
+    } else if (type == ProjectSaveBinaryTask::kChunkSequence) {
+      sequence_chunks.insert(id, chunk);
+    }
+  }
+
+  QByteArray project_xml = qUncompress(project_chunk);
+
+  if (project_xml.isEmpty()) {
+    SetError(tr("Failed to find a project in file \"%1\".").arg(GetFilename()));
+    return false;
+  }
+
+  QXmlStreamReader reader(project_xml);
+
+  if (!ReadProjectDocument(&reader, sequence_chunks)) {
+    return false;
+  }
+
+  // The project has been built so we no longer need the file
+  project_file.close();
+
+  emit ProgressChanged(kParseProgress);
+
+  ValidateFootage(kParseProgress);
+
+  return !IsCancelled();
+}
+
+}
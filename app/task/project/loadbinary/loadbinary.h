@@ -0,0 +1,53 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROJECTLOADBINARYTASK_H
+#define PROJECTLOADBINARYTASK_H
+
+#include "task/project/load/loadbasetask.h"
+
+namespace olive {
+
+/**
+ * @brief Loads a project saved by ProjectSaveBinaryTask
+ *
+ * The file is memory mapped where possible so chunks are decompressed straight from the mapping
+ * without reading the whole file into memory first.
+ */
+class ProjectLoadBinaryTask : public ProjectLoadBaseTask
+{
+  Q_OBJECT
+public:
+  ProjectLoadBinaryTask(const QString& filename);
+
+protected:
+  virtual bool Run() override;
+
+private:
+  /**
+   * @brief Portion of the overall progress taken by parsing, the rest is footage validation
+   */
+  static const double kParseProgress;
+
+};
+
+}
+
+#endif // PROJECTLOADBINARYTASK_H
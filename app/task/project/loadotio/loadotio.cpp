@@ -26,6 +26,10 @@
 #include <opentimelineio/serializableCollection.h>
 #include <opentimelineio/timeline.h>
 #include <QFileInfo>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+
+#include "config/config.h"
 
 #include "node/block/clip/clip.h"
 #include "node/block/gap/gap.h"
@@ -75,8 +79,35 @@ bool LoadOTIOTask::Run()
     return false;
   }
 
-  // Keep track of imported footage
-  QMap<QString, Footage*> imported_footage;
+  // Probe each referenced file once, up front and in parallel, since on network storage probing
+  // dominates the import time
+  QStringList footage_urls;
+
+  foreach (auto timeline, timelines) {
+    for (auto c : timeline->tracks()->children()) {
+      for (auto otio_block_retainer : static_cast<OTIO::Track*>(c.value)->children()) {
+        auto otio_block = otio_block_retainer.value;
+
+        if (otio_block->schema_name() == "Clip") {
+          auto media_ref = static_cast<OTIO::Clip*>(otio_block)->media_reference();
+
+          if (media_ref && media_ref->schema_name() == "ExternalReference") {
+            QString url = QString::fromStdString(static_cast<OTIO::ExternalReference*>(media_ref)->target_url());
+
+            if (!footage_urls.contains(url)) {
+              footage_urls.append(url);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  QMap<QString, Footage*> imported_footage = ProbeFootage(footage_urls);
+
+  if (IsCancelled()) {
+    return false;
+  }
 
   foreach (auto timeline, timelines) {
     Sequence* sequence = new Sequence();
@@ -156,19 +187,11 @@ bool LoadOTIOTask::Run()
         if (otio_block->schema_name() == "Clip") {
           auto otio_clip = static_cast<OTIO::Clip*>(otio_block);
 
-          if (otio_clip->media_reference()->schema_name() == "ExternalReference") {
+          if (otio_clip->media_reference() && otio_clip->media_reference()->schema_name() == "ExternalReference") {
             // Link footage
             QString footage_url = QString::fromStdString(static_cast<OTIO::ExternalReference*>(otio_clip->media_reference())->target_url());
 
-            Footage* probed_item;
-
-            if (imported_footage.contains(footage_url)) {
-              probed_item = imported_footage.value(footage_url);
-            } else {
-              probed_item = Decoder::Probe(project_, footage_url, &IsCancelled());
-              imported_footage.insert(footage_url, probed_item);
-              probed_item->setParent(project_->root());
-            }
+            Footage* probed_item = imported_footage.value(footage_url);
 
             if (probed_item && probed_item->type() == Item::kFootage) {
               MediaInput* media = new MediaInput();
@@ -190,9 +213,62 @@ bool LoadOTIOTask::Run()
     }
   }
 
+  ValidateFootage(0.5);
+
   project_->moveToThread(qApp->thread());
 
-  return true;
+  return !IsCancelled();
+}
+
+QMap<QString, Footage*> LoadOTIOTask::ProbeFootage(const QStringList &urls)
+{
+  QMap<QString, Footage*> footage;
+
+  // Probing is mostly waiting on IO, so this is bounded by how much the storage can take rather
+  // than the number of cores
+  QThreadPool pool;
+  pool.setMaxThreadCount(qMax(1, Config::Current()[QStringLiteral("ProbeConcurrency")].toInt()));
+
+  QThread* task_thread = QThread::currentThread();
+  QAtomicInt probed_count;
+  double count = urls.size();
+
+  QVector< QFuture<Footage*> > futures(urls.size());
+
+  for (int i=0; i<urls.size(); i++) {
+    const QString& url = urls.at(i);
+
+    futures[i] = QtConcurrent::run(&pool, [this, url, task_thread, &probed_count, count]() -> Footage* {
+      Footage* f = nullptr;
+
+      if (!IsCancelled()) {
+        f = Decoder::Probe(project_, url, &IsCancelled());
+
+        if (f) {
+          // Footage is parented to the project from the task thread
+          f->moveToThread(task_thread);
+        }
+      }
+
+      emit ProgressChanged(0.5 * (probed_count.fetchAndAddOrdered(1) + 1) / count);
+
+      return f;
+    });
+  }
+
+  for (int i=0; i<urls.size(); i++) {
+    Footage* f = futures.at(i).result();
+
+    if (f) {
+      f->setParent(project_->root());
+    } else {
+      qWarning() << "Failed to probe OTIO media reference:" << urls.at(i);
+    }
+
+    footage.insert(urls.at(i), f);
+  }
+
+  return footage;
 }
 
 }
@@ -35,6 +35,14 @@ public:
 protected:
   virtual bool Run() override;
 
+private:
+  /**
+   * @brief Probe every file in `urls` concurrently, at most "ProbeConcurrency" at a time
+   *
+   * Footage is returned in the calling thread. Files that couldn't be probed map to nullptr.
+   */
+  QMap<QString, Footage*> ProbeFootage(const QStringList& urls);
+
 };
 
 }
@@ -0,0 +1,196 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#include "relinktask.h"
+
+#include <QDir>
+#include <QtConcurrent/QtConcurrent>
+
+namespace olive {
+
+FootageRelinkTask::FootageRelinkTask(const QVector<Footage *> &footage, const QStringList &search_roots) :
+  footage_(footage),
+  search_roots_(search_roots)
+{
+  SetTitle(tr("Searching for %n file(s)", nullptr, footage.size()));
+}
+
+bool FootageRelinkTask::Run()
+{
+  results_.clear();
+
+  BuildIndex();
+
+  if (IsCancelled()) {
+    return false;
+  }
+
+  emit ProgressChanged(0.5);
+
+  QVector<Result> candidates;
+
+  foreach (Footage* f, footage_) {
+    QString filename = FindCandidate(f);
+
+    if (!filename.isEmpty()) {
+      candidates.append({f, filename});
+    }
+  }
+
+  // Candidates are verified in parallel since it may mean probing the file
+  QVector<char> verified(candidates.size(), false);
+  QVector<int> indexes(candidates.size());
+  for (int i=0; i<indexes.size(); i++) {
+    indexes[i] = i;
+  }
+
+  QAtomicInt checked_count;
+  double count = candidates.size();
+
+  QtConcurrent::blockingMap(indexes, [&](int i) {
+    if (IsCancelled()) {
+      return;
+    }
+
+    verified[i] = Footage::CompareFootageToFile(candidates.at(i).footage, candidates.at(i).filename);
+
+    emit ProgressChanged(0.5 + 0.5 * (checked_count.fetchAndAddOrdered(1) + 1) / count);
+  });
+
+  if (IsCancelled()) {
+    return false;
+  }
+
+  for (int i=0; i<candidates.size(); i++) {
+    if (verified.at(i)) {
+      results_.append(candidates.at(i));
+    }
+  }
+
+  return true;
+}
+
+FootageRelinkTask::DirectoryListing FootageRelinkTask::ListDirectory(const QString &path)
+{
+  DirectoryListing listing;
+
+  QFileInfoList entries = QDir(path).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden);
+
+  foreach (const QFileInfo& info, entries) {
+    if (info.isDir()) {
+      listing.directories.append(info.absoluteFilePath());
+    } else {
+      listing.files.append({info.absoluteFilePath(), info.lastModified().toMSecsSinceEpoch()});
+    }
+  }
+
+  return listing;
+}
+
+void FootageRelinkTask::BuildIndex()
+{
+  index_.clear();
+
+  // Walk the tree one level at a time, listing every directory of a level in parallel. On network
+  // storage the listing latency dominates so this is far faster than a serial walk.
+  QSet<QString> visited;
+  QStringList level;
+
+  foreach (const QString& root, search_roots_) {
+    QString canonical = QFileInfo(root).canonicalFilePath();
+
+    if (!canonical.isEmpty() && !visited.contains(canonical)) {
+      visited.insert(canonical);
+      level.append(canonical);
+    }
+  }
+
+  while (!level.isEmpty() && !IsCancelled()) {
+    QVector<DirectoryListing> listings = QtConcurrent::blockingMapped<QVector<DirectoryListing> >(level, &FootageRelinkTask::ListDirectory);
+
+    level.clear();
+
+    foreach (const DirectoryListing& listing, listings) {
+      foreach (const IndexEntry& e, listing.files) {
+        index_.insert(IndexKey(e.path), e);
+      }
+
+      foreach (const QString& dir, listing.directories) {
+        // Symlinks may loop back on themselves so directories are compared by canonical path
+        QString canonical = QFileInfo(dir).canonicalFilePath();
+
+        if (!canonical.isEmpty() && !visited.contains(canonical)) {
+          visited.insert(canonical);
+          level.append(dir);
+        }
+      }
+    }
+  }
+}
+
+QString FootageRelinkTask::FindCandidate(Footage *footage) const
+{
+  QList<IndexEntry> matches = index_.values(IndexKey(footage->filename()));
+
+  if (matches.isEmpty()) {
+    return QString();
+  }
+
+  QStringList old_dirs = QFileInfo(footage->filename()).path().split('/');
+
+  int best = -1;
+  bool best_time_matches = false;
+  int best_shared_dirs = -1;
+
+  for (int i=0; i<matches.size(); i++) {
+    const IndexEntry& e = matches.at(i);
+    bool time_matches = (e.modified == footage->timestamp());
+
+    QStringList dirs = QFileInfo(e.path).path().split('/');
+    int shared_dirs = 0;
+    while (shared_dirs < dirs.size() && shared_dirs < old_dirs.size()
+           && dirs.at(dirs.size() - 1 - shared_dirs) == old_dirs.at(old_dirs.size() - 1 - shared_dirs)) {
+      shared_dirs++;
+    }
+
+    if (best == -1
+        || (time_matches && !best_time_matches)
+        || (time_matches == best_time_matches && shared_dirs > best_shared_dirs)) {
+      best = i;
+      best_time_matches = time_matches;
+      best_shared_dirs = shared_dirs;
+    }
+  }
+
+  return matches.at(best).path;
+}
+
+QString FootageRelinkTask::IndexKey(const QString &filename)
+{
+  QString name = QFileInfo(filename).fileName();
+
+#ifdef Q_OS_WINDOWS
+  // Windows filenames are case-insensitive
+  name = name.toLower();
+#endif
+
+  return name;
+}
+
+}
@@ -0,0 +1,105 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#ifndef FOOTAGERELINKTASK_H
+#define FOOTAGERELINKTASK_H
+
+#include <QMultiHash>
+
+#include "project/item/footage/footage.h"
+#include "task/task.h"
+
+namespace olive {
+
+/**
+ * @brief Searches folders for the files of offline footage
+ *
+ * Rather than probing candidate paths one footage item at a time, the search roots are indexed
+ * once by filename, listing each level of the directory tree in parallel, and every footage item
+ * is matched against the index in a single pass. Candidates are then verified concurrently with
+ * Footage::CompareFootageToFile(), which reuses the probe cache for files it has seen before.
+ *
+ * Nothing is changed on the footage itself, the caller applies GetResults() so they can be undone
+ * as one batch.
+ */
+class FootageRelinkTask : public Task
+{
+  Q_OBJECT
+public:
+  FootageRelinkTask(const QVector<Footage*>& footage, const QStringList& search_roots);
+
+  struct Result {
+    Footage* footage;
+    QString filename;
+  };
+
+  /**
+   * @brief Verified matches found by the search, valid once the task has finished
+   */
+  const QVector<Result>& GetResults() const
+  {
+    return results_;
+  }
+
+  virtual Resource GetResource() const override
+  {
+    return kResourceIO;
+  }
+
+protected:
+  virtual bool Run() override;
+
+private:
+  struct IndexEntry {
+    QString path;
+    qint64 modified;
+  };
+
+  struct DirectoryListing {
+    QVector<IndexEntry> files;
+    QStringList directories;
+  };
+
+  static DirectoryListing ListDirectory(const QString& path);
+
+  void BuildIndex();
+
+  /**
+   * @brief Pick the most likely file for this footage from the index, or an empty string if none
+   *
+   * Files with the same modified time as the footage win, after that the one sharing the most
+   * trailing directories with the footage's old path.
+   */
+  QString FindCandidate(Footage* footage) const;
+
+  static QString IndexKey(const QString& filename);
+
+  QVector<Footage*> footage_;
+
+  QStringList search_roots_;
+
+  QMultiHash<QString, IndexEntry> index_;
+
+  QVector<Result> results_;
+
+};
+
+}
+
+#endif // FOOTAGERELINKTASK_H
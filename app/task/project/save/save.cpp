@@ -46,25 +46,7 @@ bool ProjectSaveTask::Run()
     QXmlStreamWriter writer(&project_file);
     writer.setAutoFormatting(true);
 
-    writer.writeStartDocument();
-
-    writer.writeStartElement("olive");
-
-    // Version is stored in YYMMDD from whenever the project format was last changed
-    // Allows easy integer math for checking project versions.
-    writer.writeTextElement("version", QString::number(Core::kProjectVersion));
-
-    writer.writeTextElement("url", project_->filename());
-
-    writer.writeStartElement(QStringLiteral("project"));
-
-    project_->Save(&writer);
-
-    writer.writeEndElement(); // project
-
-    writer.writeEndElement(); // olive
-
-    writer.writeEndDocument();
+    WriteProjectDocument(&writer, project_);
 
     project_file.close();
 
@@ -87,4 +69,27 @@ bool ProjectSaveTask::Run()
   }
 }
 
+void ProjectSaveTask::WriteProjectDocument(QXmlStreamWriter *writer, Project *project, QVector<Sequence *> *external_sequences)
+{
+  writer->writeStartDocument();
+
+  writer->writeStartElement("olive");
+
+  // Version is stored in YYMMDD from whenever the project format was last changed
+  // Allows easy integer math for checking project versions.
+  writer->writeTextElement("version", QString::number(Core::kProjectVersion));
+
+  writer->writeTextElement("url", project->filename());
+
+  writer->writeStartElement(QStringLiteral("project"));
+
+  project->Save(writer, external_sequences);
+
+  writer->writeEndElement(); // project
+
+  writer->writeEndElement(); // olive
+
+  writer->writeEndDocument();
+}
+
 }
@@ -21,6 +21,9 @@
 #ifndef PROJECTSAVEMANAGER_H
 #define PROJECTSAVEMANAGER_H
 
+#include <QXmlStreamWriter>
+
+#include "project/item/sequence/sequence.h"
 #include "project/project.h"
 #include "task/task.h"
 
@@ -37,6 +40,19 @@ public:
     return project_;
   }
 
+  /**
+   * @brief Write the full Olive XML document for a project
+   *
+   * If `external_sequences` is not nullptr, sequences are written as references and collected into
+   * it rather than being written inline (see Folder::SaveWithoutSequences()).
+   */
+  static void WriteProjectDocument(QXmlStreamWriter* writer, Project* project, QVector<Sequence*>* external_sequences = nullptr);
+
+  virtual Resource GetResource() const override
+  {
+    return kResourceIO;
+  }
+
 protected:
   virtual bool Run() override;
 
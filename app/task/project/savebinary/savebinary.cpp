@@ -0,0 +1,170 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "savebinary.h"
+
+#include <cstring>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QtEndian>
+
+#include "common/filefunctions.h"
+
+namespace olive {
+
+const char ProjectSaveBinaryTask::kMagic[] = "OVBP";
+const quint32 ProjectSaveBinaryTask::kFormatVersion = 1;
+const int ProjectSaveBinaryTask::kHeaderSize = 16;
+const int ProjectSaveBinaryTask::kTocEntrySize = 24;
+const int ProjectSaveBinaryTask::kCompressionLevel = 1;
+
+ProjectSaveBinaryTask::ProjectSaveBinaryTask(Project *project) :
+  ProjectSaveTask(project)
+{
+}
+
+bool ProjectSaveBinaryTask::Run()
+{
+  Project* project = GetProject();
+
+  // Serialize project with sequences split out
+  QVector<Sequence*> sequences;
+  QByteArray project_xml;
+
+  {
+    QXmlStreamWriter writer(&project_xml);
+    WriteProjectDocument(&writer, project, &sequences);
+
+    if (writer.hasError()) {
+      SetError(tr("Failed to write XML data"));
+      return false;
+    }
+  }
+
+  QVector<Chunk> chunks(sequences.size() + 1);
+
+  chunks[0] = {kChunkProject, 0, CompressChunk(project_xml)};
+
+  for (int i=0; i<sequences.size(); i++) {
+    if (IsCancelled()) {
+      return false;
+    }
+
+    chunks[i + 1] = {kChunkSequence, static_cast<quint32>(i), EncodeSequence(sequences.at(i))};
+
+    emit ProgressChanged(static_cast<double>(i + 1) / static_cast<double>(sequences.size()));
+  }
+
+  QString error;
+
+  if (!WriteChunks(project->filename(), chunks, &error)) {
+    SetError(error);
+    return false;
+  }
+
+  return true;
+}
+
+QByteArray ProjectSaveBinaryTask::CompressChunk(const QByteArray &xml)
+{
+  return qCompress(xml, kCompressionLevel);
+}
+
+bool ProjectSaveBinaryTask::WriteChunks(const QString &filename, const QVector<Chunk> &chunks, QString *error)
+{
+  // Build header and table of contents
+  QByteArray header(kHeaderSize + kTocEntrySize * chunks.size(), 0);
+  uchar* header_data = reinterpret_cast<uchar*>(header.data());
+
+  memcpy(header_data, kMagic, 4);
+  qToLittleEndian<quint32>(kFormatVersion, header_data + 4);
+  qToLittleEndian<quint32>(chunks.size(), header_data + 8);
+
+  quint64 offset = header.size();
+
+  for (int i=0; i<chunks.size(); i++) {
+    const Chunk& c = chunks.at(i);
+    uchar* entry = header_data + kHeaderSize + kTocEntrySize * i;
+
+    qToLittleEndian<quint32>(c.type, entry);
+    qToLittleEndian<quint32>(c.id, entry + 4);
+    qToLittleEndian<quint64>(offset, entry + 8);
+    qToLittleEndian<quint64>(c.data.size(), entry + 16);
+
+    offset += c.data.size();
+  }
+
+  // File to temporarily save to (ensures we can't half-write the user's main file and crash)
+  QString temp_save = FileFunctions::GetSafeTemporaryFilename(filename);
+
+  QFile project_file(temp_save);
+
+  if (!project_file.open(QFile::WriteOnly)) {
+    *error = tr("Failed to open temporary file \"%1\" for writing.").arg(temp_save);
+    return false;
+  }
+
+  bool write_success = (project_file.write(header) == header.size());
+
+  for (int i=0; i<chunks.size() && write_success; i++) {
+    write_success = (project_file.write(chunks.at(i).data) == chunks.at(i).data.size());
+  }
+
+  project_file.close();
+
+  if (!write_success) {
+    *error = tr("Failed to write to temporary file \"%1\".").arg(temp_save);
+    return false;
+  }
+
+  // Save was successful, we can now rewrite the original file
+  if (FileFunctions::RenameFileAllowOverwrite(temp_save, filename)) {
+    return true;
+  } else {
+    *error = tr("Failed to overwrite \"%1\". Project has been saved as \"%2\" instead.")
+             .arg(filename, temp_save);
+    return false;
+  }
+}
+
+QByteArray ProjectSaveBinaryTask::EncodeSequence(Sequence *sequence)
+{
+  QByteArray xml;
+
+  {
+    QXmlStreamWriter writer(&xml);
+    writer.writeStartElement(QStringLiteral("sequence"));
+    sequence->Save(&writer);
+    writer.writeEndElement(); // sequence
+  }
+
+  QByteArray hash = QCryptographicHash::hash(xml, QCryptographicHash::Sha1);
+
+  Sequence::BinaryChunkCache& cache = sequence->binary_chunk_cache();
+
+  if (cache.hash != hash) {
+    cache.hash = hash;
+    cache.chunk = CompressChunk(xml);
+  }
+
+  return cache.chunk;
+}
+
+}
@@ -0,0 +1,100 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROJECTSAVEBINARYTASK_H
+#define PROJECTSAVEBINARYTASK_H
+
+#include "task/project/save/save.h"
+
+namespace olive {
+
+/**
+ * @brief Saves a project in Olive's binary container format (.ovb)
+ *
+ * The container is a small header and table of contents followed by zlib-compressed chunks. The
+ * first chunk is the regular Olive XML document with every sequence replaced by a reference, and
+ * each sequence follows as its own chunk. All integers are little endian:
+ *
+ * * Header (kHeaderSize bytes): magic, format version, chunk count, reserved
+ * * Table of contents (kTocEntrySize bytes per chunk): type, ID, offset from the start of the
+ *   file, size
+ * * Chunk data
+ *
+ * Since each sequence is stored separately, sequences whose XML hasn't changed since the last save
+ * reuse their previously compressed chunk (see Sequence::binary_chunk_cache()), which makes saving
+ * a large project after a small edit considerably cheaper than writing the full XML document.
+ */
+class ProjectSaveBinaryTask : public ProjectSaveTask
+{
+  Q_OBJECT
+public:
+  ProjectSaveBinaryTask(Project* project);
+
+  enum ChunkType {
+    kChunkProject = 1,
+    kChunkSequence = 2
+  };
+
+  static const char kMagic[];
+
+  static const quint32 kFormatVersion;
+
+  static const int kHeaderSize;
+
+  static const int kTocEntrySize;
+
+  struct Chunk {
+    ChunkType type;
+    quint32 id;
+    QByteArray data;
+  };
+
+  /**
+   * @brief Compress XML data for storing as a chunk
+   */
+  static QByteArray CompressChunk(const QByteArray& xml);
+
+  /**
+   * @brief Write compressed chunks to `filename` as a binary project
+   *
+   * Data is written to a temporary file which is renamed over `filename` once complete so a failed
+   * write never damages an existing file. Returns FALSE and sets `error` on failure.
+   */
+  static bool WriteChunks(const QString& filename, const QVector<Chunk>& chunks, QString* error);
+
+protected:
+  virtual bool Run() override;
+
+private:
+  /**
+   * @brief Returns the compressed chunk for a sequence, reusing the previous one if it's unchanged
+   */
+  static QByteArray EncodeSequence(Sequence* sequence);
+
+  /**
+   * @brief zlib compression level for chunks, kept low since saving speed matters more than size
+   */
+  static const int kCompressionLevel;
+
+};
+
+}
+
+#endif // PROJECTSAVEBINARYTASK_H
@@ -35,6 +35,11 @@ class SaveOTIOTask : public Task
 public:
   SaveOTIOTask(Project* project);
 
+  virtual Resource GetResource() const override
+  {
+    return kResourceIO;
+  }
+
 protected:
   virtual bool Run() override;
 
@@ -0,0 +1,180 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "proxytask.h"
+
+#include "common/filefunctions.h"
+#include "common/timecodefunctions.h"
+#include "project/item/footage/footage.h"
+#include "project/project.h"
+#include "render/colormanager.h"
+
+namespace olive {
+
+ProxyTask::ProxyTask(VideoStream *stream, int divider) :
+  RenderTask(new ViewerOutput(), GenerateProxyParams(stream, divider), AudioParams()),
+  stream_(stream),
+  divider_(divider),
+  encoder_(nullptr),
+  frame_time_(0)
+{
+  viewer()->set_video_params(video_params());
+
+  video_node_ = new MediaInput();
+  video_node_->SetStream(stream);
+
+  NodeParam::ConnectEdge(video_node_->output(), viewer()->texture_input());
+
+  SetTitle(tr("Generating proxy for %1:%2").arg(stream->footage()->filename(),
+                                                QString::number(stream->index())));
+}
+
+ProxyTask::~ProxyTask()
+{
+  // We created these nodes ourselves, so now we should delete them
+  delete viewer();
+  delete video_node_;
+}
+
+bool ProxyTask::Run()
+{
+  QString proxy_fn = stream_->proxy_filename();
+  QString working_fn = FileFunctions::GetSafeTemporaryFilename(proxy_fn);
+
+  // The proxy is kept at the same size relative to the original as the divider we're rendering
+  // at, decoders correct for this when they open it
+  VideoParams encode_params(video_params().effective_width(),
+                            video_params().effective_height(),
+                            video_params().time_base(),
+                            video_params().format(),
+                            video_params().channel_count(),
+                            video_params().pixel_aspect_ratio(),
+                            video_params().interlacing());
+
+  // ProRes 422 Proxy, every frame is a keyframe so scrubbing is as cheap as playback
+  EncodingParams params;
+  params.SetFilename(working_fn);
+  params.EnableVideo(encode_params, ExportCodec::kCodecProRes);
+  params.set_video_pix_fmt(QStringLiteral("yuv422p10le"));
+  params.set_video_option(QStringLiteral("profile"), QStringLiteral("0"));
+  params.SetExportLength(viewer()->GetLength());
+
+  encoder_ = Encoder::CreateFromID(QStringLiteral("ffmpeg"), params);
+
+  if (!encoder_) {
+    SetError(tr("Failed to create encoder"));
+    return false;
+  }
+
+  if (!encoder_->Open()) {
+    SetError(tr("Failed to open file"));
+    encoder_->deleteLater();
+    encoder_ = nullptr;
+    return false;
+  }
+
+  ColorManager* color_manager = stream_->footage()->project()->color_manager();
+
+  // Store the proxy in the original's color space so it can be treated exactly like the original
+  ColorProcessorPtr color_processor = ColorProcessor::Create(color_manager,
+                                                             color_manager->GetReferenceColorSpace(),
+                                                             ColorTransform(stream_->colorspace()));
+
+  frame_time_ = 0;
+
+  // Proxies are always generated from the original media
+  Render(color_manager,
+         {TimeRange(0, viewer()->GetLength())},
+         TimeRangeList(),
+         RenderMode::kOnline,
+         nullptr,
+         QSize(0, 0),
+         QMatrix4x4(),
+         encoder_->GetDesiredPixelFormat(),
+         color_processor);
+
+  encoder_->Close();
+
+  delete encoder_;
+  encoder_ = nullptr;
+
+  if (IsCancelled()) {
+    QFile::remove(working_fn);
+    return true;
+  }
+
+  if (!FileFunctions::RenameFileAllowOverwrite(working_fn, proxy_fn)) {
+    SetError(tr("Failed to save proxy to \"%1\"").arg(proxy_fn));
+    QFile::remove(working_fn);
+    return false;
+  }
+
+  // Streams live on the main thread
+  QMetaObject::invokeMethod(stream_, "set_proxy_divider", Qt::QueuedConnection, Q_ARG(int, divider_));
+
+  return true;
+}
+
+void ProxyTask::FrameDownloaded(FramePtr frame, const QByteArray &hash, const QVector<rational> &times, qint64 job_time)
+{
+  Q_UNUSED(hash)
+  Q_UNUSED(job_time)
+
+  foreach (const rational& t, times) {
+    time_map_.insert(t, frame);
+  }
+
+  // Frames must be written in order, same as ExportTask
+  forever {
+    rational real_time = Timecode::timestamp_to_time(frame_time_,
+                                                     video_params().time_base());
+
+    if (!time_map_.contains(real_time)) {
+      break;
+    }
+
+    encoder_->WriteFrame(time_map_.take(real_time), real_time);
+
+    frame_time_++;
+  }
+}
+
+void ProxyTask::AudioDownloaded(const TimeRange &range, SampleBufferPtr samples, qint64 job_time)
+{
+  // Proxies are video only
+
+  Q_UNUSED(range)
+  Q_UNUSED(samples)
+  Q_UNUSED(job_time)
+}
+
+VideoParams ProxyTask::GenerateProxyParams(VideoStream *stream, int divider)
+{
+  return VideoParams(stream->width(),
+                     stream->height(),
+                     stream->timebase(),
+                     VideoParams::kFormatFloat16,
+                     VideoParams::kRGBAChannelCount,
+                     stream->pixel_aspect_ratio(),
+                     stream->interlacing(),
+                     divider);
+}
+
+}
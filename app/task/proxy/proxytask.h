@@ -0,0 +1,82 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROXYTASK_H
+#define PROXYTASK_H
+
+#include "codec/encoder.h"
+#include "node/input/media/media.h"
+#include "project/item/footage/videostream.h"
+#include "task/render/render.h"
+
+namespace olive {
+
+/**
+ * @brief Transcodes a video stream to a small intra-frame proxy in the project's cache
+ *
+ * Once finished, the stream's proxy divider is set and offline (preview) renders will decode the
+ * proxy instead of the original media. Online renders such as exports are unaffected.
+ */
+class ProxyTask : public RenderTask
+{
+  Q_OBJECT
+public:
+  ProxyTask(VideoStream* stream, int divider);
+
+  virtual ~ProxyTask() override;
+
+  virtual Priority GetPriority() const override
+  {
+    // Nothing is waiting on a proxy, the original media works in the meantime
+    return kPriorityLow;
+  }
+
+protected:
+  virtual bool Run() override;
+
+  virtual void FrameDownloaded(FramePtr frame, const QByteArray& hash, const QVector<rational>& times, qint64 job_time) override;
+
+  virtual void AudioDownloaded(const TimeRange& range, SampleBufferPtr samples, qint64 job_time) override;
+
+  virtual bool TwoStepFrameRendering() const override
+  {
+    return false;
+  }
+
+private:
+  static VideoParams GenerateProxyParams(VideoStream* stream, int divider);
+
+  VideoStream* stream_;
+
+  int divider_;
+
+  MediaInput* video_node_;
+
+  Encoder* encoder_;
+
+  QHash<rational, FramePtr> time_map_;
+
+  int64_t frame_time_;
+
+};
+
+}
+
+#endif // PROXYTASK_H
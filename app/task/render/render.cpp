@@ -20,15 +20,22 @@
 
 #include "render.h"
 
+#include "common/memorygovernor.h"
 #include "common/timecodefunctions.h"
+#include "config/config.h"
 #include "render/rendermanager.h"
 
 namespace olive {
 
+const rational RenderTask::kAudioChunkLength = rational(2);
+const int RenderTask::kMaximumAudioChunksInFlight = 4;
+const int RenderTask::kMaximumFramesPerBatch = 4;
+
 RenderTask::RenderTask(ViewerOutput* viewer, const VideoParams &vparams, const AudioParams &aparams) :
   viewer_(viewer),
   video_params_(vparams),
   audio_params_(aparams),
+  reuse_cache_(nullptr),
   running_tickets_(0)
 {
 }
@@ -56,26 +63,29 @@ bool RenderTask::Render(ColorManager* manager,
   // Store real time before any rendering takes place
   qint64 job_time = QDateTime::currentMSecsSinceEpoch();
 
-  // Queue audio jobs
-  foreach (const TimeRange& r, audio_range) {
-    // Don't count audio progress, since it's generally a lot faster than video and is weighted at
-    // 50%, which makes the progress bar look weird to the uninitiated
-    //total_length += r.length().toDouble();
-
-    IncrementRunningTickets();
+  // Split audio into chunks so it can be rendered and consumed alongside video rather than all at
+  // once. Don't count audio progress, since it's generally a lot faster than video and is weighted
+  // at 50%, which makes the progress bar look weird to the uninitiated.
+  QVector<TimeRange> audio_chunks;
 
-    RenderTicketWatcher* watcher = new RenderTicketWatcher();
-    watcher->setProperty("range", QVariant::fromValue(r));
-    PrepareWatcher(watcher, &watcher_thread);
-    watcher->SetTicket(RenderManager::instance()->RenderAudio(viewer_, r, audio_params_, false));
+  foreach (const TimeRange& r, audio_range) {
+    for (rational t=r.in(); t<r.out(); t+=kAudioChunkLength) {
+      audio_chunks.append(TimeRange(t, qMin(t + kAudioChunkLength, r.out())));
+    }
   }
 
   // Look up hashes
   QMap<QByteArray, QVector<rational> > time_map;
 
+  // Unique frames in the order they'll be queued
+  QVector<rational> frames_to_render;
+  QVector<QByteArray> hashes_to_render;
+
   if (!video_range.isEmpty()) {
     // Get list of discrete frames from range
     QVector<rational> times = viewer()->video_frame_cache()->GetFrameListFromTimeRange(video_range);
+    SortFramesForRendering(times);
+
     QVector<QByteArray> hashes(times.size());
 
     // Generate hashes
@@ -98,24 +108,141 @@ bool RenderTask::Render(ColorManager* manager,
       time_map[hash].append(times.at(i));
 
       if (time_map[hash].size() == 1) {
-        // This is the first frame with this hash, so we signal a render
-        RenderTicketWatcher* watcher = new RenderTicketWatcher();
-        watcher->setProperty("hash", hash);
-        PrepareWatcher(watcher, &watcher_thread);
+        // This is the first frame with this hash, so it'll need a render
+        frames_to_render.append(times.at(i));
+        hashes_to_render.append(hash);
+      }
+    }
+
+    // Add to "total progress"
+    total_length += video_frame_sz * time_map.size();
+  }
+
+  // Frames the reuse cache already has are loaded from it rather than rendered. Its frames are
+  // full size and untransformed, so a forced size or matrix rules it out.
+  QVector<bool> frames_to_load(frames_to_render.size(), false);
+  int reused_frames = 0;
+
+  if (reuse_cache_
+      && !TwoStepFrameRendering()
+      && force_matrix.isIdentity()
+      && (force_size.isNull() || force_size == QSize(video_params_.effective_width(), video_params_.effective_height()))) {
+    for (int i=0; i<hashes_to_render.size(); i++) {
+      if (IsCancelled()) {
+        return true;
+      }
 
-        IncrementRunningTickets();
+      frames_to_load[i] = reuse_cache_->HasCacheFrame(hashes_to_render.at(i));
+    }
+  }
 
-        watcher->SetTicket(RenderManager::instance()->RenderFrame(viewer_, manager, times.at(i),
+  // Limit how many frames can be held at once
+  QSize frame_size = force_size.isNull() ? QSize(video_params_.effective_width(), video_params_.effective_height()) : force_size;
+  VideoParams::Format frame_format = (force_format == VideoParams::kFormatInvalid) ? video_params_.format() : force_format;
+  qint64 frame_bytes = VideoParams::GetBufferSize(frame_size.width(), frame_size.height(),
+                                                  frame_format, VideoParams::kRGBAChannelCount);
+
+  int max_frames_in_flight = GetFrameLimit(GetMaximumFramesInFlight(),
+                                           Config::Current()["RenderMaxMemoryInFlight"].toLongLong() * 1048576,
+                                           frame_bytes);
+  int frames_in_flight = 0;
+  int frames_in_flight_peak = 0;
+  int next_frame = 0;
+
+  int audio_chunks_in_flight = 0;
+  int next_audio_chunk = 0;
+  rational latest_queued_frame;
+
+  // Queues as many frames as the in-flight limit allows. Runs of consecutive frames are queued as
+  // one batch ticket so they share a trip through the renderer.
+  auto queue_frames = [&]() {
+    // Everything we queue will need memory, so give some back first if we're over budget
+    if (MemoryGovernor::IsOverBudget()) {
+      MemoryGovernor::Reclaim();
+    }
+
+    while (next_frame < frames_to_render.size()
+           && (max_frames_in_flight <= 0 || frames_in_flight < max_frames_in_flight)
+           && (frames_in_flight == 0 || !MemoryGovernor::IsOverBudget())) {
+      int batch_limit = kMaximumFramesPerBatch;
+      if (max_frames_in_flight > 0) {
+        batch_limit = qMin(batch_limit, max_frames_in_flight - frames_in_flight);
+      }
+
+      int batch_size = 1;
+      while (!frames_to_load.at(next_frame)
+             && batch_size < batch_limit
+             && next_frame + batch_size < frames_to_render.size()
+             && !frames_to_load.at(next_frame + batch_size)
+             && frames_to_render.at(next_frame + batch_size) == frames_to_render.at(next_frame + batch_size - 1) + video_params_.time_base()) {
+        batch_size++;
+      }
+
+      RenderTicketWatcher* watcher = new RenderTicketWatcher();
+      PrepareWatcher(watcher, &watcher_thread);
+
+      IncrementRunningTickets();
+
+      if (frames_to_load.at(next_frame)) {
+        watcher->setProperty("hash", hashes_to_render.at(next_frame));
+        watcher->SetTicket(RenderManager::instance()->LoadFrameFromCache(reuse_cache_, hashes_to_render.at(next_frame),
+                                                                         force_format, force_color_output));
+      } else if (batch_size == 1) {
+        watcher->setProperty("hash", hashes_to_render.at(next_frame));
+        watcher->SetTicket(RenderManager::instance()->RenderFrame(viewer_, manager, frames_to_render.at(next_frame),
                                                                   mode, video_params_, audio_params_,
                                                                   force_size, force_matrix,
                                                                   force_format, force_color_output,
                                                                   cache));
+      } else {
+        watcher->setProperty("hashes", QVariant::fromValue(hashes_to_render.mid(next_frame, batch_size)));
+        watcher->SetTicket(RenderManager::instance()->RenderFrames(viewer_, manager, frames_to_render.mid(next_frame, batch_size),
+                                                                   mode, video_params_, audio_params_,
+                                                                   force_size, force_matrix,
+                                                                   force_format, force_color_output,
+                                                                   cache));
+      }
+
+      for (int i=0; i<batch_size; i++) {
+        latest_queued_frame = qMax(latest_queued_frame, frames_to_render.at(next_frame + i));
+      }
+
+      next_frame += batch_size;
+      frames_in_flight += batch_size;
+
+      if (frames_in_flight > frames_in_flight_peak) {
+        frames_in_flight_peak = frames_in_flight;
+
+        emit StatusChanged(tr("Peak frames in memory: %1 (%2 MB)").arg(QString::number(frames_in_flight_peak),
+                                                                      QString::number(frames_in_flight_peak * frame_bytes / 1048576)));
       }
     }
+  };
 
-    // Add to "total progress"
-    total_length += video_frame_sz * time_map.size();
-  }
+  // Queues audio up to the latest video queued so far, or freely once there's no more video
+  auto queue_audio = [&]() {
+    while (next_audio_chunk < audio_chunks.size()
+           && audio_chunks_in_flight < kMaximumAudioChunksInFlight) {
+      const TimeRange& chunk = audio_chunks.at(next_audio_chunk);
+
+      if (next_frame < frames_to_render.size() && chunk.in() > latest_queued_frame) {
+        break;
+      }
+
+      IncrementRunningTickets();
+
+      RenderTicketWatcher* watcher = new RenderTicketWatcher();
+      watcher->setProperty("range", QVariant::fromValue(chunk));
+      PrepareWatcher(watcher, &watcher_thread);
+      watcher->SetTicket(RenderManager::instance()->RenderAudio(viewer_, chunk, audio_params_, false));
+
+      next_audio_chunk++;
+      audio_chunks_in_flight++;
+    }
+  };
+
+  queue_frames();
+  queue_audio();
 
   finished_watcher_mutex_.lock();
 
@@ -126,10 +253,13 @@ bool RenderTask::Render(ColorManager* manager,
 
       finished_watcher_mutex_.unlock();
 
+      // Hold off on queuing anything else while paused, tickets already in flight can finish
+      WaitIfPaused();
+
       // Analyze watcher here
-      RenderManager::TicketType ticket_type = watcher->GetTicket()->property("type").value<RenderManager::TicketType>();
+      RenderRequest::Type ticket_type = watcher->GetTicket()->request()->type;
 
-      if (ticket_type == RenderManager::kTypeAudio) {
+      if (ticket_type == RenderRequest::kTypeAudio) {
 
         TimeRange range = watcher->property("range").value<TimeRange>();
 
@@ -137,12 +267,41 @@ bool RenderTask::Render(ColorManager* manager,
                         watcher->Get().value<SampleBufferPtr>(),
                         job_time);
 
+        audio_chunks_in_flight--;
+        queue_audio();
+
         // Don't count audio progress, since it's generally a lot faster than video and is weighted at
         // 50%, which makes the progress bar look weird to the uninitiated
         //progress_counter += range.length().toDouble();
         //emit ProgressChanged(progress_counter / total_length);
 
-      } else if (ticket_type == RenderManager::kTypeVideo && TwoStepFrameRendering()) {
+      } else if (ticket_type == RenderRequest::kTypeVideoBatch) {
+
+        QVector<FramePtr> frames = watcher->Get().value< QVector<FramePtr> >();
+        QVector<QByteArray> hashes = watcher->property("hashes").value< QVector<QByteArray> >();
+
+        for (int i=0; i<frames.size() && i<hashes.size(); i++) {
+          if (TwoStepFrameRendering()) {
+            DownloadFrame(&watcher_thread, frames.at(i), hashes.at(i));
+
+            progress_counter += video_frame_sz * 0.5;
+          } else {
+            FrameDownloaded(frames.at(i), hashes.at(i), time_map.value(hashes.at(i)), job_time);
+
+            progress_counter += video_frame_sz;
+
+            frames_in_flight--;
+          }
+        }
+
+        emit ProgressChanged(progress_counter / total_length);
+
+        if (!TwoStepFrameRendering()) {
+          queue_frames();
+          queue_audio();
+        }
+
+      } else if (ticket_type == RenderRequest::kTypeVideo && TwoStepFrameRendering()) {
 
         DownloadFrame(&watcher_thread,
                       watcher->Get().value<FramePtr>(),
@@ -151,12 +310,29 @@ bool RenderTask::Render(ColorManager* manager,
         progress_counter += video_frame_sz * 0.5;
         emit ProgressChanged(progress_counter / total_length);
 
+      } else if (ticket_type == RenderRequest::kTypeVideoLoad && !watcher->Get().value<FramePtr>()) {
+
+        // Couldn't be read back (e.g. the cache was cleared in the meantime), render it after all
+        QByteArray hash = watcher->property("hash").toByteArray();
+
+        frames_to_render.append(time_map.value(hash).first());
+        hashes_to_render.append(hash);
+        frames_to_load.append(false);
+
+        frames_in_flight--;
+        queue_frames();
+        queue_audio();
+
       } else {
 
-        // Assume single-step video or video download ticket
+        // Assume single-step video, video download or cache load ticket
         QByteArray rendered_hash = watcher->property("hash").toByteArray();
         FrameDownloaded(watcher->Get().value<FramePtr>(), rendered_hash, time_map.value(rendered_hash), job_time);
 
+        if (ticket_type == RenderRequest::kTypeVideoLoad) {
+          reused_frames++;
+        }
+
         double progress_to_add = video_frame_sz;
         if (TwoStepFrameRendering()) {
           progress_to_add *= 0.5;
@@ -165,6 +341,11 @@ bool RenderTask::Render(ColorManager* manager,
 
         emit ProgressChanged(progress_counter / total_length);
 
+        // This frame has been consumed, make room for the next one
+        frames_in_flight--;
+        queue_frames();
+        queue_audio();
+
       }
 
       delete watcher;
@@ -199,9 +380,36 @@ bool RenderTask::Render(ColorManager* manager,
   watcher_thread.quit();
   watcher_thread.wait();
 
+  if (reused_frames > 0) {
+    qInfo() << "Reused" << reused_frames << "of" << time_map.size() << "frames from the disk cache";
+
+    emit StatusChanged(tr("Reused %1 of %2 frames from the disk cache (%3%)").arg(QString::number(reused_frames),
+                                                                                 QString::number(time_map.size()),
+                                                                                 QString::number(qRound(reused_frames * 100.0 / time_map.size()))));
+  }
+
   return true;
 }
 
+int RenderTask::GetMaximumFramesInFlight() const
+{
+  return Config::Current()["RenderMaxFramesInFlight"].toInt();
+}
+
+int RenderTask::GetFrameLimit(int max_frames, qint64 max_bytes, qint64 frame_bytes)
+{
+  if (max_bytes > 0 && frame_bytes > 0) {
+    // Always allow at least one frame or nothing would ever render
+    int memory_frames = static_cast<int>(qMax(qint64(1), max_bytes / frame_bytes));
+
+    if (max_frames <= 0 || memory_frames < max_frames) {
+      return memory_frames;
+    }
+  }
+
+  return max_frames;
+}
+
 void RenderTask::DownloadFrame(QThread *thread, FramePtr frame, const QByteArray &hash)
 {
   RenderTicketWatcher* watcher = new RenderTicketWatcher();
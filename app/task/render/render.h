@@ -39,6 +39,11 @@ public:
 
   virtual ~RenderTask() override;
 
+  virtual Resource GetResource() const override
+  {
+    return kResourceGPU;
+  }
+
 protected:
   bool Render(ColorManager *manager, const TimeRangeList &video_range,
               const TimeRangeList &audio_range, RenderMode::Mode mode,
@@ -51,8 +56,18 @@ protected:
 
   virtual void FrameDownloaded(FramePtr frame, const QByteArray& hash, const QVector<rational>& times, qint64 job_time) = 0;
 
+  /**
+   * @brief Called with each rendered chunk of audio
+   *
+   * Audio is rendered in chunks of kAudioChunkLength that may arrive out of order.
+   */
   virtual void AudioDownloaded(const TimeRange& range, SampleBufferPtr samples, qint64 job_time) = 0;
 
+  /**
+   * @brief Length of each chunk audio ranges are split into for rendering
+   */
+  static const rational kAudioChunkLength;
+
   ViewerOutput* viewer() const
   {
     return viewer_;
@@ -63,6 +78,28 @@ protected:
     return video_params_;
   }
 
+  /**
+   * @brief Change the format frames are rendered in, must be called before Render()
+   */
+  void SetVideoFormat(VideoParams::Format format)
+  {
+    video_params_.set_format(format);
+  }
+
+  /**
+   * @brief Load frames from `cache` rather than rendering them where possible, must be called before Render()
+   *
+   * Any frame whose hash is already in `cache` is read back from it on the cache IO threads and
+   * given the same format and color conversion a rendered frame would get. The hash doesn't
+   * capture the render mode or whether proxies were used, so this should only be set when the
+   * cache's frames are known to match what Render() would produce. Only used for single-step
+   * rendering without a forced size or matrix.
+   */
+  void SetReuseCache(FrameHashCache* cache)
+  {
+    reuse_cache_ = cache;
+  }
+
   const AudioParams& audio_params() const
   {
     return audio_params_;
@@ -80,17 +117,52 @@ protected:
     return true;
   }
 
+  /**
+   * @brief Maximum number of frames that may be rendering or waiting to be downloaded at once
+   *
+   * Frames are only handed to the renderer as earlier ones are passed to FrameDownloaded(), which
+   * keeps memory usage flat when the consumer is slower than the renderer. 0 means no limit.
+   *
+   * Defaults to the "RenderMaxFramesInFlight" setting. Regardless of this, Render() also limits
+   * frames in flight to what fits in "RenderMaxMemoryInFlight" megabytes.
+   */
+  virtual int GetMaximumFramesInFlight() const;
+
+  /**
+   * @brief Override to change the order frames are queued for rendering in
+   *
+   * Frames are queued chronologically by default.
+   */
+  virtual void SortFramesForRendering(QVector<rational>& times) const
+  {
+    Q_UNUSED(times)
+  }
+
 private:
   void PrepareWatcher(RenderTicketWatcher* watcher, QThread *thread);
 
   void IncrementRunningTickets();
 
+  static const int kMaximumAudioChunksInFlight;
+
+  /**
+   * @brief Maximum number of consecutive frames rendered by one batch ticket
+   */
+  static const int kMaximumFramesPerBatch;
+
+  /**
+   * @brief Combine a frame limit with a memory limit, either of which may be 0 for no limit
+   */
+  static int GetFrameLimit(int max_frames, qint64 max_bytes, qint64 frame_bytes);
+
   ViewerOutput* viewer_;
 
   VideoParams video_params_;
 
   AudioParams audio_params_;
 
+  FrameHashCache* reuse_cache_;
+
   QVector<RenderTicketWatcher*> running_watchers_;
   std::list<RenderTicketWatcher*> finished_watchers_;
   int running_tickets_;
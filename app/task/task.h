@@ -23,7 +23,9 @@
 
 #include <memory>
 #include <QDateTime>
+#include <QMutex>
 #include <QObject>
+#include <QWaitCondition>
 
 #include "common/cancelableobject.h"
 
@@ -56,10 +58,44 @@ public:
   Task() :
     title_(tr("Task")),
     error_(tr("Unknown error")),
-    start_time_(0)
+    start_time_(0),
+    paused_(false)
   {
   }
 
+  /**
+   * @brief The system resource a Task spends most of its time waiting on
+   *
+   * TaskManager limits how many Tasks of each class run at once so Tasks that compete for the same
+   * resource don't slow each other down.
+   */
+  enum Resource {
+    kResourceCPU,
+    kResourceIO,
+    kResourceGPU,
+
+    kResourceCount
+  };
+
+  enum Priority {
+    kPriorityLow,
+    kPriorityNormal,
+    kPriorityHigh
+  };
+
+  virtual Resource GetResource() const
+  {
+    return kResourceCPU;
+  }
+
+  /**
+   * @brief Queued Tasks with a higher priority are started first
+   */
+  virtual Priority GetPriority() const
+  {
+    return kPriorityNormal;
+  }
+
   /**
    * @brief Retrieve the current title of this Task
    */
@@ -113,6 +149,23 @@ public slots:
   void Cancel()
   {
     CancelableObject::Cancel();
+
+    // Don't leave a paused task waiting forever
+    QMutexLocker locker(&pause_lock_);
+    pause_cond_.wakeAll();
+  }
+
+  /**
+   * @brief Ask the Task to stop making progress until it's resumed
+   *
+   * Pausing is cooperative, it only takes effect where the Task calls WaitIfPaused(). This is
+   * thread-safe.
+   */
+  void SetPaused(bool e)
+  {
+    QMutexLocker locker(&pause_lock_);
+    paused_ = e;
+    pause_cond_.wakeAll();
   }
 
 protected:
@@ -141,6 +194,20 @@ protected:
     title_ = s;
   }
 
+  /**
+   * @brief Block while this Task is paused
+   *
+   * Call this between units of work in Run() to allow the Task to be paused.
+   */
+  void WaitIfPaused()
+  {
+    QMutexLocker locker(&pause_lock_);
+
+    while (paused_ && !IsCancelled()) {
+      pause_cond_.wait(&pause_lock_);
+    }
+  }
+
 signals:
   /**
    * @brief Signal emitted whenever progress is made
@@ -153,6 +220,11 @@ signals:
    */
   void ProgressChanged(double d);
 
+  /**
+   * @brief Signal emitted with extra information about the Task's state to show alongside its progress
+   */
+  void StatusChanged(const QString& s);
+
 private:
   QString title_;
 
@@ -160,6 +232,12 @@ private:
 
   qint64 start_time_;
 
+  QMutex pause_lock_;
+
+  QWaitCondition pause_cond_;
+
+  bool paused_;
+
 };
 
 }
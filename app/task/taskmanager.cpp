@@ -23,16 +23,30 @@
 #include <QDebug>
 #include <QThread>
 
+#include "common/metrics.h"
+
 namespace olive {
 
 TaskManager* TaskManager::instance_ = nullptr;
 
-TaskManager::TaskManager()
+TaskManager::TaskManager() :
+  playback_active_(false)
 {
+  int threads = 0;
+
+  for (int i=0; i<Task::kResourceCount; i++) {
+    running_[i] = 0;
+    threads += GetResourceLimit(static_cast<Task::Resource>(i));
+  }
+
+  thread_pool_.setMaxThreadCount(threads);
 }
 
 TaskManager::~TaskManager()
 {
+  qDeleteAll(queued_);
+  queued_.clear();
+
   thread_pool_.clear();
 
   foreach (Task* t, tasks_) {
@@ -64,11 +78,15 @@ TaskManager *TaskManager::instance()
 
 int TaskManager::GetTaskCount() const
 {
-  return tasks_.size();
+  return tasks_.size() + queued_.size();
 }
 
 Task *TaskManager::GetFirstTask() const
 {
+  if (tasks_.isEmpty()) {
+    return queued_.first();
+  }
+
   return tasks_.begin().value();
 }
 
@@ -76,6 +94,10 @@ void TaskManager::CancelTaskAndWait(Task* t)
 {
   t->Cancel();
 
+  if (RemoveQueuedTask(t)) {
+    return;
+  }
+
   QFutureWatcher<bool>* w = tasks_.key(t);
 
   if (w) {
@@ -83,25 +105,113 @@ void TaskManager::CancelTaskAndWait(Task* t)
   }
 }
 
+int TaskManager::GetResourceLimit(Task::Resource resource)
+{
+  switch (resource) {
+  case Task::kResourceCPU:
+    return QThread::idealThreadCount();
+  case Task::kResourceIO:
+    // Disks rarely get faster with more than a couple of streams at once
+    return 2;
+  case Task::kResourceGPU:
+    // Rendering all goes through the same GPU thread anyway
+    return 1;
+  case Task::kResourceCount:
+    break;
+  }
+
+  return 1;
+}
+
 void TaskManager::AddTask(Task* t)
+{
+  // Add the Task to the queue behind every Task of the same or higher priority
+  int index = queued_.size();
+  while (index > 0 && queued_.at(index - 1)->GetPriority() < t->GetPriority()) {
+    index--;
+  }
+  queued_.insert(index, t);
+
+  // Emit signal that a Task was added
+  emit TaskAdded(t);
+  emit TaskListChanged();
+
+  StartQueuedTasks();
+}
+
+void TaskManager::SetPlaybackActive(bool e)
+{
+  if (playback_active_ == e) {
+    return;
+  }
+
+  playback_active_ = e;
+
+  foreach (Task* t, tasks_) {
+    t->SetPaused(e);
+  }
+
+  if (!playback_active_) {
+    StartQueuedTasks();
+  }
+}
+
+void TaskManager::StartQueuedTasks()
+{
+  if (playback_active_) {
+    return;
+  }
+
+  for (int i=0; i<queued_.size(); ) {
+    Task* t = queued_.at(i);
+
+    if (running_[t->GetResource()] < GetResourceLimit(t->GetResource())) {
+      queued_.removeAt(i);
+      StartTask(t);
+    } else {
+      i++;
+    }
+  }
+}
+
+void TaskManager::StartTask(Task *t)
 {
   // Create a watcher for signalling
   QFutureWatcher<bool>* watcher = new QFutureWatcher<bool>();
   connect(watcher, &QFutureWatcher<bool>::finished, this, &TaskManager::TaskFinished);
 
-  // Add the Task to the queue
   tasks_.insert(watcher, t);
+  running_[t->GetResource()]++;
+
+  // Progress is emitted from the task's thread, so it's stored directly rather than queued
+  connect(t, &Task::ProgressChanged, this, [t](double d){
+    Metrics::SetProgress(t, t->GetTitle(), d);
+  }, Qt::DirectConnection);
 
   // Run task concurrently
-  watcher->setFuture(QtConcurrent::run(t, &Task::Start));
+  watcher->setFuture(QtConcurrent::run(&thread_pool_, t, &Task::Start));
+}
+
+bool TaskManager::RemoveQueuedTask(Task *t)
+{
+  if (!queued_.removeOne(t)) {
+    return false;
+  }
+
+  emit TaskRemoved(t);
+  t->deleteLater();
 
-  // Emit signal that a Task was added
-  emit TaskAdded(t);
   emit TaskListChanged();
+
+  return true;
 }
 
 void TaskManager::CancelTask(Task *t)
 {
+  if (RemoveQueuedTask(t)) {
+    return;
+  }
+
   if (std::find(failed_tasks_.begin(), failed_tasks_.end(), t) != failed_tasks_.end()) {
     failed_tasks_.remove(t);
     emit TaskRemoved(t);
@@ -117,6 +227,9 @@ void TaskManager::TaskFinished()
   Task* t = tasks_.value(watcher);
 
   tasks_.remove(watcher);
+  running_[t->GetResource()]--;
+
+  Metrics::RemoveProgress(t);
 
   if (watcher->result()) {
     // Task completed successfully
@@ -131,6 +244,8 @@ void TaskManager::TaskFinished()
   watcher->deleteLater();
 
   emit TaskListChanged();
+
+  StartQueuedTasks();
 }
 
 }
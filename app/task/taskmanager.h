@@ -34,8 +34,12 @@ namespace olive {
  *
  * TaskManager handles the life of a Task object. After a new Task is created, it should be sent to TaskManager through
  * AddTask(). TaskManager will take ownership of the task and add it to a queue until it system resources are available
- * for it to run. Currently, TaskManager will run no more Tasks than there are threads on the system (one task per
- * thread). As Tasks finished, TaskManager will start the next in the queue.
+ * for it to run. Each Task declares the resource it mostly uses (see Task::GetResource()) and only a limited number of
+ * Tasks per resource run at once, see GetResourceLimit(). As Tasks finish, TaskManager starts the highest priority
+ * Tasks in the queue whose resource is free.
+ *
+ * While interactive playback is active (see SetPlaybackActive()), no new Tasks are started and running ones are
+ * paused so they don't compete with playback.
  */
 class TaskManager : public QObject
 {
@@ -65,6 +69,11 @@ public:
 
   void CancelTaskAndWait(Task* t);
 
+  /**
+   * @brief Maximum number of Tasks using `resource` that may run at once
+   */
+  static int GetResourceLimit(Task::Resource resource);
+
 public slots:
   /**
    * @brief Add a new Task
@@ -85,6 +94,11 @@ public slots:
 
   void CancelTask(Task* t);
 
+  /**
+   * @brief Hold background Tasks back while something is playing
+   */
+  void SetPlaybackActive(bool e);
+
 signals:
   /**
    * @brief Signal emitted when a Task is added by AddTask()
@@ -112,10 +126,34 @@ signals:
 
 private:
   /**
-   * @brief Internal task array
+   * @brief Start as many queued Tasks as resource limits allow
+   */
+  void StartQueuedTasks();
+
+  void StartTask(Task* t);
+
+  /**
+   * @brief Remove a Task that hasn't started yet, returns FALSE if it wasn't queued
+   */
+  bool RemoveQueuedTask(Task* t);
+
+  /**
+   * @brief Internal array of running tasks
    */
   QHash<QFutureWatcher<bool>*, Task*> tasks_;
 
+  /**
+   * @brief Tasks waiting for their resource, ordered by priority
+   */
+  QList<Task*> queued_;
+
+  /**
+   * @brief Number of running Tasks using each resource
+   */
+  int running_[Task::kResourceCount];
+
+  bool playback_active_;
+
   /**
    * @brief Internal list of failed tasks
    */
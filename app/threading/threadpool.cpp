@@ -20,27 +20,32 @@
 
 #include "threadpool.h"
 
+#include <algorithm>
+#include <QDateTime>
+
+#include "common/threadaffinity.h"
+#include "common/tracer.h"
+
 namespace olive {
 
+const qint64 ThreadPool::kStarvationThreshold = 1000;
+const unsigned long ThreadPool::kUrgentTicketPollInterval = 50;
+
 ThreadPool::ThreadPool(QThread::Priority priority, int threads, QObject *parent) :
-  QObject(parent)
+  QObject(parent),
+  next_thread_(0),
+  node_count_(ThreadAffinity::IsEnabled() ? ThreadAffinity::GetNodeCount() : 1),
+  pending_tickets_(0)
 {
   all_threads_.resize(threads ? threads : QThread::idealThreadCount());
 
   // Create threads
   for (int i=0; i<all_threads_.size(); i++) {
-    ThreadPoolThread* t  = new ThreadPoolThread(this);
-
-    // Add to vector of all threads
-    all_threads_[i] = t;
-
-    // Append to list of available threads
-    available_threads_.push_back(t);
-
-    // Connect done signal
-    connect(t, &ThreadPoolThread::Done, this, &ThreadPool::ThreadDone);
+    all_threads_[i] = new ThreadPoolThread(this, i);
+  }
 
-    // Start the thread at the given priority
+  // Start them once they all exist since they steal from each other
+  foreach (ThreadPoolThread* t, all_threads_) {
     t->start(priority);
   }
 }
@@ -49,97 +54,221 @@ ThreadPool::~ThreadPool()
 {
   foreach (ThreadPoolThread* thread, all_threads_) {
     thread->Cancel();
+  }
+
+  foreach (ThreadPoolThread* thread, all_threads_) {
     thread->wait();
     delete thread;
   }
 }
 
-void ThreadPool::AddTicket(RenderTicketPtr ticket, bool prioritize)
+void ThreadPool::AddTicket(RenderTicketPtr ticket, TicketPriority priority)
 {
-  if (prioritize) {
-    ticket_queue_.push_front(ticket);
-  } else {
-    ticket_queue_.push_back(ticket);
+  // Keep tickets queued from a worker on that worker, otherwise spread them out
+  int index = GetCurrentThreadIndex();
+
+  if (index == -1) {
+    index = static_cast<int>(static_cast<uint>(next_thread_.fetchAndAddRelaxed(1)) % static_cast<uint>(all_threads_.size()));
+  }
+
+  if (Tracer::IsEnabled()) {
+    ticket->SetQueueTime(Tracer::Now());
   }
 
-  RunNext();
+  ThreadPoolThread* target = all_threads_.at(index);
+
+  target->Push(ticket, priority);
+
+  queued_tickets_[priority].ref();
+
+  QMutexLocker locker(&pending_lock_);
+  pending_tickets_++;
+  pending_cond_.wakeOne();
 }
 
-void ThreadPool::RunNext()
+void ThreadPool::EscalateTicket(RenderTicketPtr ticket, TicketPriority priority)
 {
-  while (!ticket_queue_.empty() && !available_threads_.empty()) {
-    // Run function
-    RenderTicketPtr ticket = ticket_queue_.front();
-    ticket_queue_.pop_front();
+  foreach (ThreadPoolThread* thread, all_threads_) {
+    if (thread->Escalate(ticket, priority)) {
+      break;
+    }
+  }
+}
 
-    if (!ticket->WasCancelled()) {
-      ThreadPoolThread* thread = available_threads_.front();
-      available_threads_.pop_front();
+void ThreadPool::WaitForMoreUrgentTickets(TicketPriority priority, const QAtomicInt *cancelled) const
+{
+  forever {
+    if (cancelled && *cancelled) {
+      return;
+    }
 
-      // Move ticket to other thread so event processing can occur there
-      ticket->moveToThread(thread);
+    bool busy = false;
+
+    for (int i=0; i<priority && !busy; i++) {
+      busy = GetQueuedTicketCount(static_cast<TicketPriority>(i)) > 0;
+    }
 
-      // Run the ticket in the thread, which actually just calls our virtual function RunTicket
-      thread->RunTicket(ticket);
+    if (!busy) {
+      return;
     }
+
+    QThread::msleep(kUrgentTicketPollInterval);
   }
 }
 
-void ThreadPool::ThreadDone()
+int ThreadPool::GetCurrentThreadIndex() const
 {
-  ThreadPoolThread* thread = static_cast<ThreadPoolThread*>(sender());
+  QThread* current = QThread::currentThread();
 
-  available_threads_.push_back(thread);
+  for (int i=0; i<all_threads_.size(); i++) {
+    if (all_threads_.at(i) == current) {
+      return i;
+    }
+  }
 
-  RunNext();
+  return -1;
 }
 
-ThreadPoolThread::ThreadPoolThread(ThreadPool *parent)
+RenderTicketPtr ThreadPool::TakeNext(ThreadPoolThread *thread)
 {
-  pool_ = parent;
+  RenderTicketPtr ticket;
+  int taken_priority = 0;
+
+  // Check our own queue first, then steal from the others in order. Workers are pinned to nodes
+  // round-robin, so stepping by the node count visits the workers on our own node first.
+  auto take_from_any = [this, thread](int priority, qint64 queued_before) {
+    RenderTicketPtr t;
+
+    for (int offset=0; offset<node_count_ && !t; offset++) {
+      for (int i=offset; i<all_threads_.size() && !t; i+=node_count_) {
+        t = all_threads_.at((thread->index() + i) % all_threads_.size())->Take(priority, queued_before);
+      }
+    }
+
+    return t;
+  };
 
-  // Ensures mutex is definitely locked by the time the thread is running
-  mutex_.lock();
+  // Anything that's been waiting too long goes first, lowest priority first since it's the most
+  // likely to have been starved
+  qint64 starved_before = QDateTime::currentMSecsSinceEpoch() - kStarvationThreshold;
+
+  for (int i=kPriorityCount-1; i>kPriorityInteractive && !ticket; i--) {
+    ticket = take_from_any(i, starved_before);
+    taken_priority = i;
+  }
+
+  for (int i=0; i<kPriorityCount && !ticket; i++) {
+    ticket = take_from_any(i, -1);
+    taken_priority = i;
+  }
+
+  if (ticket) {
+    queued_tickets_[taken_priority].deref();
+
+    QMutexLocker locker(&pending_lock_);
+    pending_tickets_--;
+  }
+
+  return ticket;
+}
+
+void ThreadPool::WaitForTicket(ThreadPoolThread *thread)
+{
+  QMutexLocker locker(&pending_lock_);
+
+  while (!pending_tickets_ && !thread->IsCancelled()) {
+    pending_cond_.wait(&pending_lock_);
+  }
 }
 
-ThreadPoolThread::~ThreadPoolThread()
+ThreadPoolThread::ThreadPoolThread(ThreadPool *parent, int index) :
+  pool_(parent),
+  index_(index)
 {
-  mutex_.unlock();
+  setObjectName(QStringLiteral("Worker %1").arg(index));
 }
 
-void ThreadPoolThread::RunTicket(RenderTicketPtr ticket)
+void ThreadPoolThread::Push(RenderTicketPtr ticket, ThreadPool::TicketPriority priority)
 {
-  mutex_.lock();
-  ticket_ = ticket;
-  wait_cond_.wakeAll();
-  mutex_.unlock();
+  QMutexLocker locker(&queue_lock_);
+  queue_[priority].push_back(ticket);
 }
 
-void ThreadPoolThread::run()
+RenderTicketPtr ThreadPoolThread::Take(int priority, qint64 queued_before)
+{
+  QMutexLocker locker(&queue_lock_);
+
+  std::deque<RenderTicketPtr>& queue = queue_[priority];
+
+  if (queue.empty()
+      || (queued_before >= 0 && queue.front()->GetJobTime() >= queued_before)) {
+    return nullptr;
+  }
+
+  RenderTicketPtr ticket = queue.front();
+  queue.pop_front();
+  return ticket;
+}
+
+bool ThreadPoolThread::Escalate(RenderTicketPtr ticket, ThreadPool::TicketPriority priority)
 {
-  while (true) {
-    wait_cond_.wait(&mutex_);
+  QMutexLocker locker(&queue_lock_);
+
+  for (int i=0; i<ThreadPool::kPriorityCount; i++) {
+    std::deque<RenderTicketPtr>& queue = queue_[i];
 
-    if (ticket_) {
-      pool_->RunTicket(ticket_);
+    auto it = std::find(queue.begin(), queue.end(), ticket);
 
-      // Move back to calling thread (hacky?)
-      ticket_->moveToThread(this->thread());
+    if (it != queue.end()) {
+      if (i > priority) {
+        queue.erase(it);
 
-      ticket_ = nullptr;
+        // Keep it in job time order so the starvation check still sees the oldest ticket first
+        std::deque<RenderTicketPtr>& target = queue_[priority];
+        auto pos = std::find_if(target.begin(), target.end(), [&ticket](const RenderTicketPtr& t) {
+          return t->GetJobTime() > ticket->GetJobTime();
+        });
+        target.insert(pos, ticket);
+
+        // Adjusted under our lock so TakeNext() can't take it before the counts are moved
+        pool_->queued_tickets_[i].deref();
+        pool_->queued_tickets_[priority].ref();
+      }
+
+      return true;
     }
+  }
 
-    if (IsCancelled()) {
-      break;
+  return false;
+}
+
+void ThreadPoolThread::run()
+{
+  if (pool_->node_count_ > 1) {
+    ThreadAffinity::PinCurrentThreadToNode(index_ % pool_->node_count_);
+  }
+
+  while (!IsCancelled()) {
+    RenderTicketPtr ticket = pool_->TakeNext(this);
+
+    if (ticket) {
+      if (!ticket->WasCancelled()) {
+        if (ticket->GetQueueTime() >= 0 && Tracer::IsEnabled()) {
+          Tracer::Record("Queue Wait", ticket->GetQueueTime(), Tracer::Now());
+        }
+
+        pool_->RunTicket(ticket);
+      }
     } else {
-      emit Done();
+      pool_->WaitForTicket(this);
     }
   }
 }
 
 void ThreadPoolThread::CancelEvent()
 {
-  wait_cond_.wakeAll();
+  QMutexLocker locker(&pool_->pending_lock_);
+  pool_->pending_cond_.wakeAll();
 }
 
 }
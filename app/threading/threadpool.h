@@ -21,7 +21,10 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
+#include <deque>
+#include <QMutex>
 #include <QThread>
+#include <QWaitCondition>
 
 #include "common/cancelableobject.h"
 #include "threading/threadticket.h"
@@ -30,32 +33,118 @@ namespace olive {
 
 class ThreadPoolThread;
 
+/**
+ * @brief A pool of worker threads that runs RenderTickets by priority class
+ *
+ * Each worker owns a deque per priority class. Workers always take the highest priority ticket
+ * available, first from their own deques and then by stealing from other workers, so tickets are
+ * dispatched directly from the worker threads without going through an event loop.
+ *
+ * Lower priority tickets that have been waiting longer than kStarvationThreshold are run ahead of
+ * higher priority ones so that, for example, disk writes can't be held back indefinitely by a
+ * long stream of background renders.
+ */
 class ThreadPool : public QObject
 {
   Q_OBJECT
 public:
+  enum TicketPriority {
+    /// Requests the user is actively waiting on, e.g. a single frame for the viewer
+    kPriorityInteractive,
+
+    /// Work needed for playback in the near future
+    kPriorityPlayback,
+
+    /// Background caching
+    kPriorityBackground,
+
+    /// Writing finished results to disk
+    kPriorityDiskIO,
+
+    kPriorityCount
+  };
+
   ThreadPool(QThread::Priority priority = QThread::InheritPriority, int threads = 0, QObject* parent = nullptr);
 
   virtual ~ThreadPool() override;
 
-  RenderTicketPtr Queue();
-
   virtual void RunTicket(RenderTicketPtr ticket) const = 0;
 
-public slots:
-  void AddTicket(olive::RenderTicketPtr ticket, bool prioritize = false);
+  /**
+   * @brief Queue a ticket to be run by the next available worker
+   *
+   * This function is thread-safe. If called from one of this pool's own workers, the ticket is
+   * queued on that worker.
+   */
+  void AddTicket(RenderTicketPtr ticket, TicketPriority priority = kPriorityBackground);
+
+  /**
+   * @brief Move a queued ticket up to a more urgent priority class
+   *
+   * Does nothing if the ticket is already queued at `priority` or higher, or if it's no longer
+   * queued (i.e. it's running or finished). This function is thread-safe.
+   */
+  void EscalateTicket(RenderTicketPtr ticket, TicketPriority priority);
+
+  /**
+   * @brief Returns how many tickets of this priority class are waiting to be run
+   *
+   * Tickets that are already running aren't counted. This function is thread-safe, though the
+   * value may be out of date as soon as it returns so it should only be used as a hint, e.g. for
+   * background work to back off while the user is waiting on something.
+   */
+  int GetQueuedTicketCount(TicketPriority priority) const
+  {
+    return queued_tickets_[priority].load();
+  }
+
+  /**
+   * @brief Block the calling thread while tickets more urgent than `priority` are waiting
+   *
+   * Lets work that doesn't go through this pool (e.g. decoding done directly by a Task) back off
+   * for renders the user is waiting on. Returns early if `cancelled` is set.
+   */
+  void WaitForMoreUrgentTickets(TicketPriority priority, const QAtomicInt* cancelled) const;
+
+  /**
+   * @brief Milliseconds a ticket can wait before it's run regardless of its priority class
+   */
+  static const qint64 kStarvationThreshold;
+
+  /**
+   * @brief Milliseconds between checks in WaitForMoreUrgentTickets()
+   */
+  static const unsigned long kUrgentTicketPollInterval;
+
+protected:
+  /**
+   * @brief Returns the index of the worker this is called from, or -1 if it isn't one of ours
+   */
+  int GetCurrentThreadIndex() const;
 
 private:
-  void RunNext();
+  RenderTicketPtr TakeNext(ThreadPoolThread *thread);
+
+  void WaitForTicket(ThreadPoolThread *thread);
 
   QVector<ThreadPoolThread*> all_threads_;
 
-  std::list<ThreadPoolThread*> available_threads_;
+  QAtomicInt next_thread_;
+
+  /**
+   * @brief Number of NUMA nodes workers are spread over, 1 if they aren't pinned
+   */
+  int node_count_;
+
+  int pending_tickets_;
+
+  QAtomicInt queued_tickets_[kPriorityCount];
 
-  std::list<RenderTicketPtr> ticket_queue_;
+  QMutex pending_lock_;
 
-private slots:
-  void ThreadDone();
+  QWaitCondition pending_cond_;
+
+  friend class ThreadPoolThread;
 
 };
 
@@ -63,28 +152,42 @@ class ThreadPoolThread : public QThread, public CancelableObject
 {
   Q_OBJECT
 public:
-  ThreadPoolThread(ThreadPool* parent);
+  ThreadPoolThread(ThreadPool* parent, int index);
+
+  void Push(RenderTicketPtr ticket, ThreadPool::TicketPriority priority);
 
-  virtual ~ThreadPoolThread() override;
+  /**
+   * @brief Take the oldest ticket of this priority class
+   *
+   * If `queued_before` is >= 0, a ticket is only returned if it was created before that time.
+   */
+  RenderTicketPtr Take(int priority, qint64 queued_before = -1);
 
-  void RunTicket(RenderTicketPtr ticket);
+  /**
+   * @brief If this ticket is queued here at a lower priority than `priority`, move it up
+   *
+   * Returns TRUE if the ticket was found queued on this thread.
+   */
+  bool Escalate(RenderTicketPtr ticket, ThreadPool::TicketPriority priority);
+
+  int index() const
+  {
+    return index_;
+  }
 
 protected:
   virtual void run() override;
 
   virtual void CancelEvent() override;
 
-signals:
-  void Done();
-
 private:
   ThreadPool* pool_;
 
-  RenderTicketPtr ticket_;
+  int index_;
 
-  QMutex mutex_;
+  std::deque<RenderTicketPtr> queue_[ThreadPool::kPriorityCount];
 
-  QWaitCondition wait_cond_;
+  QMutex queue_lock_;
 
 };
 
@@ -20,12 +20,18 @@
 
 #include "threadticket.h"
 
+#include "common/tracer.h"
+
 namespace olive {
 
 RenderTicket::RenderTicket() :
   started_(false),
   finished_(false),
-  cancelled_(false)
+  cancelled_(false),
+  queue_time_(-1),
+  runner_(nullptr),
+  cancel_time_(-1),
+  requesters_(1)
 {
   SetJobTime();
 }
@@ -70,12 +76,13 @@ bool RenderTicket::WasCancelled()
   return cancelled_;
 }
 
-void RenderTicket::Start()
+void RenderTicket::Start(CancelableObject *runner)
 {
   QMutexLocker locker(&lock_);
 
   if (!started_ && !finished_) {
     started_ = true;
+    runner_ = runner;
   }
 }
 
@@ -91,9 +98,15 @@ void RenderTicket::Finish(QVariant result, bool cancelled)
   } else {
     finished_ = true;
     cancelled_ = cancelled;
+    runner_ = nullptr;
 
     result_ = result;
 
+    if (cancelled && cancel_time_ >= 0) {
+      // How long the work kept running after it was no longer wanted
+      Tracer::Record("Cancel Latency", cancel_time_, Tracer::Now());
+    }
+
     wait_.wakeAll();
 
     locker.unlock();
@@ -107,8 +120,22 @@ void RenderTicket::Cancel()
   QMutexLocker locker(&lock_);
 
   if (!finished_) {
+    if (requesters_ > 1) {
+      // Someone else still wants this result
+      requesters_--;
+      return;
+    }
+
     cancelled_ = true;
 
+    if (runner_) {
+      if (Tracer::IsEnabled()) {
+        cancel_time_ = Tracer::Now();
+      }
+
+      runner_->Cancel();
+    }
+
     if (!started_) {
       finished_ = true;
 
@@ -121,4 +148,16 @@ void RenderTicket::Cancel()
   }
 }
 
+bool RenderTicket::AddRequester()
+{
+  QMutexLocker locker(&lock_);
+
+  if (finished_ || cancelled_) {
+    return false;
+  }
+
+  requesters_++;
+  return true;
+}
+
 }
@@ -27,8 +27,10 @@
 
 #include "codec/frame.h"
 #include "codec/samplebuffer.h"
+#include "common/cancelableobject.h"
 #include "common/timerange.h"
 #include "node/output/viewer/viewer.h"
+#include "render/renderrequest.h"
 
 namespace olive {
 
@@ -48,6 +50,47 @@ public:
     job_time_ = QDateTime::currentMSecsSinceEpoch();
   }
 
+  /**
+   * @brief Tracer time this ticket was queued at, or -1 if it was queued while tracing was off
+   */
+  qint64 GetQueueTime() const
+  {
+    return queue_time_;
+  }
+
+  void SetQueueTime(qint64 t)
+  {
+    queue_time_ = t;
+  }
+
+  /**
+   * @brief What this ticket should do, set by whoever creates it before it's queued
+   *
+   * May be nullptr for tickets that only pass a result along.
+   */
+  const RenderRequest* request() const
+  {
+    return request_.get();
+  }
+
+  void SetRequest(RenderRequestPtr request)
+  {
+    request_ = request;
+  }
+
+  /**
+   * @brief Stats reported by the job, set before Finish() so they're valid once it has finished
+   */
+  const RenderStats& stats() const
+  {
+    return stats_;
+  }
+
+  void SetStats(const RenderStats& stats)
+  {
+    stats_ = stats;
+  }
+
   void WaitForFinished();
 
   QVariant Get();
@@ -61,12 +104,33 @@ public:
     return &lock_;
   }
 
-  void Start();
+  /**
+   * @brief Mark this ticket as running
+   *
+   * If `runner` is set, it's cancelled if this ticket is cancelled before it finishes so long
+   * renders, decodes and sample loops can stop early rather than running to completion for a
+   * result nobody wants. `runner` must stay valid until Finish() is called.
+   */
+  void Start(CancelableObject* runner = nullptr);
 
   void Finish(QVariant result, bool cancelled);
 
+  /**
+   * @brief Cancel this ticket on behalf of one of its requesters
+   *
+   * If the ticket is shared (see AddRequester()), it's only actually cancelled once every
+   * requester has cancelled it. The others still receive the result.
+   */
   void Cancel();
 
+  /**
+   * @brief Register another requester waiting on this ticket's result
+   *
+   * Returns FALSE if the ticket has already finished or been cancelled, in which case it can't be
+   * shared and the caller should make its own.
+   */
+  bool AddRequester();
+
 signals:
   void Finished();
 
@@ -79,12 +143,30 @@ private:
 
   QVariant result_;
 
+  RenderRequestPtr request_;
+
+  RenderStats stats_;
+
   QMutex lock_;
 
   QWaitCondition wait_;
 
   qint64 job_time_;
 
+  qint64 queue_time_;
+
+  CancelableObject* runner_;
+
+  /**
+   * @brief Tracer time Cancel() was called at while running, or -1
+   */
+  qint64 cancel_time_;
+
+  /**
+   * @brief Number of requesters that haven't cancelled yet
+   */
+  int requesters_;
+
 };
 
 using RenderTicketPtr = std::shared_ptr<RenderTicket>;
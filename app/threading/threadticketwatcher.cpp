@@ -20,14 +20,194 @@
 
 #include "threadticketwatcher.h"
 
+#include <QCoreApplication>
+#include <QEvent>
+#include <QHash>
+#include <QThread>
+
 namespace olive {
 
+/**
+ * @brief Collects finished tickets for every watcher living in one thread
+ */
+class RenderTicketWatcher::Dispatcher : public QObject
+{
+public:
+  /**
+   * @brief Get the dispatcher for `thread`, creating it if necessary
+   */
+  static Dispatcher* Get(QThread* thread)
+  {
+    QMutexLocker locker(&instances_lock_);
+
+    Dispatcher* d = instances_.value(thread);
+
+    if (!d) {
+      d = new Dispatcher(thread);
+      d->moveToThread(thread);
+      instances_.insert(thread, d);
+
+      // Nothing will be delivered on this thread anymore once it's finished
+      connect(thread, &QThread::finished, d, &Dispatcher::Orphan, Qt::DirectConnection);
+    }
+
+    return d;
+  }
+
+  /**
+   * @brief Deliver Finished() to `watcher` once `ticket` finishes
+   *
+   * Must be called with the ticket's lock held so it can't finish in between.
+   */
+  void Watch(RenderTicketWatcher* watcher, RenderTicket* ticket)
+  {
+    {
+      QMutexLocker locker(&lock_);
+      waiting_.insert(ticket, watcher);
+      watcher_count_++;
+    }
+
+    // The ticket emits from the render thread, so this only queues the watcher and the event loop
+    // is woken once for however many tickets finish before it gets around to it
+    connect(ticket, &RenderTicket::Finished, this, [this, ticket]{
+      TicketFinished(ticket);
+    }, Qt::DirectConnection);
+  }
+
+  /**
+   * @brief Forget about a watcher that's being deleted
+   */
+  void Remove(RenderTicketWatcher* watcher, RenderTicket* ticket)
+  {
+    QMutexLocker locker(&lock_);
+
+    waiting_.remove(ticket, watcher);
+    finished_.removeAll(watcher);
+    watcher_count_--;
+
+    bool last = (orphaned_ && watcher_count_ == 0);
+
+    locker.unlock();
+
+    if (last) {
+      delete this;
+    }
+  }
+
+protected:
+  virtual bool event(QEvent* e) override
+  {
+    if (e->type() != QEvent::User) {
+      return QObject::event(e);
+    }
+
+    QMutexLocker locker(&lock_);
+
+    flush_posted_ = false;
+
+    // Taken one at a time since slots may delete other watchers, which removes them from the list
+    while (!finished_.isEmpty()) {
+      RenderTicketWatcher* watcher = finished_.takeFirst();
+
+      locker.unlock();
+      emit watcher->Finished(watcher);
+      locker.relock();
+    }
+
+    return true;
+  }
+
+private:
+  Dispatcher(QThread* thread) :
+    thread_(thread),
+    watcher_count_(0),
+    flush_posted_(false),
+    orphaned_(false)
+  {
+  }
+
+  void TicketFinished(RenderTicket* ticket)
+  {
+    QMutexLocker locker(&lock_);
+
+    QList<RenderTicketWatcher*> watchers = waiting_.values(ticket);
+
+    if (watchers.isEmpty()) {
+      return;
+    }
+
+    waiting_.remove(ticket);
+    finished_.append(watchers);
+
+    if (!flush_posted_) {
+      flush_posted_ = true;
+      QCoreApplication::postEvent(this, new QEvent(QEvent::User));
+    }
+  }
+
+  /**
+   * @brief Called when our thread finishes, we're deleted once the last watcher using us is
+   */
+  void Orphan()
+  {
+    {
+      QMutexLocker locker(&instances_lock_);
+      instances_.remove(thread_);
+    }
+
+    QMutexLocker locker(&lock_);
+
+    orphaned_ = true;
+
+    bool unused = (watcher_count_ == 0);
+
+    locker.unlock();
+
+    if (unused) {
+      delete this;
+    }
+  }
+
+  QThread* thread_;
+
+  QMutex lock_;
+
+  QMultiHash<RenderTicket*, RenderTicketWatcher*> waiting_;
+
+  QList<RenderTicketWatcher*> finished_;
+
+  /**
+   * @brief Number of watchers that have a pointer to us
+   */
+  int watcher_count_;
+
+  bool flush_posted_;
+
+  bool orphaned_;
+
+  static QMutex instances_lock_;
+
+  static QHash<QThread*, Dispatcher*> instances_;
+
+};
+
+QMutex RenderTicketWatcher::Dispatcher::instances_lock_;
+QHash<QThread*, RenderTicketWatcher::Dispatcher*> RenderTicketWatcher::Dispatcher::instances_;
+
 RenderTicketWatcher::RenderTicketWatcher(QObject *parent) :
   QObject(parent),
-  ticket_(nullptr)
+  ticket_(nullptr),
+  dispatcher_(nullptr)
 {
 }
 
+RenderTicketWatcher::~RenderTicketWatcher()
+{
+  if (dispatcher_) {
+    dispatcher_->Remove(this, ticket_.get());
+  }
+}
+
 void RenderTicketWatcher::SetTicket(RenderTicketPtr ticket)
 {
   if (ticket_) {
@@ -48,7 +228,8 @@ void RenderTicketWatcher::SetTicket(RenderTicketPtr ticket)
     locker.unlock();
     emit Finished(this);
   } else {
-    connect(ticket_.get(), &RenderTicket::Finished, this, &RenderTicketWatcher::TicketFinished);
+    dispatcher_ = Dispatcher::Get(thread());
+    dispatcher_->Watch(this, ticket_.get());
   }
 }
 
@@ -93,9 +274,4 @@ void RenderTicketWatcher::Cancel()
   }
 }
 
-void RenderTicketWatcher::TicketFinished()
-{
-  emit Finished(this);
-}
-
 }
@@ -25,12 +25,21 @@
 
 namespace olive {
 
+/**
+ * @brief Receives a RenderTicket's result in the thread this object lives in
+ *
+ * Tickets finishing on render threads don't post an event each. They're collected per receiving
+ * thread and Finished() is emitted for all of them from a single event, so hundreds of frames a
+ * second don't cost hundreds of trips through the event loop.
+ */
 class RenderTicketWatcher : public QObject
 {
   Q_OBJECT
 public:
   RenderTicketWatcher(QObject* parent = nullptr);
 
+  virtual ~RenderTicketWatcher() override;
+
   RenderTicketPtr GetTicket() const
   {
     return ticket_;
@@ -52,10 +61,12 @@ signals:
   void Finished(RenderTicketWatcher* watcher);
 
 private:
-  void TicketFinished();
+  class Dispatcher;
 
   RenderTicketPtr ticket_;
 
+  Dispatcher* dispatcher_;
+
 };
 
 }
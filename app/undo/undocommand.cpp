@@ -24,6 +24,9 @@
 
 namespace olive {
 
+const qint64 UndoCommand::kBaseMemoryUsage = 256;
+const qint64 UndoCommand::kHeldNodeMemoryUsage = 16384;
+
 UndoCommand::UndoCommand(QUndoCommand *parent) :
   QUndoCommand(parent)
 {
@@ -44,6 +47,11 @@ void UndoCommand::undo()
   GetRelevantProject()->set_modified(modified_);
 }
 
+qint64 UndoCommand::memory_usage() const
+{
+  return kBaseMemoryUsage;
+}
+
 void UndoCommand::redo_internal()
 {
   QUndoCommand::redo();
@@ -38,6 +38,24 @@ public:
 
   virtual Project* GetRelevantProject() const = 0;
 
+  /**
+   * @brief Estimated memory this command holds in bytes, not including its children
+   *
+   * UndoStack uses this to limit the size of the undo history. Commands that keep removed nodes
+   * or other large state alive for undoing should override this.
+   */
+  virtual qint64 memory_usage() const;
+
+  /**
+   * @brief Estimated memory of a command that holds nothing beyond its own members
+   */
+  static const qint64 kBaseMemoryUsage;
+
+  /**
+   * @brief Rough estimate of the memory a node kept alive by a command takes
+   */
+  static const qint64 kHeldNodeMemoryUsage;
+
 protected:
   virtual void redo_internal();
   virtual void undo_internal();
@@ -20,8 +20,58 @@
 
 #include "undostack.h"
 
+#include <QDebug>
+
+#include "config/config.h"
+#include "undo/undocommand.h"
+
 namespace olive {
 
+UndoStack::UndoStack(QObject *parent) :
+  QObject(parent),
+  index_(0),
+  memory_usage_(0),
+  memory_counter_(MemoryAccounting::kUndoHistory)
+{
+}
+
+UndoStack::~UndoStack()
+{
+  foreach (const Entry& e, commands_) {
+    delete e.command;
+  }
+}
+
+void UndoStack::push(QUndoCommand *command)
+{
+  int old_index = index_;
+  bool old_can_undo = canUndo();
+  bool old_can_redo = canRedo();
+  QString old_undo_text = undoText();
+  QString old_redo_text = redoText();
+
+  command->redo();
+
+  DiscardRedoable();
+
+  // Measured after redo() since many commands only collect what they'll hold onto when they run
+  qint64 usage = EstimateMemoryUsage(command);
+  commands_.append({command, usage});
+  memory_usage_ += usage;
+  index_ = commands_.size();
+
+  TrimToMemoryLimit();
+
+  memory_counter_.Set(memory_usage_);
+
+  EmitChanges(old_index, old_can_undo, old_can_redo, old_undo_text, old_redo_text);
+
+  if (index_ == old_index) {
+    // Trimming can leave the index where it was, but the history has still changed
+    emit indexChanged(index_);
+  }
+}
+
 void UndoStack::pushIfHasChildren(QUndoCommand *command)
 {
   if (command->childCount() > 0) {
@@ -31,4 +81,193 @@ void UndoStack::pushIfHasChildren(QUndoCommand *command)
   }
 }
 
+void UndoStack::clear()
+{
+  int old_index = index_;
+  bool old_can_undo = canUndo();
+  bool old_can_redo = canRedo();
+  QString old_undo_text = undoText();
+  QString old_redo_text = redoText();
+
+  foreach (const Entry& e, commands_) {
+    delete e.command;
+  }
+
+  commands_.clear();
+  index_ = 0;
+  memory_usage_ = 0;
+  memory_counter_.Set(0);
+
+  EmitChanges(old_index, old_can_undo, old_can_redo, old_undo_text, old_redo_text);
+}
+
+bool UndoStack::canUndo() const
+{
+  return index_ > 0;
+}
+
+bool UndoStack::canRedo() const
+{
+  return index_ < commands_.size();
+}
+
+QString UndoStack::undoText() const
+{
+  return canUndo() ? commands_.at(index_ - 1).command->text() : QString();
+}
+
+QString UndoStack::redoText() const
+{
+  return canRedo() ? commands_.at(index_).command->text() : QString();
+}
+
+QAction *UndoStack::createUndoAction(QObject *parent)
+{
+  QAction* a = new QAction(parent);
+
+  a->setEnabled(canUndo());
+  UpdateActionText(a, tr("Undo"), undoText());
+
+  connect(this, &UndoStack::canUndoChanged, a, &QAction::setEnabled);
+  connect(this, &UndoStack::undoTextChanged, a, [a](const QString& text){
+    UpdateActionText(a, tr("Undo"), text);
+  });
+  connect(a, &QAction::triggered, this, &UndoStack::undo);
+
+  return a;
+}
+
+QAction *UndoStack::createRedoAction(QObject *parent)
+{
+  QAction* a = new QAction(parent);
+
+  a->setEnabled(canRedo());
+  UpdateActionText(a, tr("Redo"), redoText());
+
+  connect(this, &UndoStack::canRedoChanged, a, &QAction::setEnabled);
+  connect(this, &UndoStack::redoTextChanged, a, [a](const QString& text){
+    UpdateActionText(a, tr("Redo"), text);
+  });
+  connect(a, &QAction::triggered, this, &UndoStack::redo);
+
+  return a;
+}
+
+qint64 UndoStack::EstimateMemoryUsage(const QUndoCommand *command)
+{
+  const UndoCommand* olive_command = dynamic_cast<const UndoCommand*>(command);
+
+  qint64 usage = olive_command ? olive_command->memory_usage() : UndoCommand::kBaseMemoryUsage;
+
+  for (int i=0; i<command->childCount(); i++) {
+    usage += EstimateMemoryUsage(command->child(i));
+  }
+
+  return usage;
+}
+
+void UndoStack::undo()
+{
+  if (!canUndo()) {
+    return;
+  }
+
+  int old_index = index_;
+  bool old_can_undo = canUndo();
+  bool old_can_redo = canRedo();
+  QString old_undo_text = undoText();
+  QString old_redo_text = redoText();
+
+  index_--;
+  commands_.at(index_).command->undo();
+
+  EmitChanges(old_index, old_can_undo, old_can_redo, old_undo_text, old_redo_text);
+}
+
+void UndoStack::redo()
+{
+  if (!canRedo()) {
+    return;
+  }
+
+  int old_index = index_;
+  bool old_can_undo = canUndo();
+  bool old_can_redo = canRedo();
+  QString old_undo_text = undoText();
+  QString old_redo_text = redoText();
+
+  commands_.at(index_).command->redo();
+  index_++;
+
+  EmitChanges(old_index, old_can_undo, old_can_redo, old_undo_text, old_redo_text);
+}
+
+void UndoStack::DiscardRedoable()
+{
+  while (commands_.size() > index_) {
+    memory_usage_ -= commands_.last().memory_usage;
+    delete commands_.last().command;
+    commands_.removeLast();
+  }
+}
+
+void UndoStack::TrimToMemoryLimit()
+{
+  qint64 memory_limit = Config::Current()[QStringLiteral("UndoMemoryLimit")].toLongLong() * 1048576;
+
+  if (memory_limit <= 0) {
+    return;
+  }
+
+  int trim_count = 0;
+  qint64 trimmed_usage = 0;
+
+  // Only commands that have been done (and could be undone) are trimmed, and never the latest
+  while (memory_usage_ - trimmed_usage > memory_limit && trim_count < index_ - 1) {
+    trimmed_usage += commands_.at(trim_count).memory_usage;
+    delete commands_.at(trim_count).command;
+    trim_count++;
+  }
+
+  if (trim_count) {
+    commands_.remove(0, trim_count);
+    index_ -= trim_count;
+    memory_usage_ -= trimmed_usage;
+
+    qDebug() << "Trimmed" << trim_count << "undo commands, history is now" << memory_usage_ << "bytes";
+  }
+}
+
+void UndoStack::EmitChanges(int old_index, bool old_can_undo, bool old_can_redo, const QString &old_undo_text, const QString &old_redo_text)
+{
+  if (index_ != old_index) {
+    emit indexChanged(index_);
+  }
+
+  if (canUndo() != old_can_undo) {
+    emit canUndoChanged(canUndo());
+  }
+
+  if (canRedo() != old_can_redo) {
+    emit canRedoChanged(canRedo());
+  }
+
+  if (undoText() != old_undo_text) {
+    emit undoTextChanged(undoText());
+  }
+
+  if (redoText() != old_redo_text) {
+    emit redoTextChanged(redoText());
+  }
+}
+
+void UndoStack::UpdateActionText(QAction *action, const QString &prefix, const QString &command_text)
+{
+  if (command_text.isEmpty()) {
+    action->setText(prefix);
+  } else {
+    action->setText(QStringLiteral("%1 %2").arg(prefix, command_text));
+  }
+}
+
 }
@@ -21,20 +21,148 @@
 #ifndef UNDOSTACK_H
 #define UNDOSTACK_H
 
-#include <QUndoStack>
+#include <QAction>
+#include <QUndoCommand>
+#include <QVector>
 
 #include "common/define.h"
+#include "common/memoryaccounting.h"
 
 namespace olive {
 
-class UndoStack : public QUndoStack {
+/**
+ * @brief Olive's undo history
+ *
+ * Works like QUndoStack (commands are QUndoCommands, redo() is called on push(), and the same
+ * signals and actions are provided) but limits history by estimated memory rather than command
+ * count. Commands that hold removed nodes alive for undo can be far heavier than others, so once
+ * the history's estimated size passes the "UndoMemoryLimit" config value (in megabytes, 0 for
+ * unlimited), the oldest commands are deleted until it fits again.
+ *
+ * \see UndoCommand::memory_usage()
+ */
+class UndoStack : public QObject
+{
+  Q_OBJECT
 public:
+  UndoStack(QObject* parent = nullptr);
+
+  virtual ~UndoStack() override;
+
+  DISABLE_COPY_MOVE(UndoStack)
+
+  /**
+   * @brief Run `command` and add it to the history, discarding anything that could be redone
+   *
+   * This function takes ownership of `command`.
+   */
+  void push(QUndoCommand* command);
+
   /**
    * @brief A wrapper for push() that either pushes if the command has children or deletes if not
    *
    * This function takes ownership of `command`, and may delete it so it should never be accessed after this call.
    */
   void pushIfHasChildren(QUndoCommand* command);
+
+  /**
+   * @brief Delete all commands without undoing or redoing them
+   */
+  void clear();
+
+  bool canUndo() const;
+
+  bool canRedo() const;
+
+  QString undoText() const;
+
+  QString redoText() const;
+
+  int count() const
+  {
+    return commands_.size();
+  }
+
+  int index() const
+  {
+    return index_;
+  }
+
+  /**
+   * @brief Create an action that undoes the current command and tracks its text and availability
+   */
+  QAction* createUndoAction(QObject* parent);
+
+  /**
+   * @brief Create an action that redoes the next command and tracks its text and availability
+   */
+  QAction* createRedoAction(QObject* parent);
+
+  /**
+   * @brief Returns the estimated memory held by all commands in the history in bytes
+   */
+  qint64 GetMemoryUsage() const
+  {
+    return memory_usage_;
+  }
+
+  /**
+   * @brief Estimated memory held by `command` and all of its children in bytes
+   */
+  static qint64 EstimateMemoryUsage(const QUndoCommand* command);
+
+public slots:
+  void undo();
+
+  void redo();
+
+signals:
+  void indexChanged(int idx);
+
+  void canUndoChanged(bool can_undo);
+
+  void canRedoChanged(bool can_redo);
+
+  void undoTextChanged(const QString& text);
+
+  void redoTextChanged(const QString& text);
+
+private:
+  struct Entry {
+    QUndoCommand* command;
+    qint64 memory_usage;
+  };
+
+  /**
+   * @brief Delete commands after the current index
+   */
+  void DiscardRedoable();
+
+  /**
+   * @brief Delete the oldest commands until the history fits in the configured memory limit
+   *
+   * The most recent command is always kept, even if it alone is over the limit.
+   */
+  void TrimToMemoryLimit();
+
+  /**
+   * @brief Emit every signal whose value differs from before an operation
+   */
+  void EmitChanges(int old_index, bool old_can_undo, bool old_can_redo, const QString& old_undo_text, const QString& old_redo_text);
+
+  static void UpdateActionText(QAction* action, const QString& prefix, const QString& command_text);
+
+  QVector<Entry> commands_;
+
+  int index_;
+
+  qint64 memory_usage_;
+
+  /**
+   * @brief Reports `memory_usage_` to MemoryAccounting
+   */
+  MemoryAccounting::Counter memory_counter_;
+
 };
 
 }
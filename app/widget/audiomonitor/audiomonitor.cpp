@@ -21,8 +21,10 @@
 #include "audiomonitor.h"
 
 #include <QAudio>
+#include <QDateTime>
 #include <QDebug>
 #include <QPainter>
+#include <QtMath>
 
 #include "audio/audiomanager.h"
 #include "common/qtutils.h"
@@ -35,10 +37,12 @@ const int kMaximumSmoothness = 8;
 
 AudioMonitor::AudioMonitor(QWidget *parent) :
   QOpenGLWidget(parent),
-  file_(nullptr),
+  playing_(false),
+  level_cursor_(0),
   cached_channels_(0)
 {
   values_.resize(kMaximumSmoothness);
+  rms_values_.resize(kMaximumSmoothness);
 
   connect(AudioManager::instance(), &AudioManager::OutputDeviceStarted, this, &AudioMonitor::OutputDeviceSet);
   connect(AudioManager::instance(), &AudioManager::OutputPushed, this, &AudioMonitor::OutputPushed);
@@ -53,6 +57,9 @@ void AudioMonitor::SetParams(const AudioParams &params)
   for (int i=0;i<values_.size();i++) {
     values_[i].resize(params_.channel_count());
     values_[i].fill(0);
+
+    rms_values_[i].resize(params_.channel_count());
+    rms_values_[i].fill(0);
   }
 
   peaked_.resize(params_.channel_count());
@@ -61,29 +68,21 @@ void AudioMonitor::SetParams(const AudioParams &params)
 
 void AudioMonitor::OutputDeviceSet(AudioPlaybackCache *cache, qint64 offset, int playback_speed)
 {
-  Stop();
-
-  file_ = cache->CreatePlaybackDevice(this);
-
-  if (!file_->open(QFile::ReadOnly)) {
-    qWarning() << "Failed to open IO device for AudioMonitor display";
-    Stop();
-    return;
-  }
+  // The output measures what it plays (including speed changes and reversing) so there's nothing
+  // to read here, just start from whatever it writes next
+  Q_UNUSED(cache)
+  Q_UNUSED(offset)
+  Q_UNUSED(playback_speed)
 
-  file_->seek(offset);
-
-  playback_speed_ = playback_speed;
-
-  last_time_ = QDateTime::currentMSecsSinceEpoch();
+  playing_ = true;
+  level_cursor_ = AudioManager::instance()->GetOutputLevels().GetWritePosition();
 
   SetUpdateLoop(true);
 }
 
 void AudioMonitor::Stop()
 {
-  delete file_;
-  file_ = nullptr;
+  playing_ = false;
 }
 
 void AudioMonitor::OutputPushed(const QByteArray &d)
@@ -92,7 +91,8 @@ void AudioMonitor::OutputPushed(const QByteArray &d)
 
   BytesToSampleSummary(d, v);
 
-  PushValue(v);
+  // Pushed samples are short, their peak is close enough to their RMS for the meter
+  PushValue(v, v);
 
   SetUpdateLoop(true);
 }
@@ -210,14 +210,16 @@ void AudioMonitor::paintGL()
   p.drawPixmap(0, 0, cached_background_);
 
   QVector<double> v(params_.channel_count(), 0);
+  QVector<double> rms(params_.channel_count(), 0);
 
-  if (file_) {
-    UpdateValuesFromFile(v);
+  if (playing_) {
+    UpdateValuesFromLevels(v, rms);
   }
 
-  PushValue(v);
+  PushValue(v, rms);
 
-  QVector<double> vals = GetAverages();
+  QVector<double> vals = GetAverages(values_, params_.channel_count());
+  QVector<double> rms_vals = GetAverages(rms_values_, params_.channel_count());
 
   p.setBrush(QColor(0, 0, 0, 128));
   p.setPen(Qt::NoPen);
@@ -246,15 +248,24 @@ void AudioMonitor::paintGL()
     // Convert val to logarithmic scale
     vol = QAudio::convertVolume(vol, QAudio::LinearVolumeScale, QAudio::LogarithmicVolumeScale);
 
-    meter_rect.adjust(0, 0, 0, -qRound(meter_rect.height() * vol));
+    int full_height = meter_rect.height();
+
+    meter_rect.adjust(0, 0, 0, -qRound(full_height * vol));
     p.drawRect(meter_rect);
 
     if (!peaked_.at(i)) {
       p.drawRect(peaks_rect);
     }
+
+    // Mark the RMS level across the bar
+    double rms_vol = QAudio::convertVolume(qMin(1.0, rms_vals.at(i)), QAudio::LinearVolumeScale, QAudio::LogarithmicVolumeScale);
+    if (rms_vol > 0) {
+      int rms_y = full_meter_rect.bottom() - qRound(full_height * rms_vol);
+      p.fillRect(QRect(channel_x, rms_y, channel_width, 2), palette().text().color());
+    }
   }
 
-  if (all_zeroes && !file_) {
+  if (all_zeroes && !playing_) {
     // Optimize by disabling the update loop
     SetUpdateLoop(false);
   }
@@ -266,62 +277,42 @@ void AudioMonitor::mousePressEvent(QMouseEvent *)
   update();
 }
 
-void AudioMonitor::UpdateValuesFromFile(QVector<double>& v)
+void AudioMonitor::UpdateValuesFromLevels(QVector<double> &peaks, QVector<double> &rms)
 {
-  // Determines how many milliseconds have passed since last update
-  qint64 current_time = QDateTime::currentMSecsSinceEpoch();
-  qint64 time_passed = current_time - last_time_;
-  int abs_speed = qAbs(playback_speed_);
-
-  // Multiply by speed if the speed is not 1
-  if (abs_speed != 1) {
-    time_passed *= abs_speed;
-  }
+  const AudioLevelRing& levels = AudioManager::instance()->GetOutputLevels();
 
-  // Convert ms to float seconds and determine how many bytes that is
-  qint64 bytes_to_read = params_.time_to_bytes(static_cast<double>(time_passed) * 0.001);
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
 
-  if (playback_speed_ < 0) {
-    // If reversing, jump back by the amount of bytes we're going to read
-    bytes_to_read = qMin(bytes_to_read, file_->pos());
+  QVector<double> sum_of_squares(rms.size(), 0);
+  int blocks = 0;
 
-    file_->seek(file_->pos() - bytes_to_read);
-  }
+  AudioLevelRing::Block b;
 
-  // Read bytes in from file
-  QByteArray b = file_->read(bytes_to_read);
+  while (levels.IsNextAudible(level_cursor_, now) && levels.Read(&level_cursor_, &b)) {
+    int channels = qMin(b.channels, peaks.size());
 
-  if (playback_speed_ < 0) {
-    // If reversing, head back to where we were before the read so that the next read starts
-    // from where we left off
-    file_->seek(file_->pos() - bytes_to_read);
-  }
-
-  // If speed is not 1, transform it here
-  if (abs_speed != 1) {
-    int sample_sz = params_.samples_to_bytes(1);
-    int in_nb_samples = params_.bytes_to_samples(b.size());
-    int out_nb_samples = in_nb_samples / abs_speed;
-    QByteArray speed_adjusted(out_nb_samples * sample_sz, Qt::Uninitialized);
-
-    for (int i=0;i<out_nb_samples;i++) {
-      memcpy(speed_adjusted.data() + i * sample_sz,
-             b.constData() + i * abs_speed * sample_sz,
-             sample_sz);
+    for (int i=0; i<channels; i++) {
+      peaks[i] = qMax(peaks.at(i), static_cast<double>(b.peak[i]));
+      sum_of_squares[i] += static_cast<double>(b.rms[i]) * b.rms[i];
     }
 
-    b = speed_adjusted;
+    blocks++;
   }
 
-  BytesToSampleSummary(b, v);
-
-  last_time_ = current_time;
+  if (blocks) {
+    for (int i=0; i<rms.size(); i++) {
+      rms[i] = qSqrt(sum_of_squares.at(i) / blocks);
+    }
+  }
 }
 
-void AudioMonitor::PushValue(const QVector<double> &v)
+void AudioMonitor::PushValue(const QVector<double> &v, const QVector<double> &rms)
 {
   values_.removeFirst();
   values_.append(v);
+
+  rms_values_.removeFirst();
+  rms_values_.append(rms);
 }
 
 void AudioMonitor::BytesToSampleSummary(const QByteArray &b, QVector<double> &v)
@@ -332,7 +323,7 @@ void AudioMonitor::BytesToSampleSummary(const QByteArray &b, QVector<double> &v)
   for (int i=0;i<nb_samples;i++) {
     int channel = i % params_.channel_count();
 
-    float abs_sample = samples[i];
+    float abs_sample = qAbs(samples[i]);
 
     if (abs_sample > v.at(channel)) {
       v.replace(channel, abs_sample);
@@ -340,18 +331,18 @@ void AudioMonitor::BytesToSampleSummary(const QByteArray &b, QVector<double> &v)
   }
 }
 
-QVector<double> AudioMonitor::GetAverages() const
+QVector<double> AudioMonitor::GetAverages(const QVector<QVector<double> > &values, int channels)
 {
-  QVector<double> v(params_.channel_count(), 0);
+  QVector<double> v(channels, 0);
 
-  for (int i=0;i<values_.size();i++) {
-    for (int j=0;j<v.size();j++) {
-      v[j] += values_.at(i).at(j);
+  for (int i=0;i<values.size();i++) {
+    for (int j=0;j<v.size() && j<values.at(i).size();j++) {
+      v[j] += values.at(i).at(j);
     }
   }
 
   for (int i=0;i<v.size();i++) {
-    v[i] /= static_cast<double>(values_.size());
+    v[i] /= static_cast<double>(values.size());
   }
 
   return v;
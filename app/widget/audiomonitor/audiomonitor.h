@@ -21,7 +21,6 @@
 #ifndef AUDIOMONITORWIDGET_H
 #define AUDIOMONITORWIDGET_H
 
-#include <QFile>
 #include <QOpenGLWidget>
 #include <QTimer>
 
@@ -55,22 +54,27 @@ protected:
 private:
   void SetUpdateLoop(bool e);
 
-  void UpdateValuesFromFile(QVector<double> &v);
+  /**
+   * @brief Take every level block the output has made audible since the last update
+   */
+  void UpdateValuesFromLevels(QVector<double> &peaks, QVector<double> &rms);
 
-  void PushValue(const QVector<double>& v);
+  void PushValue(const QVector<double>& v, const QVector<double>& rms);
 
   void BytesToSampleSummary(const QByteArray& bytes, QVector<double>& v);
 
-  QVector<double> GetAverages() const;
+  static QVector<double> GetAverages(const QVector< QVector<double> >& values, int channels);
 
   AudioParams params_;
 
-  QIODevice* file_;
-  qint64 last_time_;
+  /// TRUE while the output is playing a device, whose levels are read from the output
+  bool playing_;
 
-  int playback_speed_;
+  /// Position in AudioManager::GetOutputLevels() of the last block read
+  qint64 level_cursor_;
 
   QVector< QVector<double> > values_;
+  QVector< QVector<double> > rms_values_;
   QVector<bool> peaked_;
 
   QPixmap cached_background_;
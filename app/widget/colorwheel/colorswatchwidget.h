@@ -57,6 +57,16 @@ protected:
 
   Color GetManagedColor(const Color& input) const;
 
+  ColorProcessorPtr to_linear_processor() const
+  {
+    return to_linear_processor_;
+  }
+
+  ColorProcessorPtr to_display_processor() const
+  {
+    return to_display_processor_;
+  }
+
 private:
   void SetSelectedColorInternal(const Color& c, bool external);
 
@@ -20,10 +20,13 @@
 
 #include "colorwheelwidget.h"
 
+#include <QDebug>
 #include <QPainter>
 #include <QtMath>
+#include <QVector4D>
 
 #include "common/clamp.h"
+#include "common/filefunctions.h"
 #include "node/node.h"
 
 namespace olive {
@@ -31,98 +34,177 @@ namespace olive {
 #define M_180_OVER_PI 57.295791433133264917914229473464
 #define M_RADIAN_TO_0_1 0.15915497620314795810531730409296
 
-ColorWheelWidget::ColorWheelWidget(QWidget *parent) :
-  ColorSwatchWidget(parent),
+ColorWheelDisplay::ColorWheelDisplay(QWidget *parent) :
+  ManagedDisplayWidget(parent),
   val_(1.0f),
-  force_redraw_(false)
+  selector_radius_(1),
+  selector_color_(Qt::white),
+  force_redraw_(true)
 {
 }
 
-Color ColorWheelWidget::GetColorFromScreenPos(const QPoint &p) const
+ColorWheelDisplay::~ColorWheelDisplay()
 {
-  return GetColorFromTriangle(GetTriangleFromCoords(rect().center(), p));
+  OnDestroy();
 }
 
-void ColorWheelWidget::resizeEvent(QResizeEvent *e)
+void ColorWheelDisplay::SetColorProcessor(ColorProcessorPtr to_linear, ColorProcessorPtr to_display)
 {
-  ColorSwatchWidget::resizeEvent(e);
+  to_linear_ = to_linear;
+  to_display_ = to_display;
+  force_redraw_ = true;
+  update();
+}
 
-  emit DiameterChanged(GetDiameter());
+void ColorWheelDisplay::SetValue(float val)
+{
+  if (val_ != val) {
+    val_ = val;
+    force_redraw_ = true;
+    update();
+  }
 }
 
-void ColorWheelWidget::paintEvent(QPaintEvent *e)
+void ColorWheelDisplay::SetSelector(const QPoint &pos, int radius, Qt::GlobalColor color)
 {
-  ColorSwatchWidget::paintEvent(e);
+  selector_pos_ = pos;
+  selector_radius_ = radius;
+  selector_color_ = color;
+  update();
+}
 
-  int diameter = GetDiameter();
+void ColorWheelDisplay::OnPaint()
+{
+  QColor bg_color = palette().window().color();
+  renderer()->ClearDestination(bg_color.redF(), bg_color.greenF(), bg_color.blueF());
 
-  // Half diameter
-  int radius = diameter / 2;
+  int device_width = qRound(width() * devicePixelRatioF());
+  int device_height = qRound(height() * devicePixelRatioF());
+  int device_diameter = qMin(device_width, device_height);
 
-  if (cached_wheel_.width() != diameter || force_redraw_) {
-    cached_wheel_ = QPixmap(QSize(diameter, diameter));
-    cached_wheel_.fill(Qt::transparent);
-    force_redraw_ = false;
+  if (device_diameter <= 0) {
+    return;
+  }
 
-    QPainter p(&cached_wheel_);
-    QPoint center(radius, radius);
+  if (wheel_shader_.isNull()) {
+    wheel_shader_ = renderer()->CreateNativeShader(ShaderCode(FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/colorwheel.frag"))));
+    composite_shader_ = renderer()->CreateNativeShader(ShaderCode(FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/solidover.frag"))));
 
-    for (int i=0;i<diameter;i++) {
-      for (int j=0;j<diameter;j++) {
-        Triangle tri = GetTriangleFromCoords(center, j, i);
+    if (wheel_shader_.isNull() || composite_shader_.isNull()) {
+      qCritical() << "Failed to create color wheel shaders";
+      return;
+    }
+  }
 
-        if (tri.hypotenuse <= radius) {
-          Color managed = GetManagedColor(GetColorFromTriangle(tri));
-          QColor c = managed.toQColor();
+  if (!wheel_texture_ || wheel_texture_->width() != device_diameter || force_redraw_) {
+    RegenerateWheel(device_diameter);
 
-          // Very basic antialiasing around the edges of the wheel
-          qreal alpha = qMin(1.0, radius - tri.hypotenuse);
-          c.setAlphaF(alpha);
+    // Drawing into textures leaves the renderer's framebuffer unbound, rebind the widget's
+    makeCurrent();
+  }
 
-          p.setPen(c);
+  if (!wheel_texture_) {
+    return;
+  }
 
-          p.drawPoint(i, j);
-        }
-      }
-    }
+  ShaderJob job;
+  job.InsertValue(QStringLiteral("ove_maintex"), ShaderValue(QVariant::fromValue(wheel_texture_), NodeParam::kTexture));
+  job.InsertValue(QStringLiteral("ove_background"), ShaderValue(QVariant::fromValue(QVector4D(bg_color.redF(), bg_color.greenF(), bg_color.blueF(), 1.0f)), NodeParam::kVec4));
+  renderer()->Blit(composite_shader_, job, VideoParams(device_width, device_height, VideoParams::kFormatUnsigned8, VideoParams::kRGBAChannelCount), false);
+
+  // Draw selector
+  QPainter p(inner_widget());
+  p.setPen(QPen(selector_color_, qMax(1, selector_radius_ / 4)));
+  p.setBrush(Qt::NoBrush);
+  p.drawEllipse(selector_pos_, selector_radius_, selector_radius_);
+}
+
+void ColorWheelDisplay::OnDestroy()
+{
+  wheel_texture_ = nullptr;
+
+  if (!wheel_shader_.isNull()) {
+    renderer()->DestroyNativeShader(wheel_shader_);
+    wheel_shader_.clear();
+  }
+
+  if (!composite_shader_.isNull()) {
+    renderer()->DestroyNativeShader(composite_shader_);
+    composite_shader_.clear();
+  }
+
+  ManagedDisplayWidget::OnDestroy();
+}
+
+void ColorWheelDisplay::RegenerateWheel(int diameter)
+{
+  VideoParams wheel_params(diameter, diameter, VideoParams::kFormatFloat16, VideoParams::kRGBAChannelCount);
+
+  TexturePtr wheel = renderer()->CreateTexture(wheel_params);
+
+  if (!wheel) {
+    wheel_texture_ = nullptr;
+    return;
   }
 
-  QPainter p(this);
+  ShaderJob job;
+  job.InsertValue(QStringLiteral("ove_diameter"), ShaderValue(diameter, NodeParam::kFloat));
+  job.InsertValue(QStringLiteral("ove_value"), ShaderValue(val_, NodeParam::kFloat));
+  renderer()->BlitToTexture(wheel_shader_, job, wheel.get());
+
+  if (to_linear_ && to_display_) {
+    // Wheel colors are in the input space, take them to the reference space and then the display
+    TexturePtr reference = renderer()->CreateTexture(wheel_params);
+    renderer()->BlitColorManaged(to_linear_, wheel, true, reference.get());
 
-  // Draw wheel pixmap
-  int x, y;
+    TexturePtr display = renderer()->CreateTexture(wheel_params);
+    renderer()->BlitColorManaged(to_display_, reference, true, display.get());
 
-  if (width() == height()) {
-    x = 0;
-    y = 0;
-  } else if (width() > height()) {
-    x = (width() - height()) / 2;
-    y = 0;
-  } else {
-    x = 0;
-    y = (height() - width()) / 2;
+    wheel = display;
   }
 
-  p.drawPixmap(x, y, cached_wheel_);
+  wheel_texture_ = wheel;
+  force_redraw_ = false;
+}
 
+ColorWheelWidget::ColorWheelWidget(QWidget *parent) :
+  ColorSwatchWidget(parent),
+  val_(1.0f)
+{
+  display_ = new ColorWheelDisplay(this);
 
-  // Draw selection
-  // Really rough algorithm for determining whether the selector UI should be white or black
+  // Mouse events fall through to ColorSwatchWidget
+  display_->setAttribute(Qt::WA_TransparentForMouseEvents);
+}
 
+Color ColorWheelWidget::GetColorFromScreenPos(const QPoint &p) const
+{
+  return GetColorFromTriangle(GetTriangleFromCoords(rect().center(), p));
+}
 
-  int selector_radius = qMax(1, radius / 32);
-  p.setPen(QPen(GetUISelectorColor(), qMax(1, selector_radius / 4)));
-  p.setBrush(Qt::NoBrush);
+void ColorWheelWidget::resizeEvent(QResizeEvent *e)
+{
+  ColorSwatchWidget::resizeEvent(e);
+
+  // Keep the display square and centered, wherever the wheel is drawn
+  int diameter = GetDiameter();
+  display_->setGeometry((width() - diameter) / 2, (height() - diameter) / 2, diameter, diameter);
+
+  UpdateSelector();
 
-  p.drawEllipse(GetCoordsFromColor(GetSelectedColor()), selector_radius, selector_radius);
+  emit DiameterChanged(diameter);
 }
 
 void ColorWheelWidget::SelectedColorChangedEvent(const Color &c, bool external)
 {
   if (external) {
-    force_redraw_ = true;
     val_ = clamp(c.value(), 0.0, 1.0);
+
+    display_->SetColorProcessor(to_linear_processor(), to_display_processor());
+    display_->SetValue(val_);
   }
+
+  UpdateSelector();
 }
 
 int ColorWheelWidget::GetDiameter() const
@@ -177,4 +259,11 @@ QPoint ColorWheelWidget::GetCoordsFromColor(const Color &c) const
   return pos;
 }
 
+void ColorWheelWidget::UpdateSelector()
+{
+  int selector_radius = qMax(1, GetDiameter() / 2 / 32);
+
+  display_->SetSelector(GetCoordsFromColor(GetSelectedColor()) - display_->pos(), selector_radius, GetUISelectorColor());
+}
+
 }
@@ -25,9 +25,61 @@
 
 #include "colorswatchwidget.h"
 #include "render/color.h"
+#include "widget/manageddisplay/manageddisplay.h"
 
 namespace olive {
 
+/**
+ * @brief Draws the wheel for ColorWheelWidget on the GPU
+ *
+ * The wheel is generated by a shader and then converted to the display through the same OCIO GPU
+ * path the viewer uses, so it only costs a few blits when it's resized or the transform changes.
+ * Drawing the selector then only re-composites the cached wheel.
+ */
+class ColorWheelDisplay : public ManagedDisplayWidget
+{
+  Q_OBJECT
+public:
+  ColorWheelDisplay(QWidget* parent = nullptr);
+
+  virtual ~ColorWheelDisplay() override;
+
+  void SetColorProcessor(ColorProcessorPtr to_linear, ColorProcessorPtr to_display);
+
+  void SetValue(float val);
+
+  void SetSelector(const QPoint& pos, int radius, Qt::GlobalColor color);
+
+protected slots:
+  virtual void OnPaint() override;
+
+  virtual void OnDestroy() override;
+
+private:
+  void RegenerateWheel(int diameter);
+
+  ColorProcessorPtr to_linear_;
+
+  ColorProcessorPtr to_display_;
+
+  float val_;
+
+  QPoint selector_pos_;
+
+  int selector_radius_;
+
+  Qt::GlobalColor selector_color_;
+
+  QVariant wheel_shader_;
+
+  QVariant composite_shader_;
+
+  TexturePtr wheel_texture_;
+
+  bool force_redraw_;
+
+};
+
 class ColorWheelWidget : public ColorSwatchWidget
 {
   Q_OBJECT
@@ -42,8 +94,6 @@ protected:
 
   virtual void resizeEvent(QResizeEvent* e) override;
 
-  virtual void paintEvent(QPaintEvent* e) override;
-
   virtual void SelectedColorChangedEvent(const Color& c, bool external) override;
 
 private:
@@ -63,11 +113,11 @@ private:
   Color GetColorFromTriangle(const Triangle& tri) const;
   QPoint GetCoordsFromColor(const Color& c) const;
 
-  QPixmap cached_wheel_;
+  void UpdateSelector();
 
-  float val_;
+  ColorWheelDisplay* display_;
 
-  bool force_redraw_;
+  float val_;
 
 };
 
@@ -145,7 +145,6 @@ void CurveView::drawBackground(QPainter *painter, const QRectF &rect)
   int y_start = qCeil(rect.top() / y_grid_interval) * y_grid_interval;
 
   QPointF scene_bottom_left = mapToScene(QPoint(0, qRound(rect.height())));
-  QPointF scene_top_right = mapToScene(QPoint(qRound(rect.width()), 0));
 
   // Add vertical lines
   for (int i=x_start;i<rect.right();i+=x_grid_interval) {
@@ -164,84 +163,49 @@ void CurveView::drawBackground(QPainter *painter, const QRectF &rect)
   // Draw grid
   painter->drawLines(lines);
 
-  // Draw keyframe lines
+  // Draw keyframe curves by sampling the visible range once per pixel column, so redrawing costs
+  // the same however many keyframes a track has
+  int columns = qMax(1, qCeil(rect.width()));
+  double column_width = rect.width() / columns;
+
+  QPolygonF curve(columns + 1);
+  for (int i=0;i<=columns;i++) {
+    curve[i].setX(rect.left() + i * column_width);
+  }
+
   foreach (NodeInput* input, connected_inputs_) {
     if (input->is_keyframing()) {
-      foreach (const NodeInput::KeyframeTrack& track, input->keyframe_tracks()) {
+      Node* node = input->parentNode();
+
+      // Time adjustments between nodes are offsets, so mapping both ends of the visible range and
+      // interpolating between them gives the node time of every column without walking the graph
+      // for each one
+      rational node_start = GetAdjustedTime(GetTimeTarget(), node, rational::fromDouble(rect.left() / GetScale()), NodeParam::kInput);
+      rational node_end = GetAdjustedTime(GetTimeTarget(), node, rational::fromDouble(rect.right() / GetScale()), NodeParam::kInput);
+
+      double node_start_dbl = node_start.toDouble();
+      double node_step = (node_end.toDouble() - node_start_dbl) / columns;
+
+      QVector<rational> times(columns + 1);
+      for (int i=0;i<=columns;i++) {
+        times[i] = rational::fromDouble(node_start_dbl + i * node_step);
+      }
+
+      const QVector<NodeInput::KeyframeTrack>& tracks = input->keyframe_tracks();
+
+      for (int i=0;i<tracks.size();i++) {
+        const NodeInput::KeyframeTrack& track = tracks.at(i);
+
         if (!track.isEmpty()) {
           painter->setPen(QPen(keyframe_colors_.value(&track), qMax(1, fontMetrics().height() / 4)));
 
-          QVector<QLineF> keyframe_lines;
-
-          // Draw straight line leading to first keyframe
-          QPointF first_key_pos = item_map().value(track.first().get())->pos();
-          keyframe_lines.append(QLineF(QPointF(scene_bottom_left.x(), first_key_pos.y()), first_key_pos));
-
-          // Draw lines between each keyframe
-          for (int i=1;i<track.size();i++) {
-            NodeKeyframePtr before = track.at(i-1);
-            NodeKeyframePtr after = track.at(i);
-
-            KeyframeViewItem* before_item = item_map().value(before.get());
-            KeyframeViewItem* after_item = item_map().value(after.get());
-
-            if (before->type() == NodeKeyframe::kHold) {
-              // Draw a hold keyframe (basically a right angle)
-              keyframe_lines.append(QLineF(before_item->pos().x(),
-                                           before_item->pos().y(),
-                                           after_item->pos().x(),
-                                           before_item->pos().y()));
-              keyframe_lines.append(QLineF(after_item->pos().x(),
-                                           before_item->pos().y(),
-                                           after_item->pos().x(),
-                                           after_item->pos().y()));
-            } else if (before->type() == NodeKeyframe::kBezier && after->type() == NodeKeyframe::kBezier) {
-              // Draw a cubic bezier
-
-              // Cubic beziers have two control points, so we can just use both
-              QPointF before_control_point = before_item->pos() + ScalePoint(before->bezier_control_out());
-              QPointF after_control_point = after_item->pos() + ScalePoint(after->bezier_control_in());
-
-              QPainterPath path;
-              path.moveTo(before_item->pos());
-              path.cubicTo(before_control_point, after_control_point, after_item->pos());
-              painter->drawPath(path);
-
-            } else if (before->type() == NodeKeyframe::kBezier || after->type() == NodeKeyframe::kBezier) {
-              // Draw a quadratic bezier
-
-              // Quadratic beziers have a single control point, we just have to determine which it is
-              QPointF key_anchor;
-              QPointF control_point;
-
-              if (before->type() == NodeKeyframe::kBezier) {
-                key_anchor = before_item->pos();
-                control_point = before->bezier_control_out();
-              } else {
-                key_anchor = after_item->pos();
-                control_point = after->bezier_control_in();
-              }
-
-              // Scale control point
-              control_point = key_anchor + ScalePoint(control_point);
-
-              // Create the path from both keyframes
-              QPainterPath path;
-              path.moveTo(before_item->pos());
-              path.quadTo(control_point, after_item->pos());
-              painter->drawPath(path);
-
-            } else {
-              // Linear to linear
-              keyframe_lines.append(QLineF(before_item->pos(), after_item->pos()));
-            }
-          }
+          QVector<QVariant> values = input->get_values_at_times_for_track(times, i);
 
-          // Draw straight line leading from end keyframe
-          QPointF last_key_pos = item_map().value(track.last().get())->pos();
-          keyframe_lines.append(QLineF(last_key_pos, QPointF(scene_top_right.x(), last_key_pos.y())));
+          for (int j=0;j<values.size();j++) {
+            curve[j].setY(GetItemYFromKeyframeValue(values.at(j).toDouble()));
+          }
 
-          painter->drawLines(keyframe_lines);
+          painter->drawPolyline(curve);
         }
       }
     }
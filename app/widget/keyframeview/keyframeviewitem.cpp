@@ -20,10 +20,12 @@
 
 #include "keyframeviewitem.h"
 
+#include <algorithm>
 #include <QApplication>
 #include <QPainter>
 #include <QStyleOptionGraphicsItem>
 #include <QWidget>
+#include <QtMath>
 
 #include "common/qtutils.h"
 #include "node/input.h"
@@ -76,6 +78,11 @@ NodeKeyframePtr KeyframeViewItem::key() const
 
 void KeyframeViewItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
 {
+  if (!(option->state & QStyle::State_Selected) && IsCoveredByPreviousKeyframe()) {
+    // Dense tracks would otherwise draw dozens of identical keyframes on top of each other
+    return;
+  }
+
   painter->setRenderHint(QPainter::Antialiasing);
 
   painter->setPen(Qt::black);
@@ -115,6 +122,25 @@ void KeyframeViewItem::TimeTargetChangedEvent(Node *)
   UpdatePos();
 }
 
+bool KeyframeViewItem::IsCoveredByPreviousKeyframe() const
+{
+  const NodeInput::KeyframeTrack& track = key_->parent()->keyframe_tracks().at(key_->track());
+
+  NodeInput::KeyframeTrack::const_iterator it = std::lower_bound(track.constBegin(), track.constEnd(), key_->time(),
+                                                                 [](const NodeKeyframePtr& k, const rational& t) {
+    return k->time() < t;
+  });
+
+  if (it == track.constBegin()) {
+    return false;
+  }
+
+  // Time adjustments are offsets so the distance between keyframes is the same in both time bases
+  qreal previous_x = pos().x() - (key_->time() - (*(it - 1))->time()).toDouble() * scale_;
+
+  return qFloor(previous_x) == qFloor(pos().x());
+}
+
 void KeyframeViewItem::UpdatePos()
 {
   rational adjusted = GetAdjustedTime(key_->parent()->parentNode(), GetTimeTarget(), key_->time(), NodeParam::kOutput);
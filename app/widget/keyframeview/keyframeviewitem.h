@@ -48,6 +48,14 @@ protected:
   virtual void TimeTargetChangedEvent(Node* ) override;
 
 private:
+  /**
+   * @brief Returns TRUE if the keyframe before this one on its track lands on the same pixel column
+   *
+   * Only the first keyframe of each column is painted, the rest stay in the scene so they can
+   * still be selected.
+   */
+  bool IsCoveredByPreviousKeyframe() const;
+
   NodeKeyframePtr key_;
 
   double scale_;
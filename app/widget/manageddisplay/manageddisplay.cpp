@@ -61,6 +61,7 @@ ManagedDisplayWidget::ManagedDisplayWidget(QWidget *parent) :
 
     // Create OpenGL renderer
     attached_renderer_ = new OpenGLRenderer(this);
+    attached_renderer_->SetTextureOrigin(MemoryAccounting::kTextureDisplay);
   } else {
     inner_widget_ = nullptr;
   }
@@ -251,7 +251,7 @@ void MenuShared::EnableDisableTriggered()
 
 void MenuShared::NestTriggered()
 {
-  qDebug() << "FIXME: Stub";
+  PanelManager::instance()->CurrentlyFocused()->Nest();
 }
 
 void MenuShared::DefaultTransitionTriggered()
@@ -22,6 +22,8 @@
 
 #include <QCheckBox>
 #include <QFontComboBox>
+#include <QGuiApplication>
+#include <QScreen>
 #include <QVector2D>
 #include <QVector3D>
 #include <QVector4D>
@@ -42,10 +44,19 @@ namespace olive {
 
 NodeParamViewWidgetBridge::NodeParamViewWidgetBridge(NodeInput *input, QObject *parent) :
   QObject(parent),
-  input_(input)
+  input_(input),
+  drag_has_pending_value_(false)
 {
   CreateWidgets();
 
+  // Slider drags can report values far faster than the viewer can show them, so they're applied
+  // no more than once per display refresh
+  qreal refresh_rate = QGuiApplication::primaryScreen() ? QGuiApplication::primaryScreen()->refreshRate() : 60.0;
+  drag_timer_.setInterval(qMax(1, qRound(1000.0 / qMax(refresh_rate, 1.0))));
+  drag_timer_.setSingleShot(true);
+  drag_timer_.setTimerType(Qt::PreciseTimer);
+  connect(&drag_timer_, &QTimer::timeout, this, &NodeParamViewWidgetBridge::DragTimerTimeout);
+
   connect(input_, &NodeInput::ValueChanged, this, &NodeParamViewWidgetBridge::InputValueChanged);
   connect(input_, &NodeInput::PropertyChanged, this, &NodeParamViewWidgetBridge::PropertyChanged);
 }
@@ -239,13 +250,23 @@ void NodeParamViewWidgetBridge::ProcessSlider(SliderBase *slider, const QVariant
       dragger_.Start(input_, node_time, slider_track);
     }
 
-    dragger_.Drag(value);
+    if (drag_timer_.isActive()) {
+      // Too soon after the last update, only the latest value is applied when the timer fires
+      drag_pending_value_ = value;
+      drag_has_pending_value_ = true;
+    } else {
+      dragger_.Drag(value);
+      drag_timer_.start();
+    }
 
     //input_->parentNode()->InvalidateVisible(input_, input_);
 
   } else if (dragger_.IsStarted()) {
 
-    // We were dragging and just stopped
+    // We were dragging and just stopped, the final value supersedes anything pending
+    drag_timer_.stop();
+    drag_has_pending_value_ = false;
+
     dragger_.Drag(value);
     dragger_.End();
 
@@ -255,6 +276,17 @@ void NodeParamViewWidgetBridge::ProcessSlider(SliderBase *slider, const QVariant
   }
 }
 
+void NodeParamViewWidgetBridge::DragTimerTimeout()
+{
+  if (drag_has_pending_value_ && dragger_.IsStarted()) {
+    drag_has_pending_value_ = false;
+    dragger_.Drag(drag_pending_value_);
+
+    // Keep limiting the rate for as long as values are still coming in
+    drag_timer_.start();
+  }
+}
+
 void NodeParamViewWidgetBridge::WidgetCallback()
 {
   switch (input_->data_type()) {
@@ -22,6 +22,7 @@
 #define NODEPARAMVIEWWIDGETBRIDGE_H
 
 #include <QObject>
+#include <QTimer>
 
 #include "node/input.h"
 #include "node/inputdragger.h"
@@ -70,11 +71,22 @@ private:
 
   NodeInputDragger dragger_;
 
+  /**
+   * @brief Limits how often slider drags are applied to the input, see ProcessSlider()
+   */
+  QTimer drag_timer_;
+
+  QVariant drag_pending_value_;
+
+  bool drag_has_pending_value_;
+
   NodeParamViewScrollBlocker scroll_filter_;
 
 private slots:
   void WidgetCallback();
 
+  void DragTimerTimeout();
+
   void InputValueChanged(const TimeRange& range);
 
   void PropertyChanged(const QString& key, const QVariant& value);
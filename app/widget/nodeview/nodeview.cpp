@@ -45,16 +45,16 @@ NodeView::NodeView(QWidget *parent) :
   setMouseTracking(true);
   setRenderHint(QPainter::Antialiasing);
   setViewportUpdateMode(FullViewportUpdate);
-
-  connect(&scene_, &QGraphicsScene::changed, this, &NodeView::ItemsChanged);
   connect(this, &NodeView::customContextMenuRequested, this, &NodeView::ShowContextMenu);
 
   ConnectSelectionChangedSignal();
 
   SetFlowDirection(NodeViewCommon::kTopToBottom);
 
-  // Set massive scene rect and hide the scrollbars to create an "infinite space" effect
-  scene_.setSceneRect(-1000000, -1000000, 2000000, 2000000);
+  // Set massive scene rect and hide the scrollbars to create an "infinite space" effect. This is
+  // set on the view rather than the scene so the scene's BSP index only spans the items, a
+  // massive index rect would put every node in the same leaf.
+  setSceneRect(-1000000, -1000000, 2000000, 2000000);
   setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
   setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
 
@@ -295,15 +295,6 @@ void NodeView::Duplicate()
   AttachNodesToCursor(duplicated_nodes);
 }
 
-void NodeView::ItemsChanged()
-{
-  QHash<NodeEdge *, NodeViewEdge *>::const_iterator i;
-
-  for (i=scene_.edge_map().constBegin(); i!=scene_.edge_map().constEnd(); i++) {
-    i.value()->Adjust();
-  }
-}
-
 void NodeView::keyPressEvent(QKeyEvent *event)
 {
   super::keyPressEvent(event);
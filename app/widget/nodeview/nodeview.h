@@ -149,13 +149,6 @@ private slots:
 
   void GraphEdgeRemoved(NodeEdgePtr edge);
 
-  /**
-   * @brief Internal function triggered when any change is signalled from the QGraphicsScene
-   *
-   * Current primary function is to inform all NodeViewEdges to re-adjust in case any Nodes have moved
-   */
-  void ItemsChanged();
-
   /**
    * @brief Receiver for when the scene's selected items change
    */
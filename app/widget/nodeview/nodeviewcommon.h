@@ -44,6 +44,16 @@ public:
     }
   }
 
+  /**
+   * @brief Level of detail below which items are drawn as plain shapes
+   *
+   * Text, gradients and arrows are unreadable when zoomed this far out and dominate paint time for
+   * large graphs.
+   */
+  static qreal SimplifiedLevelOfDetail() {
+    return 0.4;
+  }
+
   static bool DirectionsAreOpposing(FlowDirection a, FlowDirection b) {
     return ((a == NodeViewCommon::kLeftToRight && b == NodeViewCommon::kRightToLeft)
             || (a == NodeViewCommon::kRightToLeft && b == NodeViewCommon::kLeftToRight)
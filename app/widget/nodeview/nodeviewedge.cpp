@@ -187,7 +187,7 @@ void NodeViewEdge::SetCurved(bool e)
 {
   curved_ = e;
 
-  update();
+  Adjust();
 }
 
 void NodeViewEdge::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *)
@@ -210,6 +210,16 @@ void NodeViewEdge::paint(QPainter *painter, const QStyleOptionGraphicsItem *opti
   // Draw main path
   QColor edge_color = qApp->palette().color(group, role);
 
+  if (option->levelOfDetailFromTransform(painter->worldTransform()) < NodeViewCommon::SimplifiedLevelOfDetail()) {
+    // Zoomed too far out for curves or arrows to be visible, a hairline between the ends will do
+    if (!path().isEmpty()) {
+      painter->setRenderHint(QPainter::Antialiasing, false);
+      painter->setPen(QPen(edge_color, 0));
+      painter->drawLine(path().elementAt(0), path().currentPosition());
+    }
+    return;
+  }
+
   painter->setPen(QPen(edge_color, edge_width_));
   painter->setBrush(Qt::NoBrush);
   painter->drawPath(path());
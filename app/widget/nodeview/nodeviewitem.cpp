@@ -219,6 +219,11 @@ void NodeViewItem::SetExpanded(bool e, bool hide_titlebar)
     setRect(title_bar_rect_);
   }
 
+  // Input points have moved
+  if (scene()) {
+    static_cast<NodeViewScene*>(scene())->QueueEdgeUpdate(node_);
+  }
+
   update();
 }
 
@@ -233,6 +238,21 @@ void NodeViewItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *opti
   // don't want here)
   QPalette app_pal = Core::instance()->main_window()->palette();
 
+  // When zoomed far out, nothing but the shape and color is legible so skip everything else
+  if (option->levelOfDetailFromTransform(painter->worldTransform()) < NodeViewCommon::SimplifiedLevelOfDetail()) {
+    QColor fill = app_pal.color(QPalette::Window);
+
+    if (node_ && !hide_titlebar_) {
+      fill = Config::Current()[QStringLiteral("NodeCatColor%1")
+          .arg(node_->Category().first())].value<Color>().toQColor();
+    }
+
+    painter->setPen(Qt::NoPen);
+    painter->setBrush((option->state & QStyle::State_Selected) ? app_pal.color(QPalette::Highlight) : fill);
+    painter->drawRect(rect());
+    return;
+  }
+
   // Draw background rect if expanded
   if (IsExpanded()) {
     painter->setPen(Qt::NoPen);
@@ -613,6 +633,10 @@ QVariant NodeViewItem::itemChange(QGraphicsItem::GraphicsItemChange change, cons
     node_->blockSignals(true);
     node_->SetPosition(GetNodePosition());
     node_->blockSignals(false);
+
+    if (scene()) {
+      static_cast<NodeViewScene*>(scene())->QueueEdgeUpdate(node_);
+    }
   }
 
   return QGraphicsItem::itemChange(change, value);
@@ -85,6 +85,9 @@ void NodeViewScene::clear()
     }
     edge_map_.clear();
   }
+
+  node_edges_.clear();
+  queued_edges_.clear();
 }
 
 void NodeViewScene::SelectAll()
@@ -183,6 +186,9 @@ void NodeViewScene::AddNode(Node* node)
   addItem(item);
   item_map_.insert(node, item);
 
+  // Edges from nodes added before this one couldn't be positioned until now
+  QueueEdgeUpdate(node);
+
   // Add a NodeViewEdge for each connection
   foreach (NodeParam* param, node->parameters()) {
 
@@ -219,11 +225,65 @@ void NodeViewScene::AddEdge(NodeEdgePtr edge)
 
   addItem(edge_ui);
   edge_map_.insert(edge.get(), edge_ui);
+
+  node_edges_[edge->output()->parentNode()].append(edge_ui);
+  node_edges_[edge->input()->parentNode()].append(edge_ui);
+
+  // Position now that it's in the scene
+  edge_ui->Adjust();
 }
 
 void NodeViewScene::RemoveEdge(NodeEdgePtr edge)
 {
-  delete edge_map_.take(edge.get());
+  NodeViewEdge* edge_ui = edge_map_.take(edge.get());
+
+  if (!edge_ui) {
+    return;
+  }
+
+  Node* ends[] = {edge->output()->parentNode(), edge->input()->parentNode()};
+
+  for (Node* n : ends) {
+    QHash<Node*, QVector<NodeViewEdge*> >::iterator it = node_edges_.find(n);
+
+    if (it != node_edges_.end()) {
+      it->removeOne(edge_ui);
+
+      if (it->isEmpty()) {
+        node_edges_.erase(it);
+      }
+    }
+  }
+
+  queued_edges_.remove(edge_ui);
+
+  delete edge_ui;
+}
+
+void NodeViewScene::QueueEdgeUpdate(Node *n)
+{
+  const QVector<NodeViewEdge*> edges = node_edges_.value(n);
+
+  if (edges.isEmpty()) {
+    return;
+  }
+
+  if (queued_edges_.isEmpty()) {
+    QMetaObject::invokeMethod(this, "UpdateQueuedEdges", Qt::QueuedConnection);
+  }
+
+  foreach (NodeViewEdge* e, edges) {
+    queued_edges_.insert(e);
+  }
+}
+
+void NodeViewScene::UpdateQueuedEdges()
+{
+  foreach (NodeViewEdge* e, queued_edges_) {
+    e->Adjust();
+  }
+
+  queued_edges_.clear();
 }
 
 int NodeViewScene::DetermineWeight(Node *n)
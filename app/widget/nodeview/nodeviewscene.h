@@ -22,6 +22,7 @@
 #define NODEVIEWSCENE_H
 
 #include <QGraphicsScene>
+#include <QSet>
 #include <QTimer>
 
 #include "node/graph.h"
@@ -82,6 +83,15 @@ public:
 
   bool GetEdgesAreCurved() const;
 
+  /**
+   * @brief Queue every edge connected to this node to have its path recalculated
+   *
+   * Called whenever a node item moves or changes shape. Paths are recalculated once per event loop
+   * iteration however many times this is called, so dragging many nodes doesn't recalculate the
+   * same edges over and over.
+   */
+  void QueueEdgeUpdate(Node* n);
+
 public slots:
   /**
    * @brief Slot when a Node is added to a graph (SetGraph() connects this)
@@ -127,6 +137,16 @@ private:
 
   QHash<NodeEdge*, NodeViewEdge*> edge_map_;
 
+  /**
+   * @brief Edge items connected to each node, so moving a node only touches its own edges
+   */
+  QHash<Node*, QVector<NodeViewEdge*> > node_edges_;
+
+  /**
+   * @brief Edges waiting for UpdateQueuedEdges()
+   */
+  QSet<NodeViewEdge*> queued_edges_;
+
   NodeGraph* graph_;
 
   NodeViewCommon::FlowDirection direction_;
@@ -134,6 +154,11 @@ private:
   bool curved_edges_;
 
 private slots:
+  /**
+   * @brief Recalculate the paths of edges queued with QueueEdgeUpdate()
+   */
+  void UpdateQueuedEdges();
+
   /**
    * @brief Receiver for whenever a node position changes
    */
@@ -194,6 +194,14 @@ Project *NodeRemoveCommand::GetRelevantProject() const
   return static_cast<Sequence*>(graph_)->project();
 }
 
+qint64 NodeRemoveCommand::memory_usage() const
+{
+  // Removed nodes are kept alive by this command until it's deleted
+  return kBaseMemoryUsage
+      + nodes_.size() * kHeldNodeMemoryUsage
+      + edges_.size() * static_cast<qint64>(sizeof(NodeEdge));
+}
+
 NodeRemoveWithExclusiveDeps::NodeRemoveWithExclusiveDeps(NodeGraph *graph, Node *node, QUndoCommand *parent) :
   UndoCommand(parent)
 {
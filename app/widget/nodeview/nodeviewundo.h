@@ -103,6 +103,8 @@ public:
 
   virtual Project* GetRelevantProject() const override;
 
+  virtual qint64 memory_usage() const override;
+
 protected:
   virtual void redo_internal() override;
   virtual void undo_internal() override;
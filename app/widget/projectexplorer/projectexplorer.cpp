@@ -34,6 +34,7 @@
 #include "dialog/sequence/sequence.h"
 #include "projectexplorerundo.h"
 #include "task/precache/precachetask.h"
+#include "task/proxy/proxytask.h"
 #include "task/taskmanager.h"
 #include "widget/menu/menu.h"
 #include "widget/menu/menushared.h"
@@ -45,8 +46,11 @@ namespace olive {
 
 ProjectExplorer::ProjectExplorer(QWidget *parent) :
   QWidget(parent),
-  model_(this)
+  model_(this),
+  sort_model_(this)
 {
+  sort_model_.setSourceModel(&model_);
+
   // Create layout
   QVBoxLayout* layout = new QVBoxLayout(this);
   layout->setSpacing(0);
@@ -118,14 +122,19 @@ void ProjectExplorer::set_view_type(ProjectToolbar::ViewType type)
   }
 }
 
+void ProjectExplorer::SetFilterText(const QString &text)
+{
+  sort_model_.SetFilterText(text);
+}
+
 void ProjectExplorer::Edit(Item *item)
 {
-  CurrentView()->edit(model_.CreateIndexFromItem(item));
+  CurrentView()->edit(sort_model_.mapFromSource(model_.CreateIndexFromItem(item)));
 }
 
 void ProjectExplorer::AddView(QAbstractItemView *view)
 {
-  view->setModel(&model_);
+  view->setModel(&sort_model_);
   view->setEditTriggers(QAbstractItemView::NoEditTriggers);
   connect(view, &QAbstractItemView::clicked, this, &ProjectExplorer::ItemClickedSlot);
   connect(view, &QAbstractItemView::doubleClicked, this, &ProjectExplorer::ItemDoubleClickedSlot);
@@ -144,7 +153,7 @@ void ProjectExplorer::BrowseToFolder(const QModelIndex &index)
 
   // Set navbar text to folder's name
   if (index.isValid()) {
-    Folder* f = static_cast<Folder*>(index.internalPointer());
+    Folder* f = static_cast<Folder*>(ProjectViewModel::ItemFromIndex(index));
     nav_bar_->set_text(f->name());
   } else {
     // Or set it to an empty string if the index is valid (which means we're browsing to the root directory)
@@ -195,7 +204,7 @@ void ProjectExplorer::ItemDoubleClickedSlot(const QModelIndex &index)
   rename_timer_.stop();
 
   // Retrieve source item from index
-  Item* i = static_cast<Item*>(index.internalPointer());
+  Item* i = ProjectViewModel::ItemFromIndex(index);
 
   // If the item is a folder, browse to it
   if (i->CanHaveChildren()
@@ -337,6 +346,18 @@ void ProjectExplorer::ShowContextMenu()
 
         connect(proxy_menu, &Menu::triggered, this, &ProjectExplorer::ContextMenuStartProxy);
       }
+
+      Menu* create_proxy_menu = new Menu(tr("Create Proxy"), &menu);
+      menu.addMenu(create_proxy_menu);
+
+      QVector<int> dividers = {2, 4, 8};
+
+      foreach (int d, dividers) {
+        QAction* a = create_proxy_menu->addAction(tr("1/%1 Resolution").arg(d));
+        a->setData(d);
+      }
+
+      connect(create_proxy_menu, &Menu::triggered, this, &ProjectExplorer::ContextMenuCreateProxy);
     }
 
     Q_UNUSED(all_items_are_footage_or_sequence)
@@ -437,6 +458,23 @@ void ProjectExplorer::ContextMenuStartProxy(QAction *a)
   }
 }
 
+void ProjectExplorer::ContextMenuCreateProxy(QAction *a)
+{
+  int divider = a->data().toInt();
+
+  // To get here, the `context_menu_items_` must be all kFootage
+  foreach (Item* i, context_menu_items_) {
+    Footage* f = static_cast<Footage*>(i);
+    VideoStream* s = static_cast<VideoStream*>(f->get_first_enabled_stream_of_type(Stream::kVideo));
+
+    // Still images are cached whole and gain nothing from a proxy
+    if (s && s->video_type() == VideoStream::kVideoTypeVideo) {
+      ProxyTask* proxy_task = new ProxyTask(s, divider);
+      TaskManager::instance()->AddTask(proxy_task);
+    }
+  }
+}
+
 Project *ProjectExplorer::project() const
 {
   return model_.project();
@@ -449,12 +487,12 @@ void ProjectExplorer::set_project(Project *p)
 
 QModelIndex ProjectExplorer::get_root_index() const
 {
-  return tree_view_->rootIndex();
+  return sort_model_.mapToSource(tree_view_->rootIndex());
 }
 
 void ProjectExplorer::set_root(Item *item)
 {
-  QModelIndex index = model_.CreateIndexFromItem(item);
+  QModelIndex index = sort_model_.mapFromSource(model_.CreateIndexFromItem(item));
 
   BrowseToFolder(index);
   tree_view_->setRootIndex(index);
@@ -471,7 +509,7 @@ QList<Item *> ProjectExplorer::SelectedItems() const
   for (int i=0;i<index_list.size();i++) {
     const QModelIndex& index = index_list.at(i);
 
-    Item* item = static_cast<Item*>(index.internalPointer());
+    Item* item = ProjectViewModel::ItemFromIndex(index);
 
     selected_items.append(item);
   }
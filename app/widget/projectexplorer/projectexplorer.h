@@ -27,6 +27,7 @@
 
 #include "node/input/media/media.h"
 #include "project/project.h"
+#include "project/projectsortfiltermodel.h"
 #include "project/projectviewmodel.h"
 #include "widget/projectexplorer/projectexplorericonview.h"
 #include "widget/projectexplorer/projectexplorerlistview.h"
@@ -89,6 +90,11 @@ public:
 public slots:
   void set_view_type(ProjectToolbar::ViewType type);
 
+  /**
+   * @brief Only show items whose names contain `text`
+   */
+  void SetFilterText(const QString& text);
+
   void Edit(Item* item);
 
 signals:
@@ -153,6 +159,8 @@ private:
 
   ProjectViewModel model_;
 
+  ProjectSortFilterModel sort_model_;
+
   QModelIndex clicked_index_;
 
   QTimer rename_timer_;
@@ -184,6 +192,8 @@ private slots:
 
   void ContextMenuStartProxy(QAction* a);
 
+  void ContextMenuCreateProxy(QAction* a);
+
 };
 
 }
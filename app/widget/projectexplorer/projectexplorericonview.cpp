@@ -20,6 +20,10 @@
 
 #include "projectexplorericonview.h"
 
+#include <QMouseEvent>
+
+#include "task/precompute/thumbnailcache.h"
+
 namespace olive {
 
 ProjectExplorerIconView::ProjectExplorerIconView(QWidget *parent) :
@@ -28,6 +32,54 @@ ProjectExplorerIconView::ProjectExplorerIconView(QWidget *parent) :
   setViewMode(QListView::IconMode);
 
   setItemDelegate(&delegate_);
+
+  // For hover scrubbing thumbnails
+  setMouseTracking(true);
+
+  if (ThumbnailCache::instance()) {
+    connect(ThumbnailCache::instance(), &ThumbnailCache::ThumbnailsReady, viewport(), static_cast<void(QWidget::*)()>(&QWidget::update));
+  }
+}
+
+void ProjectExplorerIconView::mouseMoveEvent(QMouseEvent *event)
+{
+  ProjectExplorerListViewBase::mouseMoveEvent(event);
+
+  QModelIndex index;
+  double position = 0;
+
+  if (event->buttons() == Qt::NoButton) {
+    index = indexAt(event->pos());
+
+    if (index.isValid()) {
+      QRect r = visualRect(index);
+      position = static_cast<double>(event->pos().x() - r.left()) / r.width();
+    }
+  }
+
+  SetScrubPosition(index, position);
+}
+
+void ProjectExplorerIconView::leaveEvent(QEvent *event)
+{
+  ProjectExplorerListViewBase::leaveEvent(event);
+
+  SetScrubPosition(QModelIndex(), 0);
+}
+
+void ProjectExplorerIconView::SetScrubPosition(const QModelIndex &index, double position)
+{
+  QModelIndex old_index = delegate_.scrub_index();
+
+  delegate_.SetScrubPosition(index, position);
+
+  if (old_index.isValid() && old_index != index) {
+    update(old_index);
+  }
+
+  if (index.isValid()) {
+    update(index);
+  }
 }
 
 }
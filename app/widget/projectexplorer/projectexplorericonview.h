@@ -35,7 +35,14 @@ class ProjectExplorerIconView : public ProjectExplorerListViewBase
 public:
   ProjectExplorerIconView(QWidget* parent);
 
+protected:
+  virtual void mouseMoveEvent(QMouseEvent* event) override;
+
+  virtual void leaveEvent(QEvent* event) override;
+
 private:
+  void SetScrubPosition(const QModelIndex& index, double position);
+
   ProjectExplorerIconViewItemDelegate delegate_;
 };
 
@@ -23,11 +23,15 @@
 #include <QPainter>
 
 #include "common/qtutils.h"
+#include "project/item/footage/footage.h"
+#include "project/projectviewmodel.h"
+#include "task/precompute/thumbnailcache.h"
 
 namespace olive {
 
 ProjectExplorerIconViewItemDelegate::ProjectExplorerIconViewItemDelegate(QObject *parent) :
-  QStyledItemDelegate (parent)
+  QStyledItemDelegate (parent),
+  scrub_position_(0)
 {
 }
 
@@ -82,13 +86,44 @@ void ProjectExplorerIconViewItemDelegate::paint(QPainter *painter, const QStyleO
   }
 
   // Draw image
-  QIcon ico = index.data(Qt::DecorationRole).value<QIcon>();
-  QSize icon_size = ico.actualSize(img_rect.size());
-  img_rect = QRect(img_rect.x() + (img_rect.width() / 2 - icon_size.width() / 2),
-                   img_rect.y() + (img_rect.height() / 2 - icon_size.height() / 2),
-                   icon_size.width(),
-                   icon_size.height());
-  painter->drawPixmap(img_rect, ico.pixmap(icon_size));
+  const ThumbnailCache::Strip* thumbs = nullptr;
+  Item* item = ProjectViewModel::ItemFromIndex(index);
+
+  if (item->type() == Item::kFootage && ThumbnailCache::instance()) {
+    Stream* s = static_cast<Footage*>(item)->get_first_enabled_stream_of_type(Stream::kVideo);
+
+    if (s) {
+      thumbs = ThumbnailCache::instance()->Get(static_cast<VideoStream*>(s));
+    }
+  }
+
+  if (thumbs) {
+    int thumb_width = thumbs->pixmap.width() / thumbs->count;
+    int thumb_index = 0;
+
+    if (scrub_index_ == index) {
+      thumb_index = qBound(0, static_cast<int>(scrub_position_ * thumbs->count), thumbs->count - 1);
+    }
+
+    QSize thumb_size = QSize(thumb_width, thumbs->pixmap.height()).scaled(img_rect.size(), Qt::KeepAspectRatio);
+    img_rect = QRect(img_rect.x() + (img_rect.width() / 2 - thumb_size.width() / 2),
+                     img_rect.y() + (img_rect.height() / 2 - thumb_size.height() / 2),
+                     thumb_size.width(),
+                     thumb_size.height());
+
+    painter->save();
+    painter->setRenderHint(QPainter::SmoothPixmapTransform);
+    painter->drawPixmap(img_rect, thumbs->pixmap, QRect(thumb_index * thumb_width, 0, thumb_width, thumbs->pixmap.height()));
+    painter->restore();
+  } else {
+    QIcon ico = index.data(Qt::DecorationRole).value<QIcon>();
+    QSize icon_size = ico.actualSize(img_rect.size());
+    img_rect = QRect(img_rect.x() + (img_rect.width() / 2 - icon_size.width() / 2),
+                     img_rect.y() + (img_rect.height() / 2 - icon_size.height() / 2),
+                     icon_size.width(),
+                     icon_size.height());
+    painter->drawPixmap(img_rect, ico.pixmap(icon_size));
+  }
 
   if (option.state & QStyle::State_Selected) {
     QColor highlight_color = option.palette.highlight().color();
@@ -99,4 +134,10 @@ void ProjectExplorerIconViewItemDelegate::paint(QPainter *painter, const QStyleO
   }
 }
 
+void ProjectExplorerIconViewItemDelegate::SetScrubPosition(const QModelIndex &index, double position)
+{
+  scrub_index_ = index;
+  scrub_position_ = position;
+}
+
 }
@@ -21,6 +21,7 @@
 #ifndef PROJECTEXPLORERICONVIEWITEMDELEGATE_H
 #define PROJECTEXPLORERICONVIEWITEMDELEGATE_H
 
+#include <QPersistentModelIndex>
 #include <QStyledItemDelegate>
 
 #include "common/define.h"
@@ -29,6 +30,9 @@ namespace olive {
 
 /**
  * @brief The delegate that's used to draw items when ProjectExplorer is in Icon view
+ *
+ * Video footage is drawn with its thumbnail from ThumbnailCache instead of its icon once one is
+ * available. The item set with SetScrubPosition() shows the thumbnail under the cursor instead.
  */
 class ProjectExplorerIconViewItemDelegate : public QStyledItemDelegate {
 public:
@@ -36,6 +40,23 @@ public:
 
   virtual QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
   virtual void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+  /**
+   * @brief Set which item is being hover scrubbed and how far across it (0.0 to 1.0) the cursor is
+   *
+   * Pass an invalid index to stop scrubbing.
+   */
+  void SetScrubPosition(const QModelIndex& index, double position);
+
+  const QPersistentModelIndex& scrub_index() const
+  {
+    return scrub_index_;
+  }
+
+private:
+  QPersistentModelIndex scrub_index_;
+
+  double scrub_position_;
 };
 
 }
@@ -20,6 +20,7 @@
 
 #include "projectexplorertreeview.h"
 
+#include <QHeaderView>
 #include <QMouseEvent>
 
 namespace olive {
@@ -41,6 +42,10 @@ ProjectExplorerTreeView::ProjectExplorerTreeView(QWidget *parent) :
 
   // Set context menu to emit a signal
   setContextMenuPolicy(Qt::CustomContextMenu);
+
+  // Allow sorting by clicking a column header, but keep the project's own order until then
+  header()->setSortIndicator(-1, Qt::AscendingOrder);
+  setSortingEnabled(true);
 }
 
 void ProjectExplorerTreeView::mouseDoubleClickEvent(QMouseEvent *event)
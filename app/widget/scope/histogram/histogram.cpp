@@ -62,7 +62,7 @@ ShaderCode HistogramScope::GenerateShaderCode()
                     FileFunctions::ReadFileAsString(":/shaders/default.vert"));
 }
 
-void HistogramScope::DrawScope(TexturePtr managed_tex, QVariant pipeline)
+void HistogramScope::DrawScope(TexturePtr managed_tex, QVariant pipeline, Texture *destination)
 {
   float histogram_scale = 0.80f;
   // This value is eyeballed for usefulness. Until we have a geometry
@@ -91,7 +91,13 @@ void HistogramScope::DrawScope(TexturePtr managed_tex, QVariant pipeline)
 
   // Draw sums into a histogram
   shader_job.InsertValue(QStringLiteral("ove_maintex"), ShaderValue(QVariant::fromValue(texture_row_sums_), NodeParam::kTexture));
-  renderer()->Blit(pipeline_secondary_, shader_job, texture_row_sums_->params());
+  renderer()->BlitToTexture(pipeline_secondary_, shader_job, destination);
+}
+
+void HistogramScope::DrawOverlay()
+{
+  float histogram_scale = 0.80f;
+  float histogram_base = 2.5f;
 
   // Draw line overlays
   QPainter p(inner_widget());
@@ -42,7 +42,9 @@ protected:
   virtual ShaderCode GenerateShaderCode() override;
   QVariant CreateSecondaryShader();
 
-  virtual void DrawScope(TexturePtr managed_tex, QVariant pipeline) override;
+  virtual void DrawScope(TexturePtr managed_tex, QVariant pipeline, Texture* destination) override;
+
+  virtual void DrawOverlay() override;
 
 private:
   QVariant pipeline_secondary_;
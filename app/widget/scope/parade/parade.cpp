@@ -0,0 +1,71 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "parade.h"
+
+#include <QPainter>
+#include <QtMath>
+
+namespace olive {
+
+ParadeScope::ParadeScope(QWidget* parent) :
+  WaveformScope(parent)
+{
+}
+
+ParadeScope::~ParadeScope()
+{
+  OnDestroy();
+}
+
+ShaderCode ParadeScope::GenerateShaderCode()
+{
+  return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/rgbparade.frag"),
+                    FileFunctions::ReadFileAsString(":/shaders/rgbwaveform.vert"));
+}
+
+void ParadeScope::DrawOverlay()
+{
+  // Draw IRE lines
+  WaveformScope::DrawOverlay();
+
+  float waveform_scale = 0.80f;
+
+  float waveform_dim_x = ceil((width() - 1.0) * waveform_scale);
+  float waveform_dim_y = ceil((height() - 1.0) * waveform_scale);
+  float waveform_start_dim_x =
+      ((width() - 1.0) - waveform_dim_x) / 2.0f;
+  float waveform_start_dim_y =
+      ((height() - 1.0) - waveform_dim_y) / 2.0f;
+
+  // Draw dividers between channels
+  QPainter p(inner_widget());
+
+  p.setCompositionMode(QPainter::CompositionMode_Plus);
+  p.setPen(QColor(0.0, 0.6 * 255.0, 0.0));
+
+  for (int i=1; i<3; i++) {
+    float divider_x = waveform_start_dim_x + waveform_dim_x * i / 3.0f;
+
+    p.drawLine(QLineF(divider_x, waveform_start_dim_y, divider_x, waveform_start_dim_y + waveform_dim_y));
+  }
+}
+
+}
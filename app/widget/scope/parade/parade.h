@@ -0,0 +1,48 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PARADESCOPE_H
+#define PARADESCOPE_H
+
+#include "widget/scope/waveform/waveform.h"
+
+namespace olive {
+
+/**
+ * @brief A waveform scope showing red, green, and blue side by side
+ */
+class ParadeScope : public WaveformScope
+{
+  Q_OBJECT
+public:
+  ParadeScope(QWidget* parent = nullptr);
+
+  virtual ~ParadeScope() override;
+
+protected:
+  virtual ShaderCode GenerateShaderCode() override;
+
+  virtual void DrawOverlay() override;
+
+};
+
+}
+
+#endif // PARADESCOPE_H
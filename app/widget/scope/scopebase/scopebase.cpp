@@ -20,15 +20,24 @@
 
 #include "scopebase.h"
 
+#include "common/filefunctions.h"
 #include "config/config.h"
 
 namespace olive {
 
 ScopeBase::ScopeBase(QWidget* parent) :
   ManagedDisplayWidget(parent),
-  buffer_(nullptr)
+  buffer_(nullptr),
+  scope_dirty_(true)
 {
   EnableDefaultContextMenu();
+
+  if (renderer()) {
+    renderer()->SetTextureOrigin(MemoryAccounting::kTextureScope);
+  }
+
+  upload_timer_.setSingleShot(true);
+  connect(&upload_timer_, &QTimer::timeout, this, &ScopeBase::UploadTextureFromBuffer);
 }
 
 ScopeBase::~ScopeBase()
@@ -38,9 +47,15 @@ ScopeBase::~ScopeBase()
 
 void ScopeBase::SetBuffer(Frame *frame)
 {
+  // The viewer holds onto the frame it last emitted until it emits a new one, so a new frame can
+  // never share the last one's address and the same pointer means the same image
+  if (frame == buffer_) {
+    return;
+  }
+
   buffer_ = frame;
 
-  UploadTextureFromBuffer();
+  ScheduleUpload();
 }
 
 void ScopeBase::showEvent(QShowEvent* e)
@@ -50,15 +65,36 @@ void ScopeBase::showEvent(QShowEvent* e)
   UploadTextureFromBuffer();
 }
 
-void ScopeBase::DrawScope(TexturePtr managed_tex, QVariant pipeline)
+void ScopeBase::DrawScope(TexturePtr managed_tex, QVariant pipeline, Texture *destination)
 {
   ShaderJob job;
 
   job.InsertValue(QStringLiteral("ove_maintex"), ShaderValue(QVariant::fromValue(managed_tex), NodeParam::kTexture));
 
-  renderer()->Blit(pipeline, job, VideoParams(width(), height(),
-                                              static_cast<VideoParams::Format>(Config::Current()["OfflinePixelFormat"].toInt()),
-                                              VideoParams::kInternalChannelCount));
+  renderer()->BlitToTexture(pipeline, job, destination);
+}
+
+void ScopeBase::DrawOverlay()
+{
+}
+
+void ScopeBase::ColorProcessorChangedEvent()
+{
+  scope_dirty_ = true;
+
+  ManagedDisplayWidget::ColorProcessorChangedEvent();
+}
+
+void ScopeBase::ScheduleUpload()
+{
+  int interval = 1000 / qMax(1, Config::Current()["ScopeRefreshRate"].toInt());
+
+  if (!last_upload_.isValid() || last_upload_.elapsed() >= interval) {
+    upload_timer_.stop();
+    UploadTextureFromBuffer();
+  } else if (!upload_timer_.isActive()) {
+    upload_timer_.start(interval - last_upload_.elapsed());
+  }
 }
 
 void ScopeBase::UploadTextureFromBuffer()
@@ -67,6 +103,8 @@ void ScopeBase::UploadTextureFromBuffer()
     return;
   }
 
+  last_upload_.start();
+
   if (buffer_) {
     makeCurrent();
 
@@ -75,11 +113,9 @@ void ScopeBase::UploadTextureFromBuffer()
         || texture_->height() != buffer_->height()
         || texture_->format() != buffer_->format()) {
       texture_ = nullptr;
-      managed_tex_ = nullptr;
 
       texture_ = renderer()->CreateTexture(buffer_->video_params(),
                                            buffer_->data(), buffer_->linesize_pixels());
-      managed_tex_ = renderer()->CreateTexture(buffer_->video_params());
     } else {
       texture_->Upload(buffer_->data(), buffer_->linesize_pixels());
     }
@@ -87,6 +123,8 @@ void ScopeBase::UploadTextureFromBuffer()
     doneCurrent();
   }
 
+  scope_dirty_ = true;
+
   update();
 }
 
@@ -97,6 +135,11 @@ void ScopeBase::OnInit()
   UploadTextureFromBuffer();
 
   pipeline_ = renderer()->CreateNativeShader(GenerateShaderCode());
+
+  pipeline_copy_ = renderer()->CreateNativeShader(ShaderCode(FileFunctions::ReadFileAsString(":/shaders/default.frag"),
+                                                             FileFunctions::ReadFileAsString(":/shaders/default.vert")));
+
+  scope_dirty_ = true;
 }
 
 void ScopeBase::OnPaint()
@@ -104,11 +147,47 @@ void ScopeBase::OnPaint()
   // Clear display surface
   renderer()->ClearDestination();
 
-  if (buffer_) {
-    // Convert reference frame to display space
-    renderer()->BlitColorManaged(color_service(), texture_, true, managed_tex_.get());
+  if (buffer_ && texture_) {
+    VideoParams scope_params(width(), height(),
+                             static_cast<VideoParams::Format>(Config::Current()["OfflinePixelFormat"].toInt()),
+                             VideoParams::kInternalChannelCount);
+
+    if (!scope_tex_
+        || scope_tex_->width() != scope_params.width()
+        || scope_tex_->height() != scope_params.height()
+        || scope_tex_->format() != scope_params.format()) {
+      scope_tex_ = renderer()->CreateTexture(scope_params);
+      scope_dirty_ = true;
+    }
+
+    if (scope_dirty_) {
+      // Scopes sample at most once per output pixel so there's no point color managing the
+      // reference frame at a higher resolution than the scope itself
+      int managed_width = qMin(texture_->width(), width());
+      int managed_height = qMin(texture_->height(), height());
+
+      if (!managed_tex_
+          || managed_tex_->width() != managed_width
+          || managed_tex_->height() != managed_height
+          || managed_tex_->format() != texture_->format()) {
+        managed_tex_ = renderer()->CreateTexture(VideoParams(managed_width, managed_height,
+                                                             texture_->format(),
+                                                             texture_->channel_count()));
+      }
+
+      // Convert reference frame to display space
+      renderer()->BlitColorManaged(color_service(), texture_, true, managed_tex_.get());
+
+      DrawScope(managed_tex_, pipeline_, scope_tex_.get());
+
+      scope_dirty_ = false;
+    }
+
+    ShaderJob job;
+    job.InsertValue(QStringLiteral("ove_maintex"), ShaderValue(QVariant::fromValue(scope_tex_), NodeParam::kTexture));
+    renderer()->Blit(pipeline_copy_, job, scope_params);
 
-    DrawScope(managed_tex_, pipeline_);
+    DrawOverlay();
   }
 }
 
@@ -118,7 +197,9 @@ void ScopeBase::OnDestroy()
 
   managed_tex_ = nullptr;
   texture_ = nullptr;
+  scope_tex_ = nullptr;
   pipeline_.clear();
+  pipeline_copy_.clear();
 }
 
 }
@@ -21,12 +21,24 @@
 #ifndef SCOPEBASE_H
 #define SCOPEBASE_H
 
+#include <QElapsedTimer>
+#include <QTimer>
+
 #include "codec/frame.h"
 #include "render/colorprocessor.h"
 #include "widget/manageddisplay/manageddisplay.h"
 
 namespace olive {
 
+/**
+ * @brief Base class for widgets that analyze the viewer's current frame
+ *
+ * Scope shaders sample the whole frame for every output pixel, so the result is rendered into a
+ * texture and only redrawn when the frame, the widget's size, or the color transform changes.
+ * Repaints in between (e.g. from overlapping windows) just draw the cached texture. New frames are
+ * also throttled to the "ScopeRefreshRate" config value so scopes don't try to update at the full
+ * playback rate.
+ */
 class ScopeBase : public ManagedDisplayWidget
 {
 public:
@@ -52,21 +64,45 @@ protected:
   /**
    * @brief Draw function
    *
-   * Override this if your sub-class scope needs extra drawing.
+   * Renders the scope from `managed_tex` into `destination`. The result is cached, so this is only
+   * called when the scope needs to change. Override this if your sub-class scope needs extra
+   * passes.
+   */
+  virtual void DrawScope(TexturePtr managed_tex, QVariant pipeline, Texture* destination);
+
+  /**
+   * @brief Draw anything on top of the cached scope, called on every paint
    */
-  virtual void DrawScope(TexturePtr managed_tex, QVariant pipeline);
+  virtual void DrawOverlay();
+
+  virtual void ColorProcessorChangedEvent() override;
 
 private:
+  /**
+   * @brief Upload the buffer now if the refresh rate allows it, otherwise once it does
+   */
+  void ScheduleUpload();
+
   void UploadTextureFromBuffer();
 
   QVariant pipeline_;
 
+  QVariant pipeline_copy_;
+
   TexturePtr texture_;
 
   TexturePtr managed_tex_;
 
+  TexturePtr scope_tex_;
+
   Frame* buffer_;
 
+  bool scope_dirty_;
+
+  QTimer upload_timer_;
+
+  QElapsedTimer last_upload_;
+
 };
 
 }
@@ -0,0 +1,137 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "vectorscope.h"
+
+#include <QPainter>
+#include <QtMath>
+#include <QVector2D>
+#include <QVector3D>
+
+#include "node/node.h"
+
+namespace olive {
+
+const float VectorscopeScope::kScale = 0.80f;
+const int VectorscopeScope::kSampleCount = 96;
+
+VectorscopeScope::VectorscopeScope(QWidget* parent) :
+  ScopeBase(parent)
+{
+}
+
+VectorscopeScope::~VectorscopeScope()
+{
+  OnDestroy();
+}
+
+ShaderCode VectorscopeScope::GenerateShaderCode()
+{
+  return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/vectorscope.frag"),
+                    FileFunctions::ReadFileAsString(":/shaders/default.vert"));
+}
+
+void VectorscopeScope::DrawScope(TexturePtr managed_tex, QVariant pipeline, Texture *destination)
+{
+  ShaderJob job;
+
+  job.InsertValue(QStringLiteral("viewport"),
+                  ShaderValue(QVector2D(width(), height()), NodeParam::kVec2));
+
+  double luma_coeffs[3] = {0.0f, 0.0f, 0.0f};
+  color_manager()->GetDefaultLumaCoefs(luma_coeffs);
+  job.InsertValue(QStringLiteral("luma_coeffs"),
+                  ShaderValue(QVector3D(luma_coeffs[0], luma_coeffs[1], luma_coeffs[2]), NodeParam::kVec3));
+
+  job.InsertValue(QStringLiteral("vectorscope_scale"),
+                  ShaderValue(kScale, NodeParam::kFloat));
+
+  // Sample evenly across the frame keeping its aspect ratio
+  QVector2D sample_count;
+  if (managed_tex->width() >= managed_tex->height()) {
+    sample_count.setX(qMin(kSampleCount, managed_tex->width()));
+    sample_count.setY(qMax(1, qRound(sample_count.x() * managed_tex->height() / managed_tex->width())));
+  } else {
+    sample_count.setY(qMin(kSampleCount, managed_tex->height()));
+    sample_count.setX(qMax(1, qRound(sample_count.y() * managed_tex->width() / managed_tex->height())));
+  }
+  job.InsertValue(QStringLiteral("sample_count"),
+                  ShaderValue(sample_count, NodeParam::kVec2));
+
+  job.InsertValue(QStringLiteral("ove_maintex"),
+                  ShaderValue(QVariant::fromValue(managed_tex), NodeParam::kTexture));
+
+  renderer()->BlitToTexture(pipeline, job, destination);
+}
+
+void VectorscopeScope::DrawOverlay()
+{
+  float diameter = qCeil(kScale * qMin(width(), height()));
+  QPointF center(width() * 0.5, height() * 0.5);
+
+  QPainter p(inner_widget());
+  QFont font;
+  font.setPixelSize(10);
+  p.setFont(font);
+
+  p.setCompositionMode(QPainter::CompositionMode_Plus);
+  p.setPen(QColor(0.0, 0.6 * 255.0, 0.0));
+
+  // Draw outline and axes
+  p.drawEllipse(center, diameter * 0.5, diameter * 0.5);
+  p.drawLine(QLineF(center.x() - diameter * 0.5, center.y(), center.x() + diameter * 0.5, center.y()));
+  p.drawLine(QLineF(center.x(), center.y() - diameter * 0.5, center.x(), center.y() + diameter * 0.5));
+
+  // Draw targets for 75% primaries and secondaries
+  double luma_coeffs[3] = {0.0f, 0.0f, 0.0f};
+  color_manager()->GetDefaultLumaCoefs(luma_coeffs);
+
+  struct Target {
+    QString label;
+    double r;
+    double g;
+    double b;
+  };
+
+  const Target targets[] = {
+    {QStringLiteral("R"), 0.75, 0.0, 0.0},
+    {QStringLiteral("Yl"), 0.75, 0.75, 0.0},
+    {QStringLiteral("G"), 0.0, 0.75, 0.0},
+    {QStringLiteral("Cy"), 0.0, 0.75, 0.75},
+    {QStringLiteral("B"), 0.0, 0.0, 0.75},
+    {QStringLiteral("Mg"), 0.75, 0.0, 0.75}
+  };
+
+  const float target_size = 8.0f;
+
+  for (const Target& t : targets) {
+    double luma = t.r * luma_coeffs[0] + t.g * luma_coeffs[1] + t.b * luma_coeffs[2];
+    double cb = (t.b - luma) / (2.0 * (1.0 - luma_coeffs[2]));
+    double cr = (t.r - luma) / (2.0 * (1.0 - luma_coeffs[0]));
+
+    QPointF target_pos(center.x() + cb * diameter, center.y() - cr * diameter);
+
+    p.drawRect(QRectF(target_pos.x() - target_size * 0.5, target_pos.y() - target_size * 0.5,
+                      target_size, target_size));
+    p.drawText(target_pos + QPointF(target_size, -target_size), t.label);
+  }
+}
+
+}
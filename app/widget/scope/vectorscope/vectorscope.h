@@ -0,0 +1,67 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef VECTORSCOPE_H
+#define VECTORSCOPE_H
+
+#include "widget/scope/scopebase/scopebase.h"
+
+namespace olive {
+
+/**
+ * @brief A scope plotting every sampled pixel by its chroma
+ *
+ * Blue-difference is plotted horizontally and red-difference vertically using the color
+ * manager's luma coefficients, with targets for 75% primaries and secondaries.
+ */
+class VectorscopeScope : public ScopeBase
+{
+  Q_OBJECT
+public:
+  VectorscopeScope(QWidget* parent = nullptr);
+
+  virtual ~VectorscopeScope() override;
+
+protected:
+  virtual ShaderCode GenerateShaderCode() override;
+
+  virtual void DrawScope(TexturePtr managed_tex, QVariant pipeline, Texture* destination) override;
+
+  virtual void DrawOverlay() override;
+
+private:
+  /**
+   * @brief Diameter of the scope relative to the shortest side of the widget
+   */
+  static const float kScale;
+
+  /**
+   * @brief Number of samples taken along the longest side of the frame
+   *
+   * Every sample is tested by every output pixel, so this is kept well below the frame's actual
+   * resolution.
+   */
+  static const int kSampleCount;
+
+};
+
+}
+
+#endif // VECTORSCOPE_H
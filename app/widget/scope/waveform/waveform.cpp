@@ -49,7 +49,7 @@ ShaderCode WaveformScope::GenerateShaderCode()
                     FileFunctions::ReadFileAsString(":/shaders/rgbwaveform.vert"));
 }
 
-void WaveformScope::DrawScope(TexturePtr managed_tex, QVariant pipeline)
+void WaveformScope::DrawScope(TexturePtr managed_tex, QVariant pipeline, Texture *destination)
 {
   float waveform_scale = 0.80f;
 
@@ -75,9 +75,12 @@ void WaveformScope::DrawScope(TexturePtr managed_tex, QVariant pipeline)
   job.InsertValue(QStringLiteral("ove_maintex"),
                   ShaderValue(QVariant::fromValue(managed_tex), NodeParam::kTexture));
 
-  renderer()->Blit(pipeline, job, VideoParams(width(), height(),
-                                              static_cast<VideoParams::Format>(Config::Current()["OfflinePixelFormat"].toInt()),
-                                              VideoParams::kInternalChannelCount));
+  renderer()->BlitToTexture(pipeline, job, destination);
+}
+
+void WaveformScope::DrawOverlay()
+{
+  float waveform_scale = 0.80f;
 
   float waveform_dim_x = ceil((width() - 1.0) * waveform_scale);
   float waveform_dim_y = ceil((height() - 1.0) * waveform_scale);
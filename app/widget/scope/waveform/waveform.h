@@ -36,7 +36,9 @@ public:
 protected:
   virtual ShaderCode GenerateShaderCode() override;
 
-  virtual void DrawScope(TexturePtr managed_tex, QVariant pipeline) override;
+  virtual void DrawScope(TexturePtr managed_tex, QVariant pipeline, Texture* destination) override;
+
+  virtual void DrawOverlay() override;
 
 };
 
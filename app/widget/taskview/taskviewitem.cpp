@@ -43,6 +43,11 @@ TaskViewItem::TaskViewItem(Task* task, QWidget *parent) :
   task_name_lbl_->setText(task_->GetTitle());
   layout->addWidget(task_name_lbl_);
 
+  // Create status label, only shown if the task reports a status
+  task_status_lbl_ = new QLabel(this);
+  task_status_lbl_->setVisible(false);
+  layout->addWidget(task_status_lbl_);
+
   // Create center layout (combines progress bar and a cancel button)
   QHBoxLayout* middle_layout = new QHBoxLayout();
   layout->addLayout(middle_layout);
@@ -76,6 +81,7 @@ TaskViewItem::TaskViewItem(Task* task, QWidget *parent) :
 
   // Connect to the task
   connect(task_, &Task::ProgressChanged, this, &TaskViewItem::UpdateProgress);
+  connect(task_, &Task::StatusChanged, this, &TaskViewItem::UpdateStatus);
   connect(cancel_btn_, &QPushButton::clicked, this, [this] { emit TaskCancelled(task_); });
 }
 
@@ -92,4 +98,10 @@ void TaskViewItem::UpdateProgress(double d)
   elapsed_timer_lbl_->SetProgress(d);
 }
 
+void TaskViewItem::UpdateStatus(const QString &s)
+{
+  task_status_lbl_->setText(s);
+  task_status_lbl_->setVisible(!s.isEmpty());
+}
+
 }
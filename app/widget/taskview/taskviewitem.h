@@ -54,6 +54,7 @@ signals:
 
 private:
   QLabel* task_name_lbl_;
+  QLabel* task_status_lbl_;
   QProgressBar* progress_bar_;
   QPushButton* cancel_btn_;
 
@@ -66,6 +67,8 @@ private:
 private slots:
   void UpdateProgress(double d);
 
+  void UpdateStatus(const QString& s);
+
 };
 
 }
@@ -20,6 +20,7 @@
 
 #include "timelinewidget.h"
 
+#include <algorithm>
 #include <cfloat>
 #include <QSplitter>
 #include <QVBoxLayout>
@@ -29,7 +30,9 @@
 #include "common/range.h"
 #include "common/timecodefunctions.h"
 #include "dialog/sequence/sequence.h"
+#include "node/block/clip/clip.h"
 #include "node/block/transition/transition.h"
+#include "node/input/nested/nestedsequence.h"
 #include "tool/add.h"
 #include "tool/beam.h"
 #include "tool/edit.h"
@@ -181,6 +184,8 @@ void TimelineWidget::Clear()
     delete iterator.value();
   }
   block_items_.clear();
+  block_edges_.clear();
+  indexed_block_edges_.clear();
 
   // Emit that we've deselected any selected blocks
   SignalDeselectedAllBlocks();
@@ -313,7 +318,7 @@ void TimelineWidget::CopyNodesToClipboardInternal(QXmlStreamWriter *writer, void
 
     writer->writeStartElement(QStringLiteral("block"));
 
-    writer->writeAttribute(QStringLiteral("ptr"), QString::number(reinterpret_cast<quintptr>(block)));
+    writer->writeAttribute(QStringLiteral("ptr"), QString::number(GetClipboardPtr(block)));
     writer->writeAttribute(QStringLiteral("in"), (block->in() - earliest_in).toString());
 
     TrackOutput* track = TrackOutput::TrackFromBlock(block);
@@ -742,6 +747,113 @@ void TimelineWidget::ToggleSelectedEnabled()
   Core::instance()->undo_stack()->pushIfHasChildren(command);
 }
 
+void TimelineWidget::NestSelected()
+{
+  if (!GetConnectedNode()) {
+    return;
+  }
+
+  // Audio would need its own path through the nested sequence's audio cache, so only video is
+  // nested and audio clips stay where they are
+  QVector<Block*> clips;
+  TimeRange range;
+  int lowest_track = -1;
+
+  foreach (TimelineViewBlockItem* item, GetSelectedBlocks()) {
+    Block* b = item->block();
+    TrackOutput* track = TrackOutput::TrackFromBlock(b);
+
+    if (b->type() != Block::kClip || track->track_type() != Timeline::kTrackTypeVideo) {
+      continue;
+    }
+
+    if (clips.isEmpty()) {
+      range = TimeRange(b->in(), b->out());
+      lowest_track = track->Index();
+    } else {
+      range = TimeRange(qMin(range.in(), b->in()), qMax(range.out(), b->out()));
+      lowest_track = qMin(lowest_track, track->Index());
+    }
+
+    clips.append(b);
+  }
+
+  if (clips.isEmpty()) {
+    return;
+  }
+
+  Sequence* outer = static_cast<Sequence*>(GetConnectedNode()->parent());
+  QUndoCommand* command = new QUndoCommand();
+
+  Sequence* nested = Core::instance()->CreateNewSequenceForProject(outer->project());
+  nested->set_video_params(outer->video_params());
+  nested->set_audio_params(outer->audio_params());
+  nested->add_default_nodes();
+
+  new ProjectViewModel::AddItemCommand(Core::instance()->GetActiveProjectModel(),
+                                       Core::instance()->GetSelectedFolderInActiveProject(),
+                                       nested,
+                                       command);
+
+  // Copy the clips and everything they depend on into the new sequence
+  QVector<Node*> src;
+
+  foreach (Block* b, clips) {
+    if (!src.contains(b)) {
+      src.append(b);
+    }
+
+    foreach (Node* dep, b->GetDependencies()) {
+      if (!src.contains(dep)) {
+        src.append(dep);
+      }
+    }
+  }
+
+  QVector<Node*> dst(src.size());
+
+  for (int i=0; i<src.size(); i++) {
+    Node* c = src.at(i)->copy();
+    Node::CopyInputs(src.at(i), c, false);
+    new NodeAddCommand(nested, c, command);
+    dst[i] = c;
+  }
+
+  Node::CopyDependencyGraph(src, dst, command);
+
+  foreach (Block* b, clips) {
+    new TrackPlaceBlockCommand(nested->viewer_output()->track_list(Timeline::kTrackTypeVideo),
+                               TrackOutput::TrackFromBlock(b)->Index() - lowest_track,
+                               static_cast<Block*>(dst.at(src.indexOf(b))),
+                               b->in() - range.in(),
+                               command);
+  }
+
+  ReplaceBlocksWithGaps(clips, true, command);
+
+  // Put the new sequence where the clips were
+  ClipBlock* clip = new ClipBlock();
+  clip->set_length_and_media_out(range.length());
+  clip->SetLabel(nested->name());
+  new NodeAddCommand(outer, clip, command);
+
+  NestedSequence* nest = new NestedSequence();
+  nest->SetSequence(nested);
+  new NodeAddCommand(outer, nest, command);
+
+  new NodeEdgeAddCommand(nest->output(), clip->texture_input(), command);
+
+  new TrackPlaceBlockCommand(GetConnectedNode()->track_list(Timeline::kTrackTypeVideo),
+                             lowest_track,
+                             clip,
+                             range.in(),
+                             command);
+
+  new TimelineSetSelectionsCommand(this, TimelineWidgetSelections(), GetSelections(), command);
+
+  Core::instance()->undo_stack()->pushIfHasChildren(command);
+}
+
 QVector<TimelineViewBlockItem *> TimelineWidget::GetSelectedBlocks()
 {
   QVector<TimelineViewBlockItem *> list(selected_blocks_.size());
@@ -887,6 +999,7 @@ void TimelineWidget::AddBlock(Block *block, TrackReference track)
     // Add to list of clip items that can be iterated through
     item = new TimelineViewBlockItem(block);
     block_items_.insert(block, item);
+    AddBlockEdges(block);
 
     // Set scale parameters
     item->SetScale(GetScale());
@@ -923,6 +1036,7 @@ void TimelineWidget::RemoveBlock(const QList<Block *> &blocks)
 
     // Take item from map
     TimelineViewBlockItem* item = block_items_.take(b);
+    RemoveBlockEdges(b);
 
     // If selected, deselect it
     int select_index = selected_blocks_.indexOf(b);
@@ -976,13 +1090,50 @@ void TimelineWidget::TrackIndexChanged()
 
 void TimelineWidget::BlockRefreshed()
 {
-  TimelineViewRect* rect = block_items_.value(static_cast<Block*>(sender()));
+  Block* b = static_cast<Block*>(sender());
+  TimelineViewRect* rect = block_items_.value(b);
 
   if (rect) {
     rect->UpdateRect();
+
+    // In/out may have moved
+    RemoveBlockEdges(b);
+    AddBlockEdges(b);
   }
 }
 
+void TimelineWidget::AddBlockEdges(Block *b)
+{
+  TimeRange edges(b->in(), b->out());
+
+  block_edges_.insert(std::upper_bound(block_edges_.begin(), block_edges_.end(), edges.in()), edges.in());
+  block_edges_.insert(std::upper_bound(block_edges_.begin(), block_edges_.end(), edges.out()), edges.out());
+
+  indexed_block_edges_.insert(b, edges);
+}
+
+void TimelineWidget::RemoveBlockEdges(Block *b)
+{
+  QHash<Block*, TimeRange>::iterator it = indexed_block_edges_.find(b);
+
+  if (it == indexed_block_edges_.end()) {
+    return;
+  }
+
+  // Any one copy of a repeated value is as good as another
+  QVector<rational>::iterator in_it = std::lower_bound(block_edges_.begin(), block_edges_.end(), it->in());
+  if (in_it != block_edges_.end() && *in_it == it->in()) {
+    block_edges_.erase(in_it);
+  }
+
+  QVector<rational>::iterator out_it = std::lower_bound(block_edges_.begin(), block_edges_.end(), it->out());
+  if (out_it != block_edges_.end() && *out_it == it->out()) {
+    block_edges_.erase(out_it);
+  }
+
+  indexed_block_edges_.erase(it);
+}
+
 void TimelineWidget::BlockUpdated()
 {
   TimelineViewRect* rect = block_items_.value(static_cast<Block*>(sender()));
@@ -994,14 +1145,13 @@ void TimelineWidget::BlockUpdated()
 
 void TimelineWidget::TrackPreviewUpdated()
 {
-  QMap<Block*, TimelineViewBlockItem*>::const_iterator i;
-
   TrackOutput* track = static_cast<TrackOutput*>(sender());
-  TrackReference track_ref(track->track_type(), track->Index());
 
-  for (i=block_items_.constBegin(); i!=block_items_.constEnd(); i++) {
-    if (i.value()->Track() == track_ref) {
-      i.value()->update();
+  foreach (Block* b, track->Blocks()) {
+    TimelineViewBlockItem* item = block_items_.value(b);
+
+    if (item) {
+      item->update();
     }
   }
 }
@@ -1550,15 +1700,22 @@ void TimelineWidget::SetSelections(const TimelineWidgetSelections &s)
 
 TimelineViewBlockItem *TimelineWidget::GetItemAtScenePos(const TimelineCoordinate& coord)
 {
-  for (auto it=block_items_.cbegin(); it!=block_items_.cend(); it++) {
-    Block* b = it.key();
-    TimelineViewBlockItem* item = it.value();
+  if (!GetConnectedNode() || coord.GetTrack().index() < 0) {
+    return nullptr;
+  }
 
-    if (b->in() <= coord.GetFrame()
-        && b->out() > coord.GetFrame()
-        && item->Track() == coord.GetTrack()) {
-      return item;
-    }
+  // Look the block up through its track rather than testing every item, this is called on every
+  // mouse move
+  TrackOutput* track = GetTrackFromReference(coord.GetTrack());
+
+  if (!track) {
+    return nullptr;
+  }
+
+  Block* b = track->NearestBlockBeforeOrAt(coord.GetFrame());
+
+  if (b && b->in() <= coord.GetFrame()) {
+    return block_items_.value(b);
   }
 
   return nullptr;
@@ -1569,12 +1726,12 @@ struct SnapData {
   rational movement;
 };
 
+const qreal kSnapRange = 10; // FIXME: Hardcoded number
+
 QList<SnapData> AttemptSnap(const QList<double>& screen_pt,
                             double compare_pt,
                             const QList<rational>& start_times,
                             const rational& compare_time) {
-  const qreal kSnapRange = 10; // FIXME: Hardcoded number
-
   QList<SnapData> snap_data;
 
   for (int i=0;i<screen_pt.size();i++) {
@@ -1604,20 +1761,29 @@ bool TimelineWidget::SnapPoint(QList<rational> start_times, rational* movement,
   }
 
   if (snap_points & kSnapToClips) {
-    QMap<Block*, TimelineViewBlockItem*>::const_iterator i;
+    for (int i=0; i<screen_pt.size(); i++) {
+      // Only look at the edges around this point rather than every block. The search starts a
+      // pixel early so rounding in SceneToTime() can't skip an edge InRange() would accept.
+      double pt = screen_pt.at(i);
+      rational search_start = SceneToTime(pt - kSnapRange - 1);
 
-    for (i=block_items_.constBegin(); i!=block_items_.constEnd(); i++) {
-      TimelineViewBlockItem* item = i.value();
+      QVector<rational>::const_iterator it = std::lower_bound(block_edges_.constBegin(), block_edges_.constEnd(), search_start);
 
-      if (item) {
-        qreal rect_left = item->x();
-        qreal rect_right = rect_left + item->rect().width();
+      for (; it!=block_edges_.constEnd(); it++) {
+        qreal edge_pos = TimeToScene(*it);
 
-        // Attempt snapping to clip in point
-        potential_snaps.append(AttemptSnap(screen_pt, rect_left, start_times, item->block()->in()));
+        if (edge_pos > pt + kSnapRange) {
+          break;
+        }
 
-        // Attempt snapping to clip out point
-        potential_snaps.append(AttemptSnap(screen_pt, rect_right, start_times, item->block()->out()));
+        // Repeated values would only produce identical snaps
+        if (it != block_edges_.constBegin() && *(it - 1) == *it) {
+          continue;
+        }
+
+        if (InRange(pt, edge_pos, kSnapRange)) {
+          potential_snaps.append({*it, *it - start_times.at(i)});
+        }
       }
     }
   }
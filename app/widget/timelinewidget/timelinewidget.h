@@ -89,6 +89,14 @@ public:
 
   void ToggleSelectedEnabled();
 
+  /**
+   * @brief Move the selected video clips into a new sequence and replace them with a clip of it
+   *
+   * The new sequence starts at the earliest selected clip and keeps the clips' relative positions
+   * and tracks. It's placed on the lowest selected track, overwriting anything else in its range.
+   */
+  void NestSelected();
+
   QVector<TimelineViewBlockItem*> GetSelectedBlocks();
 
   virtual bool SnapPoint(QList<rational> start_times, rational *movement, int snap_points = kSnapAll) override;
@@ -253,6 +261,22 @@ private:
 
   QMap<Block*, TimelineViewBlockItem*> block_items_;
 
+  /**
+   * @brief Sorted in and out points of every block in `block_items_` for SnapPoint()
+   *
+   * Adjacent blocks share points so values may repeat, each block adds exactly one in and one out.
+   */
+  QVector<rational> block_edges_;
+
+  /**
+   * @brief The in/out each block was last added to `block_edges_` with, so it can be taken out again
+   */
+  QHash<Block*, TimeRange> indexed_block_edges_;
+
+  void AddBlockEdges(Block* b);
+
+  void RemoveBlockEdges(Block* b);
+
   QList<TimelineAndTrackView*> views_;
 
   TimeSlider* timecode_label_;
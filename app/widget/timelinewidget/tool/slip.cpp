@@ -68,16 +68,19 @@ void SlipTool::FinishDrag(TimelineViewMouseEvent *event)
 {
   Q_UNUSED(event)
 
-  QUndoCommand* command = new QUndoCommand();
+  BlockSetMediaInManyCommand* command = new BlockSetMediaInManyCommand();
 
-  // Find earliest point to ripple around
   foreach (TimelineViewGhostItem* ghost, parent()->GetGhostItems()) {
     Block* b = Node::ValueToPtr<Block>(ghost->GetData(TimelineViewGhostItem::kAttachedBlock));
 
-    new BlockSetMediaInCommand(b, ghost->GetAdjustedMediaIn(), command);
+    command->AddBlock(b, ghost->GetAdjustedMediaIn());
   }
 
-  Core::instance()->undo_stack()->pushIfHasChildren(command);
+  if (command->isEmpty()) {
+    delete command;
+  } else {
+    Core::instance()->undo_stack()->push(command);
+  }
 }
 
 }
@@ -106,6 +106,40 @@ void BlockSetMediaInCommand::undo_internal()
   block_->set_media_in(old_media_in_);
 }
 
+BlockSetMediaInManyCommand::BlockSetMediaInManyCommand(QUndoCommand *parent) :
+  UndoCommand(parent)
+{
+}
+
+void BlockSetMediaInManyCommand::AddBlock(Block *block, const rational &new_media_in)
+{
+  changes_.append({block, block->media_in(), new_media_in});
+}
+
+Project *BlockSetMediaInManyCommand::GetRelevantProject() const
+{
+  return static_cast<Sequence*>(changes_.first().block->parent())->project();
+}
+
+qint64 BlockSetMediaInManyCommand::memory_usage() const
+{
+  return kBaseMemoryUsage + changes_.size() * static_cast<qint64>(sizeof(Change));
+}
+
+void BlockSetMediaInManyCommand::redo_internal()
+{
+  foreach (const Change& c, changes_) {
+    c.block->set_media_in(c.new_media_in);
+  }
+}
+
+void BlockSetMediaInManyCommand::undo_internal()
+{
+  for (int i=changes_.size()-1; i>=0; i--) {
+    changes_.at(i).block->set_media_in(changes_.at(i).old_media_in);
+  }
+}
+
 TrackRippleRemoveBlockCommand::TrackRippleRemoveBlockCommand(TrackOutput *track, Block *block, QUndoCommand *parent) :
   UndoCommand(parent),
   track_(track),
@@ -177,6 +211,18 @@ Project *TrackRippleRemoveAreaCommand::GetRelevantProject() const
   return static_cast<Sequence*>(track_->parent())->project();
 }
 
+qint64 TrackRippleRemoveAreaCommand::memory_usage() const
+{
+  // Removed blocks are kept alive by this command until it's deleted
+  qint64 usage = kBaseMemoryUsage + removed_blocks_.size() * kHeldNodeMemoryUsage;
+
+  foreach (UndoCommand* c, remove_block_commands_) {
+    usage += UndoStack::EstimateMemoryUsage(c);
+  }
+
+  return usage;
+}
+
 void TrackRippleRemoveAreaCommand::SetInsert(Block *insert)
 {
   insert_ = insert;
@@ -831,20 +877,51 @@ void BlockUnlinkAllCommand::undo_internal()
 
 BlockLinkManyCommand::BlockLinkManyCommand(const QVector<Block *> blocks, bool link, QUndoCommand *parent) :
   UndoCommand(parent),
-  blocks_(blocks)
+  blocks_(blocks),
+  link_(link)
+{
+}
+
+Project *BlockLinkManyCommand::GetRelevantProject() const
+{
+  return static_cast<Sequence*>(blocks_.first()->parent())->project();
+}
+
+qint64 BlockLinkManyCommand::memory_usage() const
+{
+  return kBaseMemoryUsage
+      + blocks_.size() * static_cast<qint64>(sizeof(Block*))
+      + changed_.size() * static_cast<qint64>(sizeof(QPair<Block*, Block*>));
+}
+
+void BlockLinkManyCommand::redo_internal()
 {
+  changed_.clear();
+
   foreach (Block* a, blocks_) {
     foreach (Block* b, blocks_) {
       if (a != b) {
-        new BlockLinkCommand(a, b, link, this);
+        bool done = link_ ? Block::Link(a, b) : Block::Unlink(a, b);
+
+        if (done) {
+          changed_.append({a, b});
+        }
       }
     }
   }
 }
 
-Project *BlockLinkManyCommand::GetRelevantProject() const
+void BlockLinkManyCommand::undo_internal()
 {
-  return static_cast<Sequence*>(blocks_.first()->parent())->project();
+  for (int i=changed_.size()-1; i>=0; i--) {
+    const QPair<Block*, Block*>& pair = changed_.at(i);
+
+    if (link_) {
+      Block::Unlink(pair.first, pair.second);
+    } else {
+      Block::Link(pair.first, pair.second);
+    }
+  }
 }
 
 BlockEnableDisableCommand::BlockEnableDisableCommand(Block *block, bool enabled, QUndoCommand *parent) :
@@ -114,6 +114,39 @@ private:
   rational new_media_in_;
 };
 
+/**
+ * @brief Sets the media in of several blocks as one command
+ */
+class BlockSetMediaInManyCommand : public UndoCommand {
+public:
+  BlockSetMediaInManyCommand(QUndoCommand* parent = nullptr);
+
+  void AddBlock(Block* block, const rational& new_media_in);
+
+  bool isEmpty() const
+  {
+    return changes_.isEmpty();
+  }
+
+  virtual Project* GetRelevantProject() const override;
+
+  virtual qint64 memory_usage() const override;
+
+protected:
+  virtual void redo_internal() override;
+  virtual void undo_internal() override;
+
+private:
+  struct Change {
+    Block* block;
+    rational old_media_in;
+    rational new_media_in;
+  };
+
+  QVector<Change> changes_;
+
+};
+
 class TrackRippleRemoveBlockCommand : public UndoCommand {
 public:
   TrackRippleRemoveBlockCommand(TrackOutput* track, Block* block, QUndoCommand* parent = nullptr);
@@ -178,6 +211,8 @@ public:
 
   virtual Project* GetRelevantProject() const override;
 
+  virtual qint64 memory_usage() const override;
+
   void SetInsert(Block* insert);
 
 protected:
@@ -471,15 +506,31 @@ private:
 
 };
 
+/**
+ * @brief Links or unlinks every pair of blocks in a set
+ *
+ * Done as one command recording only the pairs that actually changed, rather than a child
+ * BlockLinkCommand for each of the N*(N-1) pairs.
+ */
 class BlockLinkManyCommand : public UndoCommand {
 public:
   BlockLinkManyCommand(const QVector<Block*> blocks, bool link, QUndoCommand* parent = nullptr);
 
   virtual Project* GetRelevantProject() const override;
 
+  virtual qint64 memory_usage() const override;
+
+protected:
+  virtual void redo_internal() override;
+  virtual void undo_internal() override;
+
 private:
   QVector<Block*> blocks_;
 
+  bool link_;
+
+  QVector< QPair<Block*, Block*> > changed_;
+
 };
 
 class BlockLinkCommand : public UndoCommand {
@@ -60,6 +60,22 @@ void TimelineViewBlockItem::UpdateRect()
   setRect(0, y_, item_width - 1, height_);
   setPos(item_left, 0.0);
 
+  UpdateToolTip();
+}
+
+void TimelineViewBlockItem::UpdateToolTip()
+{
+  if (!toolTip().isEmpty()
+      && tooltip_in_ == block_->in()
+      && tooltip_out_ == block_->out()
+      && tooltip_timebase_ == timebase()) {
+    return;
+  }
+
+  tooltip_in_ = block_->in();
+  tooltip_out_ = block_->out();
+  tooltip_timebase_ = timebase();
+
   setToolTip(QCoreApplication::translate("TimelineViewBlockItem",
                                          "%1\n\nIn: %2\nOut: %3\nLength: %4").arg(block_->Name(),
                                                                                   Timecode::time_to_timecode(block_->in(), timebase(), Core::instance()->GetTimecodeDisplay()),
@@ -94,7 +110,7 @@ void TimelineViewBlockItem::paint(QPainter *painter, const QStyleOptionGraphicsI
     painter->setPen(QColor(64, 64, 64));
     TrackOutput* track = TrackOutput::TrackFromBlock(block_);
     if (track) {
-      AudioVisualWaveform::DrawWaveform(painter,
+      AudioVisualWaveform::DrawWaveformCached(painter,
                                         rect().toRect(),
                                         this->GetScale(),
                                         track->waveform(),
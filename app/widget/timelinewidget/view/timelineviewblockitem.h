@@ -42,8 +42,20 @@ protected:
   virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
 
 private:
+  void UpdateToolTip();
+
   Block* block_;
 
+  /**
+   * @brief Block times and timebase the current tooltip was generated for
+   *
+   * Formatting timecodes is slow enough to matter when every block's rect is updated on zoom, so
+   * the tooltip is only regenerated when it would actually change.
+   */
+  rational tooltip_in_;
+  rational tooltip_out_;
+  rational tooltip_timebase_;
+
 };
 
 }
@@ -97,7 +97,7 @@ void TimeRuler::paintEvent(QPaintEvent *)
     int marker_bottom = height() - text_height();
 
     if (show_cache_status_) {
-      marker_bottom -= cache_status_height_;
+      marker_bottom -= CacheStatusAreaHeight();
     }
 
     if (text_visible_) {
@@ -181,7 +181,7 @@ void TimeRuler::paintEvent(QPaintEvent *)
   int line_bottom = height();
 
   if (show_cache_status_) {
-    line_bottom -= cache_status_height_;
+    line_bottom -= CacheStatusAreaHeight();
   }
 
   int long_height = fm.height();
@@ -281,6 +281,12 @@ void TimeRuler::paintEvent(QPaintEvent *)
                    Qt::red);
       }
     }
+
+    FrameHashCache* frame_cache = qobject_cast<FrameHashCache*>(playback_cache_);
+
+    if (frame_cache) {
+      DrawRenderCosts(&p, frame_cache, height() - CacheStatusAreaHeight());
+    }
   }
 
   // Draw the playhead if it's on screen at the moment
@@ -297,6 +303,35 @@ void TimeRuler::TimebaseChangedEvent(const rational &tb)
   update();
 }
 
+void TimeRuler::DrawRenderCosts(QPainter *p, FrameHashCache *cache, int y)
+{
+  TimeRange visible(rational(ScreenToUnit(0)) * timebase(), rational(ScreenToUnit(width()) + 1) * timebase());
+
+  // A frame that takes as long to render as it does to play is halfway between green and red
+  double realtime_ns = timebase().toDouble() * 1000000000.0;
+
+  typedef QPair<TimeRange, FrameHashCache::RenderCost> CostRange;
+  foreach (const CostRange& c, cache->GetRenderCosts(visible)) {
+    int left = qMax(0, TimeToScreen(c.first.in()));
+    int right = qMin(width(), TimeToScreen(c.first.out()));
+
+    if (right <= left) {
+      continue;
+    }
+
+    // GPU work may still be running after the CPU considers the frame done
+    double ratio = qBound(0.0, qMax(c.second.total, c.second.gpu()) / realtime_ns * 0.5, 1.0);
+
+    p->fillRect(left, y, right - left, cache_status_height_, QColor::fromHsvF((1.0 - ratio) / 3.0, 1.0, 1.0));
+  }
+}
+
+int TimeRuler::CacheStatusAreaHeight() const
+{
+  // The cache status bar and the render cost heatmap above it
+  return cache_status_height_ * 2;
+}
+
 int TimeRuler::CacheStatusHeight() const
 {
   return fontMetrics().height() / 4;
@@ -323,7 +358,7 @@ void TimeRuler::UpdateHeight()
 
   // Add cache status height
   if (show_cache_status_) {
-    height += cache_status_height_;
+    height += CacheStatusAreaHeight();
   }
 
   // Add marker height
@@ -26,6 +26,7 @@
 
 #include "common/timerange.h"
 #include "seekablewidget.h"
+#include "render/framehashcache.h"
 #include "render/playbackcache.h"
 
 namespace olive {
@@ -50,6 +51,18 @@ private:
 
   int CacheStatusHeight() const;
 
+  /**
+   * @brief Height of everything drawn under the ruler's lines when cache status is visible
+   */
+  int CacheStatusAreaHeight() const;
+
+  /**
+   * @brief Draw a heatmap of how long each rendered frame took to render
+   *
+   * Green frames rendered well within their duration, red ones took twice as long or longer.
+   */
+  void DrawRenderCosts(QPainter* p, FrameHashCache* cache, int y);
+
   int cache_status_height_;
 
   int minimum_gap_between_lines_;
@@ -38,6 +38,9 @@ FootageViewerWidget::FootageViewerWidget(QWidget *parent) :
   audio_node_ = new MediaInput();
   sequence_.AddNode(audio_node_);
 
+  // Footage is shown as decoded, there's no graph worth hashing or caching
+  SetDirectPreview(true);
+
   connect(display_widget(), &ViewerDisplayWidget::DragStarted, this, &FootageViewerWidget::StartFootageDrag);
 
   controls_->SetAudioVideoDragButtonsVisible(true);
@@ -31,12 +31,17 @@
 #include <QVBoxLayout>
 
 #include "audio/audiomanager.h"
+#include "common/bufferpool.h"
+#include "common/memoryaccounting.h"
+#include "common/memorygovernor.h"
 #include "common/power.h"
 #include "common/ratiodialog.h"
 #include "common/timecodefunctions.h"
 #include "config/config.h"
+#include "node/factory.h"
 #include "project/item/sequence/sequence.h"
 #include "project/project.h"
+#include "render/framememorycache.h"
 #include "render/rendermanager.h"
 #include "task/taskmanager.h"
 #include "widget/menu/menu.h"
@@ -47,6 +52,13 @@ namespace olive {
 QVector<ViewerWidget*> ViewerWidget::instances_;
 
 const int kMaxPreQueueSize = 16;
+const int kPlaybackLeadIncrement = 4;
+const int kMaxPlaybackLead = 256;
+const int kPerformanceOverlayInterval = 500;
+const int kScrubSettleInterval = 150;
+const int kAdaptiveDividerSamples = 8;
+const double kAdaptiveDividerRaiseLoad = 0.9;
+const double kAdaptiveDividerLowerLoad = 0.6;
 
 ViewerWidget::ViewerWidget(QWidget *parent) :
   TimeBasedWidget(false, true, parent),
@@ -56,8 +68,23 @@ ViewerWidget::ViewerWidget(QWidget *parent) :
   override_color_manager_(nullptr),
   time_changed_from_timer_(false),
   pause_autocache_during_playback_(false),
-  prequeuing_(false)
-{
+  prequeuing_(false),
+  playback_lead_(kMaxPreQueueSize),
+  dropped_frames_(0),
+  show_performance_overlay_(false),
+  delivered_frames_(0),
+  cache_hits_(0),
+  cache_misses_(0),
+  cache_decode_time_(0),
+  adaptive_divider_(0),
+  adaptive_render_time_(0),
+  adaptive_samples_(0),
+  auto_cacher_(nullptr),
+  autocache_paused_(false),
+  direct_preview_(false)
+{
+  cache_decode_pool_.setMaxThreadCount(QThread::idealThreadCount());
+
   // Set up main layout
   QVBoxLayout* layout = new QVBoxLayout(this);
   layout->setMargin(0);
@@ -75,9 +102,18 @@ ViewerWidget::ViewerWidget(QWidget *parent) :
   connect(display_widget_, &ViewerDisplayWidget::CursorColor, this, &ViewerWidget::CursorColor);
   connect(display_widget_, &ViewerDisplayWidget::ColorProcessorChanged, this, &ViewerWidget::ColorProcessorChanged);
   connect(display_widget_, &ViewerDisplayWidget::ColorManagerChanged, this, &ViewerWidget::ColorManagerChanged);
+  connect(display_widget_, &ViewerDisplayWidget::VisibleRegionNotRendered, this, [this]{
+    // Panned or zoomed out past what the last partial render covered
+    if (!IsPlaying() && GetConnectedNode() && !display_widget_->IsPreviewingGizmo()) {
+      UpdateTextureFromNode(GetTime());
+    }
+  });
   connect(sizer_, &ViewerSizer::RequestScale, display_widget_, &ViewerDisplayWidget::SetMatrixZoom);
   connect(sizer_, &ViewerSizer::RequestTranslate, display_widget_, &ViewerDisplayWidget::SetMatrixTranslate);
   connect(display_widget_, &ViewerDisplayWidget::HandDragMoved, sizer_, &ViewerSizer::HandDragMove);
+  connect(display_widget_, &ViewerDisplayWidget::GizmoDragStarted, this, &ViewerWidget::GizmoDragStarted);
+  connect(display_widget_, &ViewerDisplayWidget::GizmoDragMoved, this, &ViewerWidget::GizmoDragMoved);
+  connect(display_widget_, &ViewerDisplayWidget::GizmoDragEnded, this, &ViewerWidget::RenderGizmoPreview);
   sizer_->SetWidget(display_widget_);
 
   // Create waveform view when audio is connected and video isn't
@@ -113,7 +149,19 @@ ViewerWidget::ViewerWidget(QWidget *parent) :
   connect(waveform_view_, &AudioWaveformView::TimeChanged, this, &ViewerWidget::TimeChangedFromWaveform);
   connect(waveform_view_, &AudioWaveformView::customContextMenuRequested, this, &ViewerWidget::ShowContextMenu);
 
-  connect(&playback_backup_timer_, &QTimer::timeout, this, &ViewerWidget::PlaybackTimerUpdate);
+  playback_backup_timer_.setTimerType(Qt::PreciseTimer);
+  connect(&playback_backup_timer_, &QTimer::timeout, this, &ViewerWidget::BackupTimerTick);
+
+  performance_overlay_timer_.setInterval(kPerformanceOverlayInterval);
+  connect(&performance_overlay_timer_, &QTimer::timeout, this, &ViewerWidget::UpdatePerformanceOverlay);
+
+  scrub_settle_timer_.setInterval(kScrubSettleInterval);
+  scrub_settle_timer_.setSingleShot(true);
+  connect(&scrub_settle_timer_, &QTimer::timeout, this, &ViewerWidget::ScrubSettled);
+
+  gizmo_preview_timer_.setInterval(kScrubSettleInterval);
+  gizmo_preview_timer_.setSingleShot(true);
+  connect(&gizmo_preview_timer_, &QTimer::timeout, this, &ViewerWidget::RenderGizmoPreview);
 
   SetAutoMaxScrollBar(true);
 
@@ -127,6 +175,19 @@ ViewerWidget::~ViewerWidget()
   foreach (ViewerWindow* window, windows) {
     delete window;
   }
+
+  if (show_performance_overlay_ && RenderManager::instance()) {
+    RenderManager::instance()->SetFrameProfilingEnabled(false);
+  }
+
+  if (IsPlaying() && TaskManager::instance()) {
+    TaskManager::instance()->SetPlaybackActive(false);
+  }
+
+  if (auto_cacher_) {
+    PreviewAutoCacher::Release(auto_cacher_, this);
+    auto_cacher_ = nullptr;
+  }
 }
 
 void ViewerWidget::TimeChangedEvent(const int64_t &i)
@@ -159,7 +220,7 @@ void ViewerWidget::TimeChangedEvent(const int64_t &i)
     }
 
     if (!pause_autocache_during_playback_ || !IsPlaying()) {
-      auto_cacher_.SetPlayhead(time_set);
+      auto_cacher_->SetPlayhead(this, time_set);
     }
 
     display_widget_->SetTime(time_set);
@@ -199,7 +260,9 @@ void ViewerWidget::ConnectNodeInternal(ViewerOutput *n)
     using_manager = nullptr;
   }
 
-  auto_cacher_.SetColorManager(using_manager);
+  if (auto_cacher_) {
+    auto_cacher_->SetColorManager(this, using_manager);
+  }
 
   display_widget_->ConnectColorManager(using_manager);
   foreach (ViewerWindow* window, windows_) {
@@ -243,7 +306,9 @@ void ViewerWidget::DisconnectNodeInternal(ViewerOutput *n)
   foreach (ViewerWindow* window, windows_) {
     window->display_widget()->DisconnectColorManager();
   }
-  auto_cacher_.SetColorManager(nullptr);
+  if (auto_cacher_) {
+    auto_cacher_->SetColorManager(this, nullptr);
+  }
 
   waveform_view_->SetViewer(nullptr);
   waveform_view_->ConnectTimelinePoints(nullptr);
@@ -254,7 +319,26 @@ void ViewerWidget::DisconnectNodeInternal(ViewerOutput *n)
 
 void ViewerWidget::ConnectedNodeChanged(ViewerOutput *n)
 {
-  auto_cacher_.SetViewerNode(n);
+  if (auto_cacher_) {
+    PreviewAutoCacher::Release(auto_cacher_, this);
+    auto_cacher_ = nullptr;
+  }
+
+  if (n) {
+    auto_cacher_ = PreviewAutoCacher::Acquire(n, this);
+    auto_cacher_->SetDirectPreview(direct_preview_);
+    auto_cacher_->SetPaused(this, autocache_paused_);
+    auto_cacher_->SetPlayhead(this, GetTime());
+  }
+}
+
+void ViewerWidget::SetDirectPreview(bool e)
+{
+  direct_preview_ = e;
+
+  if (auto_cacher_) {
+    auto_cacher_->SetDirectPreview(direct_preview_);
+  }
 }
 
 void ViewerWidget::ScaleChangedEvent(const double &s)
@@ -348,18 +432,22 @@ void ViewerWidget::ForceUpdate()
 
 void ViewerWidget::SetAutoCacheEnabled(bool e)
 {
-  auto_cacher_.SetPaused(!e);
+  autocache_paused_ = !e;
+
+  if (auto_cacher_) {
+    auto_cacher_->SetPaused(this, autocache_paused_);
+  }
 }
 
 void ViewerWidget::CacheEntireSequence()
 {
-  auto_cacher_.ForceCacheRange(TimeRange(rational(), GetConnectedNode()->video_frame_cache()->GetLength()));
+  auto_cacher_->ForceCacheRange(TimeRange(rational(), GetConnectedNode()->video_frame_cache()->GetLength()));
 }
 
 void ViewerWidget::CacheSequenceInOut()
 {
   if (GetConnectedTimelinePoints() && GetConnectedTimelinePoints()->workarea()->enabled()) {
-    auto_cacher_.ForceCacheRange(GetConnectedTimelinePoints()->workarea()->range());
+    auto_cacher_->ForceCacheRange(GetConnectedTimelinePoints()->workarea()->range());
   } else {
     QMessageBox::warning(this,
                          tr("Error"),
@@ -374,12 +462,22 @@ void ViewerWidget::SetGizmos(Node *node)
   display_widget_->SetGizmos(node);
 }
 
-FramePtr ViewerWidget::DecodeCachedImage(const QString &fn, const rational& time) const
+FramePtr ViewerWidget::DecodeCachedImage(const QByteArray &hash, const rational& time) const
 {
-  FramePtr frame = GetConnectedNode()->video_frame_cache()->LoadCacheFrame(fn);
+  QElapsedTimer timer;
+  timer.start();
+
+  FramePtr frame = GetConnectedNode()->video_frame_cache()->LoadCacheFrame(hash);
 
   if (frame) {
     frame->set_timestamp(time);
+
+    // Weight recent decodes more heavily so the lead follows changes in the material. This can
+    // race with other decode threads, but losing a sample here and there doesn't matter.
+    int elapsed = static_cast<int>(timer.nsecsElapsed() / 1000);
+    int average = cache_decode_time_.loadAcquire();
+
+    cache_decode_time_.storeRelease(average ? (average * 7 + elapsed) / 8 : elapsed);
   } else {
     qWarning() << "Tried to load cached frame from file but it was null";
   }
@@ -387,10 +485,10 @@ FramePtr ViewerWidget::DecodeCachedImage(const QString &fn, const rational& time
   return frame;
 }
 
-void ViewerWidget::DecodeCachedImage(RenderTicketPtr ticket, const QString &fn, const rational& time) const
+void ViewerWidget::DecodeCachedImage(RenderTicketPtr ticket, const QByteArray &hash, const rational& time) const
 {
   ticket->Start();
-  ticket->Finish(QVariant::fromValue(DecodeCachedImage(fn, time)), false);
+  ticket->Finish(QVariant::fromValue(DecodeCachedImage(hash, time)), false);
 }
 
 bool ViewerWidget::ShouldForceWaveform() const
@@ -410,6 +508,8 @@ void ViewerWidget::UpdateTextureFromNode(const rational& time)
     // We still run the playback queue even when FrameExistsAtTime returns false because we might be
     // playing backwards and about to start showing frames, so the queue should be prepared for
     // that.
+    CancelStalePlaybackQueueRequests(time);
+
     while (!playback_queue_.empty()) {
 
       const ViewerPlaybackFrame& pf = playback_queue_.front();
@@ -428,9 +528,16 @@ void ViewerWidget::UpdateTextureFromNode(const rational& time)
       }
     }
 
-    // Only show warning if frame actually exists
+    // Only count a drop if the frame actually exists
     if (frame_exists_at_time) {
-      qWarning() << "Playback queue failed to keep up";
+      dropped_frames_++;
+
+      // Keep more frames in flight from now on so rendering has a better chance of keeping up
+      int max_lead = GetMaximumPlaybackLead();
+      if (playback_lead_ < max_lead) {
+        playback_lead_ = qMin(playback_lead_ + kPlaybackLeadIncrement, max_lead);
+        TopUpPlaybackQueue();
+      }
     }
 
   }
@@ -443,10 +550,72 @@ void ViewerWidget::UpdateTextureFromNode(const rational& time)
   }
 
   // Frame was not in queue, will require rendering or decoding from cache
+  bool best_effort = false;
+
+  if (!IsPlaying()) {
+    // Requests in quick succession mean the playhead is being dragged. Rather than lag behind
+    // it decoding every exact frame, show the nearest frame that's quick to get and render the
+    // exact one once the playhead settles.
+    best_effort = scrub_clock_.isValid() && scrub_clock_.elapsed() < kScrubSettleInterval;
+    scrub_clock_.start();
+
+    if (best_effort) {
+      scrub_settle_timer_.start();
+    }
+  }
+
   RenderTicketWatcher* watcher = new RenderTicketWatcher();
   connect(watcher, &RenderTicketWatcher::Finished, this, &ViewerWidget::RendererGeneratedFrame);
   nonqueue_watchers_.append(watcher);
-  watcher->SetTicket(GetFrame(time, true));
+  watcher->SetTicket(GetFrame(time, false, best_effort));
+}
+
+void ViewerWidget::ScrubSettled()
+{
+  if (IsPlaying() || !GetConnectedNode()) {
+    return;
+  }
+
+  // Make sure this request is treated as exact rather than as part of the scrub
+  scrub_clock_.invalidate();
+
+  UpdateTextureFromNode(GetTime());
+}
+
+void ViewerWidget::GizmoDragStarted()
+{
+  // Playback keeps rendering anyway, and its frames weren't rendered with the values we'd move
+  // them from
+  if (!IsPlaying()) {
+    display_widget_->StartGizmoPreview();
+  }
+}
+
+void ViewerWidget::GizmoDragMoved()
+{
+  if (display_widget_->IsPreviewingGizmo()) {
+    // Render once the handle stops moving
+    gizmo_preview_timer_.start();
+  }
+}
+
+void ViewerWidget::RenderGizmoPreview()
+{
+  gizmo_preview_timer_.stop();
+
+  if (!display_widget_->IsPreviewingGizmo()) {
+    return;
+  }
+
+  // Anything still rendering was requested with older values, only take the image of these, and
+  // make sure it's exact rather than a scrubbing approximation
+  nonqueue_watchers_.clear();
+  scrub_clock_.invalidate();
+  display_widget_->GizmoPreviewRenderRequested();
+
+  if (GetConnectedNode()) {
+    UpdateTextureFromNode(GetTime());
+  }
 }
 
 void ViewerWidget::PlayInternal(int speed, bool in_to_out_only)
@@ -469,8 +638,8 @@ void ViewerWidget::PlayInternal(int speed, bool in_to_out_only)
       viewer->Pause();
     }
 
-    if (pause_autocache_during_playback_) {
-      viewer->auto_cacher_.ClearVideoQueue();
+    if (pause_autocache_during_playback_ && viewer->auto_cacher_) {
+      viewer->auto_cacher_->ClearVideoQueue();
     }
   }
 
@@ -483,23 +652,38 @@ void ViewerWidget::PlayInternal(int speed, bool in_to_out_only)
     }
   }
 
+  // Anything requested for the previous position (e.g. before looping) is no longer useful
+  CancelPlaybackQueueRequests();
+  playback_queue_.clear();
+
   playback_speed_ = speed;
   play_in_to_out_only_ = in_to_out_only;
 
+  // Background tasks would compete with playback for the renderer and decoders
+  if (TaskManager::instance()) {
+    TaskManager::instance()->SetPlaybackActive(true);
+  }
+
   playback_queue_next_frame_ = ruler()->GetTime();
+  dropped_frames_ = 0;
+
+  // Start each playback at full resolution, the renders will tell us soon enough if it's too much
+  adaptive_divider_ = 0;
+  adaptive_render_time_ = 0;
+  adaptive_samples_ = 0;
 
   controls_->ShowPauseButton();
 
   // Attempt to fill playback queue
   if (stack_->currentWidget() == sizer_) {
-    prequeue_length_ = DeterminePlaybackQueueSize();
+    // Only wait for the first few frames before starting, the rest of the lead keeps rendering
+    // while we play
+    prequeue_length_ = qMin(kMaxPreQueueSize, DeterminePlaybackQueueSize());
 
     if (prequeue_length_ > 0) {
       prequeuing_ = true;
 
-      for (int i=0; i<prequeue_length_; i++) {
-        RequestNextFrameForQueue();
-      }
+      TopUpPlaybackQueue();
     }
   }
 
@@ -515,7 +699,7 @@ void ViewerWidget::PauseInternal()
     playback_speed_ = 0;
     controls_->ShowPlayButton();
 
-    disconnect(display_widget_, &ViewerDisplayWidget::frameSwapped, this, &ViewerWidget::ForceUpdate);
+    disconnect(display_widget_, &ViewerDisplayWidget::frameSwapped, this, &ViewerWidget::VsyncTick);
 
     foreach (ViewerWindow* window, windows_) {
       window->Pause();
@@ -523,9 +707,24 @@ void ViewerWidget::PauseInternal()
 
     playback_queue_.clear();
     playback_backup_timer_.stop();
+
+    if (TaskManager::instance()) {
+      TaskManager::instance()->SetPlaybackActive(false);
+    }
   }
 
+  CancelPlaybackQueueRequests();
+
   prequeuing_ = false;
+
+  if (adaptive_divider_) {
+    // The paused frame is probably at the reduced resolution, replace it with a full one
+    adaptive_divider_ = 0;
+
+    if (GetConnectedNode()) {
+      UpdateTextureFromNode(GetTime());
+    }
+  }
 }
 
 void ViewerWidget::PushScrubbedAudio()
@@ -596,6 +795,10 @@ void ViewerWidget::SetDisplayImage(FramePtr frame, bool main_only)
 {
   display_widget_->SetImage(frame);
 
+  if (show_performance_overlay_ && frame && IsPlaying()) {
+    delivered_frames_++;
+  }
+
   if (!main_only) {
     foreach (ViewerWindow* vw, windows_) {
       vw->display_widget()->SetImage(frame);
@@ -605,36 +808,400 @@ void ViewerWidget::SetDisplayImage(FramePtr frame, bool main_only)
   emit LoadedBuffer(frame.get());
 }
 
-void ViewerWidget::RequestNextFrameForQueue()
+bool ViewerWidget::RequestNextFrameForQueue()
 {
+  if ((playback_queue_next_frame_ - GetTimestamp()) * playback_speed_ < 0) {
+    // Rendering fell behind the playhead, there's no point finishing frames that have already
+    // passed so skip ahead to the next one that will be shown
+    playback_queue_next_frame_ = GetTimestamp() + playback_speed_;
+  }
+
   rational next_time = Timecode::timestamp_to_time(playback_queue_next_frame_,
                                                    timebase());
 
+  if (!FrameExistsAtTime(next_time)) {
+    return false;
+  }
+
   playback_queue_next_frame_ += playback_speed_;
 
   RenderTicketWatcher* watcher = new RenderTicketWatcher();
+  watcher->setProperty("time", QVariant::fromValue(next_time));
   connect(watcher, &RenderTicketWatcher::Finished, this, &ViewerWidget::RendererGeneratedFrameForQueue);
-  watcher->SetTicket(GetFrame(next_time, false));
+  queue_watchers_.append(watcher);
+  watcher->SetTicket(GetFrame(next_time, true));
+
+  return true;
+}
+
+void ViewerWidget::TopUpPlaybackQueue()
+{
+  int target = DeterminePlaybackQueueSize();
+
+  while (int(playback_queue_.size()) + queue_watchers_.size() < target) {
+    if (!RequestNextFrameForQueue()) {
+      break;
+    }
+  }
+}
+
+void ViewerWidget::CancelPlaybackQueueRequests()
+{
+  // Watchers delete themselves once their tickets finish, we just stop listening for them
+  foreach (RenderTicketWatcher* watcher, queue_watchers_) {
+    watcher->Cancel();
+  }
+  queue_watchers_.clear();
+
+  if (auto_cacher_) {
+    auto_cacher_->ClearPlaybackQueue(this);
+  }
+}
+
+void ViewerWidget::CancelStalePlaybackQueueRequests(const rational &time)
+{
+  for (int i=0; i<queue_watchers_.size(); i++) {
+    RenderTicketWatcher* watcher = queue_watchers_.at(i);
+    rational watcher_time = watcher->property("time").value<rational>();
+
+    if ((playback_speed_ > 0 && watcher_time < time)
+        || (playback_speed_ < 0 && watcher_time > time)) {
+      watcher->Cancel();
+      queue_watchers_.removeAt(i);
+      i--;
+    }
+  }
+}
+
+int ViewerWidget::GetDecodeBoundPlaybackLead()
+{
+  int decode_time = cache_decode_time_.loadAcquire();
+  int speed = qAbs(playback_speed_.loadAcquire());
+
+  if (!decode_time || !speed || timebase().isNull()) {
+    return 0;
+  }
+
+  // Frames decode in parallel, so keeping up means having enough in flight that one completes
+  // every frame interval. Double it so the occasional slow frame doesn't cause a drop.
+  double frame_interval = timebase_dbl() * 1000000.0 / speed;
+  int in_flight = qCeil(decode_time / frame_interval);
+
+  return qMin(in_flight * 2 + 1, GetMaximumPlaybackLead());
+}
+
+QRect ViewerWidget::GetRenderRegion()
+{
+  if (!windows_.isEmpty()) {
+    // Other windows show the same frame and may be showing a different part of it
+    return QRect();
+  }
+
+  QRect visible = display_widget_->GetVisibleRegion();
+
+  if (visible.isNull()) {
+    return QRect();
+  }
+
+  // Render some extra around what's visible so small pans don't need another render
+  QRect region = visible.adjusted(-visible.width() / 2, -visible.height() / 2,
+                                  visible.width() / 2, visible.height() / 2);
+
+  const VideoParams& vp = GetConnectedNode()->video_params();
+  region &= QRect(0, 0, vp.width(), vp.height());
+
+  // Only worth it when zoomed in far enough, otherwise we'd just be re-rendering on every pan
+  if (qint64(region.width()) * region.height() * 2 > qint64(vp.width()) * vp.height()) {
+    return QRect();
+  }
+
+  return region;
+}
+
+int ViewerWidget::GetPlaybackDivider()
+{
+  return adaptive_divider_ ? adaptive_divider_ : GetConnectedNode()->video_params().divider();
+}
+
+void ViewerWidget::UpdateAdaptivePlaybackDivider(qint64 render_time, int divider)
+{
+  int speed = qAbs(playback_speed_.loadAcquire());
+
+  if (!Config::Current()[QStringLiteral("AdaptivePlaybackResolution")].toBool()
+      || !speed || timebase().isNull()) {
+    return;
+  }
+
+  int current = GetPlaybackDivider();
+
+  if (divider != current) {
+    // Requested before the last change, says nothing about the current divider
+    return;
+  }
+
+  adaptive_render_time_ = adaptive_samples_ ? (adaptive_render_time_ * 7 + render_time) / 8 : render_time;
+  adaptive_samples_++;
+
+  if (adaptive_samples_ < kAdaptiveDividerSamples) {
+    return;
+  }
+
+  const QVector<int>& dividers = VideoParams::kSupportedDividers;
+  int index = dividers.indexOf(current);
+  int base_index = dividers.indexOf(GetConnectedNode()->video_params().divider());
+
+  if (index == -1 || base_index == -1) {
+    return;
+  }
+
+  // Frames render in parallel, so the time one takes is spread across every render thread
+  double frame_interval = timebase_dbl() * 1000000000.0 / speed;
+  int threads = qMax(1, Config::Current()[QStringLiteral("RenderThreads")].toInt());
+  double load = adaptive_render_time_ / (frame_interval * threads);
+
+  int next = current;
+
+  if (load > kAdaptiveDividerRaiseLoad && index < dividers.size() - 1) {
+    next = dividers.at(index + 1);
+  } else if (index > base_index) {
+    // Assume cost scales with pixel count, only step down if we'd still keep up comfortably
+    int lower = dividers.at(index - 1);
+    double ratio = double(current) / double(lower);
+
+    if (load * ratio * ratio < kAdaptiveDividerLowerLoad) {
+      next = lower;
+    }
+  }
+
+  if (next != current) {
+    adaptive_divider_ = (next == dividers.at(base_index)) ? 0 : next;
+    adaptive_render_time_ = 0;
+    adaptive_samples_ = 0;
+  }
+}
+
+int ViewerWidget::GetMaximumPlaybackLead()
+{
+  const VideoParams& vp = GetConnectedNode()->video_params();
+  VideoParams::Format format = static_cast<VideoParams::Format>(Config::Current()["OfflinePixelFormat"].toInt());
+
+  qint64 frame_size = VideoParams::GetBufferSize(vp.width(), vp.height(), format, VideoParams::kRGBAChannelCount);
+  qint64 budget = Config::Current()[QStringLiteral("PlaybackQueueMemory")].toLongLong() * 1024 * 1024;
+
+  if (frame_size <= 0) {
+    return kMaxPreQueueSize;
+  }
+
+  // Never go below the lead we would have had anyway
+  return qBound(kMaxPreQueueSize, int(qMin(budget / frame_size, qint64(kMaxPlaybackLead))), kMaxPlaybackLead);
+}
+
+void ViewerWidget::SetPerformanceOverlayEnabled(bool e)
+{
+  if (show_performance_overlay_ == e) {
+    return;
+  }
+
+  show_performance_overlay_ = e;
+
+  RenderManager::instance()->SetFrameProfilingEnabled(e);
+
+  if (e) {
+    delivered_frames_ = 0;
+    cache_hits_ = 0;
+    cache_misses_ = 0;
+    performance_overlay_clock_.start();
+    performance_overlay_timer_.start();
+    UpdatePerformanceOverlay();
+  } else {
+    performance_overlay_timer_.stop();
+    display_widget_->ClearPerformanceOverlay();
+  }
+}
+
+void ViewerWidget::UpdatePerformanceOverlay()
+{
+  if (!GetConnectedNode()) {
+    display_widget_->ClearPerformanceOverlay();
+    return;
+  }
+
+  QStringList lines;
+
+  // Frame rate delivered since the last sample against the one playback is aiming for
+  double elapsed = performance_overlay_clock_.restart() * 0.001;
+
+  if (IsPlaying() && elapsed > 0) {
+    double target = GetConnectedNode()->video_params().time_base().flipped().toDouble() * qAbs(playback_speed_.load());
+    lines.append(tr("FPS: %1 / %2").arg(QString::number(delivered_frames_ / elapsed, 'f', 1),
+                                        QString::number(target, 'f', 1)));
+
+    double lead = 0;
+
+    if (!playback_queue_.empty() && playback_speed_ != 0) {
+      lead = (playback_queue_.back().timestamp - GetTime()).toDouble() / playback_speed_;
+    }
+
+    lines.append(tr("Dropped: %1  Lead: %2s").arg(QString::number(dropped_frames_),
+                                                  QString::number(qMax(0.0, lead), 'f', 2)));
+
+    if (frame_pacer_.IsVsyncActive()) {
+      lines.append(tr("Vsync: %1 Hz, %2 clock").arg(QString::number(1000000000.0 / frame_pacer_.GetVsyncInterval(), 'f', 2),
+                                                   playback_timer_.IsSyncedToAudio() ? tr("audio") : tr("system")));
+    } else {
+      lines.append(tr("Vsync: inactive, %1 clock").arg(playback_timer_.IsSyncedToAudio() ? tr("audio") : tr("system")));
+    }
+
+    const ViewerFramePacer::Statistics& pacing = frame_pacer_.GetStatistics();
+    lines.append(tr("Pacing: %1 late, %2 early, %3 repeated, %4 skipped").arg(QString::number(pacing.late),
+                                                                              QString::number(pacing.early),
+                                                                              QString::number(pacing.repeated),
+                                                                              QString::number(pacing.skipped)));
+  } else {
+    lines.append(tr("FPS: -"));
+  }
+
+  RenderManager* rm = RenderManager::instance();
+
+  lines.append(tr("Render Queue: %1 interactive, %2 playback, %3 background").arg(
+                 QString::number(rm->GetQueuedTicketCount(RenderManager::kPriorityInteractive)),
+                 QString::number(rm->GetQueuedTicketCount(RenderManager::kPriorityPlayback)),
+                 QString::number(rm->GetQueuedTicketCount(RenderManager::kPriorityBackground))));
+  lines.append(tr("Cache Writes: %1 pending").arg(QString::number(rm->GetPendingCacheWriteCount())));
+
+  int requests = cache_hits_ + cache_misses_;
+
+  if (requests > 0) {
+    lines.append(tr("Cache Hits: %1% of %2 frames").arg(QString::number(cache_hits_ * 100 / requests),
+                                                        QString::number(requests)));
+  } else {
+    lines.append(tr("Cache Hits: -"));
+  }
+
+  qint64 pool_usage, pool_budget;
+  rm->GetTexturePoolUsage(&pool_usage, &pool_budget);
+  lines.append(tr("Texture Pool: %1 / %2 MB").arg(QString::number(pool_usage / 1048576),
+                                                  QString::number(pool_budget / 1048576)));
+
+  BufferPool::Statistics buffer_stats = BufferPool::GetStatistics();
+  lines.append(tr("Buffer Pool: %1 / %2 MB in %3 sizes").arg(QString::number(buffer_stats.lent_bytes / 1048576),
+                                                             QString::number(buffer_stats.reserved_bytes / 1048576),
+                                                             QString::number(buffer_stats.size_classes)));
+
+  qint64 memory_budget = MemoryGovernor::GetBudget();
+  lines.append(tr("Memory: %1 / %2 MB").arg(QString::number(MemoryGovernor::GetUsage() / 1048576),
+                                            memory_budget > 0 ? QString::number(memory_budget / 1048576) : tr("Unlimited")));
+
+  foreach (const MemoryGovernor::Report& r, MemoryGovernor::GetReport()) {
+    if (r.usage > 0) {
+      lines.append(tr("  %1: %2 MB").arg(r.name, QString::number(r.usage / 1048576)));
+    }
+  }
+
+  // Where memory is going by subsystem, including what's held outside of the governed caches
+  qint64 system_total = 0;
+  qint64 video_total = 0;
+
+  for (int i=0; i<MemoryAccounting::kCategoryCount; i++) {
+    MemoryAccounting::Category c = static_cast<MemoryAccounting::Category>(i);
+
+    if (MemoryAccounting::IsVideoMemory(c)) {
+      video_total += MemoryAccounting::Get(c);
+    } else {
+      system_total += MemoryAccounting::Get(c);
+    }
+  }
+
+  for (int i=0; i<2; i++) {
+    bool video = (i == 1);
+
+    lines.append(video ? tr("Video Memory: %1 MB").arg(QString::number(video_total / 1048576))
+                       : tr("System Memory: %1 MB").arg(QString::number(system_total / 1048576)));
+
+    for (int j=0; j<MemoryAccounting::kCategoryCount; j++) {
+      MemoryAccounting::Category c = static_cast<MemoryAccounting::Category>(j);
+      qint64 usage = MemoryAccounting::Get(c);
+
+      if (MemoryAccounting::IsVideoMemory(c) != video || usage <= 0) {
+        continue;
+      }
+
+      // Below a megabyte is still worth seeing for hashes and undo, so show tenths
+      lines.append(tr("  %1: %2 MB").arg(MemoryAccounting::GetName(c),
+                                         QString::number(static_cast<double>(usage) / 1048576.0, 'f', 1)));
+
+      QMap<QString, qint64> details = MemoryAccounting::GetDetails(c);
+
+      for (auto it=details.cbegin(); it!=details.cend(); it++) {
+        lines.append(tr("    %1: %2 MB").arg(it.key(), QString::number(it.value() / 1048576)));
+      }
+    }
+  }
+
+  RenderManager::FrameProfile profile = rm->GetLastFrameProfile(GetConnectedNode());
+
+  if (!profile.slowest_node.isEmpty()) {
+    lines.append(tr("Slowest Node: %1 (%2 ms)").arg(NodeFactory::GetNameFromID(profile.slowest_node),
+                                                    QString::number(profile.slowest_node_ns * 0.000001, 'f', 2)));
+  }
+
+  RenderManager::GPUPassProfile gpu_pass = rm->GetSlowestGPUPass();
+
+  if (!gpu_pass.node.isEmpty()) {
+    lines.append(tr("Slowest GPU Pass: %1 (%2 ms)").arg(NodeFactory::GetNameFromID(gpu_pass.node),
+                                                        QString::number(gpu_pass.ns * 0.000001, 'f', 2)));
+  }
+
+  delivered_frames_ = 0;
+  cache_hits_ = 0;
+  cache_misses_ = 0;
+
+  display_widget_->SetPerformanceOverlay(lines);
 }
 
-RenderTicketPtr ViewerWidget::GetFrame(const rational &t, bool clear_render_queue)
+RenderTicketPtr ViewerWidget::GetFrame(const rational &t, bool playback, bool best_effort)
 {
-  QByteArray cached_hash = GetConnectedNode()->video_frame_cache()->GetHash(t);
+  // Direct previews never hash or cache frames, so there's nothing to look up
+  QByteArray cached_hash;
 
-  QString cache_fn = GetConnectedNode()->video_frame_cache()->CachePathName(cached_hash);
+  if (!direct_preview_) {
+    cached_hash = GetConnectedNode()->video_frame_cache()->GetHash(t);
+  }
+
+  bool cached = !cached_hash.isEmpty() && GetConnectedNode()->video_frame_cache()->HasCacheFrame(cached_hash);
+
+  if (show_performance_overlay_) {
+    if (cached) {
+      cache_hits_++;
+    } else {
+      cache_misses_++;
+    }
+  }
 
-  if (cached_hash.isEmpty() || !QFileInfo::exists(cache_fn)) {
+  if (!cached) {
     // Frame hasn't been cached, start render job
-    if (clear_render_queue) {
-      auto_cacher_.ClearVideoQueue();
+    if (playback) {
+      return auto_cacher_->GetPlaybackFrame(this, t, adaptive_divider_);
     }
 
-    return auto_cacher_.GetSingleFrame(t);
+    auto_cacher_->ClearVideoQueue();
+
+    return auto_cacher_->GetSingleFrame(this, t, GetRenderRegion(), best_effort);
   } else {
     // Frame has been cached, grab the frame
     RenderTicketPtr ticket = std::make_shared<RenderTicket>();
     ticket->setProperty("time", QVariant::fromValue(t));
-    QtConcurrent::run(this, &ViewerWidget::DecodeCachedImage, ticket, cache_fn, t);
+
+    FramePtr frame = FrameMemoryCache::instance()->Get(cached_hash);
+
+    if (frame) {
+      // Frame is still in memory, no need to go to another thread at all
+      frame->set_timestamp(t);
+      ticket->Start();
+      ticket->Finish(QVariant::fromValue(frame), false);
+    } else {
+      QtConcurrent::run(&cache_decode_pool_, this, &ViewerWidget::DecodeCachedImage, ticket, cached_hash, t);
+    }
 
     return ticket;
   }
@@ -645,10 +1212,20 @@ void ViewerWidget::FinishPlayPreprocess()
   int64_t playback_start_time = ruler()->GetTime();
 
   AudioPlaybackCache* audio_cache = GetConnectedNode()->audio_playback_cache();
+  qint64 audio_offset = audio_cache->GetParameters().time_to_bytes(GetTime());
+
   AudioManager::instance()->SetOutputParams(audio_cache->GetParameters());
-  AudioManager::instance()->StartOutput(audio_cache,
-                                        audio_cache->GetParameters().time_to_bytes(GetTime()),
-                                        playback_speed_);
+
+  if (direct_preview_ || Config::Current()["AudioRealtimeMix"].toBool() || IsAudioCacheStale()) {
+    // Mix as we play rather than play silence or the old mix until the cache catches up
+    AudioManager::instance()->StartOutput(auto_cacher_->CreateLiveAudioDevice(),
+                                          audio_offset,
+                                          playback_speed_);
+  } else {
+    AudioManager::instance()->StartOutput(audio_cache,
+                                          audio_offset,
+                                          playback_speed_);
+  }
 
   playback_timer_.Start(playback_start_time, playback_speed_, timebase_dbl());
 
@@ -656,12 +1233,90 @@ void ViewerWidget::FinishPlayPreprocess()
     window->Play(playback_start_time, playback_speed_, timebase());
   }
 
-  connect(display_widget_, &ViewerDisplayWidget::frameSwapped, this, &ViewerWidget::ForceUpdate);
+  frame_pacer_.Reset();
+  connect(display_widget_, &ViewerDisplayWidget::frameSwapped, this, &ViewerWidget::VsyncTick);
 
-  playback_backup_timer_.setInterval(qFloor(timebase_dbl()));
+  // Checks a few times a frame whether vsync has stopped driving playback
+  playback_backup_timer_.setInterval(qMax(1, qFloor(timebase_dbl() * 1000.0 / 4.0)));
   playback_backup_timer_.start();
 
   PlaybackTimerUpdate();
+  ForceUpdate();
+}
+
+void ViewerWidget::VsyncTick()
+{
+  if (!IsPlaying()) {
+    return;
+  }
+
+  frame_pacer_.VsyncOccurred();
+
+  // Whatever's drawn now is seen at the next vsync, so that's the time to choose a frame for
+  qint64 until_vsync = frame_pacer_.GetTimeUntilNextVsync();
+
+  PlaybackTimerUpdate(until_vsync);
+
+  if (!IsPlaying()) {
+    // Reached the end
+    return;
+  }
+
+  FramePtr shown = display_widget_->last_loaded_buffer();
+
+  if (shown && shown->timestamp() == GetTime()) {
+    // Still this frame's turn, redraw it anyway so we hear about the next vsync
+    display_widget_->update();
+    return;
+  }
+
+  UpdateTextureFromNode(GetTime());
+
+  FramePtr now_shown = display_widget_->last_loaded_buffer();
+
+  if (now_shown && now_shown != shown && now_shown->timestamp() == GetTime()) {
+    frame_pacer_.FramePresented(GetTimestamp(),
+                                until_vsync - playback_timer_.GetTimeUntil(GetTimestamp()),
+                                playback_speed_);
+  } else if (FrameExistsAtTime(GetTime())) {
+    // The frame isn't ready, keep the vsyncs coming so it's shown as soon as it is
+    frame_pacer_.FrameRepeated();
+    display_widget_->update();
+  }
+}
+
+void ViewerWidget::BackupTimerTick()
+{
+  if (frame_pacer_.IsVsyncActive() && isVisible()) {
+    return;
+  }
+
+  PlaybackTimerUpdate();
+
+  if (IsPlaying() && isVisible()) {
+    // Show the frame ourselves, which also restarts the vsync loop if it had stalled
+    FramePtr shown = display_widget_->last_loaded_buffer();
+
+    if (!shown || shown->timestamp() != GetTime()) {
+      ForceUpdate();
+    }
+  }
+}
+
+bool ViewerWidget::IsAudioCacheStale()
+{
+  AudioPlaybackCache* audio_cache = GetConnectedNode()->audio_playback_cache();
+
+  // Only what's about to be played matters
+  TimeRange upcoming = (playback_speed_ > 0) ? TimeRange(GetTime(), audio_cache->GetLength()) : TimeRange(rational(), GetTime());
+
+  foreach (const TimeRange& r, audio_cache->GetInvalidatedRanges()) {
+    if (r.OverlapsWith(upcoming, false, false)) {
+      return true;
+    }
+  }
+
+  return false;
 }
 
 int ViewerWidget::DeterminePlaybackQueueSize()
@@ -677,16 +1332,14 @@ int ViewerWidget::DeterminePlaybackQueueSize()
 
   int remaining_frames = (end_ts - GetTimestamp()) * playback_speed_;
 
-  return qMin(kMaxPreQueueSize, remaining_frames);
+  return qMin(qMax(playback_lead_, GetDecodeBoundPlaybackLead()), remaining_frames);
 }
 
 void ViewerWidget::PopOldestFrameFromPlaybackQueue()
 {
   playback_queue_.pop_front();
 
-  if (int(playback_queue_.size()) < DeterminePlaybackQueueSize()) {
-    RequestNextFrameForQueue();
-  }
+  TopUpPlaybackQueue();
 }
 
 void ViewerWidget::UpdateStack()
@@ -774,18 +1427,26 @@ void ViewerWidget::RendererGeneratedFrameForQueue()
 {
   RenderTicketWatcher* watcher = static_cast<RenderTicketWatcher*>(sender());
 
-  if (!watcher->WasCancelled()) {
+  // Requests that were cancelled (e.g. on seek) are no longer in the list even if they finished
+  // before the cancel was noticed
+  if (queue_watchers_.removeOne(watcher) && !watcher->WasCancelled()) {
     FramePtr frame = watcher->Get().value<FramePtr>();
 
+    // Only rendered frames carry a render time, cache hits don't tell us anything
+    qint64 render_time = watcher->GetTicket()->stats().render_time;
+    if (frame && render_time >= 0) {
+      UpdateAdaptivePlaybackDivider(render_time, frame->video_params().divider());
+    }
+
     // Ignore this signal if we've paused now
-    if (IsPlaying() || prequeuing_) {
+    if (frame && (IsPlaying() || prequeuing_)) {
       playback_queue_.AppendTimewise({frame->timestamp(), frame}, playback_speed_);
 
       foreach (ViewerWindow* window, windows_) {
         window->queue()->AppendTimewise({frame->timestamp(), frame}, playback_speed_);
       }
 
-      if (prequeuing_ && int(playback_queue_.size()) == prequeue_length_) {
+      if (prequeuing_ && int(playback_queue_.size()) >= prequeue_length_) {
         prequeuing_ = false;
         FinishPlayPreprocess();
       }
@@ -889,7 +1550,7 @@ void ViewerWidget::ShowContextMenu(const QPoint &pos)
       // Auto-cache
       QAction* autocache_action = cache_menu->addAction(tr("Auto-Cache"));
       autocache_action->setCheckable(true);
-      autocache_action->setChecked(!auto_cacher_.IsPaused());
+      autocache_action->setChecked(!autocache_paused_);
       connect(autocache_action, &QAction::triggered, this, &ViewerWidget::SetAutoCacheEnabled);
 
       cache_menu->addSeparator();
@@ -902,6 +1563,20 @@ void ViewerWidget::ShowContextMenu(const QPoint &pos)
         pause_autocache_during_playback_ = e;
       });
 
+      // Lower the resolution while playing if rendering can't keep up
+      QAction* adaptive_resolution = cache_menu->addAction(tr("Adaptive Playback Resolution"));
+      adaptive_resolution->setCheckable(true);
+      adaptive_resolution->setChecked(Config::Current()[QStringLiteral("AdaptivePlaybackResolution")].toBool());
+      connect(adaptive_resolution, &QAction::triggered, this, [](bool e){
+        Config::Current()[QStringLiteral("AdaptivePlaybackResolution")] = e;
+      });
+
+      // Frame rate, queue, cache and slowest node overlay
+      QAction* show_performance_overlay = cache_menu->addAction(tr("Show Performance Overlay"));
+      show_performance_overlay->setCheckable(true);
+      show_performance_overlay->setChecked(show_performance_overlay_);
+      connect(show_performance_overlay, &QAction::triggered, this, &ViewerWidget::SetPerformanceOverlayEnabled);
+
       cache_menu->addSeparator();
 
       // Cache Entire Sequence
@@ -974,7 +1649,9 @@ void ViewerWidget::Pause()
 {
   PauseInternal();
 
-  auto_cacher_.SetPlayhead(GetTime());
+  if (auto_cacher_) {
+    auto_cacher_->SetPlayhead(this, GetTime());
+  }
 }
 
 void ViewerWidget::ShuttleLeft()
@@ -1040,9 +1717,11 @@ void ViewerWidget::TimebaseChangedEvent(const rational &timebase)
   LengthChangedSlot(GetConnectedNode() ? GetConnectedNode()->GetLength() : 0);
 }
 
-void ViewerWidget::PlaybackTimerUpdate()
+void ViewerWidget::PlaybackTimerUpdate(qint64 ahead_nsecs)
 {
-  int64_t current_time = playback_timer_.GetTimestampNow();
+  playback_timer_.SyncToAudioOutput();
+
+  int64_t current_time = playback_timer_.GetTimestampAt(ahead_nsecs);
 
   int64_t min_time, max_time;
 
@@ -1172,6 +1851,11 @@ void ViewerWidget::SetZoomFromMenu(QAction *action)
 
 void ViewerWidget::ViewerInvalidatedVideoRange(const TimeRange &range)
 {
+  // A gizmo drag being previewed renders when it pauses rather than with every change
+  if (display_widget_->IsPreviewingGizmo() && !IsPlaying()) {
+    return;
+  }
+
   // If our current frame is within this range, we need to update
   if (GetTime() >= range.in() && (GetTime() < range.out() || range.in() == range.out())) {
     QMetaObject::invokeMethod(this, "ForceUpdate", Qt::QueuedConnection);
@@ -21,10 +21,12 @@
 #ifndef VIEWER_WIDGET_H
 #define VIEWER_WIDGET_H
 
+#include <QElapsedTimer>
 #include <QFile>
 #include <QLabel>
 #include <QPushButton>
 #include <QScrollBar>
+#include <QThreadPool>
 #include <QTimer>
 #include <QWidget>
 
@@ -35,6 +37,7 @@
 #include "render/previewautocacher.h"
 #include "threading/threadticketwatcher.h"
 #include "viewerdisplay.h"
+#include "viewerframepacer.h"
 #include "viewerplaybacktimer.h"
 #include "viewerqueue.h"
 #include "viewersizer.h"
@@ -168,6 +171,13 @@ protected:
     return display_widget_;
   }
 
+  /**
+   * @brief Render frames straight to the display, bypassing the frame hash, disk and audio caches
+   *
+   * \see PreviewAutoCacher::SetDirectPreview()
+   */
+  void SetDirectPreview(bool e);
+
 private:
   void UpdateTimeInternal(int64_t i);
 
@@ -189,19 +199,93 @@ private:
 
   void SetDisplayImage(FramePtr frame, bool main_only);
 
-  void RequestNextFrameForQueue();
+  /**
+   * @brief Request the next frame ahead of the playhead, returns FALSE if there's no frame there
+   */
+  bool RequestNextFrameForQueue();
+
+  /**
+   * @brief Request frames until the queue plus frames in flight reach the current lead
+   */
+  void TopUpPlaybackQueue();
 
-  RenderTicketPtr GetFrame(const rational& t, bool clear_render_queue);
+  /**
+   * @brief Cancel all frames requested for the playback queue that haven't arrived yet
+   */
+  void CancelPlaybackQueueRequests();
+
+  /**
+   * @brief Cancel requests for frames the playhead has already passed
+   */
+  void CancelStalePlaybackQueueRequests(const rational& time);
+
+  /**
+   * @brief Returns the most frames the playback queue may hold before exceeding its memory budget
+   */
+  int GetMaximumPlaybackLead();
+
+  /**
+   * @brief Returns how many frames need to be in flight for cache decoding to keep up with playback
+   *
+   * Based on how long recent cache frames took to decode. Returns 0 if nothing has been decoded yet.
+   */
+  int GetDecodeBoundPlaybackLead();
+
+  /**
+   * @brief Returns the part of the frame a single frame render needs, or a null rect for all of it
+   *
+   * When zoomed in, only the visible part of the frame plus a border for panning is rendered.
+   */
+  QRect GetRenderRegion();
+
+  /**
+   * @brief Returns the divider frames rendered for playback should use
+   *
+   * This is the sequence's own divider unless adaptive playback resolution has raised it.
+   */
+  int GetPlaybackDivider();
+
+  /**
+   * @brief Step the adaptive playback divider up or down based on how long a frame took to render
+   *
+   * Does nothing unless "AdaptivePlaybackResolution" is enabled.
+   */
+  void UpdateAdaptivePlaybackDivider(qint64 render_time, int divider);
+
+  /**
+   * @brief Start or stop showing the performance overlay
+   *
+   * While shown, render tickets are profiled and the overlay is refreshed periodically. While
+   * hidden, nothing is sampled.
+   */
+  void SetPerformanceOverlayEnabled(bool e);
+
+  /**
+   * @brief Get a frame for display
+   *
+   * If `playback` is TRUE, the frame is requested alongside others ahead of the playhead,
+   * otherwise it replaces any single frame currently being rendered and the auto-cache queue is
+   * cleared so it renders as soon as possible.
+   *
+   * If `best_effort` is TRUE, a nearby frame that's faster to decode may be returned instead (see
+   * RenderManager::RenderFrame()).
+   */
+  RenderTicketPtr GetFrame(const rational& t, bool playback, bool best_effort = false);
 
   void FinishPlayPreprocess();
 
+  /**
+   * @brief Returns TRUE if any audio between the playhead and where playback is heading is not cached
+   */
+  bool IsAudioCacheStale();
+
   int DeterminePlaybackQueueSize();
 
   void PopOldestFrameFromPlaybackQueue();
 
-  FramePtr DecodeCachedImage(const QString &fn, const rational& time) const;
+  FramePtr DecodeCachedImage(const QByteArray &hash, const rational& time) const;
 
-  void DecodeCachedImage(RenderTicketPtr ticket, const QString &fn, const rational& time) const;
+  void DecodeCachedImage(RenderTicketPtr ticket, const QByteArray &hash, const rational& time) const;
 
   bool ShouldForceWaveform() const;
 
@@ -234,8 +318,14 @@ private:
   ViewerDisplayWidget* context_menu_widget_;
 
   ViewerPlaybackTimer playback_timer_;
+
+  /**
+   * @brief Advances playback while vsync isn't driving it, see BackupTimerTick()
+   */
   QTimer playback_backup_timer_;
 
+  ViewerFramePacer frame_pacer_;
+
   ViewerQueue playback_queue_;
   int64_t playback_queue_next_frame_;
 
@@ -243,16 +333,115 @@ private:
 
   QList<RenderTicketWatcher*> nonqueue_watchers_;
 
+  QList<RenderTicketWatcher*> queue_watchers_;
+
   rational last_length_;
 
   int prequeue_length_;
 
-  PreviewAutoCacher auto_cacher_;
+  /**
+   * @brief Number of frames kept rendered or rendering ahead of the playhead
+   *
+   * Grows each time a frame isn't ready in time, up to GetMaximumPlaybackLead().
+   */
+  int playback_lead_;
+
+  int dropped_frames_;
+
+  bool show_performance_overlay_;
+
+  QTimer performance_overlay_timer_;
+
+  QElapsedTimer performance_overlay_clock_;
+
+  /**
+   * @brief Time since the last frame was requested while paused, used to detect scrubbing
+   */
+  QElapsedTimer scrub_clock_;
+
+  /**
+   * @brief Fires once the playhead has stopped moving to replace a best-effort frame with the exact one
+   */
+  QTimer scrub_settle_timer_;
+
+  /**
+   * @brief Fires once a previewed gizmo drag pauses to render the exact image
+   */
+  QTimer gizmo_preview_timer_;
+
+  /**
+   * @brief Counters sampled and reset by UpdatePerformanceOverlay(), only kept while it's shown
+   */
+  int delivered_frames_;
+  int cache_hits_;
+  int cache_misses_;
+
+  /**
+   * @brief Moving average of how long a cached frame takes to load, in microseconds
+   */
+  mutable QAtomicInt cache_decode_time_;
+
+  /**
+   * @brief Divider chosen by adaptive playback resolution, or 0 to use the sequence's
+   */
+  int adaptive_divider_;
+
+  /**
+   * @brief Moving average of how long playback frames took to render at the current divider, in nanoseconds
+   */
+  qint64 adaptive_render_time_;
+
+  int adaptive_samples_;
+
+  /**
+   * @brief Cacher shared by every viewer showing the connected node, nullptr if none is connected
+   */
+  PreviewAutoCacher* auto_cacher_;
+
+  /**
+   * @brief Whether the user turned auto-cache off, kept across connected nodes
+   */
+  bool autocache_paused_;
+
+  bool direct_preview_;
+
+  /**
+   * @brief Threads cached frames are loaded on, several at once so EXR decoding keeps up with playback
+   *
+   * Declared last so it's destroyed (and waits for any running decodes) before anything they use.
+   */
+  QThreadPool cache_decode_pool_;
 
   static QVector<ViewerWidget*> instances_;
 
 private slots:
-  void PlaybackTimerUpdate();
+  /**
+   * @brief Move the playhead to where playback should be `ahead_nsecs` from now
+   */
+  void PlaybackTimerUpdate(qint64 ahead_nsecs = 0);
+
+  /**
+   * @brief Present the frame for the next vsync, called each time the display swaps during playback
+   */
+  void VsyncTick();
+
+  /**
+   * @brief Keep playback going when the display isn't swapping, e.g. while it's hidden
+   */
+  void BackupTimerTick();
+
+  void UpdatePerformanceOverlay();
+
+  void ScrubSettled();
+
+  void GizmoDragStarted();
+
+  void GizmoDragMoved();
+
+  /**
+   * @brief Render the gizmo node's current values, ending the preview if the drag is over
+   */
+  void RenderGizmoPreview();
 
   void LengthChangedSlot(const rational& length);
 
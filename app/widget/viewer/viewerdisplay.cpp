@@ -21,6 +21,7 @@
 #include "viewerdisplay.h"
 
 #include <OpenImageIO/imagebuf.h>
+#include <QDebug>
 #include <QFileInfo>
 #include <QMessageBox>
 #include <QMouseEvent>
@@ -28,9 +29,12 @@
 #include <QOpenGLFunctions>
 #include <QOpenGLTexture>
 #include <QPainter>
+#include <QPainterPath>
+#include <QVector4D>
 
 #include "common/define.h"
 #include "common/functiontimer.h"
+#include "common/qtutils.h"
 #include "config/config.h"
 #include "core.h"
 #include "gizmotraverser.h"
@@ -39,10 +43,18 @@ namespace olive {
 
 ViewerDisplayWidget::ViewerDisplayWidget(QWidget *parent) :
   ManagedDisplayWidget(parent),
+  texture_is_shared_(false),
   deinterlace_texture_(nullptr),
+  display_texture_valid_(false),
+  display_texture_painted_(false),
   signal_cursor_color_(false),
+  color_sample_format_(VideoParams::kFormatInvalid),
+  color_sample_moved_(false),
   gizmos_(nullptr),
+  gizmo_db_valid_(false),
   gizmo_click_(false),
+  gizmo_preview_(false),
+  gizmo_preview_render_pending_(false),
   last_loaded_buffer_(nullptr),
   hand_dragging_(false),
   deinterlace_(false)
@@ -91,22 +103,54 @@ void ViewerDisplayWidget::SetSignalCursorColorEnabled(bool e)
 
 void ViewerDisplayWidget::SetImage(FramePtr in_buffer)
 {
+  if (texture_is_shared_) {
+    // Once we let go of a renderer's texture it can be rendered into again, so make sure we're
+    // done drawing it first
+    makeCurrent();
+    renderer()->Flush();
+    doneCurrent();
+
+    texture_ = nullptr;
+    texture_is_shared_ = false;
+  }
+
   last_loaded_buffer_ = in_buffer;
 
+  if (gizmo_preview_ && gizmo_preview_render_pending_) {
+    // This is the image of the values we requested, move it from there from now on
+    gizmo_preview_render_pending_ = false;
+
+    if (gizmo_click_) {
+      gizmo_preview_reference_ = gizmo_preview_pending_reference_;
+      UpdateGizmoPreview();
+    } else {
+      EndGizmoPreview();
+    }
+  }
+
+  InvalidateDisplayTexture();
+
   if (last_loaded_buffer_) {
     makeCurrent();
 
-    if (!texture_
+    if (in_buffer->texture()) {
+      // Rendered in a context that shares with ours, draw it directly rather than uploading the
+      // frame's data (which would also download it)
+      texture_ = in_buffer->texture();
+      texture_is_shared_ = true;
+    } else if (!texture_
         || texture_->width() != in_buffer->width()
         || texture_->height() != in_buffer->height()
         || texture_->format() != in_buffer->format()
         || texture_->channel_count() != in_buffer->channel_count()) {
-      texture_ = renderer()->CreateTexture(in_buffer->video_params(), in_buffer->data(), in_buffer->linesize_pixels());
+      texture_ = renderer()->CreateTexture(in_buffer->video_params(), in_buffer->const_data(), in_buffer->linesize_pixels());
     } else {
-      texture_->Upload(in_buffer->data(), in_buffer->linesize_pixels());
+      texture_->Upload(in_buffer->const_data(), in_buffer->linesize_pixels());
     }
 
     doneCurrent();
+
+    UpdateDeinterlacedTexture();
   }
 
   update();
@@ -116,8 +160,11 @@ void ViewerDisplayWidget::SetDeinterlacing(bool e)
 {
   deinterlace_ = e;
 
+  InvalidateDisplayTexture();
+
   if (deinterlace_) {
     deinterlace_shader_ = renderer()->CreateNativeShader(ShaderCode(FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/deinterlace.frag"))));
+    UpdateDeinterlacedTexture();
   } else {
     renderer()->DestroyNativeShader(deinterlace_shader_);
     deinterlace_texture_ = nullptr;
@@ -126,6 +173,32 @@ void ViewerDisplayWidget::SetDeinterlacing(bool e)
   update();
 }
 
+void ViewerDisplayWidget::UpdateDeinterlacedTexture()
+{
+  if (!deinterlace_ || !texture_) {
+    return;
+  }
+
+  makeCurrent();
+
+  if (!deinterlace_texture_
+      || deinterlace_texture_->params() != texture_->params()) {
+    // (Re)create texture
+    deinterlace_texture_ = renderer()->CreateTexture(texture_->params());
+  }
+
+  int field = (gizmo_params_.interlacing() == VideoParams::kInterlacedBottomFirst) ? 1 : 0;
+
+  ShaderJob job;
+  job.InsertValue(QStringLiteral("resolution_in"), ShaderValue(QVector2D(texture_->width(), texture_->height()), NodeParam::kVec2));
+  job.InsertValue(QStringLiteral("field_in"), ShaderValue(field, NodeParam::kInt));
+  job.InsertValue(QStringLiteral("ove_maintex"), ShaderValue(QVariant::fromValue(texture_), NodeParam::kTexture));
+
+  renderer()->BlitToTexture(deinterlace_shader_, job, deinterlace_texture_.get());
+
+  doneCurrent();
+}
+
 const ViewerSafeMarginInfo &ViewerDisplayWidget::GetSafeMargin() const
 {
   return safe_margin_;
@@ -140,10 +213,39 @@ void ViewerDisplayWidget::SetSafeMargins(const ViewerSafeMarginInfo &safe_margin
   }
 }
 
+void ViewerDisplayWidget::SetPerformanceOverlay(const QStringList &lines)
+{
+  performance_overlay_ = lines;
+
+  update();
+}
+
+void ViewerDisplayWidget::ClearPerformanceOverlay()
+{
+  if (!performance_overlay_.isEmpty()) {
+    performance_overlay_.clear();
+
+    update();
+  }
+}
+
 void ViewerDisplayWidget::SetGizmos(Node *node)
 {
   if (gizmos_ != node) {
+    if (gizmos_) {
+      disconnect(gizmos_, &Node::CacheInvalidated, this, &ViewerDisplayWidget::GizmoCacheInvalidated);
+    }
+
     gizmos_ = node;
+    gizmo_db_valid_ = false;
+
+    if (gizmo_preview_) {
+      EndGizmoPreview();
+    }
+
+    if (gizmos_) {
+      connect(gizmos_, &Node::CacheInvalidated, this, &ViewerDisplayWidget::GizmoCacheInvalidated);
+    }
 
     update();
   }
@@ -153,6 +255,9 @@ void ViewerDisplayWidget::SetVideoParams(const VideoParams &params)
 {
   gizmo_params_ = params;
 
+  // Gizmo values are generated at the sequence's resolution
+  gizmo_db_valid_ = false;
+
   if (gizmos_) {
     update();
   }
@@ -172,6 +277,77 @@ FramePtr ViewerDisplayWidget::last_loaded_buffer() const
   return last_loaded_buffer_;
 }
 
+bool ViewerDisplayWidget::StartGizmoPreview()
+{
+  if (!gizmo_click_ || !last_loaded_buffer_) {
+    return false;
+  }
+
+  QRectF clip;
+
+  if (!gizmos_->GetGizmoImageGeometry(GetGizmoDatabase(), &gizmo_preview_reference_, &clip)
+      || !gizmo_preview_reference_.isInvertible()) {
+    return false;
+  }
+
+  gizmo_preview_ = true;
+  gizmo_preview_render_pending_ = false;
+
+  UpdateGizmoPreview();
+
+  return true;
+}
+
+void ViewerDisplayWidget::GizmoPreviewRenderRequested()
+{
+  if (!gizmo_preview_) {
+    return;
+  }
+
+  QRectF clip;
+
+  if (gizmos_->GetGizmoImageGeometry(GetGizmoDatabase(), &gizmo_preview_pending_reference_, &clip)
+      && gizmo_preview_pending_reference_.isInvertible()) {
+    gizmo_preview_render_pending_ = true;
+  } else {
+    // Can't tell where the next image will be anymore, just show it as it is
+    EndGizmoPreview();
+  }
+}
+
+void ViewerDisplayWidget::UpdateGizmoPreview()
+{
+  QTransform current;
+  QRectF clip;
+
+  if (!gizmos_->GetGizmoImageGeometry(GetGizmoDatabase(), &current, &clip)) {
+    return;
+  }
+
+  // Map from the normalized coordinates the image is drawn with to sequence pixels and back, the
+  // gizmo node works in the latter
+  double half_width = gizmo_params_.width() * gizmo_params_.pixel_aspect_ratio().toDouble() * 0.5;
+  double half_height = gizmo_params_.height() * 0.5;
+  QTransform normalized_to_sequence(half_width, 0, 0, half_height, half_width, half_height);
+
+  QTransform moved = gizmo_preview_reference_.inverted() * current;
+
+  gizmo_preview_matrix_ = QMatrix4x4(normalized_to_sequence * moved * normalized_to_sequence.inverted());
+  gizmo_preview_clip_ = clip;
+
+  UpdateMatrix();
+}
+
+void ViewerDisplayWidget::EndGizmoPreview()
+{
+  gizmo_preview_ = false;
+  gizmo_preview_render_pending_ = false;
+  gizmo_preview_matrix_.setToIdentity();
+  gizmo_preview_clip_ = QRectF();
+
+  UpdateMatrix();
+}
+
 QPoint ViewerDisplayWidget::TransformViewerSpaceToBufferSpace(QPoint pos)
 {
   /*
@@ -184,13 +360,15 @@ QPoint ViewerDisplayWidget::TransformViewerSpaceToBufferSpace(QPoint pos)
 void ViewerDisplayWidget::mousePressEvent(QMouseEvent *event)
 {
   if (event->button() == Qt::LeftButton && gizmos_
-      && gizmos_->GizmoPress(gizmo_db_, TransformViewerSpaceToBufferSpace(event->pos()))) {
+      && gizmos_->GizmoPress(GetGizmoDatabase(), TransformViewerSpaceToBufferSpace(event->pos()))) {
 
     // Handle gizmo click
     gizmo_click_ = true;
     gizmo_drag_time_ = GetGizmoTime();
     gizmo_start_drag_ = event->pos();
 
+    emit GizmoDragStarted();
+
   } else if (IsHandDrag(event)) {
 
     // Handle hand drag
@@ -228,8 +406,15 @@ void ViewerDisplayWidget::mouseMoveEvent(QMouseEvent *event)
     gizmos_->GizmoMove(TransformViewerSpaceToBufferSpace(event->pos()),
                        gizmo_drag_time_);
     gizmo_start_drag_ = event->pos();
+
+    if (gizmo_preview_) {
+      UpdateGizmoPreview();
+    }
+
     update();
 
+    emit GizmoDragMoved();
+
   } else {
 
     // Default behavior
@@ -253,6 +438,8 @@ void ViewerDisplayWidget::mouseReleaseEvent(QMouseEvent *event)
     gizmos_->GizmoRelease();
     gizmo_click_ = false;
 
+    emit GizmoDragEnded();
+
   } else {
 
     // Default behavior
@@ -261,6 +448,15 @@ void ViewerDisplayWidget::mouseReleaseEvent(QMouseEvent *event)
   }
 }
 
+void ViewerDisplayWidget::resizeEvent(QResizeEvent *event)
+{
+  ManagedDisplayWidget::resizeEvent(event);
+
+  if (!IsVisibleRegionRendered()) {
+    emit VisibleRegionNotRendered();
+  }
+}
+
 void ViewerDisplayWidget::OnPaint()
 {
   // Clear background to empty
@@ -270,23 +466,8 @@ void ViewerDisplayWidget::OnPaint()
   // We only draw if we have a pipeline
   if (last_loaded_buffer_ && color_service()) {
 
-    TexturePtr texture_to_draw = texture_;
-
-    if (deinterlace_) {
-      if (!deinterlace_texture_
-          || deinterlace_texture_->params() != texture_to_draw->params()) {
-        // (Re)create texture
-        deinterlace_texture_ = renderer()->CreateTexture(texture_to_draw->params());
-      }
-
-      ShaderJob job;
-      job.InsertValue(QStringLiteral("resolution_in"), ShaderValue(QVector2D(texture_to_draw->width(), texture_to_draw->height()), NodeParam::kVec2));
-      job.InsertValue(QStringLiteral("ove_maintex"), ShaderValue(QVariant::fromValue(texture_to_draw), NodeParam::kTexture));
-
-      renderer()->BlitToTexture(deinterlace_shader_, job, deinterlace_texture_.get());
-
-      texture_to_draw = deinterlace_texture_;
-    }
+    // Deinterlaced once per image in SetImage() rather than on every repaint
+    TexturePtr texture_to_draw = (deinterlace_ && deinterlace_texture_) ? deinterlace_texture_ : texture_;
 
     // Draw texture through color transform
     int device_width = width() * devicePixelRatioF();
@@ -294,25 +475,60 @@ void ViewerDisplayWidget::OnPaint()
     VideoParams::Format device_format = static_cast<VideoParams::Format>(Config::Current()["OfflinePixelFormat"].toInt());
     VideoParams device_params(device_width, device_height, device_format, VideoParams::kInternalChannelCount);
 
-    renderer()->BlitColorManaged(color_service(), texture_to_draw, true, device_params, false,
-                                 combined_matrix_flipped_);
+    bool display_texture_current = display_texture_valid_
+        && display_texture_->params() == device_params
+        && display_texture_processor_ == color_service()
+        && display_texture_matrix_ == combined_matrix_flipped_
+        && display_texture_background_ == bg_color;
+
+    if (!display_texture_current && !display_texture_painted_) {
+      // First time this image is drawn, which during playback is the only time, so there's no
+      // point keeping a copy
+      renderer()->BlitColorManaged(color_service(), texture_to_draw, true, device_params, false,
+                                   combined_matrix_flipped_);
+
+      display_texture_painted_ = true;
+    } else {
+      // The same image is being redrawn (e.g. for an overlay or the cursor), keep the
+      // display-transformed result so further repaints are a plain copy
+      if (!display_texture_current) {
+        UpdateDisplayTexture(texture_to_draw, device_params, bg_color);
+      }
+
+      if (display_texture_valid_) {
+        ShaderJob job;
+        job.InsertValue(QStringLiteral("ove_maintex"), ShaderValue(QVariant::fromValue(display_texture_), NodeParam::kTexture));
+        renderer()->Blit(display_copy_shader_, job, device_params, false);
+      } else {
+        renderer()->BlitColorManaged(color_service(), texture_to_draw, true, device_params, false,
+                                     combined_matrix_flipped_);
+      }
+    }
   }
 
   QTransform world_transform = GenerateWorldTransform();
 
-  // Draw gizmos if we have any
-  if (gizmos_) {
-    GizmoTraverser gt(QVector2D(gizmo_params_.width() * gizmo_params_.pixel_aspect_ratio().toDouble(),
-                                gizmo_params_.height()));
+  if (gizmo_preview_ && !gizmo_preview_clip_.isNull()) {
+    // Hide what the gizmo's clip no longer shows by painting over it with the background, anything
+    // it newly reveals has to wait for a render
+    QPainter p(inner_widget());
+    p.setWorldTransform(GenerateGizmoTransform());
 
-    rational node_time = GetGizmoTime();
+    QPainterPath hidden;
+    hidden.setFillRule(Qt::OddEvenFill);
+    hidden.addRect(QRectF(0, 0,
+                          gizmo_params_.width() * gizmo_params_.pixel_aspect_ratio().toDouble(),
+                          gizmo_params_.height()));
+    hidden.addRect(gizmo_preview_clip_.normalized());
 
-    gizmo_db_ = gt.GenerateDatabase(gizmos_, TimeRange(node_time,
-                                                       node_time + gizmo_params_.time_base()));
+    p.fillPath(hidden, bg_color);
+  }
 
+  // Draw gizmos if we have any
+  if (gizmos_) {
     QPainter p(inner_widget());
     p.setWorldTransform(GenerateGizmoTransform());
-    gizmos_->DrawGizmos(gizmo_db_, &p);
+    gizmos_->DrawGizmos(GetGizmoDatabase(), &p);
   }
 
   // Draw action/title safe areas
@@ -348,13 +564,93 @@ void ViewerDisplayWidget::OnPaint()
 
     p.drawLines(lines, 2);
   }
+
+  // Draw performance statistics
+  if (!performance_overlay_.isEmpty()) {
+    QPainter p(inner_widget());
+
+    int line_height = p.fontMetrics().height();
+    int width = 0;
+
+    foreach (const QString& line, performance_overlay_) {
+      width = qMax(width, QtUtils::QFontMetricsWidth(p.fontMetrics(), line));
+    }
+
+    QRect text_rect(line_height / 2, line_height / 2, width, line_height * performance_overlay_.size());
+
+    p.fillRect(text_rect.adjusted(-2, -2, 2, 2), QColor(0, 0, 0, 160));
+    p.setPen(Qt::white);
+    p.drawText(text_rect, Qt::AlignLeft | Qt::AlignTop, performance_overlay_.join('\n'));
+  }
+}
+
+void ViewerDisplayWidget::UpdateDisplayTexture(TexturePtr source, const VideoParams &device_params, const QColor &bg_color)
+{
+  if (display_copy_shader_.isNull()) {
+    display_copy_shader_ = renderer()->CreateNativeShader(ShaderCode(FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/default.frag")),
+                                                                     FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/default.vert"))));
+    display_fill_shader_ = renderer()->CreateNativeShader(ShaderCode(FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/solid.frag"))));
+
+    if (display_copy_shader_.isNull() || display_fill_shader_.isNull()) {
+      qCritical() << "Failed to create viewer display cache shaders";
+      return;
+    }
+  }
+
+  if (!display_texture_ || display_texture_->params() != device_params) {
+    display_texture_ = renderer()->CreateTexture(device_params);
+  }
+
+  // Fill with the background first so the copy matches drawing straight onto the cleared widget
+  ShaderJob fill_job;
+  fill_job.InsertValue(QStringLiteral("color_in"), ShaderValue(QVariant::fromValue(QVector4D(bg_color.redF(), bg_color.greenF(), bg_color.blueF(), 1.0f)), NodeParam::kVec4));
+  renderer()->BlitToTexture(display_fill_shader_, fill_job, display_texture_.get());
+
+  renderer()->BlitColorManaged(color_service(), source, true, display_texture_.get(), false,
+                               combined_matrix_flipped_);
+
+  display_texture_processor_ = color_service();
+  display_texture_matrix_ = combined_matrix_flipped_;
+  display_texture_background_ = bg_color;
+  display_texture_valid_ = true;
+
+  // Drawing into textures leaves the renderer's framebuffer unbound, rebind the widget's
+  makeCurrent();
+}
+
+void ViewerDisplayWidget::InvalidateDisplayTexture()
+{
+  display_texture_valid_ = false;
+  display_texture_painted_ = false;
 }
 
 void ViewerDisplayWidget::OnDestroy()
 {
+  if (!color_sample_download_.isNull()) {
+    // Finish it anyway so the renderer can clean up after it
+    QByteArray discard(VideoParams::GetBytesPerPixel(color_sample_format_, VideoParams::kRGBAChannelCount), 0);
+    renderer()->FinishDownloadFromTexture(color_sample_download_, discard.data());
+    color_sample_download_.clear();
+  }
+
+  display_texture_ = nullptr;
+  display_texture_processor_ = nullptr;
+  InvalidateDisplayTexture();
+
+  if (!display_copy_shader_.isNull()) {
+    renderer()->DestroyNativeShader(display_copy_shader_);
+    display_copy_shader_.clear();
+  }
+
+  if (!display_fill_shader_.isNull()) {
+    renderer()->DestroyNativeShader(display_fill_shader_);
+    display_fill_shader_.clear();
+  }
+
   ManagedDisplayWidget::OnDestroy();
 
   texture_ = nullptr;
+  texture_is_shared_ = false;
 }
 
 QPointF ViewerDisplayWidget::GetTexturePosition(const QPoint &screen_pos)
@@ -378,6 +674,32 @@ rational ViewerDisplayWidget::GetGizmoTime()
   return GetAdjustedTime(GetTimeTarget(), gizmos_, time_, NodeParam::kInput);
 }
 
+const NodeValueDatabase &ViewerDisplayWidget::GetGizmoDatabase()
+{
+  rational node_time = GetGizmoTime();
+
+  if (!gizmo_db_valid_ || gizmo_db_time_ != node_time) {
+    GizmoTraverser gt(QVector2D(gizmo_params_.width() * gizmo_params_.pixel_aspect_ratio().toDouble(),
+                                gizmo_params_.height()));
+
+    gizmo_db_ = gt.GenerateDatabase(gizmos_, TimeRange(node_time,
+                                                       node_time + gizmo_params_.time_base()));
+    gizmo_db_time_ = node_time;
+    gizmo_db_valid_ = true;
+  }
+
+  return gizmo_db_;
+}
+
+void ViewerDisplayWidget::GizmoCacheInvalidated(const TimeRange &range)
+{
+  if (gizmo_db_valid_
+      && range.OverlapsWith(TimeRange(gizmo_db_time_, gizmo_db_time_ + gizmo_params_.time_base()))) {
+    gizmo_db_valid_ = false;
+    update();
+  }
+}
+
 bool ViewerDisplayWidget::IsHandDrag(QMouseEvent *event) const
 {
   return event->button() == Qt::MiddleButton || Core::instance()->tool() == Tool::kHand;
@@ -391,7 +713,47 @@ void ViewerDisplayWidget::UpdateMatrix()
   combined_matrix_flipped_.scale(1.0, -1.0, 1.0);
   combined_matrix_flipped_ *= combined_matrix_;
 
+  // Only the image moves during a gizmo preview, gizmos are drawn with `combined_matrix_`
+  combined_matrix_flipped_ *= gizmo_preview_matrix_;
+
+  // Zooming or panning repaints once per step, don't keep copies of every step
+  InvalidateDisplayTexture();
+
   update();
+
+  if (!IsVisibleRegionRendered()) {
+    emit VisibleRegionNotRendered();
+  }
+}
+
+QRect ViewerDisplayWidget::GetVisibleRegion()
+{
+  if (gizmo_params_.width() <= 0 || gizmo_params_.height() <= 0) {
+    return QRect();
+  }
+
+  QRectF visible = GenerateGizmoTransform().inverted().mapRect(QRectF(rect()));
+
+  return visible.toAlignedRect() & QRect(0, 0, gizmo_params_.width(), gizmo_params_.height());
+}
+
+bool ViewerDisplayWidget::IsVisibleRegionRendered()
+{
+  if (!last_loaded_buffer_ || !last_loaded_buffer_->is_partial()) {
+    return true;
+  }
+
+  int divider = last_loaded_buffer_->video_params().divider();
+  QRect visible = GetVisibleRegion();
+
+  QRect effective(visible.left() / divider,
+                  visible.top() / divider,
+                  visible.width() / divider + 1,
+                  visible.height() / divider + 1);
+
+  effective &= QRect(0, 0, last_loaded_buffer_->width(), last_loaded_buffer_->height());
+
+  return last_loaded_buffer_->region().contains(effective);
 }
 
 QTransform ViewerDisplayWidget::GenerateWorldTransform()
@@ -425,22 +787,72 @@ QTransform ViewerDisplayWidget::GenerateGizmoTransform()
   return gizmo_transform;
 }
 
+void ViewerDisplayWidget::StartColorSample()
+{
+  color_sample_moved_ = false;
+
+  if (texture_) {
+    QPointF pixel_pos = GenerateGizmoTransform().inverted().map(QPointF(color_sample_pos_));
+
+    pixel_pos /= texture_->params().divider();
+
+    QPoint pixel(qRound(pixel_pos.x()), qRound(pixel_pos.y()));
+
+    if (QRect(0, 0, texture_->width(), texture_->height()).contains(pixel)) {
+      // Read the one pixel straight from the texture we're drawing, the frame itself may only
+      // exist on the GPU and downloading all of it for this would be a waste
+      makeCurrent();
+      color_sample_download_ = renderer()->BeginDownloadRegionFromTexture(texture_.get(), QRect(pixel, QSize(1, 1)));
+      doneCurrent();
+
+      if (!color_sample_download_.isNull()) {
+        color_sample_format_ = texture_->format();
+
+        // Give the transfer until the next event loop iteration to complete
+        QMetaObject::invokeMethod(this, "FinishColorSample", Qt::QueuedConnection);
+        return;
+      }
+    }
+  }
+
+  emit CursorColor(Color(), Color());
+}
+
 void ViewerDisplayWidget::EmitColorAtCursor(QMouseEvent *e)
 {
   // Do this no matter what, emits signal to any pixel samplers
   if (signal_cursor_color_) {
-    Color reference, display;
+    color_sample_pos_ = e->pos();
+
+    if (color_sample_download_.isNull()) {
+      StartColorSample();
+    } else {
+      color_sample_moved_ = true;
+    }
+  }
+}
 
-    if (last_loaded_buffer_) {
-      QPointF pixel_pos = GenerateGizmoTransform().inverted().map(e->pos());
+void ViewerDisplayWidget::FinishColorSample()
+{
+  if (color_sample_download_.isNull()) {
+    return;
+  }
 
-      pixel_pos /= last_loaded_buffer_->video_params().divider();
+  QByteArray pixel(VideoParams::GetBytesPerPixel(color_sample_format_, VideoParams::kRGBAChannelCount), 0);
 
-      reference = last_loaded_buffer_->get_pixel(qRound(pixel_pos.x()), qRound(pixel_pos.y()));
-      display = color_service()->ConvertColor(reference);
-    }
+  makeCurrent();
+  renderer()->FinishDownloadFromTexture(color_sample_download_, pixel.data());
+  doneCurrent();
+
+  color_sample_download_.clear();
+
+  Color reference(pixel.constData(), color_sample_format_, VideoParams::kRGBAChannelCount);
+  Color display = color_service() ? color_service()->ConvertColor(reference) : reference;
+
+  emit CursorColor(reference, display);
 
-    emit CursorColor(reference, display);
+  if (color_sample_moved_) {
+    StartColorSample();
   }
 }
 
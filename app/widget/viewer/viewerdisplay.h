@@ -73,6 +73,16 @@ public:
 
   FramePtr last_loaded_buffer() const;
 
+  /**
+   * @brief Returns the part of the frame currently visible, in sequence pixels
+   */
+  QRect GetVisibleRegion();
+
+  /**
+   * @brief Returns FALSE if the current image is partial and doesn't cover everything visible
+   */
+  bool IsVisibleRegionRendered();
+
   /**
    * @brief Transform a point from viewer space to the buffer space.
    * Multiplies by the inverted transform matrix to undo the scaling and translation.
@@ -84,6 +94,36 @@ public:
     return deinterlace_;
   }
 
+  /**
+   * @brief Show performance statistics in the corner of the display, one entry per line
+   */
+  void SetPerformanceOverlay(const QStringList& lines);
+
+  /**
+   * @brief Stop showing performance statistics
+   */
+  void ClearPerformanceOverlay();
+
+  /**
+   * @brief Preview the gizmo drag that just started by moving the shown image rather than rendering
+   *
+   * Returns FALSE if the gizmo node can't be previewed this way, in which case the drag should be
+   * rendered as normal. The preview lasts until the image rendered after the drag is set.
+   */
+  bool StartGizmoPreview();
+
+  /**
+   * @brief Call when the gizmo node's current values are about to be rendered
+   *
+   * The next image set is taken as showing them, and if the drag has ended the preview stops.
+   */
+  void GizmoPreviewRenderRequested();
+
+  bool IsPreviewingGizmo() const
+  {
+    return gizmo_preview_;
+  }
+
 public slots:
   /**
    * @brief Set the transformation matrix to draw with
@@ -151,6 +191,26 @@ signals:
    */
   void CursorColor(const Color& reference, const Color& display);
 
+  /**
+   * @brief Emitted when panning, zooming or resizing reveals part of the frame a partial image doesn't cover
+   */
+  void VisibleRegionNotRendered();
+
+  /**
+   * @brief Emitted when the user grabs a gizmo, before it's moved
+   */
+  void GizmoDragStarted();
+
+  /**
+   * @brief Emitted each time a grabbed gizmo is moved, after the node's values have changed
+   */
+  void GizmoDragMoved();
+
+  /**
+   * @brief Emitted once a gizmo is let go
+   */
+  void GizmoDragEnded();
+
 protected:
   /**
    * @brief Override the mouse press event for the DragStarted() signal and gizmos
@@ -167,6 +227,8 @@ protected:
    */
   virtual void mouseReleaseEvent(QMouseEvent* event) override;
 
+  virtual void resizeEvent(QResizeEvent* event) override;
+
   /**
    * @brief Paint function to display the texture (received in SetTexture()) on screen.
    *
@@ -183,19 +245,59 @@ private:
 
   rational GetGizmoTime();
 
+  /**
+   * @brief Returns the gizmo node's values at the current time, only traversing if they're out of date
+   */
+  const NodeValueDatabase& GetGizmoDatabase();
+
   bool IsHandDrag(QMouseEvent* event) const;
 
+  /**
+   * @brief Update the image's move from `gizmo_preview_reference_` to where the gizmo node has it now
+   */
+  void UpdateGizmoPreview();
+
+  /**
+   * @brief Stop moving the image and draw it as is
+   */
+  void EndGizmoPreview();
+
   void UpdateMatrix();
 
+  /**
+   * @brief Render the deinterlaced copy of `texture_` if deinterlacing is enabled
+   */
+  void UpdateDeinterlacedTexture();
+
+  /**
+   * @brief Draw `source` through the display transform into `display_texture_`
+   */
+  void UpdateDisplayTexture(TexturePtr source, const VideoParams& device_params, const QColor& bg_color);
+
+  /**
+   * @brief Mark `display_texture_` as out of date because the image or how it's drawn has changed
+   */
+  void InvalidateDisplayTexture();
+
   QTransform GenerateWorldTransform();
 
   QTransform GenerateGizmoTransform();
 
+  /**
+   * @brief Start reading back the pixel of `texture_` under `color_sample_pos_`
+   */
+  void StartColorSample();
+
   /**
    * @brief Internal reference to the OpenGL texture to draw. Set in SetTexture() and used in paintGL().
    */
   TexturePtr texture_;
 
+  /**
+   * @brief TRUE if `texture_` belongs to a renderer rather than being our own upload
+   */
+  bool texture_is_shared_;
+
   /**
    * @brief Internal texture to deinterlace to
    */
@@ -206,6 +308,27 @@ private:
    */
   QVariant deinterlace_shader_;
 
+  /**
+   * @brief The last image as drawn on screen, so repaints while paused skip the display transform
+   *
+   * Only made once the same image is painted a second time, since during playback every image is
+   * only painted once. The processor, matrix and background it was drawn with are kept to check it
+   * against the current ones.
+   */
+  TexturePtr display_texture_;
+  ColorProcessorPtr display_texture_processor_;
+  QMatrix4x4 display_texture_matrix_;
+  QColor display_texture_background_;
+  bool display_texture_valid_;
+
+  /**
+   * @brief Whether the current image has already been drawn since it last changed
+   */
+  bool display_texture_painted_;
+
+  QVariant display_copy_shader_;
+  QVariant display_fill_shader_;
+
   /**
    * @brief Translation only matrix (defaults to identity).
    */
@@ -224,15 +347,44 @@ private:
 
   bool signal_cursor_color_;
 
+  /**
+   * @brief Readback of the pixel under the cursor that's still in flight
+   *
+   * Only one runs at a time, if the cursor moves in the meantime another is started for its
+   * latest position once this one finishes.
+   */
+  QVariant color_sample_download_;
+  VideoParams::Format color_sample_format_;
+  QPoint color_sample_pos_;
+  bool color_sample_moved_;
+
   ViewerSafeMarginInfo safe_margin_;
 
+  QStringList performance_overlay_;
+
   Node* gizmos_;
   NodeValueDatabase gizmo_db_;
+  rational gizmo_db_time_;
+  bool gizmo_db_valid_;
   rational gizmo_drag_time_;
   VideoParams gizmo_params_;
   QPoint gizmo_start_drag_;
   bool gizmo_click_;
 
+  /**
+   * @brief State of a gizmo drag preview, see StartGizmoPreview()
+   *
+   * The reference is the gizmo node's image geometry when the shown image was rendered, the
+   * pending reference is the one of the render that was requested last. The matrix moves the
+   * image from the reference to the current geometry in the same space as `combined_matrix_`.
+   */
+  bool gizmo_preview_;
+  bool gizmo_preview_render_pending_;
+  QTransform gizmo_preview_reference_;
+  QTransform gizmo_preview_pending_reference_;
+  QMatrix4x4 gizmo_preview_matrix_;
+  QRectF gizmo_preview_clip_;
+
   rational time_;
 
   FramePtr last_loaded_buffer_;
@@ -248,6 +400,13 @@ private:
 private slots:
   void EmitColorAtCursor(QMouseEvent* e);
 
+  void FinishColorSample();
+
+  /**
+   * @brief Drops the gizmo database if the gizmo node's values around the current time changed
+   */
+  void GizmoCacheInvalidated(const olive::TimeRange& range);
+
 };
 
 }
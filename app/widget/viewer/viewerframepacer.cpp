@@ -0,0 +1,116 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "viewerframepacer.h"
+
+#include <QGuiApplication>
+#include <QScreen>
+
+namespace olive {
+
+const int ViewerFramePacer::kMaximumOutliers = 8;
+
+ViewerFramePacer::ViewerFramePacer() :
+  last_vsync_(-1),
+  outliers_(0),
+  has_presented_(false),
+  last_presented_(0)
+{
+  // Start from what the screen claims until we've measured it ourselves
+  QScreen* screen = QGuiApplication::primaryScreen();
+  qreal refresh_rate = screen ? screen->refreshRate() : 0;
+
+  if (refresh_rate < 1) {
+    refresh_rate = 60;
+  }
+
+  vsync_interval_ = qRound64(1000000000.0 / refresh_rate);
+
+  clock_.start();
+
+  Reset();
+}
+
+void ViewerFramePacer::Reset()
+{
+  stats_ = Statistics();
+  has_presented_ = false;
+}
+
+void ViewerFramePacer::VsyncOccurred()
+{
+  qint64 now = clock_.nsecsElapsed();
+
+  if (last_vsync_ >= 0) {
+    qint64 delta = now - last_vsync_;
+
+    if (delta > vsync_interval_ / 2 && delta < vsync_interval_ * 3 / 2) {
+      // Averaging out the jitter in when we're told about the swap
+      vsync_interval_ += (delta - vsync_interval_) / 16;
+      outliers_ = 0;
+    } else if (delta > 0 && ++outliers_ >= kMaximumOutliers) {
+      // Consistently off, the estimate was wrong (e.g. the window moved to another screen)
+      vsync_interval_ = delta;
+      outliers_ = 0;
+    }
+  }
+
+  last_vsync_ = now;
+}
+
+bool ViewerFramePacer::IsVsyncActive() const
+{
+  return last_vsync_ >= 0 && clock_.nsecsElapsed() - last_vsync_ < vsync_interval_ * 3;
+}
+
+qint64 ViewerFramePacer::GetTimeUntilNextVsync() const
+{
+  if (last_vsync_ < 0) {
+    return vsync_interval_;
+  }
+
+  qint64 since_last = clock_.nsecsElapsed() - last_vsync_;
+
+  return qBound(qint64(0), vsync_interval_ - since_last, vsync_interval_);
+}
+
+void ViewerFramePacer::FramePresented(int64_t timestamp, qint64 error_nsecs, int speed)
+{
+  stats_.presented++;
+
+  if (error_nsecs > vsync_interval_) {
+    stats_.late++;
+  } else if (error_nsecs < 0) {
+    stats_.early++;
+  }
+
+  if (has_presented_ && speed != 0) {
+    int64_t steps = (timestamp - last_presented_) / speed;
+
+    if (steps > 1) {
+      stats_.skipped += static_cast<int>(steps - 1);
+    }
+  }
+
+  has_presented_ = true;
+  last_presented_ = timestamp;
+}
+
+}
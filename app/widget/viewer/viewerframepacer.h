@@ -0,0 +1,136 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2020 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef VIEWERFRAMEPACER_H
+#define VIEWERFRAMEPACER_H
+
+#include <QElapsedTimer>
+#include <QtGlobal>
+
+#include "common/define.h"
+
+namespace olive {
+
+/**
+ * @brief Tracks the display's vsync and how evenly playback frames are presented on it
+ *
+ * The viewer's display widget emits frameSwapped() once per vsync for as long as it keeps asking
+ * to be redrawn, so playback picks each frame from there. VsyncOccurred() is called on every swap
+ * to measure the actual refresh interval, which tells playback when the frame it draws now will
+ * reach the screen. Displays that don't wait for vsync (e.g. a driver forcing the swap interval
+ * to 0) are measured the same way, their "refresh" is just however fast they swap.
+ *
+ * Frames presented during playback are scored against when they were due:
+ *
+ * - Late: reached the screen more than a refresh after it was due
+ * - Early: reached the screen before it was due
+ * - Repeated: a refresh where the previous frame stayed up because the due one wasn't ready
+ * - Skipped: a frame that was never shown at all
+ */
+class ViewerFramePacer
+{
+public:
+  struct Statistics {
+    int presented;
+    int late;
+    int early;
+    int repeated;
+    int skipped;
+  };
+
+  ViewerFramePacer();
+
+  /**
+   * @brief Clear statistics, called when playback starts
+   */
+  void Reset();
+
+  /**
+   * @brief Call whenever the display widget swapped buffers
+   */
+  void VsyncOccurred();
+
+  /**
+   * @brief Returns TRUE if vsyncs are arriving, meaning they can drive playback
+   *
+   * Swaps stop when the display widget isn't being redrawn (e.g. it's hidden or waiting for a
+   * frame), in which case a timer has to take over.
+   */
+  bool IsVsyncActive() const;
+
+  /**
+   * @brief Estimated nanoseconds until the next vsync, when a frame drawn now will be seen
+   */
+  qint64 GetTimeUntilNextVsync() const;
+
+  /**
+   * @brief Measured refresh interval in nanoseconds
+   */
+  qint64 GetVsyncInterval() const
+  {
+    return vsync_interval_;
+  }
+
+  /**
+   * @brief Record a new frame being presented
+   *
+   * `error_nsecs` is how long after it was due it will reach the screen. `speed` is the playback
+   * speed, to tell how many frames were stepped over since the last one.
+   */
+  void FramePresented(int64_t timestamp, qint64 error_nsecs, int speed);
+
+  /**
+   * @brief Record a vsync where the due frame wasn't ready and the last one stays on screen
+   */
+  void FrameRepeated()
+  {
+    stats_.repeated++;
+  }
+
+  const Statistics& GetStatistics() const
+  {
+    return stats_;
+  }
+
+private:
+  /**
+   * @brief Consecutive swap intervals that don't fit the estimate before it's thrown out
+   */
+  static const int kMaximumOutliers;
+
+  QElapsedTimer clock_;
+
+  qint64 last_vsync_;
+
+  qint64 vsync_interval_;
+
+  int outliers_;
+
+  bool has_presented_;
+
+  int64_t last_presented_;
+
+  Statistics stats_;
+
+};
+
+}
+
+#endif // VIEWERFRAMEPACER_H
@@ -20,25 +20,112 @@
 
 #include "viewerplaybacktimer.h"
 
-#include <QDateTime>
+#include <QtMath>
+
+#include "audio/audiomanager.h"
 
 namespace olive {
 
+const qint64 ViewerPlaybackTimer::kMaximumSteerNsecs = 250000000;
+
+ViewerPlaybackTimer::ViewerPlaybackTimer() :
+  latency_msec_(0),
+  start_timestamp_(0),
+  playback_speed_(0),
+  timebase_(0),
+  audio_synced_(false),
+  audio_correction_nsecs_(0),
+  last_audio_sample_(0)
+{
+}
+
 void ViewerPlaybackTimer::Start(const int64_t &start_timestamp, const int &playback_speed, const double &timebase)
 {
-  start_msec_ = QDateTime::currentMSecsSinceEpoch();
+  clock_.start();
+  latency_msec_ = 0;
   start_timestamp_ = start_timestamp;
   playback_speed_ = playback_speed;
   timebase_ = timebase;
+  audio_synced_ = false;
+  audio_correction_nsecs_ = 0;
+  last_audio_sample_ = 0;
 }
 
-int64_t ViewerPlaybackTimer::GetTimestampNow() const
+int64_t ViewerPlaybackTimer::GetTimestampAt(qint64 ahead_nsecs) const
 {
-  int64_t real_time = QDateTime::currentMSecsSinceEpoch() - start_msec_;
+  if (timebase_ <= 0) {
+    return start_timestamp_;
+  }
+
+  qint64 real_time = qMax(qint64(0), GetPlaybackTime(ahead_nsecs));
 
-  int64_t frames_since_start = qRound(static_cast<double>(real_time) / (timebase_ * 1000));
+  // A frame is shown for the whole of its interval rather than from halfway through the one before
+  int64_t frames_since_start = static_cast<int64_t>(qFloor(static_cast<double>(real_time) / (timebase_ * 1000000000.0)));
 
   return start_timestamp_ + frames_since_start * playback_speed_;
 }
 
+qint64 ViewerPlaybackTimer::GetTimeUntil(int64_t timestamp) const
+{
+  if (playback_speed_ == 0) {
+    return 0;
+  }
+
+  double frames_since_start = static_cast<double>(timestamp - start_timestamp_) / playback_speed_;
+  qint64 due = qRound64(frames_since_start * timebase_ * 1000000000.0);
+
+  return due - GetPlaybackTime(0);
+}
+
+void ViewerPlaybackTimer::SyncToAudioOutput()
+{
+  AudioManager* audio = AudioManager::instance();
+
+  SetLatency(audio->GetOutputLatency());
+
+  qint64 played_usecs, sampled_at;
+
+  if (!clock_.isValid() || !audio->GetOutputClock(&played_usecs, &sampled_at)) {
+    audio_synced_ = false;
+    return;
+  }
+
+  if (audio_synced_ && sampled_at == last_audio_sample_) {
+    // Nothing new since last time
+    return;
+  }
+
+  last_audio_sample_ = sampled_at;
+
+  // How far ahead of our clock the audio was when it was sampled, which is the playback start,
+  // output latency and any drift between the two clocks
+  qint64 timer_elapsed = (sampled_at - clock_.msecsSinceReference()) * 1000000;
+  qint64 error = played_usecs * 1000 - timer_elapsed;
+
+  if (!audio_synced_ || qAbs(error - audio_correction_nsecs_) > kMaximumSteerNsecs) {
+    audio_correction_nsecs_ = error;
+    audio_synced_ = true;
+  } else {
+    // The output's clock only moves in whole buffer periods, so steer gradually
+    audio_correction_nsecs_ += (error - audio_correction_nsecs_) / 16;
+  }
+}
+
+qint64 ViewerPlaybackTimer::GetPlaybackTime(qint64 ahead_nsecs) const
+{
+  if (!clock_.isValid()) {
+    return 0;
+  }
+
+  qint64 t = clock_.nsecsElapsed() + ahead_nsecs;
+
+  if (audio_synced_) {
+    t += audio_correction_nsecs_;
+  } else {
+    t -= latency_msec_ * 1000000;
+  }
+
+  return t;
+}
+
 }
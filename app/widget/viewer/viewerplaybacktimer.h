@@ -21,26 +21,89 @@
 #ifndef VIEWERPLAYBACKTIMER_H
 #define VIEWERPLAYBACKTIMER_H
 
+#include <QElapsedTimer>
 #include <QtGlobal>
 
 #include "common/define.h"
 
 namespace olive {
 
+/**
+ * @brief Works out which frame should be on screen during playback
+ *
+ * Time is measured on the monotonic clock from when Start() was called. While the audio output
+ * is playing, SyncToAudioOutput() slaves the timer to the audio that's actually being heard by
+ * slowly steering it towards the output's clock, so video neither drifts from audio over long
+ * playbacks nor jumps around with the output's buffer. Otherwise, the timer is just delayed by
+ * the output's latency.
+ */
 class ViewerPlaybackTimer {
 public:
+  ViewerPlaybackTimer();
+
   void Start(const int64_t& start_timestamp, const int& playback_speed, const double& timebase);
 
-  int64_t GetTimestampNow() const;
+  int64_t GetTimestampNow() const
+  {
+    return GetTimestampAt(0);
+  }
+
+  /**
+   * @brief Get the timestamp that should be on screen `ahead_nsecs` from now
+   */
+  int64_t GetTimestampAt(qint64 ahead_nsecs) const;
+
+  /**
+   * @brief Returns how many nanoseconds from now `timestamp` is due, negative if it's already passed
+   */
+  qint64 GetTimeUntil(int64_t timestamp) const;
+
+  /**
+   * @brief Delay the timer by this many milliseconds so video lines up with audio that's heard late
+   *
+   * Only used while the timer isn't synced to the audio output.
+   */
+  void SetLatency(qint64 msec)
+  {
+    latency_msec_ = msec;
+  }
+
+  /**
+   * @brief Follow the audio output's clock if it's playing, or its latency if it isn't
+   */
+  void SyncToAudioOutput();
+
+  /**
+   * @brief Returns TRUE if the timer is currently following the audio output's clock
+   */
+  bool IsSyncedToAudio() const
+  {
+    return audio_synced_;
+  }
 
 private:
-  qint64 start_msec_;
+  /**
+   * @brief Nanoseconds of playback `ahead_nsecs` from now, with latency or audio sync applied
+   */
+  qint64 GetPlaybackTime(qint64 ahead_nsecs) const;
+
+  /**
+   * @brief Corrections further out than this are applied at once rather than steered towards
+   */
+  static const qint64 kMaximumSteerNsecs;
+
+  QElapsedTimer clock_;
+  qint64 latency_msec_;
   int64_t start_timestamp_;
 
   int playback_speed_;
 
   double timebase_;
 
+  bool audio_synced_;
+  qint64 audio_correction_nsecs_;
+  qint64 last_audio_sample_;
+
 };
 
 }
@@ -104,6 +104,8 @@ void ViewerWindow::closeEvent(QCloseEvent *e)
 
 void ViewerWindow::UpdateFromQueue()
 {
+  timer_.SyncToAudioOutput();
+
   int64_t t = timer_.GetTimestampNow();
 
   rational time = Timecode::timestamp_to_time(t, playback_timebase_);
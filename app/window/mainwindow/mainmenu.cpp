@@ -22,9 +22,12 @@
 
 #include <QDesktopServices>
 #include <QEvent>
+#include <QFileDialog>
+#include <QMessageBox>
 #include <QStyleFactory>
 
 #include "common/timecodefunctions.h"
+#include "common/tracer.h"
 #include "config/config.h"
 #include "core.h"
 #include "dialog/actionsearch/actionsearch.h"
@@ -244,6 +247,13 @@ MainMenu::MainMenu(MainWindow *parent) :
 
   tools_preferences_item_ = tools_menu_->AddItem("prefs", Core::instance(), &Core::DialogPreferencesShow, "Ctrl+,");
 
+  tools_menu_->addSeparator();
+
+  tools_debug_menu_ = new Menu(tools_menu_);
+  tools_record_trace_item_ = tools_debug_menu_->AddItem("recordtrace", this, &MainMenu::RecordTraceTriggered);
+  tools_record_trace_item_->setCheckable(true);
+  tools_save_trace_item_ = tools_debug_menu_->AddItem("savetrace", this, &MainMenu::SaveTraceTriggered);
+
   //
   // HELP MENU
   //
@@ -326,6 +336,8 @@ void MainMenu::ToolsMenuAboutToShow()
 
   // Ensure snapping value is correct
   tools_snapping_item_->setChecked(Core::instance()->snapping());
+
+  tools_record_trace_item_->setChecked(Tracer::IsEnabled());
 }
 
 void MainMenu::PlaybackMenuAboutToShow()
@@ -590,6 +602,39 @@ void MainMenu::SequenceCacheInOutTriggered()
   Core::instance()->CacheActiveSequence(true);
 }
 
+void MainMenu::RecordTraceTriggered(bool e)
+{
+  if (e) {
+    // Start every recording from scratch
+    Tracer::Clear();
+  }
+
+  Tracer::SetEnabled(e);
+}
+
+void MainMenu::SaveTraceTriggered()
+{
+  QString filename = QFileDialog::getSaveFileName(parentWidget(),
+                                                  tr("Save Render Trace"),
+                                                  QString(),
+                                                  tr("Chrome Trace (*.json)"));
+
+  if (filename.isEmpty()) {
+    return;
+  }
+
+  if (!filename.endsWith(QStringLiteral(".json"), Qt::CaseInsensitive)) {
+    filename.append(QStringLiteral(".json"));
+  }
+
+  if (!Tracer::SaveChromeTrace(filename)) {
+    QMessageBox::critical(parentWidget(),
+                          tr("Failed to save trace"),
+                          tr("Failed to write render trace to \"%1\".").arg(filename),
+                          QMessageBox::Ok);
+  }
+}
+
 void MainMenu::HelpFeedbackTriggered()
 {
   QDesktopServices::openUrl(QStringLiteral("https://github.com/olive-editor/olive/issues"));
@@ -684,6 +729,9 @@ void MainMenu::Retranslate()
   tools_transition_item_->setText(tr("Transition Tool"));
   tools_snapping_item_->setText(tr("Enable Snapping"));
   tools_preferences_item_->setText(tr("Preferences"));
+  tools_debug_menu_->setTitle(tr("Debug"));
+  tools_record_trace_item_->setText(tr("Record Render Trace"));
+  tools_save_trace_item_->setText(tr("Save Render Trace..."));
 
   // Help menu
   help_menu_->setTitle(tr("&Help"));
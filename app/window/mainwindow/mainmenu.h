@@ -174,6 +174,9 @@ private slots:
   void SequenceCacheTriggered();
   void SequenceCacheInOutTriggered();
 
+  void RecordTraceTriggered(bool e);
+  void SaveTraceTriggered();
+
   void HelpFeedbackTriggered();
 
 private:
@@ -265,6 +268,10 @@ private:
   QAction* tools_snapping_item_;
   QAction* tools_preferences_item_;
 
+  Menu* tools_debug_menu_;
+  QAction* tools_record_trace_item_;
+  QAction* tools_save_trace_item_;
+
   Menu* help_menu_;
   QAction* help_action_search_item_;
   QAction* help_feedback_item_;